@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <TaskSchedulerDeclarations.h>
+#include <array>
+#include <mutex>
+#include <optional>
+
+// computes the minimum, maximum and time-weighted average of a few power
+// flows over windows aligned to the wall clock, such that consumers need
+// not receive every sample to compute them, e.g., for 15 minute demand
+// tracking. every new sample of a source is accounted for in constant time,
+// the value of a source holds until its next sample arrives. the results
+// of a window are published to MQTT once the window completed.
+class AggregatesClass {
+public:
+    enum class Field : uint8_t {
+        InverterAcPower, // of all inverters with polling enabled, in W
+        InverterDcPower, // of all inverters with polling enabled, in W
+        BatteryCurrent, // positive while charging, in A
+        GridPower, // positive while importing, in W
+        SolarChargerPower // output of the solar charge controllers, in W
+    };
+    static constexpr size_t FIELD_COUNT = static_cast<size_t>(Field::SolarChargerPower) + 1;
+
+    enum class Window : uint8_t {
+        Minute,
+        QuarterHour,
+        Day // local day
+    };
+    static constexpr size_t WINDOW_COUNT = static_cast<size_t>(Window::Day) + 1;
+
+    struct Result {
+        uint32_t Start; // unix timestamp of the start of the window
+        uint32_t CoveredSeconds; // while the source provided data
+        float Min;
+        float Max;
+        float Average;
+    };
+
+    AggregatesClass();
+    void init(Scheduler& scheduler);
+
+    // nullopt if the source did not provide any data in the window
+    std::optional<Result> getCurrent(Field field, Window window) const;
+    std::optional<Result> getCompleted(Field field, Window window) const;
+
+    static char const* getName(Field field);
+    static char const* getName(Window window);
+
+private:
+    void loop();
+
+    // the value of a field as of the last sample
+    struct Held {
+        bool Valid = false;
+        float Value = 0;
+        uint32_t SampleMillis = 0;
+        uint32_t AccountedMillis = 0; // up to which the value was accounted
+    };
+
+    struct Accumulator {
+        uint32_t Start = 0;
+        uint32_t Count = 0; // of samples
+        float Min = 0;
+        float Max = 0;
+        double WeightedSum = 0; // value times milliseconds
+        uint32_t Millis = 0;
+
+        void reset(uint32_t start);
+        void account(float value, uint32_t millis);
+        void sample(float value);
+        std::optional<Result> getResult() const;
+    };
+
+    void sample(Field field, std::optional<float> value, uint32_t now);
+    void advance(uint32_t now);
+    void publish(Window window);
+    static uint32_t getWindowStart(Window window, uint32_t timestamp);
+
+    // a source which did not provide a sample for this long is considered
+    // to provide no data since its last sample
+    static constexpr uint32_t MAX_GAP_MILLIS = 60 * 1000;
+
+    Task _loopTask;
+
+    mutable std::mutex _mutex;
+    std::array<Held, FIELD_COUNT> _held;
+    std::array<std::array<Accumulator, WINDOW_COUNT>, FIELD_COUNT> _current;
+    std::array<std::array<std::optional<Result>, WINDOW_COUNT>, FIELD_COUNT> _completed;
+
+    uint32_t _lastInverterSequence = 0;
+    uint32_t _lastBatterySequence = 0;
+    uint32_t _lastPowerMeterSequence = 0;
+    uint32_t _lastSolarChargerSequence = 0;
+};
+
+extern AggregatesClass Aggregates;
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+
+// measures the stages of setup(). the stages run one after another on the
+// Arduino loop task, except for those which mostly wait for hardware and
+// which the following stages do not depend on: these run on a worker task
+// and are joined right before the first stage which needs them.
+class BootProfilerClass {
+public:
+    struct Stage {
+        char const* Name;
+        uint32_t StartMillis; // since the system started
+        uint32_t DurationMillis;
+        bool Concurrent; // run on a worker task
+        uint32_t WaitMillis; // how long setup() waited for the worker
+    };
+
+    // ends the current stage, if any, and starts the next one
+    void stage(char const* name);
+
+    // runs the function on a worker task. the function runs right away if
+    // the task cannot be created.
+    using Worker = size_t;
+    Worker startWorker(char const* name, std::function<void()> func);
+
+    // waits for the worker to finish
+    void join(Worker worker);
+
+    // ends the last stage, from here on the scheduler runs the control loops
+    void finish();
+
+    uint32_t getControlMillis() const { return _controlMillis; }
+    std::vector<Stage> getStages() const;
+
+private:
+    struct WorkerContext {
+        BootProfilerClass* pInstance;
+        size_t StageIndex;
+        std::function<void()> Func;
+        SemaphoreHandle_t Done;
+    };
+
+    static void workerHelper(void* context);
+    void endStage();
+
+    static constexpr uint32_t WorkerStackSize = 6144;
+
+    mutable std::mutex _mutex;
+    std::vector<Stage> _stages;
+    std::vector<std::unique_ptr<WorkerContext>> _workers;
+    int _current = -1;
+    uint32_t _controlMillis = 0;
+};
+
+extern BootProfilerClass BootProfiler;
@@ -0,0 +1,263 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "Configuration.h"
+#include "defaults.h"
+#include <ArduinoJson.h>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+
+// compile-time descriptions of the configuration structs: each table lists
+// the JSON key, the member, the default and optionally the bounds of every
+// field. the generic functions below serialize, deserialize and validate a
+// struct based on its table, such that a key is spelled exactly once for
+// all of these operations.
+namespace ConfigFields {
+
+// a bool, a number or an enum
+template<typename S, typename M>
+struct Scalar {
+    char const* Key;
+    M S::* Member;
+    M Default;
+    M Min;
+    M Max;
+    bool Bounded;
+    bool Rounded; // floats only: written with two decimal places
+};
+
+// a zero-terminated string in a char array
+template<typename S, size_t N>
+struct Text {
+    char const* Key;
+    char (S::* Member)[N];
+    char const* LegacyKey; // read if the key is missing, may be nullptr
+};
+
+template<typename S, typename M, typename D>
+constexpr Scalar<S, M> scalar(char const* key, M S::* member, D def)
+{
+    return { key, member, static_cast<M>(def), M{}, M{}, false, false };
+}
+
+template<typename S, typename M, typename D, typename B>
+constexpr Scalar<S, M> ranged(char const* key, M S::* member, D def, B min, B max)
+{
+    return { key, member, static_cast<M>(def), static_cast<M>(min), static_cast<M>(max), true, false };
+}
+
+template<typename S, typename D>
+constexpr Scalar<S, float> rounded(char const* key, float S::* member, D def)
+{
+    return { key, member, static_cast<float>(def), 0, 0, false, true };
+}
+
+template<typename S, size_t N>
+constexpr Text<S, N> text(char const* key, char (S::* member)[N], char const* legacyKey = nullptr)
+{
+    return { key, member, legacyKey };
+}
+
+inline double roundedFloat(float val)
+{
+    return static_cast<int>(val * 100 + (val > 0 ? 0.5 : -0.5)) / 100.0;
+}
+
+template<typename S, typename M>
+void write(Scalar<S, M> const& field, S const& source, JsonObject& target)
+{
+    M const& value = source.*field.Member;
+
+    if constexpr (std::is_enum_v<M>) {
+        target[field.Key] = static_cast<std::underlying_type_t<M>>(value);
+    } else if constexpr (std::is_floating_point_v<M>) {
+        if (field.Rounded) { target[field.Key] = roundedFloat(value); }
+        else { target[field.Key] = value; }
+    } else {
+        target[field.Key] = value;
+    }
+}
+
+template<typename S, size_t N>
+void write(Text<S, N> const& field, S const& source, JsonObject& target)
+{
+    // passed as pointer, such that the string is copied into the document
+    target[field.Key] = static_cast<char const*>(source.*field.Member);
+}
+
+template<typename S, typename M>
+void read(Scalar<S, M> const& field, JsonObject const& source, S& target)
+{
+    if constexpr (std::is_enum_v<M>) {
+        using U = std::underlying_type_t<M>;
+        target.*field.Member = static_cast<M>(source[field.Key] | static_cast<U>(field.Default));
+    } else {
+        target.*field.Member = source[field.Key] | field.Default;
+    }
+}
+
+template<typename S, size_t N>
+void read(Text<S, N> const& field, JsonObject const& source, S& target)
+{
+    char const* value = source[field.Key];
+    if (value == nullptr && field.LegacyKey != nullptr) { value = source[field.LegacyKey]; }
+    strlcpy(target.*field.Member, value ? value : "", N);
+}
+
+// fields missing from the source are accepted. only bounded scalars are
+// checked for their type.
+template<typename S, typename M>
+bool isValid(Scalar<S, M> const& field, JsonObject const& source)
+{
+    if (!field.Bounded) { return true; }
+
+    JsonVariantConst value = source[field.Key];
+    if (value.isNull()) { return true; }
+
+    using T = std::conditional_t<std::is_enum_v<M>, std::underlying_type<M>, std::common_type<M>>;
+    if (!value.is<typename T::type>()) { return false; }
+
+    M v = static_cast<M>(value.as<typename T::type>());
+    return v >= field.Min && v <= field.Max;
+}
+
+template<typename S, size_t N>
+bool isValid(Text<S, N> const& field, JsonObject const& source)
+{
+    JsonVariantConst value = source[field.Key];
+    if (value.isNull()) { return true; }
+    return value.is<char const*>() && strlen(value.as<char const*>()) < N;
+}
+
+template<typename Fields, typename S>
+void serialize(Fields const& fields, S const& source, JsonObject& target)
+{
+    std::apply([&](auto const&... field) { (write(field, source, target), ...); }, fields);
+}
+
+template<typename Fields, typename S>
+void deserialize(Fields const& fields, JsonObject const& source, S& target)
+{
+    std::apply([&](auto const&... field) { (read(field, source, target), ...); }, fields);
+}
+
+// returns the key of the first field with an invalid value, nullptr if the
+// values of all fields are acceptable
+template<typename Fields>
+char const* validate(Fields const& fields, JsonObject const& source)
+{
+    char const* invalidKey = nullptr;
+    std::apply([&](auto const&... field) {
+        ((invalidKey == nullptr && !isValid(field, source) ? (invalidKey = field.Key, 0) : 0), ...);
+    }, fields);
+    return invalidKey;
+}
+
+inline constexpr auto HttpRequest = std::make_tuple(
+    text("url", &HttpRequestConfig::Url),
+    scalar("auth_type", &HttpRequestConfig::AuthType, HttpRequestConfig::Auth::None),
+    text("username", &HttpRequestConfig::Username),
+    text("password", &HttpRequestConfig::Password),
+    text("header_key", &HttpRequestConfig::HeaderKey),
+    text("header_value", &HttpRequestConfig::HeaderValue),
+    scalar("timeout", &HttpRequestConfig::Timeout, HTTP_REQUEST_TIMEOUT_MS)
+);
+
+inline constexpr auto SolarCharger = std::make_tuple(
+    scalar("enabled", &SolarChargerConfig::Enabled, SOLAR_CHARGER_ENABLED),
+    scalar("verbose_logging", &SolarChargerConfig::VerboseLogging, VERBOSE_LOGGING),
+    scalar("provider", &SolarChargerConfig::Provider, SolarChargerProviderType::VEDIRECT),
+    scalar("additional_providers", &SolarChargerConfig::AdditionalProviders, SOLAR_CHARGER_ADDITIONAL_PROVIDERS),
+    scalar("publish_updates_only", &SolarChargerConfig::PublishUpdatesOnly, SOLAR_CHARGER_PUBLISH_UPDATES_ONLY)
+);
+
+inline constexpr auto SolarChargerMqtt = std::make_tuple(
+    scalar("calculate_output_power", &SolarChargerMqttConfig::CalculateOutputPower, false),
+    text("power_topic", &SolarChargerMqttConfig::PowerTopic),
+    text("power_path", &SolarChargerMqttConfig::PowerJsonPath),
+    scalar("power_unit", &SolarChargerMqttConfig::PowerUnit, SolarChargerMqttConfig::WattageUnit::Watts),
+    text("voltage_topic", &SolarChargerMqttConfig::VoltageTopic),
+    text("voltage_path", &SolarChargerMqttConfig::VoltageJsonPath),
+    scalar("voltage_unit", &SolarChargerMqttConfig::VoltageTopicUnit, SolarChargerMqttConfig::VoltageUnit::Volts),
+    text("current_topic", &SolarChargerMqttConfig::CurrentTopic),
+    text("current_path", &SolarChargerMqttConfig::CurrentJsonPath),
+    scalar("current_unit", &SolarChargerMqttConfig::CurrentUnit, SolarChargerMqttConfig::AmperageUnit::Amps)
+);
+
+inline constexpr auto PowerMeterSerialSdm = std::make_tuple(
+    ranged("address", &PowerMeterSerialSdmConfig::Address, POWERMETER_SDMADDRESS, 1, 247),
+    scalar("polling_interval", &PowerMeterSerialSdmConfig::PollingInterval, POWERMETER_POLLING_INTERVAL),
+    scalar("slow_polling_interval", &PowerMeterSerialSdmConfig::SlowPollingInterval, POWERMETER_SDM_SLOW_POLLING_INTERVAL),
+    ranged("submeter_address", &PowerMeterSerialSdmConfig::SubMeterAddress, POWERMETER_SDM_SUBMETER_ADDRESS, 0, 247),
+    scalar("submeter_three_phases", &PowerMeterSerialSdmConfig::SubMeterThreePhases, POWERMETER_SDM_SUBMETER_THREE_PHASES)
+);
+
+inline constexpr auto PowerMeterUdpSmaHm = std::make_tuple(
+    scalar("serial", &PowerMeterUdpSmaHmConfig::Serial, POWERMETER_SMAHM_SERIAL),
+    scalar("submeter_serial", &PowerMeterUdpSmaHmConfig::SubMeterSerial, POWERMETER_SMAHM_SUBMETER_SERIAL)
+);
+
+inline constexpr auto PowerMeterUdpPush = std::make_tuple(
+    ranged("port", &PowerMeterUdpPushConfig::Port, POWERMETER_UDP_PUSH_PORT, 1, 65535)
+);
+
+inline constexpr auto PowerMeterShellyRpc = std::make_tuple(
+    text("hostname", &PowerMeterShellyRpcConfig::Hostname),
+    text("password", &PowerMeterShellyRpcConfig::Password),
+    ranged("em_id", &PowerMeterShellyRpcConfig::EmId, POWERMETER_SHELLY_EM_ID, 0, 9)
+);
+
+inline constexpr auto PowerMeterFusion = std::make_tuple(
+    scalar("enabled", &PowerMeterFusionConfig::Enabled, POWERMETER_FUSION_ENABLED),
+    scalar("source", &PowerMeterFusionConfig::Source, POWERMETER_FUSION_SOURCE),
+    ranged("max_deviation", &PowerMeterFusionConfig::MaxDeviation, POWERMETER_FUSION_MAX_DEVIATION, 0, 10000)
+);
+
+inline constexpr auto Battery = std::make_tuple(
+    scalar("enabled", &BatteryConfig::Enabled, BATTERY_ENABLED),
+    scalar("verbose_logging", &BatteryConfig::VerboseLogging, VERBOSE_LOGGING),
+    scalar("provider", &BatteryConfig::Provider, BATTERY_PROVIDER),
+    scalar("additional_providers", &BatteryConfig::AdditionalProviders, BATTERY_ADDITIONAL_PROVIDERS),
+    scalar("soc_aggregation", &BatteryConfig::SocAggregation, BATTERY_SOC_AGGREGATION),
+    scalar("jkbms_interface", &BatteryConfig::JkBmsInterface, BATTERY_JKBMS_INTERFACE),
+    ranged("jkbms_polling_interval", &BatteryConfig::JkBmsPollingInterval, BATTERY_JKBMS_POLLING_INTERVAL, 2, 90),
+    ranged("jbdbms_cell_voltages_divider", &BatteryConfig::JbdBmsCellVoltagesDivider, BATTERY_JBDBMS_CELL_VOLTAGES_DIVIDER, 1, 20),
+    scalar("mqtt_full_publish_interval", &BatteryConfig::MqttFullPublishInterval, BATTERY_MQTT_FULL_PUBLISH_INTERVAL),
+    scalar("mqtt_deadband_relative", &BatteryConfig::MqttDeadbandRelative, BATTERY_MQTT_DEADBAND_RELATIVE),
+    scalar("mqtt_cell_deadband_millivolt", &BatteryConfig::MqttCellDeadbandMilliVolt, BATTERY_MQTT_CELL_DEADBAND_MILLIVOLT),
+    scalar("mqtt_cell_voltages_json", &BatteryConfig::MqttCellVoltagesJson, BATTERY_MQTT_CELL_VOLTAGES_JSON),
+    // these two were previously saved as mqtt_topic and mqtt_json_path
+    text("mqtt_soc_topic", &BatteryConfig::MqttSocTopic, "mqtt_topic"),
+    text("mqtt_soc_json_path", &BatteryConfig::MqttSocJsonPath, "mqtt_json_path"),
+    text("mqtt_voltage_topic", &BatteryConfig::MqttVoltageTopic),
+    text("mqtt_voltage_json_path", &BatteryConfig::MqttVoltageJsonPath),
+    scalar("mqtt_voltage_unit", &BatteryConfig::MqttVoltageUnit, BatteryVoltageUnit::Volts),
+    scalar("enable_discharge_current_limit", &BatteryConfig::EnableDischargeCurrentLimit, BATTERY_ENABLE_DISCHARGE_CURRENT_LIMIT),
+    scalar("discharge_current_limit", &BatteryConfig::DischargeCurrentLimit, BATTERY_DISCHARGE_CURRENT_LIMIT),
+    ranged("discharge_current_limit_below_soc", &BatteryConfig::DischargeCurrentLimitBelowSoc, BATTERY_DISCHARGE_CURRENT_LIMIT_BELOW_SOC, 0, 100),
+    scalar("discharge_current_limit_below_voltage", &BatteryConfig::DischargeCurrentLimitBelowVoltage, BATTERY_DISCHARGE_CURRENT_LIMIT_BELOW_VOLTAGE),
+    scalar("use_battery_reported_discharge_current_limit", &BatteryConfig::UseBatteryReportedDischargeCurrentLimit, BATTERY_USE_BATTERY_REPORTED_DISCHARGE_CURRENT_LIMIT),
+    text("mqtt_discharge_current_topic", &BatteryConfig::MqttDischargeCurrentTopic),
+    text("mqtt_discharge_current_json_path", &BatteryConfig::MqttDischargeCurrentJsonPath),
+    scalar("mqtt_amperage_unit", &BatteryConfig::MqttAmperageUnit, BatteryAmperageUnit::Amps)
+);
+
+inline constexpr auto GridCharger = std::make_tuple(
+    scalar("enabled", &GridChargerConfig::Enabled, HUAWEI_ENABLED),
+    scalar("verbose_logging", &GridChargerConfig::VerboseLogging, VERBOSE_LOGGING),
+    scalar("hardware_interface", &GridChargerConfig::HardwareInterface, GridChargerHardwareInterface::MCP2515),
+    scalar("can_controller_frequency", &GridChargerConfig::CAN_Controller_Frequency, HUAWEI_CAN_CONTROLLER_FREQUENCY),
+    ranged("unit_count", &GridChargerConfig::UnitCount, HUAWEI_UNIT_COUNT, 1, 3),
+    scalar("auto_power_enabled", &GridChargerConfig::Auto_Power_Enabled, false),
+    scalar("auto_power_batterysoc_limits_enabled", &GridChargerConfig::Auto_Power_BatterySoC_Limits_Enabled, false),
+    scalar("emergency_charge_enabled", &GridChargerConfig::Emergency_Charge_Enabled, false),
+    rounded("voltage_limit", &GridChargerConfig::Auto_Power_Voltage_Limit, HUAWEI_AUTO_POWER_VOLTAGE_LIMIT),
+    rounded("enable_voltage_limit", &GridChargerConfig::Auto_Power_Enable_Voltage_Limit, HUAWEI_AUTO_POWER_ENABLE_VOLTAGE_LIMIT),
+    scalar("lower_power_limit", &GridChargerConfig::Auto_Power_Lower_Power_Limit, HUAWEI_AUTO_POWER_LOWER_POWER_LIMIT),
+    scalar("upper_power_limit", &GridChargerConfig::Auto_Power_Upper_Power_Limit, HUAWEI_AUTO_POWER_UPPER_POWER_LIMIT),
+    ranged("stop_batterysoc_threshold", &GridChargerConfig::Auto_Power_Stop_BatterySoC_Threshold, HUAWEI_AUTO_POWER_STOP_BATTERYSOC_THRESHOLD, 2, 99),
+    scalar("target_power_consumption", &GridChargerConfig::Auto_Power_Target_Power_Consumption, HUAWEI_AUTO_POWER_TARGET_POWER_CONSUMPTION)
+);
+
+} // namespace ConfigFields
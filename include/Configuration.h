@@ -5,10 +5,12 @@
 #include <cstdint>
 #include <ArduinoJson.h>
 #include <TaskSchedulerDeclarations.h>
+#include <memory>
 #include <mutex>
-#include <condition_variable>
 
 #define CONFIG_FILENAME "/config.json"
+#define CONFIG_SNAPSHOT_FILENAME "/config.bin"
+#define CONFIG_TMP_SUFFIX ".tmp"
 #define CONFIG_VERSION 0x00011d00 // 0.1.29 // make sure to clean all after change
 #define CONFIG_VERSION_ONBATTERY 5
 
@@ -18,6 +20,10 @@
 
 #define SYSLOG_MAX_HOSTNAME_STRLEN 128
 
+#define INFLUX_MAX_HOSTNAME_STRLEN 128
+#define INFLUX_MAX_PATH_STRLEN 128
+#define INFLUX_MAX_TOKEN_STRLEN 128
+
 #define NTP_MAX_SERVER_STRLEN 31
 #define NTP_MAX_TIMEZONE_STRLEN 50
 #define NTP_MAX_TIMEZONEDESCR_STRLEN 50
@@ -29,10 +35,18 @@
 #define MQTT_MAX_TOPIC_STRLEN 256
 #define MQTT_MAX_LWTVALUE_STRLEN 20
 #define MQTT_MAX_CERT_STRLEN 2560
+#define MQTT_ROOT_CA_CERT_FILENAME "/mqtt_ca.pem"
+#define MQTT_CLIENT_CERT_FILENAME "/mqtt_cert.pem"
+#define MQTT_CLIENT_KEY_FILENAME "/mqtt_key.pem"
 #define MQTT_MAX_JSON_PATH_STRLEN 256
 
 #define INV_MAX_NAME_STRLEN 31
+// every slot costs memory in the configuration, the history and the
+// per-inverter state of several modules, so builds for larger plants may
+// raise this using a build flag.
+#ifndef INV_MAX_COUNT
 #define INV_MAX_COUNT 10
+#endif
 #define INV_MAX_CHAN_COUNT 6
 
 #define CHAN_MAX_NAME_STRLEN 31
@@ -46,6 +60,9 @@
 #define HTTP_REQUEST_MAX_HEADER_KEY_STRLEN 64
 #define HTTP_REQUEST_MAX_HEADER_VALUE_STRLEN 256
 
+#define POWERMETER_SHELLY_MAX_HOSTNAME_STRLEN 128
+#define POWERMETER_SHELLY_MAX_PASSWORD_STRLEN 64
+
 #define POWERMETER_MQTT_MAX_VALUES 3
 #define POWERMETER_HTTP_JSON_MAX_VALUES 3
 
@@ -104,6 +121,9 @@ using PowerMeterMqttConfig = struct POWERMETER_MQTT_CONFIG_T;
 struct POWERMETER_SERIAL_SDM_CONFIG_T {
     uint32_t Address;
     uint32_t PollingInterval;
+    uint32_t SlowPollingInterval; // voltages and energy counters
+    uint32_t SubMeterAddress; // 0: no sub-meter on the bus
+    bool SubMeterThreePhases;
 };
 using PowerMeterSerialSdmConfig = struct POWERMETER_SERIAL_SDM_CONFIG_T;
 
@@ -132,6 +152,33 @@ struct POWERMETER_HTTP_SML_CONFIG_T {
 };
 using PowerMeterHttpSmlConfig = struct POWERMETER_HTTP_SML_CONFIG_T;
 
+// combines the readings of a secondary source with the primary one
+struct POWERMETER_UDP_SMAHM_CONFIG_T {
+    uint32_t Serial; // 0: the first meter that is heard
+    uint32_t SubMeterSerial; // 0: no sub-meter
+};
+using PowerMeterUdpSmaHmConfig = struct POWERMETER_UDP_SMAHM_CONFIG_T;
+
+// readings pushed by the meter, see powermeter/udp/push/Provider.h
+struct POWERMETER_UDP_PUSH_CONFIG_T {
+    uint16_t Port;
+};
+using PowerMeterUdpPushConfig = struct POWERMETER_UDP_PUSH_CONFIG_T;
+
+struct POWERMETER_SHELLY_RPC_CONFIG_T {
+    char Hostname[POWERMETER_SHELLY_MAX_HOSTNAME_STRLEN + 1];
+    char Password[POWERMETER_SHELLY_MAX_PASSWORD_STRLEN + 1]; // empty: no authentication
+    uint8_t EmId;
+};
+using PowerMeterShellyRpcConfig = struct POWERMETER_SHELLY_RPC_CONFIG_T;
+
+struct POWERMETER_FUSION_CONFIG_T {
+    bool Enabled;
+    uint32_t Source;
+    uint16_t MaxDeviation; // in W, 0 disables the cross-check
+};
+using PowerMeterFusionConfig = struct POWERMETER_FUSION_CONFIG_T;
+
 struct POWERLIMITER_INVERTER_CONFIG_T {
     uint64_t Serial;
     bool IsGoverned;
@@ -150,6 +197,7 @@ struct POWERLIMITER_CONFIG_T {
     bool Enabled;
     bool VerboseLogging;
     bool SolarPassThroughEnabled;
+    bool SolarPowerPrediction;
     uint8_t ConductionLosses;
     bool BatteryAlwaysUseAtNight;
     int16_t TargetPowerConsumption;
@@ -161,6 +209,8 @@ struct POWERLIMITER_CONFIG_T {
     float VoltageStartThreshold;
     float VoltageStopThreshold;
     float VoltageLoadCorrectionFactor;
+    bool VoltageLoadCorrectionAdaptive;
+    uint16_t BatteryCapacity; // in Ah, zero disables the SoC estimate
     uint16_t FullSolarPassThroughSoc;
     float FullSolarPassThroughStartVoltage;
     float FullSolarPassThroughStopVoltage;
@@ -168,6 +218,38 @@ struct POWERLIMITER_CONFIG_T {
     uint8_t InverterChannelIdForDcVoltage;
     int8_t RestartHour;
     uint16_t TotalUpperPowerLimit;
+
+    // how the power is distributed among battery-powered inverters
+    enum DistributionStrategy { Sequential = 0, Efficiency = 1 };
+    DistributionStrategy Distribution;
+
+    // several DTUs sharing one grid meter, see DplCluster.h
+    struct {
+        uint8_t Role; // 0: standalone, 1: leader, 2: follower
+        uint16_t Port;
+        uint8_t Id; // separates several clusters on the same network
+    } Cluster;
+
+    // thresholds for the 90th percentiles, see ControlLatency.h. zero
+    // disables the respective alert.
+    struct {
+        uint16_t ReactionMillis;
+        uint16_t MeterIntervalMillis;
+        uint16_t StatsAgeMillis;
+    } LatencyAlert;
+
+    // an alternate configuration evaluated against the live inputs without
+    // commanding the inverters, see PowerLimiterShadow.h
+    struct {
+        bool Enabled;
+        int16_t TargetPowerConsumption;
+        uint16_t TargetPowerConsumptionHysteresis;
+        uint16_t BatterySocStartThreshold;
+        uint16_t BatterySocStopThreshold;
+        float VoltageStartThreshold;
+        float VoltageStopThreshold;
+    } Shadow;
+
     PowerLimiterInverterConfig Inverters[INV_MAX_COUNT];
 };
 using PowerLimiterConfig = struct POWERLIMITER_CONFIG_T;
@@ -176,12 +258,22 @@ enum BatteryVoltageUnit { Volts = 0, DeciVolts = 1, CentiVolts = 2, MilliVolts =
 
 enum BatteryAmperageUnit { Amps = 0, MilliAmps = 1 };
 
+// how the SoC of several batteries is combined
+enum class BatterySocAggregation : uint8_t { Minimum = 0, CapacityWeighted = 1 };
+
 struct BATTERY_CONFIG_T {
     bool Enabled;
     bool VerboseLogging;
     uint8_t Provider;
+    uint8_t AdditionalProviders; // bitmask of providers running alongside Provider
+    BatterySocAggregation SocAggregation;
     uint8_t JkBmsInterface;
     uint8_t JkBmsPollingInterval;
+    uint8_t JbdBmsCellVoltagesDivider;
+    uint16_t MqttFullPublishInterval;
+    float MqttDeadbandRelative;
+    uint16_t MqttCellDeadbandMilliVolt;
+    bool MqttCellVoltagesJson;
     char MqttSocTopic[MQTT_MAX_TOPIC_STRLEN + 1];
     char MqttSocJsonPath[MQTT_MAX_JSON_PATH_STRLEN + 1];
     char MqttVoltageTopic[MQTT_MAX_TOPIC_STRLEN + 1];
@@ -205,6 +297,7 @@ struct GRID_CHARGER_CONFIG_T {
     bool VerboseLogging;
     GridChargerHardwareInterface HardwareInterface;
     uint32_t CAN_Controller_Frequency;
+    uint8_t UnitCount; // PSUs sharing the CAN bus
     bool Auto_Power_Enabled;
     bool Auto_Power_BatterySoC_Limits_Enabled;
     bool Emergency_Charge_Enabled;
@@ -244,6 +337,7 @@ struct SOLAR_CHARGER_CONFIG_T {
     bool VerboseLogging;
     bool PublishUpdatesOnly;
     SolarChargerProviderType Provider;
+    uint8_t AdditionalProviders; // bitmask of providers running alongside Provider
     SolarChargerMqttConfig Mqtt;
 };
 using SolarChargerConfig = struct SOLAR_CHARGER_CONFIG_T;
@@ -266,6 +360,8 @@ struct CONFIG_T {
         bool Dhcp;
         char Hostname[WIFI_MAX_HOSTNAME_STRLEN + 1];
         uint32_t ApTimeout;
+        bool PowerSave;
+        bool Failover; // keeps WiFi connected while Ethernet is in use
     } WiFi;
 
     struct {
@@ -276,8 +372,25 @@ struct CONFIG_T {
         bool Enabled;
         char Hostname[SYSLOG_MAX_HOSTNAME_STRLEN + 1];
         uint16_t Port;
+        uint8_t Protocol; // 0: UDP, 1: TCP with octet-counting framing
     } Syslog;
 
+    struct {
+        bool Enabled;
+        char Hostname[INFLUX_MAX_HOSTNAME_STRLEN + 1];
+        uint16_t Port;
+        uint8_t Protocol; // 0: UDP, 1: HTTP POST
+        uint32_t Interval; // in s
+        char Path[INFLUX_MAX_PATH_STRLEN + 1]; // HTTP only, including the query
+        char Token[INFLUX_MAX_TOKEN_STRLEN + 1]; // HTTP only, may be empty
+    } Influx;
+
+    struct {
+        bool Enabled;
+        uint16_t Port;
+        bool WriteEnabled; // allows to change the DPL mode
+    } Modbus;
+
     struct {
         char Server[NTP_MAX_SERVER_STRLEN + 1];
         char Timezone[NTP_MAX_TIMEZONE_STRLEN + 1];
@@ -298,7 +411,11 @@ struct CONFIG_T {
         char Topic[MQTT_MAX_TOPIC_STRLEN + 1];
         bool Retain;
         uint32_t PublishInterval;
+        uint32_t PublishRefreshInterval;
+        float PublishDeadband;
+        bool InverterJsonPayload;
         bool CleanSession;
+        uint16_t OutboxLimit; // messages, 0: unlimited
 
         struct {
             char Topic[MQTT_MAX_TOPIC_STRLEN + 1];
@@ -313,14 +430,14 @@ struct CONFIG_T {
             char Topic[MQTT_MAX_TOPIC_STRLEN + 1];
             bool IndividualPanels;
             bool Expire;
+            bool DeviceDiscovery; // one discovery message per device
         } Hass;
 
         struct {
             bool Enabled;
-            char RootCaCert[MQTT_MAX_CERT_STRLEN + 1];
             bool CertLogin;
-            char ClientCert[MQTT_MAX_CERT_STRLEN + 1];
-            char ClientKey[MQTT_MAX_CERT_STRLEN + 1];
+            // the certificates are stored in files of their own, see
+            // ConfigurationClass::readCertificate()
         } Tls;
     } Mqtt;
 
@@ -336,6 +453,7 @@ struct CONFIG_T {
             uint8_t CountryMode;
         } Cmt;
         bool VerboseLogging;
+        bool LowPowerNight;
     } Dtu;
 
     struct {
@@ -369,6 +487,11 @@ struct CONFIG_T {
         PowerMeterSerialSdmConfig SerialSdm;
         PowerMeterHttpJsonConfig HttpJson;
         PowerMeterHttpSmlConfig HttpSml;
+        PowerMeterUdpSmaHmConfig UdpSmaHm;
+        PowerMeterUdpPushConfig UdpPush;
+        PowerMeterShellyRpcConfig ShellyRpc;
+        PowerMeterFusionConfig Fusion;
+        bool PredictiveFilter;
     } PowerMeter;
 
     PowerLimiterConfig PowerLimiter;
@@ -383,6 +506,21 @@ struct CONFIG_T {
 
 class ConfigurationClass {
 public:
+    enum class Section : uint8_t {
+        Network,
+        Mqtt,
+        Ntp,
+        Dtu,
+        Security,
+        Device,
+        Inverters,
+        SolarCharger,
+        PowerMeter,
+        PowerLimiter,
+        Battery,
+        GridCharger
+    };
+
     void init(Scheduler& scheduler);
     bool read();
     bool write();
@@ -390,6 +528,17 @@ public:
     void migrateOnBattery();
     CONFIG_T const& get();
 
+    // incremented whenever a changed configuration is published
+    uint32_t getGeneration() const;
+
+    // marks the section as changed. the configuration is written once no
+    // further changes were made for a little while, such that bursts of
+    // changes result in a single write to flash.
+    void scheduleWrite(Section section);
+
+    // writes pending changes immediately, e.g., before restarting.
+    void flush();
+
     class WriteGuard {
     public:
         WriteGuard();
@@ -402,10 +551,37 @@ public:
 
     WriteGuard getWriteGuard();
 
+    // these modify the master copy, so a WriteGuard must be held
     INVERTER_CONFIG_T* getFreeInverterSlot();
-    INVERTER_CONFIG_T* getInverterConfig(const uint64_t serial);
     void deleteInverterById(const uint8_t id);
 
+    INVERTER_CONFIG_T const* getInverterConfig(const uint64_t serial);
+
+    // the TLS certificates are kept out of CONFIG_T, as they are large and
+    // only needed while connecting to the MQTT broker. every copy of the
+    // configuration would carry them otherwise.
+    enum class Certificate : uint8_t {
+        RootCa,
+        Client,
+        ClientKey
+    };
+    static String readCertificate(Certificate which);
+    static bool writeCertificate(Certificate which, String const& pem);
+
+    // a binary image of CONFIG_T to provision many devices at once. it is
+    // only accepted by the very same firmware build, as the layout of
+    // CONFIG_T is not versioned. the secrets are left out unless requested,
+    // in which case the restoring device keeps its own. the identity of the
+    // restoring device (DTU serial, hostname, MQTT client ID) is kept.
+    enum class RestoreResult : uint8_t {
+        Success,
+        InvalidFormat,
+        BuildMismatch
+    };
+    static size_t getBackupSize();
+    static std::unique_ptr<uint8_t[]> exportBackup(bool includeSecrets);
+    RestoreResult restoreBackup(uint8_t const* data, size_t length);
+
     static void serializeHttpRequestConfig(HttpRequestConfig const& source, JsonObject& target);
     static void serializeSolarChargerConfig(SolarChargerConfig const& source, JsonObject& target);
     static void serializeSolarChargerMqttConfig(SolarChargerMqttConfig const& source, JsonObject& target);
@@ -413,6 +589,10 @@ public:
     static void serializePowerMeterSerialSdmConfig(PowerMeterSerialSdmConfig const& source, JsonObject& target);
     static void serializePowerMeterHttpJsonConfig(PowerMeterHttpJsonConfig const& source, JsonObject& target);
     static void serializePowerMeterHttpSmlConfig(PowerMeterHttpSmlConfig const& source, JsonObject& target);
+    static void serializePowerMeterUdpSmaHmConfig(PowerMeterUdpSmaHmConfig const& source, JsonObject& target);
+    static void serializePowerMeterUdpPushConfig(PowerMeterUdpPushConfig const& source, JsonObject& target);
+    static void serializePowerMeterShellyRpcConfig(PowerMeterShellyRpcConfig const& source, JsonObject& target);
+    static void serializePowerMeterFusionConfig(PowerMeterFusionConfig const& source, JsonObject& target);
     static void serializeBatteryConfig(BatteryConfig const& source, JsonObject& target);
     static void serializePowerLimiterConfig(PowerLimiterConfig const& source, JsonObject& target);
     static void serializeGridChargerConfig(GridChargerConfig const& source, JsonObject& target);
@@ -424,6 +604,10 @@ public:
     static void deserializePowerMeterSerialSdmConfig(JsonObject const& source, PowerMeterSerialSdmConfig& target);
     static void deserializePowerMeterHttpJsonConfig(JsonObject const& source, PowerMeterHttpJsonConfig& target);
     static void deserializePowerMeterHttpSmlConfig(JsonObject const& source, PowerMeterHttpSmlConfig& target);
+    static void deserializePowerMeterUdpSmaHmConfig(JsonObject const& source, PowerMeterUdpSmaHmConfig& target);
+    static void deserializePowerMeterUdpPushConfig(JsonObject const& source, PowerMeterUdpPushConfig& target);
+    static void deserializePowerMeterShellyRpcConfig(JsonObject const& source, PowerMeterShellyRpcConfig& target);
+    static void deserializePowerMeterFusionConfig(JsonObject const& source, PowerMeterFusionConfig& target);
     static void deserializeBatteryConfig(JsonObject const& source, BatteryConfig& target);
     static void deserializePowerLimiterConfig(JsonObject const& source, PowerLimiterConfig& target);
     static void deserializeGridChargerConfig(JsonObject const& source, GridChargerConfig& target);
@@ -432,6 +616,22 @@ private:
     void loop();
     static double roundedFloat(float val);
 
+    // binary image of CONFIG_T, written alongside the JSON file. it is used
+    // at boot to skip parsing the JSON file, as long as it was written by the
+    // same firmware build and matches the JSON file.
+    static bool readSnapshot();
+    static bool writeSnapshot(size_t jsonSize);
+
+    void writePending(bool force);
+
+    static constexpr uint32_t WRITE_QUIET_PERIOD_MS = 1000;
+    static constexpr uint32_t WRITE_MAX_DELAY_MS = 5000;
+
+    std::mutex _pendingMutex;
+    uint32_t _dirtySections = 0;
+    uint32_t _firstChangeMillis = 0;
+    uint32_t _lastChangeMillis = 0;
+
     Task _loopTask;
 };
 
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <TaskSchedulerDeclarations.h>
+#include <array>
+#include <mutex>
+#include <optional>
+#include <stdint.h>
+
+// measures how fast the DPL reacts to the grid: the time from taking the
+// power meter reading which made the DPL change the limits until the first
+// inverter acknowledged the new limit, the inter-arrival time of the power
+// meter readings and the age of the inverter stats the DPL relied on.
+// alerts are logged if the 90th percentile of a metric exceeds the
+// threshold configured in the DPL settings.
+class ControlLatencyClass {
+public:
+    ControlLatencyClass();
+    void init(Scheduler& scheduler);
+
+    enum class Metric : uint8_t {
+        Reaction, // meter reading taken until the first limit acknowledgment
+        Decision, // meter reading taken until the DPL sent new limits
+        MeterInterval, // time between two power meter readings
+        StatsAge, // age of the inverter stats when the DPL calculated
+        Count
+    };
+    static constexpr size_t MetricCount = static_cast<size_t>(Metric::Count);
+
+    // snake case name, as used by the web API, MQTT and Prometheus
+    static char const* getName(Metric metric);
+
+    struct Summary {
+        uint32_t Count; // samples since boot
+        uint16_t Samples; // samples the percentiles are based on
+        uint32_t P50;
+        uint32_t P90;
+        uint32_t P99;
+        uint32_t Max;
+        bool Alert;
+    };
+    Summary getSummary(Metric metric) const;
+
+    // the number and the sum of all samples since boot, of which the mean
+    // of any period can be derived by taking the difference
+    struct Total {
+        uint32_t Count;
+        uint64_t Millis;
+    };
+    Total getTotal(Metric metric) const;
+
+    // smoothed difference of successive inter-arrival times (RFC 3550)
+    uint32_t getMeterJitter() const;
+
+    // to be called by the DPL after each calculation. the measurement time
+    // of the power meter reading is unset when no reading was used, e.g.,
+    // for a follower of a cluster, and the stats age is unset if no stats
+    // were waited for.
+    void recordCalculation(std::optional<uint32_t> meterMeasuredMillis,
+            std::optional<uint32_t> statsAgeMillis, bool limitsUpdated);
+
+    // to be called by the DPL when an inverter acknowledged a limit which
+    // was sent due to the last calculation
+    void recordAcknowledgment(uint32_t ackMillis);
+
+private:
+    void loop();
+    void publishLoop();
+    void onMeterReading();
+    void add(Metric metric, uint32_t millis);
+    uint32_t getThreshold(Metric metric) const;
+
+    // the most recent samples of a metric, of which the percentiles are
+    // calculated. durations saturate at UINT16_MAX.
+    struct Series {
+        static constexpr size_t Capacity = 128;
+        std::array<uint16_t, Capacity> Values;
+        uint16_t Size = 0;
+        uint16_t Next = 0;
+        uint32_t Count = 0;
+        uint64_t Total = 0;
+        bool Alert = false;
+    };
+
+    Task _loopTask;
+    Task _publishTask;
+
+    // thread-safe, as the power meter readings arrive in other tasks
+    mutable std::mutex _mutex;
+    std::array<Series, MetricCount> _series;
+
+    uint32_t _lastMeterArrival = 0;
+    std::optional<uint32_t> _oLastMeterInterval;
+    float _meterJitter = 0;
+
+    // the calculation whose limits are not acknowledged by any inverter yet
+    std::optional<uint32_t> _oPendingMeasuredMillis;
+};
+
+extern ControlLatencyClass ControlLatency;
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+// fans out the arrival of new data to the components which consume it,
+// such that they can react right away instead of polling the producers on
+// their own timers. a topic only tells that new data is available, the
+// data itself is still read from the producer, e.g., Battery.getStats().
+//
+// subscribers are invoked synchronously in the context of the publisher,
+// which is the scheduler for the inverter statistics and the DPL, but a
+// task of its own for most power meters and some batteries. the callbacks
+// must hence be short and thread-safe, like setting an atomic flag, unless
+// the subscriber knows the publisher runs on the scheduler as well.
+class DataBusClass {
+public:
+    enum class Topic : uint8_t {
+        InverterStats, // a Hoymiles inverter's statistics were updated
+        Battery, // the battery stats were updated
+        SolarCharger, // the solar charger stats were updated
+        PowerMeter, // a power meter took a new reading
+        DplDecision, // the DPL sent new limits to the inverters
+        Count
+    };
+
+    using Callback = std::function<void()>;
+
+    void init();
+
+    // thread-safe. returns false if the topic has no free slot left.
+    // subscriptions are permanent, as the subscribers are singletons.
+    bool subscribe(Topic topic, Callback callback);
+
+    // thread-safe, lock-free
+    void publish(Topic topic);
+
+    // increments with every publication on the topic, such that a consumer
+    // which runs on its own timer anyways can tell whether it missed any
+    // data. starts at zero.
+    uint32_t getSequence(Topic topic) const;
+
+private:
+    static constexpr size_t MaxSubscribers = 6;
+
+    struct Subscribers {
+        // slots [0, Count) are readable without locking, as a slot is
+        // written once before Count is incremented past it.
+        std::array<Callback, MaxSubscribers> Callbacks;
+        std::atomic<uint8_t> Count = 0;
+        std::atomic<uint32_t> Sequence = 0;
+    };
+
+    std::array<Subscribers, static_cast<size_t>(Topic::Count)> _topics;
+
+    // serializes subscribers, publishers never take it
+    std::mutex _subscribeMutex;
+};
+
+extern DataBusClass DataBus;
@@ -1,44 +1,85 @@
 #pragma once
 
 #include <Arduino.h>
-#include <map>
+#include <array>
+#include <bitset>
 #include <optional>
 #include <string>
-#include <unordered_map>
+#include <type_traits>
+#include <utility>
 #include <variant>
 #include <limits>
 #include <algorithm>
 
-using tCellVoltages = std::map<uint8_t, uint16_t>;
+// the voltages of a battery's cells in millivolts, numbered from one in the
+// order reported by the BMS. minimum, maximum and sum are updated as cells
+// are added, such that consumers need not iterate the cells.
+class tCellVoltages {
+    public:
+        static constexpr size_t MaxCells = 32;
+
+        // returns false and drops the voltage if the capacity is exhausted
+        bool add(uint16_t milliVolt) {
+            if (_count >= MaxCells) { return false; }
+
+            if (_count == 0 || milliVolt < _milliVolts[_minIdx]) { _minIdx = _count; }
+            if (_count == 0 || milliVolt > _milliVolts[_maxIdx]) { _maxIdx = _count; }
+            _milliVolts[_count++] = milliVolt;
+            _sum += milliVolt;
+            return true;
+        }
+
+        size_t size() const { return _count; }
+        bool empty() const { return _count == 0; }
+        uint16_t const* begin() const { return _milliVolts.data(); }
+        uint16_t const* end() const { return _milliVolts.data() + _count; }
+
+        // all of these are zero if there are no cells
+        uint16_t getMinMilliVolt() const { return empty() ? 0 : _milliVolts[_minIdx]; }
+        uint16_t getMaxMilliVolt() const { return empty() ? 0 : _milliVolts[_maxIdx]; }
+        uint16_t getAvgMilliVolt() const { return empty() ? 0 : (_sum + _count / 2) / _count; }
+        uint16_t getDiffMilliVolt() const { return getMaxMilliVolt() - getMinMilliVolt(); }
+        uint8_t getMinCell() const { return empty() ? 0 : _minIdx + 1; }
+        uint8_t getMaxCell() const { return empty() ? 0 : _maxIdx + 1; }
+
+        bool operator==(tCellVoltages const& other) const {
+            return _count == other._count && std::equal(begin(), end(), other.begin());
+        }
+
+    private:
+        std::array<uint16_t, MaxCells> _milliVolts = {};
+        uint32_t _sum = 0;
+        uint8_t _count = 0;
+        uint8_t _minIdx = 0;
+        uint8_t _maxIdx = 0;
+};
+
+template<typename T> std::string dataPointValueToStr(T const& v);
 
 template<typename... V>
 class DataPoint {
-    template<typename, typename L, template<L> class>
+    template<typename, typename L, template<L> class, L, L>
     friend class DataPointContainer;
 
     public:
         using tValue = std::variant<V...>;
 
-        DataPoint() = delete;
-
-        DataPoint(DataPoint const& other)
-            : _strLabel(other._strLabel)
-            , _strValue(other._strValue)
-            , _strUnit(other._strUnit)
-            , _value(other._value)
-            , _timestamp(other._timestamp) { }
-
-        DataPoint(std::string const& strLabel, std::string const& strValue,
-                std::string const& strUnit, tValue value, uint32_t timestamp)
-            : _strLabel(strLabel)
-            , _strValue(strValue)
-            , _strUnit(strUnit)
-            , _value(std::move(value))
-            , _timestamp(timestamp) { }
-
-        std::string const& getLabelText() const { return _strLabel; }
-        std::string const& getValueText() const { return _strValue; }
-        std::string const& getUnitText() const { return _strUnit; }
+        // the value text is only produced when asked for
+        std::string getValueText() const {
+            return std::visit([](auto const& v) { return dataPointValueToStr(v); }, _value);
+        }
+
+        // nullopt if the value is not a number
+        std::optional<float> getValueNumber() const {
+            return std::visit([](auto const& v) -> std::optional<float> {
+                if constexpr (std::is_arithmetic_v<std::decay_t<decltype(v)>>) {
+                    return static_cast<float>(v);
+                } else {
+                    return std::nullopt;
+                }
+            }, _value);
+        }
+
         uint32_t getTimestamp() const { return _timestamp; }
 
         bool operator==(DataPoint const& other) const {
@@ -46,32 +87,79 @@ class DataPoint {
         }
 
     private:
-        std::string _strLabel;
-        std::string _strValue;
-        std::string _strUnit;
         tValue _value;
-        uint32_t _timestamp;
+        uint32_t _timestamp = 0;
 };
 
-template<typename T> std::string dataPointValueToStr(T const& v);
-
-template<typename DataPoint, typename Label, template<Label> class Traits>
+namespace DataPointLabelTexts {
+
+template<typename Label, template<Label> class Traits, Label L, typename = void>
+struct HasTraits : std::false_type { };
+
+template<typename Label, template<Label> class Traits, Label L>
+struct HasTraits<Label, Traits, L, std::void_t<decltype(sizeof(Traits<L>))>> : std::true_type { };
+
+template<typename Label, template<Label> class Traits, Label L>
+constexpr char const* name() {
+    if constexpr (HasTraits<Label, Traits, L>::value) { return Traits<L>::name; }
+    else { return nullptr; }
+}
+
+template<typename Label, template<Label> class Traits, Label L>
+constexpr char const* unit() {
+    if constexpr (HasTraits<Label, Traits, L>::value) { return Traits<L>::unit; }
+    else { return nullptr; }
+}
+
+template<typename Label>
+constexpr Label offset(Label first, size_t idx) {
+    return static_cast<Label>(static_cast<std::underlying_type_t<Label>>(first) + idx);
+}
+
+template<typename Label, template<Label> class Traits, Label First, size_t... I>
+constexpr std::array<char const*, sizeof...(I)> makeNames(std::index_sequence<I...>) {
+    return {{ name<Label, Traits, offset(First, I)>()... }};
+}
+
+template<typename Label, template<Label> class Traits, Label First, size_t... I>
+constexpr std::array<char const*, sizeof...(I)> makeUnits(std::index_sequence<I...>) {
+    return {{ unit<Label, Traits, offset(First, I)>()... }};
+}
+
+} // namespace DataPointLabelTexts
+
+/**
+ * stores the data points in a flat array indexed by label. the labels in
+ * [First, Last] which have traits make up the set of data points, label and
+ * unit texts are taken from the traits. slots of labels without traits are
+ * never used.
+ */
+template<typename DataPoint, typename Label, template<Label> class Traits, Label First, Label Last>
 class DataPointContainer {
+    using tIndex = std::underlying_type_t<Label>;
+    static constexpr size_t Size = static_cast<tIndex>(Last) - static_cast<tIndex>(First) + 1;
+
+    template<Label L>
+    static constexpr size_t indexOf() {
+        static_assert(static_cast<tIndex>(L) >= static_cast<tIndex>(First) &&
+                static_cast<tIndex>(L) <= static_cast<tIndex>(Last), "label out of range");
+        return static_cast<tIndex>(L) - static_cast<tIndex>(First);
+    }
+
+    static constexpr std::array<char const*, Size> _names =
+        DataPointLabelTexts::makeNames<Label, Traits, First>(std::make_index_sequence<Size>{});
+    static constexpr std::array<char const*, Size> _units =
+        DataPointLabelTexts::makeUnits<Label, Traits, First>(std::make_index_sequence<Size>{});
+
     public:
         DataPointContainer() = default;
 
         template<Label L>
         void add(typename Traits<L>::type val) {
-            _dataPoints.emplace(
-                    L,
-                    DataPoint(
-                        Traits<L>::name,
-                        dataPointValueToStr(val),
-                        Traits<L>::unit,
-                        typename DataPoint::tValue(std::move(val)),
-                        millis()
-                    )
-            );
+            auto& dataPoint = _dataPoints[indexOf<L>()];
+            dataPoint._value.template emplace<typename Traits<L>::type>(std::move(val));
+            dataPoint._timestamp = millis();
+            _valid.set(indexOf<L>());
         }
 
         // make sure add() is only called with the type expected for the
@@ -79,38 +167,49 @@ class DataPointContainer {
         template<Label L, typename T>
         void add(T) = delete;
 
+        // returns nullptr if the container holds no value for this label
         template<Label L>
-        std::optional<DataPoint const> getDataPointFor() const {
-            auto it = _dataPoints.find(L);
-            if (it == _dataPoints.end()) { return std::nullopt; }
-            return it->second;
+        DataPoint const* getDataPointFor() const {
+            if (!_valid.test(indexOf<L>())) { return nullptr; }
+            return &_dataPoints[indexOf<L>()];
         }
 
         template<Label L>
         std::optional<typename Traits<L>::type> get() const {
-            auto optionalDataPoint = getDataPointFor<L>();
-            if (!optionalDataPoint.has_value()) { return std::nullopt; }
-            return std::get<typename Traits<L>::type>(optionalDataPoint->_value);
+            auto pDataPoint = getDataPointFor<L>();
+            if (!pDataPoint) { return std::nullopt; }
+            return std::get<typename Traits<L>::type>(pDataPoint->_value);
+        }
+
+        static char const* getLabelText(Label label) { return _names[static_cast<tIndex>(label) - static_cast<tIndex>(First)]; }
+        static char const* getUnitText(Label label) { return _units[static_cast<tIndex>(label) - static_cast<tIndex>(First)]; }
+
+        // calls the callback with the label and the data point of each
+        // label the container holds a value for, in order of their labels.
+        template<typename F>
+        void forEach(F&& callback) const {
+            for (size_t idx = 0; idx < Size; ++idx) {
+                if (!_valid.test(idx)) { continue; }
+                callback(DataPointLabelTexts::offset(First, idx), _dataPoints[idx]);
+            }
         }
 
-        using tMap = std::unordered_map<Label, DataPoint const>;
-        typename tMap::const_iterator cbegin() const { return _dataPoints.cbegin(); }
-        typename tMap::const_iterator cend() const { return _dataPoints.cend(); }
+        // drops all data points. the storage is kept, such that the
+        // container can be refilled without allocations.
+        void clear() { _valid.reset(); }
 
         // copy all data points from source into this instance, overwriting
         // existing data points in this instance.
         void updateFrom(DataPointContainer const& source)
         {
-            for (auto iter = source.cbegin(); iter != source.cend(); ++iter) {
-                auto pos = _dataPoints.find(iter->first);
+            for (size_t idx = 0; idx < Size; ++idx) {
+                if (!source._valid.test(idx)) { continue; }
 
-                if (pos != _dataPoints.end()) {
-                    // do not update existing data points with the same value
-                    if (pos->second == iter->second) { continue; }
+                // do not update existing data points with the same value
+                if (_valid.test(idx) && _dataPoints[idx] == source._dataPoints[idx]) { continue; }
 
-                    _dataPoints.erase(pos);
-                }
-                _dataPoints.insert(*iter);
+                _dataPoints[idx] = source._dataPoints[idx];
+                _valid.set(idx);
             }
         }
 
@@ -118,12 +217,14 @@ class DataPointContainer {
         {
             uint32_t now = millis();
             uint32_t diff = std::numeric_limits<uint32_t>::max()/2;
-            for (auto iter = _dataPoints.cbegin(); iter != _dataPoints.cend(); ++iter) {
-                diff = std::min(diff, now - iter->second.getTimestamp());
+            for (size_t idx = 0; idx < Size; ++idx) {
+                if (!_valid.test(idx)) { continue; }
+                diff = std::min(diff, now - _dataPoints[idx].getTimestamp());
             }
             return now - diff;
         }
 
     private:
-        tMap _dataPoints;
+        std::array<DataPoint, Size> _dataPoints;
+        std::bitset<Size> _valid;
 };
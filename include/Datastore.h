@@ -1,8 +1,10 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "Configuration.h"
 #include <TaskSchedulerDeclarations.h>
-#include <mutex>
+#include <array>
+#include <atomic>
 
 class DatastoreClass {
 public:
@@ -62,24 +64,52 @@ private:
 
     Task _loopTask;
 
-    std::mutex _mutex;
-
-    float _totalAcYieldTotalEnabled = 0;
-    float _totalAcYieldDayEnabled = 0;
-    float _totalAcPowerEnabled = 0;
-    float _totalDcPowerEnabled = 0;
-    float _totalDcPowerIrradiation = 0;
-    float _totalDcIrradiationInstalled = 0;
-    float _totalDcIrradiation = 0;
-    uint32_t _totalAcYieldTotalDigits = 0;
-    uint32_t _totalAcYieldDayDigits = 0;
-    uint32_t _totalAcPowerDigits = 0;
-    uint32_t _totalDcPowerDigits = 0;
-    bool _isAtLeastOneReachable = false;
-    bool _isAtLeastOneProducing = false;
-    bool _isAllEnabledProducing = false;
-    bool _isAllEnabledReachable = false;
-    bool _isAtLeastOnePollEnabled = false;
+    // the share of a single inverter in the totals
+    struct Contribution {
+        float AcYieldTotal = 0;
+        float AcYieldDay = 0;
+        float AcPower = 0;
+        float DcPower = 0;
+        float DcPowerIrradiation = 0;
+        float DcIrradiationInstalled = 0;
+        uint32_t AcYieldTotalDigits = 0;
+        uint32_t AcYieldDayDigits = 0;
+        uint32_t AcPowerDigits = 0;
+        uint32_t DcPowerDigits = 0;
+    };
+
+    // what the contribution of an inverter was computed from. the
+    // contribution is only recomputed if any of these changed.
+    struct InverterState {
+        uint64_t Serial = 0;
+        uint32_t LastUpdate = 0;
+        bool PollEnabled = false;
+        bool ConfigPollEnabled = false;
+        float StringMaxPower = 0;
+        Contribution Share;
+    };
+
+    std::array<InverterState, INV_MAX_COUNT> _inverterStates;
+
+    struct Totals {
+        Contribution Sum;
+        float DcIrradiation = 0;
+        bool IsAtLeastOneReachable = false;
+        bool IsAtLeastOneProducing = false;
+        bool IsAllEnabledProducing = false;
+        bool IsAllEnabledReachable = false;
+        bool IsAtLeastOnePollEnabled = false;
+    };
+
+    // the totals are published through a seqlock with two slots: the loop
+    // fills the slot not indicated by the sequence number and then
+    // increments it. readers never block and retry their copy if the
+    // sequence number changed while they were copying.
+    std::array<Totals, 2> _totals;
+    std::atomic<uint32_t> _totalsSeq = 0;
+
+    void publish(Totals const& totals);
+    Totals getTotals() const;
 };
 
 extern DatastoreClass Datastore;
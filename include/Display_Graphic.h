@@ -5,6 +5,9 @@
 #include "defaults.h"
 #include <TaskSchedulerDeclarations.h>
 #include <U8g2lib.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
 
 #define CHART_HEIGHT 20 // chart area hight in pixels
 #define CHART_WIDTH 47 // chart area width in pixels
@@ -51,6 +54,10 @@ public:
 
 private:
     void loop();
+    void readLangPack();
+    static void sendTaskHelper(void* context);
+    void sendLoop();
+    void sendChangedTiles();
     void printText(const char* text, const uint8_t line);
     void calcLineHeights();
     void setFont(const uint8_t line);
@@ -59,6 +66,18 @@ private:
     Task _loopTask;
 
     U8G2* _display;
+
+    // the frame is rendered by the loop task, but sent to the display by a
+    // task of low priority, as transfers via I2C take tens of milliseconds.
+    // the mutex guards the frame buffer and the display itself. only the
+    // tiles which changed since the last transfer are sent, based on a copy
+    // of the frame as it was sent last.
+    TaskHandle_t _sendTaskHandle = nullptr;
+    std::mutex _displayMutex;
+    std::vector<uint8_t> _sentFrame;
+    bool _sendAllTiles = true;
+    std::atomic<bool> _powerSave = false;
+    bool _powerSaveSent = false;
     DisplayGraphicDiagramClass _diagram;
 
     bool _displayTurnedOn;
@@ -66,6 +85,10 @@ private:
     DisplayType_t _display_type = DisplayType_t::None;
     DiagramMode_t _diagram_mode = DiagramMode_t::Off;
     String _display_language = DISPLAY_LOCALE;
+
+    // the strings of an uploaded language pack are read when drawing the
+    // next frame, i.e., only if a display is actually used
+    std::atomic<bool> _langPackPending = false;
     uint8_t _mExtra;
     const uint16_t _period = 1000;
     const uint16_t _interval = 60000; // interval at which to power save (milliseconds)
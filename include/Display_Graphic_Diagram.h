@@ -3,6 +3,7 @@
 
 #include <TaskSchedulerDeclarations.h>
 #include <U8g2lib.h>
+#include <algorithm>
 #include <array>
 
 #define MAX_DATAPOINTS 128
@@ -20,17 +21,43 @@ private:
     void averageLoop();
     void dataPointLoop();
 
-    uint32_t getSecondsPerDot();
+    void updateMaximum();
+
+    // calls f(pos, n) for the contiguous ranges of the ring buffer which
+    // hold count data points, starting at the idx-th oldest one
+    template<typename F>
+    void forEachRange(size_t idx, size_t count, F const& f) const
+    {
+        size_t pos = (_head + idx) % _capacity;
+        size_t first = std::min(count, _capacity - pos);
+        f(pos, first);
+        if (count > first) { f(0, count - first); }
+    }
 
     Task _averageTask;
     Task _dataPointTask;
 
     U8G2* _display = nullptr;
-    std::array<float, MAX_DATAPOINTS> _graphValues = {};
-    uint8_t _graphValuesCount = 0;
-
-    uint8_t _chartWidth = MAX_DATAPOINTS;
 
-    float _iRunningAverage = 0;
-    uint16_t _iRunningAverageCnt = 0;
+    // ring buffer of data points covering the configured diagram duration.
+    // with PSRAM, the duration is split into more data points, which are
+    // combined per pixel column when drawing. the minimum, maximum and
+    // average of the samples of a data point, in watts, are kept in separate
+    // arrays, such that the values of a column are reduced in tight loops.
+    uint16_t* _mins = nullptr;
+    uint16_t* _maxs = nullptr;
+    uint16_t* _avgs = nullptr;
+    size_t _capacity = 0;
+    size_t _head = 0; // index of the oldest data point
+    size_t _count = 0;
+
+    // the largest value of all data points, such that the diagram is
+    // scaled without looking at all of them.
+    uint16_t _maxWatts = 0;
+
+    // the samples of the data point which is currently collected
+    uint32_t _sampleSum = 0;
+    uint16_t _sampleCount = 0;
+    uint16_t _sampleMin = UINT16_MAX;
+    uint16_t _sampleMax = 0;
 };
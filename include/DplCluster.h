@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <TaskSchedulerDeclarations.h>
+#include <WiFiUdp.h>
+#include <array>
+#include <cstdint>
+#include <optional>
+
+// coordinates the DPLs of several DTUs sharing one grid meter, such that
+// only one control loop acts on the meter. the leader holds the meter and
+// announces itself by broadcast. each follower reports the output and the
+// headroom of its governed inverters to the leader, which accounts for the
+// followers' output like for inverters behind the power meter and assigns
+// each follower a share of the power its own inverters do not cover. the
+// follower's DPL distributes this setpoint among its inverters instead of
+// reading a meter.
+//
+// setpoints carry a sequence number and are repeated until a report
+// acknowledges them. a follower which loses its leader falls back to zero
+// output, a follower which stops reporting is no longer assigned power.
+class DplClusterClass {
+public:
+    enum class Role : uint8_t {
+        Standalone = 0,
+        Leader = 1,
+        Follower = 2
+    };
+
+    DplClusterClass();
+    void init(Scheduler& scheduler);
+
+    bool isLeader() const { return _role == Role::Leader; }
+    bool isFollower() const { return _role == Role::Follower; }
+
+    // leader: the AC power the followers reported to produce
+    uint16_t getFollowersOutputWatts() const;
+
+    // leader: like PowerLimiterInverter::getSettledMillis(), the time the
+    // last follower settled on its current setpoint (zero if there are no
+    // followers), or std::nullopt while a follower is still adjusting.
+    std::optional<uint32_t> getSettledMillis() const;
+
+    // leader: assigns the requested power to the followers in proportion to
+    // their capacity. returns the power they are expected to produce.
+    uint16_t distribute(uint16_t powerRequested);
+
+    // follower: the power assigned by the leader, zero if the leader was
+    // lost. the setpoint is considered applied once it was retrieved.
+    uint16_t getSetpoint();
+
+    // follower: the time the setpoint last changed
+    uint32_t getSetpointMillis() const { return _setpointMillis; }
+
+    size_t getNodeCount() const;
+
+private:
+    void loop();
+    void updateSettings();
+    void receive();
+    void onBeacon(IPAddress const& address, uint16_t port);
+    void onReport(IPAddress const& address, uint16_t port, uint8_t const* payload);
+    void onSetpoint(IPAddress const& address, uint16_t port, uint8_t const* payload);
+    void sendBeacon();
+    void sendReport();
+    void sendSetpoints();
+    void send(IPAddress const& address, uint16_t port, uint8_t type, uint8_t const* payload, size_t length);
+
+    static constexpr uint8_t MaxNodes = 8;
+    static constexpr uint32_t BeaconIntervalMillis = 1000;
+    static constexpr uint32_t ReportIntervalMillis = 500;
+    static constexpr uint32_t RetransmitMillis = 100;
+    static constexpr uint32_t TimeoutMillis = 3000;
+    // a follower whose DPL is stuck does not hold up the leader for longer
+    static constexpr uint32_t SettleTimeoutMillis = 10000;
+
+    Task _loopTask;
+    uint32_t _configGeneration = 0;
+
+    Role _role = Role::Standalone;
+    uint8_t _clusterId = 0;
+    uint16_t _port = 0;
+    WiFiUDP _udp;
+    uint32_t _lastBeacon = 0;
+    uint32_t _lastReport = 0;
+
+    // leader: the followers, identified by their address
+    struct Node {
+        IPAddress Address;
+        uint16_t Port;
+        uint32_t LastSeen;
+        uint16_t OutputWatts;
+        uint16_t CapacityWatts;
+        bool Settled;
+        uint32_t SettledMillis;
+        uint32_t ReceivedSequence;
+        uint32_t AppliedSequence;
+        uint16_t SetpointWatts;
+        uint32_t SetpointSequence;
+        uint32_t SetpointMillis;
+        uint32_t LastSent;
+    };
+    std::array<std::optional<Node>, MaxNodes> _nodes;
+    uint32_t _sequence = 0;
+
+    // follower: the leader and its latest setpoint
+    IPAddress _leaderAddress;
+    uint16_t _leaderPort = 0;
+    uint32_t _leaderSeen = 0;
+    bool _leaderLost = true;
+    uint16_t _setpoint = 0;
+    uint32_t _setpointMillis = 0;
+    uint32_t _receivedSequence = 0;
+    uint32_t _appliedSequence = 0;
+    uint32_t _reportedSequence = 0;
+    bool _reportedSettled = false;
+};
+
+extern DplClusterClass DplCluster;
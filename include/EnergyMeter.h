@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <TaskSchedulerDeclarations.h>
+#include <array>
+#include <mutex>
+
+// integrates the power flows of the system into energy counters, such that
+// consumers need not receive every power sample to compute energy figures.
+// each new sample of a source is integrated using the trapezoidal rule.
+// counters for the current day and totals are persisted to flash using
+// the state store.
+class EnergyMeterClass {
+public:
+    enum class Flow : uint8_t {
+        GridImport,
+        GridExport,
+        BatteryCharge,
+        BatteryDischarge,
+        SolarCharger, // output of the solar charge controllers
+        Inverters // AC output of all inverters with polling enabled
+    };
+    static constexpr size_t FLOW_COUNT = static_cast<size_t>(Flow::Inverters) + 1;
+
+    EnergyMeterClass();
+    void init(Scheduler& scheduler);
+
+    // in Wh
+    double getToday(Flow flow) const;
+    double getTotal(Flow flow) const;
+
+    static char const* getName(Flow flow);
+
+    // hands the counters to the state store if they changed, e.g., before
+    // restarting, which is to be flushed afterwards
+    void flush();
+
+private:
+    void loop();
+    void publishLoop();
+
+    // integrates a signed power, positive values are added to one counter
+    // and negative values to the other one.
+    class Integrator {
+    public:
+        void add(uint32_t timestamp, float watts, double& positiveWh, double& negativeWh);
+        void reset() { _valid = false; }
+
+    private:
+        bool _valid = false;
+        uint32_t _lastMillis = 0;
+        float _lastWatts = 0;
+    };
+
+    void add(Integrator& integrator, float watts, Flow positive, Flow negative);
+    void rollover(uint32_t day);
+
+    bool restore();
+    bool restoreLegacy();
+    void persist();
+
+    // samples further apart than this are not connected
+    static constexpr uint32_t MAX_GAP_MILLIS = 60 * 1000;
+
+    // the counters are handed to the state store, which bounds the rate
+    // at which they are written to flash
+    struct Snapshot {
+        uint32_t Day; // local date as yyyymmdd, 0 if unknown
+        double Today[FLOW_COUNT];
+        double Total[FLOW_COUNT];
+    };
+
+    // records were written to these slot files in turn before the counters
+    // were persisted using the state store. they are read once to migrate.
+    static constexpr uint8_t PERSIST_SLOTS = 4;
+
+    struct Record {
+        uint32_t Magic;
+        uint32_t Sequence;
+        uint32_t Day; // local date as yyyymmdd, 0 if unknown
+        double Today[FLOW_COUNT];
+        double Total[FLOW_COUNT];
+        uint32_t Crc;
+    };
+
+    Task _loopTask;
+    Task _publishTask;
+
+    mutable std::mutex _mutex;
+    std::array<double, FLOW_COUNT> _today = {};
+    std::array<double, FLOW_COUNT> _total = {};
+    uint32_t _day = 0;
+    bool _dirty = false;
+
+    Integrator _grid;
+    Integrator _battery;
+    Integrator _solarCharger;
+    Integrator _inverters;
+
+    // see DataBusClass::getSequence()
+    uint32_t _lastPowerMeterSequence = 0;
+    uint32_t _lastBatterySequence = 0;
+};
+
+extern EnergyMeterClass EnergyMeter;
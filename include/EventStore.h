@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <TaskSchedulerDeclarations.h>
+#include <array>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// an append-only history of events on LittleFS, which outlives the alarm
+// log buffer of the inverters and restarts of the DTU. the alarms of the
+// inverters are taken over whenever their alarm log was fetched, and only
+// new entries or entries which ended meanwhile are appended. the DPL, the
+// battery and the grid charger add events of their own.
+//
+// the events are stored in one file per day (UTC) of their start, which
+// serves as index for queries by time range. files older than the
+// retention period are removed.
+class EventStoreClass {
+public:
+    enum class Source : uint8_t {
+        InverterAlarm, // the code is the message id of the alarm
+        PowerLimiter, // the code is the DPL status (PowerLimiterClass::Status)
+        Battery, // the code is a Code
+        GridCharger // the code is a Code
+    };
+
+    enum class Code : uint16_t {
+        DataLost = 1, // no data received for DATA_TIMEOUT_S
+        DataRestored = 2
+    };
+
+    struct __attribute__((packed)) Record {
+        uint64_t Serial; // of the inverter, zero for other sources
+        uint32_t Start; // unix timestamp
+        uint32_t End; // unix timestamp, zero while ongoing or if instant
+        uint16_t Code;
+        Source Origin;
+        uint8_t Reserved;
+    };
+
+    EventStoreClass();
+    void init(Scheduler& scheduler);
+
+    // thread-safe. the event is stored with the current time, if the time
+    // is synchronized, by the next run of the store's task.
+    void add(Source source, uint16_t code);
+
+    // calls the callback for at most maxRecords events which started within
+    // [from, to], of the given inverter unless serial is zero, ordered by
+    // their start. an event which was stored again because it ended is
+    // passed once, with its end. returns the amount of events passed to
+    // the callback.
+    using RecordCallback = std::function<void(Record const& record)>;
+    size_t query(uint32_t from, uint32_t to, uint64_t serial,
+        size_t maxRecords, RecordCallback const& callback);
+
+private:
+    void loop();
+    void takeInverterAlarms();
+    void watchDataAge(Source source, bool enabled, uint32_t lastUpdate, bool& lost);
+    void append(Record const& record);
+    void restore();
+    bool isKnown(Record const& record) const;
+    void remember(Record const& record);
+
+    static String getFilename(uint16_t day);
+
+    static constexpr uint16_t RETENTION_DAYS = 31;
+    static constexpr uint32_t DATA_TIMEOUT_S = 60;
+
+    // the keys of the inverter alarms stored last, to skip alarms which
+    // are fetched again. covers the alarm logs of all inverters twice.
+    static constexpr size_t KNOWN_ALARMS = 2 * 10 * 15;
+
+    Task _loopTask;
+
+    std::mutex _mutex;
+    std::vector<uint16_t> _days; // which have a file, ascending
+    std::vector<Record> _pending;
+
+    std::array<Record, KNOWN_ALARMS> _known;
+    size_t _knownCount = 0;
+    size_t _knownNext = 0;
+
+    // the last alarm log update seen per inverter position
+    std::vector<uint32_t> _alarmLogUpdates;
+
+    bool _batteryDataLost = false;
+    bool _gridChargerDataLost = false;
+};
+
+extern EventStoreClass EventStore;
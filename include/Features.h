@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Configuration.h>
+#include <powermeter/Provider.h>
+
+// build-time feature flags. every provider is compiled in unless its flag is
+// set to 0 using the build_flags, e.g., -DFEATURE_BATTERY_JKBMS=0. the
+// sources of a disabled provider may then be excluded using build_src_filter,
+// see the lean environments in platformio.ini.
+
+#ifndef FEATURE_BATTERY_PYLONTECH
+#define FEATURE_BATTERY_PYLONTECH 1
+#endif
+#ifndef FEATURE_BATTERY_JKBMS
+#define FEATURE_BATTERY_JKBMS 1
+#endif
+#ifndef FEATURE_BATTERY_MQTT
+#define FEATURE_BATTERY_MQTT 1
+#endif
+#ifndef FEATURE_BATTERY_SMARTSHUNT
+#define FEATURE_BATTERY_SMARTSHUNT 1
+#endif
+#ifndef FEATURE_BATTERY_PYTES
+#define FEATURE_BATTERY_PYTES 1
+#endif
+#ifndef FEATURE_BATTERY_SBS
+#define FEATURE_BATTERY_SBS 1
+#endif
+#ifndef FEATURE_BATTERY_JBDBMS
+#define FEATURE_BATTERY_JBDBMS 1
+#endif
+
+#ifndef FEATURE_POWERMETER_MQTT
+#define FEATURE_POWERMETER_MQTT 1
+#endif
+#ifndef FEATURE_POWERMETER_SDM
+#define FEATURE_POWERMETER_SDM 1
+#endif
+#ifndef FEATURE_POWERMETER_HTTP_JSON
+#define FEATURE_POWERMETER_HTTP_JSON 1
+#endif
+#ifndef FEATURE_POWERMETER_SERIAL_SML
+#define FEATURE_POWERMETER_SERIAL_SML 1
+#endif
+#ifndef FEATURE_POWERMETER_SMAHM
+#define FEATURE_POWERMETER_SMAHM 1
+#endif
+#ifndef FEATURE_POWERMETER_HTTP_SML
+#define FEATURE_POWERMETER_HTTP_SML 1
+#endif
+#ifndef FEATURE_POWERMETER_UDP_PUSH
+#define FEATURE_POWERMETER_UDP_PUSH 1
+#endif
+#ifndef FEATURE_POWERMETER_SHELLY_RPC
+#define FEATURE_POWERMETER_SHELLY_RPC 1
+#endif
+
+#ifndef FEATURE_SOLARCHARGER_VEDIRECT
+#define FEATURE_SOLARCHARGER_VEDIRECT 1
+#endif
+#ifndef FEATURE_SOLARCHARGER_MQTT
+#define FEATURE_SOLARCHARGER_MQTT 1
+#endif
+
+#ifndef FEATURE_HUAWEI_MCP2515
+#define FEATURE_HUAWEI_MCP2515 1
+#endif
+#ifndef FEATURE_HUAWEI_TWAI
+#define FEATURE_HUAWEI_TWAI 1
+#endif
+
+// used by the controllers and the web API, such that a provider which was
+// compiled out can neither be selected nor is instantiated.
+namespace Features {
+
+constexpr bool isBatteryProviderAvailable(uint8_t provider)
+{
+    switch (provider) {
+        case 0: return FEATURE_BATTERY_PYLONTECH;
+        case 1: return FEATURE_BATTERY_JKBMS;
+        case 2: return FEATURE_BATTERY_MQTT;
+        case 3: return FEATURE_BATTERY_SMARTSHUNT;
+        case 4: return FEATURE_BATTERY_PYTES;
+        case 5: return FEATURE_BATTERY_SBS;
+        case 6: return FEATURE_BATTERY_JBDBMS;
+    }
+    return false;
+}
+constexpr uint8_t BatteryProviderCount = 7;
+
+constexpr bool isPowerMeterProviderAvailable(PowerMeters::Provider::Type type)
+{
+    using Type = PowerMeters::Provider::Type;
+    switch (type) {
+        case Type::MQTT: return FEATURE_POWERMETER_MQTT;
+        case Type::SDM1PH: return FEATURE_POWERMETER_SDM;
+        case Type::SDM3PH: return FEATURE_POWERMETER_SDM;
+        case Type::HTTP_JSON: return FEATURE_POWERMETER_HTTP_JSON;
+        case Type::SERIAL_SML: return FEATURE_POWERMETER_SERIAL_SML;
+        case Type::SMAHM2: return FEATURE_POWERMETER_SMAHM;
+        case Type::HTTP_SML: return FEATURE_POWERMETER_HTTP_SML;
+        case Type::UDP_PUSH: return FEATURE_POWERMETER_UDP_PUSH;
+        case Type::SHELLY_RPC: return FEATURE_POWERMETER_SHELLY_RPC;
+    }
+    return false;
+}
+constexpr uint8_t PowerMeterProviderCount = 9;
+
+constexpr bool isSolarChargerProviderAvailable(uint8_t provider)
+{
+    switch (provider) {
+        case SolarChargerProviderType::VEDIRECT: return FEATURE_SOLARCHARGER_VEDIRECT;
+        case SolarChargerProviderType::MQTT: return FEATURE_SOLARCHARGER_MQTT;
+    }
+    return false;
+}
+constexpr uint8_t SolarChargerProviderCount = 2;
+
+constexpr bool isGridChargerInterfaceAvailable(uint8_t hardwareInterface)
+{
+    switch (hardwareInterface) {
+        case GridChargerHardwareInterface::MCP2515: return FEATURE_HUAWEI_MCP2515;
+        case GridChargerHardwareInterface::TWAI: return FEATURE_HUAWEI_TWAI;
+    }
+    return false;
+}
+constexpr uint8_t GridChargerInterfaceCount = 2;
+
+} // namespace Features
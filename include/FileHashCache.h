@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <TaskSchedulerDeclarations.h>
+#include <WString.h>
+#include <ctime>
+#include <list>
+#include <mutex>
+#include <vector>
+
+// caches the MD5 sums of files on LittleFS, which are used as ETags, such
+// that files are not read completely whenever a client revalidates them.
+// a cached sum is only used while the size and the modification time of
+// the file match the ones it was calculated for. the sums of the language
+// packs are calculated in the background after startup.
+class FileHashCacheClass {
+public:
+    FileHashCacheClass();
+    void init(Scheduler& scheduler);
+
+    // thread-safe. returns an empty string if the file does not exist.
+    String getMd5(String const& path);
+
+    // to be called if a file was changed or removed
+    void invalidate(String const& path);
+
+    // the quoted MD5 sum of the file, as used for the ETag header
+    String getETag(String const& path);
+
+private:
+    void loop();
+
+    struct Entry {
+        String Path;
+        size_t Size;
+        time_t LastWrite;
+        String Md5;
+    };
+
+    // the oldest entry is replaced once the cache is full
+    static constexpr size_t Capacity = 16;
+
+    Task _loopTask;
+
+    std::mutex _mutex;
+    std::vector<Entry> _entries;
+    size_t _next = 0;
+
+    // the files whose sums are calculated in the background
+    std::list<String> _pending;
+    bool _queued = false;
+};
+
+extern FileHashCacheClass FileHashCache;
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Arduino.h>
+#include <MD5Builder.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/stream_buffer.h>
+#include <atomic>
+
+struct tinfl_decompressor_tag;
+
+// writes an uploaded firmware to flash. the upload handler only copies the
+// received chunks into a stream buffer, while a task of its own inflates
+// and writes them, such that the AsyncTCP task is not blocked by erasing
+// and writing the flash. images compressed with gzip (.bin.gz) are
+// detected by their magic bytes and inflated on the fly.
+class FirmwareUpdaterClass {
+public:
+    // starts an update, fails if one is in progress already
+    bool begin(String const& md5);
+
+    // blocks while the stream buffer is full, i.e., the flash is slower
+    // than the upload, which throttles the sender
+    bool write(uint8_t const* data, size_t len);
+
+    // waits for the remaining data to be written and the image to be
+    // verified. returns whether the update succeeded.
+    bool end();
+
+    char const* getError() const { return _error.load(); }
+
+private:
+    static void taskHelper(void* context);
+    void taskLoop();
+    bool process(uint8_t* data, size_t len);
+    bool processGzipHeader(uint8_t*& data, size_t& len);
+    bool inflate(uint8_t* data, size_t len);
+    bool writeFlash(uint8_t* data, size_t len);
+    bool finish();
+    void fail(char const* error);
+    void release();
+
+    static constexpr size_t StreamSize = 32 * 1024;
+    static constexpr size_t ChunkSize = 4096;
+    static constexpr size_t DictionarySize = 32 * 1024; // TINFL_LZ_DICT_SIZE
+    // below the watchdog timeout of the AsyncTCP task
+    static constexpr uint32_t WriteTimeoutMillis = 4 * 1000;
+    static constexpr uint32_t IdleTimeoutMillis = 30 * 1000;
+    static constexpr uint32_t FinishTimeoutMillis = 30 * 1000;
+
+    enum class Format : uint8_t {
+        Unknown,
+        Plain,
+        Gzip
+    };
+
+    std::atomic<bool> _running = false;
+    std::atomic<bool> _finished = false;
+    std::atomic<char const*> _error = nullptr;
+
+    StaticStreamBuffer_t _streamStruct;
+    uint8_t* _streamStorage = nullptr;
+    StreamBufferHandle_t _stream = nullptr;
+    SemaphoreHandle_t _done = nullptr;
+    TaskHandle_t _taskHandle = nullptr;
+
+    String _expectedMd5;
+    MD5Builder _md5;
+    uint8_t* _chunk = nullptr;
+
+    Format _format = Format::Unknown;
+
+    // state of the gzip member header, see RFC 1952
+    uint8_t _headerFlags = 0;
+    uint8_t _headerFixed = 0; // bytes of the 10 byte fixed part seen
+    uint16_t _headerExtra = 0; // bytes of the extra field left to skip
+    uint8_t _headerExtraLength = 0; // bytes of the extra field length seen
+    uint8_t _headerCrc = 0; // bytes of the header CRC left to skip
+    bool _headerDone = false;
+
+    tinfl_decompressor_tag* _inflator = nullptr;
+    uint8_t* _dictionary = nullptr;
+    size_t _dictionaryOffset = 0;
+    bool _inflateDone = false;
+    uint32_t _inflatedSize = 0;
+    uint8_t _trailer[8];
+    uint8_t _trailerLength = 0;
+};
+
+extern FirmwareUpdaterClass FirmwareUpdater;
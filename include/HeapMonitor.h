@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <TaskSchedulerDeclarations.h>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+// attributes changes of the free internal heap and failed allocations to
+// tags, which are set by scopes around subsystem entry points, and records
+// the fragmentation of the internal heap over time. the free heap is
+// measured when entering and leaving a scope, so allocations of other tasks
+// running at the same time are attributed to the scope as well.
+class HeapMonitorClass {
+public:
+    HeapMonitorClass();
+    void init(Scheduler& scheduler);
+
+    struct Tag;
+
+    // sets the tag of the current task while it exists. scopes may be
+    // nested, the inner scope's bytes are not attributed to the outer one.
+    class Scope {
+    public:
+        explicit Scope(Tag* pTag);
+        ~Scope();
+
+        Scope(Scope const&) = delete;
+        Scope& operator=(Scope const&) = delete;
+
+    private:
+        Tag* _pTag;
+        Scope* _pParent;
+        size_t _freeAtEntry;
+        int32_t _childBytes = 0;
+    };
+
+    // returns the tag with the given name, which is created if necessary.
+    // returns nullptr if there are too many tags.
+    Tag* getTag(char const* name);
+
+    struct TagStats {
+        char const* Name;
+        uint32_t Scopes; // how often the tag was entered
+        int32_t NetBytes; // bytes allocated and not freed so far
+        int32_t BytesPerMinute; // change of NetBytes during the last minute
+        uint32_t FailedAllocs;
+        uint32_t FailedBytes;
+    };
+    std::vector<TagStats> getTagStats() const;
+
+    // 0 if the free internal heap is a single block, approaching 100 the
+    // more it is split into small blocks.
+    uint8_t getFragmentation() const;
+
+    static constexpr size_t HistoryLength = 60;
+    // one sample per minute, the oldest first
+    std::vector<uint8_t> getFragmentationHistory() const;
+
+    struct Tag {
+        char const* Name = nullptr;
+        std::atomic<uint32_t> Scopes = 0;
+        std::atomic<int32_t> NetBytes = 0;
+        int32_t LastMinuteNetBytes = 0;
+        std::atomic<int32_t> BytesPerMinute = 0;
+        std::atomic<uint32_t> FailedAllocs = 0;
+        std::atomic<uint32_t> FailedBytes = 0;
+    };
+
+private:
+    void loop();
+
+    static void onAllocFailed(size_t size, uint32_t caps, char const* functionName);
+
+    Task _loopTask;
+
+    static constexpr size_t MaxTags = 64;
+    std::array<Tag, MaxTags> _tags;
+    std::atomic<size_t> _tagCount = 0;
+    mutable std::mutex _mutex;
+
+    // failed allocations outside of any scope are counted here
+    Tag* _pUntagged = nullptr;
+
+    std::array<uint8_t, HistoryLength> _history = {};
+    size_t _historyHead = 0; // index of the oldest sample
+    size_t _historyCount = 0;
+};
+
+extern HeapMonitorClass HeapMonitor;
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "Configuration.h"
+#include <TaskSchedulerDeclarations.h>
+#include <array>
+#include <functional>
+#include <mutex>
+#include <optional>
+
+class HistoryClass {
+public:
+    enum class Series : uint8_t {
+        BatterySoC,
+        BatteryVoltage,
+        BatteryCurrent,
+        PowerMeterTotal,
+        PowerLimiterTarget,
+        InverterAcPower // first of INV_MAX_COUNT series, one per inverter slot
+    };
+
+    static constexpr size_t SERIES_COUNT = static_cast<size_t>(Series::InverterAcPower) + INV_MAX_COUNT;
+
+    enum class Resolution : uint8_t {
+        Raw,
+        Minute
+    };
+
+    HistoryClass();
+    void init(Scheduler& scheduler);
+
+    // calls the callback for at most maxSamples samples of the series with
+    // a timestamp in [from, to], in chronological order. returns the amount
+    // of samples passed to the callback.
+    using SampleCallback = std::function<void(uint32_t timestamp, std::optional<float> value)>;
+    size_t query(size_t series, Resolution resolution, uint32_t from, uint32_t to,
+        size_t maxSamples, SampleCallback const& callback);
+
+    uint16_t getInterval(Resolution resolution) const;
+
+    // the value of one fixed-point unit and the matching number of decimals
+    static float getScale(size_t series);
+    static uint8_t getDecimals(size_t series);
+
+private:
+    void loop();
+    void sample(uint32_t timestamp);
+    void rollup(uint32_t minute);
+
+    static constexpr uint16_t RAW_INTERVAL_S = 10;
+    static constexpr uint16_t MINUTE_INTERVAL_S = 60;
+    static constexpr size_t SAMPLES_PER_BLOCK = 60;
+
+    // values are stored as fixed-point numbers. a block stores the first
+    // sample of each series as is and every following sample as the
+    // difference to the previous valid sample of this series.
+    static constexpr int32_t NO_VALUE = INT32_MIN;
+    static constexpr int16_t NO_DELTA = INT16_MIN;
+
+    struct Block {
+        uint32_t Start; // unix timestamp of the first sample
+        uint16_t Interval; // seconds between two samples
+        uint8_t Count; // number of samples in this block
+        int32_t Base[SERIES_COUNT];
+        int16_t Deltas[SAMPLES_PER_BLOCK - 1][SERIES_COUNT];
+    };
+
+    using values_t = std::array<int32_t, SERIES_COUNT>;
+
+    class Tier {
+    public:
+        bool allocate(size_t capacity, uint16_t interval);
+
+        // returns the block which was completed by appending the sample, if any
+        Block const* append(uint32_t timestamp, values_t const& values);
+        void restore(Block const& block);
+
+        size_t query(size_t series, uint32_t from, uint32_t to,
+            size_t maxSamples, SampleCallback const& callback, float scale) const;
+
+        uint16_t getInterval() const { return _interval; }
+
+    private:
+        Block* startBlock(uint32_t timestamp, values_t const& values);
+
+        Block* _blocks = nullptr;
+        size_t _capacity = 0;
+        size_t _head = 0; // index of the block currently being filled
+        size_t _size = 0;
+        uint16_t _interval = 0;
+        values_t _reference; // last valid value of each series in the current block
+    };
+
+    void persist(Block const& block);
+    void restore();
+
+    Task _loopTask;
+
+    std::mutex _mutex;
+    Tier _raw;
+    Tier _minute;
+
+    uint32_t _lastSample = 0;
+
+    // accumulates the raw samples of the current minute
+    uint32_t _currentMinute = 0;
+    std::array<int64_t, SERIES_COUNT> _minuteSums;
+    std::array<uint8_t, SERIES_COUNT> _minuteCounts;
+};
+
+extern HistoryClass History;
@@ -12,11 +12,17 @@
 class HttpGetterClient : public HTTPClient {
 public:
     void restartTCP() {
-        // keeps the NetworkClient, and closes the TCP connections (as we
-        // effectively do not support keep-alive with HTTP 1.0).
+        // keeps the NetworkClient, and closes the TCP connection, e.g., if
+        // the server announced that it will not keep it alive.
         HTTPClient::disconnect(true);
         HTTPClient::connect();
     }
+
+    void closeTCP() {
+        // the remainder of the response would otherwise be drained before
+        // the connection can be reused.
+        if (_client) { _client->stop(); }
+    }
 };
 
 using up_http_client_t = std::unique_ptr<HttpGetterClient>;
@@ -24,19 +30,14 @@ using sp_wifi_client_t = std::shared_ptr<WiFiClient>;
 
 class HttpRequestResult {
 public:
-    HttpRequestResult(bool success,
-            up_http_client_t upHttpClient = nullptr,
-            sp_wifi_client_t spWiFiClient = nullptr)
+    HttpRequestResult(bool success, HttpGetterClient* pHttpClient = nullptr)
         : _success(success)
-        , _upHttpClient(std::move(upHttpClient))
-        , _spWiFiClient(std::move(spWiFiClient)) { }
+        , _pHttpClient(pHttpClient) { }
 
     ~HttpRequestResult() {
-        // the wifi client *must* die *after* the http client, as the http
-        // client uses the wifi client in its destructor.
-        if (_upHttpClient) { _upHttpClient->end(); }
-        _upHttpClient = nullptr;
-        _spWiFiClient = nullptr;
+        // drains the response and keeps the TCP connection open for the
+        // next request, unless the server signaled that it will close it.
+        if (_pHttpClient) { _pHttpClient->end(); }
     }
 
     HttpRequestResult(HttpRequestResult const&) = delete;
@@ -47,14 +48,29 @@ public:
     operator bool() const { return _success; }
 
     Stream* getStream() {
-        if(!_upHttpClient) { return nullptr; }
-        return _upHttpClient->getStreamPtr();
+        if(!_pHttpClient) { return nullptr; }
+        return _pHttpClient->getStreamPtr();
+    }
+
+    // the size of the body as announced by the server, -1 if unknown
+    int getSize() const {
+        if (!_pHttpClient) { return -1; }
+        return _pHttpClient->getSize();
+    }
+
+    bool isConnected() const {
+        return _pHttpClient && _pHttpClient->connected();
+    }
+
+    // to be called if the rest of the body is not needed. the next request
+    // then uses a new TCP connection.
+    void close() {
+        if (_pHttpClient) { _pHttpClient->closeTCP(); }
     }
 
 private:
     bool _success;
-    up_http_client_t _upHttpClient;
-    sp_wifi_client_t _spWiFiClient;
+    HttpGetterClient* _pHttpClient;
 };
 
 class HttpGetter {
@@ -64,11 +80,16 @@ public:
 
     bool init();
     void addHeader(char const* key, char const* value);
+
+    // the result must not outlive this HttpGetter, and only one result
+    // may exist at any time, as the HTTP client is reused.
     HttpRequestResult performGetRequest();
 
     char const* getErrorText() const { return _errBuffer; }
 
 private:
+    bool resolveHost();
+    std::pair<bool, String> parseChallenge(String const& wwwAuthenticate);
     std::pair<bool, String> getAuthDigest();
     HttpRequestConfig const& _config;
 
@@ -81,10 +102,34 @@ private:
     String _uri;
     uint16_t _port;
 
-    String _wwwAuthenticate = "";
+    // resolving a name via mDNS or DNS takes much longer than the request
+    // itself, so the address is kept until a request fails. addresses are
+    // also shared with other HTTP getters through a small cache whose
+    // entries expire after a while, such that an address change is noticed.
+    IPAddress _ipAddress = INADDR_NONE;
+    uint32_t _resolvedAt = 0;
+
+    // the parts of the last digest challenge which do not change between
+    // requests, such that the challenge is parsed and hashed only once.
+    struct DigestChallenge {
+        bool Valid = false;
+        String Realm;
+        String Nonce;
+        String Algorithm;
+        String Ha1;
+        String Ha2;
+    };
+    DigestChallenge _digest;
     unsigned _nonceCounter = 0;
 
-    sp_wifi_client_t _spWiFiClient; // reused for multiple HTTP requests
+    // the wifi client *must* die *after* the http client, as the http
+    // client uses the wifi client in its destructor. both are reused for
+    // all requests, which keeps the TCP connection alive between polls.
+    sp_wifi_client_t _spWiFiClient;
+    up_http_client_t _upHttpClient;
+
+    // see NetworkSettingsClass::getRouteGeneration()
+    uint32_t _routeGeneration = 0;
 
     std::vector<std::pair<std::string, std::string>> _additionalHeaders;
 };
@@ -3,7 +3,9 @@
 
 #include <TaskSchedulerDeclarations.h>
 #include <WString.h>
+#include <array>
 #include <list>
+#include <mutex>
 
 struct LanguageInfo_t {
     String code;
@@ -16,7 +18,7 @@ public:
     I18nClass();
     void init(Scheduler& scheduler);
     std::list<LanguageInfo_t> getAvailableLanguages();
-    String getFilenameByLocale(const String& locale) const;
+    String getFilenameByLocale(const String& locale);
     void readDisplayStrings(
         const String& locale,
         String& date_format,
@@ -27,9 +29,23 @@ public:
         String& yield_total_kwh, String& yield_total_mwh);
 
 private:
+    // the meta data and display strings of a language pack, in the order
+    // in which they are stored in the compiled file
+    static constexpr size_t LangPackStringCount = 12;
+    struct LangPack_t {
+        std::array<String, LangPackStringCount> Strings;
+        std::array<bool, LangPackStringCount> Present = {};
+    };
+
     void readLangPacks();
-    void readConfig(String file);
+    static bool loadLangPack(const String& file, LangPack_t& pack);
+    static bool readCompiled(const String& file, LangPack_t& pack);
+    static bool compile(const String& file, LangPack_t& pack);
+    static String getCompiledFilename(const String& file);
 
+    // the language packs are scanned on first use rather than at startup
+    std::mutex _mutex;
+    bool _scanned = false;
     std::list<LanguageInfo_t> _availLanguages;
 };
 
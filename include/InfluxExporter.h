@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <AsyncTCP.h>
+#include <Hoymiles.h>
+#include <TaskSchedulerDeclarations.h>
+#include <WiFiUdp.h>
+#include <lwip/ip_addr.h>
+#include <atomic>
+#include <cstdarg>
+#include <vector>
+
+// pushes the values of the inverters, the battery, the solar charger, the
+// power meter, the DPL and the system to an InfluxDB (or any other sink
+// understanding the line protocol) once per interval. all lines are
+// rendered into one buffer, which is sent in as few UDP datagrams as
+// possible or as the body of a single HTTP POST request. the lines carry no
+// timestamp, the server assigns the time of reception.
+class InfluxExporterClass {
+public:
+    InfluxExporterClass();
+    void init(Scheduler& scheduler);
+
+private:
+    enum class Protocol : uint8_t {
+        Udp = 0,
+        Http = 1
+    };
+
+    void loop();
+    void updateSettings();
+    void resolve();
+
+    void render();
+    void renderSystem();
+    void renderInverters();
+    void renderBattery();
+    void renderSolarCharger();
+    void renderPowerMeter();
+    void renderPowerLimiter();
+
+    // a line is discarded if it has no fields or does not fit the buffer
+    void beginLine(char const* format, ...) __attribute__((format(printf, 2, 3)));
+    void addField(char const* key, char const* format, ...) __attribute__((format(printf, 3, 4)));
+    void endLine();
+    void append(char const* format, ...) __attribute__((format(printf, 2, 3)));
+    void print(char const* format, va_list args);
+    static String escapeTag(char const* value);
+
+    void sendUdp();
+    void sendHttp();
+    void sendPending();
+
+    static void onDnsFound(const char* name, const ip_addr_t* ipaddr, void* arg);
+
+    // payload of a single datagram, such that it is never fragmented
+    static constexpr size_t MaxDatagramSize = 1400;
+    static constexpr size_t BufferSize = 8192;
+    static constexpr uint32_t ResolveIntervalMillis = 10 * 60 * 1000;
+    static constexpr uint32_t HttpTimeoutSeconds = 10;
+
+    Task _loopTask;
+
+    uint32_t _configGeneration = 0;
+    bool _enabled = false;
+    Protocol _protocol = Protocol::Udp;
+    String _hostname;
+    uint16_t _port = 0;
+
+    // measurement and tags of the lines of each inverter, which only change
+    // with the inverter's name. stats are only rendered if they were
+    // updated since the last interval.
+    struct InverterTags {
+        uint64_t Serial;
+        String Name;
+        String Prefix;
+        uint32_t LastUpdate;
+    };
+    std::vector<InverterTags> _inverters;
+    String _hostTag;
+
+    char* _buffer = nullptr;
+    size_t _length = 0;
+    size_t _lineStart = 0;
+    size_t _lineFields = 0;
+    bool _lineOverflow = false;
+    uint32_t _droppedLines = 0;
+
+    WiFiUDP _udp;
+
+    // the lwIP DNS callback runs in the TCP/IP task
+    IPAddress _address;
+    std::atomic<uint32_t> _dnsResult = 0;
+    std::atomic<uint32_t> _dnsGeneration = 0;
+    uint32_t _lastResolve = 0;
+
+    // the request header and the buffer are sent from within the async_tcp
+    // task. the buffer is not rendered again until the request completed.
+    enum class HttpState : uint8_t {
+        Idle,
+        Connecting,
+        Sending
+    };
+    std::atomic<HttpState> _httpState = HttpState::Idle;
+    AsyncClient _client;
+    String _request;
+    size_t _requestSent = 0;
+    String _token;
+    String _path;
+};
+
+extern InfluxExporterClass InfluxExporter;
@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+// records the raw input of the serial, CAN and radio data sources into a
+// buffer (in PSRAM if available), such that it can be downloaded and later
+// fed into the parsers again, at the original or at an accelerated speed.
+// this reproduces the load and the data of a site exactly, e.g., to
+// benchmark the parsers or to tune the DPL.
+//
+// the log starts with a Header, followed by the records. each record starts
+// with a RecordHeader and holds the bytes received by one source at about
+// the same time. consecutive bytes of serial sources are combined into one
+// record if they arrived within CoalesceMicros, whereas each CAN frame and
+// each radio fragment is a record of its own. a full buffer ends the
+// recording. while a source is replayed, its live input is dropped.
+class InputCaptureClass {
+public:
+    enum class Source : uint8_t {
+        VeDirect = 0, // channel: controller instance
+        JkBms = 1,
+        JbdBms = 2,
+        SmlSerial = 3,
+        Twai = 4, // one frame per record, see FrameSize
+        Radio = 5, // channel: 0 NRF, 1 CMT, data: RSSI followed by the fragment
+        Count
+    };
+
+    struct Header {
+        char Magic[4]; // "OICP"
+        uint8_t Version;
+        uint8_t Reserved[3];
+        uint32_t RecordBytes; // following the header
+        uint32_t DurationMillis;
+    };
+
+    struct RecordHeader {
+        uint32_t DeltaMicros; // since the previous record
+        uint8_t Source;
+        uint8_t Channel;
+        uint16_t Length;
+    };
+
+    enum class State : uint8_t {
+        Idle,
+        Recording,
+        Replaying
+    };
+
+    static constexpr uint8_t MaxChannels = 4;
+    static constexpr uint32_t CoalesceMicros = 1000;
+
+    // starts a new recording of the given sources (bit mask of Source)
+    bool startRecording(uint32_t sources);
+
+    // feeds the recorded or loaded data into the parsers. the speed is a
+    // factor applied to the recorded timing.
+    bool startReplay(uint16_t speed);
+
+    void stop();
+
+    // replaces the buffer's content by a previously downloaded log, which
+    // is passed in consecutive parts. the log is checked once it is complete.
+    bool load(size_t offset, uint8_t const* data, size_t length);
+    bool finishLoad(size_t length);
+
+    State getState() const { return _state; }
+    uint32_t getSources() const { return _sources; }
+    size_t getCapacity() const { return _capacity; }
+    size_t getUsed() const { return _used; }
+    uint32_t getDroppedRecords() const { return _droppedRecords; }
+    uint32_t getDurationMillis() const;
+
+    // copies a part of the log, i.e., the header and the records
+    size_t getLogSize() const { return sizeof(Header) + _used; }
+    size_t readLog(size_t offset, uint8_t* buffer, size_t length) const;
+
+    // cheap unless the source is being recorded. thread-safe.
+    void record(Source source, uint8_t channel, uint8_t const* data, size_t length) {
+        if ((_recordMask.load(std::memory_order_relaxed) & bit(source)) == 0) { return; }
+        append(source, channel, data, length);
+    }
+
+    bool isReplaying(Source source) const {
+        return (_replayMask.load(std::memory_order_relaxed) & bit(source)) != 0;
+    }
+
+    // invokes the callback for every record of the source and channel which
+    // is due, from the context which consumes the source's input otherwise.
+    using ReplayCallback = std::function<void(uint8_t const* data, size_t length)>;
+    template<typename Callback>
+    void replay(Source source, uint8_t channel, Callback&& callback) {
+        if (!isReplaying(source)) { return; }
+        replayDue(source, channel, ReplayCallback(std::forward<Callback>(callback)));
+    }
+
+    // the record of a CAN frame: identifier, flags (bit 0: extended, bit 1:
+    // remote), data length code and the data.
+    static constexpr size_t FrameSize = 4 + 1 + 1 + 8;
+
+private:
+    // the buffer is smaller without PSRAM
+    static constexpr size_t BufferSize = 128 * 1024;
+    static constexpr size_t InternalBufferSize = 16 * 1024;
+
+    static constexpr uint32_t bit(Source source) { return 1UL << static_cast<uint8_t>(source); }
+    static bool isStream(Source source) { return source != Source::Twai && source != Source::Radio; }
+
+    bool allocate();
+    void append(Source source, uint8_t channel, uint8_t const* data, size_t length);
+    void replayDue(Source source, uint8_t channel, ReplayCallback const& callback);
+
+    uint8_t* _buffer = nullptr;
+    size_t _capacity = 0;
+    Header _loadHeader;
+
+    // protects the buffer while recording. appending is short, so it is
+    // done with interrupts disabled rather than blocking the sources.
+    portMUX_TYPE _recordLock = portMUX_INITIALIZER_UNLOCKED;
+    std::atomic<size_t> _used = 0;
+    size_t _lastRecord = 0;
+    int64_t _lastMicros = 0;
+    int64_t _lastChunkMicros = 0;
+    bool _hasRecord = false;
+    uint32_t _startMillis = 0;
+    uint32_t _durationMillis = 0;
+    std::atomic<uint32_t> _droppedRecords = 0;
+
+    std::atomic<State> _state = State::Idle;
+    std::atomic<uint32_t> _recordMask = 0;
+    std::atomic<uint32_t> _replayMask = 0;
+    uint32_t _sources = 0;
+
+    // the contexts replaying records right now. the buffer is not replaced
+    // until they are done.
+    std::atomic<uint8_t> _replayReaders = 0;
+    uint16_t _speed = 1;
+    int64_t _replayStartMicros = 0;
+    struct Cursor {
+        size_t Offset; // of the next record
+        uint64_t Micros; // of the previous record, since the start
+    };
+    Cursor _cursors[static_cast<size_t>(Source::Count)][MaxChannels];
+};
+
+extern InputCaptureClass InputCapture;
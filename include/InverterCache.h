@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Hoymiles.h>
+#include <TaskSchedulerDeclarations.h>
+#include <vector>
+
+// persists the device info and grid profile of each inverter, which are
+// fetched in multi-fragment exchanges. after booting, they are restored
+// from flash, so the radio is free for polling the inverters' stats. the
+// device info is requested again once in the background, and the grid
+// profile is fetched again if the firmware version changed.
+class InverterCacheClass {
+public:
+    InverterCacheClass();
+    void init(Scheduler& scheduler);
+
+    // to be called after the inverters were added
+    void restore();
+
+private:
+    void loop();
+
+    // the data as written to flash
+    struct Record {
+        uint32_t Magic;
+        uint64_t Serial;
+        uint8_t DevInfoAll[DEV_INFO_SIZE];
+        uint8_t DevInfoAllLength;
+        uint8_t DevInfoSimple[DEV_INFO_SIZE];
+        uint8_t DevInfoSimpleLength;
+        uint8_t GridProfile[GRID_PROFILE_SIZE];
+        uint8_t GridProfileLength;
+    };
+
+    struct Entry {
+        Record Persisted; // the data which was written to flash last
+        bool RefreshPending; // the restored device info was not confirmed yet
+        uint32_t RefreshRequested;
+    };
+
+    static void read(InverterAbstract& inv, Record& record);
+    Entry* getEntry(uint64_t serial);
+    static String getFilename(uint64_t serial);
+    static void persist(Record const& record);
+
+    Task _loopTask;
+
+    std::vector<Entry> _entries;
+};
+
+extern InverterCacheClass InverterCache;
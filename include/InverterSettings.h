@@ -9,6 +9,11 @@
 class InverterSettingsClass {
 public:
     InverterSettingsClass();
+
+    // sets up the radios and adds the inverters. does not use the
+    // scheduler, hence it may run on a worker task while booting.
+    void initRadios();
+
     void init(Scheduler& scheduler);
 
 private:
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+// holds the JSON document generated from data of a given version (see
+// JsonETag), along with its serialization. unchanged data is thus generated
+// and serialized once, however many websocket clients and REST requests
+// ask for it within the same version.
+class JsonFragmentCache {
+public:
+    using Generator = std::function<void(JsonVariant& root)>;
+
+    struct Fragment {
+        std::shared_ptr<JsonDocument const> spDoc;
+        AsyncWebSocketSharedBuffer spText;
+    };
+
+    // returns the fragment of the given version, which is generated if the
+    // cached fragment is of another version. both pointers are nullptr if
+    // the document could not be allocated. a fragment stays valid while it
+    // is used, even if a fragment of another version was generated.
+    Fragment get(uint32_t version, Generator const& generate);
+
+    // sends the serialized fragment as response to the request
+    static void send(AsyncWebServerRequest* request, Fragment const& fragment);
+
+private:
+    std::mutex _mutex;
+    std::optional<uint32_t> _oVersion = std::nullopt;
+    Fragment _fragment;
+};
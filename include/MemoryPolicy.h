@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ArduinoJson.h>
+#include <cstddef>
+
+// decides where buffers are placed on boards with PSRAM. allocations above
+// InternalMaxSize bytes go to PSRAM in general, whereas smaller ones stay
+// in the internal RAM, which is faster and needed by drivers and the
+// network stack. large or long-lived buffers are placed in PSRAM explicitly
+// using the functions below, regardless of their size. without PSRAM, the
+// internal RAM is used.
+namespace MemoryPolicy {
+    static constexpr size_t InternalMaxSize = 512;
+
+    void init();
+
+    // for buffers which are large or kept for a long time, e.g., the
+    // history and the trace rings. to be released using free().
+    void* allocateLarge(size_t size);
+
+    // for JSON documents which are large or kept while being sent, e.g.,
+    // the configuration, Home Assistant discovery payloads and websocket
+    // snapshots. ArduinoJson allocates many small pools and strings for a
+    // document, which would end up in internal RAM otherwise.
+    ArduinoJson::Allocator* jsonAllocator();
+} // namespace MemoryPolicy
@@ -1,10 +1,12 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
-#include <AsyncWebSocket.h>
 #include <TaskSchedulerDeclarations.h>
 #include <Print.h>
 #include <freertos/task.h>
+#include <array>
+#include <atomic>
+#include <functional>
 #include <mutex>
 #include <vector>
 #include <unordered_map>
@@ -16,26 +18,52 @@ public:
     void init(Scheduler& scheduler);
     size_t write(uint8_t c) override;
     size_t write(const uint8_t* buffer, size_t size) override;
-    void register_ws_output(AsyncWebSocket* output);
+    // the sink is called in the context of the loop for every line. it must
+    // be registered during setup, before the loop runs.
+    using LineSink = std::function<void(uint8_t const* data, size_t size)>;
+    void register_ws_output(LineSink sink);
 
 private:
     void loop();
 
     Task _loopTask;
 
-    using message_t = std::vector<uint8_t>;
+    // we keep a staging buffer for every task which is currently writing a
+    // line and only commit complete lines to the ring buffer. this way we
+    // prevent mangling of messages from different contexts. a slot is only
+    // accessed by the task owning it and released once its line is complete.
+    struct Staging {
+        std::atomic<TaskHandle_t> Owner = nullptr;
+        uint16_t Length = 0;
+        uint8_t Data[256];
+    };
+    std::array<Staging, 12> _staging;
 
-    // we keep a buffer for every task and only write complete lines to the
-    // serial output and then move them to be pushed through the websocket.
-    // this way we prevent mangling of messages from different contexts.
-    std::unordered_map<TaskHandle_t, message_t> _task_messages;
-    std::queue<message_t> _lines;
+    Staging* acquireStaging();
 
-    AsyncWebSocket* _ws = nullptr;
+    // lines are passed to the loop through a lock-free ring buffer with
+    // multiple producers and a single consumer. a producer reserves space
+    // for its record by advancing _reserved, copies the line and then marks
+    // the record's header as committed. the loop outputs committed records
+    // in order, zeroes them and advances _released.
+    static constexpr uint32_t RingSize = 8192; // must be a power of two
+    alignas(4) uint8_t _ring[RingSize] = {};
+    std::atomic<uint32_t> _reserved = 0;
+    std::atomic<uint32_t> _released = 0;
 
-    std::mutex _msgLock;
+    static constexpr uint32_t HeaderCommitted = 1 << 31;
+    static constexpr uint32_t HeaderPadding = 1 << 30;
+    static constexpr uint32_t HeaderLengthMask = 0xFFFF;
 
-    void serialWrite(message_t const& m);
+    void commit(uint8_t const* data, size_t size);
+
+    // lines which were dropped as the ring buffer was full
+    std::atomic<uint32_t> _droppedLines = 0;
+    uint32_t _lastDroppedReport = 0;
+
+    LineSink _wsSink;
+
+    void serialWrite(uint8_t const* data, size_t size);
 };
 
 extern MessageOutputClass MessageOutput;
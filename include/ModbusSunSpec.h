@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstdint>
+
+// the SunSpec register map served by the Modbus TCP server, such that
+// energy managers can discover the DTU. it consists of the common model,
+// the three-phase inverter model (103) holding the totals of all inverters,
+// the MPPT model (160) with one module per DC channel and the battery base
+// model (802). the layout is fixed, so the model headers and the strings
+// are written once and only the values are refreshed.
+namespace ModbusSunSpec {
+    static constexpr uint16_t BaseAddress = 40000;
+
+    // offsets of the model headers (ID and length) relative to BaseAddress
+    static constexpr uint16_t CommonModel = 2;
+    static constexpr uint16_t CommonLength = 66;
+    static constexpr uint16_t InverterModel = CommonModel + 2 + CommonLength;
+    static constexpr uint16_t InverterLength = 50;
+    static constexpr uint16_t MpptModel = InverterModel + 2 + InverterLength;
+    static constexpr uint8_t MpptModules = 12;
+    static constexpr uint16_t MpptModuleLength = 20;
+    static constexpr uint16_t MpptLength = 8 + MpptModuleLength * MpptModules;
+    static constexpr uint16_t BatteryModel = MpptModel + 2 + MpptLength;
+    static constexpr uint16_t BatteryLength = 62;
+    static constexpr uint16_t EndModel = BatteryModel + 2 + BatteryLength;
+    static constexpr uint16_t Size = EndModel + 2;
+
+    // writes the static parts of the map
+    void initialize(uint16_t* image);
+
+    // updates the values of the map
+    void refresh(uint16_t* image);
+} // namespace ModbusSunSpec
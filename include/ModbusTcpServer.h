@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "Configuration.h"
+#include <AsyncTCP.h>
+#include <TaskSchedulerDeclarations.h>
+#include <atomic>
+#include <mutex>
+#include <optional>
+
+// serves live data to SCADA systems and energy managers via Modbus TCP.
+// the registers are refreshed from the data sources once per second, so a
+// request only copies from the register image, regardless of how often it
+// is polled. function codes 3 and 4 read the same registers. if writing is
+// enabled, the DPL mode can be changed using function code 6 or 16.
+//
+// 32 bit values occupy two registers, high word first. floats are IEEE 754
+// and are NaN if the value is not known. the inverter blocks follow the
+// order of the inverters in the settings. starting at address 40000, the
+// data is also available as SunSpec models, see ModbusSunSpec.h.
+class ModbusTcpServerClass {
+public:
+    enum Register : uint16_t {
+        // system
+        MapVersion = 0,
+        InverterCount = 1,
+        Uptime = 2, // uint32, s
+        DplMode = 10, // 0: normal, 1: disabled, 2: unconditional full solar passthrough
+        DplInverterOutput = 11, // float, W
+
+        // power meter
+        PowerMeterValid = 100, // 0 or 1
+        PowerMeterPower = 101, // float, W
+
+        // battery
+        BatteryEnabled = 200, // 0 or 1
+        BatteryDataAge = 201, // s
+        BatterySoc = 202, // float, %
+        BatteryVoltage = 204, // float, V
+        BatteryCurrent = 206, // float, A
+        BatteryPower = 208, // float, W
+        BatteryDischargeCurrentLimit = 210, // float, A
+
+        // solar charger
+        SolarChargerEnabled = 300, // 0 or 1
+        SolarChargerDataAge = 301, // s
+        SolarChargerOutputPower = 302, // float, W
+        SolarChargerOutputVoltage = 304, // float, V
+        SolarChargerPanelPower = 306, // float, W
+        SolarChargerYieldDay = 308, // float, Wh
+        SolarChargerYieldTotal = 310, // float, kWh
+
+        // inverter blocks, relative to InverterBase + position * InverterBlockSize
+        InverterBase = 1000,
+        InverterBlockSize = 100,
+        InverterSerial = 0, // uint64, four registers
+        InverterReachable = 4, // 0 or 1
+        InverterProducing = 5, // 0 or 1
+        InverterDataAge = 6, // s, 0xFFFF if no data was received yet
+        InverterLimitRelative = 7, // float, %
+        // the fields of the statistics parser as listed in the source file,
+        // starting with the AC channel, followed by the inverter channel and
+        // the DC channels.
+        InverterFields = 10,
+    };
+
+    static constexpr uint16_t RegisterCount = InverterBase + InverterBlockSize * INV_MAX_COUNT;
+
+    ModbusTcpServerClass();
+    void init(Scheduler& scheduler);
+
+private:
+    void loop();
+    void updateSettings();
+    void refresh();
+    void refreshInverters();
+
+    void setUInt32(uint16_t address, uint32_t value);
+    void setFloat(uint16_t address, float value);
+    void setFloat(uint16_t address, std::optional<float> const& value);
+
+    struct Connection {
+        uint8_t Buffer[260]; // the largest ADU
+        size_t Length = 0;
+    };
+
+    void onClient(AsyncClient* client);
+    void onData(AsyncClient* client, Connection& connection, uint8_t const* data, size_t len);
+    size_t handleRequest(uint8_t const* request, size_t length, uint8_t* response);
+    size_t handleRead(uint8_t const* pdu, size_t length, uint8_t* response);
+    size_t handleWrite(uint8_t const* pdu, size_t length, uint8_t* response);
+    static size_t exception(uint8_t function, uint8_t code, uint8_t* response);
+
+    static constexpr uint8_t MaxClients = 4;
+    static constexpr uint32_t IdleTimeoutSeconds = 60;
+
+    Task _loopTask;
+    uint32_t _configGeneration = 0;
+
+    AsyncServer* _server = nullptr;
+    std::atomic<bool> _enabled = false;
+    std::atomic<bool> _writeEnabled = false;
+    std::atomic<uint8_t> _clients = 0;
+
+    // written by the loop, read from within the async_tcp task
+    std::mutex _mutex;
+    uint16_t* _registers = nullptr;
+    uint16_t* _sunspec = nullptr;
+
+    // applied by the loop, as the DPL is not thread-safe
+    static constexpr int NoPendingMode = -1;
+    std::atomic<int> _pendingDplMode = NoPendingMode;
+};
+
+extern ModbusTcpServerClass ModbusTcpServer;
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "MessageOutput.h"
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// MQTT callbacks to process updates on subscribed topics are executed in the
+// MQTT thread's context. the handlers parse a message into a command, which
+// is pushed to this queue and executed in the main loop's context
+// (TaskScheduler context), such that the MQTT client never waits for
+// configuration locks or the radio. a command replaces the pending command
+// for the same target, i.e., the last writer wins, which keeps the queue
+// short during bursts of messages. the Command type must provide a method
+// `key()` which identifies its target.
+template<typename Command, size_t Capacity = 16>
+class MqttCommandQueue {
+public:
+    explicit MqttCommandQueue(char const* name)
+        : _name(name)
+    {
+        _pending.reserve(Capacity);
+    }
+
+    // returns false if the queue is full and the command was dropped
+    bool push(Command const& command)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto key = command.key();
+        auto it = std::find_if(_pending.begin(), _pending.end(),
+                [key](Command const& pending) { return pending.key() == key; });
+        if (it != _pending.end()) {
+            *it = command;
+            return true;
+        }
+
+        if (_pending.size() >= Capacity) {
+            MessageOutput.printf("[%s] Command queue is full, dropping command\r\n", _name);
+            return false;
+        }
+
+        _pending.push_back(command);
+        return true;
+    }
+
+    // calls the handler for each pending command in the order of arrival of
+    // the first command for the respective target. the handler is called
+    // without holding the lock, so it may take as long as it needs.
+    template<typename F>
+    void execute(F&& handler)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_pending.empty()) { return; }
+            std::swap(_executing, _pending);
+        }
+
+        for (auto const& command : _executing) { handler(command); }
+        _executing.clear();
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending.clear();
+    }
+
+private:
+    char const* _name;
+    std::mutex _mutex;
+    std::vector<Command> _pending;
+    std::vector<Command> _executing; // only used by the main loop
+};
@@ -1,9 +1,12 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "MqttHassPublisher.h"
 #include <ArduinoJson.h>
 #include <Hoymiles.h>
 #include <TaskSchedulerDeclarations.h>
+#include <functional>
+#include <optional>
 
 // mqtt discovery device classes
 enum DeviceClassType {
@@ -74,8 +77,27 @@ public:
 
 private:
     void loop();
+    void enqueue(MqttHassPublisherClass::Generator&& generator);
     static void publish(const String& subtopic, const String& payload);
-    static void publish(const String& subtopic, const JsonDocument& doc);
+    static void publish(const String& subtopic, JsonDocument& doc);
+
+    // passes the generators of the entity documents of a device on
+    using Emit = std::function<void(MqttHassPublisherClass::Generator&&)>;
+    static void addDtuEntities(const Emit& emit);
+    static void addInverterEntities(std::shared_ptr<InverterAbstract> inv, const Emit& emit);
+
+    // device-based discovery: runs the entity generators of a device and
+    // publishes their documents as components of a single message.
+    using DeviceInfo = std::function<void(JsonDocument&)>;
+    using Entities = std::function<void(const Emit&)>;
+    static void publishDevice(const String& nodeId, const DeviceInfo& createInfo, const Entities& addEntities);
+    static void addComponent(const String& subtopic, JsonDocument& doc);
+
+    // where the entity documents created by the generators go
+    enum class Output { Entity, Component, Clear };
+    static Output _output;
+    static String* _pDevicePayload;
+    static size_t _componentCount;
 
     static void addCommonMetadata(JsonDocument& doc, const String& unit_of_measure, const String& icon, const DeviceClassType device_class, const StateClassType state_class, const CategoryType category);
 
@@ -102,6 +124,9 @@ private:
 
     bool _wasConnected = false;
     bool _updateForced = false;
+
+    // the discovery mode used for the messages published last
+    std::optional<bool> _oDeviceDiscovery = std::nullopt;
 };
 
 extern MqttHandleHassClass MqttHandleHass;
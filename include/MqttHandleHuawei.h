@@ -2,11 +2,9 @@
 #pragma once
 
 #include "Configuration.h"
+#include "MqttCommandQueue.h"
 #include <espMqttClient.h>
 #include <TaskSchedulerDeclarations.h>
-#include <mutex>
-#include <deque>
-#include <functional>
 #include <frozen/map.h>
 #include <frozen/string.h>
 
@@ -44,16 +42,20 @@ private:
             const char* topic, const uint8_t* payload, size_t len,
             size_t index, size_t total);
 
+    struct Command {
+        Topic Type;
+        float Value;
+
+        unsigned key() const { return static_cast<unsigned>(Type); }
+    };
+    void execute(Command const& command);
+
     Task _loopTask;
 
     uint32_t _lastPublishStats;
     uint32_t _lastPublish;
 
-    // MQTT callbacks to process updates on subscribed topics are executed in
-    // the MQTT thread's context. we use this queue to switch processing the
-    // user requests into the main loop's context (TaskScheduler context).
-    mutable std::mutex _mqttMutex;
-    std::deque<std::function<void()>> _mqttCallbacks;
+    MqttCommandQueue<Command> _commands { "MqttHandleHuawei" };
 };
 
 extern MqttHandleHuaweiClass MqttHandleHuawei;
\ No newline at end of file
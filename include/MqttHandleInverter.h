@@ -2,11 +2,14 @@
 #pragma once
 
 #include "Configuration.h"
+#include "MqttCommandQueue.h"
 #include <Hoymiles.h>
 #include <TaskSchedulerDeclarations.h>
 #include <espMqttClient.h>
 #include <frozen/map.h>
 #include <frozen/string.h>
+#include <string>
+#include <vector>
 
 class MqttHandleInverterClass {
 public:
@@ -14,17 +17,44 @@ public:
     void init(Scheduler& scheduler);
 
     static String getTopic(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId);
+    static String getJsonTopic(std::shared_ptr<InverterAbstract> inv);
 
     void subscribeTopics();
     void unsubscribeTopics();
 
 private:
+    struct FieldState {
+        ChannelType_t type;
+        ChannelNum_t channel;
+        FieldId_t fieldId;
+        uint16_t topicOffset; // into InverterState::topics
+        uint8_t nameOffset; // of the field name within the topic
+        float value; // last published value
+        bool published;
+    };
+
+    struct InverterState {
+        uint64_t serial = 0;
+        String prefix;
+        uint32_t lastPublishStats = 0;
+        uint32_t lastRefresh = 0;
+        // all topics of this inverter including the prefix, each one
+        // null-terminated, such that a single allocation holds them all.
+        std::string topics;
+        uint16_t jsonTopicOffset = 0;
+        std::vector<FieldState> fields;
+    };
+
     void loop();
-    void publishField(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId);
+    void commandLoop();
+    void buildInverterState(std::shared_ptr<InverterAbstract> inv, InverterState& state);
+    void publishFields(std::shared_ptr<InverterAbstract> inv, InverterState& state);
+    static bool exceedsDeadband(const float last, const float value, const uint8_t digits, const float deadband);
 
     Task _loopTask;
+    Task _commandTask;
 
-    uint32_t _lastPublishStats[INV_MAX_COUNT] = { 0 };
+    InverterState _inverterStates[INV_MAX_COUNT];
 
     FieldId_t _publishFields[14] = {
         FLD_UDC,
@@ -65,6 +95,24 @@ private:
     };
 
     void onMqttMessage(Topic t, const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, const size_t len, const size_t index, const size_t total);
+
+    struct Command {
+        uint64_t Serial;
+        Topic Type;
+        float Value;
+        bool Retained;
+
+        // all limit topics set the same limit of an inverter. retained
+        // messages are kept apart, as some of them are ignored.
+        uint64_t key() const
+        {
+            auto target = (Type <= Topic::LimitNonPersistentAbsolute) ? Topic::LimitPersistentRelative : Type;
+            return (Serial << 8) | (Retained ? 0x80 : 0) | static_cast<uint8_t>(target);
+        }
+    };
+    void execute(Command const& command);
+
+    MqttCommandQueue<Command> _commands { "MqttHandleInverter" };
 };
 
 extern MqttHandleInverterClass MqttHandleInverter;
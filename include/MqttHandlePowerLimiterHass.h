@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "MqttHassPublisher.h"
 #include <ArduinoJson.h>
 #include <TaskSchedulerDeclarations.h>
 
@@ -12,6 +13,7 @@ public:
 
 private:
     void loop();
+    void enqueue(MqttHassPublisherClass::Generator&& generator);
     void publish(const String& subtopic, const String& payload);
     void publishNumber(const char* caption, const char* icon, const char* category, const char* commandTopic, const char* stateTopic, const char* unitOfMeasure, const int16_t min, const int16_t max, const float step);
     void publishSelect(const char* caption, const char* icon, const char* category, const char* commandTopic, const char* stateTopic);
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Arduino.h>
+#include <TaskSchedulerDeclarations.h>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// publishes the Home Assistant discovery documents of all integrations at a
+// limited pace, such that a (re)connect does not flood the MQTT client's
+// outbox and delay the telemetry. the documents are only created once it is
+// their turn to be published.
+class MqttHassPublisherClass {
+public:
+    MqttHassPublisherClass();
+    void init(Scheduler& scheduler);
+
+    // a generator creates a single discovery document and passes it to
+    // publish(). the owner must cancel its generators before it is destroyed.
+    using Generator = std::function<void()>;
+    void enqueue(void const* owner, Generator&& generator);
+    void cancel(void const* owner);
+
+    // skips retained payloads which were already published to the same
+    // topic since the MQTT connection was established.
+    void publish(const String& subtopic, const String& payload);
+
+private:
+    void loop();
+    void reset();
+
+    static uint32_t hash(char const* data, size_t length, uint32_t seed = 2166136261UL);
+
+    // every tick publishes this many documents at most. documents which are
+    // skipped as they were published already do not count.
+    static constexpr size_t MessagesPerTick = 4;
+    static constexpr size_t GeneratorsPerTick = 16;
+    static constexpr uint32_t TickIntervalMs = 50;
+
+    Task _loopTask;
+
+    std::deque<std::pair<void const*, Generator>> _queue;
+
+    // pairs of topic hash and payload hash, sorted by topic hash
+    std::vector<std::pair<uint32_t, uint32_t>> _published;
+
+    size_t _publishedThisTick = 0;
+    bool _wasConnected = false;
+};
+
+extern MqttHassPublisherClass MqttHassPublisher;
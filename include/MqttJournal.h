@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// keeps MQTT messages published while the broker is not reachable, such that
+// they are sent once the connection was established again. the messages are
+// stored one after another in a single ring buffer. a retained message
+// supersedes the queued message of the same topic, as only the last state
+// matters to the broker, whereas other messages are kept as samples. the
+// oldest messages are dropped if the buffer is full.
+class MqttJournal {
+public:
+    MqttJournal() = default;
+    ~MqttJournal();
+
+    MqttJournal(MqttJournal const&) = delete;
+    MqttJournal& operator=(MqttJournal const&) = delete;
+
+    // allocates the buffer once, returns false if it cannot be allocated
+    bool allocate(size_t capacity);
+    bool isAllocated() const { return _buffer != nullptr; }
+
+    // returns false if the message does not fit into the buffer at all.
+    // older messages are dropped to make room for the message.
+    bool append(char const* topic, char const* payload, bool retain, uint8_t qos);
+
+    struct Message {
+        char const* Topic; // null-terminated, valid until pop()
+        char const* Payload; // null-terminated, valid until pop()
+        uint32_t Millis; // when the message was appended
+        bool Retain;
+        uint8_t Qos;
+    };
+
+    // the oldest message which was not superseded, returns false if empty
+    bool front(Message& message);
+    void pop();
+
+    void clear();
+
+    bool empty() const { return _messages == 0; }
+    size_t getMessages() const { return _messages; }
+    size_t getBytesUsed() const { return _used; }
+
+    // messages dropped to make room for newer ones
+    uint32_t getDropped() const { return _dropped; }
+
+private:
+    struct Header {
+        uint32_t Millis;
+        uint32_t TopicHash;
+        uint16_t TopicLength; // including the terminator
+        uint16_t PayloadLength; // including the terminator
+        uint8_t Flags;
+        uint8_t Qos;
+        uint16_t Reserved;
+    };
+
+    static constexpr uint8_t FlagRetain = 1 << 0;
+    static constexpr uint8_t FlagSuperseded = 1 << 1;
+    static constexpr uint8_t FlagWrap = 1 << 2; // the next record is at offset 0
+
+    static uint32_t hash(char const* topic);
+    static size_t recordSize(Header const& header);
+
+    // the offset of the record at or wrapped around from the given offset
+    size_t next(size_t offset) const;
+    bool reserve(size_t size, size_t& offset);
+    void dropHead();
+    void supersede(uint32_t topicHash, char const* topic);
+
+    uint8_t* _buffer = nullptr;
+    size_t _capacity = 0;
+    size_t _head = 0; // offset of the oldest record
+    size_t _tail = 0; // offset where the next record is written
+    size_t _used = 0; // bytes occupied by records
+    size_t _records = 0; // including the superseded ones
+    size_t _messages = 0; // excluding the superseded ones
+    uint32_t _dropped = 0;
+};
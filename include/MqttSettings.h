@@ -1,22 +1,48 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "MqttJournal.h"
+#include "MqttTopicRegistry.h"
 #include "NetworkSettings.h"
 #include <MqttSubscribeParser.h>
+#include <TaskSchedulerDeclarations.h>
 #include <Ticker.h>
 #include <espMqttClient.h>
+#include <atomic>
 #include <mutex>
+#include <utility>
+#include <vector>
 
 class MqttSettingsClass {
 public:
     MqttSettingsClass();
-    void init();
-    void loop();
+    void init(Scheduler& scheduler);
     void performReconnect();
     bool getConnected();
+
+    // whether published messages reach the broker, either right away or
+    // from the offline journal once the connection is established again.
+    // if this turns false, messages were lost while being offline and
+    // every value needs to be published again after reconnecting.
+    bool acceptsPublishes();
+
+    // whether the client's outbox holds as many messages as configured.
+    // values are dropped while it is, other messages shall be delayed.
+    bool isOutboxCongested();
     void publish(const String& subtopic, const String& payload);
     void publishGeneric(const String& topic, const String& payload, const bool retain, const uint8_t qos = 0);
 
+    // publishes to a topic interned by the MqttTopicRegistry, which does not
+    // allocate. numbers are formatted with the given amount of digits after
+    // the decimal point.
+    void publish(MqttTopicRegistryClass::Handle topic, const char* payload);
+    void publish(MqttTopicRegistryClass::Handle topic, double value, uint8_t digits);
+
+    // publishes all messages while acquiring the client lock only once.
+    // the topics must already include the prefix.
+    using Message = std::pair<const char*, String>;
+    void publishBatch(const std::vector<Message>& messages);
+
     void subscribe(const String& topic, const uint8_t qos, const espMqttClientTypes::OnMessageCallback& cb);
     void unsubscribe(const String& topic);
 
@@ -32,14 +58,42 @@ private:
 
     void performConnect();
     void performDisconnect();
+    void scheduleReconnect();
 
     void createMqttClientObject();
 
+    void publishRaw(const char* topic, const char* payload, const bool retain, const uint8_t qos);
+
+    // to be called while holding the client lock
+    bool isOutboxFull() const;
+    bool dropValue(const char* topic, const uint8_t qos);
+
+    // to be called while holding both locks
+    void enqueue(const char* topic, const char* payload, const bool retain, const uint8_t qos);
+    void drainJournal();
+
     MqttClient* _mqttClient = nullptr;
+
+    // read from flash while connecting, they must outlive the client
+    String _rootCaCert;
+    String _clientCert;
+    String _clientKey;
+
     Ticker _mqttReconnectTimer;
+    std::atomic<uint32_t> _reconnectDelayMillis;
+    bool _droppingValues = false;
+    uint32_t _droppedValues = 0;
     MqttSubscribeParser _mqttSubscribeParser;
     std::mutex _clientLock;
     bool _verboseLogging = true;
+
+    // acquired before the client lock. while the journal is not empty,
+    // new messages are appended to it, such that the order is kept and
+    // the messages are sent at a limited rate after reconnecting.
+    std::mutex _journalLock;
+    MqttJournal _journal;
+    std::atomic<bool> _journalOverflow = false;
+    Task _journalTask;
 };
 
 extern MqttSettingsClass MqttSettings;
@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// interns the topics of values which are published regularly. a topic is
+// stored once with the prefix prepended and is only rebuilt if the prefix
+// changed, such that publishing a value by its handle allocates nothing.
+class MqttTopicRegistryClass {
+public:
+    using Handle = uint16_t;
+    static constexpr Handle Invalid = UINT16_MAX;
+
+    // returns the handle of the subtopic made of the given parts, which is
+    // interned on first use. looking up a known subtopic does not allocate,
+    // such that this can be called for every publish. returns Invalid if
+    // the registry is full.
+    Handle intern(char const* part1, char const* part2 = "", char const* part3 = "");
+
+    // calls the function with the full topic, which is valid during the
+    // call only. returns false if the handle is invalid.
+    template<typename F>
+    bool withTopic(Handle handle, char const* prefix, F&& function)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (handle >= _topics.size()) { return false; }
+        if (_prefix != prefix) { rebuild(prefix); }
+        function(_topics[handle].c_str());
+        return true;
+    }
+
+private:
+    // topics are added for every device, the limit guards against topics
+    // containing a changing part by mistake.
+    static constexpr size_t MaxTopics = 512;
+
+    void rebuild(char const* prefix);
+
+    std::mutex _mutex;
+    std::vector<std::pair<uint32_t, Handle>> _index; // sorted by hash
+    std::vector<std::string> _subtopics;
+    std::vector<std::string> _topics;
+    std::string _prefix;
+    bool _fullReported = false;
+};
+
+extern MqttTopicRegistryClass MqttTopicRegistry;
@@ -5,6 +5,8 @@
 #include <DNSServer.h>
 #include <TaskSchedulerDeclarations.h>
 #include <WiFi.h>
+#include <atomic>
+#include <optional>
 #include <vector>
 
 enum class network_mode {
@@ -21,6 +23,7 @@ enum class network_event {
     NETWORK_DISCONNECTED,
     NETWORK_GOT_IP,
     NETWORK_LOST_IP,
+    NETWORK_FAILOVER, // the default route moved to the other interface
     NETWORK_EVENT_MAX
 };
 
@@ -54,16 +57,63 @@ public:
     bool isConnected() const;
     network_mode NetworkMode() const;
 
+    // traffic of the W5500 Ethernet controller, if present
+    std::optional<W5500::Stats> getW5500Stats();
+
+    // uses the maximum modem sleep while connected to a WiFi access point
+    void setLowPowerMode(bool enabled);
+
+    // whether WiFi is kept connected while Ethernet is in use, such that
+    // the default route is moved to WiFi right away if Ethernet fails.
+    // requires an Ethernet interface, a configured SSID and DHCP.
+    bool isFailoverEnabled() const;
+
+    // incremented whenever the default route moved to the other interface.
+    // connections opened before are bound to the previous interface and
+    // should be reopened.
+    uint32_t getRouteGeneration() const { return _routeGeneration; }
+
     bool onEvent(DtuNetworkEventCb cbEvent, const network_event event = network_event::NETWORK_EVENT_MAX);
     void raiseEvent(const network_event event);
 
 private:
     void loop();
-    void setHostname();
-    void setStaticIp();
+    void setHostname(network_mode mode);
+    void setStaticIp(network_mode mode);
+    void moveDefaultRoute();
+    void applyDefaultRoute();
     void handleMDNS();
     void setupMode();
     void NetworkEvent(const WiFiEvent_t event, WiFiEventInfo_t info);
+    void connectWiFi(bool fast);
+    void handleWiFiReconnect();
+    void loadFastConnect();
+    void storeFastConnect();
+
+    // the access point which was last connected to. it is tried first,
+    // such that associating does not need to scan all channels.
+    struct FastConnect {
+        uint32_t SsidHash;
+        uint8_t Bssid[6];
+        uint8_t Channel;
+    };
+    FastConnect _fastConnect = {};
+    bool _fastConnectValid = false;
+    bool _fastConnectPending = false;
+    uint32_t _connectStartMillis = 0;
+
+    // if the fast connect does not succeed in time, all channels are scanned
+    static constexpr uint32_t FastConnectTimeoutMillis = 3000;
+    static constexpr uint32_t ReconnectBackoffMinMillis = 500;
+    static constexpr uint32_t ReconnectBackoffMaxMillis = 30 * 1000;
+
+    // set by the WiFi event handler, which runs in a task of its own
+    std::atomic<bool> _wifiDisconnected = false;
+    std::atomic<bool> _wifiConnected = false;
+
+    bool _reconnectScheduled = false;
+    uint32_t _reconnectBackoffMillis = 0;
+    uint32_t _disconnectMillis = 0;
 
     Task _loopTask;
 
@@ -82,6 +132,17 @@ private:
     bool _dnsServerStatus = false;
     network_mode _networkMode = network_mode::Undefined;
     bool _ethConnected = false;
+    bool _ethAvailable = false;
+
+    // Ethernet is configured when its link comes up, before it is used
+    bool _ethConfigured = false;
+
+    // esp_netif picks the default route by a fixed priority whenever an
+    // interface changes, which prefers WiFi. with failover, the route is
+    // set again after such changes.
+    std::atomic<bool> _failover = false;
+    std::atomic<bool> _routeDirty = false;
+    std::atomic<uint32_t> _routeGeneration = 0;
     std::vector<DtuNetworkEventCbList_t> _cbEventList;
     bool _lastMdnsEnabled = false;
     std::unique_ptr<W5500> _w5500;
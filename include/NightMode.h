@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <TaskSchedulerDeclarations.h>
+#include <atomic>
+#include <vector>
+
+// reduces the power consumption at night while no battery-powered inverter
+// is producing: inverters without high poll priority are polled less often,
+// registered tasks run less often, WiFi uses modem sleep and the CPU runs at
+// a lower clock. leaves the low-power mode on web or MQTT activity.
+class NightModeClass {
+public:
+    NightModeClass();
+    void init(Scheduler& scheduler);
+
+    // the task's interval is stretched while the low-power mode is active
+    void addIdleTask(Task& task);
+
+    // thread-safe. leaves the low-power mode for a while.
+    void notifyActivity();
+
+    bool isActive() const { return _active; }
+
+private:
+    void loop();
+    bool shouldBeActive() const;
+    void enter();
+    void leave();
+
+    static constexpr uint32_t ActivityTimeoutMillis = 5 * 60 * 1000;
+    static constexpr uint8_t PollFactor = 8;
+    static constexpr uint8_t TaskFactor = 6;
+    static constexpr uint32_t CpuFrequencyMhz = 80;
+
+    Task _loopTask;
+
+    struct IdleTask {
+        Task* pTask;
+        unsigned long DayInterval;
+    };
+    std::vector<IdleTask> _idleTasks;
+
+    std::atomic<uint32_t> _lastActivityMillis = 0;
+    std::atomic<bool> _activity = false;
+    bool _active = false;
+    uint32_t _dayCpuFrequencyMhz = 0;
+};
+
+extern NightModeClass NightMode;
@@ -8,6 +8,11 @@ public:
 
     void setServer();
     void setTimezone();
+
+    // sets the system time from the Date header of an HTTP response (e.g.,
+    // of a power meter) unless the time is known already, which bridges
+    // the time until NTP answers after a cold start. thread-safe.
+    void setTimeFromHttpDate(char const* date);
 };
 
 extern NtpSettingsClass NtpSettings;
\ No newline at end of file
@@ -3,9 +3,11 @@
 
 #include <Arduino.h>
 #include <ETH.h>
+#include <FS.h>
 #include <stdint.h>
 
 #define PINMAPPING_FILENAME "/pin_mapping.json"
+#define PINMAPPING_CACHE_FILENAME "/pin_mapping.bin"
 #define PINMAPPING_LED_COUNT 2
 
 #define MAPPING_NAME_STRLEN 31
@@ -33,6 +35,7 @@ struct PinMapping_t {
     int8_t w5500_cs;
     int8_t w5500_int;
     int8_t w5500_rst;
+    uint8_t w5500_spi_mhz;
 
 #if CONFIG_ETH_USE_ESP32_EMAC
     int8_t eth_phy_addr;
@@ -59,10 +62,16 @@ struct PinMapping_t {
     int8_t victron_rx2;
     int8_t victron_tx3;
     int8_t victron_rx3;
+    int8_t victron_tx4;
+    int8_t victron_rx4;
     int8_t battery_rx;
     int8_t battery_rxen;
     int8_t battery_tx;
     int8_t battery_txen;
+    int8_t battery2_rx; // for a second battery provider
+    int8_t battery2_rxen;
+    int8_t battery2_tx;
+    int8_t battery2_txen;
     int8_t huawei_miso;
     int8_t huawei_mosi;
     int8_t huawei_clk;
@@ -94,6 +103,9 @@ public:
 #endif
 
 private:
+    bool readCache(fs::File& json, const String& deviceMapping);
+    void writeCache(fs::File& json);
+
     PinMapping_t _pinMapping;
 
     bool _mappingSelected = false;
@@ -3,8 +3,14 @@
 
 #include "Configuration.h"
 #include "PowerLimiterInverter.h"
+#include "PowerLimiterScorecard.h"
+#include "PowerLimiterShadow.h"
+#include "PowerLimiterTrace.h"
+#include <battery/ResistanceEstimator.h>
+#include <battery/SocEstimator.h>
 #include <espMqttClient.h>
 #include <Arduino.h>
+#include <array>
 #include <atomic>
 #include <deque>
 #include <memory>
@@ -36,9 +42,17 @@ public:
         Stable,
     };
 
+    // snake case name, as used by the web API and MQTT
+    static char const* getStatusKey(Status status);
+
     void init(Scheduler& scheduler);
-    void triggerReloadingConfig() { _reloadConfigFlag = true; }
+    void triggerReloadingConfig() { _reloadConfigFlag = true; triggerCalculation(); }
+
+    // thread-safe. wakes up the DPL if it is idle, e.g., because a new power
+    // meter reading or new inverter stats are available.
+    void triggerCalculation() { _calculationTriggered = true; }
     uint8_t getInverterUpdateTimeouts() const;
+    uint32_t getSuppressedLimitUpdates() const { return _suppressedLimitUpdates; }
     uint8_t getPowerLimiterState();
     int32_t getInverterOutput() { return _lastExpectedInverterOutput; }
     bool getFullSolarPassThroughEnabled() const { return _fullSolarPassThroughEnabled; }
@@ -49,7 +63,7 @@ public:
         UnconditionalFullSolarPassthrough = 2
     };
 
-    void setMode(Mode m) { _mode = m; }
+    void setMode(Mode m) { _mode = m; triggerCalculation(); }
     Mode getMode() const { return _mode; }
     bool usesBatteryPoweredInverter();
     bool usesSmartBufferPoweredInverter();
@@ -57,20 +71,68 @@ public:
     // used to interlock Huawei R48xx grid charger against battery-powered inverters
     bool isGovernedBatteryPoweredInverterProducing();
 
+    // the AC power the inverters behind the power meter produced at the
+    // given time, according to their output history.
+    uint16_t getBehindPowerMeterOutputAt(uint32_t at) const;
+
+    // the power dissipated by the governed inverters, as calculated using
+    // their efficiency curves
+    float getInverterLossesWatts() const { return _inverterLossesWatts; }
+
+    // the estimated internal resistance of the battery in Ohm (0 if not yet
+    // known) and the coefficient of determination of its fit
+    float getBatteryResistance() const { return _batteryResistance; }
+    float getBatteryResistanceFitQuality() const { return _batteryResistanceFitQuality; }
+
+    // thread-safe
+    PowerLimiterTrace const& getTrace() const { return _trace; }
+
+    // thread-safe. the comparison with the alternate settings, which is
+    // reset whenever the settings are saved.
+    PowerLimiterShadow const& getShadow() const { return _shadow; }
+
+    // thread-safe. the control quality per quarter hour and per day.
+    PowerLimiterScorecard const& getScorecard() const { return _scorecard; }
+
+    // the AC power the governed inverters produce and the power they could
+    // produce on top of that, as reported to the leader of a DPL cluster.
+    uint16_t getGovernedOutputWatts() const;
+    uint16_t getGovernedMaxIncreaseWatts() const;
+
+    // false while the inverters are adjusting to the last calculation
+    bool isSettled() const { return _settled; }
+
 private:
     void loop();
 
     Task _loopTask;
 
     std::atomic<bool> _reloadConfigFlag = true;
+    std::atomic<bool> _calculationTriggered = false;
     uint16_t _lastExpectedInverterOutput = 0;
+    std::atomic<float> _inverterLossesWatts = 0;
     Status _lastStatus = Status::Initializing;
     uint32_t _lastStatusPrinted = 0;
+    bool _settled = false;
+    Status _lastStoredStatus = Status::Initializing;
+    std::atomic<uint32_t> _suppressedLimitUpdates = 0;
     uint32_t _lastCalculation = 0;
     static constexpr uint32_t _calculationBackoffMsDefault = 128;
     uint32_t _calculationBackoffMs = _calculationBackoffMsDefault;
+
+    // while idle, the DPL loop returns early until it is woken up through
+    // triggerCalculation() or until the idle duration elapsed.
+    static constexpr uint32_t _idleHeartbeatMs = 1000;
+    uint32_t _idleSince = 0;
+    uint32_t _idleDurationMs = 0;
+    void idle(uint32_t durationMs);
     Mode _mode = Mode::Normal;
 
+    // the values of the current loop pass, recorded once its status is known
+    PowerLimiterTrace _trace;
+    PowerLimiterTrace::Record _traceRecord = {};
+    void recordTrace(Status status);
+
     std::deque<std::unique_ptr<PowerLimiterInverter>> _inverters;
     bool _batteryDischargeEnabled = false;
     bool _nighttimeDischarging = false;
@@ -88,17 +150,62 @@ private:
     uint16_t dcPowerBusToInverterAc(uint16_t dcPower);
     void unconditionalFullSolarPassthrough();
     int16_t calcConsumption();
-    using inverter_filter_t = std::function<bool(PowerLimiterInverter const&)>;
-    uint16_t updateInverterLimits(uint16_t powerRequested, inverter_filter_t filter, std::string const& filterExpression);
+
+    // the inverters a calculation step applies to. their amount is bounded,
+    // so they are collected without allocating memory.
+    class InverterSelection {
+    public:
+        void push_back(PowerLimiterInverter* pInv) {
+            if (_size < _inverters.size()) { _inverters[_size++] = pInv; }
+        }
+        bool empty() const { return _size == 0; }
+        size_t size() const { return _size; }
+        PowerLimiterInverter* operator[](size_t idx) const { return _inverters[idx]; }
+        PowerLimiterInverter** begin() { return _inverters.data(); }
+        PowerLimiterInverter** end() { return _inverters.data() + _size; }
+        PowerLimiterInverter* const* begin() const { return _inverters.data(); }
+        PowerLimiterInverter* const* end() const { return _inverters.data() + _size; }
+
+    private:
+        std::array<PowerLimiterInverter*, INV_MAX_COUNT> _inverters;
+        size_t _size = 0;
+    };
+
+    template<typename Filter>
+    uint16_t updateInverterLimits(uint16_t powerRequested, Filter const& filter,
+            char const* filterExpression, bool efficiencyAware = false);
+    uint16_t distributeByEfficiency(uint16_t powerRequested,
+            InverterSelection const& inverters, uint16_t hysteresis);
+    bool isEfficiencyAware() const;
     uint16_t calcPowerBusUsage(uint16_t powerRequested);
     bool updateInverters();
     uint16_t getSolarPassthroughPower();
+
+    // the output of the solar charge controllers, optionally forecast to
+    // the current time to compensate for the age of their data.
+    std::optional<float> getSolarChargerOutputWatts() const;
     std::optional<uint16_t> getBatteryDischargeLimit();
     float getBatteryInvertersOutputAcWatts();
 
     std::optional<float> _oLoadCorrectedVoltage = std::nullopt;
     float getLoadCorrectedVoltage();
 
+    Batteries::ResistanceEstimator _resistanceEstimator;
+    uint32_t _lastResistanceSample = 0;
+    std::atomic<float> _batteryResistance = 0;
+    std::atomic<float> _batteryResistanceFitQuality = 0;
+    std::optional<float> getBatteryCurrent();
+    void updateResistanceEstimate();
+
+    Batteries::SocEstimator _socEstimator;
+    void updateSocEstimate();
+
+    PowerLimiterShadow _shadow;
+    void updateShadow(int16_t consumption, uint16_t unrestricted, bool limitsUpdated);
+
+    PowerLimiterScorecard _scorecard;
+    void updateScorecard(Status status);
+
     bool testThreshold(float socThreshold, float voltThreshold,
             std::function<bool(float, float)> compare);
     bool isStartThresholdReached();
@@ -3,6 +3,7 @@
 
 #include "Configuration.h"
 #include <Hoymiles.h>
+#include <array>
 #include <optional>
 #include <memory>
 
@@ -10,6 +11,8 @@ class PowerLimiterInverter {
 public:
     static std::unique_ptr<PowerLimiterInverter> create(bool verboseLogging, PowerLimiterInverterConfig const& config);
 
+    virtual ~PowerLimiterInverter();
+
     // send command(s) to inverter to reach desired target state (limit and
     // production). return true if an update is pending, i.e., if the target
     // state is NOT yet reached, false otherwise.
@@ -20,9 +23,24 @@ public:
     // are pending after the last command completed.
     std::optional<uint32_t> getLatestStatsMillis() const;
 
+    // like getLatestStatsMillis(), but while stats are pending after a limit
+    // command, returns the time at which the output is expected to have
+    // settled according to the learned response model, once it passed.
+    std::optional<uint32_t> getSettledMillis() const;
+
     // the amount of times an update command issued to the inverter timed out
     uint8_t getUpdateTimeouts() const { return _updateTimeouts; }
 
+    // takes the values which the decisions of a DPL cycle are based on from
+    // the inverter's stats, such that they are looked up once per cycle and
+    // all decisions of the cycle use the same values, even if new stats
+    // arrive or the modelled output progresses meanwhile. until endCycle(),
+    // the respective getters return the values taken. applying a reduction
+    // or increase only changes the target and the expected output, so the
+    // values need no update within the cycle.
+    void beginCycle();
+    void endCycle() { _oCycle = std::nullopt; }
+
     // maximum amount of AC power the inverter is able to produce
     // (not regarding the configured upper power limit)
     uint16_t getInverterMaxPowerWatts() const;
@@ -31,11 +49,25 @@ public:
     // upper power limit (additionally restricted by inverter's absolute max)
     uint16_t getConfiguredMaxPowerWatts() const;
 
+    // the output as reported by the latest stats, or as estimated using the
+    // response model until stats following the last limit command arrive.
     uint16_t getCurrentOutputAcWatts() const;
 
     // this differs from current output power if new limit was assigned
     uint16_t getExpectedOutputAcWatts() const;
 
+    // the AC power the inverter was known or expected to produce at the
+    // given time. a new limit is considered effective once it was reached.
+    uint16_t getOutputAcWattsAt(uint32_t at) const;
+
+    // the share of DC input power that is converted to AC power when
+    // producing the given AC power. starts out with a typical curve, which
+    // is adjusted using the efficiency reported by the inverter.
+    float getEfficiencyAt(uint16_t acWatts) const;
+
+    // the power dissipated by the inverter when producing the given AC power
+    float getLossesWattsAt(uint16_t acWatts) const;
+
     // the maximum reduction of power output the inverter
     // can achieve with or withouth going into standby.
     virtual uint16_t getMaxReductionWatts(bool allowStandby) const = 0;
@@ -65,9 +97,14 @@ public:
     bool isReachable() const { return _spInverter->isReachable(); }
     bool isProducing() const { return _spInverter->isProducing(); }
 
+    // the commands waiting for the radio this inverter is attached to,
+    // including the polls for the statistics of all of its inverters
+    uint32_t getRadioQueueSize() const { return _spInverter->getRadio()->getQueueSize(); }
+
     uint64_t getSerial() const { return _config.Serial; }
     char const* getSerialStr() const { return _serialStr; }
     bool isBehindPowerMeter() const { return _config.IsBehindPowerMeter; }
+    uint16_t getLowerPowerLimitWatts() const { return _config.LowerPowerLimit; }
 
     bool isBatteryPowered() const { return _config.PowerSource == PowerLimiterInverterConfig::InverterPowerSource::Battery; }
     bool isSolarPowered() const { return _config.PowerSource == PowerLimiterInverterConfig::InverterPowerSource::Solar; }
@@ -98,6 +135,16 @@ protected:
 
     static char mpptName(MpptNum_t mppt);
 
+    // the AC power contributed by each MPPT (in the order of getMppt()), as
+    // derived from the DC power of its channels. all values are read from
+    // the same stats.
+    using MpptAcPowers = std::array<float, MPPT_CNT>;
+    MpptAcPowers getMpptAcPowers(float efficiencyFactor) const;
+
+    size_t getMpptCount() const { return _mpptCount; }
+    MpptNum_t getMppt(size_t idx) const { return _mppts[idx].Mppt; }
+    size_t getDcChannelCount() const { return _dcChannelCount; }
+
     // copied to avoid races with web UI
     PowerLimiterInverterConfig _config;
 
@@ -110,8 +157,26 @@ protected:
 private:
     virtual void setAcOutput(uint16_t expectedOutputWatts) = 0;
 
+    bool updateState();
+    void trackOutput();
+    void learnEfficiency();
+    void learnResponse();
+    uint16_t getMeasuredOutputAcWatts() const;
+    std::optional<uint16_t> getModelledOutputAcWattsAt(uint32_t at) const;
+
     char _serialStr[16];
 
+    // the inverter's DC channels grouped by MPPT, which is determined once,
+    // as it is needed to calculate each limit of solar-powered inverters
+    struct MpptChannels {
+        MpptNum_t Mppt;
+        uint8_t ChannelCount;
+        std::array<ChannelNum_t, CH_CNT> Channels;
+    };
+    std::array<MpptChannels, MPPT_CNT> _mppts;
+    uint8_t _mpptCount = 0;
+    uint8_t _dcChannelCount = 0;
+
     // track (target) state
     uint8_t _updateTimeouts = 0;
     std::optional<uint32_t> _oUpdateStartMillis = std::nullopt;
@@ -121,4 +186,49 @@ private:
 
     // the expected AC output (possibly is different from the target limit)
     uint16_t _expectedOutputAcWatts = 0;
+
+    // ring buffer of output changes, recorded while no update is pending
+    struct OutputSample {
+        uint32_t Millis;
+        uint16_t Watts;
+    };
+    static constexpr size_t OutputHistorySize = 16;
+    std::array<OutputSample, OutputHistorySize> _outputHistory;
+    size_t _outputSamples = 0; // total amount of samples recorded
+
+    // efficiency per tenth of the inverter's max power, where each value
+    // belongs to the center of its load range
+    static constexpr size_t EfficiencyBuckets = 10;
+    std::array<float, EfficiencyBuckets> _efficiency;
+    uint32_t _lastEfficiencyStats = 0;
+
+    // step response to limit changes, learned from the stats following each
+    // limit command: the time until the output starts to change, and the
+    // rate at which it approaches the new limit afterwards.
+    struct ResponseModel {
+        float DeadTimeMillis = 0;
+        float RampWattsPerSecond = 0;
+        uint8_t Samples = 0;
+    };
+    static constexpr uint8_t MinResponseSamples = 3;
+    ResponseModel _responseModel;
+
+    // the last limit change, which is observed to learn the model and
+    // which the estimated output refers to
+    struct Step {
+        uint32_t Millis; // the limit command was acknowledged
+        uint16_t FromWatts;
+        uint16_t ToWatts;
+        uint32_t LastStatsMillis;
+        std::optional<uint32_t> oResponseMillis; // the output started to change
+    };
+    std::optional<Step> _oStep = std::nullopt;
+
+    struct CycleValues {
+        Eligibility Eligible;
+        uint16_t InverterMaxPowerWatts;
+        uint16_t CurrentLimitWatts;
+        uint16_t CurrentOutputAcWatts;
+    };
+    std::optional<CycleValues> _oCycle = std::nullopt;
 };
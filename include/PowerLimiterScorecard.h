@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <optional>
+#include <stdint.h>
+
+// grades the live DPL over windows aligned to the wall clock: the energy
+// imported from and exported to the grid while the DPL was active, the mean
+// absolute deviation of the grid power from the target consumption, the
+// number of limit updates, the mean reaction latency and the share of time
+// spent in each status. every loop pass of the DPL is accounted for in
+// constant time, the state of a pass holds until the next pass. the results
+// of a window are published to MQTT once the window completed.
+class PowerLimiterScorecard {
+public:
+    // the amount of PowerLimiterClass::Status values
+    static constexpr size_t StatusCount = 11;
+
+    enum class Window : uint8_t {
+        QuarterHour,
+        Day // local day
+    };
+    static constexpr size_t WindowCount = static_cast<size_t>(Window::Day) + 1;
+
+    static char const* getName(Window window);
+
+    // the state of the DPL at the end of a loop pass
+    struct Inputs {
+        uint32_t Millis;
+        uint32_t Timestamp; // unix time, zero or in the past if not yet known
+        uint8_t Status;
+        bool Active; // neither disabled nor waiting for the time
+        std::optional<float> oGridWatts; // positive if importing
+        std::optional<int16_t> oTargetWatts; // unset if not under own control
+    };
+
+    struct Result {
+        uint32_t Start; // unix timestamp of the start of the window
+        uint32_t Seconds; // time covered by the figures below
+        uint32_t ActiveSeconds;
+        float ImportWh; // while active
+        float ExportWh;
+        std::optional<float> oMeanAbsErrorWatts;
+        uint32_t Commands; // calculations which changed the limits
+        uint32_t Reactions; // limit acknowledgments measured
+        std::optional<float> oMeanReactionMillis;
+        std::array<float, StatusCount> StatusPercent;
+    };
+
+    // to be called at the end of every loop pass of the DPL
+    void update(Inputs const& inputs);
+
+    // to be called when a calculation sent new limits
+    void countCommand();
+
+    // thread-safe. nullopt if the window did not start yet.
+    std::optional<Result> getCurrent(Window window) const;
+    std::optional<Result> getCompleted(Window window) const;
+
+private:
+    struct Accumulator {
+        uint32_t Start = 0;
+        uint32_t End = 0;
+        uint32_t CoveredMillis = 0;
+        uint32_t ActiveMillis = 0;
+        uint32_t ErrorMillis = 0;
+        double ImportWh = 0;
+        double ExportWh = 0;
+        double AbsErrorWattMillis = 0;
+        uint32_t Commands = 0;
+        uint32_t ReactionsAtStart = 0; // baseline of the latency totals
+        uint64_t ReactionMillisAtStart = 0;
+        std::array<uint32_t, StatusCount> StatusMillis = {};
+
+        Result getResult(uint32_t reactions, uint64_t reactionMillis) const;
+    };
+
+    void account(uint32_t elapsedMillis);
+    void publish(Window window);
+    static uint32_t getWindowStart(Window window, uint32_t timestamp);
+    static uint32_t getWindowEnd(Window window, uint32_t start);
+
+    // gaps longer than this, e.g., while the DPL task was blocked, are not
+    // attributed to any status.
+    static constexpr uint32_t MaxGapMillis = 60 * 1000;
+
+    // any earlier time was not set by NTP or the RTC
+    static constexpr uint32_t MinValidTimestamp = 1451606400; // 2016-01-01
+
+    mutable std::mutex _mutex;
+    std::optional<Inputs> _oLast = std::nullopt;
+    std::array<Accumulator, WindowCount> _current;
+    std::array<std::optional<Result>, WindowCount> _completed;
+};
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <mutex>
+#include <optional>
+#include <stdint.h>
+
+// evaluates an alternate set of DPL settings against the inputs of the live
+// DPL, without commanding any inverter. each calculation of the live DPL is
+// mirrored: the shadow applies its own target consumption, hysteresis and
+// battery thresholds to the same load, battery state and solar power, and
+// keeps track of the total limit it would have commanded. the grid power
+// which would have resulted is integrated into import and export energy,
+// next to the energy actually measured, such that both configurations can
+// be compared under the same real load.
+//
+// the shadow does not model the individual inverters: it assumes the total
+// limit to be reached immediately and all governed inverters to be behind
+// the power meter.
+class PowerLimiterShadow {
+public:
+    // the inputs of one calculation of the live DPL
+    struct Inputs {
+        uint32_t Millis;
+        float LoadWatts; // household load including the inverters' output
+        std::optional<float> oGridWatts; // as measured, positive if importing
+        uint16_t UpperLimitWatts; // total upper power limit
+        // possible without discharging the battery: the power the live DPL
+        // assigned to inverters not powered by the battery, plus the power
+        // available for solar-passthrough
+        uint16_t UnrestrictedWatts;
+        bool StartThresholdReached; // as per the shadow thresholds
+        bool StopThresholdReached;
+        bool LiveDischarge; // the live DPL allows discharging the battery
+        bool LiveLimitsUpdated; // the live DPL sent new limits
+    };
+
+    // the figures accumulated for either configuration
+    struct Totals {
+        double ImportWh;
+        double ExportWh;
+        uint32_t Commands; // calculations which changed the limits
+        uint32_t Flaps; // changes between charging and discharging
+    };
+
+    struct Summary {
+        bool Active;
+        uint32_t Cycles; // calculations evaluated
+        uint32_t Seconds; // time covered by the energy figures
+        uint16_t LimitWatts; // the shadow's current total limit
+        bool Discharge; // the shadow allows discharging the battery
+        Totals Live;
+        Totals Shadow;
+    };
+
+    // to be called once per calculation of the live DPL
+    void update(Inputs const& inputs, int16_t targetConsumption, uint16_t hysteresis);
+
+    void reset();
+
+    // thread-safe
+    Summary getSummary() const;
+
+private:
+    static void accumulate(Totals& totals, float gridWatts, uint32_t elapsedMillis);
+
+    // gaps longer than this, e.g., while the DPL was disabled, are not
+    // attributed to either configuration.
+    static constexpr uint32_t MaxGapMillis = 60 * 1000;
+
+    mutable std::mutex _mutex;
+    std::optional<uint32_t> _oLastMillis = std::nullopt;
+    std::optional<bool> _oLiveDischarge = std::nullopt;
+    std::optional<bool> _oDischarge = std::nullopt;
+    uint16_t _limitWatts = 0;
+    uint32_t _cycles = 0;
+    uint32_t _coveredMillis = 0;
+    Totals _live = {};
+    Totals _shadow = {};
+};
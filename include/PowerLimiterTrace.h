@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "Configuration.h"
+#include <mutex>
+#include <stdint.h>
+
+// records one fixed-size record per pass of the DPL loop into a ring buffer
+// in RAM, such that the DPL's decisions can be reconstructed without verbose
+// logging. consecutive passes which did not calculate anything and did not
+// change anything are folded into one record.
+class PowerLimiterTrace {
+public:
+    struct Inverter {
+        uint32_t Serial; // lower 32 bits
+        uint16_t TargetWatts; // expected output once commands completed
+        uint16_t OutputWatts;
+    };
+
+    struct Record {
+        uint32_t Millis;
+        int16_t Consumption; // only valid if FlagCalculated is set
+        uint16_t CoveredBySolar;
+        uint16_t CoveredBySmartBuffer;
+        uint16_t CoveredByBattery;
+        uint16_t PowerMeterAgeMillis; // saturates at UINT16_MAX
+        uint16_t StatsAgeMillis; // age of the oldest stats used, saturates
+        uint8_t Status; // PowerLimiterClass::Status
+        uint8_t Flags;
+        uint8_t Repeats; // amount of identical passes folded into this one
+        uint8_t InverterCount;
+        Inverter Inverters[INV_MAX_COUNT];
+    };
+
+    static constexpr uint8_t FlagCalculated = 1 << 0;
+    static constexpr uint8_t FlagLimitsUpdated = 1 << 1;
+    static constexpr uint8_t FlagBatteryDischarge = 1 << 2;
+    static constexpr uint8_t FlagFullSolarPassthrough = 1 << 3;
+
+    // precedes the records when downloading the trace
+    struct Header {
+        char Magic[4]; // "DPLT"
+        uint8_t Version;
+        uint8_t MaxInverters;
+        uint16_t RecordSize;
+        uint32_t Count;
+        uint32_t Millis; // the time the download started
+    };
+
+    void record(Record const& record);
+
+    // records are identified by a sequence number, which increases with
+    // every record. [first, end) are the records currently available.
+    std::pair<uint32_t, uint32_t> getSequenceRange() const;
+
+    // returns false if the record was overwritten meanwhile
+    bool read(uint32_t sequence, Record& record) const;
+
+private:
+    void allocate();
+
+    mutable std::mutex _mutex;
+    Record* _records = nullptr;
+    size_t _capacity = 0;
+    uint32_t _end = 0; // sequence number of the next record
+};
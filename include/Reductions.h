@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdint.h>
+#include <type_traits>
+
+// reductions over contiguous arrays of integers, e.g., to decimate long
+// buffers of samples for drawing. each loop keeps four independent
+// accumulators, such that a step does not wait for the result of the
+// previous one. the sum of 16 bit values is 32 bits wide, i.e., it does not
+// overflow for up to 65536 values. the sum of 32 bit values is 64 bits wide.
+namespace Reductions {
+
+template<typename T>
+using sum_t = std::conditional_t<(sizeof(T) <= 2),
+    std::conditional_t<std::is_signed_v<T>, int32_t, uint32_t>,
+    std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t>>;
+
+template<typename T>
+T min(T const* values, size_t count, T init)
+{
+    static_assert(std::is_integral_v<T>, "integers only");
+
+    T m0 = init, m1 = init, m2 = init, m3 = init;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        m0 = std::min(m0, values[i]);
+        m1 = std::min(m1, values[i + 1]);
+        m2 = std::min(m2, values[i + 2]);
+        m3 = std::min(m3, values[i + 3]);
+    }
+    for (; i < count; ++i) { m0 = std::min(m0, values[i]); }
+
+    return std::min(std::min(m0, m1), std::min(m2, m3));
+}
+
+template<typename T>
+T max(T const* values, size_t count, T init)
+{
+    static_assert(std::is_integral_v<T>, "integers only");
+
+    T m0 = init, m1 = init, m2 = init, m3 = init;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        m0 = std::max(m0, values[i]);
+        m1 = std::max(m1, values[i + 1]);
+        m2 = std::max(m2, values[i + 2]);
+        m3 = std::max(m3, values[i + 3]);
+    }
+    for (; i < count; ++i) { m0 = std::max(m0, values[i]); }
+
+    return std::max(std::max(m0, m1), std::max(m2, m3));
+}
+
+template<typename T>
+sum_t<T> sum(T const* values, size_t count)
+{
+    static_assert(std::is_integral_v<T>, "integers only");
+
+    sum_t<T> s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        s0 += values[i];
+        s1 += values[i + 1];
+        s2 += values[i + 2];
+        s3 += values[i + 3];
+    }
+    for (; i < count; ++i) { s0 += values[i]; }
+
+    return (s0 + s1) + (s2 + s3);
+}
+
+// zero if there are no values
+template<typename T>
+T mean(T const* values, size_t count)
+{
+    if (count == 0) { return 0; }
+    return static_cast<T>(sum(values, count) / static_cast<sum_t<T>>(count));
+}
+
+} // namespace Reductions
@@ -3,4 +3,8 @@
 
 #include <TaskSchedulerDeclarations.h>
 
-extern Scheduler scheduler;
\ No newline at end of file
+extern Scheduler scheduler;
+
+// runs the tasks which are due, to be called from the Arduino loop. blocks
+// the loop task for a tick if no task was due.
+void executeScheduler();
@@ -1,7 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <HardwareSerial.h>
 #include <array>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <vector>
@@ -14,15 +18,64 @@ public:
 
     std::optional<uint8_t> allocatePort(std::string const& owner);
     void freePort(std::string const& owner);
+    bool hasFreePort() const;
 
-    using allocations_t = std::vector<std::pair<int8_t, std::string>>;
+    // software UARTs (GPIO interrupt driven) are not a scarce resource, but
+    // are recorded such that they show up in the list of allocations.
+    void registerSoftwarePort(std::string const& owner);
+
+    // low-rate owners, which poll their device every few seconds, share a
+    // single hardware UART, which is owned by the port manager. an owner
+    // uses the shared UART exclusively during a window, for which the pins
+    // and line settings of that owner are applied.
+    struct SharedPortConfig {
+        uint32_t Baud;
+        uint32_t Config; // e.g., SERIAL_8N1
+        int8_t RxPin;
+        int8_t TxPin;
+    };
+    bool allocateSharedPort(std::string const& owner, SharedPortConfig const& config);
+
+    // returns the shared UART if the owner may use it until it calls
+    // releaseWindow(), or nullptr while another owner holds a window. does
+    // not block, may be called from any task.
+    HardwareSerial* acquireWindow(std::string const& owner);
+    void releaseWindow(std::string const& owner);
+
+    // port number reported for owners using a software UART
+    static int8_t constexpr SoftwarePort = -2;
+
+    struct Allocation {
+        int8_t Port; // -1 if rejected
+        std::string Owner;
+        bool Shared;
+    };
+    using allocations_t = std::vector<Allocation>;
     allocations_t getAllocations() const;
 
 private:
+    void freeHardwarePort(std::string const& owner);
+    bool freeSharedPort(std::string const& owner);
+
     // the amount of hardare UARTs available on supported ESP32 chips
     static size_t constexpr _num_controllers = 3;
     std::array<std::string, _num_controllers> _ports = { "" };
     std::set<std::string> _rejects;
+    std::set<std::string> _softwarePorts;
+
+    // the owner of the hardware port which is shared by time-slicing
+    static char constexpr _sharedPortOwner[] = "Time-Sliced UART";
+
+    // holds the responses of all owners, which are only read once the
+    // response is complete, e.g. 300 bytes by a JK BMS
+    static size_t constexpr _sharedRxBufferSize = 1024;
+
+    // the owners of the shared port call from their own tasks
+    mutable std::mutex _sharedMutex;
+    std::unique_ptr<HardwareSerial> _upSharedSerial = nullptr;
+    std::map<std::string, SharedPortConfig> _sharedOwners;
+    std::string _windowOwner; // empty if no window is open
+    std::string _configuredOwner; // whose settings are applied to the UART
 };
 
 extern SerialPortManagerClass SerialPortManager;
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <HardwareSerial.h>
+#include <TaskPlacement.h>
+#include <atomic>
+
+// base of the providers which read a device attached to a UART in a task
+// apart from the main loop, such that their latency does not depend on what
+// blocks the main loop. providers of the same role share one task, as most
+// of the memory of a task is its stack: the task sleeps until a UART driver
+// reports received data, or until the period of a provider elapsed (e.g., to
+// send the next request), and then calls serialLoop() of the providers due.
+// the derived class hands its results to the main loop, serialLoop() must
+// not touch state owned by the main loop and must not block.
+class SerialProviderTask {
+public:
+    SerialProviderTask() = default;
+    virtual ~SerialProviderTask() = default;
+
+    SerialProviderTask(SerialProviderTask const& other) = delete;
+    SerialProviderTask& operator=(SerialProviderTask const& other) = delete;
+
+    struct Group;
+
+protected:
+    // the RX events of the given UART wake the task. without a UART, the
+    // provider runs periodically only. the task of a role is created with
+    // the name and stack size passed by the first provider of the role.
+    // returns false if the task could not be created, serialLoop() must
+    // then be called from the main loop.
+    bool startSerialTask(char const* name, TaskPlacement::Role role,
+            uint32_t stackSize, uint32_t periodMillis, HardwareSerial* pSerial);
+
+    // waits until serialLoop() is not running. must be called before the
+    // UART is closed and from the destructor of the derived class.
+    void stopSerialTask();
+
+    bool hasSerialTask() const { return _pGroup != nullptr; }
+
+    // wakes the task early, may be called from any task
+    void notifySerialTask();
+
+    virtual void serialLoop() = 0;
+
+private:
+    static void taskHelper(void* context);
+    static void groupLoop(Group& group);
+
+    std::atomic<Group*> _pGroup = nullptr;
+    HardwareSerial* _pSerial = nullptr;
+    TickType_t _periodTicks = 0;
+    TickType_t _lastRunTicks = 0;
+    std::atomic<bool> _notified = false;
+};
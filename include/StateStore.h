@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <TaskSchedulerDeclarations.h>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+
+// a small key-value store for state which changes every few seconds and
+// shall survive a reboot, e.g., energy counters. the values are kept in RAM.
+// changes are appended to a log file as records protected by a CRC, at most
+// once per write interval, such that setting a value is cheap no matter how
+// often it changes. records of an interrupted write fail the CRC check and
+// are dropped when the log is read. once the log exceeds its size limit, it
+// is compacted by writing the current values to a new file which replaces
+// the log.
+class StateStoreClass {
+public:
+    StateStoreClass();
+
+    // reads the log. values can be read right after this, i.e., before
+    // initializing the modules which restore their state from the store.
+    void init(Scheduler& scheduler);
+
+    static constexpr size_t MaxKeyLength = 15;
+    static constexpr size_t MaxValueSize = 128;
+
+    // thread-safe. the setters return false if the key or value is too long.
+    std::optional<uint64_t> getCounter(char const* key) const;
+    bool setCounter(char const* key, uint64_t value);
+
+    // returns the size of the stored value, which is copied if it fits
+    // into the buffer. returns 0 if the key is unknown.
+    size_t getBlob(char const* key, void* data, size_t maxSize) const;
+    bool setBlob(char const* key, void const* data, size_t size);
+
+    // for plain structs, which are only restored if their size matches
+    template<typename T>
+    bool get(char const* key, T& value) const {
+        static_assert(std::is_trivially_copyable<T>::value, "plain data only");
+        T tmp;
+        if (getBlob(key, &tmp, sizeof(T)) != sizeof(T)) { return false; }
+        value = tmp;
+        return true;
+    }
+
+    template<typename T>
+    bool set(char const* key, T const& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "plain data only");
+        static_assert(sizeof(T) <= MaxValueSize, "value too large");
+        return setBlob(key, &value, sizeof(T));
+    }
+
+    void remove(char const* key);
+
+    // writes pending changes right away, e.g., before restarting
+    void flush();
+
+private:
+    void loop();
+    void restore();
+    bool append();
+    bool compact();
+
+    struct Entry {
+        char Key[MaxKeyLength + 1];
+        std::vector<uint8_t> Value; // empty if removed
+        bool Dirty;
+    };
+
+    Entry* find(char const* key);
+    Entry const* find(char const* key) const;
+
+    // precedes the key and the value of each record, which are followed
+    // by the CRC of the header, the key and the value
+    struct RecordHeader {
+        uint16_t Magic;
+        uint8_t KeyLength;
+        uint8_t ValueSize;
+    };
+
+    static constexpr uint32_t WriteIntervalMillis = 30 * 1000;
+    static constexpr size_t MaxLogSize = 16 * 1024;
+
+    Task _loopTask;
+
+    mutable std::mutex _mutex;
+    std::vector<Entry> _entries;
+    bool _dirty = false;
+    bool _compactionPending = false;
+    size_t _logSize = 0;
+};
+
+extern StateStoreClass StateStore;
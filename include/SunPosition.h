@@ -2,8 +2,10 @@
 #pragma once
 
 #include <TaskSchedulerDeclarations.h>
+#include <array>
 #include <atomic>
 #include <sunset.h>
+#include <time.h>
 
 class SunPositionClass {
 public:
@@ -19,14 +21,29 @@ public:
 private:
     void loop();
     void updateSunData();
+    void updateTable();
     bool checkRecalcDayChanged() const;
-    bool getSunTime(struct tm* info, const uint32_t offset) const;
 
     Task _loopTask;
 
+    // sunrise and sunset of each day of a leap year for the configured
+    // location and sunset type, in minutes since midnight UTC. the table
+    // does not depend on the timezone and is only rebuilt if the location
+    // or the sunset type changes.
+    struct TableEntry {
+        int16_t SunriseMinutes;
+        int16_t SunsetMinutes;
+    };
+    static constexpr int16_t NoSunset = INT16_MIN;
+    std::array<TableEntry, 366> _table;
+    bool _tableValid = false;
+    double _tableLatitude = 0;
+    double _tableLongitude = 0;
+    uint8_t _tableSunsetType = 0;
+
     bool _isSunsetAvailable = true;
-    uint32_t _sunriseMinutes = 0;
-    uint32_t _sunsetMinutes = 0;
+    time_t _sunrise = 0;
+    time_t _sunset = 0;
 
     bool _isValidInfo = false;
     std::atomic_bool _doRecalc = true;
@@ -1,7 +1,10 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 #include <WiFiUdp.h>
+#include <AsyncTCP.h>
 #include <TaskSchedulerDeclarations.h>
+#include <lwip/ip_addr.h>
+#include <atomic>
 #include <mutex>
 
 class SyslogLogger {
@@ -12,23 +15,85 @@ public:
     void write(const uint8_t *buffer, size_t size);
 
 private:
+    enum class Protocol : uint8_t {
+        Udp = 0,
+        Tcp = 1
+    };
+
     void loop();
     void disable();
     void enable();
-    bool resolveAndStart();
+    void resolve();
+    void updateAddress();
+    void setAddress(IPAddress const& address);
+    void updateConnection();
+    void flush();
+    bool sendMessage(char const* message, size_t length);
+    size_t sendUdp();
+    size_t sendTcp();
+    bool addFrame(char const* message, size_t length);
+    void endLine();
+    void consume(size_t size);
     bool isResolved() const {
         return _address != INADDR_NONE;
     }
 
+    static void onDnsFound(const char* name, const ip_addr_t* ipaddr, void* arg);
+
+    // payload of a single datagram, such that it is never fragmented
+    static constexpr size_t MaxDatagramSize = 1400;
+    // longer lines are continued on a new line
+    static constexpr size_t MaxLineSize = 1024;
+    // lines which do not fit are dropped until the backlog was sent
+    static constexpr size_t PendingSize = 4096;
+    static constexpr uint32_t FlushIntervalMillis = 250;
+    static constexpr uint32_t ResolveIntervalMillis = 10 * 60 * 1000;
+    static constexpr uint32_t ResolveRetryMillis = 10 * 1000;
+    static constexpr uint32_t ResolveTimeoutMillis = 30 * 1000;
+    static constexpr uint32_t MdnsTimeoutMillis = 500;
+    static constexpr uint32_t ReconnectIntervalMillis = 10 * 1000;
+
     Task _loopTask;
     std::mutex _mutex;
     WiFiUDP _udp;
+    AsyncClient _client;
     IPAddress _address;
     String _syslog_hostname;
     String _proc_id;
     String _header;
     uint16_t _port;
+    Protocol _protocol = Protocol::Udp;
     bool _enabled;
+
+    // sanitized lines, each terminated by '\n', followed by the line which
+    // is currently being written.
+    char _pending[PendingSize];
+    size_t _pendingSize = 0;
+    size_t _lineSize = 0;
+    bool _discardLine = false;
+    uint32_t _droppedLines = 0;
+    uint32_t _lastFlush = 0;
+
+    // the lwIP DNS callback runs in the TCP/IP task. results of lookups
+    // which were superseded by a newer lookup are discarded.
+    enum class DnsState : uint8_t {
+        Idle,
+        Pending,
+        Found,
+        Failed
+    };
+    std::atomic<DnsState> _dnsState = DnsState::Idle;
+    std::atomic<uint32_t> _dnsGeneration = 0;
+    std::atomic<uint32_t> _dnsResult = 0;
+    uint32_t _lastResolve = 0;
+
+    enum class TcpState : uint8_t {
+        Disconnected,
+        Connecting,
+        Connected
+    };
+    std::atomic<TcpState> _tcpState = TcpState::Disconnected;
+    uint32_t _lastConnect = 0;
 };
 
 extern SyslogLogger Syslog;
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// on dual-core chips, WiFi, lwIP, AsyncTCP and the MQTT client run on the
+// networking core, while the Arduino loop (scheduler, radios, DPL, display)
+// runs on the control core. both can be overridden using build flags, the
+// AsyncTCP core is set by CONFIG_ASYNC_TCP_RUNNING_CORE in platformio.ini.
+#ifndef TASK_CORE_CONTROL
+#define TASK_CORE_CONTROL ARDUINO_RUNNING_CORE
+#endif
+
+#ifndef TASK_CORE_NETWORK
+#define TASK_CORE_NETWORK 0
+#endif
+
+// where the firmware's own FreeRTOS tasks run and at which priority. tasks
+// of the control path are placed next to the Arduino loop, such that their
+// latency does not depend on the web load, whereas tasks waiting for network
+// I/O are placed on the networking core.
+class TaskPlacement {
+public:
+    enum class Role : uint8_t {
+        CanBus, // dispatching TWAI frames
+        GridCharger, // Huawei hardware interface
+        SerialPowerMeter, // power meters read via UART
+        NetworkPowerMeter, // power meters polled via HTTP
+        SolarCharger, // VE.Direct receivers
+        SerialBattery, // BMS read via UART
+        Display, // sending the display buffer
+        FirmwareUpdate, // writing an uploaded firmware to flash
+        Boot // initializing hardware concurrently to setup()
+    };
+
+    struct Placement {
+        BaseType_t Core;
+        UBaseType_t Priority;
+    };
+
+    static constexpr Placement get(Role role)
+    {
+        switch (role) {
+        case Role::CanBus: return { TASK_CORE_CONTROL, 20 };
+        case Role::GridCharger: return { TASK_CORE_CONTROL, 16 };
+        case Role::SerialPowerMeter: return { TASK_CORE_CONTROL, 1 };
+        case Role::NetworkPowerMeter: return { TASK_CORE_NETWORK, 1 };
+        case Role::SolarCharger: return { TASK_CORE_CONTROL, 1 };
+        case Role::SerialBattery: return { TASK_CORE_CONTROL, 1 };
+        case Role::Display: return { TASK_CORE_CONTROL, 1 };
+        case Role::FirmwareUpdate: return { TASK_CORE_NETWORK, 1 };
+        // interrupt handlers are installed on the core of the calling task
+        case Role::Boot: return { TASK_CORE_CONTROL, 1 };
+        }
+        return { tskNO_AFFINITY, 1 };
+    }
+
+    static bool create(Role role, TaskFunction_t function, char const* name,
+            uint32_t stackSize, void* parameter, TaskHandle_t* pHandle)
+    {
+        auto placement = get(role);
+        return xTaskCreatePinnedToCore(function, name, stackSize, parameter,
+                placement.Priority, pHandle, placement.Core) == pdPASS;
+    }
+};
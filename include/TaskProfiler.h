@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "HeapMonitor.h"
+#include <TaskSchedulerDeclarations.h>
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+// measures the callbacks of the tasks run by the scheduler, for which the
+// callbacks were wrapped when setting up the tasks. the time is measured
+// using the CPU cycle counter. each run is a heap monitor scope named after
+// the task.
+class TaskProfilerClass {
+public:
+    struct Stats {
+        char const* Name;
+        uint32_t IntervalMillis; // the interval planned for the task
+        uint32_t Count;
+        uint64_t TotalMicros;
+        uint32_t MaxMicros;
+        // runs which took longer than the interval planned for the task
+        uint32_t Overruns;
+        // how much later than planned a run started at most, measured
+        // from the start of the previous run
+        uint32_t MaxLateMillis;
+    };
+
+    // returns a callback which calls the given one and measures it. wrap()
+    // is called while constructing other globals, so the profiler must be
+    // constant-initialized, i.e., must not have a user-provided constructor.
+    TaskCallback wrap(char const* name, TaskCallback callback);
+
+    // the values are read without locking and may be off by one run
+    std::vector<Stats> getStats() const;
+
+private:
+    struct Entry {
+        Stats Values;
+        uint32_t LastStartMillis;
+        // looked up on the first run, as the heap monitor is not
+        // constructed yet when wrap() is called
+        HeapMonitorClass::Tag* HeapTag;
+        Entry* Next;
+    };
+
+    static void run(Entry& entry, TaskCallback const& callback);
+
+    std::atomic<Entry*> _first = nullptr;
+};
+
+extern TaskProfilerClass TaskProfiler;
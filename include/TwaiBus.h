@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <driver/twai.h>
+
+// owns the TWAI driver, of which there is only one instance. a single task
+// receives the frames and dispatches them to the subscribers' queues by
+// identifier range, such that multiple users (e.g., a battery and a grid
+// charger) can share one CAN bus. the driver is recovered from bus-off here
+// as well.
+class TwaiBusClass {
+public:
+    struct Config {
+        char const* Name;
+        int8_t TxPin;
+        int8_t RxPin;
+        uint32_t Bitrate; // in bit/s, all subscribers must agree
+        bool Extended; // whether the subscriber receives extended frames
+        uint32_t FirstId; // frames within [FirstId, LastId] are received
+        uint32_t LastId;
+        // used as acceptance filter if this is the only subscriber
+        twai_filter_config_t Filter;
+        UBaseType_t QueueLength;
+        TaskHandle_t NotifyTask; // notified on reception, may be nullptr
+    };
+
+    class Subscription {
+    public:
+        // the frames received for this subscriber
+        bool receive(twai_message_t& message) {
+            return xQueueReceive(_queue, &message, 0) == pdTRUE;
+        }
+
+        // frames dropped because this subscriber's queue was full
+        uint32_t getDroppedFrames() const { return _droppedFrames; }
+
+    private:
+        friend class TwaiBusClass;
+
+        Config _config;
+        QueueHandle_t _queue = nullptr;
+        std::atomic<uint32_t> _droppedFrames = 0;
+    };
+
+    // returns nullptr if the bus is in use with another bitrate or other
+    // pins, or if the driver cannot be started.
+    Subscription* subscribe(Config const& config);
+    void unsubscribe(Subscription* subscription);
+
+    bool transmit(twai_message_t const& message, TickType_t timeout);
+
+    // frames missed by the driver because its queue was full
+    uint32_t getMissedFrames() const { return _missedFrames; }
+
+private:
+    bool start();
+    void stop();
+
+    static bool getTimingConfig(uint32_t bitrate, twai_timing_config_t& timing);
+
+    static void taskHelper(void* context);
+    void task();
+    void dispatch(twai_message_t const& message);
+
+    // see InputCapture.h. while a recording is replayed, the frames
+    // received from the bus are dropped.
+    void recordFrame(twai_message_t const& message);
+    void replayFrames();
+
+    // serializes (un)subscribing and transmitting against restarting the
+    // driver. the task is stopped while the subscribers change.
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<Subscription>> _subscriptions;
+    bool _running = false;
+
+    TaskHandle_t _taskHandle = nullptr;
+    std::atomic<bool> _stopTask = false;
+    std::atomic<bool> _taskDone = false;
+
+    std::atomic<uint32_t> _missedFrames = 0;
+};
+
+extern TwaiBusClass TwaiBus;
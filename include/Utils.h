@@ -4,7 +4,41 @@
 #include <ArduinoJson.h>
 #include <LittleFS.h>
 #include <cstdint>
+#include <optional>
+#include <string_view>
 #include <utility>
+#include <vector>
+
+// a JSON path like "emeters/[0]/power", split into its keys and array
+// indices once, such that it can be resolved repeatedly without parsing
+// the path again. the path also yields an ArduinoJson filter, which makes
+// deserializeJson() skip everything not on the path.
+class JsonPath {
+public:
+    JsonPath() : JsonPath(String()) { }
+    explicit JsonPath(String const& path);
+
+    String const& getPath() const { return _path; }
+
+    JsonDocument const& getFilter() const { return _filter; }
+
+    // adds this path to a filter shared by multiple paths
+    void addToFilter(JsonDocument& filter) const;
+
+    template<typename T>
+    std::pair<T, String> getValue(JsonDocument const& root) const;
+
+private:
+    struct Token {
+        String Key;
+        int32_t Index; // negative for object keys
+        int Position; // of the token within the path string
+    };
+
+    String _path;
+    std::vector<Token> _tokens;
+    JsonDocument _filter;
+};
 
 class Utils {
 public:
@@ -16,11 +50,20 @@ public:
     static String generateMd5FromFile(String file);
     static void skipBom(File& f);
 
+    // formats the value with a fixed number of decimal places like "%.*f",
+    // but without the (soft-float) printf machinery. writes at most size
+    // bytes including the terminator and returns the length of the text.
+    // FixedFormatSize bytes hold any value below 1e12 with up to 9 places.
+    static constexpr size_t FixedFormatSize = 24;
+    static size_t formatFixed(char* buffer, size_t size, double value, uint8_t digits);
+
     /* OpenDTU-OnBatter-specific utils go here: */
     template<typename T>
     static std::pair<T, String> getJsonValueByPath(JsonDocument const& root, String const& path);
 
+    // parses the payload in place if the path is empty. otherwise, the
+    // payload is deserialized into a pooled buffer using the path's filter.
     template <typename T>
     static std::optional<T> getNumericValueFromMqttPayload(char const* client,
-            std::string const& src, char const* topic, char const* jsonPath);
+            std::string_view src, char const* topic, JsonPath const& jsonPath);
 };
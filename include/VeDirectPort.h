@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <MessageOutput.h>
+#include <SerialPortManager.h>
+#include <SerialProviderTask.h>
+
+// a VE.Direct device (SmartShunt, MPPT charger) attached to a UART. all
+// VE.Direct devices are served alike, whichever subsystem consumes their
+// data: the port allocates a hardware UART if one is left and falls back
+// to a software UART otherwise, which is fine for the VE.Direct baud rate
+// of 19200. a task of its own drains the UART, assembles the frames and
+// sends the queued hex commands, such that the frame latency neither
+// depends on the type of the device nor on what blocks the main loop. the
+// main loop picks up the decoded data through withController().
+template<typename Controller>
+class VeDirectPort : public SerialProviderTask {
+public:
+    explicit VeDirectPort(std::string owner) : _owner(std::move(owner)) { }
+    ~VeDirectPort() { end(); }
+
+    // returns false if no UART could be allocated
+    bool begin(int8_t rx, int8_t tx, bool verboseLogging, TaskPlacement::Role role)
+    {
+        std::optional<uint8_t> oHwSerialPort = std::nullopt;
+        if (SerialPortManager.hasFreePort()) {
+            oHwSerialPort = SerialPortManager.allocatePort(_owner);
+            if (!oHwSerialPort) { return false; }
+        } else {
+            SerialPortManager.registerSoftwarePort(_owner);
+        }
+        _allocated = true;
+
+        _controller.init(rx, tx, &MessageOutput, verboseLogging, oHwSerialPort);
+
+        // a hardware UART wakes the task once data was received, the
+        // period only matters to send hex commands. a software UART buffers
+        // few bytes and does not signal anything, so it is polled frequently.
+        auto pHwSerial = _controller.getHardwareSerial();
+        uint32_t periodMillis = pHwSerial ? 50 : 10;
+
+        // the name of a task is limited to 16 characters
+        char taskName[16];
+        snprintf(taskName, sizeof(taskName), "%s", _owner.c_str());
+        uint32_t constexpr stackSize = 3072;
+
+        if (!startSerialTask(taskName, role, stackSize, periodMillis, pHwSerial)) {
+            MessageOutput.printf("[VE.Direct] %s: failed to create RX task\r\n",
+                    _owner.c_str());
+        }
+
+        return true;
+    }
+
+    void end()
+    {
+        stopSerialTask();
+        if (!_allocated) { return; }
+        SerialPortManager.freePort(_owner);
+        _allocated = false;
+    }
+
+    // to be used before begin() only, e.g., to set the RX tap
+    Controller& getController() { return _controller; }
+
+    // called after every loop of the controller, e.g., to feed it recorded
+    // input. must be set before begin().
+    using LoopHook = std::function<void(Controller&)>;
+    void setLoopHook(LoopHook hook) { _loopHook = std::move(hook); }
+
+    // calls the function while the controller is locked. if no task could
+    // be created, the controller is looped beforehand.
+    template<typename F>
+    void withController(F&& function)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!hasSerialTask()) { loopController(); }
+        function(static_cast<Controller const&>(_controller));
+    }
+
+private:
+    void serialLoop() final
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        loopController();
+    }
+
+    void loopController()
+    {
+        _controller.loop();
+        if (_loopHook) { _loopHook(_controller); }
+    }
+
+    std::string const _owner;
+    bool _allocated = false;
+    std::mutex _mutex;
+    Controller _controller;
+    LoopHook _loopHook;
+};
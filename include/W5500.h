@@ -6,24 +6,88 @@
 #include <esp_eth.h> // required for esp_eth_handle_t
 #include <esp_netif.h>
 
+#include <atomic>
 #include <memory>
 
 class W5500 {
 private:
-    explicit W5500(spi_device_handle_t spi, gpio_num_t pin_int);
+    explicit W5500(spi_device_handle_t spi, gpio_num_t pin_int, uint32_t spi_clock_hz);
 
 public:
     W5500(const W5500&) = delete;
     W5500& operator=(const W5500&) = delete;
     ~W5500();
 
-    static std::unique_ptr<W5500> setup(int8_t pin_mosi, int8_t pin_miso, int8_t pin_sclk, int8_t pin_cs, int8_t pin_int, int8_t pin_rst);
+    static std::unique_ptr<W5500> setup(int8_t pin_mosi, int8_t pin_miso, int8_t pin_sclk, int8_t pin_cs, int8_t pin_int, int8_t pin_rst, uint8_t spi_clock_mhz);
     String macAddress();
 
+    struct Stats {
+        uint32_t spi_clock_hz;
+        uint32_t rx_frames;
+        uint32_t rx_bytes;
+        uint32_t tx_frames;
+        uint32_t tx_bytes;
+        uint32_t rx_errors;
+        uint32_t tx_errors;
+        // bytes per second and the time spent transferring a frame via
+        // SPI, measured over the last sample period
+        uint32_t rx_rate;
+        uint32_t tx_rate;
+        uint32_t rx_latency_avg_us;
+        uint32_t rx_latency_max_us;
+        uint32_t tx_latency_avg_us;
+        uint32_t tx_latency_max_us;
+    };
+    Stats getStats();
+
+    static constexpr uint8_t default_spi_clock_mhz = 20; // stable with OpenDTU Fusion shield
+    static constexpr uint8_t max_spi_clock_mhz = 40;
+
 private:
     static bool connection_check_spi(spi_device_handle_t spi);
     static bool connection_check_interrupt(gpio_num_t pin_int);
 
+    // wrap the MAC's frame transfer functions to account for the traffic.
+    // receive is called from the driver's RX task, which is woken by the
+    // INT line, transmit is called from the lwIP task.
+    static esp_err_t receive(esp_eth_mac_t* mac, uint8_t* buf, uint32_t* length);
+    static esp_err_t transmit(esp_eth_mac_t* mac, uint8_t* buf, uint32_t length);
+
+    struct Counter {
+        std::atomic<uint32_t> frames = 0;
+        std::atomic<uint32_t> bytes = 0;
+        std::atomic<uint32_t> errors = 0;
+        std::atomic<uint32_t> busy_us = 0;
+        std::atomic<uint32_t> max_us = 0;
+
+        void account(esp_err_t result, uint32_t length, uint32_t duration_us);
+    };
+
+    struct Sample {
+        uint32_t frames = 0;
+        uint32_t bytes = 0;
+        uint32_t busy_us = 0;
+        uint32_t rate = 0;
+        uint32_t latency_avg_us = 0;
+        uint32_t latency_max_us = 0;
+
+        void update(Counter& counter, uint32_t elapsed_ms);
+    };
+
+    static constexpr uint32_t sample_period_ms = 1000;
+
+    static W5500* instance;
+    spi_device_handle_t spi;
+    esp_err_t (*mac_receive)(esp_eth_mac_t* mac, uint8_t* buf, uint32_t* length);
+    esp_err_t (*mac_transmit)(esp_eth_mac_t* mac, uint8_t* buf, uint32_t length);
+
+    Counter rx;
+    Counter tx;
+    Sample rx_sample;
+    Sample tx_sample;
+    uint32_t last_sample_ms;
+    uint32_t spi_clock_hz;
+
     esp_eth_handle_t eth_handle;
     esp_netif_t* eth_netif;
 };
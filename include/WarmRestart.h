@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstdint>
+
+// keeps state which takes long to acquire in RTC memory during a controlled
+// restart, such that the DPL resumes control right after booting rather
+// than waiting for NTP, device info and limits to be fetched again.
+class WarmRestartClass {
+public:
+    // checks whether the state saved before a software restart is valid and
+    // restores the system time. to be called early during startup.
+    void init();
+
+    // to be called right before restarting
+    void save();
+
+    // to be called after the inverters were added
+    void restoreInverters();
+
+    // to be called after the battery provider was set up
+    void restoreBattery();
+
+private:
+    bool _valid = false;
+};
+
+extern WarmRestartClass WarmRestart;
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "Configuration.h"
 #include "WebApi_battery.h"
 #include "WebApi_device.h"
 #include "WebApi_devinfo.h"
@@ -10,8 +11,11 @@
 #include "WebApi_file.h"
 #include "WebApi_firmware.h"
 #include "WebApi_gridprofile.h"
+#include "WebApi_history.h"
 #include "WebApi_i18n.h"
 #include "WebApi_inverter.h"
+#include "WebApi_json_pool.h"
+#include "WebApi_json_stream.h"
 #include "WebApi_limit.h"
 #include "WebApi_maintenance.h"
 #include "WebApi_mqtt.h"
@@ -21,11 +25,15 @@
 #include "WebApi_powermeter.h"
 #include "WebApi_powerlimiter.h"
 #include "WebApi_prometheus.h"
+#include "WebApi_router.h"
 #include "WebApi_security.h"
+#include "WebApi_snapshot.h"
+#include "WebApi_sse.h"
 #include "WebApi_sysstatus.h"
 #include "WebApi_webapp.h"
 #include "WebApi_ws_console.h"
 #include "WebApi_ws_live.h"
+#include "WebApi_ws_mux.h"
 #include <AsyncJson.h>
 #include "WebApi_ws_solarcharger_live.h"
 #include "WebApi_solarcharger.h"
@@ -34,6 +42,28 @@
 #include "WebApi_ws_battery.h"
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
+#include <array>
+#include <mutex>
+
+// identifies the version of the data which a JSON response is generated
+// from, including the configuration. the ETag changes if any of the added
+// versions changes.
+class JsonETag {
+public:
+    JsonETag();
+    JsonETag& add(uint32_t version);
+    JsonETag& add(uint64_t version);
+
+    // a weak ETag denotes responses whose data is unchanged, but which
+    // might still differ in values derived from the current time (ages).
+    String toString(bool weak) const;
+
+    // e.g., to key a JsonFragmentCache
+    uint32_t getHash() const { return _hash; }
+
+private:
+    uint32_t _hash;
+};
 
 class WebApiClass {
 public:
@@ -46,14 +76,55 @@ public:
 
     static void sendTooManyRequests(AsyncWebServerRequest* request);
 
-    static void writeConfig(JsonVariant& retMsg, const WebApiError code = WebApiError::GenericSuccess, const String& message = "Settings saved!");
+    static void writeConfig(JsonVariant& retMsg, ConfigurationClass::Section section, const WebApiError code = WebApiError::GenericSuccess, const String& message = "Settings saved!");
 
     static bool parseRequestData(AsyncWebServerRequest* request, AsyncJsonResponse* response, JsonDocument& json_document);
     static uint64_t parseSerialFromRequest(AsyncWebServerRequest* request, String param_name = "inv");
     static bool sendJsonResponse(AsyncWebServerRequest* request, AsyncJsonResponse* response, const char* function, const uint16_t line);
+    static bool sendJsonResponse(AsyncWebServerRequest* request, PooledJsonResponse* response, const char* function, const uint16_t line);
+
+    // answers with 304 if the client holds the response with this ETag.
+    // otherwise, the ETag must be added to the response using addETag().
+    static bool sendNotModified(AsyncWebServerRequest* request, String const& etag);
+    static void addETag(AsyncWebServerResponse* response, String const& etag);
+
+    // the plain routes of all API classes are registered here, the routes
+    // with upload or body handler and the websockets at the web server.
+    WebApiRouterClass& getRouter() { return _router; }
 
 private:
+    // the authorization header of a request authenticated before is
+    // accepted without being decoded again, until it expires or the
+    // configuration changes.
+    struct VerifiedCredentials {
+        String Authorization;
+        uint32_t Generation;
+        uint32_t VerifiedAt;
+    };
+    static constexpr size_t VerifiedCredentialsCount = 4;
+    static constexpr uint32_t VerifiedCredentialsMillis = 5 * 60 * 1000;
+
+    // failed authentication attempts per client address
+    struct AuthFailures {
+        uint32_t Address;
+        uint32_t WindowStart;
+        uint8_t Count;
+    };
+    static constexpr size_t AuthFailuresCount = 8;
+    static constexpr uint32_t AuthFailuresWindowMillis = 60 * 1000;
+    static constexpr uint8_t AuthFailuresMax = 10;
+
+    static bool isVerified(String const& authorization);
+    static void addVerified(String const& authorization);
+    static bool isRateLimited(uint32_t address);
+    static void addFailure(uint32_t address);
+
+    static std::mutex sAuthMutex;
+    static std::array<VerifiedCredentials, VerifiedCredentialsCount> sVerified;
+    static std::array<AuthFailures, AuthFailuresCount> sFailures;
+
     AsyncWebServer _server;
+    WebApiRouterClass _router;
 
     WebApiBatteryClass _webApiBattery;
     WebApiDeviceClass _webApiDevice;
@@ -63,6 +134,7 @@ private:
     WebApiFileClass _webApiFile;
     WebApiFirmwareClass _webApiFirmware;
     WebApiGridProfileClass _webApiGridprofile;
+    WebApiHistoryClass _webApiHistory;
     WebApiI18nClass _webApiI18n;
     WebApiInverterClass _webApiInverter;
     WebApiLimitClass _webApiLimit;
@@ -77,6 +149,8 @@ private:
     WebApiSecurityClass _webApiSecurity;
     WebApiSysstatusClass _webApiSysstatus;
     WebApiWebappClass _webApiWebapp;
+    WebApiWsMuxClass _webApiWsMux; // precedes the classes publishing to it
+    WebApiSseClass _webApiSse; // likewise
     WebApiWsConsoleClass _webApiWsConsole;
     WebApiWsLiveClass _webApiWsLive;
     WebApiWsSolarChargerLiveClass _webApiWsSolarChargerLive;
@@ -84,6 +158,7 @@ private:
     WebApiHuaweiClass _webApiHuaweiClass;
     WebApiWsHuaweiLiveClass _webApiWsHuaweiLive;
     WebApiWsBatteryLiveClass _webApiWsBatteryLive;
+    WebApiSnapshotClass _webApiSnapshot; // follows the classes it combines
 };
 
 extern WebApiClass WebApi;
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "Configuration.h"
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
 
@@ -15,4 +16,9 @@ private:
 
     Task _applyDataTask;
     void applyDataTaskCb();
+
+    // the settings the radios were configured with. only the settings
+    // which differ from these are applied, as reconfiguring a radio
+    // interrupts the transaction it is busy with.
+    decltype(CONFIG_T::Dtu) _applied;
 };
@@ -10,6 +10,8 @@ enum WebApiError {
     GenericValueMissing,
     GenericWriteFailed,
     GenericInternalServerError,
+    GenericNotAvailable,
+    GenericValueOutOfRange,
 
     DtuBase = 2000,
     DtuSerialZero,
@@ -22,6 +24,9 @@ enum WebApiError {
     FileNotDeleted,
     FileSuccess,
     FileDeleteSuccess,
+    FileBackupInvalid,
+    FileBackupBuildMismatch,
+    FileBackupRestored,
 
     InverterBase = 4000,
     InverterSerialZero,
@@ -44,6 +49,11 @@ enum WebApiError {
     MaintenanceBase = 6000,
     MaintenanceRebootTriggered,
     MaintenanceRebootCancled,
+    MaintenanceCaptureStarted,
+    MaintenanceCaptureStopped,
+    MaintenanceCaptureFailed,
+    MaintenanceCaptureLoaded,
+    MaintenanceCaptureInvalid,
 
     MqttBase = 7000,
     MqttHostnameLength,
@@ -63,6 +73,8 @@ enum WebApiError {
     MqttHassTopicCharacter,
     MqttLwtQos,
     MqttClientIdLength,
+    MqttPublishRefreshInterval,
+    MqttPublishDeadband,
 
     NetworkBase = 8000,
     NetworkIpInvalid,
@@ -73,6 +85,14 @@ enum WebApiError {
     NetworkApTimeoutInvalid,
     NetworkSyslogHostnameLength,
     NetworkSyslogPort,
+    NetworkSyslogProtocol,
+    NetworkInfluxHostnameLength,
+    NetworkInfluxPort,
+    NetworkInfluxProtocol,
+    NetworkInfluxInterval,
+    NetworkInfluxPathLength,
+    NetworkInfluxTokenLength,
+    NetworkModbusPort,
 
     NtpBase = 9000,
     NtpServerLength,
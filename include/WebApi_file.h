@@ -15,4 +15,7 @@ private:
     void onFileListGet(AsyncWebServerRequest* request);
     void onFileUploadFinish(AsyncWebServerRequest* request);
     void onFileUpload(AsyncWebServerRequest* request, String filename, size_t index, uint8_t* data, size_t len, bool final);
+    void onConfigBackup(AsyncWebServerRequest* request);
+    void onConfigRestore(AsyncWebServerRequest* request);
+    void onConfigRestoreBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total);
 };
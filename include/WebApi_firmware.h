@@ -14,4 +14,6 @@ private:
     void onFirmwareUpdateFinish(AsyncWebServerRequest* request);
     void onFirmwareUpdateUpload(AsyncWebServerRequest* request, String filename, size_t index, uint8_t* data, size_t len, bool final);
     void onFirmwareStatus(AsyncWebServerRequest* request);
+
+    bool _updateSucceeded = false;
 };
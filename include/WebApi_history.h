@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "History.h"
+#include <ESPAsyncWebServer.h>
+#include <TaskSchedulerDeclarations.h>
+
+class WebApiHistoryClass {
+public:
+    void init(AsyncWebServer& server, Scheduler& scheduler);
+
+private:
+    void onHistoryGet(AsyncWebServerRequest* request);
+    void onAggregatesGet(AsyncWebServerRequest* request);
+
+    // renders the samples in small batches, such that the history lock is
+    // only held briefly and the response is never held in memory as a whole.
+    class HistoryWriter {
+    public:
+        HistoryWriter(String const& name, size_t series, HistoryClass::Resolution resolution,
+            uint32_t from, uint32_t to);
+
+        size_t fill(uint8_t* buffer, size_t maxLen);
+
+    private:
+        bool renderNextBlock();
+
+        enum class Stage : uint8_t {
+            Header,
+            Samples,
+            Footer,
+            Done
+        };
+
+        Stage _stage = Stage::Header;
+        String _name;
+        size_t _series;
+        HistoryClass::Resolution _resolution;
+        uint32_t _next;
+        uint32_t _to;
+        bool _first = true;
+
+        static constexpr size_t SAMPLES_PER_BLOCK = 32;
+        static constexpr size_t BLOCK_SIZE = 1024;
+        char _block[BLOCK_SIZE];
+        size_t _blockLen = 0;
+        size_t _blockPos = 0;
+    };
+};
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <array>
+#include <mutex>
+
+// pre-allocated buffers for the JSON documents of the frequently polled
+// web API responses and of parsed MQTT payloads, such that serving the
+// polls and processing the messages does not allocate from the heap. a buffer is checked out when the response is created and
+// returned once the response was sent. the handlers choose the size class
+// they expect to need. allocations which exceed the buffer, or which are
+// made while all buffers of the size class are in use, are served by the
+// heap instead.
+class JsonDocumentPoolClass {
+public:
+    enum class SizeClass : uint8_t {
+        Small, // a flat object, e.g., a status summary
+        Large // lists, e.g., the task statistics
+    };
+
+    // an ArduinoJson allocator which serves from one buffer of the pool.
+    // space is handed out consecutively and reused only if the most recent
+    // allocation is released or resized.
+    class Lease : public ArduinoJson::Allocator {
+    public:
+        explicit Lease(SizeClass sizeClass);
+        ~Lease();
+
+        Lease(Lease const&) = delete;
+        Lease& operator=(Lease const&) = delete;
+
+        void* allocate(size_t size) override;
+        void deallocate(void* ptr) override;
+        void* reallocate(void* ptr, size_t new_size) override;
+
+    private:
+        bool owns(void const* ptr) const;
+        size_t& sizeOf(void* ptr) const;
+
+        uint8_t* _buffer = nullptr;
+        size_t _capacity = 0;
+        size_t _used = 0;
+        uint8_t* _last = nullptr;
+    };
+
+private:
+    struct Slot {
+        uint8_t* Buffer = nullptr;
+        bool InUse = false;
+    };
+
+    uint8_t* checkout(SizeClass sizeClass, size_t& capacity);
+    void giveBack(uint8_t* buffer);
+
+    static constexpr size_t SmallCapacity = 3 * 1024;
+    static constexpr size_t LargeCapacity = 6 * 1024;
+
+    // fewer slots are used without PSRAM
+    static constexpr size_t MaxSmallSlots = 4;
+    static constexpr size_t MaxLargeSlots = 2;
+
+    std::mutex _mutex;
+    std::array<Slot, MaxSmallSlots> _small;
+    std::array<Slot, MaxLargeSlots> _large;
+};
+
+extern JsonDocumentPoolClass JsonDocumentPool;
+
+// a JSON response of which the document is backed by the pool. it is used
+// like an AsyncJsonResponse with WebApi.sendJsonResponse().
+class PooledJsonResponse : public AsyncAbstractResponse {
+public:
+    explicit PooledJsonResponse(JsonDocumentPoolClass::SizeClass sizeClass);
+
+    JsonVariant& getRoot() { return _root; }
+    bool overflowed() const { return _document.overflowed(); }
+    size_t setLength();
+
+    bool _sourceValid() const override { return _valid; }
+    size_t _fillBuffer(uint8_t* data, size_t len) override;
+
+private:
+    // declared first, as the document must be destroyed before the lease
+    JsonDocumentPoolClass::Lease _lease;
+    JsonDocument _document;
+    JsonVariant _root;
+    bool _valid = false;
+};
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// sends a JSON object using a chunked response. the object is made up of
+// parts, which are generated one after another while the response is sent.
+// members are generated at once, whereas arrays are generated one element at
+// a time, such that the memory needed does not grow with the amount of
+// elements (e.g., inverters).
+class JsonStreamResponse {
+public:
+    // adds members to the root object
+    using MembersCallback = std::function<void(JsonObject root)>;
+
+    // fills the element with the given index. returns false if there is no
+    // such element, which is then skipped.
+    using ElementCallback = std::function<bool(size_t index, JsonObject element)>;
+
+    JsonStreamResponse();
+
+    JsonStreamResponse& addMembers(MembersCallback callback);
+    JsonStreamResponse& addArray(char const* key, size_t count, ElementCallback callback);
+
+    // the parts are generated from within the async web server task and
+    // must not refer to the request or to data on the caller's stack.
+    void send(AsyncWebServerRequest* request, String const& etag = String());
+
+private:
+    struct Part {
+        char const* Key; // nullptr for members
+        size_t Count;
+        MembersCallback Members;
+        ElementCallback Element;
+    };
+
+    struct State {
+        std::vector<Part> Parts;
+        size_t PartIndex = 0;
+        size_t ElementIndex = 0;
+        bool Started = false;
+        bool Finished = false;
+        bool ArrayOpen = false;
+        bool FirstMember = true;
+        bool FirstElement = true;
+        String Pending;
+        size_t PendingOffset = 0;
+    };
+
+    static size_t fill(State& state, uint8_t* buffer, size_t maxLen);
+    static bool generate(State& state);
+    static void appendMembers(State& state, JsonDocument const& doc);
+
+    std::shared_ptr<State> _state;
+};
@@ -10,4 +10,9 @@ public:
 
 private:
     void onRebootPost(AsyncWebServerRequest* request);
+    void onCaptureGet(AsyncWebServerRequest* request);
+    void onCapturePost(AsyncWebServerRequest* request);
+    void onCaptureLogGet(AsyncWebServerRequest* request);
+    void onCaptureLogPost(AsyncWebServerRequest* request);
+    void onCaptureLogPostBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total);
 };
@@ -12,6 +12,10 @@ public:
 private:
     void onStatus(AsyncWebServerRequest* request);
     void onMetaData(AsyncWebServerRequest* request);
+    void onTrace(AsyncWebServerRequest* request);
+    void onLatency(AsyncWebServerRequest* request);
+    void onShadow(AsyncWebServerRequest* request);
+    void onScorecard(AsyncWebServerRequest* request);
     void onAdminGet(AsyncWebServerRequest* request);
     void onAdminPost(AsyncWebServerRequest* request);
 
@@ -14,6 +14,7 @@ private:
     void onStatus(AsyncWebServerRequest* request);
     void onAdminGet(AsyncWebServerRequest* request);
     void onAdminPost(AsyncWebServerRequest* request);
+    void onDiagnostics(AsyncWebServerRequest* request);
     void onTestHttpJsonRequest(AsyncWebServerRequest* request);
     void onTestHttpSmlRequest(AsyncWebServerRequest* request);
 
@@ -2,9 +2,12 @@
 #pragma once
 
 #include <ESPAsyncWebServer.h>
+#include <HeapMonitor.h>
 #include <Hoymiles.h>
+#include <TaskProfiler.h>
 #include <TaskSchedulerDeclarations.h>
-#include <map>
+#include <WsMonitor.h>
+#include <powermeter/Controller.h>
 
 class WebApiPrometheusClass {
 public:
@@ -13,36 +16,136 @@ public:
 private:
     void onPrometheusMetricsGet(AsyncWebServerRequest* request);
 
-    void addField(AsyncResponseStream* stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, const char* metricName, const char* channelName = nullptr);
+    // renders the metrics block by block into a fixed-size buffer, from which
+    // the chunked response is filled as the TCP send window allows. each block
+    // holds one metric family of one inverter or one group of system metrics.
+    class MetricsWriter {
+    public:
+        size_t fill(uint8_t* buffer, size_t maxLen);
 
-    void addPanelInfo(AsyncResponseStream* stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel);
+    private:
+        bool renderNextBlock();
+        void print(const char* format, ...) __attribute__((format(printf, 2, 3)));
 
-    enum MetricType_t {
-        NONE = 0,
-        GAUGE,
-        COUNTER,
+        void renderSystemInfo();
+        void renderInverterInfo(const uint8_t family, const uint8_t idx, std::shared_ptr<InverterAbstract> inv);
+        void renderInverterFields(const uint8_t family, const uint8_t idx, std::shared_ptr<InverterAbstract> inv);
+        bool renderInverterLatency();
+        void renderBattery();
+        void renderSolarCharger();
+        void renderPowerMeter();
+        bool renderPowerMeterDiagnostics();
+        void renderPowerLimiter();
+        void renderControlLatency();
+        void renderEnergy();
+        bool renderTasks();
+        bool renderHeapTags();
+        bool renderWebsockets();
+
+        enum class Stage : uint8_t {
+            System,
+            InverterInfo,
+            InverterFields,
+            InverterLatency,
+            Battery,
+            SolarCharger,
+            PowerMeter,
+            PowerMeterDiagnostics,
+            PowerLimiter,
+            ControlLatency,
+            Energy,
+            Tasks,
+            HeapTags,
+            Websockets,
+            Done
+        };
+
+        Stage _stage = Stage::System;
+        uint8_t _family = 0;
+        uint8_t _inverter = 0;
+
+        // snapshot of the RF latencies of the inverter being rendered. one
+        // block holds one phase of one command.
+        std::vector<TransactionLatency> _latency;
+        String _latencySerial;
+        uint8_t _latencyUnit = 0;
+        size_t _latencyEntry = 0;
+        uint8_t _latencyPhase = 0;
+        bool _latencyPreamble = false;
+
+        // snapshot of the power meter diagnostics. one block holds one
+        // metric of one source, the last one holds the failures.
+        std::vector<PowerMeters::Controller::SourceDiagnostics> _meterDiagnostics;
+        uint8_t _meterMetric = 0;
+        size_t _meterSource = 0;
+        bool _meterSnapshot = false;
+
+        // snapshot of the task profiler's values
+        std::vector<TaskProfilerClass::Stats> _tasks;
+        uint8_t _taskFamily = 0;
+        size_t _taskIndex = 0;
+
+        // snapshot of the heap monitor's tags
+        std::vector<HeapMonitorClass::TagStats> _heapTags;
+        uint8_t _heapTagFamily = 0;
+        size_t _heapTagIndex = 0;
+
+        // snapshot of the websocket monitor's values. one block holds one
+        // metric of all websockets.
+        std::vector<WsMonitorClass::SocketStats> _sockets;
+        uint8_t _socketFamily = 0;
+
+        static constexpr size_t BLOCK_SIZE = 2048;
+        char _block[BLOCK_SIZE];
+        size_t _blockLen = 0;
+        size_t _blockPos = 0;
+    };
+
+    struct metric_family_t {
+        const char* name;
+        const char* preamble; // HELP and TYPE lines
+    };
+
+    static constexpr metric_family_t _infoFamilies[] = {
+        { "last_update", "# HELP opendtu_last_update last update from inverter in s\n# TYPE opendtu_last_update gauge\n" },
+        { "inverter_limit_relative", "# HELP opendtu_inverter_limit_relative current relative limit of the inverter\n# TYPE opendtu_inverter_limit_relative gauge\n" },
+        { "inverter_limit_absolute", "# HELP opendtu_inverter_limit_absolute current relative limit of the inverter\n# TYPE opendtu_inverter_limit_absolute gauge\n" },
+        { "PanelInfo", "# HELP opendtu_PanelInfo panel information\n# TYPE opendtu_PanelInfo gauge\n" },
+        { "MaxPower", "# HELP opendtu_MaxPower panel maximum output power\n# TYPE opendtu_MaxPower gauge\n" },
+        { "YieldTotalOffset", "# HELP opendtu_YieldTotalOffset panel yield offset (for used inverters)\n# TYPE opendtu_YieldTotalOffset gauge\n" },
     };
-    const char* _metricTypes[3] = { 0, "gauge", "counter" };
 
-    struct publish_type_t {
-        FieldId_t field;
-        MetricType_t type;
+    // the names match the field names of the statistics parser, except
+    // for the DC power of the inverter channel, which is called PowerDC.
+    static constexpr metric_family_t _fieldFamilies[] = {
+        { "Power", "# HELP opendtu_Power in W\n# TYPE opendtu_Power gauge\n" },
+        { "Voltage", "# HELP opendtu_Voltage in V\n# TYPE opendtu_Voltage gauge\n" },
+        { "Current", "# HELP opendtu_Current in A\n# TYPE opendtu_Current gauge\n" },
+        { "PowerDC", "# HELP opendtu_PowerDC in W\n# TYPE opendtu_PowerDC gauge\n" },
+        { "YieldDay", "# HELP opendtu_YieldDay in Wh\n# TYPE opendtu_YieldDay counter\n" },
+        { "YieldTotal", "# HELP opendtu_YieldTotal in kWh\n# TYPE opendtu_YieldTotal counter\n" },
+        { "Frequency", "# HELP opendtu_Frequency in Hz\n# TYPE opendtu_Frequency gauge\n" },
+        { "Temperature", "# HELP opendtu_Temperature in °C\n# TYPE opendtu_Temperature gauge\n" },
+        { "PowerFactor", "# HELP opendtu_PowerFactor in \n# TYPE opendtu_PowerFactor gauge\n" },
+        { "ReactivePower", "# HELP opendtu_ReactivePower in var\n# TYPE opendtu_ReactivePower gauge\n" },
+        { "Efficiency", "# HELP opendtu_Efficiency in %\n# TYPE opendtu_Efficiency gauge\n" },
+        { "Irradiation", "# HELP opendtu_Irradiation in %\n# TYPE opendtu_Irradiation gauge\n" },
     };
 
-    const publish_type_t _publishFields[14] = {
-        { FLD_PAC, MetricType_t::GAUGE },
-        { FLD_UAC, MetricType_t::GAUGE },
-        { FLD_IAC, MetricType_t::GAUGE },
-        { FLD_PDC, MetricType_t::GAUGE },
-        { FLD_UDC, MetricType_t::GAUGE },
-        { FLD_IDC, MetricType_t::GAUGE },
-        { FLD_YD, MetricType_t::COUNTER },
-        { FLD_YT, MetricType_t::COUNTER },
-        { FLD_F, MetricType_t::GAUGE },
-        { FLD_T, MetricType_t::GAUGE },
-        { FLD_PF, MetricType_t::GAUGE },
-        { FLD_Q, MetricType_t::GAUGE },
-        { FLD_EFF, MetricType_t::GAUGE },
-        { FLD_IRR, MetricType_t::GAUGE },
+    static constexpr FieldId_t _publishFields[] = {
+        FLD_PAC,
+        FLD_UAC,
+        FLD_IAC,
+        FLD_PDC,
+        FLD_UDC,
+        FLD_IDC,
+        FLD_YD,
+        FLD_YT,
+        FLD_F,
+        FLD_T,
+        FLD_PF,
+        FLD_Q,
+        FLD_EFF,
+        FLD_IRR,
     };
 };
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// dispatches the requests of all plain routes, i.e., routes without upload
+// or body handler, by a single hash lookup of the URL. the web server
+// otherwise asks every registered handler in turn whether it handles a
+// request, which compares the URL against each route. the router also
+// counts the requests per route and measures the time spent in each
+// request handler, i.e., until the response was queued, not sent.
+//
+// the time spent in request handlers is limited by a leaky bucket, which
+// is drained at BudgetMicrosPerSecond. while the bucket is full, requests
+// of routes which take FairShareMicros or more on average are answered
+// with 503 and a Retry-After header, such that a burst of expensive
+// requests cannot starve the other users of the core. cheap requests are
+// always served.
+class WebApiRouterClass : public AsyncWebHandler {
+public:
+    // the URI must have static storage duration, e.g., a string literal.
+    // a method composite registers the handler for each of its methods.
+    void on(char const* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest);
+
+    bool canHandle(AsyncWebServerRequest* request) const final;
+    void handleRequest(AsyncWebServerRequest* request) final;
+    bool isRequestHandlerTrivial() const final { return false; }
+
+    struct Stats {
+        char const* Uri;
+        WebRequestMethodComposite Method;
+        uint32_t Count;
+        uint64_t TotalMicros;
+        uint32_t MaxMicros;
+        uint32_t Overruns; // requests which took longer than RequestBudgetMicros
+        uint32_t Rejected; // requests refused as the budget was used up
+    };
+
+    // a snapshot of the counters of all routes. must be called from a
+    // request handler, as the counters are only updated by the task of
+    // the web server.
+    std::vector<Stats> getStats() const;
+
+private:
+    struct Route {
+        WebRequestMethodComposite Method;
+        ArRequestHandlerFunction OnRequest;
+        uint32_t Count = 0;
+        uint64_t TotalMicros = 0;
+        uint32_t MaxMicros = 0;
+        uint32_t Overruns = 0;
+        uint32_t Rejected = 0;
+    };
+
+    static constexpr uint32_t BudgetMicrosPerSecond = 250 * 1000;
+    static constexpr uint32_t FairShareMicros = 20 * 1000;
+    static constexpr uint32_t RequestBudgetMicros = 50 * 1000;
+
+    // true if the request was refused
+    bool isOverBudget(AsyncWebServerRequest* request, Route& route, int64_t now);
+
+    // a URL is registered for few methods, mostly GET and POST, such that
+    // the routes of a URL are searched linearly.
+    using Routes = std::vector<Route>;
+
+    Route const* find(AsyncWebServerRequest* request) const;
+
+    std::unordered_map<std::string_view, Routes> _routes;
+
+    // only used by the task of the web server
+    uint64_t _bucketMicros = 0;
+    int64_t _bucketUpdated = 0;
+};
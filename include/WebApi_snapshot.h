@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "JsonFragmentCache.h"
+#include "WebApi_sysstatus.h"
+#include "WebApi_ws_battery.h"
+#include "WebApi_ws_Huawei.h"
+#include "WebApi_ws_live.h"
+#include "WebApi_ws_solarcharger_live.h"
+#include <ESPAsyncWebServer.h>
+#include <TaskSchedulerDeclarations.h>
+
+// /api/snapshot combines the documents of the live data endpoints, the
+// power limiter status and the system status into a single response, such
+// that a monitoring cycle costs one request and all values are captured in
+// the same moment. the sections are selected by "?include=live,battery,...",
+// all sections are included by default. the snapshot is generated at most
+// once per second and section selection, concurrent pollers share it.
+class WebApiSnapshotClass {
+public:
+    WebApiSnapshotClass(WebApiWsLiveClass& live, WebApiWsBatteryLiveClass& battery,
+            WebApiWsSolarChargerLiveClass& solarCharger, WebApiWsHuaweiLiveClass& huawei,
+            WebApiSysstatusClass& sysstatus);
+
+    void init(AsyncWebServer& server, Scheduler& scheduler);
+
+private:
+    enum Section : uint8_t {
+        Live = 1 << 0,
+        Battery = 1 << 1,
+        SolarCharger = 1 << 2,
+        Huawei = 1 << 3,
+        PowerLimiter = 1 << 4,
+        System = 1 << 5,
+        All = (1 << 6) - 1
+    };
+
+    static uint8_t parseSections(AsyncWebServerRequest* request);
+    void generate(JsonVariant& root, uint8_t sections);
+    void onSnapshotGet(AsyncWebServerRequest* request);
+
+    WebApiWsLiveClass& _live;
+    WebApiWsBatteryLiveClass& _battery;
+    WebApiWsSolarChargerLiveClass& _solarCharger;
+    WebApiWsHuaweiLiveClass& _huawei;
+    WebApiSysstatusClass& _sysstatus;
+
+    JsonFragmentCache _cache;
+};
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <TaskSchedulerDeclarations.h>
+#include <atomic>
+
+// a stream of Server-Sent Events at /api/events, for clients which only
+// read the live data, e.g., wall displays and scripts. every document which
+// is published to the websockets is sent as an event named after its
+// channel ("live", "battery", "solarcharger" or "huawei"), its data being
+// the JSON document. like the websocket frames, events are sent on change
+// only, and the live channel carries the changed inverter values only,
+// unless a full update is due or a client connected.
+class WebApiSseClass {
+public:
+    WebApiSseClass();
+    void init(AsyncWebServer& server, Scheduler& scheduler);
+    void reload();
+
+    bool hasClients() const { return _events.count() > 0; }
+
+    // true once for each publisher after a client connected, which relies
+    // on a full update. the publisher holds the number of connections it
+    // has seen.
+    bool takeResyncRequest(uint32_t& seenConnects) const;
+
+    // the serialization of the document may be passed if it is at hand,
+    // e.g., from a JsonFragmentCache
+    void publish(char const* channel, JsonDocument const& root, AsyncWebSocketSharedBuffer spText = nullptr);
+
+private:
+    AsyncEventSource _events;
+    AsyncAuthenticationMiddleware _simpleDigestAuth;
+    std::atomic<uint32_t> _connects = 0;
+};
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <ArduinoJson.h>
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
 
@@ -8,6 +9,13 @@ class WebApiSysstatusClass {
 public:
     void init(AsyncWebServer& server, Scheduler& scheduler);
 
+    // the document of /api/system/status, also part of /api/snapshot
+    void generateStatus(JsonVariant& root);
+
 private:
     void onSystemStatus(AsyncWebServerRequest* request);
+    void onSystemTasks(AsyncWebServerRequest* request);
+    void onSystemHeap(AsyncWebServerRequest* request);
+    void onSystemSpi(AsyncWebServerRequest* request);
+    void onSystemRoutes(AsyncWebServerRequest* request);
 };
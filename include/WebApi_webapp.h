@@ -10,4 +10,8 @@ public:
 
 private:
     void responseBinaryDataWithETagCache(AsyncWebServerRequest* request, const String &contentType, const String &contentEncoding, const uint8_t *content, size_t len);
+
+    // ships the brotli variant if the client accepts it, gzip otherwise
+    void responseCompressedDataWithETagCache(AsyncWebServerRequest* request, const String& contentType,
+        const uint8_t* gzContent, size_t gzLen, const uint8_t* brContent, size_t brLen);
 };
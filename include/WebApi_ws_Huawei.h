@@ -2,27 +2,38 @@
 #pragma once
 
 #include "ArduinoJson.h"
+#include "JsonFragmentCache.h"
+#include "WebApi_sse.h"
+#include "WebApi_ws_mux.h"
+#include "WebApi_ws_publisher.h"
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
 #include <mutex>
 
 class WebApiWsHuaweiLiveClass {
 public:
-    WebApiWsHuaweiLiveClass();
+    WebApiWsHuaweiLiveClass(WebApiWsMuxClass& mux, WebApiSseClass& sse);
     void init(AsyncWebServer& server, Scheduler& scheduler);
     void reload();
 
+    // shared by the websockets, the REST API and /api/snapshot
+    JsonFragmentCache::Fragment getFragment();
+
 private:
-    void generateCommonJsonResponse(JsonVariant& root);
     void onLivedataStatus(AsyncWebServerRequest* request);
     void onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
 
     AsyncWebServer* _server;
     AsyncWebSocket _ws;
+    WebApiWsPublisher _publisher;
+    WebApiWsPublisher _muxPublisher; // see WebApiWsMuxClass
+    WebApiSseClass& _sse;
+    uint32_t _sseConnects = 0; // see WebApiSseClass::takeResyncRequest()
     AsyncAuthenticationMiddleware _simpleDigestAuth;
 
-    std::mutex _mutex;
-    
+    // shared by the websocket and the REST API
+    JsonFragmentCache _cache;
+
     Task _wsCleanupTask;
     void wsCleanupTaskCb();
 
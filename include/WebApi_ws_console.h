@@ -3,6 +3,9 @@
 
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
+#include <mutex>
+#include <string>
+#include <vector>
 
 class WebApiWsConsoleClass {
 public:
@@ -16,4 +19,31 @@ private:
 
     Task _wsCleanupTask;
     void wsCleanupTaskCb();
+
+    // lines are collected per client and sent as one frame every
+    // BatchIntervalMillis, or earlier once MaxFrameSize is reached.
+    static constexpr uint32_t BatchIntervalMillis = 100;
+    static constexpr size_t MaxFrameSize = 2048;
+
+    Task _flushTask;
+    void flushTaskCb();
+
+    void onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
+    void onLine(uint8_t const* data, size_t size);
+
+    struct Client {
+        uint32_t Id;
+        // a line is forwarded if it starts with any of the prefixes. all
+        // lines are forwarded if there are none.
+        std::vector<std::string> Filters;
+        std::vector<uint8_t> Batch;
+        uint32_t Dropped = 0; // lines not sent as the client fell behind
+    };
+
+    static bool matches(Client const& client, uint8_t const* data, size_t size);
+    bool send(Client& client);
+
+    // clients connect and send filters in the context of the async TCP task
+    std::mutex _mutex;
+    std::vector<Client> _clients;
 };
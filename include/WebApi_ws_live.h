@@ -3,40 +3,72 @@
 
 #include "Configuration.h"
 #include <ArduinoJson.h>
+#include "WebApi_sse.h"
+#include "WebApi_ws_mux.h"
+#include "WebApi_ws_publisher.h"
 #include <ESPAsyncWebServer.h>
 #include <Hoymiles.h>
 #include <TaskSchedulerDeclarations.h>
+#include <atomic>
+#include <unordered_map>
 
 class WebApiWsLiveClass {
 public:
-    WebApiWsLiveClass();
+    WebApiWsLiveClass(WebApiWsMuxClass& mux, WebApiSseClass& sse);
     void init(AsyncWebServer& server, Scheduler& scheduler);
     void reload();
 
+    // the document of /api/livedata/status with the channels of all
+    // inverters, part of /api/snapshot
+    void generateSnapshot(JsonVariant& root);
+
 private:
+    // values last sent to the websocket clients, keyed by channel type,
+    // channel number and field id (see fieldKey())
+    using LastSentValues = std::unordered_map<uint16_t, float>;
+
+    struct InverterPublishState {
+        uint64_t serial = 0;
+        uint32_t lastPublish = 0;
+        uint32_t lastKeyframe = 0;
+        LastSentValues values;
+    };
+
     static void generateInverterCommonJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv);
-    static void generateInverterChannelJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv);
+    static void generateInverterChannelJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv, LastSentValues* lastSent = nullptr, bool deltaOnly = false);
     static void generateCommonJsonResponse(JsonVariant& root);
 
     void generateOnBatteryJsonResponse(JsonVariant& root, bool all);
     void sendOnBatteryStats();
 
-    static void addField(JsonObject& root, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, String topic = "");
+    static void addField(JsonObject& root, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, String topic = "", LastSentValues* lastSent = nullptr, bool deltaOnly = false);
+    static uint16_t fieldKey(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId);
     static void addTotalField(JsonObject& root, const String& name, const float value, const String& unit, const uint8_t digits);
 
+    static String getLivedataETag(uint64_t serial);
     void onLivedataStatus(AsyncWebServerRequest* request);
     void onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
 
     AsyncWebSocket _ws;
+    WebApiWsPublisher _publisher;
+    WebApiWsPublisher _muxPublisher; // see WebApiWsMuxClass
+    WebApiSseClass& _sse;
+    uint32_t _sseConnects = 0; // see WebApiSseClass::takeResyncRequest()
     AsyncAuthenticationMiddleware _simpleDigestAuth;
 
     uint32_t _lastPublishOnBatteryFull = 0;
-    uint32_t _lastPublishSolarCharger = 0;
     uint32_t _lastPublishHuawei = 0;
-    uint32_t _lastPublishBattery = 0;
-    uint32_t _lastPublishPowerMeter = 0;
 
-    uint32_t _lastPublishStats[INV_MAX_COUNT] = { 0 };
+    // see DataBusClass::getSequence()
+    uint32_t _lastSolarChargerSequence = 0;
+    uint32_t _lastBatterySequence = 0;
+    uint32_t _lastPowerMeterSequence = 0;
+    uint32_t _lastDplDecisionSequence = 0;
+
+    InverterPublishState _publishStates[INV_MAX_COUNT];
+
+    // a freshly connected client relies on a full frame for every inverter
+    std::atomic<bool> _forceKeyframe = false;
 
     std::mutex _mutex;
 
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "WebApi_ws_publisher.h"
+#include <ESPAsyncWebServer.h>
+#include <TaskSchedulerDeclarations.h>
+#include <vector>
+
+// a single websocket which carries the data of all live views, such that a
+// browser showing the dashboard keeps one connection instead of one per
+// view. the live data classes publish to it through publishers which are
+// assigned a channel (see WebApiWsPublisher), and the clients subscribe to
+// the channels they display.
+class WebApiWsMuxClass {
+public:
+    WebApiWsMuxClass();
+    void init(AsyncWebServer& server, Scheduler& scheduler);
+    void reload();
+
+    AsyncWebSocket& getSocket() { return _ws; }
+
+    // the publisher receives the events of the websocket. to be called
+    // before init().
+    void addPublisher(WebApiWsPublisher& publisher);
+
+private:
+    void onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
+
+    AsyncWebSocket _ws;
+    AsyncAuthenticationMiddleware _simpleDigestAuth;
+    std::vector<WebApiWsPublisher*> _publishers;
+
+    Task _wsCleanupTask;
+    void wsCleanupTaskCb();
+};
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// sends JSON documents to all clients of a websocket. clients which sent
+// the text message "encoding:msgpack" receive MessagePack frames instead,
+// in which object keys are replaced by indices into a dictionary. each
+// frame is an array [base, [keys...], payload], which adds the given keys
+// to the client's dictionary, starting at index base. only keys which the
+// client does not know yet are sent.
+//
+// a frame is skipped for a client which did not yet drain the previous one,
+// and the interval at which such a client is served grows until it keeps
+// up again. hence at most one frame is queued per client.
+//
+// several publishers may share a websocket if each is given a channel (see
+// WebApiWsMuxClass). a client is then only served by the publishers whose
+// channels it listed in its text message "subscribe:<channel>,...". text
+// frames are wrapped as {"channel": ..., "data": ...} and binary frames
+// are arrays [channel, base, [keys...], payload], each channel having its
+// own dictionary.
+class WebApiWsPublisher {
+public:
+    explicit WebApiWsPublisher(AsyncWebSocket& ws, char const* channel = nullptr);
+
+    // to be called by the websocket's event handler
+    void onWebsocketEvent(AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
+
+    // the serialization of the document may be passed if it is at hand,
+    // e.g., from a JsonFragmentCache. it is sent to the text clients of a
+    // websocket without channel.
+    void publish(JsonDocument const& root, AsyncWebSocketSharedBuffer spText = nullptr);
+
+    // true if any client is to be served, i.e., a client is connected to a
+    // websocket of its own, or a client subscribed to the channel
+    bool hasClients();
+
+    // true once after a client which skipped frames caught up again. streams
+    // which send changes only must send a full update next.
+    bool takeResyncRequest();
+
+private:
+    struct Client {
+        uint32_t Id;
+        bool Subscribed;
+        bool Binary = false;
+        uint16_t KnownKeys = 0;
+        uint32_t IntervalMillis = 0;
+        uint32_t LastSentMillis = 0;
+        bool Skipped = false;
+    };
+
+    void encodeValue(std::vector<uint8_t>& out, JsonVariantConst value);
+    void encodeKey(std::vector<uint8_t>& out, char const* key);
+    AsyncWebSocketSharedBuffer buildBinaryFrame(uint16_t base) const;
+    Client& getClient(uint32_t id);
+    bool isSendDue(AsyncWebSocketClient& client, Client& state);
+    bool isSubscription(uint8_t const* data, size_t len) const;
+    AsyncWebSocketSharedBuffer buildTextFrame(JsonDocument const& root) const;
+
+    // keys beyond this limit are sent as strings
+    static constexpr size_t MaxKeys = 512;
+
+    static constexpr uint32_t MinBackoffMillis = 250;
+    static constexpr uint32_t MaxBackoffMillis = 8 * 1000;
+
+    AsyncWebSocket& _ws;
+    char const* _channel;
+    std::mutex _mutex;
+
+    std::vector<std::string> _keys;
+    std::unordered_map<std::string, uint16_t> _keyIndices;
+    std::vector<Client> _clients;
+    bool _resyncRequested = false;
+
+    // MessagePack encoding of the document which is currently published
+    std::vector<uint8_t> _payload;
+};
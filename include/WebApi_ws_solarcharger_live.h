@@ -3,6 +3,9 @@
 
 #include "ArduinoJson.h"
 #include "Configuration.h"
+#include "WebApi_sse.h"
+#include "WebApi_ws_mux.h"
+#include "WebApi_ws_publisher.h"
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
 #include <VeDirectMpptController.h>
@@ -10,10 +13,14 @@
 
 class WebApiWsSolarChargerLiveClass {
 public:
-    WebApiWsSolarChargerLiveClass();
+    WebApiWsSolarChargerLiveClass(WebApiWsMuxClass& mux, WebApiSseClass& sse);
     void init(AsyncWebServer& server, Scheduler& scheduler);
     void reload();
 
+    // the document of /api/solarchargerlivedata/status with all values,
+    // also part of /api/snapshot
+    void generateSnapshot(JsonVariant& root);
+
 private:
     void generateCommonJsonResponse(JsonVariant& root, bool fullUpdate);
     void onLivedataStatus(AsyncWebServerRequest* request);
@@ -21,6 +28,10 @@ private:
 
     AsyncWebServer* _server;
     AsyncWebSocket _ws;
+    WebApiWsPublisher _publisher;
+    WebApiWsPublisher _muxPublisher; // see WebApiWsMuxClass
+    WebApiSseClass& _sse;
+    uint32_t _sseConnects = 0; // see WebApiSseClass::takeResyncRequest()
     AsyncAuthenticationMiddleware _simpleDigestAuth;
 
     uint32_t _lastFullPublish = 0;
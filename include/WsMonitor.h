@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+#include <TaskSchedulerDeclarations.h>
+#include <mutex>
+#include <sdkconfig.h>
+#include <stdint.h>
+#include <vector>
+
+// samples the message queues and the TCP send buffers of the clients of all
+// websockets once per second. a client whose message queue did not become
+// empty for BacklogLimitSeconds is closed, as it holds memory for frames it
+// will not take anyway. it reconnects and receives a full update then. the
+// limit shrinks while the free heap is low.
+class WsMonitorClass {
+public:
+    WsMonitorClass();
+    void init(Scheduler& scheduler);
+
+    // to be called when the websocket is added to the server
+    void addSocket(AsyncWebSocket& ws);
+
+    struct SocketStats {
+        char const* Url;
+        uint8_t Clients;
+        uint32_t QueuedMessages; // of all clients
+        uint32_t MaxQueueLength; // of any client
+        uint32_t PeakQueueLength; // since startup
+        uint32_t SendBufferUsed; // bytes not acknowledged, of all clients
+        uint32_t MaxSendBufferUsed; // of any client
+        uint8_t BackloggedClients; // whose queue is not empty
+        uint32_t ClosedClients; // due to a persistent backlog
+    };
+    std::vector<SocketStats> getStats() const;
+
+    // the send buffer of each TCP connection
+    static constexpr uint32_t SendBufferSize = CONFIG_LWIP_TCP_SND_BUF_DEFAULT;
+
+    uint32_t getBacklogLimitSeconds() const;
+
+private:
+    void loop();
+
+    struct Client {
+        AsyncWebSocket const* pSocket;
+        uint32_t Id;
+        uint32_t BacklogSeconds;
+        bool Closing;
+        uint32_t ClosingSeconds;
+    };
+
+    static constexpr uint32_t BacklogLimitSeconds = 30;
+    static constexpr uint32_t LowHeapBacklogLimitSeconds = 5;
+    static constexpr uint32_t LowHeapBytes = 32 * 1024;
+
+    // a client which did not complete the close handshake in time is
+    // disconnected without it
+    static constexpr uint32_t AbortSeconds = 5;
+
+    Task _loopTask;
+
+    mutable std::mutex _mutex;
+    std::vector<AsyncWebSocket*> _sockets;
+    std::vector<SocketStats> _stats;
+    std::vector<Client> _clients;
+    uint32_t _backlogLimitSeconds = BacklogLimitSeconds;
+};
+
+extern WsMonitorClass WsMonitor;
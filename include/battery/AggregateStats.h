@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <battery/Stats.h>
+#include <memory>
+#include <vector>
+
+namespace Batteries {
+
+// combines the stats of batteries connected in parallel, each of which is
+// read by its own provider: the currents are summed up, the SoC is either
+// the minimum or the capacity-weighted mean (see the battery settings) and
+// the voltage and the current limits are the minimum of all batteries. the
+// combined values are recalculated when a battery was updated, such that
+// reading them is as cheap as reading the values of a single battery.
+class AggregateStats : public Stats {
+public:
+    explicit AggregateStats(std::vector<std::shared_ptr<Stats const>> packs);
+
+    size_t getPackCount() const { return _packs.size(); }
+    std::shared_ptr<Stats const> getPack(size_t index) const;
+
+    // recalculates the combined values if any battery was updated since
+    // the last call. returns true if the values were recalculated.
+    bool update();
+
+    void getLiveViewData(JsonVariant& root) const final;
+
+    bool getImmediateChargingRequest() const final { return _immediateChargingRequest; }
+    float getChargeCurrentLimitation() const final { return _chargeCurrentLimitation; }
+    std::optional<float> getCapacityAmpHours() const final { return _oCapacity; }
+
+private:
+    void aggregate();
+    void updateManufacturer();
+
+    struct Pack {
+        std::shared_ptr<Stats const> spStats;
+        uint32_t lastUpdate = 0;
+    };
+    std::vector<Pack> _packs;
+
+    size_t _knownManufacturers = 0;
+    bool _immediateChargingRequest = false;
+    float _chargeCurrentLimitation = FLT_MAX;
+    std::optional<float> _oCapacity = std::nullopt; // if all batteries report it
+};
+
+} // namespace Batteries
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Batteries {
+
+// a non-owning view on a bounded range of bytes, e.g., a frame in a receive
+// buffer. the viewed bytes must outlive the view.
+class ByteSpan {
+public:
+    using const_iterator = uint8_t const*;
+
+    ByteSpan() = default;
+    ByteSpan(uint8_t const* data, size_t size) : _data(data), _size(size) { }
+
+    uint8_t const* data() const { return _data; }
+    size_t size() const { return _size; }
+
+    const_iterator cbegin() const { return _data; }
+    const_iterator cend() const { return _data + _size; }
+
+    uint8_t operator[](size_t idx) const { return _data[idx]; }
+
+private:
+    uint8_t const* _data = nullptr;
+    size_t _size = 0;
+};
+
+} // namespace Batteries
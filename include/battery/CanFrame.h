@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Arduino.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include <driver/twai.h>
+
+namespace Batteries::CanFrame {
+
+// the encoding of a value within the (little-endian) payload of a frame
+enum class Type : uint8_t {
+    U8, U16, S16, S24, U32,
+    Bit, // a single bit of the byte at the offset
+    Text, // the whole payload as a string
+    Frame // the whole payload, decoded by a handler of its own
+};
+
+// reads the value of the given type at the given offset, scaled and biased.
+// returns std::nullopt if the frame is too short to hold the value.
+std::optional<float> readValue(twai_message_t const& frame, Type type,
+        uint8_t offset, uint8_t bit, float scale, float bias);
+
+// returns the payload as string, or std::nullopt if it is empty or does not
+// start with a printable character.
+std::optional<String> readText(twai_message_t const& frame);
+
+void logValue(char const* tag, char const* name, float value);
+void logText(char const* tag, char const* name, String const& text);
+
+// describes one value within the frames of a protocol. the values are
+// assigned to the stats of type S by captureless lambdas, which are
+// converted to function pointers, such that a table of fields is a
+// constant expression.
+template<typename S>
+struct Field {
+    using ValueSetter = void (*)(S&, float);
+    using TextSetter = void (*)(S&, String const&);
+    using FrameHandler = void (*)(S&, twai_message_t const&, bool verboseLogging);
+
+    uint32_t Id;
+    Type Kind;
+    uint8_t Offset;
+    uint8_t Bit;
+    float Scale;
+    float Bias;
+    char const* Name;
+    ValueSetter SetValue;
+    TextSetter SetText;
+    FrameHandler Handle;
+
+    static constexpr Field value(uint32_t id, Type type, uint8_t offset,
+            float scale, char const* name, ValueSetter set, float bias = 0)
+    {
+        return { id, type, offset, 0, scale, bias, name, set, nullptr, nullptr };
+    }
+
+    static constexpr Field bit(uint32_t id, uint8_t offset, uint8_t bit,
+            char const* name, ValueSetter set)
+    {
+        return { id, Type::Bit, offset, bit, 1, 0, name, set, nullptr, nullptr };
+    }
+
+    static constexpr Field text(uint32_t id, char const* name, TextSetter set)
+    {
+        return { id, Type::Text, 0, 0, 1, 0, name, nullptr, set, nullptr };
+    }
+
+    static constexpr Field frame(uint32_t id, FrameHandler handle)
+    {
+        return { id, Type::Frame, 0, 0, 1, 0, "", nullptr, nullptr, handle };
+    }
+
+    void apply(S& stats, twai_message_t const& frame, char const* tag, bool verboseLogging) const
+    {
+        switch (Kind) {
+            case Type::Text: {
+                auto oText = readText(frame);
+                if (!oText) { return; }
+                if (verboseLogging) { logText(tag, Name, *oText); }
+                SetText(stats, *oText);
+                return;
+            }
+            case Type::Frame:
+                Handle(stats, frame, verboseLogging);
+                return;
+            default: {
+                auto oValue = readValue(frame, Kind, Offset, Bit, Scale, Bias);
+                if (!oValue) { return; }
+                if (verboseLogging) { logValue(tag, Name, *oValue); }
+                SetValue(stats, *oValue);
+                return;
+            }
+        }
+    }
+};
+
+// the description of all frames of a protocol, sorted by identifier, such
+// that decoding a frame costs a binary search and the fields of the frame.
+template<typename S>
+class FrameTable {
+public:
+    template<size_t N>
+    constexpr FrameTable(Field<S> const (&fields)[N])
+        : _pFields(fields), _count(N) { }
+
+    constexpr bool isSorted() const
+    {
+        for (size_t i = 1; i < _count; ++i) {
+            if (_pFields[i].Id < _pFields[i - 1].Id) { return false; }
+        }
+        return true;
+    }
+
+    // the identifiers of all described frames, from which the hardware
+    // acceptance filter is generated.
+    std::vector<uint32_t> getIds() const
+    {
+        std::vector<uint32_t> ids;
+        for (size_t i = 0; i < _count; ++i) {
+            if (ids.empty() || ids.back() != _pFields[i].Id) {
+                ids.push_back(_pFields[i].Id);
+            }
+        }
+        return ids;
+    }
+
+    // applies all fields of the frame to the stats. returns false if the
+    // frame is not described by this table.
+    bool decode(twai_message_t const& frame, S& stats, char const* tag, bool verboseLogging) const
+    {
+        auto pEnd = _pFields + _count;
+        auto pField = std::lower_bound(_pFields, pEnd, frame.identifier,
+                [](Field<S> const& field, uint32_t id) { return field.Id < id; });
+        if (pField == pEnd || pField->Id != frame.identifier) { return false; }
+
+        for (; pField != pEnd && pField->Id == frame.identifier; ++pField) {
+            pField->apply(stats, frame, tag, verboseLogging);
+        }
+
+        return true;
+    }
+
+private:
+    Field<S> const* _pFields;
+    size_t _count;
+};
+
+} // namespace Batteries::CanFrame
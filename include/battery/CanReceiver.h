@@ -1,8 +1,10 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <atomic>
 #include <stdint.h>
-#include <driver/twai.h>
+#include <vector>
+#include <TwaiBus.h>
 #include <battery/Provider.h>
 
 namespace Batteries {
@@ -13,21 +15,36 @@ public:
     void deinit() final;
     void loop() final;
 
-    virtual void onMessage(twai_message_t rx_message) = 0;
+    virtual void onMessage(twai_message_t const& rx_message) = 0;
 
 protected:
-    uint8_t readUnsignedInt8(uint8_t *data);
-    uint16_t readUnsignedInt16(uint8_t *data);
-    int16_t readSignedInt16(uint8_t *data);
-    uint32_t readUnsignedInt32(uint8_t *data);
-    int32_t readSignedInt24(uint8_t *data);
-    float scaleValue(int32_t value, float factor);
-    bool getBit(uint8_t value, uint8_t bit);
+    // the (standard) identifiers of the messages the provider processes.
+    // the hardware acceptance filter is programmed to let at least these
+    // messages pass. an empty list accepts all messages.
+    virtual std::vector<uint32_t> getMessageIds() const { return {}; }
+
+    // for the frames which a table of CanFrame::Field cannot describe
+    static uint8_t readUnsignedInt8(uint8_t const* data);
+    static uint16_t readUnsignedInt16(uint8_t const* data);
+    static int16_t readSignedInt16(uint8_t const* data);
+    static uint32_t readUnsignedInt32(uint8_t const* data);
+    static int32_t readSignedInt24(uint8_t const* data);
+    static float scaleValue(int32_t value, float factor);
+    static bool getBit(uint32_t value, uint8_t bit);
 
     bool _verboseLogging = true;
 
 private:
+    twai_filter_config_t getFilterConfig() const;
+
     char const* _providerName = "Battery CAN";
+
+    static constexpr UBaseType_t FrameQueueLength = 32;
+    static constexpr size_t MaxFramesPerLoop = 16;
+    TwaiBusClass::Subscription* _pSubscription = nullptr;
+
+    uint32_t _reportedLostFrames = 0;
+    uint32_t _lastLostFramesReport = 0;
 };
 
 } // namespace Batteries
@@ -3,7 +3,10 @@
 
 #include <memory>
 #include <mutex>
+#include <vector>
 #include <TaskSchedulerDeclarations.h>
+#include <battery/AggregateStats.h>
+#include <battery/HassIntegration.h>
 #include <battery/Provider.h>
 #include <battery/Stats.h>
 
@@ -16,14 +19,27 @@ public:
 
     float getDischargeCurrentLimit();
 
+    // the stats of the battery, which combine the stats of all batteries
+    // if additional providers are configured
     std::shared_ptr<Stats const> getStats() const;
 
+    // the stats of the individual batteries, in the order of their
+    // providers, the main provider first
+    size_t getPackCount() const;
+    std::shared_ptr<Stats const> getPackStats(size_t index) const;
+
+    void restoreSoC(float soc, uint8_t precision, uint32_t ageMillis);
+
 private:
     void loop();
+    std::unique_ptr<Provider> createProvider(uint8_t provider) const;
 
     Task _loopTask;
     mutable std::mutex _mutex;
-    std::unique_ptr<Provider> _upProvider = nullptr;
+    std::vector<std::unique_ptr<Provider>> _providers;
+    std::shared_ptr<AggregateStats> _spAggregateStats = nullptr;
+    std::shared_ptr<HassIntegration> _spAggregateHassIntegration = nullptr;
+    uint32_t _lastStatsUpdate = 0;
 };
 
 } // namespace Batteries
@@ -11,6 +11,7 @@ namespace Batteries {
 class HassIntegration {
 public:
     explicit HassIntegration(std::shared_ptr<Stats> spStats);
+    virtual ~HassIntegration();
 
     void hassLoop();
 
@@ -28,6 +29,15 @@ protected:
     virtual void publishSensors() const;
 
 private:
+    // the discovery documents are created once the paced publisher gets to them
+    void generateBinarySensor(const char* caption,
+            const char* icon, const char* subTopic,
+            const char* payload_on, const char* payload_off) const;
+    void generateSensor(const char* caption, const char* icon,
+            const char* subTopic, const char* deviceClass,
+            const char* stateClass,
+            const char* unitOfMeasurement) const;
+
     String _serial = "0001"; // pseudo-serial, can be replaced in future with real serialnumber
     std::shared_ptr<Stats> _spStats = nullptr;
 
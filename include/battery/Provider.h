@@ -1,7 +1,9 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <atomic>
 #include <memory>
+#include <stdint.h>
 
 namespace Batteries {
 
@@ -10,12 +12,43 @@ class HassIntegration;
 
 class Provider {
 public:
+    virtual ~Provider() = default;
+
     // returns true if the provider is ready for use, false otherwise
     virtual bool init(bool verboseLogging) = 0;
     virtual void deinit() = 0;
     virtual void loop() = 0;
     virtual std::shared_ptr<Stats> getStats() const = 0;
     virtual std::shared_ptr<HassIntegration> getHassIntegration() = 0;
+
+    // selects the pins the provider uses for its interface, 0 for the
+    // battery pins and 1 for the battery2 pins. must be set before init().
+    void setPinSet(uint8_t pinSet) { _pinSet = pinSet; }
+
+protected:
+    struct Pins {
+        int8_t Rx;
+        int8_t RxEnable;
+        int8_t Tx;
+        int8_t TxEnable;
+    };
+    Pins getPins() const;
+    uint8_t getPinSet() const { return _pinSet; }
+
+    // for providers polling their BMS. the configured interval applies
+    // unless the battery is about to reach the DPL's stop threshold while
+    // discharging, or is charged by the grid charger, which asks for fresh
+    // data every second, or while the battery is idle, which only asks for
+    // data every few intervals. to be called from the main loop, as the
+    // DPL and the grid charger are consulted.
+    void updatePollInterval(uint8_t configuredSeconds, bool verboseLogging);
+
+    // thread-safe, e.g., for the serial task sending the requests
+    uint32_t getPollIntervalMillis() const { return _pollIntervalMillis; }
+
+private:
+    uint8_t _pinSet = 0;
+    std::atomic<uint32_t> _pollIntervalMillis = 0;
 };
 
 } // namespace Batteries
@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <optional>
+#include <stdint.h>
+
+namespace Batteries {
+
+// estimates the internal resistance of the battery pack by fitting a line
+// to paired (current, voltage) samples, where the slope is the resistance
+// and the intercept is the voltage of the idle pack. the samples are
+// weighted exponentially, such that the fit follows changes due to
+// temperature and state of charge.
+class ResistanceEstimator {
+public:
+    void reset();
+
+    // current: positive while charging, in A. voltage: measured at the
+    // same time as the current, in V.
+    void update(float current, float voltage);
+
+    // the internal resistance in Ohm. std::nullopt until the fit is
+    // trustworthy, i.e., until the samples cover a sufficient range of
+    // currents and the resistance is plausible.
+    std::optional<float> getResistance() const;
+
+    // coefficient of determination (0..1) of the fit
+    float getFitQuality() const;
+
+    uint32_t getSamples() const { return _samples; }
+
+private:
+    // the weight of a sample decays by this factor with every new sample
+    static constexpr float Decay = 0.995f;
+
+    // the standard deviation of the current must be at least 1 A
+    static constexpr float MinCurrentVariance = 1.0f;
+
+    static constexpr uint32_t MinSamples = 30;
+    static constexpr float MaxResistance = 1.0f;
+
+    uint32_t _samples = 0;
+    float _weight = 0;
+    float _meanCurrent = 0;
+    float _meanVoltage = 0;
+    float _varCurrent = 0;
+    float _varVoltage = 0;
+    float _covariance = 0;
+};
+
+} // namespace Batteries
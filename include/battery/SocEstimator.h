@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <optional>
+#include <stdint.h>
+
+namespace Batteries {
+
+// estimates the SoC between the battery's SoC updates by integrating the
+// battery current (coulomb counting). many batteries report the SoC only
+// every few seconds or in steps of 1 %. whenever the battery reports its
+// SoC, the estimate is kept if it still rounds to the reported value and
+// is moved to the nearest value that does otherwise, which corrects the
+// drift without discarding the resolution gained by integration.
+class SocEstimator {
+public:
+    void reset();
+
+    // soc: as reported by the battery, with the given amount of decimal
+    // places, reported at socTimestamp. current: positive while charging,
+    // in A. capacity: the usable capacity of the battery in Ah.
+    void update(float soc, uint8_t precision, uint32_t socTimestamp,
+            float current, float capacity, uint32_t now);
+
+    // std::nullopt until the battery reported its SoC, and if either the
+    // SoC or the current was not updated for too long.
+    std::optional<float> getSoC(uint32_t now) const;
+
+private:
+    // the estimate may not deviate further from the last reported SoC
+    static constexpr float MaxDeviation = 3.0f;
+
+    // the current is integrated over this period at most, such that a gap
+    // in the updates does not cause a large error
+    static constexpr uint32_t MaxIntegrationMillis = 10 * 1000;
+
+    static constexpr uint32_t MaxSoCAgeMillis = 10 * 60 * 1000;
+
+    bool _valid = false;
+    float _estimate = 0;
+    float _reportedSoC = 0;
+    uint32_t _lastSoCTimestamp = 0;
+    uint32_t _lastIntegration = 0;
+};
+
+} // namespace Batteries
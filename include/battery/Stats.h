@@ -5,7 +5,13 @@
 #include <stdint.h>
 #include <AsyncJson.h>
 #include <cfloat>
+#include <optional>
 #include <string>
+#include <type_traits>
+#include <vector>
+#include <DataPoints.h>
+#include <MqttTopicRegistry.h>
+#include <Utils.h>
 
 namespace Batteries {
 
@@ -17,20 +23,26 @@ public:
 
     // the last time *any* data was updated
     uint32_t getAgeSeconds() const { return (millis() - _lastUpdate) / 1000; }
+    uint32_t getLastUpdate() const { return _lastUpdate; }
     bool updateAvailable(uint32_t since) const;
 
     float getSoC() const { return _soc; }
     uint32_t getSoCAgeSeconds() const { return (millis() - _lastUpdateSoC) / 1000; }
+    uint32_t getSoCLastUpdate() const { return _lastUpdateSoC; }
     uint8_t getSoCPrecision() const { return _socPrecision; }
 
     float getVoltage() const { return _voltage; }
     uint32_t getVoltageAgeSeconds() const { return (millis() - _lastUpdateVoltage) / 1000; }
+    uint32_t getVoltageLastUpdate() const { return _lastUpdateVoltage; }
 
     float getChargeCurrent() const { return _current; };
+    uint32_t getChargeCurrentAgeSeconds() const { return (millis() - _lastUpdateCurrent) / 1000; }
+    uint32_t getChargeCurrentLastUpdate() const { return _lastUpdateCurrent; }
     uint8_t getChargeCurrentPrecision() const { return _currentPrecision; }
 
     float getDischargeCurrentLimit() const { return _dischargeCurrentLimit; };
     uint32_t getDischargeCurrentLimitAgeSeconds() const { return (millis() - _lastUpdateDischargeCurrentLimit) / 1000; }
+    uint32_t getDischargeCurrentLimitLastUpdate() const { return _lastUpdateDischargeCurrentLimit; }
 
     // convert stats to JSON for web application live view
     virtual void getLiveViewData(JsonVariant& root) const;
@@ -39,7 +51,7 @@ public:
 
     // the interval at which all battery data will be re-published, even
     // if they did not change. used to calculate Home Assistent expiration.
-    virtual uint32_t getMqttFullPublishIntervalMs() const;
+    uint32_t getMqttFullPublishIntervalMs() const;
 
     bool isSoCValid() const { return _lastUpdateSoC > 0; }
     bool isVoltageValid() const { return _lastUpdateVoltage > 0; }
@@ -54,9 +66,79 @@ public:
 
     virtual bool supportsAlarmsAndWarnings() const { return true; };
 
+    // the nominal capacity, if the battery reports it
+    virtual std::optional<float> getCapacityAmpHours() const { return std::nullopt; }
+
+    // publishes all values below battery/<subtopic>/ rather than battery/,
+    // used for the individual batteries if several are combined. must be
+    // set before the values are published for the first time.
+    void setMqttSubtopic(String const& subtopic) { _mqttTopicPrefix = "battery/" + subtopic + "/"; }
+
+    // resumes with the SoC known before a warm restart, until the battery
+    // reports it again. the SoC keeps the age it had when it was saved.
+    void restoreSoC(float soc, uint8_t precision, uint32_t ageMillis) {
+        if (isSoCValid()) { return; }
+        setSoC(soc, precision, millis() - ageMillis);
+    }
+
 protected:
     virtual void mqttPublish() const;
 
+    // true while mqttPublish() is executed to publish all values, regardless
+    // of whether or not they changed since they were last published.
+    bool isMqttFullPublish() const { return _mqttFullPublish; }
+
+    // publishes the text to the topic unless it is the text published last.
+    // numeric values are only published if they also changed by more than
+    // the absolute deadband and the configured relative deadband.
+    void mqttPublishValue(char const* topic, char const* text,
+        std::optional<float> value = std::nullopt, float absoluteDeadband = 0) const;
+
+    void mqttPublishValue(char const* topic, String const& text,
+        std::optional<float> value = std::nullopt, float absoluteDeadband = 0) const
+    {
+        mqttPublishValue(topic, text.c_str(), value, absoluteDeadband);
+    }
+
+    void mqttPublishValue(String const& topic, char const* text,
+        std::optional<float> value = std::nullopt, float absoluteDeadband = 0) const
+    {
+        mqttPublishValue(topic.c_str(), text, value, absoluteDeadband);
+    }
+
+    void mqttPublishValue(String const& topic, String const& text,
+        std::optional<float> value = std::nullopt, float absoluteDeadband = 0) const
+    {
+        mqttPublishValue(topic.c_str(), text.c_str(), value, absoluteDeadband);
+    }
+
+    // the text is formatted on the stack, floats with two decimal places
+    template<typename T>
+    std::enable_if_t<std::is_arithmetic_v<T>> mqttPublishValue(
+        char const* topic, T value, float absoluteDeadband = 0) const
+    {
+        char text[Utils::FixedFormatSize];
+        if constexpr (std::is_floating_point_v<T>) {
+            Utils::formatFixed(text, sizeof(text), value, 2);
+        } else if constexpr (std::is_signed_v<T>) {
+            snprintf(text, sizeof(text), "%lld", static_cast<long long>(value));
+        } else {
+            snprintf(text, sizeof(text), "%llu", static_cast<unsigned long long>(value));
+        }
+        mqttPublishValue(topic, text, static_cast<float>(value), absoluteDeadband);
+    }
+
+    template<typename T>
+    std::enable_if_t<std::is_arithmetic_v<T>> mqttPublishValue(
+        String const& topic, T value, float absoluteDeadband = 0) const
+    {
+        mqttPublishValue(topic.c_str(), value, absoluteDeadband);
+    }
+
+    // publishes one topic per cell or all cells as a JSON array, subject to
+    // the configured cell voltage deadband.
+    void mqttPublishCellVoltages(tCellVoltages const& cellVoltages) const;
+
     void setSoC(float soc, uint8_t precision, uint32_t timestamp) {
         _soc = soc;
         _socPrecision = precision;
@@ -134,8 +216,24 @@ protected:
     uint32_t _lastUpdate = 0;
 
 private:
+    bool exceedsMqttDeadband(float last, float value, float absoluteDeadband) const;
+    MqttTopicRegistryClass::Handle internMqttTopic(char const* topic) const;
+
     std::optional<String> _oManufacturer = std::nullopt;
+    String _mqttTopicPrefix; // replaces "battery/" if not empty
     uint32_t _lastMqttPublish = 0;
+    uint32_t _lastFullMqttPublish = 0;
+    bool _mqttFullPublish = false;
+
+    // what was last published to a topic, sorted by topic hash
+    struct MqttPublished {
+        uint32_t topicHash;
+        uint32_t textHash;
+        float value; // NAN for non-numeric values
+        MqttTopicRegistryClass::Handle topic;
+    };
+    mutable std::vector<MqttPublished> _mqttPublished;
+    mutable std::vector<uint16_t> _mqttCellVoltages;
     float _soc = 0;
     uint8_t _socPrecision = 0; // decimal places
     uint32_t _lastUpdateSoC = 0;
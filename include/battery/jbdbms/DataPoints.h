@@ -110,8 +110,11 @@ LABEL_TRAIT(ActualBatteryCapacityAmpHours,          uint32_t,    "Ah");
 using JbdBmsDataPoint = DataPoint<bool, uint8_t, uint16_t, uint32_t,
               int16_t, int32_t, std::string, Batteries::JbdBms::tCells>;
 
-template class DataPointContainer<JbdBmsDataPoint, Batteries::JbdBms::DataPointLabel, Batteries::JbdBms::DataPointLabelTraits>;
+template class DataPointContainer<JbdBmsDataPoint, Batteries::JbdBms::DataPointLabel, Batteries::JbdBms::DataPointLabelTraits,
+                                  Batteries::JbdBms::DataPointLabel::CellsMilliVolt,
+                                  Batteries::JbdBms::DataPointLabel::ActualBatteryCapacityAmpHours>;
 
 namespace Batteries::JbdBms {
-    using DataPointContainer = DataPointContainer<JbdBmsDataPoint, DataPointLabel, DataPointLabelTraits>;
+    using DataPointContainer = DataPointContainer<JbdBmsDataPoint, DataPointLabel, DataPointLabelTraits,
+            DataPointLabel::CellsMilliVolt, DataPointLabel::ActualBatteryCapacityAmpHours>;
 } // namespace Batteries::JbdBms
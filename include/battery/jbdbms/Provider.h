@@ -1,9 +1,12 @@
 #pragma once
 
+#include <array>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <frozen/string.h>
 
+#include <SerialProviderTask.h>
 #include <battery/Provider.h>
 #include <battery/jbdbms/Stats.h>
 #include <battery/jbdbms/DataPoints.h>
@@ -12,7 +15,10 @@
 
 namespace Batteries::JbdBms {
 
-class Provider : public ::Batteries::Provider {
+// the BMS is polled and its responses are parsed in a task of its own. the
+// data points of complete frames are handed to the main loop, which updates
+// the stats.
+class Provider : public ::Batteries::Provider, private SerialProviderTask {
 public:
     Provider();
 
@@ -27,23 +33,35 @@ private:
 
 #ifdef JBDBMS_DUMMY_SERIAL
     std::unique_ptr<DummySerial> _upSerial;
+    DummySerial* _pSerial = nullptr;
 #else
-    std::unique_ptr<HardwareSerial> _upSerial;
+    // the BMS is polled rarely, so it uses the time-sliced UART, which is
+    // only available while a window is open, see SerialPortManager.h
+    HardwareSerial* _pSerial = nullptr;
 #endif
 
+    // a window is held from sending a request until the response was
+    // received or timed out
+    bool openWindow();
+    void closeWindow();
+
     enum class Status : unsigned {
         Initializing,
         Timeout,
         WaitingForPollInterval,
         HwSerialNotAvailableForWrite,
+        WaitingForWindow,
         BusyReading,
         RequestSent,
         FrameCompleted
     };
 
+    void serialLoop() final;
+
     frozen::string const& getStatusText(Status status);
     void announceStatus(Status status);
-    void sendRequest(uint8_t pollInterval);
+    void startPollCycle(uint8_t cellVoltagesDivider);
+    void sendRequest(uint32_t pollIntervalMillis, uint8_t cellVoltagesDivider);
     void rxData(uint8_t inbyte);
     void reset();
     void frameComplete();
@@ -80,8 +98,30 @@ private:
     Status _lastStatus = Status::Initializing;
     uint32_t _lastStatusPrinted = 0;
     uint32_t _lastRequest = 0;
+
+    // the requests to send in the current poll cycle
+    std::array<SerialCommand::Command, 3> _pipeline;
+    size_t _pipelineSize = 0;
+    size_t _pipelinePos = 0;
+    uint32_t _pollCycle = 0;
+    uint32_t _lastPollCycle = 0;
+    bool _hardwareVersionRequested = false;
+
+    // a response of the maximum length takes less than 300 ms at 9600 baud
+    static constexpr uint32_t _responseTimeoutMillis = 500;
+
     uint8_t _dataLength = 0;
+    uint16_t _checksumSum = 0; // accumulated while the frame is received
     JbdBms::SerialResponse::tData _buffer = {};
+    DataPointContainer _frameDataPoints; // reused for every frame
+
+    // the data points of the frames received since the main loop last
+    // picked them up, and its copy of them
+    std::mutex _handoffMutex;
+    DataPointContainer _pendingDataPoints;
+    bool _dataPointsPending = false;
+    DataPointContainer _handoffDataPoints;
+
     std::shared_ptr<Stats> _stats;
     std::shared_ptr<HassIntegration> _hassIntegration;
 };
@@ -4,6 +4,7 @@
 #include <vector>
 #include <Arduino.h>
 
+#include <battery/ByteSpan.h>
 #include <battery/jbdbms/DataPoints.h>
 
 namespace Batteries::JbdBms {
@@ -35,26 +36,32 @@ class SerialMessage {
         uint8_t const* data() { return _raw.data(); }
         size_t size() { return _raw.size(); }
 
+        // adds the byte most recently appended to the frame to the sum of
+        // the bytes covered by the checksum. this needs the frame's data
+        // length field, so it must be called for every byte as it arrives.
+        static void accumulateChecksum(uint16_t& sum, tData const& frame);
+
         static constexpr uint8_t startMarker = 0xDD;
         static constexpr uint8_t endMarker = 0x77;
 
     protected:
-        template <typename... Args>
-        explicit SerialMessage(Args&&... args) : _raw(std::forward<Args>(args)...) { }
+        SerialMessage(ByteSpan raw, uint16_t checksum)
+            : _raw(raw), _checksum(checksum) { }
 
         template<typename T, typename It> T get(It&& pos) const;
         template<typename It> bool getBool(It&& pos) const;
         template<typename It> int16_t getTemperature(It&& pos) const;
         template<typename It> std::string getString(It&& pos, size_t len, bool replaceZeroes = false) const;
         template<typename It> std::string getProductionDate(It&& pos) const;
-        template<typename T> void set(tData::iterator const& pos, T val);
-        uint16_t calcChecksum() const;
-        void updateChecksum();
+        static uint16_t checksumFromSum(uint16_t sum) { return ~sum + 0x01; }
 
-        tData _raw;
-        DataPointContainer _dp;
+        ByteSpan _raw;
+        uint16_t _checksum; // the checksum computed over the frame's bytes
 };
 
+// decodes a received frame in place. the frame must outlive the response.
+// the data points are written into the given container, such that the
+// caller can reuse it for every frame.
 class SerialResponse : public SerialMessage {
     public:
         enum class Status : uint8_t {
@@ -63,7 +70,7 @@ class SerialResponse : public SerialMessage {
         };
 
         using tData = SerialMessage::tData;
-        explicit SerialResponse(tData&& raw);
+        SerialResponse(ByteSpan raw, uint16_t checksumSum, DataPointContainer& dp);
 
         Command getCommand() const { return static_cast<Command>(_raw[1]); }
         Status getStatus() const { return static_cast<Status>(_raw[2]); }
@@ -71,6 +78,9 @@ class SerialResponse : public SerialMessage {
         bool isValid() const;
 
         DataPointContainer const& getDataPoints() const { return _dp; }
+
+    private:
+        DataPointContainer& _dp;
 };
 
 class SerialCommand : public SerialMessage {
@@ -82,6 +92,10 @@ class SerialCommand : public SerialMessage {
 
         explicit SerialCommand(Status status, Command cmd);
 
+        // the base class views the storage of this instance
+        SerialCommand(SerialCommand const&) = delete;
+        SerialCommand& operator=(SerialCommand const&) = delete;
+
         Status getStatus() const { return static_cast<Status>(_raw[1]); }
         Command getCommand() const { return static_cast<Command>(_raw[2]); }
         static Command getLastCommand() { return _lastCmd; }
@@ -89,6 +103,11 @@ class SerialCommand : public SerialMessage {
         bool isValid() const;
 
     private:
+        template<typename T> void set(tData::iterator const& pos, T val);
+        uint16_t calcChecksum() const;
+
+        tData _storage;
+
         static Command _lastCmd;
 };
 
@@ -208,8 +208,11 @@ LABEL_TRAIT(ProtocolVersion,                        uint8_t,     "");
 using JkBmsDataPoint = DataPoint<bool, uint8_t, uint16_t, uint32_t,
               int16_t, int32_t, std::string, Batteries::JkBms::tCells>;
 
-template class DataPointContainer<JkBmsDataPoint, Batteries::JkBms::DataPointLabel, Batteries::JkBms::DataPointLabelTraits>;
+template class DataPointContainer<JkBmsDataPoint, Batteries::JkBms::DataPointLabel, Batteries::JkBms::DataPointLabelTraits,
+                                  Batteries::JkBms::DataPointLabel::CellsMilliVolt,
+                                  Batteries::JkBms::DataPointLabel::ProtocolVersion>;
 
 namespace Batteries::JkBms {
-    using DataPointContainer = DataPointContainer<JkBmsDataPoint, DataPointLabel, DataPointLabelTraits>;
+    using DataPointContainer = DataPointContainer<JkBmsDataPoint, DataPointLabel, DataPointLabelTraits,
+            DataPointLabel::CellsMilliVolt, DataPointLabel::ProtocolVersion>;
 } // namespace Batteries::JkBms
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <frozen/string.h>
 
+#include <SerialProviderTask.h>
 #include <battery/Provider.h>
 #include <battery/jkbms/Stats.h>
 #include <battery/jkbms/DataPoints.h>
@@ -15,7 +17,10 @@
 
 namespace Batteries::JkBms {
 
-class Provider : public ::Batteries::Provider {
+// the BMS is polled and its responses are parsed in a task of its own. the
+// data points of complete frames are handed to the main loop, which updates
+// the stats.
+class Provider : public ::Batteries::Provider, private SerialProviderTask {
 public:
     Provider();
 
@@ -30,23 +35,34 @@ private:
 
 #ifdef JKBMS_DUMMY_SERIAL
     std::unique_ptr<DummySerial> _upSerial;
+    DummySerial* _pSerial = nullptr;
 #else
-    std::unique_ptr<HardwareSerial> _upSerial;
+    // the BMS is polled rarely, so it uses the time-sliced UART, which is
+    // only available while a window is open, see SerialPortManager.h
+    HardwareSerial* _pSerial = nullptr;
 #endif
 
+    // a window is held from sending a request until the response was
+    // received or timed out
+    bool openWindow();
+    void closeWindow();
+
     enum class Status : unsigned {
         Initializing,
         Timeout,
         WaitingForPollInterval,
         HwSerialNotAvailableForWrite,
+        WaitingForWindow,
         BusyReading,
         RequestSent,
         FrameCompleted
     };
 
+    void serialLoop() final;
+
     frozen::string const& getStatusText(Status status);
     void announceStatus(Status status);
-    void sendRequest(uint8_t pollInterval);
+    void sendRequest(uint32_t pollIntervalMillis);
     void rxData(uint8_t inbyte);
     void reset();
     void frameComplete();
@@ -80,8 +96,18 @@ private:
     uint32_t _lastStatusPrinted = 0;
     uint32_t _lastRequest = 0;
     uint16_t _frameLength = 0;
+    uint16_t _checksum = 0; // accumulated while the frame is received
     uint8_t _protocolVersion = -1;
     SerialResponse::tData _buffer = {};
+    DataPointContainer _frameDataPoints; // reused for every frame
+
+    // the data points of the frames received since the main loop last
+    // picked them up, and its copy of them
+    std::mutex _handoffMutex;
+    DataPointContainer _pendingDataPoints;
+    bool _dataPointsPending = false;
+    DataPointContainer _handoffDataPoints;
+
     std::shared_ptr<Stats> _stats;
     std::shared_ptr<HassIntegration> _hassIntegration;
 };
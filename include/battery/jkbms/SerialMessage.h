@@ -4,6 +4,7 @@
 #include <vector>
 #include <Arduino.h>
 
+#include <battery/ByteSpan.h>
 #include <battery/jkbms/DataPoints.h>
 
 namespace Batteries::JkBms {
@@ -56,38 +57,58 @@ class SerialMessage {
         uint8_t const* data() { return _raw.data(); }
         size_t size() { return _raw.size(); }
 
+        // adds the byte most recently appended to the frame to the checksum,
+        // if the byte is covered by the checksum. this needs the frame's
+        // length field, so it must be called for every byte as it arrives.
+        static void accumulateChecksum(uint16_t& checksum, tData const& frame);
+
     protected:
-        template <typename... Args>
-        explicit SerialMessage(Args&&... args) : _raw(std::forward<Args>(args)...) { }
+        SerialMessage(ByteSpan raw, uint16_t checksum)
+            : _raw(raw), _checksum(checksum) { }
 
         template<typename T, typename It> T get(It&& pos) const;
         template<typename It> bool getBool(It&& pos) const;
         template<typename It> int16_t getTemperature(It&& pos) const;
         template<typename It> std::string getString(It&& pos, size_t len, bool replaceZeroes = false) const;
-        void processBatteryCurrent(tData::const_iterator& pos, uint8_t protocolVersion);
-        template<typename T> void set(tData::iterator const& pos, T val);
-        uint16_t calcChecksum() const;
-        void updateChecksum();
 
-        tData _raw;
-        DataPointContainer _dp;
+        ByteSpan _raw;
+        uint16_t _checksum; // the checksum computed over the frame's bytes
 
         static constexpr uint16_t startMarker = 0x4e57;
         static constexpr uint8_t endMarker = 0x68;
 };
 
+// decodes a received frame in place. the frame must outlive the response.
+// the data points are written into the given container, such that the
+// caller can reuse it for every frame.
 class SerialResponse : public SerialMessage {
     public:
         using tData = SerialMessage::tData;
-        explicit SerialResponse(tData&& raw, uint8_t protocolVersion = -1);
+        SerialResponse(ByteSpan raw, uint16_t checksum,
+                DataPointContainer& dp, uint8_t protocolVersion = -1);
 
         DataPointContainer const& getDataPoints() const { return _dp; }
+
+    private:
+        void processBatteryCurrent(ByteSpan::const_iterator& pos, uint8_t protocolVersion);
+
+        DataPointContainer& _dp;
 };
 
 class SerialCommand : public SerialMessage {
     public:
         using Command = SerialMessage::Command;
         explicit SerialCommand(Command cmd);
+
+        // the base class views the storage of this instance
+        SerialCommand(SerialCommand const&) = delete;
+        SerialCommand& operator=(SerialCommand const&) = delete;
+
+    private:
+        template<typename T> void set(tData::iterator const& pos, T val);
+        uint16_t calcChecksum() const;
+
+        tData _storage;
 };
 
 } // namespace Batteries::JkBms
@@ -18,21 +18,18 @@ public:
 
     void mqttPublish() const final;
 
-    uint32_t getMqttFullPublishIntervalMs() const final { return 60 * 1000; }
     std::optional<String> getHassDeviceName() const final;
 
+    std::optional<float> getCapacityAmpHours() const final;
+
     void updateFrom(DataPointContainer const& dp);
 
 private:
     void getJsonData(JsonVariant& root, bool verbose) const;
 
     DataPointContainer _dataPoints;
-    mutable uint32_t _lastMqttPublish = 0;
-    mutable uint32_t _lastFullMqttPublish = 0;
 
-    uint16_t _cellMinMilliVolt = 0;
-    uint16_t _cellAvgMilliVolt = 0;
-    uint16_t _cellMaxMilliVolt = 0;
+    tCellVoltages _cellVoltages;
     uint32_t _cellVoltageTimestamp = 0;
 };
 
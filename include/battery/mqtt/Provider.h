@@ -4,6 +4,7 @@
 #include <espMqttClient.h>
 #include <battery/Provider.h>
 #include <battery/mqtt/Stats.h>
+#include <Utils.h>
 
 namespace Batteries::Mqtt {
 
@@ -22,18 +23,21 @@ private:
     String _socTopic;
     String _voltageTopic;
     String _dischargeCurrentLimitTopic;
+    JsonPath _socJsonPath;
+    JsonPath _voltageJsonPath;
+    JsonPath _dischargeCurrentLimitJsonPath;
     std::shared_ptr<Stats> _stats = std::make_shared<Stats>();
     uint8_t _socPrecision = 0;
 
     void onMqttMessageSoC(espMqttClientTypes::MessageProperties const& properties,
             char const* topic, uint8_t const* payload, size_t len, size_t index, size_t total,
-            char const* jsonPath);
+            JsonPath const* jsonPath);
     void onMqttMessageVoltage(espMqttClientTypes::MessageProperties const& properties,
             char const* topic, uint8_t const* payload, size_t len, size_t index, size_t total,
-            char const* jsonPath);
+            JsonPath const* jsonPath);
     void onMqttMessageDischargeCurrentLimit(espMqttClientTypes::MessageProperties const& properties,
             char const* topic, uint8_t const* payload, size_t len, size_t index, size_t total,
-            char const* jsonPath);
+            JsonPath const* jsonPath);
 };
 
 } // namespace Batteries::Mqtt
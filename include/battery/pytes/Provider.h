@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <driver/twai.h>
+#include <battery/CanFrame.h>
 #include <battery/CanReceiver.h>
 #include <battery/pytes/Stats.h>
 #include <battery/pytes/HassIntegration.h>
@@ -13,12 +14,17 @@ class Provider : public ::Batteries::CanReceiver {
 public:
     Provider();
     bool init(bool verboseLogging) final;
-    void onMessage(twai_message_t rx_message) final;
+    void onMessage(twai_message_t const& rx_message) final;
+
+protected:
+    std::vector<uint32_t> getMessageIds() const final { return getFrames().getIds(); }
 
     std::shared_ptr<::Batteries::Stats> getStats() const final { return _stats; }
     std::shared_ptr<::Batteries::HassIntegration> getHassIntegration() final { return _hassIntegration; }
 
 private:
+    static CanFrame::FrameTable<Stats> const& getFrames();
+
     std::shared_ptr<Stats> _stats;
     std::shared_ptr<HassIntegration> _hassIntegration;
 };
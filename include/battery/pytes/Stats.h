@@ -13,6 +13,10 @@ public:
     void mqttPublish() const final;
     bool getImmediateChargingRequest() const { return _chargeImmediately; };
     float getChargeCurrentLimitation() const { return _chargeCurrentLimit; };
+    std::optional<float> getCapacityAmpHours() const final {
+        if (_totalCapacity <= 0) { return std::nullopt; }
+        return _totalCapacity;
+    }
 
 private:
     void setLastUpdate(uint32_t ts) { _lastUpdate = ts; }
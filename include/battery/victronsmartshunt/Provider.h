@@ -2,6 +2,8 @@
 #pragma once
 
 #include <memory>
+#include <VeDirectPort.h>
+#include <VeDirectShuntController.h>
 #include <battery/Provider.h>
 #include <battery/victronsmartshunt/Stats.h>
 #include <battery/victronsmartshunt/HassIntegration.h>
@@ -18,7 +20,8 @@ public:
     std::shared_ptr<::Batteries::HassIntegration> getHassIntegration() final { return _hassIntegration; }
 
 private:
-    static char constexpr _serialPortOwner[] = "SmartShunt";
+    using Port = VeDirectPort<VeDirectShuntController>;
+    std::unique_ptr<Port> _upPort;
 
     uint32_t _lastUpdate = 0;
     std::shared_ptr<Stats> _stats;
@@ -11,7 +11,7 @@ public:
     void getLiveViewData(JsonVariant& root) const final;
     void mqttPublish() const final;
 
-    void updateFrom(VeDirectShuntController::data_t const& shuntData);
+    void updateFrom(VeDirectShuntController::data_t const& shuntData, uint32_t lastUpdate);
 
 private:
     float _temperature;
@@ -19,11 +19,24 @@
 #define WIFI_SSID ""
 #define WIFI_PASSWORD ""
 #define WIFI_DHCP true
+#define WIFI_POWER_SAVE true
+#define WIFI_FAILOVER false
 
 #define MDNS_ENABLED false
 
 #define SYSLOG_ENABLED false
 #define SYSLOG_PORT 514
+#define SYSLOG_PROTOCOL 0
+
+#define INFLUX_ENABLED false
+#define INFLUX_PORT 8089
+#define INFLUX_PROTOCOL 0
+#define INFLUX_INTERVAL 10U
+#define INFLUX_PATH "/write?db=opendtu"
+
+#define MODBUS_ENABLED false
+#define MODBUS_PORT 502
+#define MODBUS_WRITE_ENABLED false
 
 #define NTP_SERVER_OLD "pool.ntp.org"
 #define NTP_SERVER "opendtu.pool.ntp.org"
@@ -81,10 +94,15 @@
 #define MQTT_LWT_OFFLINE "offline"
 #define MQTT_LWT_QOS 2U
 #define MQTT_PUBLISH_INTERVAL 5U
+#define MQTT_PUBLISH_REFRESH_INTERVAL 0U
+#define MQTT_PUBLISH_DEADBAND 0.0f
+#define MQTT_INVERTER_JSON_PAYLOAD false
 #define MQTT_CLEAN_SESSION true
+#define MQTT_OUTBOX_LIMIT 0U
 
 #define DTU_SERIAL 0x99978563412U
 #define DTU_POLL_INTERVAL 5000U
+#define DTU_LOW_POWER_NIGHT false
 #define DTU_NRF_PA_LEVEL 0U
 #define DTU_CMT_PA_LEVEL 0
 #define DTU_CMT_FREQUENCY 865000000U
@@ -95,6 +113,7 @@
 #define MQTT_HASS_RETAIN true
 #define MQTT_HASS_TOPIC "homeassistant/"
 #define MQTT_HASS_INDIVIDUALPANELS false
+#define MQTT_HASS_DEVICE_DISCOVERY false
 
 #define DEV_PINMAPPING ""
 
@@ -113,21 +132,35 @@
 #define MAX_INVERTER_LIMIT 2250
 
 #define LANG_PACK_SUFFIX ".lang.json"
+#define LANG_PACK_COMPILED_SUFFIX ".lang.bin"
 
 // values specific to downstream project OpenDTU-OnBattery start here:
 #define SOLAR_CHARGER_ENABLED false
 #define SOLAR_CHARGER_VERBOSE_LOGGING false
 #define SOLAR_CHARGER_PUBLISH_UPDATES_ONLY true
+#define SOLAR_CHARGER_ADDITIONAL_PROVIDERS 0 // none
 
 #define POWERMETER_ENABLED false
 #define POWERMETER_POLLING_INTERVAL 10
 #define POWERMETER_SOURCE 0
 #define POWERMETER_SDMADDRESS 1
+#define POWERMETER_SDM_SLOW_POLLING_INTERVAL 30
+#define POWERMETER_SDM_SUBMETER_ADDRESS 0
+#define POWERMETER_SDM_SUBMETER_THREE_PHASES false
+#define POWERMETER_SMAHM_SERIAL 0
+#define POWERMETER_SMAHM_SUBMETER_SERIAL 0
+#define POWERMETER_UDP_PUSH_PORT 9523
+#define POWERMETER_SHELLY_EM_ID 0
+#define POWERMETER_FUSION_ENABLED false
+#define POWERMETER_FUSION_SOURCE 0
+#define POWERMETER_FUSION_MAX_DEVIATION 500
+#define POWERMETER_PREDICTIVE_FILTER false
 
 #define HTTP_REQUEST_TIMEOUT_MS 1000
 
 #define POWERLIMITER_ENABLED false
 #define POWERLIMITER_SOLAR_PASSTHROUGH_ENABLED false
+#define POWERLIMITER_SOLAR_POWER_PREDICTION false
 #define POWERLIMITER_CONDUCTION_LOSSES 3
 #define POWERLIMITER_BATTERY_ALWAYS_USE_AT_NIGHT false
 #define POWERLIMITER_IS_INVERTER_BEHIND_POWER_METER true
@@ -145,15 +178,31 @@
 #define POWERLIMITER_VOLTAGE_START_THRESHOLD 50.0
 #define POWERLIMITER_VOLTAGE_STOP_THRESHOLD 49.0
 #define POWERLIMITER_VOLTAGE_LOAD_CORRECTION_FACTOR 0.001
+#define POWERLIMITER_VOLTAGE_LOAD_CORRECTION_ADAPTIVE false
+#define POWERLIMITER_BATTERY_CAPACITY 0
 #define POWERLIMITER_RESTART_HOUR -1
 #define POWERLIMITER_FULL_SOLAR_PASSTHROUGH_SOC 100
 #define POWERLIMITER_FULL_SOLAR_PASSTHROUGH_START_VOLTAGE 66.0
 #define POWERLIMITER_FULL_SOLAR_PASSTHROUGH_STOP_VOLTAGE 66.0
+#define POWERLIMITER_CLUSTER_ROLE 0
+#define POWERLIMITER_CLUSTER_PORT 4422
+#define POWERLIMITER_CLUSTER_ID 0
+#define POWERLIMITER_LATENCY_ALERT_REACTION_MS 0
+#define POWERLIMITER_LATENCY_ALERT_METER_INTERVAL_MS 0
+#define POWERLIMITER_LATENCY_ALERT_STATS_AGE_MS 0
+#define POWERLIMITER_SHADOW_ENABLED false
 
 #define BATTERY_ENABLED false
 #define BATTERY_PROVIDER 0 // Pylontech CAN receiver
+#define BATTERY_ADDITIONAL_PROVIDERS 0 // none
+#define BATTERY_SOC_AGGREGATION 0 // minimum
 #define BATTERY_JKBMS_INTERFACE 0
 #define BATTERY_JKBMS_POLLING_INTERVAL 5
+#define BATTERY_JBDBMS_CELL_VOLTAGES_DIVIDER 3
+#define BATTERY_MQTT_FULL_PUBLISH_INTERVAL 60U
+#define BATTERY_MQTT_DEADBAND_RELATIVE 0.0f
+#define BATTERY_MQTT_CELL_DEADBAND_MILLIVOLT 0U
+#define BATTERY_MQTT_CELL_VOLTAGES_JSON false
 #define BATTERY_ENABLE_DISCHARGE_CURRENT_LIMIT false
 #define BATTERY_DISCHARGE_CURRENT_LIMIT 0.0
 #define BATTERY_DISCHARGE_CURRENT_LIMIT_BELOW_SOC 100.0
@@ -162,6 +211,7 @@
 
 #define HUAWEI_ENABLED false
 #define HUAWEI_CAN_CONTROLLER_FREQUENCY 8000000UL
+#define HUAWEI_UNIT_COUNT 1
 #define HUAWEI_AUTO_POWER_VOLTAGE_LIMIT 42.0
 #define HUAWEI_AUTO_POWER_ENABLE_VOLTAGE_LIMIT 42.0
 #define HUAWEI_AUTO_POWER_LOWER_POWER_LIMIT 150
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <memory>
 #include <ArduinoJson.h>
@@ -26,15 +27,24 @@ public:
     void setParameter(float val, HardwareInterface::Setting setting);
     void setMode(uint8_t mode);
 
+    // the values of all units combined: powers and currents are summed up,
+    // the temperatures are the warmest unit's.
     DataPointContainer const& getDataPoints() const { return _dataPoints; }
     void getJsonData(JsonVariant& root) const;
 
+    uint8_t getUnitCount() const;
+    DataPointContainer const& getUnitDataPoints(uint8_t unit) const { return _units[unit].DataPoints; }
+
     bool getAutoPowerStatus() const { return _autoPowerEnabled; };
     uint8_t getMode() const { return _mode; };
 
 private:
     void loop();
     void _setParameter(float val, HardwareInterface::Setting setting);
+    void updateDataPoints(uint8_t unit, bool verboseLogging);
+    void combineDataPoints();
+    std::array<float, HardwareInterface::MaxUnits> splitCurrent(float current) const;
+    float stepPowerController(float error, uint32_t dtMillis, float inputPower, float maxPowerLimit);
 
     // these control the pin named "power", which in turn is supposed to control
     // a relay (or similar) to enable or disable the PSU using it's slot detect
@@ -49,13 +59,38 @@ private:
     std::mutex _mutex;
     uint8_t _mode = HUAWEI_MODE_AUTO_EXT;
 
+    struct Unit {
+        HardwareInterface::Snapshot Latest; // the snapshot most recently received
+        DataPointContainer DataPoints;
+    };
+    std::array<Unit, HardwareInterface::MaxUnits> _units;
     DataPointContainer _dataPoints;
 
+    // the output current is split across the units in proportion to their
+    // efficiency, while a unit is derated linearly between these output
+    // temperatures, down to the given share of its nominal weight.
+    static constexpr float DerateStartTemperature = 60.0f;
+    static constexpr float DerateEndTemperature = 80.0f;
+    static constexpr float DeratedWeight = 0.1f;
+
     uint32_t _outputCurrentOnSinceMillis;         // Timestamp since when the PSU was idle at zero amps
     uint32_t _nextAutoModePeriodicIntMillis;      // When to set the next output voltage in automatic mode
     uint32_t _lastPowerMeterUpdateReceivedMillis; // Timestamp of last seen power meter value
     uint32_t _autoModeBlockedTillMillis = 0;      // Timestamp to block running auto mode for some time
 
+    // PI controller for the PSU's input power in internal automatic mode,
+    // stepped with every power meter reading. the gains are per W of grid
+    // power (error) and per W and second, respectively.
+    static constexpr float PowerControllerKp = 0.5f;
+    static constexpr float PowerControllerKi = 0.6f;
+    struct PowerController {
+        bool Active = false;
+        float Output = 0; // in W
+        float LastError = 0; // in W
+        float LastCurrent = -1; // the output current sent last, in A
+    };
+    PowerController _powerController;
+
     uint8_t _autoPowerEnabledCounter = 0;
     bool _autoPowerEnabled = false;
     bool _batteryEmergencyCharging = false;
@@ -44,8 +44,11 @@ LABEL_TRAIT(OutputCurrent,      "A");
 
 template class DataPointContainer<DataPoint<float>,
                                   GridCharger::Huawei::DataPointLabel,
-                                  GridCharger::Huawei::DataPointLabelTraits>;
+                                  GridCharger::Huawei::DataPointLabelTraits,
+                                  GridCharger::Huawei::DataPointLabel::InputPower,
+                                  GridCharger::Huawei::DataPointLabel::OutputCurrent>;
 
 namespace GridCharger::Huawei {
-    using DataPointContainer = DataPointContainer<DataPoint<float>, DataPointLabel, DataPointLabelTraits>;
+    using DataPointContainer = DataPointContainer<DataPoint<float>, DataPointLabel, DataPointLabelTraits,
+            DataPointLabel::InputPower, DataPointLabel::OutputCurrent>;
 } // namespace GridCharger::Huawei
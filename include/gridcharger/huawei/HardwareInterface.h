@@ -1,10 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <array>
 #include <mutex>
-#include <memory>
+#include <optional>
 #include <queue>
 #include <cstdint>
 #include <gridcharger/huawei/DataPoints.h>
@@ -19,15 +20,62 @@ public:
 
     virtual bool init() = 0;
 
+    // several PSUs may share the CAN bus, each of which is addressed by
+    // the address byte (bits 16 to 23) of the CAN identifiers. the units
+    // use addresses 0x81, 0x82, etc., while 0x80 addresses all of them.
+    static uint8_t constexpr MaxUnits = 3;
+    void setUnitCount(uint8_t count) { _unitCount = std::max<uint8_t>(1, std::min(count, MaxUnits)); }
+    uint8_t getUnitCount() const { return _unitCount; }
+
     enum class Setting : uint8_t {
         OnlineVoltage = 0,
         OfflineVoltage = 1,
         OnlineCurrent = 3,
         OfflineCurrent = 4
     };
+
+    // sends the same value to all units
     void setParameter(Setting setting, float val);
 
-    std::unique_ptr<DataPointContainer> getCurrentData();
+    // sends one value per unit. the set-points are sent in one burst.
+    void setParameters(Setting setting, std::array<float, MaxUnits> const& values);
+
+    // the values of one answer to a data request. the layout is fixed, such
+    // that a snapshot is filled and copied without any heap allocation.
+    struct Snapshot {
+        static uint8_t constexpr FirstLabel = static_cast<uint8_t>(DataPointLabel::InputPower);
+        static uint8_t constexpr LabelCount = static_cast<uint8_t>(DataPointLabel::OutputCurrent) - FirstLabel + 1;
+
+        std::array<float, LabelCount> Values;
+        std::array<uint32_t, LabelCount> Timestamps;
+        uint32_t Valid = 0; // bit n is set if Values[n] holds a value
+
+        void set(DataPointLabel label, float value, uint32_t timestamp) {
+            uint8_t idx = static_cast<uint8_t>(label) - FirstLabel;
+            Values[idx] = value;
+            Timestamps[idx] = timestamp;
+            Valid |= (1 << idx);
+        }
+
+        template<DataPointLabel L>
+        std::optional<float> get() const {
+            constexpr uint8_t idx = static_cast<uint8_t>(L) - FirstLabel;
+            static_assert(idx < LabelCount, "label out of range");
+            if ((Valid & (1 << idx)) == 0) { return std::nullopt; }
+            return Values[idx];
+        }
+
+        template<DataPointLabel L>
+        uint32_t getTimestamp() const {
+            return Timestamps[static_cast<uint8_t>(L) - FirstLabel];
+        }
+    };
+
+    // copies the snapshot most recently completed by the task for the given
+    // unit into the given snapshot. returns false if no snapshot was
+    // completed since the previous call. must only be called from a single
+    // task.
+    bool getCurrentData(uint8_t unit, Snapshot& snapshot);
 
     static uint32_t constexpr DataRequestIntervalMillis = 2500;
 
@@ -42,6 +90,10 @@ protected:
     bool startLoop();
     void stopLoop();
 
+    static uint32_t constexpr DataAnswerId = 0x1081407F; // from the first unit
+    static uint32_t constexpr AddressMask = 0x00FF0000;
+    static constexpr uint32_t addressOf(uint8_t unit) { return static_cast<uint32_t>(0x81 + unit) << 16; }
+
     TaskHandle_t getTaskHandle() const { return _taskHandle; }
 
 private:
@@ -58,10 +110,31 @@ private:
     std::atomic<bool> _taskDone = false;
     bool _stopLoop = false;
 
-    std::unique_ptr<DataPointContainer> _upDataCurrent = nullptr;
-    std::unique_ptr<DataPointContainer> _upDataInFlight = nullptr;
+    uint8_t _unitCount = 1;
 
-    std::queue<std::pair<HardwareInterface::Setting, uint16_t>> _sendQueue;
+    struct Unit {
+        // the snapshot being filled by the task
+        Snapshot InFlight;
+
+        // completed snapshots are published through a seqlock with two
+        // slots: the task fills the slot not indicated by the sequence
+        // number and then increments it. the reader never blocks and
+        // retries its copy if the sequence number changed while it was
+        // copying.
+        std::array<Snapshot, 2> Snapshots;
+        std::atomic<uint32_t> SnapshotSeq = 0;
+        uint32_t ConsumedSeq = 0; // only accessed by the reader
+    };
+    std::array<Unit, MaxUnits> _units;
+
+    void publish(Unit& unit);
+
+    struct Parameter {
+        uint8_t UnitIndex;
+        Setting Type;
+        uint16_t Value;
+    };
+    std::queue<Parameter> _sendQueue;
 
     static unsigned constexpr _maxCurrentMultiplier = 20;
 
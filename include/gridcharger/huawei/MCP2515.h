@@ -20,6 +20,13 @@ public:
     bool sendMessage(uint32_t canId, std::array<uint8_t, 8> const& data) final;
 
 private:
+    // the raw contents of a receive buffer, starting at RXBnSIDH
+    using RxBuffer = std::array<uint8_t, 13>;
+
+    uint8_t readStatus();
+    void readRxBuffer(uint8_t instruction, RxBuffer& buffer);
+    static bool decode(RxBuffer const& buffer, HardwareInterface::can_message_t& msg);
+
     // this is static because we cannot give back the bus once we claimed it.
     // as we are going to use a shared host/bus in the future, we won't use a
     // workaround for the limited time we use it like this.
@@ -28,6 +35,13 @@ private:
     std::unique_ptr<SPIClass> _upSPI;
     std::unique_ptr<MCP_CAN> _upCAN;
     uint8_t _huaweiIrq; // IRQ pin
+    uint8_t _huaweiCs; // chip select pin
+
+    // messages read from both receive buffers at once, which are handed
+    // out one after another by getMessage()
+    std::array<HardwareInterface::can_message_t, 2> _rxMessages;
+    uint8_t _rxCount = 0;
+    uint8_t _rxIndex = 0;
 };
 
 } // namespace GridCharger::Huawei
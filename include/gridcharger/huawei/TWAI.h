@@ -1,7 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
-#include <atomic>
+#include <TwaiBus.h>
 #include <gridcharger/huawei/HardwareInterface.h>
 
 namespace GridCharger::Huawei {
@@ -17,11 +17,7 @@ public:
     bool sendMessage(uint32_t canId, std::array<uint8_t, 8> const& data) final;
 
 private:
-    TaskHandle_t _pollingTaskHandle = nullptr;
-    std::atomic<bool> _pollingTaskDone = false;
-    std::atomic<bool> _stopPolling = false;
-
-    static void pollAlerts(void* context);
+    TwaiBusClass::Subscription* _pSubscription = nullptr;
 };
 
 } // namespace GridCharger::Huawei
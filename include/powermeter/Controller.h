@@ -1,10 +1,13 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <powermeter/Estimator.h>
 #include <powermeter/Provider.h>
 #include <TaskSchedulerDeclarations.h>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <vector>
 
 namespace PowerMeters {
 
@@ -16,14 +19,61 @@ public:
 
     float getPowerTotal() const;
     uint32_t getLastUpdate() const;
+    uint32_t getMeasuredMillis() const;
     bool isDataValid() const;
 
+    // name of the source which provides the current reading. if fusion is
+    // enabled, this is the source with the most recent valid reading.
+    char const* getActiveSourceName() const;
+
+    // the household load (grid power plus the output of the inverters
+    // behind the power meter) forecast to the current time. std::nullopt
+    // if the predictive filter is disabled or has no valid estimate.
+    std::optional<float> getEstimatedLoad() const;
+
+    // the forecast grid power, based on the estimated load
+    std::optional<float> getPredictedPowerTotal() const;
+
+    float getEstimatorResidual() const;
+
+    // the diagnostics of the primary and, if fusion is enabled, the
+    // secondary source. Key is the source's snake case name.
+    struct SourceDiagnostics {
+        Provider::Type Type;
+        char const* Key;
+        Diagnostics::Snapshot Snapshot;
+    };
+    std::vector<SourceDiagnostics> getDiagnostics() const;
+
 private:
     void loop();
+    void publishDiagnostics() const;
+
+    static std::unique_ptr<Provider> createProvider(Provider::Type type);
+    static char const* getSourceName(Provider::Type type);
+    static char const* getSourceKey(Provider::Type type);
+
+    struct Source {
+        Provider::Type Type;
+        std::unique_ptr<Provider> upProvider;
+    };
+
+    // must be called while holding the mutex. returns nullptr if no
+    // source is available.
+    Source const* getActiveSource() const;
 
     Task _loopTask;
     mutable std::mutex _mutex;
-    std::unique_ptr<Provider> _upProvider = nullptr;
+
+    // holds the primary source and, if fusion is enabled, the secondary
+    std::vector<Source> _sources;
+
+    Estimator _estimator;
+    uint32_t _lastEstimatorUpdate = 0;
+
+    Provider::Type _lastActiveType = Provider::Type::MQTT;
+    uint32_t _lastDeviationWarning = 0;
+    uint32_t _lastDiagnosticsPublish = 0;
 };
 
 } // namespace PowerMeters
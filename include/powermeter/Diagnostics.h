@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <stdint.h>
+
+namespace PowerMeters {
+
+// fixed-bucket histograms of the timing of a provider's readings and the
+// amount of its failures by reason, such that a slow or unreliable meter
+// can be told apart from a slow DPL. thread-safe, as the providers process
+// their readings in tasks of their own.
+class Diagnostics {
+public:
+    enum class Metric : uint8_t {
+        Latency, // request sent until the response arrived
+        Interval, // time between two readings
+        ParseTime, // time spent decoding a reading
+        Count
+    };
+    static constexpr size_t MetricCount = static_cast<size_t>(Metric::Count);
+
+    enum class Failure : uint8_t {
+        Request, // the request failed or was answered with an error
+        Timeout, // the meter did not answer in time
+        Checksum, // the reading was corrupted
+        Parse, // the reading could not be decoded
+        Incomplete, // the reading lacked values
+        Sequence, // the reading was older than the last one
+        Count
+    };
+    static constexpr size_t FailureCount = static_cast<size_t>(Failure::Count);
+
+    // snake case names, as used by the web API, MQTT and Prometheus
+    static char const* getName(Metric metric);
+    static char const* getName(Failure failure);
+
+    static constexpr size_t BoundCount = 8;
+    using Bounds = std::array<uint32_t, BoundCount>;
+
+    // upper bounds of the buckets in microseconds. durations beyond the
+    // last bound are counted in an additional bucket.
+    static Bounds const& getBounds(Metric metric);
+
+    struct Histogram {
+        std::array<uint32_t, BoundCount + 1> Buckets = {}; // not cumulative
+        uint32_t Count = 0;
+        uint64_t Sum = 0; // microseconds
+    };
+
+    struct Snapshot {
+        std::array<Histogram, MetricCount> Metrics;
+        std::array<uint32_t, FailureCount> Failures = {};
+    };
+
+    void record(Metric metric, uint32_t micros);
+    void record(Failure failure);
+
+    Snapshot get() const;
+
+private:
+    mutable std::mutex _mutex;
+    Snapshot _snapshot;
+};
+
+} // namespace PowerMeters
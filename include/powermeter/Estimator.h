@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <optional>
+#include <stdint.h>
+
+namespace PowerMeters {
+
+// alpha-beta filter estimating the household load, i.e., the grid power
+// plus the output of the inverters behind the power meter. as the load is
+// independent from the inverter limits, it can be forecast to the current
+// time without waiting for a reading that reflects the last limit change.
+class Estimator {
+public:
+    void reset();
+
+    // load: grid power measured at the given time plus the output of the
+    // inverters behind the power meter at that same time.
+    void update(uint32_t measuredAt, float load);
+
+    // the load forecast to the given time. std::nullopt until the first
+    // measurement and if the last measurement is too old.
+    std::optional<float> getLoad(uint32_t at) const;
+
+    // difference between the last measurement and its forecast
+    float getResidual() const { return _residual; }
+
+private:
+    static constexpr float Alpha = 0.5f;
+    static constexpr float Beta = 0.1f;
+
+    // the trend is not extrapolated further than this
+    static constexpr uint32_t MaxForecastMillis = 5 * 1000;
+
+    // the filter restarts if measurements are missing for this long
+    static constexpr uint32_t MaxGapMillis = 30 * 1000;
+
+    bool _initialized = false;
+    uint32_t _lastMeasurement = 0;
+    float _load = 0; // in W
+    float _trend = 0; // in W per ms
+    float _residual = 0;
+};
+
+} // namespace PowerMeters
@@ -3,6 +3,7 @@
 
 #include <atomic>
 #include "Configuration.h"
+#include <powermeter/Diagnostics.h>
 
 namespace PowerMeters {
 
@@ -17,7 +18,9 @@ public:
         HTTP_JSON = 3,
         SERIAL_SML = 4,
         SMAHM2 = 5,
-        HTTP_SML = 6
+        HTTP_SML = 6,
+        UDP_PUSH = 7,
+        SHELLY_RPC = 8
     };
 
     // returns true if the provider is ready for use, false otherwise
@@ -27,27 +30,49 @@ public:
     virtual float getPowerTotal() const = 0;
     virtual bool isDataValid() const;
 
+    // the time the last reading was received
     uint32_t getLastUpdate() const { return _lastUpdate; }
+
+    // the time the last reading was measured, as far as the provider
+    // knows, which is never later than the time it was received.
+    uint32_t getMeasuredMillis() const { return _measuredMillis; }
+
     void mqttLoop() const;
 
+    // the timing of the readings and the failures, see Diagnostics.h
+    Diagnostics::Snapshot getDiagnostics() const { return _diagnostics.get(); }
+
 protected:
     Provider() {
         auto const& config = Configuration.get();
         _verboseLogging = config.PowerMeter.VerboseLogging;
     }
 
-    void gotUpdate() { _lastUpdate = millis(); }
+    // thread-safe. records the time of the new reading and announces it on
+    // the DataBus, such that the DPL can react to it right away.
+    void gotUpdate();
 
-    void mqttPublish(String const& topic, float const& value) const;
+    // as above, for a reading which was taken at the given time, e.g., the
+    // oldest of several values which were requested concurrently, or the
+    // start of the frame which carried it.
+    void gotUpdate(uint32_t takenMillis);
+
+    void mqttPublish(char const* topic, float const& value) const;
+    void mqttPublish(String const& topic, float const& value) const { mqttPublish(topic.c_str(), value); }
 
     bool _verboseLogging;
 
+    // the providers record the latency and parse time where applicable.
+    // the interval is recorded by gotUpdate(). thread-safe, hence mutable.
+    mutable Diagnostics _diagnostics;
+
 private:
     virtual void doMqttPublish() const = 0;
 
     // gotUpdate() updates this variable potentially from a different thread
     // than users that request to read this variable through getLastUpdate().
     std::atomic<uint32_t> _lastUpdate = 0;
+    std::atomic<uint32_t> _measuredMillis = 0;
 
     mutable uint32_t _lastMqttPublish = 0;
 };
@@ -5,11 +5,14 @@
 #include <array>
 #include <variant>
 #include <memory>
+#include <optional>
 #include <condition_variable>
 #include <mutex>
 #include <stdint.h>
+#include <ArduinoJson.h>
 #include <Configuration.h>
 #include <HttpGetter.h>
+#include <Utils.h>
 #include <powermeter/Provider.h>
 
 using Auth_t = HttpRequestConfig::Auth;
@@ -39,6 +42,25 @@ private:
     std::atomic<bool> _taskDone;
     void pollingLoop();
 
+    using value_result_t = std::variant<float, String>;
+    String fetchDocument(uint8_t idx, JsonDocument& json, JsonDocument const& filter);
+    value_result_t fetchValue(uint8_t idx);
+    value_result_t extractValue(uint8_t idx, JsonDocument const& json) const;
+
+    // if values are requested individually, all values but the first are
+    // fetched by worker tasks, such that the requests run concurrently.
+    struct Fetcher {
+        Provider* pProvider = nullptr;
+        uint8_t idx = 0;
+        TaskHandle_t taskHandle = nullptr;
+        TaskHandle_t requester = nullptr;
+        std::atomic<bool> taskDone;
+        value_result_t result;
+        uint32_t resultMillis = 0;
+    };
+    static void fetcherLoopHelper(void* context);
+    std::array<Fetcher, POWERMETER_HTTP_JSON_MAX_VALUES> _fetchers;
+
     PowerMeterHttpJsonConfig const _cfg;
 
     uint32_t _lastPoll = 0;
@@ -46,8 +68,16 @@ private:
     mutable std::mutex _valueMutex;
     power_values_t _powerValues = {};
 
+    // the time the oldest of the current values was received
+    uint32_t _powerValuesMillis = 0;
+
     std::array<std::unique_ptr<HttpGetter>, POWERMETER_HTTP_JSON_MAX_VALUES> _httpGetters;
 
+    // pre-parsed JSON paths and, if all values are extracted from the same
+    // response, a filter which keeps the nodes on any of these paths.
+    std::array<JsonPath, POWERMETER_HTTP_JSON_MAX_VALUES> _jsonPaths;
+    JsonDocument _sharedFilter;
+
     TaskHandle_t _taskHandle = nullptr;
     bool _stopPolling;
     mutable std::mutex _pollingMutex;
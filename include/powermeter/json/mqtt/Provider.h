@@ -2,6 +2,7 @@
 #pragma once
 
 #include <Configuration.h>
+#include <Utils.h>
 #include <powermeter/Provider.h>
 #include <espMqttClient.h>
 #include <vector>
@@ -25,7 +26,8 @@ private:
     using MsgProperties = espMqttClientTypes::MessageProperties;
     void onMessage(MsgProperties const& properties, char const* topic,
             uint8_t const* payload, size_t len, size_t index,
-            size_t total, float* targetVariable, PowerMeterMqttValue const* cfg);
+            size_t total, float* targetVariable, PowerMeterMqttValue const* cfg,
+            JsonPath const* jsonPath);
 
     // we don't need to republish data received from MQTT
     void doMqttPublish() const final { };
@@ -35,6 +37,8 @@ private:
     using power_values_t = std::array<float, POWERMETER_MQTT_MAX_VALUES>;
     power_values_t _powerValues;
 
+    std::array<JsonPath, POWERMETER_MQTT_MAX_VALUES> _jsonPaths;
+
     std::vector<String> _mqttSubscriptions;
 
     mutable std::mutex _mutex;
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <ArduinoJson.h>
+#include <Configuration.h>
+#include <esp_websocket_client.h>
+#include <powermeter/Provider.h>
+
+namespace PowerMeters::Json::Shelly {
+
+// reads a Shelly Gen2 energy meter (e.g., the Pro 3EM) through its RPC
+// websocket at ws://<hostname>/rpc. the device sends notifications to every
+// websocket peer which identified itself in a request, so the connection
+// is kept open and each NotifyStatus of the EM component is processed as
+// soon as it arrives, in the context of the websocket task. the status is
+// requested explicitly only if the notifications cease.
+class Provider : public ::PowerMeters::Provider {
+public:
+    explicit Provider(PowerMeterShellyRpcConfig const& cfg);
+    ~Provider();
+
+    bool init() final;
+    void loop() final;
+    float getPowerTotal() const final;
+    void doMqttPublish() const final;
+
+private:
+    static void onEventHelper(void* context, esp_event_base_t base,
+            int32_t eventId, void* eventData);
+    void onEvent(int32_t eventId, esp_websocket_event_data_t const* data);
+    void handleMessage();
+    void handleError(JsonObjectConst error);
+    void sendStatusRequest();
+
+    PowerMeterShellyRpcConfig const _cfg;
+    esp_websocket_client_handle_t _client = nullptr;
+
+    // "em:<id>", the key of the meter's status in notifications
+    String _component;
+
+    // keeps the power values of the responses and notifications only
+    JsonDocument _filter;
+
+    // a message larger than the websocket buffer arrives in chunks
+    std::vector<char> _message;
+
+    mutable std::mutex _mutex;
+    float _power = 0;
+    std::array<float, 3> _phases = {};
+
+    // the pending status request, answered or not
+    uint32_t _requestId = 0;
+    uint32_t _requestMillis = 0;
+    bool _requestPending = false;
+
+    // digest authentication, set up once the device demanded it
+    bool _authValid = false;
+    String _authRealm;
+    String _authHa1;
+    uint32_t _authNonce = 0;
+
+    std::atomic<uint32_t> _lastMessage = 0;
+};
+
+} // namespace PowerMeters::Json::Shelly
@@ -4,6 +4,8 @@
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <array>
+#include <vector>
 #include <SoftwareSerial.h>
 #include <Configuration.h>
 #include <powermeter/Provider.h>
@@ -18,9 +20,7 @@ public:
         Three
     };
 
-    Provider(Phases phases, PowerMeterSerialSdmConfig const& cfg)
-        : _phases(phases)
-        , _cfg(cfg) { }
+    Provider(Phases phases, PowerMeterSerialSdmConfig const& cfg);
 
     ~Provider();
 
@@ -31,24 +31,38 @@ public:
     void doMqttPublish() const final;
 
 private:
+    // the values of one meter on the RS485 bus
+    struct Meter {
+        uint8_t Address;
+        Phases MeterPhases;
+        std::array<float, 3> Power = {};
+        std::array<float, 3> Voltage = {};
+        std::array<float, 2> Energy = {}; // import and export
+    };
+
+    // a single Modbus request for consecutive values of one meter
+    struct Request {
+        uint8_t Address;
+        uint16_t Reg;
+        uint8_t Count;
+        float* pTargets;
+    };
+
     static void pollingLoopHelper(void* context);
-    bool readValue(std::unique_lock<std::mutex>& lock, uint16_t reg, float& targetVar);
+    bool readValues(std::unique_lock<std::mutex>& lock, Request const& request);
     std::atomic<bool> _taskDone;
     void pollingLoop();
+    void mqttPublishMeter(Meter const& meter, String const& prefix) const;
 
     Phases _phases;
     PowerMeterSerialSdmConfig const _cfg;
 
     uint32_t _lastPoll = 0;
+    uint32_t _lastSlowPoll = 0;
 
-    float _phase1Power = 0.0;
-    float _phase2Power = 0.0;
-    float _phase3Power = 0.0;
-    float _phase1Voltage = 0.0;
-    float _phase2Voltage = 0.0;
-    float _phase3Voltage = 0.0;
-    float _energyImport = 0.0;
-    float _energyExport = 0.0;
+    // the meter which measures the grid power comes first. other meters on
+    // the same bus (e.g., sub-meters of single loads) follow.
+    std::vector<Meter> _meters;
 
     mutable std::mutex _valueMutex;
 
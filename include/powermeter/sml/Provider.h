@@ -1,7 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
-#include <list>
+#include <array>
 #include <mutex>
 #include <optional>
 #include <stdint.h>
@@ -22,10 +22,32 @@ protected:
     explicit Provider(char const* user)
         : _user(user) { }
 
+    // discards the frame in progress, which is counted as incomplete
     void reset();
-    void processSmlByte(uint8_t byte);
+
+    void processSmlBytes(uint8_t const* data, size_t length);
+
+    // sets the time the values of the next frame were taken, which is
+    // otherwise the time its first byte was processed
+    void startFrame(uint32_t takenMillis) { _frameStartMillis = takenMillis; }
+
+    // the amount of frames whose values were taken
+    uint32_t getCompletedFrames() const { return _completedFrames; }
+
+    // whether the current frame provided the total power and all other
+    // values that previous frames provided, such that the rest of the
+    // frame is not needed.
+    bool hasExpectedValues() const;
+
+    // takes the values decoded from the current frame so far, without
+    // verifying its checksum. only to be used if the transport ensures
+    // the integrity of the data.
+    void takeValues();
 
 private:
+    void clear();
+    void processSmlByte(uint8_t byte);
+
     std::string _user;
     mutable std::mutex _mutex;
 
@@ -47,27 +69,46 @@ private:
     values_t _values;
     values_t _cache;
 
+    // the time the first byte of the current frame was processed, which is
+    // the best guess for the time the meter took the values. zero while no
+    // frame is in progress. only accessed by the parsing task.
+    uint32_t _frameStartMillis = 0;
+
+    // the time spent parsing the current frame, accumulated over the
+    // chunks it arrived in. only accessed by the parsing task.
+    uint32_t _parseMicros = 0;
+    uint32_t _chunkStartMicros = 0;
+
+    // the values decoded from the current frame and those decoded from any
+    // complete frame so far, by index into the handler list
+    uint16_t _decodedValues = 0;
+    uint16_t _expectedValues = 0;
+    uint32_t _completedFrames = 0;
+
+    // the handlers refer to the values by member pointer, such that the
+    // table is shared by all instances and lives in flash.
     using OBISHandler = struct {
         uint8_t const OBIS[6];
         void (*decoder)(float&);
-        std::optional<float>* target;
+        std::optional<float> values_t::* target;
         char const* name;
     };
 
-    const std::list<OBISHandler> smlHandlerList{
-        {{0x01, 0x00, 0x10, 0x07, 0x00, 0xff}, &smlOBISW, &_cache.activePowerTotal, "active power total"},
-        {{0x01, 0x00, 0x24, 0x07, 0x00, 0xff}, &smlOBISW, &_cache.activePowerL1, "active power L1"},
-        {{0x01, 0x00, 0x38, 0x07, 0x00, 0xff}, &smlOBISW, &_cache.activePowerL2, "active power L2"},
-        {{0x01, 0x00, 0x4c, 0x07, 0x00, 0xff}, &smlOBISW, &_cache.activePowerL3, "active power L3"},
-        {{0x01, 0x00, 0x20, 0x07, 0x00, 0xff}, &smlOBISVolt, &_cache.voltageL1, "voltage L1"},
-        {{0x01, 0x00, 0x34, 0x07, 0x00, 0xff}, &smlOBISVolt, &_cache.voltageL2, "voltage L2"},
-        {{0x01, 0x00, 0x48, 0x07, 0x00, 0xff}, &smlOBISVolt, &_cache.voltageL3, "voltage L3"},
-        {{0x01, 0x00, 0x1f, 0x07, 0x00, 0xff}, &smlOBISAmpere, &_cache.currentL1, "current L1"},
-        {{0x01, 0x00, 0x33, 0x07, 0x00, 0xff}, &smlOBISAmpere, &_cache.currentL2, "current L2"},
-        {{0x01, 0x00, 0x47, 0x07, 0x00, 0xff}, &smlOBISAmpere, &_cache.currentL3, "current L3"},
-        {{0x01, 0x00, 0x01, 0x08, 0x00, 0xff}, &smlOBISWh, &_cache.energyImport, "energy import"},
-        {{0x01, 0x00, 0x02, 0x08, 0x00, 0xff}, &smlOBISWh, &_cache.energyExport, "energy export"}
-    };
+    static constexpr std::array<OBISHandler, 12> smlHandlerList{{
+        {{0x01, 0x00, 0x10, 0x07, 0x00, 0xff}, &smlOBISW, &values_t::activePowerTotal, "active power total"},
+        {{0x01, 0x00, 0x24, 0x07, 0x00, 0xff}, &smlOBISW, &values_t::activePowerL1, "active power L1"},
+        {{0x01, 0x00, 0x38, 0x07, 0x00, 0xff}, &smlOBISW, &values_t::activePowerL2, "active power L2"},
+        {{0x01, 0x00, 0x4c, 0x07, 0x00, 0xff}, &smlOBISW, &values_t::activePowerL3, "active power L3"},
+        {{0x01, 0x00, 0x20, 0x07, 0x00, 0xff}, &smlOBISVolt, &values_t::voltageL1, "voltage L1"},
+        {{0x01, 0x00, 0x34, 0x07, 0x00, 0xff}, &smlOBISVolt, &values_t::voltageL2, "voltage L2"},
+        {{0x01, 0x00, 0x48, 0x07, 0x00, 0xff}, &smlOBISVolt, &values_t::voltageL3, "voltage L3"},
+        {{0x01, 0x00, 0x1f, 0x07, 0x00, 0xff}, &smlOBISAmpere, &values_t::currentL1, "current L1"},
+        {{0x01, 0x00, 0x33, 0x07, 0x00, 0xff}, &smlOBISAmpere, &values_t::currentL2, "current L2"},
+        {{0x01, 0x00, 0x47, 0x07, 0x00, 0xff}, &smlOBISAmpere, &values_t::currentL3, "current L3"},
+        {{0x01, 0x00, 0x01, 0x08, 0x00, 0xff}, &smlOBISWh, &values_t::energyImport, "energy import"},
+        {{0x01, 0x00, 0x02, 0x08, 0x00, 0xff}, &smlOBISWh, &values_t::energyExport, "energy export"}
+    }};
+    static_assert(smlHandlerList.size() <= 16, "handler bits exceed uint16_t");
 };
 
 } // namespace PowerMeters::Sml
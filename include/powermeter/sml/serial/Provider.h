@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <HardwareSerial.h>
 #include <SoftwareSerial.h>
 #include <powermeter/sml/Provider.h>
 
@@ -34,14 +35,31 @@ private:
     // serial instance that performs bit decoding (we call available()).
     static int constexpr _isrCapacity = 256; // memory usage: 8 bytes each (timestamp + pointer)
 
+    // the hardware UART signals the end of a datagram once the RX line was
+    // idle for this many symbols, i.e. about 10 ms at 9600 baud.
+    static uint8_t constexpr _rxTimeoutSymbols = 10;
+
+    // size of the chunks which are read from the hardware UART buffer
+    static size_t constexpr _chunkSize = 128;
+
     static void pollingLoopHelper(void* context);
     std::atomic<bool> _taskDone;
     void pollingLoop();
+    void pollingLoopHardware();
+    void pollingLoopSoftware();
+
+    // feeds the recorded input which is due, see InputCapture.h
+    void replay();
 
     TaskHandle_t _taskHandle = nullptr;
     bool _stopPolling;
     mutable std::mutex _pollingMutex;
 
+    std::string const _serialPortOwner = "SML Power Meter";
+
+    // a hardware UART is used if one is available. it buffers whole
+    // datagrams, such that the task sleeps until a datagram was received.
+    std::unique_ptr<HardwareSerial> _upHwSerial = nullptr;
     std::unique_ptr<SoftwareSerial> _upSmlSerial = nullptr;
 };
 
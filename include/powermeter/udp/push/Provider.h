@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <AsyncUDP.h>
+#include <Configuration.h>
+#include <powermeter/Provider.h>
+
+namespace PowerMeters::Udp::Push {
+
+// receives readings which a meter reader (e.g., ESPHome, Tasmota or a
+// script) pushes as UDP datagrams. each datagram is processed as soon as it
+// is received, i.e., in the context of the UDP task, and wakes up the DPL.
+//
+// binary datagrams (little endian) are 20 or 32 bytes long:
+//   0  "ODPM"
+//   4  uint8   version, 1
+//   5  uint8   number of phase values, 0 or 3
+//   6  uint16  reserved, 0
+//   8  uint32  sequence number
+//  12  uint32  time of the measurement in milliseconds of the sender's clock
+//  16  float   total power in W, positive when importing from the grid
+//  20  float   power of L1, L2 and L3 in W (optional)
+//
+// JSON datagrams hold the same values, "phases" being optional:
+//   {"seq":1234,"ts":567890,"power":-215.5,"phases":[-80.5,-70,-65]}
+//
+// datagrams which are not newer than the last one by their sequence number
+// are dropped, unless the sender apparently restarted.
+class Provider : public ::PowerMeters::Provider {
+public:
+    explicit Provider(PowerMeterUdpPushConfig const& cfg);
+    ~Provider();
+
+    bool init() final;
+    void loop() final { }
+    float getPowerTotal() const final;
+    void doMqttPublish() const final;
+
+private:
+    struct Reading {
+        uint32_t Sequence;
+        uint32_t Timestamp;
+        float Power;
+        std::array<float, 3> Phases;
+        bool HasPhases;
+    };
+
+    void handlePacket(AsyncUDPPacket& packet);
+    bool parseBinary(uint8_t const* data, size_t size, Reading& reading) const;
+    bool parseJson(uint8_t const* data, size_t size, Reading& reading) const;
+
+    PowerMeterUdpPushConfig const _cfg;
+    AsyncUDP _udp;
+
+    mutable std::mutex _mutex;
+    float _power = 0;
+    std::array<float, 3> _phases = {};
+    bool _hasPhases = false;
+
+    bool _synced = false;
+    uint32_t _lastSequence = 0;
+    uint32_t _lastArrival = 0;
+
+    // the smallest difference between arrival and measurement seen within
+    // the current window maps the sender's clock to ours, as it belongs to
+    // the datagram which was delayed the least.
+    uint32_t _clockOffset = 0;
+    uint16_t _clockOffsetAge = 0;
+};
+
+} // namespace PowerMeters::Udp::Push
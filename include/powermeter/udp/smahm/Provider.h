@@ -4,32 +4,55 @@
  */
 #pragma once
 
+#include <array>
 #include <cstdint>
+#include <mutex>
+#include <vector>
+#include <Configuration.h>
 #include <powermeter/Provider.h>
 
 namespace PowerMeters::Udp::SmaHM {
 
 class Provider : public ::PowerMeters::Provider {
 public:
+    explicit Provider(PowerMeterUdpSmaHmConfig const& cfg);
     ~Provider();
 
     bool init() final;
     void loop() final;
-    float getPowerTotal() const final { return _powerMeterPower; }
+    float getPowerTotal() const final;
     void doMqttPublish() const final;
 
 private:
-    void Soutput(int kanal, int index, int art, int tarif,
-            char const* name, float value, uint32_t timestamp);
+    // the values of one SMA Home Manager or Energy Meter
+    struct Meter {
+        uint32_t Serial;
+        std::array<float, 4> Power = {}; // total and per phase
+        bool Valid = false;
+
+        // inter-arrival jitter as defined in RFC 3550, section 6.4.1,
+        // based on the meter's own millisecond tick.
+        uint32_t LastTimestamp = 0;
+        uint32_t LastArrival = 0;
+        float JitterMillis = 0.0;
+    };
+
+    void handlePacket(uint8_t const* buffer, size_t size);
+    void decodeGroup(uint8_t const* data, uint16_t length, uint32_t arrival);
+    Meter* getMeter(uint32_t serial);
+    void mqttPublishMeter(Meter const& meter, String const& prefix) const;
+
+    PowerMeterUdpSmaHmConfig const _cfg;
+
+    // the meter which measures the grid power comes first. other meters
+    // (e.g., of a sub-distribution) follow.
+    std::vector<Meter> _meters;
+    mutable std::mutex _mutex;
 
-    uint8_t* decodeGroup(uint8_t* offset, uint16_t grouplen);
-
-    float _powerMeterPower = 0.0;
-    float _powerMeterL1 = 0.0;
-    float _powerMeterL2 = 0.0;
-    float _powerMeterL3 = 0.0;
     uint32_t _previousMillis = 0;
-    uint32_t _serial = 0;
+
+    // a datagram of a Home Manager 2.0 is about 600 bytes long
+    std::array<uint8_t, 1024> _buffer;
 };
 
 } // namespace PowerMeters::Udp::SmaHM
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <solarcharger/Stats.h>
+#include <memory>
+#include <vector>
+
+namespace SolarChargers {
+
+// combines the stats of several providers feeding the same DC bus, e.g.,
+// Victron MPPTs and a charge controller reporting via MQTT: the powers and
+// yields are summed up and the output voltage is the minimum of all
+// providers. the combined values are recalculated when a provider was
+// updated, such that reading them is as cheap as reading the values of a
+// single provider.
+class AggregateStats : public Stats {
+public:
+    explicit AggregateStats(std::vector<std::shared_ptr<Stats const>> providers);
+
+    // recalculates the combined values if any provider was updated since
+    // the last call. returns true if the values were recalculated.
+    bool update();
+
+    uint32_t getAgeMillis() const final;
+    std::optional<float> getOutputPowerWatts() const final { return _aggregates.oOutputPowerWatts; }
+    std::optional<float> getOutputVoltage() const final { return _aggregates.oOutputVoltage; }
+    std::optional<uint16_t> getPanelPowerWatts() const final { return _aggregates.oPanelPowerWatts; }
+    std::optional<float> getYieldTotal() const final { return _aggregates.oYieldTotal; }
+    std::optional<float> getYieldDay() const final { return _aggregates.oYieldDay; }
+    std::optional<StateOfOperation> getStateOfOperation() const final { return _aggregates.oStateOfOperation; }
+    std::optional<float> getFloatVoltage() const final { return _aggregates.oFloatVoltage; }
+    std::optional<float> getAbsorptionVoltage() const final { return _aggregates.oAbsorptionVoltage; }
+
+    void getLiveViewData(JsonVariant& root, const boolean fullUpdate, const uint32_t lastPublish) const final;
+
+    // the providers publish their own values and sensors
+    void mqttPublish() const final {}
+    void mqttPublishSensors(const boolean forcePublish) const final {}
+
+private:
+    void aggregate();
+
+    struct Source {
+        std::shared_ptr<Stats const> spStats;
+        uint32_t lastUpdate = 0;
+    };
+    std::vector<Source> _sources;
+
+    struct Aggregates {
+        std::optional<uint32_t> oNewestUpdate = std::nullopt;
+        std::optional<float> oOutputPowerWatts = std::nullopt;
+        std::optional<float> oOutputVoltage = std::nullopt;
+        std::optional<uint16_t> oPanelPowerWatts = std::nullopt;
+        std::optional<float> oYieldTotal = std::nullopt;
+        std::optional<float> oYieldDay = std::nullopt;
+        std::optional<StateOfOperation> oStateOfOperation = std::nullopt;
+        std::optional<float> oFloatVoltage = std::nullopt;
+        std::optional<float> oAbsorptionVoltage = std::nullopt;
+    };
+    Aggregates _aggregates;
+};
+
+} // namespace SolarChargers
@@ -3,7 +3,10 @@
 
 #include <memory>
 #include <mutex>
+#include <vector>
 #include <TaskSchedulerDeclarations.h>
+#include <solarcharger/AggregateStats.h>
+#include <solarcharger/Estimator.h>
 #include <solarcharger/Provider.h>
 #include <solarcharger/Stats.h>
 
@@ -14,15 +17,25 @@ public:
     void init(Scheduler&);
     void updateSettings();
 
+    // the stats of the solar chargers, which combine the stats of all
+    // providers if additional providers are configured
     std::shared_ptr<Stats const> getStats() const;
 
+    // the output power of the solar chargers forecast to the current time,
+    // see Estimator.h. std::nullopt if there is no recent output power.
+    std::optional<float> getPredictedOutputPowerWatts() const;
+
 private:
     void loop();
+    std::unique_ptr<Provider> createProvider(uint8_t provider) const;
 
     Task _loopTask;
     mutable std::mutex _mutex;
-    std::unique_ptr<Provider> _upProvider = nullptr;
+    std::vector<std::unique_ptr<Provider>> _providers;
+    std::shared_ptr<AggregateStats> _spAggregateStats = nullptr;
     bool _forcePublishSensors = false;
+
+    Estimator _estimator;
 };
 
 } // namespace SolarChargers
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <optional>
+#include <stdint.h>
+
+namespace SolarChargers {
+
+// alpha-beta filter estimating the power the solar charge controllers feed
+// into the DC power bus. the trend is additionally informed by the change
+// of the panel power, which leads the output while the MPPT tracks a
+// changing irradiance. this allows to forecast the output over the time the
+// data of the charge controllers takes to arrive, such that the DPL does
+// not consistently lag behind clouds passing by.
+class Estimator {
+public:
+    void reset();
+
+    // outputWatts: the output power reported at the given time, and the
+    // panel power reported along with it, if known. may be called with the
+    // same data repeatedly, which is ignored.
+    void update(uint32_t measuredAt, float outputWatts, std::optional<float> oPanelWatts);
+
+    // the output power forecast to the given time. std::nullopt until the
+    // first measurement and if the last measurement is too old.
+    std::optional<float> getOutputWatts(uint32_t at) const;
+
+    // difference between the last measurement and its forecast
+    float getResidual() const { return _residual; }
+
+private:
+    static constexpr float Alpha = 0.5f;
+    static constexpr float Beta = 0.1f;
+
+    // weight of the trend derived from the change of the panel power
+    static constexpr float Gamma = 0.3f;
+
+    // measurements closer than this are considered the same
+    static constexpr uint32_t MinIntervalMillis = 100;
+
+    // the trend is not extrapolated further than this
+    static constexpr uint32_t MaxForecastMillis = 3 * 1000;
+
+    // the filter restarts if measurements are missing for this long
+    static constexpr uint32_t MaxGapMillis = 10 * 1000;
+
+    bool _initialized = false;
+    uint32_t _lastMeasurement = 0;
+    float _output = 0; // in W
+    float _trend = 0; // in W per ms
+    float _residual = 0;
+    std::optional<float> _oPanelWatts = std::nullopt;
+};
+
+} // namespace SolarChargers
@@ -2,12 +2,17 @@
 #pragma once
 
 #include <Arduino.h>
+#include <functional>
 
 namespace SolarChargers {
 
 class HassIntegration {
+public:
+    ~HassIntegration();
+
 protected:
     void publish(const String& subtopic, const String& payload) const;
+    void enqueue(std::function<void()>&& generator) const;
 };
 
 } // namespace SolarChargers
@@ -8,6 +8,7 @@
 #include <solarcharger/mqtt/Stats.h>
 #include <VeDirectMpptController.h>
 #include <espMqttClient.h>
+#include <Utils.h>
 
 namespace SolarChargers::Mqtt {
 
@@ -31,20 +32,23 @@ private:
     String _outputPowerTopic;
     String _outputVoltageTopic;
     String _outputCurrentTopic;
+    JsonPath _outputPowerJsonPath;
+    JsonPath _outputVoltageJsonPath;
+    JsonPath _outputCurrentJsonPath;
     std::vector<String> _subscribedTopics;
     std::shared_ptr<Stats> _stats = std::make_shared<Stats>();
 
     void onMqttMessageOutputPower(espMqttClientTypes::MessageProperties const& properties,
             char const* topic, uint8_t const* payload, size_t len, size_t index, size_t total,
-            char const* jsonPath) const;
+            JsonPath const* jsonPath) const;
 
     void onMqttMessageOutputVoltage(espMqttClientTypes::MessageProperties const& properties,
             char const* topic, uint8_t const* payload, size_t len, size_t index, size_t total,
-            char const* jsonPath) const;
+            JsonPath const* jsonPath) const;
 
     void onMqttMessageOutputCurrent(espMqttClientTypes::MessageProperties const& properties,
             char const* topic, uint8_t const* payload, size_t len, size_t index, size_t total,
-            char const* jsonPath) const;
+            JsonPath const* jsonPath) const;
 };
 
 } // namespace SolarChargers::Mqtt
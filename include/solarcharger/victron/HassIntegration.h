@@ -4,6 +4,7 @@
 #include <ArduinoJson.h>
 #include <solarcharger/HassIntegration.h>
 #include "VeDirectMpptController.h"
+#include <memory>
 
 namespace SolarChargers::Victron {
 
@@ -14,12 +15,22 @@ public:
 private:
     void publishBinarySensor(const char *caption, const char *icon, const char *subTopic,
                              const char *payload_on, const char *payload_off,
-                             const VeDirectMpptController::data_t &mpptData) const;
+                             const std::shared_ptr<const VeDirectMpptController::data_t> &spMpptData) const;
 
     void publishSensor(const char *caption, const char *icon, const char *subTopic,
                        const char *deviceClass, const char *stateClass,
                        const char *unitOfMeasurement,
-                       const VeDirectMpptController::data_t &mpptData) const;
+                       const std::shared_ptr<const VeDirectMpptController::data_t> &spMpptData) const;
+
+    // the discovery documents are created once the paced publisher gets to them
+    void generateBinarySensor(const char *caption, const char *icon, const char *subTopic,
+                              const char *payload_on, const char *payload_off,
+                              const VeDirectMpptController::data_t &mpptData) const;
+
+    void generateSensor(const char *caption, const char *icon, const char *subTopic,
+                        const char *deviceClass, const char *stateClass,
+                        const char *unitOfMeasurement,
+                        const VeDirectMpptController::data_t &mpptData) const;
 
     void createDeviceInfo(JsonObject &object,
                           const VeDirectMpptController::data_t &mpptData) const;
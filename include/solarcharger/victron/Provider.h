@@ -4,6 +4,7 @@
 #include <mutex>
 #include <memory>
 #include <TaskSchedulerDeclarations.h>
+#include <VeDirectPort.h>
 #include <solarcharger/Provider.h>
 #include <solarcharger/victron/Stats.h>
 #include <VeDirectMpptController.h>
@@ -26,10 +27,10 @@ private:
     Provider& operator=(Provider const& other) = delete;
     Provider& operator=(Provider&& other) = delete;
 
+    using Port = VeDirectPort<VeDirectMpptController>;
+
     mutable std::mutex _mutex;
-    using controller_t = std::unique_ptr<VeDirectMpptController>;
-    std::vector<controller_t> _controllers;
-    std::vector<String> _serialPortOwners;
+    std::vector<std::unique_ptr<Port>> _ports;
     std::shared_ptr<Stats> _stats = std::make_shared<Stats>();
 
     bool initController(int8_t rx, int8_t tx, bool logging, uint8_t instance);
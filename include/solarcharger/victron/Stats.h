@@ -33,6 +33,23 @@ private:
 
     mutable std::map<String, VeDirectMpptController::data_t> _previousData;
 
+    // the values of all charge controllers combined, which are updated with
+    // each new frame rather than each time they are read.
+    struct Aggregates {
+        std::optional<uint32_t> oOldestUpdate = std::nullopt;
+        std::optional<float> oOutputPowerWatts = std::nullopt;
+        std::optional<float> oOutputVoltage = std::nullopt;
+        std::optional<uint16_t> oPanelPowerWatts = std::nullopt;
+        std::optional<float> oYieldTotal = std::nullopt;
+        std::optional<float> oYieldDay = std::nullopt;
+        std::optional<StateOfOperation> oStateOfOperation = std::nullopt;
+        std::optional<float> oFloatVoltage = std::nullopt;
+        std::optional<float> oAbsorptionVoltage = std::nullopt;
+    };
+    mutable Aggregates _aggregates;
+
+    void updateAggregates() const;
+
     // point of time in millis() when updated values will be published
     mutable uint32_t _nextPublishUpdatesOnly = 0;
 
@@ -42,6 +42,18 @@ uint8_t CMT2300A_ReadReg(const uint8_t addr)
     return cmt_spi3_read(addr);
 }
 
+/*! ********************************************************
+ * @name    CMT2300A_ReadRegs
+ * @desc    Read several CMT2300A registers in a single batch.
+ * @param   addrs: register addresses
+ *          dat: buffer where to copy the register values
+ *          len: number of registers to be read
+ * *********************************************************/
+void CMT2300A_ReadRegs(const uint8_t addrs[], uint8_t dat[], const uint8_t len)
+{
+    cmt_spi3_read_regs(addrs, dat, len);
+}
+
 /*! ********************************************************
  * @name    CMT2300A_WriteReg
  * @desc    Write the CMT2300A register at the specified address.
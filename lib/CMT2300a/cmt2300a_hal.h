@@ -39,6 +39,7 @@ extern "C" {
 void CMT2300A_InitSpi(const int8_t pin_sdio, const int8_t pin_clk, const int8_t pin_cs, const int8_t pin_fcs, const uint32_t spi_speed);
 
 uint8_t CMT2300A_ReadReg(const uint8_t addr);
+void CMT2300A_ReadRegs(const uint8_t addrs[], uint8_t dat[], const uint8_t len);
 void CMT2300A_WriteReg(const uint8_t addr, const uint8_t dat);
 
 void CMT2300A_ReadFifo(uint8_t buf[], const uint16_t len);
@@ -123,6 +123,15 @@ int CMT2300A::getRssiDBm()
     return CMT2300A_GetRssiDBm();
 }
 
+CMT2300A::RxStatus CMT2300A::getRxStatus()
+{
+    static constexpr uint8_t addrs[] = { CMT2300A_CUS_FREQ_CHNL, CMT2300A_CUS_RSSI_DBM };
+    uint8_t values[sizeof(addrs)];
+    CMT2300A_ReadRegs(addrs, values, sizeof(addrs));
+
+    return { values[0], static_cast<int>(values[1]) - 128 };
+}
+
 bool CMT2300A::setPALevel(const int8_t level)
 {
     uint16_t Tx_dBm_word;
@@ -90,6 +90,17 @@ public:
 
     int getRssiDBm();
 
+    struct RxStatus {
+        uint8_t channel;
+        int rssiDBm;
+    };
+
+    /**
+     * Get the channel and the RSSI of the last received payload, read in
+     * a single batch of register accesses
+     */
+    RxStatus getRxStatus();
+
     bool setPALevel(const int8_t level);
 
     bool rxFifoAvailable();
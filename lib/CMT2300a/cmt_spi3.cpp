@@ -47,7 +47,8 @@ void cmt_spi3_init(const int8_t pin_sdio, const int8_t pin_clk, const int8_t pin
         .post_cb = post_cb,
     };
 
-    spi = SpiManagerInst.alloc_device("", bus_config, device_config);
+    // the RX FIFO must be read before the next fragment overwrites it
+    spi = SpiManagerInst.alloc_device("", bus_config, device_config, "CMT2300A", SpiPriority::Realtime);
     if (!spi)
         ESP_ERROR_CHECK(ESP_FAIL);
 
@@ -62,94 +63,119 @@ void cmt_spi3_init(const int8_t pin_sdio, const int8_t pin_clk, const int8_t pin
     ESP_ERROR_CHECK(gpio_set_direction(cs_fifo, GPIO_MODE_OUTPUT));
 }
 
-void cmt_spi3_write(const uint8_t addr, const uint8_t data)
+// all transfers use the data fields of the transactions instead of buffers.
+// with DMA enabled, the driver would otherwise allocate a temporary,
+// word-aligned buffer for every byte read from the chip.
+
+static spi_transaction_ext_t make_reg_read_trans(const uint8_t addr)
 {
     spi_transaction_ext_t trans {
         .base {
-            .flags = SPI_TRANS_VARIABLE_CMD | SPI_TRANS_VARIABLE_ADDR,
-            .cmd = 0,
+            .flags = SPI_TRANS_VARIABLE_CMD | SPI_TRANS_VARIABLE_ADDR | SPI_TRANS_USE_RXDATA,
+            .cmd = 1,
             .addr = addr,
-            .length = 8,
-            .rxlength = 0,
+            .length = 0,
+            .rxlength = 8,
             .user = &cs_reg, // CS for register access
-            .tx_buffer = &data,
-            .rx_buffer = nullptr,
         },
         .command_bits = 1,
         .address_bits = 7,
         .dummy_bits = 0,
     };
-    SPI_PARAM_LOCK();
-    ESP_ERROR_CHECK(spi_device_polling_transmit(spi, reinterpret_cast<spi_transaction_t*>(&trans)));
-    SPI_PARAM_UNLOCK();
+    return trans;
 }
 
-uint8_t cmt_spi3_read(const uint8_t addr)
+void cmt_spi3_write(const uint8_t addr, const uint8_t data)
 {
-    uint8_t data;
     spi_transaction_ext_t trans {
         .base {
-            .flags = SPI_TRANS_VARIABLE_CMD | SPI_TRANS_VARIABLE_ADDR,
-            .cmd = 1,
+            .flags = SPI_TRANS_VARIABLE_CMD | SPI_TRANS_VARIABLE_ADDR | SPI_TRANS_USE_TXDATA,
+            .cmd = 0,
             .addr = addr,
-            .length = 0,
-            .rxlength = 8,
+            .length = 8,
+            .rxlength = 0,
             .user = &cs_reg, // CS for register access
-            .tx_buffer = nullptr,
-            .rx_buffer = &data,
         },
         .command_bits = 1,
         .address_bits = 7,
         .dummy_bits = 0,
     };
+    trans.base.tx_data[0] = data;
+
     SPI_PARAM_LOCK();
     ESP_ERROR_CHECK(spi_device_polling_transmit(spi, reinterpret_cast<spi_transaction_t*>(&trans)));
     SPI_PARAM_UNLOCK();
-    return data;
 }
 
+uint8_t cmt_spi3_read(const uint8_t addr)
+{
+    spi_transaction_ext_t trans = make_reg_read_trans(addr);
+
+    SPI_PARAM_LOCK();
+    ESP_ERROR_CHECK(spi_device_polling_transmit(spi, reinterpret_cast<spi_transaction_t*>(&trans)));
+    SPI_PARAM_UNLOCK();
+    return trans.base.rx_data[0];
+}
+
+void cmt_spi3_read_regs(const uint8_t* addrs, uint8_t* data, const uint8_t len)
+{
+    SPI_PARAM_LOCK();
+    SpiManagerInst.acquire(spi);
+    spi_device_acquire_bus(spi, portMAX_DELAY);
+    for (uint8_t i = 0; i < len; i++) {
+        spi_transaction_ext_t trans = make_reg_read_trans(addrs[i]);
+        ESP_ERROR_CHECK(spi_device_polling_transmit(spi, reinterpret_cast<spi_transaction_t*>(&trans)));
+        data[i] = trans.base.rx_data[0];
+    }
+    spi_device_release_bus(spi);
+    SpiManagerInst.release(spi);
+    SPI_PARAM_UNLOCK();
+}
+
+// the chip expects every FIFO byte to be framed by FCSB, so each byte is a
+// transaction of its own. the bus is acquired once for all of them.
 void cmt_spi3_write_fifo(const uint8_t* buf, const uint16_t len)
 {
     spi_transaction_t trans {
-        .flags = 0,
+        .flags = SPI_TRANS_USE_TXDATA,
         .cmd = 0,
         .addr = 0,
         .length = 8,
         .rxlength = 0,
         .user = &cs_fifo, // CS for FIFO access
-        .tx_buffer = nullptr,
-        .rx_buffer = nullptr,
     };
 
     SPI_PARAM_LOCK();
+    SpiManagerInst.acquire(spi);
     spi_device_acquire_bus(spi, portMAX_DELAY);
-    for (uint8_t i = 0; i < len; i++) {
-        trans.tx_buffer = buf + i;
+    for (uint16_t i = 0; i < len; i++) {
+        trans.tx_data[0] = buf[i];
         ESP_ERROR_CHECK(spi_device_polling_transmit(spi, &trans));
     }
     spi_device_release_bus(spi);
+    SpiManagerInst.release(spi);
     SPI_PARAM_UNLOCK();
 }
 
 void cmt_spi3_read_fifo(uint8_t* buf, const uint16_t len)
 {
     spi_transaction_t trans {
-        .flags = 0,
+        .flags = SPI_TRANS_USE_RXDATA,
         .cmd = 0,
         .addr = 0,
         .length = 0,
         .rxlength = 8,
         .user = &cs_fifo, // CS for FIFO access
-        .tx_buffer = nullptr,
-        .rx_buffer = nullptr,
     };
 
     SPI_PARAM_LOCK();
+    SpiManagerInst.acquire(spi);
     spi_device_acquire_bus(spi, portMAX_DELAY);
-    for (uint8_t i = 0; i < len; i++) {
-        trans.rx_buffer = buf + i;
+    for (uint16_t i = 0; i < len; i++) {
         ESP_ERROR_CHECK(spi_device_polling_transmit(spi, &trans));
+        buf[i] = trans.rx_data[0];
     }
     spi_device_release_bus(spi);
+    SpiManagerInst.release(spi);
     SPI_PARAM_UNLOCK();
 }
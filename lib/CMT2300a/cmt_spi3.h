@@ -12,6 +12,9 @@ void cmt_spi3_init(const int8_t pin_sdio, const int8_t pin_clk, const int8_t pin
 void cmt_spi3_write(const uint8_t addr, const uint8_t dat);
 uint8_t cmt_spi3_read(const uint8_t addr);
 
+// reads several registers while holding the bus
+void cmt_spi3_read_regs(const uint8_t* addrs, uint8_t* data, const uint8_t len);
+
 void cmt_spi3_write_fifo(const uint8_t* p_buf, const uint16_t len);
 void cmt_spi3_read_fifo(uint8_t* p_buf, const uint16_t len);
 
@@ -17,14 +17,39 @@
 #include "inverters/HM_2CH.h"
 #include "inverters/HM_4CH.h"
 #include <Arduino.h>
+#include <algorithm>
 
 HoymilesClass Hoymiles;
 
+namespace {
+
+// the sender's radio id is sent most significant byte first, it matches the
+// lower four bytes of the inverter's serial
+uint32_t getFragmentRadioId(const fragment_t& fragment)
+{
+    return (static_cast<uint32_t>(fragment.fragment[1]) << 24)
+        | (static_cast<uint32_t>(fragment.fragment[2]) << 16)
+        | (static_cast<uint32_t>(fragment.fragment[3]) << 8)
+        | static_cast<uint32_t>(fragment.fragment[4]);
+}
+
+// the radio ids of inverters of one installation are often consecutive,
+// the multiplication spreads them across the index
+size_t hashRadioId(const uint32_t radioId)
+{
+    return (radioId * 2654435761U) >> 16;
+}
+
+} // namespace
+
 void HoymilesClass::init()
 {
     _pollInterval = 0;
     _radioNrf.reset(new HoymilesRadio_NRF());
     _radioCmt.reset(new HoymilesRadio_CMT());
+#ifdef HOYMILES_SIMULATOR
+    _radioSim.reset(new HoymilesRadio_Sim());
+#endif
 }
 
 void HoymilesClass::initNRF(SPIClass* initialisedSpiBus, const uint8_t pinCE, const uint8_t pinIRQ)
@@ -37,33 +62,34 @@ void HoymilesClass::initCMT(const int8_t pin_sdio, const int8_t pin_clk, const i
     _radioCmt->init(pin_sdio, pin_clk, pin_cs, pin_fcs, pin_gpio2, pin_gpio3);
 }
 
+#ifdef HOYMILES_SIMULATOR
+void HoymilesClass::initSimulator()
+{
+    _radioSim->init();
+}
+#endif
+
 void HoymilesClass::loop()
 {
+    // the radios are serviced by their own tasks
     std::lock_guard<std::mutex> lock(_mutex);
-    _radioNrf->loop();
-    _radioCmt->loop();
 
     if (getNumInverters() == 0) {
         return;
     }
 
     if (millis() - _lastPoll > _pollInterval) {
-        static uint8_t inverterPos = 0;
-
-        std::shared_ptr<InverterAbstract> iv = getInverterByPos(inverterPos);
-        if ((iv == nullptr) || ((iv != nullptr) && (!iv->getRadio()->isInitialized()))) {
-            if (++inverterPos >= getNumInverters()) {
-                inverterPos = 0;
-            }
-        }
+        std::shared_ptr<InverterAbstract> iv = getNextInverterToPoll();
 
-        if (iv != nullptr && iv->getRadio()->isInitialized()) {
+        if (iv != nullptr) {
+            const bool poll = iv->getEnablePolling() || iv->getEnableCommands();
+            iv->setLastPoll(millis(), poll);
 
             if (iv->getZeroValuesIfUnreachable() && !iv->isReachable()) {
                 iv->Statistics()->zeroRuntimeData();
             }
 
-            if (iv->getEnablePolling() || iv->getEnableCommands()) {
+            if (poll) {
                 _messageOutput->print("Fetch inverter: ");
                 _messageOutput->println(iv->serial(), HEX);
 
@@ -77,8 +103,12 @@ void HoymilesClass::loop()
                 const bool force = iv->EventLog()->getLastAlarmRequestSuccess() == CMD_NOK;
                 iv->sendAlarmLogRequest(force);
 
-                // Fetch limit
-                if (((millis() - iv->SystemConfigPara()->getLastUpdateRequest() > HOY_SYSTEM_CONFIG_PARA_POLL_INTERVAL)
+                // Fetch limit. it is tracked from the acknowledged limit
+                // commands and only read back frequently if it is uncertain.
+                checkLimitConfirmed(iv);
+                const uint32_t limitPollInterval = iv->SystemConfigPara()->getLimitConfirmed()
+                    ? HOY_SYSTEM_CONFIG_PARA_REFRESH_INTERVAL : HOY_SYSTEM_CONFIG_PARA_POLL_INTERVAL;
+                if (((millis() - iv->SystemConfigPara()->getLastUpdateRequest() > limitPollInterval)
                         && (millis() - iv->SystemConfigPara()->getLastUpdateCommand() > HOY_SYSTEM_CONFIG_PARA_POLL_MIN_DURATION))) {
                     _messageOutput->println("Request SystemConfigPara");
                     iv->sendSystemConfigParaRequest();
@@ -122,10 +152,6 @@ void HoymilesClass::loop()
                  _messageOutput->printf("Queue size - NRF: %" PRId32 " CMT: %" PRId32 "\r\n", _radioNrf->getQueueSize(), _radioCmt->getQueueSize());
                 _lastPoll = millis();
             }
-
-            if (++inverterPos >= getNumInverters()) {
-                inverterPos = 0;
-            }
         }
 
         // Perform housekeeping of all inverters on day change
@@ -146,39 +172,131 @@ void HoymilesClass::loop()
     }
 }
 
+uint32_t HoymilesClass::getTargetPollInterval(InverterAbstract& iv) const
+{
+    // by default, each inverter is polled once per round
+    // through all inverters, just like with round-robin.
+    uint32_t interval = _pollInterval;
+    if (!iv.getHighPollPriority()) {
+        interval *= getNumInverters() * _idlePollFactor;
+    }
+
+    // back off exponentially while the inverter does not answer
+    if (iv.getEnablePolling() && !iv.isReachable()) {
+        const uint32_t failures = iv.Statistics()->getRxFailureCount() - iv.getReachableThreshold();
+        interval <<= std::min<uint32_t>(failures, 4);
+    }
+
+    return interval;
+}
+
+// the limit known from acknowledged commands becomes uncertain if the
+// inverter might have rebooted, which resets a non-persistent limit, or if
+// it produces more power than the limit allows, i.e., if the limit was
+// changed by someone else.
+void HoymilesClass::checkLimitConfirmed(std::shared_ptr<InverterAbstract> iv)
+{
+    auto systemConfigPara = iv->SystemConfigPara();
+    if (!systemConfigPara->getLimitConfirmed()) {
+        return;
+    }
+
+    if (!iv->isReachable()) {
+        systemConfigPara->setLimitConfirmed(false);
+        return;
+    }
+
+    const uint16_t maxPower = iv->DevInfo()->getMaxPower();
+    if (maxPower == 0 || !iv->Statistics()->hasChannelFieldValue(TYPE_AC, CH0, FLD_PAC)) {
+        return;
+    }
+
+    const float limitWatts = systemConfigPara->getLimitPercent() * maxPower / 100;
+    const float acPower = iv->Statistics()->getChannelFieldValue(TYPE_AC, CH0, FLD_PAC);
+    if (acPower > limitWatts * 1.1f + 10) {
+        _messageOutput->printf("AC power %.0f W exceeds the limit of %.0f W, reading back the limit\r\n",
+            acPower, limitWatts);
+        systemConfigPara->setLimitConfirmed(false);
+    }
+}
+
+// selects the inverter which is overdue the longest (earliest deadline first)
+std::shared_ptr<InverterAbstract> HoymilesClass::getNextInverterToPoll()
+{
+    std::shared_ptr<InverterAbstract> next = nullptr;
+    uint32_t maxOverdue = 0;
+
+    for (auto& inv : _inverters) {
+        if (!inv->getRadio()->isInitialized()) {
+            continue;
+        }
+
+        const uint32_t elapsed = millis() - inv->getLastPoll();
+        const uint32_t interval = getTargetPollInterval(*inv);
+        if (elapsed < interval) {
+            continue;
+        }
+
+        const uint32_t overdue = elapsed - interval;
+        if (next == nullptr || overdue > maxOverdue) {
+            next = inv;
+            maxOverdue = overdue;
+        }
+    }
+
+    return next;
+}
+
 std::shared_ptr<InverterAbstract> HoymilesClass::addInverter(const char* name, const uint64_t serial)
 {
+    HoymilesRadio* radioNrf = _radioNrf.get();
+    HoymilesRadio* radioCmt = _radioCmt.get();
+#ifdef HOYMILES_SIMULATOR
+    if (_radioSim->isInitialized()) {
+        radioNrf = _radioSim.get();
+        radioCmt = _radioSim.get();
+    }
+#endif
+
     std::shared_ptr<InverterAbstract> i = nullptr;
     if (HMT_4CH::isValidSerial(serial)) {
-        i = std::make_shared<HMT_4CH>(_radioCmt.get(), serial);
+        i = std::make_shared<HMT_4CH>(radioCmt, serial);
     } else if (HMT_6CH::isValidSerial(serial)) {
-        i = std::make_shared<HMT_6CH>(_radioCmt.get(), serial);
+        i = std::make_shared<HMT_6CH>(radioCmt, serial);
     } else if (HMS_4CH::isValidSerial(serial)) {
-        i = std::make_shared<HMS_4CH>(_radioCmt.get(), serial);
+        i = std::make_shared<HMS_4CH>(radioCmt, serial);
     } else if (HMS_2CH::isValidSerial(serial)) {
-        i = std::make_shared<HMS_2CH>(_radioCmt.get(), serial);
+        i = std::make_shared<HMS_2CH>(radioCmt, serial);
     } else if (HMS_1CH::isValidSerial(serial)) {
-        i = std::make_shared<HMS_1CH>(_radioCmt.get(), serial);
+        i = std::make_shared<HMS_1CH>(radioCmt, serial);
     } else if (HMS_1CHv2::isValidSerial(serial)) {
-        i = std::make_shared<HMS_1CHv2>(_radioCmt.get(), serial);
+        i = std::make_shared<HMS_1CHv2>(radioCmt, serial);
     } else if (HM_4CH::isValidSerial(serial)) {
-        i = std::make_shared<HM_4CH>(_radioNrf.get(), serial);
+        i = std::make_shared<HM_4CH>(radioNrf, serial);
     } else if (HM_2CH::isValidSerial(serial)) {
-        i = std::make_shared<HM_2CH>(_radioNrf.get(), serial);
+        i = std::make_shared<HM_2CH>(radioNrf, serial);
     } else if (HM_1CH::isValidSerial(serial)) {
-        i = std::make_shared<HM_1CH>(_radioNrf.get(), serial);
+        i = std::make_shared<HM_1CH>(radioNrf, serial);
     } else if (HERF_1CH::isValidSerial(serial)) {
-        i = std::make_shared<HERF_1CH>(_radioNrf.get(), serial);
+        i = std::make_shared<HERF_1CH>(radioNrf, serial);
     } else if (HERF_2CH::isValidSerial(serial)) {
-        i = std::make_shared<HERF_2CH>(_radioNrf.get(), serial);
+        i = std::make_shared<HERF_2CH>(radioNrf, serial);
     } else if (HERF_4CH::isValidSerial(serial)) {
-        i = std::make_shared<HERF_4CH>(_radioNrf.get(), serial);
+        i = std::make_shared<HERF_4CH>(radioNrf, serial);
     }
 
     if (i) {
         i->setName(name);
         i->init();
+
+        // the radio tasks iterate the inverter list
+        auto nrfLock = _radioNrf->lockRadio();
+        auto cmtLock = _radioCmt->lockRadio();
+#ifdef HOYMILES_SIMULATOR
+        auto simLock = _radioSim->lockRadio();
+#endif
         _inverters.push_back(std::move(i));
+        rebuildInverterIndex();
         return _inverters.back();
     }
 
@@ -196,12 +314,8 @@ std::shared_ptr<InverterAbstract> HoymilesClass::getInverterByPos(const uint8_t
 
 std::shared_ptr<InverterAbstract> HoymilesClass::getInverterBySerial(const uint64_t serial)
 {
-    for (auto& inv : _inverters) {
-        if (inv->serial() == serial) {
-            return inv;
-        }
-    }
-    return nullptr;
+    const int16_t pos = findInverterPos(static_cast<uint32_t>(serial), &serial);
+    return pos < 0 ? nullptr : _inverters[pos];
 }
 
 std::shared_ptr<InverterAbstract> HoymilesClass::getInverterByFragment(const fragment_t& fragment)
@@ -210,31 +324,83 @@ std::shared_ptr<InverterAbstract> HoymilesClass::getInverterByFragment(const fra
         return nullptr;
     }
 
-    for (auto& inv : _inverters) {
-        serial_u p;
-        p.u64 = inv->serial();
+    const int16_t pos = findInverterPos(getFragmentRadioId(fragment), nullptr);
+    return pos < 0 ? nullptr : _inverters[pos];
+}
 
-        if ((p.b[3] == fragment.fragment[1])
-            && (p.b[2] == fragment.fragment[2])
-            && (p.b[1] == fragment.fragment[3])
-            && (p.b[0] == fragment.fragment[4])) {
+InverterAbstract* HoymilesClass::findInverterBySerial(const uint64_t serial) const
+{
+    const int16_t pos = findInverterPos(static_cast<uint32_t>(serial), &serial);
+    return pos < 0 ? nullptr : _inverters[pos].get();
+}
+
+InverterAbstract* HoymilesClass::findInverterByFragment(const fragment_t& fragment) const
+{
+    if (fragment.len <= 4) {
+        return nullptr;
+    }
 
-            return inv;
+    const int16_t pos = findInverterPos(getFragmentRadioId(fragment), nullptr);
+    return pos < 0 ? nullptr : _inverters[pos].get();
+}
+
+int16_t HoymilesClass::findInverterPos(const uint32_t radioId, const uint64_t* serial) const
+{
+    if (_inverterIndex.empty()) {
+        return -1;
+    }
+
+    // inverters sharing a radio id, which only differ in the upper bytes of
+    // their serial, follow each other in the probe sequence
+    const size_t mask = _inverterIndex.size() - 1;
+    for (size_t i = hashRadioId(radioId) & mask;; i = (i + 1) & mask) {
+        const IndexSlot& slot = _inverterIndex[i];
+        if (slot.Pos == INDEX_EMPTY) {
+            return -1;
+        }
+        if (slot.RadioId == radioId
+            && (serial == nullptr || _inverters[slot.Pos]->serial() == *serial)) {
+            return slot.Pos;
         }
     }
-    return nullptr;
 }
 
-void HoymilesClass::removeInverterBySerial(const uint64_t serial)
+void HoymilesClass::rebuildInverterIndex()
 {
-    for (uint8_t i = 0; i < _inverters.size(); i++) {
-        if (_inverters[i]->serial() == serial) {
-            std::lock_guard<std::mutex> lock(_mutex);
-            _inverters[i]->getRadio()->removeCommands(_inverters[i].get());
-            _inverters.erase(_inverters.begin() + i);
-            return;
+    // at most half of the slots are used, which keeps the probe sequences short
+    size_t size = 8;
+    while (size < _inverters.size() * 2) {
+        size *= 2;
+    }
+
+    _inverterIndex.assign(size, { 0, INDEX_EMPTY });
+
+    for (uint8_t pos = 0; pos < _inverters.size(); pos++) {
+        const uint32_t radioId = static_cast<uint32_t>(_inverters[pos]->serial());
+        size_t i = hashRadioId(radioId) & (size - 1);
+        while (_inverterIndex[i].Pos != INDEX_EMPTY) {
+            i = (i + 1) & (size - 1);
         }
+        _inverterIndex[i] = { radioId, pos };
+    }
+}
+
+void HoymilesClass::removeInverterBySerial(const uint64_t serial)
+{
+    const int16_t pos = findInverterPos(static_cast<uint32_t>(serial), &serial);
+    if (pos < 0) {
+        return;
     }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto nrfLock = _radioNrf->lockRadio();
+    auto cmtLock = _radioCmt->lockRadio();
+#ifdef HOYMILES_SIMULATOR
+    auto simLock = _radioSim->lockRadio();
+#endif
+    _inverters[pos]->getRadio()->removeCommands(_inverters[pos].get());
+    _inverters.erase(_inverters.begin() + pos);
+    rebuildInverterIndex();
 }
 
 size_t HoymilesClass::getNumInverters() const
@@ -254,6 +420,11 @@ HoymilesRadio_CMT* HoymilesClass::getRadioCmt()
 
 bool HoymilesClass::isAllRadioIdle() const
 {
+#ifdef HOYMILES_SIMULATOR
+    if (!_radioSim->isIdle()) {
+        return false;
+    }
+#endif
     return _radioNrf.get()->isIdle() && _radioCmt.get()->isIdle();
 }
 
@@ -267,6 +438,11 @@ void HoymilesClass::setPollInterval(const uint32_t interval)
     _pollInterval = interval;
 }
 
+void HoymilesClass::setIdlePollFactor(const uint8_t factor)
+{
+    _idlePollFactor = std::max<uint8_t>(factor, 1);
+}
+
 void HoymilesClass::setVerboseLogging(bool verboseLogging)
 {
     _verboseLogging = verboseLogging;
@@ -282,6 +458,30 @@ Print* HoymilesClass::getMessageOutput()
     return _messageOutput;
 }
 
+void HoymilesClass::addStatisticsUpdateCallback(StatisticsUpdateCallback callback)
+{
+    _statisticsUpdateCallbacks.push_back(callback);
+}
+
+void HoymilesClass::notifyStatisticsUpdate()
+{
+    for (auto const& callback : _statisticsUpdateCallbacks) {
+        callback();
+    }
+}
+
+void HoymilesClass::setFragmentCallback(FragmentCallback callback)
+{
+    _fragmentCallback = callback;
+}
+
+void HoymilesClass::notifyFragment(uint8_t radio, const fragment_t& fragment)
+{
+    if (_fragmentCallback) {
+        _fragmentCallback(radio, fragment);
+    }
+}
+
 class Silent : public Print {
     public:
         size_t write(uint8_t c) final { return 0; }
@@ -3,14 +3,19 @@
 
 #include "HoymilesRadio_CMT.h"
 #include "HoymilesRadio_NRF.h"
+#ifdef HOYMILES_SIMULATOR
+#include "HoymilesRadio_Sim.h"
+#endif
 #include "inverters/InverterAbstract.h"
 #include "types.h"
 #include <Print.h>
 #include <SPI.h>
+#include <functional>
 #include <memory>
 #include <vector>
 
-#define HOY_SYSTEM_CONFIG_PARA_POLL_INTERVAL (2 * 60 * 1000) // 2 minutes
+#define HOY_SYSTEM_CONFIG_PARA_POLL_INTERVAL (2 * 60 * 1000) // 2 minutes, while the limit is uncertain
+#define HOY_SYSTEM_CONFIG_PARA_REFRESH_INTERVAL (30 * 60 * 1000) // 30 minutes, while the limit is confirmed
 #define HOY_SYSTEM_CONFIG_PARA_POLL_MIN_DURATION (4 * 60 * 1000) // at least 4 minutes between sending limit command and read request. Otherwise eventlog entry
 
 class HoymilesClass {
@@ -18,16 +23,38 @@ public:
     void init();
     void initNRF(SPIClass* initialisedSpiBus, const uint8_t pinCE, const uint8_t pinIRQ);
     void initCMT(const int8_t pin_sdio, const int8_t pin_clk, const int8_t pin_cs, const int8_t pin_fcs, const int8_t pin_gpio2, const int8_t pin_gpio3);
+#ifdef HOYMILES_SIMULATOR
+    // all inverters added afterwards are simulated, see HoymilesRadio_Sim
+    void initSimulator();
+#endif
     void loop();
 
     void setMessageOutput(Print* output);
     Print* getMessageOutput();
     Print* getVerboseMessageOutput();
 
+    // the callbacks are invoked from the context that processed the inverter's
+    // response, whenever new statistics data was received from an inverter.
+    // callbacks must be added during initialization.
+    using StatisticsUpdateCallback = std::function<void()>;
+    void addStatisticsUpdateCallback(StatisticsUpdateCallback callback);
+    void notifyStatisticsUpdate();
+
+    // invoked from the radio's loop for every valid fragment addressed to a
+    // known inverter, e.g., to record the received data. the radio is 0 for
+    // the NRF and 1 for the CMT module. must be set during initialization.
+    using FragmentCallback = std::function<void(uint8_t radio, const fragment_t& fragment)>;
+    void setFragmentCallback(FragmentCallback callback);
+    void notifyFragment(uint8_t radio, const fragment_t& fragment);
+
     std::shared_ptr<InverterAbstract> addInverter(const char* name, const uint64_t serial);
     std::shared_ptr<InverterAbstract> getInverterByPos(const uint8_t pos);
     std::shared_ptr<InverterAbstract> getInverterBySerial(const uint64_t serial);
     std::shared_ptr<InverterAbstract> getInverterByFragment(const fragment_t& fragment);
+    // the same lookups without taking a reference, for the radio tasks. these
+    // hold their radio's lock, which keeps the inverter list from changing.
+    InverterAbstract* findInverterBySerial(const uint64_t serial) const;
+    InverterAbstract* findInverterByFragment(const fragment_t& fragment) const;
     void removeInverterBySerial(const uint64_t serial);
     size_t getNumInverters() const;
 
@@ -36,22 +63,51 @@ public:
 
     uint32_t PollInterval() const;
     void setPollInterval(const uint32_t interval);
+    // inverters without high poll priority are polled this many times
+    // less often, e.g., to save power
+    void setIdlePollFactor(const uint8_t factor);
     void setVerboseLogging(bool verboseLogging);
 
     bool isAllRadioIdle() const;
 
+    // the interval the scheduler aims for when polling the given inverter
+    uint32_t getTargetPollInterval(InverterAbstract& iv) const;
+
 private:
+    std::shared_ptr<InverterAbstract> getNextInverterToPoll();
+    void checkLimitConfirmed(std::shared_ptr<InverterAbstract> iv);
+
+    static constexpr uint8_t INDEX_EMPTY = 0xff;
+    int16_t findInverterPos(const uint32_t radioId, const uint64_t* serial) const;
+    void rebuildInverterIndex();
+
     std::vector<std::shared_ptr<InverterAbstract>> _inverters;
+
+    // open addressing table, which maps the radio id of an inverter, i.e.,
+    // the lower four bytes of its serial, to its position in _inverters. it
+    // is rebuilt whenever an inverter is added or removed.
+    struct IndexSlot {
+        uint32_t RadioId;
+        uint8_t Pos;
+    };
+    std::vector<IndexSlot> _inverterIndex;
     std::unique_ptr<HoymilesRadio_NRF> _radioNrf;
     std::unique_ptr<HoymilesRadio_CMT> _radioCmt;
+#ifdef HOYMILES_SIMULATOR
+    std::unique_ptr<HoymilesRadio_Sim> _radioSim;
+#endif
 
     std::mutex _mutex;
 
     uint32_t _pollInterval = 0;
+    uint8_t _idlePollFactor = 1;
     bool _verboseLogging = true;
     uint32_t _lastPoll = 0;
 
     Print* _messageOutput = &Serial;
+
+    std::vector<StatisticsUpdateCallback> _statisticsUpdateCallbacks;
+    FragmentCallback _fragmentCallback;
 };
 
 extern HoymilesClass Hoymiles;
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include "Hoymiles.h"
 #include "crc.h"
 
+CommandPool HoymilesRadio::_commandPool;
+
 serial_u HoymilesRadio::DtuSerial() const
 {
     return _dtuSerial;
@@ -30,10 +32,41 @@ serial_u HoymilesRadio::convertSerialToRadioId(const serial_u serial)
 
 bool HoymilesRadio::checkFragmentCrc(const fragment_t& fragment) const
 {
+    // the slot is not cleared before reading the FIFO into it, so only
+    // the received bytes may be looked at
+    if (fragment.len == 0) {
+        return false;
+    }
+
     const uint8_t crc = crc8(fragment.fragment, fragment.len - 1);
     return (crc == fragment.fragment[fragment.len - 1]);
 }
 
+uint32_t HoymilesRadio::getRxTimeout(const CommandAbstract& cmd) const
+{
+    auto inv = Hoymiles.findInverterBySerial(cmd.getTargetAddress());
+    if (nullptr == inv) {
+        return cmd.getTimeout();
+    }
+    return inv->RxTimeouts.getTimeout(cmd);
+}
+
+void HoymilesRadio::checkRxPeriodComplete(const InverterAbstract& inv)
+{
+    if (!_busyFlag || isQueueEmpty()) {
+        return;
+    }
+
+    // late fragments of another inverter do not end the RX period
+    if (_commandQueue.front()->getTargetAddress() != inv.serial()) {
+        return;
+    }
+
+    if (inv.isRxPeriodComplete()) {
+        _rxTimeout.set(0);
+    }
+}
+
 void HoymilesRadio::sendRetransmitPacket(const uint8_t fragment_id)
 {
     CommandAbstract* cmd = _commandQueue.front().get();
@@ -41,6 +74,7 @@ void HoymilesRadio::sendRetransmitPacket(const uint8_t fragment_id)
     CommandAbstract* requestCmd = cmd->getRequestFrameCommand(fragment_id);
 
     if (requestCmd != nullptr) {
+        _retransmitted = true;
         sendEsbPacket(*requestCmd);
     }
 }
@@ -53,13 +87,22 @@ void HoymilesRadio::sendLastPacketAgain()
 
 void HoymilesRadio::handleReceivedPackage()
 {
-    if (_busyFlag && _rxTimeout.occured()) {
+    // fragments received in time but not parsed yet still count
+    if (_busyFlag && _rxTimeout.occured() && _rxBuffer.empty()) {
         Hoymiles.getVerboseMessageOutput()->println("RX Period End");
-        std::shared_ptr<InverterAbstract> inv = Hoymiles.getInverterBySerial(_commandQueue.front().get()->getTargetAddress());
+        InverterAbstract* inv = Hoymiles.findInverterBySerial(_commandQueue.front().get()->getTargetAddress());
 
         if (nullptr != inv) {
             CommandAbstract* cmd = _commandQueue.front().get();
             uint8_t verifyResult = inv->verifyAllFragments(*cmd);
+            updateLinkQuality(*inv, verifyResult != FRAGMENT_ALL_MISSING_RESEND
+                    && verifyResult != FRAGMENT_ALL_MISSING_TIMEOUT);
+
+            // the inverter did not answer completely in time
+            if (verifyResult != FRAGMENT_OK && verifyResult != FRAGMENT_HANDLE_ERROR) {
+                inv->RxTimeouts.backoff(*cmd);
+            }
+
             if (verifyResult == FRAGMENT_ALL_MISSING_RESEND) {
                 Hoymiles.getMessageOutput()->println("Nothing received, resend whole request");
                 sendLastPacketAgain();
@@ -71,6 +114,7 @@ void HoymilesRadio::handleReceivedPackage()
                     inv->RadioStats.RxFailNoAnswer++;
                 }
 
+                inv->Transactions.record(*cmd, inv->getFirstRxFragmentMillis(), std::nullopt);
                 _commandQueue.pop();
                 _busyFlag = false;
 
@@ -81,6 +125,7 @@ void HoymilesRadio::handleReceivedPackage()
                     inv->RadioStats.RxFailPartialAnswer++;
                 }
 
+                inv->Transactions.record(*cmd, inv->getFirstRxFragmentMillis(), std::nullopt);
                 _commandQueue.pop();
                 _busyFlag = false;
 
@@ -91,6 +136,7 @@ void HoymilesRadio::handleReceivedPackage()
                     inv->RadioStats.RxFailCorruptData++;
                 }
 
+                inv->Transactions.record(*cmd, inv->getFirstRxFragmentMillis(), std::nullopt);
                 _commandQueue.pop();
                 _busyFlag = false;
 
@@ -111,6 +157,11 @@ void HoymilesRadio::handleReceivedPackage()
                     inv->RadioStats.RxSuccess++;
                 }
 
+                inv->Transactions.record(*cmd, inv->getFirstRxFragmentMillis(), inv->getLastRxFragmentMillis());
+                auto completedAt = inv->getLastRxFragmentMillis();
+                if (completedAt && cmd->getSendCount() == 1 && !_retransmitted) {
+                    inv->RxTimeouts.addSample(*cmd, *completedAt - cmd->getSentAt());
+                }
                 _commandQueue.pop();
                 _busyFlag = false;
             }
@@ -122,17 +173,28 @@ void HoymilesRadio::handleReceivedPackage()
             _busyFlag = false;
         }
     } else if (!_busyFlag) {
+        if (resumeParkedCommand()) {
+            return;
+        }
+
         // Currently in idle mode --> send packet if one is in the queue
         if (!isQueueEmpty()) {
             CommandAbstract* cmd = _commandQueue.front().get();
+            if (!mayDispatchWhileParked(*cmd)) {
+                return;
+            }
 
-            auto inv = Hoymiles.getInverterBySerial(cmd->getTargetAddress());
+            auto inv = Hoymiles.findInverterBySerial(cmd->getTargetAddress());
             if (nullptr != inv) {
                 inv->clearRxFragmentBuffer();
                 // Statistics: TX Requests
                 inv->RadioStats.TxRequestData++;
 
+                cmd->setSentAt(millis());
+                _retransmitted = false;
+                _commandQueue.commandDispatched(*cmd);
                 sendEsbPacket(*cmd);
+                parkCommand(*cmd);
             } else {
                 Hoymiles.getMessageOutput()->println("TX: Invalid inverter found");
                 _commandQueue.pop();
@@ -141,6 +203,78 @@ void HoymilesRadio::handleReceivedPackage()
     }
 }
 
+void HoymilesRadio::parkCommand(CommandAbstract& cmd)
+{
+    if (!supportsInterleaving() || !cmd.allowsInterleaving() || _parkedCmd != nullptr) {
+        return;
+    }
+
+    // only inverters known to take their time are left alone meanwhile
+    auto inv = Hoymiles.findInverterBySerial(cmd.getTargetAddress());
+    if (nullptr == inv) {
+        return;
+    }
+    const auto earliestAnswer = inv->RxTimeouts.getEarliestAnswer(cmd);
+    if (!earliestAnswer) {
+        return;
+    }
+
+    auto parked = _commandQueue.pop();
+    if (!parked) {
+        return;
+    }
+
+    Hoymiles.getVerboseMessageOutput()->printf("Waiting for %s in background\r\n", cmd.getCommandName().c_str());
+    _parkedCmd = std::move(*parked);
+    _parkedAnswerAt = cmd.getSentAt() + *earliestAnswer;
+    _parkedUntil = cmd.getSentAt() + getRxTimeout(cmd);
+    _parked = true;
+    _busyFlag = false;
+}
+
+bool HoymilesRadio::resumeParkedCommand()
+{
+    if (_parkedCmd == nullptr) {
+        return false;
+    }
+
+    auto inv = Hoymiles.findInverterBySerial(_parkedCmd->getTargetAddress());
+    const bool timedOut = static_cast<int32_t>(millis() - _parkedUntil) >= 0;
+    if (nullptr != inv && !timedOut && !inv->isRxPeriodComplete()) {
+        return false;
+    }
+
+    // the RX period of the command ends now, as if it was in progress all
+    // the time. its fragments were collected by the inverter meanwhile.
+    if (!_commandQueue.pushFront(std::move(_parkedCmd))) {
+        Hoymiles.getMessageOutput()->println("Command queue full, parked command dropped");
+    } else {
+        _retransmitted = false;
+        _busyFlag = true;
+        _rxTimeout.set(0);
+    }
+
+    _parkedCmd.reset();
+    _parked = false;
+    return true;
+}
+
+bool HoymilesRadio::mayDispatchWhileParked(const CommandAbstract& cmd) const
+{
+    if (_parkedCmd == nullptr) {
+        return true;
+    }
+
+    // the parked inverter's fragment buffer must stay untouched, and the
+    // command must be done before the parked inverter is expected to answer
+    if (cmd.getTargetAddress() == _parkedCmd->getTargetAddress()) {
+        return false;
+    }
+
+    const int32_t remaining = static_cast<int32_t>(_parkedAnswerAt - millis());
+    return remaining > 0 && static_cast<uint32_t>(remaining) > getRxTimeout(cmd);
+}
+
 void HoymilesRadio::dumpBuf(const uint8_t buf[], const uint8_t len, const bool appendNewline)
 {
     for (uint8_t i = 0; i < len; i++) {
@@ -158,6 +292,10 @@ bool HoymilesRadio::isInitialized() const
 
 void HoymilesRadio::removeCommands(InverterAbstract* inv)
 {
+    if (_parkedCmd != nullptr && _parkedCmd->getTargetAddress() == inv->serial()) {
+        _parkedCmd.reset();
+        _parked = false;
+    }
     _commandQueue.removeAllEntriesForInverter(inv);
 }
 
@@ -166,9 +304,67 @@ uint8_t HoymilesRadio::countSimilarCommands(std::shared_ptr<CommandAbstract> cmd
     return _commandQueue.countSimilarCommands(cmd);
 }
 
+std::unique_lock<std::mutex> HoymilesRadio::lockRadio()
+{
+    return std::unique_lock<std::mutex>(_radioMutex);
+}
+
+void HoymilesRadio::startTask(const char* name)
+{
+    if (_taskHandle != nullptr) {
+        return;
+    }
+
+    // the task is pinned to the core which is initializing the radio
+    uint32_t constexpr stackSize = 4096;
+    xTaskCreatePinnedToCore(HoymilesRadio::taskLoopHelper, name,
+        stackSize, this, 2 /*prio*/, &_taskHandle, xPortGetCoreID());
+}
+
+void HoymilesRadio::taskLoopHelper(void* context)
+{
+    static_cast<HoymilesRadio*>(context)->taskLoop();
+}
+
+void HoymilesRadio::taskLoop()
+{
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(_radioMutex);
+            loop();
+        }
+
+        // keep going while received fragments are pending. otherwise sleep
+        // until the next interrupt or enqueued command, but only for a tick,
+        // as timeouts and channel hopping need regular attention.
+        const bool pending = _packetReceived || !_rxBuffer.empty();
+        ulTaskNotifyTake(pdTRUE, pending ? 0 : pdMS_TO_TICKS(1));
+    }
+}
+
+void HoymilesRadio::notifyTask()
+{
+    if (_taskHandle != nullptr) {
+        xTaskNotifyGive(_taskHandle);
+    }
+}
+
+void ARDUINO_ISR_ATTR HoymilesRadio::notifyTaskFromIsr()
+{
+    if (_taskHandle == nullptr) {
+        return;
+    }
+
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    vTaskNotifyGiveFromISR(_taskHandle, &higherPriorityTaskWoken);
+    if (higherPriorityTaskWoken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
 bool HoymilesRadio::isIdle() const
 {
-    return !_busyFlag;
+    return !_busyFlag && !_parked;
 }
 
 bool HoymilesRadio::isQueueEmpty() const
@@ -180,3 +376,8 @@ uint32_t HoymilesRadio::getQueueSize() const
 {
     return _commandQueue.size();
 }
+
+CommandQueueLatency HoymilesRadio::getQueueLatency(const CommandPriority priority) const
+{
+    return _commandQueue.getLatency(priority);
+}
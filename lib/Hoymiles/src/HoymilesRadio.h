@@ -3,9 +3,17 @@
 
 #include "Arduino.h"
 #include "commands/CommandAbstract.h"
+#include "queue/CommandPool.h"
 #include "queue/CommandQueue.h"
+#include "queue/FragmentQueue.h"
 #include "types.h"
 #include <TimeoutHelper.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+// number of fragments hold in buffer
+#define FRAGMENT_BUFFER_SIZE 30
 
 #ifdef HOY_DEBUG_QUEUE
 #define DEBUG_PRINT(fmt, args...) Serial.printf(fmt, ##args)
@@ -21,15 +29,21 @@ public:
     bool isIdle() const;
     bool isQueueEmpty() const;
     uint32_t getQueueSize() const;
+    CommandQueueLatency getQueueLatency(const CommandPriority priority) const;
     bool isInitialized() const;
 
     void removeCommands(InverterAbstract* inv);
     uint8_t countSimilarCommands(std::shared_ptr<CommandAbstract> cmd);
 
+    // the radio is serviced by its own task. while the returned lock is
+    // held, the task is blocked and does not access any inverter.
+    std::unique_lock<std::mutex> lockRadio();
+
     void enqueCommand(std::shared_ptr<CommandAbstract> cmd)
     {
         DEBUG_PRINT("Queue size before: %ld\r\n", _commandQueue.size());
         DEBUG_PRINT("Handling command %s with type %d\r\n", cmd.get()->getCommandName().c_str(), static_cast<uint8_t>(cmd.get()->getQueueInsertType()));
+        cmd->cacheSimilarityKey();
         switch (cmd.get()->getQueueInsertType()) {
         case QueueInsertType::RemoveOldest:
             _commandQueue.removeDuplicatedEntries(cmd);
@@ -59,7 +73,10 @@ public:
 
         // Push the command into the queue if we reach this position of the code
         DEBUG_PRINT("    ... new entry will be appended\r\n");
-        _commandQueue.push(cmd);
+        if (!_commandQueue.push(cmd)) {
+            DEBUG_PRINT("    ... queue is full, new entry was dropped\r\n");
+        }
+        notifyTask();
 
         DEBUG_PRINT("Queue size after: %ld\r\n", _commandQueue.size());
     }
@@ -67,23 +84,71 @@ public:
     template <typename T>
     std::shared_ptr<T> prepareCommand(InverterAbstract* inv)
     {
-        return std::make_shared<T>(inv);
+        return std::allocate_shared<T>(CommandPoolAllocator<T>(_commandPool), inv);
     }
 
 protected:
+    // called by the radio task, which holds _radioMutex while doing so
+    virtual void loop() = 0;
+
+    void startTask(const char* name);
+    void notifyTask();
+    void ARDUINO_ISR_ATTR notifyTaskFromIsr();
+
     static serial_u convertSerialToRadioId(const serial_u serial);
     static void dumpBuf(const uint8_t buf[], const uint8_t len, const bool appendNewline = true);
 
     bool checkFragmentCrc(const fragment_t& fragment) const;
     virtual void sendEsbPacket(CommandAbstract& cmd) = 0;
+    // called at the end of each RX period, telling whether the inverter
+    // answered the last transmission at all
+    virtual void updateLinkQuality(InverterAbstract& inv, const bool answered) { }
+    // the RX timeout of the inverter for the command, adapted to the
+    // round-trip times measured before
+    uint32_t getRxTimeout(const CommandAbstract& cmd) const;
+    // to be called after a fragment was added to the inverter. ends the RX
+    // period early if the inverter sent everything that was asked for.
+    void checkRxPeriodComplete(const InverterAbstract& inv);
     void sendRetransmitPacket(const uint8_t fragment_id);
     void sendLastPacketAgain();
     void handleReceivedPackage();
 
+    // whether the radio listens to all inverters at once, such that it may
+    // send commands to other inverters while waiting for a slow answer
+    virtual bool supportsInterleaving() const { return false; }
+    void parkCommand(CommandAbstract& cmd);
+    bool resumeParkedCommand();
+    bool mayDispatchWhileParked(const CommandAbstract& cmd) const;
+
     serial_u _dtuSerial;
     CommandQueue _commandQueue;
     bool _isInitialized = false;
-    bool _busyFlag = false;
+    std::atomic<bool> _busyFlag = false;
+
+    volatile bool _packetReceived = false;
+    FragmentQueue<FRAGMENT_BUFFER_SIZE> _rxBuffer;
 
     TimeoutHelper _rxTimeout;
+
+    // whether missing fragments of the current command were re-requested
+    bool _retransmitted = false;
+
+    // a command which was sent and whose answer is expected later. it is
+    // put back in front of the queue once the answer arrived or its RX
+    // timeout occured, and is verified like the command in progress.
+    std::shared_ptr<CommandAbstract> _parkedCmd;
+    std::atomic<bool> _parked = false;
+    uint32_t _parkedAnswerAt = 0; // earliest expected answer
+    uint32_t _parkedUntil = 0; // end of its RX period
+
+    mutable std::mutex _radioMutex;
+
+private:
+    // shared by all radios, as only few commands are pending at a time
+    static CommandPool _commandPool;
+
+    static void taskLoopHelper(void* context);
+    void taskLoop();
+
+    TaskHandle_t _taskHandle = nullptr;
 };
@@ -111,6 +111,8 @@ void HoymilesRadio_CMT::init(const int8_t pin_sdio, const int8_t pin_clk, const
     }
 
     _isInitialized = true;
+
+    startTask("HoyRadioCMT");
 }
 
 void HoymilesRadio_CMT::loop()
@@ -128,19 +130,19 @@ void HoymilesRadio_CMT::loop()
     if (_packetReceived) {
         Hoymiles.getVerboseMessageOutput()->println("Interrupt received");
         while (_radio->available()) {
-            if (!(_rxBuffer.size() > FRAGMENT_BUFFER_SIZE)) {
-                fragment_t f;
-                memset(f.fragment, 0xcc, MAX_RF_PAYLOAD_SIZE);
-                f.len = _radio->getDynamicPayloadSize();
-                f.channel = _radio->getChannel();
-                f.rssi = _radio->getRssiDBm();
-                f.wasReceived = false;
-                f.mainCmd = 0x00;
-                if (f.len > MAX_RF_PAYLOAD_SIZE) {
-                    f.len = MAX_RF_PAYLOAD_SIZE;
+            fragment_t* f = _rxBuffer.push();
+            if (f != nullptr) {
+                f->len = _radio->getDynamicPayloadSize();
+                const auto status = _radio->getRxStatus();
+                f->channel = status.channel;
+                f->rssi = status.rssiDBm;
+                f->wasReceived = false;
+                f->rxMillis = millis();
+                f->mainCmd = 0x00;
+                if (f->len > MAX_RF_PAYLOAD_SIZE) {
+                    f->len = MAX_RF_PAYLOAD_SIZE;
                 }
-                _radio->read(f.fragment, f.len);
-                _rxBuffer.push(f);
+                _radio->read(f->fragment, f->len);
             } else {
                 Hoymiles.getMessageOutput()->println("CMT: Buffer full");
                 _radio->flush_rx();
@@ -152,7 +154,7 @@ void HoymilesRadio_CMT::loop()
     } else {
         // Perform package parsing only if no packages are received
         if (!_rxBuffer.empty()) {
-            fragment_t f = _rxBuffer.back();
+            const fragment_t& f = _rxBuffer.back();
             if (checkFragmentCrc(f)) {
 
                 const serial_u dtuId = convertSerialToRadioId(_dtuSerial);
@@ -161,7 +163,7 @@ void HoymilesRadio_CMT::loop()
                 // Has to be done manually here.
                 if (memcmp(&f.fragment[5], &dtuId.b[1], 4) == 0) {
 
-                    std::shared_ptr<InverterAbstract> inv = Hoymiles.getInverterByFragment(f);
+                    InverterAbstract* inv = Hoymiles.findInverterByFragment(f);
 
                     if (nullptr != inv) {
                         // Save packet in inverter rx buffer
@@ -169,7 +171,9 @@ void HoymilesRadio_CMT::loop()
                         dumpBuf(f.fragment, f.len, false);
                         Hoymiles.getVerboseMessageOutput()->printf("| %" PRId8 " dBm\r\n", f.rssi);
 
-                        inv->addRxFragment(f.fragment, f.len, f.rssi);
+                        Hoymiles.notifyFragment(1, f);
+                        inv->addRxFragment(f.fragment, f.len, f.rssi, f.rxMillis);
+                        checkRxPeriodComplete(*inv);
                     } else {
                         Hoymiles.getMessageOutput()->println("Inverter Not found!");
                     }
@@ -189,6 +193,8 @@ void HoymilesRadio_CMT::loop()
 
 void HoymilesRadio_CMT::setPALevel(const int8_t paLevel)
 {
+    std::lock_guard<std::mutex> lock(_radioMutex);
+
     if (!_isInitialized) {
         return;
     }
@@ -202,6 +208,8 @@ void HoymilesRadio_CMT::setPALevel(const int8_t paLevel)
 
 void HoymilesRadio_CMT::setInverterTargetFrequency(const uint32_t frequency)
 {
+    std::lock_guard<std::mutex> lock(_radioMutex);
+
     _inverterTargetFrequency = frequency;
     if (!_isInitialized) {
         return;
@@ -216,6 +224,8 @@ uint32_t HoymilesRadio_CMT::getInverterTargetFrequency() const
 
 bool HoymilesRadio_CMT::isConnected() const
 {
+    std::lock_guard<std::mutex> lock(_radioMutex);
+
     if (!_isInitialized) {
         return false;
     }
@@ -239,6 +249,8 @@ CountryModeId_t HoymilesRadio_CMT::getCountryMode() const
 
 void HoymilesRadio_CMT::setCountryMode(const CountryModeId_t mode)
 {
+    std::lock_guard<std::mutex> lock(_radioMutex);
+
     _countryMode = mode;
     if (!_isInitialized) {
         return;
@@ -260,6 +272,7 @@ void ARDUINO_ISR_ATTR HoymilesRadio_CMT::handleInt1()
 void ARDUINO_ISR_ATTR HoymilesRadio_CMT::handleInt2()
 {
     _packetReceived = true;
+    notifyTaskFromIsr();
 }
 
 void HoymilesRadio_CMT::sendEsbPacket(CommandAbstract& cmd)
@@ -284,5 +297,5 @@ void HoymilesRadio_CMT::sendEsbPacket(CommandAbstract& cmd)
     cmtSwitchDtuFreq(_inverterTargetFrequency);
     _radio->startListening();
     _busyFlag = true;
-    _rxTimeout.set(cmd.getTimeout());
+    _rxTimeout.set(getRxTimeout(cmd));
 }
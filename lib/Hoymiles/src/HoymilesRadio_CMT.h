@@ -7,12 +7,8 @@
 #include <Arduino.h>
 #include <cmt2300wrapper.h>
 #include <memory>
-#include <queue>
 #include <vector>
 
-// number of fragments hold in buffer
-#define FRAGMENT_BUFFER_SIZE 30
-
 #ifndef HOYMILES_CMT_WORK_FREQ
 #define HOYMILES_CMT_WORK_FREQ 865000000
 #endif
@@ -42,7 +38,6 @@ struct CountryFrequencyList_t {
 class HoymilesRadio_CMT : public HoymilesRadio {
 public:
     void init(const int8_t pin_sdio, const int8_t pin_clk, const int8_t pin_cs, const int8_t pin_fcs, const int8_t pin_gpio2, const int8_t pin_gpio3);
-    void loop();
     void setPALevel(const int8_t paLevel);
     void setInverterTargetFrequency(const uint32_t frequency);
     uint32_t getInverterTargetFrequency() const;
@@ -67,20 +62,22 @@ public:
     std::vector<CountryFrequencyList_t> getCountryFrequencyList() const;
 
 private:
+    void loop() final;
+
     void ARDUINO_ISR_ATTR handleInt1();
     void ARDUINO_ISR_ATTR handleInt2();
 
     void sendEsbPacket(CommandAbstract& cmd);
+    // all inverters answer on the same frequency
+    bool supportsInterleaving() const final { return true; }
 
     std::unique_ptr<CMT2300A> _radio;
 
-    volatile bool _packetReceived = false;
     volatile bool _packetSent = false;
 
     bool _gpio2_configured = false;
     bool _gpio3_configured = false;
 
-    std::queue<fragment_t> _rxBuffer;
     TimeoutHelper _txTimeout;
 
     uint32_t _inverterTargetFrequency = HOYMILES_CMT_WORK_FREQ;
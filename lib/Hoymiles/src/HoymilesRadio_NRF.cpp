@@ -5,8 +5,8 @@
 #include "HoymilesRadio_NRF.h"
 #include "Hoymiles.h"
 #include "commands/RequestFrameCommand.h"
-#include <Every.h>
 #include <FunctionalInterrupt.h>
+#include <algorithm>
 
 void HoymilesRadio_NRF::init(SPIClass* initialisedSpiBus, const uint8_t pinCE, const uint8_t pinIRQ)
 {
@@ -34,6 +34,21 @@ void HoymilesRadio_NRF::init(SPIClass* initialisedSpiBus, const uint8_t pinCE, c
     openReadingPipe();
     _radio->startListening();
     _isInitialized = true;
+
+    startTask("HoyRadioNRF");
+
+    // the RX channel is switched at a fixed pace, independent of how long
+    // the radio task was busy
+    const esp_timer_create_args_t timerArgs = {
+        .callback = &HoymilesRadio_NRF::onRxChannelTimer,
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "HoyNrfRxCh",
+        .skip_unhandled_events = true,
+    };
+    if (esp_timer_create(&timerArgs, &_rxChannelTimer) == ESP_OK) {
+        esp_timer_start_periodic(_rxChannelTimer, NRF_RX_CHANNEL_SWITCH_INTERVAL_US);
+    }
 }
 
 void HoymilesRadio_NRF::loop()
@@ -42,24 +57,22 @@ void HoymilesRadio_NRF::loop()
         return;
     }
 
-    EVERY_N_MILLIS(4)
-    {
+    if (_rxChannelSwitchDue.exchange(false)) {
         switchRxCh();
     }
 
     if (_packetReceived) {
         Hoymiles.getVerboseMessageOutput()->println("Interrupt received");
         while (_radio->available()) {
-            if (!(_rxBuffer.size() > FRAGMENT_BUFFER_SIZE)) {
-                fragment_t f;
-                memset(f.fragment, 0xcc, MAX_RF_PAYLOAD_SIZE);
-                f.len = _radio->getDynamicPayloadSize();
-                f.channel = _radio->getChannel();
-                f.rssi = _radio->testRPD() ? -30 : -80;
-                if (f.len > MAX_RF_PAYLOAD_SIZE)
-                    f.len = MAX_RF_PAYLOAD_SIZE;
-                _radio->read(f.fragment, f.len);
-                _rxBuffer.push(f);
+            fragment_t* f = _rxBuffer.push();
+            if (f != nullptr) {
+                f->len = _radio->getDynamicPayloadSize();
+                f->channel = _radio->getChannel();
+                f->rssi = _radio->testRPD() ? -30 : -80;
+                f->rxMillis = _irqMillis;
+                if (f->len > MAX_RF_PAYLOAD_SIZE)
+                    f->len = MAX_RF_PAYLOAD_SIZE;
+                _radio->read(f->fragment, f->len);
             } else {
                 Hoymiles.getMessageOutput()->println("NRF: Buffer full");
                 _radio->flush_rx();
@@ -70,9 +83,9 @@ void HoymilesRadio_NRF::loop()
     } else {
         // Perform package parsing only if no packages are received
         if (!_rxBuffer.empty()) {
-            fragment_t f = _rxBuffer.back();
+            const fragment_t& f = _rxBuffer.back();
             if (checkFragmentCrc(f)) {
-                std::shared_ptr<InverterAbstract> inv = Hoymiles.getInverterByFragment(f);
+                InverterAbstract* inv = Hoymiles.findInverterByFragment(f);
 
                 if (nullptr != inv) {
                     // Save packet in inverter rx buffer
@@ -80,7 +93,9 @@ void HoymilesRadio_NRF::loop()
                     dumpBuf(f.fragment, f.len, false);
                     Hoymiles.getVerboseMessageOutput()->printf("| %" PRId8 " dBm\r\n", f.rssi);
 
-                    inv->addRxFragment(f.fragment, f.len, f.rssi);
+                    Hoymiles.notifyFragment(0, f);
+                    inv->addRxFragment(f.fragment, f.len, f.rssi, f.rxMillis);
+                    checkRxPeriodComplete(*inv);
                 } else {
                     Hoymiles.getMessageOutput()->println("Inverter Not found!");
                 }
@@ -99,6 +114,8 @@ void HoymilesRadio_NRF::loop()
 
 void HoymilesRadio_NRF::setPALevel(const rf24_pa_dbm_e paLevel)
 {
+    std::lock_guard<std::mutex> lock(_radioMutex);
+
     if (!_isInitialized) {
         return;
     }
@@ -107,6 +124,8 @@ void HoymilesRadio_NRF::setPALevel(const rf24_pa_dbm_e paLevel)
 
 void HoymilesRadio_NRF::setDtuSerial(const uint64_t serial)
 {
+    std::lock_guard<std::mutex> lock(_radioMutex);
+
     HoymilesRadio::setDtuSerial(serial);
 
     if (!_isInitialized) {
@@ -117,6 +136,8 @@ void HoymilesRadio_NRF::setDtuSerial(const uint64_t serial)
 
 bool HoymilesRadio_NRF::isConnected() const
 {
+    std::lock_guard<std::mutex> lock(_radioMutex);
+
     if (!_isInitialized) {
         return false;
     }
@@ -125,6 +146,8 @@ bool HoymilesRadio_NRF::isConnected() const
 
 bool HoymilesRadio_NRF::isPVariant() const
 {
+    std::lock_guard<std::mutex> lock(_radioMutex);
+
     if (!_isInitialized) {
         return false;
     }
@@ -145,7 +168,17 @@ void HoymilesRadio_NRF::openWritingPipe(const serial_u serial)
 
 void ARDUINO_ISR_ATTR HoymilesRadio_NRF::handleIntr()
 {
+    _irqMillis = millis();
     _packetReceived = true;
+    notifyTaskFromIsr();
+}
+
+void HoymilesRadio_NRF::onRxChannelTimer(void* context)
+{
+    // runs in the esp_timer task
+    auto radio = static_cast<HoymilesRadio_NRF*>(context);
+    radio->_rxChannelSwitchDue = true;
+    radio->notifyTask();
 }
 
 uint8_t HoymilesRadio_NRF::getRxNxtChannel()
@@ -162,6 +195,35 @@ uint8_t HoymilesRadio_NRF::getTxNxtChannel()
     return _txChLst[_txChIdx];
 }
 
+uint8_t HoymilesRadio_NRF::getTxChannel(CommandAbstract& cmd)
+{
+    // a fragment re-request follows an answer on the current channel
+    if (&cmd != _commandQueue.front().get()) {
+        return _txChLst[_txChIdx];
+    }
+
+    // the request was not answered, sweep all channels
+    auto inv = Hoymiles.findInverterBySerial(cmd.getTargetAddress());
+    if (cmd.getSendCount() > 1 || inv == nullptr) {
+        return getTxNxtChannel();
+    }
+
+    // new requests start on the channel which worked best for the inverter
+    auto const& quality = inv->TxChannelQuality;
+    _txChIdx = std::max_element(quality.begin(), quality.end()) - quality.begin();
+    return _txChLst[_txChIdx];
+}
+
+void HoymilesRadio_NRF::updateLinkQuality(InverterAbstract& inv, const bool answered)
+{
+    uint8_t& quality = inv.TxChannelQuality[_txChIdx];
+    if (answered) {
+        quality += (100 - quality + 3) / 4;
+    } else {
+        quality -= (quality + 3) / 4;
+    }
+}
+
 void HoymilesRadio_NRF::switchRxCh()
 {
     _radio->stopListening();
@@ -176,7 +238,7 @@ void HoymilesRadio_NRF::sendEsbPacket(CommandAbstract& cmd)
     cmd.setRouterAddress(DtuSerial().u64);
 
     _radio->stopListening();
-    _radio->setChannel(getTxNxtChannel());
+    _radio->setChannel(getTxChannel(cmd));
 
     serial_u s;
     s.u64 = cmd.getTargetAddress();
@@ -193,5 +255,5 @@ void HoymilesRadio_NRF::sendEsbPacket(CommandAbstract& cmd)
     _radio->setChannel(getRxNxtChannel());
     _radio->startListening();
     _busyFlag = true;
-    _rxTimeout.set(cmd.getTimeout());
+    _rxTimeout.set(getRxTimeout(cmd));
 }
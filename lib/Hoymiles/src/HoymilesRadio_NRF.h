@@ -4,17 +4,17 @@
 #include "HoymilesRadio.h"
 #include "commands/CommandAbstract.h"
 #include <RF24.h>
+#include <atomic>
+#include <esp_timer.h>
 #include <memory>
 #include <nRF24L01.h>
-#include <queue>
 
-// number of fragments hold in buffer
-#define FRAGMENT_BUFFER_SIZE 30
+// interval of switching the RX channel while waiting for fragments
+#define NRF_RX_CHANNEL_SWITCH_INTERVAL_US 4000
 
 class HoymilesRadio_NRF : public HoymilesRadio {
 public:
     void init(SPIClass* initialisedSpiBus, const uint8_t pinCE, const uint8_t pinIRQ);
-    void loop();
     void setPALevel(const rf24_pa_dbm_e paLevel);
 
     virtual void setDtuSerial(const uint64_t serial);
@@ -23,24 +23,32 @@ public:
     bool isPVariant() const;
 
 private:
+    void loop() final;
+
     void ARDUINO_ISR_ATTR handleIntr();
+    static void onRxChannelTimer(void* context);
     uint8_t getRxNxtChannel();
     uint8_t getTxNxtChannel();
+    uint8_t getTxChannel(CommandAbstract& cmd);
     void switchRxCh();
     void openReadingPipe();
     void openWritingPipe(const serial_u serial);
 
     void sendEsbPacket(CommandAbstract& cmd);
+    void updateLinkQuality(InverterAbstract& inv, const bool answered) final;
 
     std::unique_ptr<SPIClass> _spiPtr;
     std::unique_ptr<RF24> _radio;
     uint8_t _rxChLst[5] = { 3, 23, 40, 61, 75 };
     uint8_t _rxChIdx = 0;
 
-    uint8_t _txChLst[5] = { 3, 23, 40, 61, 75 };
+    uint8_t _txChLst[HOY_TX_CHANNEL_COUNT] = { 3, 23, 40, 61, 75 };
     uint8_t _txChIdx = 0;
 
-    volatile bool _packetReceived = false;
+    // millis() at the last interrupt, i.e., when the fragments currently
+    // waiting in the RX FIFO were received
+    volatile uint32_t _irqMillis = 0;
 
-    std::queue<fragment_t> _rxBuffer;
+    esp_timer_handle_t _rxChannelTimer = nullptr;
+    std::atomic<bool> _rxChannelSwitchDue = false;
 };
\ No newline at end of file
@@ -0,0 +1,386 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "HoymilesRadio_Sim.h"
+#include "Hoymiles.h"
+#include "crc.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// the payload bytes carried by one fragment, as sent by real inverters
+constexpr uint8_t FragmentDataSize = 16;
+
+constexpr float SunFactor = 0.8;
+constexpr float Efficiency = 0.96;
+
+struct SimType {
+    const char* TypePrefix;
+    uint8_t HwPart[4];
+    uint16_t MaxPower;
+};
+
+// one hardware part number of each inverter type, as known by the
+// DevInfoParser. the first type whose prefix matches the inverter's type
+// name is used, the last one applies to all remaining types.
+constexpr SimType SimTypes[] = {
+    { "HMS-300", { 0x10, 0x20, 0x41, 0x00 }, 400 },
+    { "HMS-450", { 0x10, 0x20, 0x71, 0x00 }, 500 },
+    { "HMS-600", { 0x10, 0x21, 0x41, 0x00 }, 800 },
+    { "HMS-1600", { 0x10, 0x22, 0x71, 0x00 }, 2000 },
+    { "HMT-1600", { 0x10, 0x32, 0x71, 0x00 }, 2000 },
+    { "HMT-1800", { 0x10, 0x33, 0x31, 0x00 }, 2250 },
+    { "HM-300", { 0x10, 0x10, 0x40, 0x00 }, 400 },
+    { "HM-1000", { 0x10, 0x12, 0x30, 0x00 }, 1500 },
+    { "HERF-300", { 0x10, 0x10, 0x40, 0x00 }, 400 },
+    { "HERF-1600", { 0xF1, 0x01, 0x24, 0x00 }, 1600 },
+    { "HERF-600", { 0xF1, 0x01, 0x14, 0x00 }, 800 },
+    { "", { 0x10, 0x11, 0x40, 0x00 }, 800 },
+};
+
+void writeSerial(uint8_t* buffer, const uint64_t serial)
+{
+    serial_u s;
+    s.u64 = serial;
+    buffer[0] = s.b[3];
+    buffer[1] = s.b[2];
+    buffer[2] = s.b[1];
+    buffer[3] = s.b[0];
+}
+
+void writeUint16(std::vector<uint8_t>& payload, const size_t pos, const uint16_t value)
+{
+    payload[pos] = static_cast<uint8_t>(value >> 8);
+    payload[pos + 1] = static_cast<uint8_t>(value);
+}
+
+bool isLost()
+{
+    return random(100) < HOYMILES_SIMULATOR_LOSS_PERCENT;
+}
+
+} // namespace
+
+void HoymilesRadio_Sim::init()
+{
+    _dtuSerial.u64 = 0;
+    _isInitialized = true;
+
+    Hoymiles.getMessageOutput()->printf("Simulating inverters, %d %% of the fragments get lost\r\n",
+        HOYMILES_SIMULATOR_LOSS_PERCENT);
+
+    startTask("HoyRadioSim");
+}
+
+void HoymilesRadio_Sim::loop()
+{
+    const uint32_t now = millis();
+
+    for (auto it = _pending.begin(); it != _pending.end();) {
+        if (static_cast<int32_t>(now - it->DueMillis) < 0) {
+            ++it;
+            continue;
+        }
+
+        fragment_t& f = it->Fragment;
+        f.rxMillis = now;
+
+        InverterAbstract* inv = Hoymiles.findInverterByFragment(f);
+        if (nullptr != inv) {
+            Hoymiles.getVerboseMessageOutput()->print("RX Sim --> ");
+            dumpBuf(f.fragment, f.len, false);
+            Hoymiles.getVerboseMessageOutput()->printf("| %" PRId8 " dBm\r\n", f.rssi);
+
+            inv->addRxFragment(f.fragment, f.len, f.rssi, f.rxMillis);
+            checkRxPeriodComplete(*inv);
+        }
+
+        it = _pending.erase(it);
+    }
+
+    handleReceivedPackage();
+}
+
+void HoymilesRadio_Sim::sendEsbPacket(CommandAbstract& cmd)
+{
+    cmd.incrementSendCount();
+
+    Hoymiles.getVerboseMessageOutput()->printf("TX %s Sim --> ", cmd.getCommandName().c_str());
+    cmd.dumpDataPayload(Hoymiles.getVerboseMessageOutput());
+
+    _busyFlag = true;
+    _rxTimeout.set(getRxTimeout(cmd));
+
+    auto inv = Hoymiles.findInverterBySerial(cmd.getTargetAddress());
+    if (nullptr == inv || isLost()) {
+        return;
+    }
+
+    SimInverter* sim = getSimInverter(*inv);
+    const uint8_t* request = cmd.getDataPayload();
+    const uint32_t delay = HOYMILES_SIMULATOR_ANSWER_DELAY_MS + random(HOYMILES_SIMULATOR_ANSWER_DELAY_MS + 1);
+
+    if (request[0] == 0x51) {
+        handleDevControl(cmd, *sim);
+        return;
+    }
+
+    // the channel change command is not answered
+    if (request[0] != 0x15) {
+        return;
+    }
+
+    // retransmit requests only consist of the frame number
+    if (cmd.getDataSize() == 10) {
+        const uint8_t frame = request[9] & 0x7f;
+        if (frame >= 1 && frame <= sim->LastAnswer.size() && !isLost()) {
+            sendFragment(sim->LastAnswer[frame - 1], millis() + delay);
+        }
+        return;
+    }
+
+    updatePower(*sim);
+
+    std::vector<uint8_t> payload;
+    switch (request[10]) {
+    case 0x0b: // RealTimeRunData
+        payload = buildStatistics(*inv, *sim);
+        break;
+    case 0x05: // SystemConfigPara
+        payload = buildSystemConfigPara(*sim);
+        break;
+    case 0x00: // DevInfoSimple
+        payload = buildDevInfoSimple(*sim);
+        break;
+    case 0x01: // DevInfoAll
+        payload = buildDevInfoAll();
+        break;
+    case 0x02: // GridOnProFilePara, the parser only checks its size
+        payload.assign(8, 0);
+        break;
+    case 0x11: // AlarmData, without any events
+        payload.assign(2, 0);
+        break;
+    default:
+        return;
+    }
+
+    answer(*sim, 0x95, payload, delay);
+}
+
+HoymilesRadio_Sim::SimInverter* HoymilesRadio_Sim::getSimInverter(const InverterAbstract& inv)
+{
+    auto it = std::find_if(_inverters.begin(), _inverters.end(),
+        [&inv](const SimInverter& sim) { return sim.Serial == inv.serial(); });
+    if (it != _inverters.end()) {
+        return &*it;
+    }
+
+    const String typeName = inv.typeName();
+    const SimType* type = &SimTypes[sizeof(SimTypes) / sizeof(SimTypes[0]) - 1];
+    for (auto& t : SimTypes) {
+        if (typeName.startsWith(t.TypePrefix)) {
+            type = &t;
+            break;
+        }
+    }
+
+    SimInverter sim;
+    sim.Serial = inv.serial();
+    memcpy(sim.HwPart, type->HwPart, sizeof(sim.HwPart));
+    sim.MaxPower = type->MaxPower;
+    sim.Power = SunFactor * sim.MaxPower;
+    sim.LastUpdate = millis();
+    _inverters.push_back(std::move(sim));
+    return &_inverters.back();
+}
+
+void HoymilesRadio_Sim::updatePower(SimInverter& sim)
+{
+    const uint32_t now = millis();
+    const float elapsed = now - sim.LastUpdate;
+    sim.LastUpdate = now;
+
+    const float energy = sim.Power * elapsed / (3600 * 1000);
+    sim.YieldTotal += energy;
+    sim.YieldDay += energy;
+
+    float target = 0;
+    if (sim.ProducingEnabled) {
+        target = std::min(SunFactor, sim.LimitPercent / 100) * sim.MaxPower;
+    }
+    sim.Power += (target - sim.Power) * (1 - expf(-elapsed / HOYMILES_SIMULATOR_STEP_TAU_MS));
+}
+
+void HoymilesRadio_Sim::answer(SimInverter& sim, const uint8_t mainCmd, const std::vector<uint8_t>& payload, uint32_t delay)
+{
+    std::vector<uint8_t> data = payload;
+    const uint16_t crc = crc16(data.data(), data.size());
+    data.push_back(static_cast<uint8_t>(crc >> 8));
+    data.push_back(static_cast<uint8_t>(crc));
+
+    const size_t count = (data.size() + FragmentDataSize - 1) / FragmentDataSize;
+    const int8_t rssi = -50 - random(30);
+
+    sim.LastAnswer.clear();
+    for (size_t i = 0; i < count; i++) {
+        const size_t offset = i * FragmentDataSize;
+        const uint8_t size = std::min<size_t>(FragmentDataSize, data.size() - offset);
+
+        fragment_t f = {};
+        f.fragment[0] = mainCmd;
+        writeSerial(&f.fragment[1], sim.Serial);
+        writeSerial(&f.fragment[5], _dtuSerial.u64);
+        f.fragment[9] = (i + 1) | ((i == count - 1) ? 0x80 : 0x00);
+        memcpy(&f.fragment[10], &data[offset], size);
+        f.len = 11 + size;
+        f.fragment[f.len - 1] = crc8(f.fragment, f.len - 1);
+        f.rssi = rssi;
+        sim.LastAnswer.push_back(f);
+
+        if (!isLost()) {
+            sendFragment(f, millis() + delay);
+        }
+        delay += HOYMILES_SIMULATOR_FRAGMENT_SPACING_MS;
+    }
+}
+
+void HoymilesRadio_Sim::sendFragment(const fragment_t& fragment, const uint32_t dueMillis)
+{
+    _pending.push_back({ dueMillis, fragment });
+}
+
+std::vector<uint8_t> HoymilesRadio_Sim::buildStatistics(const InverterAbstract& inv, const SimInverter& sim) const
+{
+    std::vector<uint8_t> payload(inv.getByteAssignmentIndex()->expectedByteCount, 0);
+
+    const uint8_t dcChannels = std::max<uint8_t>(inv.getChannelMetaDataSize(), 1);
+    const float dcPower = sim.Power / Efficiency / dcChannels;
+
+    const byteAssign_t* assignments = inv.getByteAssignment();
+    for (uint8_t i = 0; i < inv.getByteAssignmentSize(); i++) {
+        const byteAssign_t& a = assignments[i];
+        if (a.div == CMD_CALC) {
+            continue;
+        }
+
+        const float dcVoltage = 34 + a.ch * 0.5;
+        float value = 0;
+        switch (a.fieldId) {
+        case FLD_UDC:
+            value = dcVoltage;
+            break;
+        case FLD_IDC:
+            value = dcPower / dcVoltage;
+            break;
+        case FLD_PDC:
+            value = dcPower;
+            break;
+        case FLD_YD:
+            value = sim.YieldDay / dcChannels;
+            break;
+        case FLD_YT:
+            value = sim.YieldTotal / 1000 / dcChannels;
+            break;
+        case FLD_UAC:
+        case FLD_UAC_1N:
+        case FLD_UAC_2N:
+        case FLD_UAC_3N:
+            value = 230;
+            break;
+        case FLD_UAC_12:
+        case FLD_UAC_23:
+        case FLD_UAC_31:
+            value = 400;
+            break;
+        case FLD_IAC:
+            value = sim.Power / 230;
+            break;
+        case FLD_IAC_1:
+        case FLD_IAC_2:
+        case FLD_IAC_3:
+            value = sim.Power / 3 / 230;
+            break;
+        case FLD_PAC:
+            value = sim.Power;
+            break;
+        case FLD_F:
+            value = 50;
+            break;
+        case FLD_T:
+            value = 35;
+            break;
+        case FLD_PF:
+            value = 1;
+            break;
+        default:
+            break;
+        }
+
+        const int64_t raw = llroundf(value * a.div);
+        for (uint8_t b = 0; b < a.num && a.start + a.num <= payload.size(); b++) {
+            payload[a.start + a.num - 1 - b] = static_cast<uint8_t>(raw >> (8 * b));
+        }
+    }
+
+    return payload;
+}
+
+std::vector<uint8_t> HoymilesRadio_Sim::buildDevInfoSimple(const SimInverter& sim) const
+{
+    std::vector<uint8_t> payload(14, 0);
+    memcpy(&payload[2], sim.HwPart, sizeof(sim.HwPart));
+    payload[6] = 1; // hardware version
+    return payload;
+}
+
+std::vector<uint8_t> HoymilesRadio_Sim::buildDevInfoAll() const
+{
+    std::vector<uint8_t> payload(14, 0);
+    writeUint16(payload, 0, 10016); // firmware version
+    writeUint16(payload, 2, 2024); // firmware build year
+    writeUint16(payload, 4, 101); // month and day
+    writeUint16(payload, 6, 1200); // hour and minute
+    writeUint16(payload, 8, 10000); // bootloader version
+    return payload;
+}
+
+std::vector<uint8_t> HoymilesRadio_Sim::buildSystemConfigPara(const SimInverter& sim) const
+{
+    std::vector<uint8_t> payload(SYSTEM_CONFIG_PARA_SIZE, 0);
+    writeUint16(payload, 2, static_cast<uint16_t>(sim.LimitPercent * 10));
+    return payload;
+}
+
+void HoymilesRadio_Sim::handleDevControl(CommandAbstract& cmd, SimInverter& sim)
+{
+    updatePower(sim);
+
+    const uint8_t* request = cmd.getDataPayload();
+    switch (request[10]) {
+    case 0x0b: { // ActivePowerControl
+        const float limit = ((static_cast<uint16_t>(request[12]) << 8) | request[13]) / 10.0;
+        const bool relative = (request[15] & 0x01) != 0;
+        const float percent = relative ? limit : limit / sim.MaxPower * 100;
+        sim.LimitPercent = std::clamp(percent, 0.0f, 100.0f);
+        break;
+    }
+    case 0x00: // TurnOn
+        sim.ProducingEnabled = true;
+        break;
+    case 0x01: // TurnOff
+        sim.ProducingEnabled = false;
+        break;
+    case 0x02: // Restart
+        sim.Power = 0;
+        break;
+    default:
+        break;
+    }
+
+    const uint32_t delay = HOYMILES_SIMULATOR_CONTROL_DELAY_MS + random(HOYMILES_SIMULATOR_CONTROL_DELAY_MS / 2 + 1);
+    answer(sim, request[0] | 0x80, { request[10], request[11] }, delay);
+}
@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "HoymilesRadio.h"
+#include "commands/CommandAbstract.h"
+#include "types.h"
+#include <cstdint>
+#include <vector>
+
+// the share of fragments (in percent) which get lost on the air
+#ifndef HOYMILES_SIMULATOR_LOSS_PERCENT
+#define HOYMILES_SIMULATOR_LOSS_PERCENT 5
+#endif
+
+// the time until the first fragment of an answer arrives, plus a random
+// jitter of up to the same amount, and the time between two fragments
+#ifndef HOYMILES_SIMULATOR_ANSWER_DELAY_MS
+#define HOYMILES_SIMULATOR_ANSWER_DELAY_MS 25
+#endif
+#ifndef HOYMILES_SIMULATOR_FRAGMENT_SPACING_MS
+#define HOYMILES_SIMULATOR_FRAGMENT_SPACING_MS 6
+#endif
+
+// the time it takes to acknowledge a DevControl request, plus a random
+// jitter of up to half of that
+#ifndef HOYMILES_SIMULATOR_CONTROL_DELAY_MS
+#define HOYMILES_SIMULATOR_CONTROL_DELAY_MS 500
+#endif
+
+// time constant of the AC power following a new limit
+#ifndef HOYMILES_SIMULATOR_STEP_TAU_MS
+#define HOYMILES_SIMULATOR_STEP_TAU_MS 3000
+#endif
+
+// a radio which emulates all inverters added while HOYMILES_SIMULATOR is
+// defined, whatever their type, to test large sites without hardware. the
+// statistics are generated through the byte assignment of the respective
+// inverter type, such that the real parsers process them. the inverters
+// produce 80 % of their nominal power and follow limits with a delay.
+class HoymilesRadio_Sim : public HoymilesRadio {
+public:
+    void init();
+
+private:
+    struct SimInverter {
+        uint64_t Serial;
+        uint8_t HwPart[4];
+        uint16_t MaxPower;
+        float LimitPercent = 100;
+        bool ProducingEnabled = true;
+        float Power = 0; // AC
+        double YieldTotal = 0; // Wh
+        float YieldDay = 0; // Wh
+        uint32_t LastUpdate = 0;
+        std::vector<fragment_t> LastAnswer; // for retransmit requests
+    };
+
+    struct Pending {
+        uint32_t DueMillis;
+        fragment_t Fragment;
+    };
+
+    void loop() final;
+    void sendEsbPacket(CommandAbstract& cmd) final;
+    // all simulated inverters share the same virtual channel
+    bool supportsInterleaving() const final { return true; }
+
+    SimInverter* getSimInverter(const InverterAbstract& inv);
+    void updatePower(SimInverter& sim);
+    void answer(SimInverter& sim, const uint8_t mainCmd, const std::vector<uint8_t>& payload, uint32_t delay);
+    void sendFragment(const fragment_t& fragment, const uint32_t dueMillis);
+
+    std::vector<uint8_t> buildStatistics(const InverterAbstract& inv, const SimInverter& sim) const;
+    std::vector<uint8_t> buildDevInfoSimple(const SimInverter& sim) const;
+    std::vector<uint8_t> buildDevInfoAll() const;
+    std::vector<uint8_t> buildSystemConfigPara(const SimInverter& sim) const;
+    void handleDevControl(CommandAbstract& cmd, SimInverter& sim);
+
+    std::vector<SimInverter> _inverters;
+    std::vector<Pending> _pending;
+};
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "RxTimeoutEstimator.h"
+#include "commands/CommandAbstract.h"
+#include <algorithm>
+
+uint32_t RxTimeoutEstimator::getTimeout(const CommandAbstract& cmd) const
+{
+    const Estimate* estimate = find(cmd);
+    if (estimate == nullptr) {
+        return cmd.getTimeout();
+    }
+    return estimate->Timeout;
+}
+
+std::optional<uint32_t> RxTimeoutEstimator::getEarliestAnswer(const CommandAbstract& cmd) const
+{
+    const Estimate* estimate = find(cmd);
+    if (estimate == nullptr) {
+        return std::nullopt;
+    }
+
+    const uint32_t margin = 2 * estimate->RttVar;
+    return (estimate->Srtt > margin) ? estimate->Srtt - margin : 0;
+}
+
+void RxTimeoutEstimator::addSample(const CommandAbstract& cmd, const uint32_t rtt)
+{
+    // commands which are not queued, e.g., retransmit requests, have no key
+    if (cmd.getSimilarityKey() == 0) {
+        return;
+    }
+
+    Estimate* estimate = find(cmd);
+    if (estimate == nullptr) {
+        _estimates.push_back({ cmd.getSimilarityKey(), rtt, rtt / 2, 0 });
+        estimate = &_estimates.back();
+    } else {
+        const uint32_t deviation = (rtt > estimate->Srtt) ? rtt - estimate->Srtt : estimate->Srtt - rtt;
+        estimate->RttVar = (3 * estimate->RttVar + deviation) / 4;
+        estimate->Srtt = (7 * estimate->Srtt + rtt) / 8;
+    }
+
+    estimate->Timeout = clamp(cmd, estimate->Srtt + std::max(Granularity, 4 * estimate->RttVar));
+}
+
+void RxTimeoutEstimator::backoff(const CommandAbstract& cmd)
+{
+    Estimate* estimate = find(cmd);
+    if (estimate == nullptr) {
+        return;
+    }
+
+    estimate->Timeout = clamp(cmd, estimate->Timeout * 2);
+}
+
+RxTimeoutEstimator::Estimate* RxTimeoutEstimator::find(const CommandAbstract& cmd)
+{
+    return const_cast<Estimate*>(static_cast<const RxTimeoutEstimator*>(this)->find(cmd));
+}
+
+const RxTimeoutEstimator::Estimate* RxTimeoutEstimator::find(const CommandAbstract& cmd) const
+{
+    const uint32_t key = cmd.getSimilarityKey();
+    if (key == 0) {
+        return nullptr;
+    }
+
+    auto it = std::find_if(_estimates.begin(), _estimates.end(),
+        [key](const Estimate& estimate) { return estimate.Key == key; });
+    return (it == _estimates.end()) ? nullptr : &*it;
+}
+
+uint32_t RxTimeoutEstimator::clamp(const CommandAbstract& cmd, const uint32_t timeout)
+{
+    const uint32_t fixed = cmd.getTimeout();
+    return std::clamp(timeout, std::min(MinTimeout, fixed), fixed * MaxTimeoutFactor);
+}
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+class CommandAbstract;
+
+// estimates the round-trip time of each command to an inverter like TCP
+// does (RFC 6298), i.e., as smoothed mean plus four times the smoothed mean
+// deviation, and derives the RX timeout of the next transmission from it.
+// commands without estimate use their own fixed timeout. only used by the
+// radio task.
+class RxTimeoutEstimator {
+public:
+    uint32_t getTimeout(const CommandAbstract& cmd) const;
+
+    // the time after sending the command before which the inverter is
+    // unlikely to answer, i.e., smoothed mean minus twice the smoothed mean
+    // deviation. unset if no estimate exists.
+    std::optional<uint32_t> getEarliestAnswer(const CommandAbstract& cmd) const;
+
+    // to be called with the time from sending a command until its last
+    // fragment arrived. following Karn's algorithm, transactions which
+    // needed a resend or a retransmit must not be sampled, as their
+    // round-trip time is ambiguous.
+    void addSample(const CommandAbstract& cmd, const uint32_t rtt);
+
+    // to be called if the inverter did not answer completely within the
+    // timeout. doubles the timeout until the next sample.
+    void backoff(const CommandAbstract& cmd);
+
+private:
+    // the timeout is kept in these bounds relative to the fixed timeout of
+    // the respective command, such that an estimate gone wrong neither
+    // floods the inverter nor stalls the radio.
+    static constexpr uint32_t MinTimeout = 50; // or the fixed timeout if lower
+    static constexpr uint32_t MaxTimeoutFactor = 2;
+
+    // added to the variance term, as the radio task notices fragments
+    // and timeouts in the granularity of its loop
+    static constexpr uint32_t Granularity = 10;
+
+    struct Estimate {
+        uint32_t Key;
+        uint32_t Srtt; // milliseconds
+        uint32_t RttVar; // milliseconds
+        uint32_t Timeout; // milliseconds
+    };
+
+    Estimate* find(const CommandAbstract& cmd);
+    const Estimate* find(const CommandAbstract& cmd) const;
+    static uint32_t clamp(const CommandAbstract& cmd, const uint32_t timeout);
+
+    std::vector<Estimate> _estimates;
+};
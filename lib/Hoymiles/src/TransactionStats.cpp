@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "TransactionStats.h"
+#include "commands/CommandAbstract.h"
+#include <algorithm>
+
+const char* getTransactionPhaseName(const TransactionPhase phase)
+{
+    switch (phase) {
+    case TransactionPhase::Queue:
+        return "queue";
+    case TransactionPhase::FirstFragment:
+        return "first_fragment";
+    case TransactionPhase::Complete:
+        return "complete";
+    }
+    return "unknown";
+}
+
+void LatencyHistogram::add(const uint32_t duration)
+{
+    auto bound = std::lower_bound(Bounds.begin(), Bounds.end(), duration);
+    ++Buckets[bound - Bounds.begin()];
+    ++Count;
+    Sum += duration;
+}
+
+void TransactionStats::record(const CommandAbstract& cmd, const std::optional<uint32_t> firstFragmentAt, const std::optional<uint32_t> completedAt)
+{
+    const String command = cmd.getCommandName();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = std::find_if(_latency.begin(), _latency.end(),
+        [&command](const TransactionLatency& entry) { return entry.Command == command; });
+
+    if (it == _latency.end()) {
+        _latency.push_back({ command, {} });
+        it = _latency.end() - 1;
+    }
+
+    auto& phases = it->Phases;
+    phases[static_cast<size_t>(TransactionPhase::Queue)].add(cmd.getSentAt() - cmd.getQueuedAt());
+
+    if (firstFragmentAt) {
+        phases[static_cast<size_t>(TransactionPhase::FirstFragment)].add(*firstFragmentAt - cmd.getSentAt());
+    }
+
+    if (completedAt) {
+        phases[static_cast<size_t>(TransactionPhase::Complete)].add(*completedAt - cmd.getSentAt());
+    }
+}
+
+std::vector<TransactionLatency> TransactionStats::get() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _latency;
+}
+
+void TransactionStats::reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _latency.clear();
+}
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Arduino.h>
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+class CommandAbstract;
+
+enum class TransactionPhase : uint8_t {
+    Queue, // queued until sent
+    FirstFragment, // sent until the first fragment was received
+    Complete, // sent until the last fragment was received
+};
+#define HOY_TRANSACTION_PHASE_COUNT 3
+
+// snake case name of the phase, as used by the web API
+const char* getTransactionPhaseName(const TransactionPhase phase);
+
+struct LatencyHistogram {
+    // upper bounds of the buckets in milliseconds. durations beyond the last
+    // bound are counted in an additional bucket.
+    static constexpr std::array<uint32_t, 8> Bounds = { 25, 50, 100, 250, 500, 1000, 2500, 5000 };
+
+    std::array<uint32_t, Bounds.size() + 1> Buckets = {}; // not cumulative
+    uint32_t Count = 0;
+    uint32_t Sum = 0; // milliseconds
+
+    void add(const uint32_t duration);
+};
+
+struct TransactionLatency {
+    String Command;
+    std::array<LatencyHistogram, HOY_TRANSACTION_PHASE_COUNT> Phases;
+};
+
+// latencies of the RF transactions of an inverter, per command name.
+// written by the radio task, read by the web API.
+class TransactionStats {
+public:
+    // to be called when the command leaves the queue after it was sent.
+    // completedAt is the time the last fragment of a successful
+    // transaction was received.
+    void record(const CommandAbstract& cmd, const std::optional<uint32_t> firstFragmentAt, const std::optional<uint32_t> completedAt);
+
+    std::vector<TransactionLatency> get() const;
+
+    void reset();
+
+private:
+    mutable std::mutex _mutex;
+    std::vector<TransactionLatency> _latency;
+};
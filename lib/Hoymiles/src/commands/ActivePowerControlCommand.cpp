@@ -76,21 +76,27 @@ bool ActivePowerControlCommand::handleResponse(const fragment_t fragment[], cons
         return false;
     }
 
+    // the acknowledged limit is in effect, it does not need to be read back
     if ((getType() == PowerLimitControlType::RelativNonPersistent) || (getType() == PowerLimitControlType::RelativPersistent)) {
         _inv->SystemConfigPara()->setLimitPercent(getLimit());
+        _inv->SystemConfigPara()->setLimitConfirmed(true);
     } else {
         const uint16_t max_power = _inv->DevInfo()->getMaxPower();
         if (max_power > 0) {
             _inv->SystemConfigPara()->setLimitPercent(static_cast<float>(getLimit()) / max_power * 100);
+            _inv->SystemConfigPara()->setLimitConfirmed(true);
         } else {
             // TODO(tbnobody): Not implemented yet because we only can publish the percentage value
+            _inv->SystemConfigPara()->setLimitConfirmed(false);
         }
     }
     _inv->SystemConfigPara()->setLastUpdateCommand(millis());
+    _inv->SystemConfigPara()->setLastLimitCommandRoundTrip(millis() - getQueuedAt());
     std::shared_ptr<ActivePowerControlCommand> cmd(std::shared_ptr<ActivePowerControlCommand>(), this);
     if (_inv->getRadio()->countSimilarCommands(cmd) == 1) {
         _inv->SystemConfigPara()->setLastLimitCommandSuccess(CMD_OK);
     }
+    _inv->activePowerControlCompleted();
     return true;
 }
 
@@ -107,5 +113,9 @@ PowerLimitControlType ActivePowerControlCommand::getType() const
 
 void ActivePowerControlCommand::gotTimeout()
 {
+    // the inverter might have applied the limit without us receiving the
+    // acknowledgment
+    _inv->SystemConfigPara()->setLimitConfirmed(false);
     _inv->SystemConfigPara()->setLastLimitCommandSuccess(CMD_NOK);
+    _inv->activePowerControlCompleted();
 }
@@ -11,7 +11,7 @@ Derives from MultiDataCommand
 Command structure:
 * DT: this specific command uses 0x11
 * AlarmId: The last event id received from the inverter or zero in case that no events
-  has been received yet. --> Not Implemented yet
+  has been received yet. The inverter then only sends the events which were added since.
 
 00   01 02 03 04   05 06 07 08   09   10   11   12 13 14 15   16 17   18 19   20 21 22 23   24 25   26   27 28 29 30 31
 -----------------------------------------------------------------------------------------------------------------------
@@ -22,6 +22,7 @@ ID   Target Addr   Source Addr   Idx  DT   ?    Time          Gap     AlarmId Pa
 */
 #include "AlarmDataCommand.h"
 #include "inverters/InverterAbstract.h"
+#include <cstring>
 
 AlarmDataCommand::AlarmDataCommand(InverterAbstract* inv, const uint64_t router_address, const time_t time)
     : MultiDataCommand(inv, router_address)
@@ -36,6 +37,18 @@ String AlarmDataCommand::getCommandName() const
     return "AlarmData";
 }
 
+void AlarmDataCommand::setAlarmId(const uint16_t alarmId)
+{
+    _payload[18] = static_cast<uint8_t>(alarmId >> 8);
+    _payload[19] = static_cast<uint8_t>(alarmId);
+    udpateCRC();
+}
+
+uint16_t AlarmDataCommand::getAlarmId() const
+{
+    return (static_cast<uint16_t>(_payload[18]) << 8) | _payload[19];
+}
+
 bool AlarmDataCommand::handleResponse(const fragment_t fragment[], const uint8_t max_fragment_id)
 {
     // Check CRC of whole payload
@@ -43,13 +56,25 @@ bool AlarmDataCommand::handleResponse(const fragment_t fragment[], const uint8_t
         return false;
     }
 
-    // Move all fragments into target buffer
-    uint8_t offs = 0;
     _inv->EventLog()->beginAppendFragment();
-    _inv->EventLog()->clearBuffer();
-    for (uint8_t i = 0; i < max_fragment_id; i++) {
-        _inv->EventLog()->appendFragment(offs, fragment[i].fragment, fragment[i].len);
-        offs += (fragment[i].len);
+    if (getAlarmId() == 0) {
+        // Move all fragments into target buffer
+        uint8_t offs = 0;
+        _inv->EventLog()->clearBuffer();
+        for (uint8_t i = 0; i < max_fragment_id; i++) {
+            _inv->EventLog()->appendFragment(offs, fragment[i].fragment, fragment[i].len);
+            offs += (fragment[i].len);
+        }
+    } else {
+        // the response only contains the new events, which are added to
+        // the ones received before
+        uint8_t payload[ALARM_LOG_PAYLOAD_SIZE];
+        uint8_t offs = 0;
+        for (uint8_t i = 0; i < max_fragment_id && offs + fragment[i].len <= ALARM_LOG_PAYLOAD_SIZE; i++) {
+            memcpy(&payload[offs], fragment[i].fragment, fragment[i].len);
+            offs += (fragment[i].len);
+        }
+        _inv->EventLog()->mergeEntries(payload, offs);
     }
     _inv->EventLog()->endAppendFragment();
     _inv->EventLog()->setLastAlarmRequestSuccess(CMD_OK);
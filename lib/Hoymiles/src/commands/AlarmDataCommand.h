@@ -9,6 +9,9 @@ public:
 
     virtual String getCommandName() const;
 
+    void setAlarmId(const uint16_t alarmId);
+    uint16_t getAlarmId() const;
+
     virtual bool handleResponse(const fragment_t fragment[], const uint8_t max_fragment_id);
     virtual void gotTimeout();
 };
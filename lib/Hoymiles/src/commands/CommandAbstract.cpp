@@ -144,3 +144,48 @@ bool CommandAbstract::areSameParameter(CommandAbstract* other)
     return this->getCommandName() == other->getCommandName()
         && this->_targetAddress == other->getTargetAddress();
 }
+
+void CommandAbstract::cacheSimilarityKey()
+{
+    // FNV-1a, zero is reserved for "not cached"
+    const String name = getCommandName();
+    uint32_t hash = 2166136261UL;
+    for (const char* c = name.c_str(); *c != '\0'; ++c) {
+        hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619UL;
+    }
+    _similarityKey = (hash == 0) ? 1 : hash;
+}
+
+bool CommandAbstract::hasSameSimilarityKey(const CommandAbstract& other) const
+{
+    // commands without cached key might still be similar
+    if (_similarityKey == 0 || other._similarityKey == 0) {
+        return true;
+    }
+    return _similarityKey == other._similarityKey;
+}
+
+uint32_t CommandAbstract::getSimilarityKey() const
+{
+    return _similarityKey;
+}
+
+void CommandAbstract::setQueuedAt(const uint32_t queuedAt)
+{
+    _queuedAt = queuedAt;
+}
+
+uint32_t CommandAbstract::getQueuedAt() const
+{
+    return _queuedAt;
+}
+
+void CommandAbstract::setSentAt(const uint32_t sentAt)
+{
+    _sentAt = sentAt;
+}
+
+uint32_t CommandAbstract::getSentAt() const
+{
+    return _sentAt;
+}
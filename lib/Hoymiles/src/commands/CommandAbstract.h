@@ -23,6 +23,17 @@ enum class QueueInsertType {
     ReplaceExistent,
 };
 
+// commands of a higher priority (lower value) are sent before the queued
+// commands of lower priorities
+enum class CommandPriority : uint8_t {
+    // changes the behavior of the inverter, e.g., its power limit
+    Control,
+
+    // polls data from the inverter
+    Telemetry,
+};
+#define HOY_COMMAND_PRIORITY_COUNT 2
+
 class CommandAbstract {
 public:
     explicit CommandAbstract(InverterAbstract* inv, const uint64_t router_address = 0);
@@ -60,8 +71,27 @@ public:
 
     // Returns whether multiple instances of this command are allowed in the command queue.
     virtual QueueInsertType getQueueInsertType() const { return QueueInsertType::RemoveNewest; }
+    virtual CommandPriority getPriority() const { return CommandPriority::Telemetry; }
+    // whether the inverter takes long to answer, such that commands to other
+    // inverters may be sent and answered in the meantime
+    virtual bool allowsInterleaving() const { return false; }
     virtual bool areSameParameter(CommandAbstract* other);
 
+    // caches a hash of the command name, such that the command queue can
+    // tell dissimilar commands apart without calling getCommandName().
+    // must be called before the command is shared with other threads.
+    void cacheSimilarityKey();
+    bool hasSameSimilarityKey(const CommandAbstract& other) const;
+    uint32_t getSimilarityKey() const;
+
+    // the time the command was put into the command queue
+    void setQueuedAt(const uint32_t queuedAt);
+    uint32_t getQueuedAt() const;
+
+    // the time the radio sent the command for the first time
+    void setSentAt(const uint32_t sentAt);
+    uint32_t getSentAt() const;
+
 protected:
     uint8_t _payload[RF_LEN];
     uint8_t _payload_size;
@@ -74,6 +104,10 @@ protected:
     InverterAbstract* _inv;
 
 private:
+    uint32_t _similarityKey = 0;
+    uint32_t _queuedAt = 0;
+    uint32_t _sentAt = 0;
+
     void setTargetAddress(const uint64_t address);
     static void convertSerialToPacketId(uint8_t buffer[], const uint64_t serial);
 };
@@ -56,12 +56,19 @@ bool RealTimeRunDataCommand::handleResponse(const fragment_t fragment[], const u
 
     // Move all fragments into target buffer
     uint8_t offs = 0;
+    uint32_t acquiredMillis = 0;
     _inv->Statistics()->beginAppendFragment();
     _inv->Statistics()->clearBuffer();
     for (uint8_t i = 0; i < max_fragment_id; i++) {
         _inv->Statistics()->appendFragment(offs, fragment[i].fragment, fragment[i].len);
         offs += (fragment[i].len);
+
+        // the frame is complete once its last fragment was received
+        if (i == 0 || fragment[i].rxMillis - acquiredMillis < (UINT32_MAX / 2)) {
+            acquiredMillis = fragment[i].rxMillis;
+        }
     }
+    _inv->Statistics()->setAcquiredMillis(acquiredMillis);
     _inv->Statistics()->endAppendFragment();
     _inv->Statistics()->resetRxFailureCount();
     _inv->Statistics()->setLastUpdate(millis());
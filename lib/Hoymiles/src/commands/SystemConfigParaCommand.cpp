@@ -65,6 +65,7 @@ bool SystemConfigParaCommand::handleResponse(const fragment_t fragment[], const
     _inv->SystemConfigPara()->endAppendFragment();
     _inv->SystemConfigPara()->setLastUpdateRequest(millis());
     _inv->SystemConfigPara()->setLastLimitRequestSuccess(CMD_OK);
+    _inv->SystemConfigPara()->setLimitConfirmed(true);
     return true;
 }
 
@@ -3,15 +3,55 @@
  * Copyright (C) 2022 Thomas Basler and others
  */
 #include "crc.h"
+#include <array>
+#include <esp_rom_crc.h>
 
-uint8_t crc8(const uint8_t buf[], const uint8_t len)
+namespace {
+
+// lookup tables holding the CRC of each possible byte, calculated bit by bit
+// at compile time. the CRC of a buffer is then updated once per byte.
+constexpr std::array<uint8_t, 256> makeCrc8Table()
 {
-    uint8_t crc = CRC8_INIT;
-    for (uint8_t i = 0; i < len; i++) {
-        crc ^= buf[i];
+    std::array<uint8_t, 256> table {};
+    for (uint16_t i = 0; i < 256; i++) {
+        uint8_t crc = i;
         for (uint8_t b = 0; b < 8; b++) {
             crc = (crc << 1) ^ ((crc & 0x80) ? CRC8_POLY : 0x00);
         }
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr std::array<uint16_t, 256> makeCrc16Table()
+{
+    std::array<uint16_t, 256> table {};
+    for (uint16_t i = 0; i < 256; i++) {
+        uint16_t crc = i;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x0001) ? ((crc >> 1) ^ CRC16_MODBUS_POLYNOM) : (crc >> 1);
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr auto crc8Table = makeCrc8Table();
+constexpr auto crc16Table = makeCrc16Table();
+
+uint16_t crc16nrf24Bit(uint16_t crc, uint8_t val, uint8_t idx)
+{
+    crc ^= 0x8000 & (val << (8 + idx));
+    return (crc & 0x8000) ? ((crc << 1) ^ CRC16_NRF24_POLYNOM) : (crc << 1);
+}
+
+} // namespace
+
+uint8_t crc8(const uint8_t buf[], const uint8_t len)
+{
+    uint8_t crc = CRC8_INIT;
+    for (uint8_t i = 0; i < len; i++) {
+        crc = crc8Table[crc ^ buf[i]];
     }
     return crc;
 }
@@ -19,16 +59,8 @@ uint8_t crc8(const uint8_t buf[], const uint8_t len)
 uint16_t crc16(const uint8_t buf[], const uint8_t len, const uint16_t start)
 {
     uint16_t crc = start;
-    uint8_t shift = 0;
-
     for (uint8_t i = 0; i < len; i++) {
-        crc = crc ^ buf[i];
-        for (uint8_t bit = 0; bit < 8; bit++) {
-            shift = (crc & 0x0001);
-            crc = crc >> 1;
-            if (shift != 0)
-                crc = crc ^ 0xA001;
-        }
+        crc = (crc >> 8) ^ crc16Table[(crc ^ buf[i]) & 0xff];
     }
     return crc;
 }
@@ -36,15 +68,25 @@ uint16_t crc16(const uint8_t buf[], const uint8_t len, const uint16_t start)
 uint16_t crc16nrf24(const uint8_t buf[], const uint16_t lenBits, const uint16_t startBit, const uint16_t crcIn)
 {
     uint16_t crc = crcIn;
-    uint8_t idx, val = buf[(startBit >> 3)];
-
-    for (uint16_t bit = startBit; bit < lenBits; bit++) {
-        idx = bit & 0x07;
-        if (0 == idx)
-            val = buf[(bit >> 3)];
-        crc ^= 0x8000 & (val << (8 + idx));
-        crc = (crc & 0x8000) ? ((crc << 1) ^ CRC16_NRF24_POLYNOM) : (crc << 1);
+    uint16_t bit = startBit;
+
+    // leading bits up to the next byte boundary
+    for (; bit < lenBits && (bit & 0x07) != 0; bit++) {
+        crc = crc16nrf24Bit(crc, buf[bit >> 3], bit & 0x07);
+    }
+
+    // whole bytes are handled by the ROM implementation of the same
+    // polynomial, which inverts the CRC before and after.
+    uint16_t bytes = (bit < lenBits) ? ((lenBits - bit) >> 3) : 0;
+    if (bytes > 0) {
+        crc = ~esp_rom_crc16_be(static_cast<uint16_t>(~crc), &buf[bit >> 3], bytes);
+        bit += bytes << 3;
+    }
+
+    // trailing bits of an incomplete byte
+    for (; bit < lenBits; bit++) {
+        crc = crc16nrf24Bit(crc, buf[bit >> 3], bit & 0x07);
     }
 
     return crc;
-}
\ No newline at end of file
+}
@@ -5,7 +5,7 @@
  */
 #include "HERF_1CH.h"
 
-static const byteAssign_t byteAssignment[] = {
+static constexpr byteAssign_t byteAssignment[] = {
     { TYPE_DC, CH0, FLD_UDC, UNIT_V, 2, 2, 10, false, 1 },
     { TYPE_DC, CH0, FLD_IDC, UNIT_A, 6, 2, 100, false, 2 },
     { TYPE_DC, CH0, FLD_PDC, UNIT_W, 10, 2, 10, false, 1 },
@@ -29,6 +29,8 @@ static const byteAssign_t byteAssignment[] = {
     { TYPE_INV, CH0, FLD_EFF, UNIT_PCT, CALC_TOTAL_EFF, 0, CMD_CALC, false, 3 }
 };
 
+static constexpr auto byteAssignmentIndex = StatisticsParser::buildAssignmentIndex(byteAssignment);
+
 static const channelMetaData_t channelMetaData[] = {
     { CH0, MPPT_A }
 };
@@ -60,6 +62,11 @@ uint8_t HERF_1CH::getByteAssignmentSize() const
     return sizeof(byteAssignment) / sizeof(byteAssignment[0]);
 }
 
+const StatisticsParser::AssignmentIndex* HERF_1CH::getByteAssignmentIndex() const
+{
+    return &byteAssignmentIndex;
+}
+
 const channelMetaData_t* HERF_1CH::getChannelMetaData() const
 {
     return channelMetaData;
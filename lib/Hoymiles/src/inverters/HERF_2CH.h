@@ -10,6 +10,7 @@ public:
     String typeName() const;
     const byteAssign_t* getByteAssignment() const;
     uint8_t getByteAssignmentSize() const;
+    const StatisticsParser::AssignmentIndex* getByteAssignmentIndex() const;
     const channelMetaData_t* getChannelMetaData() const;
     uint8_t getChannelMetaDataSize() const;
 };
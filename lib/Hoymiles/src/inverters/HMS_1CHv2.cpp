@@ -4,7 +4,7 @@
  */
 #include "HMS_1CHv2.h"
 
-static const byteAssign_t byteAssignment[] = {
+static constexpr byteAssign_t byteAssignment[] = {
     { TYPE_DC, CH0, FLD_UDC, UNIT_V, 2, 2, 10, false, 1 },
     { TYPE_DC, CH0, FLD_IDC, UNIT_A, 6, 2, 100, false, 2 },
     { TYPE_DC, CH0, FLD_PDC, UNIT_W, 10, 2, 10, false, 1 },
@@ -28,6 +28,8 @@ static const byteAssign_t byteAssignment[] = {
     { TYPE_INV, CH0, FLD_EFF, UNIT_PCT, CALC_TOTAL_EFF, 0, CMD_CALC, false, 3 }
 };
 
+static constexpr auto byteAssignmentIndex = StatisticsParser::buildAssignmentIndex(byteAssignment);
+
 static const channelMetaData_t channelMetaData[] = {
     { CH0, MPPT_A }
 };
@@ -59,6 +61,11 @@ uint8_t HMS_1CHv2::getByteAssignmentSize() const
     return sizeof(byteAssignment) / sizeof(byteAssignment[0]);
 }
 
+const StatisticsParser::AssignmentIndex* HMS_1CHv2::getByteAssignmentIndex() const
+{
+    return &byteAssignmentIndex;
+}
+
 const channelMetaData_t* HMS_1CHv2::getChannelMetaData() const
 {
     return channelMetaData;
@@ -4,7 +4,7 @@
  */
 #include "HMS_2CH.h"
 
-static const byteAssign_t byteAssignment[] = {
+static constexpr byteAssign_t byteAssignment[] = {
     { TYPE_DC, CH0, FLD_UDC, UNIT_V, 2, 2, 10, false, 1 },
     { TYPE_DC, CH0, FLD_IDC, UNIT_A, 6, 2, 100, false, 2 },
     { TYPE_DC, CH0, FLD_PDC, UNIT_W, 10, 2, 10, false, 1 },
@@ -35,6 +35,8 @@ static const byteAssign_t byteAssignment[] = {
     { TYPE_INV, CH0, FLD_EFF, UNIT_PCT, CALC_TOTAL_EFF, 0, CMD_CALC, false, 3 }
 };
 
+static constexpr auto byteAssignmentIndex = StatisticsParser::buildAssignmentIndex(byteAssignment);
+
 static const channelMetaData_t channelMetaData[] = {
     { CH0, MPPT_A },
     { CH1, MPPT_B }
@@ -67,6 +69,11 @@ uint8_t HMS_2CH::getByteAssignmentSize() const
     return sizeof(byteAssignment) / sizeof(byteAssignment[0]);
 }
 
+const StatisticsParser::AssignmentIndex* HMS_2CH::getByteAssignmentIndex() const
+{
+    return &byteAssignmentIndex;
+}
+
 const channelMetaData_t* HMS_2CH::getChannelMetaData() const
 {
     return channelMetaData;
@@ -58,6 +58,7 @@ bool HM_Abstract::sendAlarmLogRequest(const bool force)
         }
     }
 
+    const uint8_t lastAlarmLogCnt = _lastAlarmLogCnt;
     _lastAlarmLogCnt = static_cast<uint8_t>(Statistics()->getChannelFieldValue(TYPE_INV, CH0, FLD_EVT_LOG));
 
     time_t now;
@@ -65,6 +66,12 @@ bool HM_Abstract::sendAlarmLogRequest(const bool force)
 
     auto cmd = _radio->prepareCommand<AlarmDataCommand>(this);
     cmd->setTime(now);
+
+    // only the events added since the last request are fetched, unless the
+    // request failed or the inverter started a new log (e.g. in the morning)
+    if (!force && EventLog()->getEntryCount() > 0 && _lastAlarmLogCnt > lastAlarmLogCnt) {
+        cmd->setAlarmId(lastAlarmLogCnt);
+    }
     EventLog()->setLastAlarmRequestSuccess(CMD_PENDING);
     _radio->enqueCommand(cmd);
 
@@ -124,23 +131,47 @@ bool HM_Abstract::sendActivePowerControlRequest(float limit, const PowerLimitCon
         return false;
     }
 
-    if (CMD_PENDING == SystemConfigPara()->getLastLimitCommandSuccess()) {
-        return false;
-    }
-
     if (type == PowerLimitControlType::RelativNonPersistent || type == PowerLimitControlType::RelativPersistent) {
         limit = min<float>(100, limit);
     }
 
+    std::lock_guard<std::mutex> lock(_activePowerControlMutex);
+
     _activePowerControlLimit = limit;
     _activePowerControlType = type;
 
+    // coalesce with the command in flight
+    if (CMD_PENDING == SystemConfigPara()->getLastLimitCommandSuccess()) {
+        _activePowerControlUpdatePending = true;
+        return true;
+    }
+
+    enqueueActivePowerControl();
+
+    return true;
+}
+
+void HM_Abstract::activePowerControlCompleted()
+{
+    std::lock_guard<std::mutex> lock(_activePowerControlMutex);
+
+    if (!_activePowerControlUpdatePending) {
+        return;
+    }
+
+    // only the newest limit is sent, all limits requested in the meantime
+    // are obsolete
+    enqueueActivePowerControl();
+}
+
+void HM_Abstract::enqueueActivePowerControl()
+{
+    _activePowerControlUpdatePending = false;
+
     auto cmd = _radio->prepareCommand<ActivePowerControlCommand>(this);
-    cmd->setActivePowerLimit(limit, type);
+    cmd->setActivePowerLimit(_activePowerControlLimit, _activePowerControlType);
     SystemConfigPara()->setLastLimitCommandSuccess(CMD_PENDING);
     _radio->enqueCommand(cmd);
-
-    return true;
 }
 
 bool HM_Abstract::resendActivePowerControlRequest()
@@ -2,6 +2,7 @@
 #pragma once
 
 #include "InverterAbstract.h"
+#include <mutex>
 
 class HM_Abstract : public InverterAbstract {
 public:
@@ -12,6 +13,7 @@ public:
     bool sendSystemConfigParaRequest();
     bool sendActivePowerControlRequest(float limit, const PowerLimitControlType type);
     bool resendActivePowerControlRequest();
+    void activePowerControlCompleted();
     bool sendPowerControlRequest(const bool turnOn);
     bool sendRestartControlRequest();
     bool resendPowerControlRequest();
@@ -19,9 +21,17 @@ public:
     bool supportsPowerDistributionLogic() override;
 
 private:
+    void enqueueActivePowerControl();
+
     uint8_t _lastAlarmLogCnt = 0;
+
+    // the newest limit requested. while a limit command is in flight, new
+    // limits only update this register, which is sent once the command in
+    // flight completed.
+    std::mutex _activePowerControlMutex;
     float _activePowerControlLimit = 0;
     PowerLimitControlType _activePowerControlType = PowerLimitControlType::AbsolutNonPersistent;
+    bool _activePowerControlUpdatePending = false;
 
     uint8_t _powerState = 1;
 };
@@ -12,6 +12,8 @@ InverterAbstract::InverterAbstract(HoymilesRadio* radio, const uint64_t serial)
     _serial.u64 = serial;
     _radio = radio;
 
+    TxChannelQuality.fill(50);
+
     char serial_buff[sizeof(uint64_t) * 8 + 1];
     snprintf(serial_buff, sizeof(serial_buff), "%0x%08x",
         static_cast<uint32_t>((serial >> 32) & 0xFFFFFFFF),
@@ -32,7 +34,7 @@ void InverterAbstract::init()
     // Not possible in constructor --> virtual function
     // Not possible in verifyAllFragments --> Because no data if nothing is ever received
     // It has to be executed because otherwise the getChannelCount method in stats always returns 0
-    _statisticsParser.get()->setByteAssignment(getByteAssignment(), getByteAssignmentSize());
+    _statisticsParser.get()->setByteAssignment(getByteAssignment(), getByteAssignmentSize(), getByteAssignmentIndex());
 }
 
 uint64_t InverterAbstract::serial() const
@@ -97,6 +99,46 @@ bool InverterAbstract::getEnableCommands() const
     return _enableCommands;
 }
 
+void InverterAbstract::setHighPollPriority(const bool enabled)
+{
+    _highPollPriority = enabled;
+}
+
+bool InverterAbstract::getHighPollPriority() const
+{
+    return _highPollPriority;
+}
+
+uint32_t InverterAbstract::getLastPoll() const
+{
+    return _lastPoll;
+}
+
+void InverterAbstract::setLastPoll(const uint32_t lastPoll, const bool polled)
+{
+    _lastPoll = lastPoll;
+
+    if (!polled) {
+        return;
+    }
+
+    if (_lastStatsPoll > 0) {
+        const uint32_t interval = lastPoll - _lastStatsPoll;
+        if (_effectivePollInterval == 0) {
+            _effectivePollInterval = interval;
+        } else {
+            _effectivePollInterval = (_effectivePollInterval * 3 + interval) / 4;
+        }
+    }
+
+    _lastStatsPoll = lastPoll;
+}
+
+uint32_t InverterAbstract::getEffectivePollInterval() const
+{
+    return _effectivePollInterval;
+}
+
 void InverterAbstract::setReachableThreshold(const uint8_t threshold)
 {
     _reachableThreshold = threshold;
@@ -184,16 +226,30 @@ SystemConfigParaParser* InverterAbstract::SystemConfigPara()
 
 void InverterAbstract::clearRxFragmentBuffer()
 {
-    memset(_rxFragmentBuffer, 0, MAX_RF_FRAGMENT_COUNT * sizeof(fragment_t));
+    // the payload of a slot is only read once all fragments up to the last
+    // one were received anew, so only the flags are cleared
+    for (auto& fragment : _rxFragmentBuffer) {
+        fragment.wasReceived = false;
+    }
     _rxFragmentMaxPacketId = 0;
     _rxFragmentLastPacketId = 0;
     _rxFragmentRetransmitCnt = 0;
+    _rxFragmentReceivedMask = 0;
+    _rxFragmentRequestedMask = 0;
+    _rxFragmentRequestedId = 0;
+    _rxFirstFragmentMillis.reset();
+    _rxLastFragmentMillis.reset();
 }
 
-void InverterAbstract::addRxFragment(const uint8_t fragment[], const uint8_t len, const int8_t rssi)
+void InverterAbstract::addRxFragment(const uint8_t fragment[], const uint8_t len, const int8_t rssi, const uint32_t rxMillis)
 {
     _lastRssi = rssi;
 
+    if (!_rxFirstFragmentMillis) {
+        _rxFirstFragmentMillis = rxMillis;
+    }
+    _rxLastFragmentMillis = rxMillis;
+
     if (len < 11) {
         Hoymiles.getMessageOutput()->printf("FATAL: (%s, %d) fragment too short\r\n", __FILE__, __LINE__);
         return;
@@ -222,7 +278,10 @@ void InverterAbstract::addRxFragment(const uint8_t fragment[], const uint8_t len
     memcpy(_rxFragmentBuffer[fragmentId - 1].fragment, &fragment[10], len - 11);
     _rxFragmentBuffer[fragmentId - 1].len = len - 11;
     _rxFragmentBuffer[fragmentId - 1].mainCmd = fragment[0];
+    _rxFragmentBuffer[fragmentId - 1].rssi = rssi;
+    _rxFragmentBuffer[fragmentId - 1].rxMillis = rxMillis;
     _rxFragmentBuffer[fragmentId - 1].wasReceived = true;
+    _rxFragmentReceivedMask |= 1 << (fragmentId - 1);
 
     if (fragmentId > _rxFragmentLastPacketId) {
         _rxFragmentLastPacketId = fragmentId;
@@ -235,6 +294,30 @@ void InverterAbstract::addRxFragment(const uint8_t fragment[], const uint8_t len
 }
 
 // Returns Zero on Success or the Fragment ID for retransmit or error code
+std::optional<uint32_t> InverterAbstract::getFirstRxFragmentMillis() const
+{
+    return _rxFirstFragmentMillis;
+}
+
+std::optional<uint32_t> InverterAbstract::getLastRxFragmentMillis() const
+{
+    return _rxLastFragmentMillis;
+}
+
+bool InverterAbstract::isRxPeriodComplete() const
+{
+    if (_rxFragmentRequestedId != 0) {
+        return (_rxFragmentReceivedMask & (1 << (_rxFragmentRequestedId - 1))) != 0;
+    }
+
+    if (_rxFragmentMaxPacketId == 0) {
+        return false;
+    }
+
+    const uint16_t all = (1 << _rxFragmentMaxPacketId) - 1;
+    return (_rxFragmentReceivedMask & all) == all;
+}
+
 uint8_t InverterAbstract::verifyAllFragments(CommandAbstract& cmd)
 {
     // All missing
@@ -248,28 +331,33 @@ uint8_t InverterAbstract::verifyAllFragments(CommandAbstract& cmd)
         }
     }
 
-    // Last fragment is missing (the one with 0x80)
+    // the last fragment (the one with 0x80) is requested first, as it tells
+    // the number of fragments. the gaps follow in ascending order.
+    uint8_t missingId = 0;
     if (_rxFragmentMaxPacketId == 0) {
         Hoymiles.getMessageOutput()->println("Last missing");
-        if (_rxFragmentRetransmitCnt++ < cmd.getMaxRetransmitCount()) {
-            return _rxFragmentLastPacketId + 1;
-        } else {
+        missingId = _rxFragmentLastPacketId + 1;
+    } else {
+        const uint16_t missing = ~_rxFragmentReceivedMask & ((1 << _rxFragmentMaxPacketId) - 1);
+        if (missing != 0) {
+            Hoymiles.getMessageOutput()->println("Middle missing");
+            missingId = __builtin_ctz(missing) + 1;
+        }
+    }
+
+    if (missingId != 0) {
+        if (_rxFragmentRetransmitCnt++ >= cmd.getMaxRetransmitCount()) {
             cmd.gotTimeout();
             return FRAGMENT_RETRANSMIT_TIMEOUT;
         }
-    }
 
-    // Middle fragment is missing
-    for (uint8_t i = 0; i < _rxFragmentMaxPacketId - 1; i++) {
-        if (!_rxFragmentBuffer[i].wasReceived) {
-            Hoymiles.getMessageOutput()->println("Middle missing");
-            if (_rxFragmentRetransmitCnt++ < cmd.getMaxRetransmitCount()) {
-                return i + 1;
-            } else {
-                cmd.gotTimeout();
-                return FRAGMENT_RETRANSMIT_TIMEOUT;
-            }
+        const uint16_t bit = 1 << (missingId - 1);
+        if ((_rxFragmentRequestedMask & bit) == 0) {
+            _rxFragmentRequestedMask |= bit;
+            RadioStats.LostFragments[missingId - 1]++;
         }
+        _rxFragmentRequestedId = missingId;
+        return missingId;
     }
 
     if (!cmd.handleResponse(_rxFragmentBuffer, _rxFragmentMaxPacketId)) {
@@ -297,6 +385,7 @@ void InverterAbstract::performDailyTask()
 void InverterAbstract::resetRadioStats()
 {
     RadioStats = {};
+    Transactions.reset();
 }
 
 std::vector<ChannelNum_t> InverterAbstract::getChannelsDC() const
@@ -9,10 +9,14 @@
 #include "../parser/StatisticsParser.h"
 #include "../parser/SystemConfigParaParser.h"
 #include "HoymilesRadio.h"
+#include "RxTimeoutEstimator.h"
+#include "TransactionStats.h"
 #include "types.h"
 #include <Arduino.h>
+#include <array>
 #include <cstdint>
 #include <list>
+#include <optional>
 
 #define MAX_NAME_LENGTH 32
 
@@ -53,6 +57,7 @@ public:
     virtual String typeName() const = 0;
     virtual const byteAssign_t* getByteAssignment() const = 0;
     virtual uint8_t getByteAssignmentSize() const = 0;
+    virtual const StatisticsParser::AssignmentIndex* getByteAssignmentIndex() const = 0;
 
     virtual const channelMetaData_t* getChannelMetaData() const = 0;
     virtual uint8_t getChannelMetaDataSize() const = 0;
@@ -66,6 +71,17 @@ public:
     void setEnableCommands(const bool enabled);
     bool getEnableCommands() const;
 
+    // inverters with high poll priority are polled as often as the global
+    // poll interval permits, other inverters take turns.
+    void setHighPollPriority(const bool enabled);
+    bool getHighPollPriority() const;
+
+    // bookkeeping of the poll scheduler. the effective poll interval is
+    // the average time between two polls that requested new stats.
+    uint32_t getLastPoll() const;
+    void setLastPoll(const uint32_t lastPoll, const bool polled);
+    uint32_t getEffectivePollInterval() const;
+
     void setReachableThreshold(const uint8_t threshold);
     uint8_t getReachableThreshold() const;
 
@@ -81,7 +97,14 @@ public:
     int8_t getLastRssi() const;
 
     void clearRxFragmentBuffer();
-    void addRxFragment(const uint8_t fragment[], const uint8_t len, const int8_t rssi);
+    void addRxFragment(const uint8_t fragment[], const uint8_t len, const int8_t rssi, const uint32_t rxMillis);
+    // the time the first and the last fragment were received since the
+    // buffer was cleared
+    std::optional<uint32_t> getFirstRxFragmentMillis() const;
+    std::optional<uint32_t> getLastRxFragmentMillis() const;
+    // whether all fragments of the response, or the fragment requested by
+    // the last retransmit, were received, such that the RX period can end
+    bool isRxPeriodComplete() const;
     uint8_t verifyAllFragments(CommandAbstract& cmd);
 
     void performDailyTask();
@@ -106,14 +129,28 @@ public:
 
         // RX Fail Corrupt Data
         uint32_t RxFailCorruptData;
+
+        // how often each fragment (by id - 1) was missing and re-requested
+        std::array<uint32_t, MAX_RF_FRAGMENT_COUNT> LostFragments;
     } RadioStats = {};
 
+    // percentage of the requests on each TX channel of the radio which were
+    // answered by this inverter, as exponential moving average. it is kept
+    // in RAM only and starts neutral for all channels.
+    std::array<uint8_t, HOY_TX_CHANNEL_COUNT> TxChannelQuality;
+
+    TransactionStats Transactions;
+
+    RxTimeoutEstimator RxTimeouts;
+
     virtual bool sendStatsRequest() = 0;
     virtual bool sendAlarmLogRequest(const bool force = false) = 0;
     virtual bool sendDevInfoRequest() = 0;
     virtual bool sendSystemConfigParaRequest() = 0;
     virtual bool sendActivePowerControlRequest(float limit, const PowerLimitControlType type) = 0;
     virtual bool resendActivePowerControlRequest() = 0;
+    // called by the radio once the limit command in flight completed
+    virtual void activePowerControlCompleted() = 0;
     virtual bool sendPowerControlRequest(const bool turnOn) = 0;
     virtual bool sendRestartControlRequest() = 0;
     virtual bool resendPowerControlRequest() = 0;
@@ -147,10 +184,21 @@ private:
     uint8_t _rxFragmentMaxPacketId = 0;
     uint8_t _rxFragmentLastPacketId = 0;
     uint8_t _rxFragmentRetransmitCnt = 0;
+    // bit (id - 1) is set for each fragment id received or re-requested
+    uint16_t _rxFragmentReceivedMask = 0;
+    uint16_t _rxFragmentRequestedMask = 0;
+    uint8_t _rxFragmentRequestedId = 0; // of the pending retransmit
+    std::optional<uint32_t> _rxFirstFragmentMillis;
+    std::optional<uint32_t> _rxLastFragmentMillis;
 
     bool _enablePolling = true;
     bool _enableCommands = true;
 
+    bool _highPollPriority = false;
+    uint32_t _lastPoll = 0;
+    uint32_t _lastStatsPoll = 0;
+    uint32_t _effectivePollInterval = 0;
+
     uint8_t _reachableThreshold = 3;
 
     bool _zeroValuesIfUnreachable = false;
@@ -200,6 +200,7 @@ void AlarmLogParser::clearBuffer()
 {
     memset(_payloadAlarmLog, 0, ALARM_LOG_PAYLOAD_SIZE);
     _alarmLogLength = 0;
+    _entriesValid = false;
 }
 
 void AlarmLogParser::appendFragment(const uint8_t offset, const uint8_t* payload, const uint8_t len)
@@ -210,6 +211,57 @@ void AlarmLogParser::appendFragment(const uint8_t offset, const uint8_t* payload
     }
     memcpy(&_payloadAlarmLog[offset], payload, len);
     _alarmLogLength += len;
+    _entriesValid = false;
+}
+
+bool AlarmLogParser::containsEntry(const uint8_t* entry) const
+{
+    for (uint8_t i = 0; i < getEntryCount(); i++) {
+        if (memcmp(&_payloadAlarmLog[2 + i * ALARM_LOG_ENTRY_SIZE], entry, ALARM_LOG_ENTRY_SIZE) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void AlarmLogParser::mergeEntries(const uint8_t* payload, const uint8_t len)
+{
+    if (len < 2) {
+        return;
+    }
+
+    if (len > ALARM_LOG_PAYLOAD_SIZE) {
+        Hoymiles.getMessageOutput()->printf("FATAL: (%s, %d) stats packet too large for buffer (%d > %d)\r\n", __FILE__, __LINE__, len, ALARM_LOG_PAYLOAD_SIZE);
+        return;
+    }
+
+    uint8_t count = getEntryCount();
+    const uint8_t newCount = (len - 2) / ALARM_LOG_ENTRY_SIZE;
+
+    memcpy(_payloadAlarmLog, payload, 2);
+
+    // entries which are held already are skipped, such that a complete log
+    // sent by the inverter is merged as well. the oldest entries are dropped
+    // once the log is full.
+    for (uint8_t i = 0; i < newCount; i++) {
+        const uint8_t* entry = &payload[2 + i * ALARM_LOG_ENTRY_SIZE];
+        if (containsEntry(entry)) {
+            continue;
+        }
+
+        if (count == ALARM_LOG_ENTRY_COUNT) {
+            memmove(&_payloadAlarmLog[2], &_payloadAlarmLog[2 + ALARM_LOG_ENTRY_SIZE], (ALARM_LOG_ENTRY_COUNT - 1) * ALARM_LOG_ENTRY_SIZE);
+            count--;
+        }
+
+        memcpy(&_payloadAlarmLog[2 + count * ALARM_LOG_ENTRY_SIZE], entry, ALARM_LOG_ENTRY_SIZE);
+        count++;
+        _alarmLogLength = 2 + count * ALARM_LOG_ENTRY_SIZE + 2;
+    }
+
+    // the merged log ends with a (zeroed) checksum like a received one
+    memset(&_payloadAlarmLog[2 + count * ALARM_LOG_ENTRY_SIZE], 0, 2);
+    _entriesValid = false;
 }
 
 uint8_t AlarmLogParser::getEntryCount() const
@@ -232,63 +284,107 @@ LastCommandSuccess AlarmLogParser::getLastAlarmRequestSuccess() const
 
 void AlarmLogParser::setMessageType(const AlarmMessageType_t type)
 {
+    HOY_SEMAPHORE_TAKE();
     _messageType = type;
+    _entriesValid = false;
+    HOY_SEMAPHORE_GIVE();
+}
+
+const AlarmMessage_t* AlarmLogParser::findMessage(const uint16_t messageId) const
+{
+    const AlarmMessage_t* result = nullptr;
+
+    for (auto& msg : _alarmMessages) {
+        if (msg.MessageId == messageId) {
+            if (msg.InverterType == _messageType) {
+                return &msg;
+            } else if (msg.InverterType == AlarmMessageType_t::ALL) {
+                result = &msg;
+            }
+        }
+    }
+
+    return result;
+}
+
+// must be called while holding the semaphore
+void AlarmLogParser::decodeEntries()
+{
+    for (uint8_t entryId = 0; entryId < getEntryCount(); entryId++) {
+        const uint8_t entryStartOffset = 2 + entryId * ALARM_LOG_ENTRY_SIZE;
+        auto& entry = _entries[entryId];
+
+        const uint32_t wcode = static_cast<uint16_t>(_payloadAlarmLog[entryStartOffset]) << 8 | _payloadAlarmLog[entryStartOffset + 1];
+        uint32_t startTimeOffset = 0;
+        if (((wcode >> 13) & 0x01) == 1) {
+            startTimeOffset = 12 * 60 * 60;
+        }
+
+        uint32_t endTimeOffset = 0;
+        if (((wcode >> 12) & 0x01) == 1) {
+            endTimeOffset = 12 * 60 * 60;
+        }
+
+        entry.MessageId = _payloadAlarmLog[entryStartOffset + 1];
+        entry.StartTime = ((static_cast<uint16_t>(_payloadAlarmLog[entryStartOffset + 4]) << 8) | static_cast<uint16_t>(_payloadAlarmLog[entryStartOffset + 5])) + startTimeOffset;
+        entry.EndTime = (static_cast<uint16_t>(_payloadAlarmLog[entryStartOffset + 6]) << 8) | static_cast<uint16_t>(_payloadAlarmLog[entryStartOffset + 7]);
+        if (entry.EndTime > 0) {
+            entry.EndTime += endTimeOffset;
+        }
+
+        entry.Message = findMessage(entry.MessageId);
+    }
+
+    _entriesValid = true;
 }
 
 void AlarmLogParser::getLogEntry(const uint8_t entryId, AlarmLogEntry_t& entry, const AlarmMessageLocale_t locale)
 {
-    const uint8_t entryStartOffset = 2 + entryId * ALARM_LOG_ENTRY_SIZE;
+    if (entryId >= ALARM_LOG_ENTRY_COUNT) {
+        return;
+    }
 
     const int timezoneOffset = getTimezoneOffset();
 
     HOY_SEMAPHORE_TAKE();
 
-    const uint32_t wcode = static_cast<uint16_t>(_payloadAlarmLog[entryStartOffset]) << 8 | _payloadAlarmLog[entryStartOffset + 1];
-    uint32_t startTimeOffset = 0;
-    if (((wcode >> 13) & 0x01) == 1) {
-        startTimeOffset = 12 * 60 * 60;
+    if (!_entriesValid) {
+        decodeEntries();
     }
 
-    uint32_t endTimeOffset = 0;
-    if (((wcode >> 12) & 0x01) == 1) {
-        endTimeOffset = 12 * 60 * 60;
-    }
-
-    entry.MessageId = _payloadAlarmLog[entryStartOffset + 1];
-    entry.StartTime = ((static_cast<uint16_t>(_payloadAlarmLog[entryStartOffset + 4]) << 8) | static_cast<uint16_t>(_payloadAlarmLog[entryStartOffset + 5])) + startTimeOffset + timezoneOffset;
-    entry.EndTime = (static_cast<uint16_t>(_payloadAlarmLog[entryStartOffset + 6]) << 8) | static_cast<uint16_t>(_payloadAlarmLog[entryStartOffset + 7]);
+    const auto& decoded = _entries[entryId];
+    entry.MessageId = decoded.MessageId;
+    entry.StartTime = decoded.StartTime + timezoneOffset;
+    entry.EndTime = decoded.EndTime;
+    const AlarmMessage_t* msg = decoded.Message;
 
     HOY_SEMAPHORE_GIVE();
 
     if (entry.EndTime > 0) {
-        entry.EndTime += (endTimeOffset + timezoneOffset);
+        entry.EndTime += timezoneOffset;
     }
 
-    switch (locale) {
-    case AlarmMessageLocale_t::DE:
-        entry.Message = "Unbekannt";
-        break;
-    case AlarmMessageLocale_t::FR:
-        entry.Message = "Inconnu";
-        break;
-    default:
-        entry.Message = "Unknown";
-    }
+    entry.Message = getLocaleMessage(msg, locale);
+}
 
-    for (auto& msg : _alarmMessages) {
-        if (msg.MessageId == entry.MessageId) {
-            if (msg.InverterType == _messageType) {
-                entry.Message = getLocaleMessage(&msg, locale);
-                break;
-            } else if (msg.InverterType == AlarmMessageType_t::ALL) {
-                entry.Message = getLocaleMessage(&msg, locale);
-            }
-        }
-    }
+String AlarmLogParser::getMessage(const uint16_t messageId, const AlarmMessageLocale_t locale) const
+{
+    return getLocaleMessage(findMessage(messageId), locale);
 }
 
-String AlarmLogParser::getLocaleMessage(const AlarmMessage_t* msg, const AlarmMessageLocale_t locale) const
+String AlarmLogParser::getLocaleMessage(const AlarmMessage_t* msg, const AlarmMessageLocale_t locale)
 {
+    if (msg == nullptr) {
+        switch (locale) {
+        case AlarmMessageLocale_t::DE:
+            return "Unbekannt";
+        case AlarmMessageLocale_t::FR:
+            return "Inconnu";
+        default:
+            return "Unknown";
+        }
+    }
+
     if (locale == AlarmMessageLocale_t::DE) {
         return msg->Message_de[0] != '\0' ? msg->Message_de : msg->Message_en;
     }
@@ -302,6 +398,12 @@ String AlarmLogParser::getLocaleMessage(const AlarmMessage_t* msg, const AlarmMe
 
 int AlarmLogParser::getTimezoneOffset()
 {
+    // the offset only changes with daylight saving time. it is determined
+    // at most once a minute instead of for every entry.
+    if (_timezoneOffsetUpdate > 0 && millis() - _timezoneOffsetUpdate < 60 * 1000) {
+        return _timezoneOffset;
+    }
+
     // see: https://stackoverflow.com/questions/13804095/get-the-time-zone-gmt-offset-in-c/44063597#44063597
 
     time_t gmt, rawtime = time(NULL);
@@ -314,5 +416,7 @@ int AlarmLogParser::getTimezoneOffset()
     ptm->tm_isdst = -1;
     gmt = mktime(ptm);
 
-    return static_cast<int>(difftime(rawtime, gmt));
+    _timezoneOffset = static_cast<int>(difftime(rawtime, gmt));
+    _timezoneOffsetUpdate = millis();
+    return _timezoneOffset;
 }
@@ -42,21 +42,46 @@ public:
     void clearBuffer();
     void appendFragment(const uint8_t offset, const uint8_t* payload, const uint8_t len);
 
+    // adds the entries of an incrementally requested log to the held ones
+    void mergeEntries(const uint8_t* payload, const uint8_t len);
+
     uint8_t getEntryCount() const;
     void getLogEntry(const uint8_t entryId, AlarmLogEntry_t& entry, const AlarmMessageLocale_t locale = AlarmMessageLocale_t::EN);
 
+    // the text of the message with the given id, e.g., of an entry which
+    // was stored elsewhere
+    String getMessage(const uint16_t messageId, const AlarmMessageLocale_t locale = AlarmMessageLocale_t::EN) const;
+
     void setLastAlarmRequestSuccess(const LastCommandSuccess status);
     LastCommandSuccess getLastAlarmRequestSuccess() const;
 
     void setMessageType(const AlarmMessageType_t type);
 
 private:
-    static int getTimezoneOffset();
-    String getLocaleMessage(const AlarmMessage_t* msg, const AlarmMessageLocale_t locale) const;
+    // an entry as decoded from the payload, without the timezone offset
+    struct DecodedEntry_t {
+        uint16_t MessageId;
+        time_t StartTime;
+        time_t EndTime;
+        const AlarmMessage_t* Message;
+    };
+
+    int getTimezoneOffset();
+    void decodeEntries();
+    const AlarmMessage_t* findMessage(const uint16_t messageId) const;
+    bool containsEntry(const uint8_t* entry) const;
+    static String getLocaleMessage(const AlarmMessage_t* msg, const AlarmMessageLocale_t locale);
 
     uint8_t _payloadAlarmLog[ALARM_LOG_PAYLOAD_SIZE];
     uint8_t _alarmLogLength = 0;
 
+    // the entries are decoded once per received payload, on first access
+    std::array<DecodedEntry_t, ALARM_LOG_ENTRY_COUNT> _entries;
+    bool _entriesValid = false;
+
+    int _timezoneOffset = 0;
+    uint32_t _timezoneOffsetUpdate = 0;
+
     LastCommandSuccess _lastAlarmRequestSuccess = CMD_NOK; // Set to NOK to fetch at startup
 
     AlarmMessageType_t _messageType = AlarmMessageType_t::ALL;
@@ -110,6 +110,15 @@ void DevInfoParser::appendFragmentAll(const uint8_t offset, const uint8_t* paylo
     _devInfoAllLength += len;
 }
 
+uint8_t DevInfoParser::getPayloadAll(uint8_t* buffer) const
+{
+    HOY_SEMAPHORE_TAKE();
+    memcpy(buffer, _payloadDevInfoAll, DEV_INFO_SIZE);
+    const uint8_t len = _devInfoAllLength;
+    HOY_SEMAPHORE_GIVE();
+    return len;
+}
+
 void DevInfoParser::clearBufferSimple()
 {
     memset(_payloadDevInfoSimple, 0, DEV_INFO_SIZE);
@@ -126,6 +135,15 @@ void DevInfoParser::appendFragmentSimple(const uint8_t offset, const uint8_t* pa
     _devInfoSimpleLength += len;
 }
 
+uint8_t DevInfoParser::getPayloadSimple(uint8_t* buffer) const
+{
+    HOY_SEMAPHORE_TAKE();
+    memcpy(buffer, _payloadDevInfoSimple, DEV_INFO_SIZE);
+    const uint8_t len = _devInfoSimpleLength;
+    HOY_SEMAPHORE_GIVE();
+    return len;
+}
+
 uint32_t DevInfoParser::getLastUpdateAll() const
 {
     return _lastUpdateAll;
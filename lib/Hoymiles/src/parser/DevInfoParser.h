@@ -9,9 +9,13 @@ public:
     DevInfoParser();
     void clearBufferAll();
     void appendFragmentAll(const uint8_t offset, const uint8_t* payload, const uint8_t len);
+    // copies the raw payload into a buffer of DEV_INFO_SIZE bytes and
+    // returns its length
+    uint8_t getPayloadAll(uint8_t* buffer) const;
 
     void clearBufferSimple();
     void appendFragmentSimple(const uint8_t offset, const uint8_t* payload, const uint8_t len);
+    uint8_t getPayloadSimple(uint8_t* buffer) const;
 
     uint32_t getLastUpdateAll() const;
     void setLastUpdateAll(const uint32_t lastUpdate);
@@ -372,6 +372,7 @@ void GridProfileParser::clearBuffer()
 {
     memset(_payloadGridProfile, 0, GRID_PROFILE_SIZE);
     _gridProfileLength = 0;
+    _profileValid = false;
 }
 
 void GridProfileParser::appendFragment(const uint8_t offset, const uint8_t* payload, const uint8_t len)
@@ -382,6 +383,7 @@ void GridProfileParser::appendFragment(const uint8_t offset, const uint8_t* payl
     }
     memcpy(&_payloadGridProfile[offset], payload, len);
     _gridProfileLength += len;
+    _profileValid = false;
 }
 
 String GridProfileParser::getProfileName() const
@@ -416,7 +418,22 @@ std::vector<uint8_t> GridProfileParser::getRawData() const
 
 std::list<GridProfileSection_t> GridProfileParser::getProfile() const
 {
-    std::list<GridProfileSection_t> l;
+    HOY_SEMAPHORE_TAKE();
+    if (!_profileValid) {
+        decodeProfile();
+    }
+    auto l = _profile;
+    HOY_SEMAPHORE_GIVE();
+
+    return l;
+}
+
+// must be called while holding the semaphore
+void GridProfileParser::decodeProfile() const
+{
+    auto& l = _profile;
+    l.clear();
+    _profileValid = true;
 
     if (_gridProfileLength > 4) {
         uint16_t pos = 4;
@@ -459,8 +476,6 @@ std::list<GridProfileSection_t> GridProfileParser::getProfile() const
 
         } while (pos < _gridProfileLength);
     }
-
-    return l;
 }
 
 bool GridProfileParser::containsValidData() const
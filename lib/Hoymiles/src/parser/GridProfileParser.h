@@ -19,14 +19,15 @@ struct GridProfileValue_t {
     uint8_t ItemDefinition;
 };
 
+// the names point to constant strings, which do not need to be copied
 struct GridProfileItem_t {
-    String Name;
-    String Unit;
+    const char* Name;
+    const char* Unit;
     float Value;
 };
 
 struct GridProfileSection_t {
-    String SectionName;
+    const char* SectionName;
     std::list<GridProfileItem_t> items;
 };
 
@@ -48,10 +49,15 @@ public:
 private:
     static uint8_t getSectionSize(const uint8_t section_id, const uint8_t section_version);
     static int16_t getSectionStart(const uint8_t section_id, const uint8_t section_version);
+    void decodeProfile() const;
 
     uint8_t _payloadGridProfile[GRID_PROFILE_SIZE] = {};
     uint8_t _gridProfileLength = 0;
 
+    // the profile is decoded once per received payload, on first access
+    mutable std::list<GridProfileSection_t> _profile;
+    mutable bool _profileValid = false;
+
     static const std::array<const ProfileType_t, PROFILE_TYPE_COUNT> _profileTypes;
     static const std::array<const GridProfileValue_t, SECTION_VALUE_COUNT> _profileValues;
 };
@@ -4,6 +4,7 @@
  */
 #include "StatisticsParser.h"
 #include "../Hoymiles.h"
+#include <algorithm>
 
 static float calcTotalYieldTotal(StatisticsParser* iv, uint8_t arg0);
 static float calcTotalYieldDay(StatisticsParser* iv, uint8_t arg0);
@@ -62,28 +63,35 @@ StatisticsParser::StatisticsParser()
     clearBuffer();
 }
 
-void StatisticsParser::setByteAssignment(const byteAssign_t* byteAssignment, const uint8_t size)
+void StatisticsParser::setByteAssignment(const byteAssign_t* byteAssignment, const uint8_t size, const AssignmentIndex* index)
 {
     _byteAssignment = byteAssignment;
     _byteAssignmentSize = size;
+    _assignmentIndex = index;
 
-    for (uint8_t i = 0; i < _byteAssignmentSize; i++) {
-        if (_byteAssignment[i].div == CMD_CALC) {
-            continue;
-        }
-        _expectedByteCount = max<uint8_t>(_expectedByteCount, _byteAssignment[i].start + _byteAssignment[i].num);
-    }
+    HOY_SEMAPHORE_TAKE();
+    _valueCache.assign(_byteAssignmentSize, 0);
+    _valueCached.assign(_byteAssignmentSize, false);
+    _cacheGeneration++;
+    HOY_SEMAPHORE_GIVE();
 }
 
 uint8_t StatisticsParser::getExpectedByteCount()
 {
-    return _expectedByteCount;
+    return (_assignmentIndex != nullptr) ? _assignmentIndex->expectedByteCount : 0;
+}
+
+void StatisticsParser::beginAppendFragment()
+{
+    Parser::beginAppendFragment();
+    beginWriteBackBuffer();
 }
 
 void StatisticsParser::clearBuffer()
 {
-    memset(_payloadStatistic, 0, STATISTIC_PACKET_SIZE);
-    _statisticLength = 0;
+    const uint8_t back = (_publishCount + 1) & 1;
+    memset(_payloadStatistic[back], 0, STATISTIC_PACKET_SIZE);
+    _statisticLength[back] = 0;
 }
 
 void StatisticsParser::appendFragment(const uint8_t offset, const uint8_t* payload, const uint8_t len)
@@ -92,42 +100,56 @@ void StatisticsParser::appendFragment(const uint8_t offset, const uint8_t* paylo
         Hoymiles.getMessageOutput()->printf("FATAL: (%s, %d) stats packet too large for buffer\r\n", __FILE__, __LINE__);
         return;
     }
-    memcpy(&_payloadStatistic[offset], payload, len);
-    _statisticLength += len;
+    const uint8_t back = (_publishCount + 1) & 1;
+    memcpy(&_payloadStatistic[back][offset], payload, len);
+    _statisticLength[back] += len;
 }
 
 void StatisticsParser::endAppendFragment()
 {
+    // the semaphore is still held since beginAppendFragment()
+    publishBackBuffer();
     Parser::endAppendFragment();
 
     if (!_enableYieldDayCorrection) {
         resetYieldDayCorrection();
-        return;
-    }
-
-    for (auto& c : getChannelsByType(TYPE_DC)) {
-        // check if current yield day is smaller then last cached yield day
-        if (getChannelFieldValue(TYPE_DC, c, FLD_YD) < _lastYieldDay[static_cast<uint8_t>(c)]) {
-            // currently all values are zero --> Add last known values to offset
-            Hoymiles.getMessageOutput()->printf("Yield Day reset detected!\r\n");
+    } else {
+        for (auto& c : getChannelsByType(TYPE_DC)) {
+            // check if current yield day is smaller then last cached yield day
+            if (getChannelFieldValue(TYPE_DC, c, FLD_YD) < _lastYieldDay[static_cast<uint8_t>(c)]) {
+                // currently all values are zero --> Add last known values to offset
+                Hoymiles.getMessageOutput()->printf("Yield Day reset detected!\r\n");
 
-            setChannelFieldOffset(TYPE_DC, c, FLD_YD, _lastYieldDay[static_cast<uint8_t>(c)]);
+                setChannelFieldOffset(TYPE_DC, c, FLD_YD, _lastYieldDay[static_cast<uint8_t>(c)]);
 
-            _lastYieldDay[static_cast<uint8_t>(c)] = 0;
-        } else {
-            _lastYieldDay[static_cast<uint8_t>(c)] = getChannelFieldValue(TYPE_DC, c, FLD_YD);
+                _lastYieldDay[static_cast<uint8_t>(c)] = 0;
+            } else {
+                _lastYieldDay[static_cast<uint8_t>(c)] = getChannelFieldValue(TYPE_DC, c, FLD_YD);
+            }
         }
     }
+
+    // the snapshot includes the yield day correction
+    const uint32_t acquiredMillis = (_acquiredMillis > 0) ? _acquiredMillis : millis();
+    _acquiredMillis = 0;
+    publishSnapshot(acquiredMillis);
+}
+
+uint8_t StatisticsParser::getAssignmentIndex(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId) const
+{
+    if (_assignmentIndex == nullptr || type >= TYPE_COUNT || channel >= CH_CNT || fieldId >= FIELD_COUNT) {
+        return INVALID_INDEX;
+    }
+    return _assignmentIndex->index[type][channel][fieldId];
 }
 
 const byteAssign_t* StatisticsParser::getAssignmentByChannelField(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId) const
 {
-    for (uint8_t i = 0; i < _byteAssignmentSize; i++) {
-        if (_byteAssignment[i].type == type && _byteAssignment[i].ch == channel && _byteAssignment[i].fieldId == fieldId) {
-            return &_byteAssignment[i];
-        }
+    const uint8_t index = getAssignmentIndex(type, channel, fieldId);
+    if (index == INVALID_INDEX) {
+        return nullptr;
     }
-    return nullptr;
+    return &_byteAssignment[index];
 }
 
 fieldSettings_t* StatisticsParser::getSettingByChannelField(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId)
@@ -142,24 +164,41 @@ fieldSettings_t* StatisticsParser::getSettingByChannelField(const ChannelType_t
 
 float StatisticsParser::getChannelFieldValue(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId)
 {
-    const byteAssign_t* pos = getAssignmentByChannelField(type, channel, fieldId);
-    if (pos == nullptr) {
+    const uint8_t index = getAssignmentIndex(type, channel, fieldId);
+    if (index == INVALID_INDEX) {
         return 0;
     }
 
-    uint8_t ptr = pos->start;
-    const uint8_t end = ptr + pos->num;
+    HOY_SEMAPHORE_TAKE();
+    if (_valueCached[index]) {
+        const float value = _valueCache[index];
+        HOY_SEMAPHORE_GIVE();
+        return value;
+    }
+    const uint32_t generation = _cacheGeneration;
+    HOY_SEMAPHORE_GIVE();
+
+    const float value = calcChannelFieldValue(&_byteAssignment[index], type, channel, fieldId);
+
+    // do not cache a value decoded from data which changed meanwhile
+    HOY_SEMAPHORE_TAKE();
+    if (generation == _cacheGeneration) {
+        _valueCache[index] = value;
+        _valueCached[index] = true;
+    }
+    HOY_SEMAPHORE_GIVE();
+
+    return value;
+}
+
+float StatisticsParser::calcChannelFieldValue(const byteAssign_t* pos, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId)
+{
     const uint16_t div = pos->div;
 
     if (CMD_CALC != div) {
         // Value is a static value
-        uint32_t val = 0;
-        HOY_SEMAPHORE_TAKE();
-        do {
-            val <<= 8;
-            val |= _payloadStatistic[ptr];
-        } while (++ptr != end);
-        HOY_SEMAPHORE_GIVE();
+        uint8_t statisticLength;
+        const uint32_t val = readPayload(pos->start, pos->num, statisticLength);
 
         float result;
         if (pos->isSigned && pos->num == 2) {
@@ -173,7 +212,7 @@ float StatisticsParser::getChannelFieldValue(const ChannelType_t type, const Cha
         result /= static_cast<float>(div);
 
         const fieldSettings_t* setting = getSettingByChannelField(type, channel, fieldId);
-        if (setting != nullptr && _statisticLength > 0) {
+        if (setting != nullptr && statisticLength > 0) {
             result += setting->offset;
         }
         return result;
@@ -216,10 +255,16 @@ bool StatisticsParser::setChannelFieldValue(const ChannelType_t type, const Chan
     }
 
     HOY_SEMAPHORE_TAKE();
+    beginWriteBackBuffer();
+    const uint8_t front = _publishCount & 1;
+    const uint8_t back = front ^ 1;
+    memcpy(_payloadStatistic[back], _payloadStatistic[front], STATISTIC_PACKET_SIZE);
+    _statisticLength[back] = _statisticLength[front];
     do {
-        _payloadStatistic[ptr] = val;
+        _payloadStatistic[back][ptr] = val;
         val >>= 8;
     } while (--ptr >= end);
+    publishBackBuffer();
     HOY_SEMAPHORE_GIVE();
 
     return true;
@@ -273,6 +318,10 @@ void StatisticsParser::setChannelFieldOffset(const ChannelType_t type, const Cha
     } else {
         _fieldSettings.push_back({ type, channel, fieldId, offset });
     }
+
+    HOY_SEMAPHORE_TAKE();
+    invalidateValueCache();
+    HOY_SEMAPHORE_GIVE();
 }
 
 std::list<ChannelType_t> StatisticsParser::getChannelTypes() const
@@ -310,6 +359,10 @@ void StatisticsParser::setStringMaxPower(const uint8_t channel, const uint16_t p
 {
     if (channel < sizeof(_stringMaxPower) / sizeof(_stringMaxPower[0])) {
         _stringMaxPower[channel] = power;
+
+        HOY_SEMAPHORE_TAKE();
+        invalidateValueCache();
+        HOY_SEMAPHORE_GIVE();
     }
 }
 
@@ -342,6 +395,35 @@ void StatisticsParser::setLastUpdate(const uint32_t lastUpdate)
 {
     Parser::setLastUpdate(lastUpdate);
     setLastUpdateFromInternal(lastUpdate);
+    Hoymiles.notifyStatisticsUpdate();
+}
+
+void StatisticsParser::setAcquiredMillis(const uint32_t acquiredMillis)
+{
+    _acquiredMillis = acquiredMillis;
+}
+
+std::shared_ptr<const StatisticsSnapshot> StatisticsParser::getSnapshot() const
+{
+    return std::atomic_load(&_snapshot);
+}
+
+void StatisticsParser::publishSnapshot(const uint32_t acquiredMillis)
+{
+    auto snapshot = std::make_shared<StatisticsSnapshot>();
+    snapshot->_sequence = ++_snapshotSequence;
+    snapshot->_acquiredMillis = acquiredMillis;
+    snapshot->_index = _assignmentIndex;
+
+    // decoded through the value cache, which the snapshot makes redundant
+    // for most readers
+    snapshot->_values.resize(_byteAssignmentSize);
+    for (uint8_t i = 0; i < _byteAssignmentSize; i++) {
+        const byteAssign_t& assignment = _byteAssignment[i];
+        snapshot->_values[i] = getChannelFieldValue(assignment.type, assignment.ch, assignment.fieldId);
+    }
+
+    std::atomic_store(&_snapshot, std::shared_ptr<const StatisticsSnapshot>(std::move(snapshot)));
 }
 
 uint32_t StatisticsParser::getLastUpdateFromInternal() const
@@ -377,6 +459,49 @@ void StatisticsParser::zeroFields(const FieldId_t* fields)
         }
     }
     setLastUpdateFromInternal(millis());
+    publishSnapshot(millis());
+}
+
+void StatisticsParser::invalidateValueCache()
+{
+    std::fill(_valueCached.begin(), _valueCached.end(), false);
+    _cacheGeneration++;
+}
+
+void StatisticsParser::beginWriteBackBuffer()
+{
+    // the back buffer might still be read by readers which started before
+    // the previous publish
+    _writeCount = _publishCount.load();
+}
+
+void StatisticsParser::publishBackBuffer()
+{
+    _publishCount++;
+    invalidateValueCache();
+}
+
+uint32_t StatisticsParser::readPayload(const uint8_t start, const uint8_t num, uint8_t& statisticLength) const
+{
+    uint32_t val;
+    uint32_t published;
+
+    do {
+        published = _publishCount;
+        const uint8_t* payload = _payloadStatistic[published & 1];
+
+        val = 0;
+        for (uint8_t ptr = start; ptr < start + num; ptr++) {
+            val <<= 8;
+            val |= payload[ptr];
+        }
+        statisticLength = _statisticLength[published & 1];
+
+        // the buffer becomes the back buffer with the next publish and
+        // is overwritten once a write starts after that publish
+    } while (_writeCount > published);
+
+    return val;
 }
 
 void StatisticsParser::resetYieldDayCorrection()
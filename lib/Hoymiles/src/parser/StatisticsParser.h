@@ -1,8 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 #include "Parser.h"
+#include <atomic>
 #include <cstdint>
 #include <list>
+#include <memory>
+#include <vector>
 
 #define STATISTIC_PACKET_SIZE (7 * 16)
 
@@ -102,14 +105,64 @@ typedef struct {
     float offset; // offset (positive/negative) to be applied on the fetched value
 } fieldSettings_t;
 
+class StatisticsSnapshot;
+
 class StatisticsParser : public Parser {
 public:
+    static constexpr uint8_t TYPE_COUNT = TYPE_INV + 1;
+    static constexpr uint8_t FIELD_COUNT = FLD_IAC_3 + 1;
+    static constexpr uint8_t INVALID_INDEX = 0xff;
+
+    // index into a byte assignment table for each type, channel and field,
+    // such that lookups do not search the table
+    struct AssignmentIndex {
+        uint8_t index[TYPE_COUNT][CH_CNT][FIELD_COUNT];
+        uint8_t expectedByteCount;
+    };
+
+    // builds the index of a byte assignment table at compile time
+    template <size_t N>
+    static constexpr AssignmentIndex buildAssignmentIndex(const byteAssign_t (&byteAssignment)[N])
+    {
+        static_assert(N < INVALID_INDEX, "too many byte assignments");
+
+        AssignmentIndex result = {};
+        for (auto& channels : result.index) {
+            for (auto& fields : channels) {
+                for (auto& index : fields) {
+                    index = INVALID_INDEX;
+                }
+            }
+        }
+
+        for (uint8_t i = 0; i < N; i++) {
+            const byteAssign_t& assignment = byteAssignment[i];
+            if (assignment.type < TYPE_COUNT && assignment.ch < CH_CNT && assignment.fieldId < FIELD_COUNT) {
+                // keep the first match, like the linear search did
+                uint8_t& index = result.index[assignment.type][assignment.ch][assignment.fieldId];
+                if (index == INVALID_INDEX) {
+                    index = i;
+                }
+            }
+
+            if (assignment.div != CMD_CALC && assignment.start + assignment.num > result.expectedByteCount) {
+                result.expectedByteCount = assignment.start + assignment.num;
+            }
+        }
+
+        return result;
+    }
+
     StatisticsParser();
+
+    // fragments are appended to the back buffer, which becomes the buffer
+    // that is read once all fragments were appended.
+    void beginAppendFragment();
     void clearBuffer();
     void appendFragment(const uint8_t offset, const uint8_t* payload, const uint8_t len);
     void endAppendFragment();
 
-    void setByteAssignment(const byteAssign_t* byteAssignment, const uint8_t size);
+    void setByteAssignment(const byteAssign_t* byteAssignment, const uint8_t size, const AssignmentIndex* index);
 
     // Returns 1 based amount of expected bytes of statistic data
     uint8_t getExpectedByteCount();
@@ -147,6 +200,13 @@ public:
     // Update time when new data from the inverter is received
     void setLastUpdate(const uint32_t lastUpdate);
 
+    // the time the frame which is being appended was received by the radio.
+    // must be set before endAppendFragment(), defaults to the current time.
+    void setAcquiredMillis(const uint32_t acquiredMillis);
+
+    // all values of the latest frame, nullptr until a frame was received
+    std::shared_ptr<const StatisticsSnapshot> getSnapshot() const;
+
     // Update time when internal data structure changes (from inverter and by internal manipulation)
     uint32_t getLastUpdateFromInternal() const;
     void setLastUpdateFromInternal(const uint32_t lastUpdate);
@@ -156,13 +216,41 @@ public:
 private:
     void zeroFields(const FieldId_t* fields);
 
-    uint8_t _payloadStatistic[STATISTIC_PACKET_SIZE] = {};
-    uint8_t _statisticLength = 0;
+    // decodes all values into a new snapshot, which replaces the current one
+    void publishSnapshot(const uint32_t acquiredMillis);
+
+    uint8_t getAssignmentIndex(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId) const;
+    float calcChannelFieldValue(const byteAssign_t* pos, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId);
+
+    // must be called while holding the semaphore
+    void invalidateValueCache();
+
+    // must be called while holding the semaphore, before and after
+    // modifying the back buffer
+    void beginWriteBackBuffer();
+    void publishBackBuffer();
+
+    // reads the value from the front buffer without taking the semaphore
+    uint32_t readPayload(const uint8_t start, const uint8_t num, uint8_t& statisticLength) const;
+
+    // the front buffer is read by everyone, writers modify the back buffer,
+    // which is published by incrementing _publishCount. readers retry if a
+    // writer started to modify the buffer they were reading meanwhile.
+    uint8_t _payloadStatistic[2][STATISTIC_PACKET_SIZE] = {};
+    uint8_t _statisticLength[2] = {};
+    std::atomic<uint32_t> _publishCount = 0; // front buffer is _publishCount & 1
+    std::atomic<uint32_t> _writeCount = 0; // _publishCount when the last write started
     uint16_t _stringMaxPower[CH_CNT];
 
-    const byteAssign_t* _byteAssignment;
-    uint8_t _byteAssignmentSize;
-    uint8_t _expectedByteCount = 0;
+    const byteAssign_t* _byteAssignment = nullptr;
+    uint8_t _byteAssignmentSize = 0;
+    const AssignmentIndex* _assignmentIndex = nullptr;
+
+    // decoded values, indexed like _byteAssignment and invalidated when
+    // the payload, an offset or a string's max power changes
+    std::vector<float> _valueCache;
+    std::vector<bool> _valueCached;
+    uint32_t _cacheGeneration = 0;
     std::list<fieldSettings_t> _fieldSettings;
 
     uint32_t _rxFailureCount = 0;
@@ -170,4 +258,51 @@ private:
 
     bool _enableYieldDayCorrection = false;
     float _lastYieldDay[CH_CNT] = {};
+
+    // accessed with std::atomic_load() and std::atomic_store()
+    std::shared_ptr<const StatisticsSnapshot> _snapshot;
+    std::atomic<uint32_t> _snapshotSequence = 0;
+    uint32_t _acquiredMillis = 0;
+};
+
+// the values of one statistics frame, decoded once when the frame was
+// completed, such that all consumers share the decode. a snapshot never
+// changes, so its values are consistent and can be read without locking
+// while the parser receives the next frame. values which are zeroed
+// internally, e.g., at night, are published as a new snapshot as well.
+class StatisticsSnapshot {
+public:
+    // increments with every snapshot of the parser
+    uint32_t getSequence() const { return _sequence; }
+
+    // when the frame was received, or when the values were zeroed
+    uint32_t getAcquiredMillis() const { return _acquiredMillis; }
+
+    bool hasChannelFieldValue(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId) const
+    {
+        return getIndex(type, channel, fieldId) != StatisticsParser::INVALID_INDEX;
+    }
+
+    // returns 0 for fields the inverter does not provide
+    float getChannelFieldValue(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId) const
+    {
+        const uint8_t index = getIndex(type, channel, fieldId);
+        return (index != StatisticsParser::INVALID_INDEX) ? _values[index] : 0;
+    }
+
+private:
+    friend class StatisticsParser;
+
+    uint8_t getIndex(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId) const
+    {
+        if (_index == nullptr || type >= StatisticsParser::TYPE_COUNT || channel >= CH_CNT || fieldId >= StatisticsParser::FIELD_COUNT) {
+            return StatisticsParser::INVALID_INDEX;
+        }
+        return _index->index[type][channel][fieldId];
+    }
+
+    uint32_t _sequence = 0;
+    uint32_t _acquiredMillis = 0;
+    const StatisticsParser::AssignmentIndex* _index = nullptr;
+    std::vector<float> _values; // indexed like the byte assignment
 };
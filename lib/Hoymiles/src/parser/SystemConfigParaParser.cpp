@@ -72,6 +72,16 @@ LastCommandSuccess SystemConfigParaParser::getLastLimitCommandSuccess() const
     return _lastLimitCommandSuccess;
 }
 
+uint32_t SystemConfigParaParser::getLastLimitCommandRoundTrip() const
+{
+    return _lastLimitCommandRoundTrip;
+}
+
+void SystemConfigParaParser::setLastLimitCommandRoundTrip(const uint32_t roundTrip)
+{
+    _lastLimitCommandRoundTrip = roundTrip;
+}
+
 uint32_t SystemConfigParaParser::getLastUpdateCommand() const
 {
     return _lastUpdateCommand;
@@ -104,6 +114,16 @@ void SystemConfigParaParser::setLastUpdateRequest(const uint32_t lastUpdate)
     setLastUpdate(lastUpdate);
 }
 
+bool SystemConfigParaParser::getLimitConfirmed() const
+{
+    return _limitConfirmed;
+}
+
+void SystemConfigParaParser::setLimitConfirmed(const bool confirmed)
+{
+    _limitConfirmed = confirmed;
+}
+
 uint8_t SystemConfigParaParser::getExpectedByteCount() const
 {
     return SYSTEM_CONFIG_PARA_SIZE;
@@ -18,11 +18,22 @@ public:
     uint32_t getLastUpdateCommand() const;
     void setLastUpdateCommand(const uint32_t lastUpdate);
 
+    // time from queueing the last successful limit command until the
+    // inverter acknowledged it, in milliseconds
+    uint32_t getLastLimitCommandRoundTrip() const;
+    void setLastLimitCommandRoundTrip(const uint32_t roundTrip);
+
     void setLastLimitRequestSuccess(const LastCommandSuccess status);
     LastCommandSuccess getLastLimitRequestSuccess() const;
     uint32_t getLastUpdateRequest() const;
     void setLastUpdateRequest(const uint32_t lastUpdate);
 
+    // whether the limit is known to be in effect, as it was read back or
+    // acknowledged by the inverter since it is reachable. the limit is only
+    // read back periodically while it is not confirmed.
+    bool getLimitConfirmed() const;
+    void setLimitConfirmed(const bool confirmed);
+
     // Returns 1 based amount of expected bytes of data
     uint8_t getExpectedByteCount() const;
 
@@ -34,5 +45,7 @@ private:
     LastCommandSuccess _lastLimitRequestSuccess = CMD_NOK; // Set to NOK to fetch at startup
 
     uint32_t _lastUpdateCommand = 0;
+    uint32_t _lastLimitCommandRoundTrip = 0;
     uint32_t _lastUpdateRequest = 0;
+    bool _limitConfirmed = false;
 };
\ No newline at end of file
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "CommandPool.h"
+#include <new>
+
+void* CommandPool::allocate(const size_t size)
+{
+    if (size <= HOY_COMMAND_POOL_BLOCK_SIZE) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_free != nullptr) {
+            Block* block = _free;
+            _free = block->next;
+            return block->storage;
+        }
+
+        if (_unused > 0) {
+            return _blocks[HOY_COMMAND_POOL_SIZE - _unused--].storage;
+        }
+    }
+
+    // pool exhausted or command too large
+    return ::operator new(size);
+}
+
+void CommandPool::deallocate(void* ptr)
+{
+    if (!isPoolBlock(ptr)) {
+        ::operator delete(ptr);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    Block* block = static_cast<Block*>(ptr);
+    block->next = _free;
+    _free = block;
+}
+
+bool CommandPool::isPoolBlock(const void* ptr) const
+{
+    auto p = static_cast<const uint8_t*>(ptr);
+    auto first = reinterpret_cast<const uint8_t*>(_blocks.data());
+    return p >= first && p < first + sizeof(_blocks);
+}
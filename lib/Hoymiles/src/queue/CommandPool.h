@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// number of commands (including their shared_ptr control block) which can
+// be held by the pool at the same time. more commands are allocated from
+// the heap.
+#define HOY_COMMAND_POOL_SIZE 24
+#define HOY_COMMAND_POOL_BLOCK_SIZE 192
+
+// Fixed-capacity storage for the commands created by
+// HoymilesRadio::prepareCommand(). Blocks are recycled through a free list,
+// so polling the inverters does not allocate from the heap in steady state.
+class CommandPool {
+public:
+    CommandPool() = default;
+    CommandPool(const CommandPool&) = delete;
+    CommandPool& operator=(const CommandPool&) = delete;
+
+    void* allocate(const size_t size);
+    void deallocate(void* ptr);
+
+private:
+    union Block {
+        Block* next;
+        alignas(std::max_align_t) uint8_t storage[HOY_COMMAND_POOL_BLOCK_SIZE];
+    };
+
+    bool isPoolBlock(const void* ptr) const;
+
+    mutable std::mutex _mutex;
+    std::array<Block, HOY_COMMAND_POOL_SIZE> _blocks;
+    Block* _free = nullptr;
+    size_t _unused = HOY_COMMAND_POOL_SIZE; // blocks never handed out so far
+};
+
+// allocator to be used with std::allocate_shared, such that the command and
+// the control block share a single block of the pool.
+template <typename T>
+class CommandPoolAllocator {
+public:
+    using value_type = T;
+
+    explicit CommandPoolAllocator(CommandPool& pool)
+        : _pool(&pool)
+    {
+    }
+
+    template <typename U>
+    CommandPoolAllocator(const CommandPoolAllocator<U>& other)
+        : _pool(other._pool)
+    {
+    }
+
+    T* allocate(const size_t n)
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types are not supported");
+        return static_cast<T*>(_pool->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, const size_t)
+    {
+        _pool->deallocate(ptr);
+    }
+
+    template <typename U>
+    bool operator==(const CommandPoolAllocator<U>& other) const { return _pool == other._pool; }
+
+    template <typename U>
+    bool operator!=(const CommandPoolAllocator<U>& other) const { return _pool != other._pool; }
+
+private:
+    template <typename U>
+    friend class CommandPoolAllocator;
+
+    CommandPool* _pool;
+};
@@ -4,48 +4,121 @@
  */
 #include "CommandQueue.h"
 #include "../inverters/InverterAbstract.h"
+#include <Arduino.h>
 #include <algorithm>
 
+static bool isSimilarCommand(const std::shared_ptr<CommandAbstract>& queued, const std::shared_ptr<CommandAbstract>& cmd)
+{
+    // compare the cached keys first to avoid building the command names
+    return queued->getTargetAddress() == cmd->getTargetAddress()
+        && queued->hasSameSimilarityKey(*cmd)
+        && cmd->areSameParameter(queued.get());
+}
+
+bool CommandQueue::push(std::shared_ptr<CommandAbstract> cmd)
+{
+    const CommandPriority priority = cmd->getPriority();
+    cmd->setQueuedAt(millis());
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // the front element is the command currently in progress
+    size_t pos = 1;
+    while (pos < sizeLocked() && at(pos)->getPriority() <= priority) {
+        ++pos;
+    }
+
+    if (pos >= sizeLocked() || _overtakeCount >= HOY_COMMAND_QUEUE_MAX_OVERTAKE) {
+        return insertLocked(sizeLocked(), std::move(cmd));
+    }
+
+    if (!insertLocked(pos, std::move(cmd))) {
+        return false;
+    }
+    ++_overtakeCount;
+    return true;
+}
+
+bool CommandQueue::pushFront(std::shared_ptr<CommandAbstract> cmd)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return insertLocked(0, std::move(cmd));
+}
+
+void CommandQueue::commandDispatched(const CommandAbstract& cmd)
+{
+    const uint32_t latency = millis() - cmd.getQueuedAt();
+    const CommandPriority priority = cmd.getPriority();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // sending a telemetry command ends the streak of commands which
+    // overtook the queued telemetry commands.
+    if (priority == CommandPriority::Telemetry) {
+        _overtakeCount = 0;
+    }
+
+    auto& stats = _latency[static_cast<size_t>(priority)];
+    stats.Last = latency;
+    stats.Average = (stats.Count == 0) ? latency : (stats.Average * 7 + latency) / 8;
+    stats.Max = std::max(stats.Max, latency);
+    ++stats.Count;
+}
+
+CommandQueueLatency CommandQueue::getLatency(const CommandPriority priority) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _latency[static_cast<size_t>(priority)];
+}
+
 void CommandQueue::removeAllEntriesForInverter(InverterAbstract* inv)
 {
     std::lock_guard<std::mutex> lock(_mutex);
 
-    auto it = std::remove_if(_queue.begin(), _queue.end(),
-        [&inv](std::shared_ptr<CommandAbstract> v) -> bool { return v.get()->getTargetAddress() == inv->serial(); });
-    _queue.erase(it, _queue.end());
+    eraseIf(0, [&inv](const std::shared_ptr<CommandAbstract>& v) -> bool {
+        return v->getTargetAddress() == inv->serial();
+    });
 }
 
 void CommandQueue::removeDuplicatedEntries(std::shared_ptr<CommandAbstract> cmd)
 {
+    if (cmd->getQueueInsertType() != QueueInsertType::RemoveOldest) {
+        return;
+    }
+
     std::lock_guard<std::mutex> lock(_mutex);
 
-    auto it = std::remove_if(_queue.begin() + 1, _queue.end(),
-        [&cmd](std::shared_ptr<CommandAbstract> v) -> bool {
-            return cmd->areSameParameter(v.get())
-                && cmd.get()->getQueueInsertType() == QueueInsertType::RemoveOldest;
-        });
-    _queue.erase(it, _queue.end());
+    // the front element is the command currently in progress
+    eraseIf(1, [&cmd](const std::shared_ptr<CommandAbstract>& v) -> bool {
+        return isSimilarCommand(v, cmd);
+    });
 }
 
 void CommandQueue::replaceEntries(std::shared_ptr<CommandAbstract> cmd)
 {
+    if (cmd->getQueueInsertType() != QueueInsertType::ReplaceExistent) {
+        return;
+    }
+
     std::lock_guard<std::mutex> lock(_mutex);
 
-    std::replace_if(_queue.begin() + 1, _queue.end(),
-        [&cmd](std::shared_ptr<CommandAbstract> v)-> bool {
-            return cmd.get()->getQueueInsertType() == QueueInsertType::ReplaceExistent
-                && cmd->areSameParameter(v.get());
-            },
-        cmd
-    );
+    // the front element is the command currently in progress
+    for (size_t pos = 1; pos < sizeLocked(); ++pos) {
+        if (isSimilarCommand(at(pos), cmd)) {
+            at(pos) = cmd;
+        }
+    }
 }
 
 uint8_t CommandQueue::countSimilarCommands(std::shared_ptr<CommandAbstract> cmd)
 {
     std::lock_guard<std::mutex> lock(_mutex);
 
-    return std::count_if(_queue.begin(), _queue.end(),
-        [&cmd](std::shared_ptr<CommandAbstract> v) -> bool {
-            return cmd->areSameParameter(v.get());
-        });
+    uint8_t count = 0;
+    for (size_t pos = 0; pos < sizeLocked(); ++pos) {
+        if (isSimilarCommand(at(pos), cmd)) {
+            ++count;
+        }
+    }
+    return count;
 }
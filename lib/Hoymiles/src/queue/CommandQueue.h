@@ -2,16 +2,49 @@
 #pragma once
 
 #include "../commands/CommandAbstract.h"
-#include <ThreadSafeQueue.h>
+#include <ThreadSafeRingQueue.h>
+#include <array>
 #include <memory>
 
+#define HOY_COMMAND_QUEUE_SIZE 128
+
+// number of commands which may overtake queued commands of a lower priority
+// in a row, before the next command of a lower priority is sent.
+#define HOY_COMMAND_QUEUE_MAX_OVERTAKE 8
+
 class InverterAbstract;
 
-class CommandQueue : public ThreadSafeQueue<std::shared_ptr<CommandAbstract>> {
+// the time commands spent in the queue before they were sent, in milliseconds
+struct CommandQueueLatency {
+    uint32_t Last = 0;
+    uint32_t Average = 0; // exponential moving average
+    uint32_t Max = 0;
+    uint32_t Count = 0;
+};
+
+class CommandQueue : public ThreadSafeRingQueue<std::shared_ptr<CommandAbstract>, HOY_COMMAND_QUEUE_SIZE> {
 public:
+    // inserts the command in front of all queued commands of a lower
+    // priority, but never in front of the command in progress. returns
+    // false (and drops the command) if the queue is full.
+    bool push(std::shared_ptr<CommandAbstract> cmd);
+
+    // inserts the command in front of all queued commands, such that it
+    // becomes the command in progress. only to be called by an idle radio.
+    bool pushFront(std::shared_ptr<CommandAbstract> cmd);
+
+    // to be called when the radio starts sending the front command
+    void commandDispatched(const CommandAbstract& cmd);
+
+    CommandQueueLatency getLatency(const CommandPriority priority) const;
+
     void removeAllEntriesForInverter(InverterAbstract* inv);
     void removeDuplicatedEntries(std::shared_ptr<CommandAbstract> cmd);
     void replaceEntries(std::shared_ptr<CommandAbstract> cmd);
 
     uint8_t countSimilarCommands(std::shared_ptr<CommandAbstract> cmd);
+
+private:
+    std::array<CommandQueueLatency, HOY_COMMAND_PRIORITY_COUNT> _latency;
+    uint8_t _overtakeCount = 0;
 };
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "../types.h"
+#include <array>
+#include <cstddef>
+
+// Fixed-capacity queue of the fragments received by a radio, which are
+// waiting to be parsed. It is only used by the radio task, so it is not
+// thread-safe, and it never allocates.
+template <size_t N>
+class FragmentQueue {
+public:
+    bool empty() const { return _count == 0; }
+    bool full() const { return _count == N; }
+    size_t size() const { return _count; }
+
+    // returns a slot at the end of the queue to be filled in place,
+    // or nullptr if the queue is full
+    fragment_t* push()
+    {
+        if (full()) {
+            return nullptr;
+        }
+        return &_buffer[(_head + _count++) % N];
+    }
+
+    const fragment_t& front() const { return _buffer[_head]; }
+    const fragment_t& back() const { return _buffer[(_head + _count - 1) % N]; }
+
+    void pop()
+    {
+        if (empty()) {
+            return;
+        }
+        _head = (_head + 1) % N;
+        --_count;
+    }
+
+private:
+    std::array<fragment_t, N> _buffer;
+    size_t _head = 0;
+    size_t _count = 0;
+};
@@ -11,6 +11,9 @@ union serial_u {
 // maximum buffer length of packet received / sent to RF24 module
 #define MAX_RF_PAYLOAD_SIZE 32
 
+// number of channels a radio transmits requests on
+#define HOY_TX_CHANNEL_COUNT 5
+
 typedef struct {
     uint8_t mainCmd;
     uint8_t fragment[MAX_RF_PAYLOAD_SIZE];
@@ -18,4 +21,5 @@ typedef struct {
     uint8_t channel;
     int8_t rssi;
     bool wasReceived;
+    uint32_t rxMillis; // when the radio signaled the reception
 } fragment_t;
@@ -3,6 +3,8 @@
  * Copyright (C) 2022 Thomas Basler and others
  */
 #include "MqttSubscribeParser.h"
+#include <algorithm>
+#include <cstring>
 
 void MqttSubscribeParser::register_callback(const std::string& topic, uint8_t qos, const espMqttClientTypes::OnMessageCallback& cb)
 {
@@ -11,6 +13,7 @@ void MqttSubscribeParser::register_callback(const std::string& topic, uint8_t qo
     cbf.qos = qos;
     cbf.cb = cb;
     _callbacks.push_back(cbf);
+    insert(_callbacks.size() - 1);
 }
 
 void MqttSubscribeParser::unregister_callback(const std::string& topic)
@@ -22,17 +25,25 @@ void MqttSubscribeParser::unregister_callback(const std::string& topic)
             ++it;
         }
     }
+
+    // the indices of the remaining filters changed
+    rebuild();
 }
 
 void MqttSubscribeParser::handle_message(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t len, size_t index, size_t total)
 {
-    bool result = false;
-    for (const auto& cb : _callbacks) {
-        if (mosquitto_topic_matches_sub(cb.topic.c_str(), topic, &result) == MOSQ_ERR_SUCCESS) {
-            if (result) {
-                cb.cb(properties, topic, payload, len, index, total);
-            }
-        }
+    if (topic == nullptr || topic[0] == 0) {
+        return;
+    }
+
+    _matches.clear();
+    match(_root, topic, _matches);
+
+    // invoke the callbacks in the order they were registered
+    std::sort(_matches.begin(), _matches.end());
+
+    for (size_t idx : _matches) {
+        _callbacks[idx].cb(properties, topic, payload, len, index, total);
     }
 }
 
@@ -41,131 +52,118 @@ std::vector<cb_filter_t> MqttSubscribeParser::get_callbacks()
     return _callbacks;
 }
 
-/* Does a topic match a subscription? */
-int MqttSubscribeParser::mosquitto_topic_matches_sub(const char* sub, const char* topic, bool* result)
+/* Is the subscription valid, i.e., are wildcards used as whole levels
+ * only and is '#' the last level, if any? */
+bool MqttSubscribeParser::is_valid_filter(const std::string& topic)
 {
-    size_t spos;
+    if (topic.empty()) {
+        return false;
+    }
 
-    if (!result)
-        return MOSQ_ERR_INVAL;
-    *result = false;
+    for (size_t pos = 0; pos < topic.size(); ++pos) {
+        char c = topic[pos];
+        if (c != '+' && c != '#') {
+            continue;
+        }
 
-    if (!sub || !topic || sub[0] == 0 || topic[0] == 0) {
-        return MOSQ_ERR_INVAL;
+        bool levelStart = (pos == 0 || topic[pos - 1] == '/');
+        bool levelEnd = (pos + 1 == topic.size() || topic[pos + 1] == '/');
+        if (!levelStart || !levelEnd) {
+            return false;
+        }
+
+        if (c == '#' && pos + 1 != topic.size()) {
+            return false;
+        }
     }
 
-    if ((sub[0] == '$' && topic[0] != '$')
-        || (topic[0] == '$' && sub[0] != '$')) {
+    return true;
+}
 
-        return MOSQ_ERR_SUCCESS;
+void MqttSubscribeParser::insert(size_t idx)
+{
+    const std::string& topic = _callbacks[idx].topic;
+    if (!is_valid_filter(topic)) {
+        // such a subscription never matched any topic
+        return;
     }
 
-    spos = 0;
+    trie_node_t* node = &_root;
+    size_t start = 0;
+    while (true) {
+        size_t end = topic.find('/', start);
+        if (end == std::string::npos) {
+            end = topic.size();
+        }
 
-    while (sub[0] != 0) {
-        if (topic[0] == '+' || topic[0] == '#') {
-            return MOSQ_ERR_INVAL;
+        std::string level = topic.substr(start, end - start);
+        if (level == "#") {
+            node->multi_level.push_back(idx);
+            return;
         }
-        if (sub[0] != topic[0] || topic[0] == 0) { /* Check for wildcard matches */
-            if (sub[0] == '+') {
-                /* Check for bad "+foo" or "a/+foo" subscription */
-                if (spos > 0 && sub[-1] != '/') {
-                    return MOSQ_ERR_INVAL;
-                }
-                /* Check for bad "foo+" or "foo+/a" subscription */
-                if (sub[1] != 0 && sub[1] != '/') {
-                    return MOSQ_ERR_INVAL;
-                }
-                spos++;
-                sub++;
-                while (topic[0] != 0 && topic[0] != '/') {
-                    if (topic[0] == '+' || topic[0] == '#') {
-                        return MOSQ_ERR_INVAL;
-                    }
-                    topic++;
-                }
-                if (topic[0] == 0 && sub[0] == 0) {
-                    *result = true;
-                    return MOSQ_ERR_SUCCESS;
-                }
-            } else if (sub[0] == '#') {
-                /* Check for bad "foo#" subscription */
-                if (spos > 0 && sub[-1] != '/') {
-                    return MOSQ_ERR_INVAL;
-                }
-                /* Check for # not the final character of the sub, e.g. "#foo" */
-                if (sub[1] != 0) {
-                    return MOSQ_ERR_INVAL;
-                } else {
-                    while (topic[0] != 0) {
-                        if (topic[0] == '+' || topic[0] == '#') {
-                            return MOSQ_ERR_INVAL;
-                        }
-                        topic++;
-                    }
-                    *result = true;
-                    return MOSQ_ERR_SUCCESS;
-                }
-            } else {
-                /* Check for e.g. foo/bar matching foo/+/# */
-                if (topic[0] == 0
-                    && spos > 0
-                    && sub[-1] == '+'
-                    && sub[0] == '/'
-                    && sub[1] == '#') {
-                    *result = true;
-                    return MOSQ_ERR_SUCCESS;
-                }
-
-                /* There is no match at this point, but is the sub invalid? */
-                while (sub[0] != 0) {
-                    if (sub[0] == '#' && sub[1] != 0) {
-                        return MOSQ_ERR_INVAL;
-                    }
-                    spos++;
-                    sub++;
-                }
-
-                /* Valid input, but no match */
-                return MOSQ_ERR_SUCCESS;
+
+        if (level == "+") {
+            if (!node->single_level) {
+                node->single_level = std::make_unique<trie_node_t>();
             }
+            node = node->single_level.get();
         } else {
-            /* sub[spos] == topic[tpos] */
-            if (topic[1] == 0) {
-                /* Check for e.g. foo matching foo/# */
-                if (sub[1] == '/'
-                    && sub[2] == '#'
-                    && sub[3] == 0) {
-                    *result = true;
-                    return MOSQ_ERR_SUCCESS;
-                }
-            }
-            spos++;
-            sub++;
-            topic++;
-            if (sub[0] == 0 && topic[0] == 0) {
-                *result = true;
-                return MOSQ_ERR_SUCCESS;
-            } else if (topic[0] == 0 && sub[0] == '+' && sub[1] == 0) {
-                if (spos > 0 && sub[-1] != '/') {
-                    return MOSQ_ERR_INVAL;
-                }
-                spos++;
-                sub++;
-                *result = true;
-                return MOSQ_ERR_SUCCESS;
+            auto it = std::find_if(node->children.begin(), node->children.end(),
+                [&level](const trie_node_t& child) { return child.level == level; });
+            if (it == node->children.end()) {
+                node->children.emplace_back();
+                node->children.back().level = level;
+                it = node->children.end() - 1;
             }
+            node = &(*it);
         }
+
+        if (end == topic.size()) {
+            node->filters.push_back(idx);
+            return;
+        }
+
+        start = end + 1;
+    }
+}
+
+void MqttSubscribeParser::rebuild()
+{
+    _root = trie_node_t();
+    for (size_t idx = 0; idx < _callbacks.size(); ++idx) {
+        insert(idx);
+    }
+}
+
+/* Collects the filters of the node and its subtree which match the topic
+ * levels starting at level. level is nullptr once all levels were consumed. */
+void MqttSubscribeParser::match(const trie_node_t& node, const char* level, std::vector<size_t>& matches) const
+{
+    // topics starting with '$' are not matched by wildcards on the first level
+    bool wildcards = (&node != &_root || level[0] != '$');
+
+    // "foo/#" also matches "foo"
+    if (wildcards) {
+        matches.insert(matches.end(), node.multi_level.begin(), node.multi_level.end());
     }
-    if ((topic[0] != 0 || sub[0] != 0)) {
-        *result = false;
+
+    if (level == nullptr) {
+        matches.insert(matches.end(), node.filters.begin(), node.filters.end());
+        return;
     }
-    while (topic[0] != 0) {
-        if (topic[0] == '+' || topic[0] == '#') {
-            return MOSQ_ERR_INVAL;
+
+    const char* end = strchr(level, '/');
+    size_t length = (end != nullptr) ? (end - level) : strlen(level);
+    const char* next = (end != nullptr) ? (end + 1) : nullptr;
+
+    for (const auto& child : node.children) {
+        if (child.level.size() == length && child.level.compare(0, length, level, length) == 0) {
+            match(child, next, matches);
+            break;
         }
-        topic++;
     }
 
-    return MOSQ_ERR_SUCCESS;
+    if (wildcards && node.single_level) {
+        match(*node.single_level, next, matches);
+    }
 }
@@ -3,6 +3,7 @@
 
 #include <cstdint>
 #include <espMqttClient.h>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -20,12 +21,22 @@ public:
     std::vector<cb_filter_t> get_callbacks();
 
 private:
-    int mosquitto_topic_matches_sub(const char* sub, const char* topic, bool* result);
+    // one node per topic level of the registered filters. the filters are
+    // referenced by their index in _callbacks.
+    struct trie_node_t {
+        std::string level;
+        std::vector<trie_node_t> children;
+        std::unique_ptr<trie_node_t> single_level; // '+'
+        std::vector<size_t> multi_level; // filters ending in '#' at this level
+        std::vector<size_t> filters; // filters ending at this level
+    };
 
-    std::vector<cb_filter_t> _callbacks;
+    static bool is_valid_filter(const std::string& topic);
+    void insert(size_t idx);
+    void rebuild();
+    void match(const trie_node_t& node, const char* level, std::vector<size_t>& matches) const;
 
-    enum mosq_err_t {
-        MOSQ_ERR_SUCCESS = 0,
-        MOSQ_ERR_INVAL = 3,
-    };
-};
\ No newline at end of file
+    std::vector<cb_filter_t> _callbacks;
+    trie_node_t _root;
+    std::vector<size_t> _matches;
+};
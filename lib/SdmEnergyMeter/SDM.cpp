@@ -114,28 +114,44 @@ float SDM::readVal(uint16_t reg, uint8_t node) {
 }
 
 void SDM::startReadVal(uint16_t reg, uint8_t node, uint8_t functionCode) {
+  startReadVals(reg, 1, node, functionCode);
+}
+
+void SDM::startReadVals(uint16_t reg, uint8_t count, uint8_t node, uint8_t functionCode) {
+  const uint16_t registers = 2 * count;                                          //  every value spans two registers
+
   uint8_t data[] = {
-    node,             // Address
-    functionCode,     // Modbus function
-    highByte(reg),    // Start address high byte
-    lowByte(reg),     // Start address low byte
-    SDM_B_05,         // Number of points high byte
-    SDM_B_06,         // Number of points low byte
-    0,                // Checksum low byte
-    0};               // Checksum high byte
+    node,                 // Address
+    functionCode,         // Modbus function
+    highByte(reg),        // Start address high byte
+    lowByte(reg),         // Start address low byte
+    highByte(registers),  // Number of points high byte
+    lowByte(registers),   // Number of points low byte
+    0,                    // Checksum low byte
+    0};                   // Checksum high byte
 
   constexpr size_t messageLength = sizeof(data) / sizeof(data[0]);
   modbusWrite(data, messageLength);
 }
 
 uint16_t SDM::readValReady(uint8_t node, uint8_t functionCode) {
+  return readValsReady(1, node, functionCode);
+}
+
+uint16_t SDM::readValsReady(uint8_t count, uint8_t node, uint8_t functionCode) {
+  if (count == 0 || count > SDM_MAX_READ_VALUES) {
+    return SDM_ERR_WRONG_BYTES;
+  }
+
+  const uint8_t framesize = 5 + 4 * count;                                      //  address, function, byte count, data, crc
+
   uint16_t readErr = SDM_ERR_NO_ERROR;
-  if (sdmSer.available() < FRAMESIZE && ((millis() - resptime) < msturnaround)) 
+  if (sdmSer.available() < framesize && ((millis() - resptime) < msturnaround)) 
   {
     return SDM_ERR_STILL_WAITING;
   }
 
-  while (sdmSer.available() < FRAMESIZE) {
+  while (sdmSer.available() < framesize) {
     if ((millis() - resptime) > msturnaround) {
       readErr = SDM_ERR_TIMEOUT;                                                //err debug (4)
 
@@ -154,16 +170,17 @@ uint16_t SDM::readValReady(uint8_t node, uint8_t functionCode) {
 
   if (readErr == SDM_ERR_NO_ERROR) {                                            //if no timeout...
 
-    if (sdmSer.available() >= FRAMESIZE) {
+    if (sdmSer.available() >= framesize) {
 
-      for(int n=0; n<FRAMESIZE; n++) {
+      for(int n=0; n<framesize; n++) {
         sdmarr[n] = sdmSer.read();
       }
+      sdmframesize = framesize;
 
       if (sdmarr[0] == node && 
           sdmarr[1] == functionCode && 
-          sdmarr[2] == SDM_REPLY_BYTE_COUNT) {
-        if (!validChecksum(sdmarr, FRAMESIZE)) {
+          sdmarr[2] == SDM_REPLY_BYTE_COUNT * count) {
+        if (!validChecksum(sdmarr, framesize)) {
           readErr = SDM_ERR_CRC_ERROR;                                          //err debug (1)
         }
 
@@ -208,6 +225,36 @@ float SDM::decodeFloatValue() const {
   return res;
 }
 
+float SDM::decodeFloatValue(uint8_t idx) const {
+  if (4 * idx + 7 <= sdmframesize && validChecksum(sdmarr, sdmframesize)) {
+    float res{};
+    ((uint8_t*)&res)[3]= sdmarr[3 + 4 * idx];
+    ((uint8_t*)&res)[2]= sdmarr[4 + 4 * idx];
+    ((uint8_t*)&res)[1]= sdmarr[5 + 4 * idx];
+    ((uint8_t*)&res)[0]= sdmarr[6 + 4 * idx];
+    return res;
+  }
+  constexpr float res = NAN;
+  return res;
+}
+
+uint16_t SDM::readVals(uint16_t reg, uint8_t count, float* values, uint8_t node) {
+  startReadVals(reg, count, node);
+
+  uint16_t readErr = SDM_ERR_STILL_WAITING;
+
+  while (readErr == SDM_ERR_STILL_WAITING) {
+    readErr = readValsReady(count, node);
+    delay(1);
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    values[i] = (readErr == SDM_ERR_NO_ERROR) ? decodeFloatValue(i) : NAN;
+  }
+
+  return readErr;
+}
+
 float SDM::readHoldingRegister(uint16_t reg, uint8_t node) {
   startReadVal(reg, node, SDM_READ_HOLDING_REGISTER);
 
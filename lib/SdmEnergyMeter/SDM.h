@@ -104,6 +104,8 @@
 #define SDM_WRITE_HOLDING_REGISTER                    0x10
 
 #define FRAMESIZE                                     9                         //  size of out/in array
+#define SDM_MAX_READ_VALUES                           12                        //  max number of values read in one request (the reply fits the 64 byte software serial rx buffer)
+#define SDM_MAX_FRAMESIZE                             (5 + 4 * SDM_MAX_READ_VALUES) //  size of in array for reading several values at once
 #define SDM_REPLY_BYTE_COUNT                          0x04                      //  number of bytes with data
 
 #define SDM_B_01                                      0x01                      //  BYTE 1 -> slave address (default value 1 read from node 1)
@@ -346,6 +348,11 @@ class SDM {
     uint16_t readValReady(uint8_t node = SDM_B_01, uint8_t functionCode = SDM_B_02);                             //  Check to see if a reply is ready reading from a node (allow for async access)
     float decodeFloatValue() const;
 
+    void startReadVals(uint16_t reg, uint8_t count, uint8_t node = SDM_B_01, uint8_t functionCode = SDM_B_02); //  Start sending out the request to read count consecutive values starting at register = reg (allows for async access)
+    uint16_t readValsReady(uint8_t count, uint8_t node = SDM_B_01, uint8_t functionCode = SDM_B_02);          //  Check to see if a reply with count values is ready (allows for async access)
+    float decodeFloatValue(uint8_t idx) const;                                  //  decode value idx of a reply with several values
+    uint16_t readVals(uint16_t reg, uint8_t count, float* values, uint8_t node = SDM_B_01);                   //  read count consecutive values in a single request, returns the error code
+
     float readHoldingRegister(uint16_t reg, uint8_t node = SDM_B_01);
     bool writeHoldingRegister(float value, uint16_t reg, uint8_t node = SDM_B_01);
 
@@ -399,7 +406,8 @@ class SDM {
     uint32_t readingerrcount = 0;                                               //  total errors counter
     uint32_t readingsuccesscount = 0;                                           //  total success counter
     unsigned long resptime = 0;
-    uint8_t sdmarr[FRAMESIZE] = {};
+    uint8_t sdmarr[SDM_MAX_FRAMESIZE] = {};
+    uint8_t sdmframesize = FRAMESIZE;                                           //  size of the last reply in sdmarr
     uint16_t calculateCRC(const uint8_t *array, uint8_t len) const;
     void flush(unsigned long _flushtime = 0);                                   //  read serial if any old data is available or for a given time in ms
     void dereSet(bool _state = LOW);                                            //  for control MAX485 DE/RE pins, LOW receive from SDM, HIGH transmit to SDM
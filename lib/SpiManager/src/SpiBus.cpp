@@ -7,7 +7,13 @@ SpiBus::SpiBus(const std::string& _id, spi_host_device_t _host_device)
     : id(_id)
     , host_device(_host_device)
     , cur_config(nullptr)
+    , arbiter_mux(portMUX_INITIALIZER_UNLOCKED)
+    , arbiter_busy(false)
+    , arbiter_waiting {}
 {
+    for (auto& grant : arbiter_grant)
+        grant = xSemaphoreCreateCounting(UINT8_MAX, 0);
+
     spi_bus_config_t bus_config {
         .mosi_io_num = -1,
         .miso_io_num = -1,
@@ -36,18 +42,57 @@ SpiBus::SpiBus(const std::string& _id, spi_host_device_t _host_device)
 SpiBus::~SpiBus()
 {
     ESP_ERROR_CHECK(spi_bus_free(host_device));
+
+    for (auto& grant : arbiter_grant)
+        vSemaphoreDelete(grant);
 }
 
-spi_device_handle_t SpiBus::add_device(const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config)
+spi_device_handle_t SpiBus::add_device(const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config, const char* name, SpiPriority priority)
 {
-    if (!SpiCallback::patch(shared_from_this(), bus_config, device_config))
+    int slot = SpiCallback::patch(shared_from_this(), bus_config, device_config, name, priority);
+    if (slot < 0)
         return nullptr;
 
     spi_device_handle_t device;
     ESP_ERROR_CHECK(spi_bus_add_device(host_device, &device_config, &device));
+    SpiCallback::bind(slot, device);
     return device;
 }
 
+bool SpiBus::acquire(SpiPriority priority)
+{
+    size_t index = static_cast<size_t>(priority);
+
+    taskENTER_CRITICAL(&arbiter_mux);
+    if (!arbiter_busy) {
+        arbiter_busy = true;
+        taskEXIT_CRITICAL(&arbiter_mux);
+        return false;
+    }
+    ++arbiter_waiting[index];
+    taskEXIT_CRITICAL(&arbiter_mux);
+
+    // the bus is handed over by release() without becoming free in between
+    xSemaphoreTake(arbiter_grant[index], portMAX_DELAY);
+    return true;
+}
+
+void SpiBus::release()
+{
+    taskENTER_CRITICAL(&arbiter_mux);
+    for (size_t index = SPI_PRIORITY_COUNT; index-- > 0;) {
+        if (arbiter_waiting[index] == 0)
+            continue;
+
+        --arbiter_waiting[index];
+        taskEXIT_CRITICAL(&arbiter_mux);
+        xSemaphoreGive(arbiter_grant[index]);
+        return;
+    }
+    arbiter_busy = false;
+    taskEXIT_CRITICAL(&arbiter_mux);
+}
+
 // TODO: add remove_device (with spi_device_acquire_bus)
 
 void SpiBus::apply_config(SpiBusConfig* config)
@@ -2,11 +2,25 @@
 #pragma once
 
 #include <driver/spi_master.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <array>
 #include <memory>
 #include <string>
 
 class SpiBusConfig;
 
+// the order in which the devices sharing a bus are served if several of
+// them wait for it. a transfer which already occupies the bus is never
+// interrupted, so the priority only decides who is next.
+enum class SpiPriority : uint8_t {
+    Bulk, // large transfers which tolerate delays, e.g., Ethernet frames
+    Normal,
+    Realtime, // transfers which must not be delayed, e.g., radio FIFO reads
+};
+
+#define SPI_PRIORITY_COUNT 3
+
 class SpiBus : public std::enable_shared_from_this<SpiBus> {
 public:
     explicit SpiBus(const std::string& id, spi_host_device_t host_device);
@@ -38,7 +52,12 @@ public:
         return host_device;
     }
 
-    spi_device_handle_t add_device(const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config);
+    spi_device_handle_t add_device(const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config, const char* name, SpiPriority priority);
+
+    // grants the bus to one of the sharing devices for a sequence of
+    // transactions. returns whether the caller had to wait.
+    bool acquire(SpiPriority priority);
+    void release();
 
 private:
     void apply_config(SpiBusConfig* config);
@@ -46,4 +65,9 @@ private:
     std::string id;
     spi_host_device_t host_device;
     SpiBusConfig* cur_config;
+
+    portMUX_TYPE arbiter_mux;
+    bool arbiter_busy;
+    std::array<uint8_t, SPI_PRIORITY_COUNT> arbiter_waiting;
+    std::array<SemaphoreHandle_t, SPI_PRIORITY_COUNT> arbiter_grant;
 };
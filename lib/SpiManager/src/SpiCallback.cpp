@@ -1,7 +1,8 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include "SpiCallback.h"
 
-#include "SpiBus.h"
+#include <esp_timer.h>
+#include <algorithm>
 #include <array>
 #include <optional>
 
@@ -12,6 +13,20 @@ namespace {
         std::shared_ptr<SpiBusConfig> config;
         transaction_cb_t inner_pre_cb;
         transaction_cb_t inner_post_cb;
+
+        spi_device_handle_t device = nullptr;
+        const char* name = "";
+        SpiPriority priority = SpiPriority::Normal;
+
+        // written from the callbacks, which may run in the ISR
+        portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+        int64_t start_us = 0;
+        uint32_t transactions = 0;
+        uint64_t busy_us = 0;
+        uint32_t max_us = 0;
+        uint32_t waits = 0;
+        uint64_t wait_us = 0;
+        uint32_t max_wait_us = 0;
     };
 
     std::array<std::optional<CallbackData>, SPI_MANAGER_CALLBACK_COUNT> instances;
@@ -20,6 +35,7 @@ namespace {
     void IRAM_ATTR fn_pre_cb(spi_transaction_t* trans)
     {
         instances[N]->bus->require_config(instances[N]->config.get());
+        instances[N]->start_us = esp_timer_get_time();
         if (instances[N]->inner_pre_cb)
             instances[N]->inner_pre_cb(trans);
     }
@@ -29,41 +45,123 @@ namespace {
     {
         if (instances[N]->inner_post_cb)
             instances[N]->inner_post_cb(trans);
+
+        CallbackData& data = *instances[N];
+        uint32_t duration = esp_timer_get_time() - data.start_us;
+        portENTER_CRITICAL_SAFE(&data.mux);
+        ++data.transactions;
+        data.busy_us += duration;
+        if (duration > data.max_us)
+            data.max_us = duration;
+        portEXIT_CRITICAL_SAFE(&data.mux);
     }
 
     template <int N>
-    inline __attribute__((always_inline)) bool alloc(CallbackData*& instance, transaction_cb_t& pre_cb, transaction_cb_t& post_cb)
+    inline __attribute__((always_inline)) int alloc(CallbackData*& instance, transaction_cb_t& pre_cb, transaction_cb_t& post_cb)
     {
         if constexpr (N > 0) {
-            if (alloc<N - 1>(instance, pre_cb, post_cb))
-                return true;
+            int slot = alloc<N - 1>(instance, pre_cb, post_cb);
+            if (slot >= 0)
+                return slot;
             if (!instances[N - 1]) {
                 instances[N - 1].emplace();
                 instance = &*instances[N - 1];
                 pre_cb = fn_pre_cb<N - 1>;
                 post_cb = fn_post_cb<N - 1>;
-                return true;
+                return N - 1;
             }
         }
-        return false;
+        return -1;
+    }
+
+    CallbackData* find(spi_device_handle_t device)
+    {
+        for (auto& instance : instances) {
+            if (instance && instance->device == device)
+                return &*instance;
+        }
+        return nullptr;
     }
 }
 
-bool patch(const std::shared_ptr<SpiBus>& bus, const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config)
+int patch(const std::shared_ptr<SpiBus>& bus, const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config, const char* name, SpiPriority priority)
 {
     CallbackData* instance;
     transaction_cb_t pre_cb;
     transaction_cb_t post_cb;
-    if (!alloc<SPI_MANAGER_CALLBACK_COUNT>(instance, pre_cb, post_cb))
-        return false;
+    int slot = alloc<SPI_MANAGER_CALLBACK_COUNT>(instance, pre_cb, post_cb);
+    if (slot < 0)
+        return -1;
 
     instance->bus = bus;
     instance->config = bus_config;
     instance->inner_pre_cb = device_config.pre_cb;
     instance->inner_post_cb = device_config.post_cb;
+    instance->name = name;
+    instance->priority = priority;
     device_config.pre_cb = pre_cb;
     device_config.post_cb = post_cb;
 
+    return slot;
+}
+
+void bind(int slot, spi_device_handle_t device)
+{
+    instances[slot]->device = device;
+}
+
+bool acquire(spi_device_handle_t device)
+{
+    CallbackData* data = find(device);
+    if (!data)
+        return false;
+
+    int64_t start = esp_timer_get_time();
+    if (!data->bus->acquire(data->priority))
+        return true;
+
+    uint32_t duration = esp_timer_get_time() - start;
+    portENTER_CRITICAL_SAFE(&data->mux);
+    ++data->waits;
+    data->wait_us += duration;
+    if (duration > data->max_wait_us)
+        data->max_wait_us = duration;
+    portEXIT_CRITICAL_SAFE(&data->mux);
     return true;
 }
+
+void release(spi_device_handle_t device)
+{
+    CallbackData* data = find(device);
+    if (data)
+        data->bus->release();
+}
+
+std::vector<SpiDeviceStats> get_stats()
+{
+    std::vector<SpiDeviceStats> stats;
+    for (auto& instance : instances) {
+        if (!instance || !instance->device)
+            continue;
+
+        CallbackData& data = *instance;
+        portENTER_CRITICAL_SAFE(&data.mux);
+        SpiDeviceStats entry {
+            .bus_id = {},
+            .name = data.name,
+            .priority = data.priority,
+            .transactions = data.transactions,
+            .busy_us = data.busy_us,
+            .max_us = data.max_us,
+            .waits = data.waits,
+            .wait_us = data.wait_us,
+            .max_wait_us = data.max_wait_us,
+        };
+        portEXIT_CRITICAL_SAFE(&data.mux);
+
+        entry.bus_id = data.bus->get_id();
+        stats.push_back(std::move(entry));
+    }
+    return stats;
+}
 }
@@ -1,15 +1,36 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "SpiBus.h"
+
 #include <driver/spi_master.h>
 #include <memory>
+#include <vector>
 
 // Pre and post callbacks for 2 buses with 3 devices each
 #define SPI_MANAGER_CALLBACK_COUNT 6
 
-class SpiBus;
 class SpiBusConfig;
 
+struct SpiDeviceStats {
+    std::string bus_id;
+    const char* name;
+    SpiPriority priority;
+    uint32_t transactions;
+    uint64_t busy_us; // time between the pre and post callbacks
+    uint32_t max_us;
+    uint32_t waits; // acquisitions which found the bus occupied
+    uint64_t wait_us;
+    uint32_t max_wait_us;
+};
+
 namespace SpiCallback {
-bool patch(const std::shared_ptr<SpiBus>& bus, const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config);
+// returns the slot of the device, or -1 if all are in use
+int patch(const std::shared_ptr<SpiBus>& bus, const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config, const char* name, SpiPriority priority);
+void bind(int slot, spi_device_handle_t device);
+
+bool acquire(spi_device_handle_t device);
+void release(spi_device_handle_t device);
+
+std::vector<SpiDeviceStats> get_stats();
 }
@@ -76,13 +76,29 @@ std::optional<uint8_t> SpiManager::claim_bus_arduino()
 
 #endif
 
-spi_device_handle_t SpiManager::alloc_device(const std::string& bus_id, const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config)
+spi_device_handle_t SpiManager::alloc_device(const std::string& bus_id, const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config,
+    const char* name, SpiPriority priority)
 {
     std::shared_ptr<SpiBus> shared_bus = get_shared_bus(bus_id);
     if (!shared_bus)
         return nullptr;
 
-    return shared_bus->add_device(bus_config, device_config);
+    return shared_bus->add_device(bus_config, device_config, name, priority);
+}
+
+bool SpiManager::acquire(spi_device_handle_t device)
+{
+    return SpiCallback::acquire(device);
+}
+
+void SpiManager::release(spi_device_handle_t device)
+{
+    SpiCallback::release(device);
+}
+
+std::vector<SpiDeviceStats> SpiManager::get_device_stats() const
+{
+    return SpiCallback::get_stats();
 }
 
 std::shared_ptr<SpiBus> SpiManager::get_shared_bus(const std::string& bus_id)
@@ -3,6 +3,7 @@
 
 #include "SpiBus.h"
 #include "SpiBusConfig.h"
+#include "SpiCallback.h"
 
 #include <driver/spi_master.h>
 
@@ -10,6 +11,7 @@
 #include <memory>
 #include <optional>
 #include <utility>
+#include <vector>
 
 #define SPI_MANAGER_NUM_BUSES SOC_SPI_PERIPH_NUM
 
@@ -29,7 +31,15 @@ public:
     std::optional<uint8_t> claim_bus_arduino();
 #endif
 
-    spi_device_handle_t alloc_device(const std::string& bus_id, const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config);
+    spi_device_handle_t alloc_device(const std::string& bus_id, const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config,
+        const char* name = "", SpiPriority priority = SpiPriority::Normal);
+
+    // arbitrates a sequence of transactions against the other devices on
+    // the shared bus, which are served in order of their priority
+    bool acquire(spi_device_handle_t device);
+    void release(spi_device_handle_t device);
+
+    std::vector<SpiDeviceStats> get_device_stats() const;
 
 private:
     std::shared_ptr<SpiBus> get_shared_bus(const std::string& bus_id);
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+
+// Fixed-capacity variant of ThreadSafeQueue. All elements are stored in a
+// statically sized ring buffer, so pushing and popping never allocates.
+// Critical sections are limited to a couple of index updates and moves.
+template <typename T, size_t N>
+class ThreadSafeRingQueue {
+public:
+    ThreadSafeRingQueue() = default;
+    ThreadSafeRingQueue(const ThreadSafeRingQueue<T, N>&) = delete;
+    ThreadSafeRingQueue& operator=(const ThreadSafeRingQueue<T, N>&) = delete;
+
+    virtual ~ThreadSafeRingQueue() { }
+
+    static constexpr size_t capacity() { return N; }
+
+    unsigned long size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _count;
+    }
+
+    std::optional<T> pop()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_count == 0) {
+            return {};
+        }
+        T tmp = std::move(_buffer[_head]);
+        _buffer[_head] = T();
+        _head = (_head + 1) % N;
+        --_count;
+        return tmp;
+    }
+
+    // returns false (and drops the item) if the queue is full
+    bool push(T item)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_count == N) {
+            return false;
+        }
+        _buffer[(_head + _count) % N] = std::move(item);
+        ++_count;
+        return true;
+    }
+
+    T front()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _buffer[_head];
+    }
+
+protected:
+    // the following helpers must only be called while holding _mutex.
+    // positions are counted from the front of the queue.
+    size_t sizeLocked() const { return _count; }
+
+    T& at(const size_t pos) { return _buffer[(_head + pos) % N]; }
+
+    // inserts the item at the given position, moving the elements at this
+    // and later positions back by one. returns false if the queue is full.
+    bool insertLocked(const size_t pos, T item)
+    {
+        if (_count == N || pos > _count) {
+            return false;
+        }
+        for (size_t i = _count; i > pos; --i) {
+            at(i) = std::move(at(i - 1));
+        }
+        at(pos) = std::move(item);
+        ++_count;
+        return true;
+    }
+
+    // removes all elements at position first or later for which the
+    // predicate returns true. the order of the other elements is preserved.
+    template <typename Predicate>
+    void eraseIf(const size_t first, Predicate pred)
+    {
+        size_t dst = first;
+        for (size_t src = first; src < _count; ++src) {
+            if (pred(at(src))) {
+                continue;
+            }
+            if (dst != src) {
+                at(dst) = std::move(at(src));
+            }
+            ++dst;
+        }
+
+        for (size_t i = dst; i < _count; ++i) {
+            at(i) = T();
+        }
+
+        _count = dst;
+    }
+
+    mutable std::mutex _mutex;
+
+private:
+    std::array<T, N> _buffer = {};
+    size_t _head = 0;
+    size_t _count = 0;
+};
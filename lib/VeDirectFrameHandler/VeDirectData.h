@@ -6,6 +6,8 @@
 
 #define VE_MAX_VALUE_LEN 33 // VE.Direct Protocol: max value size is 33 including /0
 #define VE_MAX_HEX_LEN 100 // Maximum size of hex frame - max payload 34 byte (=68 char) + safe buffer
+#define VE_MAX_NAME_LEN 16 // max label size including /0, the longest known label has 8 characters
+#define VE_MAX_TEXT_RECORDS 24 // VE.Direct Protocol: max 22 records per text frame, plus margin
 
 typedef struct {
     uint16_t productID_PID = 0;             // product id
@@ -34,6 +34,7 @@
  */
 
 #include <Arduino.h>
+#include <SoftwareSerial.h>
 #include "VeDirectFrameHandler.h"
 
 // The name of the record that contains the checksum.
@@ -57,35 +58,55 @@ VeDirectFrameHandler<T>::VeDirectFrameHandler() :
 	_name(""),
 	_value(""),
 	_debugIn(0),
-	_lastByteMillis(0)
+	_lastByteMillis(0),
+	_hexQueueCount(0),
+	_hexOutstandingCount(0),
+	_textDataCount(0)
 {
 }
 
 template<typename T>
 void VeDirectFrameHandler<T>::init(char const* who, int8_t rx, int8_t tx,
-		Print* msgOut, bool verboseLogging, uint8_t hwSerialPort)
+		Print* msgOut, bool verboseLogging, std::optional<uint8_t> hwSerialPort)
 {
-	_vedirectSerial = std::make_unique<HardwareSerial>(hwSerialPort);
-	_vedirectSerial->setRxBufferSize(512); // increased from default (256) to 512 Byte to avoid overflow
-	_vedirectSerial->end(); // make sure the UART will be re-initialized
-	_vedirectSerial->begin(19200, SERIAL_8N1, rx, tx);
+	if (hwSerialPort) {
+		auto upSerial = std::make_unique<HardwareSerial>(*hwSerialPort);
+		upSerial->setRxBufferSize(512); // increased from default (256) to 512 Byte to avoid overflow
+		upSerial->end(); // make sure the UART will be re-initialized
+		upSerial->begin(19200, SERIAL_8N1, rx, tx);
+		_pHwSerial = upSerial.get();
+		_vedirectSerial = std::move(upSerial);
+	} else {
+		// 19200 baud is well within the capabilities of the GPIO interrupt
+		// driven software UART. the ISR buffer holds one entry per level
+		// change, i.e., up to ten entries per byte.
+		auto upSerial = std::make_unique<SoftwareSerial>();
+		upSerial->begin(19200, SWSERIAL_8N1, rx, tx,
+				false/*invert*/, 512/*bufCapacity*/, 1024/*isrBufCapacity*/);
+		upSerial->enableTx(tx != -1);
+		_vedirectSerial = std::move(upSerial);
+	}
 	_vedirectSerial->flush();
 	_canSend = (tx != -1);
 	_msgOut = msgOut;
 	_verboseLogging = verboseLogging;
 	_debugIn = 0;
-	snprintf(_logId, sizeof(_logId), "[VE.Direct %s %d/%d]", who, rx, tx);
+	if (_verboseLogging && !_upDebugBuffer) { _upDebugBuffer = std::make_unique<DebugBuffer>(); }
+	if (!_verboseLogging) { _upDebugBuffer = nullptr; }
+	snprintf(_logId, sizeof(_logId), "[VE.Direct %s %d/%d%s]", who, rx, tx,
+			(hwSerialPort ? "" : " SW"));
 	if (_verboseLogging) { _msgOut->printf("%s init complete\r\n", _logId); }
 }
 
 template<typename T>
 void VeDirectFrameHandler<T>::dumpDebugBuffer() {
+	if (!_upDebugBuffer) { return; }
 	_msgOut->printf("%s serial input (%d Bytes):", _logId, _debugIn);
 	for (int i = 0; i < _debugIn; ++i) {
 		if (i % 16 == 0) {
 			_msgOut->printf("\r\n%s", _logId);
 		}
-		_msgOut->printf(" %02x", _debugBuffer[i]);
+		_msgOut->printf(" %02x", (*_upDebugBuffer)[i]);
 	}
 	_msgOut->println("");
 	_debugIn = 0;
@@ -96,14 +117,19 @@ void VeDirectFrameHandler<T>::reset()
 {
 	_checksum = 0;
 	_state = State::IDLE;
-	_textData.clear();
+	_textDataCount = 0;
 }
 
 template<typename T>
 void VeDirectFrameHandler<T>::loop()
 {
+	// First we send queued HEX-Commands (timing improvement)
+	sendQueuedHexCommands();
+
 	while ( _vedirectSerial->available()) {
-		rxData(_vedirectSerial->read());
+		uint8_t inbyte = _vedirectSerial->read();
+		if (_rxTap && !_rxTap(inbyte)) { continue; }
+		rxData(inbyte);
 		_lastByteMillis = millis();
 	}
 
@@ -118,6 +144,15 @@ void VeDirectFrameHandler<T>::loop()
 	}
 }
 
+template<typename T>
+void VeDirectFrameHandler<T>::feed(uint8_t const* data, size_t length)
+{
+	for (size_t i = 0; i < length; ++i) {
+		rxData(data[i]);
+	}
+	if (length > 0) { _lastByteMillis = millis(); }
+}
+
 /*
  *  rxData
  *  This function is called by loop() which passes a byte of serial data
@@ -126,9 +161,9 @@ void VeDirectFrameHandler<T>::loop()
 template<typename T>
 void VeDirectFrameHandler<T>::rxData(uint8_t inbyte)
 {
-	if (_verboseLogging) {
-		_debugBuffer[_debugIn] = inbyte;
-		_debugIn = (_debugIn + 1) % _debugBuffer.size();
+	if (_upDebugBuffer) {
+		(*_upDebugBuffer)[_debugIn] = inbyte;
+		_debugIn = (_debugIn + 1) % _upDebugBuffer->size();
 		if (0 == _debugIn) {
 			_msgOut->printf("%s ERROR: debug buffer overrun!\r\n", _logId);
 		}
@@ -191,7 +226,14 @@ void VeDirectFrameHandler<T>::rxData(uint8_t inbyte)
 		case '\n':
 			if ( _textPointer < (_value + sizeof(_value)) ) {
 				*_textPointer = 0; // make zero ended
-				_textData.push_back({_name, _value});
+				if (_textDataCount < _textData.size()) {
+					auto& record = _textData[_textDataCount++];
+					strlcpy(record.name, _name, sizeof(record.name));
+					strlcpy(record.value, _value, sizeof(record.value));
+				}
+				else {
+					_msgOut->printf("%s too many text records, dropping '%s'\r\n", _logId, _name);
+				}
 			}
 			_state = State::RECORD_BEGIN;
 			break;
@@ -208,8 +250,8 @@ void VeDirectFrameHandler<T>::rxData(uint8_t inbyte)
 	{
 		if (_verboseLogging) { dumpDebugBuffer(); }
 		if (_checksum == 0) {
-			for (auto const& event : _textData) {
-				processTextData(event.first, event.second);
+			for (size_t i = 0; i < _textDataCount; ++i) {
+				processTextData(_textData[i].name, _textData[i].value);
 			}
 			_lastUpdate = millis();
 			frameValidEvent();
@@ -230,49 +272,42 @@ void VeDirectFrameHandler<T>::rxData(uint8_t inbyte)
  * This function is called every time a new name/value is successfully parsed.  It writes the values to the temporary buffer.
  */
 template<typename T>
-void VeDirectFrameHandler<T>::processTextData(std::string const& name, std::string const& value) {
+void VeDirectFrameHandler<T>::processTextData(char const* name, char const* value) {
 	if (_verboseLogging) {
 		_msgOut->printf("%s Text Data '%s' = '%s'\r\n",
-				_logId, name.c_str(), value.c_str());
+				_logId, name, value);
 	}
 
 	if (processTextDataDerived(name, value)) { return; }
 
-	if (name == "PID") {
-		_tmpFrame.productID_PID = strtol(value.c_str(), nullptr, 0);
-		return;
-	}
-
-	if (name == "SER") {
-		strncpy(_tmpFrame.serialNr_SER, value.c_str(), sizeof(_tmpFrame.serialNr_SER));
-		return;
-	}
-
-	if (name == "FW") {
-		_tmpFrame.firmwareVer_FWE[0] = '\0';
-		strncpy(_tmpFrame.firmwareVer_FW, value.c_str(), sizeof(_tmpFrame.firmwareVer_FW));
-		return;
-	}
-
-	// some devices use "FWE" instead of "FW" for the firmware version.
-	if (name == "FWE") {
-		_tmpFrame.firmwareVer_FW[0] = '\0';
-		strncpy(_tmpFrame.firmwareVer_FWE, value.c_str(), sizeof(_tmpFrame.firmwareVer_FWE));
-		return;
-	}
-
-	if (name == "V") {
-		_tmpFrame.batteryVoltage_V_mV = atol(value.c_str());
-		return;
-	}
+	static constexpr TextHandlers<veStruct, 6> handlers = {
+		{ "PID", [](veStruct& frame, char const* value) {
+			frame.productID_PID = strtol(value, nullptr, 0);
+		} },
+		{ "SER", [](veStruct& frame, char const* value) {
+			strncpy(frame.serialNr_SER, value, sizeof(frame.serialNr_SER));
+		} },
+		{ "FW", [](veStruct& frame, char const* value) {
+			frame.firmwareVer_FWE[0] = '\0';
+			strncpy(frame.firmwareVer_FW, value, sizeof(frame.firmwareVer_FW));
+		} },
+		// some devices use "FWE" instead of "FW" for the firmware version.
+		{ "FWE", [](veStruct& frame, char const* value) {
+			frame.firmwareVer_FW[0] = '\0';
+			strncpy(frame.firmwareVer_FWE, value, sizeof(frame.firmwareVer_FWE));
+		} },
+		{ "V", [](veStruct& frame, char const* value) {
+			frame.batteryVoltage_V_mV = atol(value);
+		} },
+		{ "I", [](veStruct& frame, char const* value) {
+			frame.batteryCurrent_I_mA = atol(value);
+		} },
+	};
 
-	if (name == "I") {
-		_tmpFrame.batteryCurrent_I_mA = atol(value.c_str());
-		return;
-	}
+	if (dispatchTextData(handlers, static_cast<veStruct&>(_tmpFrame), name, value)) { return; }
 
 	_msgOut->printf("%s Unknown text data '%s' (value '%s')\r\n",
-			_logId, name.c_str(), value.c_str());
+			_logId, name, value);
 }
 
 /*
@@ -289,7 +324,15 @@ typename VeDirectFrameHandler<T>::State VeDirectFrameHandler<T>::hexRxEvent(uint
 		// now we can analyse the hex message
 		_hexBuffer[_hexSize] = '\0';
 		VeDirectHexData data;
-		if (disassembleHexData(data) && !hexDataHandler(data) && _verboseLogging) {
+		if (!disassembleHexData(data)) {
+			// restore previous state
+			ret=_prevState;
+			break;
+		}
+
+		completeHexRequest(data);
+
+		if (!hexDataHandler(data) && _verboseLogging) {
 			_msgOut->printf("%s Unhandled Hex %s Response, addr: 0x%04X (%s), "
 					"value: 0x%08X, flags: 0x%02X\r\n", _logId,
 					data.getResponseAsString().data(),
@@ -14,9 +14,12 @@
 
 #include <Arduino.h>
 #include <array>
+#include <functional>
 #include <memory>
+#include <optional>
 #include <utility>
-#include <deque>
+#include <frozen/unordered_map.h>
+#include <frozen/string.h>
 #include "VeDirectData.h"
 
 template<typename T>
@@ -29,10 +32,32 @@ public:
     bool sendHexCommand(VeDirectHexCommand cmd, VeDirectHexRegister addr, uint32_t value = 0, uint8_t valsize = 0);
     bool isStateIdle() const { return (_state == State::IDLE); }
 
+    // queues a hex command, which is sent from loop() while no text frame
+    // is being received. priority commands (e.g., writes) are sent before
+    // all others. a command already queued for the same register is
+    // replaced. returns false if the queue is full.
+    bool queueHexCommand(VeDirectHexCommand cmd, VeDirectHexRegister addr,
+        uint32_t value = 0, uint8_t valsize = 0, bool priority = false);
+
+    // true while a command for the register is queued or awaits its response
+    bool isHexCommandPending(VeDirectHexCommand cmd, VeDirectHexRegister addr) const;
+
+    // observes the bytes received from the serial port, e.g., to record
+    // them. the bytes are dropped if the tap returns false.
+    using RxTap = std::function<bool(uint8_t inbyte)>;
+    void setRxTap(RxTap tap) { _rxTap = std::move(tap); }
+
+    // processes the bytes as if they were received from the serial port
+    void feed(uint8_t const* data, size_t length);
+
+    // the hardware UART the data is read from, nullptr for a software UART
+    HardwareSerial* getHardwareSerial() const { return _pHwSerial; }
+
 protected:
     VeDirectFrameHandler();
+    // uses a software UART if no hardware UART port is given
     void init(char const* who, int8_t rx, int8_t tx, Print* msgOut,
-        bool verboseLogging, uint8_t hwSerialPort);
+        bool verboseLogging, std::optional<uint8_t> hwSerialPort);
     virtual bool hexDataHandler(VeDirectHexData const &data) { return false; } // handles the disassembled hex response
 
     bool _verboseLogging;
@@ -48,12 +73,38 @@ private:
     void reset();
     void dumpDebugBuffer();
     void rxData(uint8_t inbyte);              // byte of serial data
-    void processTextData(std::string const& name, std::string const& value);
-    virtual bool processTextDataDerived(std::string const& name, std::string const& value) = 0;
+    void processTextData(char const* name, char const* value);
+    virtual bool processTextDataDerived(char const* name, char const* value) = 0;
     virtual void frameValidEvent() { }
     bool disassembleHexData(VeDirectHexData &data);     //return true if disassembling was possible
 
-    std::unique_ptr<HardwareSerial> _vedirectSerial;
+    std::unique_ptr<Stream> _vedirectSerial;
+    HardwareSerial* _pHwSerial = nullptr;
+    RxTap _rxTap;
+
+    struct HexRequest {
+        VeDirectHexCommand cmd;
+        VeDirectHexRegister addr;
+        uint32_t value;
+        uint8_t valsize;
+        bool priority;
+        uint32_t sentMillis;
+    };
+
+    // the device processes commands one after another. sending a few
+    // without waiting for the responses hides the latency, but sending
+    // too many overflows its receive buffer.
+    static constexpr size_t MaxQueuedHexRequests = 8;
+    static constexpr size_t MaxOutstandingHexRequests = 2;
+    static constexpr uint32_t HexResponseTimeoutMillis = 500;
+
+    std::array<HexRequest, MaxQueuedHexRequests> _hexQueue;
+    size_t _hexQueueCount;
+    std::array<HexRequest, MaxOutstandingHexRequests> _hexOutstanding;
+    size_t _hexOutstandingCount;
+
+    void sendQueuedHexCommands();
+    void completeHexRequest(VeDirectHexData const& data);
 
     enum class State {
         IDLE = 1,
@@ -74,7 +125,10 @@ private:
     char _hexBuffer[VE_MAX_HEX_LEN];           // buffer for received hex frames
     char _name[VE_MAX_VALUE_LEN];              // buffer for the field name
     char _value[VE_MAX_VALUE_LEN];             // buffer for the field value
-    std::array<uint8_t, 512> _debugBuffer;
+    // the raw input is captured to be logged per frame, which is only
+    // needed with verbose logging, so the buffer is only allocated then.
+    using DebugBuffer = std::array<uint8_t, 512>;
+    std::unique_ptr<DebugBuffer> _upDebugBuffer;
     unsigned _debugIn;
     uint32_t _lastByteMillis;                  // time of last parsed byte
 
@@ -86,8 +140,29 @@ private:
      * this also handles fragmentation nicely, since there is no need to reset
      * our data buffer. we simply update the interpreted data from this event
      * queue, which is fine as we know the source frame was valid.
+     * the queue is a fixed array to avoid allocations for every record.
      */
-    std::deque<std::pair<std::string, std::string>> _textData;
+    struct TextRecord {
+        char name[VE_MAX_NAME_LEN];
+        char value[VE_MAX_VALUE_LEN];
+    };
+    std::array<TextRecord, VE_MAX_TEXT_RECORDS> _textData;
+    size_t _textDataCount;
+
+protected:
+    // maps text frame labels to functions parsing a value into a frame
+    template<typename Frame, size_t N>
+    using TextHandlers = frozen::unordered_map<frozen::string, void(*)(Frame&, char const*), N>;
+
+    template<typename Frame, size_t N>
+    static bool dispatchTextData(TextHandlers<Frame, N> const& handlers,
+        Frame& frame, char const* name, char const* value)
+    {
+        auto it = handlers.find(frozen::string(name, strlen(name)));
+        if (it == handlers.end()) { return false; }
+        it->second(frame, value);
+        return true;
+    }
 };
 
 template class VeDirectFrameHandler<veMpptStruct>;
@@ -224,3 +224,141 @@ bool VeDirectFrameHandler<T>::sendHexCommand(VeDirectHexCommand cmd, VeDirectHex
 
     return (ret);
 }
+
+
+/*
+ * queueHexCommand()
+ * queue a hex command to be sent by loop(), see sendHexCommand() for the
+ * parameters. priority commands are sent before all others.
+ */
+template<typename T>
+bool VeDirectFrameHandler<T>::queueHexCommand(VeDirectHexCommand cmd, VeDirectHexRegister addr,
+        uint32_t value, uint8_t valsize, bool priority)
+{
+    if (!_canSend) { return false; }
+
+    HexRequest request = { cmd, addr, value, valsize, priority, 0 };
+
+    for (size_t i = 0; i < _hexQueueCount; ++i) {
+        auto& queued = _hexQueue[i];
+        if (queued.cmd != cmd || queued.addr != addr) { continue; }
+        queued.value = value;
+        queued.valsize = valsize;
+        queued.priority = queued.priority || priority;
+        return true;
+    }
+
+    if (_hexQueueCount >= _hexQueue.size()) {
+        _msgOut->printf("%s Hex command queue full, dropping command 0x%X for 0x%04X\r\n",
+                _logId, static_cast<unsigned>(cmd), static_cast<unsigned>(addr));
+        return false;
+    }
+
+    _hexQueue[_hexQueueCount++] = request;
+    return true;
+}
+
+template<typename T>
+bool VeDirectFrameHandler<T>::isHexCommandPending(VeDirectHexCommand cmd, VeDirectHexRegister addr) const
+{
+    auto matches = [cmd, addr](HexRequest const& request) {
+        return request.cmd == cmd && request.addr == addr;
+    };
+
+    for (size_t i = 0; i < _hexQueueCount; ++i) {
+        if (matches(_hexQueue[i])) { return true; }
+    }
+
+    for (size_t i = 0; i < _hexOutstandingCount; ++i) {
+        if (matches(_hexOutstanding[i])) { return true; }
+    }
+
+    return false;
+}
+
+/*
+ * sendQueuedHexCommands()
+ * send queued hex commands while the receiver is idle, i.e., in the gaps
+ * between text frames, as long as not too many responses are outstanding.
+ */
+template<typename T>
+void VeDirectFrameHandler<T>::sendQueuedHexCommands()
+{
+    auto now = millis();
+
+    // requests without a response are given up on after the timeout
+    size_t kept = 0;
+    for (size_t i = 0; i < _hexOutstandingCount; ++i) {
+        auto const& request = _hexOutstanding[i];
+        if ((now - request.sentMillis) > HexResponseTimeoutMillis) {
+            if (_verboseLogging) {
+                _msgOut->printf("%s Hex command 0x%X for 0x%04X timed out\r\n", _logId,
+                        static_cast<unsigned>(request.cmd), static_cast<unsigned>(request.addr));
+            }
+            continue;
+        }
+        _hexOutstanding[kept++] = request;
+    }
+    _hexOutstandingCount = kept;
+
+    while (isStateIdle() && _hexQueueCount > 0
+            && _hexOutstandingCount < _hexOutstanding.size()) {
+        // the first priority command, or the first command otherwise
+        size_t idx = 0;
+        for (size_t i = 0; i < _hexQueueCount; ++i) {
+            if (_hexQueue[i].priority) { idx = i; break; }
+        }
+
+        auto request = _hexQueue[idx];
+        for (size_t i = idx + 1; i < _hexQueueCount; ++i) {
+            _hexQueue[i - 1] = _hexQueue[i];
+        }
+        --_hexQueueCount;
+
+        if (!sendHexCommand(request.cmd, request.addr, request.value, request.valsize)) {
+            continue;
+        }
+
+        request.sentMillis = now;
+        _hexOutstanding[_hexOutstandingCount++] = request;
+    }
+}
+
+/*
+ * completeHexRequest()
+ * remove the outstanding request the hex message answers. GET and SET
+ * responses are matched by register, other responses complete the oldest
+ * request they can belong to.
+ */
+template<typename T>
+void VeDirectFrameHandler<T>::completeHexRequest(VeDirectHexData const& data)
+{
+    using Response = VeDirectHexResponse;
+    using Command = VeDirectHexCommand;
+
+    if (data.rsp == Response::ASYNC) { return; }
+
+    auto matches = [&data](HexRequest const& request) -> bool {
+        switch (data.rsp) {
+            case Response::GET:
+                return request.cmd == Command::GET && request.addr == data.addr;
+            case Response::SET:
+                return request.cmd == Command::SET && request.addr == data.addr;
+            case Response::DONE:
+            case Response::PING:
+                return request.cmd != Command::GET && request.cmd != Command::SET;
+            default: // error responses do not tell which request failed
+                return true;
+        }
+    };
+
+    for (size_t i = 0; i < _hexOutstandingCount; ++i) {
+        if (!matches(_hexOutstanding[i])) { continue; }
+
+        for (size_t j = i + 1; j < _hexOutstandingCount; ++j) {
+            _hexOutstanding[j - 1] = _hexOutstanding[j];
+        }
+        --_hexOutstandingCount;
+        return;
+    }
+}
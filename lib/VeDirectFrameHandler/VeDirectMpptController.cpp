@@ -13,79 +13,66 @@
 //#define PROCESS_NETWORK_STATE
 
 void VeDirectMpptController::init(int8_t rx, int8_t tx, Print* msgOut,
-		bool verboseLogging, uint8_t hwSerialPort)
+		bool verboseLogging, std::optional<uint8_t> hwSerialPort)
 {
 	VeDirectFrameHandler::init("MPPT", rx, tx, msgOut,
 			verboseLogging, hwSerialPort);
 }
 
-bool VeDirectMpptController::processTextDataDerived(std::string const& name, std::string const& value)
+bool VeDirectMpptController::processTextDataDerived(char const* name, char const* value)
 {
-	if (name == "IL") {
-		_tmpFrame.loadCurrent_IL_mA.second = atol(value.c_str());
-        _tmpFrame.loadCurrent_IL_mA.first = millis();
-		return true;
-	}
-	if (name == "LOAD") {
-		_tmpFrame.loadOutputState_LOAD.second = (value == "ON");
-        _tmpFrame.loadOutputState_LOAD.first = millis();
-		return true;
-	}
-    if (name == "RELAY") {
-		_tmpFrame.relayState_RELAY.second = (value == "ON");
-        _tmpFrame.relayState_RELAY.first = millis();
-		return true;
-	}
-	if (name == "CS") {
-		_tmpFrame.currentState_CS = atoi(value.c_str());
-		return true;
-	}
-	if (name == "ERR") {
-		_tmpFrame.errorCode_ERR = atoi(value.c_str());
-		return true;
-	}
-	if (name == "OR") {
-		_tmpFrame.offReason_OR = strtol(value.c_str(), nullptr, 0);
-		return true;
-	}
-	if (name == "MPPT") {
-		_tmpFrame.stateOfTracker_MPPT = atoi(value.c_str());
-		return true;
-	}
-	if (name == "HSDS") {
-		_tmpFrame.daySequenceNr_HSDS = atoi(value.c_str());
-		return true;
-	}
-	if (name == "VPV") {
-		_tmpFrame.panelVoltage_VPV_mV = atol(value.c_str());
-		return true;
-	}
-	if (name == "PPV") {
-		_tmpFrame.panelPower_PPV_W = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H19") {
-		_tmpFrame.yieldTotal_H19_Wh = atol(value.c_str()) * 10;
-		return true;
-	}
-	if (name == "H20") {
-		_tmpFrame.yieldToday_H20_Wh = atol(value.c_str()) * 10;
-		return true;
-	}
-	if (name == "H21") {
-		_tmpFrame.maxPowerToday_H21_W = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H22") {
-		_tmpFrame.yieldYesterday_H22_Wh = atol(value.c_str()) * 10;
-		return true;
-	}
-	if (name == "H23") {
-		_tmpFrame.maxPowerYesterday_H23_W = atoi(value.c_str());
-		return true;
-	}
+	static constexpr TextHandlers<veMpptStruct, 15> handlers = {
+		{ "IL", [](veMpptStruct& frame, char const* value) {
+			frame.loadCurrent_IL_mA.second = atol(value);
+			frame.loadCurrent_IL_mA.first = millis();
+		} },
+		{ "LOAD", [](veMpptStruct& frame, char const* value) {
+			frame.loadOutputState_LOAD.second = (strcmp(value, "ON") == 0);
+			frame.loadOutputState_LOAD.first = millis();
+		} },
+		{ "RELAY", [](veMpptStruct& frame, char const* value) {
+			frame.relayState_RELAY.second = (strcmp(value, "ON") == 0);
+			frame.relayState_RELAY.first = millis();
+		} },
+		{ "CS", [](veMpptStruct& frame, char const* value) {
+			frame.currentState_CS = atoi(value);
+		} },
+		{ "ERR", [](veMpptStruct& frame, char const* value) {
+			frame.errorCode_ERR = atoi(value);
+		} },
+		{ "OR", [](veMpptStruct& frame, char const* value) {
+			frame.offReason_OR = strtol(value, nullptr, 0);
+		} },
+		{ "MPPT", [](veMpptStruct& frame, char const* value) {
+			frame.stateOfTracker_MPPT = atoi(value);
+		} },
+		{ "HSDS", [](veMpptStruct& frame, char const* value) {
+			frame.daySequenceNr_HSDS = atoi(value);
+		} },
+		{ "VPV", [](veMpptStruct& frame, char const* value) {
+			frame.panelVoltage_VPV_mV = atol(value);
+		} },
+		{ "PPV", [](veMpptStruct& frame, char const* value) {
+			frame.panelPower_PPV_W = atoi(value);
+		} },
+		{ "H19", [](veMpptStruct& frame, char const* value) {
+			frame.yieldTotal_H19_Wh = atol(value) * 10;
+		} },
+		{ "H20", [](veMpptStruct& frame, char const* value) {
+			frame.yieldToday_H20_Wh = atol(value) * 10;
+		} },
+		{ "H21", [](veMpptStruct& frame, char const* value) {
+			frame.maxPowerToday_H21_W = atoi(value);
+		} },
+		{ "H22", [](veMpptStruct& frame, char const* value) {
+			frame.yieldYesterday_H22_Wh = atol(value) * 10;
+		} },
+		{ "H23", [](veMpptStruct& frame, char const* value) {
+			frame.maxPowerYesterday_H23_W = atoi(value);
+		} },
+	};
 
-	return false;
+	return dispatchTextData(handlers, _tmpFrame, name, value);
 }
 
 /*
@@ -117,12 +104,12 @@ void VeDirectMpptController::frameValidEvent() {
 
 void VeDirectMpptController::loop()
 {
-	// First we send HEX-Commands (timing improvement)
+	// First we queue the periodic HEX-Commands, which are sent by the base class
 	if (isHexCommandPossible()) {
-		sendNextHexCommandFromQueue();
+		queuePeriodicHexCommands();
 	}
 
-	// Second we read Text- and HEX-Messages
+	// Second we send HEX-Commands and read Text- and HEX-Messages
 	VeDirectFrameHandler::loop();
 
 	// Note: Room for improvement, longer data valid time for slow changing values?
@@ -164,11 +151,6 @@ bool VeDirectMpptController::hexDataHandler(VeDirectHexData const &data) {
 
 	auto regLog = static_cast<uint16_t>(data.addr);
 
-	// we check whether the answer matches a previously asked query
-	if ((data.rsp == VeDirectHexResponse::GET) && (data.addr == _hexQueue[_sendQueueNr]._hexRegister)) {
-		_sendTimeout = 0;
-	}
-
 	switch (data.addr) {
 		case VeDirectHexRegister::ChargeControllerTemperature:
 			_tmpFrame.MpptTemperatureMilliCelsius =
@@ -304,49 +286,20 @@ bool VeDirectMpptController::isHexCommandPossible(void) {
 
 
 /*
- * sendNextHexCommandFromQueue()
- * send one Hex Commands from the Hex Command Queue
- * handles the received hex data from the MPPT
+ * queuePeriodicHexCommands()
+ * queue the periodic register reads which are due. a register is not queued
+ * again while its previous read is still pending, such that a register with
+ * a short period is read at the rate the device answers at most.
  */
-void VeDirectMpptController::sendNextHexCommandFromQueue(void) {
-	// It seems some commands get lost if we send to fast the next command.
-	// maybe we produce an overflow on the MPPT receive buffer or we have to
-	// wait for the MPPT answer before we can send the next command. We only
-	// send a new query in VE.Direct idle state and if no query is pending. In
-	// case we do not get an answer we send the next query from the queue after
-	// a timeout of 500ms. NOTE: _sendTimeout will be set to 0 after receiving
-	// an answer, see function hexDataHandler().
+void VeDirectMpptController::queuePeriodicHexCommands(void) {
 	auto millisTime = millis();
-	if (isStateIdle() && ((millisTime - _hexQueue[_sendQueueNr]._lastSendTime) > _sendTimeout)) {
-
-		// we do 2 loops, first for high prio commands and second for low prio commands
-		bool prio = true;
-		for (auto idy = 0; idy < 2; ++idy) {
-
-			// we start searching the queue with the next queue index
-			auto idx = _sendQueueNr + 1;
-			if (idx >= _hexQueue.size()) { idx = 0; }
-
-			do {
-				// we check if it is time to send the command again
-				if (((prio && (_hexQueue[idx]._readPeriod == HIGH_PRIO_COMMAND)) ||
-					(!prio && (_hexQueue[idx]._readPeriod != HIGH_PRIO_COMMAND))) &&
-					(millisTime - _hexQueue[idx]._lastSendTime) > (_hexQueue[idx]._readPeriod * 1000)) {
-
-					sendHexCommand(VeDirectHexCommand::GET, _hexQueue[idx]._hexRegister);
-					_hexQueue[idx]._lastSendTime = millisTime;
-
-					// we need this information to check if we get an answer, see hexDataHandler()
-					_sendTimeout = 500;
-					_sendQueueNr = idx;
-					return;
-				}
 
-				++idx;
-				if (idx == _hexQueue.size()) { idx = 0; }
-			} while (idx != _sendQueueNr);
+	for (auto& read : _periodicReads) {
+		if ((millisTime - read._lastSendTime) < read._readPeriodMillis) { continue; }
+		if (isHexCommandPending(VeDirectHexCommand::GET, read._hexRegister)) { continue; }
 
-			prio = false; // second loop for low prio commands
+		if (queueHexCommand(VeDirectHexCommand::GET, read._hexRegister)) {
+			read._lastSendTime = millisTime;
 		}
 	}
 }
@@ -38,7 +38,7 @@ private:
 
 struct VeDirectHexQueue {
     VeDirectHexRegister _hexRegister;   // hex register
-    uint8_t _readPeriod;                // time period in sec until we send the command again
+    uint16_t _readPeriodMillis;         // time period in milli sec until we send the command again
     uint32_t _lastSendTime;             // time stamp in milli sec of last send
 };
 
@@ -47,7 +47,7 @@ public:
     VeDirectMpptController() = default;
 
     void init(int8_t rx, int8_t tx, Print* msgOut,
-        bool verboseLogging, uint8_t hwSerialPort);
+        bool verboseLogging, std::optional<uint8_t> hwSerialPort);
 
     using data_t = veMpptStruct;
 
@@ -55,20 +55,18 @@ public:
 
 private:
     bool hexDataHandler(VeDirectHexData const &data) final;
-    bool processTextDataDerived(std::string const& name, std::string const& value) final;
+    bool processTextDataDerived(char const* name, char const* value) final;
     void frameValidEvent() final;
-    void sendNextHexCommandFromQueue(void);
+    void queuePeriodicHexCommands(void);
     bool isHexCommandPossible(void);
     MovingAverage<float, 5> _efficiency;
 
-    uint32_t _sendTimeout = 0;          // timeout until we send the next command from the queue
-    size_t _sendQueueNr = 0;            // actual queue position;
-
-    // for slow changing values we use a send time period of 4 sec
-    #define HIGH_PRIO_COMMAND 1
-    std::array<VeDirectHexQueue, 5> _hexQueue { VeDirectHexRegister::NetworkTotalDcInputPower, HIGH_PRIO_COMMAND, 0,
-                                                VeDirectHexRegister::ChargeControllerTemperature, 4, 0,
-                                                VeDirectHexRegister::SmartBatterySenseTemperature, 4, 0,
-                                                VeDirectHexRegister::BatteryFloatVoltage, 4, 0,
-                                                VeDirectHexRegister::BatteryAbsorptionVoltage, 4, 0 };
+    // the network total DC input power is used by the DPL and is read as
+    // often as the device answers reasonably. for slow changing values we
+    // use a send time period of 4 sec.
+    std::array<VeDirectHexQueue, 5> _periodicReads { VeDirectHexRegister::NetworkTotalDcInputPower, 250, 0,
+                                                     VeDirectHexRegister::ChargeControllerTemperature, 4000, 0,
+                                                     VeDirectHexRegister::SmartBatterySenseTemperature, 4000, 0,
+                                                     VeDirectHexRegister::BatteryFloatVoltage, 4000, 0,
+                                                     VeDirectHexRegister::BatteryAbsorptionVoltage, 4000, 0 };
 };
@@ -1,134 +1,105 @@
 #include <Arduino.h>
 #include "VeDirectShuntController.h"
 
-VeDirectShuntController VeDirectShunt;
-
 void VeDirectShuntController::init(int8_t rx, int8_t tx, Print* msgOut,
-		bool verboseLogging, uint8_t hwSerialPort)
+		bool verboseLogging, std::optional<uint8_t> hwSerialPort)
 {
 	VeDirectFrameHandler::init("SmartShunt", rx, tx, msgOut,
 			verboseLogging, hwSerialPort);
 }
 
-bool VeDirectShuntController::processTextDataDerived(std::string const& name, std::string const& value)
+bool VeDirectShuntController::processTextDataDerived(char const* name, char const* value)
 {
-	if (name == "T") {
-		_tmpFrame.T = atoi(value.c_str());
-		_tmpFrame.tempPresent = true;
-		return true;
-	}
-	if (name == "P") {
-		_tmpFrame.P = atoi(value.c_str());
-		return true;
-	}
-	if (name == "CE") {
-		_tmpFrame.CE = atoi(value.c_str());
-		return true;
-	}
-	if (name == "SOC") {
-		_tmpFrame.SOC = atoi(value.c_str());
-		return true;
-	}
-	if (name == "TTG") {
-		_tmpFrame.TTG = atoi(value.c_str());
-		return true;
-	}
-	if (name == "ALARM") {
-		_tmpFrame.ALARM = (value == "ON");
-		return true;
-	}
-	if (name == "AR") {
-		_tmpFrame.alarmReason_AR = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H1") {
-		_tmpFrame.H1 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H2") {
-		_tmpFrame.H2 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H3") {
-		_tmpFrame.H3 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H4") {
-		_tmpFrame.H4 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H5") {
-		_tmpFrame.H5 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H6") {
-		_tmpFrame.H6 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H7") {
-		_tmpFrame.H7 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H8") {
-		_tmpFrame.H8 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H9") {
-		_tmpFrame.H9 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H10") {
-		_tmpFrame.H10 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H11") {
-		_tmpFrame.H11 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H12") {
-		_tmpFrame.H12 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H13") {
-		_tmpFrame.H13 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H14") {
-		_tmpFrame.H14 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H15") {
-		_tmpFrame.H15 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H16") {
-		_tmpFrame.H16 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H17") {
-		_tmpFrame.H17 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "VM") {
-		_tmpFrame.VM = atoi(value.c_str());
-		return true;
-	}
-	if (name == "DM") {
-		_tmpFrame.DM = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H18") {
-		_tmpFrame.H18 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "BMV") {
+	static constexpr TextHandlers<veShuntStruct, 29> handlers = {
+		{ "T", [](veShuntStruct& frame, char const* value) {
+			frame.T = atoi(value);
+			frame.tempPresent = true;
+		} },
+		{ "P", [](veShuntStruct& frame, char const* value) {
+			frame.P = atoi(value);
+		} },
+		{ "CE", [](veShuntStruct& frame, char const* value) {
+			frame.CE = atoi(value);
+		} },
+		{ "SOC", [](veShuntStruct& frame, char const* value) {
+			frame.SOC = atoi(value);
+		} },
+		{ "TTG", [](veShuntStruct& frame, char const* value) {
+			frame.TTG = atoi(value);
+		} },
+		{ "ALARM", [](veShuntStruct& frame, char const* value) {
+			frame.ALARM = (strcmp(value, "ON") == 0);
+		} },
+		{ "AR", [](veShuntStruct& frame, char const* value) {
+			frame.alarmReason_AR = atoi(value);
+		} },
+		{ "H1", [](veShuntStruct& frame, char const* value) {
+			frame.H1 = atoi(value);
+		} },
+		{ "H2", [](veShuntStruct& frame, char const* value) {
+			frame.H2 = atoi(value);
+		} },
+		{ "H3", [](veShuntStruct& frame, char const* value) {
+			frame.H3 = atoi(value);
+		} },
+		{ "H4", [](veShuntStruct& frame, char const* value) {
+			frame.H4 = atoi(value);
+		} },
+		{ "H5", [](veShuntStruct& frame, char const* value) {
+			frame.H5 = atoi(value);
+		} },
+		{ "H6", [](veShuntStruct& frame, char const* value) {
+			frame.H6 = atoi(value);
+		} },
+		{ "H7", [](veShuntStruct& frame, char const* value) {
+			frame.H7 = atoi(value);
+		} },
+		{ "H8", [](veShuntStruct& frame, char const* value) {
+			frame.H8 = atoi(value);
+		} },
+		{ "H9", [](veShuntStruct& frame, char const* value) {
+			frame.H9 = atoi(value);
+		} },
+		{ "H10", [](veShuntStruct& frame, char const* value) {
+			frame.H10 = atoi(value);
+		} },
+		{ "H11", [](veShuntStruct& frame, char const* value) {
+			frame.H11 = atoi(value);
+		} },
+		{ "H12", [](veShuntStruct& frame, char const* value) {
+			frame.H12 = atoi(value);
+		} },
+		{ "H13", [](veShuntStruct& frame, char const* value) {
+			frame.H13 = atoi(value);
+		} },
+		{ "H14", [](veShuntStruct& frame, char const* value) {
+			frame.H14 = atoi(value);
+		} },
+		{ "H15", [](veShuntStruct& frame, char const* value) {
+			frame.H15 = atoi(value);
+		} },
+		{ "H16", [](veShuntStruct& frame, char const* value) {
+			frame.H16 = atoi(value);
+		} },
+		{ "H17", [](veShuntStruct& frame, char const* value) {
+			frame.H17 = atoi(value);
+		} },
+		{ "VM", [](veShuntStruct& frame, char const* value) {
+			frame.VM = atoi(value);
+		} },
+		{ "DM", [](veShuntStruct& frame, char const* value) {
+			frame.DM = atoi(value);
+		} },
+		{ "H18", [](veShuntStruct& frame, char const* value) {
+			frame.H18 = atoi(value);
+		} },
 		// This field contains a textual description of the BMV model,
 		// for example 602S or 702. It is deprecated, refer to the field PID instead.
-		return true;
-	}
-	if (name == "MON") {
-		_tmpFrame.dcMonitorMode_MON = static_cast<int8_t>(atoi(value.c_str()));
-		return true;
-	}
-	return false;
+		{ "BMV", [](veShuntStruct& frame, char const* value) { } },
+		{ "MON", [](veShuntStruct& frame, char const* value) {
+			frame.dcMonitorMode_MON = static_cast<int8_t>(atoi(value));
+		} },
+	};
+
+	return dispatchTextData(handlers, _tmpFrame, name, value);
 }
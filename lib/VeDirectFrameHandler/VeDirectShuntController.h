@@ -9,12 +9,10 @@ public:
     VeDirectShuntController() = default;
 
     void init(int8_t rx, int8_t tx, Print* msgOut,
-        bool verboseLogging, uint8_t hwSerialPort);
+        bool verboseLogging, std::optional<uint8_t> hwSerialPort);
 
     using data_t = veShuntStruct;
 
 private:
-    bool processTextDataDerived(std::string const& name, std::string const& value) final;
+    bool processTextDataDerived(char const* name, char const* value) final;
 };
-
-extern VeDirectShuntController VeDirectShunt;
@@ -0,0 +1,246 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "Aggregates.h"
+#include "Configuration.h"
+#include "DataBus.h"
+#include "Datastore.h"
+#include "MqttSettings.h"
+#include "TaskProfiler.h"
+#include <battery/Controller.h>
+#include <powermeter/Controller.h>
+#include <solarcharger/Controller.h>
+#include <algorithm>
+#include <ctime>
+
+AggregatesClass Aggregates;
+
+AggregatesClass::AggregatesClass()
+    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("Aggregates::loop", std::bind(&AggregatesClass::loop, this)))
+{
+}
+
+void AggregatesClass::init(Scheduler& scheduler)
+{
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+char const* AggregatesClass::getName(Field field)
+{
+    switch (field) {
+    case Field::InverterAcPower: return "inverter_ac_power";
+    case Field::InverterDcPower: return "inverter_dc_power";
+    case Field::BatteryCurrent: return "battery_current";
+    case Field::GridPower: return "grid_power";
+    case Field::SolarChargerPower: return "solar_charger_power";
+    }
+    return "unknown";
+}
+
+char const* AggregatesClass::getName(Window window)
+{
+    switch (window) {
+    case Window::Minute: return "minute";
+    case Window::QuarterHour: return "quarter_hour";
+    case Window::Day: return "day";
+    }
+    return "unknown";
+}
+
+std::optional<AggregatesClass::Result> AggregatesClass::getCurrent(Field field, Window window) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _current[static_cast<size_t>(field)][static_cast<size_t>(window)].getResult();
+}
+
+std::optional<AggregatesClass::Result> AggregatesClass::getCompleted(Field field, Window window) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _completed[static_cast<size_t>(field)][static_cast<size_t>(window)];
+}
+
+void AggregatesClass::Accumulator::reset(uint32_t start)
+{
+    *this = Accumulator();
+    Start = start;
+}
+
+void AggregatesClass::Accumulator::account(float value, uint32_t millis)
+{
+    WeightedSum += static_cast<double>(value) * millis;
+    Millis += millis;
+}
+
+void AggregatesClass::Accumulator::sample(float value)
+{
+    Min = (Count == 0) ? value : std::min(Min, value);
+    Max = (Count == 0) ? value : std::max(Max, value);
+    ++Count;
+}
+
+std::optional<AggregatesClass::Result> AggregatesClass::Accumulator::getResult() const
+{
+    if (Count == 0) { return std::nullopt; }
+
+    // a single sample which arrived right before the window ended
+    float average = (Millis > 0) ? static_cast<float>(WeightedSum / Millis) : Min;
+
+    return Result { Start, Millis / 1000, Min, Max, average };
+}
+
+uint32_t AggregatesClass::getWindowStart(Window window, uint32_t timestamp)
+{
+    switch (window) {
+    case Window::Minute:
+        return timestamp - (timestamp % 60);
+    case Window::QuarterHour:
+        return timestamp - (timestamp % (15 * 60));
+    case Window::Day: {
+        time_t t = timestamp;
+        struct tm local;
+        localtime_r(&t, &local);
+        return timestamp - (local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec);
+    }
+    }
+    return timestamp;
+}
+
+// accounts the held value of each field up to now. must be called with the
+// mutex held.
+void AggregatesClass::advance(uint32_t now)
+{
+    for (size_t f = 0; f < FIELD_COUNT; ++f) {
+        auto& held = _held[f];
+        if (!held.Valid) { continue; }
+
+        if (now - held.SampleMillis > MAX_GAP_MILLIS) {
+            held.Valid = false;
+            continue;
+        }
+
+        uint32_t elapsed = now - held.AccountedMillis;
+        for (auto& accumulator : _current[f]) {
+            accumulator.account(held.Value, elapsed);
+        }
+        held.AccountedMillis = now;
+    }
+}
+
+void AggregatesClass::sample(Field field, std::optional<float> value, uint32_t now)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    advance(now);
+
+    auto& held = _held[static_cast<size_t>(field)];
+    held.Valid = value.has_value();
+    if (!held.Valid) { return; }
+
+    held.Value = *value;
+    held.SampleMillis = now;
+    held.AccountedMillis = now;
+
+    for (auto& accumulator : _current[static_cast<size_t>(field)]) {
+        if (accumulator.Start != 0) { accumulator.sample(*value); }
+    }
+}
+
+void AggregatesClass::loop()
+{
+    // the windows are aligned to the wall clock
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo, 5)) { return; }
+
+    uint32_t timestamp = time(nullptr);
+    uint32_t now = millis();
+
+    std::array<bool, WINDOW_COUNT> completed = {};
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        advance(now);
+
+        for (size_t w = 0; w < WINDOW_COUNT; ++w) {
+            uint32_t start = getWindowStart(static_cast<Window>(w), timestamp);
+
+            for (size_t f = 0; f < FIELD_COUNT; ++f) {
+                auto& accumulator = _current[f][w];
+                if (accumulator.Start == start) { continue; }
+
+                // the first window after the time became known is
+                // incomplete, which its covered seconds tell.
+                if (accumulator.Start != 0) {
+                    _completed[f][w] = accumulator.getResult();
+                    completed[w] = true;
+                }
+
+                accumulator.reset(start);
+
+                // the held value is the first one of the new window
+                if (_held[f].Valid) { accumulator.sample(_held[f].Value); }
+            }
+        }
+    }
+
+    for (size_t w = 0; w < WINDOW_COUNT; ++w) {
+        if (completed[w]) { publish(static_cast<Window>(w)); }
+    }
+
+    auto const& config = Configuration.get();
+
+    uint32_t sequence = DataBus.getSequence(DataBusClass::Topic::InverterStats);
+    if (sequence != _lastInverterSequence) {
+        _lastInverterSequence = sequence;
+        bool reachable = Datastore.getIsAtLeastOneReachable();
+        sample(Field::InverterAcPower, reachable ? std::optional<float>(Datastore.getTotalAcPowerEnabled()) : std::nullopt, now);
+        sample(Field::InverterDcPower, reachable ? std::optional<float>(Datastore.getTotalDcPowerEnabled()) : std::nullopt, now);
+    }
+
+    sequence = DataBus.getSequence(DataBusClass::Topic::Battery);
+    if (sequence != _lastBatterySequence) {
+        _lastBatterySequence = sequence;
+        auto spStats = Battery.getStats();
+        bool valid = config.Battery.Enabled && spStats->isCurrentValid();
+        sample(Field::BatteryCurrent, valid ? std::optional<float>(spStats->getChargeCurrent()) : std::nullopt, now);
+    }
+
+    sequence = DataBus.getSequence(DataBusClass::Topic::PowerMeter);
+    if (sequence != _lastPowerMeterSequence) {
+        _lastPowerMeterSequence = sequence;
+        bool valid = config.PowerMeter.Enabled && PowerMeter.isDataValid();
+        sample(Field::GridPower, valid ? std::optional<float>(PowerMeter.getPowerTotal()) : std::nullopt, now);
+    }
+
+    sequence = DataBus.getSequence(DataBusClass::Topic::SolarCharger);
+    if (sequence != _lastSolarChargerSequence) {
+        _lastSolarChargerSequence = sequence;
+        auto watts = SolarCharger.getStats()->getOutputPowerWatts();
+        sample(Field::SolarChargerPower, config.SolarCharger.Enabled ? watts : std::nullopt, now);
+    }
+}
+
+void AggregatesClass::publish(Window window)
+{
+    if (!MqttSettings.acceptsPublishes()) { return; }
+
+    // the topic is aggregates/<field>/<window>/<statistic>
+    static constexpr char const* suffixes[WINDOW_COUNT][3] = {
+        { "/minute/min", "/minute/max", "/minute/avg" },
+        { "/quarter_hour/min", "/quarter_hour/max", "/quarter_hour/avg" },
+        { "/day/min", "/day/max", "/day/avg" }
+    };
+
+    auto const& names = suffixes[static_cast<size_t>(window)];
+    auto& topics = MqttTopicRegistry;
+
+    for (size_t f = 0; f < FIELD_COUNT; ++f) {
+        auto field = static_cast<Field>(f);
+        auto oResult = getCompleted(field, window);
+        if (!oResult) { continue; }
+
+        uint8_t digits = (field == Field::BatteryCurrent) ? 2 : 1;
+        MqttSettings.publish(topics.intern("aggregates/", getName(field), names[0]), oResult->Min, digits);
+        MqttSettings.publish(topics.intern("aggregates/", getName(field), names[1]), oResult->Max, digits);
+        MqttSettings.publish(topics.intern("aggregates/", getName(field), names[2]), oResult->Average, digits);
+    }
+}
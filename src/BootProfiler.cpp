@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "BootProfiler.h"
+#include "MessageOutput.h"
+#include "TaskPlacement.h"
+#include <Arduino.h>
+
+BootProfilerClass BootProfiler;
+
+void BootProfilerClass::endStage()
+{
+    if (_current < 0) { return; }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto& stage = _stages[_current];
+    stage.DurationMillis = millis() - stage.StartMillis;
+    _current = -1;
+}
+
+void BootProfilerClass::stage(char const* name)
+{
+    endStage();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _current = _stages.size();
+    _stages.push_back({ name, millis(), 0, false, 0 });
+}
+
+BootProfilerClass::Worker BootProfilerClass::startWorker(char const* name, std::function<void()> func)
+{
+    auto upContext = std::make_unique<WorkerContext>();
+    upContext->pInstance = this;
+    upContext->Func = std::move(func);
+    upContext->Done = xSemaphoreCreateBinary();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        upContext->StageIndex = _stages.size();
+        _stages.push_back({ name, millis(), 0, true, 0 });
+    }
+
+    auto pContext = upContext.get();
+    Worker worker = _workers.size();
+    _workers.push_back(std::move(upContext));
+
+    if (pContext->Done == nullptr || !TaskPlacement::create(TaskPlacement::Role::Boot,
+                &BootProfilerClass::workerHelper, name, WorkerStackSize, pContext, nullptr)) {
+        MessageOutput.printf("[BootProfiler] Cannot start worker for %s\r\n", name);
+        pContext->Func();
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto& stage = _stages[pContext->StageIndex];
+        stage.Concurrent = false;
+        stage.DurationMillis = millis() - stage.StartMillis;
+        if (pContext->Done != nullptr) { xSemaphoreGive(pContext->Done); }
+    }
+
+    return worker;
+}
+
+void BootProfilerClass::workerHelper(void* context)
+{
+    auto pContext = static_cast<WorkerContext*>(context);
+    pContext->Func();
+
+    {
+        auto pInstance = pContext->pInstance;
+        std::lock_guard<std::mutex> lock(pInstance->_mutex);
+        auto& stage = pInstance->_stages[pContext->StageIndex];
+        stage.DurationMillis = millis() - stage.StartMillis;
+    }
+
+    xSemaphoreGive(pContext->Done);
+    vTaskDelete(nullptr);
+}
+
+void BootProfilerClass::join(Worker worker)
+{
+    auto& upContext = _workers[worker];
+    if (!upContext) { return; }
+
+    uint32_t start = millis();
+    if (upContext->Done != nullptr) {
+        xSemaphoreTake(upContext->Done, portMAX_DELAY);
+        vSemaphoreDelete(upContext->Done);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stages[upContext->StageIndex].WaitMillis = millis() - start;
+    }
+
+    upContext.reset();
+}
+
+void BootProfilerClass::finish()
+{
+    endStage();
+    _controlMillis = millis();
+
+    MessageOutput.printf("[BootProfiler] Control loops start after %" PRIu32 " ms\r\n", _controlMillis);
+}
+
+std::vector<BootProfilerClass::Stage> BootProfilerClass::getStages() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stages;
+}
@@ -3,27 +3,195 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "Configuration.h"
+#include "ConfigFields.h"
+#include "MemoryPolicy.h"
 #include "MessageOutput.h"
 #include "NetworkSettings.h"
 #include "Utils.h"
 #include "defaults.h"
+#include "__compiled_constants.h"
 #include <LittleFS.h>
+#include <esp_rom_crc.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <vector>
 #include <nvs_flash.h>
+#include "TaskProfiler.h"
 
+// the master copy of the configuration. it is only modified while holding
+// sWriterMutex, or during startup, before any other task is running.
 CONFIG_T config;
 
-static std::condition_variable sWriterCv;
 static std::mutex sWriterMutex;
-static unsigned sWriterCount = 0;
+
+// readers are handed the most recently published immutable copy of the
+// configuration. writers modify the master copy and publish a new copy of
+// it once they are done. readers never block and never observe a partially
+// updated configuration.
+static std::atomic<CONFIG_T const*> sPublished(&config);
+static std::atomic<uint32_t> sGeneration(0);
+
+// replaced copies are freed only after the main loop passed its quiescent
+// point (the configuration task) and after a grace period, which covers
+// readers in other tasks that still hold a reference obtained before.
+struct RetiredConfig {
+    std::unique_ptr<CONFIG_T const> upConfig;
+    uint32_t retiredMillis;
+};
+static std::vector<RetiredConfig> sRetired;
+static std::mutex sRetiredMutex;
+static constexpr uint32_t RETIRED_CONFIG_GRACE_MS = 5000;
+
+static void publishConfig()
+{
+    auto upCopy = std::make_unique<CONFIG_T>(config);
+    CONFIG_T const* previous = sPublished.exchange(upCopy.release(), std::memory_order_acq_rel);
+    ++sGeneration;
+    if (previous == &config) { return; }
+
+    std::lock_guard<std::mutex> lock(sRetiredMutex);
+    sRetired.push_back({ std::unique_ptr<CONFIG_T const>(previous), millis() });
+}
+
+static void reclaimRetiredConfigs()
+{
+    std::lock_guard<std::mutex> lock(sRetiredMutex);
+
+    uint32_t now = millis();
+    sRetired.erase(std::remove_if(sRetired.begin(), sRetired.end(),
+        [now](RetiredConfig const& r) { return (now - r.retiredMillis) >= RETIRED_CONFIG_GRACE_MS; }),
+        sRetired.end());
+}
+
+namespace {
+
+// writes the top-level sections of the config file one after another, such
+// that only the JSON document of one section is held in memory at a time.
+// a section is serialized once the next one is added, so each returned
+// object or array stays valid until the next section is added.
+class SectionWriter {
+public:
+    explicit SectionWriter(File& f)
+        : _f(f)
+        , _doc(MemoryPolicy::jsonAllocator()) { }
+
+    JsonObject addObject(char const* key)
+    {
+        flush();
+        _key = key;
+        return _doc.to<JsonObject>();
+    }
+
+    JsonArray addArray(char const* key)
+    {
+        flush();
+        _key = key;
+        return _doc.to<JsonArray>();
+    }
+
+    // returns the size of the JSON document written, zero on failure
+    size_t finish()
+    {
+        flush();
+        if (_size == 0) { print("{"); }
+        print("}");
+        return _failed ? 0 : _size;
+    }
+
+private:
+    void flush()
+    {
+        if (_key == nullptr) { return; }
+
+        if (!Utils::checkJsonAlloc(_doc, __FUNCTION__, __LINE__)) { _failed = true; }
+
+        if (!_failed) {
+            print(_size == 0 ? "{\"" : ",\"");
+            print(_key);
+            print("\":");
+
+            size_t written = serializeJson(_doc, _f);
+            if (written == 0) { _failed = true; }
+            _size += written;
+        }
+
+        _key = nullptr;
+        _doc.clear();
+    }
+
+    void print(char const* text)
+    {
+        size_t len = strlen(text);
+        if (_f.write(reinterpret_cast<uint8_t const*>(text), len) != len) { _failed = true; }
+        _size += len;
+    }
+
+    File& _f;
+    JsonDocument _doc;
+    char const* _key = nullptr;
+    size_t _size = 0;
+    bool _failed = false;
+};
+
+// reads one top-level section of the config file at a time, using a filter
+// which makes the parser skip all other sections, such that only the JSON
+// document of one section is held in memory. the file is parsed once per
+// section requested, and each section stays valid until another one is
+// requested.
+class SectionReader {
+public:
+    explicit SectionReader(File& f)
+        : _f(f)
+        , _start(f ? f.position() : 0)
+        , _doc(MemoryPolicy::jsonAllocator()) { }
+
+    // the section's value, which is null if the section is missing
+    JsonVariant get(char const* key)
+    {
+        if (_key == key) { return _doc[key].as<JsonVariant>(); }
+
+        _doc.clear();
+
+        JsonDocument filter;
+        filter[key] = true;
+
+        if (_f) { _f.seek(_start); }
+        _error = deserializeJson(_doc, _f, DeserializationOption::Filter(filter));
+        _key = key;
+
+        if (!Utils::checkJsonAlloc(_doc, __FUNCTION__, __LINE__)) { _overflowed = true; }
+
+        return _doc[key].as<JsonVariant>();
+    }
+
+    // the result of parsing the file for the section requested last
+    DeserializationError getError() const { return _error; }
+
+    // a section requested so far exceeded the memory available
+    bool overflowed() const { return _overflowed; }
+
+private:
+    File& _f;
+    size_t _start;
+    JsonDocument _doc;
+    String _key;
+    DeserializationError _error;
+    bool _overflowed = false;
+};
+
+} // namespace
 
 void ConfigurationClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&ConfigurationClass::loop, this));
+    _loopTask.setCallback(TaskProfiler.wrap("Configuration::loop", std::bind(&ConfigurationClass::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
 
     memset(&config, 0x0, sizeof(config));
+    publishConfig();
 }
 
 // we want a representation of our floating-point value in the JSON that
@@ -36,41 +204,23 @@ void ConfigurationClass::init(Scheduler& scheduler)
 // actual value is a float (32 bits).
 double ConfigurationClass::roundedFloat(float val)
 {
-    return static_cast<int>(val * 100 + (val > 0 ? 0.5 : -0.5)) / 100.0;
+    return ConfigFields::roundedFloat(val);
 }
 
 void ConfigurationClass::serializeHttpRequestConfig(HttpRequestConfig const& source, JsonObject& target)
 {
     JsonObject target_http_config = target["http_request"].to<JsonObject>();
-    target_http_config["url"] = source.Url;
-    target_http_config["auth_type"] = source.AuthType;
-    target_http_config["username"] = source.Username;
-    target_http_config["password"] = source.Password;
-    target_http_config["header_key"] = source.HeaderKey;
-    target_http_config["header_value"] = source.HeaderValue;
-    target_http_config["timeout"] = source.Timeout;
+    ConfigFields::serialize(ConfigFields::HttpRequest, source, target_http_config);
 }
 
 void ConfigurationClass::serializeSolarChargerConfig(SolarChargerConfig const& source, JsonObject& target)
 {
-    target["enabled"] = source.Enabled;
-    target["verbose_logging"] = source.VerboseLogging;
-    target["provider"] = source.Provider;
-    target["publish_updates_only"] = source.PublishUpdatesOnly;
+    ConfigFields::serialize(ConfigFields::SolarCharger, source, target);
 }
 
 void ConfigurationClass::serializeSolarChargerMqttConfig(SolarChargerMqttConfig const& source, JsonObject& target)
 {
-    target["calculate_output_power"] = source.CalculateOutputPower;
-    target["power_topic"] = source.PowerTopic;
-    target["power_path"] = source.PowerJsonPath;
-    target["power_unit"] = source.PowerUnit;
-    target["voltage_topic"] = source.VoltageTopic;
-    target["voltage_path"] = source.VoltageJsonPath;
-    target["voltage_unit"] = source.VoltageTopicUnit;
-    target["current_topic"] = source.CurrentTopic;
-    target["current_path"] = source.CurrentJsonPath;
-    target["current_unit"] = source.CurrentUnit;
+    ConfigFields::serialize(ConfigFields::SolarChargerMqtt, source, target);
 }
 
 void ConfigurationClass::serializePowerMeterMqttConfig(PowerMeterMqttConfig const& source, JsonObject& target)
@@ -89,8 +239,7 @@ void ConfigurationClass::serializePowerMeterMqttConfig(PowerMeterMqttConfig cons
 
 void ConfigurationClass::serializePowerMeterSerialSdmConfig(PowerMeterSerialSdmConfig const& source, JsonObject& target)
 {
-    target["address"] = source.Address;
-    target["polling_interval"] = source.PollingInterval;
+    ConfigFields::serialize(ConfigFields::PowerMeterSerialSdm, source, target);
 }
 
 void ConfigurationClass::serializePowerMeterHttpJsonConfig(PowerMeterHttpJsonConfig const& source, JsonObject& target)
@@ -118,26 +267,29 @@ void ConfigurationClass::serializePowerMeterHttpSmlConfig(PowerMeterHttpSmlConfi
     serializeHttpRequestConfig(source.HttpRequest, target);
 }
 
+void ConfigurationClass::serializePowerMeterUdpSmaHmConfig(PowerMeterUdpSmaHmConfig const& source, JsonObject& target)
+{
+    ConfigFields::serialize(ConfigFields::PowerMeterUdpSmaHm, source, target);
+}
+
+void ConfigurationClass::serializePowerMeterUdpPushConfig(PowerMeterUdpPushConfig const& source, JsonObject& target)
+{
+    ConfigFields::serialize(ConfigFields::PowerMeterUdpPush, source, target);
+}
+
+void ConfigurationClass::serializePowerMeterShellyRpcConfig(PowerMeterShellyRpcConfig const& source, JsonObject& target)
+{
+    ConfigFields::serialize(ConfigFields::PowerMeterShellyRpc, source, target);
+}
+
+void ConfigurationClass::serializePowerMeterFusionConfig(PowerMeterFusionConfig const& source, JsonObject& target)
+{
+    ConfigFields::serialize(ConfigFields::PowerMeterFusion, source, target);
+}
+
 void ConfigurationClass::serializeBatteryConfig(BatteryConfig const& source, JsonObject& target)
 {
-    target["enabled"] = config.Battery.Enabled;
-    target["verbose_logging"] = config.Battery.VerboseLogging;
-    target["provider"] = config.Battery.Provider;
-    target["jkbms_interface"] = config.Battery.JkBmsInterface;
-    target["jkbms_polling_interval"] = config.Battery.JkBmsPollingInterval;
-    target["mqtt_soc_topic"] = config.Battery.MqttSocTopic;
-    target["mqtt_soc_json_path"] = config.Battery.MqttSocJsonPath;
-    target["mqtt_voltage_topic"] = config.Battery.MqttVoltageTopic;
-    target["mqtt_voltage_json_path"] = config.Battery.MqttVoltageJsonPath;
-    target["mqtt_voltage_unit"] = config.Battery.MqttVoltageUnit;
-    target["enable_discharge_current_limit"] = config.Battery.EnableDischargeCurrentLimit;
-    target["discharge_current_limit"] = config.Battery.DischargeCurrentLimit;
-    target["discharge_current_limit_below_soc"] = config.Battery.DischargeCurrentLimitBelowSoc;
-    target["discharge_current_limit_below_voltage"] = config.Battery.DischargeCurrentLimitBelowVoltage;
-    target["use_battery_reported_discharge_current_limit"] = config.Battery.UseBatteryReportedDischargeCurrentLimit;
-    target["mqtt_discharge_current_topic"] = config.Battery.MqttDischargeCurrentTopic;
-    target["mqtt_discharge_current_json_path"] = config.Battery.MqttDischargeCurrentJsonPath;
-    target["mqtt_amperage_unit"] = config.Battery.MqttAmperageUnit;
+    ConfigFields::serialize(ConfigFields::Battery, source, target);
 }
 
 void ConfigurationClass::serializePowerLimiterConfig(PowerLimiterConfig const& source, JsonObject& target)
@@ -153,6 +305,7 @@ void ConfigurationClass::serializePowerLimiterConfig(PowerLimiterConfig const& s
     target["enabled"] = source.Enabled;
     target["verbose_logging"] = source.VerboseLogging;
     target["solar_passthrough_enabled"] = source.SolarPassThroughEnabled;
+    target["solar_power_prediction"] = source.SolarPowerPrediction;
     target["conduction_losses"] = source.ConductionLosses;
     target["battery_always_use_at_night"] = source.BatteryAlwaysUseAtNight;
     target["target_power_consumption"] = source.TargetPowerConsumption;
@@ -164,6 +317,8 @@ void ConfigurationClass::serializePowerLimiterConfig(PowerLimiterConfig const& s
     target["voltage_start_threshold"] = roundedFloat(source.VoltageStartThreshold);
     target["voltage_stop_threshold"] = roundedFloat(source.VoltageStopThreshold);
     target["voltage_load_correction_factor"] = source.VoltageLoadCorrectionFactor;
+    target["voltage_load_correction_adaptive"] = source.VoltageLoadCorrectionAdaptive;
+    target["battery_capacity"] = source.BatteryCapacity;
     target["full_solar_passthrough_soc"] = source.FullSolarPassThroughSoc;
     target["full_solar_passthrough_start_voltage"] = roundedFloat(source.FullSolarPassThroughStartVoltage);
     target["full_solar_passthrough_stop_voltage"] = roundedFloat(source.FullSolarPassThroughStopVoltage);
@@ -171,6 +326,20 @@ void ConfigurationClass::serializePowerLimiterConfig(PowerLimiterConfig const& s
     target["inverter_channel_id_for_dc_voltage"] = source.InverterChannelIdForDcVoltage;
     target["inverter_restart_hour"] = source.RestartHour;
     target["total_upper_power_limit"] = source.TotalUpperPowerLimit;
+    target["distribution_strategy"] = source.Distribution;
+    target["cluster_role"] = source.Cluster.Role;
+    target["cluster_port"] = source.Cluster.Port;
+    target["cluster_id"] = source.Cluster.Id;
+    target["latency_alert_reaction_ms"] = source.LatencyAlert.ReactionMillis;
+    target["latency_alert_meter_interval_ms"] = source.LatencyAlert.MeterIntervalMillis;
+    target["latency_alert_stats_age_ms"] = source.LatencyAlert.StatsAgeMillis;
+    target["shadow_enabled"] = source.Shadow.Enabled;
+    target["shadow_target_power_consumption"] = source.Shadow.TargetPowerConsumption;
+    target["shadow_target_power_consumption_hysteresis"] = source.Shadow.TargetPowerConsumptionHysteresis;
+    target["shadow_battery_soc_start_threshold"] = source.Shadow.BatterySocStartThreshold;
+    target["shadow_battery_soc_stop_threshold"] = source.Shadow.BatterySocStopThreshold;
+    target["shadow_voltage_start_threshold"] = roundedFloat(source.Shadow.VoltageStartThreshold);
+    target["shadow_voltage_stop_threshold"] = roundedFloat(source.Shadow.VoltageStopThreshold);
 
     JsonArray inverters = target["inverters"].to<JsonArray>();
     for (size_t i = 0; i < INV_MAX_COUNT; ++i) {
@@ -191,37 +360,27 @@ void ConfigurationClass::serializePowerLimiterConfig(PowerLimiterConfig const& s
 
 void ConfigurationClass::serializeGridChargerConfig(GridChargerConfig const& source, JsonObject& target)
 {
-    target["enabled"] = source.Enabled;
-    target["verbose_logging"] = source.VerboseLogging;
-    target["hardware_interface"] = source.HardwareInterface;
-    target["can_controller_frequency"] = source.CAN_Controller_Frequency;
-    target["auto_power_enabled"] = source.Auto_Power_Enabled;
-    target["auto_power_batterysoc_limits_enabled"] = source.Auto_Power_BatterySoC_Limits_Enabled;
-    target["emergency_charge_enabled"] = source.Emergency_Charge_Enabled;
-    target["voltage_limit"] = roundedFloat(source.Auto_Power_Voltage_Limit);
-    target["enable_voltage_limit"] = roundedFloat(source.Auto_Power_Enable_Voltage_Limit);
-    target["lower_power_limit"] = source.Auto_Power_Lower_Power_Limit;
-    target["upper_power_limit"] = source.Auto_Power_Upper_Power_Limit;
-    target["stop_batterysoc_threshold"] = source.Auto_Power_Stop_BatterySoC_Threshold;
-    target["target_power_consumption"] = source.Auto_Power_Target_Power_Consumption;
+    ConfigFields::serialize(ConfigFields::GridCharger, source, target);
 }
 
 bool ConfigurationClass::write()
 {
-    File f = LittleFS.open(CONFIG_FILENAME, "w");
+    // the new configuration is staged in temporary files, which then replace
+    // the current ones, such that an interrupted write does not corrupt them.
+    File f = LittleFS.open(CONFIG_FILENAME CONFIG_TMP_SUFFIX, "w");
     if (!f) {
         return false;
     }
     config.Cfg.SaveCount++;
 
-    JsonDocument doc;
+    SectionWriter writer(f);
 
-    JsonObject cfg = doc["cfg"].to<JsonObject>();
+    JsonObject cfg = writer.addObject("cfg");
     cfg["version"] = config.Cfg.Version;
     cfg["version_onbattery"] = config.Cfg.VersionOnBattery;
     cfg["save_count"] = config.Cfg.SaveCount;
 
-    JsonObject wifi = doc["wifi"].to<JsonObject>();
+    JsonObject wifi = writer.addObject("wifi");
     wifi["ssid"] = config.WiFi.Ssid;
     wifi["password"] = config.WiFi.Password;
     wifi["ip"] = IPAddress(config.WiFi.Ip).toString();
@@ -232,16 +391,33 @@ bool ConfigurationClass::write()
     wifi["dhcp"] = config.WiFi.Dhcp;
     wifi["hostname"] = config.WiFi.Hostname;
     wifi["aptimeout"] = config.WiFi.ApTimeout;
+    wifi["powersave"] = config.WiFi.PowerSave;
+    wifi["failover"] = config.WiFi.Failover;
 
-    JsonObject mdns = doc["mdns"].to<JsonObject>();
+    JsonObject mdns = writer.addObject("mdns");
     mdns["enabled"] = config.Mdns.Enabled;
 
-    JsonObject syslog = doc["syslog"].to<JsonObject>();
+    JsonObject syslog = writer.addObject("syslog");
     syslog["enabled"] = config.Syslog.Enabled;
     syslog["hostname"] = config.Syslog.Hostname;
     syslog["port"] = config.Syslog.Port;
-
-    JsonObject ntp = doc["ntp"].to<JsonObject>();
+    syslog["protocol"] = config.Syslog.Protocol;
+
+    JsonObject influx = writer.addObject("influx");
+    influx["enabled"] = config.Influx.Enabled;
+    influx["hostname"] = config.Influx.Hostname;
+    influx["port"] = config.Influx.Port;
+    influx["protocol"] = config.Influx.Protocol;
+    influx["interval"] = config.Influx.Interval;
+    influx["path"] = config.Influx.Path;
+    influx["token"] = config.Influx.Token;
+
+    JsonObject modbus = writer.addObject("modbus");
+    modbus["enabled"] = config.Modbus.Enabled;
+    modbus["port"] = config.Modbus.Port;
+    modbus["write_enabled"] = config.Modbus.WriteEnabled;
+
+    JsonObject ntp = writer.addObject("ntp");
     ntp["server"] = config.Ntp.Server;
     ntp["timezone"] = config.Ntp.Timezone;
     ntp["timezone_descr"] = config.Ntp.TimezoneDescr;
@@ -249,7 +425,7 @@ bool ConfigurationClass::write()
     ntp["longitude"] = config.Ntp.Longitude;
     ntp["sunsettype"] = config.Ntp.SunsetType;
 
-    JsonObject mqtt = doc["mqtt"].to<JsonObject>();
+    JsonObject mqtt = writer.addObject("mqtt");
     mqtt["enabled"] = config.Mqtt.Enabled;
     mqtt["verbose_logging"] = config.Mqtt.VerboseLogging;
     mqtt["hostname"] = config.Mqtt.Hostname;
@@ -260,7 +436,11 @@ bool ConfigurationClass::write()
     mqtt["topic"] = config.Mqtt.Topic;
     mqtt["retain"] = config.Mqtt.Retain;
     mqtt["publish_interval"] = config.Mqtt.PublishInterval;
+    mqtt["publish_refresh_interval"] = config.Mqtt.PublishRefreshInterval;
+    mqtt["publish_deadband"] = config.Mqtt.PublishDeadband;
+    mqtt["inverter_json_payload"] = config.Mqtt.InverterJsonPayload;
     mqtt["clean_session"] = config.Mqtt.CleanSession;
+    mqtt["outbox_limit"] = config.Mqtt.OutboxLimit;
 
     JsonObject mqtt_lwt = mqtt["lwt"].to<JsonObject>();
     mqtt_lwt["topic"] = config.Mqtt.Lwt.Topic;
@@ -270,10 +450,7 @@ bool ConfigurationClass::write()
 
     JsonObject mqtt_tls = mqtt["tls"].to<JsonObject>();
     mqtt_tls["enabled"] = config.Mqtt.Tls.Enabled;
-    mqtt_tls["root_ca_cert"] = config.Mqtt.Tls.RootCaCert;
     mqtt_tls["certlogin"] = config.Mqtt.Tls.CertLogin;
-    mqtt_tls["client_cert"] = config.Mqtt.Tls.ClientCert;
-    mqtt_tls["client_key"] = config.Mqtt.Tls.ClientKey;
 
     JsonObject mqtt_hass = mqtt["hass"].to<JsonObject>();
     mqtt_hass["enabled"] = config.Mqtt.Hass.Enabled;
@@ -281,21 +458,23 @@ bool ConfigurationClass::write()
     mqtt_hass["topic"] = config.Mqtt.Hass.Topic;
     mqtt_hass["individual_panels"] = config.Mqtt.Hass.IndividualPanels;
     mqtt_hass["expire"] = config.Mqtt.Hass.Expire;
+    mqtt_hass["device_discovery"] = config.Mqtt.Hass.DeviceDiscovery;
 
-    JsonObject dtu = doc["dtu"].to<JsonObject>();
+    JsonObject dtu = writer.addObject("dtu");
     dtu["serial"] = config.Dtu.Serial;
     dtu["poll_interval"] = config.Dtu.PollInterval;
     dtu["verbose_logging"] = config.Dtu.VerboseLogging;
+    dtu["low_power_night"] = config.Dtu.LowPowerNight;
     dtu["nrf_pa_level"] = config.Dtu.Nrf.PaLevel;
     dtu["cmt_pa_level"] = config.Dtu.Cmt.PaLevel;
     dtu["cmt_frequency"] = config.Dtu.Cmt.Frequency;
     dtu["cmt_country_mode"] = config.Dtu.Cmt.CountryMode;
 
-    JsonObject security = doc["security"].to<JsonObject>();
+    JsonObject security = writer.addObject("security");
     security["password"] = config.Security.Password;
     security["allow_readonly"] = config.Security.AllowReadonly;
 
-    JsonObject device = doc["device"].to<JsonObject>();
+    JsonObject device = writer.addObject("device");
     device["pinmapping"] = config.Dev_PinMapping;
 
     JsonObject display = device["display"].to<JsonObject>();
@@ -313,7 +492,7 @@ bool ConfigurationClass::write()
         led["brightness"] = config.Led_Single[i].Brightness;
     }
 
-    JsonArray inverters = doc["inverters"].to<JsonArray>();
+    JsonArray inverters = writer.addArray("inverters");
     for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
         JsonObject inv = inverters.add<JsonObject>();
         inv["serial"] = config.Inverter[i].Serial;
@@ -338,16 +517,17 @@ bool ConfigurationClass::write()
         }
     }
 
-    JsonObject solarcharger = doc["solarcharger"].to<JsonObject>();
+    JsonObject solarcharger = writer.addObject("solarcharger");
     serializeSolarChargerConfig(config.SolarCharger, solarcharger);
 
     JsonObject solarcharger_mqtt = solarcharger["mqtt"].to<JsonObject>();
     serializeSolarChargerMqttConfig(config.SolarCharger.Mqtt, solarcharger_mqtt);
 
-    JsonObject powermeter = doc["powermeter"].to<JsonObject>();
+    JsonObject powermeter = writer.addObject("powermeter");
     powermeter["enabled"] = config.PowerMeter.Enabled;
     powermeter["verbose_logging"] = config.PowerMeter.VerboseLogging;
     powermeter["source"] = config.PowerMeter.Source;
+    powermeter["predictive_filter"] = config.PowerMeter.PredictiveFilter;
 
     JsonObject powermeter_mqtt = powermeter["mqtt"].to<JsonObject>();
     serializePowerMeterMqttConfig(config.PowerMeter.Mqtt, powermeter_mqtt);
@@ -361,60 +541,276 @@ bool ConfigurationClass::write()
     JsonObject powermeter_http_sml = powermeter["http_sml"].to<JsonObject>();
     serializePowerMeterHttpSmlConfig(config.PowerMeter.HttpSml, powermeter_http_sml);
 
-    JsonObject powerlimiter = doc["powerlimiter"].to<JsonObject>();
+    JsonObject powermeter_udp_smahm = powermeter["udp_smahm"].to<JsonObject>();
+    serializePowerMeterUdpSmaHmConfig(config.PowerMeter.UdpSmaHm, powermeter_udp_smahm);
+
+    JsonObject powermeter_udp_push = powermeter["udp_push"].to<JsonObject>();
+    serializePowerMeterUdpPushConfig(config.PowerMeter.UdpPush, powermeter_udp_push);
+
+    JsonObject powermeter_shelly_rpc = powermeter["shelly_rpc"].to<JsonObject>();
+    serializePowerMeterShellyRpcConfig(config.PowerMeter.ShellyRpc, powermeter_shelly_rpc);
+
+    JsonObject powermeter_fusion = powermeter["fusion"].to<JsonObject>();
+    serializePowerMeterFusionConfig(config.PowerMeter.Fusion, powermeter_fusion);
+
+    JsonObject powerlimiter = writer.addObject("powerlimiter");
     serializePowerLimiterConfig(config.PowerLimiter, powerlimiter);
 
-    JsonObject battery = doc["battery"].to<JsonObject>();
+    JsonObject battery = writer.addObject("battery");
     serializeBatteryConfig(config.Battery, battery);
 
-    JsonObject huawei = doc["huawei"].to<JsonObject>();
+    JsonObject huawei = writer.addObject("huawei");
     serializeGridChargerConfig(config.Huawei, huawei);
 
-    if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
+    size_t jsonSize = writer.finish();
+    if (jsonSize == 0) {
+        MessageOutput.println("Failed to write file");
+        return false;
+    }
+
+    f.close();
+
+    // the old snapshot is removed first, so it is never paired with the new
+    // JSON file should we be interrupted before the new snapshot is in place.
+    bool snapshotWritten = writeSnapshot(jsonSize);
+    LittleFS.remove(CONFIG_SNAPSHOT_FILENAME);
+
+    if (!LittleFS.rename(CONFIG_FILENAME CONFIG_TMP_SUFFIX, CONFIG_FILENAME)) {
+        MessageOutput.println("Failed to replace config file");
         return false;
     }
 
-    // Serialize JSON to file
-    if (serializeJson(doc, f) == 0) {
-        MessageOutput.println("Failed to write file");
+    if (snapshotWritten) {
+        LittleFS.rename(CONFIG_SNAPSHOT_FILENAME CONFIG_TMP_SUFFIX, CONFIG_SNAPSHOT_FILENAME);
+    }
+
+    return true;
+}
+
+struct ConfigSnapshotHeader {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t VersionOnBattery;
+    uint32_t PayloadSize;
+    uint32_t JsonSize;
+    char GitHash[16];
+    uint32_t Crc;
+};
+
+struct ConfigSnapshot {
+    ConfigSnapshotHeader Header;
+    CONFIG_T Config;
+};
+
+static constexpr uint32_t CONFIG_SNAPSHOT_MAGIC = 0x4f434647; // "OCFG"
+
+// the layout of CONFIG_T changes without CONFIG_VERSION being incremented,
+// so a snapshot is only accepted if written by the very same firmware build.
+static void fillSnapshotHeader(ConfigSnapshotHeader& header, CONFIG_T const& cfg, size_t jsonSize)
+{
+    header.Magic = CONFIG_SNAPSHOT_MAGIC;
+    header.Version = CONFIG_VERSION;
+    header.VersionOnBattery = CONFIG_VERSION_ONBATTERY;
+    header.PayloadSize = sizeof(CONFIG_T);
+    header.JsonSize = jsonSize;
+    strlcpy(header.GitHash, __COMPILED_GIT_HASH__, sizeof(header.GitHash));
+    header.Crc = esp_rom_crc32_le(0, reinterpret_cast<uint8_t const*>(&cfg), sizeof(CONFIG_T));
+}
+
+// writes the snapshot to a temporary file, which the caller moves into place
+bool ConfigurationClass::writeSnapshot(size_t jsonSize)
+{
+    ConfigSnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    fillSnapshotHeader(header, config, jsonSize);
+
+    File f = LittleFS.open(CONFIG_SNAPSHOT_FILENAME CONFIG_TMP_SUFFIX, "w");
+    if (!f) {
+        MessageOutput.println("Failed to open config snapshot for writing");
+        return false;
+    }
+
+    bool success = f.write(reinterpret_cast<uint8_t const*>(&header), sizeof(header)) == sizeof(header)
+        && f.write(reinterpret_cast<uint8_t const*>(&config), sizeof(config)) == sizeof(config);
+    f.close();
+
+    if (!success) {
+        MessageOutput.println("Failed to write config snapshot");
+        LittleFS.remove(CONFIG_SNAPSHOT_FILENAME CONFIG_TMP_SUFFIX);
+    }
+
+    return success;
+}
+
+bool ConfigurationClass::readSnapshot()
+{
+    File json = LittleFS.open(CONFIG_FILENAME, "r", false);
+    if (!json) { return false; }
+    size_t jsonSize = json.size();
+    json.close();
+
+    File f = LittleFS.open(CONFIG_SNAPSHOT_FILENAME, "r", false);
+    if (!f) { return false; }
+
+    if (f.size() != sizeof(ConfigSnapshot)) {
+        MessageOutput.print("config snapshot size mismatch... ");
         return false;
     }
 
+    auto upSnapshot = std::make_unique<ConfigSnapshot>();
+    size_t bytesRead = f.read(reinterpret_cast<uint8_t*>(upSnapshot.get()), sizeof(ConfigSnapshot));
     f.close();
+
+    if (bytesRead != sizeof(ConfigSnapshot)) { return false; }
+
+    ConfigSnapshotHeader expected;
+    memset(&expected, 0, sizeof(expected));
+    fillSnapshotHeader(expected, upSnapshot->Config, jsonSize);
+
+    if (memcmp(&expected, &upSnapshot->Header, sizeof(expected)) != 0) {
+        MessageOutput.print("config snapshot outdated... ");
+        return false;
+    }
+
+    memcpy(&config, &upSnapshot->Config, sizeof(config));
     return true;
 }
 
+struct ConfigBackupHeader {
+    uint32_t Magic;
+    uint16_t Format;
+    uint16_t Flags;
+    uint32_t Version;
+    uint32_t VersionOnBattery;
+    uint32_t PayloadSize;
+    char GitHash[16];
+    uint32_t Crc;
+    uint32_t Reserved[2];
+};
+
+// the payload follows the header, which must keep it aligned
+static_assert(sizeof(ConfigBackupHeader) % alignof(CONFIG_T) == 0);
+
+static constexpr uint32_t CONFIG_BACKUP_MAGIC = 0x4f43424b; // "OCBK"
+static constexpr uint16_t CONFIG_BACKUP_FORMAT = 1;
+static constexpr uint16_t CONFIG_BACKUP_FLAG_SECRETS = 1 << 0;
+
+template<typename Fn>
+static void forEachSecret(CONFIG_T& cfg, Fn&& fn)
+{
+    fn(cfg.WiFi.Password, sizeof(cfg.WiFi.Password));
+    fn(cfg.Influx.Token, sizeof(cfg.Influx.Token));
+    fn(cfg.Mqtt.Password, sizeof(cfg.Mqtt.Password));
+    fn(cfg.Security.Password, sizeof(cfg.Security.Password));
+
+    auto http = [&fn](HttpRequestConfig& request) {
+        fn(request.Password, sizeof(request.Password));
+        fn(request.HeaderValue, sizeof(request.HeaderValue));
+    };
+    for (auto& value : cfg.PowerMeter.HttpJson.Values) { http(value.HttpRequest); }
+    http(cfg.PowerMeter.HttpSml.HttpRequest);
+}
+
+size_t ConfigurationClass::getBackupSize()
+{
+    return sizeof(ConfigBackupHeader) + sizeof(CONFIG_T);
+}
+
+std::unique_ptr<uint8_t[]> ConfigurationClass::exportBackup(bool includeSecrets)
+{
+    std::unique_ptr<uint8_t[]> upBackup(new (std::nothrow) uint8_t[getBackupSize()]);
+    if (!upBackup) { return nullptr; }
+
+    auto& header = *reinterpret_cast<ConfigBackupHeader*>(upBackup.get());
+    auto& payload = *reinterpret_cast<CONFIG_T*>(upBackup.get() + sizeof(ConfigBackupHeader));
+
+    memcpy(&payload, &Configuration.get(), sizeof(CONFIG_T));
+    if (!includeSecrets) {
+        forEachSecret(payload, [](char* secret, size_t size) { memset(secret, 0, size); });
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.Magic = CONFIG_BACKUP_MAGIC;
+    header.Format = CONFIG_BACKUP_FORMAT;
+    header.Flags = includeSecrets ? CONFIG_BACKUP_FLAG_SECRETS : 0;
+    header.Version = CONFIG_VERSION;
+    header.VersionOnBattery = CONFIG_VERSION_ONBATTERY;
+    header.PayloadSize = sizeof(CONFIG_T);
+    strlcpy(header.GitHash, __COMPILED_GIT_HASH__, sizeof(header.GitHash));
+    header.Crc = esp_rom_crc32_le(0, reinterpret_cast<uint8_t const*>(&payload), sizeof(CONFIG_T));
+
+    return upBackup;
+}
+
+// applies the backup to the master copy. it is written to flash at once,
+// along with the snapshot, so the next boot does not parse the JSON file.
+ConfigurationClass::RestoreResult ConfigurationClass::restoreBackup(uint8_t const* data, size_t length)
+{
+    if (length != getBackupSize()) { return RestoreResult::InvalidFormat; }
+
+    ConfigBackupHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (header.Magic != CONFIG_BACKUP_MAGIC || header.Format != CONFIG_BACKUP_FORMAT) {
+        return RestoreResult::InvalidFormat;
+    }
+
+    if (header.Version != CONFIG_VERSION
+            || header.VersionOnBattery != CONFIG_VERSION_ONBATTERY
+            || header.PayloadSize != sizeof(CONFIG_T)
+            || strncmp(header.GitHash, __COMPILED_GIT_HASH__, sizeof(header.GitHash) - 1) != 0) {
+        return RestoreResult::BuildMismatch;
+    }
+
+    uint8_t const* payload = data + sizeof(ConfigBackupHeader);
+    if (esp_rom_crc32_le(0, payload, sizeof(CONFIG_T)) != header.Crc) {
+        return RestoreResult::InvalidFormat;
+    }
+
+    {
+        auto guard = getWriteGuard();
+        auto& current = guard.getConfig();
+
+        auto upIncoming = std::make_unique<CONFIG_T>();
+        memcpy(upIncoming.get(), payload, sizeof(CONFIG_T));
+        auto& incoming = *upIncoming;
+
+        incoming.Cfg = current.Cfg;
+        incoming.Dtu.Serial = current.Dtu.Serial;
+        strlcpy(incoming.WiFi.Hostname, current.WiFi.Hostname, sizeof(incoming.WiFi.Hostname));
+        strlcpy(incoming.Mqtt.ClientId, current.Mqtt.ClientId, sizeof(incoming.Mqtt.ClientId));
+
+        if (!(header.Flags & CONFIG_BACKUP_FLAG_SECRETS)) {
+            // the secrets are visited in the same order for both copies
+            std::vector<char const*> secrets;
+            forEachSecret(current, [&secrets](char* secret, size_t) { secrets.push_back(secret); });
+            size_t i = 0;
+            forEachSecret(incoming, [&secrets, &i](char* secret, size_t size) { strlcpy(secret, secrets[i++], size); });
+        }
+
+        memcpy(&current, &incoming, sizeof(CONFIG_T));
+    }
+
+    for (uint8_t section = 0; section <= static_cast<uint8_t>(Section::GridCharger); ++section) {
+        scheduleWrite(static_cast<Section>(section));
+    }
+    flush();
+
+    return RestoreResult::Success;
+}
+
 void ConfigurationClass::deserializeHttpRequestConfig(JsonObject const& source_http_config, HttpRequestConfig& target)
 {
-    strlcpy(target.Url, source_http_config["url"] | "", sizeof(target.Url));
-    target.AuthType = source_http_config["auth_type"] | HttpRequestConfig::Auth::None;
-    strlcpy(target.Username, source_http_config["username"] | "", sizeof(target.Username));
-    strlcpy(target.Password, source_http_config["password"] | "", sizeof(target.Password));
-    strlcpy(target.HeaderKey, source_http_config["header_key"] | "", sizeof(target.HeaderKey));
-    strlcpy(target.HeaderValue, source_http_config["header_value"] | "", sizeof(target.HeaderValue));
-    target.Timeout = source_http_config["timeout"] | HTTP_REQUEST_TIMEOUT_MS;
+    ConfigFields::deserialize(ConfigFields::HttpRequest, source_http_config, target);
 }
 
 void ConfigurationClass::deserializeSolarChargerConfig(JsonObject const& source, SolarChargerConfig& target)
 {
-    target.Enabled = source["enabled"] | SOLAR_CHARGER_ENABLED;
-    target.VerboseLogging = source["verbose_logging"] | VERBOSE_LOGGING;
-    target.Provider = source["provider"] | SolarChargerProviderType::VEDIRECT;
-    target.PublishUpdatesOnly = source["publish_updates_only"] | SOLAR_CHARGER_PUBLISH_UPDATES_ONLY;
+    ConfigFields::deserialize(ConfigFields::SolarCharger, source, target);
 }
 
 void ConfigurationClass::deserializeSolarChargerMqttConfig(JsonObject const& source, SolarChargerMqttConfig& target)
 {
-    target.CalculateOutputPower = source["calculate_output_power"];
-    strlcpy(target.PowerTopic, source["power_topic"] | "", sizeof(target.PowerTopic));
-    strlcpy(target.PowerJsonPath, source["power_path"] | "", sizeof(target.PowerJsonPath));
-    target.PowerUnit = source["power_unit"] | SolarChargerMqttConfig::WattageUnit::Watts;
-    strlcpy(target.VoltageTopic, source["voltage_topic"] | "", sizeof(target.VoltageTopic));
-    strlcpy(target.VoltageJsonPath, source["voltage_path"] | "", sizeof(target.VoltageJsonPath));
-    target.VoltageTopicUnit = source["voltage_unit"] | SolarChargerMqttConfig::VoltageUnit::Volts;
-    strlcpy(target.CurrentTopic, source["current_topic"] | "", sizeof(target.CurrentTopic));
-    strlcpy(target.CurrentJsonPath, source["current_path"] | "", sizeof(target.CurrentJsonPath));
-    target.CurrentUnit = source["current_unit"] | SolarChargerMqttConfig::AmperageUnit::Amps;
+    ConfigFields::deserialize(ConfigFields::SolarChargerMqtt, source, target);
 }
 
 void ConfigurationClass::deserializePowerMeterMqttConfig(JsonObject const& source, PowerMeterMqttConfig& target)
@@ -432,8 +828,7 @@ void ConfigurationClass::deserializePowerMeterMqttConfig(JsonObject const& sourc
 
 void ConfigurationClass::deserializePowerMeterSerialSdmConfig(JsonObject const& source, PowerMeterSerialSdmConfig& target)
 {
-    target.PollingInterval = source["polling_interval"] | POWERMETER_POLLING_INTERVAL;
-    target.Address = source["address"] | POWERMETER_SDMADDRESS;
+    ConfigFields::deserialize(ConfigFields::PowerMeterSerialSdm, source, target);
 }
 
 void ConfigurationClass::deserializePowerMeterHttpJsonConfig(JsonObject const& source, PowerMeterHttpJsonConfig& target)
@@ -463,26 +858,29 @@ void ConfigurationClass::deserializePowerMeterHttpSmlConfig(JsonObject const& so
     deserializeHttpRequestConfig(source["http_request"], target.HttpRequest);
 }
 
+void ConfigurationClass::deserializePowerMeterUdpSmaHmConfig(JsonObject const& source, PowerMeterUdpSmaHmConfig& target)
+{
+    ConfigFields::deserialize(ConfigFields::PowerMeterUdpSmaHm, source, target);
+}
+
+void ConfigurationClass::deserializePowerMeterUdpPushConfig(JsonObject const& source, PowerMeterUdpPushConfig& target)
+{
+    ConfigFields::deserialize(ConfigFields::PowerMeterUdpPush, source, target);
+}
+
+void ConfigurationClass::deserializePowerMeterShellyRpcConfig(JsonObject const& source, PowerMeterShellyRpcConfig& target)
+{
+    ConfigFields::deserialize(ConfigFields::PowerMeterShellyRpc, source, target);
+}
+
+void ConfigurationClass::deserializePowerMeterFusionConfig(JsonObject const& source, PowerMeterFusionConfig& target)
+{
+    ConfigFields::deserialize(ConfigFields::PowerMeterFusion, source, target);
+}
+
 void ConfigurationClass::deserializeBatteryConfig(JsonObject const& source, BatteryConfig& target)
 {
-    target.Enabled = source["enabled"] | BATTERY_ENABLED;
-    target.VerboseLogging = source["verbose_logging"] | VERBOSE_LOGGING;
-    target.Provider = source["provider"] | BATTERY_PROVIDER;
-    target.JkBmsInterface = source["jkbms_interface"] | BATTERY_JKBMS_INTERFACE;
-    target.JkBmsPollingInterval = source["jkbms_polling_interval"] | BATTERY_JKBMS_POLLING_INTERVAL;
-    strlcpy(target.MqttSocTopic, source["mqtt_soc_topic"] | source["mqtt_topic"] | "", sizeof(config.Battery.MqttSocTopic)); // mqtt_soc_topic was previously saved as mqtt_topic. Be nice and also try old key.
-    strlcpy(target.MqttSocJsonPath, source["mqtt_soc_json_path"] | source["mqtt_json_path"] | "", sizeof(config.Battery.MqttSocJsonPath)); // mqtt_soc_json_path was previously saved as mqtt_json_path. Be nice and also try old key.
-    strlcpy(target.MqttVoltageTopic, source["mqtt_voltage_topic"] | "", sizeof(config.Battery.MqttVoltageTopic));
-    strlcpy(target.MqttVoltageJsonPath, source["mqtt_voltage_json_path"] | "", sizeof(config.Battery.MqttVoltageJsonPath));
-    target.MqttVoltageUnit = source["mqtt_voltage_unit"] | BatteryVoltageUnit::Volts;
-    target.EnableDischargeCurrentLimit = source["enable_discharge_current_limit"] | BATTERY_ENABLE_DISCHARGE_CURRENT_LIMIT;
-    target.DischargeCurrentLimit = source["discharge_current_limit"] | BATTERY_DISCHARGE_CURRENT_LIMIT;
-    target.DischargeCurrentLimitBelowSoc = source["discharge_current_limit_below_soc"] | BATTERY_DISCHARGE_CURRENT_LIMIT_BELOW_SOC;
-    target.DischargeCurrentLimitBelowVoltage = source["discharge_current_limit_below_voltage"] | BATTERY_DISCHARGE_CURRENT_LIMIT_BELOW_VOLTAGE;
-    target.UseBatteryReportedDischargeCurrentLimit = source["use_battery_reported_discharge_current_limit"] | BATTERY_USE_BATTERY_REPORTED_DISCHARGE_CURRENT_LIMIT;
-    strlcpy(target.MqttDischargeCurrentTopic, source["mqtt_discharge_current_topic"] | "", sizeof(config.Battery.MqttDischargeCurrentTopic));
-    strlcpy(target.MqttDischargeCurrentJsonPath, source["mqtt_discharge_current_json_path"] | "", sizeof(config.Battery.MqttDischargeCurrentJsonPath));
-    target.MqttAmperageUnit = source["mqtt_amperage_unit"] | BatteryAmperageUnit::Amps;
+    ConfigFields::deserialize(ConfigFields::Battery, source, target);
 }
 
 void ConfigurationClass::deserializePowerLimiterConfig(JsonObject const& source, PowerLimiterConfig& target)
@@ -494,6 +892,7 @@ void ConfigurationClass::deserializePowerLimiterConfig(JsonObject const& source,
     target.Enabled = source["enabled"] | POWERLIMITER_ENABLED;
     target.VerboseLogging = source["verbose_logging"] | VERBOSE_LOGGING;
     target.SolarPassThroughEnabled = source["solar_passthrough_enabled"] | POWERLIMITER_SOLAR_PASSTHROUGH_ENABLED;
+    target.SolarPowerPrediction = source["solar_power_prediction"] | POWERLIMITER_SOLAR_POWER_PREDICTION;
     target.ConductionLosses = source["conduction_losses"] | POWERLIMITER_CONDUCTION_LOSSES;
     target.BatteryAlwaysUseAtNight = source["battery_always_use_at_night"] | POWERLIMITER_BATTERY_ALWAYS_USE_AT_NIGHT;
     target.TargetPowerConsumption = source["target_power_consumption"] | POWERLIMITER_TARGET_POWER_CONSUMPTION;
@@ -505,6 +904,8 @@ void ConfigurationClass::deserializePowerLimiterConfig(JsonObject const& source,
     target.VoltageStartThreshold = source["voltage_start_threshold"] | POWERLIMITER_VOLTAGE_START_THRESHOLD;
     target.VoltageStopThreshold = source["voltage_stop_threshold"] | POWERLIMITER_VOLTAGE_STOP_THRESHOLD;
     target.VoltageLoadCorrectionFactor = source["voltage_load_correction_factor"] | POWERLIMITER_VOLTAGE_LOAD_CORRECTION_FACTOR;
+    target.VoltageLoadCorrectionAdaptive = source["voltage_load_correction_adaptive"] | POWERLIMITER_VOLTAGE_LOAD_CORRECTION_ADAPTIVE;
+    target.BatteryCapacity = source["battery_capacity"] | POWERLIMITER_BATTERY_CAPACITY;
     target.FullSolarPassThroughSoc = source["full_solar_passthrough_soc"] | POWERLIMITER_FULL_SOLAR_PASSTHROUGH_SOC;
     target.FullSolarPassThroughStartVoltage = source["full_solar_passthrough_start_voltage"] | POWERLIMITER_FULL_SOLAR_PASSTHROUGH_START_VOLTAGE;
     target.FullSolarPassThroughStopVoltage = source["full_solar_passthrough_stop_voltage"] | POWERLIMITER_FULL_SOLAR_PASSTHROUGH_STOP_VOLTAGE;
@@ -512,6 +913,20 @@ void ConfigurationClass::deserializePowerLimiterConfig(JsonObject const& source,
     target.InverterChannelIdForDcVoltage = source["inverter_channel_id_for_dc_voltage"] | POWERLIMITER_INVERTER_CHANNEL_ID;
     target.RestartHour = source["inverter_restart_hour"] | POWERLIMITER_RESTART_HOUR;
     target.TotalUpperPowerLimit = source["total_upper_power_limit"] | POWERLIMITER_UPPER_POWER_LIMIT;
+    target.Distribution = source["distribution_strategy"] | PowerLimiterConfig::Sequential;
+    target.Cluster.Role = source["cluster_role"] | POWERLIMITER_CLUSTER_ROLE;
+    target.Cluster.Port = source["cluster_port"] | POWERLIMITER_CLUSTER_PORT;
+    target.Cluster.Id = source["cluster_id"] | POWERLIMITER_CLUSTER_ID;
+    target.LatencyAlert.ReactionMillis = source["latency_alert_reaction_ms"] | POWERLIMITER_LATENCY_ALERT_REACTION_MS;
+    target.LatencyAlert.MeterIntervalMillis = source["latency_alert_meter_interval_ms"] | POWERLIMITER_LATENCY_ALERT_METER_INTERVAL_MS;
+    target.LatencyAlert.StatsAgeMillis = source["latency_alert_stats_age_ms"] | POWERLIMITER_LATENCY_ALERT_STATS_AGE_MS;
+    target.Shadow.Enabled = source["shadow_enabled"] | POWERLIMITER_SHADOW_ENABLED;
+    target.Shadow.TargetPowerConsumption = source["shadow_target_power_consumption"] | POWERLIMITER_TARGET_POWER_CONSUMPTION;
+    target.Shadow.TargetPowerConsumptionHysteresis = source["shadow_target_power_consumption_hysteresis"] | POWERLIMITER_TARGET_POWER_CONSUMPTION_HYSTERESIS;
+    target.Shadow.BatterySocStartThreshold = source["shadow_battery_soc_start_threshold"] | POWERLIMITER_BATTERY_SOC_START_THRESHOLD;
+    target.Shadow.BatterySocStopThreshold = source["shadow_battery_soc_stop_threshold"] | POWERLIMITER_BATTERY_SOC_STOP_THRESHOLD;
+    target.Shadow.VoltageStartThreshold = source["shadow_voltage_start_threshold"] | POWERLIMITER_VOLTAGE_START_THRESHOLD;
+    target.Shadow.VoltageStopThreshold = source["shadow_voltage_stop_threshold"] | POWERLIMITER_VOLTAGE_STOP_THRESHOLD;
 
     JsonArray inverters = source["inverters"].as<JsonArray>();
     for (size_t i = 0; i < INV_MAX_COUNT; ++i) {
@@ -531,27 +946,21 @@ void ConfigurationClass::deserializePowerLimiterConfig(JsonObject const& source,
 
 void ConfigurationClass::deserializeGridChargerConfig(JsonObject const& source, GridChargerConfig& target)
 {
-    target.Enabled = source["enabled"] | HUAWEI_ENABLED;
-    target.VerboseLogging = source["verbose_logging"] | VERBOSE_LOGGING;
-    target.HardwareInterface = source["hardware_interface"] | GridChargerHardwareInterface::MCP2515;
-    target.CAN_Controller_Frequency = source["can_controller_frequency"] | HUAWEI_CAN_CONTROLLER_FREQUENCY;
-    target.Auto_Power_Enabled = source["auto_power_enabled"] | false;
-    target.Auto_Power_BatterySoC_Limits_Enabled = source["auto_power_batterysoc_limits_enabled"] | false;
-    target.Emergency_Charge_Enabled = source["emergency_charge_enabled"] | false;
-    target.Auto_Power_Voltage_Limit = source["voltage_limit"] | HUAWEI_AUTO_POWER_VOLTAGE_LIMIT;
-    target.Auto_Power_Enable_Voltage_Limit =  source["enable_voltage_limit"] | HUAWEI_AUTO_POWER_ENABLE_VOLTAGE_LIMIT;
-    target.Auto_Power_Lower_Power_Limit = source["lower_power_limit"] | HUAWEI_AUTO_POWER_LOWER_POWER_LIMIT;
-    target.Auto_Power_Upper_Power_Limit = source["upper_power_limit"] | HUAWEI_AUTO_POWER_UPPER_POWER_LIMIT;
-    target.Auto_Power_Stop_BatterySoC_Threshold = source["stop_batterysoc_threshold"] | HUAWEI_AUTO_POWER_STOP_BATTERYSOC_THRESHOLD;
-    target.Auto_Power_Target_Power_Consumption = source["target_power_consumption"] | HUAWEI_AUTO_POWER_TARGET_POWER_CONSUMPTION;
+    ConfigFields::deserialize(ConfigFields::GridCharger, source, target);
 }
 
 bool ConfigurationClass::read()
 {
+    if (readSnapshot()) {
+        MessageOutput.print("from snapshot... ");
+        publishConfig();
+        return true;
+    }
+
     File f = LittleFS.open(CONFIG_FILENAME, "r", false);
     Utils::skipBom(f);
 
-    JsonDocument doc;
+    SectionReader reader(f);
 
     // as OpenDTU-OnBattery was in use a long time without the version marker
     // specific to OpenDTU-OnBattery, we must distinguish the cases (1) where a
@@ -561,23 +970,17 @@ bool ConfigurationClass::read()
     // migration as the config is default-initialized to the current version.
     uint32_t version_onbattery = 0;
 
-    // Deserialize the JSON document
-    const DeserializationError error = deserializeJson(doc, f);
-    if (error) {
+    JsonObject cfg = reader.get("cfg");
+    if (reader.getError()) {
         version_onbattery = CONFIG_VERSION_ONBATTERY;
         MessageOutput.println("Failed to read file, using default configuration");
     }
 
-    if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
-        return false;
-    }
-
-    JsonObject cfg = doc["cfg"];
     config.Cfg.Version = cfg["version"] | CONFIG_VERSION;
     config.Cfg.VersionOnBattery = cfg["version_onbattery"] | version_onbattery;
     config.Cfg.SaveCount = cfg["save_count"] | 0;
 
-    JsonObject wifi = doc["wifi"];
+    JsonObject wifi = reader.get("wifi");
     strlcpy(config.WiFi.Ssid, wifi["ssid"] | WIFI_SSID, sizeof(config.WiFi.Ssid));
     strlcpy(config.WiFi.Password, wifi["password"] | WIFI_PASSWORD, sizeof(config.WiFi.Password));
     strlcpy(config.WiFi.Hostname, wifi["hostname"] | APP_HOSTNAME, sizeof(config.WiFi.Hostname));
@@ -619,16 +1022,33 @@ bool ConfigurationClass::read()
 
     config.WiFi.Dhcp = wifi["dhcp"] | WIFI_DHCP;
     config.WiFi.ApTimeout = wifi["aptimeout"] | ACCESS_POINT_TIMEOUT;
+    config.WiFi.PowerSave = wifi["powersave"] | WIFI_POWER_SAVE;
+    config.WiFi.Failover = wifi["failover"] | WIFI_FAILOVER;
 
-    JsonObject mdns = doc["mdns"];
+    JsonObject mdns = reader.get("mdns");
     config.Mdns.Enabled = mdns["enabled"] | MDNS_ENABLED;
 
-    JsonObject syslog = doc["syslog"];
+    JsonObject syslog = reader.get("syslog");
     config.Syslog.Enabled = syslog["enabled"] | SYSLOG_ENABLED;
     strlcpy(config.Syslog.Hostname, syslog["hostname"] | "", sizeof(config.Syslog.Hostname));
     config.Syslog.Port = syslog["port"] | SYSLOG_PORT;
-
-    JsonObject ntp = doc["ntp"];
+    config.Syslog.Protocol = syslog["protocol"] | SYSLOG_PROTOCOL;
+
+    JsonObject influx = reader.get("influx");
+    config.Influx.Enabled = influx["enabled"] | INFLUX_ENABLED;
+    strlcpy(config.Influx.Hostname, influx["hostname"] | "", sizeof(config.Influx.Hostname));
+    config.Influx.Port = influx["port"] | INFLUX_PORT;
+    config.Influx.Protocol = influx["protocol"] | INFLUX_PROTOCOL;
+    config.Influx.Interval = influx["interval"] | INFLUX_INTERVAL;
+    strlcpy(config.Influx.Path, influx["path"] | INFLUX_PATH, sizeof(config.Influx.Path));
+    strlcpy(config.Influx.Token, influx["token"] | "", sizeof(config.Influx.Token));
+
+    JsonObject modbus = reader.get("modbus");
+    config.Modbus.Enabled = modbus["enabled"] | MODBUS_ENABLED;
+    config.Modbus.Port = modbus["port"] | MODBUS_PORT;
+    config.Modbus.WriteEnabled = modbus["write_enabled"] | MODBUS_WRITE_ENABLED;
+
+    JsonObject ntp = reader.get("ntp");
     strlcpy(config.Ntp.Server, ntp["server"] | NTP_SERVER, sizeof(config.Ntp.Server));
     strlcpy(config.Ntp.Timezone, ntp["timezone"] | NTP_TIMEZONE, sizeof(config.Ntp.Timezone));
     strlcpy(config.Ntp.TimezoneDescr, ntp["timezone_descr"] | NTP_TIMEZONEDESCR, sizeof(config.Ntp.TimezoneDescr));
@@ -636,7 +1056,7 @@ bool ConfigurationClass::read()
     config.Ntp.Longitude = ntp["longitude"] | NTP_LONGITUDE;
     config.Ntp.SunsetType = ntp["sunsettype"] | NTP_SUNSETTYPE;
 
-    JsonObject mqtt = doc["mqtt"];
+    JsonObject mqtt = reader.get("mqtt");
     config.Mqtt.Enabled = mqtt["enabled"] | MQTT_ENABLED;
     config.Mqtt.VerboseLogging = mqtt["verbose_logging"] | VERBOSE_LOGGING;
     strlcpy(config.Mqtt.Hostname, mqtt["hostname"] | MQTT_HOST, sizeof(config.Mqtt.Hostname));
@@ -647,7 +1067,11 @@ bool ConfigurationClass::read()
     strlcpy(config.Mqtt.Topic, mqtt["topic"] | MQTT_TOPIC, sizeof(config.Mqtt.Topic));
     config.Mqtt.Retain = mqtt["retain"] | MQTT_RETAIN;
     config.Mqtt.PublishInterval = mqtt["publish_interval"] | MQTT_PUBLISH_INTERVAL;
+    config.Mqtt.PublishRefreshInterval = mqtt["publish_refresh_interval"] | MQTT_PUBLISH_REFRESH_INTERVAL;
+    config.Mqtt.PublishDeadband = mqtt["publish_deadband"] | MQTT_PUBLISH_DEADBAND;
+    config.Mqtt.InverterJsonPayload = mqtt["inverter_json_payload"] | MQTT_INVERTER_JSON_PAYLOAD;
     config.Mqtt.CleanSession = mqtt["clean_session"] | MQTT_CLEAN_SESSION;
+    config.Mqtt.OutboxLimit = mqtt["outbox_limit"] | MQTT_OUTBOX_LIMIT;
 
     JsonObject mqtt_lwt = mqtt["lwt"];
     strlcpy(config.Mqtt.Lwt.Topic, mqtt_lwt["topic"] | MQTT_LWT_TOPIC, sizeof(config.Mqtt.Lwt.Topic));
@@ -657,32 +1081,44 @@ bool ConfigurationClass::read()
 
     JsonObject mqtt_tls = mqtt["tls"];
     config.Mqtt.Tls.Enabled = mqtt_tls["enabled"] | MQTT_TLS;
-    strlcpy(config.Mqtt.Tls.RootCaCert, mqtt_tls["root_ca_cert"] | MQTT_ROOT_CA_CERT, sizeof(config.Mqtt.Tls.RootCaCert));
     config.Mqtt.Tls.CertLogin = mqtt_tls["certlogin"] | MQTT_TLSCERTLOGIN;
-    strlcpy(config.Mqtt.Tls.ClientCert, mqtt_tls["client_cert"] | MQTT_TLSCLIENTCERT, sizeof(config.Mqtt.Tls.ClientCert));
-    strlcpy(config.Mqtt.Tls.ClientKey, mqtt_tls["client_key"] | MQTT_TLSCLIENTKEY, sizeof(config.Mqtt.Tls.ClientKey));
+
+    // older configs (and backups of them) carry the certificates inline.
+    // they are moved to their files, and the config is written again
+    // without them below.
+    bool certificatesMigrated = false;
+    auto migrateCertificate = [&](char const* key, Certificate which) {
+        if (!mqtt_tls[key].is<char const*>()) { return; }
+        writeCertificate(which, mqtt_tls[key].as<String>());
+        certificatesMigrated = true;
+    };
+    migrateCertificate("root_ca_cert", Certificate::RootCa);
+    migrateCertificate("client_cert", Certificate::Client);
+    migrateCertificate("client_key", Certificate::ClientKey);
 
     JsonObject mqtt_hass = mqtt["hass"];
     config.Mqtt.Hass.Enabled = mqtt_hass["enabled"] | MQTT_HASS_ENABLED;
     config.Mqtt.Hass.Retain = mqtt_hass["retain"] | MQTT_HASS_RETAIN;
     config.Mqtt.Hass.Expire = mqtt_hass["expire"] | MQTT_HASS_EXPIRE;
     config.Mqtt.Hass.IndividualPanels = mqtt_hass["individual_panels"] | MQTT_HASS_INDIVIDUALPANELS;
+    config.Mqtt.Hass.DeviceDiscovery = mqtt_hass["device_discovery"] | MQTT_HASS_DEVICE_DISCOVERY;
     strlcpy(config.Mqtt.Hass.Topic, mqtt_hass["topic"] | MQTT_HASS_TOPIC, sizeof(config.Mqtt.Hass.Topic));
 
-    JsonObject dtu = doc["dtu"];
+    JsonObject dtu = reader.get("dtu");
     config.Dtu.Serial = dtu["serial"] | DTU_SERIAL;
     config.Dtu.PollInterval = dtu["poll_interval"] | DTU_POLL_INTERVAL;
     config.Dtu.VerboseLogging = dtu["verbose_logging"] | VERBOSE_LOGGING;
+    config.Dtu.LowPowerNight = dtu["low_power_night"] | DTU_LOW_POWER_NIGHT;
     config.Dtu.Nrf.PaLevel = dtu["nrf_pa_level"] | DTU_NRF_PA_LEVEL;
     config.Dtu.Cmt.PaLevel = dtu["cmt_pa_level"] | DTU_CMT_PA_LEVEL;
     config.Dtu.Cmt.Frequency = dtu["cmt_frequency"] | DTU_CMT_FREQUENCY;
     config.Dtu.Cmt.CountryMode = dtu["cmt_country_mode"] | DTU_CMT_COUNTRY_MODE;
 
-    JsonObject security = doc["security"];
+    JsonObject security = reader.get("security");
     strlcpy(config.Security.Password, security["password"] | ACCESS_POINT_PASSWORD, sizeof(config.Security.Password));
     config.Security.AllowReadonly = security["allow_readonly"] | SECURITY_ALLOW_READONLY;
 
-    JsonObject device = doc["device"];
+    JsonObject device = reader.get("device");
     strlcpy(config.Dev_PinMapping, device["pinmapping"] | DEV_PINMAPPING, sizeof(config.Dev_PinMapping));
 
     JsonObject display = device["display"];
@@ -700,7 +1136,7 @@ bool ConfigurationClass::read()
         config.Led_Single[i].Brightness = led["brightness"] | LED_BRIGHTNESS;
     }
 
-    JsonArray inverters = doc["inverters"];
+    JsonArray inverters = reader.get("inverters");
     for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
         JsonObject inv = inverters[i].as<JsonObject>();
         config.Inverter[i].Serial = inv["serial"] | 0ULL;
@@ -725,14 +1161,15 @@ bool ConfigurationClass::read()
         }
     }
 
-    JsonObject solarcharger = doc["solarcharger"];
+    JsonObject solarcharger = reader.get("solarcharger");
     deserializeSolarChargerConfig(solarcharger, config.SolarCharger);
     deserializeSolarChargerMqttConfig(solarcharger["mqtt"], config.SolarCharger.Mqtt);
 
-    JsonObject powermeter = doc["powermeter"];
+    JsonObject powermeter = reader.get("powermeter");
     config.PowerMeter.Enabled = powermeter["enabled"] | POWERMETER_ENABLED;
     config.PowerMeter.VerboseLogging = powermeter["verbose_logging"] | VERBOSE_LOGGING;
     config.PowerMeter.Source =  powermeter["source"] | POWERMETER_SOURCE;
+    config.PowerMeter.PredictiveFilter = powermeter["predictive_filter"] | POWERMETER_PREDICTIVE_FILTER;
 
     deserializePowerMeterMqttConfig(powermeter["mqtt"], config.PowerMeter.Mqtt);
 
@@ -742,14 +1179,27 @@ bool ConfigurationClass::read()
 
     deserializePowerMeterHttpSmlConfig(powermeter["http_sml"], config.PowerMeter.HttpSml);
 
-    deserializePowerLimiterConfig(doc["powerlimiter"], config.PowerLimiter);
+    deserializePowerMeterUdpSmaHmConfig(powermeter["udp_smahm"], config.PowerMeter.UdpSmaHm);
+
+    deserializePowerMeterUdpPushConfig(powermeter["udp_push"], config.PowerMeter.UdpPush);
 
-    deserializeBatteryConfig(doc["battery"], config.Battery);
+    deserializePowerMeterShellyRpcConfig(powermeter["shelly_rpc"], config.PowerMeter.ShellyRpc);
 
-    deserializeGridChargerConfig(doc["huawei"], config.Huawei);
+    deserializePowerMeterFusionConfig(powermeter["fusion"], config.PowerMeter.Fusion);
 
+    deserializePowerLimiterConfig(reader.get("powerlimiter"), config.PowerLimiter);
+
+    deserializeBatteryConfig(reader.get("battery"), config.Battery);
+
+    deserializeGridChargerConfig(reader.get("huawei"), config.Huawei);
+
+    size_t jsonSize = f ? f.size() : 0;
     f.close();
 
+    if (reader.overflowed()) {
+        return false;
+    }
+
     // Check for default DTU serial
     MessageOutput.print("Check for default DTU serial... ");
     if (config.Dtu.Serial == DTU_SERIAL) {
@@ -760,9 +1210,21 @@ bool ConfigurationClass::read()
             static_cast<uint32_t>(dtuId & 0xFFFFFFFF));
         config.Dtu.Serial = dtuId;
         write();
+    } else if (certificatesMigrated) {
+        MessageOutput.print("moved TLS certificates to their files... ");
+        write();
+    } else if (jsonSize > 0 && config.Cfg.Version == CONFIG_VERSION
+            && config.Cfg.VersionOnBattery == CONFIG_VERSION_ONBATTERY) {
+        // such that the next boot does not need to parse the JSON file.
+        // outdated configs are written as part of their migration.
+        if (writeSnapshot(jsonSize)) {
+            LittleFS.remove(CONFIG_SNAPSHOT_FILENAME);
+            LittleFS.rename(CONFIG_SNAPSHOT_FILENAME CONFIG_TMP_SUFFIX, CONFIG_SNAPSHOT_FILENAME);
+        }
     }
     MessageOutput.println("done");
 
+    publishConfig();
     return true;
 }
 
@@ -776,21 +1238,21 @@ void ConfigurationClass::migrate()
 
     Utils::skipBom(f);
 
-    JsonDocument doc;
+    SectionReader reader(f);
 
-    // Deserialize the JSON document
-    const DeserializationError error = deserializeJson(doc, f);
-    if (error) {
+    // only validates the file, the sections are read as needed
+    reader.get("cfg");
+    if (auto error = reader.getError()) {
         MessageOutput.printf("Failed to read file, cancel migration: %s\r\n", error.c_str());
         return;
     }
 
-    if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
+    if (reader.overflowed()) {
         return;
     }
 
     if (config.Cfg.Version < 0x00011700) {
-        JsonArray inverters = doc["inverters"];
+        JsonArray inverters = reader.get("inverters");
         for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
             JsonObject inv = inverters[i].as<JsonObject>();
             JsonArray channels = inv["channels"];
@@ -802,12 +1264,12 @@ void ConfigurationClass::migrate()
     }
 
     if (config.Cfg.Version < 0x00011800) {
-        JsonObject mqtt = doc["mqtt"];
+        JsonObject mqtt = reader.get("mqtt");
         config.Mqtt.PublishInterval = mqtt["publish_invterval"];
     }
 
     if (config.Cfg.Version < 0x00011900) {
-        JsonObject dtu = doc["dtu"];
+        JsonObject dtu = reader.get("dtu");
         config.Dtu.Nrf.PaLevel = dtu["pa_level"];
     }
 
@@ -831,7 +1293,7 @@ void ConfigurationClass::migrate()
     }
 
     if (config.Cfg.Version < 0x00011d00) {
-        JsonObject device = doc["device"];
+        JsonObject device = reader.get("device");
         JsonObject display = device["display"];
         switch (display["language"] | 0U) {
         case 0U:
@@ -863,17 +1325,17 @@ void ConfigurationClass::migrateOnBattery()
 
     Utils::skipBom(f);
 
-    JsonDocument doc;
+    SectionReader reader(f);
 
-    // Deserialize the JSON document
-    const DeserializationError error = deserializeJson(doc, f);
-    if (error) {
+    // only validates the file, the sections are read as needed
+    reader.get("cfg");
+    if (auto error = reader.getError()) {
         MessageOutput.printf("Failed to read file, cancel OpenDTU-OnBattery "
                 "migration: %s\r\n", error.c_str());
         return;
     }
 
-    if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
+    if (reader.overflowed()) {
         return;
     }
 
@@ -884,7 +1346,7 @@ void ConfigurationClass::migrateOnBattery()
         // OpenDTU-OnBattery-specific settings, i.e., all before the
         // OpenDTU-OnBattery config version value was introduced.
 
-        JsonObject powermeter = doc["powermeter"];
+        JsonObject powermeter = reader.get("powermeter");
 
         if (!powermeter["mqtt_topic_powermeter_1"].isNull()) {
             auto& values = config.PowerMeter.Mqtt.Values;
@@ -915,7 +1377,7 @@ void ConfigurationClass::migrateOnBattery()
             target.IndividualRequests = powermeter["http_individual_requests"] | false;
         }
 
-        JsonObject powerlimiter = doc["powerlimiter"];
+        JsonObject powerlimiter = reader.get("powerlimiter");
 
         if (powerlimiter["battery_drain_strategy"].as<uint8_t>() == 1) {
             config.PowerLimiter.BatteryAlwaysUseAtNight = true;
@@ -960,7 +1422,7 @@ void ConfigurationClass::migrateOnBattery()
     }
 
     if (config.Cfg.VersionOnBattery < 2) {
-        config.PowerLimiter.ConductionLosses = doc["powerlimiter"]["solar_passthrough_losses"].as<uint8_t>();
+        config.PowerLimiter.ConductionLosses = reader.get("powerlimiter")["solar_passthrough_losses"].as<uint8_t>();
     }
 
     if (config.Cfg.VersionOnBattery < 3) {
@@ -968,14 +1430,14 @@ void ConfigurationClass::migrateOnBattery()
     }
 
     if (config.Cfg.VersionOnBattery < 4) {
-        JsonObject vedirect = doc["vedirect"];
+        JsonObject vedirect = reader.get("vedirect");
         config.SolarCharger.Enabled = vedirect["enabled"] | SOLAR_CHARGER_ENABLED;
         config.SolarCharger.VerboseLogging = vedirect["verbose_logging"] | SOLAR_CHARGER_VERBOSE_LOGGING;
         config.SolarCharger.PublishUpdatesOnly = vedirect["updates_only"] | SOLAR_CHARGER_PUBLISH_UPDATES_ONLY;
     }
 
     if (config.Cfg.VersionOnBattery < 5) {
-        JsonArray inverters = doc["powerlimiter"]["inverters"].as<JsonArray>();
+        JsonArray inverters = reader.get("powerlimiter")["inverters"].as<JsonArray>();
 
         for (size_t i = 0; i < INV_MAX_COUNT; ++i) {
             PowerLimiterInverterConfig& inv = config.PowerLimiter.Inverters[i];
@@ -996,9 +1458,65 @@ void ConfigurationClass::migrateOnBattery()
     read();
 }
 
+static char const* getCertificateFilename(ConfigurationClass::Certificate which)
+{
+    switch (which) {
+    case ConfigurationClass::Certificate::RootCa: return MQTT_ROOT_CA_CERT_FILENAME;
+    case ConfigurationClass::Certificate::Client: return MQTT_CLIENT_CERT_FILENAME;
+    case ConfigurationClass::Certificate::ClientKey: return MQTT_CLIENT_KEY_FILENAME;
+    }
+    return "";
+}
+
+String ConfigurationClass::readCertificate(Certificate which)
+{
+    File f = LittleFS.open(getCertificateFilename(which), "r", false);
+    if (!f) {
+        switch (which) {
+        case Certificate::RootCa: return MQTT_ROOT_CA_CERT;
+        case Certificate::Client: return MQTT_TLSCLIENTCERT;
+        case Certificate::ClientKey: return MQTT_TLSCLIENTKEY;
+        }
+    }
+
+    String pem = f.readString();
+    f.close();
+    return pem;
+}
+
+bool ConfigurationClass::writeCertificate(Certificate which, String const& pem)
+{
+    auto filename = getCertificateFilename(which);
+
+    if (pem.length() > MQTT_MAX_CERT_STRLEN) {
+        MessageOutput.printf("Certificate for %s is too long\r\n", filename);
+        return false;
+    }
+
+    File f = LittleFS.open(filename, "w");
+    if (!f) {
+        MessageOutput.printf("Failed to open %s for writing\r\n", filename);
+        return false;
+    }
+
+    bool success = f.print(pem) == pem.length();
+    f.close();
+
+    if (!success) {
+        MessageOutput.printf("Failed to write %s\r\n", filename);
+    }
+
+    return success;
+}
+
 CONFIG_T const& ConfigurationClass::get()
 {
-    return config;
+    return *sPublished.load(std::memory_order_acquire);
+}
+
+uint32_t ConfigurationClass::getGeneration() const
+{
+    return sGeneration.load();
 }
 
 ConfigurationClass::WriteGuard ConfigurationClass::getWriteGuard()
@@ -1017,11 +1535,12 @@ INVERTER_CONFIG_T* ConfigurationClass::getFreeInverterSlot()
     return nullptr;
 }
 
-INVERTER_CONFIG_T* ConfigurationClass::getInverterConfig(const uint64_t serial)
+INVERTER_CONFIG_T const* ConfigurationClass::getInverterConfig(const uint64_t serial)
 {
+    auto const& cfg = get();
     for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
-        if (config.Inverter[i].Serial == serial) {
-            return &config.Inverter[i];
+        if (cfg.Inverter[i].Serial == serial) {
+            return &cfg.Inverter[i];
         }
     }
 
@@ -1050,13 +1569,71 @@ void ConfigurationClass::deleteInverterById(const uint8_t id)
     }
 }
 
+void ConfigurationClass::scheduleWrite(Section section)
+{
+    std::lock_guard<std::mutex> lock(_pendingMutex);
+
+    uint32_t now = millis();
+    if (_dirtySections == 0) { _firstChangeMillis = now; }
+    _lastChangeMillis = now;
+    _dirtySections |= 1 << static_cast<uint8_t>(section);
+}
+
+void ConfigurationClass::flush()
+{
+    writePending(true/*force*/);
+}
+
+void ConfigurationClass::writePending(bool force)
+{
+    static constexpr char const* sectionNames[] = {
+        "network", "mqtt", "ntp", "dtu", "security", "device", "inverters",
+        "solarcharger", "powermeter", "powerlimiter", "battery", "huawei"
+    };
+
+    uint32_t dirtySections;
+
+    {
+        std::lock_guard<std::mutex> lock(_pendingMutex);
+        if (_dirtySections == 0) { return; }
+
+        uint32_t now = millis();
+        bool quiet = (now - _lastChangeMillis) >= WRITE_QUIET_PERIOD_MS;
+        bool overdue = (now - _firstChangeMillis) >= WRITE_MAX_DELAY_MS;
+        if (!force && !quiet && !overdue) { return; }
+
+        dirtySections = _dirtySections;
+        _dirtySections = 0;
+    }
+
+    MessageOutput.print("Writing configuration (changed:");
+    for (size_t i = 0; i < sizeof(sectionNames)/sizeof(sectionNames[0]); ++i) {
+        if (dirtySections & (1 << i)) { MessageOutput.printf(" %s", sectionNames[i]); }
+    }
+    MessageOutput.print(")... ");
+
+    std::unique_lock<std::mutex> writerLock(sWriterMutex);
+    bool success = write();
+    writerLock.unlock();
+
+    if (success) {
+        MessageOutput.println("done");
+        return;
+    }
+
+    MessageOutput.println("failed, will retry");
+
+    std::lock_guard<std::mutex> lock(_pendingMutex);
+    if (_dirtySections == 0) { _firstChangeMillis = millis(); }
+    _lastChangeMillis = millis();
+    _dirtySections |= dirtySections;
+}
+
 void ConfigurationClass::loop()
 {
-    std::unique_lock<std::mutex> lock(sWriterMutex);
-    if (sWriterCount == 0) { return; }
+    reclaimRetiredConfigs();
 
-    sWriterCv.notify_all();
-    sWriterCv.wait(lock, [] { return sWriterCount == 0; });
+    writePending(false/*force*/);
 }
 
 CONFIG_T& ConfigurationClass::WriteGuard::getConfig()
@@ -1067,13 +1644,10 @@ CONFIG_T& ConfigurationClass::WriteGuard::getConfig()
 ConfigurationClass::WriteGuard::WriteGuard()
     : _lock(sWriterMutex)
 {
-    sWriterCount++;
-    sWriterCv.wait(_lock);
 }
 
 ConfigurationClass::WriteGuard::~WriteGuard() {
-    sWriterCount--;
-    if (sWriterCount == 0) { sWriterCv.notify_all(); }
+    publishConfig();
 }
 
 ConfigurationClass Configuration;
@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "ControlLatency.h"
+#include "Configuration.h"
+#include "DataBus.h"
+#include "MessageOutput.h"
+#include "MqttSettings.h"
+#include "NightMode.h"
+#include "TaskProfiler.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+
+ControlLatencyClass ControlLatency;
+
+namespace {
+
+// alerts are only raised once the percentiles are meaningful
+constexpr uint16_t MinAlertSamples = 10;
+
+} // namespace
+
+ControlLatencyClass::ControlLatencyClass()
+    : _loopTask(10 * TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("ControlLatency::loop", std::bind(&ControlLatencyClass::loop, this)))
+    , _publishTask(TASK_IMMEDIATE, TASK_FOREVER, TaskProfiler.wrap("ControlLatency::publishLoop", std::bind(&ControlLatencyClass::publishLoop, this)))
+{
+}
+
+void ControlLatencyClass::init(Scheduler& scheduler)
+{
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+
+    scheduler.addTask(_publishTask);
+    _publishTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
+    _publishTask.enable();
+    NightMode.addIdleTask(_publishTask);
+
+    DataBus.subscribe(DataBusClass::Topic::PowerMeter, [this]() { onMeterReading(); });
+}
+
+char const* ControlLatencyClass::getName(Metric metric)
+{
+    switch (metric) {
+    case Metric::Reaction: return "reaction";
+    case Metric::Decision: return "decision";
+    case Metric::MeterInterval: return "meter_interval";
+    case Metric::StatsAge: return "stats_age";
+    case Metric::Count: break;
+    }
+    return "unknown";
+}
+
+void ControlLatencyClass::add(Metric metric, uint32_t millis)
+{
+    auto& series = _series[static_cast<size_t>(metric)];
+    auto value = static_cast<uint16_t>(std::min<uint32_t>(millis, UINT16_MAX));
+    series.Values[series.Next] = value;
+    series.Next = (series.Next + 1) % Series::Capacity;
+    series.Size = std::min<uint16_t>(series.Size + 1, Series::Capacity);
+    ++series.Count;
+    series.Total += value;
+}
+
+void ControlLatencyClass::onMeterReading()
+{
+    uint32_t now = millis();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_lastMeterArrival != 0) {
+        uint32_t interval = now - _lastMeterArrival;
+        add(Metric::MeterInterval, interval);
+
+        if (_oLastMeterInterval) {
+            float difference = std::fabs(static_cast<float>(interval) - *_oLastMeterInterval);
+            _meterJitter += (difference - _meterJitter) / 16;
+        }
+        _oLastMeterInterval = interval;
+    }
+
+    _lastMeterArrival = now;
+}
+
+void ControlLatencyClass::recordCalculation(std::optional<uint32_t> meterMeasuredMillis,
+        std::optional<uint32_t> statsAgeMillis, bool limitsUpdated)
+{
+    uint32_t now = millis();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (statsAgeMillis) { add(Metric::StatsAge, *statsAgeMillis); }
+
+    if (!limitsUpdated) { return; }
+
+    // a calculation which did not act on a reading is not measured, and it
+    // resets the pending one, as it sent newer limits
+    _oPendingMeasuredMillis = meterMeasuredMillis;
+    if (!meterMeasuredMillis) { return; }
+
+    add(Metric::Decision, now - *meterMeasuredMillis);
+}
+
+void ControlLatencyClass::recordAcknowledgment(uint32_t ackMillis)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (!_oPendingMeasuredMillis) { return; }
+
+    add(Metric::Reaction, ackMillis - *_oPendingMeasuredMillis);
+    _oPendingMeasuredMillis.reset();
+}
+
+ControlLatencyClass::Summary ControlLatencyClass::getSummary(Metric metric) const
+{
+    std::array<uint16_t, Series::Capacity> values;
+    Summary summary = {};
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto const& series = _series[static_cast<size_t>(metric)];
+        std::copy_n(series.Values.begin(), series.Size, values.begin());
+        summary.Count = series.Count;
+        summary.Samples = series.Size;
+        summary.Alert = series.Alert;
+    }
+
+    if (summary.Samples == 0) { return summary; }
+
+    auto end = values.begin() + summary.Samples;
+    std::sort(values.begin(), end);
+
+    auto percentile = [&](uint8_t p) -> uint32_t {
+        return values[(summary.Samples - 1) * p / 100];
+    };
+
+    summary.P50 = percentile(50);
+    summary.P90 = percentile(90);
+    summary.P99 = percentile(99);
+    summary.Max = *(end - 1);
+    return summary;
+}
+
+ControlLatencyClass::Total ControlLatencyClass::getTotal(Metric metric) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto const& series = _series[static_cast<size_t>(metric)];
+    return { series.Count, series.Total };
+}
+
+uint32_t ControlLatencyClass::getMeterJitter() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return static_cast<uint32_t>(_meterJitter);
+}
+
+uint32_t ControlLatencyClass::getThreshold(Metric metric) const
+{
+    auto const& alert = Configuration.get().PowerLimiter.LatencyAlert;
+
+    switch (metric) {
+    case Metric::Reaction: return alert.ReactionMillis;
+    case Metric::MeterInterval: return alert.MeterIntervalMillis;
+    case Metric::StatsAge: return alert.StatsAgeMillis;
+    default: break;
+    }
+
+    return 0;
+}
+
+void ControlLatencyClass::loop()
+{
+    for (size_t i = 0; i < MetricCount; ++i) {
+        auto metric = static_cast<Metric>(i);
+        uint32_t threshold = getThreshold(metric);
+        auto summary = getSummary(metric);
+
+        bool alert = threshold > 0 && summary.Samples >= MinAlertSamples
+            && summary.P90 > threshold;
+        if (alert == summary.Alert) { continue; }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _series[i].Alert = alert;
+        }
+
+        if (alert) {
+            MessageOutput.printf("[ControlLatency] ALERT: %s p90 of %" PRIu32 " ms "
+                    "exceeds %" PRIu32 " ms (p99 %" PRIu32 " ms, max %" PRIu32 " ms)\r\n",
+                    getName(metric), summary.P90, threshold, summary.P99, summary.Max);
+        } else {
+            MessageOutput.printf("[ControlLatency] %s p90 of %" PRIu32 " ms is back "
+                    "within %" PRIu32 " ms\r\n", getName(metric), summary.P90, threshold);
+        }
+
+        _publishTask.forceNextIteration();
+    }
+}
+
+void ControlLatencyClass::publishLoop()
+{
+    _publishTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
+
+    if (!Configuration.get().PowerLimiter.Enabled) { return; }
+
+    if (!MqttSettings.acceptsPublishes()) {
+        _publishTask.forceNextIteration();
+        return;
+    }
+
+    auto& topics = MqttTopicRegistry;
+    char const* prefix = "powerlimiter/status/latency/";
+
+    for (size_t i = 0; i < MetricCount; ++i) {
+        auto metric = static_cast<Metric>(i);
+        auto summary = getSummary(metric);
+        if (summary.Samples == 0) { continue; }
+
+        char const* name = getName(metric);
+        MqttSettings.publish(topics.intern(prefix, name, "/p50"), summary.P50, 0);
+        MqttSettings.publish(topics.intern(prefix, name, "/p90"), summary.P90, 0);
+        MqttSettings.publish(topics.intern(prefix, name, "/p99"), summary.P99, 0);
+        MqttSettings.publish(topics.intern(prefix, name, "/max"), summary.Max, 0);
+        MqttSettings.publish(topics.intern(prefix, name, "/alert"), summary.Alert ? 1 : 0, 0);
+    }
+
+    MqttSettings.publish(topics.intern(prefix, "meter_jitter"), getMeterJitter(), 0);
+}
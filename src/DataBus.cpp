@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "DataBus.h"
+#include "MessageOutput.h"
+#include <Hoymiles.h>
+
+DataBusClass DataBus;
+
+void DataBusClass::init()
+{
+    // the Hoymiles library does not know about the bus
+    Hoymiles.addStatisticsUpdateCallback([this]() { publish(Topic::InverterStats); });
+}
+
+bool DataBusClass::subscribe(Topic topic, Callback callback)
+{
+    if (topic >= Topic::Count) { return false; }
+
+    std::lock_guard<std::mutex> lock(_subscribeMutex);
+
+    auto& subscribers = _topics[static_cast<size_t>(topic)];
+    uint8_t count = subscribers.Count.load(std::memory_order_relaxed);
+    if (count >= MaxSubscribers) {
+        MessageOutput.printf("[DataBus] No free slot for topic %u\r\n",
+                static_cast<unsigned>(topic));
+        return false;
+    }
+
+    subscribers.Callbacks[count] = std::move(callback);
+    subscribers.Count.store(count + 1, std::memory_order_release);
+    return true;
+}
+
+void DataBusClass::publish(Topic topic)
+{
+    if (topic >= Topic::Count) { return; }
+
+    auto& subscribers = _topics[static_cast<size_t>(topic)];
+    subscribers.Sequence.fetch_add(1, std::memory_order_relaxed);
+
+    uint8_t count = subscribers.Count.load(std::memory_order_acquire);
+    for (uint8_t i = 0; i < count; ++i) {
+        subscribers.Callbacks[i]();
+    }
+}
+
+uint32_t DataBusClass::getSequence(Topic topic) const
+{
+    if (topic >= Topic::Count) { return 0; }
+    return _topics[static_cast<size_t>(topic)].Sequence.load(std::memory_order_relaxed);
+}
@@ -1,6 +1,7 @@
 #include <stdio.h>
 
 #include "DataPoints.h"
+#include "Utils.h"
 
 static char conversionBuffer[16];
 
@@ -18,7 +19,7 @@ template std::string dataPointValueToStr(uint16_t const& v);
 template std::string dataPointValueToStr(uint32_t const& v);
 
 template<> std::string dataPointValueToStr(float const& v) {
-    snprintf(conversionBuffer, sizeof(conversionBuffer), "%.2f", v);
+    Utils::formatFixed(conversionBuffer, sizeof(conversionBuffer), v, 2);
     return conversionBuffer;
 }
 
@@ -35,12 +36,13 @@ std::string dataPointValueToStr(bool const& v) {
 template<>
 std::string dataPointValueToStr(tCellVoltages const& v) {
     std::string res;
-    res.reserve(v.size()*(2+2+1+4)); // separator, index, equal sign, value
+    res.reserve(v.size()*(2+2+1+4)); // separator, number, equal sign, value
     res += "(";
-    std::string sep = "";
-    for(auto const& mapval : v) {
-        snprintf(conversionBuffer, sizeof(conversionBuffer), "%s%d=%d",
-                sep.c_str(), mapval.first, mapval.second);
+    char const* sep = "";
+    unsigned cell = 1;
+    for(auto milliVolt : v) {
+        snprintf(conversionBuffer, sizeof(conversionBuffer), "%s%u=%u",
+                sep, cell++, milliVolt);
         res += conversionBuffer;
         sep = ", ";
     }
@@ -4,12 +4,14 @@
  */
 #include "Datastore.h"
 #include "Configuration.h"
+#include "DataBus.h"
 #include <Hoymiles.h>
+#include "TaskProfiler.h"
 
 DatastoreClass Datastore;
 
 DatastoreClass::DatastoreClass()
-    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&DatastoreClass::loop, this))
+    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("Datastore::loop", std::bind(&DatastoreClass::loop, this)))
 {
 }
 
@@ -17,6 +19,12 @@ void DatastoreClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
     _loopTask.enable();
+
+    // the topic is published from the Hoymiles loop, which is executed by
+    // the same scheduler, so the totals are updated right after new data
+    // was received. the periodic execution catches the remaining changes,
+    // e.g., inverters becoming unreachable or data being zeroed at night.
+    DataBus.subscribe(DataBusClass::Topic::InverterStats, [this]() { _loopTask.forceNextIteration(); });
 }
 
 void DatastoreClass::loop()
@@ -30,186 +38,219 @@ void DatastoreClass::loop()
     uint8_t isReachable = 0;
     uint8_t pollEnabledCount = 0;
 
-    std::lock_guard<std::mutex> lock(_mutex);
-
-    _totalAcYieldTotalEnabled = 0;
-    _totalAcYieldTotalDigits = 0;
-
-    _totalAcYieldDayEnabled = 0;
-    _totalAcYieldDayDigits = 0;
-
-    _totalAcPowerEnabled = 0;
-    _totalAcPowerDigits = 0;
-
-    _totalDcPowerEnabled = 0;
-    _totalDcPowerDigits = 0;
+    Totals totals;
+    totals.IsAllEnabledProducing = true;
+    totals.IsAllEnabledReachable = true;
 
-    _totalDcPowerIrradiation = 0;
-    _totalDcIrradiationInstalled = 0;
-
-    _isAllEnabledProducing = true;
-    _isAllEnabledReachable = true;
-
-    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
-        auto inv = Hoymiles.getInverterByPos(i);
-        if (inv == nullptr) {
-            continue;
-        }
+    for (uint8_t i = 0; i < _inverterStates.size(); i++) {
+        auto& state = _inverterStates[i];
 
-        auto cfg = Configuration.getInverterConfig(inv->serial());
+        auto inv = (i < Hoymiles.getNumInverters()) ? Hoymiles.getInverterByPos(i) : nullptr;
+        auto cfg = (inv != nullptr) ? Configuration.getInverterConfig(inv->serial()) : nullptr;
         if (cfg == nullptr) {
+            state = InverterState();
             continue;
         }
 
-        if (inv->getEnablePolling()) {
+        bool pollEnabled = inv->getEnablePolling();
+
+        if (pollEnabled) {
             pollEnabledCount++;
         }
 
         if (inv->isProducing()) {
             isProducing++;
         } else {
-            if (inv->getEnablePolling()) {
-                _isAllEnabledProducing = false;
+            if (pollEnabled) {
+                totals.IsAllEnabledProducing = false;
             }
         }
 
         if (inv->isReachable()) {
             isReachable++;
         } else {
-            if (inv->getEnablePolling()) {
-                _isAllEnabledReachable = false;
+            if (pollEnabled) {
+                totals.IsAllEnabledReachable = false;
             }
         }
 
-        for (auto& c : inv->Statistics()->getChannelsByType(TYPE_INV)) {
-            if (cfg->Poll_Enable) {
-                _totalAcYieldTotalEnabled += inv->Statistics()->getChannelFieldValue(TYPE_INV, c, FLD_YT);
-                _totalAcYieldDayEnabled += inv->Statistics()->getChannelFieldValue(TYPE_INV, c, FLD_YD);
+        auto stats = inv->Statistics();
+        auto dcChannels = stats->getChannelsByType(TYPE_DC);
 
-                _totalAcYieldTotalDigits = max<unsigned int>(_totalAcYieldTotalDigits, inv->Statistics()->getChannelFieldDigits(TYPE_INV, c, FLD_YT));
-                _totalAcYieldDayDigits = max<unsigned int>(_totalAcYieldDayDigits, inv->Statistics()->getChannelFieldDigits(TYPE_INV, c, FLD_YD));
-            }
+        float stringMaxPower = 0;
+        for (auto& c : dcChannels) {
+            stringMaxPower += stats->getStringMaxPower(c);
         }
 
-        for (auto& c : inv->Statistics()->getChannelsByType(TYPE_AC)) {
-            if (inv->getEnablePolling()) {
-                _totalAcPowerEnabled += inv->Statistics()->getChannelFieldValue(TYPE_AC, c, FLD_PAC);
-                _totalAcPowerDigits = max<unsigned int>(_totalAcPowerDigits, inv->Statistics()->getChannelFieldDigits(TYPE_AC, c, FLD_PAC));
+        if (state.Serial != inv->serial()
+            || state.LastUpdate != stats->getLastUpdateFromInternal()
+            || state.PollEnabled != pollEnabled
+            || state.ConfigPollEnabled != cfg->Poll_Enable
+            || state.StringMaxPower != stringMaxPower) {
+
+            state.Serial = inv->serial();
+            state.LastUpdate = stats->getLastUpdateFromInternal();
+            state.PollEnabled = pollEnabled;
+            state.ConfigPollEnabled = cfg->Poll_Enable;
+            state.StringMaxPower = stringMaxPower;
+
+            auto& share = state.Share;
+            share = Contribution();
+
+            if (cfg->Poll_Enable) {
+                for (auto& c : stats->getChannelsByType(TYPE_INV)) {
+                    share.AcYieldTotal += stats->getChannelFieldValue(TYPE_INV, c, FLD_YT);
+                    share.AcYieldDay += stats->getChannelFieldValue(TYPE_INV, c, FLD_YD);
+
+                    share.AcYieldTotalDigits = max<unsigned int>(share.AcYieldTotalDigits, stats->getChannelFieldDigits(TYPE_INV, c, FLD_YT));
+                    share.AcYieldDayDigits = max<unsigned int>(share.AcYieldDayDigits, stats->getChannelFieldDigits(TYPE_INV, c, FLD_YD));
+                }
             }
-        }
 
-        for (auto& c : inv->Statistics()->getChannelsByType(TYPE_DC)) {
-            if (inv->getEnablePolling()) {
-                _totalDcPowerEnabled += inv->Statistics()->getChannelFieldValue(TYPE_DC, c, FLD_PDC);
-                _totalDcPowerDigits = max<unsigned int>(_totalDcPowerDigits, inv->Statistics()->getChannelFieldDigits(TYPE_DC, c, FLD_PDC));
+            if (pollEnabled) {
+                for (auto& c : stats->getChannelsByType(TYPE_AC)) {
+                    share.AcPower += stats->getChannelFieldValue(TYPE_AC, c, FLD_PAC);
+                    share.AcPowerDigits = max<unsigned int>(share.AcPowerDigits, stats->getChannelFieldDigits(TYPE_AC, c, FLD_PAC));
+                }
+
+                for (auto& c : dcChannels) {
+                    share.DcPower += stats->getChannelFieldValue(TYPE_DC, c, FLD_PDC);
+                    share.DcPowerDigits = max<unsigned int>(share.DcPowerDigits, stats->getChannelFieldDigits(TYPE_DC, c, FLD_PDC));
 
-                if (inv->Statistics()->getStringMaxPower(c) > 0) {
-                    _totalDcPowerIrradiation += inv->Statistics()->getChannelFieldValue(TYPE_DC, c, FLD_PDC);
-                    _totalDcIrradiationInstalled += inv->Statistics()->getStringMaxPower(c);
+                    if (stats->getStringMaxPower(c) > 0) {
+                        share.DcPowerIrradiation += stats->getChannelFieldValue(TYPE_DC, c, FLD_PDC);
+                        share.DcIrradiationInstalled += stats->getStringMaxPower(c);
+                    }
                 }
             }
         }
+
+        auto const& share = state.Share;
+        auto& sum = totals.Sum;
+        sum.AcYieldTotal += share.AcYieldTotal;
+        sum.AcYieldDay += share.AcYieldDay;
+        sum.AcPower += share.AcPower;
+        sum.DcPower += share.DcPower;
+        sum.DcPowerIrradiation += share.DcPowerIrradiation;
+        sum.DcIrradiationInstalled += share.DcIrradiationInstalled;
+        sum.AcYieldTotalDigits = max<unsigned int>(sum.AcYieldTotalDigits, share.AcYieldTotalDigits);
+        sum.AcYieldDayDigits = max<unsigned int>(sum.AcYieldDayDigits, share.AcYieldDayDigits);
+        sum.AcPowerDigits = max<unsigned int>(sum.AcPowerDigits, share.AcPowerDigits);
+        sum.DcPowerDigits = max<unsigned int>(sum.DcPowerDigits, share.DcPowerDigits);
     }
 
-    _isAtLeastOneProducing = isProducing > 0;
-    _isAtLeastOneReachable = isReachable > 0;
-    _isAtLeastOnePollEnabled = pollEnabledCount > 0;
+    totals.IsAtLeastOneProducing = isProducing > 0;
+    totals.IsAtLeastOneReachable = isReachable > 0;
+    totals.IsAtLeastOnePollEnabled = pollEnabledCount > 0;
+
+    totals.DcIrradiation = totals.Sum.DcIrradiationInstalled > 0 ? totals.Sum.DcPowerIrradiation / totals.Sum.DcIrradiationInstalled * 100.0f : 0;
+
+    publish(totals);
+}
+
+void DatastoreClass::publish(Totals const& totals)
+{
+    uint32_t seq = _totalsSeq.load(std::memory_order_relaxed);
+
+    // orders the previous increment of the sequence number before the
+    // writes to the slot, which the readers of the previous cycle might
+    // still be copying from.
+    std::atomic_thread_fence(std::memory_order_release);
+    _totals[(seq + 1) & 1] = totals;
+
+    _totalsSeq.store(seq + 1, std::memory_order_release);
+}
+
+DatastoreClass::Totals DatastoreClass::getTotals() const
+{
+    Totals totals;
+    uint32_t seq;
+
+    do {
+        seq = _totalsSeq.load(std::memory_order_acquire);
+        totals = _totals[seq & 1];
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while (seq != _totalsSeq.load(std::memory_order_relaxed));
 
-    _totalDcIrradiation = _totalDcIrradiationInstalled > 0 ? _totalDcPowerIrradiation / _totalDcIrradiationInstalled * 100.0f : 0;
+    return totals;
 }
 
 float DatastoreClass::getTotalAcYieldTotalEnabled()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalAcYieldTotalEnabled;
+    return getTotals().Sum.AcYieldTotal;
 }
 
 float DatastoreClass::getTotalAcYieldDayEnabled()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalAcYieldDayEnabled;
+    return getTotals().Sum.AcYieldDay;
 }
 
 float DatastoreClass::getTotalAcPowerEnabled()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalAcPowerEnabled;
+    return getTotals().Sum.AcPower;
 }
 
 float DatastoreClass::getTotalDcPowerEnabled()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalDcPowerEnabled;
+    return getTotals().Sum.DcPower;
 }
 
 float DatastoreClass::getTotalDcPowerIrradiation()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalDcPowerIrradiation;
+    return getTotals().Sum.DcPowerIrradiation;
 }
 
 float DatastoreClass::getTotalDcIrradiationInstalled()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalDcIrradiationInstalled;
+    return getTotals().Sum.DcIrradiationInstalled;
 }
 
 float DatastoreClass::getTotalDcIrradiation()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalDcIrradiation;
+    return getTotals().DcIrradiation;
 }
 
 uint32_t DatastoreClass::getTotalAcYieldTotalDigits()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalAcYieldTotalDigits;
+    return getTotals().Sum.AcYieldTotalDigits;
 }
 
 uint32_t DatastoreClass::getTotalAcYieldDayDigits()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalAcYieldDayDigits;
+    return getTotals().Sum.AcYieldDayDigits;
 }
 
 uint32_t DatastoreClass::getTotalAcPowerDigits()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalAcPowerDigits;
+    return getTotals().Sum.AcPowerDigits;
 }
 
 uint32_t DatastoreClass::getTotalDcPowerDigits()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalDcPowerDigits;
+    return getTotals().Sum.DcPowerDigits;
 }
 
 bool DatastoreClass::getIsAtLeastOneReachable()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _isAtLeastOneReachable;
+    return getTotals().IsAtLeastOneReachable;
 }
 
 bool DatastoreClass::getIsAtLeastOneProducing()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _isAtLeastOneProducing;
+    return getTotals().IsAtLeastOneProducing;
 }
 
 bool DatastoreClass::getIsAllEnabledProducing()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _isAllEnabledProducing;
+    return getTotals().IsAllEnabledProducing;
 }
 
 bool DatastoreClass::getIsAllEnabledReachable()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _isAllEnabledReachable;
+    return getTotals().IsAllEnabledReachable;
 }
 
 bool DatastoreClass::getIsAtLeastOnePollEnabled()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _isAtLeastOnePollEnabled;
+    return getTotals().IsAtLeastOnePollEnabled;
 }
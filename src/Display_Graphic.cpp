@@ -5,11 +5,14 @@
 #include "Display_Graphic.h"
 #include "Datastore.h"
 #include "I18n.h"
+#include "NightMode.h"
+#include "TaskPlacement.h"
 #include <powermeter/Controller.h>
 #include "Configuration.h"
 #include <NetworkSettings.h>
 #include <map>
 #include <time.h>
+#include "TaskProfiler.h"
 
 std::map<DisplayType_t, std::function<U8G2*(uint8_t, uint8_t, uint8_t, uint8_t)>> display_types = {
     { DisplayType_t::PCD8544, [](uint8_t reset, uint8_t clock, uint8_t data, uint8_t cs) { return new U8G2_PCD8544_84X48_F_4W_HW_SPI(U8G2_R0, cs, data, reset); } },
@@ -41,7 +44,7 @@ static const char* const i18n_yield_total_mwh[] = { "total: %.0f kWh", "Ges.: %.
 static const char* const i18n_date_format[] = { "%m/%d/%Y %H:%M", "%d.%m.%Y %H:%M", "%d/%m/%Y %H:%M" };
 
 DisplayGraphicClass::DisplayGraphicClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&DisplayGraphicClass::loop, this))
+    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, TaskProfiler.wrap("DisplayGraphic::loop", std::bind(&DisplayGraphicClass::loop, this)))
 {
 }
 
@@ -64,9 +67,74 @@ void DisplayGraphicClass::init(Scheduler& scheduler, const DisplayType_t type, c
         setStatus(true);
         _diagram.init(scheduler, _display);
 
+        _sentFrame.resize(_display->getBufferTileWidth() * _display->getBufferTileHeight() * 8);
+
+        uint32_t constexpr stackSize = 2048;
+        TaskPlacement::create(TaskPlacement::Role::Display,
+                DisplayGraphicClass::sendTaskHelper, "Display", stackSize,
+                this, &_sendTaskHandle);
+
         scheduler.addTask(_loopTask);
         _loopTask.setInterval(_period);
         _loopTask.enable();
+        NightMode.addIdleTask(_loopTask);
+    }
+}
+
+void DisplayGraphicClass::sendTaskHelper(void* context)
+{
+    static_cast<DisplayGraphicClass*>(context)->sendLoop();
+}
+
+void DisplayGraphicClass::sendLoop()
+{
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        std::lock_guard<std::mutex> lock(_displayMutex);
+        sendChangedTiles();
+
+        bool powerSave = _powerSave;
+        if (powerSave != _powerSaveSent) {
+            _display->setPowerSave(powerSave);
+            _powerSaveSent = powerSave;
+        }
+    }
+}
+
+// must be called while holding the display mutex
+void DisplayGraphicClass::sendChangedTiles()
+{
+    if (_sendAllTiles) {
+        _display->sendBuffer();
+        memcpy(_sentFrame.data(), _display->getBufferPtr(), _sentFrame.size());
+        _sendAllTiles = false;
+        return;
+    }
+
+    // a tile is eight bytes, each one a column of eight pixels
+    uint8_t const tileWidth = _display->getBufferTileWidth();
+    uint8_t const tileHeight = _display->getBufferTileHeight();
+    uint8_t const* pFrame = _display->getBufferPtr();
+
+    for (uint8_t ty = 0; ty < tileHeight; ++ty) {
+        size_t rowOffset = ty * tileWidth * 8;
+        int16_t first = -1;
+        int16_t last = -1;
+
+        for (uint8_t tx = 0; tx < tileWidth; ++tx) {
+            size_t offset = rowOffset + tx * 8;
+            if (memcmp(pFrame + offset, _sentFrame.data() + offset, 8) == 0) { continue; }
+            if (first < 0) { first = tx; }
+            last = tx;
+        }
+
+        if (first < 0) { continue; }
+
+        // the changed tiles of a row are sent as a single transfer
+        uint8_t width = last - first + 1;
+        _display->updateDisplayArea(first, ty, width, 1);
+        memcpy(_sentFrame.data() + rowOffset + first * 8, pFrame + rowOffset + first * 8, width * 8);
     }
 }
 
@@ -146,6 +214,11 @@ void DisplayGraphicClass::setOrientation(const uint8_t rotation)
         return;
     }
 
+    std::lock_guard<std::mutex> lock(_displayMutex);
+
+    // the frame is drawn anew in a different orientation
+    _sendAllTiles = true;
+
     switch (rotation) {
     case 0:
         _display->setDisplayRotation(U8G2_R0);
@@ -186,7 +259,12 @@ void DisplayGraphicClass::setLocale(const String& locale)
     _i18n_yield_total_kwh = i18n_yield_total_kwh[idx];
     _i18n_yield_total_mwh = i18n_yield_total_mwh[idx];
 
-    I18n.readDisplayStrings(locale,
+    _langPackPending = true;
+}
+
+void DisplayGraphicClass::readLangPack()
+{
+    I18n.readDisplayStrings(_display_language,
         _i18n_date_format,
         _i18n_offline,
         _i18n_current_power_w,
@@ -212,9 +290,11 @@ void DisplayGraphicClass::setStartupDisplay()
         return;
     }
 
+    std::lock_guard<std::mutex> lock(_displayMutex);
     _display->clearBuffer();
     printText("OpenDTU!", 0);
-    _display->sendBuffer();
+    _sendAllTiles = true;
+    sendChangedTiles();
 }
 
 DisplayGraphicDiagramClass& DisplayGraphicClass::Diagram()
@@ -224,7 +304,14 @@ DisplayGraphicDiagramClass& DisplayGraphicClass::Diagram()
 
 void DisplayGraphicClass::loop()
 {
-    _loopTask.setInterval(_period);
+    // the interval is stretched in the low-power mode
+    if (!NightMode.isActive()) { _loopTask.setInterval(_period); }
+
+    // skips this frame if the previous one is still being sent
+    std::unique_lock<std::mutex> lock(_displayMutex, std::try_to_lock);
+    if (!lock.owns_lock()) { return; }
+
+    if (_langPackPending.exchange(false)) { readLangPack(); }
 
     _display->clearBuffer();
     bool displayPowerSave = false;
@@ -327,15 +414,16 @@ void DisplayGraphicClass::loop()
         printText(_fmtText, 2);
     }
 
-    _display->sendBuffer();
-
     _mExtra++;
 
     if (!_displayTurnedOn) {
         displayPowerSave = true;
     }
 
-    _display->setPowerSave(displayPowerSave);
+    _powerSave = displayPowerSave;
+
+    lock.unlock();
+    if (_sendTaskHandle != nullptr) { xTaskNotifyGive(_sendTaskHandle); }
 }
 
 void DisplayGraphicClass::setContrast(const uint8_t contrast)
@@ -343,6 +431,7 @@ void DisplayGraphicClass::setContrast(const uint8_t contrast)
     if (!isValidDisplay()) {
         return;
     }
+    std::lock_guard<std::mutex> lock(_displayMutex);
     _display->setContrast(contrast * 2.55f);
 }
 
@@ -5,11 +5,14 @@
 #include "Display_Graphic_Diagram.h"
 #include "Configuration.h"
 #include "Datastore.h"
+#include "MemoryPolicy.h"
+#include "Reductions.h"
 #include <algorithm>
+#include "TaskProfiler.h"
 
 DisplayGraphicDiagramClass::DisplayGraphicDiagramClass()
-    : _averageTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&DisplayGraphicDiagramClass::averageLoop, this))
-    , _dataPointTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&DisplayGraphicDiagramClass::dataPointLoop, this))
+    : _averageTask(1 * TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("DisplayGraphicDiagram::averageLoop", std::bind(&DisplayGraphicDiagramClass::averageLoop, this)))
+    , _dataPointTask(TASK_IMMEDIATE, TASK_FOREVER, TaskProfiler.wrap("DisplayGraphicDiagram::dataPointLoop", std::bind(&DisplayGraphicDiagramClass::dataPointLoop, this)))
 {
 }
 
@@ -17,6 +20,18 @@ void DisplayGraphicDiagramClass::init(Scheduler& scheduler, U8G2* display)
 {
     _display = display;
 
+    _capacity = psramFound() ? (8 * MAX_DATAPOINTS) : MAX_DATAPOINTS;
+    size_t size = 3 * _capacity * sizeof(uint16_t);
+    _mins = static_cast<uint16_t*>(MemoryPolicy::allocateLarge(size));
+
+    if (_mins == nullptr) {
+        _capacity = 0;
+        return;
+    }
+
+    _maxs = _mins + _capacity;
+    _avgs = _maxs + _capacity;
+
     scheduler.addTask(_averageTask);
     _averageTask.enable();
 
@@ -28,40 +43,69 @@ void DisplayGraphicDiagramClass::init(Scheduler& scheduler, U8G2* display)
 void DisplayGraphicDiagramClass::averageLoop()
 {
     const float currentWatts = Datastore.getTotalAcPowerEnabled(); // get the current AC production
-    _iRunningAverage += currentWatts;
-    _iRunningAverageCnt++;
+    const uint16_t watts = std::clamp<float>(currentWatts + 0.5f, 0, UINT16_MAX);
+    _sampleSum += watts;
+    _sampleCount++;
+    _sampleMin = std::min(_sampleMin, watts);
+    _sampleMax = std::max(_sampleMax, watts);
+}
+
+void DisplayGraphicDiagramClass::updateMaximum()
+{
+    _maxWatts = 0;
+    forEachRange(0, _count, [this](size_t pos, size_t n) {
+        _maxWatts = Reductions::max(_maxs + pos, n, _maxWatts);
+    });
 }
 
 void DisplayGraphicDiagramClass::dataPointLoop()
 {
-    if (_graphValuesCount >= std::size(_graphValues)) {
-        for (uint8_t i = 0; i < std::size(_graphValues) - 1; i++) {
-            _graphValues[i] = _graphValues[i + 1];
-        }
-        _graphValuesCount = std::size(_graphValues) - 1;
+    if (_sampleCount == 0) {
+        return;
     }
-    if (_iRunningAverageCnt != 0) {
-        _graphValues[_graphValuesCount++] = _iRunningAverage / _iRunningAverageCnt;
-        _iRunningAverage = 0;
-        _iRunningAverageCnt = 0;
+
+    uint16_t const bucketMax = _sampleMax;
+
+    size_t idx;
+    bool evictsMaximum = false;
+    if (_count == _capacity) {
+        idx = _head;
+        evictsMaximum = (_maxs[idx] == _maxWatts);
+        _head = (_head + 1) % _capacity;
+    } else {
+        idx = (_head + _count) % _capacity;
+        _count++;
     }
-}
 
-uint32_t DisplayGraphicDiagramClass::getSecondsPerDot()
-{
-    return Configuration.get().Display.Diagram.Duration / _chartWidth;
+    _mins[idx] = _sampleMin;
+    _maxs[idx] = bucketMax;
+    _avgs[idx] = static_cast<uint16_t>(_sampleSum / _sampleCount);
+
+    _sampleSum = 0;
+    _sampleCount = 0;
+    _sampleMin = UINT16_MAX;
+    _sampleMax = 0;
+
+    // the maximum only needs to be searched if it dropped out of the buffer
+    if (evictsMaximum && bucketMax < _maxWatts) {
+        updateMaximum();
+    } else {
+        _maxWatts = std::max(_maxWatts, bucketMax);
+    }
 }
 
 void DisplayGraphicDiagramClass::updatePeriod()
 {
+    if (_capacity == 0) {
+        return;
+    }
+
     //  Calculate seconds per datapoint
-    _dataPointTask.setInterval(Configuration.get().Display.Diagram.Duration * TASK_SECOND / MAX_DATAPOINTS);
+    _dataPointTask.setInterval(Configuration.get().Display.Diagram.Duration * TASK_SECOND / _capacity);
 }
 
 void DisplayGraphicDiagramClass::redraw(uint8_t screenSaverOffsetX, uint8_t xPos, uint8_t yPos, uint8_t width, uint8_t height, bool isFullscreen)
 {
-    _chartWidth = width;
-
     // screenSaverOffsetX expected to be in range 0..6
     const uint8_t graphPosX = xPos + ((screenSaverOffsetX > 3) ? 1 : 0);
     const uint8_t graphPosY = yPos + ((screenSaverOffsetX > 3) ? 1 : 0);
@@ -83,7 +127,7 @@ void DisplayGraphicDiagramClass::redraw(uint8_t screenSaverOffsetX, uint8_t xPos
 
     // draw AC value
     char fmtText[7];
-    const float maxWatts = *std::max_element(_graphValues.begin(), _graphValues.end());
+    const float maxWatts = _maxWatts;
     if (maxWatts > 999) {
         snprintf(fmtText, sizeof(fmtText), "%2.1fkW", maxWatts / 1000);
     } else {
@@ -101,10 +145,6 @@ void DisplayGraphicDiagramClass::redraw(uint8_t screenSaverOffsetX, uint8_t xPos
         _display->drawStr(graphPosX - arrow_size - _display->getStrWidth(fmtText), graphPosY + 5, fmtText);
     }
 
-    // draw chart
-    const float scaleFactorY = maxWatts / static_cast<float>(height);
-    const float scaleFactorX = static_cast<float>(MAX_DATAPOINTS) / static_cast<float>(_chartWidth);
-
     if (maxWatts > 0 && isFullscreen) {
         // draw y axis ticks
         const uint16_t yAxisWattPerTick = maxWatts <= 100 ? 10 : maxWatts <= 1000 ? 100
@@ -117,20 +157,64 @@ void DisplayGraphicDiagramClass::redraw(uint8_t screenSaverOffsetX, uint8_t xPos
         }
     }
 
+    if (_capacity == 0 || width == 0) {
+        return;
+    }
+
+    // draw chart. the data points are spread over the width of the chart
+    // as if the buffer was full, such that the chart fills up from the left.
+    const float scaleFactorY = maxWatts / static_cast<float>(height);
+    const uint32_t secondsPerColumn = Configuration.get().Display.Diagram.Duration / width;
+    auto toY = [&](uint16_t watts) -> uint8_t {
+        if (scaleFactorY == 0) { return horizontal_line_y; }
+        return horizontal_line_y - std::max<int16_t>(0, watts / scaleFactorY - 0.5);
+    };
+
     uint8_t xAxisTicks = 1;
-    for (uint8_t i = 1; i < _graphValuesCount; i++) {
+    int16_t previousX = -1;
+    uint8_t previousY = 0;
+    size_t idx = 0;
+    for (uint8_t column = 0; column < width && idx < _count; column++) {
+        // the data points which belong to this column
+        size_t end = std::min(_count, (column + 1) * _capacity / width);
+        if (end <= idx) {
+            continue;
+        }
+
+        uint16_t columnMin = UINT16_MAX;
+        uint16_t columnMax = 0;
+        uint32_t columnSum = 0;
+        size_t columnCount = end - idx;
+        forEachRange(idx, columnCount, [&](size_t pos, size_t n) {
+            columnMin = Reductions::min(_mins + pos, n, columnMin);
+            columnMax = Reductions::max(_maxs + pos, n, columnMax);
+            columnSum += Reductions::sum(_avgs + pos, n);
+        });
+        idx = end;
+
+        const uint8_t x = graphPosX + column;
+
         // draw one tick per hour to the x-axis
-        if (i * getSecondsPerDot() > (3600u * xAxisTicks)) {
-            _display->drawPixel((graphPosX + 1 + i) * scaleFactorX, graphPosY + height);
+        if (column * secondsPerColumn > (3600u * xAxisTicks)) {
+            _display->drawPixel(x, graphPosY + height);
             xAxisTicks++;
         }
 
-        if (scaleFactorY == 0 || scaleFactorX == 0) {
-            continue;
+        // the range of the samples is drawn as a dotted band, the average
+        // as a solid line.
+        const uint8_t yMin = toY(columnMin);
+        const uint8_t yMax = toY(columnMax);
+        for (uint8_t y = yMax; y < yMin; y += 2) {
+            _display->drawPixel(x, y);
         }
 
-        _display->drawLine(
-            graphPosX + (i - 1) / scaleFactorX, horizontal_line_y - std::max<int16_t>(0, _graphValues[i - 1] / scaleFactorY - 0.5),
-            graphPosX + i / scaleFactorX, horizontal_line_y - std::max<int16_t>(0, _graphValues[i] / scaleFactorY - 0.5));
+        const uint8_t yAvg = toY(columnSum / columnCount);
+        if (previousX >= 0) {
+            _display->drawLine(previousX, previousY, x, yAvg);
+        } else {
+            _display->drawPixel(x, yAvg);
+        }
+        previousX = x;
+        previousY = yAvg;
     }
 }
@@ -0,0 +1,400 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "DplCluster.h"
+#include "Configuration.h"
+#include "MessageOutput.h"
+#include "NetworkSettings.h"
+#include "PowerLimiter.h"
+#include <TaskProfiler.h>
+#include <algorithm>
+#include <cstring>
+
+DplClusterClass DplCluster;
+
+namespace {
+
+// every datagram starts with the magic, the protocol version, the message
+// type and the cluster ID. values are little endian.
+constexpr uint8_t MAGIC[] = { 'O', 'D', 'P', 'L' };
+constexpr uint8_t PROTOCOL_VERSION = 1;
+constexpr size_t HEADER_SIZE = sizeof(MAGIC) + 3;
+
+enum MessageType : uint8_t {
+    Beacon = 1, // leader, broadcast, no payload
+    Report = 2, // follower: received and applied sequence, output, capacity, flags
+    Setpoint = 3 // leader: sequence, power
+};
+
+constexpr size_t REPORT_SIZE = 4 + 4 + 2 + 2 + 1;
+constexpr size_t SETPOINT_SIZE = 4 + 2;
+
+constexpr uint8_t REPORT_FLAG_SETTLED = 0x01;
+
+void put16(uint8_t* p, uint16_t value)
+{
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+void put32(uint8_t* p, uint32_t value)
+{
+    put16(p, value & 0xFFFF);
+    put16(p + 2, value >> 16);
+}
+
+uint16_t get16(uint8_t const* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+uint32_t get32(uint8_t const* p)
+{
+    return get16(p) | (static_cast<uint32_t>(get16(p + 2)) << 16);
+}
+
+} // namespace
+
+DplClusterClass::DplClusterClass()
+    : _loopTask(5 * TASK_MILLISECOND, TASK_FOREVER, TaskProfiler.wrap("DplCluster::loop", std::bind(&DplClusterClass::loop, this)))
+{
+}
+
+void DplClusterClass::init(Scheduler& scheduler)
+{
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+void DplClusterClass::updateSettings()
+{
+    auto const& config = Configuration.get().PowerLimiter.Cluster;
+
+    _udp.stop();
+    _nodes = {};
+    _leaderLost = true;
+    _setpoint = 0;
+    _setpointMillis = millis();
+
+    _role = static_cast<Role>(config.Role);
+    _clusterId = config.Id;
+    _port = config.Port;
+
+    if (_role != Role::Leader && _role != Role::Follower) {
+        _role = Role::Standalone;
+        return;
+    }
+
+    if (!_udp.begin(_port)) {
+        MessageOutput.println("[DplCluster] No sockets available");
+        _role = Role::Standalone;
+        return;
+    }
+
+    MessageOutput.printf("[DplCluster] Acting as %s of cluster %u on port %u\r\n",
+            (isLeader() ? "leader" : "follower"), _clusterId, _port);
+
+    _lastBeacon = millis() - BeaconIntervalMillis;
+    PowerLimiter.triggerCalculation();
+}
+
+void DplClusterClass::loop()
+{
+    auto generation = Configuration.getGeneration();
+    if (generation != _configGeneration) {
+        _configGeneration = generation;
+        updateSettings();
+    }
+
+    if (_role == Role::Standalone || !NetworkSettings.isConnected()) { return; }
+
+    receive();
+
+    if (isLeader()) {
+        for (auto& oNode : _nodes) {
+            if (!oNode || millis() - oNode->LastSeen < TimeoutMillis) { continue; }
+            MessageOutput.printf("[DplCluster] Lost follower %s\r\n",
+                    oNode->Address.toString().c_str());
+            oNode.reset();
+            PowerLimiter.triggerCalculation();
+        }
+
+        if (millis() - _lastBeacon >= BeaconIntervalMillis) { sendBeacon(); }
+        sendSetpoints();
+        return;
+    }
+
+    if (!_leaderLost && millis() - _leaderSeen > TimeoutMillis) {
+        MessageOutput.printf("[DplCluster] Lost leader %s, falling back to zero output\r\n",
+                _leaderAddress.toString().c_str());
+        _leaderLost = true;
+        if (_setpoint != 0) {
+            _setpoint = 0;
+            _setpointMillis = millis();
+            PowerLimiter.triggerCalculation();
+        }
+    }
+
+    if (_leaderLost) { return; }
+
+    // the leader waits for the followers to settle, so a change is
+    // reported right away
+    bool changed = _reportedSequence != _appliedSequence
+        || _reportedSettled != PowerLimiter.isSettled();
+    if (changed || millis() - _lastReport >= ReportIntervalMillis) { sendReport(); }
+}
+
+void DplClusterClass::receive()
+{
+    uint8_t buffer[HEADER_SIZE + REPORT_SIZE];
+
+    while (_udp.parsePacket() > 0) {
+        auto length = _udp.read(buffer, sizeof(buffer));
+        IPAddress address = _udp.remoteIP();
+        uint16_t port = _udp.remotePort();
+        _udp.flush();
+
+        if (length < static_cast<int>(HEADER_SIZE)) { continue; }
+        if (memcmp(buffer, MAGIC, sizeof(MAGIC)) != 0) { continue; }
+        if (buffer[4] != PROTOCOL_VERSION || buffer[6] != _clusterId) { continue; }
+
+        auto payload = buffer + HEADER_SIZE;
+        auto payloadLength = length - HEADER_SIZE;
+
+        switch (buffer[5]) {
+            case MessageType::Beacon:
+                onBeacon(address, port);
+                break;
+            case MessageType::Report:
+                if (payloadLength >= REPORT_SIZE) { onReport(address, port, payload); }
+                break;
+            case MessageType::Setpoint:
+                if (payloadLength >= SETPOINT_SIZE) { onSetpoint(address, port, payload); }
+                break;
+        }
+    }
+}
+
+void DplClusterClass::onBeacon(IPAddress const& address, uint16_t port)
+{
+    if (isLeader()) {
+        if (address == NetworkSettings.localIP()) { return; }
+        MessageOutput.printf("[DplCluster] %s acts as leader of cluster %u as well\r\n",
+                address.toString().c_str(), _clusterId);
+        return;
+    }
+
+    if (_leaderLost) {
+        MessageOutput.printf("[DplCluster] Following leader %s\r\n", address.toString().c_str());
+        _leaderAddress = address;
+        _leaderPort = port;
+        _leaderLost = false;
+        _receivedSequence = 0;
+        _appliedSequence = 0;
+        sendReport();
+    }
+
+    if (address == _leaderAddress) { _leaderSeen = millis(); }
+}
+
+void DplClusterClass::onReport(IPAddress const& address, uint16_t port, uint8_t const* payload)
+{
+    if (!isLeader()) { return; }
+
+    std::optional<Node>* pSlot = nullptr;
+    for (auto& oNode : _nodes) {
+        if (oNode && oNode->Address == address) { pSlot = &oNode; break; }
+        if (!oNode && pSlot == nullptr) { pSlot = &oNode; }
+    }
+
+    if (pSlot == nullptr) { return; } // all slots taken
+
+    if (!*pSlot) {
+        MessageOutput.printf("[DplCluster] New follower %s\r\n", address.toString().c_str());
+        *pSlot = Node {};
+        (*pSlot)->Address = address;
+        (*pSlot)->SetpointMillis = millis();
+    }
+
+    auto& node = **pSlot;
+    auto wasSettled = node.Settled && node.AppliedSequence == node.SetpointSequence;
+    auto previousOutput = node.OutputWatts;
+
+    node.Port = port;
+    node.LastSeen = millis();
+    node.ReceivedSequence = get32(payload);
+    node.AppliedSequence = get32(payload + 4);
+    node.OutputWatts = get16(payload + 8);
+    node.CapacityWatts = get16(payload + 10);
+    node.Settled = (payload[12] & REPORT_FLAG_SETTLED) != 0;
+
+    auto settled = node.Settled && node.AppliedSequence == node.SetpointSequence;
+    if (settled && !wasSettled) { node.SettledMillis = millis(); }
+
+    if (settled != wasSettled || node.OutputWatts != previousOutput) {
+        PowerLimiter.triggerCalculation();
+    }
+}
+
+void DplClusterClass::onSetpoint(IPAddress const& address, uint16_t port, uint8_t const* payload)
+{
+    if (!isFollower() || _leaderLost || address != _leaderAddress) { return; }
+
+    _leaderSeen = millis();
+
+    // repeated datagrams are acknowledged again, older ones are dropped
+    auto sequence = get32(payload);
+    if (sequence < _receivedSequence) { return; }
+
+    if (sequence > _receivedSequence) {
+        _receivedSequence = sequence;
+        auto watts = get16(payload + 4);
+        if (watts != _setpoint) {
+            _setpoint = watts;
+            _setpointMillis = millis();
+            PowerLimiter.triggerCalculation();
+        } else {
+            // nothing to adjust, so the setpoint is applied already
+            _appliedSequence = sequence;
+        }
+    }
+
+    sendReport();
+}
+
+void DplClusterClass::sendBeacon()
+{
+    _lastBeacon = millis();
+    send(IPAddress(255, 255, 255, 255), _port, MessageType::Beacon, nullptr, 0);
+}
+
+void DplClusterClass::sendReport()
+{
+    auto const& config = Configuration.get().PowerLimiter;
+
+    bool settled = PowerLimiter.isSettled();
+    uint16_t output = PowerLimiter.getGovernedOutputWatts();
+    uint32_t capacity = output + PowerLimiter.getGovernedMaxIncreaseWatts();
+    capacity = std::min<uint32_t>(capacity, config.TotalUpperPowerLimit);
+
+    uint8_t payload[REPORT_SIZE];
+    put32(payload, _receivedSequence);
+    put32(payload + 4, _appliedSequence);
+    put16(payload + 8, output);
+    put16(payload + 10, capacity);
+    payload[12] = settled ? REPORT_FLAG_SETTLED : 0;
+
+    send(_leaderAddress, _leaderPort, MessageType::Report, payload, sizeof(payload));
+
+    _lastReport = millis();
+    _reportedSequence = _appliedSequence;
+    _reportedSettled = settled;
+}
+
+void DplClusterClass::sendSetpoints()
+{
+    for (auto& oNode : _nodes) {
+        if (!oNode || oNode->ReceivedSequence == oNode->SetpointSequence) { continue; }
+        if (millis() - oNode->LastSent < RetransmitMillis) { continue; }
+
+        uint8_t payload[SETPOINT_SIZE];
+        put32(payload, oNode->SetpointSequence);
+        put16(payload + 4, oNode->SetpointWatts);
+        send(oNode->Address, oNode->Port, MessageType::Setpoint, payload, sizeof(payload));
+
+        oNode->LastSent = millis();
+    }
+}
+
+void DplClusterClass::send(IPAddress const& address, uint16_t port, uint8_t type, uint8_t const* payload, size_t length)
+{
+    if (!_udp.beginPacket(address, port)) { return; }
+
+    uint8_t header[HEADER_SIZE];
+    memcpy(header, MAGIC, sizeof(MAGIC));
+    header[4] = PROTOCOL_VERSION;
+    header[5] = type;
+    header[6] = _clusterId;
+
+    _udp.write(header, sizeof(header));
+    if (length > 0) { _udp.write(payload, length); }
+    _udp.endPacket();
+}
+
+uint16_t DplClusterClass::getFollowersOutputWatts() const
+{
+    uint32_t output = 0;
+    for (auto const& oNode : _nodes) {
+        if (oNode) { output += oNode->OutputWatts; }
+    }
+    return std::min<uint32_t>(output, UINT16_MAX);
+}
+
+std::optional<uint32_t> DplClusterClass::getSettledMillis() const
+{
+    uint32_t latest = 0;
+
+    for (auto const& oNode : _nodes) {
+        if (!oNode) { continue; }
+
+        auto const& node = *oNode;
+        bool applied = node.Settled && node.AppliedSequence == node.SetpointSequence;
+        bool idle = node.CapacityWatts == 0 && node.SetpointWatts == 0;
+        bool overdue = millis() - node.SetpointMillis > SettleTimeoutMillis;
+
+        if (applied) {
+            latest = std::max(latest, node.SettledMillis);
+        } else if (!idle && !overdue) {
+            return std::nullopt;
+        }
+    }
+
+    return latest;
+}
+
+uint16_t DplClusterClass::distribute(uint16_t powerRequested)
+{
+    uint32_t capacity = 0;
+    for (auto const& oNode : _nodes) {
+        if (oNode) { capacity += oNode->CapacityWatts; }
+    }
+
+    uint32_t assigned = 0;
+
+    for (auto& oNode : _nodes) {
+        if (!oNode) { continue; }
+
+        uint16_t share = 0;
+        if (capacity > 0) {
+            share = std::min<uint32_t>(oNode->CapacityWatts,
+                    static_cast<uint32_t>(powerRequested) * oNode->CapacityWatts / capacity);
+        }
+        assigned += share;
+
+        if (share == oNode->SetpointWatts) { continue; }
+
+        oNode->SetpointWatts = share;
+        oNode->SetpointSequence = ++_sequence;
+        oNode->SetpointMillis = millis();
+        oNode->LastSent = millis() - RetransmitMillis;
+
+        if (Configuration.get().PowerLimiter.VerboseLogging) {
+            MessageOutput.printf("[DplCluster] Assigning %u W to follower %s (capacity %u W)\r\n",
+                    share, oNode->Address.toString().c_str(), oNode->CapacityWatts);
+        }
+    }
+
+    sendSetpoints();
+
+    return std::min<uint32_t>(assigned, UINT16_MAX);
+}
+
+uint16_t DplClusterClass::getSetpoint()
+{
+    _appliedSequence = _receivedSequence;
+    return _setpoint;
+}
+
+size_t DplClusterClass::getNodeCount() const
+{
+    return std::count_if(_nodes.begin(), _nodes.end(),
+            [](auto const& oNode) { return oNode.has_value(); });
+}
@@ -0,0 +1,297 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "EnergyMeter.h"
+#include "Configuration.h"
+#include "DataBus.h"
+#include "Datastore.h"
+#include "MessageOutput.h"
+#include "MqttSettings.h"
+#include "NightMode.h"
+#include "StateStore.h"
+#include "TaskProfiler.h"
+#include <battery/Controller.h>
+#include <powermeter/Controller.h>
+#include <solarcharger/Controller.h>
+#include <LittleFS.h>
+#include <esp_rom_crc.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+
+EnergyMeterClass EnergyMeter;
+
+namespace {
+
+constexpr uint32_t RECORD_MAGIC = 0x454d5631; // "EMV1"
+
+constexpr char const* STATE_KEY = "energy";
+
+// the solar charger and the inverters are sampled at the loop's
+// interval while their data is recent
+constexpr uint32_t MAX_DATA_AGE_MILLIS = 10 * 1000;
+
+String getSlotFilename(uint8_t slot)
+{
+    return String("/energy_") + slot + ".bin";
+}
+
+// the local date as yyyymmdd, or 0 if the time is not known yet
+uint32_t getLocalDay()
+{
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo, 5)) { return 0; }
+    return (timeinfo.tm_year + 1900) * 10000 + (timeinfo.tm_mon + 1) * 100 + timeinfo.tm_mday;
+}
+
+} // namespace
+
+EnergyMeterClass::EnergyMeterClass()
+    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("EnergyMeter::loop", std::bind(&EnergyMeterClass::loop, this)))
+    , _publishTask(TASK_IMMEDIATE, TASK_FOREVER, TaskProfiler.wrap("EnergyMeter::publishLoop", std::bind(&EnergyMeterClass::publishLoop, this)))
+{
+}
+
+void EnergyMeterClass::init(Scheduler& scheduler)
+{
+    if (restore()) {
+        MessageOutput.printf("[EnergyMeter] Restored counters of day %" PRIu32 "\r\n", _day);
+    }
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+
+    scheduler.addTask(_publishTask);
+    _publishTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
+    _publishTask.enable();
+    NightMode.addIdleTask(_publishTask);
+}
+
+char const* EnergyMeterClass::getName(Flow flow)
+{
+    switch (flow) {
+    case Flow::GridImport: return "grid_import";
+    case Flow::GridExport: return "grid_export";
+    case Flow::BatteryCharge: return "battery_charge";
+    case Flow::BatteryDischarge: return "battery_discharge";
+    case Flow::SolarCharger: return "solar_charger";
+    case Flow::Inverters: return "inverters";
+    }
+    return "unknown";
+}
+
+double EnergyMeterClass::getToday(Flow flow) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _today[static_cast<size_t>(flow)];
+}
+
+double EnergyMeterClass::getTotal(Flow flow) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _total[static_cast<size_t>(flow)];
+}
+
+void EnergyMeterClass::Integrator::add(uint32_t timestamp, float watts, double& positiveWh, double& negativeWh)
+{
+    uint32_t elapsed = timestamp - _lastMillis;
+    bool connected = _valid && elapsed <= MAX_GAP_MILLIS;
+    float lastWatts = _lastWatts;
+
+    _valid = true;
+    _lastMillis = timestamp;
+    _lastWatts = watts;
+
+    if (!connected || elapsed == 0) { return; }
+
+    double hours = elapsed / 3600000.0;
+
+    if ((lastWatts >= 0) == (watts >= 0)) {
+        double wh = (lastWatts + watts) / 2 * hours;
+        if (wh >= 0) { positiveWh += wh; } else { negativeWh -= wh; }
+        return;
+    }
+
+    // the power crossed zero, which is assumed to happen linearly
+    double crossing = lastWatts / (lastWatts - watts);
+    double first = lastWatts / 2 * crossing * hours;
+    double second = watts / 2 * (1 - crossing) * hours;
+    for (double wh : { first, second }) {
+        if (wh >= 0) { positiveWh += wh; } else { negativeWh -= wh; }
+    }
+}
+
+void EnergyMeterClass::add(Integrator& integrator, float watts, Flow positive, Flow negative)
+{
+    uint32_t now = millis();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    double positiveWh = 0;
+    double negativeWh = 0;
+    integrator.add(now, watts, positiveWh, negativeWh);
+    if (positiveWh == 0 && negativeWh == 0) { return; }
+
+    for (auto [flow, wh] : { std::make_pair(positive, positiveWh), std::make_pair(negative, negativeWh) }) {
+        _today[static_cast<size_t>(flow)] += wh;
+        _total[static_cast<size_t>(flow)] += wh;
+    }
+    _dirty = true;
+}
+
+void EnergyMeterClass::loop()
+{
+    auto const& config = Configuration.get();
+
+    uint32_t day = getLocalDay();
+    if (day != 0 && day != _day) { rollover(day); }
+
+    // the power meter and the battery are integrated once per new sample
+    if (config.PowerMeter.Enabled && PowerMeter.isDataValid()) {
+        uint32_t sequence = DataBus.getSequence(DataBusClass::Topic::PowerMeter);
+        if (sequence != _lastPowerMeterSequence) {
+            _lastPowerMeterSequence = sequence;
+            add(_grid, PowerMeter.getPowerTotal(), Flow::GridImport, Flow::GridExport);
+        }
+    } else {
+        _grid.reset();
+    }
+
+    auto spBattery = Battery.getStats();
+    if (config.Battery.Enabled && spBattery->isVoltageValid() && spBattery->isCurrentValid()
+            && spBattery->getChargeCurrentAgeSeconds() * 1000 < MAX_GAP_MILLIS) {
+        uint32_t sequence = DataBus.getSequence(DataBusClass::Topic::Battery);
+        if (sequence != _lastBatterySequence) {
+            _lastBatterySequence = sequence;
+            // a positive current charges the battery
+            add(_battery, spBattery->getVoltage() * spBattery->getChargeCurrent(),
+                Flow::BatteryCharge, Flow::BatteryDischarge);
+        }
+    } else {
+        _battery.reset();
+    }
+
+    auto spSolarCharger = SolarCharger.getStats();
+    auto solarChargerWatts = spSolarCharger->getOutputPowerWatts();
+    if (config.SolarCharger.Enabled && solarChargerWatts.has_value()
+            && spSolarCharger->getAgeMillis() < MAX_DATA_AGE_MILLIS) {
+        add(_solarCharger, std::max(0.0f, *solarChargerWatts), Flow::SolarCharger, Flow::SolarCharger);
+    } else {
+        _solarCharger.reset();
+    }
+
+    if (Datastore.getIsAtLeastOneReachable()) {
+        add(_inverters, std::max(0.0f, Datastore.getTotalAcPowerEnabled()), Flow::Inverters, Flow::Inverters);
+    } else {
+        _inverters.reset();
+    }
+
+    if (_dirty) { persist(); }
+}
+
+void EnergyMeterClass::rollover(uint32_t day)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // the counters restored from flash might belong to another day
+        // than the one the time was set to
+        if (_day != 0) {
+            _today.fill(0);
+            _dirty = true;
+        }
+        _day = day;
+    }
+
+    persist();
+}
+
+void EnergyMeterClass::publishLoop()
+{
+    _publishTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
+
+    if (!MqttSettings.acceptsPublishes()) {
+        _publishTask.forceNextIteration();
+        return;
+    }
+
+    for (size_t i = 0; i < FLOW_COUNT; ++i) {
+        auto flow = static_cast<Flow>(i);
+        auto& topics = MqttTopicRegistry;
+        MqttSettings.publish(topics.intern("energy/", getName(flow), "/today"), getToday(flow) / 1000, 3);
+        MqttSettings.publish(topics.intern("energy/", getName(flow), "/total"), getTotal(flow) / 1000, 3);
+    }
+}
+
+void EnergyMeterClass::flush()
+{
+    if (_dirty) { persist(); }
+}
+
+bool EnergyMeterClass::restore()
+{
+    Snapshot snapshot;
+    if (!StateStore.get(STATE_KEY, snapshot)) {
+        if (!restoreLegacy()) { return false; }
+
+        // the slot files are superseded by the state store
+        persist();
+        for (uint8_t slot = 0; slot < PERSIST_SLOTS; ++slot) {
+            LittleFS.remove(getSlotFilename(slot));
+        }
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::copy(std::begin(snapshot.Today), std::end(snapshot.Today), _today.begin());
+    std::copy(std::begin(snapshot.Total), std::end(snapshot.Total), _total.begin());
+    _day = snapshot.Day;
+    return true;
+}
+
+bool EnergyMeterClass::restoreLegacy()
+{
+    Record best;
+    bool found = false;
+
+    for (uint8_t slot = 0; slot < PERSIST_SLOTS; ++slot) {
+        File f = LittleFS.open(getSlotFilename(slot), "r", false);
+        if (!f) { continue; }
+
+        Record record;
+        bool valid = f.read(reinterpret_cast<uint8_t*>(&record), sizeof(record)) == sizeof(record)
+            && record.Magic == RECORD_MAGIC
+            && record.Crc == esp_rom_crc32_le(0, reinterpret_cast<uint8_t const*>(&record), offsetof(Record, Crc));
+        f.close();
+
+        if (!valid) { continue; }
+
+        if (!found || record.Sequence > best.Sequence) {
+            best = record;
+            found = true;
+        }
+    }
+
+    if (!found) { return false; }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::copy(std::begin(best.Today), std::end(best.Today), _today.begin());
+    std::copy(std::begin(best.Total), std::end(best.Total), _total.begin());
+    _day = best.Day;
+    return true;
+}
+
+void EnergyMeterClass::persist()
+{
+    Snapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        snapshot.Day = _day;
+        std::copy(_today.begin(), _today.end(), snapshot.Today);
+        std::copy(_total.begin(), _total.end(), snapshot.Total);
+        _dirty = false;
+    }
+
+    StateStore.set(STATE_KEY, snapshot);
+}
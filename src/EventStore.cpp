@@ -0,0 +1,328 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "EventStore.h"
+#include "Configuration.h"
+#include "MessageOutput.h"
+#include <battery/Controller.h>
+#include <gridcharger/huawei/Controller.h>
+#include <Hoymiles.h>
+#include <LittleFS.h>
+#include <algorithm>
+#include "TaskProfiler.h"
+
+#define EVENTS_DIRNAME "/events"
+
+EventStoreClass EventStore;
+
+struct EventFileHeader {
+    uint32_t Magic;
+    uint16_t RecordSize;
+    uint16_t Reserved;
+};
+
+static constexpr uint32_t EVENT_FILE_MAGIC = 0x45564E54; // "EVNT"
+static constexpr uint32_t SECONDS_PER_DAY = 24 * 60 * 60;
+
+// events are dropped rather than using up the space of the configuration
+static constexpr size_t MIN_FREE_BYTES = 16 * 1024;
+
+// two records describe the same event if they only differ by their end
+static bool isSameEvent(EventStoreClass::Record const& a, EventStoreClass::Record const& b)
+{
+    return a.Origin == b.Origin && a.Serial == b.Serial
+        && a.Code == b.Code && a.Start == b.Start;
+}
+
+EventStoreClass::EventStoreClass()
+    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("EventStore::loop", std::bind(&EventStoreClass::loop, this)))
+{
+}
+
+void EventStoreClass::init(Scheduler& scheduler)
+{
+    if (!LittleFS.exists(EVENTS_DIRNAME)) {
+        LittleFS.mkdir(EVENTS_DIRNAME);
+    }
+
+    restore();
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+String EventStoreClass::getFilename(uint16_t day)
+{
+    char name[24];
+    snprintf(name, sizeof(name), EVENTS_DIRNAME "/%05u.bin", day);
+    return name;
+}
+
+void EventStoreClass::add(Source source, uint16_t code)
+{
+    // events are only useful with a wall clock timestamp
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo, 5)) {
+        return;
+    }
+
+    Record record = { 0, static_cast<uint32_t>(time(nullptr)), 0, code, source, 0 };
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pending.push_back(record);
+}
+
+void EventStoreClass::loop()
+{
+    auto const& config = Configuration.get();
+
+    watchDataAge(Source::Battery, config.Battery.Enabled,
+        Battery.getStats()->getLastUpdate(), _batteryDataLost);
+
+    watchDataAge(Source::GridCharger, config.Huawei.Enabled,
+        HuaweiCan.getDataPoints().getLastUpdate(), _gridChargerDataLost);
+
+    takeInverterAlarms();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (auto const& record : _pending) {
+        append(record);
+    }
+    _pending.clear();
+}
+
+void EventStoreClass::watchDataAge(Source source, bool enabled, uint32_t lastUpdate, bool& lost)
+{
+    // no data was received since the start, which is not an event
+    if (!enabled || lastUpdate == 0) {
+        lost = false;
+        return;
+    }
+
+    bool stale = (millis() - lastUpdate) > DATA_TIMEOUT_S * 1000;
+    if (stale == lost) {
+        return;
+    }
+
+    lost = stale;
+    add(source, static_cast<uint16_t>(stale ? Code::DataLost : Code::DataRestored));
+}
+
+void EventStoreClass::takeInverterAlarms()
+{
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo, 5)) {
+        return;
+    }
+
+    size_t count = Hoymiles.getNumInverters();
+    _alarmLogUpdates.resize(count, 0);
+
+    for (size_t i = 0; i < count; ++i) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) {
+            continue;
+        }
+
+        auto eventLog = inv->EventLog();
+        uint32_t lastUpdate = eventLog->getLastUpdate();
+        if (lastUpdate == 0 || lastUpdate == _alarmLogUpdates[i]) {
+            continue;
+        }
+        _alarmLogUpdates[i] = lastUpdate;
+
+        uint8_t entries = eventLog->getEntryCount();
+        for (uint8_t e = 0; e < entries; ++e) {
+            AlarmLogEntry_t entry;
+            eventLog->getLogEntry(e, entry);
+
+            // the inverter did not know the time when the alarm started
+            if (entry.StartTime <= 0) {
+                continue;
+            }
+
+            Record record = {
+                inv->serial(),
+                static_cast<uint32_t>(entry.StartTime),
+                static_cast<uint32_t>(std::max<time_t>(entry.EndTime, 0)),
+                entry.MessageId,
+                Source::InverterAlarm,
+                0
+            };
+
+            if (isKnown(record)) {
+                continue;
+            }
+            remember(record);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            _pending.push_back(record);
+        }
+    }
+}
+
+bool EventStoreClass::isKnown(Record const& record) const
+{
+    for (size_t i = 0; i < _knownCount; ++i) {
+        if (isSameEvent(_known[i], record) && _known[i].End == record.End) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void EventStoreClass::remember(Record const& record)
+{
+    _known[_knownNext] = record;
+    _knownNext = (_knownNext + 1) % KNOWN_ALARMS;
+    _knownCount = std::min(_knownCount + 1, KNOWN_ALARMS);
+}
+
+void EventStoreClass::append(Record const& record)
+{
+    if (LittleFS.totalBytes() - LittleFS.usedBytes() < MIN_FREE_BYTES) {
+        MessageOutput.println("[EventStore] Not enough space left to store events");
+        return;
+    }
+
+    uint16_t day = record.Start / SECONDS_PER_DAY;
+    String name = getFilename(day);
+
+    File f = LittleFS.open(name, "a");
+    if (!f) {
+        return;
+    }
+
+    if (f.size() == 0) {
+        EventFileHeader header = { EVENT_FILE_MAGIC, sizeof(Record), 0 };
+        f.write(reinterpret_cast<uint8_t const*>(&header), sizeof(header));
+    }
+
+    f.write(reinterpret_cast<uint8_t const*>(&record), sizeof(record));
+    f.close();
+
+    auto it = std::lower_bound(_days.begin(), _days.end(), day);
+    if (it != _days.end() && *it == day) {
+        return;
+    }
+    _days.insert(it, day);
+
+    // a new day started, which is the time to expire the oldest days
+    while (!_days.empty() && _days.front() + RETENTION_DAYS < _days.back()) {
+        LittleFS.remove(getFilename(_days.front()));
+        _days.erase(_days.begin());
+    }
+}
+
+void EventStoreClass::restore()
+{
+    std::vector<String> incompatible;
+
+    File dir = LittleFS.open(EVENTS_DIRNAME);
+    File file = dir.openNextFile();
+    while (file) {
+        unsigned day;
+        if (!file.isDirectory() && sscanf(file.name(), "%05u.bin", &day) == 1) {
+            EventFileHeader header;
+            if (file.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) != sizeof(header)
+                || header.Magic != EVENT_FILE_MAGIC
+                || header.RecordSize != sizeof(Record)) {
+                incompatible.push_back(getFilename(day));
+            } else {
+                _days.push_back(day);
+            }
+        }
+
+        file = dir.openNextFile();
+    }
+    dir.close();
+
+    for (auto const& name : incompatible) {
+        MessageOutput.printf("[EventStore] Discarding incompatible file %s\r\n", name.c_str());
+        LittleFS.remove(name);
+    }
+
+    std::sort(_days.begin(), _days.end());
+
+    // the alarm logs of the inverters hold the alarms of the last day at
+    // most, such that the previous day suffices to skip the known ones.
+    size_t first = (_days.size() > 2) ? _days.size() - 2 : 0;
+    for (size_t d = first; d < _days.size(); ++d) {
+        File f = LittleFS.open(getFilename(_days[d]), "r", false);
+        if (!f) {
+            continue;
+        }
+
+        f.seek(sizeof(EventFileHeader));
+
+        Record record;
+        while (f.read(reinterpret_cast<uint8_t*>(&record), sizeof(record)) == sizeof(record)) {
+            if (record.Origin == Source::InverterAlarm) {
+                remember(record);
+            }
+        }
+    }
+
+    MessageOutput.printf("[EventStore] Found events of %u days\r\n",
+        static_cast<unsigned>(_days.size()));
+}
+
+size_t EventStoreClass::query(uint32_t from, uint32_t to, uint64_t serial,
+    size_t maxRecords, RecordCallback const& callback)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    size_t count = 0;
+    uint16_t firstDay = from / SECONDS_PER_DAY;
+    uint16_t lastDay = to / SECONDS_PER_DAY;
+
+    std::vector<Record> records;
+
+    for (auto it = std::lower_bound(_days.begin(), _days.end(), firstDay);
+         it != _days.end() && *it <= lastDay && count < maxRecords; ++it) {
+        File f = LittleFS.open(getFilename(*it), "r", false);
+        if (!f) {
+            continue;
+        }
+
+        f.seek(sizeof(EventFileHeader));
+        records.clear();
+
+        Record record;
+        while (f.read(reinterpret_cast<uint8_t*>(&record), sizeof(record)) == sizeof(record)) {
+            if (record.Start < from || record.Start > to) {
+                continue;
+            }
+            if (serial != 0 && record.Serial != serial) {
+                continue;
+            }
+
+            // an alarm which ended was stored again, which replaces the
+            // record stored while it was ongoing.
+            auto same = std::find_if(records.begin(), records.end(),
+                [&record](Record const& r) { return isSameEvent(r, record); });
+            if (same != records.end()) {
+                same->End = std::max(same->End, record.End);
+                continue;
+            }
+
+            records.push_back(record);
+        }
+        f.close();
+
+        // records are appended in the order they became known, which is
+        // not the order of their start for the alarms of the inverters.
+        std::stable_sort(records.begin(), records.end(),
+            [](Record const& a, Record const& b) { return a.Start < b.Start; });
+
+        for (auto const& r : records) {
+            if (count >= maxRecords) {
+                break;
+            }
+            callback(r);
+            ++count;
+        }
+    }
+
+    return count;
+}
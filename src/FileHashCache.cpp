@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "FileHashCache.h"
+#include "I18n.h"
+#include "TaskProfiler.h"
+#include "Utils.h"
+#include <LittleFS.h>
+
+FileHashCacheClass FileHashCache;
+
+FileHashCacheClass::FileHashCacheClass()
+    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("FileHashCache::loop", std::bind(&FileHashCacheClass::loop, this)))
+{
+}
+
+void FileHashCacheClass::init(Scheduler& scheduler)
+{
+    _entries.reserve(Capacity);
+
+    // the language packs are scanned and hashed once the system settled
+    scheduler.addTask(_loopTask);
+    _loopTask.enableDelayed(30 * TASK_SECOND);
+}
+
+void FileHashCacheClass::loop()
+{
+    if (!_queued) {
+        for (auto const& language : I18n.getAvailableLanguages()) {
+            if (language.filename.isEmpty()) { continue; }
+            _pending.push_back(language.filename);
+        }
+        _queued = true;
+    }
+
+    // one file per iteration, as hashing blocks the main loop
+    if (_pending.empty()) {
+        _loopTask.disable();
+        return;
+    }
+
+    getMd5(_pending.front());
+    _pending.pop_front();
+}
+
+String FileHashCacheClass::getMd5(String const& path)
+{
+    File f = LittleFS.open(path, "r", false);
+    if (!f || f.isDirectory()) { return String(); }
+
+    size_t size = f.size();
+    time_t lastWrite = f.getLastWrite();
+    f.close();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto const& entry : _entries) {
+            if (entry.Path != path) { continue; }
+            if (entry.Size == size && entry.LastWrite == lastWrite) { return entry.Md5; }
+            break;
+        }
+    }
+
+    // the file is read without holding the lock
+    String md5 = Utils::generateMd5FromFile(path);
+    if (md5.isEmpty()) { return md5; }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (auto& entry : _entries) {
+        if (entry.Path != path) { continue; }
+        entry.Size = size;
+        entry.LastWrite = lastWrite;
+        entry.Md5 = md5;
+        return md5;
+    }
+
+    Entry entry = { path, size, lastWrite, md5 };
+    if (_entries.size() < Capacity) {
+        _entries.push_back(std::move(entry));
+    } else {
+        _entries[_next] = std::move(entry);
+        _next = (_next + 1) % Capacity;
+    }
+
+    return md5;
+}
+
+void FileHashCacheClass::invalidate(String const& path)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // the slot stays in place, such that the replacement order is kept
+    for (auto& entry : _entries) {
+        if (entry.Path != path) { continue; }
+        entry.Size = 0;
+        entry.LastWrite = 0;
+        entry.Md5 = String();
+        entry.Path = String();
+    }
+}
+
+String FileHashCacheClass::getETag(String const& path)
+{
+    String md5 = getMd5(path);
+    if (md5.isEmpty()) { return md5; }
+
+    String etag;
+    etag.reserve(md5.length() + 2);
+    etag = "\"";
+    etag += md5;
+    etag += "\"";
+    return etag;
+}
@@ -0,0 +1,332 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "FirmwareUpdater.h"
+#include "MemoryPolicy.h"
+#include "MessageOutput.h"
+#include "TaskPlacement.h"
+#include <Update.h>
+#include <rom/miniz.h>
+#include <algorithm>
+
+FirmwareUpdaterClass FirmwareUpdater;
+
+namespace {
+
+// flags of the gzip member header
+constexpr uint8_t GZIP_FHCRC = 0x02;
+constexpr uint8_t GZIP_FEXTRA = 0x04;
+constexpr uint8_t GZIP_FNAME = 0x08;
+constexpr uint8_t GZIP_FCOMMENT = 0x10;
+
+constexpr uint8_t GZIP_MAGIC1 = 0x1f;
+constexpr uint8_t GZIP_MAGIC2 = 0x8b;
+constexpr uint8_t GZIP_DEFLATE = 0x08;
+
+} // namespace
+
+bool FirmwareUpdaterClass::begin(String const& md5)
+{
+    if (_running) {
+        // the previous upload was aborted, its task has given up already
+        if (xSemaphoreTake(_done, 0) != pdTRUE) { return false; }
+        release();
+    }
+
+    if (md5.length() != 32) { return false; }
+
+    if (_done == nullptr) {
+        _done = xSemaphoreCreateBinary();
+        if (_done == nullptr) { return false; }
+    }
+
+    _streamStorage = static_cast<uint8_t*>(MemoryPolicy::allocateLarge(StreamSize + 1));
+    _chunk = static_cast<uint8_t*>(malloc(ChunkSize));
+    if (_streamStorage == nullptr || _chunk == nullptr) {
+        MessageOutput.println("[FirmwareUpdater] Failed to allocate buffers");
+        release();
+        return false;
+    }
+    _stream = xStreamBufferCreateStatic(StreamSize, 1, _streamStorage, &_streamStruct);
+
+    if (!Update.begin(UPDATE_SIZE_UNKNOWN, U_FLASH)) { // Start with max available size
+        Update.printError(Serial);
+        release();
+        return false;
+    }
+
+    _expectedMd5 = md5;
+    _md5.begin();
+    _format = Format::Unknown;
+    _headerFlags = 0;
+    _headerFixed = 0;
+    _headerExtra = 0;
+    _headerExtraLength = 0;
+    _headerCrc = 0;
+    _headerDone = false;
+    _dictionaryOffset = 0;
+    _inflateDone = false;
+    _inflatedSize = 0;
+    _trailerLength = 0;
+
+    _error = nullptr;
+    _finished = false;
+    _running = true;
+
+    uint32_t constexpr stackSize = 4096;
+    if (!TaskPlacement::create(TaskPlacement::Role::FirmwareUpdate,
+            FirmwareUpdaterClass::taskHelper, "FirmwareUpdate", stackSize,
+            this, &_taskHandle)) {
+        Update.abort();
+        release();
+        return false;
+    }
+
+    return true;
+}
+
+bool FirmwareUpdaterClass::write(uint8_t const* data, size_t len)
+{
+    if (!_running || _error.load() != nullptr) { return false; }
+
+    size_t sent = xStreamBufferSend(_stream, data, len, pdMS_TO_TICKS(WriteTimeoutMillis));
+    if (sent != len) {
+        fail("Writing the flash stalled");
+        return false;
+    }
+
+    return true;
+}
+
+bool FirmwareUpdaterClass::end()
+{
+    if (!_running) { return false; }
+
+    _finished = true;
+
+    if (xSemaphoreTake(_done, pdMS_TO_TICKS(FinishTimeoutMillis)) != pdTRUE) {
+        fail("Timeout while finishing the update");
+        return false;
+    }
+
+    release();
+    return _error.load() == nullptr;
+}
+
+void FirmwareUpdaterClass::taskHelper(void* context)
+{
+    static_cast<FirmwareUpdaterClass*>(context)->taskLoop();
+}
+
+void FirmwareUpdaterClass::taskLoop()
+{
+    uint32_t lastData = millis();
+
+    while (true) {
+        size_t len = xStreamBufferReceive(_stream, _chunk, ChunkSize, pdMS_TO_TICKS(100));
+
+        if (len > 0) {
+            lastData = millis();
+            if (_error.load() == nullptr) {
+                _md5.add(_chunk, len);
+                process(_chunk, len);
+            }
+            continue;
+        }
+
+        if (_finished) { break; }
+
+        if (millis() - lastData > IdleTimeoutMillis) {
+            fail("Upload stalled");
+            break;
+        }
+    }
+
+    if (_error.load() == nullptr) { finish(); }
+    if (_error.load() != nullptr) { Update.abort(); }
+
+    _taskHandle = nullptr;
+    xSemaphoreGive(_done);
+    vTaskDelete(nullptr);
+}
+
+bool FirmwareUpdaterClass::process(uint8_t* data, size_t len)
+{
+    if (_format == Format::Unknown) {
+        // firmware images start with 0xE9, so the gzip magic is unambiguous
+        if (data[0] == GZIP_MAGIC1) {
+            _inflator = static_cast<tinfl_decompressor*>(MemoryPolicy::allocateLarge(sizeof(tinfl_decompressor)));
+            _dictionary = static_cast<uint8_t*>(MemoryPolicy::allocateLarge(DictionarySize));
+            if (_inflator == nullptr || _dictionary == nullptr) {
+                fail("Failed to allocate the decompressor");
+                return false;
+            }
+            tinfl_init(_inflator);
+            _format = Format::Gzip;
+            MessageOutput.println("[FirmwareUpdater] Inflating gzip compressed image");
+        } else {
+            _format = Format::Plain;
+        }
+    }
+
+    if (_format == Format::Plain) { return writeFlash(data, len); }
+
+    if (!processGzipHeader(data, len)) { return false; }
+    if (len == 0) { return true; }
+
+    return inflate(data, len);
+}
+
+bool FirmwareUpdaterClass::processGzipHeader(uint8_t*& data, size_t& len)
+{
+    auto consume = [&]() {
+        uint8_t value = *data;
+        ++data;
+        --len;
+        return value;
+    };
+
+    while (!_headerDone) {
+        bool needsData = _headerFixed < 10
+            || (_headerFlags & (GZIP_FEXTRA | GZIP_FNAME | GZIP_FCOMMENT)) != 0
+            || _headerCrc > 0;
+        if (needsData && len == 0) { return true; }
+
+        if (_headerFixed < 10) {
+            uint8_t value = consume();
+            if ((_headerFixed == 1 && value != GZIP_MAGIC2) || (_headerFixed == 2 && value != GZIP_DEFLATE)) {
+                fail("Invalid gzip header");
+                return false;
+            }
+            if (_headerFixed == 3) {
+                _headerFlags = value;
+                _headerCrc = (value & GZIP_FHCRC) ? 2 : 0;
+            }
+            ++_headerFixed;
+        } else if (_headerFlags & GZIP_FEXTRA) {
+            if (_headerExtraLength < 2) {
+                _headerExtra |= consume() << (8 * _headerExtraLength++);
+                continue;
+            }
+            size_t skip = std::min<size_t>(len, _headerExtra);
+            data += skip;
+            len -= skip;
+            _headerExtra -= skip;
+            if (_headerExtra == 0) { _headerFlags &= ~GZIP_FEXTRA; }
+        } else if (_headerFlags & GZIP_FNAME) {
+            if (consume() == 0) { _headerFlags &= ~GZIP_FNAME; }
+        } else if (_headerFlags & GZIP_FCOMMENT) {
+            if (consume() == 0) { _headerFlags &= ~GZIP_FCOMMENT; }
+        } else if (_headerCrc > 0) {
+            consume();
+            --_headerCrc;
+        } else {
+            _headerDone = true;
+        }
+    }
+
+    return true;
+}
+
+bool FirmwareUpdaterClass::inflate(uint8_t* data, size_t len)
+{
+    while (!_inflateDone) {
+        size_t inSize = len;
+        size_t outSize = DictionarySize - _dictionaryOffset;
+        tinfl_status status = tinfl_decompress(_inflator, data, &inSize,
+                _dictionary, _dictionary + _dictionaryOffset, &outSize,
+                TINFL_FLAG_HAS_MORE_INPUT);
+        data += inSize;
+        len -= inSize;
+
+        if (outSize > 0) {
+            if (!writeFlash(_dictionary + _dictionaryOffset, outSize)) { return false; }
+            _inflatedSize += outSize;
+            // the dictionary is a ring, the decompressor refers back into it
+            _dictionaryOffset = (_dictionaryOffset + outSize) & (DictionarySize - 1);
+        }
+
+        if (status < TINFL_STATUS_DONE) {
+            fail("Invalid compressed data");
+            return false;
+        }
+
+        if (status == TINFL_STATUS_DONE) {
+            _inflateDone = true;
+        } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0) {
+            return true;
+        }
+    }
+
+    // the remaining data is the trailer with the CRC and the size
+    size_t trailer = std::min<size_t>(len, sizeof(_trailer) - _trailerLength);
+    memcpy(_trailer + _trailerLength, data, trailer);
+    _trailerLength += trailer;
+    return true;
+}
+
+bool FirmwareUpdaterClass::writeFlash(uint8_t* data, size_t len)
+{
+    if (Update.write(data, len) != len) {
+        fail(Update.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool FirmwareUpdaterClass::finish()
+{
+    if (_format == Format::Gzip) {
+        if (!_inflateDone || _trailerLength < sizeof(_trailer)) {
+            fail("Compressed image is truncated");
+            return false;
+        }
+
+        // the image itself is verified by the MD5 and by the bootloader's
+        // checksum, so only the size is compared here
+        uint32_t size = _trailer[4] | (_trailer[5] << 8) | (_trailer[6] << 16) | (static_cast<uint32_t>(_trailer[7]) << 24);
+        if (size != _inflatedSize) {
+            fail("Size of the inflated image does not match");
+            return false;
+        }
+    }
+
+    // the MD5 refers to the uploaded file, which may be compressed
+    _md5.calculate();
+    if (!_md5.toString().equalsIgnoreCase(_expectedMd5)) {
+        fail("MD5 mismatch");
+        return false;
+    }
+
+    if (!Update.end(true)) { // true to set the size to the current progress
+        Update.printError(Serial);
+        fail(Update.errorString());
+        return false;
+    }
+
+    MessageOutput.printf("[FirmwareUpdater] Update finished, %u bytes written\r\n", Update.progress());
+    return true;
+}
+
+void FirmwareUpdaterClass::fail(char const* error)
+{
+    char const* expected = nullptr;
+    if (_error.compare_exchange_strong(expected, error)) {
+        MessageOutput.printf("[FirmwareUpdater] %s\r\n", error);
+    }
+}
+
+void FirmwareUpdaterClass::release()
+{
+    if (_stream != nullptr) {
+        vStreamBufferDelete(_stream);
+        _stream = nullptr;
+    }
+    free(_streamStorage);
+    _streamStorage = nullptr;
+    free(_chunk);
+    _chunk = nullptr;
+    free(_inflator);
+    _inflator = nullptr;
+    free(_dictionary);
+    _dictionary = nullptr;
+    _running = false;
+}
@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "HeapMonitor.h"
+#include "TaskProfiler.h"
+#include <esp_heap_caps.h>
+#include <cstring>
+
+HeapMonitorClass HeapMonitor;
+
+// the innermost scope of the task executing the code
+static thread_local HeapMonitorClass::Scope* tCurrentScope = nullptr;
+static thread_local HeapMonitorClass::Tag* tCurrentTag = nullptr;
+
+static size_t getFreeInternal()
+{
+    return heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+}
+
+HeapMonitorClass::HeapMonitorClass()
+    : _loopTask(1 * TASK_MINUTE, TASK_FOREVER, TaskProfiler.wrap("HeapMonitor::loop", std::bind(&HeapMonitorClass::loop, this)))
+{
+}
+
+void HeapMonitorClass::init(Scheduler& scheduler)
+{
+    _pUntagged = getTag("untagged");
+
+    heap_caps_register_failed_alloc_callback(&HeapMonitorClass::onAllocFailed);
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+HeapMonitorClass::Scope::Scope(Tag* pTag)
+    : _pTag(pTag)
+    , _pParent(tCurrentScope)
+    , _freeAtEntry(getFreeInternal())
+{
+    if (_pTag == nullptr) { return; }
+    ++_pTag->Scopes;
+    tCurrentScope = this;
+    tCurrentTag = _pTag;
+}
+
+HeapMonitorClass::Scope::~Scope()
+{
+    if (_pTag == nullptr) { return; }
+
+    int32_t bytes = static_cast<int32_t>(_freeAtEntry) - static_cast<int32_t>(getFreeInternal());
+    _pTag->NetBytes += bytes - _childBytes;
+
+    tCurrentScope = _pParent;
+    tCurrentTag = (_pParent != nullptr) ? _pParent->_pTag : nullptr;
+    if (_pParent != nullptr) { _pParent->_childBytes += bytes; }
+}
+
+HeapMonitorClass::Tag* HeapMonitorClass::getTag(char const* name)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    size_t count = _tagCount;
+    for (size_t i = 0; i < count; ++i) {
+        if (strcmp(_tags[i].Name, name) == 0) { return &_tags[i]; }
+    }
+
+    if (count >= _tags.size()) { return nullptr; }
+
+    _tags[count].Name = name;
+    _tagCount = count + 1;
+    return &_tags[count];
+}
+
+void HeapMonitorClass::onAllocFailed(size_t size, uint32_t caps, char const* functionName)
+{
+    // must not allocate memory, so nothing is logged here
+    auto pTag = (tCurrentTag != nullptr) ? tCurrentTag : HeapMonitor._pUntagged;
+    if (pTag == nullptr) { return; }
+    ++pTag->FailedAllocs;
+    pTag->FailedBytes += size;
+}
+
+void HeapMonitorClass::loop()
+{
+    size_t count = _tagCount;
+    for (size_t i = 0; i < count; ++i) {
+        auto& tag = _tags[i];
+        int32_t net = tag.NetBytes;
+        tag.BytesPerMinute = net - tag.LastMinuteNetBytes;
+        tag.LastMinuteNetBytes = net;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint8_t sample = getFragmentation();
+    if (_historyCount < _history.size()) {
+        _history[(_historyHead + _historyCount++) % _history.size()] = sample;
+    } else {
+        _history[_historyHead] = sample;
+        _historyHead = (_historyHead + 1) % _history.size();
+    }
+}
+
+std::vector<HeapMonitorClass::TagStats> HeapMonitorClass::getTagStats() const
+{
+    std::vector<TagStats> result;
+    size_t count = _tagCount;
+    result.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        auto const& tag = _tags[i];
+        result.push_back({ tag.Name, tag.Scopes, tag.NetBytes, tag.BytesPerMinute,
+            tag.FailedAllocs, tag.FailedBytes });
+    }
+
+    return result;
+}
+
+uint8_t HeapMonitorClass::getFragmentation() const
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_INTERNAL);
+    if (info.total_free_bytes == 0) { return 0; }
+    return 100 - (info.largest_free_block * 100 / info.total_free_bytes);
+}
+
+std::vector<uint8_t> HeapMonitorClass::getFragmentationHistory() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<uint8_t> result;
+    result.reserve(_historyCount);
+    for (size_t i = 0; i < _historyCount; ++i) {
+        result.push_back(_history[(_historyHead + i) % _history.size()]);
+    }
+    return result;
+}
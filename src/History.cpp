@@ -0,0 +1,410 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "History.h"
+#include "MessageOutput.h"
+#include "PowerLimiter.h"
+#include <battery/Controller.h>
+#include <Hoymiles.h>
+#include <LittleFS.h>
+#include <powermeter/Controller.h>
+#include "MemoryPolicy.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include "TaskProfiler.h"
+
+#define HISTORY_FILENAME "/history.bin"
+#define HISTORY_OLD_FILENAME "/history.old"
+
+HistoryClass History;
+
+// the minute rollups are persisted in two files of up to twelve hourly
+// blocks each, such that the last 12 to 24 hours survive a restart.
+static constexpr size_t PERSISTED_BLOCKS_PER_FILE = 12;
+
+struct HistoryFileHeader {
+    uint32_t Magic;
+    uint16_t SeriesCount;
+    uint16_t BlockSize;
+};
+
+static constexpr uint32_t HISTORY_FILE_MAGIC = 0x48495354; // "HIST"
+
+HistoryClass::HistoryClass()
+    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("History::loop", std::bind(&HistoryClass::loop, this)))
+{
+}
+
+void HistoryClass::init(Scheduler& scheduler)
+{
+    // one block holds ten minutes of raw samples or one hour of minute
+    // rollups and uses about 2 kB of memory.
+    bool psram = psramFound();
+    size_t rawBlocks = psram ? 144 : 3;
+    size_t minuteBlocks = psram ? 24 : 6;
+
+    if (!_raw.allocate(rawBlocks, RAW_INTERVAL_S) || !_minute.allocate(minuteBlocks, MINUTE_INTERVAL_S)) {
+        MessageOutput.println("[History] Failed to allocate memory");
+        return;
+    }
+
+    MessageOutput.printf("[History] Using %u bytes of %s\r\n",
+        static_cast<unsigned>((rawBlocks + minuteBlocks) * sizeof(Block)), (psram ? "PSRAM" : "RAM"));
+
+    _minuteSums.fill(0);
+    _minuteCounts.fill(0);
+
+    restore();
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+float HistoryClass::getScale(size_t series)
+{
+    switch (static_cast<Series>(series)) {
+    case Series::BatterySoC:
+        return 0.1;
+    case Series::BatteryVoltage:
+    case Series::BatteryCurrent:
+        return 0.01;
+    default:
+        return 1.0;
+    }
+}
+
+uint8_t HistoryClass::getDecimals(size_t series)
+{
+    switch (static_cast<Series>(series)) {
+    case Series::BatterySoC:
+        return 1;
+    case Series::BatteryVoltage:
+    case Series::BatteryCurrent:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+uint16_t HistoryClass::getInterval(Resolution resolution) const
+{
+    return (resolution == Resolution::Raw) ? _raw.getInterval() : _minute.getInterval();
+}
+
+void HistoryClass::loop()
+{
+    // samples are only useful with a wall clock timestamp
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo, 5)) {
+        return;
+    }
+
+    uint32_t now = time(nullptr);
+    uint32_t timestamp = now - (now % RAW_INTERVAL_S);
+    if (timestamp == _lastSample) {
+        return;
+    }
+
+    _lastSample = timestamp;
+    sample(timestamp);
+}
+
+void HistoryClass::sample(uint32_t timestamp)
+{
+    values_t values;
+    values.fill(NO_VALUE);
+
+    auto set = [&values](size_t series, float value) {
+        values[series] = static_cast<int32_t>(lroundf(value / getScale(series)));
+    };
+
+    auto const& config = Configuration.get();
+
+    if (config.Battery.Enabled) {
+        auto spStats = Battery.getStats();
+        if (spStats->isSoCValid()) {
+            set(static_cast<size_t>(Series::BatterySoC), spStats->getSoC());
+        }
+        if (spStats->isVoltageValid()) {
+            set(static_cast<size_t>(Series::BatteryVoltage), spStats->getVoltage());
+        }
+        if (spStats->isCurrentValid()) {
+            set(static_cast<size_t>(Series::BatteryCurrent), spStats->getChargeCurrent());
+        }
+    }
+
+    if (config.PowerMeter.Enabled && PowerMeter.isDataValid()) {
+        set(static_cast<size_t>(Series::PowerMeterTotal), PowerMeter.getPowerTotal());
+    }
+
+    if (config.PowerLimiter.Enabled) {
+        set(static_cast<size_t>(Series::PowerLimiterTarget), PowerLimiter.getInverterOutput());
+    }
+
+    for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
+        if (config.Inverter[i].Serial == 0) {
+            continue;
+        }
+
+        auto inv = Hoymiles.getInverterBySerial(config.Inverter[i].Serial);
+        if (inv == nullptr || !inv->isReachable()) {
+            continue;
+        }
+
+        set(static_cast<size_t>(Series::InverterAcPower) + i,
+            inv->Statistics()->getChannelFieldValue(TYPE_AC, CH0, FLD_PAC));
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _raw.append(timestamp, values);
+
+    uint32_t minute = timestamp - (timestamp % MINUTE_INTERVAL_S);
+    if (_currentMinute != 0 && minute != _currentMinute) {
+        rollup(_currentMinute);
+    }
+    _currentMinute = minute;
+
+    for (size_t s = 0; s < SERIES_COUNT; ++s) {
+        if (values[s] == NO_VALUE) {
+            continue;
+        }
+        _minuteSums[s] += values[s];
+        _minuteCounts[s]++;
+    }
+}
+
+void HistoryClass::rollup(uint32_t minute)
+{
+    values_t values;
+
+    for (size_t s = 0; s < SERIES_COUNT; ++s) {
+        if (_minuteCounts[s] == 0) {
+            values[s] = NO_VALUE;
+        } else {
+            values[s] = static_cast<int32_t>(std::llround(static_cast<double>(_minuteSums[s]) / _minuteCounts[s]));
+        }
+    }
+
+    _minuteSums.fill(0);
+    _minuteCounts.fill(0);
+
+    auto pCompleted = _minute.append(minute, values);
+    if (pCompleted != nullptr) {
+        persist(*pCompleted);
+    }
+}
+
+size_t HistoryClass::query(size_t series, Resolution resolution, uint32_t from, uint32_t to,
+    size_t maxSamples, SampleCallback const& callback)
+{
+    if (series >= SERIES_COUNT) {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto const& tier = (resolution == Resolution::Raw) ? _raw : _minute;
+    return tier.query(series, from, to, maxSamples, callback, getScale(series));
+}
+
+void HistoryClass::persist(Block const& block)
+{
+    if (LittleFS.totalBytes() - LittleFS.usedBytes() < 4 * sizeof(Block)) {
+        MessageOutput.println("[History] Not enough space left to persist minute rollups");
+        return;
+    }
+
+    File f = LittleFS.open(HISTORY_FILENAME, "a");
+    if (!f) {
+        return;
+    }
+
+    if (f.size() == 0) {
+        HistoryFileHeader header = { HISTORY_FILE_MAGIC, SERIES_COUNT, sizeof(Block) };
+        f.write(reinterpret_cast<uint8_t const*>(&header), sizeof(header));
+    }
+
+    f.write(reinterpret_cast<uint8_t const*>(&block), sizeof(block));
+    size_t blocks = (f.size() - sizeof(HistoryFileHeader)) / sizeof(Block);
+    f.close();
+
+    if (blocks >= PERSISTED_BLOCKS_PER_FILE) {
+        LittleFS.remove(HISTORY_OLD_FILENAME);
+        LittleFS.rename(HISTORY_FILENAME, HISTORY_OLD_FILENAME);
+    }
+}
+
+void HistoryClass::restore()
+{
+    auto upBlock = std::make_unique<Block>();
+
+    for (auto const name : { HISTORY_OLD_FILENAME, HISTORY_FILENAME }) {
+        File f = LittleFS.open(name, "r", false);
+        if (!f) {
+            continue;
+        }
+
+        HistoryFileHeader header;
+        if (f.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) != sizeof(header)
+            || header.Magic != HISTORY_FILE_MAGIC
+            || header.SeriesCount != SERIES_COUNT
+            || header.BlockSize != sizeof(Block)) {
+            MessageOutput.printf("[History] Discarding incompatible file %s\r\n", name);
+            f.close();
+            LittleFS.remove(name);
+            continue;
+        }
+
+        while (f.read(reinterpret_cast<uint8_t*>(upBlock.get()), sizeof(Block)) == sizeof(Block)) {
+            _minute.restore(*upBlock);
+        }
+    }
+}
+
+bool HistoryClass::Tier::allocate(size_t capacity, uint16_t interval)
+{
+    size_t size = capacity * sizeof(Block);
+
+    _blocks = static_cast<Block*>(MemoryPolicy::allocateLarge(size));
+
+    if (_blocks == nullptr) {
+        return false;
+    }
+
+    _capacity = capacity;
+    _interval = interval;
+    _reference.fill(NO_VALUE);
+    return true;
+}
+
+HistoryClass::Block* HistoryClass::Tier::startBlock(uint32_t timestamp, values_t const& values)
+{
+    if (_size > 0) {
+        _head = (_head + 1) % _capacity;
+    }
+    _size = std::min(_size + 1, _capacity);
+
+    Block* block = &_blocks[_head];
+    block->Start = timestamp;
+    block->Interval = _interval;
+    block->Count = 1;
+    for (size_t s = 0; s < SERIES_COUNT; ++s) {
+        block->Base[s] = values[s];
+    }
+
+    _reference = values;
+    return block;
+}
+
+HistoryClass::Block const* HistoryClass::Tier::append(uint32_t timestamp, values_t const& values)
+{
+    if (_blocks == nullptr) {
+        return nullptr;
+    }
+
+    Block* block = (_size > 0) ? &_blocks[_head] : nullptr;
+
+    bool fits = block != nullptr
+        && block->Count < SAMPLES_PER_BLOCK
+        && timestamp == block->Start + block->Count * _interval;
+
+    std::array<int16_t, SERIES_COUNT> deltas;
+    for (size_t s = 0; fits && s < SERIES_COUNT; ++s) {
+        if (values[s] == NO_VALUE) {
+            deltas[s] = NO_DELTA;
+            continue;
+        }
+
+        // the series has no reference value in this block yet, or the
+        // difference cannot be represented: start over with a new block.
+        if (_reference[s] == NO_VALUE) {
+            fits = false;
+            break;
+        }
+
+        int64_t delta = static_cast<int64_t>(values[s]) - _reference[s];
+        if (delta <= NO_DELTA || delta > INT16_MAX) {
+            fits = false;
+            break;
+        }
+
+        deltas[s] = static_cast<int16_t>(delta);
+    }
+
+    if (!fits) {
+        // the completed block stays valid until the next block is started
+        // in its place, i.e., for at least one more append() call.
+        startBlock(timestamp, values);
+        return (_capacity > 1) ? block : nullptr;
+    }
+
+    for (size_t s = 0; s < SERIES_COUNT; ++s) {
+        block->Deltas[block->Count - 1][s] = deltas[s];
+        if (deltas[s] != NO_DELTA) {
+            _reference[s] = values[s];
+        }
+    }
+
+    block->Count++;
+    return nullptr;
+}
+
+void HistoryClass::Tier::restore(Block const& block)
+{
+    if (_blocks == nullptr || block.Count == 0 || block.Count > SAMPLES_PER_BLOCK) {
+        return;
+    }
+
+    values_t values;
+    for (size_t s = 0; s < SERIES_COUNT; ++s) {
+        values[s] = block.Base[s];
+    }
+
+    // restored blocks are never continued, as the block that was in
+    // progress when restarting was lost, i.e., new samples are never
+    // contiguous with the last restored block.
+    Block* target = startBlock(block.Start, values);
+    memcpy(target, &block, sizeof(Block));
+}
+
+size_t HistoryClass::Tier::query(size_t series, uint32_t from, uint32_t to,
+    size_t maxSamples, SampleCallback const& callback, float scale) const
+{
+    size_t count = 0;
+
+    for (size_t b = 0; b < _size && count < maxSamples; ++b) {
+        Block const& block = _blocks[(_head + _capacity - _size + 1 + b) % _capacity];
+
+        uint32_t end = block.Start + (block.Count - 1) * block.Interval;
+        if (end < from) {
+            continue;
+        }
+        if (block.Start > to) {
+            break;
+        }
+
+        int32_t value = block.Base[series];
+        for (uint8_t i = 0; i < block.Count && count < maxSamples; ++i) {
+            bool valid = (i == 0) ? (value != NO_VALUE) : (block.Deltas[i - 1][series] != NO_DELTA);
+            if (i > 0 && valid) {
+                value += block.Deltas[i - 1][series];
+            }
+
+            uint32_t timestamp = block.Start + i * block.Interval;
+            if (timestamp < from) {
+                continue;
+            }
+            if (timestamp > to) {
+                return count;
+            }
+
+            callback(timestamp, valid ? std::optional<float>(value * scale) : std::nullopt);
+            count++;
+        }
+    }
+
+    return count;
+}
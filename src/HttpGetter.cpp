@@ -1,10 +1,72 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include "HttpGetter.h"
+#include "NetworkSettings.h"
+#include "NtpSettings.h"
 #include <WiFiClientSecure.h>
 #include "mbedtls/sha256.h"
 #include "mbedtls/md5.h"
 #include <base64.h>
 #include <ESPmDNS.h>
+#include <array>
+#include <mutex>
+
+namespace {
+
+struct CachedHost {
+    String Host;
+    IPAddress Address = INADDR_NONE;
+    uint32_t ResolvedAt = 0;
+};
+
+constexpr size_t hostCacheSize = 4;
+constexpr uint32_t hostCacheTtlMillis = 10 * 60 * 1000;
+
+std::mutex hostCacheMutex;
+std::array<CachedHost, hostCacheSize> hostCache;
+
+// the getters run in different tasks, so the cache is guarded by a mutex.
+// the (slow) name resolution itself happens without holding it.
+std::pair<IPAddress, uint32_t> lookupCachedHost(String const& host)
+{
+    std::lock_guard<std::mutex> lock(hostCacheMutex);
+    for (auto const& entry : hostCache) {
+        if (entry.Address == INADDR_NONE || entry.Host != host) { continue; }
+        if (millis() - entry.ResolvedAt >= hostCacheTtlMillis) { break; }
+        return { entry.Address, entry.ResolvedAt };
+    }
+    return { INADDR_NONE, 0 };
+}
+
+void storeCachedHost(String const& host, IPAddress const& address, uint32_t resolvedAt)
+{
+    std::lock_guard<std::mutex> lock(hostCacheMutex);
+
+    auto age = [](CachedHost const& entry) -> uint32_t {
+        if (entry.Address == INADDR_NONE) { return UINT32_MAX; }
+        return millis() - entry.ResolvedAt;
+    };
+
+    // replaces the entry of this host, an empty one, or the oldest one
+    CachedHost* pSlot = &hostCache.front();
+    for (auto& entry : hostCache) {
+        if (entry.Host == host) { pSlot = &entry; break; }
+        if (age(entry) > age(*pSlot)) { pSlot = &entry; }
+    }
+
+    pSlot->Host = host;
+    pSlot->Address = address;
+    pSlot->ResolvedAt = resolvedAt;
+}
+
+void forgetCachedHost(String const& host)
+{
+    std::lock_guard<std::mutex> lock(hostCacheMutex);
+    for (auto& entry : hostCache) {
+        if (entry.Host == host) { entry.Address = INADDR_NONE; }
+    }
+}
+
+} // namespace
 
 template<typename... Args>
 void HttpGetter::logError(char const* format, Args... args) {
@@ -73,11 +135,38 @@ bool HttpGetter::init()
         _spWiFiClient = std::make_shared<WiFiClient>();
     }
 
+    _upHttpClient = std::make_unique<HttpGetterClient>();
+
+    // use HTTP1.0 to avoid problems with chunked transfer encoding when the
+    // stream is later used to read the server's response. "Connection:
+    // keep-alive" is sent nevertheless, so the TCP connection (and the TLS
+    // session) can be reused by the next request if the server agrees.
+    _upHttpClient->useHTTP10(true);
+    _upHttpClient->setReuse(true);
+    _upHttpClient->setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+    _upHttpClient->setUserAgent("OpenDTU-OnBattery");
+    _upHttpClient->setConnectTimeout(_config.Timeout);
+    _upHttpClient->setTimeout(_config.Timeout);
+
+    const char *headers[3] = {"WWW-Authenticate", "Connection", "Date"};
+    _upHttpClient->collectHeaders(headers, 3);
+
     return true;
 }
 
-HttpRequestResult HttpGetter::performGetRequest()
+bool HttpGetter::resolveHost()
 {
+    if (_ipAddress != INADDR_NONE && millis() - _resolvedAt < hostCacheTtlMillis) {
+        return true;
+    }
+
+    auto cached = lookupCachedHost(_host);
+    if (cached.first != INADDR_NONE) {
+        _ipAddress = cached.first;
+        _resolvedAt = cached.second;
+        return true;
+    }
+
     // hostByName in WiFiGeneric fails to resolve local names. issue described at
     // https://github.com/espressif/arduino-esp32/issues/3822 and in analyzed in
     // depth at https://github.com/espressif/esp-idf/issues/2507#issuecomment-761836300
@@ -97,32 +186,33 @@ HttpRequestResult HttpGetter::performGetRequest()
 
         if (ipaddr == INADDR_NONE && !WiFiGenericClass::hostByName(_host.c_str(), ipaddr)) {
             logError("failed to resolve host '%s' via DNS", _host.c_str());
-            return { false };
+            return false;
         }
     }
 
-    auto upTmpHttpClient = std::make_unique<HttpGetterClient>();
+    _ipAddress = ipaddr;
+    _resolvedAt = millis();
+    storeCachedHost(_host, _ipAddress, _resolvedAt);
+    return true;
+}
 
-    // use HTTP1.0 to avoid problems with chunked transfer encoding when the
-    // stream is later used to read the server's response.
-    upTmpHttpClient->useHTTP10(true);
+HttpRequestResult HttpGetter::performGetRequest()
+{
+    if (!resolveHost()) { return { false }; }
 
-    if (!upTmpHttpClient->begin(*_spWiFiClient, ipaddr.toString(), _port, _uri, _useHttps)) {
+    // (re-)setting the connection parameters keeps an open TCP connection
+    if (!_upHttpClient->begin(*_spWiFiClient, _ipAddress.toString(), _port, _uri, _useHttps)) {
         logError("HTTP client begin() failed for %s://%s",
                 (_useHttps ? "https" : "http"), _host.c_str());
         return { false };
     }
 
-    upTmpHttpClient->setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-    upTmpHttpClient->setUserAgent("OpenDTU-OnBattery");
-    upTmpHttpClient->setConnectTimeout(_config.Timeout);
-    upTmpHttpClient->setTimeout(_config.Timeout);
     for (auto const& h : _additionalHeaders) {
-        upTmpHttpClient->addHeader(h.first.c_str(), h.second.c_str());
+        _upHttpClient->addHeader(h.first.c_str(), h.second.c_str());
     }
 
     if (strlen(_config.HeaderKey) > 0) {
-        upTmpHttpClient->addHeader(_config.HeaderKey, _config.HeaderValue);
+        _upHttpClient->addHeader(_config.HeaderKey, _config.HeaderValue);
     }
 
     using Auth_t = HttpRequestConfig::Auth;
@@ -132,18 +222,10 @@ HttpRequestResult HttpGetter::performGetRequest()
         case Auth_t::Basic: {
             String credentials = String(_config.Username) + ":" + _config.Password;
             String authorization = "Basic " + base64::encode(credentials);
-            upTmpHttpClient->addHeader("Authorization", authorization);
+            _upHttpClient->addHeader("Authorization", authorization);
             break;
         }
         case Auth_t::Digest: {
-            // send "Connection: keep-alive" (despite using HTTP/1.0, where
-            // "Connection: close" is the default) so there is a chance to
-            // reuse the TCP connection when performing the second GET request.
-            upTmpHttpClient->setReuse(true);
-
-            const char *headers[2] = {"WWW-Authenticate", "Connection"};
-            upTmpHttpClient->collectHeaders(headers, 2);
-
             // try with new auth response based on previous WWW-Authenticate
             // header, which allows us to retrieve the resource without a
             // second GET request. if the server decides that we reused the
@@ -151,59 +233,85 @@ HttpRequestResult HttpGetter::performGetRequest()
             // a new challenge, which we handle as if we had no challenge yet.
             auto authorization = getAuthDigest();
             if (authorization.first) {
-                upTmpHttpClient->addHeader("Authorization", authorization.second);
+                _upHttpClient->addHeader("Authorization", authorization.second);
             }
             break;
         }
     }
 
-    int httpCode = upTmpHttpClient->GET();
+    // an idle connection opened before a failover uses the previous
+    // interface, which might be gone. it would only fail after a timeout.
+    uint32_t routeGeneration = NetworkSettings.getRouteGeneration();
+    if (routeGeneration != _routeGeneration) {
+        _routeGeneration = routeGeneration;
+        _spWiFiClient->stop();
+    }
+
+    bool reused = _spWiFiClient->connected();
+
+    int httpCode = _upHttpClient->GET();
+
+    if (httpCode <= 0 && reused) {
+        // the server may have closed the idle connection in the meantime.
+        // retry once using a new TCP connection.
+        _spWiFiClient->stop();
+        httpCode = _upHttpClient->GET();
+    }
 
     if (httpCode == HTTP_CODE_UNAUTHORIZED && _config.AuthType == Auth_t::Digest) {
-        _wwwAuthenticate = "";
+        _digest.Valid = false;
 
-        if (!upTmpHttpClient->hasHeader("WWW-Authenticate")) {
+        if (!_upHttpClient->hasHeader("WWW-Authenticate")) {
             logError("Cannot perform digest authentication as server did "
                         "not send a WWW-Authenticate header");
-            return { false };
+            return { false, _upHttpClient.get() };
         }
 
-        _wwwAuthenticate = upTmpHttpClient->header("WWW-Authenticate");
-
-        // using a new WWW-Authenticate challenge means
-        // we never used the server's nonce in a response
-        _nonceCounter = 0;
+        auto parsed = parseChallenge(_upHttpClient->header("WWW-Authenticate"));
+        if (!parsed.first) {
+            logError("Digest Error: %s", parsed.second.c_str());
+            return { false, _upHttpClient.get() };
+        }
 
         auto authorization = getAuthDigest();
         if (!authorization.first) {
             logError("Digest Error: %s", authorization.second.c_str());
-            return { false };
+            return { false, _upHttpClient.get() };
         }
-        upTmpHttpClient->addHeader("Authorization", authorization.second);
+        _upHttpClient->addHeader("Authorization", authorization.second);
 
         // use a new TCP connection if the server sent "Connection: close".
         bool restart = true;
-        if (upTmpHttpClient->hasHeader("Connection")) {
-            String connection = upTmpHttpClient->header("Connection");
+        if (_upHttpClient->hasHeader("Connection")) {
+            String connection = _upHttpClient->header("Connection");
             connection.toLowerCase();
             restart = connection.indexOf("keep-alive") == -1;
         }
-        if (restart) { upTmpHttpClient->restartTCP(); }
+        if (restart) { _upHttpClient->restartTCP(); }
 
-        httpCode = upTmpHttpClient->GET();
+        httpCode = _upHttpClient->GET();
     }
 
     if (httpCode <= 0) {
-        logError("HTTP Error: %s", upTmpHttpClient->errorToString(httpCode).c_str());
+        logError("HTTP Error: %s", _upHttpClient->errorToString(httpCode).c_str());
+
+        // the host might have changed its address
+        _ipAddress = INADDR_NONE;
+        forgetCachedHost(_host);
+        _spWiFiClient->stop();
         return { false };
     }
 
     if (httpCode != HTTP_CODE_OK) {
         logError("Bad HTTP code: %d", httpCode);
-        return { false };
+        return { false, _upHttpClient.get() };
     }
 
-    return { true, std::move(upTmpHttpClient), _spWiFiClient };
+    if (_upHttpClient->hasHeader("Date")) {
+        NtpSettings.setTimeFromHttpDate(_upHttpClient->header("Date").c_str());
+    }
+
+    return { true, _upHttpClient.get() };
 }
 
 template<size_t binLen>
@@ -275,30 +383,43 @@ static std::pair<bool, String> getAlgo(String const& authReq) {
     return { false, "unsupported digest algorithm" };
 }
 
-std::pair<bool, String> HttpGetter::getAuthDigest() {
-    if (_wwwAuthenticate.isEmpty()) { return { false, "no digest challenge yet" }; }
+std::pair<bool, String> HttpGetter::parseChallenge(String const& wwwAuthenticate) {
+    auto algo = getAlgo(wwwAuthenticate);
+    if (!algo.first) { return { false, algo.second }; }
 
     // extracting required parameters for RFC 2617 Digest
-    String realm = extractParam(_wwwAuthenticate, "realm=\"", '"');
-    String nonce = extractParam(_wwwAuthenticate, "nonce=\"", '"');
+    _digest.Realm = extractParam(wwwAuthenticate, "realm=\"", '"');
+    _digest.Nonce = extractParam(wwwAuthenticate, "nonce=\"", '"');
+    _digest.Algorithm = algo.second;
+
+    auto hash = (_digest.Algorithm == "SHA-256") ? &sha256 : &md5;
+    _digest.Ha1 = hash(String(_config.Username) + ":" + _digest.Realm + ":" + _config.Password);
+    _digest.Ha2 = hash("GET:" + _uri);
+    _digest.Valid = true;
+
+    // using a new WWW-Authenticate challenge means
+    // we never used the server's nonce in a response
+    _nonceCounter = 0;
+
+    return { true, "" };
+}
+
+std::pair<bool, String> HttpGetter::getAuthDigest() {
+    if (!_digest.Valid) { return { false, "no digest challenge yet" }; }
+
     String cNonce = getcNonce(8); // client nonce
 
     char nc[9];
     snprintf(nc, sizeof(nc), "%08x", ++_nonceCounter);
 
-    auto algo = getAlgo(_wwwAuthenticate);
-    if (!algo.first) { return { false, algo.second }; }
-
-    auto hash = (algo.second == "SHA-256") ? &sha256 : &md5;
-    String ha1 = hash(String(_config.Username) + ":" + realm + ":" + _config.Password);
-    String ha2 = hash("GET:" + _uri);
-    String response = hash(ha1 + ":" + nonce + ":" + String(nc) +
-            ":" + cNonce + ":" + "auth" + ":" + ha2);
+    auto hash = (_digest.Algorithm == "SHA-256") ? &sha256 : &md5;
+    String response = hash(_digest.Ha1 + ":" + _digest.Nonce + ":" + String(nc) +
+            ":" + cNonce + ":" + "auth" + ":" + _digest.Ha2);
 
     return { true, String("Digest username=\"") + _config.Username +
-        "\", realm=\"" + realm + "\", nonce=\"" + nonce + "\", uri=\"" +
+        "\", realm=\"" + _digest.Realm + "\", nonce=\"" + _digest.Nonce + "\", uri=\"" +
         _uri + "\", cnonce=\"" + cNonce + "\", nc=" + nc +
-        ", qop=auth, response=\"" + response  + "\", algorithm=" + algo.second };
+        ", qop=auth, response=\"" + response  + "\", algorithm=" + _digest.Algorithm };
 }
 
 void HttpGetter::addHeader(char const* key, char const* value)
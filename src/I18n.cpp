@@ -3,30 +3,76 @@
  * Copyright (C) 2024 Thomas Basler and others
  */
 #include "I18n.h"
+#include "MemoryPolicy.h"
 #include "MessageOutput.h"
 #include "Utils.h"
 #include "defaults.h"
 #include <ArduinoJson.h>
 #include <LittleFS.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
 
 I18nClass I18n;
 
+namespace {
+
+constexpr uint32_t COMPILED_MAGIC = 0x4C4E4731; // "LNG1"
+constexpr uint8_t STRING_ABSENT = 0xFF;
+
+// the compiled file is valid as long as the source file is unchanged
+struct CompiledHeader {
+    uint32_t Magic;
+    uint32_t SourceSize;
+    uint32_t SourceLastWrite;
+    uint8_t Count;
+};
+
+enum LangPackString : size_t {
+    Code,
+    Name,
+    DisplayFirst
+};
+
+constexpr char const* displayKeys[] = {
+    "date_format",
+    "offline",
+    "power_w",
+    "power_kw",
+    "meter_power_w",
+    "meter_power_kw",
+    "yield_today_wh",
+    "yield_today_kwh",
+    "yield_total_kwh",
+    "yield_total_mwh"
+};
+
+constexpr size_t displayKeyCount = sizeof(displayKeys) / sizeof(displayKeys[0]);
+
+} // namespace
+
+static_assert(DisplayFirst + displayKeyCount == 12, "LangPackStringCount is outdated");
+
 I18nClass::I18nClass()
 {
 }
 
 void I18nClass::init(Scheduler& scheduler)
 {
-    readLangPacks();
 }
 
 std::list<LanguageInfo_t> I18nClass::getAvailableLanguages()
 {
+    std::lock_guard<std::mutex> lock(_mutex);
+    readLangPacks();
     return _availLanguages;
 }
 
-String I18nClass::getFilenameByLocale(const String& locale) const
+String I18nClass::getFilenameByLocale(const String& locale)
 {
+    std::lock_guard<std::mutex> lock(_mutex);
+    readLangPacks();
+
     auto it = std::find_if(_availLanguages.begin(), _availLanguages.end(), [locale](const LanguageInfo_t& elem) {
         return elem.code == locale;
     });
@@ -52,116 +98,187 @@ void I18nClass::readDisplayStrings(
         return;
     }
 
-    JsonDocument filter;
-    filter["display"] = true;
-
-    File f = LittleFS.open(filename, "r", false);
-
-    JsonDocument doc;
-
-    // Deserialize the JSON document
-    const DeserializationError error = deserializeJson(doc, f, DeserializationOption::Filter(filter));
-    if (error) {
-        MessageOutput.printf("Failed to read file %s\r\n", filename.c_str());
-        f.close();
+    LangPack_t pack;
+    if (!loadLangPack(filename, pack)) {
         return;
     }
 
-    if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
-        return;
+    String* targets[] = {
+        &date_format, &offline, &power_w, &power_kw,
+        &meter_power_w, &meter_power_kw, &yield_today_wh, &yield_today_kwh,
+        &yield_total_kwh, &yield_total_mwh
+    };
+
+    for (size_t i = 0; i < displayKeyCount; i++) {
+        if (pack.Present[DisplayFirst + i]) {
+            *targets[i] = pack.Strings[DisplayFirst + i];
+        }
     }
+}
 
-    auto displayData = doc["display"];
+String I18nClass::getCompiledFilename(const String& file)
+{
+    return file.substring(0, file.length() - strlen(LANG_PACK_SUFFIX)) + LANG_PACK_COMPILED_SUFFIX;
+}
 
-    if (displayData["date_format"].as<String>() != "null") {
-        date_format = displayData["date_format"].as<String>();
+bool I18nClass::readCompiled(const String& file, LangPack_t& pack)
+{
+    File source = LittleFS.open(file, "r", false);
+    if (!source) {
+        return false;
     }
+    uint32_t sourceSize = source.size();
+    uint32_t sourceLastWrite = static_cast<uint32_t>(source.getLastWrite());
+    source.close();
 
-    if (displayData["offline"].as<String>() != "null") {
-        offline = displayData["offline"].as<String>();
+    File f = LittleFS.open(getCompiledFilename(file), "r", false);
+    if (!f) {
+        return false;
     }
 
-    if (displayData["power_w"].as<String>() != "null") {
-        power_w = displayData["power_w"].as<String>();
+    CompiledHeader header;
+    bool valid = f.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) == sizeof(header)
+        && header.Magic == COMPILED_MAGIC
+        && header.SourceSize == sourceSize
+        && header.SourceLastWrite == sourceLastWrite
+        && header.Count == LangPackStringCount;
+
+    char buffer[STRING_ABSENT];
+    for (size_t i = 0; valid && i < LangPackStringCount; i++) {
+        int len = f.read();
+        if (len < 0) {
+            valid = false;
+        } else if (len == STRING_ABSENT) {
+            pack.Present[i] = false;
+        } else if (f.read(reinterpret_cast<uint8_t*>(buffer), len) == static_cast<size_t>(len)) {
+            pack.Strings[i] = String(buffer, len);
+            pack.Present[i] = true;
+        } else {
+            valid = false;
+        }
     }
 
-    if (displayData["power_kw"].as<String>() != "null") {
-        power_kw = displayData["power_kw"].as<String>();
-    }
+    f.close();
+    return valid;
+}
 
-    if (displayData["meter_power_w"].as<String>() != "null") {
-        meter_power_w = displayData["meter_power_w"].as<String>();
-    }
+bool I18nClass::compile(const String& file, LangPack_t& pack)
+{
+    JsonDocument filter;
+    filter["meta"] = true;
+    filter["display"] = true;
+
+    File f = LittleFS.open(file, "r", false);
+
+    JsonDocument doc(MemoryPolicy::jsonAllocator());
 
-    if (displayData["meter_power_kw"].as<String>() != "null") {
-        meter_power_kw = displayData["meter_power_kw"].as<String>();
+    // Deserialize the JSON document
+    const DeserializationError error = deserializeJson(doc, f, DeserializationOption::Filter(filter));
+    uint32_t sourceSize = f.size();
+    uint32_t sourceLastWrite = static_cast<uint32_t>(f.getLastWrite());
+    f.close();
+
+    if (error) {
+        MessageOutput.printf("Failed to read file %s\r\n", file.c_str());
+        return false;
     }
 
-    if (displayData["yield_today_wh"].as<String>() != "null") {
-        yield_today_wh = displayData["yield_today_wh"].as<String>();
+    if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
+        return false;
     }
 
-    if (displayData["yield_today_kwh"].as<String>() != "null") {
-        yield_today_kwh = displayData["yield_today_kwh"].as<String>();
+    auto setString = [&pack](size_t idx, JsonVariantConst value) {
+        pack.Present[idx] = value.is<const char*>();
+        if (pack.Present[idx]) {
+            pack.Strings[idx] = value.as<String>();
+        }
+    };
+
+    setString(Code, doc["meta"]["code"]);
+    setString(Name, doc["meta"]["name"]);
+    for (size_t i = 0; i < displayKeyCount; i++) {
+        setString(DisplayFirst + i, doc["display"][displayKeys[i]]);
     }
 
-    if (displayData["yield_total_kwh"].as<String>() != "null") {
-        yield_total_kwh = displayData["yield_total_kwh"].as<String>();
+    MessageOutput.printf("Compiling %s\r\n", file.c_str());
+
+    File compiled = LittleFS.open(getCompiledFilename(file), "w");
+    if (!compiled) {
+        return true;
     }
 
-    if (displayData["yield_total_mwh"].as<String>() != "null") {
-        yield_total_mwh = displayData["yield_total_mwh"].as<String>();
+    CompiledHeader header = { COMPILED_MAGIC, sourceSize, sourceLastWrite, LangPackStringCount };
+    compiled.write(reinterpret_cast<uint8_t const*>(&header), sizeof(header));
+
+    for (size_t i = 0; i < LangPackStringCount; i++) {
+        if (!pack.Present[i]) {
+            compiled.write(STRING_ABSENT);
+            continue;
+        }
+
+        // the display strings are short, longer ones are truncated
+        uint8_t len = std::min<size_t>(pack.Strings[i].length(), STRING_ABSENT - 1);
+        compiled.write(len);
+        compiled.write(reinterpret_cast<uint8_t const*>(pack.Strings[i].c_str()), len);
     }
 
-    f.close();
+    compiled.close();
+    return true;
 }
 
+bool I18nClass::loadLangPack(const String& file, LangPack_t& pack)
+{
+    return readCompiled(file, pack) || compile(file, pack);
+}
+
+// must be called while holding the mutex
 void I18nClass::readLangPacks()
 {
+    if (_scanned) {
+        return;
+    }
+    _scanned = true;
+
+    std::vector<String> files;
+
     auto root = LittleFS.open("/");
     auto file = root.getNextFileName();
-
     while (file != "") {
-        if (file.endsWith(LANG_PACK_SUFFIX)) {
-            MessageOutput.printf("Read File %s\r\n", file.c_str());
-            readConfig(file);
-        }
+        files.push_back(file);
         file = root.getNextFileName();
     }
     root.close();
-}
 
-void I18nClass::readConfig(String file)
-{
-    JsonDocument filter;
-    filter["meta"] = true;
+    for (auto const& name : files) {
+        // compiled files of removed language packs are deleted
+        if (name.endsWith(LANG_PACK_COMPILED_SUFFIX)) {
+            auto source = name.substring(0, name.length() - strlen(LANG_PACK_COMPILED_SUFFIX)) + LANG_PACK_SUFFIX;
+            if (std::find(files.begin(), files.end(), source) == files.end()) {
+                LittleFS.remove(name);
+            }
+            continue;
+        }
 
-    File f = LittleFS.open(file, "r", false);
+        if (!name.endsWith(LANG_PACK_SUFFIX)) {
+            continue;
+        }
 
-    JsonDocument doc;
+        MessageOutput.printf("Read File %s\r\n", name.c_str());
 
-    // Deserialize the JSON document
-    const DeserializationError error = deserializeJson(doc, f, DeserializationOption::Filter(filter));
-    if (error) {
-        MessageOutput.printf("Failed to read file %s\r\n", file.c_str());
-        f.close();
-        return;
-    }
-
-    if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
-        return;
-    }
+        LangPack_t pack;
+        if (!loadLangPack(name, pack)) {
+            continue;
+        }
 
-    LanguageInfo_t lang;
-    lang.code = String(doc["meta"]["code"] | "");
-    lang.name = String(doc["meta"]["name"] | "");
-    lang.filename = file;
+        LanguageInfo_t lang;
+        lang.code = pack.Present[Code] ? pack.Strings[Code] : String();
+        lang.name = pack.Present[Name] ? pack.Strings[Name] : String();
+        lang.filename = name;
 
-    if (lang.code != "" && lang.name != "") {
-        _availLanguages.push_back(lang);
-    } else {
-        MessageOutput.printf("Invalid meta data\r\n");
+        if (lang.code != "" && lang.name != "") {
+            _availLanguages.push_back(lang);
+        } else {
+            MessageOutput.printf("Invalid meta data\r\n");
+        }
     }
-
-    f.close();
 }
@@ -0,0 +1,479 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "InfluxExporter.h"
+#include "Configuration.h"
+#include "MemoryPolicy.h"
+#include "MessageOutput.h"
+#include "NetworkSettings.h"
+#include "PowerLimiter.h"
+#include <TaskProfiler.h>
+#include <battery/Controller.h>
+#include <lwip/dns.h>
+#include <powermeter/Controller.h>
+#include <solarcharger/Controller.h>
+#include <WiFi.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+
+InfluxExporterClass InfluxExporter;
+
+namespace {
+
+// the same selection of fields as exported to Prometheus
+constexpr FieldId_t INVERTER_FIELDS[] = {
+    FLD_PAC,
+    FLD_UAC,
+    FLD_IAC,
+    FLD_PDC,
+    FLD_UDC,
+    FLD_IDC,
+    FLD_YD,
+    FLD_YT,
+    FLD_F,
+    FLD_T,
+    FLD_PF,
+    FLD_Q,
+    FLD_EFF,
+    FLD_IRR,
+};
+
+} // namespace
+
+InfluxExporterClass::InfluxExporterClass()
+    : _loopTask(TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("InfluxExporter::loop", std::bind(&InfluxExporterClass::loop, this)))
+{
+    // the AsyncTCP callbacks run in the async_tcp task
+    _client.onConnect([this](void*, AsyncClient*) {
+        _httpState = HttpState::Sending;
+        sendPending();
+    });
+    _client.onAck([this](void*, AsyncClient*, size_t, uint32_t) { sendPending(); });
+    _client.onData([](void*, AsyncClient* client, void* data, size_t len) {
+        // only the status line of the response is of interest
+        auto response = static_cast<char const*>(data);
+        if (len > 12 && strncmp(response, "HTTP/1.", 7) == 0 && response[9] != '2') {
+            MessageOutput.printf("[InfluxExporter] Server responded with status %.3s\r\n", response + 9);
+        }
+        client->close(true);
+    });
+    _client.onTimeout([](void*, AsyncClient* client, uint32_t) { client->close(true); });
+    _client.onDisconnect([this](void*, AsyncClient*) { _httpState = HttpState::Idle; });
+    _client.onError([this](void*, AsyncClient*, int8_t) { _httpState = HttpState::Idle; });
+}
+
+void InfluxExporterClass::init(Scheduler& scheduler)
+{
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+void InfluxExporterClass::updateSettings()
+{
+    auto const& config = Configuration.get().Influx;
+
+    _enabled = false;
+    _udp.stop();
+    _client.close(true);
+    _address = INADDR_NONE;
+    ++_dnsGeneration;
+
+    _loopTask.setInterval(std::max<uint32_t>(config.Interval, 1) * TASK_SECOND);
+
+    if (!config.Enabled) { return; }
+
+    _hostname = config.Hostname;
+    _port = config.Port;
+    _protocol = static_cast<Protocol>(config.Protocol);
+    _path = config.Path;
+    _token = config.Token;
+
+    if (_hostname.isEmpty()) {
+        MessageOutput.println("[InfluxExporter] Hostname not configured");
+        return;
+    }
+
+    if (_buffer == nullptr) {
+        _buffer = static_cast<char*>(MemoryPolicy::allocateLarge(BufferSize));
+        if (_buffer == nullptr) {
+            MessageOutput.println("[InfluxExporter] Failed to allocate buffer");
+            return;
+        }
+    }
+
+    // bind a random source port
+    if (_protocol == Protocol::Udp && !_udp.begin(0)) {
+        MessageOutput.println("[InfluxExporter] No sockets available");
+        return;
+    }
+
+    // the hostname is part of the inverters' prefixes
+    _inverters.clear();
+    _hostTag = escapeTag(NetworkSettings.getHostname().c_str());
+
+    MessageOutput.printf("[InfluxExporter] Exporting to %s:%u via %s every %" PRIu32 " s\r\n",
+            _hostname.c_str(), _port, (_protocol == Protocol::Http ? "HTTP" : "UDP"), config.Interval);
+
+    _lastResolve = millis() - ResolveIntervalMillis;
+    _enabled = true;
+}
+
+void InfluxExporterClass::onDnsFound(const char* name, const ip_addr_t* ipaddr, void* arg)
+{
+    // a newer lookup was started in the meantime
+    if (static_cast<uint32_t>(reinterpret_cast<uintptr_t>(arg)) != InfluxExporter._dnsGeneration) {
+        return;
+    }
+
+    if (ipaddr == nullptr) { return; }
+
+    InfluxExporter._dnsResult = ip_2_ip4(ipaddr)->addr;
+}
+
+void InfluxExporterClass::resolve()
+{
+    uint32_t result = _dnsResult.exchange(0);
+    if (result != 0) { _address = IPAddress(result); }
+
+    // the address is resolved again once in a while, as it might change
+    if (_address != INADDR_NONE && millis() - _lastResolve < ResolveIntervalMillis) { return; }
+    _lastResolve = millis();
+
+    IPAddress address;
+    if (address.fromString(_hostname)) {
+        _address = address;
+        return;
+    }
+
+    // does not block. the callback is invoked once the DNS server answered,
+    // unless the address was known already.
+    uint32_t generation = ++_dnsGeneration;
+    ip_addr_t cached;
+    err_t err = dns_gethostbyname_addrtype(_hostname.c_str(), &cached,
+            &InfluxExporterClass::onDnsFound, reinterpret_cast<void*>(static_cast<uintptr_t>(generation)),
+            LWIP_DNS_ADDRTYPE_IPV4);
+
+    if (err == ERR_OK) {
+        _address = IPAddress(ip_2_ip4(&cached)->addr);
+    } else if (err != ERR_INPROGRESS) {
+        MessageOutput.printf("[InfluxExporter] Failed to resolve %s\r\n", _hostname.c_str());
+    }
+}
+
+void InfluxExporterClass::loop()
+{
+    auto generation = Configuration.getGeneration();
+    if (generation != _configGeneration) {
+        _configGeneration = generation;
+        updateSettings();
+    }
+
+    if (!_enabled || !NetworkSettings.isConnected()) { return; }
+
+    resolve();
+    if (_address == INADDR_NONE) { return; }
+
+    if (_httpState != HttpState::Idle) {
+        MessageOutput.println("[InfluxExporter] Previous request is still pending");
+        return;
+    }
+
+    render();
+    if (_length == 0) { return; }
+
+    if (_protocol == Protocol::Http) {
+        sendHttp();
+    } else {
+        sendUdp();
+    }
+}
+
+String InfluxExporterClass::escapeTag(char const* value)
+{
+    String escaped;
+    escaped.reserve(strlen(value));
+    for (; *value != '\0'; ++value) {
+        if (*value == ',' || *value == '=' || *value == ' ') { escaped += '\\'; }
+        escaped += *value;
+    }
+    return escaped;
+}
+
+void InfluxExporterClass::print(char const* format, va_list args)
+{
+    if (_lineOverflow) { return; }
+
+    size_t available = BufferSize - _length;
+    int len = vsnprintf(_buffer + _length, available, format, args);
+    if (len < 0 || static_cast<size_t>(len) >= available) {
+        _lineOverflow = true;
+        return;
+    }
+
+    _length += len;
+}
+
+void InfluxExporterClass::append(char const* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    print(format, args);
+    va_end(args);
+}
+
+void InfluxExporterClass::beginLine(char const* format, ...)
+{
+    _lineStart = _length;
+    _lineFields = 0;
+    _lineOverflow = false;
+
+    va_list args;
+    va_start(args, format);
+    print(format, args);
+    va_end(args);
+}
+
+void InfluxExporterClass::addField(char const* key, char const* format, ...)
+{
+    // fields are separated from the tags by a space, and by commas from
+    // each other
+    append(_lineFields++ == 0 ? " %s=" : ",%s=", key);
+
+    va_list args;
+    va_start(args, format);
+    print(format, args);
+    va_end(args);
+}
+
+void InfluxExporterClass::endLine()
+{
+    // keep room for the newline
+    if (_lineOverflow || _lineFields == 0 || _length + 1 >= BufferSize) {
+        if (_lineFields > 0) { ++_droppedLines; }
+        _length = _lineStart;
+        return;
+    }
+
+    _buffer[_length++] = '\n';
+}
+
+void InfluxExporterClass::render()
+{
+    _length = 0;
+
+    renderSystem();
+    renderInverters();
+    renderBattery();
+    renderSolarCharger();
+    renderPowerMeter();
+    renderPowerLimiter();
+
+    if (_droppedLines > 0) {
+        MessageOutput.printf("[InfluxExporter] %" PRIu32 " lines did not fit the buffer\r\n", _droppedLines);
+        _droppedLines = 0;
+    }
+}
+
+void InfluxExporterClass::renderSystem()
+{
+    beginLine("opendtu_system,host=%s", _hostTag.c_str());
+    addField("uptime", "%lldi", esp_timer_get_time() / 1000000);
+    addField("free_heap", "%" PRIu32 "i", ESP.getFreeHeap());
+    addField("min_free_heap", "%" PRIu32 "i", ESP.getMinFreeHeap());
+    addField("biggest_heap_block", "%" PRIu32 "i", ESP.getMaxAllocHeap());
+    if (WiFi.isConnected()) {
+        addField("rssi", "%" PRId8 "i", WiFi.RSSI());
+    }
+    endLine();
+}
+
+void InfluxExporterClass::renderInverters()
+{
+    size_t count = Hoymiles.getNumInverters();
+    if (_inverters.size() > count) { _inverters.resize(count); }
+
+    for (uint8_t i = 0; i < count; i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) { continue; }
+
+        if (i >= _inverters.size()) { _inverters.push_back({ 0, "", "", 0 }); }
+        auto& tags = _inverters[i];
+
+        if (tags.Serial != inv->serial() || tags.Name != inv->name()) {
+            tags.Serial = inv->serial();
+            tags.Name = inv->name();
+            tags.Prefix = "opendtu_inverter,host=" + _hostTag + ",serial=" + inv->serialString() + ",name=" + escapeTag(inv->name());
+            tags.LastUpdate = 0;
+        }
+
+        beginLine("%s", tags.Prefix.c_str());
+        addField("reachable", "%s", inv->isReachable() ? "true" : "false");
+        addField("producing", "%s", inv->isProducing() ? "true" : "false");
+        addField("limit_relative", "%.1f", inv->SystemConfigPara()->getLimitPercent());
+        endLine();
+
+        auto stats = inv->Statistics();
+        uint32_t lastUpdate = stats->getLastUpdate();
+        if (lastUpdate == 0 || lastUpdate == tags.LastUpdate) { continue; }
+        tags.LastUpdate = lastUpdate;
+
+        for (auto& t : stats->getChannelTypes()) {
+            for (auto& c : stats->getChannelsByType(t)) {
+                beginLine("%s,type=%s,channel=%d", tags.Prefix.c_str(), stats->getChannelTypeName(t), c);
+                for (auto& f : INVERTER_FIELDS) {
+                    if (!stats->hasChannelFieldValue(t, c, f)) { continue; }
+
+                    const char* name = (t == TYPE_INV && f == FLD_PDC) ? "PowerDC" : stats->getChannelFieldName(t, c, f);
+                    addField(name, "%.*f", static_cast<int>(stats->getChannelFieldDigits(t, c, f)),
+                            stats->getChannelFieldValue(t, c, f));
+                }
+                endLine();
+            }
+        }
+    }
+}
+
+void InfluxExporterClass::renderBattery()
+{
+    if (!Configuration.get().Battery.Enabled) { return; }
+
+    auto spStats = Battery.getStats();
+
+    beginLine("opendtu_battery,host=%s", _hostTag.c_str());
+    if (spStats->isSoCValid()) {
+        addField("soc", "%.*f", spStats->getSoCPrecision(), spStats->getSoC());
+    }
+    if (spStats->isVoltageValid()) {
+        addField("voltage", "%.2f", spStats->getVoltage());
+    }
+    if (spStats->isCurrentValid()) {
+        addField("current", "%.*f", spStats->getChargeCurrentPrecision(), spStats->getChargeCurrent());
+    }
+    if (spStats->isVoltageValid() && spStats->isCurrentValid()) {
+        addField("power", "%.1f", spStats->getVoltage() * spStats->getChargeCurrent());
+    }
+    if (spStats->isDischargeCurrentLimitValid()) {
+        addField("discharge_current_limit", "%.2f", spStats->getDischargeCurrentLimit());
+    }
+    addField("data_age", "%" PRIu32 "i", spStats->getAgeSeconds());
+    endLine();
+}
+
+void InfluxExporterClass::renderSolarCharger()
+{
+    if (!Configuration.get().SolarCharger.Enabled) { return; }
+
+    auto spStats = SolarCharger.getStats();
+
+    beginLine("opendtu_solarcharger,host=%s", _hostTag.c_str());
+    if (auto outputPower = spStats->getOutputPowerWatts()) {
+        addField("output_power", "%.1f", *outputPower);
+    }
+    if (auto outputVoltage = spStats->getOutputVoltage()) {
+        addField("output_voltage", "%.2f", *outputVoltage);
+    }
+    if (auto panelPower = spStats->getPanelPowerWatts()) {
+        addField("panel_power", "%" PRIu16 "i", *panelPower);
+    }
+    if (auto yieldDay = spStats->getYieldDay()) {
+        addField("yield_day", "%.0f", *yieldDay);
+    }
+    if (auto yieldTotal = spStats->getYieldTotal()) {
+        addField("yield_total", "%.2f", *yieldTotal);
+    }
+    endLine();
+}
+
+void InfluxExporterClass::renderPowerMeter()
+{
+    if (!Configuration.get().PowerMeter.Enabled) { return; }
+
+    beginLine("opendtu_powermeter,host=%s", _hostTag.c_str());
+    addField("power", "%.1f", PowerMeter.getPowerTotal());
+    addField("data_valid", "%s", PowerMeter.isDataValid() ? "true" : "false");
+    endLine();
+}
+
+void InfluxExporterClass::renderPowerLimiter()
+{
+    if (!Configuration.get().PowerLimiter.Enabled) { return; }
+
+    beginLine("opendtu_powerlimiter,host=%s", _hostTag.c_str());
+    addField("mode", "%ui", static_cast<unsigned>(PowerLimiter.getMode()));
+    addField("inverter_output", "%" PRId32 "i", PowerLimiter.getInverterOutput());
+    endLine();
+}
+
+void InfluxExporterClass::sendUdp()
+{
+    // as many lines as fit into a datagram are sent at once
+    size_t start = 0;
+    while (start < _length) {
+        size_t end = start;
+        while (end < _length) {
+            auto newline = static_cast<char const*>(memchr(_buffer + end, '\n', _length - end));
+            size_t next = newline - _buffer + 1;
+            if (end > start && next - start > MaxDatagramSize) { break; }
+            end = next;
+        }
+
+        if (!_udp.beginPacket(_address, _port)) { return; }
+        _udp.write(reinterpret_cast<uint8_t const*>(_buffer + start), end - start);
+        if (!_udp.endPacket()) {
+            MessageOutput.println("[InfluxExporter] Failed to send datagram");
+            return;
+        }
+
+        start = end;
+    }
+}
+
+void InfluxExporterClass::sendHttp()
+{
+    _request = "POST ";
+    _request += _path;
+    _request += " HTTP/1.1\r\nHost: ";
+    _request += _hostname;
+    _request += "\r\nContent-Type: text/plain; charset=utf-8\r\nContent-Length: ";
+    _request += _length;
+    if (!_token.isEmpty()) {
+        _request += "\r\nAuthorization: Token ";
+        _request += _token;
+    }
+    _request += "\r\nConnection: close\r\n\r\n";
+    _requestSent = 0;
+
+    // does not block. the request is sent from within the callbacks.
+    _httpState = HttpState::Connecting;
+    _client.setRxTimeout(HttpTimeoutSeconds);
+    if (!_client.connect(_address, _port)) {
+        _httpState = HttpState::Idle;
+    }
+}
+
+void InfluxExporterClass::sendPending()
+{
+    size_t headerLength = _request.length();
+    size_t total = headerLength + _length;
+
+    // the header and the body are added as the send buffer allows
+    while (_requestSent < total) {
+        size_t space = _client.space();
+        if (space == 0) { break; }
+
+        char const* data;
+        size_t remaining;
+        if (_requestSent < headerLength) {
+            data = _request.c_str() + _requestSent;
+            remaining = headerLength - _requestSent;
+        } else {
+            data = _buffer + (_requestSent - headerLength);
+            remaining = total - _requestSent;
+        }
+
+        size_t added = _client.add(data, std::min(space, remaining));
+        if (added == 0) { break; }
+        _requestSent += added;
+    }
+
+    _client.send();
+}
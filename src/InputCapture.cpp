@@ -0,0 +1,267 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "InputCapture.h"
+#include "MemoryPolicy.h"
+#include "MessageOutput.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <cstring>
+
+InputCaptureClass InputCapture;
+
+namespace {
+
+constexpr char MAGIC[] = { 'O', 'I', 'C', 'P' };
+constexpr uint8_t LOG_VERSION = 1;
+
+} // namespace
+
+bool InputCaptureClass::allocate()
+{
+    if (_buffer != nullptr) { return true; }
+
+    _capacity = psramFound() ? BufferSize : InternalBufferSize;
+    _buffer = static_cast<uint8_t*>(MemoryPolicy::allocateLarge(_capacity));
+    if (_buffer == nullptr) {
+        MessageOutput.println("[InputCapture] Failed to allocate buffer");
+        return false;
+    }
+
+    return true;
+}
+
+bool InputCaptureClass::startRecording(uint32_t sources)
+{
+    sources &= (1UL << static_cast<uint8_t>(Source::Count)) - 1;
+    if (sources == 0) { return false; }
+
+    stop();
+    if (!allocate()) { return false; }
+
+    portENTER_CRITICAL(&_recordLock);
+    _used = 0;
+    _hasRecord = false;
+    _droppedRecords = 0;
+    _startMillis = millis();
+    _state = State::Recording;
+    _sources = sources;
+    _recordMask = sources;
+    portEXIT_CRITICAL(&_recordLock);
+
+    MessageOutput.printf("[InputCapture] Recording sources 0x%02x into %u bytes\r\n",
+            sources, _capacity);
+    return true;
+}
+
+void InputCaptureClass::stop()
+{
+    _recordMask = 0;
+    _replayMask = 0;
+
+    auto previous = _state.exchange(State::Idle);
+    if (previous == State::Recording) {
+        _durationMillis = millis() - _startMillis;
+        MessageOutput.printf("[InputCapture] Recorded %u bytes in %u ms, %u records dropped\r\n",
+                _used.load(), _durationMillis, _droppedRecords.load());
+    }
+
+    // the records must not change while they are being replayed
+    while (_replayReaders > 0) { delay(1); }
+}
+
+void InputCaptureClass::append(Source source, uint8_t channel, uint8_t const* data, size_t length)
+{
+    if (length == 0 || length > UINT16_MAX) { return; }
+
+    int64_t now = esp_timer_get_time();
+    bool full = false;
+
+    portENTER_CRITICAL_SAFE(&_recordLock);
+
+    if (_state != State::Recording) {
+        portEXIT_CRITICAL_SAFE(&_recordLock);
+        return;
+    }
+
+    RecordHeader header;
+    size_t used = _used;
+
+    if (_hasRecord) { memcpy(&header, _buffer + _lastRecord, sizeof(header)); }
+
+    bool coalesce = _hasRecord && isStream(source)
+        && header.Source == static_cast<uint8_t>(source) && header.Channel == channel
+        && now - _lastChunkMicros < CoalesceMicros
+        && header.Length + length <= UINT16_MAX;
+
+    if (coalesce && used + length <= _capacity) {
+        header.Length += length;
+        memcpy(_buffer + _lastRecord, &header, sizeof(header));
+        memcpy(_buffer + used, data, length);
+        _used = used + length;
+        _lastChunkMicros = now;
+    } else if (!coalesce && used + sizeof(header) + length <= _capacity) {
+        int64_t delta = _hasRecord ? now - _lastMicros : 0;
+        header.DeltaMicros = std::min<int64_t>(delta, UINT32_MAX);
+        header.Source = static_cast<uint8_t>(source);
+        header.Channel = channel;
+        header.Length = length;
+        memcpy(_buffer + used, &header, sizeof(header));
+        memcpy(_buffer + used + sizeof(header), data, length);
+        _lastRecord = used;
+        _used = used + sizeof(header) + length;
+        _lastMicros = now;
+        _lastChunkMicros = now;
+        _hasRecord = true;
+    } else {
+        full = true;
+        _recordMask = 0;
+        _durationMillis = millis() - _startMillis;
+        _state = State::Idle;
+    }
+
+    portEXIT_CRITICAL_SAFE(&_recordLock);
+
+    if (full) { ++_droppedRecords; }
+}
+
+bool InputCaptureClass::startReplay(uint16_t speed)
+{
+    stop();
+    if (_buffer == nullptr || _used == 0) { return false; }
+
+    // only the sources found in the log are replayed
+    uint32_t sources = 0;
+    size_t offset = 0;
+    while (offset + sizeof(RecordHeader) <= _used) {
+        RecordHeader header;
+        memcpy(&header, _buffer + offset, sizeof(header));
+        if (header.Source < static_cast<uint8_t>(Source::Count)) { sources |= 1UL << header.Source; }
+        offset += sizeof(header) + header.Length;
+    }
+
+    for (auto& channels : _cursors) {
+        for (auto& cursor : channels) { cursor = { 0, 0 }; }
+    }
+
+    _speed = std::max<uint16_t>(speed, 1);
+    _replayStartMicros = esp_timer_get_time();
+    _sources = sources;
+    _state = State::Replaying;
+    _replayMask = sources;
+
+    MessageOutput.printf("[InputCapture] Replaying sources 0x%02x (%u bytes) at %ux speed\r\n",
+            sources, _used.load(), _speed);
+    return true;
+}
+
+void InputCaptureClass::replayDue(Source source, uint8_t channel, ReplayCallback const& callback)
+{
+    ++_replayReaders;
+
+    if (_state == State::Replaying && channel < MaxChannels) {
+        auto& cursor = _cursors[static_cast<uint8_t>(source)][channel];
+        uint64_t elapsed = static_cast<uint64_t>(esp_timer_get_time() - _replayStartMicros) * _speed;
+        size_t used = _used;
+
+        while (cursor.Offset + sizeof(RecordHeader) <= used) {
+            RecordHeader header;
+            memcpy(&header, _buffer + cursor.Offset, sizeof(header));
+
+            uint64_t at = cursor.Micros + header.DeltaMicros;
+            if (at > elapsed) { break; }
+
+            cursor.Micros = at;
+            auto data = _buffer + cursor.Offset + sizeof(header);
+            cursor.Offset += sizeof(header) + header.Length;
+
+            if (header.Source == static_cast<uint8_t>(source) && header.Channel == channel) {
+                callback(data, header.Length);
+            }
+        }
+    }
+
+    --_replayReaders;
+}
+
+bool InputCaptureClass::load(size_t offset, uint8_t const* data, size_t length)
+{
+    if (offset == 0) {
+        stop();
+        if (!allocate()) { return false; }
+        _used = 0;
+        _durationMillis = 0;
+        _droppedRecords = 0;
+        _sources = 0;
+    }
+
+    if (offset < sizeof(Header)) {
+        size_t len = std::min(length, sizeof(Header) - offset);
+        memcpy(reinterpret_cast<uint8_t*>(&_loadHeader) + offset, data, len);
+        offset += len;
+        data += len;
+        length -= len;
+    }
+
+    size_t position = offset - sizeof(Header);
+    if (position + length > _capacity) { return false; }
+
+    memcpy(_buffer + position, data, length);
+    return true;
+}
+
+bool InputCaptureClass::finishLoad(size_t length)
+{
+    auto const& header = _loadHeader;
+    if (_buffer == nullptr || length < sizeof(header)) { return false; }
+
+    if (memcmp(header.Magic, MAGIC, sizeof(MAGIC)) != 0 || header.Version != LOG_VERSION) { return false; }
+    if (header.RecordBytes != length - sizeof(header) || header.RecordBytes > _capacity) { return false; }
+
+    // the records must fill the log exactly
+    size_t offset = 0;
+    while (offset + sizeof(RecordHeader) <= header.RecordBytes) {
+        RecordHeader record;
+        memcpy(&record, _buffer + offset, sizeof(record));
+        offset += sizeof(record) + record.Length;
+    }
+    if (offset != header.RecordBytes) { return false; }
+
+    _used = header.RecordBytes;
+    _durationMillis = header.DurationMillis;
+
+    MessageOutput.printf("[InputCapture] Loaded %u bytes recorded in %u ms\r\n",
+            _used.load(), _durationMillis);
+    return true;
+}
+
+uint32_t InputCaptureClass::getDurationMillis() const
+{
+    if (_state == State::Recording) { return millis() - _startMillis; }
+    return _durationMillis;
+}
+
+size_t InputCaptureClass::readLog(size_t offset, uint8_t* buffer, size_t length) const
+{
+    size_t written = 0;
+
+    if (offset < sizeof(Header)) {
+        Header header;
+        memcpy(header.Magic, MAGIC, sizeof(header.Magic));
+        header.Version = LOG_VERSION;
+        memset(header.Reserved, 0, sizeof(header.Reserved));
+        header.RecordBytes = _used;
+        header.DurationMillis = getDurationMillis();
+
+        written = std::min(length, sizeof(header) - offset);
+        memcpy(buffer, reinterpret_cast<uint8_t const*>(&header) + offset, written);
+        offset += written;
+    }
+
+    size_t used = _used;
+    size_t position = offset - sizeof(Header);
+    if (_buffer == nullptr || position >= used) { return written; }
+
+    size_t len = std::min(length - written, used - position);
+    memcpy(buffer + written, _buffer + position, len);
+    return written + len;
+}
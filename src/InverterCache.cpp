@@ -0,0 +1,219 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "InverterCache.h"
+#include "MessageOutput.h"
+#include <LittleFS.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include "TaskProfiler.h"
+
+InverterCacheClass InverterCache;
+
+namespace {
+
+constexpr uint32_t RECORD_MAGIC = 0x49435631; // "ICV1"
+constexpr char const FILENAME_PREFIX[] = "inv_";
+
+// the restored device info is confirmed once the inverter was polled for a
+// while, such that the requests do not compete with the DPL after booting
+constexpr uint32_t REFRESH_DELAY_MILLIS = 10 * 60 * 1000;
+constexpr uint32_t REFRESH_RETRY_MILLIS = 5 * 60 * 1000;
+
+uint16_t getFwBuildVersion(uint8_t const* devInfoAll)
+{
+    return (static_cast<uint16_t>(devInfoAll[0]) << 8) | devInfoAll[1];
+}
+
+} // namespace
+
+InverterCacheClass::InverterCacheClass()
+    : _loopTask(10 * TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("InverterCache::loop", std::bind(&InverterCacheClass::loop, this)))
+{
+}
+
+void InverterCacheClass::init(Scheduler& scheduler)
+{
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+String InverterCacheClass::getFilename(uint64_t serial)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "/%s%04" PRIx32 "%08" PRIx32 ".bin", FILENAME_PREFIX,
+        static_cast<uint32_t>((serial >> 32) & 0xFFFFFFFF),
+        static_cast<uint32_t>(serial & 0xFFFFFFFF));
+    return buffer;
+}
+
+InverterCacheClass::Entry* InverterCacheClass::getEntry(uint64_t serial)
+{
+    for (auto& entry : _entries) {
+        if (entry.Persisted.Serial == serial) { return &entry; }
+    }
+    return nullptr;
+}
+
+void InverterCacheClass::read(InverterAbstract& inv, Record& record)
+{
+    // zeroes the padding as well, such that records can be compared
+    memset(&record, 0, sizeof(record));
+    record.Magic = RECORD_MAGIC;
+    record.Serial = inv.serial();
+
+    record.DevInfoAllLength = inv.DevInfo()->getPayloadAll(record.DevInfoAll);
+    record.DevInfoSimpleLength = inv.DevInfo()->getPayloadSimple(record.DevInfoSimple);
+
+    auto raw = inv.GridProfile()->getRawData();
+    record.GridProfileLength = std::min<size_t>(raw.size(), GRID_PROFILE_SIZE);
+    memcpy(record.GridProfile, raw.data(), record.GridProfileLength);
+}
+
+void InverterCacheClass::persist(Record const& record)
+{
+    auto filename = getFilename(record.Serial);
+
+    File f = LittleFS.open(filename, "w");
+    if (!f) {
+        MessageOutput.printf("[InverterCache] Failed to open %s for writing\r\n", filename.c_str());
+        return;
+    }
+
+    f.write(reinterpret_cast<uint8_t const*>(&record), sizeof(record));
+    f.close();
+
+    MessageOutput.printf("[InverterCache] Stored device info and grid profile in %s\r\n", filename.c_str());
+}
+
+void InverterCacheClass::restore()
+{
+    // files of inverters which were removed are deleted
+    std::vector<String> orphans;
+
+    auto root = LittleFS.open("/");
+    auto name = root.getNextFileName();
+    while (name != "") {
+        if (name.startsWith("/")) { name = name.substring(1); }
+        if (name.startsWith(FILENAME_PREFIX)) {
+            orphans.push_back("/" + name);
+        }
+        name = root.getNextFileName();
+    }
+    root.close();
+
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) { continue; }
+
+        auto filename = getFilename(inv->serial());
+        orphans.erase(std::remove(orphans.begin(), orphans.end(), filename), orphans.end());
+
+        File f = LittleFS.open(filename, "r", false);
+        if (!f) { continue; }
+
+        Entry entry;
+        bool valid = f.read(reinterpret_cast<uint8_t*>(&entry.Persisted), sizeof(Record)) == sizeof(Record)
+            && entry.Persisted.Magic == RECORD_MAGIC
+            && entry.Persisted.Serial == inv->serial()
+            && entry.Persisted.DevInfoAllLength <= DEV_INFO_SIZE
+            && entry.Persisted.DevInfoSimpleLength <= DEV_INFO_SIZE
+            && entry.Persisted.GridProfileLength <= GRID_PROFILE_SIZE;
+        f.close();
+
+        if (!valid) {
+            MessageOutput.printf("[InverterCache] Discarding invalid file %s\r\n", filename.c_str());
+            LittleFS.remove(filename);
+            continue;
+        }
+
+        auto const& record = entry.Persisted;
+
+        auto devInfo = inv->DevInfo();
+        devInfo->beginAppendFragment();
+        devInfo->clearBufferAll();
+        devInfo->appendFragmentAll(0, record.DevInfoAll, record.DevInfoAllLength);
+        devInfo->clearBufferSimple();
+        devInfo->appendFragmentSimple(0, record.DevInfoSimple, record.DevInfoSimpleLength);
+        devInfo->endAppendFragment();
+        devInfo->setLastUpdateAll(millis());
+        devInfo->setLastUpdateSimple(millis());
+
+        auto gridProfile = inv->GridProfile();
+        gridProfile->beginAppendFragment();
+        gridProfile->clearBuffer();
+        gridProfile->appendFragment(0, record.GridProfile, record.GridProfileLength);
+        gridProfile->endAppendFragment();
+        gridProfile->setLastUpdate(millis());
+
+        entry.RefreshPending = true;
+        entry.RefreshRequested = 0;
+        _entries.push_back(entry);
+
+        MessageOutput.printf("[InverterCache] Restored inverter %s: %s, firmware %u, %s\r\n",
+            inv->serialString().c_str(), devInfo->getHwModelName().c_str(),
+            getFwBuildVersion(record.DevInfoAll), gridProfile->getProfileName().c_str());
+    }
+
+    for (auto const& orphan : orphans) {
+        MessageOutput.printf("[InverterCache] Removing %s\r\n", orphan.c_str());
+        LittleFS.remove(orphan);
+    }
+}
+
+void InverterCacheClass::loop()
+{
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) { continue; }
+
+        auto entry = getEntry(inv->serial());
+
+        if (entry != nullptr && entry->RefreshPending) {
+            auto devInfo = inv->DevInfo();
+
+            if (entry->RefreshRequested > 0 && devInfo->getLastUpdateAll() > entry->RefreshRequested) {
+                entry->RefreshPending = false;
+
+                // a firmware update might come along with another grid
+                // profile, which is then fetched by the library again
+                if (devInfo->getFwBuildVersion() != getFwBuildVersion(entry->Persisted.DevInfoAll)) {
+                    MessageOutput.printf("[InverterCache] Firmware of inverter %s changed, "
+                            "fetching grid profile\r\n", inv->serialString().c_str());
+
+                    auto gridProfile = inv->GridProfile();
+                    gridProfile->beginAppendFragment();
+                    gridProfile->clearBuffer();
+                    gridProfile->endAppendFragment();
+                    gridProfile->setLastUpdate(0);
+                }
+            } else if (inv->isReachable() && inv->Statistics()->getLastUpdate() > 0
+                    && millis() > REFRESH_DELAY_MILLIS
+                    && (entry->RefreshRequested == 0 || millis() - entry->RefreshRequested > REFRESH_RETRY_MILLIS)) {
+                if (inv->sendDevInfoRequest()) {
+                    entry->RefreshRequested = millis();
+                }
+            }
+
+            continue;
+        }
+
+        if (!inv->DevInfo()->containsValidData() || !inv->GridProfile()->containsValidData()) {
+            continue;
+        }
+
+        Record current;
+        read(*inv, current);
+
+        if (entry == nullptr) {
+            _entries.push_back({});
+            entry = &_entries.back();
+            entry->RefreshPending = false;
+            entry->RefreshRequested = 0;
+        } else if (memcmp(&entry->Persisted, &current, sizeof(Record)) == 0) {
+            continue;
+        }
+
+        entry->Persisted = current;
+        persist(current);
+    }
+}
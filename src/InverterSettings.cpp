@@ -4,21 +4,23 @@
  */
 #include "InverterSettings.h"
 #include "Configuration.h"
+#include "InputCapture.h"
 #include "MessageOutput.h"
 #include "PinMapping.h"
 #include "SunPosition.h"
 #include <Hoymiles.h>
 #include <SpiManager.h>
+#include "TaskProfiler.h"
 
 InverterSettingsClass InverterSettings;
 
 InverterSettingsClass::InverterSettingsClass()
-    : _settingsTask(INVERTER_UPDATE_SETTINGS_INTERVAL, TASK_FOREVER, std::bind(&InverterSettingsClass::settingsLoop, this))
-    , _hoyTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&InverterSettingsClass::hoyLoop, this))
+    : _settingsTask(INVERTER_UPDATE_SETTINGS_INTERVAL, TASK_FOREVER, TaskProfiler.wrap("InverterSettings::settingsLoop", std::bind(&InverterSettingsClass::settingsLoop, this)))
+    , _hoyTask(TASK_IMMEDIATE, TASK_FOREVER, TaskProfiler.wrap("InverterSettings::hoyLoop", std::bind(&InverterSettingsClass::hoyLoop, this)))
 {
 }
 
-void InverterSettingsClass::init(Scheduler& scheduler)
+void InverterSettingsClass::initRadios()
 {
     const CONFIG_T& config = Configuration.get();
     const PinMapping_t& pin = PinMapping.get();
@@ -29,7 +31,23 @@ void InverterSettingsClass::init(Scheduler& scheduler)
     Hoymiles.setMessageOutput(&MessageOutput);
     Hoymiles.init();
 
-    if (PinMapping.isValidNrf24Config() || PinMapping.isValidCmt2300Config()) {
+    // the fragments are recorded for analysis only, as replaying them
+    // would require the commands which requested them.
+    Hoymiles.setFragmentCallback([](uint8_t radio, const fragment_t& fragment) {
+        uint8_t record[1 + MAX_RF_PAYLOAD_SIZE];
+        record[0] = static_cast<uint8_t>(fragment.rssi);
+        memcpy(record + 1, fragment.fragment, fragment.len);
+        InputCapture.record(InputCapture::Source::Radio, radio, record, 1 + fragment.len);
+    });
+
+#ifdef HOYMILES_SIMULATOR
+    Hoymiles.initSimulator();
+    constexpr bool simulator = true;
+#else
+    constexpr bool simulator = false;
+#endif
+
+    if (simulator || PinMapping.isValidNrf24Config() || PinMapping.isValidCmt2300Config()) {
         if (PinMapping.isValidNrf24Config()) {
             auto spi_bus = SpiManagerInst.claim_bus_arduino();
             ESP_ERROR_CHECK(spi_bus ? ESP_OK : ESP_FAIL);
@@ -89,7 +107,10 @@ void InverterSettingsClass::init(Scheduler& scheduler)
     } else {
         MessageOutput.println("Invalid pin config");
     }
+}
 
+void InverterSettingsClass::init(Scheduler& scheduler)
+{
     scheduler.addTask(_hoyTask);
     _hoyTask.enable();
 
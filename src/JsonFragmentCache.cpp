@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "JsonFragmentCache.h"
+#include "MemoryPolicy.h"
+#include "Utils.h"
+
+JsonFragmentCache::Fragment JsonFragmentCache::get(uint32_t version, Generator const& generate)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_oVersion == version) { return _fragment; }
+
+    auto spDoc = std::make_shared<JsonDocument>(MemoryPolicy::jsonAllocator());
+    JsonVariant root = *spDoc;
+    generate(root);
+
+    if (!Utils::checkJsonAlloc(*spDoc, __FUNCTION__, __LINE__)) { return {}; }
+
+    // REST clients always expect an object
+    if (spDoc->isNull()) { spDoc->to<JsonObject>(); }
+
+    size_t size = measureJson(*spDoc);
+    auto spText = std::make_shared<std::vector<uint8_t>>(size);
+    serializeJson(*spDoc, reinterpret_cast<char*>(spText->data()), size);
+
+    _fragment = { std::move(spDoc), std::move(spText) };
+    _oVersion = version;
+    return _fragment;
+}
+
+void JsonFragmentCache::send(AsyncWebServerRequest* request, Fragment const& fragment)
+{
+    auto spText = fragment.spText;
+    size_t size = spText->size();
+
+    AsyncWebServerResponse* response = request->beginResponse("application/json", size,
+        [spText, size](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            size_t len = std::min(maxLen, size - index);
+            memcpy(buffer, spText->data() + index, len);
+            return len;
+        });
+    request->send(response);
+}
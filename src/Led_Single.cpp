@@ -9,6 +9,7 @@
 #include "NetworkSettings.h"
 #include "PinMapping.h"
 #include <Hoymiles.h>
+#include "TaskProfiler.h"
 
 LedSingleClass LedSingle;
 
@@ -38,8 +39,8 @@ const uint8_t pwmTable[] = {
 #define LED_OFF 0
 
 LedSingleClass::LedSingleClass()
-    : _setTask(LEDSINGLE_UPDATE_INTERVAL * TASK_MILLISECOND, TASK_FOREVER, std::bind(&LedSingleClass::setLoop, this))
-    , _outputTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&LedSingleClass::outputLoop, this))
+    : _setTask(LEDSINGLE_UPDATE_INTERVAL * TASK_MILLISECOND, TASK_FOREVER, TaskProfiler.wrap("LedSingle::setLoop", std::bind(&LedSingleClass::setLoop, this)))
+    , _outputTask(TASK_IMMEDIATE, TASK_FOREVER, TaskProfiler.wrap("LedSingle::outputLoop", std::bind(&LedSingleClass::outputLoop, this)))
 {
 }
 
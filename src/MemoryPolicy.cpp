@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "MemoryPolicy.h"
+#include <esp_heap_caps.h>
+
+namespace {
+
+constexpr uint32_t PSRAM_CAPS = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+constexpr uint32_t INTERNAL_CAPS = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+
+class LargeJsonAllocator : public ArduinoJson::Allocator {
+public:
+    void* allocate(size_t size) override
+    {
+        return heap_caps_malloc_prefer(size, 2, PSRAM_CAPS, INTERNAL_CAPS);
+    }
+
+    void deallocate(void* ptr) override
+    {
+        heap_caps_free(ptr);
+    }
+
+    void* reallocate(void* ptr, size_t new_size) override
+    {
+        return heap_caps_realloc_prefer(ptr, new_size, 2, PSRAM_CAPS, INTERNAL_CAPS);
+    }
+};
+
+LargeJsonAllocator sJsonAllocator;
+
+} // namespace
+
+namespace MemoryPolicy {
+
+void init()
+{
+    heap_caps_malloc_extmem_enable(InternalMaxSize);
+}
+
+void* allocateLarge(size_t size)
+{
+    return heap_caps_malloc_prefer(size, 2, PSRAM_CAPS, INTERNAL_CAPS);
+}
+
+ArduinoJson::Allocator* jsonAllocator()
+{
+    return &sJsonAllocator;
+}
+
+} // namespace MemoryPolicy
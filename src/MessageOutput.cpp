@@ -3,13 +3,17 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include <HardwareSerial.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
 #include "MessageOutput.h"
 #include "SyslogLogger.h"
+#include <TaskProfiler.h>
 
 MessageOutputClass MessageOutput;
 
 MessageOutputClass::MessageOutputClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MessageOutputClass::loop, this))
+    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, TaskProfiler.wrap("MessageOutput::loop", std::bind(&MessageOutputClass::loop, this)))
 {
 }
 
@@ -19,14 +23,12 @@ void MessageOutputClass::init(Scheduler& scheduler)
     _loopTask.enable();
 }
 
-void MessageOutputClass::register_ws_output(AsyncWebSocket* output)
+void MessageOutputClass::register_ws_output(LineSink sink)
 {
-    std::lock_guard<std::mutex> lock(_msgLock);
-
-    _ws = output;
+    _wsSink = std::move(sink);
 }
 
-void MessageOutputClass::serialWrite(MessageOutputClass::message_t const& m)
+void MessageOutputClass::serialWrite(uint8_t const* data, size_t size)
 {
     // operator bool() of HWCDC returns false if the device is not attached to
     // a USB host. in general it makes sense to skip writing entirely if the
@@ -34,84 +36,139 @@ void MessageOutputClass::serialWrite(MessageOutputClass::message_t const& m)
     if (!Serial) { return; }
 
     size_t written = 0;
-    while (written < m.size()) {
-        written += Serial.write(m.data() + written, m.size() - written);
+    while (written < size) {
+        written += Serial.write(data + written, size - written);
     }
 }
 
-size_t MessageOutputClass::write(uint8_t c)
+MessageOutputClass::Staging* MessageOutputClass::acquireStaging()
 {
-    std::lock_guard<std::mutex> lock(_msgLock);
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    for (auto& staging : _staging) {
+        if (staging.Owner.load(std::memory_order_acquire) == self) { return &staging; }
+    }
+
+    for (auto& staging : _staging) {
+        TaskHandle_t expected = nullptr;
+        if (staging.Owner.compare_exchange_strong(expected, self, std::memory_order_acquire)) {
+            staging.Length = 0;
+            return &staging;
+        }
+    }
 
-    auto res = _task_messages.emplace(xTaskGetCurrentTaskHandle(), message_t());
-    auto iter = res.first;
-    auto& message = iter->second;
+    return nullptr;
+}
 
-    message.push_back(c);
+void MessageOutputClass::commit(uint8_t const* data, size_t size)
+{
+    size = std::min<size_t>(size, HeaderLengthMask);
+    uint32_t recordSize = (sizeof(uint32_t) + size + 3) & ~3;
+    if (recordSize > RingSize) { return; }
+
+    uint32_t pos = _reserved.load(std::memory_order_relaxed);
+    uint32_t padding;
+
+    do {
+        // records are never split. if the record does not fit into the
+        // remainder of the ring, that remainder is skipped using a padding
+        // record. as all records are aligned, it can always hold a header.
+        uint32_t contiguous = RingSize - (pos & (RingSize - 1));
+        padding = (recordSize > contiguous) ? contiguous : 0;
+
+        uint32_t used = pos - _released.load(std::memory_order_acquire);
+        if (used + padding + recordSize > RingSize) {
+            _droppedLines.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    } while (!_reserved.compare_exchange_weak(pos, pos + padding + recordSize,
+                std::memory_order_acq_rel, std::memory_order_relaxed));
 
-    if (c == '\n') {
-        serialWrite(message);
-        _lines.emplace(std::move(message));
-        _task_messages.erase(iter);
+    if (padding > 0) {
+        auto pHeader = reinterpret_cast<uint32_t*>(&_ring[pos & (RingSize - 1)]);
+        __atomic_store_n(pHeader, HeaderCommitted | HeaderPadding | padding, __ATOMIC_RELEASE);
+        pos += padding;
     }
 
-    return 1;
+    uint8_t* pRecord = &_ring[pos & (RingSize - 1)];
+    memcpy(pRecord + sizeof(uint32_t), data, size);
+    __atomic_store_n(reinterpret_cast<uint32_t*>(pRecord), HeaderCommitted | size, __ATOMIC_RELEASE);
 }
 
-size_t MessageOutputClass::write(const uint8_t *buffer, size_t size)
+size_t MessageOutputClass::write(uint8_t c)
 {
-    std::lock_guard<std::mutex> lock(_msgLock);
+    return write(&c, 1);
+}
 
-    auto res = _task_messages.emplace(xTaskGetCurrentTaskHandle(), message_t());
-    auto iter = res.first;
-    auto& message = iter->second;
+size_t MessageOutputClass::write(const uint8_t *buffer, size_t size)
+{
+    auto pStaging = acquireStaging();
 
-    message.reserve(message.size() + size);
+    // all staging buffers are in use, so we cannot assemble lines for
+    // this task. rather than dropping the message, we output it as is.
+    if (!pStaging) {
+        commit(buffer, size);
+        return size;
+    }
 
     for (size_t idx = 0; idx < size; ++idx) {
         uint8_t c = buffer[idx];
 
-        message.push_back(c);
+        pStaging->Data[pStaging->Length++] = c;
 
-        if (c == '\n') {
-            serialWrite(message);
-            _lines.emplace(std::move(message));
-            message.clear();
-            message.reserve(size - idx - 1);
+        if (c == '\n' || pStaging->Length == sizeof(pStaging->Data)) {
+            commit(pStaging->Data, pStaging->Length);
+            pStaging->Length = 0;
         }
     }
 
-    if (message.empty()) { _task_messages.erase(iter); }
+    if (pStaging->Length == 0) {
+        pStaging->Owner.store(nullptr, std::memory_order_release);
+    }
 
     return size;
 }
 
 void MessageOutputClass::loop()
 {
-    std::lock_guard<std::mutex> lock(_msgLock);
-
     // clean up (possibly filled) buffers of deleted tasks
-    auto map_iter = _task_messages.begin();
-    while (map_iter != _task_messages.end()) {
-        if (eTaskGetState(map_iter->first) == eDeleted) {
-            map_iter = _task_messages.erase(map_iter);
-            continue;
-        }
+    for (auto& staging : _staging) {
+        TaskHandle_t owner = staging.Owner.load(std::memory_order_acquire);
+        if (owner == nullptr || eTaskGetState(owner) != eDeleted) { continue; }
 
-        ++map_iter;
+        staging.Length = 0;
+        staging.Owner.compare_exchange_strong(owner, nullptr, std::memory_order_release);
     }
 
-    if (!_ws) {
-        while (!_lines.empty()) {
-            Syslog.write(_lines.front().data(), _lines.front().size());
-            _lines.pop(); // do not hog memory
+    uint32_t pos = _released.load(std::memory_order_relaxed);
+    while (pos != _reserved.load(std::memory_order_acquire)) {
+        uint8_t* pRecord = &_ring[pos & (RingSize - 1)];
+        uint32_t header = __atomic_load_n(reinterpret_cast<uint32_t*>(pRecord), __ATOMIC_ACQUIRE);
+
+        // the producer which reserved this record is still copying its line
+        if ((header & HeaderCommitted) == 0) { break; }
+
+        uint32_t size = header & HeaderLengthMask;
+        uint32_t recordSize = (header & HeaderPadding) ? size : ((sizeof(uint32_t) + size + 3) & ~3);
+
+        if ((header & HeaderPadding) == 0) {
+            uint8_t const* pData = pRecord + sizeof(uint32_t);
+            serialWrite(pData, size);
+            Syslog.write(pData, size);
+            if (_wsSink) { _wsSink(pData, size); }
         }
-        return;
+
+        // the next records might start anywhere in this record, so no stale
+        // header must remain in it once the space is released.
+        memset(pRecord, 0, recordSize);
+        pos += recordSize;
+        _released.store(pos, std::memory_order_release);
     }
 
-    while (!_lines.empty() && _ws->availableForWriteAll()) {
-        Syslog.write(_lines.front().data(), _lines.front().size());
-        _ws->textAll(std::make_shared<message_t>(std::move(_lines.front())));
-        _lines.pop();
+    uint32_t dropped = _droppedLines.load(std::memory_order_relaxed);
+    if (dropped > 0 && millis() - _lastDroppedReport > 10 * 1000) {
+        _droppedLines.fetch_sub(dropped, std::memory_order_relaxed);
+        _lastDroppedReport = millis();
+        printf("[MessageOutput] %" PRIu32 " messages were dropped as the buffer was full\r\n", dropped);
     }
 }
@@ -0,0 +1,314 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "ModbusSunSpec.h"
+#include "Configuration.h"
+#include "Datastore.h"
+#include "NetworkSettings.h"
+#include "__compiled_constants.h"
+#include <Hoymiles.h>
+#include <battery/Controller.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// values which are not implemented
+constexpr uint16_t NA_UINT16 = 0xFFFF;
+constexpr uint16_t NA_INT16 = 0x8000;
+constexpr uint16_t NA_ENUM16 = 0xFFFF;
+
+// operating states of the inverter and the MPPT modules
+constexpr uint16_t ST_OFF = 1;
+constexpr uint16_t ST_SLEEPING = 2;
+constexpr uint16_t ST_MPPT = 4;
+
+// the battery's type, lithium-ion
+constexpr uint16_t BAT_TYPE_LITHIUM_ION = 4;
+
+// points of the inverter model (103), relative to its first value
+namespace Inverter {
+    constexpr uint16_t A = 0;
+    constexpr uint16_t AphA = 1;
+    constexpr uint16_t A_SF = 4;
+    constexpr uint16_t PhVphA = 8;
+    constexpr uint16_t V_SF = 11;
+    constexpr uint16_t W = 12;
+    constexpr uint16_t W_SF = 13;
+    constexpr uint16_t Hz = 14;
+    constexpr uint16_t Hz_SF = 15;
+    constexpr uint16_t VA = 16;
+    constexpr uint16_t VA_SF = 17;
+    constexpr uint16_t VAr = 18;
+    constexpr uint16_t VAr_SF = 19;
+    constexpr uint16_t PF = 20;
+    constexpr uint16_t PF_SF = 21;
+    constexpr uint16_t WH = 22;
+    constexpr uint16_t WH_SF = 24;
+    constexpr uint16_t DCA = 25;
+    constexpr uint16_t DCA_SF = 26;
+    constexpr uint16_t DCV = 27;
+    constexpr uint16_t DCV_SF = 28;
+    constexpr uint16_t DCW = 29;
+    constexpr uint16_t DCW_SF = 30;
+    constexpr uint16_t TmpCab = 31;
+    constexpr uint16_t Tmp_SF = 35;
+    constexpr uint16_t St = 36;
+    constexpr uint16_t StVnd = 37;
+} // namespace Inverter
+
+// points of the MPPT model (160), relative to its first value
+namespace Mppt {
+    constexpr uint16_t DCA_SF = 0;
+    constexpr uint16_t DCV_SF = 1;
+    constexpr uint16_t DCW_SF = 2;
+    constexpr uint16_t DCWH_SF = 3;
+    constexpr uint16_t N = 6;
+    constexpr uint16_t TmsPer = 7;
+    constexpr uint16_t Modules = 8;
+
+    // relative to the module
+    constexpr uint16_t ID = 0;
+    constexpr uint16_t IDStr = 1;
+    constexpr uint16_t IDStrLength = 8;
+    constexpr uint16_t DCA = 9;
+    constexpr uint16_t DCV = 10;
+    constexpr uint16_t DCW = 11;
+    constexpr uint16_t DCWH = 12;
+    constexpr uint16_t Tms = 14;
+    constexpr uint16_t Tmp = 16;
+    constexpr uint16_t DCSt = 17;
+} // namespace Mppt
+
+// points of the battery base model (802), relative to its first value
+namespace Bat {
+    constexpr uint16_t SoC = 9;
+    constexpr uint16_t Typ = 19;
+    constexpr uint16_t V = 32;
+    constexpr uint16_t A = 42;
+    constexpr uint16_t ADisChaMax = 44;
+    constexpr uint16_t W = 45;
+    constexpr uint16_t SoC_SF = 54;
+    constexpr uint16_t V_SF = 57;
+    constexpr uint16_t A_SF = 59;
+    constexpr uint16_t AMax_SF = 60;
+    constexpr uint16_t W_SF = 61;
+} // namespace Bat
+
+// the scale factors are fixed, such that clients may cache them
+constexpr int16_t SF_CURRENT = -2;
+constexpr int16_t SF_VOLTAGE = -1;
+constexpr int16_t SF_POWER = 0;
+constexpr int16_t SF_FREQUENCY = -2;
+constexpr int16_t SF_ENERGY = 0;
+constexpr int16_t SF_TEMPERATURE = -1;
+constexpr int16_t SF_SOC = -1;
+constexpr int16_t SF_BAT_VOLTAGE = -2;
+constexpr int16_t SF_BAT_CURRENT = -1;
+
+uint16_t* values(uint16_t* image, uint16_t model)
+{
+    return image + model + 2;
+}
+
+void setString(uint16_t* target, uint16_t registers, char const* value)
+{
+    size_t length = std::min<size_t>(strlen(value), registers * 2);
+    for (uint16_t i = 0; i < registers; ++i) {
+        uint8_t high = (2 * i < length) ? value[2 * i] : 0;
+        uint8_t low = (2 * i + 1 < length) ? value[2 * i + 1] : 0;
+        target[i] = (high << 8) | low;
+    }
+}
+
+void setHeader(uint16_t* image, uint16_t model, uint16_t id, uint16_t length)
+{
+    image[model] = id;
+    image[model + 1] = length;
+}
+
+// scales the value by 10^-sf and rounds it
+int32_t scale(float value, int16_t sf)
+{
+    return static_cast<int32_t>(std::lround(value * std::pow(10.0f, -sf)));
+}
+
+uint16_t toUInt16(float value, int16_t sf)
+{
+    if (std::isnan(value)) { return NA_UINT16; }
+    return std::clamp<int32_t>(scale(value, sf), 0, NA_UINT16 - 1);
+}
+
+uint16_t toInt16(float value, int16_t sf)
+{
+    if (std::isnan(value)) { return NA_INT16; }
+    return static_cast<uint16_t>(static_cast<int16_t>(std::clamp<int32_t>(scale(value, sf), -32767, 32767)));
+}
+
+void setAcc32(uint16_t* target, float value, int16_t sf)
+{
+    // accumulators are not implemented if zero
+    uint32_t raw = std::isnan(value) ? 0 : static_cast<uint32_t>(std::max<int32_t>(scale(value, sf), 0));
+    target[0] = raw >> 16;
+    target[1] = raw & 0xFFFF;
+}
+
+uint16_t toSf(int16_t sf)
+{
+    return static_cast<uint16_t>(sf);
+}
+
+} // namespace
+
+namespace ModbusSunSpec {
+
+void initialize(uint16_t* image)
+{
+    std::fill(image, image + Size, 0);
+
+    setString(image, 2, "SunS");
+
+    setHeader(image, CommonModel, 1, CommonLength);
+    auto common = values(image, CommonModel);
+    setString(common + 0, 16, "OpenDTU");
+    setString(common + 16, 16, "OpenDTU-OnBattery");
+    setString(common + 40, 8, __COMPILED_GIT_HASH__);
+    setString(common + 48, 16, NetworkSettings.macAddress().c_str());
+    common[64] = 1; // device address
+    common[65] = NA_INT16;
+
+    setHeader(image, InverterModel, 103, InverterLength);
+    auto inverter = values(image, InverterModel);
+    std::fill(inverter, inverter + InverterLength, NA_UINT16);
+    inverter[Inverter::A_SF] = toSf(SF_CURRENT);
+    inverter[Inverter::V_SF] = toSf(SF_VOLTAGE);
+    inverter[Inverter::W_SF] = toSf(SF_POWER);
+    inverter[Inverter::Hz_SF] = toSf(SF_FREQUENCY);
+    inverter[Inverter::VA] = NA_INT16;
+    inverter[Inverter::VA_SF] = toSf(SF_POWER);
+    inverter[Inverter::VAr] = NA_INT16;
+    inverter[Inverter::VAr_SF] = toSf(SF_POWER);
+    inverter[Inverter::PF] = NA_INT16;
+    inverter[Inverter::PF_SF] = toSf(-2);
+    inverter[Inverter::WH_SF] = toSf(SF_ENERGY);
+    inverter[Inverter::DCA_SF] = toSf(SF_CURRENT);
+    inverter[Inverter::DCV_SF] = toSf(SF_VOLTAGE);
+    inverter[Inverter::DCW_SF] = toSf(SF_POWER);
+    for (uint16_t i = Inverter::TmpCab; i < Inverter::Tmp_SF; ++i) { inverter[i] = NA_INT16; }
+    inverter[Inverter::Tmp_SF] = toSf(SF_TEMPERATURE);
+    // the event bitfields are zero, i.e., no events
+    std::fill(inverter + Inverter::StVnd + 1, inverter + InverterLength, 0);
+
+    setHeader(image, MpptModel, 160, MpptLength);
+    auto mppt = values(image, MpptModel);
+    mppt[Mppt::DCA_SF] = toSf(SF_CURRENT);
+    mppt[Mppt::DCV_SF] = toSf(SF_VOLTAGE);
+    mppt[Mppt::DCW_SF] = toSf(SF_POWER);
+    mppt[Mppt::DCWH_SF] = toSf(SF_ENERGY);
+    mppt[Mppt::N] = MpptModules;
+    mppt[Mppt::TmsPer] = NA_UINT16;
+    for (uint8_t m = 0; m < MpptModules; ++m) {
+        auto module = mppt + Mppt::Modules + m * MpptModuleLength;
+        module[Mppt::ID] = m + 1;
+        module[Mppt::Tms] = NA_UINT16;
+        module[Mppt::Tms + 1] = NA_UINT16;
+        module[Mppt::Tmp] = NA_INT16;
+    }
+
+    setHeader(image, BatteryModel, 802, BatteryLength);
+    auto battery = values(image, BatteryModel);
+    std::fill(battery, battery + BatteryLength, NA_UINT16);
+    battery[Bat::Typ] = BAT_TYPE_LITHIUM_ION;
+    battery[Bat::A] = NA_INT16;
+    battery[Bat::W] = NA_INT16;
+    battery[Bat::SoC_SF] = toSf(SF_SOC);
+    battery[Bat::V_SF] = toSf(SF_BAT_VOLTAGE);
+    battery[Bat::A_SF] = toSf(SF_BAT_CURRENT);
+    battery[Bat::AMax_SF] = toSf(SF_BAT_CURRENT);
+    battery[Bat::W_SF] = toSf(SF_POWER);
+
+    setHeader(image, EndModel, 0xFFFF, 0);
+}
+
+void refresh(uint16_t* image)
+{
+    auto inverter = values(image, InverterModel);
+    auto mppt = values(image, MpptModel);
+
+    // the totals of all inverters, and the grid values of the first one
+    // which is reachable, as the inverters share the grid connection
+    float acCurrent = 0;
+    float voltage = NAN;
+    float frequency = NAN;
+    float temperature = NAN;
+    uint8_t module = 0;
+
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) { continue; }
+
+        auto stats = inv->Statistics();
+        bool valid = stats->getLastUpdate() > 0;
+
+        if (valid && inv->isReachable()) {
+            acCurrent += stats->getChannelFieldValue(TYPE_AC, CH0, FLD_IAC);
+            if (std::isnan(voltage)) {
+                voltage = stats->getChannelFieldValue(TYPE_AC, CH0, FLD_UAC);
+                frequency = stats->getChannelFieldValue(TYPE_AC, CH0, FLD_F);
+            }
+            float t = stats->getChannelFieldValue(TYPE_INV, CH0, FLD_T);
+            if (std::isnan(temperature) || t > temperature) { temperature = t; }
+        }
+
+        for (auto& c : stats->getChannelsByType(TYPE_DC)) {
+            if (module >= MpptModules) { break; }
+            auto target = mppt + Mppt::Modules + module++ * MpptModuleLength;
+
+            String name = String(inv->name()) + " " + String(static_cast<int>(c) + 1);
+            setString(target + Mppt::IDStr, Mppt::IDStrLength, name.c_str());
+
+            float power = valid ? stats->getChannelFieldValue(TYPE_DC, c, FLD_PDC) : NAN;
+            target[Mppt::DCA] = toUInt16(valid ? stats->getChannelFieldValue(TYPE_DC, c, FLD_IDC) : NAN, SF_CURRENT);
+            target[Mppt::DCV] = toUInt16(valid ? stats->getChannelFieldValue(TYPE_DC, c, FLD_UDC) : NAN, SF_VOLTAGE);
+            target[Mppt::DCW] = toUInt16(power, SF_POWER);
+            setAcc32(target + Mppt::DCWH, valid ? stats->getChannelFieldValue(TYPE_DC, c, FLD_YT) * 1000 : NAN, SF_ENERGY);
+            target[Mppt::DCSt] = !inv->isReachable() ? ST_OFF : (power > 0 ? ST_MPPT : ST_SLEEPING);
+        }
+    }
+
+    // modules of inverters which were removed
+    for (; module < MpptModules; ++module) {
+        auto target = mppt + Mppt::Modules + module * MpptModuleLength;
+        setString(target + Mppt::IDStr, Mppt::IDStrLength, "");
+        target[Mppt::DCA] = NA_UINT16;
+        target[Mppt::DCV] = NA_UINT16;
+        target[Mppt::DCW] = NA_UINT16;
+        setAcc32(target + Mppt::DCWH, NAN, SF_ENERGY);
+        target[Mppt::DCSt] = NA_ENUM16;
+    }
+
+    bool reachable = Datastore.getIsAtLeastOneReachable();
+    inverter[Inverter::A] = toUInt16(reachable ? acCurrent : NAN, SF_CURRENT);
+    inverter[Inverter::AphA] = inverter[Inverter::A];
+    inverter[Inverter::PhVphA] = toUInt16(voltage, SF_VOLTAGE);
+    inverter[Inverter::W] = toInt16(Datastore.getTotalAcPowerEnabled(), SF_POWER);
+    inverter[Inverter::Hz] = toUInt16(frequency, SF_FREQUENCY);
+    setAcc32(inverter + Inverter::WH, Datastore.getTotalAcYieldTotalEnabled() * 1000, SF_ENERGY);
+    inverter[Inverter::DCW] = toInt16(Datastore.getTotalDcPowerEnabled(), SF_POWER);
+    inverter[Inverter::TmpCab] = toInt16(temperature, SF_TEMPERATURE);
+    inverter[Inverter::St] = Datastore.getIsAtLeastOneProducing() ? ST_MPPT : (reachable ? ST_SLEEPING : ST_OFF);
+
+    auto battery = values(image, BatteryModel);
+    auto const& config = Configuration.get();
+    auto spStats = Battery.getStats();
+    bool enabled = config.Battery.Enabled;
+
+    battery[Bat::SoC] = toUInt16((enabled && spStats->isSoCValid()) ? spStats->getSoC() : NAN, SF_SOC);
+    battery[Bat::V] = toUInt16((enabled && spStats->isVoltageValid()) ? spStats->getVoltage() : NAN, SF_BAT_VOLTAGE);
+    battery[Bat::A] = toInt16((enabled && spStats->isCurrentValid()) ? spStats->getChargeCurrent() : NAN, SF_BAT_CURRENT);
+    battery[Bat::ADisChaMax] = toUInt16((enabled && spStats->isDischargeCurrentLimitValid())
+            ? spStats->getDischargeCurrentLimit() : NAN, SF_BAT_CURRENT);
+    battery[Bat::W] = toInt16((enabled && spStats->isVoltageValid() && spStats->isCurrentValid())
+            ? spStats->getVoltage() * spStats->getChargeCurrent() : NAN, SF_POWER);
+}
+
+} // namespace ModbusSunSpec
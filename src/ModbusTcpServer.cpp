@@ -0,0 +1,440 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "ModbusTcpServer.h"
+#include "MemoryPolicy.h"
+#include "MessageOutput.h"
+#include "ModbusSunSpec.h"
+#include "PowerLimiter.h"
+#include <Hoymiles.h>
+#include <TaskProfiler.h>
+#include <battery/Controller.h>
+#include <powermeter/Controller.h>
+#include <solarcharger/Controller.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+ModbusTcpServerClass ModbusTcpServer;
+
+namespace {
+
+constexpr uint16_t MAP_VERSION = 1;
+
+constexpr uint8_t FC_READ_HOLDING_REGISTERS = 0x03;
+constexpr uint8_t FC_READ_INPUT_REGISTERS = 0x04;
+constexpr uint8_t FC_WRITE_SINGLE_REGISTER = 0x06;
+constexpr uint8_t FC_WRITE_MULTIPLE_REGISTERS = 0x10;
+
+constexpr uint8_t EX_ILLEGAL_FUNCTION = 0x01;
+constexpr uint8_t EX_ILLEGAL_DATA_ADDRESS = 0x02;
+constexpr uint8_t EX_ILLEGAL_DATA_VALUE = 0x03;
+
+constexpr size_t MBAP_SIZE = 7;
+constexpr uint16_t MAX_READ_REGISTERS = 125;
+constexpr uint16_t MAX_WRITE_REGISTERS = 123;
+
+// the fields of an inverter block, each taking two registers starting at
+// InverterFields. the DC fields are repeated for each of the DC channels.
+struct InverterField {
+    ChannelType_t Type;
+    FieldId_t Field;
+};
+
+constexpr InverterField AC_FIELDS[] = {
+    { TYPE_AC, FLD_PAC },
+    { TYPE_AC, FLD_UAC },
+    { TYPE_AC, FLD_IAC },
+    { TYPE_AC, FLD_F },
+    { TYPE_AC, FLD_PF },
+    { TYPE_AC, FLD_Q },
+    { TYPE_INV, FLD_T },
+    { TYPE_INV, FLD_EFF },
+    { TYPE_INV, FLD_PDC },
+    { TYPE_INV, FLD_YD },
+    { TYPE_INV, FLD_YT },
+};
+
+constexpr FieldId_t DC_FIELDS[] = { FLD_UDC, FLD_IDC, FLD_PDC, FLD_YD, FLD_YT };
+constexpr uint8_t DC_CHANNELS = 6;
+
+constexpr size_t AC_FIELD_COUNT = sizeof(AC_FIELDS) / sizeof(AC_FIELDS[0]);
+constexpr size_t DC_FIELD_COUNT = sizeof(DC_FIELDS) / sizeof(DC_FIELDS[0]);
+static_assert(ModbusTcpServerClass::InverterFields + 2 * (AC_FIELD_COUNT + DC_CHANNELS * DC_FIELD_COUNT)
+        <= ModbusTcpServerClass::InverterBlockSize, "inverter fields exceed the block");
+
+uint16_t getUInt16(uint8_t const* data)
+{
+    return (static_cast<uint16_t>(data[0]) << 8) | data[1];
+}
+
+void putUInt16(uint8_t* data, uint16_t value)
+{
+    data[0] = value >> 8;
+    data[1] = value & 0xFF;
+}
+
+} // namespace
+
+ModbusTcpServerClass::ModbusTcpServerClass()
+    : _loopTask(TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("ModbusTcpServer::loop", std::bind(&ModbusTcpServerClass::loop, this)))
+{
+}
+
+void ModbusTcpServerClass::init(Scheduler& scheduler)
+{
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+void ModbusTcpServerClass::updateSettings()
+{
+    auto const& config = Configuration.get().Modbus;
+
+    _writeEnabled = config.WriteEnabled;
+
+    if (_server != nullptr) {
+        _server->end();
+        delete _server;
+        _server = nullptr;
+    }
+    _enabled = false;
+
+    if (!config.Enabled) { return; }
+
+    if (_registers == nullptr) {
+        _registers = static_cast<uint16_t*>(MemoryPolicy::allocateLarge(RegisterCount * sizeof(uint16_t)));
+        if (_registers == nullptr) {
+            MessageOutput.println("[ModbusTcpServer] Failed to allocate registers");
+            return;
+        }
+        memset(_registers, 0, RegisterCount * sizeof(uint16_t));
+    }
+
+    if (_sunspec == nullptr) {
+        _sunspec = static_cast<uint16_t*>(MemoryPolicy::allocateLarge(ModbusSunSpec::Size * sizeof(uint16_t)));
+        if (_sunspec == nullptr) {
+            MessageOutput.println("[ModbusTcpServer] Failed to allocate SunSpec registers");
+            return;
+        }
+        ModbusSunSpec::initialize(_sunspec);
+    }
+
+    refresh();
+
+    _server = new AsyncServer(config.Port);
+    _server->onClient([this](void*, AsyncClient* client) { onClient(client); }, nullptr);
+    _server->setNoDelay(true);
+    _server->begin();
+    _enabled = true;
+
+    MessageOutput.printf("[ModbusTcpServer] Listening on port %u%s\r\n",
+            config.Port, (config.WriteEnabled ? ", writing enabled" : ""));
+}
+
+void ModbusTcpServerClass::loop()
+{
+    auto generation = Configuration.getGeneration();
+    if (generation != _configGeneration) {
+        _configGeneration = generation;
+        updateSettings();
+    }
+
+    int mode = _pendingDplMode.exchange(NoPendingMode);
+    if (mode != NoPendingMode) {
+        MessageOutput.printf("[ModbusTcpServer] Setting DPL mode to %d\r\n", mode);
+        PowerLimiter.setMode(static_cast<PowerLimiterClass::Mode>(mode));
+    }
+
+    if (!_enabled) { return; }
+
+    refresh();
+}
+
+void ModbusTcpServerClass::setUInt32(uint16_t address, uint32_t value)
+{
+    _registers[address] = value >> 16;
+    _registers[address + 1] = value & 0xFFFF;
+}
+
+void ModbusTcpServerClass::setFloat(uint16_t address, float value)
+{
+    uint32_t raw;
+    static_assert(sizeof(raw) == sizeof(value), "float is not 32 bit wide");
+    memcpy(&raw, &value, sizeof(raw));
+    setUInt32(address, raw);
+}
+
+void ModbusTcpServerClass::setFloat(uint16_t address, std::optional<float> const& value)
+{
+    setFloat(address, value.value_or(NAN));
+}
+
+void ModbusTcpServerClass::refresh()
+{
+    auto const& config = Configuration.get();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _registers[MapVersion] = MAP_VERSION;
+    _registers[InverterCount] = Hoymiles.getNumInverters();
+    setUInt32(Uptime, esp_timer_get_time() / 1000000);
+    _registers[DplMode] = static_cast<uint16_t>(PowerLimiter.getMode());
+    setFloat(DplInverterOutput, static_cast<float>(PowerLimiter.getInverterOutput()));
+
+    bool powerMeter = config.PowerMeter.Enabled && PowerMeter.isDataValid();
+    _registers[PowerMeterValid] = powerMeter ? 1 : 0;
+    setFloat(PowerMeterPower, powerMeter ? PowerMeter.getPowerTotal() : NAN);
+
+    _registers[BatteryEnabled] = config.Battery.Enabled ? 1 : 0;
+    if (config.Battery.Enabled) {
+        auto spStats = Battery.getStats();
+        _registers[BatteryDataAge] = std::min<uint32_t>(spStats->getAgeSeconds(), UINT16_MAX);
+        setFloat(BatterySoc, spStats->isSoCValid() ? spStats->getSoC() : NAN);
+        setFloat(BatteryVoltage, spStats->isVoltageValid() ? spStats->getVoltage() : NAN);
+        setFloat(BatteryCurrent, spStats->isCurrentValid() ? spStats->getChargeCurrent() : NAN);
+        setFloat(BatteryPower, (spStats->isVoltageValid() && spStats->isCurrentValid())
+                ? spStats->getVoltage() * spStats->getChargeCurrent() : NAN);
+        setFloat(BatteryDischargeCurrentLimit, spStats->isDischargeCurrentLimitValid()
+                ? spStats->getDischargeCurrentLimit() : NAN);
+    } else {
+        _registers[BatteryDataAge] = UINT16_MAX;
+        for (uint16_t r = BatterySoc; r <= BatteryDischargeCurrentLimit; r += 2) { setFloat(r, NAN); }
+    }
+
+    _registers[SolarChargerEnabled] = config.SolarCharger.Enabled ? 1 : 0;
+    if (config.SolarCharger.Enabled) {
+        auto spStats = SolarCharger.getStats();
+        _registers[SolarChargerDataAge] = std::min<uint32_t>(spStats->getAgeMillis() / 1000, UINT16_MAX);
+        setFloat(SolarChargerOutputPower, spStats->getOutputPowerWatts());
+        setFloat(SolarChargerOutputVoltage, spStats->getOutputVoltage());
+        auto panelPower = spStats->getPanelPowerWatts();
+        setFloat(SolarChargerPanelPower, panelPower ? static_cast<float>(*panelPower) : NAN);
+        setFloat(SolarChargerYieldDay, spStats->getYieldDay());
+        setFloat(SolarChargerYieldTotal, spStats->getYieldTotal());
+    } else {
+        _registers[SolarChargerDataAge] = UINT16_MAX;
+        for (uint16_t r = SolarChargerOutputPower; r <= SolarChargerYieldTotal; r += 2) { setFloat(r, NAN); }
+    }
+
+    refreshInverters();
+
+    ModbusSunSpec::refresh(_sunspec);
+}
+
+void ModbusTcpServerClass::refreshInverters()
+{
+    for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
+        uint16_t base = InverterBase + i * InverterBlockSize;
+        auto inv = Hoymiles.getInverterByPos(i);
+
+        if (inv == nullptr) {
+            memset(_registers + base, 0, InverterBlockSize * sizeof(uint16_t));
+            continue;
+        }
+
+        uint64_t serial = inv->serial();
+        for (uint8_t w = 0; w < 4; ++w) {
+            _registers[base + InverterSerial + w] = (serial >> (48 - 16 * w)) & 0xFFFF;
+        }
+
+        auto stats = inv->Statistics();
+        uint32_t lastUpdate = stats->getLastUpdate();
+
+        _registers[base + InverterReachable] = inv->isReachable() ? 1 : 0;
+        _registers[base + InverterProducing] = inv->isProducing() ? 1 : 0;
+        _registers[base + InverterDataAge] = (lastUpdate == 0) ? UINT16_MAX
+            : std::min<uint32_t>((millis() - lastUpdate) / 1000, UINT16_MAX);
+        setFloat(base + InverterLimitRelative, inv->SystemConfigPara()->getLimitPercent());
+
+        auto value = [&](ChannelType_t type, ChannelNum_t channel, FieldId_t field) {
+            if (lastUpdate == 0 || !stats->hasChannelFieldValue(type, channel, field)) { return NAN; }
+            return stats->getChannelFieldValue(type, channel, field);
+        };
+
+        uint16_t address = base + InverterFields;
+        for (auto const& field : AC_FIELDS) {
+            setFloat(address, value(field.Type, CH0, field.Field));
+            address += 2;
+        }
+
+        for (uint8_t c = 0; c < DC_CHANNELS; ++c) {
+            for (auto field : DC_FIELDS) {
+                setFloat(address, value(TYPE_DC, static_cast<ChannelNum_t>(c), field));
+                address += 2;
+            }
+        }
+    }
+}
+
+void ModbusTcpServerClass::onClient(AsyncClient* client)
+{
+    // the callbacks run in the async_tcp task
+    if (!_enabled || _clients >= MaxClients) {
+        client->onDisconnect([](void*, AsyncClient* c) { delete c; });
+        client->close(true);
+        return;
+    }
+
+    ++_clients;
+    auto connection = new Connection();
+
+    client->setRxTimeout(IdleTimeoutSeconds);
+    client->setNoDelay(true);
+    client->onData([this, connection](void*, AsyncClient* c, void* data, size_t len) {
+        onData(c, *connection, static_cast<uint8_t const*>(data), len);
+    });
+    client->onTimeout([](void*, AsyncClient* c, uint32_t) { c->close(true); });
+    client->onDisconnect([this, connection](void*, AsyncClient* c) {
+        --_clients;
+        delete connection;
+        delete c;
+    });
+}
+
+void ModbusTcpServerClass::onData(AsyncClient* client, Connection& connection, uint8_t const* data, size_t len)
+{
+    if (!_enabled) {
+        client->close(true);
+        return;
+    }
+
+    // requests may be split across segments or arrive back to back
+    while (len > 0) {
+        size_t chunk = std::min(len, sizeof(connection.Buffer) - connection.Length);
+        memcpy(connection.Buffer + connection.Length, data, chunk);
+        connection.Length += chunk;
+        data += chunk;
+        len -= chunk;
+
+        while (connection.Length >= MBAP_SIZE) {
+            uint16_t protocol = getUInt16(connection.Buffer + 2);
+            uint16_t length = getUInt16(connection.Buffer + 4);
+
+            // the length includes the unit identifier and the function code
+            if (protocol != 0 || length < 2 || 6 + length > sizeof(connection.Buffer)) {
+                client->close(true);
+                return;
+            }
+
+            size_t frameLength = 6 + length;
+            if (connection.Length < frameLength) { break; }
+
+            uint8_t response[sizeof(Connection::Buffer)];
+            size_t responseLength = handleRequest(connection.Buffer, frameLength, response);
+            if (client->space() >= responseLength) {
+                client->add(reinterpret_cast<char const*>(response), responseLength);
+                client->send();
+            }
+
+            connection.Length -= frameLength;
+            memmove(connection.Buffer, connection.Buffer + frameLength, connection.Length);
+        }
+    }
+}
+
+size_t ModbusTcpServerClass::handleRequest(uint8_t const* request, size_t length, uint8_t* response)
+{
+    // the transaction and protocol identifiers and the unit identifier are
+    // echoed. any unit identifier is accepted.
+    memcpy(response, request, MBAP_SIZE);
+
+    uint8_t const* pdu = request + MBAP_SIZE;
+    size_t pduLength = length - MBAP_SIZE;
+    uint8_t* responsePdu = response + MBAP_SIZE;
+
+    size_t responsePduLength;
+    switch (pdu[0]) {
+    case FC_READ_HOLDING_REGISTERS:
+    case FC_READ_INPUT_REGISTERS:
+        responsePduLength = handleRead(pdu, pduLength, responsePdu);
+        break;
+    case FC_WRITE_SINGLE_REGISTER:
+    case FC_WRITE_MULTIPLE_REGISTERS:
+        responsePduLength = handleWrite(pdu, pduLength, responsePdu);
+        break;
+    default:
+        responsePduLength = exception(pdu[0], EX_ILLEGAL_FUNCTION, responsePdu);
+        break;
+    }
+
+    putUInt16(response + 4, responsePduLength + 1);
+    return MBAP_SIZE + responsePduLength;
+}
+
+size_t ModbusTcpServerClass::exception(uint8_t function, uint8_t code, uint8_t* response)
+{
+    response[0] = function | 0x80;
+    response[1] = code;
+    return 2;
+}
+
+size_t ModbusTcpServerClass::handleRead(uint8_t const* pdu, size_t length, uint8_t* response)
+{
+    if (length != 5) { return exception(pdu[0], EX_ILLEGAL_DATA_VALUE, response); }
+
+    uint16_t address = getUInt16(pdu + 1);
+    uint16_t quantity = getUInt16(pdu + 3);
+
+    if (quantity == 0 || quantity > MAX_READ_REGISTERS) {
+        return exception(pdu[0], EX_ILLEGAL_DATA_VALUE, response);
+    }
+
+    // the SunSpec map is a separate image, a read must not span both
+    uint16_t const* image = _registers;
+    uint32_t end = static_cast<uint32_t>(address) + quantity;
+    if (address >= ModbusSunSpec::BaseAddress) {
+        if (end > ModbusSunSpec::BaseAddress + ModbusSunSpec::Size) {
+            return exception(pdu[0], EX_ILLEGAL_DATA_ADDRESS, response);
+        }
+        image = _sunspec;
+        address -= ModbusSunSpec::BaseAddress;
+    } else if (end > RegisterCount) {
+        return exception(pdu[0], EX_ILLEGAL_DATA_ADDRESS, response);
+    }
+
+    response[0] = pdu[0];
+    response[1] = quantity * 2;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (uint16_t i = 0; i < quantity; ++i) {
+        putUInt16(response + 2 + 2 * i, image[address + i]);
+    }
+
+    return 2 + quantity * 2;
+}
+
+size_t ModbusTcpServerClass::handleWrite(uint8_t const* pdu, size_t length, uint8_t* response)
+{
+    if (!_writeEnabled) { return exception(pdu[0], EX_ILLEGAL_FUNCTION, response); }
+
+    uint16_t address = getUInt16(pdu + 1);
+    uint16_t quantity = 1;
+    uint8_t const* values = pdu + 3;
+
+    if (pdu[0] == FC_WRITE_MULTIPLE_REGISTERS) {
+        if (length < 6) { return exception(pdu[0], EX_ILLEGAL_DATA_VALUE, response); }
+        quantity = getUInt16(pdu + 3);
+        if (quantity == 0 || quantity > MAX_WRITE_REGISTERS
+                || pdu[5] != quantity * 2 || length != 6 + quantity * 2u) {
+            return exception(pdu[0], EX_ILLEGAL_DATA_VALUE, response);
+        }
+        values = pdu + 6;
+    } else if (length != 5) {
+        return exception(pdu[0], EX_ILLEGAL_DATA_VALUE, response);
+    }
+
+    // the DPL mode is the only writable register
+    if (address != DplMode || quantity != 1) {
+        return exception(pdu[0], EX_ILLEGAL_DATA_ADDRESS, response);
+    }
+
+    uint16_t mode = getUInt16(values);
+    if (mode > static_cast<uint16_t>(PowerLimiterClass::Mode::UnconditionalFullSolarPassthrough)) {
+        return exception(pdu[0], EX_ILLEGAL_DATA_VALUE, response);
+    }
+
+    _pendingDplMode = mode;
+
+    // the response echoes the address and the value or quantity
+    memcpy(response, pdu, 5);
+    return 5;
+}
@@ -6,13 +6,15 @@
 #include "Configuration.h"
 #include "MqttSettings.h"
 #include "NetworkSettings.h"
+#include "NightMode.h"
 #include <Hoymiles.h>
 #include <CpuTemperature.h>
+#include "TaskProfiler.h"
 
 MqttHandleDtuClass MqttHandleDtu;
 
 MqttHandleDtuClass::MqttHandleDtuClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MqttHandleDtuClass::loop, this))
+    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, TaskProfiler.wrap("MqttHandleDtu::loop", std::bind(&MqttHandleDtuClass::loop, this)))
 {
 }
 
@@ -21,31 +23,33 @@ void MqttHandleDtuClass::init(Scheduler& scheduler)
     scheduler.addTask(_loopTask);
     _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
     _loopTask.enable();
+    NightMode.addIdleTask(_loopTask);
 }
 
 void MqttHandleDtuClass::loop()
 {
     _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
 
-    if (!MqttSettings.getConnected() || !Hoymiles.isAllRadioIdle()) {
+    if (!MqttSettings.acceptsPublishes() || !Hoymiles.isAllRadioIdle()) {
         _loopTask.forceNextIteration();
         return;
     }
 
-    MqttSettings.publish("dtu/uptime", String(esp_timer_get_time() / 1000000));
-    MqttSettings.publish("dtu/ip", NetworkSettings.localIP().toString());
-    MqttSettings.publish("dtu/hostname", NetworkSettings.getHostname());
-    MqttSettings.publish("dtu/heap/size", String(ESP.getHeapSize()));
-    MqttSettings.publish("dtu/heap/free", String(ESP.getFreeHeap()));
-    MqttSettings.publish("dtu/heap/minfree", String(ESP.getMinFreeHeap()));
-    MqttSettings.publish("dtu/heap/maxalloc", String(ESP.getMaxAllocHeap()));
+    auto& topics = MqttTopicRegistry;
+    MqttSettings.publish(topics.intern("dtu/uptime"), esp_timer_get_time() / 1000000, 0);
+    MqttSettings.publish(topics.intern("dtu/ip"), NetworkSettings.localIP().toString().c_str());
+    MqttSettings.publish(topics.intern("dtu/hostname"), NetworkSettings.getHostname().c_str());
+    MqttSettings.publish(topics.intern("dtu/heap/size"), ESP.getHeapSize(), 0);
+    MqttSettings.publish(topics.intern("dtu/heap/free"), ESP.getFreeHeap(), 0);
+    MqttSettings.publish(topics.intern("dtu/heap/minfree"), ESP.getMinFreeHeap(), 0);
+    MqttSettings.publish(topics.intern("dtu/heap/maxalloc"), ESP.getMaxAllocHeap(), 0);
     if (NetworkSettings.NetworkMode() == network_mode::WiFi) {
-        MqttSettings.publish("dtu/rssi", String(WiFi.RSSI()));
-        MqttSettings.publish("dtu/bssid", WiFi.BSSIDstr());
+        MqttSettings.publish(topics.intern("dtu/rssi"), WiFi.RSSI(), 0);
+        MqttSettings.publish(topics.intern("dtu/bssid"), WiFi.BSSIDstr().c_str());
     }
 
     float temperature = CpuTemperature.read();
     if (!std::isnan(temperature)) {
-        MqttSettings.publish("dtu/temperature", String(temperature));
+        MqttSettings.publish(topics.intern("dtu/temperature"), temperature, 2);
     }
 }
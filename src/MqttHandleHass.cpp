@@ -3,17 +3,24 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "MqttHandleHass.h"
+#include "MemoryPolicy.h"
 #include "MqttHandleInverter.h"
+#include "MqttHassPublisher.h"
 #include "MqttSettings.h"
 #include "NetworkSettings.h"
 #include "Utils.h"
 #include "__compiled_constants.h"
 #include "defaults.h"
+#include "TaskProfiler.h"
 
 MqttHandleHassClass MqttHandleHass;
 
+MqttHandleHassClass::Output MqttHandleHassClass::_output = MqttHandleHassClass::Output::Entity;
+String* MqttHandleHassClass::_pDevicePayload = nullptr;
+size_t MqttHandleHassClass::_componentCount = 0;
+
 MqttHandleHassClass::MqttHandleHassClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MqttHandleHassClass::loop, this))
+    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, TaskProfiler.wrap("MqttHandleHass::loop", std::bind(&MqttHandleHassClass::loop, this)))
 {
 }
 
@@ -47,7 +54,9 @@ void MqttHandleHassClass::forceUpdate()
 
 void MqttHandleHassClass::publishConfig()
 {
-    if (!Configuration.get().Mqtt.Hass.Enabled) {
+    const CONFIG_T& config = Configuration.get();
+
+    if (!config.Mqtt.Hass.Enabled) {
         return;
     }
 
@@ -55,66 +64,203 @@ void MqttHandleHassClass::publishConfig()
         return;
     }
 
-    const CONFIG_T& config = Configuration.get();
-
-    // publish DTU sensors
-    publishDtuSensor("IP", "dtu/ip", "", "mdi:network-outline", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
-    publishDtuSensor("WiFi Signal", "dtu/rssi", "dBm", "", DEVICE_CLS_SIGNAL_STRENGTH, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
-    publishDtuSensor("Uptime", "dtu/uptime", "s", "", DEVICE_CLS_DURATION, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
-    publishDtuSensor("Temperature", "dtu/temperature", "°C", "", DEVICE_CLS_TEMPERATURE, STATE_CLS_MEASUREMENT, CATEGORY_DIAGNOSTIC);
-    publishDtuSensor("Heap Size", "dtu/heap/size", "Bytes", "mdi:memory", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
-    publishDtuSensor("Heap Free", "dtu/heap/free", "Bytes", "mdi:memory", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
-    publishDtuSensor("Largest Free Heap Block", "dtu/heap/maxalloc", "Bytes", "mdi:memory", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
-    publishDtuSensor("Lifetime Minimum Free Heap", "dtu/heap/minfree", "Bytes", "mdi:memory", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
+    // a previous update which is still pending is superseded
+    MqttHassPublisher.cancel(this);
+
+    const bool deviceDiscovery = config.Mqtt.Hass.DeviceDiscovery;
+
+    Emit enqueueEntity = [this](MqttHassPublisherClass::Generator&& generator) {
+        enqueue(std::move(generator));
+    };
+
+    // the messages of the mode used before are removed, such that Home
+    // Assistant does not know each entity twice. the unique ids are the same
+    // in both modes, so the entities keep their history.
+    if (_oDeviceDiscovery.has_value() && *_oDeviceDiscovery != deviceDiscovery) {
+        if (deviceDiscovery) {
+            Emit clearEntity = [this](MqttHassPublisherClass::Generator&& generator) {
+                enqueue([generator = std::move(generator)] {
+                    _output = Output::Clear;
+                    generator();
+                    _output = Output::Entity;
+                });
+            };
+
+            addDtuEntities(clearEntity);
+            for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+                addInverterEntities(Hoymiles.getInverterByPos(i), clearEntity);
+            }
+        } else {
+            enqueue([] { publish("device/" + getDtuUniqueId() + "/config", ""); });
+            for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+                auto inv = Hoymiles.getInverterByPos(i);
+                enqueue([inv] { publish("device/dtu_" + inv->serialString() + "/config", ""); });
+            }
+        }
+    }
+    _oDeviceDiscovery = deviceDiscovery;
 
-    publishDtuSensor("Yield Total", "ac/yieldtotal", "kWh", "", DEVICE_CLS_ENERGY, STATE_CLS_TOTAL_INCREASING, CATEGORY_NONE);
-    publishDtuSensor("Yield Day", "ac/yieldday", "Wh", "", DEVICE_CLS_ENERGY, STATE_CLS_TOTAL_INCREASING, CATEGORY_NONE);
-    publishDtuSensor("AC Power", "ac/power", "W", "", DEVICE_CLS_PWR, STATE_CLS_MEASUREMENT, CATEGORY_NONE);
-    publishDtuSensor("DC Power", "dc/power", "W", "", DEVICE_CLS_PWR, STATE_CLS_MEASUREMENT, CATEGORY_NONE);  
+    if (!deviceDiscovery) {
+        addDtuEntities(enqueueEntity);
+        for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+            addInverterEntities(Hoymiles.getInverterByPos(i), enqueueEntity);
+        }
+        return;
+    }
 
-    publishDtuBinarySensor("Status", config.Mqtt.Lwt.Topic, config.Mqtt.Lwt.Value_Online, config.Mqtt.Lwt.Value_Offline, DEVICE_CLS_CONNECTIVITY, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
+    enqueue([] { publishDevice(getDtuUniqueId(), &createDtuInfo, &addDtuEntities); });
 
-    // Loop all inverters
     for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
         auto inv = Hoymiles.getInverterByPos(i);
+        enqueue([inv] {
+            publishDevice("dtu_" + inv->serialString(),
+                [inv](JsonDocument& doc) { createInverterInfo(doc, inv); },
+                [inv](const Emit& emit) { addInverterEntities(inv, emit); });
+        });
+    }
+}
+
+void MqttHandleHassClass::addDtuEntities(const Emit& emit)
+{
+    emit([] { publishDtuSensor("IP", "dtu/ip", "", "mdi:network-outline", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC); });
+    emit([] { publishDtuSensor("WiFi Signal", "dtu/rssi", "dBm", "", DEVICE_CLS_SIGNAL_STRENGTH, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC); });
+    emit([] { publishDtuSensor("Uptime", "dtu/uptime", "s", "", DEVICE_CLS_DURATION, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC); });
+    emit([] { publishDtuSensor("Temperature", "dtu/temperature", "°C", "", DEVICE_CLS_TEMPERATURE, STATE_CLS_MEASUREMENT, CATEGORY_DIAGNOSTIC); });
+    emit([] { publishDtuSensor("Heap Size", "dtu/heap/size", "Bytes", "mdi:memory", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC); });
+    emit([] { publishDtuSensor("Heap Free", "dtu/heap/free", "Bytes", "mdi:memory", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC); });
+    emit([] { publishDtuSensor("Largest Free Heap Block", "dtu/heap/maxalloc", "Bytes", "mdi:memory", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC); });
+    emit([] { publishDtuSensor("Lifetime Minimum Free Heap", "dtu/heap/minfree", "Bytes", "mdi:memory", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC); });
+
+    emit([] { publishDtuSensor("Yield Total", "ac/yieldtotal", "kWh", "", DEVICE_CLS_ENERGY, STATE_CLS_TOTAL_INCREASING, CATEGORY_NONE); });
+    emit([] { publishDtuSensor("Yield Day", "ac/yieldday", "Wh", "", DEVICE_CLS_ENERGY, STATE_CLS_TOTAL_INCREASING, CATEGORY_NONE); });
+    emit([] { publishDtuSensor("AC Power", "ac/power", "W", "", DEVICE_CLS_PWR, STATE_CLS_MEASUREMENT, CATEGORY_NONE); });
+    emit([] { publishDtuSensor("DC Power", "dc/power", "W", "", DEVICE_CLS_PWR, STATE_CLS_MEASUREMENT, CATEGORY_NONE); });
+
+    emit([] {
+        const CONFIG_T& config = Configuration.get();
+        publishDtuBinarySensor("Status", config.Mqtt.Lwt.Topic, config.Mqtt.Lwt.Value_Online, config.Mqtt.Lwt.Value_Offline, DEVICE_CLS_CONNECTIVITY, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
+    });
+}
 
-        publishInverterButton(inv, "Turn Inverter Off", "cmd/power", "0", "mdi:power-plug-off", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_CONFIG);
-        publishInverterButton(inv, "Turn Inverter On", "cmd/power", "1", "mdi:power-plug", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_CONFIG);
-        publishInverterButton(inv, "Restart Inverter", "cmd/restart", "1", "", DEVICE_CLS_RESTART, STATE_CLS_NONE, CATEGORY_CONFIG);
-        publishInverterButton(inv, "Reset Radio Statistics", "cmd/reset_rf_stats", "1", "", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_CONFIG);
-
-        publishInverterNumber(inv, "Limit NonPersistent Relative", "status/limit_relative", "cmd/limit_nonpersistent_relative", 0, 100, 0.1, "%", "mdi:speedometer", STATE_CLS_NONE, CATEGORY_CONFIG);
-        publishInverterNumber(inv, "Limit Persistent Relative", "status/limit_relative", "cmd/limit_persistent_relative", 0, 100, 0.1, "%", "mdi:speedometer", STATE_CLS_NONE, CATEGORY_CONFIG);
-
-        publishInverterNumber(inv, "Limit NonPersistent Absolute", "status/limit_absolute", "cmd/limit_nonpersistent_absolute", 0, MAX_INVERTER_LIMIT, 1, "W", "mdi:speedometer", STATE_CLS_NONE, CATEGORY_CONFIG);
-        publishInverterNumber(inv, "Limit Persistent Absolute", "status/limit_absolute", "cmd/limit_persistent_absolute", 0, MAX_INVERTER_LIMIT, 1, "W", "mdi:speedometer", STATE_CLS_NONE, CATEGORY_CONFIG);
-
-        publishInverterBinarySensor(inv, "Reachable", "status/reachable", "1", "0", DEVICE_CLS_CONNECTIVITY, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
-        publishInverterBinarySensor(inv, "Producing", "status/producing", "1", "0", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_NONE);
-
-        publishInverterSensor(inv, "TX Requests", "radio/tx_request", "", "", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
-        publishInverterSensor(inv, "RX Success", "radio/rx_success", "", "", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
-        publishInverterSensor(inv, "RX Fail Receive Nothing", "radio/rx_fail_nothing", "", "", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
-        publishInverterSensor(inv, "RX Fail Receive Partial", "radio/rx_fail_partial", "", "", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
-        publishInverterSensor(inv, "RX Fail Receive Corrupt", "radio/rx_fail_corrupt", "", "", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
-        publishInverterSensor(inv, "TX Re-Request Fragment", "radio/tx_re_request", "", "", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
-        publishInverterSensor(inv, "RSSI", "radio/rssi", "dBm", "", DEVICE_CLS_SIGNAL_STRENGTH, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
-
-        // Loop all channels
-        for (auto& t : inv->Statistics()->getChannelTypes()) {
-            for (auto& c : inv->Statistics()->getChannelsByType(t)) {
-                for (uint8_t f = 0; f < DEVICE_CLS_ASSIGN_LIST_LEN; f++) {
-                    bool clear = false;
-                    if (t == TYPE_DC && !config.Mqtt.Hass.IndividualPanels) {
-                        clear = true;
-                    }
-                    publishInverterField(inv, t, c, deviceFieldAssignment[f], clear);
+void MqttHandleHassClass::addInverterEntities(std::shared_ptr<InverterAbstract> inv, const Emit& emit)
+{
+    emit([inv] { publishInverterButton(inv, "Turn Inverter Off", "cmd/power", "0", "mdi:power-plug-off", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_CONFIG); });
+    emit([inv] { publishInverterButton(inv, "Turn Inverter On", "cmd/power", "1", "mdi:power-plug", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_CONFIG); });
+    emit([inv] { publishInverterButton(inv, "Restart Inverter", "cmd/restart", "1", "", DEVICE_CLS_RESTART, STATE_CLS_NONE, CATEGORY_CONFIG); });
+    emit([inv] { publishInverterButton(inv, "Reset Radio Statistics", "cmd/reset_rf_stats", "1", "", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_CONFIG); });
+
+    emit([inv] { publishInverterNumber(inv, "Limit NonPersistent Relative", "status/limit_relative", "cmd/limit_nonpersistent_relative", 0, 100, 0.1, "%", "mdi:speedometer", STATE_CLS_NONE, CATEGORY_CONFIG); });
+    emit([inv] { publishInverterNumber(inv, "Limit Persistent Relative", "status/limit_relative", "cmd/limit_persistent_relative", 0, 100, 0.1, "%", "mdi:speedometer", STATE_CLS_NONE, CATEGORY_CONFIG); });
+
+    emit([inv] { publishInverterNumber(inv, "Limit NonPersistent Absolute", "status/limit_absolute", "cmd/limit_nonpersistent_absolute", 0, MAX_INVERTER_LIMIT, 1, "W", "mdi:speedometer", STATE_CLS_NONE, CATEGORY_CONFIG); });
+    emit([inv] { publishInverterNumber(inv, "Limit Persistent Absolute", "status/limit_absolute", "cmd/limit_persistent_absolute", 0, MAX_INVERTER_LIMIT, 1, "W", "mdi:speedometer", STATE_CLS_NONE, CATEGORY_CONFIG); });
+
+    emit([inv] { publishInverterBinarySensor(inv, "Reachable", "status/reachable", "1", "0", DEVICE_CLS_CONNECTIVITY, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC); });
+    emit([inv] { publishInverterBinarySensor(inv, "Producing", "status/producing", "1", "0", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_NONE); });
+
+    emit([inv] { publishInverterSensor(inv, "TX Requests", "radio/tx_request", "", "", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC); });
+    emit([inv] { publishInverterSensor(inv, "RX Success", "radio/rx_success", "", "", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC); });
+    emit([inv] { publishInverterSensor(inv, "RX Fail Receive Nothing", "radio/rx_fail_nothing", "", "", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC); });
+    emit([inv] { publishInverterSensor(inv, "RX Fail Receive Partial", "radio/rx_fail_partial", "", "", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC); });
+    emit([inv] { publishInverterSensor(inv, "RX Fail Receive Corrupt", "radio/rx_fail_corrupt", "", "", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC); });
+    emit([inv] { publishInverterSensor(inv, "TX Re-Request Fragment", "radio/tx_re_request", "", "", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC); });
+    emit([inv] { publishInverterSensor(inv, "RSSI", "radio/rssi", "dBm", "", DEVICE_CLS_SIGNAL_STRENGTH, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC); });
+
+    const CONFIG_T& config = Configuration.get();
+
+    // Loop all channels
+    for (auto& t : inv->Statistics()->getChannelTypes()) {
+        for (auto& c : inv->Statistics()->getChannelsByType(t)) {
+            for (uint8_t f = 0; f < DEVICE_CLS_ASSIGN_LIST_LEN; f++) {
+                // keeps the queue short, the generator checks again
+                if (!inv->Statistics()->hasChannelFieldValue(t, c, deviceFieldAssignment[f].fieldId)) {
+                    continue;
+                }
+
+                bool clear = false;
+                if (t == TYPE_DC && !config.Mqtt.Hass.IndividualPanels) {
+                    clear = true;
                 }
+                emit([inv, t, c, f, clear] { publishInverterField(inv, t, c, deviceFieldAssignment[f], clear); });
             }
         }
     }
 }
 
+void MqttHandleHassClass::publishDevice(const String& nodeId, const DeviceInfo& createInfo, const Entities& addEntities)
+{
+    std::vector<MqttHassPublisherClass::Generator> generators;
+    addEntities([&generators](MqttHassPublisherClass::Generator&& generator) {
+        generators.push_back(std::move(generator));
+    });
+
+    JsonDocument root(MemoryPolicy::jsonAllocator());
+    createInfo(root);
+
+    auto origin = root["o"].to<JsonObject>();
+    origin["name"] = "OpenDTU-OnBattery";
+    origin["sw"] = __COMPILED_GIT_HASH__;
+
+    if (!Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) {
+        return;
+    }
+
+    // the components are appended to the message one by one, such that only
+    // the document of a single entity exists at any time.
+    String payload;
+    payload.reserve(measureJson(root) + generators.size() * 256);
+    serializeJson(root, payload);
+    payload.remove(payload.length() - 1); // closing brace
+    payload += ",\"cmps\":{";
+
+    _pDevicePayload = &payload;
+    _componentCount = 0;
+    _output = Output::Component;
+
+    for (auto const& generator : generators) {
+        generator();
+    }
+
+    _output = Output::Entity;
+    _pDevicePayload = nullptr;
+
+    payload += "}}";
+
+    publish("device/" + nodeId + "/config", payload);
+}
+
+void MqttHandleHassClass::addComponent(const String& subtopic, JsonDocument& doc)
+{
+    // the subtopic reads "<platform>/<node id>/<object id>/config"
+    const int platformEnd = subtopic.indexOf('/');
+    const int objectEnd = subtopic.lastIndexOf('/');
+    const int objectStart = subtopic.lastIndexOf('/', objectEnd - 1) + 1;
+    if (platformEnd <= 0 || objectStart <= platformEnd || objectEnd <= objectStart) {
+        return;
+    }
+
+    // the device block is shared by all components
+    doc.remove("dev");
+    doc["p"] = subtopic.substring(0, platformEnd);
+
+    if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
+        return;
+    }
+
+    String component;
+    serializeJson(doc, component);
+
+    *_pDevicePayload += (_componentCount++ > 0) ? ",\"" : "\"";
+    *_pDevicePayload += subtopic.substring(objectStart, objectEnd);
+    *_pDevicePayload += "\":";
+    *_pDevicePayload += component;
+}
+
+void MqttHandleHassClass::enqueue(MqttHassPublisherClass::Generator&& generator)
+{
+    MqttHassPublisher.enqueue(this, std::move(generator));
+}
+
 void MqttHandleHassClass::publishInverterField(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const byteAssign_fieldDeviceClass_t fieldType, const bool clear)
 {
     if (!inv->Statistics()->hasChannelFieldValue(type, channel, fieldType.fieldId)) {
@@ -143,7 +289,14 @@ void MqttHandleHassClass::publishInverterField(std::shared_ptr<InverterAbstract>
         + "/config";
 
     if (!clear) {
-        const String stateTopic = MqttSettings.getPrefix() + MqttHandleInverter.getTopic(inv, type, channel, fieldType.fieldId);
+        const auto& config = Configuration.get();
+
+        String stateTopic;
+        if (config.Mqtt.InverterJsonPayload) {
+            stateTopic = MqttSettings.getPrefix() + MqttHandleInverter.getJsonTopic(inv);
+        } else {
+            stateTopic = MqttSettings.getPrefix() + MqttHandleInverter.getTopic(inv, type, channel, fieldType.fieldId);
+        }
 
         String name;
         if (type != TYPE_DC) {
@@ -154,7 +307,7 @@ void MqttHandleHassClass::publishInverterField(std::shared_ptr<InverterAbstract>
 
         String unit_of_measure = inv->Statistics()->getChannelFieldUnit(type, channel, fieldType.fieldId);
 
-        JsonDocument root;
+        JsonDocument root(MemoryPolicy::jsonAllocator());
         createInverterInfo(root, inv);
         addCommonMetadata(root, unit_of_measure, "", fieldType.deviceClsId, fieldType.stateClsId, CATEGORY_NONE);
 
@@ -162,8 +315,17 @@ void MqttHandleHassClass::publishInverterField(std::shared_ptr<InverterAbstract>
         root["stat_t"] = stateTopic;
         root["uniq_id"] = serial + "_ch" + chanNum + "_" + fieldName;
 
-        if (Configuration.get().Mqtt.Hass.Expire) {
-            root["exp_aft"] = Hoymiles.getNumInverters() * max<uint32_t>(Hoymiles.PollInterval()/1000U, Configuration.get().Mqtt.PublishInterval) * inv->getReachableThreshold();
+        if (config.Mqtt.InverterJsonPayload) {
+            String key = fieldName;
+            key.toLowerCase();
+            root["val_tpl"] = "{{ value_json['" + chanNum + "']['" + key + "'] }}";
+        }
+
+        if (config.Mqtt.Hass.Expire) {
+            // unchanged values are only re-published once per refresh interval
+            root["exp_aft"] = max<uint32_t>(
+                Hoymiles.getNumInverters() * max<uint32_t>(Hoymiles.PollInterval()/1000U, config.Mqtt.PublishInterval) * inv->getReachableThreshold(),
+                config.Mqtt.PublishRefreshInterval * 2);
         }
 
         publish(configTopic, root);
@@ -189,7 +351,7 @@ void MqttHandleHassClass::publishInverterButton(
 
     const String cmdTopic = MqttSettings.getPrefix() + serial + "/" + state_topic;
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::jsonAllocator());
     createInverterInfo(root, inv);
     addCommonMetadata(root, "", icon, device_class, state_class, category);
 
@@ -221,7 +383,7 @@ void MqttHandleHassClass::publishInverterNumber(
     const String cmdTopic = MqttSettings.getPrefix() + serial + "/" + command_topic;
     const String statTopic = MqttSettings.getPrefix() + serial + "/" + stateTopic;
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::jsonAllocator());
     createInverterInfo(root, inv);
     addCommonMetadata(root, unit_of_measure, icon, DEVICE_CLS_NONE, state_class, category);
 
@@ -293,14 +455,26 @@ String MqttHandleHassClass::getDtuUrl()
 
 void MqttHandleHassClass::publish(const String& subtopic, const String& payload)
 {
-    String topic = Configuration.get().Mqtt.Hass.Topic;
-    topic += subtopic;
-    MqttSettings.publishGeneric(topic, payload, Configuration.get().Mqtt.Hass.Retain);
-    yield();
+    // entities which are cleared are simply not part of a device message
+    if (_output == Output::Component) {
+        return;
+    }
+
+    MqttHassPublisher.publish(subtopic, payload);
 }
 
-void MqttHandleHassClass::publish(const String& subtopic, const JsonDocument& doc)
+void MqttHandleHassClass::publish(const String& subtopic, JsonDocument& doc)
 {
+    if (_output == Output::Component) {
+        addComponent(subtopic, doc);
+        return;
+    }
+
+    if (_output == Output::Clear) {
+        publish(subtopic, "");
+        return;
+    }
+
     if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
         return;
     }
@@ -358,7 +532,7 @@ void MqttHandleHassClass::publishDtuBinarySensor(
 {
     const String dtuId = getDtuUniqueId();
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::jsonAllocator());
     createDtuInfo(root);
     publishBinarySensor(root, dtuId, dtuId, name, state_topic, payload_on, payload_off, device_class, state_class, category);
 }
@@ -369,7 +543,7 @@ void MqttHandleHassClass::publishInverterBinarySensor(
 {
     const String serial = inv->serialString();
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::jsonAllocator());
     createInverterInfo(root, inv);
     publishBinarySensor(root, "dtu_" + serial, serial, name, serial + "/" + state_topic, payload_on, payload_off, device_class, state_class, category);
 }
@@ -406,7 +580,7 @@ void MqttHandleHassClass::publishDtuSensor(
 {
     const String dtuId = getDtuUniqueId();
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::jsonAllocator());
     createDtuInfo(root);
     publishSensor(root, dtuId, dtuId, name, state_topic, unit_of_measure, icon, device_class, state_class, category);
 }
@@ -418,7 +592,7 @@ void MqttHandleHassClass::publishInverterSensor(
 {
     const String serial = inv->serialString();
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::jsonAllocator());
     createInverterInfo(root, inv);
     publishSensor(root, "dtu_" + serial, serial, name, serial + "/" + state_topic, unit_of_measure, icon, device_class, state_class, category);
 }
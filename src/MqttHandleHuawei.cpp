@@ -5,16 +5,18 @@
 #include "MqttHandleHuawei.h"
 #include "MessageOutput.h"
 #include "MqttSettings.h"
+#include "NightMode.h"
 #include <gridcharger/huawei/Controller.h>
 #include "WebApi_Huawei.h"
 #include <ctime>
+#include "TaskProfiler.h"
 
 MqttHandleHuaweiClass MqttHandleHuawei;
 
 void MqttHandleHuaweiClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&MqttHandleHuaweiClass::loop, this));
+    _loopTask.setCallback(TaskProfiler.wrap("MqttHandleHuawei::loop", std::bind(&MqttHandleHuaweiClass::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
 
@@ -58,19 +60,14 @@ void MqttHandleHuaweiClass::loop()
 {
     const CONFIG_T& config = Configuration.get();
 
-    std::unique_lock<std::mutex> mqttLock(_mqttMutex);
-
     if (!config.Huawei.Enabled) {
-        _mqttCallbacks.clear();
+        _commands.clear();
         return;
     }
 
-    for (auto& callback : _mqttCallbacks) { callback(); }
-    _mqttCallbacks.clear();
-
-    mqttLock.unlock();
+    _commands.execute([this](Command const& command) { execute(command); });
 
-    if (!MqttSettings.getConnected() ) {
+    if (!MqttSettings.acceptsPublishes() ) {
         return;
     }
 
@@ -84,7 +81,7 @@ void MqttHandleHuaweiClass::loop()
     { \
         auto oDataPoint = dataPoints.get<GridCharger::Huawei::DataPointLabel::l>(); \
         if (oDataPoint) { \
-            MqttSettings.publish("huawei/" t, String(*oDataPoint)); \
+            MqttSettings.publish(MqttTopicRegistry.intern("huawei/" t), *oDataPoint, 2); \
         } \
     }
 
@@ -100,8 +97,31 @@ void MqttHandleHuaweiClass::loop()
     PUB(Efficiency, "efficiency");
 #undef PUB
 
-    MqttSettings.publish("huawei/data_age", String((millis() - dataPoints.getLastUpdate()) / 1000));
-    MqttSettings.publish("huawei/mode", String(HuaweiCan.getMode()));
+    // the values of the individual units, if there are several
+    static constexpr char const* units[] = { "huawei/unit1/", "huawei/unit2/", "huawei/unit3/" };
+    static_assert(sizeof(units) / sizeof(units[0]) == GridCharger::Huawei::HardwareInterface::MaxUnits);
+
+    uint8_t unitCount = HuaweiCan.getUnitCount();
+    for (uint8_t unit = 0; unitCount > 1 && unit < unitCount; ++unit) {
+        auto const& unitDataPoints = HuaweiCan.getUnitDataPoints(unit);
+
+#define PUB(l, t) \
+    { \
+        auto oDataPoint = unitDataPoints.get<GridCharger::Huawei::DataPointLabel::l>(); \
+        if (oDataPoint) { \
+            MqttSettings.publish(MqttTopicRegistry.intern(units[unit], t), *oDataPoint, 2); \
+        } \
+    }
+
+        PUB(OutputCurrent, "output_current");
+        PUB(OutputPower, "output_power");
+        PUB(OutputTemperature, "output_temp");
+        PUB(Efficiency, "efficiency");
+#undef PUB
+    }
+
+    MqttSettings.publish(MqttTopicRegistry.intern("huawei/data_age"), (millis() - dataPoints.getLastUpdate()) / 1000, 0);
+    MqttSettings.publish(MqttTopicRegistry.intern("huawei/mode"), HuaweiCan.getMode(), 0);
 
     _lastPublish = millis();
 }
@@ -112,6 +132,8 @@ void MqttHandleHuaweiClass::onMqttMessage(Topic t,
         const char* topic, const uint8_t* payload, size_t len,
         size_t index, size_t total)
 {
+    NightMode.notifyActivity();
+
     std::string strValue(reinterpret_cast<const char*>(payload), len);
     float payload_val = -1;
     try {
@@ -123,58 +145,55 @@ void MqttHandleHuaweiClass::onMqttMessage(Topic t,
         return;
     }
 
-    std::lock_guard<std::mutex> mqttLock(_mqttMutex);
+    _commands.push({ t, payload_val });
+}
+
+void MqttHandleHuaweiClass::execute(Command const& command)
+{
+    float const payload_val = command.Value;
     using Setting = GridCharger::Huawei::HardwareInterface::Setting;
 
-    switch (t) {
+    switch (command.Type) {
         case Topic::LimitOnlineVoltage:
             MessageOutput.printf("Limit Voltage: %f V\r\n", payload_val);
-            _mqttCallbacks.push_back(std::bind(&GridCharger::Huawei::Controller::setParameter,
-                        &HuaweiCan, payload_val, Setting::OnlineVoltage));
+            HuaweiCan.setParameter(payload_val, Setting::OnlineVoltage);
             break;
 
         case Topic::LimitOfflineVoltage:
             MessageOutput.printf("Offline Limit Voltage: %f V\r\n", payload_val);
-            _mqttCallbacks.push_back(std::bind(&GridCharger::Huawei::Controller::setParameter,
-                        &HuaweiCan, payload_val, Setting::OfflineVoltage));
+            HuaweiCan.setParameter(payload_val, Setting::OfflineVoltage);
             break;
 
         case Topic::LimitOnlineCurrent:
             MessageOutput.printf("Limit Current: %f A\r\n", payload_val);
-            _mqttCallbacks.push_back(std::bind(&GridCharger::Huawei::Controller::setParameter,
-                        &HuaweiCan, payload_val, Setting::OnlineCurrent));
+            HuaweiCan.setParameter(payload_val, Setting::OnlineCurrent);
             break;
 
         case Topic::LimitOfflineCurrent:
             MessageOutput.printf("Offline Limit Current: %f A\r\n", payload_val);
-            _mqttCallbacks.push_back(std::bind(&GridCharger::Huawei::Controller::setParameter,
-                        &HuaweiCan, payload_val, Setting::OfflineCurrent));
+            HuaweiCan.setParameter(payload_val, Setting::OfflineCurrent);
             break;
 
         case Topic::Mode:
             switch (static_cast<int>(payload_val)) {
                 case 3:
                     MessageOutput.println("[Huawei MQTT::] Received MQTT msg. New mode: Full internal control");
-                    _mqttCallbacks.push_back(std::bind(&GridCharger::Huawei::Controller::setMode,
-                                &HuaweiCan, HUAWEI_MODE_AUTO_INT));
+                    HuaweiCan.setMode(HUAWEI_MODE_AUTO_INT);
                     break;
 
                 case 2:
                     MessageOutput.println("[Huawei MQTT::] Received MQTT msg. New mode: Internal on/off control, external power limit");
-                    _mqttCallbacks.push_back(std::bind(&GridCharger::Huawei::Controller::setMode,
-                                &HuaweiCan, HUAWEI_MODE_AUTO_EXT));
+                    HuaweiCan.setMode(HUAWEI_MODE_AUTO_EXT);
                     break;
 
                 case 1:
                     MessageOutput.println("[Huawei MQTT::] Received MQTT msg. New mode: Turned ON");
-                    _mqttCallbacks.push_back(std::bind(&GridCharger::Huawei::Controller::setMode,
-                                &HuaweiCan, HUAWEI_MODE_ON));
+                    HuaweiCan.setMode(HUAWEI_MODE_ON);
                     break;
 
                 case 0:
                     MessageOutput.println("[Huawei MQTT::] Received MQTT msg. New mode: Turned OFF");
-                    _mqttCallbacks.push_back(std::bind(&GridCharger::Huawei::Controller::setMode,
-                                &HuaweiCan, HUAWEI_MODE_OFF));
+                    HuaweiCan.setMode(HUAWEI_MODE_OFF);
                     break;
 
                 default:
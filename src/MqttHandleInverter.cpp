@@ -5,14 +5,18 @@
 #include "MqttHandleInverter.h"
 #include "MessageOutput.h"
 #include "MqttSettings.h"
+#include "NightMode.h"
+#include "Utils.h"
 #include <ctime>
+#include "TaskProfiler.h"
 
 #define PUBLISH_MAX_INTERVAL 60000
 
 MqttHandleInverterClass MqttHandleInverter;
 
 MqttHandleInverterClass::MqttHandleInverterClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MqttHandleInverterClass::loop, this))
+    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, TaskProfiler.wrap("MqttHandleInverter::loop", std::bind(&MqttHandleInverterClass::loop, this)))
+    , _commandTask(TASK_IMMEDIATE, TASK_FOREVER, TaskProfiler.wrap("MqttHandleInverter::commandLoop", std::bind(&MqttHandleInverterClass::commandLoop, this)))
 {
 }
 
@@ -23,13 +27,30 @@ void MqttHandleInverterClass::init(Scheduler& scheduler)
     scheduler.addTask(_loopTask);
     _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
     _loopTask.enable();
+    NightMode.addIdleTask(_loopTask);
+
+    // not an idle task, as commands must be executed during the night, too
+    scheduler.addTask(_commandTask);
+    _commandTask.enable();
+}
+
+void MqttHandleInverterClass::commandLoop()
+{
+    _commands.execute([this](Command const& command) { execute(command); });
 }
 
 void MqttHandleInverterClass::loop()
 {
     _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
 
-    if (!MqttSettings.getConnected() || !Hoymiles.isAllRadioIdle()) {
+    if (!MqttSettings.acceptsPublishes()) {
+        // publish all values once the connection is established again
+        for (auto& state : _inverterStates) {
+            state.lastRefresh = 0;
+        }
+    }
+
+    if (!MqttSettings.acceptsPublishes() || !Hoymiles.isAllRadioIdle()) {
         _loopTask.forceNextIteration();
         return;
     }
@@ -89,38 +110,157 @@ void MqttHandleInverterClass::loop()
         }
 
         const uint32_t lastUpdateInternal = inv->Statistics()->getLastUpdateFromInternal();
-        if (inv->Statistics()->getLastUpdate() > 0 && (lastUpdateInternal != _lastPublishStats[i])) {
-            _lastPublishStats[i] = lastUpdateInternal;
-
-            // Loop all channels
-            for (auto& t : inv->Statistics()->getChannelTypes()) {
-                for (auto& c : inv->Statistics()->getChannelsByType(t)) {
-                    if (t == TYPE_DC) {
-                        INVERTER_CONFIG_T* inv_cfg = Configuration.getInverterConfig(inv->serial());
-                        if (inv_cfg != nullptr) {
-                            // TODO(tbnobody)
-                            MqttSettings.publish(inv->serialString() + "/" + String(static_cast<uint8_t>(c) + 1) + "/name", inv_cfg->channel[c].Name);
-                        }
-                    }
-                    for (uint8_t f = 0; f < sizeof(_publishFields) / sizeof(FieldId_t); f++) {
-                        publishField(inv, t, c, _publishFields[f]);
-                    }
+        auto& state = _inverterStates[i];
+        if (inv->Statistics()->getLastUpdate() > 0 && (lastUpdateInternal != state.lastPublishStats)) {
+            publishFields(inv, state);
+            state.lastPublishStats = lastUpdateInternal;
+        }
+
+        yield();
+    }
+}
+
+void MqttHandleInverterClass::buildInverterState(std::shared_ptr<InverterAbstract> inv, InverterState& state)
+{
+    state = InverterState();
+    state.serial = inv->serial();
+    state.prefix = MqttSettings.getPrefix();
+
+    for (auto& t : inv->Statistics()->getChannelTypes()) {
+        for (auto& c : inv->Statistics()->getChannelsByType(t)) {
+            for (uint8_t f = 0; f < sizeof(_publishFields) / sizeof(FieldId_t); f++) {
+                const String topic = getTopic(inv, t, c, _publishFields[f]);
+                if (topic == "") {
+                    continue;
                 }
+
+                FieldState field = {};
+                field.type = t;
+                field.channel = c;
+                field.fieldId = _publishFields[f];
+                field.topicOffset = state.topics.size();
+                field.nameOffset = state.prefix.length() + topic.lastIndexOf('/') + 1;
+                state.fields.push_back(field);
+
+                state.topics.append(state.prefix.c_str());
+                state.topics.append(topic.c_str());
+                state.topics.push_back('\0');
             }
         }
+    }
 
-        yield();
+    state.jsonTopicOffset = state.topics.size();
+    state.topics.append(state.prefix.c_str());
+    state.topics.append(getJsonTopic(inv).c_str());
+    state.topics.push_back('\0');
+}
+
+bool MqttHandleInverterClass::exceedsDeadband(const float last, const float value, const uint8_t digits, const float deadband)
+{
+    // changes which are not visible with the field's precision never count
+    const float scale = powf(10, digits);
+    if (roundf(last * scale) == roundf(value * scale)) {
+        return false;
     }
+
+    return fabsf(value - last) > fabsf(last) * deadband / 100;
 }
 
-void MqttHandleInverterClass::publishField(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId)
+void MqttHandleInverterClass::publishFields(std::shared_ptr<InverterAbstract> inv, InverterState& state)
 {
-    const String topic = getTopic(inv, type, channel, fieldId);
-    if (topic == "") {
+    auto const& config = Configuration.get();
+
+    if (state.serial != inv->serial() || state.prefix != MqttSettings.getPrefix()) {
+        buildInverterState(inv, state);
+    }
+
+    // all values are published if the refresh interval elapsed, otherwise
+    // only values which changed by more than the deadband since they were
+    // last published. a refresh interval of zero disables change detection.
+    const uint32_t refreshInterval = config.Mqtt.PublishRefreshInterval * 1000;
+    const bool refresh = refreshInterval == 0 || state.lastRefresh == 0 || (millis() - state.lastRefresh) >= refreshInterval;
+    if (refresh) {
+        state.lastRefresh = millis();
+    }
+
+    // the values of one publish cycle all stem from the same frame
+    auto spSnapshot = inv->Statistics()->getSnapshot();
+    if (!spSnapshot) {
         return;
     }
 
-    MqttSettings.publish(topic, inv->Statistics()->getChannelFieldValueString(type, channel, fieldId));
+    const bool json = config.Mqtt.InverterJsonPayload;
+    bool changed = false;
+
+    std::vector<MqttSettingsClass::Message> batch;
+    JsonDocument doc;
+
+    for (auto& field : state.fields) {
+        float value = spSnapshot->getChannelFieldValue(field.type, field.channel, field.fieldId);
+        uint8_t digits = inv->Statistics()->getChannelFieldDigits(field.type, field.channel, field.fieldId);
+
+        const bool fieldChanged = !field.published
+            || exceedsDeadband(field.value, value, digits, config.Mqtt.PublishDeadband);
+        changed |= fieldChanged;
+
+        if (!json && !refresh && !fieldChanged) {
+            continue;
+        }
+
+        // the json payload is a snapshot of all values
+        if (fieldChanged || refresh) {
+            field.value = value;
+            field.published = true;
+        }
+
+        const char* topic = state.topics.c_str() + field.topicOffset;
+        char payload[Utils::FixedFormatSize];
+        const size_t payloadLength = Utils::formatFixed(payload, sizeof(payload), value, digits);
+
+        if (json) {
+            // TODO(tbnobody)
+            const uint8_t chanNum = (field.type == TYPE_DC) ? static_cast<uint8_t>(field.channel) + 1 : static_cast<uint8_t>(field.channel);
+            doc[String(chanNum)][topic + field.nameOffset] = serialized(static_cast<const char*>(payload), payloadLength);
+        } else {
+            batch.emplace_back(topic, payload);
+        }
+    }
+
+    if (refresh) {
+        const INVERTER_CONFIG_T* inv_cfg = Configuration.getInverterConfig(inv->serial());
+        if (inv_cfg != nullptr) {
+            for (auto& c : inv->Statistics()->getChannelsByType(TYPE_DC)) {
+                // TODO(tbnobody)
+                const String chanNum(static_cast<uint8_t>(c) + 1);
+                if (json) {
+                    doc[chanNum]["name"] = inv_cfg->channel[c].Name;
+                } else {
+                    MqttSettings.publish(inv->serialString() + "/" + chanNum + "/name", inv_cfg->channel[c].Name);
+                }
+            }
+        }
+    }
+
+    if (json) {
+        if (!changed && !refresh) {
+            return;
+        }
+
+        if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
+            return;
+        }
+
+        String buffer;
+        serializeJson(doc, buffer);
+        batch.emplace_back(state.topics.c_str() + state.jsonTopicOffset, buffer);
+    }
+
+    MqttSettings.publishBatch(batch);
+}
+
+String MqttHandleInverterClass::getJsonTopic(std::shared_ptr<InverterAbstract> inv)
+{
+    return inv->serialString() + "/json";
 }
 
 String MqttHandleInverterClass::getTopic(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId)
@@ -150,6 +290,8 @@ String MqttHandleInverterClass::getTopic(std::shared_ptr<InverterAbstract> inv,
 
 void MqttHandleInverterClass::onMqttMessage(Topic t, const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, const size_t len, const size_t index, const size_t total)
 {
+    NightMode.notifyActivity();
+
     const CONFIG_T& config = Configuration.get();
 
     char token_topic[MQTT_MAX_TOPIC_STRLEN + 40]; // respect all subtopics
@@ -166,13 +308,6 @@ void MqttHandleInverterClass::onMqttMessage(Topic t, const espMqttClientTypes::M
 
     const uint64_t serial = strtoull(serial_str, 0, 16);
 
-    auto inv = Hoymiles.getInverterBySerial(serial);
-
-    if (inv == nullptr) {
-        MessageOutput.println("Inverter not found");
-        return;
-    }
-
     std::string strValue(reinterpret_cast<const char*>(payload), len);
     float payload_val = -1;
     try {
@@ -183,7 +318,21 @@ void MqttHandleInverterClass::onMqttMessage(Topic t, const espMqttClientTypes::M
         return;
     }
 
-    switch (t) {
+    _commands.push({ serial, t, payload_val, properties.retain });
+}
+
+void MqttHandleInverterClass::execute(Command const& command)
+{
+    auto inv = Hoymiles.getInverterBySerial(command.Serial);
+
+    if (inv == nullptr) {
+        MessageOutput.println("Inverter not found");
+        return;
+    }
+
+    float const payload_val = command.Value;
+
+    switch (command.Type) {
     case Topic::LimitPersistentRelative:
         // Set inverter limit relative persistent
         MessageOutput.printf("Limit Persistent: %.1f %%\r\n", payload_val);
@@ -199,7 +348,7 @@ void MqttHandleInverterClass::onMqttMessage(Topic t, const espMqttClientTypes::M
     case Topic::LimitNonPersistentRelative:
         // Set inverter limit relative non persistent
         MessageOutput.printf("Limit Non-Persistent: %.1f %%\r\n", payload_val);
-        if (!properties.retain) {
+        if (!command.Retained) {
             inv->sendActivePowerControlRequest(payload_val, PowerLimitControlType::RelativNonPersistent);
         } else {
             MessageOutput.println("Ignored because retained");
@@ -209,7 +358,7 @@ void MqttHandleInverterClass::onMqttMessage(Topic t, const espMqttClientTypes::M
     case Topic::LimitNonPersistentAbsolute:
         // Set inverter limit absolute non persistent
         MessageOutput.printf("Limit Non-Persistent: %.1f W\r\n", payload_val);
-        if (!properties.retain) {
+        if (!command.Retained) {
             inv->sendActivePowerControlRequest(payload_val, PowerLimitControlType::AbsolutNonPersistent);
         } else {
             MessageOutput.println("Ignored because retained");
@@ -225,7 +374,7 @@ void MqttHandleInverterClass::onMqttMessage(Topic t, const espMqttClientTypes::M
     case Topic::Restart:
         // Restart inverter
         MessageOutput.printf("Restart inverter\r\n");
-        if (!properties.retain && payload_val == 1) {
+        if (!command.Retained && payload_val == 1) {
             inv->sendRestartControlRequest();
         } else {
             MessageOutput.println("Ignored because retained or numeric value not '1'");
@@ -235,7 +384,7 @@ void MqttHandleInverterClass::onMqttMessage(Topic t, const espMqttClientTypes::M
     case Topic::ResetRfStats:
         // Reset RF Stats
         MessageOutput.printf("Reset RF stats\r\n");
-        if (!properties.retain && payload_val == 1) {
+        if (!command.Retained && payload_val == 1) {
             inv->resetRadioStats();
         } else {
             MessageOutput.println("Ignored because retained or numeric value not '1'");
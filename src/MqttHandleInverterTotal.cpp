@@ -6,12 +6,14 @@
 #include "Configuration.h"
 #include "Datastore.h"
 #include "MqttSettings.h"
+#include "NightMode.h"
 #include <Hoymiles.h>
+#include "TaskProfiler.h"
 
 MqttHandleInverterTotalClass MqttHandleInverterTotal;
 
 MqttHandleInverterTotalClass::MqttHandleInverterTotalClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MqttHandleInverterTotalClass::loop, this))
+    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, TaskProfiler.wrap("MqttHandleInverterTotal::loop", std::bind(&MqttHandleInverterTotalClass::loop, this)))
 {
 }
 
@@ -20,6 +22,7 @@ void MqttHandleInverterTotalClass::init(Scheduler& scheduler)
     scheduler.addTask(_loopTask);
     _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
     _loopTask.enable();
+    NightMode.addIdleTask(_loopTask);
 }
 
 void MqttHandleInverterTotalClass::loop()
@@ -27,16 +30,17 @@ void MqttHandleInverterTotalClass::loop()
     // Update interval from config
     _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
 
-    if (!MqttSettings.getConnected() || !Hoymiles.isAllRadioIdle()) {
+    if (!MqttSettings.acceptsPublishes() || !Hoymiles.isAllRadioIdle()) {
         _loopTask.forceNextIteration();
         return;
     }
 
-    MqttSettings.publish("ac/power", String(Datastore.getTotalAcPowerEnabled(), Datastore.getTotalAcPowerDigits()));
-    MqttSettings.publish("ac/yieldtotal", String(Datastore.getTotalAcYieldTotalEnabled(), Datastore.getTotalAcYieldTotalDigits()));
-    MqttSettings.publish("ac/yieldday", String(Datastore.getTotalAcYieldDayEnabled(), Datastore.getTotalAcYieldDayDigits()));
-    MqttSettings.publish("ac/is_valid", String(Datastore.getIsAllEnabledReachable()));
-    MqttSettings.publish("dc/power", String(Datastore.getTotalDcPowerEnabled(), Datastore.getTotalDcPowerDigits()));
-    MqttSettings.publish("dc/irradiation", String(Datastore.getTotalDcIrradiation(), 3));
-    MqttSettings.publish("dc/is_valid", String(Datastore.getIsAllEnabledReachable()));
+    auto& topics = MqttTopicRegistry;
+    MqttSettings.publish(topics.intern("ac/power"), Datastore.getTotalAcPowerEnabled(), Datastore.getTotalAcPowerDigits());
+    MqttSettings.publish(topics.intern("ac/yieldtotal"), Datastore.getTotalAcYieldTotalEnabled(), Datastore.getTotalAcYieldTotalDigits());
+    MqttSettings.publish(topics.intern("ac/yieldday"), Datastore.getTotalAcYieldDayEnabled(), Datastore.getTotalAcYieldDayDigits());
+    MqttSettings.publish(topics.intern("ac/is_valid"), Datastore.getIsAllEnabledReachable(), 0);
+    MqttSettings.publish(topics.intern("dc/power"), Datastore.getTotalDcPowerEnabled(), Datastore.getTotalDcPowerDigits());
+    MqttSettings.publish(topics.intern("dc/irradiation"), Datastore.getTotalDcIrradiation(), 3);
+    MqttSettings.publish(topics.intern("dc/is_valid"), Datastore.getIsAllEnabledReachable(), 0);
 }
@@ -5,16 +5,18 @@
 #include "MessageOutput.h"
 #include "MqttSettings.h"
 #include "MqttHandlePowerLimiter.h"
+#include "NightMode.h"
 #include "PowerLimiter.h"
 #include <ctime>
 #include <string>
+#include "TaskProfiler.h"
 
 MqttHandlePowerLimiterClass MqttHandlePowerLimiter;
 
 void MqttHandlePowerLimiterClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&MqttHandlePowerLimiterClass::loop, this));
+    _loopTask.setCallback(TaskProfiler.wrap("MqttHandlePowerLimiter::loop", std::bind(&MqttHandlePowerLimiterClass::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
 
@@ -63,21 +65,16 @@ void MqttHandlePowerLimiterClass::unsubscribeTopics()
 
 void MqttHandlePowerLimiterClass::loop()
 {
-    std::unique_lock<std::mutex> mqttLock(_mqttMutex);
-
     auto const& config = Configuration.get();
 
     if (!config.PowerLimiter.Enabled) {
-        _mqttCallbacks.clear();
+        _commands.clear();
         return;
     }
 
-    for (auto& callback : _mqttCallbacks) { callback(); }
-    _mqttCallbacks.clear();
-
-    mqttLock.unlock();
+    _commands.execute([this](Command const& command) { execute(command); });
 
-    if (!MqttSettings.getConnected() ) { return; }
+    if (!MqttSettings.acceptsPublishes() ) { return; }
 
     if ((millis() - _lastPublish) < (config.Mqtt.PublishInterval * 1000)) {
         return;
@@ -85,39 +82,45 @@ void MqttHandlePowerLimiterClass::loop()
 
     _lastPublish = millis();
 
+    auto& topics = MqttTopicRegistry;
+
     auto val = static_cast<unsigned>(PowerLimiter.getMode());
-    MqttSettings.publish("powerlimiter/status/mode", String(val));
+    MqttSettings.publish(topics.intern("powerlimiter/status/mode"), val, 0);
 
-    MqttSettings.publish("powerlimiter/status/upper_power_limit", String(config.PowerLimiter.TotalUpperPowerLimit));
+    MqttSettings.publish(topics.intern("powerlimiter/status/upper_power_limit"), config.PowerLimiter.TotalUpperPowerLimit, 0);
 
-    MqttSettings.publish("powerlimiter/status/target_power_consumption", String(config.PowerLimiter.TargetPowerConsumption));
+    MqttSettings.publish(topics.intern("powerlimiter/status/target_power_consumption"), config.PowerLimiter.TargetPowerConsumption, 0);
 
-    MqttSettings.publish("powerlimiter/status/inverter_update_timeouts", String(PowerLimiter.getInverterUpdateTimeouts()));
+    MqttSettings.publish(topics.intern("powerlimiter/status/inverter_update_timeouts"), PowerLimiter.getInverterUpdateTimeouts(), 0);
+
+    MqttSettings.publish(topics.intern("powerlimiter/status/suppressed_limit_updates"), PowerLimiter.getSuppressedLimitUpdates(), 0);
 
     // no thresholds are relevant for setups without a battery
     if (!PowerLimiter.usesBatteryPoweredInverter()) { return; }
 
-    MqttSettings.publish("powerlimiter/status/threshold/voltage/start", String(config.PowerLimiter.VoltageStartThreshold));
-    MqttSettings.publish("powerlimiter/status/threshold/voltage/stop", String(config.PowerLimiter.VoltageStopThreshold));
+    MqttSettings.publish(topics.intern("powerlimiter/status/threshold/voltage/start"), config.PowerLimiter.VoltageStartThreshold, 2);
+    MqttSettings.publish(topics.intern("powerlimiter/status/threshold/voltage/stop"), config.PowerLimiter.VoltageStopThreshold, 2);
 
     if (config.SolarCharger.Enabled) {
-        MqttSettings.publish("powerlimiter/status/full_solar_passthrough_active", String(PowerLimiter.getFullSolarPassThroughEnabled()));
-        MqttSettings.publish("powerlimiter/status/threshold/voltage/full_solar_passthrough_start", String(config.PowerLimiter.FullSolarPassThroughStartVoltage));
-        MqttSettings.publish("powerlimiter/status/threshold/voltage/full_solar_passthrough_stop", String(config.PowerLimiter.FullSolarPassThroughStopVoltage));
+        MqttSettings.publish(topics.intern("powerlimiter/status/full_solar_passthrough_active"), PowerLimiter.getFullSolarPassThroughEnabled(), 0);
+        MqttSettings.publish(topics.intern("powerlimiter/status/threshold/voltage/full_solar_passthrough_start"), config.PowerLimiter.FullSolarPassThroughStartVoltage, 2);
+        MqttSettings.publish(topics.intern("powerlimiter/status/threshold/voltage/full_solar_passthrough_stop"), config.PowerLimiter.FullSolarPassThroughStopVoltage, 2);
     }
 
     if (!config.Battery.Enabled || config.PowerLimiter.IgnoreSoc) { return; }
 
-    MqttSettings.publish("powerlimiter/status/threshold/soc/start", String(config.PowerLimiter.BatterySocStartThreshold));
-    MqttSettings.publish("powerlimiter/status/threshold/soc/stop", String(config.PowerLimiter.BatterySocStopThreshold));
+    MqttSettings.publish(topics.intern("powerlimiter/status/threshold/soc/start"), config.PowerLimiter.BatterySocStartThreshold, 0);
+    MqttSettings.publish(topics.intern("powerlimiter/status/threshold/soc/stop"), config.PowerLimiter.BatterySocStopThreshold, 0);
 
     if (config.SolarCharger.Enabled) {
-        MqttSettings.publish("powerlimiter/status/threshold/soc/full_solar_passthrough", String(config.PowerLimiter.FullSolarPassThroughSoc));
+        MqttSettings.publish(topics.intern("powerlimiter/status/threshold/soc/full_solar_passthrough"), config.PowerLimiter.FullSolarPassThroughSoc, 0);
     }
 }
 
 void MqttHandlePowerLimiterClass::onMqttCmd(MqttPowerLimiterCommand command, const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t len, size_t index, size_t total)
 {
+    NightMode.notifyActivity();
+
     std::string strValue(reinterpret_cast<const char*>(payload), len);
     float payload_val = -1;
     try {
@@ -128,24 +131,27 @@ void MqttHandlePowerLimiterClass::onMqttCmd(MqttPowerLimiterCommand command, con
                 topic, strValue.c_str());
         return;
     }
+
+    _commands.push({ command, payload_val });
+}
+
+void MqttHandlePowerLimiterClass::execute(Command const& command)
+{
+    float const payload_val = command.Value;
     const int intValue = static_cast<int>(payload_val);
 
-    if (command == MqttPowerLimiterCommand::Mode) {
-        std::lock_guard<std::mutex> mqttLock(_mqttMutex);
+    if (command.Type == MqttPowerLimiterCommand::Mode) {
         using Mode = PowerLimiterClass::Mode;
         Mode mode = static_cast<Mode>(intValue);
         if (mode == Mode::UnconditionalFullSolarPassthrough) {
             MessageOutput.println("Power limiter unconditional full solar PT");
-            _mqttCallbacks.push_back(std::bind(&PowerLimiterClass::setMode,
-                        &PowerLimiter, Mode::UnconditionalFullSolarPassthrough));
+            PowerLimiter.setMode(Mode::UnconditionalFullSolarPassthrough);
         } else if (mode == Mode::Disabled) {
             MessageOutput.println("Power limiter disabled (override)");
-            _mqttCallbacks.push_back(std::bind(&PowerLimiterClass::setMode,
-                        &PowerLimiter, Mode::Disabled));
+            PowerLimiter.setMode(Mode::Disabled);
         } else if (mode == Mode::Normal) {
             MessageOutput.println("Power limiter normal operation");
-            _mqttCallbacks.push_back(std::bind(&PowerLimiterClass::setMode,
-                        &PowerLimiter, Mode::Normal));
+            PowerLimiter.setMode(Mode::Normal);
         } else {
             MessageOutput.printf("PowerLimiter - unknown mode %d\r\n", intValue);
         }
@@ -155,9 +161,9 @@ void MqttHandlePowerLimiterClass::onMqttCmd(MqttPowerLimiterCommand command, con
     auto guard = Configuration.getWriteGuard();
     auto& config = guard.getConfig();
 
-    switch (command) {
+    switch (command.Type) {
         case MqttPowerLimiterCommand::Mode:
-            // handled separately above to avoid locking two mutexes
+            // handled separately above to not hold the write guard
             break;
         case MqttPowerLimiterCommand::BatterySoCStartThreshold:
             if (config.PowerLimiter.BatterySocStartThreshold == intValue) { return; }
@@ -207,5 +213,5 @@ void MqttHandlePowerLimiterClass::onMqttCmd(MqttPowerLimiterCommand command, con
     }
 
     // not reached if the value did not change
-    Configuration.write();
+    Configuration.scheduleWrite(ConfigurationClass::Section::PowerLimiter);
 }
@@ -3,7 +3,9 @@
  * Copyright (C) 2022 Thomas Basler and others
  */
 #include "MqttHandlePowerLimiterHass.h"
+#include "MemoryPolicy.h"
 #include "MqttHandleHass.h"
+#include "MqttHassPublisher.h"
 #include "Configuration.h"
 #include "MqttSettings.h"
 #include "NetworkSettings.h"
@@ -11,13 +13,14 @@
 #include "Utils.h"
 #include "PowerLimiter.h"
 #include "__compiled_constants.h"
+#include "TaskProfiler.h"
 
 MqttHandlePowerLimiterHassClass MqttHandlePowerLimiterHass;
 
 void MqttHandlePowerLimiterHassClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&MqttHandlePowerLimiterHassClass::loop, this));
+    _loopTask.setCallback(TaskProfiler.wrap("MqttHandlePowerLimiterHass::loop", std::bind(&MqttHandlePowerLimiterHassClass::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
 }
@@ -63,48 +66,72 @@ void MqttHandlePowerLimiterHassClass::publishConfig()
         return;
     }
 
-    publishSelect("DPL Mode", "mdi:gauge", "config", "mode", "mode");
+    // a previous update which is still pending is superseded
+    MqttHassPublisher.cancel(this);
+
+    enqueue([this] { publishSelect("DPL Mode", "mdi:gauge", "config", "mode", "mode"); });
 
     if (!PowerLimiter.usesBatteryPoweredInverter()) {
         return;
     }
 
     // as this project revolves around Hoymiles inverters, 16 - 60 V is a reasonable voltage range
-    publishNumber("DPL battery voltage start threshold", "mdi:battery-charging",
-            "config", "threshold/voltage/start", "threshold/voltage/start", "V", 16, 60, 0.1);
-    publishNumber("DPL battery voltage stop threshold", "mdi:battery-charging",
-            "config", "threshold/voltage/stop", "threshold/voltage/stop", "V", 16, 60, 0.1);
+    enqueue([this] {
+        publishNumber("DPL battery voltage start threshold", "mdi:battery-charging",
+                "config", "threshold/voltage/start", "threshold/voltage/start", "V", 16, 60, 0.1);
+    });
+    enqueue([this] {
+        publishNumber("DPL battery voltage stop threshold", "mdi:battery-charging",
+                "config", "threshold/voltage/stop", "threshold/voltage/stop", "V", 16, 60, 0.1);
+    });
 
     if (config.SolarCharger.Enabled) {
-        publishBinarySensor("full solar passthrough active",
-            "mdi:transmission-tower-import",
-            "full_solar_passthrough_active", "1", "0");
-
-        publishNumber("DPL full solar passthrough start voltage",
-                "mdi:transmission-tower-import", "config",
-                "threshold/voltage/full_solar_passthrough_start",
-                "threshold/voltage/full_solar_passthrough_start", "V", 16, 60, 0.1);
-        publishNumber("DPL full solar passthrough stop voltage",
-                "mdi:transmission-tower-import", "config",
-                "threshold/voltage/full_solar_passthrough_stop",
-                "threshold/voltage/full_solar_passthrough_stop", "V", 16, 60, 0.1);
+        enqueue([this] {
+            publishBinarySensor("full solar passthrough active",
+                "mdi:transmission-tower-import",
+                "full_solar_passthrough_active", "1", "0");
+        });
+
+        enqueue([this] {
+            publishNumber("DPL full solar passthrough start voltage",
+                    "mdi:transmission-tower-import", "config",
+                    "threshold/voltage/full_solar_passthrough_start",
+                    "threshold/voltage/full_solar_passthrough_start", "V", 16, 60, 0.1);
+        });
+        enqueue([this] {
+            publishNumber("DPL full solar passthrough stop voltage",
+                    "mdi:transmission-tower-import", "config",
+                    "threshold/voltage/full_solar_passthrough_stop",
+                    "threshold/voltage/full_solar_passthrough_stop", "V", 16, 60, 0.1);
+        });
     }
 
     if (config.Battery.Enabled && !config.PowerLimiter.IgnoreSoc) {
-        publishNumber("DPL battery SoC start threshold", "mdi:battery-charging",
-                "config", "threshold/soc/start", "threshold/soc/start", "%", 0, 100, 1.0);
-        publishNumber("DPL battery SoC stop threshold", "mdi:battery-charging",
-                "config", "threshold/soc/stop", "threshold/soc/stop", "%", 0, 100, 1.0);
+        enqueue([this] {
+            publishNumber("DPL battery SoC start threshold", "mdi:battery-charging",
+                    "config", "threshold/soc/start", "threshold/soc/start", "%", 0, 100, 1.0);
+        });
+        enqueue([this] {
+            publishNumber("DPL battery SoC stop threshold", "mdi:battery-charging",
+                    "config", "threshold/soc/stop", "threshold/soc/stop", "%", 0, 100, 1.0);
+        });
 
         if (config.SolarCharger.Enabled) {
-            publishNumber("DPL full solar passthrough SoC",
-                    "mdi:transmission-tower-import", "config",
-                    "threshold/soc/full_solar_passthrough",
-                    "threshold/soc/full_solar_passthrough", "%", 0, 100, 1.0);
+            enqueue([this] {
+                publishNumber("DPL full solar passthrough SoC",
+                        "mdi:transmission-tower-import", "config",
+                        "threshold/soc/full_solar_passthrough",
+                        "threshold/soc/full_solar_passthrough", "%", 0, 100, 1.0);
+            });
         }
     }
 }
 
+void MqttHandlePowerLimiterHassClass::enqueue(MqttHassPublisherClass::Generator&& generator)
+{
+    MqttHassPublisher.enqueue(this, std::move(generator));
+}
+
 void MqttHandlePowerLimiterHassClass::publishSelect(
     const char* caption, const char* icon, const char* category,
     const char* commandTopic, const char* stateTopic)
@@ -119,7 +146,7 @@ void MqttHandlePowerLimiterHassClass::publishSelect(
     const String cmdTopic = MqttSettings.getPrefix() + "powerlimiter/cmd/" + commandTopic;
     const String statTopic = MqttSettings.getPrefix() + "powerlimiter/status/" + stateTopic;
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::jsonAllocator());
 
     root["name"] = caption;
     root["uniq_id"] = MqttHandleHass.getDtuUniqueId() + "_" + selectId;
@@ -160,7 +187,7 @@ void MqttHandlePowerLimiterHassClass::publishNumber(
     const String cmdTopic = MqttSettings.getPrefix() + "powerlimiter/cmd/" + commandTopic;
     const String statTopic = MqttSettings.getPrefix() + "powerlimiter/status/" + stateTopic;
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::jsonAllocator());
 
     root["name"] = caption;
     root["uniq_id"] = MqttHandleHass.getDtuUniqueId() + "_" + numberId;
@@ -205,7 +232,7 @@ void MqttHandlePowerLimiterHassClass::publishBinarySensor(
 
     const String statTopic = MqttSettings.getPrefix() + "powerlimiter/status/" + stateTopic;
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::jsonAllocator());
 
     root["name"] = caption;
     root["uniq_id"] = MqttHandleHass.getDtuUniqueId() + "_" + numberId;
@@ -247,7 +274,5 @@ void MqttHandlePowerLimiterHassClass::createDeviceInfo(JsonDocument& root)
 
 void MqttHandlePowerLimiterHassClass::publish(const String& subtopic, const String& payload)
 {
-    String topic = Configuration.get().Mqtt.Hass.Topic;
-    topic += subtopic;
-    MqttSettings.publishGeneric(topic.c_str(), payload.c_str(), Configuration.get().Mqtt.Hass.Retain);
+    MqttHassPublisher.publish(subtopic, payload);
 }
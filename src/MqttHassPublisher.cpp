@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "MqttHassPublisher.h"
+#include "Configuration.h"
+#include "MqttSettings.h"
+#include <algorithm>
+#include "TaskProfiler.h"
+
+MqttHassPublisherClass MqttHassPublisher;
+
+MqttHassPublisherClass::MqttHassPublisherClass()
+    : _loopTask(TickIntervalMs * TASK_MILLISECOND, TASK_FOREVER, TaskProfiler.wrap("MqttHassPublisher::loop", std::bind(&MqttHassPublisherClass::loop, this)))
+{
+}
+
+void MqttHassPublisherClass::init(Scheduler& scheduler)
+{
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+void MqttHassPublisherClass::enqueue(void const* owner, Generator&& generator)
+{
+    _queue.emplace_back(owner, std::move(generator));
+}
+
+void MqttHassPublisherClass::cancel(void const* owner)
+{
+    _queue.erase(std::remove_if(_queue.begin(), _queue.end(),
+        [owner](auto const& entry) { return entry.first == owner; }),
+        _queue.end());
+}
+
+void MqttHassPublisherClass::reset()
+{
+    // the integrations enqueue their documents again once connected
+    _queue.clear();
+    _published.clear();
+}
+
+void MqttHassPublisherClass::loop()
+{
+    if (!MqttSettings.getConnected()) {
+        if (_wasConnected) { reset(); }
+        _wasConnected = false;
+        return;
+    }
+
+    _wasConnected = true;
+
+    // the discovery documents wait until the outbox was drained
+    if (MqttSettings.isOutboxCongested()) { return; }
+
+    _publishedThisTick = 0;
+    size_t generators = 0;
+    while (!_queue.empty() && _publishedThisTick < MessagesPerTick && generators < GeneratorsPerTick) {
+        // the generator might enqueue or cancel generators
+        auto generator = std::move(_queue.front().second);
+        _queue.pop_front();
+        generator();
+        ++generators;
+    }
+
+    if (_queue.empty()) {
+        _queue.shrink_to_fit();
+    }
+}
+
+void MqttHassPublisherClass::publish(const String& subtopic, const String& payload)
+{
+    auto const& config = Configuration.get().Mqtt.Hass;
+
+    String topic = config.Topic;
+    topic += subtopic;
+
+    if (config.Retain) {
+        uint32_t topicHash = hash(topic.c_str(), topic.length());
+        uint32_t payloadHash = hash(payload.c_str(), payload.length());
+
+        auto it = std::lower_bound(_published.begin(), _published.end(), topicHash,
+            [](auto const& entry, uint32_t value) { return entry.first < value; });
+
+        if (it != _published.end() && it->first == topicHash) {
+            if (it->second == payloadHash) { return; }
+            it->second = payloadHash;
+        } else {
+            _published.emplace(it, topicHash, payloadHash);
+        }
+    }
+
+    MqttSettings.publishGeneric(topic, payload, config.Retain);
+    ++_publishedThisTick;
+}
+
+// 32 bit FNV-1a
+uint32_t MqttHassPublisherClass::hash(char const* data, size_t length, uint32_t seed)
+{
+    uint32_t result = seed;
+    for (size_t i = 0; i < length; ++i) {
+        result ^= static_cast<uint8_t>(data[i]);
+        result *= 16777619UL;
+    }
+    return result;
+}
@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "MqttJournal.h"
+#include "MemoryPolicy.h"
+#include <Arduino.h>
+#include <cstdlib>
+#include <cstring>
+
+MqttJournal::~MqttJournal()
+{
+    free(_buffer);
+}
+
+bool MqttJournal::allocate(size_t capacity)
+{
+    if (_buffer != nullptr) { return true; }
+
+    // records are aligned to four bytes
+    capacity &= ~static_cast<size_t>(3);
+    if (capacity < 4 * sizeof(Header)) { return false; }
+
+    _buffer = static_cast<uint8_t*>(MemoryPolicy::allocateLarge(capacity));
+    if (_buffer == nullptr) { return false; }
+
+    _capacity = capacity;
+    clear();
+    return true;
+}
+
+void MqttJournal::clear()
+{
+    _head = _tail = _used = 0;
+    _records = _messages = 0;
+}
+
+uint32_t MqttJournal::hash(char const* topic)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261;
+    while (*topic) {
+        hash ^= static_cast<uint8_t>(*topic++);
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+size_t MqttJournal::recordSize(Header const& header)
+{
+    size_t size = sizeof(Header) + header.TopicLength + header.PayloadLength;
+    return (size + 3) & ~static_cast<size_t>(3);
+}
+
+size_t MqttJournal::next(size_t offset) const
+{
+    // there is no room for a wrap marker at the very end of the buffer
+    if (_capacity - offset < sizeof(Header)) { return 0; }
+
+    auto header = reinterpret_cast<Header const*>(_buffer + offset);
+    if (header->Flags & FlagWrap) { return 0; }
+
+    return offset;
+}
+
+void MqttJournal::dropHead()
+{
+    auto header = reinterpret_cast<Header*>(_buffer + _head);
+    if (!(header->Flags & FlagSuperseded)) { --_messages; }
+
+    size_t size = recordSize(*header);
+    _used -= size;
+    --_records;
+
+    if (_records == 0) {
+        _head = _tail = 0;
+        return;
+    }
+
+    _head = next(_head + size);
+}
+
+void MqttJournal::supersede(uint32_t topicHash, char const* topic)
+{
+    size_t offset = _head;
+    for (size_t i = 0; i < _records; ++i) {
+        auto header = reinterpret_cast<Header*>(_buffer + offset);
+
+        if ((header->Flags & (FlagRetain | FlagSuperseded)) == FlagRetain
+                && header->TopicHash == topicHash
+                && strcmp(reinterpret_cast<char const*>(header + 1), topic) == 0) {
+            // there is at most one queued state per topic
+            header->Flags |= FlagSuperseded;
+            --_messages;
+            return;
+        }
+
+        offset = next(offset + recordSize(*header));
+    }
+}
+
+bool MqttJournal::reserve(size_t size, size_t& offset)
+{
+    if (_records == 0) {
+        _head = _tail = 0;
+        offset = 0;
+        return true;
+    }
+
+    if (_tail > _head) {
+        if (_capacity - _tail >= size) {
+            offset = _tail;
+            return true;
+        }
+
+        if (_head >= size) {
+            if (_capacity - _tail >= sizeof(Header)) {
+                auto marker = reinterpret_cast<Header*>(_buffer + _tail);
+                memset(marker, 0, sizeof(Header));
+                marker->Flags = FlagWrap;
+            }
+            offset = 0;
+            return true;
+        }
+
+        return false;
+    }
+
+    // the buffer is full if the tail caught up with the head
+    if (_tail < _head && _head - _tail >= size) {
+        offset = _tail;
+        return true;
+    }
+
+    return false;
+}
+
+bool MqttJournal::append(char const* topic, char const* payload, bool retain, uint8_t qos)
+{
+    if (_buffer == nullptr) { return false; }
+
+    size_t topicLength = strlen(topic) + 1;
+    size_t payloadLength = strlen(payload) + 1;
+    if (topicLength > UINT16_MAX || payloadLength > UINT16_MAX) { return false; }
+
+    Header header;
+    header.Millis = millis();
+    header.TopicHash = hash(topic);
+    header.TopicLength = topicLength;
+    header.PayloadLength = payloadLength;
+    header.Flags = retain ? FlagRetain : 0;
+    header.Qos = qos;
+    header.Reserved = 0;
+
+    // a single message shall not displace most of the journal
+    size_t size = recordSize(header);
+    if (size > _capacity / 4) { return false; }
+
+    if (retain) { supersede(header.TopicHash, topic); }
+
+    size_t offset;
+    while (!reserve(size, offset)) {
+        auto oldest = reinterpret_cast<Header const*>(_buffer + _head);
+        if (!(oldest->Flags & FlagSuperseded)) { ++_dropped; }
+        dropHead();
+    }
+
+    uint8_t* record = _buffer + offset;
+    memcpy(record, &header, sizeof(Header));
+    memcpy(record + sizeof(Header), topic, topicLength);
+    memcpy(record + sizeof(Header) + topicLength, payload, payloadLength);
+
+    _tail = offset + size;
+    _used += size;
+    ++_records;
+    ++_messages;
+
+    return true;
+}
+
+bool MqttJournal::front(Message& message)
+{
+    while (_records > 0) {
+        auto header = reinterpret_cast<Header const*>(_buffer + _head);
+        if (header->Flags & FlagSuperseded) {
+            dropHead();
+            continue;
+        }
+
+        auto topic = reinterpret_cast<char const*>(header + 1);
+        message.Topic = topic;
+        message.Payload = topic + header->TopicLength;
+        message.Millis = header->Millis;
+        message.Retain = header->Flags & FlagRetain;
+        message.Qos = header->Qos;
+        return true;
+    }
+
+    return false;
+}
+
+void MqttJournal::pop()
+{
+    if (_records > 0) { dropHead(); }
+}
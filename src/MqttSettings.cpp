@@ -5,8 +5,36 @@
 #include "MqttSettings.h"
 #include "Configuration.h"
 #include "MessageOutput.h"
+#include "TaskProfiler.h"
+#include "Utils.h"
+#include <esp32-hal-psram.h>
+#include <esp_random.h>
+#include <algorithm>
+#include <cinttypes>
+
+namespace {
+
+// messages published while the broker is not reachable are kept in RAM,
+// which allows for a couple of minutes to hours depending on the amount of
+// inverters and the publish interval.
+constexpr size_t JOURNAL_CAPACITY = 8 * 1024;
+constexpr size_t JOURNAL_CAPACITY_PSRAM = 256 * 1024;
+
+// samples older than this are of no use anymore
+constexpr uint32_t JOURNAL_MAX_AGE_MILLIS = 6 * 60 * 60 * 1000;
+
+// messages sent per iteration of the journal task after reconnecting
+constexpr size_t JOURNAL_DRAIN_BATCH = 16;
+
+// the delay between failed connection attempts doubles up to the maximum
+constexpr uint32_t RECONNECT_DELAY_MIN_MILLIS = 2 * 1000;
+constexpr uint32_t RECONNECT_DELAY_MAX_MILLIS = 5 * 60 * 1000;
+
+} // namespace
 
 MqttSettingsClass::MqttSettingsClass()
+    : _reconnectDelayMillis(RECONNECT_DELAY_MIN_MILLIS)
+    , _journalTask(100 * TASK_MILLISECOND, TASK_FOREVER, TaskProfiler.wrap("MqttSettings::drainJournal", std::bind(&MqttSettingsClass::drainJournal, this)))
 {
 }
 
@@ -15,12 +43,27 @@ void MqttSettingsClass::NetworkEvent(network_event event)
     switch (event) {
     case network_event::NETWORK_GOT_IP:
         MessageOutput.println("Network connected");
+        _reconnectDelayMillis = RECONNECT_DELAY_MIN_MILLIS;
         performConnect();
         break;
     case network_event::NETWORK_DISCONNECTED:
         MessageOutput.println("Network lost connection");
         _mqttReconnectTimer.detach(); // ensure we don't reconnect to MQTT while reconnecting to Wi-Fi
         break;
+    case network_event::NETWORK_FAILOVER: {
+        // the connection is bound to the previous interface, which might be
+        // gone. reconnecting right away avoids waiting for the keep alive.
+        MessageOutput.println("Network failover, reconnecting to MQTT");
+        _reconnectDelayMillis = RECONNECT_DELAY_MIN_MILLIS;
+        bool connected;
+        {
+            std::lock_guard<std::mutex> lock(_clientLock);
+            connected = _mqttClient != nullptr && _mqttClient->connected();
+            if (connected) { _mqttClient->disconnect(true); }
+        }
+        if (!connected) { performConnect(); }
+        break;
+    }
     default:
         break;
     }
@@ -29,11 +72,15 @@ void MqttSettingsClass::NetworkEvent(network_event event)
 void MqttSettingsClass::onMqttConnect(const bool sessionPresent)
 {
     MessageOutput.println("Connected to MQTT.");
+    _reconnectDelayMillis = RECONNECT_DELAY_MIN_MILLIS;
     const CONFIG_T& config = Configuration.get();
-    publish(config.Mqtt.Lwt.Topic, config.Mqtt.Lwt.Value_Online);
+    const String willTopic = getPrefix() + config.Mqtt.Lwt.Topic;
 
     std::lock_guard<std::mutex> lock(_clientLock);
     if (_mqttClient != nullptr) {
+        // ahead of the messages in the journal
+        _mqttClient->publish(willTopic.c_str(), 0, config.Mqtt.Retain, config.Mqtt.Lwt.Value_Online);
+
         for (const auto& cb : _mqttSubscribeParser.get_callbacks()) {
             _mqttClient->subscribe(cb.topic.c_str(), cb.qos);
         }
@@ -61,6 +108,7 @@ void MqttSettingsClass::unsubscribe(const String& topic)
 void MqttSettingsClass::onMqttDisconnect(espMqttClientTypes::DisconnectReason reason)
 {
     MessageOutput.println("Disconnected from MQTT.");
+    _journalOverflow = false;
 
     MessageOutput.print("Disconnect reason:");
     switch (reason) {
@@ -85,8 +133,21 @@ void MqttSettingsClass::onMqttDisconnect(espMqttClientTypes::DisconnectReason re
     default:
         MessageOutput.println("Unknown");
     }
-    _mqttReconnectTimer.once(
-        2, +[](MqttSettingsClass* instance) { instance->performConnect(); }, this);
+    scheduleReconnect();
+}
+
+void MqttSettingsClass::scheduleReconnect()
+{
+    // the jitter of +/-25% keeps devices which lost the broker at the same
+    // time from reconnecting in lockstep.
+    uint32_t delay = _reconnectDelayMillis;
+    delay = delay - delay / 4 + esp_random() % (delay / 2 + 1);
+    _reconnectDelayMillis = std::min(_reconnectDelayMillis * 2, RECONNECT_DELAY_MAX_MILLIS);
+
+    MessageOutput.printf("Reconnecting to MQTT in %" PRIu32 " ms\r\n", delay);
+
+    _mqttReconnectTimer.once_ms(
+        delay, +[](MqttSettingsClass* instance) { instance->performConnect(); }, this);
 }
 
 void MqttSettingsClass::onMqttMessage(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, const size_t len, const size_t index, const size_t total)
@@ -119,11 +180,20 @@ void MqttSettingsClass::performConnect()
         const String willTopic = getPrefix() + config.Mqtt.Lwt.Topic;
         String clientId = getClientId();
         if (config.Mqtt.Tls.Enabled) {
-            static_cast<espMqttClientSecure*>(_mqttClient)->setCACert(config.Mqtt.Tls.RootCaCert);
+            // the client keeps the pointers, so the buffers are only
+            // replaced if the certificates changed.
+            auto load = [](String& target, ConfigurationClass::Certificate which) {
+                String pem = ConfigurationClass::readCertificate(which);
+                if (pem != target) { target = std::move(pem); }
+            };
+            load(_rootCaCert, ConfigurationClass::Certificate::RootCa);
+            static_cast<espMqttClientSecure*>(_mqttClient)->setCACert(_rootCaCert.c_str());
             static_cast<espMqttClientSecure*>(_mqttClient)->setServer(config.Mqtt.Hostname, config.Mqtt.Port);
             if (config.Mqtt.Tls.CertLogin) {
-                static_cast<espMqttClientSecure*>(_mqttClient)->setCertificate(config.Mqtt.Tls.ClientCert);
-                static_cast<espMqttClientSecure*>(_mqttClient)->setPrivateKey(config.Mqtt.Tls.ClientKey);
+                load(_clientCert, ConfigurationClass::Certificate::Client);
+                load(_clientKey, ConfigurationClass::Certificate::ClientKey);
+                static_cast<espMqttClientSecure*>(_mqttClient)->setCertificate(_clientCert.c_str());
+                static_cast<espMqttClientSecure*>(_mqttClient)->setPrivateKey(_clientKey.c_str());
             } else {
                 static_cast<espMqttClientSecure*>(_mqttClient)->setCredentials(config.Mqtt.Username, config.Mqtt.Password);
             }
@@ -162,8 +232,15 @@ void MqttSettingsClass::performReconnect()
 {
     performDisconnect();
 
+    {
+        // the settings changed, the messages might not apply anymore
+        std::lock_guard<std::mutex> lock(_journalLock);
+        _journal.clear();
+    }
+
     createMqttClientObject();
 
+    _reconnectDelayMillis = RECONNECT_DELAY_MIN_MILLIS;
     _mqttReconnectTimer.once(
         2, +[](MqttSettingsClass* instance) { instance->performConnect(); }, this);
 }
@@ -177,6 +254,54 @@ bool MqttSettingsClass::getConnected()
     return _mqttClient->connected();
 }
 
+bool MqttSettingsClass::acceptsPublishes()
+{
+    if (!Configuration.get().Mqtt.Enabled) { return false; }
+    return getConnected() || !_journalOverflow;
+}
+
+bool MqttSettingsClass::isOutboxCongested()
+{
+    std::lock_guard<std::mutex> lock(_clientLock);
+    return isOutboxFull();
+}
+
+bool MqttSettingsClass::isOutboxFull() const
+{
+    if (_mqttClient == nullptr) { return false; }
+
+    const uint16_t limit = Configuration.get().Mqtt.OutboxLimit;
+    return limit > 0 && _mqttClient->queueSize() >= limit;
+}
+
+bool MqttSettingsClass::dropValue(const char* topic, const uint8_t qos)
+{
+    // values are published periodically, so a newer one follows soon. all
+    // other messages, e.g., discovery documents, messages with QoS > 0 or
+    // messages to foreign topics, are never dropped here.
+    const char* prefix = Configuration.get().Mqtt.Topic;
+    const bool isValue = qos == 0 && strncmp(topic, prefix, strlen(prefix)) == 0;
+
+    if (!isValue) { return false; }
+
+    if (!isOutboxFull()) {
+        if (_droppingValues) {
+            MessageOutput.printf("[MqttSettings] Outbox drained, %" PRIu32 " values were "
+                    "dropped\r\n", _droppedValues);
+            _droppingValues = false;
+            _droppedValues = 0;
+        }
+        return false;
+    }
+
+    if (!_droppingValues) {
+        MessageOutput.print("[MqttSettings] Outbox is full, dropping values\r\n");
+        _droppingValues = true;
+    }
+    ++_droppedValues;
+    return true;
+}
+
 String MqttSettingsClass::getPrefix() const
 {
     return Configuration.get().Mqtt.Topic;
@@ -204,18 +329,129 @@ void MqttSettingsClass::publish(const String& subtopic, const String& payload)
 
 void MqttSettingsClass::publishGeneric(const String& topic, const String& payload, const bool retain, const uint8_t qos)
 {
+    publishRaw(topic.c_str(), payload.c_str(), retain, qos);
+}
+
+void MqttSettingsClass::publish(MqttTopicRegistryClass::Handle topic, const char* payload)
+{
+    auto const& config = Configuration.get();
+    const bool retain = config.Mqtt.Retain;
+
+    MqttTopicRegistry.withTopic(topic, config.Mqtt.Topic, [&](const char* fullTopic) {
+        publishRaw(fullTopic, payload, retain, 0);
+    });
+}
+
+void MqttSettingsClass::publish(MqttTopicRegistryClass::Handle topic, double value, uint8_t digits)
+{
+    char payload[Utils::FixedFormatSize];
+    Utils::formatFixed(payload, sizeof(payload), value, digits);
+    publish(topic, payload);
+}
+
+void MqttSettingsClass::publishRaw(const char* topic, const char* payload, const bool retain, const uint8_t qos)
+{
+    std::lock_guard<std::mutex> journalLock(_journalLock);
+    std::lock_guard<std::mutex> lock(_clientLock);
+    if (_mqttClient == nullptr) {
+        return;
+    }
+
+    if (!_journal.empty() || !_mqttClient->connected()) {
+        enqueue(topic, payload, retain, qos);
+        return;
+    }
+
+    if (dropValue(topic, qos)) { return; }
+
+    _mqttClient->publish(topic, qos, retain, payload);
+}
+
+void MqttSettingsClass::publishBatch(const std::vector<Message>& messages)
+{
+    const bool retain = Configuration.get().Mqtt.Retain;
+
+    std::lock_guard<std::mutex> journalLock(_journalLock);
     std::lock_guard<std::mutex> lock(_clientLock);
     if (_mqttClient == nullptr) {
         return;
     }
-    _mqttClient->publish(topic.c_str(), qos, retain, payload.c_str());
+
+    if (!_journal.empty() || !_mqttClient->connected()) {
+        for (auto const& message : messages) {
+            enqueue(message.first, message.second.c_str(), retain, 0);
+        }
+        return;
+    }
+
+    for (auto const& message : messages) {
+        if (dropValue(message.first, 0)) { continue; }
+        _mqttClient->publish(message.first, 0, retain, message.second.c_str());
+    }
 }
 
-void MqttSettingsClass::init()
+void MqttSettingsClass::enqueue(const char* topic, const char* payload, const bool retain, const uint8_t qos)
+{
+    if (!Configuration.get().Mqtt.Enabled) { return; }
+
+    if (!_journal.isAllocated()) {
+        size_t capacity = psramFound() ? JOURNAL_CAPACITY_PSRAM : JOURNAL_CAPACITY;
+        if (!_journal.allocate(capacity)) {
+            MessageOutput.printf("[MqttSettings] Failed to allocate %u bytes for the offline journal\r\n",
+                    static_cast<unsigned>(capacity));
+            _journalOverflow = true;
+            return;
+        }
+    }
+
+    auto dropped = _journal.getDropped();
+    bool appended = _journal.append(topic, payload, retain, qos);
+    if (appended && _journal.getDropped() == dropped) { return; }
+
+    if (!_journalOverflow) {
+        MessageOutput.print("[MqttSettings] Offline journal is full, dropping messages\r\n");
+    }
+    _journalOverflow = true;
+}
+
+void MqttSettingsClass::drainJournal()
+{
+    std::lock_guard<std::mutex> journalLock(_journalLock);
+    if (_journal.empty()) { return; }
+
+    std::lock_guard<std::mutex> lock(_clientLock);
+    if (_mqttClient == nullptr || !_mqttClient->connected()) { return; }
+
+    // mqtt messages carry no timestamp, so the age is only used to discard
+    // samples which are of no use anymore.
+    for (size_t i = 0; i < JOURNAL_DRAIN_BATCH; ++i) {
+        MqttJournal::Message message;
+        if (!_journal.front(message)) { break; }
+
+        if (millis() - message.Millis < JOURNAL_MAX_AGE_MILLIS) {
+            // the client's outbox is full, retry later
+            if (_mqttClient->publish(message.Topic, message.Qos, message.Retain, message.Payload) == 0) {
+                break;
+            }
+        }
+
+        _journal.pop();
+    }
+
+    if (_journal.empty()) {
+        MessageOutput.printf("[MqttSettings] Offline journal was sent, %" PRIu32 " messages "
+                "were dropped so far\r\n", _journal.getDropped());
+    }
+}
+
+void MqttSettingsClass::init(Scheduler& scheduler)
 {
     using std::placeholders::_1;
     NetworkSettings.onEvent(std::bind(&MqttSettingsClass::NetworkEvent, this, _1));
 
+    scheduler.addTask(_journalTask);
+    _journalTask.enable();
+
     createMqttClientObject();
 }
 
@@ -226,6 +462,12 @@ void MqttSettingsClass::createMqttClientObject()
         delete _mqttClient;
         _mqttClient = nullptr;
     }
+
+    // no longer referenced by any client
+    _rootCaCert = String();
+    _clientCert = String();
+    _clientKey = String();
+
     const CONFIG_T& config = Configuration.get();
     if (config.Mqtt.Tls.Enabled) {
         _mqttClient = static_cast<MqttClient*>(new espMqttClientSecure);
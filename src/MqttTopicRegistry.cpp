@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "MqttTopicRegistry.h"
+#include "MessageOutput.h"
+#include <algorithm>
+#include <cstring>
+
+MqttTopicRegistryClass MqttTopicRegistry;
+
+namespace {
+
+// 32 bit FNV-1a over all parts
+uint32_t hashParts(std::initializer_list<char const*> parts)
+{
+    uint32_t result = 2166136261UL;
+    for (char const* part : parts) {
+        for (char const* c = part; *c != '\0'; ++c) {
+            result ^= static_cast<uint8_t>(*c);
+            result *= 16777619UL;
+        }
+    }
+    return result;
+}
+
+bool equalsParts(std::string const& subtopic, std::initializer_list<char const*> parts)
+{
+    size_t offset = 0;
+    for (char const* part : parts) {
+        size_t length = strlen(part);
+        if (subtopic.compare(offset, length, part) != 0) { return false; }
+        offset += length;
+    }
+    return offset == subtopic.size();
+}
+
+} // namespace
+
+MqttTopicRegistryClass::Handle MqttTopicRegistryClass::intern(char const* part1, char const* part2, char const* part3)
+{
+    auto parts = { part1, part2, part3 };
+    uint32_t hash = hashParts(parts);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = std::lower_bound(_index.begin(), _index.end(), hash,
+        [](auto const& entry, uint32_t h) { return entry.first < h; });
+
+    for (auto match = it; match != _index.end() && match->first == hash; ++match) {
+        if (equalsParts(_subtopics[match->second], parts)) { return match->second; }
+    }
+
+    if (_subtopics.size() >= MaxTopics) {
+        if (!_fullReported) {
+            MessageOutput.printf("[MqttTopicRegistry] Cannot intern more than %u topics\r\n",
+                    static_cast<unsigned>(MaxTopics));
+            _fullReported = true;
+        }
+        return Invalid;
+    }
+
+    Handle handle = _subtopics.size();
+
+    std::string subtopic;
+    for (char const* part : parts) { subtopic += part; }
+
+    _topics.push_back(_prefix + subtopic);
+    _subtopics.push_back(std::move(subtopic));
+    _index.insert(it, { hash, handle });
+
+    return handle;
+}
+
+void MqttTopicRegistryClass::rebuild(char const* prefix)
+{
+    _prefix = prefix;
+
+    for (size_t i = 0; i < _topics.size(); ++i) {
+        _topics[i].assign(_prefix);
+        _topics[i].append(_subtopics[i]);
+    }
+}
@@ -12,9 +12,27 @@
 #include "defaults.h"
 #include <ESPmDNS.h>
 #include <ETH.h>
+#include <esp_netif.h>
+#include <Preferences.h>
+#include <algorithm>
+#include "TaskProfiler.h"
+
+static constexpr char const* FAST_CONNECT_NAMESPACE = "wifi_fast";
+static constexpr char const* FAST_CONNECT_KEY = "last_ap";
+
+// FNV-1a, only used to tell whether the cached access point belongs to the
+// configured network.
+static uint32_t hashSsid(char const* ssid)
+{
+    uint32_t hash = 2166136261UL;
+    for (; *ssid; ++ssid) {
+        hash = (hash ^ static_cast<uint8_t>(*ssid)) * 16777619UL;
+    }
+    return hash;
+}
 
 NetworkSettingsClass::NetworkSettingsClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&NetworkSettingsClass::loop, this))
+    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, TaskProfiler.wrap("NetworkSettings::loop", std::bind(&NetworkSettingsClass::loop, this)))
     , _apIp(192, 168, 4, 1)
     , _apNetmask(255, 255, 255, 0)
 {
@@ -29,13 +47,20 @@ void NetworkSettingsClass::init(Scheduler& scheduler)
     WiFi.setScanMethod(WIFI_ALL_CHANNEL_SCAN);
     WiFi.setSortMethod(WIFI_CONNECT_AP_BY_SIGNAL);
 
+    // the credentials are taken from our own configuration. connecting to a
+    // specific access point must not rewrite the WiFi config in flash.
+    WiFi.persistent(false);
+
     WiFi.disconnect(true, true);
 
+    loadFastConnect();
+
     WiFi.onEvent(std::bind(&NetworkSettingsClass::NetworkEvent, this, _1, _2));
 
     if (PinMapping.isValidW5500Config()) {
         PinMapping_t& pin = PinMapping.get();
-        _w5500 = W5500::setup(pin.w5500_mosi, pin.w5500_miso, pin.w5500_sclk, pin.w5500_cs, pin.w5500_int, pin.w5500_rst);
+        _w5500 = W5500::setup(pin.w5500_mosi, pin.w5500_miso, pin.w5500_sclk, pin.w5500_cs, pin.w5500_int, pin.w5500_rst, pin.w5500_spi_mhz);
+        _ethAvailable = _w5500 != nullptr;
         if (_w5500)
             MessageOutput.println("W5500: Connection successful");
         else
@@ -49,6 +74,7 @@ void NetworkSettingsClass::init(Scheduler& scheduler)
 #else
         ETH.begin(pin.eth_type, pin.eth_phy_addr, pin.eth_mdc, pin.eth_mdio, pin.eth_power, pin.eth_clk_mode);
 #endif
+        _ethAvailable = true;
     }
 #endif
 
@@ -78,10 +104,12 @@ void NetworkSettingsClass::NetworkEvent(const WiFiEvent_t event, WiFiEventInfo_t
     case ARDUINO_EVENT_ETH_CONNECTED:
         MessageOutput.println("ETH connected");
         _ethConnected = true;
+        _routeDirty = true;
         raiseEvent(network_event::NETWORK_CONNECTED);
         break;
     case ARDUINO_EVENT_ETH_GOT_IP:
         MessageOutput.printf("ETH got IP: %s\r\n", ETH.localIP().toString().c_str());
+        _routeDirty = true;
         if (_networkMode == network_mode::Ethernet) {
             raiseEvent(network_event::NETWORK_GOT_IP);
         }
@@ -89,12 +117,16 @@ void NetworkSettingsClass::NetworkEvent(const WiFiEvent_t event, WiFiEventInfo_t
     case ARDUINO_EVENT_ETH_DISCONNECTED:
         MessageOutput.println("ETH disconnected");
         _ethConnected = false;
+        _routeDirty = true;
         if (_networkMode == network_mode::Ethernet) {
             raiseEvent(network_event::NETWORK_DISCONNECTED);
         }
         break;
     case ARDUINO_EVENT_WIFI_STA_CONNECTED:
         MessageOutput.println("WiFi connected");
+        if (_networkMode == network_mode::WiFi || _failover) {
+            _wifiConnected = true;
+        }
         if (_networkMode == network_mode::WiFi) {
             raiseEvent(network_event::NETWORK_CONNECTED);
         }
@@ -102,19 +134,27 @@ void NetworkSettingsClass::NetworkEvent(const WiFiEvent_t event, WiFiEventInfo_t
     case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
         // Reason codes can be found here: https://github.com/espressif/esp-idf/blob/5454d37d496a8c58542eb450467471404c606501/components/esp_wifi/include/esp_wifi_types_generic.h#L79-L141
         MessageOutput.printf("WiFi disconnected: %" PRIu8 "\r\n", info.wifi_sta_disconnected.reason);
+        _routeDirty = true;
+        if (_networkMode == network_mode::WiFi || _failover) {
+            // leaving the access point is caused by (re)connecting ourselves
+            if (info.wifi_sta_disconnected.reason != WIFI_REASON_ASSOC_LEAVE) {
+                _wifiDisconnected = true;
+            }
+        }
         if (_networkMode == network_mode::WiFi) {
-            MessageOutput.println("Try reconnecting");
-            WiFi.disconnect(true, false);
-            WiFi.begin();
             raiseEvent(network_event::NETWORK_DISCONNECTED);
         }
         break;
     case ARDUINO_EVENT_WIFI_STA_GOT_IP:
         MessageOutput.printf("WiFi got ip: %s\r\n", WiFi.localIP().toString().c_str());
+        _routeDirty = true;
         if (_networkMode == network_mode::WiFi) {
             raiseEvent(network_event::NETWORK_GOT_IP);
         }
         break;
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+        _routeDirty = true;
+        break;
     default:
         break;
     }
@@ -185,7 +225,7 @@ void NetworkSettingsClass::setupMode()
     } else {
         _dnsServerStatus = false;
         _dnsServer->stop();
-        if (_networkMode == network_mode::WiFi) {
+        if (_networkMode == network_mode::WiFi || _failover) {
             WiFi.mode(WIFI_STA);
         } else {
             WiFi.mode(WIFI_MODE_NULL);
@@ -206,23 +246,64 @@ String NetworkSettingsClass::getApName() const
     return String(ACCESS_POINT_NAME + String(Utils::getChipId()));
 }
 
+bool NetworkSettingsClass::isFailoverEnabled() const
+{
+    auto const& config = Configuration.get().WiFi;
+
+    // both interfaces would claim the same static address
+    return _ethAvailable && config.Failover && config.Dhcp && strlen(config.Ssid) > 0;
+}
+
 void NetworkSettingsClass::loop()
 {
-    if (_ethConnected) {
+    bool failover = isFailoverEnabled();
+    _failover = failover;
+
+    if (!_ethConnected) {
+        _ethConfigured = false;
+    } else if (failover && !_ethConfigured) {
+        // WiFi stays in use until Ethernet got an address
+        setStaticIp(network_mode::Ethernet);
+        setHostname(network_mode::Ethernet);
+        _ethConfigured = true;
+    }
+
+    bool ethReady = _ethConnected
+        && (!failover || ETH.localIP()[0] != 0 || WiFi.localIP()[0] == 0);
+
+    if (ethReady) {
         if (_networkMode != network_mode::Ethernet) {
             // Do stuff when switching to Ethernet mode
             MessageOutput.println("Switch to Ethernet mode");
+            bool fromWiFi = _networkMode == network_mode::WiFi;
             _networkMode = network_mode::Ethernet;
-            WiFi.mode(WIFI_MODE_NULL);
-            setStaticIp();
-            setHostname();
+            if (!failover) {
+                WiFi.mode(WIFI_MODE_NULL);
+                setStaticIp(_networkMode);
+                setHostname(_networkMode);
+            } else if (fromWiFi) {
+                moveDefaultRoute();
+            }
         }
     } else if (_networkMode != network_mode::WiFi) {
         // Do stuff when switching to Ethernet mode
         MessageOutput.println("Switch to WiFi mode");
         _networkMode = network_mode::WiFi;
-        enableAdminMode();
-        applyConfig();
+        if (failover && WiFi.localIP()[0] != 0) {
+            // WiFi was kept connected, only the route needs to move
+            moveDefaultRoute();
+        } else {
+            enableAdminMode();
+            applyConfig();
+        }
+    }
+
+    if (_networkMode == network_mode::WiFi || failover) {
+        handleWiFiReconnect();
+    }
+
+    if (failover && _routeDirty.exchange(false)) {
+        applyDefaultRoute();
     }
 
     if (millis() - _lastTimerCall > 1000) {
@@ -279,32 +360,160 @@ void NetworkSettingsClass::loop()
     handleMDNS();
 }
 
+void NetworkSettingsClass::moveDefaultRoute()
+{
+    MessageOutput.printf("Default route moved to %s\r\n",
+            (_networkMode == network_mode::Ethernet ? "Ethernet" : "WiFi"));
+
+    applyDefaultRoute();
+    ++_routeGeneration;
+    raiseEvent(network_event::NETWORK_FAILOVER);
+}
+
+void NetworkSettingsClass::applyDefaultRoute()
+{
+    char const* ifkey = (_networkMode == network_mode::Ethernet) ? "ETH_DEF" : "WIFI_STA_DEF";
+    esp_netif_t* netif = esp_netif_get_handle_from_ifkey(ifkey);
+    if (netif == nullptr) { return; }
+
+    esp_netif_set_default_netif(netif);
+}
+
+void NetworkSettingsClass::setLowPowerMode(bool enabled)
+{
+    if (enabled && WiFi.getMode() == WIFI_STA) {
+        WiFi.setSleep(WIFI_PS_MAX_MODEM);
+        return;
+    }
+
+    WiFi.setSleep(Configuration.get().WiFi.PowerSave ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE);
+}
+
 void NetworkSettingsClass::applyConfig()
 {
-    setHostname();
+    setHostname(_networkMode);
     if (!strcmp(Configuration.get().WiFi.Ssid, "")) {
         return;
     }
-    MessageOutput.print("Configuring WiFi STA using ");
-    if (strcmp(WiFi.SSID().c_str(), Configuration.get().WiFi.Ssid) || strcmp(WiFi.psk().c_str(), Configuration.get().WiFi.Password)) {
-        MessageOutput.print("new credentials... ");
-        WiFi.begin(
-            Configuration.get().WiFi.Ssid,
-            Configuration.get().WiFi.Password);
-    } else {
-        MessageOutput.print("existing credentials... ");
-        WiFi.begin();
-    }
-    MessageOutput.println("done");
-    setStaticIp();
+
+    // a static IP is configured before connecting, such that no DHCP
+    // request is started in the meantime.
+    setStaticIp(_networkMode);
+
+    setLowPowerMode(false);
+
+    MessageOutput.println("Configuring WiFi STA");
+    _reconnectScheduled = false;
+    _reconnectBackoffMillis = 0;
+    connectWiFi(true);
 
     Syslog.updateSettings(getHostname());
 }
 
-void NetworkSettingsClass::setHostname()
+void NetworkSettingsClass::connectWiFi(bool fast)
+{
+    auto const& config = Configuration.get().WiFi;
+
+    _connectStartMillis = millis();
+    _fastConnectPending = fast && _fastConnectValid
+        && _fastConnect.SsidHash == hashSsid(config.Ssid);
+
+    if (!_fastConnectPending) {
+        WiFi.begin(config.Ssid, config.Password);
+        return;
+    }
+
+    auto const& bssid = _fastConnect.Bssid;
+    MessageOutput.printf("Connecting to %02X:%02X:%02X:%02X:%02X:%02X on channel %" PRIu8 "\r\n",
+            bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5], _fastConnect.Channel);
+    WiFi.begin(config.Ssid, config.Password, _fastConnect.Channel, bssid);
+}
+
+void NetworkSettingsClass::handleWiFiReconnect()
+{
+    if (_wifiConnected.exchange(false)) {
+        _fastConnectPending = false;
+        _reconnectBackoffMillis = 0;
+        storeFastConnect();
+    }
+
+    // searching for access points was disabled to keep the admin AP usable
+    if (_forceDisconnection) {
+        _wifiDisconnected = false;
+        _reconnectScheduled = false;
+        return;
+    }
+
+    bool disconnected = _wifiDisconnected.exchange(false);
+
+    // the access point we connected to last is gone or moved to another
+    // channel. scan all channels right away.
+    if (_fastConnectPending &&
+            (disconnected || millis() - _connectStartMillis > FastConnectTimeoutMillis)) {
+        MessageOutput.println("Fast connect failed, scanning for AP");
+        _fastConnectValid = false;
+        WiFi.disconnect(true, false);
+        connectWiFi(false);
+        return;
+    }
+
+    if (disconnected && !_reconnectScheduled) {
+        _reconnectScheduled = true;
+        _disconnectMillis = millis();
+    }
+
+    if (!_reconnectScheduled || millis() - _disconnectMillis < _reconnectBackoffMillis) {
+        return;
+    }
+
+    // the first attempt is made right away, further ones are delayed more
+    // and more, such that an absent access point is not searched constantly.
+    MessageOutput.printf("Try reconnecting after %" PRIu32 " ms\r\n", _reconnectBackoffMillis);
+    _reconnectScheduled = false;
+    _reconnectBackoffMillis = std::min(ReconnectBackoffMaxMillis,
+            std::max(ReconnectBackoffMinMillis, _reconnectBackoffMillis * 2));
+
+    WiFi.disconnect(true, false);
+    connectWiFi(true);
+}
+
+void NetworkSettingsClass::loadFastConnect()
+{
+    Preferences prefs;
+    if (!prefs.begin(FAST_CONNECT_NAMESPACE, true)) { return; }
+
+    _fastConnectValid = prefs.getBytes(FAST_CONNECT_KEY, &_fastConnect,
+            sizeof(_fastConnect)) == sizeof(_fastConnect);
+    prefs.end();
+}
+
+void NetworkSettingsClass::storeFastConnect()
+{
+    FastConnect current;
+    memset(&current, 0, sizeof(current));
+    current.SsidHash = hashSsid(Configuration.get().WiFi.Ssid);
+    current.Channel = WiFi.channel();
+
+    uint8_t const* bssid = WiFi.BSSID();
+    if (bssid == nullptr) { return; }
+    memcpy(current.Bssid, bssid, sizeof(current.Bssid));
+
+    _fastConnectValid = true;
+
+    // only written when roaming to another access point, which is rare
+    if (memcmp(&current, &_fastConnect, sizeof(current)) == 0) { return; }
+    _fastConnect = current;
+
+    Preferences prefs;
+    if (!prefs.begin(FAST_CONNECT_NAMESPACE, false)) { return; }
+    prefs.putBytes(FAST_CONNECT_KEY, &_fastConnect, sizeof(_fastConnect));
+    prefs.end();
+}
+
+void NetworkSettingsClass::setHostname(network_mode mode)
 {
     MessageOutput.print("Setting Hostname... ");
-    if (_networkMode == network_mode::WiFi) {
+    if (mode == network_mode::WiFi) {
         if (WiFi.hostname(getHostname())) {
             MessageOutput.println("done");
         } else {
@@ -315,7 +524,7 @@ void NetworkSettingsClass::setHostname()
         WiFi.mode(WIFI_MODE_APSTA);
         WiFi.mode(WIFI_MODE_STA);
         setupMode();
-    } else if (_networkMode == network_mode::Ethernet) {
+    } else if (mode == network_mode::Ethernet) {
         if (ETH.setHostname(getHostname().c_str())) {
             MessageOutput.println("done");
         } else {
@@ -324,9 +533,9 @@ void NetworkSettingsClass::setHostname()
     }
 }
 
-void NetworkSettingsClass::setStaticIp()
+void NetworkSettingsClass::setStaticIp(network_mode mode)
 {
-    if (_networkMode == network_mode::WiFi) {
+    if (mode == network_mode::WiFi) {
         if (Configuration.get().WiFi.Dhcp) {
             MessageOutput.print("Configuring WiFi STA DHCP IP... ");
             WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
@@ -341,7 +550,7 @@ void NetworkSettingsClass::setStaticIp()
                 IPAddress(Configuration.get().WiFi.Dns2));
             MessageOutput.println("done");
         }
-    } else if (_networkMode == network_mode::Ethernet) {
+    } else if (mode == network_mode::Ethernet) {
         if (Configuration.get().WiFi.Dhcp) {
             MessageOutput.print("Configuring Ethernet DHCP IP... ");
             ETH.config(INADDR_NONE, INADDR_NONE, INADDR_NONE, INADDR_NONE);
@@ -415,6 +624,14 @@ IPAddress NetworkSettingsClass::dnsIP(const uint8_t dns_no) const
     }
 }
 
+std::optional<W5500::Stats> NetworkSettingsClass::getW5500Stats()
+{
+    if (!_w5500) {
+        return std::nullopt;
+    }
+    return _w5500->getStats();
+}
+
 String NetworkSettingsClass::macAddress() const
 {
     switch (_networkMode) {
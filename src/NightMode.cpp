@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "NightMode.h"
+#include "Configuration.h"
+#include "MessageOutput.h"
+#include "NetworkSettings.h"
+#include "PowerLimiter.h"
+#include "SunPosition.h"
+#include "TaskProfiler.h"
+#include <Hoymiles.h>
+
+NightModeClass NightMode;
+
+NightModeClass::NightModeClass()
+    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("NightMode::loop", std::bind(&NightModeClass::loop, this)))
+{
+}
+
+void NightModeClass::init(Scheduler& scheduler)
+{
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+void NightModeClass::addIdleTask(Task& task)
+{
+    _idleTasks.push_back({ &task, 0 });
+}
+
+void NightModeClass::notifyActivity()
+{
+    _lastActivityMillis = millis();
+    _activity = true;
+}
+
+bool NightModeClass::shouldBeActive() const
+{
+    if (!Configuration.get().Dtu.LowPowerNight) { return false; }
+
+    // without the sun's position, the night cannot be told from the day
+    if (!SunPosition.isSunsetAvailable() || SunPosition.isDayPeriod()) { return false; }
+
+    if (PowerLimiter.isGovernedBatteryPoweredInverterProducing()) { return false; }
+
+    return millis() - _lastActivityMillis > ActivityTimeoutMillis;
+}
+
+void NightModeClass::loop()
+{
+    // activity is handled right away, whereas entering the low-power mode
+    // may wait for the next run
+    if (_activity.exchange(false) && _active) { leave(); }
+
+    bool active = shouldBeActive();
+    if (active == _active) { return; }
+
+    if (active) { enter(); } else { leave(); }
+}
+
+void NightModeClass::enter()
+{
+    MessageOutput.print("[NightMode] Entering low-power mode\r\n");
+    _active = true;
+
+    Hoymiles.setIdlePollFactor(PollFactor);
+
+    for (auto& idleTask : _idleTasks) {
+        idleTask.DayInterval = idleTask.pTask->getInterval();
+        idleTask.pTask->setInterval(idleTask.DayInterval * TaskFactor);
+    }
+
+    NetworkSettings.setLowPowerMode(true);
+
+    _dayCpuFrequencyMhz = getCpuFrequencyMhz();
+    setCpuFrequencyMhz(CpuFrequencyMhz);
+}
+
+void NightModeClass::leave()
+{
+    _active = false;
+
+    if (_dayCpuFrequencyMhz > 0) { setCpuFrequencyMhz(_dayCpuFrequencyMhz); }
+
+    NetworkSettings.setLowPowerMode(false);
+
+    Hoymiles.setIdlePollFactor(1);
+
+    for (auto& idleTask : _idleTasks) {
+        // the interval may have been changed in the meantime, e.g., by
+        // applying a new configuration, which is kept then
+        if (idleTask.pTask->getInterval() != idleTask.DayInterval * TaskFactor) { continue; }
+        idleTask.pTask->setInterval(idleTask.DayInterval);
+        // run the tasks now, such that the data is up to date right away
+        idleTask.pTask->forceNextIteration();
+    }
+
+    MessageOutput.print("[NightMode] Leaving low-power mode\r\n");
+}
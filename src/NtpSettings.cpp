@@ -4,7 +4,11 @@
  */
 #include "NtpSettings.h"
 #include "Configuration.h"
+#include "MessageOutput.h"
 #include <Arduino.h>
+#include <atomic>
+#include <cstring>
+#include <sys/time.h>
 #include <time.h>
 
 NtpSettingsClass::NtpSettingsClass()
@@ -28,4 +32,44 @@ void NtpSettingsClass::setTimezone()
     tzset();
 }
 
+// the seconds since the epoch of the given UTC date, as there is no timegm()
+static time_t toEpoch(struct tm const& utc)
+{
+    int year = utc.tm_year + 1900;
+    int month = utc.tm_mon + 1;
+
+    // days since 1970-01-01 of a proleptic Gregorian date
+    year -= month <= 2;
+    int era = year / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + utc.tm_mday - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    int64_t days = static_cast<int64_t>(era) * 146097 + dayOfEra - 719468;
+
+    return static_cast<time_t>(days * 86400 + utc.tm_hour * 3600 + utc.tm_min * 60 + utc.tm_sec);
+}
+
+void NtpSettingsClass::setTimeFromHttpDate(char const* date)
+{
+    struct tm timeinfo;
+    if (getLocalTime(&timeinfo, 0)) { return; }
+
+    // e.g., "Sun, 06 Nov 1994 08:49:37 GMT" as mandated by RFC 9110
+    struct tm utc = {};
+    char const* end = strptime(date, "%a, %d %b %Y %H:%M:%S", &utc);
+    if (end == nullptr || strncmp(end, " GMT", 4) != 0) { return; }
+
+    // devices without a clock of their own report dates like 1970-01-01
+    if (utc.tm_year + 1900 < 2024) { return; }
+
+    // two power meter tasks may pass their responses at the same time
+    static std::atomic<bool> sTaken = false;
+    if (sTaken.exchange(true)) { return; }
+
+    struct timeval tv = { .tv_sec = toEpoch(utc), .tv_usec = 0 };
+    settimeofday(&tv, nullptr);
+
+    MessageOutput.printf("[NtpSettings] Time set from HTTP response: %s\r\n", date);
+}
+
 NtpSettingsClass NtpSettings;
\ No newline at end of file
@@ -5,8 +5,11 @@
 #include "PinMapping.h"
 #include "MessageOutput.h"
 #include "Utils.h"
+#include "__compiled_constants.h"
 #include <ArduinoJson.h>
 #include <LittleFS.h>
+#include <esp_rom_crc.h>
+#include <memory>
 #include <string.h>
 
 #ifndef DISPLAY_TYPE
@@ -109,6 +112,10 @@
 #define W5500_RST -1
 #endif
 
+#ifndef W5500_SPI_MHZ
+#define W5500_SPI_MHZ 20
+#endif
+
 #if CONFIG_ETH_USE_ESP32_EMAC
 
 #ifndef ETH_PHY_ADDR
@@ -161,6 +168,14 @@
 #define VICTRON_PIN_RX3 -1
 #endif
 
+#ifndef VICTRON_PIN_TX4
+#define VICTRON_PIN_TX4 -1
+#endif
+
+#ifndef VICTRON_PIN_RX4
+#define VICTRON_PIN_RX4 -1
+#endif
+
 #ifndef BATTERY_PIN_RX
 #define BATTERY_PIN_RX -1
 #endif
@@ -187,6 +202,22 @@
 #define BATTERY_PIN_TXEN -1
 #endif
 
+#ifndef BATTERY2_PIN_RX
+#define BATTERY2_PIN_RX -1
+#endif
+
+#ifndef BATTERY2_PIN_RXEN
+#define BATTERY2_PIN_RXEN -1
+#endif
+
+#ifndef BATTERY2_PIN_TX
+#define BATTERY2_PIN_TX -1
+#endif
+
+#ifndef BATTERY2_PIN_TXEN
+#define BATTERY2_PIN_TXEN -1
+#endif
+
 #ifndef HUAWEI_PIN_MISO
 #define HUAWEI_PIN_MISO -1
 #endif
@@ -264,6 +295,7 @@ PinMappingClass::PinMappingClass()
     _pinMapping.w5500_cs = W5500_CS;
     _pinMapping.w5500_int = W5500_INT;
     _pinMapping.w5500_rst = W5500_RST;
+    _pinMapping.w5500_spi_mhz = W5500_SPI_MHZ;
 
 #if CONFIG_ETH_USE_ESP32_EMAC
 #ifdef OPENDTU_ETHERNET
@@ -298,11 +330,19 @@ PinMappingClass::PinMappingClass()
     _pinMapping.victron_rx3 = VICTRON_PIN_RX3;
     _pinMapping.victron_tx3 = VICTRON_PIN_TX3;
 
+    _pinMapping.victron_rx4 = VICTRON_PIN_RX4;
+    _pinMapping.victron_tx4 = VICTRON_PIN_TX4;
+
     _pinMapping.battery_rx = BATTERY_PIN_RX;
     _pinMapping.battery_rxen = BATTERY_PIN_RXEN;
     _pinMapping.battery_tx = BATTERY_PIN_TX;
     _pinMapping.battery_txen = BATTERY_PIN_TXEN;
 
+    _pinMapping.battery2_rx = BATTERY2_PIN_RX;
+    _pinMapping.battery2_rxen = BATTERY2_PIN_RXEN;
+    _pinMapping.battery2_tx = BATTERY2_PIN_TX;
+    _pinMapping.battery2_txen = BATTERY2_PIN_TXEN;
+
     _pinMapping.huawei_miso = HUAWEI_PIN_MISO;
     _pinMapping.huawei_mosi = HUAWEI_PIN_MOSI;
     _pinMapping.huawei_clk = HUAWEI_PIN_SCLK;
@@ -324,6 +364,92 @@ PinMapping_t& PinMappingClass::get()
     return _pinMapping;
 }
 
+struct PinMappingCacheHeader {
+    uint32_t Magic;
+    uint32_t PayloadSize;
+    uint32_t JsonSize;
+    uint32_t JsonCrc;
+    char GitHash[16];
+    uint32_t Crc;
+};
+
+struct PinMappingCache {
+    PinMappingCacheHeader Header;
+    PinMapping_t Mapping;
+};
+
+static constexpr uint32_t PINMAPPING_CACHE_MAGIC = 0x4f50494e; // "OPIN"
+
+// the cache is only accepted if it was compiled from the very same JSON
+// file by the very same firmware build, as the defaults of the pins are
+// build flags and the layout of PinMapping_t is not versioned.
+static void fillCacheHeader(PinMappingCacheHeader& header, File& json, PinMapping_t const& mapping)
+{
+    header.Magic = PINMAPPING_CACHE_MAGIC;
+    header.PayloadSize = sizeof(PinMapping_t);
+    header.JsonSize = json.size();
+
+    uint32_t crc = 0;
+    uint8_t buffer[256];
+    json.seek(0);
+    while (size_t length = json.read(buffer, sizeof(buffer))) {
+        crc = esp_rom_crc32_le(crc, buffer, length);
+    }
+    json.seek(0);
+    header.JsonCrc = crc;
+
+    strlcpy(header.GitHash, __COMPILED_GIT_HASH__, sizeof(header.GitHash));
+    header.Crc = esp_rom_crc32_le(0, reinterpret_cast<uint8_t const*>(&mapping), sizeof(PinMapping_t));
+}
+
+bool PinMappingClass::readCache(File& json, const String& deviceMapping)
+{
+    File f = LittleFS.open(PINMAPPING_CACHE_FILENAME, "r", false);
+    if (!f) { return false; }
+
+    if (f.size() != sizeof(PinMappingCache)) { return false; }
+
+    auto upCache = std::make_unique<PinMappingCache>();
+    size_t bytesRead = f.read(reinterpret_cast<uint8_t*>(upCache.get()), sizeof(PinMappingCache));
+    f.close();
+
+    if (bytesRead != sizeof(PinMappingCache)) { return false; }
+
+    if (deviceMapping != upCache->Mapping.name) { return false; }
+
+    PinMappingCacheHeader expected;
+    memset(&expected, 0, sizeof(expected));
+    fillCacheHeader(expected, json, upCache->Mapping);
+
+    if (memcmp(&expected, &upCache->Header, sizeof(expected)) != 0) {
+        MessageOutput.println("Pin mapping cache outdated");
+        return false;
+    }
+
+    memcpy(&_pinMapping, &upCache->Mapping, sizeof(_pinMapping));
+    return true;
+}
+
+void PinMappingClass::writeCache(File& json)
+{
+    auto upCache = std::make_unique<PinMappingCache>();
+    memset(upCache.get(), 0, sizeof(PinMappingCache));
+    memcpy(&upCache->Mapping, &_pinMapping, sizeof(_pinMapping));
+    fillCacheHeader(upCache->Header, json, upCache->Mapping);
+
+    File f = LittleFS.open(PINMAPPING_CACHE_FILENAME, "w");
+    if (!f) { return; }
+
+    bool success = f.write(reinterpret_cast<uint8_t const*>(upCache.get()),
+            sizeof(PinMappingCache)) == sizeof(PinMappingCache);
+    f.close();
+
+    if (!success) {
+        MessageOutput.println("Failed to write pin mapping cache");
+        LittleFS.remove(PINMAPPING_CACHE_FILENAME);
+    }
+}
+
 bool PinMappingClass::init(const String& deviceMapping)
 {
     File f = LittleFS.open(PINMAPPING_FILENAME, "r", false);
@@ -332,6 +458,13 @@ bool PinMappingClass::init(const String& deviceMapping)
         return false;
     }
 
+    // the selected profile is cached in binary form, such that the JSON
+    // file, which holds the profiles of many boards, is only parsed once.
+    if (readCache(f, deviceMapping)) {
+        _mappingSelected = true;
+        return true;
+    }
+
     Utils::skipBom(f);
 
     JsonDocument doc;
@@ -367,6 +500,7 @@ bool PinMappingClass::init(const String& deviceMapping)
             _pinMapping.w5500_cs = doc[i]["w5500"]["cs"] | W5500_CS;
             _pinMapping.w5500_int = doc[i]["w5500"]["int"] | W5500_INT;
             _pinMapping.w5500_rst = doc[i]["w5500"]["rst"] | W5500_RST;
+            _pinMapping.w5500_spi_mhz = doc[i]["w5500"]["spi_mhz"] | W5500_SPI_MHZ;
 
 #if CONFIG_ETH_USE_ESP32_EMAC
 #ifdef OPENDTU_ETHERNET
@@ -398,12 +532,19 @@ bool PinMappingClass::init(const String& deviceMapping)
             _pinMapping.victron_tx2 = doc[i]["victron"]["tx2"] | VICTRON_PIN_TX2;
             _pinMapping.victron_rx3 = doc[i]["victron"]["rx3"] | VICTRON_PIN_RX3;
             _pinMapping.victron_tx3 = doc[i]["victron"]["tx3"] | VICTRON_PIN_TX3;
+            _pinMapping.victron_rx4 = doc[i]["victron"]["rx4"] | VICTRON_PIN_RX4;
+            _pinMapping.victron_tx4 = doc[i]["victron"]["tx4"] | VICTRON_PIN_TX4;
 
             _pinMapping.battery_rx = doc[i]["battery"]["rx"] | BATTERY_PIN_RX;
             _pinMapping.battery_rxen = doc[i]["battery"]["rxen"] | BATTERY_PIN_RXEN;
             _pinMapping.battery_tx = doc[i]["battery"]["tx"] | BATTERY_PIN_TX;
             _pinMapping.battery_txen = doc[i]["battery"]["txen"] | BATTERY_PIN_TXEN;
 
+            _pinMapping.battery2_rx = doc[i]["battery2"]["rx"] | BATTERY2_PIN_RX;
+            _pinMapping.battery2_rxen = doc[i]["battery2"]["rxen"] | BATTERY2_PIN_RXEN;
+            _pinMapping.battery2_tx = doc[i]["battery2"]["tx"] | BATTERY2_PIN_TX;
+            _pinMapping.battery2_txen = doc[i]["battery2"]["txen"] | BATTERY2_PIN_TXEN;
+
             _pinMapping.huawei_miso = doc[i]["huawei"]["miso"] | HUAWEI_PIN_MISO;
             _pinMapping.huawei_mosi = doc[i]["huawei"]["mosi"] | HUAWEI_PIN_MOSI;
             _pinMapping.huawei_clk = doc[i]["huawei"]["clk"] | HUAWEI_PIN_SCLK;
@@ -419,6 +560,7 @@ bool PinMappingClass::init(const String& deviceMapping)
             _pinMapping.powermeter_rxen = doc[i]["powermeter"]["rxen"] | POWERMETER_PIN_RXEN;
             _pinMapping.powermeter_txen = doc[i]["powermeter"]["txen"] | POWERMETER_PIN_TXEN;
 
+            writeCache(f);
             return true;
         }
     }
@@ -8,6 +8,10 @@
 #include <powermeter/Controller.h>
 #include "PowerLimiter.h"
 #include "Configuration.h"
+#include "ControlLatency.h"
+#include "DataBus.h"
+#include "DplCluster.h"
+#include "EventStore.h"
 #include "MqttSettings.h"
 #include "NetworkSettings.h"
 #include <gridcharger/huawei/Controller.h>
@@ -18,6 +22,7 @@
 #include <limits>
 #include <frozen/map.h>
 #include "SunPosition.h"
+#include <TaskProfiler.h>
 
 static auto sBatteryPoweredFilter = [](PowerLimiterInverter const& inv) {
     return inv.isBatteryPowered();
@@ -42,9 +47,13 @@ PowerLimiterClass PowerLimiter;
 void PowerLimiterClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&PowerLimiterClass::loop, this));
+    _loopTask.setCallback(TaskProfiler.wrap("PowerLimiter::loop", std::bind(&PowerLimiterClass::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
+
+    // new inverter stats and power meter readings are new information
+    DataBus.subscribe(DataBusClass::Topic::InverterStats, [this]() { triggerCalculation(); });
+    DataBus.subscribe(DataBusClass::Topic::PowerMeter, [this]() { triggerCalculation(); });
 }
 
 frozen::string const& PowerLimiterClass::getStatusText(PowerLimiterClass::Status status)
@@ -71,8 +80,87 @@ frozen::string const& PowerLimiterClass::getStatusText(PowerLimiterClass::Status
     return iter->second;
 }
 
+void PowerLimiterClass::recordTrace(PowerLimiterClass::Status status)
+{
+    auto saturate = [](uint32_t value) -> uint16_t {
+        return std::min<uint32_t>(value, UINT16_MAX);
+    };
+
+    auto& record = _traceRecord;
+    record.Millis = millis();
+    record.Status = static_cast<uint8_t>(status);
+    record.PowerMeterAgeMillis = saturate(millis() - PowerMeter.getMeasuredMillis());
+    if (_batteryDischargeEnabled) { record.Flags |= PowerLimiterTrace::FlagBatteryDischarge; }
+    if (_fullSolarPassThroughEnabled) { record.Flags |= PowerLimiterTrace::FlagFullSolarPassthrough; }
+
+    record.InverterCount = 0;
+    for (auto const& upInv : _inverters) {
+        if (record.InverterCount == INV_MAX_COUNT) { break; }
+        auto& inv = record.Inverters[record.InverterCount++];
+        inv.Serial = static_cast<uint32_t>(upInv->getSerial() & 0xFFFFFFFF);
+        inv.TargetWatts = upInv->getExpectedOutputAcWatts();
+        inv.OutputWatts = upInv->getCurrentOutputAcWatts();
+    }
+
+    _trace.record(record);
+
+    // the values of the next pass start out empty
+    record = {};
+}
+
+char const* PowerLimiterClass::getStatusKey(Status status)
+{
+    switch (status) {
+    case Status::Initializing: return "initializing";
+    case Status::DisabledByConfig: return "disabled_by_config";
+    case Status::DisabledByMqtt: return "disabled_by_mqtt";
+    case Status::WaitingForValidTimestamp: return "waiting_for_valid_timestamp";
+    case Status::PowerMeterPending: return "power_meter_pending";
+    case Status::InverterInvalid: return "inverter_invalid";
+    case Status::InverterCmdPending: return "inverter_cmd_pending";
+    case Status::ConfigReload: return "config_reload";
+    case Status::InverterStatsPending: return "inverter_stats_pending";
+    case Status::UnconditionalSolarPassthrough: return "unconditional_solar_passthrough";
+    case Status::Stable: return "stable";
+    }
+    return "unknown";
+}
+
+void PowerLimiterClass::updateScorecard(Status status)
+{
+    bool active = status != Status::Initializing &&
+        status != Status::DisabledByConfig &&
+        status != Status::DisabledByMqtt &&
+        status != Status::WaitingForValidTimestamp;
+
+    std::optional<float> oGridWatts;
+    if (PowerMeter.isDataValid()) { oGridWatts = PowerMeter.getPowerTotal(); }
+
+    // a follower of a cluster works towards the setpoint of its leader
+    std::optional<int16_t> oTargetWatts;
+    if (!DplCluster.isFollower()) { oTargetWatts = Configuration.get().PowerLimiter.TargetPowerConsumption; }
+
+    _scorecard.update({ millis(), static_cast<uint32_t>(time(nullptr)),
+            static_cast<uint8_t>(status), active, oGridWatts, oTargetWatts });
+}
+
 void PowerLimiterClass::announceStatus(PowerLimiterClass::Status status)
 {
+    recordTrace(status);
+    updateScorecard(status);
+
+    _settled = status != Status::Initializing &&
+        status != Status::InverterCmdPending &&
+        status != Status::ConfigReload &&
+        status != Status::InverterStatsPending;
+
+    // transient states are passed with every command sent to an inverter
+    // and are not worth remembering.
+    if (_settled && status != _lastStoredStatus) {
+        EventStore.add(EventStoreClass::Source::PowerLimiter, static_cast<uint16_t>(status));
+        _lastStoredStatus = status;
+    }
+
     // this method is called with high frequency. print the status text if
     // the status changed since we last printed the text of another one.
     // otherwise repeat the info with a fixed interval.
@@ -114,6 +202,7 @@ bool PowerLimiterClass::isDisabled()
     if (_shutdownComplete) { return true; }
 
     for (auto& upInv : _inverters) { upInv->standby(); }
+    if (DplCluster.isLeader()) { DplCluster.distribute(0); }
 
     // we triggered the shutdown, and we won't trigger it again until the DPL
     // enabled and disabled again. we rely that updateInverters() is called
@@ -129,6 +218,8 @@ void PowerLimiterClass::reloadConfig()
 
     _verboseLogging = config.PowerLimiter.VerboseLogging;
 
+    _shadow.reset();
+
     // clean up all inverter instances. put inverters into
     // standby if they will not be governed any more.
     auto iter = _inverters.begin();
@@ -166,8 +257,21 @@ void PowerLimiterClass::reloadConfig()
     _reloadConfigFlag = false;
 }
 
+void PowerLimiterClass::idle(uint32_t durationMs)
+{
+    _idleSince = millis();
+    _idleDurationMs = durationMs;
+}
+
 void PowerLimiterClass::loop()
 {
+    // while the last limit is still valid or while we are waiting for a new
+    // power meter reading, there is nothing to do until new data arrives,
+    // which is signalled through triggerCalculation().
+    bool triggered = _calculationTriggered.exchange(false);
+    if (!triggered && (millis() - _idleSince) < _idleDurationMs) { return; }
+    _idleDurationMs = 0;
+
     auto const& config = Configuration.get();
 
     // we know that the Hoymiles library refuses to send any message to any
@@ -191,14 +295,17 @@ void PowerLimiterClass::loop()
         return announceStatus(Status::ConfigReload);
     }
 
-    if (_inverters.empty()) {
+    // the leader of a cluster may govern the followers' inverters only
+    if (_inverters.empty() && !DplCluster.isLeader()) {
         return announceStatus(Status::InverterInvalid);
     }
 
     uint32_t latestInverterStats = 0;
 
     for (auto const& upInv : _inverters) {
-        auto oStatsMillis = upInv->getLatestStatsMillis();
+        // the learned response model allows to proceed once the output is
+        // expected to have settled, before stats confirm the new limit.
+        auto oStatsMillis = upInv->getSettledMillis();
         if (!oStatsMillis) {
             return announceStatus(Status::InverterStatsPending);
         }
@@ -206,6 +313,17 @@ void PowerLimiterClass::loop()
         latestInverterStats = std::max(*oStatsMillis, latestInverterStats);
     }
 
+    if (DplCluster.isLeader()) {
+        auto oSettledMillis = DplCluster.getSettledMillis();
+        if (!oSettledMillis) {
+            return announceStatus(Status::InverterStatsPending);
+        }
+
+        latestInverterStats = std::max(*oSettledMillis, latestInverterStats);
+    }
+
+    _traceRecord.StatsAgeMillis = std::min<uint32_t>(millis() - latestInverterStats, UINT16_MAX);
+
     // note that we can only perform unconditional full solar-passthrough or any
     // calculation at all after surviving the loop above, which ensures that we
     // have inverter stats more recent than their respective last update command
@@ -219,14 +337,33 @@ void PowerLimiterClass::loop()
     // the power meter reading is expected to be at most 2 seconds old when it
     // arrives. this can be the case for readings provided by networked meter
     // readers, where a packet needs to travel through the network for some
-    // time after the actual measurement was done by the reader.
-    if (PowerMeter.isDataValid() && PowerMeter.getLastUpdate() <= (latestInverterStats + 2000)) {
+    // time after the actual measurement was done by the reader. the time of
+    // the measurement is compared, where the provider knows it.
+    // with the predictive filter, the load is forecast independently of the
+    // inverter limits, so there is no need to wait for a new reading.
+    // a follower of a cluster is told its setpoint instead.
+    bool follower = DplCluster.isFollower();
+    if (!follower && PowerMeter.isDataValid() && !PowerMeter.getEstimatedLoad()
+            && PowerMeter.getMeasuredMillis() <= (latestInverterStats + 2000)) {
+        // we will be woken up once a new reading arrives. the heartbeat makes
+        // sure we notice if the power meter data becomes invalid meanwhile.
+        idle(_idleHeartbeatMs);
         return announceStatus(Status::PowerMeterPending);
     }
 
+    // a power meter reading that arrived after the last calculation is new
+    // information, so we use it right away instead of waiting for the backoff.
+    auto constexpr halfOfAllMillis = std::numeric_limits<uint32_t>::max() / 2;
+    auto lastReading = follower ? DplCluster.getSetpointMillis() : PowerMeter.getLastUpdate();
+    auto sinceLastReading = lastReading - _lastCalculation;
+    bool newPowerMeterReading = (follower || PowerMeter.isDataValid()) &&
+        sinceLastReading > 0 && sinceLastReading < halfOfAllMillis;
+
     // since _lastCalculation and _calculationBackoffMs are initialized to
     // zero, this test is passed the first time the condition is checked.
-    if ((millis() - _lastCalculation) < _calculationBackoffMs) {
+    auto sinceLastCalculation = millis() - _lastCalculation;
+    if (!newPowerMeterReading && sinceLastCalculation < _calculationBackoffMs) {
+        idle(_calculationBackoffMs - sinceLastCalculation);
         return announceStatus(Status::Stable);
     }
 
@@ -289,6 +426,11 @@ void PowerLimiterClass::loop()
     // re-calculate load-corrected voltage once (and only once) per DPL loop
     _oLoadCorrectedVoltage = std::nullopt;
 
+    if (usesBatteryPoweredInverter()) {
+        updateResistanceEstimate();
+        updateSocEstimate();
+    }
+
     if (_verboseLogging && (usesBatteryPoweredInverter() || usesSmartBufferPoweredInverter())) {
         MessageOutput.printf("[DPL] up %lu s, %snext inverter restart at %d s (set to %d)\r\n",
                 millis()/1000,
@@ -305,12 +447,27 @@ void PowerLimiterClass::loop()
                 Battery.getStats()->getSoCAgeSeconds(),
                 (Battery.getStats()->isSoCValid()?"valid":"stale"));
 
+        if (config.PowerLimiter.BatteryCapacity > 0) {
+            auto oSoC = _socEstimator.getSoC(millis());
+            if (oSoC) {
+                MessageOutput.printf("[DPL] estimated SoC %.2f %% (%u Ah)\r\n",
+                        *oSoC, config.PowerLimiter.BatteryCapacity);
+            } else {
+                MessageOutput.printf("[DPL] estimated SoC unavailable\r\n");
+            }
+        }
+
         auto dcVoltage = getBatteryVoltage(true/*log voltages only once per DPL loop*/);
         MessageOutput.printf("[DPL] battery voltage %.2f V, load-corrected voltage %.2f V @ %.0f W, factor %.5f 1/A\r\n",
                 dcVoltage, getLoadCorrectedVoltage(),
                 getBatteryInvertersOutputAcWatts(),
                 config.PowerLimiter.VoltageLoadCorrectionFactor);
 
+        MessageOutput.printf("[DPL] battery resistance %.1f mOhm (fit %.0f %%, %u samples), %s\r\n",
+                _batteryResistance * 1000, _batteryResistanceFitQuality * 100,
+                _resistanceEstimator.getSamples(),
+                (config.PowerLimiter.VoltageLoadCorrectionAdaptive?"used":"not used"));
+
         MessageOutput.printf("[DPL] battery discharge %s, start %.2f V or %u %%, stop %.2f V or %u %%\r\n",
                 (_batteryDischargeEnabled?"allowed":"restricted"),
                 config.PowerLimiter.VoltageStartThreshold,
@@ -338,6 +495,8 @@ void PowerLimiterClass::loop()
             config.PowerLimiter.ConductionLosses);
     };
 
+    for (auto& upInv : _inverters) { upInv->beginCycle(); }
+
     // this value is negative if we are exporting power to the grid
     // from power sources other than DPL-governed inverters.
     int16_t consumption = calcConsumption();
@@ -352,24 +511,67 @@ void PowerLimiterClass::loop()
     auto coveredBySmartBuffer = updateInverterLimits(remainingAfterSolar, sSmartBufferPoweredFilter, sSmartBufferPoweredExpression);
     auto remainingAfterSmartBuffer = (remainingAfterSolar >= coveredBySmartBuffer) ? remainingAfterSolar - coveredBySmartBuffer : 0;
     auto powerBusUsage = calcPowerBusUsage(remainingAfterSmartBuffer);
-    auto coveredByBattery = updateInverterLimits(powerBusUsage, sBatteryPoweredFilter, sBatteryPoweredExpression);
+    auto coveredByBattery = updateInverterLimits(powerBusUsage, sBatteryPoweredFilter,
+            sBatteryPoweredExpression, isEfficiencyAware());
+
+    // the followers of a cluster cover what the own inverters do not
+    uint16_t coveredByFollowers = 0;
+    if (DplCluster.isLeader()) {
+        auto remainingAfterBattery = (remainingAfterSmartBuffer >= coveredByBattery) ? remainingAfterSmartBuffer - coveredByBattery : 0;
+        coveredByFollowers = DplCluster.distribute(remainingAfterBattery);
+    }
 
     if (_verboseLogging) {
         for (auto const &upInv : _inverters) { upInv->debug(); }
     }
 
-    _lastExpectedInverterOutput = coveredBySolar + coveredByBattery;
+    _lastExpectedInverterOutput = coveredBySolar + coveredByBattery + coveredByFollowers;
+
+    _traceRecord.Flags |= PowerLimiterTrace::FlagCalculated;
+    _traceRecord.Consumption = consumption;
+    _traceRecord.CoveredBySolar = coveredBySolar;
+    _traceRecord.CoveredBySmartBuffer = coveredBySmartBuffer;
+    _traceRecord.CoveredByBattery = coveredByBattery;
+
+    float losses = 0;
+    for (auto const& upInv : _inverters) {
+        losses += upInv->getLossesWattsAt(upInv->getCurrentOutputAcWatts());
+    }
+    _inverterLossesWatts = losses;
+
+    // sending the limits must see the inverters' actual state
+    for (auto& upInv : _inverters) { upInv->endCycle(); }
 
     bool limitUpdated = updateInverters();
 
+    updateShadow(consumption, coveredBySolar + coveredBySmartBuffer, limitUpdated);
+
     _lastCalculation = millis();
 
+    std::optional<uint32_t> oMeterMeasured;
+    if (!follower && PowerMeter.isDataValid()) { oMeterMeasured = PowerMeter.getMeasuredMillis(); }
+    std::optional<uint32_t> oStatsAge;
+    if (latestInverterStats > 0) { oStatsAge = _lastCalculation - latestInverterStats; }
+    ControlLatency.recordCalculation(oMeterMeasured, oStatsAge, limitUpdated);
+
+    if (limitUpdated) {
+        _settled = false;
+        _scorecard.countCommand();
+    }
+
     if (!limitUpdated) {
         // increase polling backoff if system seems to be stable
         _calculationBackoffMs = std::min<uint32_t>(1024, _calculationBackoffMs * 2);
+        idle(_calculationBackoffMs);
         return announceStatus(Status::Stable);
     }
 
+    _traceRecord.Flags |= PowerLimiterTrace::FlagLimitsUpdated;
+    recordTrace(Status::Stable);
+    updateScorecard(Status::Stable);
+
+    DataBus.publish(DataBusClass::Topic::DplDecision);
+
     _calculationBackoffMs = _calculationBackoffMsDefault;
 }
 
@@ -465,14 +667,15 @@ void PowerLimiterClass::unconditionalFullSolarPassthrough()
 
     uint16_t targetOutput = 0;
 
-    auto solarChargerOuput = SolarCharger.getStats()->getOutputPowerWatts();
+    auto solarChargerOuput = getSolarChargerOutputWatts();
     if (solarChargerOuput) {
         targetOutput = static_cast<uint16_t>(std::max<int32_t>(0, *solarChargerOuput));
         targetOutput = dcPowerBusToInverterAc(targetOutput);
     }
 
     _calculationBackoffMs = 1 * 1000;
-    updateInverterLimits(targetOutput, sBatteryPoweredFilter, sBatteryPoweredExpression);
+    updateInverterLimits(targetOutput, sBatteryPoweredFilter,
+            sBatteryPoweredExpression, isEfficiencyAware());
     return announceStatus(Status::UnconditionalSolarPassthrough);
 }
 
@@ -505,20 +708,85 @@ uint8_t PowerLimiterClass::getPowerLimiterState()
     return _batteryDischargeEnabled ? PL_UI_STATE_USE_SOLAR_AND_BATTERY : PL_UI_STATE_USE_SOLAR_ONLY;
 }
 
+uint16_t PowerLimiterClass::getBehindPowerMeterOutputAt(uint32_t at) const
+{
+    uint16_t output = 0;
+
+    for (auto const& upInv : _inverters) {
+        if (!upInv->isBehindPowerMeter()) { continue; }
+        output += upInv->getOutputAcWattsAt(at);
+    }
+
+    // the followers of a cluster are wired behind the same power meter. as
+    // their output history is not known, their latest output is used.
+    if (DplCluster.isLeader()) { output += DplCluster.getFollowersOutputWatts(); }
+
+    return output;
+}
+
+uint16_t PowerLimiterClass::getGovernedOutputWatts() const
+{
+    uint32_t output = 0;
+
+    for (auto const& upInv : _inverters) {
+        output += upInv->getCurrentOutputAcWatts();
+    }
+
+    return std::min<uint32_t>(output, UINT16_MAX);
+}
+
+uint16_t PowerLimiterClass::getGovernedMaxIncreaseWatts() const
+{
+    if (!Configuration.get().PowerLimiter.Enabled || _mode != Mode::Normal) { return 0; }
+
+    uint32_t increase = 0;
+
+    for (auto const& upInv : _inverters) {
+        increase += upInv->getMaxIncreaseWatts();
+    }
+
+    return std::min<uint32_t>(increase, UINT16_MAX);
+}
+
 int16_t PowerLimiterClass::calcConsumption()
 {
     auto const& config = Configuration.get();
     auto targetConsumption = config.PowerLimiter.TargetPowerConsumption;
     auto baseLoad = config.PowerLimiter.BaseLoadLimit;
 
+    // the leader of the cluster accounted for the power meter already
+    if (DplCluster.isFollower()) {
+        auto setpoint = DplCluster.getSetpoint();
+        if (_verboseLogging) {
+            MessageOutput.printf("[DPL] cluster leader requests %u W\r\n", setpoint);
+        }
+        return std::min<uint16_t>(setpoint, std::numeric_limits<int16_t>::max());
+    }
+
+    // the estimated load already includes the output of the inverters
+    // behind the power meter, forecast to the current time.
+    auto oEstimatedLoad = PowerMeter.getEstimatedLoad();
+    if (oEstimatedLoad) {
+        auto load = *oEstimatedLoad;
+
+        if (_verboseLogging) {
+            MessageOutput.printf("[DPL] targeting %d W, base load is %u W, "
+                    "estimated load is %.1f W (residual %.1f W, source %s)\r\n",
+                    targetConsumption, baseLoad, load,
+                    PowerMeter.getEstimatorResidual(), PowerMeter.getActiveSourceName());
+        }
+
+        return static_cast<int16_t>(load + (load > 0 ? 0.5 : -0.5)) - targetConsumption;
+    }
+
     auto meterValid = PowerMeter.isDataValid();
     auto meterValue = PowerMeter.getPowerTotal();
 
     if (_verboseLogging) {
         MessageOutput.printf("[DPL] targeting %d W, base load is %u W, "
-                "power meter reads %.1f W (%s)\r\n",
+                "power meter reads %.1f W (%s, source %s)\r\n",
                 targetConsumption, baseLoad, meterValue,
-                (meterValid?"valid":"stale"));
+                (meterValid?"valid":"stale"), PowerMeter.getActiveSourceName());
     }
 
     if (!meterValid) { return baseLoad; }
@@ -540,6 +808,15 @@ int16_t PowerLimiterClass::calcConsumption()
         }
     }
 
+    if (DplCluster.isLeader()) {
+        auto followersOutput = DplCluster.getFollowersOutputWatts();
+        consumption += followersOutput;
+        if (_verboseLogging) {
+            MessageOutput.printf("[DPL] %u cluster followers are producing %u W\r\n",
+                    DplCluster.getNodeCount(), followersOutput);
+        }
+    }
+
     return consumption - targetConsumption;
 }
 
@@ -548,10 +825,11 @@ int16_t PowerLimiterClass::calcConsumption()
  * amount of power these inverters are expected to produce after the new limits
  * were applied.
  */
+template<typename Filter>
 uint16_t PowerLimiterClass::updateInverterLimits(uint16_t powerRequested,
-        PowerLimiterClass::inverter_filter_t filter, std::string const& filterExpression)
+        Filter const& filter, char const* filterExpression, bool efficiencyAware)
 {
-    std::vector<PowerLimiterInverter*> matchingInverters;
+    InverterSelection matchingInverters;
     uint16_t producing = 0; // sum of AC power the matching inverters produce now
 
     for (auto& upInv : _inverters) {
@@ -588,15 +866,42 @@ uint16_t PowerLimiterClass::updateInverterLimits(uint16_t powerRequested,
     if (_verboseLogging) {
         MessageOutput.printf("[DPL] requesting %d W from %d %s inverter%s "
                 "currently producing %d W (diff %i W, hysteresis %d W)\r\n",
-                powerRequested, matchingInverters.size(), filterExpression.c_str(),
+                powerRequested, matchingInverters.size(), filterExpression,
                 (plural?"s":""), producing, diff, hysteresis);
     }
 
     if (std::abs(diff) < static_cast<int32_t>(hysteresis)) { return producing; }
 
+    // a limit update costs airtime: it waits for the commands queued for
+    // the radio, each taking about one round trip, and delays the stats
+    // polls of all other inverters. the longer it takes until the update
+    // becomes effective, the more likely a small correction is obsolete by
+    // then under a fluctuating load, while the correction saves less energy
+    // than a large one. hence the deadband grows with the queue depth, by
+    // half the hysteresis per command waiting, and equals the hysteresis
+    // while the radio is idle.
+    uint32_t queued = 0;
+    for (auto const pInv : matchingInverters) {
+        queued = std::max(queued, pInv->getRadioQueueSize());
+    }
+
+    uint32_t deadband = hysteresis + queued * hysteresis / 2;
+    if (static_cast<uint32_t>(std::abs(diff)) < deadband) {
+        ++_suppressedLimitUpdates;
+        if (_verboseLogging) {
+            MessageOutput.printf("[DPL] suppressing limit update: diff %i W "
+                    "is below deadband %u W with %u command%s queued\r\n",
+                    diff, deadband, queued, (queued == 1 ? "" : "s"));
+        }
+        return producing;
+    }
+
     uint16_t covered = 0;
 
-    if (diff < 0) {
+    if (efficiencyAware && plural) {
+        covered = distributeByEfficiency(powerRequested, matchingInverters, hysteresis);
+    }
+    else if (diff < 0) {
         uint16_t reduction = static_cast<uint16_t>(diff * -1);
 
         uint16_t totalMaxReduction = 0;
@@ -643,7 +948,164 @@ uint16_t PowerLimiterClass::updateInverterLimits(uint16_t powerRequested,
     if (_verboseLogging) {
         MessageOutput.printf("[DPL] will cover %d W using "
                 "%d %s inverter%s\r\n", covered, matchingInverters.size(),
-                filterExpression.c_str(), (plural?"s":""));
+                filterExpression, (plural?"s":""));
+    }
+
+    return covered;
+}
+
+bool PowerLimiterClass::isEfficiencyAware() const
+{
+    auto const& config = Configuration.get();
+    return config.PowerLimiter.Distribution == PowerLimiterConfig::Efficiency;
+}
+
+/**
+ * distributes the requested power among the inverters such that their
+ * combined losses are minimal, e.g., by letting one inverter produce at a
+ * more efficient operating point rather than two inverters at low load. the
+ * candidate outputs of each inverter are combined using dynamic programming
+ * over the total power, quantized in steps of (at least) 10 W. among the
+ * combinations closest to the requested power, the one with the least
+ * losses is applied. returns the power the inverters are expected to
+ * produce.
+ */
+uint16_t PowerLimiterClass::distributeByEfficiency(uint16_t powerRequested,
+        InverterSelection const& inverters, uint16_t hysteresis)
+{
+    // every change causes a command to be sent, and waking an inverter from
+    // standby takes a while, so the current state is preferred slightly.
+    static constexpr float changePenaltyWatts = 1;
+    static constexpr float powerStatePenaltyWatts = 3;
+
+    struct Candidate {
+        uint16_t Watts;
+        float Cost;
+    };
+
+    std::array<uint16_t, INV_MAX_COUNT> current;
+    std::array<std::vector<Candidate>, INV_MAX_COUNT> candidates;
+    uint32_t totalMax = 0;
+
+    for (size_t i = 0; i < inverters.size(); ++i) {
+        auto pInv = inverters[i];
+        bool producing = pInv->isProducing();
+        uint16_t cur = producing ? pInv->getCurrentOutputAcWatts() : 0;
+        current[i] = cur;
+        totalMax += cur + pInv->getMaxIncreaseWatts();
+    }
+
+    // the quantization is coarser for large installations, which limits the
+    // amount of states as well as the amount of candidates per inverter
+    // (such that a candidate index fits into a byte).
+    uint16_t step = std::max<uint32_t>(10, (totalMax + 199) / 200);
+    auto quantize = [step](uint16_t watts) -> size_t { return (watts + step / 2) / step; };
+
+    for (size_t i = 0; i < inverters.size(); ++i) {
+        auto pInv = inverters[i];
+        bool producing = pInv->isProducing();
+        uint16_t cur = current[i];
+
+        auto add = [&](uint16_t watts) {
+            if (watts != cur && std::abs(watts - cur) < hysteresis) { return; }
+
+            float cost = pInv->getLossesWattsAt(watts);
+            if (watts != cur) { cost += changePenaltyWatts; }
+            if ((watts == 0) == producing) { cost += powerStatePenaltyWatts; }
+            candidates[i].push_back({ watts, cost });
+        };
+
+        add(cur);
+
+        if (producing && pInv->getMaxReductionWatts(true/*standby*/) > 0) { add(0); }
+
+        uint16_t low = producing ? cur - pInv->getMaxReductionWatts(false/*no standby*/)
+                                 : pInv->getLowerPowerLimitWatts();
+        uint16_t high = cur + pInv->getMaxIncreaseWatts();
+        if (low > high || (!producing && high == 0)) { continue; }
+
+        for (uint32_t watts = low; watts < high; watts += step) {
+            if (watts != cur) { add(watts); }
+        }
+        if (high != cur) { add(high); }
+    }
+
+    // costs[s] is the least amount of losses for a total power of s steps
+    size_t states = totalMax / step + inverters.size() + 1;
+    auto constexpr unreachable = std::numeric_limits<float>::infinity();
+    std::vector<float> costs(states, unreachable);
+    std::vector<float> next(states);
+    std::vector<uint8_t> choices(inverters.size() * states, 0);
+    costs[0] = 0;
+
+    for (size_t i = 0; i < inverters.size(); ++i) {
+        std::fill(next.begin(), next.end(), unreachable);
+
+        for (size_t s = 0; s < states; ++s) {
+            if (costs[s] == unreachable) { continue; }
+
+            for (size_t c = 0; c < candidates[i].size(); ++c) {
+                auto const& candidate = candidates[i][c];
+                size_t t = s + quantize(candidate.Watts);
+                if (t >= states) { continue; }
+
+                float cost = costs[s] + candidate.Cost;
+                if (cost < next[t]) {
+                    next[t] = cost;
+                    choices[i * states + t] = c;
+                }
+            }
+        }
+
+        std::swap(costs, next);
+    }
+
+    size_t target = quantize(powerRequested);
+    std::optional<size_t> best = std::nullopt;
+    for (size_t s = 0; s < states; ++s) {
+        if (costs[s] == unreachable) { continue; }
+
+        if (!best.has_value()) { best = s; continue; }
+
+        size_t error = (s > target) ? s - target : target - s;
+        size_t bestError = (*best > target) ? *best - target : target - *best;
+        if (error < bestError || (error == bestError && costs[s] < costs[*best])) {
+            best = s;
+        }
+    }
+
+    // the current state is always a candidate, so this is not expected
+    if (!best.has_value()) { return 0; }
+
+    std::array<uint16_t, INV_MAX_COUNT> chosen;
+    size_t state = *best;
+    for (size_t i = inverters.size(); i-- > 0;) {
+        auto const& candidate = candidates[i][choices[i * states + state]];
+        chosen[i] = candidate.Watts;
+        state -= quantize(candidate.Watts);
+    }
+
+    uint16_t covered = 0;
+    for (size_t i = 0; i < inverters.size(); ++i) {
+        auto pInv = inverters[i];
+
+        if (_verboseLogging) {
+            MessageOutput.printf("[DPL] efficiency-aware distribution: %s "
+                    "%u W -> %u W (%.1f W losses)\r\n", pInv->getSerialStr(),
+                    current[i], chosen[i], pInv->getLossesWattsAt(chosen[i]));
+        }
+
+        if (chosen[i] == 0 && current[i] > 0) {
+            pInv->standby();
+        }
+        else if (chosen[i] > current[i]) {
+            pInv->applyIncrease(chosen[i] - current[i]);
+        }
+        else if (chosen[i] < current[i]) {
+            pInv->applyReduction(current[i] - chosen[i], false/*no standby*/);
+        }
+
+        covered += pInv->getExpectedOutputAcWatts();
     }
 
     return covered;
@@ -713,9 +1175,27 @@ bool PowerLimiterClass::updateInverters()
     return busy;
 }
 
+std::optional<float> PowerLimiterClass::getSolarChargerOutputWatts() const
+{
+    auto oReported = SolarCharger.getStats()->getOutputPowerWatts();
+    if (!oReported || !Configuration.get().PowerLimiter.SolarPowerPrediction) {
+        return oReported;
+    }
+
+    auto oPredicted = SolarCharger.getPredictedOutputPowerWatts();
+    if (!oPredicted) { return oReported; }
+
+    if (_verboseLogging) {
+        MessageOutput.printf("[DPL] solar charger output is %.1f W, "
+                "predicted %.1f W\r\n", *oReported, *oPredicted);
+    }
+
+    return oPredicted;
+}
+
 uint16_t PowerLimiterClass::getSolarPassthroughPower()
 {
-    auto solarChargerOutput = SolarCharger.getStats()->getOutputPowerWatts();
+    auto solarChargerOutput = getSolarChargerOutputWatts();
 
     if (!isSolarPassThroughEnabled()
             || isBelowStopThreshold()
@@ -778,11 +1258,125 @@ float PowerLimiterClass::getLoadCorrectedVoltage()
         return 0.0;
     }
 
+    // the voltage of the idle pack is the intercept of the fit, which also
+    // accounts for the voltage rise while charging.
+    if (config.PowerLimiter.VoltageLoadCorrectionAdaptive) {
+        auto oResistance = _resistanceEstimator.getResistance();
+        auto oCurrent = getBatteryCurrent();
+        if (oResistance && oCurrent) {
+            _oLoadCorrectedVoltage = dcVoltage - (*oResistance * *oCurrent);
+            return *_oLoadCorrectedVoltage;
+        }
+    }
+
     _oLoadCorrectedVoltage = dcVoltage + (acPower * config.PowerLimiter.VoltageLoadCorrectionFactor);
 
     return *_oLoadCorrectedVoltage;
 }
 
+// the current flowing into the battery, positive while charging
+std::optional<float> PowerLimiterClass::getBatteryCurrent()
+{
+    auto const& config = Configuration.get();
+
+    auto stats = Battery.getStats();
+    if (config.Battery.Enabled && stats->isCurrentValid()
+            && stats->getChargeCurrentAgeSeconds() < 10) {
+        return stats->getChargeCurrent();
+    }
+
+    // without a reading from the BMS, the current is derived from the power
+    // balance of the power bus: the solar charger output minus the DC power
+    // drawn by the battery-powered inverters.
+    auto solarChargerOutput = SolarCharger.getStats()->getOutputPowerWatts();
+    float voltage = getBatteryVoltage();
+    if (!solarChargerOutput || voltage <= 0) { return std::nullopt; }
+
+    float inverterDcPower = 0;
+    for (auto const& upInv : _inverters) {
+        if (!upInv->isBatteryPowered()) { continue; }
+
+        auto acPower = upInv->getCurrentOutputAcWatts();
+        if (acPower == 0) { continue; }
+
+        inverterDcPower += acPower / upInv->getEfficiencyAt(acPower);
+    }
+
+    return (*solarChargerOutput - inverterDcPower) / voltage;
+}
+
+void PowerLimiterClass::updateResistanceEstimate()
+{
+    // consecutive samples are mostly the same, as the battery and solar
+    // charger data is not updated as often as the DPL loop runs.
+    if ((millis() - _lastResistanceSample) < 5 * 1000) { return; }
+
+    auto oCurrent = getBatteryCurrent();
+    float voltage = getBatteryVoltage();
+    if (!oCurrent || voltage <= 0) { return; }
+
+    _lastResistanceSample = millis();
+    _resistanceEstimator.update(*oCurrent, voltage);
+
+    _batteryResistance = _resistanceEstimator.getResistance().value_or(0);
+    _batteryResistanceFitQuality = _resistanceEstimator.getFitQuality();
+}
+
+void PowerLimiterClass::updateSocEstimate()
+{
+    auto const& config = Configuration.get();
+    auto stats = Battery.getStats();
+
+    if (!config.Battery.Enabled || !stats->isSoCValid()) {
+        _socEstimator.reset();
+        return;
+    }
+
+    auto oCurrent = getBatteryCurrent();
+    if (!oCurrent) { return; }
+
+    _socEstimator.update(stats->getSoC(), stats->getSoCPrecision(),
+            stats->getSoCLastUpdate(), *oCurrent,
+            config.PowerLimiter.BatteryCapacity, millis());
+}
+
+void PowerLimiterClass::updateShadow(int16_t consumption, uint16_t unrestricted, bool limitsUpdated)
+{
+    auto const& config = Configuration.get();
+    auto const& shadow = config.PowerLimiter.Shadow;
+
+    // a follower is told its setpoint, so its settings hardly matter. the
+    // load is only known while the power meter reading is valid.
+    if (!shadow.Enabled || DplCluster.isFollower() || !PowerMeter.isDataValid()) { return; }
+
+    PowerLimiterShadow::Inputs inputs;
+    inputs.Millis = millis();
+    inputs.LoadWatts = consumption + config.PowerLimiter.TargetPowerConsumption;
+    inputs.oGridWatts = PowerMeter.getPowerTotal();
+    inputs.UpperLimitWatts = config.PowerLimiter.TotalUpperPowerLimit;
+    inputs.LiveDischarge = _batteryDischargeEnabled;
+    inputs.LiveLimitsUpdated = limitsUpdated;
+
+    // solar-powered and smart-buffer-powered inverters are not affected by
+    // the battery thresholds, neither is solar-passthrough.
+    inputs.UnrestrictedWatts = unrestricted;
+    auto oSolarChargerOutput = getSolarChargerOutputWatts();
+    if (isSolarPassThroughEnabled() && oSolarChargerOutput) {
+        auto solarDcWatts = static_cast<uint16_t>(std::max(0.0f, *oSolarChargerOutput));
+        inputs.UnrestrictedWatts += dcPowerBusToInverterAc(solarDcWatts);
+    }
+
+    inputs.StartThresholdReached = usesBatteryPoweredInverter() && testThreshold(
+            shadow.BatterySocStartThreshold, shadow.VoltageStartThreshold,
+            [](float a, float b) -> bool { return a >= b; });
+    inputs.StopThresholdReached = !usesBatteryPoweredInverter() || testThreshold(
+            shadow.BatterySocStopThreshold, shadow.VoltageStopThreshold,
+            [](float a, float b) -> bool { return a <= b; });
+
+    _shadow.update(inputs, shadow.TargetPowerConsumption,
+            shadow.TargetPowerConsumptionHysteresis);
+}
+
 bool PowerLimiterClass::testThreshold(float socThreshold, float voltThreshold,
         std::function<bool(float, float)> compare)
 {
@@ -793,9 +1387,14 @@ bool PowerLimiterClass::testThreshold(float socThreshold, float voltThreshold,
     if (!config.PowerLimiter.IgnoreSoc
             && config.Battery.Enabled
             && socThreshold > 0.0
-            && stats->isSoCValid()
-            && stats->getSoCAgeSeconds() < 60) {
-              return compare(stats->getSoC(), socThreshold);
+            && stats->isSoCValid()) {
+        // the estimate bridges the time between the battery's SoC updates
+        auto oEstimate = _socEstimator.getSoC(millis());
+        if (oEstimate) { return compare(*oEstimate, socThreshold); }
+
+        if (stats->getSoCAgeSeconds() < 60) {
+            return compare(stats->getSoC(), socThreshold);
+        }
     }
 
     // use voltage threshold as fallback
@@ -1,9 +1,17 @@
+#include "ControlLatency.h"
 #include "RestartHelper.h"
 #include "MessageOutput.h"
 #include "PowerLimiterInverter.h"
 #include "PowerLimiterBatteryInverter.h"
 #include "PowerLimiterSolarInverter.h"
 #include "PowerLimiterSmartBufferInverter.h"
+#include <cinttypes>
+
+// efficiency of a typical microinverter at 5 %, 15 %, ..., 95 % of its max
+// power. the efficiency drops considerably at low loads.
+static constexpr std::array<float, 10> sTypicalEfficiency = {
+    0.880, 0.925, 0.945, 0.955, 0.960, 0.962, 0.962, 0.960, 0.958, 0.955
+};
 
 std::unique_ptr<PowerLimiterInverter> PowerLimiterInverter::create(
         bool verboseLogging, PowerLimiterInverterConfig const& config)
@@ -30,6 +38,7 @@ std::unique_ptr<PowerLimiterInverter> PowerLimiterInverter::create(
 PowerLimiterInverter::PowerLimiterInverter(bool verboseLogging, PowerLimiterInverterConfig const& config)
     : _config(config)
     , _verboseLogging(verboseLogging)
+    , _efficiency(sTypicalEfficiency)
 {
     _spInverter = Hoymiles.getInverterBySerial(config.Serial);
     if (!_spInverter) { return; }
@@ -39,10 +48,49 @@ PowerLimiterInverter::PowerLimiterInverter(bool verboseLogging, PowerLimiterInve
             static_cast<uint32_t>(config.Serial & 0xFFFFFFFF));
 
     snprintf(_logPrefix, sizeof(_logPrefix), "[DPL inverter %s]:", _serialStr);
+
+    auto pMetaData = _spInverter->getChannelMetaData();
+    for (uint8_t i = 0; i < _spInverter->getChannelMetaDataSize(); ++i) {
+        auto const& meta = pMetaData[i];
+
+        size_t idx = 0;
+        while (idx < _mpptCount && _mppts[idx].Mppt != meta.mppt) { ++idx; }
+
+        if (idx == _mpptCount) {
+            if (_mpptCount == _mppts.size()) { continue; }
+            _mppts[_mpptCount++] = { meta.mppt, 0, {} };
+        }
+
+        auto& mppt = _mppts[idx];
+        if (mppt.ChannelCount == mppt.Channels.size()) { continue; }
+        mppt.Channels[mppt.ChannelCount++] = meta.ch;
+        ++_dcChannelCount;
+    }
+
+    // we need recent stats of governed inverters to react quickly
+    _spInverter->setHighPollPriority(true);
+}
+
+PowerLimiterInverter::~PowerLimiterInverter()
+{
+    if (_spInverter) { _spInverter->setHighPollPriority(false); }
+}
+
+void PowerLimiterInverter::beginCycle()
+{
+    _oCycle = std::nullopt;
+    _oCycle = CycleValues {
+        isEligible(),
+        getInverterMaxPowerWatts(),
+        getCurrentLimitWatts(),
+        getCurrentOutputAcWatts()
+    };
 }
 
 PowerLimiterInverter::Eligibility PowerLimiterInverter::isEligible() const
 {
+    if (_oCycle) { return _oCycle->Eligible; }
+
     if (!isReachable()) { return Eligibility::Unreachable; }
 
     if (!isSendingCommandsEnabled()) { return Eligibility::SendingCommandsDisabled; }
@@ -62,6 +110,179 @@ PowerLimiterInverter::Eligibility PowerLimiterInverter::isEligible() const
 }
 
 bool PowerLimiterInverter::update()
+{
+    bool pending = updateState();
+    if (!pending) {
+        trackOutput();
+        learnEfficiency();
+    }
+    learnResponse();
+    return pending;
+}
+
+void PowerLimiterInverter::learnResponse()
+{
+    if (!_oStep) { return; }
+
+    auto& step = *_oStep;
+    auto lastUpdate = _spInverter->Statistics()->getLastUpdate();
+    if (lastUpdate == step.LastStatsMillis) { return; }
+
+    // stats requested before the limit command was acknowledged
+    auto constexpr halfOfAllMillis = std::numeric_limits<uint32_t>::max() / 2;
+    if ((lastUpdate - step.Millis) > halfOfAllMillis) { return; }
+
+    // stats are polled, so the time of a change is not known exactly. we
+    // assume it happened halfway between the previous and the current stats.
+    uint32_t previous = step.LastStatsMillis;
+    if ((previous - step.Millis) > halfOfAllMillis) { previous = step.Millis; }
+    uint32_t observed = previous + (lastUpdate - previous) / 2;
+    step.LastStatsMillis = lastUpdate;
+
+    if (!isProducing() || (lastUpdate - step.Millis) > 30 * 1000) {
+        _oStep.reset();
+        return;
+    }
+
+    int32_t delta = step.ToWatts - step.FromWatts;
+    int32_t measured = getMeasuredOutputAcWatts();
+    int32_t progress = (delta > 0) ? measured - step.FromWatts : step.FromWatts - measured;
+    int32_t tolerance = std::max<int32_t>(10, std::abs(delta) / 20);
+
+    if (!step.oResponseMillis && progress > tolerance) {
+        step.oResponseMillis = observed;
+    }
+
+    if (std::abs(step.ToWatts - measured) > tolerance) { return; }
+
+    // small steps are dominated by measurement noise
+    if (std::abs(delta) > 2 * tolerance && step.oResponseMillis) {
+        float deadTime = *step.oResponseMillis - step.Millis;
+        float rampMillis = std::max<uint32_t>(500, observed - *step.oResponseMillis);
+        float rate = std::abs(delta) * 1000 / rampMillis;
+
+        auto& model = _responseModel;
+        if (model.Samples == 0) {
+            model.DeadTimeMillis = deadTime;
+            model.RampWattsPerSecond = rate;
+        } else {
+            model.DeadTimeMillis += (deadTime - model.DeadTimeMillis) * 0.3f;
+            model.RampWattsPerSecond += (rate - model.RampWattsPerSecond) * 0.3f;
+        }
+        model.Samples = std::min<uint8_t>(model.Samples + 1, UINT8_MAX);
+
+        if (_verboseLogging) {
+            MessageOutput.printf("%s settled at %d W after %.0f ms dead time "
+                    "and %.0f W/s, model %.0f ms and %.0f W/s\r\n", _logPrefix,
+                    measured, deadTime, rate, model.DeadTimeMillis,
+                    model.RampWattsPerSecond);
+        }
+    }
+
+    // the stats reflect the new limit, so no estimate is needed anymore
+    _oStep.reset();
+}
+
+std::optional<uint16_t> PowerLimiterInverter::getModelledOutputAcWattsAt(uint32_t at) const
+{
+    if (!_oStep || _responseModel.Samples < MinResponseSamples) { return std::nullopt; }
+
+    auto constexpr halfOfAllMillis = std::numeric_limits<uint32_t>::max() / 2;
+    uint32_t elapsed = at - _oStep->Millis;
+    if (elapsed > halfOfAllMillis) { return std::nullopt; }
+
+    if (elapsed <= _responseModel.DeadTimeMillis) { return _oStep->FromWatts; }
+
+    float ramped = (elapsed - _responseModel.DeadTimeMillis) * _responseModel.RampWattsPerSecond / 1000;
+    int32_t delta = _oStep->ToWatts - _oStep->FromWatts;
+    if (ramped >= std::abs(delta)) { return _oStep->ToWatts; }
+
+    return _oStep->FromWatts + static_cast<int32_t>((delta > 0) ? ramped : -ramped);
+}
+
+void PowerLimiterInverter::learnEfficiency()
+{
+    auto spSnapshot = _spInverter->Statistics()->getSnapshot();
+    if (!spSnapshot || spSnapshot->getSequence() == _lastEfficiencyStats) { return; }
+    _lastEfficiencyStats = spSnapshot->getSequence();
+
+    // the stats must reflect the output after the last command completed
+    if (!getLatestStatsMillis().has_value()) { return; }
+
+    if (!isProducing()) { return; }
+
+    if (!spSnapshot->hasChannelFieldValue(TYPE_INV, CH0, FLD_EFF)) { return; }
+
+    auto maxPower = getInverterMaxPowerWatts();
+    if (maxPower == 0) { return; }
+
+    float efficiency = spSnapshot->getChannelFieldValue(TYPE_INV, CH0, FLD_EFF) / 100;
+
+    // discard implausible values, e.g., while the inverter is ramping up
+    if (efficiency < 0.5f || efficiency >= 1.0f) { return; }
+
+    size_t bucket = std::min<size_t>(EfficiencyBuckets - 1,
+            getCurrentOutputAcWatts() * EfficiencyBuckets / maxPower);
+
+    _efficiency[bucket] += (efficiency - _efficiency[bucket]) * 0.1f;
+}
+
+float PowerLimiterInverter::getEfficiencyAt(uint16_t acWatts) const
+{
+    auto maxPower = getInverterMaxPowerWatts();
+    if (maxPower == 0) { return _efficiency[EfficiencyBuckets / 2]; }
+
+    float pos = static_cast<float>(acWatts) * EfficiencyBuckets / maxPower - 0.5f;
+    if (pos <= 0) { return _efficiency.front(); }
+    if (pos >= EfficiencyBuckets - 1) { return _efficiency.back(); }
+
+    size_t lower = static_cast<size_t>(pos);
+    float fraction = pos - lower;
+    return _efficiency[lower] + (_efficiency[lower + 1] - _efficiency[lower]) * fraction;
+}
+
+float PowerLimiterInverter::getLossesWattsAt(uint16_t acWatts) const
+{
+    // standby consumption is negligible
+    if (acWatts == 0) { return 0; }
+
+    return acWatts * (1 / getEfficiencyAt(acWatts) - 1);
+}
+
+void PowerLimiterInverter::trackOutput()
+{
+    uint16_t watts = getExpectedOutputAcWatts();
+
+    if (_outputSamples > 0 &&
+            _outputHistory[(_outputSamples - 1) % OutputHistorySize].Watts == watts) {
+        return;
+    }
+
+    _outputHistory[_outputSamples % OutputHistorySize] = { millis(), watts };
+    ++_outputSamples;
+}
+
+uint16_t PowerLimiterInverter::getOutputAcWattsAt(uint32_t at) const
+{
+    // the output ramps towards the last limit rather than jumping to it
+    auto oModelled = getModelledOutputAcWattsAt(at);
+    if (oModelled) { return *oModelled; }
+
+    if (_outputSamples == 0) { return getExpectedOutputAcWatts(); }
+
+    auto constexpr halfOfAllMillis = std::numeric_limits<uint32_t>::max() / 2;
+    size_t available = std::min(_outputSamples, OutputHistorySize);
+
+    for (size_t i = 1; i <= available; ++i) {
+        auto const& sample = _outputHistory[(_outputSamples - i) % OutputHistorySize];
+        if ((at - sample.Millis) < halfOfAllMillis) { return sample.Watts; }
+    }
+
+    // the time is before the oldest sample
+    return _outputHistory[(_outputSamples - available) % OutputHistorySize].Watts;
+}
+
+bool PowerLimiterInverter::updateState()
 {
     auto reset = [this]() -> bool {
         _oTargetPowerState = std::nullopt;
@@ -154,6 +375,7 @@ bool PowerLimiterInverter::update()
             MessageOutput.printf("%s %s inverter...\r\n", _logPrefix,
                     ((*_oTargetPowerState)?"Starting":"Stopping"));
             _spInverter->sendPowerControlRequest(*_oTargetPowerState);
+            _oStep.reset(); // the response model covers limit changes only
             return true;
         }
 
@@ -187,11 +409,13 @@ bool PowerLimiterInverter::update()
         if ((lastLimitCommandMillis - *_oUpdateStartMillis) < halfOfAllMillis &&
                 CMD_OK == lastLimitCommandState) {
             MessageOutput.printf("%s actual limit is %.1f %% (%.0f W "
-                    "respectively), effective %d ms after update started, "
-                    "requested were %.1f %%\r\n",
+                    "respectively), effective %d ms after update started "
+                    "(command round trip %" PRIu32 " ms), requested were "
+                    "%.1f %%\r\n",
                     _logPrefix, currentRelativeLimit,
                     (currentRelativeLimit * getInverterMaxPowerWatts() / 100),
                     (lastLimitCommandMillis - *_oUpdateStartMillis),
+                    _spInverter->SystemConfigPara()->getLastLimitCommandRoundTrip(),
                     newRelativeLimit);
 
             if (std::abs(newRelativeLimit - currentRelativeLimit) > 2.0) {
@@ -201,6 +425,17 @@ bool PowerLimiterInverter::update()
                         _logPrefix, newRelativeLimit, currentRelativeLimit);
             }
 
+            if (isProducing() && !_oTargetPowerState.has_value()) {
+                // starts from the estimated output if the previous step
+                // was not confirmed by stats yet
+                _oStep = Step{ lastLimitCommandMillis, getCurrentOutputAcWatts(),
+                    _expectedOutputAcWatts, lastLimitCommandMillis, std::nullopt };
+            } else {
+                _oStep.reset();
+            }
+
+            ControlLatency.recordAcknowledgment(lastLimitCommandMillis);
+
             _oTargetPowerLimitWatts = std::nullopt;
             return false;
         }
@@ -251,7 +486,11 @@ std::optional<uint32_t> PowerLimiterInverter::getLatestStatsMillis() const
     }
 
     if (!_oStatsMillis) {
-        auto lastStatsMillis = _spInverter->Statistics()->getLastUpdate();
+        // the time the stats were received, rather than decoded
+        auto spSnapshot = _spInverter->Statistics()->getSnapshot();
+        if (!spSnapshot) { return std::nullopt; }
+
+        auto lastStatsMillis = spSnapshot->getAcquiredMillis();
         auto lastStatsAge = now - lastStatsMillis;
         if (lastStatsAge > lastUpdateCmdAge) {
             return std::nullopt;
@@ -263,8 +502,32 @@ std::optional<uint32_t> PowerLimiterInverter::getLatestStatsMillis() const
     return _oStatsMillis;
 }
 
+std::optional<uint32_t> PowerLimiterInverter::getSettledMillis() const
+{
+    auto oStatsMillis = getLatestStatsMillis();
+    if (oStatsMillis) { return oStatsMillis; }
+
+    // the step must refer to the last command, i.e., no other limit or
+    // power command was sent in the meantime.
+    if (!_oStep || _responseModel.Samples < MinResponseSamples) { return std::nullopt; }
+    if (_spInverter->SystemConfigPara()->getLastUpdateCommand() != _oStep->Millis) { return std::nullopt; }
+
+    auto constexpr halfOfAllMillis = std::numeric_limits<uint32_t>::max() / 2;
+    if ((_oStep->Millis - _spInverter->PowerCommand()->getLastUpdateCommand()) > halfOfAllMillis) {
+        return std::nullopt;
+    }
+
+    float rampMillis = std::abs(_oStep->ToWatts - _oStep->FromWatts) * 1000 / _responseModel.RampWattsPerSecond;
+    uint32_t settled = _oStep->Millis + static_cast<uint32_t>(_responseModel.DeadTimeMillis + rampMillis);
+    if ((millis() - settled) > halfOfAllMillis) { return std::nullopt; }
+
+    return settled;
+}
+
 uint16_t PowerLimiterInverter::getInverterMaxPowerWatts() const
 {
+    if (_oCycle) { return _oCycle->InverterMaxPowerWatts; }
+
     return _spInverter->DevInfo()->getMaxPower();
 }
 
@@ -275,7 +538,21 @@ uint16_t PowerLimiterInverter::getConfiguredMaxPowerWatts() const
 
 uint16_t PowerLimiterInverter::getCurrentOutputAcWatts() const
 {
-    return _spInverter->Statistics()->getChannelFieldValue(TYPE_AC, CH0, FLD_PAC);
+    if (_oCycle) { return _oCycle->CurrentOutputAcWatts; }
+
+    auto constexpr halfOfAllMillis = std::numeric_limits<uint32_t>::max() / 2;
+    if (_oStep && (_spInverter->Statistics()->getLastUpdate() - _oStep->Millis) > halfOfAllMillis) {
+        auto oModelled = getModelledOutputAcWattsAt(millis());
+        if (oModelled) { return *oModelled; }
+    }
+
+    return getMeasuredOutputAcWatts();
+}
+
+uint16_t PowerLimiterInverter::getMeasuredOutputAcWatts() const
+{
+    auto spSnapshot = _spInverter->Statistics()->getSnapshot();
+    return spSnapshot ? spSnapshot->getChannelFieldValue(TYPE_AC, CH0, FLD_PAC) : 0;
 }
 
 uint16_t PowerLimiterInverter::getExpectedOutputAcWatts() const
@@ -307,6 +584,8 @@ float PowerLimiterInverter::getDcVoltage(uint8_t input)
 
 uint16_t PowerLimiterInverter::getCurrentLimitWatts() const
 {
+    if (_oCycle) { return _oCycle->CurrentLimitWatts; }
+
     auto currentLimitPercent = _spInverter->SystemConfigPara()->getLimitPercent();
     return static_cast<uint16_t>(currentLimitPercent * getInverterMaxPowerWatts() / 100);
 }
@@ -356,27 +635,44 @@ void PowerLimiterInverter::debug() const
         getUpdateTimeouts()
     );
 
+    MessageOutput.printf("    response model: %.0f ms dead time, %.0f W/s, %u samples%s\r\n",
+            _responseModel.DeadTimeMillis, _responseModel.RampWattsPerSecond,
+            _responseModel.Samples, (_oStep.has_value()?", step pending":""));
+
     MessageOutput.printf("    MPPTs AC power:");
 
     auto pStats = _spInverter->Statistics();
     float inverterEfficiencyFactor = pStats->getChannelFieldValue(TYPE_INV, CH0, FLD_EFF) / 100;
-    std::vector<MpptNum_t> dcMppts = _spInverter->getMppts();
-
-    for (auto& m : dcMppts) {
-        float mpptPowerAC = 0.0;
-        std::vector<ChannelNum_t> mpptChnls = _spInverter->getChannelsDCByMppt(m);
-
-        for (auto& c : mpptChnls) {
-            mpptPowerAC += pStats->getChannelFieldValue(TYPE_DC, c, FLD_PDC) * inverterEfficiencyFactor;
-        }
+    auto mpptPowers = getMpptAcPowers(inverterEfficiencyFactor);
 
+    for (size_t m = 0; m < getMpptCount(); ++m) {
         MessageOutput.printf(" %c: %.0f W",
-                mpptName(m), mpptPowerAC);
+                mpptName(getMppt(m)), mpptPowers[m]);
     }
 
     MessageOutput.printf("\r\n");
 }
 
+PowerLimiterInverter::MpptAcPowers PowerLimiterInverter::getMpptAcPowers(float efficiencyFactor) const
+{
+    MpptAcPowers powers = {};
+
+    // all values are read from the same frame, such that they are consistent
+    auto spSnapshot = _spInverter->Statistics()->getSnapshot();
+    if (!spSnapshot) { return powers; }
+
+    for (size_t m = 0; m < _mpptCount; ++m) {
+        auto const& mppt = _mppts[m];
+        float dcPower = 0;
+        for (size_t c = 0; c < mppt.ChannelCount; ++c) {
+            dcPower += spSnapshot->getChannelFieldValue(TYPE_DC, mppt.Channels[c], FLD_PDC);
+        }
+        powers[m] = dcPower * efficiencyFactor;
+    }
+
+    return powers;
+}
+
 char PowerLimiterInverter::mpptName(MpptNum_t mppt)
 {
     switch (mppt) {
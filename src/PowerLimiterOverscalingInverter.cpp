@@ -39,10 +39,8 @@ uint16_t PowerLimiterOverscalingInverter::scaleLimit(uint16_t expectedOutputWatt
     if (!isProducing()) { return expectedOutputWatts; }
 
     auto pStats = _spInverter->Statistics();
-    std::vector<ChannelNum_t> dcChnls = _spInverter->getChannelsDC();
-    std::vector<MpptNum_t> dcMppts = _spInverter->getMppts();
-    size_t dcTotalChnls = dcChnls.size();
-    size_t dcTotalMppts = dcMppts.size();
+    size_t dcTotalChnls = getDcChannelCount();
+    size_t dcTotalMppts = getMpptCount();
 
     // if there is only one MPPT available, there is nothing we can do
     if (dcTotalMppts <= 1) { return expectedOutputWatts; }
@@ -73,13 +71,10 @@ uint16_t PowerLimiterOverscalingInverter::scaleLimit(uint16_t expectedOutputWatt
     size_t dcShadedMppts = 0;
     auto shadedChannelACPowerSum = 0.0;
 
-    for (auto& m : dcMppts) {
-        float mpptPowerAC = 0.0;
-        std::vector<ChannelNum_t> mpptChnls = _spInverter->getChannelsDCByMppt(m);
+    auto mpptPowers = getMpptAcPowers(inverterEfficiencyFactor);
 
-        for (auto& c : mpptChnls) {
-            mpptPowerAC += pStats->getChannelFieldValue(TYPE_DC, c, FLD_PDC) * inverterEfficiencyFactor;
-        }
+    for (size_t m = 0; m < dcTotalMppts; ++m) {
+        float mpptPowerAC = mpptPowers[m];
 
         if (mpptPowerAC < expectedAcPowerPerMppt) {
             dcShadedMppts++;
@@ -88,7 +83,7 @@ uint16_t PowerLimiterOverscalingInverter::scaleLimit(uint16_t expectedOutputWatt
 
         if (_verboseLogging) {
             MessageOutput.printf("    MPPT-%c AC power %.0f W\r\n",
-                    mpptName(m), mpptPowerAC);
+                    mpptName(getMppt(m)), mpptPowerAC);
         }
     }
 
@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "PowerLimiterScorecard.h"
+#include "ControlLatency.h"
+#include "MqttSettings.h"
+#include "PowerLimiter.h"
+#include <cmath>
+#include <ctime>
+
+static_assert(PowerLimiterScorecard::StatusCount ==
+        static_cast<size_t>(PowerLimiterClass::Status::Stable) + 1,
+        "the scorecard must track every status of the DPL");
+
+char const* PowerLimiterScorecard::getName(Window window)
+{
+    switch (window) {
+    case Window::QuarterHour: return "quarter_hour";
+    case Window::Day: return "day";
+    }
+    return "unknown";
+}
+
+uint32_t PowerLimiterScorecard::getWindowStart(Window window, uint32_t timestamp)
+{
+    switch (window) {
+    case Window::QuarterHour:
+        return timestamp - (timestamp % (15 * 60));
+    case Window::Day: {
+        time_t t = timestamp;
+        struct tm local;
+        localtime_r(&t, &local);
+        return timestamp - (local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec);
+    }
+    }
+    return timestamp;
+}
+
+uint32_t PowerLimiterScorecard::getWindowEnd(Window window, uint32_t start)
+{
+    // a local day lasts 23 to 25 hours, so 36 hours after its start are
+    // within the next day in any case
+    if (window == Window::Day) { return getWindowStart(window, start + 36 * 3600); }
+    return start + 15 * 60;
+}
+
+PowerLimiterScorecard::Result PowerLimiterScorecard::Accumulator::getResult(
+        uint32_t reactions, uint64_t reactionMillis) const
+{
+    Result res = {};
+    res.Start = Start;
+    res.Seconds = CoveredMillis / 1000;
+    res.ActiveSeconds = ActiveMillis / 1000;
+    res.ImportWh = ImportWh;
+    res.ExportWh = ExportWh;
+    res.Commands = Commands;
+    res.Reactions = reactions - ReactionsAtStart;
+
+    if (ErrorMillis > 0) {
+        res.oMeanAbsErrorWatts = static_cast<float>(AbsErrorWattMillis / ErrorMillis);
+    }
+
+    if (res.Reactions > 0) {
+        res.oMeanReactionMillis = static_cast<float>(reactionMillis - ReactionMillisAtStart) / res.Reactions;
+    }
+
+    for (size_t s = 0; s < StatusCount; ++s) {
+        res.StatusPercent[s] = (CoveredMillis > 0) ? 100.0f * StatusMillis[s] / CoveredMillis : 0;
+    }
+
+    return res;
+}
+
+// accounts the state of the last pass for the time since. must be called
+// with the mutex held.
+void PowerLimiterScorecard::account(uint32_t elapsedMillis)
+{
+    auto const& last = *_oLast;
+
+    for (auto& accumulator : _current) {
+        if (accumulator.Start == 0) { continue; }
+
+        accumulator.CoveredMillis += elapsedMillis;
+        if (last.Status < StatusCount) { accumulator.StatusMillis[last.Status] += elapsedMillis; }
+
+        if (!last.Active) { continue; }
+        accumulator.ActiveMillis += elapsedMillis;
+
+        if (!last.oGridWatts) { continue; }
+        double wattHours = *last.oGridWatts * (elapsedMillis / 3600000.0);
+        if (wattHours > 0) {
+            accumulator.ImportWh += wattHours;
+        } else {
+            accumulator.ExportWh -= wattHours;
+        }
+
+        if (!last.oTargetWatts) { continue; }
+        accumulator.AbsErrorWattMillis += std::fabs(*last.oGridWatts - *last.oTargetWatts) * elapsedMillis;
+        accumulator.ErrorMillis += elapsedMillis;
+    }
+}
+
+void PowerLimiterScorecard::update(Inputs const& inputs)
+{
+    std::array<bool, WindowCount> completed = {};
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_oLast) {
+            uint32_t elapsed = inputs.Millis - _oLast->Millis;
+            if (elapsed <= MaxGapMillis) { account(elapsed); }
+        }
+        _oLast = inputs;
+
+        // the windows are aligned to the wall clock
+        uint32_t timestamp = inputs.Timestamp;
+        if (timestamp < MinValidTimestamp) { return; }
+
+        for (size_t w = 0; w < WindowCount; ++w) {
+            auto& accumulator = _current[w];
+            if (timestamp >= accumulator.Start && timestamp < accumulator.End) { continue; }
+
+            auto total = ControlLatency.getTotal(ControlLatencyClass::Metric::Reaction);
+
+            // the first window after the time became known is incomplete,
+            // which its covered seconds tell.
+            if (accumulator.Start != 0) {
+                _completed[w] = accumulator.getResult(total.Count, total.Millis);
+                completed[w] = true;
+            }
+
+            auto window = static_cast<Window>(w);
+            accumulator = Accumulator();
+            accumulator.Start = getWindowStart(window, timestamp);
+            accumulator.End = getWindowEnd(window, accumulator.Start);
+            accumulator.ReactionsAtStart = total.Count;
+            accumulator.ReactionMillisAtStart = total.Millis;
+        }
+    }
+
+    for (size_t w = 0; w < WindowCount; ++w) {
+        if (completed[w]) { publish(static_cast<Window>(w)); }
+    }
+}
+
+void PowerLimiterScorecard::countCommand()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (auto& accumulator : _current) {
+        if (accumulator.Start != 0) { ++accumulator.Commands; }
+    }
+}
+
+std::optional<PowerLimiterScorecard::Result> PowerLimiterScorecard::getCurrent(Window window) const
+{
+    auto total = ControlLatency.getTotal(ControlLatencyClass::Metric::Reaction);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto const& accumulator = _current[static_cast<size_t>(window)];
+    if (accumulator.Start == 0) { return std::nullopt; }
+
+    return accumulator.getResult(total.Count, total.Millis);
+}
+
+std::optional<PowerLimiterScorecard::Result> PowerLimiterScorecard::getCompleted(Window window) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _completed[static_cast<size_t>(window)];
+}
+
+void PowerLimiterScorecard::publish(Window window)
+{
+    if (!MqttSettings.acceptsPublishes()) { return; }
+
+    auto oResult = getCompleted(window);
+    if (!oResult) { return; }
+
+    // the topic is powerlimiter/scorecard/<window>/<metric>
+    static constexpr char const* prefixes[WindowCount] = {
+        "powerlimiter/scorecard/quarter_hour/",
+        "powerlimiter/scorecard/day/"
+    };
+
+    char const* prefix = prefixes[static_cast<size_t>(window)];
+    auto& topics = MqttTopicRegistry;
+    auto const& res = *oResult;
+
+    MqttSettings.publish(topics.intern(prefix, "seconds"), res.Seconds, 0);
+    MqttSettings.publish(topics.intern(prefix, "active_seconds"), res.ActiveSeconds, 0);
+    MqttSettings.publish(topics.intern(prefix, "import_wh"), res.ImportWh, 2);
+    MqttSettings.publish(topics.intern(prefix, "export_wh"), res.ExportWh, 2);
+    MqttSettings.publish(topics.intern(prefix, "commands"), res.Commands, 0);
+    MqttSettings.publish(topics.intern(prefix, "reactions"), res.Reactions, 0);
+
+    if (res.oMeanAbsErrorWatts) {
+        MqttSettings.publish(topics.intern(prefix, "mean_abs_error"), *res.oMeanAbsErrorWatts, 1);
+    }
+
+    if (res.oMeanReactionMillis) {
+        MqttSettings.publish(topics.intern(prefix, "mean_reaction"), *res.oMeanReactionMillis, 0);
+    }
+
+    for (size_t s = 0; s < StatusCount; ++s) {
+        auto status = static_cast<PowerLimiterClass::Status>(s);
+        MqttSettings.publish(topics.intern(prefix, "status/", PowerLimiterClass::getStatusKey(status)),
+                res.StatusPercent[s], 1);
+    }
+}
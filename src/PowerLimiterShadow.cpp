@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "PowerLimiterShadow.h"
+#include <algorithm>
+#include <cmath>
+
+void PowerLimiterShadow::accumulate(Totals& totals, float gridWatts, uint32_t elapsedMillis)
+{
+    double wattHours = gridWatts * (elapsedMillis / 3600000.0);
+    if (wattHours > 0) {
+        totals.ImportWh += wattHours;
+    } else {
+        totals.ExportWh -= wattHours;
+    }
+}
+
+void PowerLimiterShadow::update(Inputs const& inputs, int16_t targetConsumption, uint16_t hysteresis)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // the grid power since the last calculation, with the limit the shadow
+    // commanded back then. nothing is accumulated without a measurement to
+    // compare against.
+    if (_oLastMillis && inputs.oGridWatts) {
+        uint32_t elapsed = inputs.Millis - *_oLastMillis;
+        if (elapsed <= MaxGapMillis) {
+            accumulate(_live, *inputs.oGridWatts, elapsed);
+            accumulate(_shadow, inputs.LoadWatts - _limitWatts, elapsed);
+            _coveredMillis += elapsed;
+        }
+    }
+    _oLastMillis = inputs.Millis;
+
+    if (inputs.LiveLimitsUpdated) { ++_live.Commands; }
+
+    if (_oLiveDischarge && *_oLiveDischarge != inputs.LiveDischarge) { ++_live.Flaps; }
+    _oLiveDischarge = inputs.LiveDischarge;
+
+    // between the thresholds, the state that was last triggered is kept
+    bool discharge = _oDischarge.value_or(false);
+    if (inputs.StopThresholdReached) {
+        discharge = false;
+    } else if (inputs.StartThresholdReached) {
+        discharge = true;
+    }
+    if (_oDischarge && *_oDischarge != discharge) { ++_shadow.Flaps; }
+    _oDischarge = discharge;
+
+    float requested = std::max(0.0f, inputs.LoadWatts - targetConsumption);
+    requested = std::min<float>(requested, inputs.UpperLimitWatts);
+    if (!discharge) { requested = std::min<float>(requested, inputs.UnrestrictedWatts); }
+
+    auto limit = static_cast<uint16_t>(std::lround(requested));
+    auto change = std::abs(static_cast<int32_t>(limit) - _limitWatts);
+    if (change > hysteresis) {
+        _limitWatts = limit;
+        ++_shadow.Commands;
+    }
+
+    ++_cycles;
+}
+
+void PowerLimiterShadow::reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _oLastMillis = std::nullopt;
+    _oLiveDischarge = std::nullopt;
+    _oDischarge = std::nullopt;
+    _limitWatts = 0;
+    _cycles = 0;
+    _coveredMillis = 0;
+    _live = {};
+    _shadow = {};
+}
+
+PowerLimiterShadow::Summary PowerLimiterShadow::getSummary() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    Summary res;
+    res.Active = _oLastMillis.has_value();
+    res.Cycles = _cycles;
+    res.Seconds = _coveredMillis / 1000;
+    res.LimitWatts = _limitWatts;
+    res.Discharge = _oDischarge.value_or(false);
+    res.Live = _live;
+    res.Shadow = _shadow;
+    return res;
+}
@@ -28,8 +28,7 @@ uint16_t PowerLimiterSolarInverter::getMaxIncreaseWatts() const
     int16_t maxTotalIncrease = getConfiguredMaxPowerWatts() - getCurrentOutputAcWatts();
 
     auto pStats = _spInverter->Statistics();
-    std::vector<MpptNum_t> dcMppts = _spInverter->getMppts();
-    size_t dcTotalMppts = dcMppts.size();
+    size_t dcTotalMppts = getMpptCount();
 
     float inverterEfficiencyFactor = pStats->getChannelFieldValue(TYPE_INV, CH0, FLD_EFF) / 100;
 
@@ -48,13 +47,10 @@ uint16_t PowerLimiterSolarInverter::getMaxIncreaseWatts() const
     size_t dcNonShadedMppts = 0;
     auto nonShadedMpptACPowerSum = 0.0;
 
-    for (auto& m : dcMppts) {
-        float mpptPowerAC = 0.0;
-        std::vector<ChannelNum_t> mpptChnls = _spInverter->getChannelsDCByMppt(m);
+    auto mpptPowers = getMpptAcPowers(inverterEfficiencyFactor);
 
-        for (auto& c : mpptChnls) {
-            mpptPowerAC += pStats->getChannelFieldValue(TYPE_DC, c, FLD_PDC) * inverterEfficiencyFactor;
-        }
+    for (size_t m = 0; m < dcTotalMppts; ++m) {
+        float mpptPowerAC = mpptPowers[m];
 
         if (mpptPowerAC >= expectedAcPowerPerMppt) {
             nonShadedMpptACPowerSum += mpptPowerAC;
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "PowerLimiterTrace.h"
+#include <Arduino.h>
+#include "MemoryPolicy.h"
+#include <cstring>
+
+void PowerLimiterTrace::allocate()
+{
+    // allocated once the DPL runs, as the trace is of no use otherwise
+    _capacity = psramFound() ? 4096 : 48;
+    size_t size = _capacity * sizeof(Record);
+    _records = static_cast<Record*>(MemoryPolicy::allocateLarge(size));
+
+    if (_records == nullptr) { _capacity = 0; }
+}
+
+void PowerLimiterTrace::record(Record const& record)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_records == nullptr) {
+        allocate();
+        if (_records == nullptr) { return; }
+    }
+
+    if (_end > 0 && !(record.Flags & FlagCalculated)) {
+        auto& last = _records[(_end - 1) % _capacity];
+        bool same = last.Status == record.Status
+            && last.Flags == record.Flags
+            && last.Repeats < UINT8_MAX
+            && last.InverterCount == record.InverterCount
+            && memcmp(last.Inverters, record.Inverters,
+                    record.InverterCount * sizeof(Inverter)) == 0;
+
+        if (same) {
+            ++last.Repeats;
+            return;
+        }
+    }
+
+    _records[_end % _capacity] = record;
+    _records[_end % _capacity].Repeats = 0;
+    ++_end;
+}
+
+std::pair<uint32_t, uint32_t> PowerLimiterTrace::getSequenceRange() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint32_t first = (_end > _capacity) ? _end - _capacity : 0;
+    return { first, _end };
+}
+
+bool PowerLimiterTrace::read(uint32_t sequence, Record& record) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (sequence >= _end || (_end - sequence) > _capacity) { return false; }
+
+    record = _records[sequence % _capacity];
+    return true;
+}
@@ -3,14 +3,19 @@
  * Copyright (C) 2024 Thomas Basler and others
  */
 #include "RestartHelper.h"
+#include "Configuration.h"
 #include "Display_Graphic.h"
+#include "EnergyMeter.h"
 #include "Led_Single.h"
+#include "StateStore.h"
+#include "WarmRestart.h"
 #include <Esp.h>
+#include "TaskProfiler.h"
 
 RestartHelperClass RestartHelper;
 
 RestartHelperClass::RestartHelperClass()
-    : _rebootTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&RestartHelperClass::loop, this))
+    : _rebootTask(1 * TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("RestartHelper::loop", std::bind(&RestartHelperClass::loop, this)))
 {
 }
 
@@ -31,6 +36,10 @@ void RestartHelperClass::loop()
         LedSingle.turnAllOff();
         Display.setStatus(false);
     } else {
+        Configuration.flush();
+        EnergyMeter.flush();
+        StateStore.flush();
+        WarmRestart.save();
         ESP.restart();
     }
 }
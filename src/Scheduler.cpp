@@ -3,5 +3,17 @@
  * Copyright (C) 2023 Thomas Basler and others
  */
 #include "Scheduler.h"
+#include <Arduino.h>
 
-Scheduler scheduler;
\ No newline at end of file
+Scheduler scheduler;
+
+void executeScheduler()
+{
+    // execute() returns true if none of the tasks was due
+    if (!scheduler.execute()) { return; }
+
+    // the loop task would otherwise spin and starve the idle task of its
+    // core, which feeds the watchdog and lets the core sleep. a task which
+    // becomes due meanwhile is started at most one tick late.
+    vTaskDelay(1);
+}
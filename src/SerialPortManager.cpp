@@ -37,6 +37,19 @@ std::optional<uint8_t> SerialPortManagerClass::allocatePort(std::string const& o
 }
 
 void SerialPortManagerClass::freePort(std::string const& owner)
+{
+    // the shared port is released once its last owner is gone
+    if (freeSharedPort(owner)) { freeHardwarePort(_sharedPortOwner); }
+
+    freeHardwarePort(owner);
+
+    if (_softwarePorts.erase(owner) > 0) {
+        MessageOutput.printf("[SerialPortManager] Freeing software UART, "
+                "owner was '%s'\r\n", owner.c_str());
+    }
+}
+
+void SerialPortManagerClass::freeHardwarePort(std::string const& owner)
 {
     for (size_t i = 0; i < _ports.size(); ++i) {
         if (_ports[i] != owner) { continue; }
@@ -47,14 +60,120 @@ void SerialPortManagerClass::freePort(std::string const& owner)
     }
 }
 
+bool SerialPortManagerClass::allocateSharedPort(std::string const& owner, SharedPortConfig const& config)
+{
+    std::lock_guard<std::mutex> lock(_sharedMutex);
+
+    if (!_upSharedSerial) {
+        auto oHwSerialPort = allocatePort(_sharedPortOwner);
+        if (!oHwSerialPort) {
+            _rejects.erase(_sharedPortOwner);
+            _rejects.insert(owner);
+            return false;
+        }
+
+        _upSharedSerial = std::make_unique<HardwareSerial>(*oHwSerialPort);
+        _upSharedSerial->end(); // make sure the UART will be re-initialized
+    }
+
+    _sharedOwners[owner] = config;
+
+    // the settings are applied once the owner acquires its first window
+    if (_configuredOwner == owner) { _configuredOwner.clear(); }
+
+    MessageOutput.printf("[SerialPortManager] Time-sliced HW UART now "
+            "shared with '%s'\r\n", owner.c_str());
+
+    return true;
+}
+
+bool SerialPortManagerClass::freeSharedPort(std::string const& owner)
+{
+    std::lock_guard<std::mutex> lock(_sharedMutex);
+
+    if (_sharedOwners.erase(owner) == 0) { return false; }
+
+    MessageOutput.printf("[SerialPortManager] Time-sliced HW UART no longer "
+            "shared with '%s'\r\n", owner.c_str());
+
+    if (_windowOwner == owner) { _windowOwner.clear(); }
+    if (_configuredOwner == owner) { _configuredOwner.clear(); }
+
+    if (!_sharedOwners.empty()) { return false; }
+
+    _upSharedSerial->end();
+    _upSharedSerial = nullptr;
+    return true;
+}
+
+HardwareSerial* SerialPortManagerClass::acquireWindow(std::string const& owner)
+{
+    std::lock_guard<std::mutex> lock(_sharedMutex);
+
+    auto iter = _sharedOwners.find(owner);
+    if (iter == _sharedOwners.end()) { return nullptr; }
+
+    if (!_windowOwner.empty() && _windowOwner != owner) { return nullptr; }
+
+    // the pins of the previous owner are detached by end(). re-initializing
+    // the UART also discards data which was not meant for this owner.
+    if (_configuredOwner != owner) {
+        auto const& config = iter->second;
+        _upSharedSerial->end();
+        _upSharedSerial->setRxBufferSize(_sharedRxBufferSize); // must precede begin()
+        _upSharedSerial->begin(config.Baud, config.Config, config.RxPin, config.TxPin);
+        _configuredOwner = owner;
+    }
+
+    _windowOwner = owner;
+    return _upSharedSerial.get();
+}
+
+void SerialPortManagerClass::releaseWindow(std::string const& owner)
+{
+    std::lock_guard<std::mutex> lock(_sharedMutex);
+
+    if (_windowOwner != owner) { return; }
+
+    // transmissions must complete before the pins are handed over
+    _upSharedSerial->flush();
+    _windowOwner.clear();
+}
+
+bool SerialPortManagerClass::hasFreePort() const
+{
+    for (auto const& port : _ports) {
+        if (port == "") { return true; }
+    }
+    return false;
+}
+
+void SerialPortManagerClass::registerSoftwarePort(std::string const& owner)
+{
+    MessageOutput.printf("[SerialPortManager] Software UART now in use "
+            "by '%s'\r\n", owner.c_str());
+    _softwarePorts.insert(owner);
+}
+
 SerialPortManagerClass::allocations_t SerialPortManagerClass::getAllocations() const
 {
     allocations_t res;
     for (int8_t i = 0; i < _ports.size(); ++i) {
-        res.push_back({i, _ports[i]});
+        if (_ports[i] != _sharedPortOwner) {
+            res.push_back({i, _ports[i], false});
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(_sharedMutex);
+        for (auto const& [owner, config] : _sharedOwners) {
+            res.push_back({i, owner, true});
+        }
+    }
+    for (auto const& owner : _softwarePorts) {
+        res.push_back({SoftwarePort, owner, false});
     }
     for (auto const& reject : _rejects) {
-        res.push_back({-1, reject});
+        res.push_back({-1, reject, false});
     }
     return res;
 }
@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "SerialProviderTask.h"
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct SerialProviderTask::Group {
+    std::mutex Mutex; // held while the members are served
+    std::vector<SerialProviderTask*> Members;
+    TaskHandle_t TaskHandle = nullptr;
+    std::atomic<bool> StopTask = false;
+    std::atomic<bool> TaskDone = false;
+};
+
+// the groups are never destroyed, such that a UART event which is still
+// dispatched while a provider stops does not refer to a destroyed group.
+// the mutex serializes starting and stopping providers.
+static std::mutex sGroupsMutex;
+static std::map<TaskPlacement::Role, std::unique_ptr<SerialProviderTask::Group>> sGroups;
+
+bool SerialProviderTask::startSerialTask(char const* name, TaskPlacement::Role role,
+        uint32_t stackSize, uint32_t periodMillis, HardwareSerial* pSerial)
+{
+    if (_pGroup != nullptr) { return true; }
+
+    std::lock_guard<std::mutex> groupsLock(sGroupsMutex);
+
+    auto& upGroup = sGroups[role];
+    if (!upGroup) { upGroup = std::make_unique<Group>(); }
+    Group& group = *upGroup;
+
+    if (group.TaskHandle == nullptr) {
+        group.StopTask = false;
+        group.TaskDone = false;
+
+        if (!TaskPlacement::create(role, SerialProviderTask::taskHelper, name,
+                    stackSize, &group, &group.TaskHandle)) {
+            group.TaskHandle = nullptr;
+            return false;
+        }
+    }
+
+    _pSerial = pSerial;
+    _periodTicks = pdMS_TO_TICKS(periodMillis);
+    _notified = true; // run once right away
+
+    {
+        std::lock_guard<std::mutex> lock(group.Mutex);
+        group.Members.push_back(this);
+        _lastRunTicks = xTaskGetTickCount();
+    }
+
+    _pGroup = &group;
+
+    // runs in the UART event task, which is fed by the driver's event queue
+    // once the RX FIFO filled up or the RX line became idle.
+    if (_pSerial) {
+        _pSerial->onReceive([this]() { notifySerialTask(); }, false/*only on timeout*/);
+    }
+
+    xTaskNotifyGive(group.TaskHandle);
+
+    return true;
+}
+
+void SerialProviderTask::stopSerialTask()
+{
+    if (_pSerial) {
+        _pSerial->onReceive(nullptr);
+        _pSerial = nullptr;
+    }
+
+    if (_pGroup == nullptr) { return; }
+
+    std::lock_guard<std::mutex> groupsLock(sGroupsMutex);
+
+    Group& group = *_pGroup.load();
+    bool empty;
+
+    {
+        std::lock_guard<std::mutex> lock(group.Mutex);
+        auto& members = group.Members;
+        members.erase(std::remove(members.begin(), members.end(), this), members.end());
+        empty = members.empty();
+    }
+
+    _pGroup = nullptr;
+
+    if (!empty) { return; }
+
+    // the last provider of the role stopped, which frees the stack
+    group.StopTask = true;
+    xTaskNotifyGive(group.TaskHandle);
+    while (!group.TaskDone) { delay(10); }
+    group.TaskHandle = nullptr;
+}
+
+void SerialProviderTask::notifySerialTask()
+{
+    Group* pGroup = _pGroup;
+    if (pGroup == nullptr) { return; }
+
+    _notified = true;
+
+    auto taskHandle = pGroup->TaskHandle;
+    if (taskHandle != nullptr) { xTaskNotifyGive(taskHandle); }
+}
+
+void SerialProviderTask::taskHelper(void* context)
+{
+    auto pGroup = static_cast<Group*>(context);
+    groupLoop(*pGroup);
+    pGroup->TaskDone = true;
+    vTaskDelete(nullptr);
+}
+
+void SerialProviderTask::groupLoop(Group& group)
+{
+    while (!group.StopTask) {
+        TickType_t waitTicks = portMAX_DELAY;
+
+        {
+            std::lock_guard<std::mutex> lock(group.Mutex);
+
+            for (auto pMember : group.Members) {
+                TickType_t elapsedTicks = xTaskGetTickCount() - pMember->_lastRunTicks;
+
+                // the flag is cleared before the provider runs, such that
+                // data received meanwhile wakes the task again.
+                if (pMember->_notified.exchange(false) || elapsedTicks >= pMember->_periodTicks) {
+                    pMember->serialLoop();
+                    pMember->_lastRunTicks = xTaskGetTickCount();
+                    elapsedTicks = 0;
+                }
+
+                waitTicks = std::min(waitTicks, pMember->_periodTicks - elapsedTicks);
+            }
+        }
+
+        ulTaskNotifyTake(pdTRUE, waitTicks);
+    }
+}
@@ -0,0 +1,279 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "StateStore.h"
+#include "MessageOutput.h"
+#include "TaskProfiler.h"
+#include <LittleFS.h>
+#include <esp_rom_crc.h>
+
+StateStoreClass StateStore;
+
+namespace {
+
+constexpr char const* LOG_FILENAME = "/state.log";
+constexpr char const* LOG_TMP_FILENAME = "/state.log.tmp";
+constexpr uint16_t RECORD_MAGIC = 0x5353; // "SS"
+
+} // namespace
+
+StateStoreClass::StateStoreClass()
+    : _loopTask(WriteIntervalMillis * TASK_MILLISECOND, TASK_FOREVER, TaskProfiler.wrap("StateStore::loop", std::bind(&StateStoreClass::loop, this)))
+{
+}
+
+void StateStoreClass::init(Scheduler& scheduler)
+{
+    restore();
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+StateStoreClass::Entry* StateStoreClass::find(char const* key)
+{
+    for (auto& entry : _entries) {
+        if (strcmp(entry.Key, key) == 0) { return &entry; }
+    }
+    return nullptr;
+}
+
+StateStoreClass::Entry const* StateStoreClass::find(char const* key) const
+{
+    for (auto const& entry : _entries) {
+        if (strcmp(entry.Key, key) == 0) { return &entry; }
+    }
+    return nullptr;
+}
+
+std::optional<uint64_t> StateStoreClass::getCounter(char const* key) const
+{
+    uint64_t value;
+    if (getBlob(key, &value, sizeof(value)) != sizeof(value)) { return std::nullopt; }
+    return value;
+}
+
+bool StateStoreClass::setCounter(char const* key, uint64_t value)
+{
+    return setBlob(key, &value, sizeof(value));
+}
+
+size_t StateStoreClass::getBlob(char const* key, void* data, size_t maxSize) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto pEntry = find(key);
+    if (!pEntry) { return 0; }
+
+    auto size = pEntry->Value.size();
+    if (size <= maxSize) { memcpy(data, pEntry->Value.data(), size); }
+    return size;
+}
+
+bool StateStoreClass::setBlob(char const* key, void const* data, size_t size)
+{
+    if (strlen(key) > MaxKeyLength || size > MaxValueSize) { return false; }
+
+    auto pBytes = static_cast<uint8_t const*>(data);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto pEntry = find(key);
+    if (!pEntry) {
+        _entries.emplace_back();
+        pEntry = &_entries.back();
+        strlcpy(pEntry->Key, key, sizeof(pEntry->Key));
+    } else if (pEntry->Value.size() == size && memcmp(pEntry->Value.data(), pBytes, size) == 0) {
+        return true;
+    }
+
+    pEntry->Value.assign(pBytes, pBytes + size);
+    pEntry->Dirty = true;
+    _dirty = true;
+    return true;
+}
+
+void StateStoreClass::remove(char const* key)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // the removal is recorded as an empty value. the entry is dropped
+    // when compacting the log.
+    auto pEntry = find(key);
+    if (!pEntry || pEntry->Value.empty()) { return; }
+
+    pEntry->Value.clear();
+    pEntry->Dirty = true;
+    _dirty = true;
+}
+
+void StateStoreClass::loop()
+{
+    if (_dirty || _compactionPending) { flush(); }
+}
+
+void StateStoreClass::flush()
+{
+    bool compactLog;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        compactLog = _compactionPending || _logSize >= MaxLogSize;
+    }
+
+    if (compactLog) {
+        if (!compact()) {
+            MessageOutput.printf("[StateStore] Failed to compact %s\r\n", LOG_FILENAME);
+        }
+    } else if (!append()) {
+        MessageOutput.printf("[StateStore] Failed to append to %s\r\n", LOG_FILENAME);
+    }
+}
+
+namespace {
+
+void appendRecord(std::vector<uint8_t>& buffer, char const* key, std::vector<uint8_t> const& value)
+{
+    auto start = buffer.size();
+
+    uint8_t header[4];
+    uint16_t magic = RECORD_MAGIC;
+    memcpy(header, &magic, sizeof(magic));
+    header[2] = strlen(key);
+    header[3] = value.size();
+
+    buffer.insert(buffer.end(), header, header + sizeof(header));
+    buffer.insert(buffer.end(), key, key + header[2]);
+    buffer.insert(buffer.end(), value.begin(), value.end());
+
+    uint32_t crc = esp_rom_crc32_le(0, buffer.data() + start, buffer.size() - start);
+    auto pCrc = reinterpret_cast<uint8_t const*>(&crc);
+    buffer.insert(buffer.end(), pCrc, pCrc + sizeof(crc));
+}
+
+} // namespace
+
+bool StateStoreClass::append()
+{
+    static_assert(sizeof(RecordHeader) == 4, "unexpected record header layout");
+
+    // the records are collected first, such that the file is written
+    // without holding the lock, and in one go.
+    std::vector<uint8_t> buffer;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto& entry : _entries) {
+            if (!entry.Dirty) { continue; }
+            appendRecord(buffer, entry.Key, entry.Value);
+            entry.Dirty = false;
+        }
+        _dirty = false;
+    }
+
+    if (buffer.empty()) { return true; }
+
+    File f = LittleFS.open(LOG_FILENAME, "a");
+    bool success = f && f.write(buffer.data(), buffer.size()) == buffer.size();
+    if (f) { f.close(); }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _logSize += buffer.size();
+
+    // the log might end in a partial record now, which would hide all
+    // records appended after it. rewriting it restores all values.
+    if (!success) { _compactionPending = true; }
+
+    return success;
+}
+
+bool StateStoreClass::compact()
+{
+    std::vector<uint8_t> buffer;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto iter = _entries.begin();
+        while (iter != _entries.end()) {
+            if (iter->Value.empty()) {
+                iter = _entries.erase(iter);
+                continue;
+            }
+            appendRecord(buffer, iter->Key, iter->Value);
+            iter->Dirty = false;
+            ++iter;
+        }
+        _dirty = false;
+        _compactionPending = false;
+    }
+
+    File f = LittleFS.open(LOG_TMP_FILENAME, "w");
+    bool success = f && f.write(buffer.data(), buffer.size()) == buffer.size();
+    if (f) { f.close(); }
+
+    success = success && LittleFS.rename(LOG_TMP_FILENAME, LOG_FILENAME);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (success) {
+        _logSize = buffer.size();
+    } else {
+        _compactionPending = true;
+    }
+
+    return success;
+}
+
+void StateStoreClass::restore()
+{
+    File f = LittleFS.open(LOG_FILENAME, "r", false);
+    if (!f) { return; }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    size_t records = 0;
+    uint8_t record[sizeof(RecordHeader) + MaxKeyLength + MaxValueSize + sizeof(uint32_t)];
+
+    while (f.available() > 0) {
+        RecordHeader header;
+        if (f.read(record, sizeof(header)) != sizeof(header)) { break; }
+        memcpy(&header, record, sizeof(header));
+
+        if (header.Magic != RECORD_MAGIC || header.KeyLength == 0
+                || header.KeyLength > MaxKeyLength
+                || header.ValueSize > MaxValueSize) { break; }
+
+        size_t payload = header.KeyLength + header.ValueSize + sizeof(uint32_t);
+        if (f.read(record + sizeof(header), payload) != payload) { break; }
+
+        size_t length = sizeof(header) + header.KeyLength + header.ValueSize;
+        uint32_t crc;
+        memcpy(&crc, record + length, sizeof(crc));
+        if (crc != esp_rom_crc32_le(0, record, length)) { break; }
+
+        char key[MaxKeyLength + 1];
+        memcpy(key, record + sizeof(header), header.KeyLength);
+        key[header.KeyLength] = '\0';
+
+        auto pValue = record + sizeof(header) + header.KeyLength;
+
+        auto pEntry = find(key);
+        if (!pEntry) {
+            _entries.emplace_back();
+            pEntry = &_entries.back();
+            strlcpy(pEntry->Key, key, sizeof(pEntry->Key));
+        }
+        pEntry->Value.assign(pValue, pValue + header.ValueSize);
+        pEntry->Dirty = false;
+
+        _logSize += length + sizeof(crc);
+        ++records;
+    }
+
+    // anything after an invalid record, e.g., one that was interrupted
+    // while writing it, cannot be read. rewriting the log avoids records
+    // being appended after the invalid one.
+    if (_logSize != f.size()) {
+        MessageOutput.printf("[StateStore] Dropped invalid data after %u records\r\n", records);
+        _compactionPending = true;
+    }
+
+    f.close();
+
+    MessageOutput.printf("[StateStore] Restored %u values from %u records\r\n",
+            _entries.size(), records);
+}
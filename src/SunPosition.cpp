@@ -6,13 +6,14 @@
 #include "Configuration.h"
 #include "Utils.h"
 #include <Arduino.h>
+#include "TaskProfiler.h"
 
 #define CALC_UNIQUE_ID (((timeinfo.tm_year << 9) | (timeinfo.tm_mon << 5) | timeinfo.tm_mday) << 1 | timeinfo.tm_isdst)
 
 SunPositionClass SunPosition;
 
 SunPositionClass::SunPositionClass()
-    : _loopTask(5 * TASK_SECOND, TASK_FOREVER, std::bind(&SunPositionClass::loop, this))
+    : _loopTask(5 * TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("SunPosition::loop", std::bind(&SunPositionClass::loop, this)))
 {
 }
 
@@ -35,10 +36,8 @@ bool SunPositionClass::isDayPeriod() const
         return true;
     }
 
-    struct tm timeinfo;
-    getLocalTime(&timeinfo, 5);
-    const uint32_t minutesPastMidnight = timeinfo.tm_hour * 60 + timeinfo.tm_min;
-    return (minutesPastMidnight >= _sunriseMinutes) && (minutesPastMidnight < _sunsetMinutes);
+    const time_t now = time(nullptr);
+    return (now >= _sunrise) && (now < _sunset);
 }
 
 // Returns if sunset/sunrise exists (e.g. in norway sunset/sunrise don't happen in summer months)
@@ -65,6 +64,84 @@ bool SunPositionClass::checkRecalcDayChanged() const
     return _lastSunPositionCalculatedYMD != ymd;
 }
 
+namespace {
+
+// days since 1970-01-01 of the given date in the proleptic gregorian
+// calendar, see https://howardhinnant.github.io/date_algorithms.html
+int32_t daysFromCivil(int32_t y, uint32_t m, uint32_t d)
+{
+    y -= m <= 2;
+    const int32_t era = (y >= 0 ? y : y - 399) / 400;
+    const uint32_t yoe = static_cast<uint32_t>(y - era * 400);
+    const uint32_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int32_t>(doe) - 719468;
+}
+
+// index of the given date (month 1..12) within a leap year
+uint16_t getLeapYearDay(uint32_t month, uint32_t day)
+{
+    static constexpr uint16_t monthStart[] = { 0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335 };
+    return monthStart[month - 1] + day - 1;
+}
+
+double getSunsetType(uint8_t type)
+{
+    switch (type) {
+    case 0:
+        return SunSet::SUNSET_OFFICIAL;
+    case 2:
+        return SunSet::SUNSET_CIVIL;
+    case 3:
+        return SunSet::SUNSET_ASTONOMICAL;
+    default:
+        return SunSet::SUNSET_NAUTICAL;
+    }
+}
+
+} // namespace
+
+void SunPositionClass::updateTable()
+{
+    CONFIG_T const& config = Configuration.get();
+
+    if (_tableValid && _tableLatitude == config.Ntp.Latitude
+            && _tableLongitude == config.Ntp.Longitude
+            && _tableSunsetType == config.Ntp.SunsetType) {
+        return;
+    }
+
+    const double sunsetType = getSunsetType(config.Ntp.SunsetType);
+
+    SunSet sun;
+    sun.setPosition(config.Ntp.Latitude, config.Ntp.Longitude, 0);
+
+    // 2024 is used as a leap year. the times differ by less than a minute
+    // between years.
+    for (uint32_t month = 1; month <= 12; ++month) {
+        static constexpr uint8_t daysInMonth[] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+        for (uint32_t day = 1; day <= daysInMonth[month - 1]; ++day) {
+            sun.setCurrentDate(2024, month, day);
+
+            const double sunriseRaw = sun.calcCustomSunrise(sunsetType);
+            const double sunsetRaw = sun.calcCustomSunset(sunsetType);
+
+            auto& entry = _table[getLeapYearDay(month, day)];
+            if (std::isnan(sunriseRaw) || std::isnan(sunsetRaw)) {
+                entry = { NoSunset, NoSunset };
+                continue;
+            }
+
+            entry = { static_cast<int16_t>(sunriseRaw), static_cast<int16_t>(sunsetRaw) };
+        }
+    }
+
+    _tableLatitude = config.Ntp.Latitude;
+    _tableLongitude = config.Ntp.Longitude;
+    _tableSunsetType = config.Ntp.SunsetType;
+    _tableValid = true;
+}
+
 void SunPositionClass::updateSunData()
 {
     struct tm timeinfo;
@@ -74,81 +151,41 @@ void SunPositionClass::updateSunData()
     setDoRecalc(false);
 
     if (!gotLocalTime) {
-        _sunriseMinutes = 0;
-        _sunsetMinutes = 0;
         _isSunsetAvailable = true;
         _isValidInfo = false;
         return;
     }
 
-    CONFIG_T const& config = Configuration.get();
-
-    double sunset_type;
-    switch (config.Ntp.SunsetType) {
-    case 0:
-        sunset_type = SunSet::SUNSET_OFFICIAL;
-        break;
-    case 2:
-        sunset_type = SunSet::SUNSET_CIVIL;
-        break;
-    case 3:
-        sunset_type = SunSet::SUNSET_ASTONOMICAL;
-        break;
-    default:
-        sunset_type = SunSet::SUNSET_NAUTICAL;
-        break;
-    }
-
-    const int offset = Utils::getTimezoneOffset() / 3600;
+    updateTable();
 
-    SunSet sun;
-    sun.setPosition(config.Ntp.Latitude, config.Ntp.Longitude, offset);
-    sun.setCurrentDate(1900 + timeinfo.tm_year, timeinfo.tm_mon + 1, timeinfo.tm_mday);
-
-    const double sunriseRaw = sun.calcCustomSunrise(sunset_type);
-    const double sunsetRaw = sun.calcCustomSunset(sunset_type);
+    auto const& entry = _table[getLeapYearDay(timeinfo.tm_mon + 1, timeinfo.tm_mday)];
 
     // If no sunset/sunrise exists (e.g. astronomical calculation in summer)
     // assume it's day period
-    if (std::isnan(sunriseRaw) || std::isnan(sunsetRaw)) {
-        _sunriseMinutes = 0;
-        _sunsetMinutes = 0;
+    if (entry.SunriseMinutes == NoSunset) {
         _isSunsetAvailable = false;
         _isValidInfo = false;
         return;
     }
 
-    _sunriseMinutes = static_cast<int>(sunriseRaw);
-    _sunsetMinutes = static_cast<int>(sunsetRaw);
+    // the times of the local date, which are given relative to midnight UTC
+    const time_t midnightUtc = static_cast<time_t>(daysFromCivil(
+        1900 + timeinfo.tm_year, timeinfo.tm_mon + 1, timeinfo.tm_mday)) * 86400;
+    _sunrise = midnightUtc + entry.SunriseMinutes * 60;
+    _sunset = midnightUtc + entry.SunsetMinutes * 60;
 
     _isSunsetAvailable = true;
     _isValidInfo = true;
 }
 
-bool SunPositionClass::getSunTime(struct tm* info, const uint32_t offset) const
-{
-    // Get today's date
-    time_t aTime = time(NULL);
-
-    // Set the time to midnight
-    struct tm tm;
-    localtime_r(&aTime, &tm);
-    tm.tm_sec = 0;
-    tm.tm_min = offset;
-    tm.tm_hour = 0;
-    tm.tm_isdst = -1;
-    const time_t midnight = mktime(&tm);
-
-    localtime_r(&midnight, info);
-    return _isValidInfo;
-}
-
 bool SunPositionClass::sunsetTime(struct tm* info) const
 {
-    return getSunTime(info, _sunsetMinutes);
+    localtime_r(&_sunset, info);
+    return _isValidInfo;
 }
 
 bool SunPositionClass::sunriseTime(struct tm* info) const
 {
-    return getSunTime(info, _sunriseMinutes);
+    localtime_r(&_sunrise, info);
+    return _isValidInfo;
 }
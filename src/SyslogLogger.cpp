@@ -4,15 +4,23 @@
  */
 #include <HardwareSerial.h>
 #include <ESPmDNS.h>
+#include <lwip/dns.h>
+#include <cinttypes>
+#include <cstring>
 #include "defaults.h"
 #include "SyslogLogger.h"
 #include "Configuration.h"
 #include "MessageOutput.h"
 #include "NetworkSettings.h"
+#include <TaskProfiler.h>
 
 SyslogLogger::SyslogLogger()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&SyslogLogger::loop, this))
+    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, TaskProfiler.wrap("SyslogLogger::loop", std::bind(&SyslogLogger::loop, this)))
 {
+    // the AsyncTCP callbacks run in the async_tcp task
+    _client.onConnect([this](void*, AsyncClient*) { _tcpState = TcpState::Connected; });
+    _client.onDisconnect([this](void*, AsyncClient*) { _tcpState = TcpState::Disconnected; });
+    _client.onError([this](void*, AsyncClient*, int8_t) { _tcpState = TcpState::Disconnected; });
 }
 
 void SyslogLogger::init(Scheduler& scheduler)
@@ -37,13 +45,15 @@ void SyslogLogger::updateSettings(const String&& hostname)
     }
 
     _port = config.Port;
+    _protocol = static_cast<Protocol>(config.Protocol);
     _syslog_hostname = config.Hostname;
     if (_syslog_hostname.isEmpty()) {
         MessageOutput.println("[SyslogLogger] Hostname not configured");
         return;
     }
 
-    MessageOutput.printf("[SyslogLogger] Logging to %s!\r\n", _syslog_hostname.c_str());
+    MessageOutput.printf("[SyslogLogger] Logging to %s via %s!\r\n", _syslog_hostname.c_str(),
+            (_protocol == Protocol::Tcp ? "TCP" : "UDP"));
 
     _header = "<14>1 - ";  // RFC5424: Facility USER, severity INFO, version 1, NIL timestamp.
     _header += hostname;
@@ -59,24 +69,58 @@ void SyslogLogger::updateSettings(const String&& hostname)
 void SyslogLogger::write(const uint8_t *buffer, size_t size)
 {
     std::lock_guard<std::mutex> lock(_mutex);
-    if (!_enabled || !isResolved()) {
+    if (!_enabled) {
         return;
     }
-    for (int i = 0; i < size; i++) {
+
+    // lines are only collected here. they are sent in batches by the loop.
+    for (size_t i = 0; i < size; i++) {
         uint8_t c = buffer[i];
-        bool overflow = false;
-        if (c != '\r' && c != '\n') {
-            // Replace control and non-ASCII characters with '?'.
-            overflow = !_udp.write(c >= 0x20 && c < 0x7f ? c : '?');
+
+        if (c == '\r') { continue; }
+
+        if (c == '\n') {
+            endLine();
+            continue;
         }
-        if (c == '\n' || overflow) {
-            _udp.endPacket();
-            _udp.beginPacket(_address, _port);
-            _udp.print(_header);
+
+        if (_discardLine) { continue; }
+
+        if (_lineSize == MaxLineSize) { endLine(); }
+
+        // keep room for the newline terminating this line
+        if (_pendingSize + _lineSize + 1 >= PendingSize) {
+            _lineSize = 0;
+            _discardLine = true;
+            ++_droppedLines;
+            continue;
         }
+
+        // Replace control and non-ASCII characters with '?'.
+        _pending[_pendingSize + _lineSize++] = (c >= 0x20 && c < 0x7f) ? c : '?';
     }
 }
 
+void SyslogLogger::endLine()
+{
+    if (_discardLine) {
+        _discardLine = false;
+        return;
+    }
+
+    if (_lineSize == 0) { return; }
+
+    _pending[_pendingSize + _lineSize] = '\n';
+    _pendingSize += _lineSize + 1;
+    _lineSize = 0;
+}
+
+void SyslogLogger::consume(size_t size)
+{
+    memmove(_pending, _pending + size, _pendingSize - size + _lineSize);
+    _pendingSize -= size;
+}
+
 void SyslogLogger::disable()
 {
     MessageOutput.println("[SyslogLogger] Disable");
@@ -85,54 +129,257 @@ void SyslogLogger::disable()
         _enabled = false;
         _address = INADDR_NONE;
         _udp.stop();
+        _client.close(true);
+
+        // discard the result of a lookup which is still in progress
+        ++_dnsGeneration;
+        _dnsState = DnsState::Idle;
+
+        _pendingSize = 0;
+        _lineSize = 0;
+        _discardLine = false;
+        _droppedLines = 0;
     }
 }
 
 void SyslogLogger::enable()
 {
     // Bind random source port.
-    if (!_udp.begin(0)) {
+    if (_protocol == Protocol::Udp && !_udp.begin(0)) {
         MessageOutput.println("[SyslogLogger] No sockets available");
         return;
     }
 
     std::lock_guard<std::mutex> lock(_mutex);
     _enabled = true;
+
+    // resolve and connect right away
+    _lastResolve = millis() - ResolveRetryMillis;
+    _lastConnect = millis() - ReconnectIntervalMillis;
 }
 
-bool SyslogLogger::resolveAndStart()
+void SyslogLogger::onDnsFound(const char* name, const ip_addr_t* ipaddr, void* arg)
 {
-    if (Configuration.get().Mdns.Enabled) {
-        _address = MDNS.queryHost(_syslog_hostname); // INADDR_NONE if failed
+    // a newer lookup was started in the meantime
+    if (static_cast<uint32_t>(reinterpret_cast<uintptr_t>(arg)) != Syslog._dnsGeneration) {
+        return;
     }
-    if (_address != INADDR_NONE) {
-        if (!_udp.beginPacket(_address, _port)) {
-            return false;
+
+    if (ipaddr == nullptr) {
+        Syslog._dnsState = DnsState::Failed;
+        return;
+    }
+
+    Syslog._dnsResult = ip_2_ip4(ipaddr)->addr;
+    Syslog._dnsState = DnsState::Found;
+}
+
+void SyslogLogger::resolve()
+{
+    _lastResolve = millis();
+
+    IPAddress address;
+    if (address.fromString(_syslog_hostname)) {
+        setAddress(address);
+        return;
+    }
+
+    uint32_t generation = ++_dnsGeneration;
+    _dnsState = DnsState::Pending;
+
+    // does not block. the callback is invoked once the DNS server answered,
+    // unless the address was known already.
+    ip_addr_t result;
+    err_t err = dns_gethostbyname_addrtype(_syslog_hostname.c_str(), &result,
+            &SyslogLogger::onDnsFound, reinterpret_cast<void*>(static_cast<uintptr_t>(generation)),
+            LWIP_DNS_ADDRTYPE_IPV4);
+
+    if (err == ERR_OK) {
+        _dnsResult = ip_2_ip4(&result)->addr;
+        _dnsState = DnsState::Found;
+    } else if (err != ERR_INPROGRESS) {
+        _dnsState = DnsState::Failed;
+    }
+}
+
+void SyslogLogger::updateAddress()
+{
+    switch (_dnsState.load()) {
+    case DnsState::Found:
+        _dnsState = DnsState::Idle;
+        setAddress(IPAddress(_dnsResult.load()));
+        return;
+
+    case DnsState::Failed: {
+        _dnsState = DnsState::Idle;
+
+        // the hostname might only be known via mDNS. the query blocks, but
+        // it is only attempted once per resolve interval.
+        IPAddress address = INADDR_NONE;
+        if (Configuration.get().Mdns.Enabled) {
+            address = MDNS.queryHost(_syslog_hostname, MdnsTimeoutMillis);
         }
-    } else {
-        if (!_udp.beginPacket(_syslog_hostname.c_str(), _port)) {
-            return false;
+
+        if (address != INADDR_NONE) {
+            setAddress(address);
+        } else {
+            MessageOutput.printf("[SyslogLogger] Failed to resolve %s\r\n", _syslog_hostname.c_str());
         }
-        _address = _udp.remoteIP();  // Store resolved address.
+        return;
     }
-    _udp.print(_header);
-    _udp.print("[SyslogLogger] Logging to ");
-    _udp.print(_syslog_hostname);
-    _udp.endPacket();
-    _udp.beginPacket(_address, _port);
-    _udp.print(_header);
+
+    case DnsState::Pending:
+        if (millis() - _lastResolve > ResolveTimeoutMillis) {
+            ++_dnsGeneration;
+            _dnsState = DnsState::Failed;
+        }
+        return;
+
+    case DnsState::Idle:
+        break;
+    }
+
+    // the address is resolved again once in a while, as it might change
+    uint32_t interval = isResolved() ? ResolveIntervalMillis : ResolveRetryMillis;
+    if (millis() - _lastResolve >= interval) {
+        resolve();
+    }
+}
+
+void SyslogLogger::setAddress(IPAddress const& address)
+{
+    if (address == _address) { return; }
+
+    _address = address;
+    MessageOutput.printf("[SyslogLogger] Resolved %s to %s\r\n",
+            _syslog_hostname.c_str(), _address.toString().c_str());
+
+    if (_protocol == Protocol::Tcp) {
+        // reconnect to the new address
+        _client.close(true);
+        _lastConnect = millis() - ReconnectIntervalMillis;
+    }
+}
+
+void SyslogLogger::updateConnection()
+{
+    if (_tcpState != TcpState::Disconnected) { return; }
+
+    if (millis() - _lastConnect < ReconnectIntervalMillis) { return; }
+    _lastConnect = millis();
+
+    // does not block. the result is reported through the callbacks.
+    _tcpState = TcpState::Connecting;
+    if (!_client.connect(_address, _port)) {
+        _tcpState = TcpState::Disconnected;
+    }
+}
+
+bool SyslogLogger::addFrame(char const* message, size_t length)
+{
+    if (_tcpState != TcpState::Connected) { return false; }
+
+    // RFC 6587 octet counting: MSG-LEN SP SYSLOG-MSG
+    size_t messageLength = _header.length() + length;
+    char prefix[8];
+    size_t prefixLength = snprintf(prefix, sizeof(prefix), "%u ", static_cast<unsigned>(messageLength));
+
+    if (_client.space() < prefixLength + messageLength) { return false; }
+
+    _client.add(prefix, prefixLength);
+    _client.add(_header.c_str(), _header.length());
+    _client.add(message, length);
     return true;
 }
 
+bool SyslogLogger::sendMessage(char const* message, size_t length)
+{
+    if (_protocol == Protocol::Tcp) {
+        return addFrame(message, length) && _client.send();
+    }
+
+    if (!_udp.beginPacket(_address, _port)) { return false; }
+    _udp.print(_header);
+    _udp.write(reinterpret_cast<uint8_t const*>(message), length);
+    return _udp.endPacket();
+}
+
+size_t SyslogLogger::sendUdp()
+{
+    // as many lines as fit into a datagram form a single message. the
+    // newline terminating the last line is not sent.
+    size_t capacity = MaxDatagramSize - _header.length();
+    size_t size = 0;
+    while (size < _pendingSize) {
+        auto end = static_cast<char const*>(memchr(_pending + size, '\n', _pendingSize - size));
+        size_t next = end - _pending + 1;
+        if (size > 0 && next - 1 > capacity) { break; }
+        size = next;
+    }
+
+    return sendMessage(_pending, size - 1) ? size : 0;
+}
+
+size_t SyslogLogger::sendTcp()
+{
+    // every line is a message of its own, but all frames which fit into the
+    // send buffer go out in as few segments as possible.
+    size_t size = 0;
+    while (size < _pendingSize) {
+        char const* line = _pending + size;
+        auto end = static_cast<char const*>(memchr(line, '\n', _pendingSize - size));
+        if (!addFrame(line, end - line)) { break; }
+        size = end - _pending + 1;
+    }
+
+    if (size > 0 && !_client.send()) { return 0; }
+
+    return size;
+}
+
+void SyslogLogger::flush()
+{
+    if (_droppedLines > 0) {
+        char note[64];
+        snprintf(note, sizeof(note), "[SyslogLogger] %" PRIu32 " lines were dropped", _droppedLines);
+        if (!sendMessage(note, strlen(note))) { return; }
+        _droppedLines = 0;
+    }
+
+    while (_pendingSize > 0) {
+        size_t sent = (_protocol == Protocol::Tcp) ? sendTcp() : sendUdp();
+        if (sent == 0) { break; }
+        consume(sent);
+    }
+}
+
 void SyslogLogger::loop()
 {
     std::lock_guard<std::mutex> lock(_mutex);
-    if (!_enabled || !NetworkSettings.isConnected() || isResolved()) {
+    if (!_enabled || !NetworkSettings.isConnected()) {
         return;
     }
-    if (!resolveAndStart()) {
-        _enabled = false;
+
+    updateAddress();
+    if (!isResolved()) {
+        return;
     }
+
+    if (_protocol == Protocol::Tcp) {
+        updateConnection();
+    }
+
+    if (_pendingSize == 0 && _droppedLines == 0) {
+        return;
+    }
+
+    // lines are collected for a while, unless they fill a datagram already
+    if (_pendingSize < MaxDatagramSize && millis() - _lastFlush < FlushIntervalMillis) {
+        return;
+    }
+
+    _lastFlush = millis();
+    flush();
 }
 
 SyslogLogger Syslog;
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "TaskProfiler.h"
+#include "Scheduler.h"
+#include <Arduino.h>
+#include <algorithm>
+
+TaskProfilerClass TaskProfiler;
+
+TaskCallback TaskProfilerClass::wrap(char const* name, TaskCallback callback)
+{
+    // entries are never removed, as tasks live as long as the firmware runs
+    auto pEntry = new Entry();
+    pEntry->Values.Name = name;
+
+    // other tasks only read the list
+    pEntry->Next = _first.load();
+    _first.store(pEntry);
+
+    return [pEntry, callback]() { run(*pEntry, callback); };
+}
+
+void TaskProfilerClass::run(Entry& entry, TaskCallback const& callback)
+{
+    auto& values = entry.Values;
+    uint32_t now = millis();
+
+    uint32_t interval = scheduler.currentTask().getInterval();
+    values.IntervalMillis = interval;
+
+    if (values.Count > 0 && interval > 0) {
+        uint32_t sincePrevious = now - entry.LastStartMillis;
+        if (sincePrevious > interval) {
+            values.MaxLateMillis = std::max(values.MaxLateMillis, sincePrevious - interval);
+        }
+    }
+    entry.LastStartMillis = now;
+
+    if (entry.HeapTag == nullptr) { entry.HeapTag = HeapMonitor.getTag(values.Name); }
+
+    uint32_t cycles;
+    {
+        HeapMonitorClass::Scope heapScope(entry.HeapTag);
+        uint32_t startCycles = ESP.getCycleCount();
+        callback();
+        cycles = ESP.getCycleCount() - startCycles;
+    }
+
+    uint32_t micros = cycles / ESP.getCpuFreqMHz();
+    ++values.Count;
+    values.TotalMicros += micros;
+    values.MaxMicros = std::max(values.MaxMicros, micros);
+    if (interval > 0 && micros > interval * 1000) { ++values.Overruns; }
+}
+
+std::vector<TaskProfilerClass::Stats> TaskProfilerClass::getStats() const
+{
+    std::vector<Stats> result;
+    for (auto pEntry = _first.load(); pEntry != nullptr; pEntry = pEntry->Next) {
+        result.push_back(pEntry->Values);
+    }
+    return result;
+}
@@ -0,0 +1,291 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <TwaiBus.h>
+#include <InputCapture.h>
+#include <MessageOutput.h>
+#include <TaskPlacement.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+
+TwaiBusClass TwaiBus;
+
+bool TwaiBusClass::getTimingConfig(uint32_t bitrate, twai_timing_config_t& timing)
+{
+    switch (bitrate) {
+        case 125000: timing = TWAI_TIMING_CONFIG_125KBITS(); return true;
+        case 250000: timing = TWAI_TIMING_CONFIG_250KBITS(); return true;
+        case 500000: timing = TWAI_TIMING_CONFIG_500KBITS(); return true;
+        case 1000000: timing = TWAI_TIMING_CONFIG_1MBITS(); return true;
+    }
+    return false;
+}
+
+TwaiBusClass::Subscription* TwaiBusClass::subscribe(Config const& config)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    twai_timing_config_t timing;
+    if (!getTimingConfig(config.Bitrate, timing)) {
+        MessageOutput.printf("[TwaiBus] Unsupported bitrate %" PRIu32 " requested "
+                "by '%s'\r\n", config.Bitrate, config.Name);
+        return nullptr;
+    }
+
+    if (!_subscriptions.empty()) {
+        auto const& other = _subscriptions.front()->_config;
+        if (other.TxPin != config.TxPin || other.RxPin != config.RxPin
+                || other.Bitrate != config.Bitrate) {
+            MessageOutput.printf("[TwaiBus] Cannot add '%s' (rx = %d, tx = %d, "
+                    "%" PRIu32 " bit/s), bus is used by '%s' (rx = %d, tx = %d, "
+                    "%" PRIu32 " bit/s)\r\n", config.Name, config.RxPin,
+                    config.TxPin, config.Bitrate, other.Name, other.RxPin,
+                    other.TxPin, other.Bitrate);
+            return nullptr;
+        }
+    }
+
+    auto upSubscription = std::make_unique<Subscription>();
+    upSubscription->_config = config;
+    upSubscription->_queue = xQueueCreate(config.QueueLength, sizeof(twai_message_t));
+    if (upSubscription->_queue == nullptr) {
+        MessageOutput.printf("[TwaiBus] Failed to allocate frame queue "
+                "for '%s'\r\n", config.Name);
+        return nullptr;
+    }
+
+    // the acceptance filter depends on the subscribers, and it can only be
+    // changed by installing the driver again.
+    stop();
+
+    auto pSubscription = upSubscription.get();
+    _subscriptions.push_back(std::move(upSubscription));
+
+    if (start()) {
+        MessageOutput.printf("[TwaiBus] Added '%s'\r\n", config.Name);
+        return pSubscription;
+    }
+
+    vQueueDelete(pSubscription->_queue);
+    _subscriptions.pop_back();
+
+    if (!_subscriptions.empty()) { start(); }
+
+    return nullptr;
+}
+
+void TwaiBusClass::unsubscribe(Subscription* subscription)
+{
+    if (subscription == nullptr) { return; }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = std::find_if(_subscriptions.begin(), _subscriptions.end(),
+        [subscription](auto const& upSubscription) {
+            return upSubscription.get() == subscription;
+        });
+    if (it == _subscriptions.end()) { return; }
+
+    stop();
+
+    MessageOutput.printf("[TwaiBus] Removed '%s'\r\n", subscription->_config.Name);
+
+    vQueueDelete(subscription->_queue);
+    _subscriptions.erase(it);
+
+    if (!_subscriptions.empty()) { start(); }
+}
+
+bool TwaiBusClass::start()
+{
+    auto const& first = _subscriptions.front()->_config;
+
+    MessageOutput.printf("[TwaiBus] rx = %d, tx = %d, %" PRIu32 " bit/s\r\n",
+            first.RxPin, first.TxPin, first.Bitrate);
+
+    if (first.RxPin < 0 || first.TxPin < 0) {
+        MessageOutput.print("[TwaiBus] Invalid pin config\r\n");
+        return false;
+    }
+
+    auto tx = static_cast<gpio_num_t>(first.TxPin);
+    auto rx = static_cast<gpio_num_t>(first.RxPin);
+    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(tx, rx, TWAI_MODE_NORMAL);
+
+    // interrupts at level 1 are in high demand, at least on ESP32-S3 boards,
+    // but only a limited amount can be allocated. failing to allocate an
+    // interrupt in the TWAI driver will cause a bootloop. we therefore
+    // register the TWAI driver's interrupt at level 2. level 2 interrupts
+    // should be available -- we don't really know. we would love to have the
+    // esp_intr_dump() function, but that's not available yet in our version
+    // of the underlying esp-idf.
+    g_config.intr_flags = ESP_INTR_FLAG_LEVEL2;
+
+    // the task is woken up by these alerts
+    g_config.alerts_enabled = TWAI_ALERT_RX_DATA | TWAI_ALERT_RX_QUEUE_FULL
+        | TWAI_ALERT_BUS_OFF | TWAI_ALERT_BUS_RECOVERED | TWAI_ALERT_ERR_PASS;
+    g_config.rx_queue_len = 16;
+
+    twai_timing_config_t t_config;
+    getTimingConfig(first.Bitrate, t_config);
+
+    // the frames of all subscribers must pass if there are more than one
+    twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+    if (_subscriptions.size() == 1) { f_config = first.Filter; }
+
+    esp_err_t result = twai_driver_install(&g_config, &t_config, &f_config);
+    if (result != ESP_OK) {
+        MessageOutput.printf("[TwaiBus] Failed to install driver: %s\r\n",
+                esp_err_to_name(result));
+        return false;
+    }
+
+    result = twai_start();
+    if (result != ESP_OK) {
+        MessageOutput.printf("[TwaiBus] Failed to start driver: %s\r\n",
+                esp_err_to_name(result));
+        twai_driver_uninstall();
+        return false;
+    }
+
+    _running = true;
+    _stopTask = false;
+    _taskDone = false;
+
+    // runs at a high priority, such that frames are fetched from the
+    // driver's queue while other tasks are busy.
+    uint32_t constexpr stackSize = 2048;
+    if (!TaskPlacement::create(TaskPlacement::Role::CanBus,
+                TwaiBusClass::taskHelper, "TwaiBus", stackSize,
+                this, &_taskHandle)) {
+        MessageOutput.print("[TwaiBus] Failed to create task\r\n");
+        _taskHandle = nullptr;
+        stop();
+        return false;
+    }
+
+    return true;
+}
+
+void TwaiBusClass::stop()
+{
+    if (_taskHandle != nullptr) {
+        _stopTask = true;
+        while (!_taskDone) { delay(10); }
+        _taskHandle = nullptr;
+    }
+
+    if (!_running) { return; }
+    _running = false;
+
+    if (twai_stop() != ESP_OK) {
+        MessageOutput.print("[TwaiBus] Failed to stop driver\r\n");
+    }
+
+    if (twai_driver_uninstall() != ESP_OK) {
+        MessageOutput.print("[TwaiBus] Failed to uninstall driver\r\n");
+    }
+}
+
+bool TwaiBusClass::transmit(twai_message_t const& message, TickType_t timeout)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_running) { return false; }
+    return twai_transmit(&message, timeout) == ESP_OK;
+}
+
+void TwaiBusClass::taskHelper(void* context)
+{
+    auto pInstance = static_cast<TwaiBusClass*>(context);
+    pInstance->task();
+    pInstance->_taskDone = true;
+    vTaskDelete(nullptr);
+}
+
+void TwaiBusClass::task()
+{
+    while (!_stopTask) {
+        uint32_t alerts = 0;
+        // the timeout allows to notice that the task shall stop, and to
+        // replay recorded frames in time
+        bool replaying = InputCapture.isReplaying(InputCapture::Source::Twai);
+        if (twai_read_alerts(&alerts, pdMS_TO_TICKS(replaying ? 5 : 100)) != ESP_OK) {
+            replayFrames();
+            continue;
+        }
+
+        if (alerts & TWAI_ALERT_ERR_PASS) {
+            MessageOutput.print("[TwaiBus] Controller is error passive\r\n");
+        }
+
+        if (alerts & TWAI_ALERT_BUS_OFF) {
+            MessageOutput.print("[TwaiBus] Bus off, initiating recovery\r\n");
+            twai_initiate_recovery();
+            continue;
+        }
+
+        if (alerts & TWAI_ALERT_BUS_RECOVERED) {
+            MessageOutput.print("[TwaiBus] Bus recovered\r\n");
+            twai_start();
+            continue;
+        }
+
+        if (alerts & TWAI_ALERT_RX_QUEUE_FULL) {
+            twai_status_info_t status_info;
+            if (twai_get_status_info(&status_info) == ESP_OK) {
+                _missedFrames = status_info.rx_missed_count;
+            }
+        }
+
+        twai_message_t message;
+        while (twai_receive(&message, 0) == ESP_OK) {
+            if (replaying) { continue; }
+            recordFrame(message);
+            dispatch(message);
+        }
+
+        replayFrames();
+    }
+}
+
+void TwaiBusClass::recordFrame(twai_message_t const& message)
+{
+    uint8_t record[InputCapture::FrameSize] = {};
+    for (int i = 0; i < 4; ++i) { record[i] = (message.identifier >> (8 * i)) & 0xFF; }
+    record[4] = (message.extd ? 0x01 : 0) | (message.rtr ? 0x02 : 0);
+    record[5] = message.data_length_code;
+    memcpy(record + 6, message.data, std::min<size_t>(message.data_length_code, TWAI_FRAME_MAX_DLC));
+    InputCapture.record(InputCapture::Source::Twai, 0, record, sizeof(record));
+}
+
+void TwaiBusClass::replayFrames()
+{
+    InputCapture.replay(InputCapture::Source::Twai, 0, [this](uint8_t const* data, size_t length) {
+        if (length != InputCapture::FrameSize) { return; }
+
+        twai_message_t message = {};
+        for (int i = 0; i < 4; ++i) { message.identifier |= static_cast<uint32_t>(data[i]) << (8 * i); }
+        message.extd = (data[4] & 0x01) != 0;
+        message.rtr = (data[4] & 0x02) != 0;
+        message.data_length_code = std::min<uint8_t>(data[5], TWAI_FRAME_MAX_DLC);
+        memcpy(message.data, data + 6, message.data_length_code);
+        dispatch(message);
+    });
+}
+
+void TwaiBusClass::dispatch(twai_message_t const& message)
+{
+    for (auto const& upSubscription : _subscriptions) {
+        auto& subscription = *upSubscription;
+        auto const& config = subscription._config;
+
+        if (static_cast<bool>(message.extd) != config.Extended) { continue; }
+        if (message.identifier < config.FirstId || message.identifier > config.LastId) { continue; }
+
+        if (xQueueSend(subscription._queue, &message, 0) != pdTRUE) {
+            ++subscription._droppedFrames;
+            continue;
+        }
+
+        if (config.NotifyTask != nullptr) { xTaskNotifyGive(config.NotifyTask); }
+    }
+}
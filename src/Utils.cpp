@@ -6,8 +6,13 @@
 #include "Utils.h"
 #include "MessageOutput.h"
 #include "PinMapping.h"
+#include "WebApi_json_pool.h"
 #include <LittleFS.h>
 #include <MD5Builder.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 
 uint32_t Utils::getChipId()
 {
@@ -124,6 +129,49 @@ void Utils::skipBom(File& f)
     }
 }
 
+size_t Utils::formatFixed(char* buffer, size_t size, double value, uint8_t digits)
+{
+    static constexpr uint32_t powers[] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+    };
+
+    double scaled = std::fabs(value) * (digits < 10 ? powers[digits] : 0) + 0.5;
+
+    // NaN, infinity and values beyond the range of the integer arithmetic
+    if (digits >= 10 || !(scaled < 1e18)) {
+        int len = snprintf(buffer, size, "%.*f", static_cast<int>(digits), value);
+        return len < 0 ? 0 : len;
+    }
+
+    uint64_t fixed = static_cast<uint64_t>(scaled);
+
+    // the text is assembled backwards, starting with the last decimal place
+    char text[FixedFormatSize];
+    char* pos = text + sizeof(text);
+
+    for (uint8_t i = 0; i < digits; ++i) {
+        *--pos = '0' + fixed % 10;
+        fixed /= 10;
+    }
+    if (digits > 0) { *--pos = '.'; }
+
+    do {
+        *--pos = '0' + fixed % 10;
+        fixed /= 10;
+    } while (fixed > 0);
+
+    // values rounding to zero are printed without sign
+    if (value < 0 && scaled >= 1) { *--pos = '-'; }
+
+    size_t len = text + sizeof(text) - pos;
+    if (size > 0) {
+        size_t copied = std::min(len, size - 1);
+        memcpy(buffer, pos, copied);
+        buffer[copied] = '\0';
+    }
+    return len;
+}
+
 /* OpenDTU-OnBatter-specific utils go here: */
 template<typename T>
 std::optional<T> getFromString(char const* val);
@@ -131,84 +179,131 @@ std::optional<T> getFromString(char const* val);
 template<>
 std::optional<float> getFromString(char const* val)
 {
-    float res = 0;
-
-    try {
-        res = std::stof(val);
-    }
-    catch (std::invalid_argument const& e) {
-        return std::nullopt;
-    }
-
+    char* end = nullptr;
+    float res = strtof(val, &end);
+    if (end == val) { return std::nullopt; }
     return res;
 }
 
+// parses a payload which is not null-terminated without allocating. like
+// strtof(), leading whitespace and trailing characters are ignored.
+template<typename T>
+std::optional<T> getFromPayload(std::string_view payload)
+{
+    char buffer[32];
+    size_t len = std::min(payload.size(), sizeof(buffer) - 1);
+    memcpy(buffer, payload.data(), len);
+    buffer[len] = '\0';
+    return getFromString<T>(buffer);
+}
+
 template<typename T>
 char const* getTypename();
 
 template<>
 char const* getTypename<float>() { return "float"; }
 
+JsonPath::JsonPath(String const& path)
+    : _path(path)
+{
+    constexpr char delimiter = '/';
+    int start = 0;
+
+    while (start <= static_cast<int>(path.length())) {
+        int end = path.indexOf(delimiter, start);
+        if (end == -1) { end = path.length(); }
+
+        String key = path.substring(start, end);
+
+        // handle double forward slashes and paths starting or ending with a slash
+        if (!key.isEmpty()) {
+            if (key[0] == '[' && key[key.length() - 1] == ']') {
+                _tokens.push_back({ key, static_cast<int32_t>(key.substring(1, key.length() - 1).toInt()), start });
+            } else {
+                _tokens.push_back({ key, -1, start });
+            }
+        }
+
+        start = end + 1;
+    }
+
+    addToFilter(_filter);
+}
+
+void JsonPath::addToFilter(JsonDocument& filter) const
+{
+    // the whole document is kept already
+    if (filter.is<bool>()) { return; }
+
+    JsonVariant node = filter.as<JsonVariant>();
+
+    for (auto const& token : _tokens) {
+        if (node.is<bool>()) { return; } // everything below is kept already
+
+        if (token.Index >= 0) {
+            // an array filter applies its first element to all elements
+            if (node.isNull()) { node.to<JsonArray>(); }
+            if (!node.is<JsonArray>()) { break; }
+
+            JsonArray array = node.as<JsonArray>();
+            node = (array.size() > 0) ? array[0].as<JsonVariant>() : array.add<JsonVariant>();
+            continue;
+        }
+
+        if (node.isNull()) { node.to<JsonObject>(); }
+        if (!node.is<JsonObject>()) { break; }
+
+        JsonObject object = node.as<JsonObject>();
+        if (object[token.Key].isNull()) {
+            node = object[token.Key].to<JsonVariant>();
+        } else {
+            node = object[token.Key].as<JsonVariant>();
+        }
+    }
+
+    // on conflicting paths, keep everything below the common node
+    node.set(true);
+}
+
 template<typename T>
-std::pair<T, String> Utils::getJsonValueByPath(JsonDocument const& root, String const& path)
+std::pair<T, String> JsonPath::getValue(JsonDocument const& root) const
 {
     size_t constexpr kErrBufferSize = 256;
     char errBuffer[kErrBufferSize];
-    constexpr char delimiter = '/';
-    int start = 0;
-    int end = path.indexOf(delimiter);
     auto value = root.as<JsonVariantConst>();
 
     // NOTE: "Because ArduinoJson implements the Null Object Pattern, it is
     // always safe to read the object: if the key doesn't exist, it returns an
     // empty value."
-    auto getNext = [&](String const& key) -> bool {
-        // handle double forward slashes and paths starting or ending with a slash
-        if (key.isEmpty()) { return true; }
-
-        if (key[0] == '[' && key[key.length() - 1] == ']') {
+    for (auto const& token : _tokens) {
+        if (token.Index >= 0) {
             if (!value.is<JsonArrayConst>()) {
                 snprintf(errBuffer, kErrBufferSize, "Cannot access non-array "
                         "JSON node using array index '%s' (JSON path '%s', "
-                        "position %i)", key.c_str(), path.c_str(), start);
-                return false;
+                        "position %i)", token.Key.c_str(), _path.c_str(), token.Position);
+                return { T(), String(errBuffer) };
             }
 
-            auto idx = key.substring(1, key.length() - 1).toInt();
-            value = value[idx];
+            value = value[token.Index];
 
             if (value.isNull()) {
                 snprintf(errBuffer, kErrBufferSize, "Unable to access JSON "
                         "array index %li (JSON path '%s', position %i)",
-                        idx, path.c_str(), start);
-                return false;
+                        static_cast<long>(token.Index), _path.c_str(), token.Position);
+                return { T(), String(errBuffer) };
             }
 
-            return true;
+            continue;
         }
 
-        value = value[key];
+        value = value[token.Key];
 
         if (value.isNull()) {
             snprintf(errBuffer, kErrBufferSize, "Unable to access JSON key "
                     "'%s' (JSON path '%s', position %i)",
-                    key.c_str(), path.c_str(), start);
-            return false;
+                    token.Key.c_str(), _path.c_str(), token.Position);
+            return { T(), String(errBuffer) };
         }
-
-        return true;
-    };
-
-    while (end != -1) {
-        if (!getNext(path.substring(start, end))) {
-              return { T(), String(errBuffer) };
-        }
-        start = end + 1;
-        end = path.indexOf(delimiter, start);
-    }
-
-    if (!getNext(path.substring(start))) {
-        return { T(), String(errBuffer) };
     }
 
     if (value.is<T>()) {
@@ -218,14 +313,14 @@ std::pair<T, String> Utils::getJsonValueByPath(JsonDocument const& root, String
     if (!value.is<char const*>()) {
         snprintf(errBuffer, kErrBufferSize, "Value '%s' at JSON path '%s' is "
                 "neither a string nor of type %s", value.as<String>().c_str(),
-                path.c_str(), getTypename<T>());
+                _path.c_str(), getTypename<T>());
         return { T(), String(errBuffer) };
     }
 
     auto res = getFromString<T>(value.as<char const*>());
     if (!res.has_value()) {
         snprintf(errBuffer, kErrBufferSize, "String '%s' at JSON path '%s' cannot "
-                "be converted to %s", value.as<String>().c_str(), path.c_str(),
+                "be converted to %s", value.as<String>().c_str(), _path.c_str(),
                 getTypename<T>());
         return { T(), String(errBuffer) };
     }
@@ -233,15 +328,20 @@ std::pair<T, String> Utils::getJsonValueByPath(JsonDocument const& root, String
     return { *res, "" };
 }
 
+template std::pair<float, String> JsonPath::getValue(JsonDocument const& root) const;
+
+template<typename T>
+std::pair<T, String> Utils::getJsonValueByPath(JsonDocument const& root, String const& path)
+{
+    return JsonPath(path).getValue<T>(root);
+}
+
 template std::pair<float, String> Utils::getJsonValueByPath(JsonDocument const& root, String const& path);
 
 template <typename T>
 std::optional<T> Utils::getNumericValueFromMqttPayload(char const* client,
-        std::string const& src, char const* topic, char const* jsonPath)
+        std::string_view src, char const* topic, JsonPath const& jsonPath)
 {
-    std::string logValue = src.substr(0, 32);
-    if (src.length() > logValue.length()) { logValue += "..."; }
-
     auto log = [client,topic](char const* format, auto&&... args) -> std::optional<T> {
         MessageOutput.printf("[%s] Topic '%s': ", client, topic);
         MessageOutput.printf(format, args...);
@@ -249,26 +349,32 @@ std::optional<T> Utils::getNumericValueFromMqttPayload(char const* client,
         return std::nullopt;
     };
 
-    if (strlen(jsonPath) == 0) {
-        auto res = getFromString<T>(src.c_str());
+    // the payload is only quoted if it cannot be processed
+    int logLength = std::min<size_t>(src.size(), 32);
+    char const* ellipsis = (src.size() > 32) ? "..." : "";
+
+    if (jsonPath.getPath().isEmpty()) {
+        auto res = getFromPayload<T>(src);
         if (!res.has_value()) {
-            return log("cannot parse payload '%s' as float", logValue.c_str());
+            return log("cannot parse payload '%.*s%s' as float", logLength, src.data(), ellipsis);
         }
         return res;
     }
 
-    JsonDocument json;
+    JsonDocumentPoolClass::Lease lease(JsonDocumentPoolClass::SizeClass::Small);
+    JsonDocument json(&lease);
 
-    const DeserializationError error = deserializeJson(json, src);
+    const DeserializationError error = deserializeJson(json, src.data(), src.size(),
+            DeserializationOption::Filter(jsonPath.getFilter()));
     if (error) {
-        return log("cannot parse payload '%s' as JSON", logValue.c_str());
+        return log("cannot parse payload '%.*s%s' as JSON", logLength, src.data(), ellipsis);
     }
 
     if (json.overflowed()) {
         return log("payload too large to process as JSON");
     }
 
-    auto pathResolutionResult = getJsonValueByPath<T>(json, jsonPath);
+    auto pathResolutionResult = jsonPath.getValue<T>(json);
     if (!pathResolutionResult.second.isEmpty()) {
         return log("%s", pathResolutionResult.second.c_str());
     }
@@ -277,4 +383,4 @@ std::optional<T> Utils::getNumericValueFromMqttPayload(char const* client,
 }
 
 template std::optional<float> Utils::getNumericValueFromMqttPayload(char const* client,
-        std::string const& src, char const* topic, char const* jsonPath);
+        std::string_view src, char const* topic, JsonPath const& jsonPath);
@@ -6,14 +6,23 @@
 #include "W5500.h"
 
 #include <SpiManager.h>
+#include <algorithm>
 #include <driver/spi_master.h>
+#include <esp_timer.h>
 
 // Internal Arduino functions from WiFiGeneric
 void tcpipInit();
 void add_esp_interface_netif(esp_interface_t interface, esp_netif_t* esp_netif);
 
-W5500::W5500(spi_device_handle_t spi, gpio_num_t pin_int)
-    : eth_handle(nullptr)
+W5500* W5500::instance = nullptr;
+
+W5500::W5500(spi_device_handle_t spi, gpio_num_t pin_int, uint32_t spi_clock_hz)
+    : spi(spi)
+    , mac_receive(nullptr)
+    , mac_transmit(nullptr)
+    , last_sample_ms(millis())
+    , spi_clock_hz(spi_clock_hz)
+    , eth_handle(nullptr)
     , eth_netif(nullptr)
 {
     // Arduino function to start networking stack if not already started
@@ -28,6 +37,14 @@ W5500::W5500(spi_device_handle_t spi, gpio_num_t pin_int)
     mac_config.rx_task_stack_size = 4096;
     esp_eth_mac_t* mac = esp_eth_mac_new_w5500(&w5500_config, &mac_config);
 
+    // the driver calls the MAC functions through the struct, such that they
+    // can be wrapped. the W5500 supports a single MAC instance only.
+    instance = this;
+    mac_receive = mac->receive;
+    mac_transmit = mac->transmit;
+    mac->receive = &W5500::receive;
+    mac->transmit = &W5500::transmit;
+
     eth_phy_config_t phy_config = ETH_PHY_DEFAULT_CONFIG();
     phy_config.reset_gpio_num = -1;
     esp_eth_phy_t* phy = esp_eth_phy_new_w5500(&phy_config);
@@ -56,8 +73,10 @@ W5500::~W5500()
     // TODO(LennartF22): support cleanup at some point?
 }
 
-std::unique_ptr<W5500> W5500::setup(int8_t pin_mosi, int8_t pin_miso, int8_t pin_sclk, int8_t pin_cs, int8_t pin_int, int8_t pin_rst)
+std::unique_ptr<W5500> W5500::setup(int8_t pin_mosi, int8_t pin_miso, int8_t pin_sclk, int8_t pin_cs, int8_t pin_int, int8_t pin_rst, uint8_t spi_clock_mhz)
 {
+    uint32_t spi_clock_hz = std::clamp<uint8_t>(spi_clock_mhz, 1, max_spi_clock_mhz) * 1000000;
+
     gpio_reset_pin(static_cast<gpio_num_t>(pin_rst));
     gpio_set_level(static_cast<gpio_num_t>(pin_rst), 0);
     gpio_set_direction(static_cast<gpio_num_t>(pin_rst), GPIO_MODE_OUTPUT);
@@ -78,7 +97,7 @@ std::unique_ptr<W5500> W5500::setup(int8_t pin_mosi, int8_t pin_miso, int8_t pin
         .duty_cycle_pos = 0,
         .cs_ena_pretrans = 0, // only 0 supported
         .cs_ena_posttrans = 0, // only 0 supported
-        .clock_speed_hz = 20000000, // stable with OpenDTU Fusion shield
+        .clock_speed_hz = static_cast<int>(spi_clock_hz),
         .input_delay_ns = 0,
         .spics_io_num = pin_cs,
         .flags = 0,
@@ -87,7 +106,7 @@ std::unique_ptr<W5500> W5500::setup(int8_t pin_mosi, int8_t pin_miso, int8_t pin
         .post_cb = nullptr,
     };
 
-    spi_device_handle_t spi = SpiManagerInst.alloc_device("", bus_config, device_config);
+    spi_device_handle_t spi = SpiManagerInst.alloc_device("", bus_config, device_config, "W5500", SpiPriority::Bulk);
     if (!spi)
         return nullptr;
 
@@ -109,7 +128,87 @@ std::unique_ptr<W5500> W5500::setup(int8_t pin_mosi, int8_t pin_miso, int8_t pin
     // Return to default state once again after connection check and temporary interrupt registration
     gpio_reset_pin(static_cast<gpio_num_t>(pin_int));
 
-    return std::unique_ptr<W5500>(new W5500(spi, static_cast<gpio_num_t>(pin_int)));
+    return std::unique_ptr<W5500>(new W5500(spi, static_cast<gpio_num_t>(pin_int), spi_clock_hz));
+}
+
+esp_err_t W5500::receive(esp_eth_mac_t* mac, uint8_t* buf, uint32_t* length)
+{
+    int64_t start = esp_timer_get_time();
+    SpiManagerInst.acquire(instance->spi);
+    esp_err_t result = instance->mac_receive(mac, buf, length);
+    SpiManagerInst.release(instance->spi);
+    // the driver polls until no frame is left, which is not an actual frame
+    if (result == ESP_OK && *length == 0)
+        return result;
+    instance->rx.account(result, *length, esp_timer_get_time() - start);
+    return result;
+}
+
+esp_err_t W5500::transmit(esp_eth_mac_t* mac, uint8_t* buf, uint32_t length)
+{
+    int64_t start = esp_timer_get_time();
+    SpiManagerInst.acquire(instance->spi);
+    esp_err_t result = instance->mac_transmit(mac, buf, length);
+    SpiManagerInst.release(instance->spi);
+    instance->tx.account(result, length, esp_timer_get_time() - start);
+    return result;
+}
+
+void W5500::Counter::account(esp_err_t result, uint32_t length, uint32_t duration_us)
+{
+    if (result != ESP_OK) {
+        errors++;
+        return;
+    }
+
+    frames++;
+    bytes += length;
+    busy_us += duration_us;
+
+    uint32_t max = max_us.load();
+    while (duration_us > max && !max_us.compare_exchange_weak(max, duration_us)) { }
+}
+
+void W5500::Sample::update(Counter& counter, uint32_t elapsed_ms)
+{
+    uint32_t now_frames = counter.frames;
+    uint32_t now_bytes = counter.bytes;
+    uint32_t now_busy_us = counter.busy_us;
+
+    uint32_t delta_frames = now_frames - frames;
+    rate = static_cast<uint64_t>(now_bytes - bytes) * 1000 / elapsed_ms;
+    latency_avg_us = (delta_frames > 0) ? (now_busy_us - busy_us) / delta_frames : 0;
+    latency_max_us = counter.max_us.exchange(0);
+
+    frames = now_frames;
+    bytes = now_bytes;
+    busy_us = now_busy_us;
+}
+
+W5500::Stats W5500::getStats()
+{
+    uint32_t elapsed_ms = millis() - last_sample_ms;
+    if (elapsed_ms >= sample_period_ms) {
+        rx_sample.update(rx, elapsed_ms);
+        tx_sample.update(tx, elapsed_ms);
+        last_sample_ms += elapsed_ms;
+    }
+
+    return {
+        .spi_clock_hz = spi_clock_hz,
+        .rx_frames = rx.frames,
+        .rx_bytes = rx.bytes,
+        .tx_frames = tx.frames,
+        .tx_bytes = tx.bytes,
+        .rx_errors = rx.errors,
+        .tx_errors = tx.errors,
+        .rx_rate = rx_sample.rate,
+        .tx_rate = tx_sample.rate,
+        .rx_latency_avg_us = rx_sample.latency_avg_us,
+        .rx_latency_max_us = rx_sample.latency_max_us,
+        .tx_latency_avg_us = tx_sample.latency_avg_us,
+        .tx_latency_max_us = tx_sample.latency_max_us,
+    };
 }
 
 String W5500::macAddress()
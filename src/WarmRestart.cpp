@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "WarmRestart.h"
+#include "Configuration.h"
+#include "MessageOutput.h"
+#include <battery/Controller.h>
+#include <Hoymiles.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <esp_attr.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <sys/time.h>
+
+WarmRestartClass WarmRestart;
+
+namespace {
+
+constexpr uint32_t RETAINED_MAGIC = 0x57524D31; // "WRM1"
+
+struct RetainedInverter {
+    uint64_t Serial;
+    uint8_t DevInfoAll[DEV_INFO_SIZE];
+    uint8_t DevInfoAllLength;
+    uint8_t DevInfoSimple[DEV_INFO_SIZE];
+    uint8_t DevInfoSimpleLength;
+    float LimitPercent;
+};
+
+struct RetainedState {
+    uint32_t Magic;
+    uint32_t Size;
+
+    // microseconds since the epoch, zero if the time was not known
+    int64_t EpochMicros;
+
+    uint8_t InverterCount;
+    RetainedInverter Inverters[INV_MAX_COUNT];
+
+    bool BatterySoCValid;
+    float BatterySoC;
+    uint8_t BatterySoCPrecision;
+    uint32_t BatterySoCAgeMillis;
+
+    uint32_t Checksum;
+};
+
+// survives software restarts, but is garbage after powering up
+RTC_NOINIT_ATTR RetainedState sRetained;
+
+uint32_t checksum(RetainedState const& state)
+{
+    auto data = reinterpret_cast<uint8_t const*>(&state);
+    uint32_t hash = 2166136261UL;
+    for (size_t i = 0; i < offsetof(RetainedState, Checksum); ++i) {
+        hash = (hash ^ data[i]) * 16777619UL;
+    }
+    return hash;
+}
+
+} // namespace
+
+void WarmRestartClass::init()
+{
+    // state saved before a crash or a watchdog reset is not trusted
+    _valid = esp_reset_reason() == ESP_RST_SW
+        && sRetained.Magic == RETAINED_MAGIC
+        && sRetained.Size == sizeof(RetainedState)
+        && sRetained.Checksum == checksum(sRetained);
+
+    // the state is used only once
+    sRetained.Magic = 0;
+
+    if (!_valid) { return; }
+
+    MessageOutput.println("[WarmRestart] Resuming with state saved before restart");
+
+    if (sRetained.EpochMicros == 0) { return; }
+
+    // the time spent in the bootloader is not accounted for, which is a
+    // fraction of a second. NTP corrects this shortly.
+    int64_t now = sRetained.EpochMicros + esp_timer_get_time();
+    struct timeval tv = {
+        .tv_sec = static_cast<time_t>(now / 1000000),
+        .tv_usec = static_cast<suseconds_t>(now % 1000000)
+    };
+    settimeofday(&tv, nullptr);
+}
+
+void WarmRestartClass::save()
+{
+    memset(&sRetained, 0, sizeof(sRetained));
+    sRetained.Magic = RETAINED_MAGIC;
+    sRetained.Size = sizeof(RetainedState);
+
+    struct tm timeinfo;
+    if (getLocalTime(&timeinfo, 5)) {
+        struct timeval tv;
+        gettimeofday(&tv, nullptr);
+        sRetained.EpochMicros = static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+    }
+
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters() && sRetained.InverterCount < INV_MAX_COUNT; i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) { continue; }
+
+        // only complete device info is of any use
+        auto devInfo = inv->DevInfo();
+        if (!devInfo->containsValidData()) { continue; }
+
+        auto& retained = sRetained.Inverters[sRetained.InverterCount++];
+        retained.Serial = inv->serial();
+        retained.DevInfoAllLength = devInfo->getPayloadAll(retained.DevInfoAll);
+        retained.DevInfoSimpleLength = devInfo->getPayloadSimple(retained.DevInfoSimple);
+        retained.LimitPercent = inv->SystemConfigPara()->getLimitPercent();
+    }
+
+    auto spStats = Battery.getStats();
+    if (Configuration.get().Battery.Enabled && spStats->isSoCValid()) {
+        sRetained.BatterySoCValid = true;
+        sRetained.BatterySoC = spStats->getSoC();
+        sRetained.BatterySoCPrecision = spStats->getSoCPrecision();
+        sRetained.BatterySoCAgeMillis = spStats->getSoCAgeSeconds() * 1000;
+    }
+
+    sRetained.Checksum = checksum(sRetained);
+}
+
+void WarmRestartClass::restoreInverters()
+{
+    if (!_valid) { return; }
+
+    for (uint8_t i = 0; i < sRetained.InverterCount && i < INV_MAX_COUNT; i++) {
+        auto const& retained = sRetained.Inverters[i];
+
+        auto inv = Hoymiles.getInverterBySerial(retained.Serial);
+        if (inv == nullptr) { continue; }
+
+        // the library does not request device info which is known already.
+        // the limit is requested again after the usual interval.
+        auto devInfo = inv->DevInfo();
+        devInfo->beginAppendFragment();
+        devInfo->clearBufferAll();
+        devInfo->appendFragmentAll(0, retained.DevInfoAll, std::min<uint8_t>(retained.DevInfoAllLength, DEV_INFO_SIZE));
+        devInfo->clearBufferSimple();
+        devInfo->appendFragmentSimple(0, retained.DevInfoSimple, std::min<uint8_t>(retained.DevInfoSimpleLength, DEV_INFO_SIZE));
+        devInfo->endAppendFragment();
+        devInfo->setLastUpdateAll(millis());
+        devInfo->setLastUpdateSimple(millis());
+
+        inv->SystemConfigPara()->setLimitPercent(retained.LimitPercent);
+
+        MessageOutput.printf("[WarmRestart] Restored inverter %s: %s, limit %.1f %%\r\n",
+            inv->serialString().c_str(), devInfo->getHwModelName().c_str(),
+            retained.LimitPercent);
+    }
+}
+
+void WarmRestartClass::restoreBattery()
+{
+    if (!_valid || !sRetained.BatterySoCValid) { return; }
+
+    Battery.restoreSoC(sRetained.BatterySoC, sRetained.BatterySoCPrecision,
+            sRetained.BatterySoCAgeMillis);
+}
@@ -5,16 +5,26 @@
 #include "WebApi.h"
 #include "Configuration.h"
 #include "MessageOutput.h"
+#include "NightMode.h"
 #include "defaults.h"
 #include <AsyncJson.h>
 
 WebApiClass::WebApiClass()
     : _server(HTTP_PORT)
+    , _webApiWsLive(_webApiWsMux, _webApiSse)
+    , _webApiWsSolarChargerLive(_webApiWsMux, _webApiSse)
+    , _webApiWsHuaweiLive(_webApiWsMux, _webApiSse)
+    , _webApiWsBatteryLive(_webApiWsMux, _webApiSse)
+    , _webApiSnapshot(_webApiWsLive, _webApiWsBatteryLive, _webApiWsSolarChargerLive, _webApiWsHuaweiLive, _webApiSysstatus)
 {
 }
 
 void WebApiClass::init(Scheduler& scheduler)
 {
+    // added first, such that the API requests are dispatched before the
+    // websockets and the catch-all handler are asked
+    _server.addHandler(&_router);
+
     _webApiDevice.init(_server, scheduler);
     _webApiDevInfo.init(_server, scheduler);
     _webApiDtu.init(_server, scheduler);
@@ -22,6 +32,7 @@ void WebApiClass::init(Scheduler& scheduler)
     _webApiFile.init(_server, scheduler);
     _webApiFirmware.init(_server, scheduler);
     _webApiGridprofile.init(_server, scheduler);
+    _webApiHistory.init(_server, scheduler);
     _webApiI18n.init(_server, scheduler);
     _webApiInverter.init(_server, scheduler);
     _webApiLimit.init(_server, scheduler);
@@ -34,6 +45,8 @@ void WebApiClass::init(Scheduler& scheduler)
     _webApiSecurity.init(_server, scheduler);
     _webApiSysstatus.init(_server, scheduler);
     _webApiWebapp.init(_server, scheduler);
+    _webApiWsMux.init(_server, scheduler);
+    _webApiSse.init(_server, scheduler);
     _webApiWsConsole.init(_server, scheduler);
     _webApiWsLive.init(_server, scheduler);
     _webApiBattery.init(_server, scheduler);
@@ -44,12 +57,15 @@ void WebApiClass::init(Scheduler& scheduler)
     _webApiWsHuaweiLive.init(_server, scheduler);
     _webApiHuaweiClass.init(_server, scheduler);
     _webApiWsBatteryLive.init(_server, scheduler);
+    _webApiSnapshot.init(_server, scheduler);
 
     _server.begin();
 }
 
 void WebApiClass::reload()
 {
+    _webApiWsMux.reload();
+    _webApiSse.reload();
     _webApiWsConsole.reload();
     _webApiWsLive.reload();
     _webApiWsBatteryLive.reload();
@@ -57,13 +73,110 @@ void WebApiClass::reload()
     _webApiWsHuaweiLive.reload();
 }
 
+std::mutex WebApiClass::sAuthMutex;
+std::array<WebApiClass::VerifiedCredentials, WebApiClass::VerifiedCredentialsCount> WebApiClass::sVerified;
+std::array<WebApiClass::AuthFailures, WebApiClass::AuthFailuresCount> WebApiClass::sFailures;
+
+// must be called while holding sAuthMutex
+bool WebApiClass::isVerified(String const& authorization)
+{
+    auto generation = Configuration.getGeneration();
+    for (auto const& verified : sVerified) {
+        if (verified.Generation == generation
+                && millis() - verified.VerifiedAt < VerifiedCredentialsMillis
+                && verified.Authorization.equals(authorization)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// must be called while holding sAuthMutex
+void WebApiClass::addVerified(String const& authorization)
+{
+    // replaces the entry which was verified first
+    auto oldest = &sVerified[0];
+    for (auto& verified : sVerified) {
+        if (verified.Authorization.isEmpty()) { oldest = &verified; break; }
+        if (verified.VerifiedAt - oldest->VerifiedAt > UINT32_MAX / 2) { oldest = &verified; }
+    }
+
+    oldest->Authorization = authorization;
+    oldest->Generation = Configuration.getGeneration();
+    oldest->VerifiedAt = millis();
+}
+
+// must be called while holding sAuthMutex
+bool WebApiClass::isRateLimited(uint32_t address)
+{
+    for (auto const& failures : sFailures) {
+        if (failures.Address == address
+                && millis() - failures.WindowStart < AuthFailuresWindowMillis
+                && failures.Count >= AuthFailuresMax) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// must be called while holding sAuthMutex
+void WebApiClass::addFailure(uint32_t address)
+{
+    AuthFailures* slot = nullptr;
+    for (auto& failures : sFailures) {
+        if (failures.Address == address) { slot = &failures; break; }
+
+        // reuses the entry whose window started first
+        if (slot == nullptr || failures.WindowStart - slot->WindowStart > UINT32_MAX / 2) {
+            slot = &failures;
+        }
+    }
+
+    if (slot->Address != address || millis() - slot->WindowStart >= AuthFailuresWindowMillis) {
+        slot->Address = address;
+        slot->WindowStart = millis();
+        slot->Count = 0;
+    }
+
+    if (slot->Count < UINT8_MAX) { ++slot->Count; }
+}
+
 bool WebApiClass::checkCredentials(AsyncWebServerRequest* request)
 {
+    NightMode.notifyActivity();
+
+    uint32_t address = static_cast<uint32_t>(request->client()->remoteIP());
+    String authorization;
+    if (request->hasHeader("Authorization")) {
+        authorization = request->getHeader("Authorization")->value();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sAuthMutex);
+
+        if (!authorization.isEmpty() && isVerified(authorization)) {
+            return true;
+        }
+
+        if (isRateLimited(address)) {
+            sendTooManyRequests(request);
+            return false;
+        }
+    }
+
     auto const& config = Configuration.get();
     if (request->authenticate(AUTH_USERNAME, config.Security.Password)) {
+        std::lock_guard<std::mutex> lock(sAuthMutex);
+        addVerified(authorization);
         return true;
     }
 
+    // requests without credentials are part of the regular login flow
+    if (!authorization.isEmpty()) {
+        std::lock_guard<std::mutex> lock(sAuthMutex);
+        addFailure(address);
+    }
+
     AsyncWebServerResponse* r = request->beginResponse(401);
 
     // WebAPI should set the X-Requested-With to prevent browser internal auth dialogs
@@ -92,16 +205,15 @@ void WebApiClass::sendTooManyRequests(AsyncWebServerRequest* request)
     request->send(response);
 }
 
-void WebApiClass::writeConfig(JsonVariant& retMsg, const WebApiError code, const String& message)
+void WebApiClass::writeConfig(JsonVariant& retMsg, ConfigurationClass::Section section, const WebApiError code, const String& message)
 {
-    if (!Configuration.write()) {
-        retMsg["message"] = "Write failed!";
-        retMsg["code"] = WebApiError::GenericWriteFailed;
-    } else {
-        retMsg["type"] = "success";
-        retMsg["message"] = message;
-        retMsg["code"] = code;
-    }
+    // the write to flash is deferred, such that the async web task is not
+    // blocked and a burst of changes results in a single write.
+    Configuration.scheduleWrite(section);
+
+    retMsg["type"] = "success";
+    retMsg["message"] = message;
+    retMsg["code"] = code;
 }
 
 bool WebApiClass::parseRequestData(AsyncWebServerRequest* request, AsyncJsonResponse* response, JsonDocument& json_document)
@@ -138,7 +250,8 @@ uint64_t WebApiClass::parseSerialFromRequest(AsyncWebServerRequest* request, Str
     return 0;
 }
 
-bool WebApiClass::sendJsonResponse(AsyncWebServerRequest* request, AsyncJsonResponse* response, const char* function, const uint16_t line)
+template<typename T>
+static bool sendJson(AsyncWebServerRequest* request, T* response, const char* function, const uint16_t line)
 {
     bool ret_val = true;
     if (response->overflowed()) {
@@ -158,4 +271,60 @@ bool WebApiClass::sendJsonResponse(AsyncWebServerRequest* request, AsyncJsonResp
     return ret_val;
 }
 
+bool WebApiClass::sendJsonResponse(AsyncWebServerRequest* request, AsyncJsonResponse* response, const char* function, const uint16_t line)
+{
+    return sendJson(request, response, function, line);
+}
+
+bool WebApiClass::sendJsonResponse(AsyncWebServerRequest* request, PooledJsonResponse* response, const char* function, const uint16_t line)
+{
+    return sendJson(request, response, function, line);
+}
+
+bool WebApiClass::sendNotModified(AsyncWebServerRequest* request, String const& etag)
+{
+    if (!request->hasHeader("If-None-Match")) { return false; }
+    if (!request->getHeader("If-None-Match")->value().equals(etag)) { return false; }
+
+    AsyncWebServerResponse* response = request->beginResponse(304);
+    addETag(response, etag);
+    request->send(response);
+    return true;
+}
+
+void WebApiClass::addETag(AsyncWebServerResponse* response, String const& etag)
+{
+    // HTTP requires cache headers in 200 and 304 to be identical
+    response->addHeader("Cache-Control", "no-cache");
+    response->addHeader("ETag", etag);
+}
+
+JsonETag::JsonETag()
+    : _hash(2166136261UL)
+{
+    add(Configuration.getGeneration());
+}
+
+JsonETag& JsonETag::add(uint32_t version)
+{
+    // FNV-1a over the bytes of the version
+    for (int i = 0; i < 4; ++i) {
+        _hash = (_hash ^ ((version >> (i * 8)) & 0xFF)) * 16777619UL;
+    }
+    return *this;
+}
+
+JsonETag& JsonETag::add(uint64_t version)
+{
+    add(static_cast<uint32_t>(version & 0xFFFFFFFF));
+    return add(static_cast<uint32_t>(version >> 32));
+}
+
+String JsonETag::toString(bool weak) const
+{
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%s\"%08" PRIx32 "\"", (weak ? "W/" : ""), _hash);
+    return buffer;
+}
+
 WebApiClass WebApi;
@@ -4,7 +4,9 @@
  */
 #include "WebApi_Huawei.h"
 #include <gridcharger/huawei/Controller.h>
+#include "ConfigFields.h"
 #include "Configuration.h"
+#include "Features.h"
 #include "MessageOutput.h"
 #include "PinMapping.h"
 #include "WebApi.h"
@@ -18,10 +20,11 @@ void WebApiHuaweiClass::init(AsyncWebServer& server, Scheduler& scheduler)
 
     _server = &server;
 
-    _server->on("/api/huawei/status", HTTP_GET, std::bind(&WebApiHuaweiClass::onStatus, this, _1));
-    _server->on("/api/huawei/config", HTTP_GET, std::bind(&WebApiHuaweiClass::onAdminGet, this, _1));
-    _server->on("/api/huawei/config", HTTP_POST, std::bind(&WebApiHuaweiClass::onAdminPost, this, _1));
-    _server->on("/api/huawei/limit/config", HTTP_POST, std::bind(&WebApiHuaweiClass::onPost, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/huawei/status", HTTP_GET, std::bind(&WebApiHuaweiClass::onStatus, this, _1));
+    router.on("/api/huawei/config", HTTP_GET, std::bind(&WebApiHuaweiClass::onAdminGet, this, _1));
+    router.on("/api/huawei/config", HTTP_POST, std::bind(&WebApiHuaweiClass::onAdminPost, this, _1));
+    router.on("/api/huawei/limit/config", HTTP_POST, std::bind(&WebApiHuaweiClass::onPost, this, _1));
 }
 
 void WebApiHuaweiClass::onStatus(AsyncWebServerRequest* request)
@@ -115,7 +118,7 @@ void WebApiHuaweiClass::onPost(AsyncWebServerRequest* request)
         }
     }
 
-    WebApi.writeConfig(retMsg);
+    WebApi.writeConfig(retMsg, ConfigurationClass::Section::GridCharger);
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
@@ -132,6 +135,11 @@ void WebApiHuaweiClass::onAdminGet(AsyncWebServerRequest* request)
 
     ConfigurationClass::serializeGridChargerConfig(config.Huawei, root);
 
+    auto availableInterfaces = root["available_hardware_interfaces"].to<JsonArray>();
+    for (uint8_t hwIfc = 0; hwIfc < Features::GridChargerInterfaceCount; ++hwIfc) {
+        if (Features::isGridChargerInterfaceAvailable(hwIfc)) { availableInterfaces.add(hwIfc); }
+    }
+
     response->setLength();
     request->send(response);
 }
@@ -164,13 +172,30 @@ void WebApiHuaweiClass::onAdminPost(AsyncWebServerRequest* request)
         return;
     }
 
+    if (auto key = ConfigFields::validate(ConfigFields::GridCharger, root.as<JsonObject>())) {
+        retMsg["message"] = String("Value of ") + key + " is out of range!";
+        retMsg["code"] = WebApiError::GenericValueOutOfRange;
+        response->setLength();
+        request->send(response);
+        return;
+    }
+
+    if (root["hardware_interface"].is<uint8_t>()
+            && !Features::isGridChargerInterfaceAvailable(root["hardware_interface"].as<uint8_t>())) {
+        retMsg["message"] = "Hardware interface is not available in this build!";
+        retMsg["code"] = WebApiError::GenericNotAvailable;
+        response->setLength();
+        request->send(response);
+        return;
+    }
+
     {
         auto guard = Configuration.getWriteGuard();
         auto& config = guard.getConfig();
         ConfigurationClass::deserializeGridChargerConfig(root.as<JsonObject>(), config.Huawei);
     }
 
-    WebApi.writeConfig(retMsg);
+    WebApi.writeConfig(retMsg, ConfigurationClass::Section::GridCharger);
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
@@ -6,7 +6,9 @@
 #include "ArduinoJson.h"
 #include "AsyncJson.h"
 #include <battery/Controller.h>
+#include "ConfigFields.h"
 #include "Configuration.h"
+#include "Features.h"
 #include "MqttHandlePowerLimiterHass.h"
 #include "WebApi.h"
 #include "WebApi_battery.h"
@@ -19,9 +21,10 @@ void WebApiBatteryClass::init(AsyncWebServer& server, Scheduler& scheduler)
 
     _server = &server;
 
-    _server->on("/api/battery/status", HTTP_GET, std::bind(&WebApiBatteryClass::onStatus, this, _1));
-    _server->on("/api/battery/config", HTTP_GET, std::bind(&WebApiBatteryClass::onAdminGet, this, _1));
-    _server->on("/api/battery/config", HTTP_POST, std::bind(&WebApiBatteryClass::onAdminPost, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/battery/status", HTTP_GET, std::bind(&WebApiBatteryClass::onStatus, this, _1));
+    router.on("/api/battery/config", HTTP_GET, std::bind(&WebApiBatteryClass::onAdminGet, this, _1));
+    router.on("/api/battery/config", HTTP_POST, std::bind(&WebApiBatteryClass::onAdminPost, this, _1));
 }
 
 void WebApiBatteryClass::onStatus(AsyncWebServerRequest* request)
@@ -36,6 +39,11 @@ void WebApiBatteryClass::onStatus(AsyncWebServerRequest* request)
 
     ConfigurationClass::serializeBatteryConfig(config.Battery, root);
 
+    auto availableProviders = root["available_providers"].to<JsonArray>();
+    for (uint8_t provider = 0; provider < Features::BatteryProviderCount; ++provider) {
+        if (Features::isBatteryProviderAvailable(provider)) { availableProviders.add(provider); }
+    }
+
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
 
@@ -69,13 +77,27 @@ void WebApiBatteryClass::onAdminPost(AsyncWebServerRequest* request)
         return;
     }
 
+    if (auto key = ConfigFields::validate(ConfigFields::Battery, root.as<JsonObject>())) {
+        retMsg["message"] = String("Value of ") + key + " is out of range!";
+        retMsg["code"] = WebApiError::GenericValueOutOfRange;
+        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        return;
+    }
+
+    if (!Features::isBatteryProviderAvailable(root["provider"].as<uint8_t>())) {
+        retMsg["message"] = "Provider is not available in this build!";
+        retMsg["code"] = WebApiError::GenericNotAvailable;
+        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        return;
+    }
+
     {
         auto guard = Configuration.getWriteGuard();
         auto& config = guard.getConfig();
         ConfigurationClass::deserializeBatteryConfig(root.as<JsonObject>(), config.Battery);
     }
 
-    WebApi.writeConfig(retMsg);
+    WebApi.writeConfig(retMsg, ConfigurationClass::Section::Battery);
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
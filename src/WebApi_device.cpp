@@ -16,8 +16,9 @@ void WebApiDeviceClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     using std::placeholders::_1;
 
-    server.on("/api/device/config", HTTP_GET, std::bind(&WebApiDeviceClass::onDeviceAdminGet, this, _1));
-    server.on("/api/device/config", HTTP_POST, std::bind(&WebApiDeviceClass::onDeviceAdminPost, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/device/config", HTTP_GET, std::bind(&WebApiDeviceClass::onDeviceAdminGet, this, _1));
+    router.on("/api/device/config", HTTP_POST, std::bind(&WebApiDeviceClass::onDeviceAdminPost, this, _1));
 }
 
 void WebApiDeviceClass::onDeviceAdminGet(AsyncWebServerRequest* request)
@@ -103,6 +104,8 @@ void WebApiDeviceClass::onDeviceAdminGet(AsyncWebServerRequest* request)
     victronPinObj["tx2"] = pin.victron_tx2;
     victronPinObj["rx3"] = pin.victron_rx3;
     victronPinObj["tx3"] = pin.victron_tx3;
+    victronPinObj["rx4"] = pin.victron_rx4;
+    victronPinObj["tx4"] = pin.victron_tx4;
 
     auto batteryPinObj = curPin["battery"].to<JsonObject>();
     batteryPinObj["rx"] = pin.battery_rx;
@@ -110,6 +113,12 @@ void WebApiDeviceClass::onDeviceAdminGet(AsyncWebServerRequest* request)
     batteryPinObj["tx"] = pin.battery_tx;
     batteryPinObj["txen"] = pin.battery_txen;
 
+    auto battery2PinObj = curPin["battery2"].to<JsonObject>();
+    battery2PinObj["rx"] = pin.battery2_rx;
+    battery2PinObj["rxen"] = pin.battery2_rxen;
+    battery2PinObj["tx"] = pin.battery2_tx;
+    battery2PinObj["txen"] = pin.battery2_txen;
+
     auto huaweiPinObj = curPin["huawei"].to<JsonObject>();
     huaweiPinObj["miso"] = pin.huawei_miso;
     huaweiPinObj["mosi"] = pin.huawei_mosi;
@@ -193,7 +202,7 @@ void WebApiDeviceClass::onDeviceAdminPost(AsyncWebServerRequest* request)
     Display.setLocale(config.Display.Locale);
     Display.Diagram().updatePeriod();
 
-    WebApi.writeConfig(retMsg);
+    WebApi.writeConfig(retMsg, ConfigurationClass::Section::Device);
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
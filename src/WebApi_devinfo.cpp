@@ -12,7 +12,8 @@ void WebApiDevInfoClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     using std::placeholders::_1;
 
-    server.on("/api/devinfo/status", HTTP_GET, std::bind(&WebApiDevInfoClass::onDevInfoStatus, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/devinfo/status", HTTP_GET, std::bind(&WebApiDevInfoClass::onDevInfoStatus, this, _1));
 }
 
 void WebApiDevInfoClass::onDevInfoStatus(AsyncWebServerRequest* request)
@@ -21,7 +22,7 @@ void WebApiDevInfoClass::onDevInfoStatus(AsyncWebServerRequest* request)
         return;
     }
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto response = new PooledJsonResponse(JsonDocumentPoolClass::SizeClass::Small);
     auto& root = response->getRoot();
     auto serial = WebApi.parseSerialFromRequest(request);
     auto inv = Hoymiles.getInverterBySerial(serial);
@@ -36,6 +37,31 @@ void WebApiDevInfoClass::onDevInfoStatus(AsyncWebServerRequest* request)
         root["max_power"] = inv->DevInfo()->getMaxPower();
         root["fw_build_datetime"] = inv->DevInfo()->getFwBuildDateTimeStr();
         root["pdl_supported"] = inv->supportsPowerDistributionLogic();
+
+        // RF transaction latencies in ms. the buckets are not cumulative,
+        // the last one counts the durations beyond the last bound.
+        auto latency = root["rf_latency"].to<JsonObject>();
+        auto bounds = latency["bounds"].to<JsonArray>();
+        for (auto bound : LatencyHistogram::Bounds) {
+            bounds.add(bound);
+        }
+
+        auto commands = latency["commands"].to<JsonArray>();
+        for (auto const& entry : inv->Transactions.get()) {
+            auto command = commands.add<JsonObject>();
+            command["command"] = entry.Command;
+
+            for (size_t phase = 0; phase < HOY_TRANSACTION_PHASE_COUNT; phase++) {
+                auto const& histogram = entry.Phases[phase];
+                auto obj = command[getTransactionPhaseName(static_cast<TransactionPhase>(phase))].to<JsonObject>();
+                obj["count"] = histogram.Count;
+                obj["sum"] = histogram.Sum;
+                auto buckets = obj["buckets"].to<JsonArray>();
+                for (auto count : histogram.Buckets) {
+                    buckets.add(count);
+                }
+            }
+        }
     }
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
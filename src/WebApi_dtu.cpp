@@ -8,9 +8,10 @@
 #include "WebApi_errors.h"
 #include <AsyncJson.h>
 #include <Hoymiles.h>
+#include "TaskProfiler.h"
 
 WebApiDtuClass::WebApiDtuClass()
-    : _applyDataTask(TASK_IMMEDIATE, TASK_ONCE, std::bind(&WebApiDtuClass::applyDataTaskCb, this))
+    : _applyDataTask(TASK_IMMEDIATE, TASK_ONCE, TaskProfiler.wrap("WebApiDtu::applyDataTaskCb", std::bind(&WebApiDtuClass::applyDataTaskCb, this)))
 {
 }
 
@@ -18,23 +19,53 @@ void WebApiDtuClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     using std::placeholders::_1;
 
-    server.on("/api/dtu/config", HTTP_GET, std::bind(&WebApiDtuClass::onDtuAdminGet, this, _1));
-    server.on("/api/dtu/config", HTTP_POST, std::bind(&WebApiDtuClass::onDtuAdminPost, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/dtu/config", HTTP_GET, std::bind(&WebApiDtuClass::onDtuAdminGet, this, _1));
+    router.on("/api/dtu/config", HTTP_POST, std::bind(&WebApiDtuClass::onDtuAdminPost, this, _1));
 
     scheduler.addTask(_applyDataTask);
+
+    _applied = Configuration.get().Dtu;
 }
 
 void WebApiDtuClass::applyDataTaskCb()
 {
     // Execute stuff in main thread to avoid busy SPI bus
-    auto const& config = Configuration.get();
-    Hoymiles.getRadioNrf()->setPALevel((rf24_pa_dbm_e)config.Dtu.Nrf.PaLevel);
-    Hoymiles.getRadioCmt()->setPALevel(config.Dtu.Cmt.PaLevel);
-    Hoymiles.getRadioNrf()->setDtuSerial(config.Dtu.Serial);
-    Hoymiles.getRadioCmt()->setDtuSerial(config.Dtu.Serial);
-    Hoymiles.getRadioCmt()->setCountryMode(static_cast<CountryModeId_t>(config.Dtu.Cmt.CountryMode));
-    Hoymiles.getRadioCmt()->setInverterTargetFrequency(config.Dtu.Cmt.Frequency);
-    Hoymiles.setPollInterval(config.Dtu.PollInterval);
+    auto const dtu = Configuration.get().Dtu;
+
+    if (dtu.Nrf.PaLevel != _applied.Nrf.PaLevel) {
+        Hoymiles.getRadioNrf()->setPALevel((rf24_pa_dbm_e)dtu.Nrf.PaLevel);
+    }
+
+    if (dtu.Cmt.PaLevel != _applied.Cmt.PaLevel) {
+        Hoymiles.getRadioCmt()->setPALevel(dtu.Cmt.PaLevel);
+    }
+
+    if (dtu.Serial != _applied.Serial) {
+        Hoymiles.getRadioNrf()->setDtuSerial(dtu.Serial);
+        Hoymiles.getRadioCmt()->setDtuSerial(dtu.Serial);
+    }
+
+    // the frequency is switched again after the band changed, as the
+    // band determines the valid frequencies
+    bool bandChanged = dtu.Cmt.CountryMode != _applied.Cmt.CountryMode;
+    if (bandChanged) {
+        Hoymiles.getRadioCmt()->setCountryMode(static_cast<CountryModeId_t>(dtu.Cmt.CountryMode));
+    }
+
+    if (bandChanged || dtu.Cmt.Frequency != _applied.Cmt.Frequency) {
+        Hoymiles.getRadioCmt()->setInverterTargetFrequency(dtu.Cmt.Frequency);
+    }
+
+    if (dtu.PollInterval != _applied.PollInterval) {
+        Hoymiles.setPollInterval(dtu.PollInterval);
+    }
+
+    if (dtu.VerboseLogging != _applied.VerboseLogging) {
+        Hoymiles.setVerboseLogging(dtu.VerboseLogging);
+    }
+
+    _applied = dtu;
 }
 
 void WebApiDtuClass::onDtuAdminGet(AsyncWebServerRequest* request)
@@ -55,6 +86,7 @@ void WebApiDtuClass::onDtuAdminGet(AsyncWebServerRequest* request)
     root["serial"] = buffer;
     root["pollinterval"] = config.Dtu.PollInterval;
     root["verbose_logging"] = config.Dtu.VerboseLogging;
+    root["low_power_night"] = config.Dtu.LowPowerNight;
     root["nrf_enabled"] = Hoymiles.getRadioNrf()->isInitialized();
     root["nrf_palevel"] = config.Dtu.Nrf.PaLevel;
     root["cmt_enabled"] = Hoymiles.getRadioCmt()->isInitialized();
@@ -161,13 +193,14 @@ void WebApiDtuClass::onDtuAdminPost(AsyncWebServerRequest* request)
         config.Dtu.Serial = serial;
         config.Dtu.PollInterval = root["pollinterval"].as<uint32_t>();
         config.Dtu.VerboseLogging = root["verbose_logging"].as<bool>();
+        config.Dtu.LowPowerNight = root["low_power_night"] | false;
         config.Dtu.Nrf.PaLevel = root["nrf_palevel"].as<uint8_t>();
         config.Dtu.Cmt.PaLevel = root["cmt_palevel"].as<int8_t>();
         config.Dtu.Cmt.Frequency = root["cmt_frequency"].as<uint32_t>();
         config.Dtu.Cmt.CountryMode = root["cmt_country"].as<CountryModeId_t>();
     }
 
-    WebApi.writeConfig(retMsg);
+    WebApi.writeConfig(retMsg, ConfigurationClass::Section::Dtu);
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
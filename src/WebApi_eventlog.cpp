@@ -3,15 +3,38 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_eventlog.h"
+#include "EventStore.h"
+#include "MessageOutput.h"
 #include "WebApi.h"
 #include <AsyncJson.h>
 #include <Hoymiles.h>
+#include <cinttypes>
+#include <memory>
+#include <vector>
+
+static AlarmMessageLocale_t parseLocale(AsyncWebServerRequest* request)
+{
+    AlarmMessageLocale_t locale = AlarmMessageLocale_t::EN;
+    if (request->hasParam("locale")) {
+        String s = request->getParam("locale")->value();
+        s.toLowerCase();
+        if (s == "de") {
+            locale = AlarmMessageLocale_t::DE;
+        }
+        if (s == "fr") {
+            locale = AlarmMessageLocale_t::FR;
+        }
+    }
+    return locale;
+}
 
 void WebApiEventlogClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     using std::placeholders::_1;
 
-    server.on("/api/eventlog/status", HTTP_GET, std::bind(&WebApiEventlogClass::onEventlogStatus, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/eventlog/status", HTTP_GET, std::bind(&WebApiEventlogClass::onEventlogStatus, this, _1));
+    router.on("/api/eventlog/history", HTTP_GET, std::bind(&WebApiEventlogClass::onEventlogHistory, this, _1));
 }
 
 void WebApiEventlogClass::onEventlogStatus(AsyncWebServerRequest* request)
@@ -20,33 +43,32 @@ void WebApiEventlogClass::onEventlogStatus(AsyncWebServerRequest* request)
         return;
     }
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
-    auto& root = response->getRoot();
     auto serial = WebApi.parseSerialFromRequest(request);
 
-    AlarmMessageLocale_t locale = AlarmMessageLocale_t::EN;
-    if (request->hasParam("locale")) {
-        String s = request->getParam("locale")->value();
-        s.toLowerCase();
-        if (s == "de") {
-            locale = AlarmMessageLocale_t::DE;
-        }
-        if (s == "fr") {
-            locale = AlarmMessageLocale_t::FR;
-        }
-    }
+    AlarmMessageLocale_t locale = parseLocale(request);
 
     auto inv = Hoymiles.getInverterBySerial(serial);
 
+    JsonETag etag;
+    etag.add(serial).add(static_cast<uint32_t>(locale));
     if (inv != nullptr) {
-        uint8_t logEntryCount = inv->EventLog()->getEntryCount();
+        etag.add(inv->EventLog()->getLastUpdate())
+            .add(static_cast<uint32_t>(inv->EventLog()->getEntryCount()));
+    }
+
+    auto etagString = etag.toString(false);
+    if (WebApi.sendNotModified(request, etagString)) { return; }
 
-        root["count"] = logEntryCount;
-        JsonArray eventsArray = root["events"].to<JsonArray>();
+    JsonStreamResponse stream;
+
+    if (inv != nullptr) {
+        uint8_t logEntryCount = inv->EventLog()->getEntryCount();
 
-        for (uint8_t logEntry = 0; logEntry < logEntryCount; logEntry++) {
-            JsonObject eventsObject = eventsArray.add<JsonObject>();
+        stream.addMembers([logEntryCount](JsonObject root) {
+            root["count"] = logEntryCount;
+        });
 
+        stream.addArray("events", logEntryCount, [inv, locale](size_t logEntry, JsonObject eventsObject) {
             AlarmLogEntry_t entry;
             inv->EventLog()->getLogEntry(logEntry, entry, locale);
 
@@ -54,8 +76,113 @@ void WebApiEventlogClass::onEventlogStatus(AsyncWebServerRequest* request)
             eventsObject["message"] = entry.Message;
             eventsObject["start_time"] = entry.StartTime;
             eventsObject["end_time"] = entry.EndTime;
-        }
+            return true;
+        });
+    }
+
+    stream.send(request, etagString);
+}
+
+// query parameters:
+// from, to: unix timestamps of the start of the events, defaults to the
+//           last 24 hours
+// inv: serial of an inverter to only return its alarms
+// locale: en (default), de or fr, for the messages of inverter alarms
+//
+// at most MAX_EVENTS events are returned. if there are more, "next_from"
+// is the start of the last event returned, to be passed as "from" to fetch
+// the remaining ones. events starting at that time are then returned again.
+void WebApiEventlogClass::onEventlogHistory(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    static constexpr size_t MAX_EVENTS = 256;
+
+    uint64_t serial = 0;
+    if (request->hasParam("inv")) {
+        serial = WebApi.parseSerialFromRequest(request);
+    }
+
+    AlarmMessageLocale_t locale = parseLocale(request);
+
+    uint32_t to = time(nullptr);
+    if (request->hasParam("to")) {
+        to = strtoul(request->getParam("to")->value().c_str(), nullptr, 10);
+    }
+
+    uint32_t from = (to > 24 * 3600) ? (to - 24 * 3600) : 0;
+    if (request->hasParam("from")) {
+        from = strtoul(request->getParam("from")->value().c_str(), nullptr, 10);
     }
 
-    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+    try {
+        auto spRecords = std::make_shared<std::vector<EventStoreClass::Record>>();
+        spRecords->reserve(MAX_EVENTS);
+
+        // one more than returned tells whether there are more events
+        EventStore.query(from, to, serial, MAX_EVENTS + 1,
+            [&spRecords](EventStoreClass::Record const& record) {
+                spRecords->push_back(record);
+            });
+
+        bool more = spRecords->size() > MAX_EVENTS;
+        if (more) { spRecords->pop_back(); }
+
+        JsonStreamResponse stream;
+
+        stream.addMembers([spRecords, from, to, more](JsonObject root) {
+            root["from"] = from;
+            root["to"] = to;
+            root["count"] = spRecords->size();
+            if (more) {
+                root["next_from"] = spRecords->back().Start;
+            }
+        });
+
+        stream.addArray("events", spRecords->size(), [spRecords, locale](size_t index, JsonObject event) {
+            auto const& record = (*spRecords)[index];
+
+            event["start_time"] = record.Start;
+            event["end_time"] = record.End;
+
+            switch (record.Origin) {
+            case EventStoreClass::Source::InverterAlarm: {
+                event["source"] = "inverter";
+
+                char serial[sizeof(uint64_t) * 8 + 1];
+                snprintf(serial, sizeof(serial), "%0" PRIx32 "%08" PRIx32,
+                    static_cast<uint32_t>((record.Serial >> 32) & 0xFFFFFFFF),
+                    static_cast<uint32_t>(record.Serial & 0xFFFFFFFF));
+                event["serial"] = serial;
+
+                event["message_id"] = record.Code;
+                auto inv = Hoymiles.getInverterBySerial(record.Serial);
+                if (inv != nullptr) {
+                    event["message"] = inv->EventLog()->getMessage(record.Code, locale);
+                }
+                break;
+            }
+            case EventStoreClass::Source::PowerLimiter:
+                event["source"] = "powerlimiter";
+                event["status"] = record.Code;
+                break;
+            case EventStoreClass::Source::Battery:
+            case EventStoreClass::Source::GridCharger:
+                event["source"] = (record.Origin == EventStoreClass::Source::Battery) ? "battery" : "gridcharger";
+                event["event"] = (record.Code == static_cast<uint16_t>(EventStoreClass::Code::DataLost)) ? "data_lost" : "data_restored";
+                break;
+            }
+
+            return true;
+        });
+
+        stream.send(request);
+
+    } catch (std::bad_alloc& bad_alloc) {
+        MessageOutput.printf("Calling /api/eventlog/history has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+
+        WebApi.sendTooManyRequests(request);
+    }
 }
@@ -4,12 +4,15 @@
  */
 #include "WebApi_file.h"
 #include "Configuration.h"
+#include "FileHashCache.h"
 #include "RestartHelper.h"
 #include "Utils.h"
 #include "WebApi.h"
 #include "WebApi_errors.h"
+#include "defaults.h"
 #include <AsyncJson.h>
 #include <LittleFS.h>
+#include <algorithm>
 
 void WebApiFileClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
@@ -20,13 +23,20 @@ void WebApiFileClass::init(AsyncWebServer& server, Scheduler& scheduler)
     using std::placeholders::_5;
     using std::placeholders::_6;
 
-    server.on("/api/file/get", HTTP_GET, std::bind(&WebApiFileClass::onFileGet, this, _1));
-    server.on("/api/file/delete", HTTP_POST, std::bind(&WebApiFileClass::onFileDelete, this, _1));
-    server.on("/api/file/delete_all", HTTP_POST, std::bind(&WebApiFileClass::onFileDeleteAll, this, _1));
-    server.on("/api/file/list", HTTP_GET, std::bind(&WebApiFileClass::onFileListGet, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/file/get", HTTP_GET, std::bind(&WebApiFileClass::onFileGet, this, _1));
+    router.on("/api/file/delete", HTTP_POST, std::bind(&WebApiFileClass::onFileDelete, this, _1));
+    router.on("/api/file/delete_all", HTTP_POST, std::bind(&WebApiFileClass::onFileDeleteAll, this, _1));
+    router.on("/api/file/list", HTTP_GET, std::bind(&WebApiFileClass::onFileListGet, this, _1));
     server.on("/api/file/upload", HTTP_POST,
         std::bind(&WebApiFileClass::onFileUploadFinish, this, _1),
         std::bind(&WebApiFileClass::onFileUpload, this, _1, _2, _3, _4, _5, _6));
+
+    router.on("/api/config/backup", HTTP_GET, std::bind(&WebApiFileClass::onConfigBackup, this, _1));
+    server.on("/api/config/restore", HTTP_POST,
+        std::bind(&WebApiFileClass::onConfigRestore, this, _1),
+        nullptr,
+        std::bind(&WebApiFileClass::onConfigRestoreBody, this, _1, _2, _3, _4, _5));
 }
 
 void WebApiFileClass::onFileListGet(AsyncWebServerRequest* request)
@@ -42,12 +52,11 @@ void WebApiFileClass::onFileListGet(AsyncWebServerRequest* request)
     File rootfs = LittleFS.open("/");
     File file = rootfs.openNextFile();
     while (file) {
-        if (file.isDirectory()) {
-            continue;
+        if (!file.isDirectory()) {
+            JsonObject obj = data.add<JsonObject>();
+            obj["name"] = String(file.name());
+            obj["size"] = file.size();
         }
-        JsonObject obj = data.add<JsonObject>();
-        obj["name"] = String(file.name());
-        obj["size"] = file.size();
 
         file = rootfs.openNextFile();
     }
@@ -73,7 +82,27 @@ void WebApiFileClass::onFileGet(AsyncWebServerRequest* request)
         }
     }
 
-    request->send(LittleFS, requestFile, String(), true);
+    String etag = FileHashCache.getETag(requestFile);
+
+    bool eTagMatch = false;
+    if (!etag.isEmpty() && request->hasHeader("If-None-Match")) {
+        const AsyncWebHeader* h = request->getHeader("If-None-Match");
+        eTagMatch = h->value().equals(etag);
+    }
+
+    AsyncWebServerResponse* response;
+    if (eTagMatch) {
+        response = request->beginResponse(304);
+    } else {
+        response = request->beginResponse(LittleFS, requestFile, String(), true);
+    }
+
+    if (!etag.isEmpty()) {
+        response->addHeader("Cache-Control", "private, must-revalidate");
+        response->addHeader("ETag", etag);
+    }
+
+    request->send(response);
 }
 
 void WebApiFileClass::onFileDelete(AsyncWebServerRequest* request)
@@ -104,6 +133,7 @@ void WebApiFileClass::onFileDelete(AsyncWebServerRequest* request)
     }
 
     LittleFS.remove(name);
+    FileHashCache.invalidate(name);
 
     retMsg["type"] = "success";
     retMsg["message"] = "File deleted";
@@ -164,6 +194,17 @@ void WebApiFileClass::onFileUpload(AsyncWebServerRequest* request, String filena
         }
         const String name = "/" + request->getParam("file")->value();
         request->_tempFile = LittleFS.open(name, "w");
+        FileHashCache.invalidate(name);
+
+        // the snapshot no longer matches the uploaded configuration
+        if (name == CONFIG_FILENAME) {
+            LittleFS.remove(CONFIG_SNAPSHOT_FILENAME);
+        }
+
+        // the compiled language pack is outdated as well
+        if (name.endsWith(LANG_PACK_SUFFIX)) {
+            LittleFS.remove(name.substring(0, name.length() - strlen(LANG_PACK_SUFFIX)) + LANG_PACK_COMPILED_SUFFIX);
+        }
     }
 
     if (len) {
@@ -192,3 +233,89 @@ void WebApiFileClass::onFileUploadFinish(AsyncWebServerRequest* request)
     request->send(response);
     RestartHelper.triggerRestart();
 }
+
+void WebApiFileClass::onConfigBackup(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentials(request)) {
+        return;
+    }
+
+    bool secrets = request->hasParam("secrets") && request->getParam("secrets")->value() == "1";
+
+    std::shared_ptr<uint8_t[]> backup = ConfigurationClass::exportBackup(secrets);
+    if (!backup) {
+        request->send(500);
+        return;
+    }
+
+    size_t size = ConfigurationClass::getBackupSize();
+    AsyncWebServerResponse* response = request->beginResponse("application/octet-stream", size,
+        [backup, size](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            size_t len = std::min(maxLen, size - index);
+            memcpy(buffer, backup.get() + index, len);
+            return len;
+        });
+    response->addHeader("Content-Disposition", "attachment; filename=\"config.backup\"");
+    request->send(response);
+}
+
+// the body is collected in the request's temporary buffer, which is freed
+// along with the request
+void WebApiFileClass::onConfigRestoreBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total)
+{
+    if (!WebApi.checkCredentials(request)) {
+        return;
+    }
+
+    if (total != ConfigurationClass::getBackupSize()) {
+        return;
+    }
+
+    if (index == 0 && request->_tempObject == nullptr) {
+        request->_tempObject = malloc(total);
+    }
+
+    if (request->_tempObject == nullptr || index + len > total) {
+        return;
+    }
+
+    memcpy(static_cast<uint8_t*>(request->_tempObject) + index, data, len);
+}
+
+void WebApiFileClass::onConfigRestore(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentials(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto& retMsg = response->getRoot();
+    retMsg["type"] = "warning";
+
+    auto result = ConfigurationClass::RestoreResult::InvalidFormat;
+    if (request->_tempObject != nullptr && request->contentLength() == ConfigurationClass::getBackupSize()) {
+        result = Configuration.restoreBackup(static_cast<uint8_t const*>(request->_tempObject), request->contentLength());
+    }
+
+    switch (result) {
+    case ConfigurationClass::RestoreResult::Success:
+        retMsg["type"] = "success";
+        retMsg["message"] = "Configuration restored. Rebooting now...";
+        retMsg["code"] = WebApiError::FileBackupRestored;
+        break;
+    case ConfigurationClass::RestoreResult::BuildMismatch:
+        retMsg["message"] = "Backup was created by a different firmware build!";
+        retMsg["code"] = WebApiError::FileBackupBuildMismatch;
+        break;
+    case ConfigurationClass::RestoreResult::InvalidFormat:
+        retMsg["message"] = "Invalid backup!";
+        retMsg["code"] = WebApiError::FileBackupInvalid;
+        break;
+    }
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+
+    if (result == ConfigurationClass::RestoreResult::Success) {
+        RestartHelper.triggerRestart();
+    }
+}
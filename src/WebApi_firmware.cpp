@@ -4,11 +4,11 @@
  */
 #include "WebApi_firmware.h"
 #include "Configuration.h"
+#include "FirmwareUpdater.h"
 #include "RestartHelper.h"
 #include "WebApi.h"
 #include "helper.h"
 #include <AsyncJson.h>
-#include <Update.h>
 #include "esp_partition.h"
 
 void WebApiFirmwareClass::init(AsyncWebServer& server, Scheduler& scheduler)
@@ -24,7 +24,8 @@ void WebApiFirmwareClass::init(AsyncWebServer& server, Scheduler& scheduler)
         std::bind(&WebApiFirmwareClass::onFirmwareUpdateFinish, this, _1),
         std::bind(&WebApiFirmwareClass::onFirmwareUpdateUpload, this, _1, _2, _3, _4, _5, _6));
 
-    server.on("/api/firmware/status", HTTP_GET, std::bind(&WebApiFirmwareClass::onFirmwareStatus, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/firmware/status", HTTP_GET, std::bind(&WebApiFirmwareClass::onFirmwareStatus, this, _1));
 }
 
 bool WebApiFirmwareClass::otaSupported() const
@@ -43,7 +44,8 @@ void WebApiFirmwareClass::onFirmwareUpdateFinish(AsyncWebServerRequest* request)
     // the request handler is triggered after the upload has finished...
     // create the response, add header, and send response
 
-    AsyncWebServerResponse* response = request->beginResponse((Update.hasError()) ? 500 : 200, "text/plain", (Update.hasError()) ? "FAIL" : "OK");
+    bool success = _updateSucceeded;
+    AsyncWebServerResponse* response = request->beginResponse(success ? 200 : 500, "text/plain", success ? "OK" : "FAIL");
     response->addHeader("Connection", "close");
     response->addHeader("Access-Control-Allow-Origin", "*");
     request->send(response);
@@ -60,36 +62,31 @@ void WebApiFirmwareClass::onFirmwareUpdateUpload(AsyncWebServerRequest* request,
         return request->send(500, "text/plain", "OTA updates not supported");
     }
 
-    // Upload handler chunks in data
+    // Upload handler chunks in data. they are written to flash by the
+    // updater's task, such that this handler only copies them.
     if (!index) {
+        _updateSucceeded = false;
+
         if (!request->hasParam("MD5", true)) {
             return request->send(400, "text/plain", "MD5 parameter missing");
         }
 
-        if (!Update.setMD5(request->getParam("MD5", true)->value().c_str())) {
-            return request->send(400, "text/plain", "MD5 parameter invalid");
-        }
-
-        if (!Update.begin(UPDATE_SIZE_UNKNOWN, U_FLASH)) { // Start with max available size
-            Update.printError(Serial);
+        if (!FirmwareUpdater.begin(request->getParam("MD5", true)->value())) {
             return request->send(400, "text/plain", "OTA could not begin");
         }
     }
 
-    // Write chunked data to the free sketch space
     if (len) {
-        if (Update.write(data, len) != len) {
-            return request->send(400, "text/plain", "OTA could not begin");
+        if (!FirmwareUpdater.write(data, len)) {
+            return request->send(400, "text/plain", "OTA could not write");
         }
     }
 
     if (final) { // if the final flag is set then this is the last frame of data
-        if (!Update.end(true)) { // true to set the size to the current progress
-            Update.printError(Serial);
+        _updateSucceeded = FirmwareUpdater.end();
+        if (!_updateSucceeded) {
             return request->send(400, "text/plain", "Could not end OTA");
         }
-    } else {
-        return;
     }
 }
 
@@ -11,8 +11,9 @@ void WebApiGridProfileClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     using std::placeholders::_1;
 
-    server.on("/api/gridprofile/status", HTTP_GET, std::bind(&WebApiGridProfileClass::onGridProfileStatus, this, _1));
-    server.on("/api/gridprofile/rawdata", HTTP_GET, std::bind(&WebApiGridProfileClass::onGridProfileRawdata, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/gridprofile/status", HTTP_GET, std::bind(&WebApiGridProfileClass::onGridProfileStatus, this, _1));
+    router.on("/api/gridprofile/rawdata", HTTP_GET, std::bind(&WebApiGridProfileClass::onGridProfileRawdata, this, _1));
 }
 
 void WebApiGridProfileClass::onGridProfileStatus(AsyncWebServerRequest* request)
@@ -21,11 +22,20 @@ void WebApiGridProfileClass::onGridProfileStatus(AsyncWebServerRequest* request)
         return;
     }
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
-    auto& root = response->getRoot();
     auto serial = WebApi.parseSerialFromRequest(request);
     auto inv = Hoymiles.getInverterBySerial(serial);
 
+    JsonETag etag;
+    etag.add(serial);
+    if (inv != nullptr) { etag.add(inv->GridProfile()->getLastUpdate()); }
+
+    auto etagString = etag.toString(false);
+    if (WebApi.sendNotModified(request, etagString)) { return; }
+
+    auto response = new PooledJsonResponse(JsonDocumentPoolClass::SizeClass::Large);
+    WebApi.addETag(response, etagString);
+    auto& root = response->getRoot();
+
     if (inv != nullptr) {
         root["name"] = inv->GridProfile()->getProfileName();
         root["version"] = inv->GridProfile()->getProfileVersion();
@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "WebApi_history.h"
+#include "Aggregates.h"
+#include "Configuration.h"
+#include "MessageOutput.h"
+#include "WebApi.h"
+#include <algorithm>
+#include <cinttypes>
+
+void WebApiHistoryClass::init(AsyncWebServer& server, Scheduler& scheduler)
+{
+    using std::placeholders::_1;
+
+    auto& router = WebApi.getRouter();
+    router.on("/api/history", HTTP_GET, std::bind(&WebApiHistoryClass::onHistoryGet, this, _1));
+    router.on("/api/history/aggregates", HTTP_GET, std::bind(&WebApiHistoryClass::onAggregatesGet, this, _1));
+}
+
+// query parameters:
+// series: battery_soc, battery_voltage, battery_current, powermeter_power,
+//         powerlimiter_target or inverter_power (requires inv=<serial>)
+// resolution: raw or minute (default)
+// from, to: unix timestamps, defaults to the last 24 hours
+void WebApiHistoryClass::onHistoryGet(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    static constexpr struct {
+        char const* name;
+        HistoryClass::Series series;
+    } seriesNames[] = {
+        { "battery_soc", HistoryClass::Series::BatterySoC },
+        { "battery_voltage", HistoryClass::Series::BatteryVoltage },
+        { "battery_current", HistoryClass::Series::BatteryCurrent },
+        { "powermeter_power", HistoryClass::Series::PowerMeterTotal },
+        { "powerlimiter_target", HistoryClass::Series::PowerLimiterTarget },
+        { "inverter_power", HistoryClass::Series::InverterAcPower },
+    };
+
+    if (!request->hasParam("series")) {
+        request->send(400, "text/plain", "series missing");
+        return;
+    }
+
+    String name = request->getParam("series")->value();
+    auto it = std::find_if(std::begin(seriesNames), std::end(seriesNames),
+        [&name](auto const& entry) { return name == entry.name; });
+    if (it == std::end(seriesNames)) {
+        request->send(400, "text/plain", "unknown series");
+        return;
+    }
+
+    size_t series = static_cast<size_t>(it->series);
+
+    if (it->series == HistoryClass::Series::InverterAcPower) {
+        auto serial = WebApi.parseSerialFromRequest(request);
+        auto const& config = Configuration.get();
+
+        size_t slot = 0;
+        while (slot < INV_MAX_COUNT && (serial == 0 || config.Inverter[slot].Serial != serial)) {
+            slot++;
+        }
+
+        if (slot == INV_MAX_COUNT) {
+            request->send(404);
+            return;
+        }
+
+        series += slot;
+    }
+
+    auto resolution = HistoryClass::Resolution::Minute;
+    if (request->hasParam("resolution") && request->getParam("resolution")->value() == "raw") {
+        resolution = HistoryClass::Resolution::Raw;
+    }
+
+    uint32_t to = time(nullptr);
+    if (request->hasParam("to")) {
+        to = strtoul(request->getParam("to")->value().c_str(), nullptr, 10);
+    }
+
+    uint32_t from = (to > 24 * 3600) ? (to - 24 * 3600) : 0;
+    if (request->hasParam("from")) {
+        from = strtoul(request->getParam("from")->value().c_str(), nullptr, 10);
+    }
+
+    try {
+        auto writer = std::make_shared<HistoryWriter>(name, series, resolution, from, to);
+
+        auto response = request->beginChunkedResponse("application/json",
+            [writer](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+                return writer->fill(buffer, maxLen);
+            });
+
+        response->addHeader("Cache-Control", "no-cache");
+        request->send(response);
+
+    } catch (std::bad_alloc& bad_alloc) {
+        MessageOutput.printf("Calling /api/history has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+
+        WebApi.sendTooManyRequests(request);
+    }
+}
+
+// the minimum, maximum and average of each field over the current and the
+// last completed minute, quarter hour and day. fields without data in a
+// window lack the respective object.
+void WebApiHistoryClass::onAggregatesGet(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    auto addResult = [](JsonObject obj, char const* key, std::optional<AggregatesClass::Result> const& oResult) {
+        if (!oResult) { return; }
+        auto result = obj[key].to<JsonObject>();
+        result["start"] = oResult->Start;
+        result["covered"] = oResult->CoveredSeconds;
+        result["min"] = oResult->Min;
+        result["max"] = oResult->Max;
+        result["avg"] = oResult->Average;
+    };
+
+    try {
+        auto response = new PooledJsonResponse(JsonDocumentPoolClass::SizeClass::Large);
+        auto root = response->getRoot().to<JsonObject>();
+
+        for (size_t f = 0; f < AggregatesClass::FIELD_COUNT; ++f) {
+            auto field = static_cast<AggregatesClass::Field>(f);
+            auto fieldObj = root[AggregatesClass::getName(field)].to<JsonObject>();
+
+            for (size_t w = 0; w < AggregatesClass::WINDOW_COUNT; ++w) {
+                auto window = static_cast<AggregatesClass::Window>(w);
+                auto windowObj = fieldObj[AggregatesClass::getName(window)].to<JsonObject>();
+                addResult(windowObj, "current", Aggregates.getCurrent(field, window));
+                addResult(windowObj, "last", Aggregates.getCompleted(field, window));
+            }
+        }
+
+        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+
+    } catch (std::bad_alloc& bad_alloc) {
+        MessageOutput.printf("Calling /api/history/aggregates has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+
+        WebApi.sendTooManyRequests(request);
+    }
+}
+
+WebApiHistoryClass::HistoryWriter::HistoryWriter(String const& name, size_t series,
+    HistoryClass::Resolution resolution, uint32_t from, uint32_t to)
+    : _name(name)
+    , _series(series)
+    , _resolution(resolution)
+    , _next(from)
+    , _to(to)
+{
+}
+
+size_t WebApiHistoryClass::HistoryWriter::fill(uint8_t* buffer, size_t maxLen)
+{
+    size_t written = 0;
+
+    while (written < maxLen) {
+        if (_blockPos >= _blockLen) {
+            _blockPos = 0;
+            _blockLen = 0;
+            if (!renderNextBlock()) { break; }
+            continue; // the block might be empty
+        }
+
+        size_t len = std::min(maxLen - written, _blockLen - _blockPos);
+        memcpy(buffer + written, _block + _blockPos, len);
+        written += len;
+        _blockPos += len;
+    }
+
+    return written;
+}
+
+bool WebApiHistoryClass::HistoryWriter::renderNextBlock()
+{
+    switch (_stage) {
+    case Stage::Header:
+        _blockLen = snprintf(_block, BLOCK_SIZE,
+            "{\"series\":\"%s\",\"resolution\":\"%s\",\"interval\":%u,\"samples\":[",
+            _name.c_str(), (_resolution == HistoryClass::Resolution::Raw ? "raw" : "minute"),
+            History.getInterval(_resolution));
+        _stage = Stage::Samples;
+        return true;
+
+    case Stage::Samples: {
+        uint8_t decimals = HistoryClass::getDecimals(_series);
+        uint32_t last = 0;
+
+        size_t count = History.query(_series, _resolution, _next, _to, SAMPLES_PER_BLOCK,
+            [this, decimals, &last](uint32_t timestamp, std::optional<float> value) {
+                size_t free = BLOCK_SIZE - _blockLen;
+                char const* separator = _first ? "" : ",";
+                if (value) {
+                    _blockLen += snprintf(_block + _blockLen, free, "%s[%" PRIu32 ",%.*f]",
+                        separator, timestamp, decimals, *value);
+                } else {
+                    _blockLen += snprintf(_block + _blockLen, free, "%s[%" PRIu32 ",null]",
+                        separator, timestamp);
+                }
+                _first = false;
+                last = timestamp;
+            });
+
+        if (count < SAMPLES_PER_BLOCK || last >= _to) {
+            _stage = Stage::Footer;
+        } else {
+            _next = last + 1;
+        }
+        return true;
+    }
+
+    case Stage::Footer:
+        _blockLen = snprintf(_block, BLOCK_SIZE, "]}");
+        _stage = Stage::Done;
+        return true;
+
+    case Stage::Done:
+        break;
+    }
+
+    return false;
+}
@@ -3,8 +3,8 @@
  * Copyright (C) 2024 Thomas Basler and others
  */
 #include "WebApi_i18n.h"
+#include "FileHashCache.h"
 #include "I18n.h"
-#include "Utils.h"
 #include "WebApi.h"
 #include <AsyncJson.h>
 #include <LittleFS.h>
@@ -13,8 +13,9 @@ void WebApiI18nClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     using std::placeholders::_1;
 
-    server.on("/api/i18n/languages", HTTP_GET, std::bind(&WebApiI18nClass::onI18nLanguages, this, _1));
-    server.on("/api/i18n/language", HTTP_GET, std::bind(&WebApiI18nClass::onI18nLanguage, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/i18n/languages", HTTP_GET, std::bind(&WebApiI18nClass::onI18nLanguages, this, _1));
+    router.on("/api/i18n/language", HTTP_GET, std::bind(&WebApiI18nClass::onI18nLanguage, this, _1));
 }
 
 void WebApiI18nClass::onI18nLanguages(AsyncWebServerRequest* request)
@@ -41,12 +42,7 @@ void WebApiI18nClass::onI18nLanguage(AsyncWebServerRequest* request)
         String filename = I18n.getFilenameByLocale(code);
 
         if (filename != "") {
-            String md5 = Utils::generateMd5FromFile(filename);
-
-            String expectedEtag;
-            expectedEtag = "\"";
-            expectedEtag += md5;
-            expectedEtag += "\"";
+            String expectedEtag = FileHashCache.getETag(filename);
 
             bool eTagMatch = false;
             if (request->hasHeader("If-None-Match")) {
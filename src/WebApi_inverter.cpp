@@ -17,12 +17,13 @@ void WebApiInverterClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     using std::placeholders::_1;
 
-    server.on("/api/inverter/list", HTTP_GET, std::bind(&WebApiInverterClass::onInverterList, this, _1));
-    server.on("/api/inverter/add", HTTP_POST, std::bind(&WebApiInverterClass::onInverterAdd, this, _1));
-    server.on("/api/inverter/edit", HTTP_POST, std::bind(&WebApiInverterClass::onInverterEdit, this, _1));
-    server.on("/api/inverter/del", HTTP_POST, std::bind(&WebApiInverterClass::onInverterDelete, this, _1));
-    server.on("/api/inverter/order", HTTP_POST, std::bind(&WebApiInverterClass::onInverterOrder, this, _1));
-    server.on("/api/inverter/stats_reset", HTTP_GET, std::bind(&WebApiInverterClass::onInverterStatReset, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/inverter/list", HTTP_GET, std::bind(&WebApiInverterClass::onInverterList, this, _1));
+    router.on("/api/inverter/add", HTTP_POST, std::bind(&WebApiInverterClass::onInverterAdd, this, _1));
+    router.on("/api/inverter/edit", HTTP_POST, std::bind(&WebApiInverterClass::onInverterEdit, this, _1));
+    router.on("/api/inverter/del", HTTP_POST, std::bind(&WebApiInverterClass::onInverterDelete, this, _1));
+    router.on("/api/inverter/order", HTTP_POST, std::bind(&WebApiInverterClass::onInverterOrder, this, _1));
+    router.on("/api/inverter/stats_reset", HTTP_GET, std::bind(&WebApiInverterClass::onInverterStatReset, this, _1));
 }
 
 void WebApiInverterClass::onInverterList(AsyncWebServerRequest* request)
@@ -31,56 +32,55 @@ void WebApiInverterClass::onInverterList(AsyncWebServerRequest* request)
         return;
     }
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
-    auto& root = response->getRoot();
-    JsonArray data = root["inverter"].to<JsonArray>();
-
-    const CONFIG_T& config = Configuration.get();
-
-    for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
-        if (config.Inverter[i].Serial > 0) {
-            JsonObject obj = data.add<JsonObject>();
-            obj["id"] = i;
-            obj["name"] = String(config.Inverter[i].Name);
-            obj["order"] = config.Inverter[i].Order;
-
-            // Inverter Serial is read as HEX
-            char buffer[sizeof(uint64_t) * 8 + 1];
-            snprintf(buffer, sizeof(buffer), "%0" PRIx32 "%08" PRIx32,
-                static_cast<uint32_t>((config.Inverter[i].Serial >> 32) & 0xFFFFFFFF),
-                static_cast<uint32_t>(config.Inverter[i].Serial & 0xFFFFFFFF));
-            obj["serial"] = buffer;
-            obj["poll_enable"] = config.Inverter[i].Poll_Enable;
-            obj["poll_enable_night"] = config.Inverter[i].Poll_Enable_Night;
-            obj["command_enable"] = config.Inverter[i].Command_Enable;
-            obj["command_enable_night"] = config.Inverter[i].Command_Enable_Night;
-            obj["reachable_threshold"] = config.Inverter[i].ReachableThreshold;
-            obj["zero_runtime"] = config.Inverter[i].ZeroRuntimeDataIfUnrechable;
-            obj["zero_day"] = config.Inverter[i].ZeroYieldDayOnMidnight;
-            obj["clear_eventlog"] = config.Inverter[i].ClearEventlogOnMidnight;
-            obj["yieldday_correction"] = config.Inverter[i].YieldDayCorrection;
-
-            auto inv = Hoymiles.getInverterBySerial(config.Inverter[i].Serial);
-            uint8_t max_channels;
-            if (inv == nullptr) {
-                obj["type"] = "Unknown";
-                max_channels = INV_MAX_CHAN_COUNT;
-            } else {
-                obj["type"] = inv->typeName();
-                max_channels = inv->Statistics()->getChannelsByType(TYPE_DC).size();
-            }
+    // the inverters are serialized one at a time while sending
+    JsonStreamResponse stream;
+
+    stream.addArray("inverter", INV_MAX_COUNT, [](size_t i, JsonObject obj) {
+        const CONFIG_T& config = Configuration.get();
+        if (config.Inverter[i].Serial == 0) { return false; }
+
+        obj["id"] = i;
+        obj["name"] = String(config.Inverter[i].Name);
+        obj["order"] = config.Inverter[i].Order;
+
+        // Inverter Serial is read as HEX
+        char buffer[sizeof(uint64_t) * 8 + 1];
+        snprintf(buffer, sizeof(buffer), "%0" PRIx32 "%08" PRIx32,
+            static_cast<uint32_t>((config.Inverter[i].Serial >> 32) & 0xFFFFFFFF),
+            static_cast<uint32_t>(config.Inverter[i].Serial & 0xFFFFFFFF));
+        obj["serial"] = buffer;
+        obj["poll_enable"] = config.Inverter[i].Poll_Enable;
+        obj["poll_enable_night"] = config.Inverter[i].Poll_Enable_Night;
+        obj["command_enable"] = config.Inverter[i].Command_Enable;
+        obj["command_enable_night"] = config.Inverter[i].Command_Enable_Night;
+        obj["reachable_threshold"] = config.Inverter[i].ReachableThreshold;
+        obj["zero_runtime"] = config.Inverter[i].ZeroRuntimeDataIfUnrechable;
+        obj["zero_day"] = config.Inverter[i].ZeroYieldDayOnMidnight;
+        obj["clear_eventlog"] = config.Inverter[i].ClearEventlogOnMidnight;
+        obj["yieldday_correction"] = config.Inverter[i].YieldDayCorrection;
+
+        auto inv = Hoymiles.getInverterBySerial(config.Inverter[i].Serial);
+        uint8_t max_channels;
+        if (inv == nullptr) {
+            obj["type"] = "Unknown";
+            max_channels = INV_MAX_CHAN_COUNT;
+        } else {
+            obj["type"] = inv->typeName();
+            max_channels = inv->Statistics()->getChannelsByType(TYPE_DC).size();
+        }
 
-            JsonArray channel = obj["channel"].to<JsonArray>();
-            for (uint8_t c = 0; c < max_channels; c++) {
-                JsonObject chanData = channel.add<JsonObject>();
-                chanData["name"] = config.Inverter[i].channel[c].Name;
-                chanData["max_power"] = config.Inverter[i].channel[c].MaxChannelPower;
-                chanData["yield_total_offset"] = config.Inverter[i].channel[c].YieldTotalOffset;
-            }
+        JsonArray channel = obj["channel"].to<JsonArray>();
+        for (uint8_t c = 0; c < max_channels; c++) {
+            JsonObject chanData = channel.add<JsonObject>();
+            chanData["name"] = config.Inverter[i].channel[c].Name;
+            chanData["max_power"] = config.Inverter[i].channel[c].MaxChannelPower;
+            chanData["yield_total_offset"] = config.Inverter[i].channel[c].YieldTotalOffset;
         }
-    }
 
-    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        return true;
+    });
+
+    stream.send(request);
 }
 
 void WebApiInverterClass::onInverterAdd(AsyncWebServerRequest* request)
@@ -123,9 +123,25 @@ void WebApiInverterClass::onInverterAdd(AsyncWebServerRequest* request)
         return;
     }
 
-    INVERTER_CONFIG_T* inverter = Configuration.getFreeInverterSlot();
+    INVERTER_CONFIG_T inverter;
+    bool slotAvailable = false;
+
+    {
+        auto guard = Configuration.getWriteGuard();
+        INVERTER_CONFIG_T* pInverter = Configuration.getFreeInverterSlot();
+
+        if (pInverter) {
+            // Interpret the string as a hex value and convert it to uint64_t
+            pInverter->Serial = serial;
 
-    if (!inverter) {
+            strncpy(pInverter->Name, root["name"].as<String>().c_str(), INV_MAX_NAME_STRLEN);
+
+            inverter = *pInverter;
+            slotAvailable = true;
+        }
+    }
+
+    if (!slotAvailable) {
         retMsg["message"] = "Only " STR(INV_MAX_COUNT) " inverters are supported!";
         retMsg["code"] = WebApiError::InverterCount;
         retMsg["param"]["max"] = INV_MAX_COUNT;
@@ -133,20 +149,15 @@ void WebApiInverterClass::onInverterAdd(AsyncWebServerRequest* request)
         return;
     }
 
-    // Interpret the string as a hex value and convert it to uint64_t
-    inverter->Serial = serial;
-
-    strncpy(inverter->Name, root["name"].as<String>().c_str(), INV_MAX_NAME_STRLEN);
-
-    WebApi.writeConfig(retMsg, WebApiError::InverterAdded, "Inverter created!");
+    WebApi.writeConfig(retMsg, ConfigurationClass::Section::Inverters, WebApiError::InverterAdded, "Inverter created!");
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
-    auto inv = Hoymiles.addInverter(inverter->Name, inverter->Serial);
+    auto inv = Hoymiles.addInverter(inverter.Name, inverter.Serial);
 
     if (inv != nullptr) {
         for (uint8_t c = 0; c < INV_MAX_CHAN_COUNT; c++) {
-            inv->Statistics()->setStringMaxPower(c, inverter->channel[c].MaxChannelPower);
+            inv->Statistics()->setStringMaxPower(c, inverter.channel[c].MaxChannelPower);
         }
     }
 
@@ -243,7 +254,7 @@ void WebApiInverterClass::onInverterEdit(AsyncWebServerRequest* request)
         }
     }
 
-    WebApi.writeConfig(retMsg, WebApiError::InverterChanged, "Inverter changed!");
+    WebApi.writeConfig(retMsg, ConfigurationClass::Section::Inverters, WebApiError::InverterChanged, "Inverter changed!");
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
@@ -314,9 +325,12 @@ void WebApiInverterClass::onInverterDelete(AsyncWebServerRequest* request)
 
     Hoymiles.removeInverterBySerial(inverter.Serial);
 
-    Configuration.deleteInverterById(inverter_id);
+    {
+        auto guard = Configuration.getWriteGuard();
+        Configuration.deleteInverterById(inverter_id);
+    }
 
-    WebApi.writeConfig(retMsg, WebApiError::InverterDeleted, "Inverter deleted!");
+    WebApi.writeConfig(retMsg, ConfigurationClass::Section::Inverters, WebApiError::InverterDeleted, "Inverter deleted!");
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
@@ -363,7 +377,7 @@ void WebApiInverterClass::onInverterOrder(AsyncWebServerRequest* request)
         }
     }
 
-    WebApi.writeConfig(retMsg, WebApiError::InverterOrdered, "Inverter order saved!");
+    WebApi.writeConfig(retMsg, ConfigurationClass::Section::Inverters, WebApiError::InverterOrdered, "Inverter order saved!");
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
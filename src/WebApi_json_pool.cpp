@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "WebApi_json_pool.h"
+#include "MemoryPolicy.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+JsonDocumentPoolClass JsonDocumentPool;
+
+namespace {
+
+// each allocation from a buffer is preceded by its size
+constexpr size_t HEADER_SIZE = alignof(std::max_align_t);
+
+constexpr size_t alignUp(size_t value)
+{
+    return (value + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+}
+
+// writes the part of the serialized document which belongs to the chunk
+// currently being sent
+class ChunkWriter : public Print {
+public:
+    ChunkWriter(uint8_t* destination, size_t skip, size_t len)
+        : _destination(destination)
+        , _skip(skip)
+        , _len(len)
+    {
+    }
+
+    size_t write(uint8_t c) override
+    {
+        if (_skip > 0) {
+            --_skip;
+            return 1;
+        }
+
+        if (_pos >= _len) { return 0; }
+        _destination[_pos++] = c;
+        return 1;
+    }
+
+    size_t write(uint8_t const* buffer, size_t size) override
+    {
+        size_t written = 0;
+        while (written < size && write(buffer[written]) == 1) { ++written; }
+        return written;
+    }
+
+private:
+    uint8_t* _destination;
+    size_t _skip;
+    size_t _len;
+    size_t _pos = 0;
+};
+
+} // namespace
+
+uint8_t* JsonDocumentPoolClass::checkout(SizeClass sizeClass, size_t& capacity)
+{
+    bool large = (sizeClass == SizeClass::Large);
+    capacity = large ? LargeCapacity : SmallCapacity;
+
+    Slot* first = large ? _large.data() : _small.data();
+    size_t count = large ? MaxLargeSlots : MaxSmallSlots;
+    if (!psramFound()) { count = std::max<size_t>(1, count / 2); }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (size_t i = 0; i < count; ++i) {
+        auto& slot = first[i];
+        if (slot.InUse) { continue; }
+
+        // allocated when first needed and kept afterwards
+        if (slot.Buffer == nullptr) {
+            slot.Buffer = static_cast<uint8_t*>(MemoryPolicy::allocateLarge(capacity));
+            if (slot.Buffer == nullptr) { return nullptr; }
+        }
+
+        slot.InUse = true;
+        return slot.Buffer;
+    }
+
+    return nullptr;
+}
+
+void JsonDocumentPoolClass::giveBack(uint8_t* buffer)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (auto& slot : _small) {
+        if (slot.Buffer == buffer) { slot.InUse = false; return; }
+    }
+
+    for (auto& slot : _large) {
+        if (slot.Buffer == buffer) { slot.InUse = false; return; }
+    }
+}
+
+JsonDocumentPoolClass::Lease::Lease(SizeClass sizeClass)
+{
+    _buffer = JsonDocumentPool.checkout(sizeClass, _capacity);
+    if (_buffer == nullptr) { _capacity = 0; }
+}
+
+JsonDocumentPoolClass::Lease::~Lease()
+{
+    if (_buffer != nullptr) { JsonDocumentPool.giveBack(_buffer); }
+}
+
+bool JsonDocumentPoolClass::Lease::owns(void const* ptr) const
+{
+    auto p = static_cast<uint8_t const*>(ptr);
+    return _buffer != nullptr && p >= _buffer && p < _buffer + _capacity;
+}
+
+size_t& JsonDocumentPoolClass::Lease::sizeOf(void* ptr) const
+{
+    return *reinterpret_cast<size_t*>(static_cast<uint8_t*>(ptr) - HEADER_SIZE);
+}
+
+void* JsonDocumentPoolClass::Lease::allocate(size_t size)
+{
+    size_t offset = alignUp(_used) + HEADER_SIZE;
+    if (_buffer == nullptr || offset + size > _capacity) {
+        return malloc(size);
+    }
+
+    uint8_t* ptr = _buffer + offset;
+    _used = offset + size;
+    _last = ptr;
+    sizeOf(ptr) = size;
+    return ptr;
+}
+
+void JsonDocumentPoolClass::Lease::deallocate(void* ptr)
+{
+    if (!owns(ptr)) {
+        free(ptr);
+        return;
+    }
+
+    if (ptr == _last) {
+        _used = static_cast<uint8_t*>(ptr) - _buffer - HEADER_SIZE;
+        _last = nullptr;
+    }
+}
+
+void* JsonDocumentPoolClass::Lease::reallocate(void* ptr, size_t new_size)
+{
+    if (ptr == nullptr) { return allocate(new_size); }
+
+    if (!owns(ptr)) { return realloc(ptr, new_size); }
+
+    size_t offset = static_cast<uint8_t*>(ptr) - _buffer;
+    if (ptr == _last && offset + new_size <= _capacity) {
+        _used = offset + new_size;
+        sizeOf(ptr) = new_size;
+        return ptr;
+    }
+
+    size_t oldSize = sizeOf(ptr);
+    if (new_size <= oldSize) {
+        sizeOf(ptr) = new_size;
+        return ptr;
+    }
+
+    void* moved = allocate(new_size);
+    if (moved == nullptr) { return nullptr; }
+
+    memcpy(moved, ptr, oldSize);
+    deallocate(ptr);
+    return moved;
+}
+
+PooledJsonResponse::PooledJsonResponse(JsonDocumentPoolClass::SizeClass sizeClass)
+    : _lease(sizeClass)
+    , _document(&_lease)
+{
+    _code = 200;
+    _contentType = "application/json";
+    _root = _document.to<JsonObject>();
+}
+
+size_t PooledJsonResponse::setLength()
+{
+    _contentLength = measureJson(_root);
+    if (_contentLength > 0) { _valid = true; }
+    return _contentLength;
+}
+
+size_t PooledJsonResponse::_fillBuffer(uint8_t* data, size_t len)
+{
+    ChunkWriter writer(data, _sentLength, len);
+    serializeJson(_root, writer);
+    return len;
+}
@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "WebApi_json_stream.h"
+#include "MessageOutput.h"
+#include "WebApi.h"
+#include <algorithm>
+#include <cstring>
+
+JsonStreamResponse::JsonStreamResponse()
+    : _state(std::make_shared<State>())
+{
+}
+
+JsonStreamResponse& JsonStreamResponse::addMembers(MembersCallback callback)
+{
+    _state->Parts.push_back({ nullptr, 0, std::move(callback), nullptr });
+    return *this;
+}
+
+JsonStreamResponse& JsonStreamResponse::addArray(char const* key, size_t count, ElementCallback callback)
+{
+    _state->Parts.push_back({ key, count, nullptr, std::move(callback) });
+    return *this;
+}
+
+void JsonStreamResponse::appendMembers(State& state, JsonDocument const& doc)
+{
+    if (doc.overflowed()) {
+        MessageOutput.println("[JsonStreamResponse] Members are incomplete");
+    }
+
+    String members;
+    serializeJson(doc, members);
+
+    // the braces of the serialized object are stripped
+    if (members.length() <= 2) { return; }
+
+    if (!state.FirstMember) { state.Pending += ','; }
+    state.FirstMember = false;
+    state.Pending += members.substring(1, members.length() - 1);
+}
+
+bool JsonStreamResponse::generate(State& state)
+{
+    state.Pending = "";
+    state.PendingOffset = 0;
+
+    if (!state.Started) {
+        state.Started = true;
+        state.Pending = "{";
+        return true;
+    }
+
+    while (state.PartIndex < state.Parts.size()) {
+        auto const& part = state.Parts[state.PartIndex];
+
+        if (part.Key == nullptr) {
+            JsonDocument doc;
+            part.Members(doc.to<JsonObject>());
+            ++state.PartIndex;
+
+            appendMembers(state, doc);
+            if (state.Pending.isEmpty()) { continue; }
+            return true;
+        }
+
+        if (!state.ArrayOpen) {
+            state.ArrayOpen = true;
+            state.FirstElement = true;
+            state.ElementIndex = 0;
+
+            if (!state.FirstMember) { state.Pending += ','; }
+            state.FirstMember = false;
+            state.Pending += '"';
+            state.Pending += part.Key;
+            state.Pending += "\":[";
+            return true;
+        }
+
+        while (state.ElementIndex < part.Count) {
+            JsonDocument doc;
+            if (!part.Element(state.ElementIndex++, doc.to<JsonObject>())) { continue; }
+
+            if (doc.overflowed()) {
+                MessageOutput.printf("[JsonStreamResponse] Element of %s is incomplete\r\n", part.Key);
+            }
+
+            String element;
+            serializeJson(doc, element);
+
+            if (!state.FirstElement) { state.Pending += ','; }
+            state.FirstElement = false;
+            state.Pending += element;
+            return true;
+        }
+
+        state.ArrayOpen = false;
+        ++state.PartIndex;
+        state.Pending = "]";
+        return true;
+    }
+
+    if (!state.Finished) {
+        state.Finished = true;
+        state.Pending = "}";
+        return true;
+    }
+
+    return false;
+}
+
+size_t JsonStreamResponse::fill(State& state, uint8_t* buffer, size_t maxLen)
+{
+    size_t written = 0;
+
+    while (written < maxLen) {
+        if (state.PendingOffset >= state.Pending.length()) {
+            if (!generate(state)) { break; }
+            continue;
+        }
+
+        size_t len = std::min(maxLen - written, state.Pending.length() - state.PendingOffset);
+        memcpy(buffer + written, state.Pending.c_str() + state.PendingOffset, len);
+        state.PendingOffset += len;
+        written += len;
+    }
+
+    return written;
+}
+
+void JsonStreamResponse::send(AsyncWebServerRequest* request, String const& etag)
+{
+    auto state = _state;
+    auto response = request->beginChunkedResponse("application/json",
+        [state](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            try {
+                return fill(*state, buffer, maxLen);
+            } catch (const std::bad_alloc& bad_alloc) {
+                // the response ends prematurely, which the client notices
+                MessageOutput.printf("[JsonStreamResponse] Out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+                return 0;
+            }
+        });
+
+    if (!etag.isEmpty()) { WebApi.addETag(response, etag); }
+
+    request->send(response);
+}
@@ -4,6 +4,7 @@
  */
 
 #include "WebApi_maintenance.h"
+#include "InputCapture.h"
 #include "RestartHelper.h"
 #include "WebApi.h"
 #include "WebApi_errors.h"
@@ -12,8 +13,20 @@
 void WebApiMaintenanceClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     using std::placeholders::_1;
+    using std::placeholders::_2;
+    using std::placeholders::_3;
+    using std::placeholders::_4;
+    using std::placeholders::_5;
 
-    server.on("/api/maintenance/reboot", HTTP_POST, std::bind(&WebApiMaintenanceClass::onRebootPost, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/maintenance/reboot", HTTP_POST, std::bind(&WebApiMaintenanceClass::onRebootPost, this, _1));
+    router.on("/api/maintenance/capture", HTTP_GET, std::bind(&WebApiMaintenanceClass::onCaptureGet, this, _1));
+    router.on("/api/maintenance/capture", HTTP_POST, std::bind(&WebApiMaintenanceClass::onCapturePost, this, _1));
+    router.on("/api/maintenance/capture/log", HTTP_GET, std::bind(&WebApiMaintenanceClass::onCaptureLogGet, this, _1));
+    server.on("/api/maintenance/capture/log", HTTP_POST,
+        std::bind(&WebApiMaintenanceClass::onCaptureLogPost, this, _1),
+        nullptr,
+        std::bind(&WebApiMaintenanceClass::onCaptureLogPostBody, this, _1, _2, _3, _4, _5));
 }
 
 void WebApiMaintenanceClass::onRebootPost(AsyncWebServerRequest* request)
@@ -51,3 +64,138 @@ void WebApiMaintenanceClass::onRebootPost(AsyncWebServerRequest* request)
         WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
     }
 }
+
+void WebApiMaintenanceClass::onCaptureGet(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentials(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto& root = response->getRoot();
+
+    static char const* const states[] = { "idle", "recording", "replaying" };
+    root["state"] = states[static_cast<uint8_t>(InputCapture.getState())];
+    root["sources"] = InputCapture.getSources();
+    root["used"] = InputCapture.getUsed();
+    root["capacity"] = InputCapture.getCapacity();
+    root["dropped"] = InputCapture.getDroppedRecords();
+    root["duration_ms"] = InputCapture.getDurationMillis();
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
+
+void WebApiMaintenanceClass::onCapturePost(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentials(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    JsonDocument root;
+    if (!WebApi.parseRequestData(request, response, root)) {
+        return;
+    }
+
+    auto& retMsg = response->getRoot();
+
+    if (!(root["action"].is<String>())) {
+        retMsg["message"] = "Values are missing!";
+        retMsg["code"] = WebApiError::GenericValueMissing;
+        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        return;
+    }
+
+    String action = root["action"].as<String>();
+    bool success = false;
+
+    if (action == "record") {
+        success = InputCapture.startRecording(root["sources"] | 0U);
+    } else if (action == "replay") {
+        success = InputCapture.startReplay(root["speed"] | 1U);
+    } else if (action == "stop") {
+        InputCapture.stop();
+        retMsg["type"] = "success";
+        retMsg["message"] = "Capture stopped!";
+        retMsg["code"] = WebApiError::MaintenanceCaptureStopped;
+        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        return;
+    }
+
+    if (success) {
+        retMsg["type"] = "success";
+        retMsg["message"] = "Capture started!";
+        retMsg["code"] = WebApiError::MaintenanceCaptureStarted;
+    } else {
+        retMsg["message"] = "Capture could not be started!";
+        retMsg["code"] = WebApiError::MaintenanceCaptureFailed;
+    }
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
+
+void WebApiMaintenanceClass::onCaptureLogGet(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentials(request)) {
+        return;
+    }
+
+    // the log is still growing while recording
+    if (InputCapture.getState() == InputCaptureClass::State::Recording) {
+        request->send(409);
+        return;
+    }
+
+    AsyncWebServerResponse* response = request->beginResponse("application/octet-stream", InputCapture.getLogSize(),
+        [](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            return InputCapture.readLog(index, buffer, maxLen);
+        });
+    response->addHeader("Content-Disposition", "attachment; filename=\"input.capture\"");
+    request->send(response);
+}
+
+// the body is written into the capture buffer as it arrives, the request's
+// temporary object only tells whether all parts fit
+void WebApiMaintenanceClass::onCaptureLogPostBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total)
+{
+    if (!WebApi.checkCredentials(request)) {
+        return;
+    }
+
+    if (index == 0 && request->_tempObject == nullptr) {
+        auto valid = static_cast<bool*>(malloc(sizeof(bool)));
+        if (valid == nullptr) { return; }
+        *valid = true;
+        request->_tempObject = valid;
+    }
+
+    auto valid = static_cast<bool*>(request->_tempObject);
+    if (valid == nullptr || !*valid) {
+        return;
+    }
+
+    *valid = InputCapture.load(index, data, len);
+}
+
+void WebApiMaintenanceClass::onCaptureLogPost(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentials(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto& retMsg = response->getRoot();
+
+    auto valid = static_cast<bool*>(request->_tempObject);
+    if (valid != nullptr && *valid && InputCapture.finishLoad(request->contentLength())) {
+        retMsg["type"] = "success";
+        retMsg["message"] = "Capture loaded!";
+        retMsg["code"] = WebApiError::MaintenanceCaptureLoaded;
+    } else {
+        retMsg["type"] = "warning";
+        retMsg["message"] = "Invalid capture!";
+        retMsg["code"] = WebApiError::MaintenanceCaptureInvalid;
+    }
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
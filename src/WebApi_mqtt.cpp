@@ -23,9 +23,10 @@ void WebApiMqttClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     using std::placeholders::_1;
 
-    server.on("/api/mqtt/status", HTTP_GET, std::bind(&WebApiMqttClass::onMqttStatus, this, _1));
-    server.on("/api/mqtt/config", HTTP_GET, std::bind(&WebApiMqttClass::onMqttAdminGet, this, _1));
-    server.on("/api/mqtt/config", HTTP_POST, std::bind(&WebApiMqttClass::onMqttAdminPost, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/mqtt/status", HTTP_GET, std::bind(&WebApiMqttClass::onMqttStatus, this, _1));
+    router.on("/api/mqtt/config", HTTP_GET, std::bind(&WebApiMqttClass::onMqttAdminGet, this, _1));
+    router.on("/api/mqtt/config", HTTP_POST, std::bind(&WebApiMqttClass::onMqttAdminPost, this, _1));
 }
 
 void WebApiMqttClass::onMqttStatus(AsyncWebServerRequest* request)
@@ -34,7 +35,7 @@ void WebApiMqttClass::onMqttStatus(AsyncWebServerRequest* request)
         return;
     }
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto response = new PooledJsonResponse(JsonDocumentPoolClass::SizeClass::Large);
     auto& root = response->getRoot();
     const CONFIG_T& config = Configuration.get();
 
@@ -48,17 +49,21 @@ void WebApiMqttClass::onMqttStatus(AsyncWebServerRequest* request)
     root["mqtt_connected"] = MqttSettings.getConnected();
     root["mqtt_retain"] = config.Mqtt.Retain;
     root["mqtt_tls"] = config.Mqtt.Tls.Enabled;
-    root["mqtt_root_ca_cert_info"] = getTlsCertInfo(config.Mqtt.Tls.RootCaCert);
+    root["mqtt_root_ca_cert_info"] = getTlsCertInfo(ConfigurationClass::readCertificate(ConfigurationClass::Certificate::RootCa).c_str());
     root["mqtt_tls_cert_login"] = config.Mqtt.Tls.CertLogin;
-    root["mqtt_client_cert_info"] = getTlsCertInfo(config.Mqtt.Tls.ClientCert);
+    root["mqtt_client_cert_info"] = getTlsCertInfo(ConfigurationClass::readCertificate(ConfigurationClass::Certificate::Client).c_str());
     root["mqtt_lwt_topic"] = String(config.Mqtt.Topic) + config.Mqtt.Lwt.Topic;
     root["mqtt_publish_interval"] = config.Mqtt.PublishInterval;
+    root["mqtt_publish_refresh_interval"] = config.Mqtt.PublishRefreshInterval;
+    root["mqtt_publish_deadband"] = config.Mqtt.PublishDeadband;
+    root["mqtt_inverter_json_payload"] = config.Mqtt.InverterJsonPayload;
     root["mqtt_clean_session"] = config.Mqtt.CleanSession;
     root["mqtt_hass_enabled"] = config.Mqtt.Hass.Enabled;
     root["mqtt_hass_expire"] = config.Mqtt.Hass.Expire;
     root["mqtt_hass_retain"] = config.Mqtt.Hass.Retain;
     root["mqtt_hass_topic"] = config.Mqtt.Hass.Topic;
     root["mqtt_hass_individualpanels"] = config.Mqtt.Hass.IndividualPanels;
+    root["mqtt_hass_devicediscovery"] = config.Mqtt.Hass.DeviceDiscovery;
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
@@ -83,21 +88,26 @@ void WebApiMqttClass::onMqttAdminGet(AsyncWebServerRequest* request)
     root["mqtt_topic"] = config.Mqtt.Topic;
     root["mqtt_retain"] = config.Mqtt.Retain;
     root["mqtt_tls"] = config.Mqtt.Tls.Enabled;
-    root["mqtt_root_ca_cert"] = config.Mqtt.Tls.RootCaCert;
+    root["mqtt_root_ca_cert"] = ConfigurationClass::readCertificate(ConfigurationClass::Certificate::RootCa);
     root["mqtt_tls_cert_login"] = config.Mqtt.Tls.CertLogin;
-    root["mqtt_client_cert"] = config.Mqtt.Tls.ClientCert;
-    root["mqtt_client_key"] = config.Mqtt.Tls.ClientKey;
+    root["mqtt_client_cert"] = ConfigurationClass::readCertificate(ConfigurationClass::Certificate::Client);
+    root["mqtt_client_key"] = ConfigurationClass::readCertificate(ConfigurationClass::Certificate::ClientKey);
     root["mqtt_lwt_topic"] = config.Mqtt.Lwt.Topic;
     root["mqtt_lwt_online"] = config.Mqtt.Lwt.Value_Online;
     root["mqtt_lwt_offline"] = config.Mqtt.Lwt.Value_Offline;
     root["mqtt_lwt_qos"] = config.Mqtt.Lwt.Qos;
     root["mqtt_publish_interval"] = config.Mqtt.PublishInterval;
+    root["mqtt_publish_refresh_interval"] = config.Mqtt.PublishRefreshInterval;
+    root["mqtt_publish_deadband"] = config.Mqtt.PublishDeadband;
+    root["mqtt_inverter_json_payload"] = config.Mqtt.InverterJsonPayload;
     root["mqtt_clean_session"] = config.Mqtt.CleanSession;
+    root["mqtt_outbox_limit"] = config.Mqtt.OutboxLimit;
     root["mqtt_hass_enabled"] = config.Mqtt.Hass.Enabled;
     root["mqtt_hass_expire"] = config.Mqtt.Hass.Expire;
     root["mqtt_hass_retain"] = config.Mqtt.Hass.Retain;
     root["mqtt_hass_topic"] = config.Mqtt.Hass.Topic;
     root["mqtt_hass_individualpanels"] = config.Mqtt.Hass.IndividualPanels;
+    root["mqtt_hass_devicediscovery"] = config.Mqtt.Hass.DeviceDiscovery;
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
@@ -134,6 +144,9 @@ void WebApiMqttClass::onMqttAdminPost(AsyncWebServerRequest* request)
             && root["mqtt_lwt_offline"].is<String>()
             && root["mqtt_lwt_qos"].is<uint8_t>()
             && root["mqtt_publish_interval"].is<uint32_t>()
+            && root["mqtt_publish_refresh_interval"].is<uint32_t>()
+            && root["mqtt_publish_deadband"].is<float>()
+            && root["mqtt_inverter_json_payload"].is<bool>()
             && root["mqtt_clean_session"].is<bool>()
             && root["mqtt_hass_enabled"].is<bool>()
             && root["mqtt_hass_expire"].is<bool>()
@@ -263,6 +276,24 @@ void WebApiMqttClass::onMqttAdminPost(AsyncWebServerRequest* request)
             return;
         }
 
+        if (root["mqtt_publish_refresh_interval"].as<uint32_t>() > 86400) {
+            retMsg["message"] = "Refresh interval must be a number between 0 and 86400!";
+            retMsg["code"] = WebApiError::MqttPublishRefreshInterval;
+            retMsg["param"]["min"] = 0;
+            retMsg["param"]["max"] = 86400;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+
+        if (root["mqtt_publish_deadband"].as<float>() < 0 || root["mqtt_publish_deadband"].as<float>() > 100) {
+            retMsg["message"] = "Deadband must be a number between 0 and 100!";
+            retMsg["code"] = WebApiError::MqttPublishDeadband;
+            retMsg["param"]["min"] = 0;
+            retMsg["param"]["max"] = 100;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+
         if (root["mqtt_hass_enabled"].as<bool>()) {
             if (root["mqtt_hass_topic"].as<String>().length() > MQTT_MAX_TOPIC_STRLEN) {
                 retMsg["message"] = "Hass topic must not be longer than " STR(MQTT_MAX_TOPIC_STRLEN) " characters!";
@@ -281,6 +312,17 @@ void WebApiMqttClass::onMqttAdminPost(AsyncWebServerRequest* request)
         }
     }
 
+    // the certificates are stored in files of their own, which are only
+    // written if the certificates changed
+    auto storeCertificate = [&root](char const* key, ConfigurationClass::Certificate which) {
+        String pem = root[key].as<String>();
+        if (pem == ConfigurationClass::readCertificate(which)) { return; }
+        ConfigurationClass::writeCertificate(which, pem);
+    };
+    storeCertificate("mqtt_root_ca_cert", ConfigurationClass::Certificate::RootCa);
+    storeCertificate("mqtt_client_cert", ConfigurationClass::Certificate::Client);
+    storeCertificate("mqtt_client_key", ConfigurationClass::Certificate::ClientKey);
+
     {
         auto guard = Configuration.getWriteGuard();
         auto& config = guard.getConfig();
@@ -289,10 +331,7 @@ void WebApiMqttClass::onMqttAdminPost(AsyncWebServerRequest* request)
         config.Mqtt.VerboseLogging = root["mqtt_verbose_logging"].as<bool>();
         config.Mqtt.Retain = root["mqtt_retain"].as<bool>();
         config.Mqtt.Tls.Enabled = root["mqtt_tls"].as<bool>();
-        strlcpy(config.Mqtt.Tls.RootCaCert, root["mqtt_root_ca_cert"].as<String>().c_str(), sizeof(config.Mqtt.Tls.RootCaCert));
         config.Mqtt.Tls.CertLogin = root["mqtt_tls_cert_login"].as<bool>();
-        strlcpy(config.Mqtt.Tls.ClientCert, root["mqtt_client_cert"].as<String>().c_str(), sizeof(config.Mqtt.Tls.ClientCert));
-        strlcpy(config.Mqtt.Tls.ClientKey, root["mqtt_client_key"].as<String>().c_str(), sizeof(config.Mqtt.Tls.ClientKey));
         config.Mqtt.Port = root["mqtt_port"].as<uint>();
         strlcpy(config.Mqtt.Hostname, root["mqtt_hostname"].as<String>().c_str(), sizeof(config.Mqtt.Hostname));
         strlcpy(config.Mqtt.ClientId, root["mqtt_clientid"].as<String>().c_str(), sizeof(config.Mqtt.ClientId));
@@ -303,11 +342,16 @@ void WebApiMqttClass::onMqttAdminPost(AsyncWebServerRequest* request)
         strlcpy(config.Mqtt.Lwt.Value_Offline, root["mqtt_lwt_offline"].as<String>().c_str(), sizeof(config.Mqtt.Lwt.Value_Offline));
         config.Mqtt.Lwt.Qos = root["mqtt_lwt_qos"].as<uint8_t>();
         config.Mqtt.PublishInterval = root["mqtt_publish_interval"].as<uint32_t>();
+        config.Mqtt.PublishRefreshInterval = root["mqtt_publish_refresh_interval"].as<uint32_t>();
+        config.Mqtt.PublishDeadband = root["mqtt_publish_deadband"].as<float>();
+        config.Mqtt.InverterJsonPayload = root["mqtt_inverter_json_payload"].as<bool>();
         config.Mqtt.CleanSession = root["mqtt_clean_session"].as<bool>();
+        config.Mqtt.OutboxLimit = root["mqtt_outbox_limit"].as<uint16_t>();
         config.Mqtt.Hass.Enabled = root["mqtt_hass_enabled"].as<bool>();
         config.Mqtt.Hass.Expire = root["mqtt_hass_expire"].as<bool>();
         config.Mqtt.Hass.Retain = root["mqtt_hass_retain"].as<bool>();
         config.Mqtt.Hass.IndividualPanels = root["mqtt_hass_individualpanels"].as<bool>();
+        config.Mqtt.Hass.DeviceDiscovery = root["mqtt_hass_devicediscovery"].as<bool>();
         strlcpy(config.Mqtt.Hass.Topic, root["mqtt_hass_topic"].as<String>().c_str(), sizeof(config.Mqtt.Hass.Topic));
 
         // Check if base topic was changed
@@ -324,7 +368,7 @@ void WebApiMqttClass::onMqttAdminPost(AsyncWebServerRequest* request)
         }
     }
 
-    WebApi.writeConfig(retMsg);
+    WebApi.writeConfig(retMsg, ConfigurationClass::Section::Mqtt);
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
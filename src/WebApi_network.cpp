@@ -9,9 +9,10 @@
 #include "WebApi_errors.h"
 #include "helper.h"
 #include <AsyncJson.h>
+#include "TaskProfiler.h"
 
 WebApiNetworkClass::WebApiNetworkClass()
-    : _applyDataTask(500 * TASK_MILLISECOND, TASK_ONCE, std::bind(&WebApiNetworkClass::applyDataTaskCb, this))
+    : _applyDataTask(500 * TASK_MILLISECOND, TASK_ONCE, TaskProfiler.wrap("WebApiNetwork::applyDataTaskCb", std::bind(&WebApiNetworkClass::applyDataTaskCb, this)))
 {
 }
 
@@ -19,9 +20,10 @@ void WebApiNetworkClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     using std::placeholders::_1;
 
-    server.on("/api/network/status", HTTP_GET, std::bind(&WebApiNetworkClass::onNetworkStatus, this, _1));
-    server.on("/api/network/config", HTTP_GET, std::bind(&WebApiNetworkClass::onNetworkAdminGet, this, _1));
-    server.on("/api/network/config", HTTP_POST, std::bind(&WebApiNetworkClass::onNetworkAdminPost, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/network/status", HTTP_GET, std::bind(&WebApiNetworkClass::onNetworkStatus, this, _1));
+    router.on("/api/network/config", HTTP_GET, std::bind(&WebApiNetworkClass::onNetworkAdminGet, this, _1));
+    router.on("/api/network/config", HTTP_POST, std::bind(&WebApiNetworkClass::onNetworkAdminPost, this, _1));
 
     scheduler.addTask(_applyDataTask);
 }
@@ -32,7 +34,7 @@ void WebApiNetworkClass::onNetworkStatus(AsyncWebServerRequest* request)
         return;
     }
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto response = new PooledJsonResponse(JsonDocumentPoolClass::SizeClass::Small);
     auto& root = response->getRoot();
 
     root["sta_status"] = ((WiFi.getMode() & WIFI_STA) != 0);
@@ -53,6 +55,24 @@ void WebApiNetworkClass::onNetworkStatus(AsyncWebServerRequest* request)
     root["ap_mac"] = WiFi.softAPmacAddress();
     root["ap_stationnum"] = WiFi.softAPgetStationNum();
 
+    auto w5500 = NetworkSettings.getW5500Stats();
+    if (w5500) {
+        auto w5500Obj = root["w5500"].to<JsonObject>();
+        w5500Obj["spi_clock"] = w5500->spi_clock_hz;
+        w5500Obj["rx_frames"] = w5500->rx_frames;
+        w5500Obj["rx_bytes"] = w5500->rx_bytes;
+        w5500Obj["rx_errors"] = w5500->rx_errors;
+        w5500Obj["rx_rate"] = w5500->rx_rate;
+        w5500Obj["rx_latency_avg"] = w5500->rx_latency_avg_us;
+        w5500Obj["rx_latency_max"] = w5500->rx_latency_max_us;
+        w5500Obj["tx_frames"] = w5500->tx_frames;
+        w5500Obj["tx_bytes"] = w5500->tx_bytes;
+        w5500Obj["tx_errors"] = w5500->tx_errors;
+        w5500Obj["tx_rate"] = w5500->tx_rate;
+        w5500Obj["tx_latency_avg"] = w5500->tx_latency_avg_us;
+        w5500Obj["tx_latency_max"] = w5500->tx_latency_max_us;
+    }
+
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
 
@@ -76,10 +96,23 @@ void WebApiNetworkClass::onNetworkAdminGet(AsyncWebServerRequest* request)
     root["ssid"] = config.WiFi.Ssid;
     root["password"] = config.WiFi.Password;
     root["aptimeout"] = config.WiFi.ApTimeout;
+    root["powersave"] = config.WiFi.PowerSave;
+    root["failover"] = config.WiFi.Failover;
     root["mdnsenabled"] = config.Mdns.Enabled;
     root["syslogenabled"] = config.Syslog.Enabled;
     root["sysloghostname"] = config.Syslog.Hostname;
     root["syslogport"] = config.Syslog.Port;
+    root["syslogprotocol"] = config.Syslog.Protocol;
+    root["influxenabled"] = config.Influx.Enabled;
+    root["influxhostname"] = config.Influx.Hostname;
+    root["influxport"] = config.Influx.Port;
+    root["influxprotocol"] = config.Influx.Protocol;
+    root["influxinterval"] = config.Influx.Interval;
+    root["influxpath"] = config.Influx.Path;
+    root["influxtoken"] = config.Influx.Token;
+    root["modbusenabled"] = config.Modbus.Enabled;
+    root["modbusport"] = config.Modbus.Port;
+    root["modbuswriteenabled"] = config.Modbus.WriteEnabled;
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
@@ -189,6 +222,68 @@ void WebApiNetworkClass::onNetworkAdminPost(AsyncWebServerRequest* request)
             return;
         }
 
+        if (root["syslogprotocol"].as<uint>() > 1) {
+            retMsg["message"] = "Syslog protocol must be UDP or TCP!";
+            retMsg["code"] = WebApiError::NetworkSyslogProtocol;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+
+    }
+    if (root["influxenabled"].as<bool>()) {
+        if (root["influxhostname"].as<String>().length() == 0 || root["influxhostname"].as<String>().length() > INFLUX_MAX_HOSTNAME_STRLEN) {
+            retMsg["message"] = "InfluxDB Server must between 1 and " STR(INFLUX_MAX_HOSTNAME_STRLEN) " characters long!";
+            retMsg["code"] = WebApiError::NetworkInfluxHostnameLength;
+            retMsg["param"]["max"] = INFLUX_MAX_HOSTNAME_STRLEN;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+
+        if (root["influxport"].as<uint>() == 0 || root["influxport"].as<uint>() > 65535) {
+            retMsg["message"] = "Port must be a number between 1 and 65535!";
+            retMsg["code"] = WebApiError::NetworkInfluxPort;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+
+        if (root["influxprotocol"].as<uint>() > 1) {
+            retMsg["message"] = "InfluxDB protocol must be UDP or HTTP!";
+            retMsg["code"] = WebApiError::NetworkInfluxProtocol;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+
+        if (root["influxinterval"].as<uint>() == 0 || root["influxinterval"].as<uint>() > 3600) {
+            retMsg["message"] = "Interval must be a number between 1 and 3600!";
+            retMsg["code"] = WebApiError::NetworkInfluxInterval;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+
+        String path = root["influxpath"].as<String>();
+        if (path.length() > INFLUX_MAX_PATH_STRLEN || (root["influxprotocol"].as<uint>() == 1 && !path.startsWith("/"))) {
+            retMsg["message"] = "Path must start with a slash and must not be longer than " STR(INFLUX_MAX_PATH_STRLEN) " characters!";
+            retMsg["code"] = WebApiError::NetworkInfluxPathLength;
+            retMsg["param"]["max"] = INFLUX_MAX_PATH_STRLEN;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+
+        if (root["influxtoken"].as<String>().length() > INFLUX_MAX_TOKEN_STRLEN) {
+            retMsg["message"] = "Token must not be longer than " STR(INFLUX_MAX_TOKEN_STRLEN) " characters!";
+            retMsg["code"] = WebApiError::NetworkInfluxTokenLength;
+            retMsg["param"]["max"] = INFLUX_MAX_TOKEN_STRLEN;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+    }
+    if (root["modbusenabled"].as<bool>()) {
+        if (root["modbusport"].as<uint>() == 0 || root["modbusport"].as<uint>() > 65535) {
+            retMsg["message"] = "Port must be a number between 1 and 65535!";
+            retMsg["code"] = WebApiError::NetworkModbusPort;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
     }
 
     {
@@ -224,14 +319,29 @@ void WebApiNetworkClass::onNetworkAdminPost(AsyncWebServerRequest* request)
             config.WiFi.Dhcp = false;
         }
         config.WiFi.ApTimeout = root["aptimeout"].as<uint>();
+        config.WiFi.PowerSave = root["powersave"].as<bool>();
+        config.WiFi.Failover = root["failover"].as<bool>();
         config.Mdns.Enabled = root["mdnsenabled"].as<bool>();
 
         config.Syslog.Enabled = root["syslogenabled"].as<bool>();
         strlcpy(config.Syslog.Hostname, root["sysloghostname"].as<String>().c_str(), sizeof(config.Syslog.Hostname));
         config.Syslog.Port = root["syslogport"].as<uint>();
+        config.Syslog.Protocol = root["syslogprotocol"].as<uint8_t>();
+
+        config.Influx.Enabled = root["influxenabled"].as<bool>();
+        strlcpy(config.Influx.Hostname, root["influxhostname"].as<String>().c_str(), sizeof(config.Influx.Hostname));
+        config.Influx.Port = root["influxport"].as<uint>();
+        config.Influx.Protocol = root["influxprotocol"].as<uint8_t>();
+        config.Influx.Interval = root["influxinterval"].as<uint>();
+        strlcpy(config.Influx.Path, root["influxpath"].as<String>().c_str(), sizeof(config.Influx.Path));
+        strlcpy(config.Influx.Token, root["influxtoken"].as<String>().c_str(), sizeof(config.Influx.Token));
+
+        config.Modbus.Enabled = root["modbusenabled"].as<bool>();
+        config.Modbus.Port = root["modbusport"].as<uint>();
+        config.Modbus.WriteEnabled = root["modbuswriteenabled"].as<bool>();
     }
 
-    WebApi.writeConfig(retMsg);
+    WebApi.writeConfig(retMsg, ConfigurationClass::Section::Network);
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
@@ -15,11 +15,12 @@ void WebApiNtpClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     using std::placeholders::_1;
 
-    server.on("/api/ntp/status", HTTP_GET, std::bind(&WebApiNtpClass::onNtpStatus, this, _1));
-    server.on("/api/ntp/config", HTTP_GET, std::bind(&WebApiNtpClass::onNtpAdminGet, this, _1));
-    server.on("/api/ntp/config", HTTP_POST, std::bind(&WebApiNtpClass::onNtpAdminPost, this, _1));
-    server.on("/api/ntp/time", HTTP_GET, std::bind(&WebApiNtpClass::onNtpTimeGet, this, _1));
-    server.on("/api/ntp/time", HTTP_POST, std::bind(&WebApiNtpClass::onNtpTimePost, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/ntp/status", HTTP_GET, std::bind(&WebApiNtpClass::onNtpStatus, this, _1));
+    router.on("/api/ntp/config", HTTP_GET, std::bind(&WebApiNtpClass::onNtpAdminGet, this, _1));
+    router.on("/api/ntp/config", HTTP_POST, std::bind(&WebApiNtpClass::onNtpAdminPost, this, _1));
+    router.on("/api/ntp/time", HTTP_GET, std::bind(&WebApiNtpClass::onNtpTimeGet, this, _1));
+    router.on("/api/ntp/time", HTTP_POST, std::bind(&WebApiNtpClass::onNtpTimePost, this, _1));
 }
 
 void WebApiNtpClass::onNtpStatus(AsyncWebServerRequest* request)
@@ -28,7 +29,7 @@ void WebApiNtpClass::onNtpStatus(AsyncWebServerRequest* request)
         return;
     }
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto response = new PooledJsonResponse(JsonDocumentPoolClass::SizeClass::Small);
     auto& root = response->getRoot();
     const CONFIG_T& config = Configuration.get();
 
@@ -147,7 +148,7 @@ void WebApiNtpClass::onNtpAdminPost(AsyncWebServerRequest* request)
         config.Ntp.SunsetType = root["sunsettype"].as<uint8_t>();
     }
 
-    WebApi.writeConfig(retMsg);
+    WebApi.writeConfig(retMsg, ConfigurationClass::Section::Ntp);
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
@@ -163,7 +164,7 @@ void WebApiNtpClass::onNtpTimeGet(AsyncWebServerRequest* request)
         return;
     }
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto response = new PooledJsonResponse(JsonDocumentPoolClass::SizeClass::Small);
     auto& root = response->getRoot();
 
     struct tm timeinfo;
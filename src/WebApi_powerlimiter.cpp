@@ -6,12 +6,16 @@
 #include "ArduinoJson.h"
 #include "AsyncJson.h"
 #include "Configuration.h"
+#include "ControlLatency.h"
 #include "MqttHandlePowerLimiterHass.h"
 #include "PowerLimiter.h"
 #include "WebApi.h"
 #include "helper.h"
 #include "WebApi_errors.h"
 #include "Configuration.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 void WebApiPowerLimiterClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
@@ -19,10 +23,15 @@ void WebApiPowerLimiterClass::init(AsyncWebServer& server, Scheduler& scheduler)
 
     _server = &server;
 
-    _server->on("/api/powerlimiter/status", HTTP_GET, std::bind(&WebApiPowerLimiterClass::onStatus, this, _1));
-    _server->on("/api/powerlimiter/config", HTTP_GET, std::bind(&WebApiPowerLimiterClass::onAdminGet, this, _1));
-    _server->on("/api/powerlimiter/config", HTTP_POST, std::bind(&WebApiPowerLimiterClass::onAdminPost, this, _1));
-    _server->on("/api/powerlimiter/metadata", HTTP_GET, std::bind(&WebApiPowerLimiterClass::onMetaData, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/powerlimiter/status", HTTP_GET, std::bind(&WebApiPowerLimiterClass::onStatus, this, _1));
+    router.on("/api/powerlimiter/config", HTTP_GET, std::bind(&WebApiPowerLimiterClass::onAdminGet, this, _1));
+    router.on("/api/powerlimiter/config", HTTP_POST, std::bind(&WebApiPowerLimiterClass::onAdminPost, this, _1));
+    router.on("/api/powerlimiter/metadata", HTTP_GET, std::bind(&WebApiPowerLimiterClass::onMetaData, this, _1));
+    router.on("/api/powerlimiter/trace", HTTP_GET, std::bind(&WebApiPowerLimiterClass::onTrace, this, _1));
+    router.on("/api/powerlimiter/latency", HTTP_GET, std::bind(&WebApiPowerLimiterClass::onLatency, this, _1));
+    router.on("/api/powerlimiter/shadow", HTTP_GET, std::bind(&WebApiPowerLimiterClass::onShadow, this, _1));
+    router.on("/api/powerlimiter/scorecard", HTTP_GET, std::bind(&WebApiPowerLimiterClass::onScorecard, this, _1));
 }
 
 void WebApiPowerLimiterClass::onStatus(AsyncWebServerRequest* request)
@@ -42,21 +51,21 @@ void WebApiPowerLimiterClass::onMetaData(AsyncWebServerRequest* request)
 {
     if (!WebApi.checkCredentials(request)) { return; }
 
-    auto const& config = Configuration.get();
-
-    AsyncJsonResponse* response = new AsyncJsonResponse();
-    auto& root = response->getRoot();
+    // the inverters are serialized one at a time while sending
+    JsonStreamResponse stream;
 
-    root["power_meter_enabled"] = config.PowerMeter.Enabled;
-    root["battery_enabled"] = config.Battery.Enabled;
-    root["charge_controller_enabled"] = config.SolarCharger.Enabled;
+    stream.addMembers([](JsonObject root) {
+        auto const& config = Configuration.get();
+        root["power_meter_enabled"] = config.PowerMeter.Enabled;
+        root["battery_enabled"] = config.Battery.Enabled;
+        root["charge_controller_enabled"] = config.SolarCharger.Enabled;
+    });
 
-    JsonArray inverters = root["inverters"].to<JsonArray>();
-    for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
+    stream.addArray("inverters", INV_MAX_COUNT, [](size_t i, JsonObject obj) {
+        auto const& config = Configuration.get();
         auto inv = Hoymiles.getInverterBySerial(config.Inverter[i].Serial);
-        if (!inv) { continue; }
+        if (!inv) { return false; }
 
-        JsonObject obj = inverters.add<JsonObject>();
         obj["serial"] = inv->serialString();
         obj["pos"] = i;
         obj["order"] = config.Inverter[i].Order;
@@ -70,11 +79,160 @@ void WebApiPowerLimiterClass::onMetaData(AsyncWebServerRequest* request)
         auto channels = inv->Statistics()->getChannelsByType(TYPE_DC);
         obj["channels"] = channels.size();
         obj["pdl_supported"] = inv->supportsPowerDistributionLogic();
+        return true;
+    });
+
+    stream.send(request);
+}
+
+void WebApiPowerLimiterClass::onLatency(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto root = response->getRoot().as<JsonObject>();
+
+    // all durations in milliseconds
+    for (size_t i = 0; i < ControlLatencyClass::MetricCount; ++i) {
+        auto metric = static_cast<ControlLatencyClass::Metric>(i);
+        auto summary = ControlLatency.getSummary(metric);
+
+        auto obj = root[ControlLatencyClass::getName(metric)].to<JsonObject>();
+        obj["count"] = summary.Count;
+        obj["samples"] = summary.Samples;
+        obj["p50"] = summary.P50;
+        obj["p90"] = summary.P90;
+        obj["p99"] = summary.P99;
+        obj["max"] = summary.Max;
+        obj["alert"] = summary.Alert;
+    }
+
+    root["meter_jitter"] = ControlLatency.getMeterJitter();
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
+
+void WebApiPowerLimiterClass::onShadow(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto root = response->getRoot().as<JsonObject>();
+
+    auto summary = PowerLimiter.getShadow().getSummary();
+    root["enabled"] = Configuration.get().PowerLimiter.Shadow.Enabled;
+    root["active"] = summary.Active;
+    root["cycles"] = summary.Cycles;
+    root["seconds"] = summary.Seconds;
+    root["limit"] = summary.LimitWatts;
+    root["discharge"] = summary.Discharge;
+
+    auto addTotals = [&root](char const* key, PowerLimiterShadow::Totals const& totals) {
+        auto obj = root[key].to<JsonObject>();
+        obj["import_wh"] = std::round(totals.ImportWh * 100) / 100;
+        obj["export_wh"] = std::round(totals.ExportWh * 100) / 100;
+        obj["commands"] = totals.Commands;
+        obj["flaps"] = totals.Flaps;
+    };
+
+    addTotals("live", summary.Live);
+    addTotals("shadow", summary.Shadow);
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
+
+void WebApiPowerLimiterClass::onScorecard(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto root = response->getRoot().as<JsonObject>();
+
+    auto addResult = [](JsonObject obj, char const* key, std::optional<PowerLimiterScorecard::Result> const& oResult) {
+        if (!oResult) { return; }
+
+        auto const& res = *oResult;
+        auto result = obj[key].to<JsonObject>();
+        result["start"] = res.Start;
+        result["seconds"] = res.Seconds;
+        result["active_seconds"] = res.ActiveSeconds;
+        result["import_wh"] = std::round(res.ImportWh * 100) / 100;
+        result["export_wh"] = std::round(res.ExportWh * 100) / 100;
+        result["commands"] = res.Commands;
+        result["reactions"] = res.Reactions;
+        if (res.oMeanAbsErrorWatts) { result["mean_abs_error"] = std::round(*res.oMeanAbsErrorWatts * 10) / 10; }
+        if (res.oMeanReactionMillis) { result["mean_reaction"] = std::lround(*res.oMeanReactionMillis); }
+
+        auto status = result["status"].to<JsonObject>();
+        for (size_t s = 0; s < PowerLimiterScorecard::StatusCount; ++s) {
+            auto key = PowerLimiterClass::getStatusKey(static_cast<PowerLimiterClass::Status>(s));
+            status[key] = std::round(res.StatusPercent[s] * 10) / 10;
+        }
+    };
+
+    auto const& scorecard = PowerLimiter.getScorecard();
+    for (size_t w = 0; w < PowerLimiterScorecard::WindowCount; ++w) {
+        auto window = static_cast<PowerLimiterScorecard::Window>(w);
+        auto obj = root[PowerLimiterScorecard::getName(window)].to<JsonObject>();
+        addResult(obj, "current", scorecard.getCurrent(window));
+        addResult(obj, "completed", scorecard.getCompleted(window));
     }
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
 
+void WebApiPowerLimiterClass::onTrace(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentials(request)) { return; }
+
+    auto range = PowerLimiter.getTrace().getSequenceRange();
+
+    PowerLimiterTrace::Header header;
+    memcpy(header.Magic, "DPLT", sizeof(header.Magic));
+    header.Version = 1;
+    header.MaxInverters = INV_MAX_COUNT;
+    header.RecordSize = sizeof(PowerLimiterTrace::Record);
+    header.Count = range.second - range.first;
+    header.Millis = millis();
+
+    // the records are copied one at a time while sending. the response ends
+    // early if records are overwritten before they were sent.
+    auto response = request->beginChunkedResponse("application/octet-stream",
+        [header, range](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            size_t written = 0;
+
+            if (index < sizeof(header)) {
+                written = std::min(maxLen, sizeof(header) - index);
+                memcpy(buffer, reinterpret_cast<uint8_t const*>(&header) + index, written);
+            }
+
+            while (written < maxLen) {
+                size_t offset = index + written - sizeof(header);
+                uint32_t sequence = range.first + offset / sizeof(PowerLimiterTrace::Record);
+                if (sequence >= range.second) { break; }
+
+                PowerLimiterTrace::Record record;
+                if (!PowerLimiter.getTrace().read(sequence, record)) { break; }
+
+                size_t inRecord = offset % sizeof(record);
+                size_t len = std::min(maxLen - written, sizeof(record) - inRecord);
+                memcpy(buffer + written, reinterpret_cast<uint8_t const*>(&record) + inRecord, len);
+                written += len;
+            }
+
+            return written;
+        });
+
+    response->addHeader("Content-Disposition", "attachment; filename=\"dpl_trace.bin\"");
+    request->send(response);
+}
+
 void WebApiPowerLimiterClass::onAdminGet(AsyncWebServerRequest* request)
 {
     if (!WebApi.checkCredentials(request)) {
@@ -104,7 +262,7 @@ void WebApiPowerLimiterClass::onAdminPost(AsyncWebServerRequest* request)
         ConfigurationClass::deserializePowerLimiterConfig(root.as<JsonObject>(), config.PowerLimiter);
     }
 
-    WebApi.writeConfig(retMsg);
+    WebApi.writeConfig(retMsg, ConfigurationClass::Section::PowerLimiter);
 
     response->setLength();
     request->send(response);
@@ -5,13 +5,19 @@
 #include "WebApi_powermeter.h"
 #include "ArduinoJson.h"
 #include "AsyncJson.h"
+#include "ConfigFields.h"
 #include "Configuration.h"
 #include "MqttHandleHass.h"
 #include "MqttSettings.h"
 #include "PowerLimiter.h"
+#include "Features.h"
 #include <powermeter/Controller.h>
+#if FEATURE_POWERMETER_HTTP_JSON
 #include <powermeter/json/http/Provider.h>
+#endif
+#if FEATURE_POWERMETER_HTTP_SML
 #include <powermeter/sml/http/Provider.h>
+#endif
 #include "WebApi.h"
 #include "helper.h"
 
@@ -21,11 +27,13 @@ void WebApiPowerMeterClass::init(AsyncWebServer& server, Scheduler& scheduler)
 
     _server = &server;
 
-    _server->on("/api/powermeter/status", HTTP_GET, std::bind(&WebApiPowerMeterClass::onStatus, this, _1));
-    _server->on("/api/powermeter/config", HTTP_GET, std::bind(&WebApiPowerMeterClass::onAdminGet, this, _1));
-    _server->on("/api/powermeter/config", HTTP_POST, std::bind(&WebApiPowerMeterClass::onAdminPost, this, _1));
-    _server->on("/api/powermeter/testhttpjsonrequest", HTTP_POST, std::bind(&WebApiPowerMeterClass::onTestHttpJsonRequest, this, _1));
-    _server->on("/api/powermeter/testhttpsmlrequest", HTTP_POST, std::bind(&WebApiPowerMeterClass::onTestHttpSmlRequest, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/powermeter/status", HTTP_GET, std::bind(&WebApiPowerMeterClass::onStatus, this, _1));
+    router.on("/api/powermeter/config", HTTP_GET, std::bind(&WebApiPowerMeterClass::onAdminGet, this, _1));
+    router.on("/api/powermeter/config", HTTP_POST, std::bind(&WebApiPowerMeterClass::onAdminPost, this, _1));
+    router.on("/api/powermeter/diagnostics", HTTP_GET, std::bind(&WebApiPowerMeterClass::onDiagnostics, this, _1));
+    router.on("/api/powermeter/testhttpjsonrequest", HTTP_POST, std::bind(&WebApiPowerMeterClass::onTestHttpJsonRequest, this, _1));
+    router.on("/api/powermeter/testhttpsmlrequest", HTTP_POST, std::bind(&WebApiPowerMeterClass::onTestHttpSmlRequest, this, _1));
 }
 
 void WebApiPowerMeterClass::onStatus(AsyncWebServerRequest* request)
@@ -42,6 +50,15 @@ void WebApiPowerMeterClass::onStatus(AsyncWebServerRequest* request)
     root["verbose_logging"] = config.PowerMeter.VerboseLogging;
     root["source"] = config.PowerMeter.Source;
 
+    auto availableSources = root["available_sources"].to<JsonArray>();
+    for (uint8_t source = 0; source < Features::PowerMeterProviderCount; ++source) {
+        if (Features::isPowerMeterProviderAvailable(static_cast<::PowerMeters::Provider::Type>(source))) {
+            availableSources.add(source);
+        }
+    }
+
+    root["predictive_filter"] = config.PowerMeter.PredictiveFilter;
+
     auto mqtt = root["mqtt"].to<JsonObject>();
     Configuration.serializePowerMeterMqttConfig(config.PowerMeter.Mqtt, mqtt);
 
@@ -54,6 +71,18 @@ void WebApiPowerMeterClass::onStatus(AsyncWebServerRequest* request)
     auto httpSml = root["http_sml"].to<JsonObject>();
     Configuration.serializePowerMeterHttpSmlConfig(config.PowerMeter.HttpSml, httpSml);
 
+    auto udpSmaHm = root["udp_smahm"].to<JsonObject>();
+    Configuration.serializePowerMeterUdpSmaHmConfig(config.PowerMeter.UdpSmaHm, udpSmaHm);
+
+    auto udpPush = root["udp_push"].to<JsonObject>();
+    Configuration.serializePowerMeterUdpPushConfig(config.PowerMeter.UdpPush, udpPush);
+
+    auto shellyRpc = root["shelly_rpc"].to<JsonObject>();
+    Configuration.serializePowerMeterShellyRpcConfig(config.PowerMeter.ShellyRpc, shellyRpc);
+
+    auto fusion = root["fusion"].to<JsonObject>();
+    Configuration.serializePowerMeterFusionConfig(config.PowerMeter.Fusion, fusion);
+
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
 
@@ -87,6 +116,24 @@ void WebApiPowerMeterClass::onAdminPost(AsyncWebServerRequest* request)
         return;
     }
 
+    char const* invalidKey = ConfigFields::validate(ConfigFields::PowerMeterSerialSdm, root["serial_sdm"].as<JsonObject>());
+    if (!invalidKey) {
+        invalidKey = ConfigFields::validate(ConfigFields::PowerMeterFusion, root["fusion"].as<JsonObject>());
+    }
+    if (!invalidKey) {
+        invalidKey = ConfigFields::validate(ConfigFields::PowerMeterUdpPush, root["udp_push"].as<JsonObject>());
+    }
+    if (!invalidKey) {
+        invalidKey = ConfigFields::validate(ConfigFields::PowerMeterShellyRpc, root["shelly_rpc"].as<JsonObject>());
+    }
+    if (invalidKey) {
+        retMsg["message"] = String("Value of ") + invalidKey + " is out of range!";
+        retMsg["code"] = WebApiError::GenericValueOutOfRange;
+        response->setLength();
+        request->send(response);
+        return;
+    }
+
     auto checkHttpConfig = [&](JsonObject const& cfg) -> bool {
         if (!cfg["url"].is<String>()
                 || (!cfg["url"].as<String>().startsWith("http://")
@@ -116,7 +163,36 @@ void WebApiPowerMeterClass::onAdminPost(AsyncWebServerRequest* request)
         return true;
     };
 
-    if (static_cast<::PowerMeters::Provider::Type>(root["source"].as<uint8_t>()) == ::PowerMeters::Provider::Type::HTTP_JSON) {
+    JsonObject fusion = root["fusion"];
+    bool fusionEnabled = fusion["enabled"].as<bool>();
+
+    if (fusionEnabled && fusion["source"].as<uint8_t>() == root["source"].as<uint8_t>()) {
+        retMsg["message"] = "Secondary power meter source must differ from the primary source!";
+        response->setLength();
+        request->send(response);
+        return;
+    }
+
+    auto isAvailable = [](JsonVariant source) {
+        return Features::isPowerMeterProviderAvailable(
+                static_cast<::PowerMeters::Provider::Type>(source.as<uint8_t>()));
+    };
+    if (!isAvailable(root["source"]) || (fusionEnabled && !isAvailable(fusion["source"]))) {
+        retMsg["message"] = "Power meter source is not available in this build!";
+        response->setLength();
+        request->send(response);
+        return;
+    }
+
+    // the configuration of a source is only validated if it is actually used
+    auto isSourceUsed = [&](::PowerMeters::Provider::Type type) -> bool {
+        auto isType = [type](JsonVariant source) {
+            return static_cast<::PowerMeters::Provider::Type>(source.as<uint8_t>()) == type;
+        };
+        return isType(root["source"]) || (fusionEnabled && isType(fusion["source"]));
+    };
+
+    if (isSourceUsed(::PowerMeters::Provider::Type::HTTP_JSON)) {
         JsonObject httpJson = root["http_json"];
         JsonArray valueConfigs = httpJson["values"];
         for (uint8_t i = 0; i < valueConfigs.size(); i++) {
@@ -142,19 +218,32 @@ void WebApiPowerMeterClass::onAdminPost(AsyncWebServerRequest* request)
         }
     }
 
-    if (static_cast<::PowerMeters::Provider::Type>(root["source"].as<uint8_t>()) == ::PowerMeters::Provider::Type::HTTP_SML) {
+    if (isSourceUsed(::PowerMeters::Provider::Type::HTTP_SML)) {
         JsonObject httpSml = root["http_sml"];
         if (!checkHttpConfig(httpSml["http_request"].as<JsonObject>())) {
             return;
         }
     }
 
+    if (isSourceUsed(::PowerMeters::Provider::Type::SHELLY_RPC)) {
+        JsonObject shellyRpc = root["shelly_rpc"];
+        if (!shellyRpc["hostname"].is<String>()
+                || shellyRpc["hostname"].as<String>().length() == 0
+                || shellyRpc["hostname"].as<String>().length() > POWERMETER_SHELLY_MAX_HOSTNAME_STRLEN) {
+            retMsg["message"] = "Shelly hostname must be between 1 and " STR(POWERMETER_SHELLY_MAX_HOSTNAME_STRLEN) " characters long!";
+            response->setLength();
+            request->send(response);
+            return;
+        }
+    }
+
     {
         auto guard = Configuration.getWriteGuard();
         auto& config = guard.getConfig();
         config.PowerMeter.Enabled = root["enabled"].as<bool>();
         config.PowerMeter.VerboseLogging = root["verbose_logging"].as<bool>();
         config.PowerMeter.Source = root["source"].as<uint8_t>();
+        config.PowerMeter.PredictiveFilter = root["predictive_filter"].as<bool>();
 
         Configuration.deserializePowerMeterMqttConfig(root["mqtt"].as<JsonObject>(),
                 config.PowerMeter.Mqtt);
@@ -167,15 +256,72 @@ void WebApiPowerMeterClass::onAdminPost(AsyncWebServerRequest* request)
 
         Configuration.deserializePowerMeterHttpSmlConfig(root["http_sml"].as<JsonObject>(),
                 config.PowerMeter.HttpSml);
+
+        Configuration.deserializePowerMeterUdpSmaHmConfig(root["udp_smahm"].as<JsonObject>(),
+                config.PowerMeter.UdpSmaHm);
+
+        Configuration.deserializePowerMeterUdpPushConfig(root["udp_push"].as<JsonObject>(),
+                config.PowerMeter.UdpPush);
+
+        Configuration.deserializePowerMeterShellyRpcConfig(root["shelly_rpc"].as<JsonObject>(),
+                config.PowerMeter.ShellyRpc);
+
+        Configuration.deserializePowerMeterFusionConfig(root["fusion"].as<JsonObject>(),
+                config.PowerMeter.Fusion);
     }
 
-    WebApi.writeConfig(retMsg);
+    WebApi.writeConfig(retMsg, ConfigurationClass::Section::PowerMeter);
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
     PowerMeter.updateSettings();
 }
 
+void WebApiPowerMeterClass::onDiagnostics(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    using Diagnostics = ::PowerMeters::Diagnostics;
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto root = response->getRoot().as<JsonObject>();
+
+    // all durations in microseconds
+    auto bounds = root["bounds"].to<JsonObject>();
+    for (size_t m = 0; m < Diagnostics::MetricCount; ++m) {
+        auto metric = static_cast<Diagnostics::Metric>(m);
+        auto array = bounds[Diagnostics::getName(metric)].to<JsonArray>();
+        for (auto bound : Diagnostics::getBounds(metric)) { array.add(bound); }
+    }
+
+    auto sources = root["sources"].to<JsonArray>();
+    for (auto const& source : PowerMeter.getDiagnostics()) {
+        auto obj = sources.add<JsonObject>();
+        obj["source"] = static_cast<unsigned>(source.Type);
+        obj["key"] = source.Key;
+
+        auto metrics = obj["metrics"].to<JsonObject>();
+        for (size_t m = 0; m < Diagnostics::MetricCount; ++m) {
+            auto const& histogram = source.Snapshot.Metrics[m];
+            auto metric = metrics[Diagnostics::getName(static_cast<Diagnostics::Metric>(m))].to<JsonObject>();
+            metric["count"] = histogram.Count;
+            metric["sum"] = histogram.Sum;
+
+            auto buckets = metric["buckets"].to<JsonArray>();
+            for (auto count : histogram.Buckets) { buckets.add(count); }
+        }
+
+        auto failures = obj["failures"].to<JsonObject>();
+        for (size_t f = 0; f < Diagnostics::FailureCount; ++f) {
+            failures[Diagnostics::getName(static_cast<Diagnostics::Failure>(f))] = source.Snapshot.Failures[f];
+        }
+    }
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
+
 void WebApiPowerMeterClass::onTestHttpJsonRequest(AsyncWebServerRequest* request)
 {
     if (!WebApi.checkCredentials(request)) {
@@ -192,6 +338,7 @@ void WebApiPowerMeterClass::onTestHttpJsonRequest(AsyncWebServerRequest* request
 
     char response[256];
 
+#if FEATURE_POWERMETER_HTTP_JSON
     auto powerMeterConfig = std::make_unique<PowerMeterHttpJsonConfig>();
     Configuration.deserializePowerMeterHttpJsonConfig(root["http_json"].as<JsonObject>(),
             *powerMeterConfig);
@@ -211,6 +358,9 @@ void WebApiPowerMeterClass::onTestHttpJsonRequest(AsyncWebServerRequest* request
     } else {
         snprintf(response, sizeof(response), "%s", std::get<String>(res).c_str());
     }
+#else
+    snprintf(response, sizeof(response), "Not available in this build");
+#endif
 
     retMsg["message"] = response;
     asyncJsonResponse->setLength();
@@ -233,6 +383,7 @@ void WebApiPowerMeterClass::onTestHttpSmlRequest(AsyncWebServerRequest* request)
 
     char response[256];
 
+#if FEATURE_POWERMETER_HTTP_SML
     auto powerMeterConfig = std::make_unique<PowerMeterHttpSmlConfig>();
     Configuration.deserializePowerMeterHttpSmlConfig(root["http_sml"].as<JsonObject>(),
             *powerMeterConfig);
@@ -245,6 +396,9 @@ void WebApiPowerMeterClass::onTestHttpSmlRequest(AsyncWebServerRequest* request)
     } else {
         snprintf(response, sizeof(response), "%s", res.c_str());
     }
+#else
+    snprintf(response, sizeof(response), "Not available in this build");
+#endif
 
     retMsg["message"] = response;
     asyncJsonResponse->setLength();
@@ -5,17 +5,27 @@
  */
 #include "WebApi_prometheus.h"
 #include "Configuration.h"
+#include "ControlLatency.h"
+#include "EnergyMeter.h"
 #include "MessageOutput.h"
 #include "NetworkSettings.h"
+#include "PowerLimiter.h"
+#include "Utils.h"
 #include "WebApi.h"
+#include <battery/Controller.h>
 #include <Hoymiles.h>
+#include <powermeter/Controller.h>
+#include <solarcharger/Controller.h>
 #include "__compiled_constants.h"
+#include <algorithm>
+#include <cstdarg>
 
 void WebApiPrometheusClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     using std::placeholders::_1;
 
-    server.on("/api/prometheus/metrics", HTTP_GET, std::bind(&WebApiPrometheusClass::onPrometheusMetricsGet, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/prometheus/metrics", HTTP_GET, std::bind(&WebApiPrometheusClass::onPrometheusMetricsGet, this, _1));
 }
 
 void WebApiPrometheusClass::onPrometheusMetricsGet(AsyncWebServerRequest* request)
@@ -25,157 +35,728 @@ void WebApiPrometheusClass::onPrometheusMetricsGet(AsyncWebServerRequest* reques
     }
 
     try {
-        auto stream = request->beginResponseStream("text/plain; charset=utf-8", 4096 * INV_MAX_COUNT); // TODO(helge) check if this calculation is correct
+        auto writer = std::make_shared<MetricsWriter>();
 
-        stream->print("# HELP opendtu_build Build info\n");
-        stream->print("# TYPE opendtu_build gauge\n");
-        stream->printf("opendtu_build{name=\"%s\",id=\"%s\",version=\"%d.%d.%d\"} 1\n",
-            NetworkSettings.getHostname().c_str(), __COMPILED_GIT_HASH__, CONFIG_VERSION >> 24 & 0xff, CONFIG_VERSION >> 16 & 0xff, CONFIG_VERSION >> 8 & 0xff);
+        auto response = request->beginChunkedResponse("text/plain; charset=utf-8",
+            [writer](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+                try {
+                    return writer->fill(buffer, maxLen);
+                } catch (std::bad_alloc& bad_alloc) {
+                    MessageOutput.printf("Calling /api/prometheus/metrics has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+                    return 0; // ends the (truncated) response
+                }
+            });
 
-        stream->print("# HELP opendtu_platform Platform info\n");
-        stream->print("# TYPE opendtu_platform gauge\n");
-        stream->printf("opendtu_platform{arch=\"%s\",mac=\"%s\"} 1\n", ESP.getChipModel(), NetworkSettings.macAddress().c_str());
+        response->addHeader("Cache-Control", "no-cache");
+        request->send(response);
 
-        stream->print("# HELP opendtu_uptime Uptime in seconds\n");
-        stream->print("# TYPE opendtu_uptime counter\n");
-        stream->printf("opendtu_uptime %lld\n", esp_timer_get_time() / 1000000);
+    } catch (std::bad_alloc& bad_alloc) {
+        MessageOutput.printf("Calling /api/prometheus/metrics has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
 
-        stream->print("# HELP opendtu_heap_size System memory size\n");
-        stream->print("# TYPE opendtu_heap_size gauge\n");
-        stream->printf("opendtu_heap_size %" PRId32 "\n", ESP.getHeapSize());
+        WebApi.sendTooManyRequests(request);
+    }
+}
 
-        stream->print("# HELP opendtu_free_heap_size System free memory\n");
-        stream->print("# TYPE opendtu_free_heap_size gauge\n");
-        stream->printf("opendtu_free_heap_size %" PRId32 "\n", ESP.getFreeHeap());
+size_t WebApiPrometheusClass::MetricsWriter::fill(uint8_t* buffer, size_t maxLen)
+{
+    size_t written = 0;
 
-        stream->print("# HELP opendtu_biggest_heap_block Biggest free heap block\n");
-        stream->print("# TYPE opendtu_biggest_heap_block gauge\n");
-        stream->printf("opendtu_biggest_heap_block %" PRId32 "\n", ESP.getMaxAllocHeap());
+    while (written < maxLen) {
+        if (_blockPos >= _blockLen) {
+            _blockPos = 0;
+            _blockLen = 0;
+            if (!renderNextBlock()) { break; }
+            continue; // the block might be empty
+        }
 
-        stream->print("# HELP opendtu_heap_min_free Minimum free memory since boot\n");
-        stream->print("# TYPE opendtu_heap_min_free gauge\n");
-        stream->printf("opendtu_heap_min_free %" PRId32 "\n", ESP.getMinFreeHeap());
+        size_t len = std::min(maxLen - written, _blockLen - _blockPos);
+        memcpy(buffer + written, _block + _blockPos, len);
+        written += len;
+        _blockPos += len;
+    }
 
-        stream->print("# HELP wifi_rssi WiFi RSSI\n");
-        stream->print("# TYPE wifi_rssi gauge\n");
-        stream->printf("wifi_rssi %" PRId8 "\n", WiFi.RSSI());
+    return written;
+}
 
-        stream->print("# HELP wifi_station WiFi Station info\n");
-        stream->print("# TYPE wifi_station gauge\n");
-        stream->printf("wifi_station{bssid=\"%s\"} 1\n", WiFi.BSSIDstr().c_str());
+bool WebApiPrometheusClass::MetricsWriter::renderNextBlock()
+{
+    constexpr uint8_t infoFamilies = sizeof(_infoFamilies) / sizeof(_infoFamilies[0]);
+    constexpr uint8_t fieldFamilies = sizeof(_fieldFamilies) / sizeof(_fieldFamilies[0]);
 
-        for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
-            auto inv = Hoymiles.getInverterByPos(i);
+    switch (_stage) {
+    case Stage::System:
+        renderSystemInfo();
+        _stage = Stage::InverterInfo;
+        return true;
 
-            String serial = inv->serialString();
-            const char* name = inv->name();
-            if (i == 0) {
-                stream->print("# HELP opendtu_last_update last update from inverter in s\n");
-                stream->print("# TYPE opendtu_last_update gauge\n");
-            }
-            stream->printf("opendtu_last_update{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\"} %" PRId32 "\n",
-                serial.c_str(), i, name, inv->Statistics()->getLastUpdate() / 1000);
+    case Stage::InverterInfo:
+    case Stage::InverterFields: {
+        bool info = (_stage == Stage::InverterInfo);
+        auto inv = Hoymiles.getInverterByPos(_inverter);
 
-            if (i == 0) {
-                stream->print("# HELP opendtu_inverter_limit_relative current relative limit of the inverter\n");
-                stream->print("# TYPE opendtu_inverter_limit_relative gauge\n");
+        if (inv == nullptr) {
+            _inverter = 0;
+            if (++_family >= (info ? infoFamilies : fieldFamilies)) {
+                _family = 0;
+                _stage = info ? Stage::InverterFields : Stage::InverterLatency;
             }
-            stream->printf("opendtu_inverter_limit_relative{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\"} %f\n",
-                serial.c_str(), i, name, inv->SystemConfigPara()->getLimitPercent() / 100.0);
+            return true;
+        }
 
-            if (inv->DevInfo()->getMaxPower() > 0) {
-                if (i == 0) {
-                    stream->print("# HELP opendtu_inverter_limit_absolute current relative limit of the inverter\n");
-                    stream->print("# TYPE opendtu_inverter_limit_absolute gauge\n");
-                }
-                stream->printf("opendtu_inverter_limit_absolute{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\"} %f\n",
-                    serial.c_str(), i, name, inv->SystemConfigPara()->getLimitPercent() * inv->DevInfo()->getMaxPower() / 100.0);
-            }
+        if (_inverter == 0) {
+            print("%s", info ? _infoFamilies[_family].preamble : _fieldFamilies[_family].preamble);
+        }
+
+        if (info) {
+            renderInverterInfo(_family, _inverter, inv);
+        } else {
+            renderInverterFields(_family, _inverter, inv);
+        }
+
+        ++_inverter;
+        return true;
+    }
+
+    case Stage::InverterLatency:
+        if (!renderInverterLatency()) {
+            _stage = Stage::Battery;
+        }
+        return true;
+
+    case Stage::Battery:
+        renderBattery();
+        _stage = Stage::SolarCharger;
+        return true;
+
+    case Stage::SolarCharger:
+        renderSolarCharger();
+        _stage = Stage::PowerMeter;
+        return true;
+
+    case Stage::PowerMeter:
+        renderPowerMeter();
+        _stage = Stage::PowerMeterDiagnostics;
+        return true;
+
+    case Stage::PowerMeterDiagnostics:
+        if (!renderPowerMeterDiagnostics()) {
+            _stage = Stage::PowerLimiter;
+        }
+        return true;
+
+    case Stage::PowerLimiter:
+        renderPowerLimiter();
+        _stage = Stage::ControlLatency;
+        return true;
+
+    case Stage::ControlLatency:
+        renderControlLatency();
+        _stage = Stage::Energy;
+        return true;
+
+    case Stage::Energy:
+        renderEnergy();
+        _stage = Stage::Tasks;
+        return true;
+
+    case Stage::Tasks:
+        if (!renderTasks()) {
+            _stage = Stage::HeapTags;
+        }
+        return true;
+
+    case Stage::HeapTags:
+        if (!renderHeapTags()) {
+            _stage = Stage::Websockets;
+        }
+        return true;
+
+    case Stage::Websockets:
+        if (!renderWebsockets()) {
+            _stage = Stage::Done;
+        }
+        return true;
+
+    case Stage::Done:
+        break;
+    }
+
+    return false;
+}
+
+void WebApiPrometheusClass::MetricsWriter::print(const char* format, ...)
+{
+    size_t available = BLOCK_SIZE - _blockLen;
+
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(_block + _blockLen, available, format, args);
+    va_end(args);
+
+    if (len < 0 || static_cast<size_t>(len) >= available) {
+        // drop the incomplete line rather than sending a broken one
+        _block[_blockLen] = '\0';
+        MessageOutput.printf("[Prometheus] metrics block overflow, skipping line\r\n");
+        return;
+    }
+
+    _blockLen += len;
+}
+
+void WebApiPrometheusClass::MetricsWriter::renderSystemInfo()
+{
+    print("# HELP opendtu_build Build info\n");
+    print("# TYPE opendtu_build gauge\n");
+    print("opendtu_build{name=\"%s\",id=\"%s\",version=\"%d.%d.%d\"} 1\n",
+        NetworkSettings.getHostname().c_str(), __COMPILED_GIT_HASH__, CONFIG_VERSION >> 24 & 0xff, CONFIG_VERSION >> 16 & 0xff, CONFIG_VERSION >> 8 & 0xff);
+
+    print("# HELP opendtu_platform Platform info\n");
+    print("# TYPE opendtu_platform gauge\n");
+    print("opendtu_platform{arch=\"%s\",mac=\"%s\"} 1\n", ESP.getChipModel(), NetworkSettings.macAddress().c_str());
+
+    print("# HELP opendtu_uptime Uptime in seconds\n");
+    print("# TYPE opendtu_uptime counter\n");
+    print("opendtu_uptime %lld\n", esp_timer_get_time() / 1000000);
+
+    print("# HELP opendtu_heap_size System memory size\n");
+    print("# TYPE opendtu_heap_size gauge\n");
+    print("opendtu_heap_size %" PRId32 "\n", ESP.getHeapSize());
+
+    print("# HELP opendtu_free_heap_size System free memory\n");
+    print("# TYPE opendtu_free_heap_size gauge\n");
+    print("opendtu_free_heap_size %" PRId32 "\n", ESP.getFreeHeap());
+
+    print("# HELP opendtu_biggest_heap_block Biggest free heap block\n");
+    print("# TYPE opendtu_biggest_heap_block gauge\n");
+    print("opendtu_biggest_heap_block %" PRId32 "\n", ESP.getMaxAllocHeap());
 
-            // Loop all channels if Statistics have been updated at least once since DTU boot
-            if (inv->Statistics()->getLastUpdate() > 0) {
-                for (auto& t : inv->Statistics()->getChannelTypes()) {
-                    for (auto& c : inv->Statistics()->getChannelsByType(t)) {
-                        addPanelInfo(stream, serial, i, inv, t, c);
-                        for (uint8_t f = 0; f < sizeof(_publishFields) / sizeof(_publishFields[0]); f++) {
-                            if (t == TYPE_INV && _publishFields[f].field == FLD_PDC) {
-                                addField(stream, serial, i, inv, t, c, _publishFields[f].field, _metricTypes[_publishFields[f].type], "PowerDC");
-                            } else {
-                                addField(stream, serial, i, inv, t, c, _publishFields[f].field, _metricTypes[_publishFields[f].type]);
-                            }
-                        }
-                    }
+    print("# HELP opendtu_heap_fragmentation Fragmentation of the internal heap in percent\n");
+    print("# TYPE opendtu_heap_fragmentation gauge\n");
+    print("opendtu_heap_fragmentation %u\n", HeapMonitor.getFragmentation());
+
+    print("# HELP opendtu_heap_min_free Minimum free memory since boot\n");
+    print("# TYPE opendtu_heap_min_free gauge\n");
+    print("opendtu_heap_min_free %" PRId32 "\n", ESP.getMinFreeHeap());
+
+    print("# HELP wifi_rssi WiFi RSSI\n");
+    print("# TYPE wifi_rssi gauge\n");
+    print("wifi_rssi %" PRId8 "\n", WiFi.RSSI());
+
+    print("# HELP wifi_station WiFi Station info\n");
+    print("# TYPE wifi_station gauge\n");
+    print("wifi_station{bssid=\"%s\"} 1\n", WiFi.BSSIDstr().c_str());
+}
+
+void WebApiPrometheusClass::MetricsWriter::renderInverterInfo(const uint8_t family, const uint8_t idx, std::shared_ptr<InverterAbstract> inv)
+{
+    String serial = inv->serialString();
+    const char* name = inv->name();
+
+    switch (family) {
+    case 0:
+        print("opendtu_last_update{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\"} %" PRId32 "\n",
+            serial.c_str(), idx, name, inv->Statistics()->getLastUpdate() / 1000);
+        return;
+    case 1:
+        print("opendtu_inverter_limit_relative{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\"} %f\n",
+            serial.c_str(), idx, name, inv->SystemConfigPara()->getLimitPercent() / 100.0);
+        return;
+    case 2:
+        if (inv->DevInfo()->getMaxPower() > 0) {
+            print("opendtu_inverter_limit_absolute{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\"} %f\n",
+                serial.c_str(), idx, name, inv->SystemConfigPara()->getLimitPercent() * inv->DevInfo()->getMaxPower() / 100.0);
+        }
+        return;
+    }
+
+    // panel information, only available once statistics were received
+    if (inv->Statistics()->getLastUpdate() == 0) {
+        return;
+    }
+
+    const auto& config = Configuration.getInverterConfig(inv->serial());
+    if (config == nullptr) {
+        return;
+    }
+
+    for (auto& channel : inv->Statistics()->getChannelsByType(TYPE_DC)) {
+        switch (family) {
+        case 3:
+            print("opendtu_PanelInfo{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\",channel=\"%d\",panelname=\"%s\"} 1\n",
+                serial.c_str(), idx, name, channel, config->channel[channel].Name);
+            break;
+        case 4:
+            print("opendtu_MaxPower{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\",channel=\"%d\"} %d\n",
+                serial.c_str(), idx, name, channel, config->channel[channel].MaxChannelPower);
+            break;
+        case 5:
+            print("opendtu_YieldTotalOffset{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\",channel=\"%" PRId16 "\"} %f\n",
+                serial.c_str(), idx, name, channel, config->channel[channel].YieldTotalOffset);
+            break;
+        }
+    }
+}
+
+void WebApiPrometheusClass::MetricsWriter::renderInverterFields(const uint8_t family, const uint8_t idx, std::shared_ptr<InverterAbstract> inv)
+{
+    // only if Statistics have been updated at least once since DTU boot.
+    // all values are read from the same frame.
+    auto spSnapshot = inv->Statistics()->getSnapshot();
+    if (inv->Statistics()->getLastUpdate() == 0 || !spSnapshot) {
+        return;
+    }
+
+    String serial = inv->serialString();
+    const char* familyName = _fieldFamilies[family].name;
+
+    for (auto& t : inv->Statistics()->getChannelTypes()) {
+        for (auto& c : inv->Statistics()->getChannelsByType(t)) {
+            for (auto& f : _publishFields) {
+                const char* chanName = (t == TYPE_INV && f == FLD_PDC) ? "PowerDC" : inv->Statistics()->getChannelFieldName(t, c, f);
+                if (strcmp(chanName, familyName) != 0 || !spSnapshot->hasChannelFieldValue(t, c, f)) {
+                    continue;
                 }
+
+                char value[Utils::FixedFormatSize];
+                Utils::formatFixed(value, sizeof(value), spSnapshot->getChannelFieldValue(t, c, f),
+                    inv->Statistics()->getChannelFieldDigits(t, c, f));
+
+                print("opendtu_%s{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\",type=\"%s\",channel=\"%d\"} %s\n",
+                    chanName,
+                    serial.c_str(),
+                    idx,
+                    inv->name(),
+                    inv->Statistics()->getChannelTypeName(t),
+                    c,
+                    value);
             }
         }
-        stream->addHeader("Cache-Control", "no-cache");
-        request->send(stream);
+    }
+}
 
-    } catch (std::bad_alloc& bad_alloc) {
-        MessageOutput.printf("Calling /api/prometheus/metrics has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+bool WebApiPrometheusClass::MetricsWriter::renderInverterLatency()
+{
+    while (_latencyEntry >= _latency.size()) {
+        auto inv = Hoymiles.getInverterByPos(_inverter);
+        if (inv == nullptr) {
+            _inverter = 0;
+            _latency.clear();
+            return false;
+        }
 
-        WebApi.sendTooManyRequests(request);
+        _latency = inv->Transactions.get();
+        _latencySerial = inv->serialString();
+        _latencyUnit = _inverter++;
+        _latencyEntry = 0;
+        _latencyPhase = 0;
     }
+
+    if (!_latencyPreamble) {
+        print("# HELP opendtu_rf_latency_seconds RF transaction latency by command and phase\n");
+        print("# TYPE opendtu_rf_latency_seconds histogram\n");
+        _latencyPreamble = true;
+    }
+
+    const auto& entry = _latency[_latencyEntry];
+    const auto& histogram = entry.Phases[_latencyPhase];
+    const char* command = entry.Command.c_str();
+    const char* phase = getTransactionPhaseName(static_cast<TransactionPhase>(_latencyPhase));
+
+    uint32_t cumulative = 0;
+    for (size_t i = 0; i < LatencyHistogram::Bounds.size(); i++) {
+        cumulative += histogram.Buckets[i];
+        print("opendtu_rf_latency_seconds_bucket{serial=\"%s\",unit=\"%" PRId8 "\",command=\"%s\",phase=\"%s\",le=\"%.3f\"} %" PRIu32 "\n",
+            _latencySerial.c_str(), _latencyUnit, command, phase, LatencyHistogram::Bounds[i] / 1000.0, cumulative);
+    }
+    print("opendtu_rf_latency_seconds_bucket{serial=\"%s\",unit=\"%" PRId8 "\",command=\"%s\",phase=\"%s\",le=\"+Inf\"} %" PRIu32 "\n",
+        _latencySerial.c_str(), _latencyUnit, command, phase, histogram.Count);
+    print("opendtu_rf_latency_seconds_sum{serial=\"%s\",unit=\"%" PRId8 "\",command=\"%s\",phase=\"%s\"} %.3f\n",
+        _latencySerial.c_str(), _latencyUnit, command, phase, histogram.Sum / 1000.0);
+    print("opendtu_rf_latency_seconds_count{serial=\"%s\",unit=\"%" PRId8 "\",command=\"%s\",phase=\"%s\"} %" PRIu32 "\n",
+        _latencySerial.c_str(), _latencyUnit, command, phase, histogram.Count);
+
+    if (++_latencyPhase >= HOY_TRANSACTION_PHASE_COUNT) {
+        _latencyPhase = 0;
+        ++_latencyEntry;
+    }
+
+    return true;
 }
 
-void WebApiPrometheusClass::addField(AsyncResponseStream* stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, const char* metricName, const char* channelName)
+void WebApiPrometheusClass::MetricsWriter::renderBattery()
 {
-    if (inv->Statistics()->hasChannelFieldValue(type, channel, fieldId)) {
-        const char* chanName = (channelName == nullptr) ? inv->Statistics()->getChannelFieldName(type, channel, fieldId) : channelName;
-        if (idx == 0 && type == TYPE_AC && channel == 0) {
-            stream->printf("# HELP opendtu_%s in %s\n", chanName, inv->Statistics()->getChannelFieldUnit(type, channel, fieldId));
-            stream->printf("# TYPE opendtu_%s %s\n", chanName, metricName);
+    if (!Configuration.get().Battery.Enabled) {
+        return;
+    }
+
+    auto spStats = Battery.getStats();
+
+    if (spStats->isSoCValid()) {
+        print("# HELP opendtu_battery_soc battery state of charge in %%\n");
+        print("# TYPE opendtu_battery_soc gauge\n");
+        print("opendtu_battery_soc %.*f\n", spStats->getSoCPrecision(), spStats->getSoC());
+    }
+
+    if (spStats->isVoltageValid()) {
+        print("# HELP opendtu_battery_voltage battery voltage in V\n");
+        print("# TYPE opendtu_battery_voltage gauge\n");
+        print("opendtu_battery_voltage %.2f\n", spStats->getVoltage());
+    }
+
+    if (spStats->isCurrentValid()) {
+        print("# HELP opendtu_battery_current battery charge current in A\n");
+        print("# TYPE opendtu_battery_current gauge\n");
+        print("opendtu_battery_current %.*f\n", spStats->getChargeCurrentPrecision(), spStats->getChargeCurrent());
+    }
+
+    if (spStats->isVoltageValid() && spStats->isCurrentValid()) {
+        print("# HELP opendtu_battery_power battery charge power in W\n");
+        print("# TYPE opendtu_battery_power gauge\n");
+        print("opendtu_battery_power %.1f\n", spStats->getVoltage() * spStats->getChargeCurrent());
+    }
+
+    if (spStats->isDischargeCurrentLimitValid()) {
+        print("# HELP opendtu_battery_discharge_current_limit battery discharge current limit in A\n");
+        print("# TYPE opendtu_battery_discharge_current_limit gauge\n");
+        print("opendtu_battery_discharge_current_limit %.2f\n", spStats->getDischargeCurrentLimit());
+    }
+
+    print("# HELP opendtu_battery_data_age age of the battery data in s\n");
+    print("# TYPE opendtu_battery_data_age gauge\n");
+    print("opendtu_battery_data_age %" PRIu32 "\n", spStats->getAgeSeconds());
+}
+
+void WebApiPrometheusClass::MetricsWriter::renderSolarCharger()
+{
+    if (!Configuration.get().SolarCharger.Enabled) {
+        return;
+    }
+
+    auto spStats = SolarCharger.getStats();
+
+    auto outputPower = spStats->getOutputPowerWatts();
+    if (outputPower) {
+        print("# HELP opendtu_solarcharger_output_power solar charger output power in W\n");
+        print("# TYPE opendtu_solarcharger_output_power gauge\n");
+        print("opendtu_solarcharger_output_power %.1f\n", *outputPower);
+    }
+
+    auto outputVoltage = spStats->getOutputVoltage();
+    if (outputVoltage) {
+        print("# HELP opendtu_solarcharger_output_voltage solar charger output voltage in V\n");
+        print("# TYPE opendtu_solarcharger_output_voltage gauge\n");
+        print("opendtu_solarcharger_output_voltage %.2f\n", *outputVoltage);
+    }
+
+    auto panelPower = spStats->getPanelPowerWatts();
+    if (panelPower) {
+        print("# HELP opendtu_solarcharger_panel_power solar panel power in W\n");
+        print("# TYPE opendtu_solarcharger_panel_power gauge\n");
+        print("opendtu_solarcharger_panel_power %" PRIu16 "\n", *panelPower);
+    }
+
+    auto yieldDay = spStats->getYieldDay();
+    if (yieldDay) {
+        print("# HELP opendtu_solarcharger_yield_day solar charger yield today in Wh\n");
+        print("# TYPE opendtu_solarcharger_yield_day counter\n");
+        print("opendtu_solarcharger_yield_day %.0f\n", *yieldDay);
+    }
+
+    auto yieldTotal = spStats->getYieldTotal();
+    if (yieldTotal) {
+        print("# HELP opendtu_solarcharger_yield_total solar charger total yield in kWh\n");
+        print("# TYPE opendtu_solarcharger_yield_total counter\n");
+        print("opendtu_solarcharger_yield_total %.2f\n", *yieldTotal);
+    }
+}
+
+void WebApiPrometheusClass::MetricsWriter::renderPowerMeter()
+{
+    if (!Configuration.get().PowerMeter.Enabled) {
+        return;
+    }
+
+    print("# HELP opendtu_powermeter_power power meter total power in W\n");
+    print("# TYPE opendtu_powermeter_power gauge\n");
+    print("opendtu_powermeter_power %.1f\n", PowerMeter.getPowerTotal());
+
+    print("# HELP opendtu_powermeter_data_valid power meter reading is recent\n");
+    print("# TYPE opendtu_powermeter_data_valid gauge\n");
+    print("opendtu_powermeter_data_valid %d\n", PowerMeter.isDataValid() ? 1 : 0);
+}
+
+bool WebApiPrometheusClass::MetricsWriter::renderPowerMeterDiagnostics()
+{
+    using Diagnostics = PowerMeters::Diagnostics;
+
+    if (!_meterSnapshot) {
+        if (!Configuration.get().PowerMeter.Enabled) {
+            return false;
+        }
+        _meterDiagnostics = PowerMeter.getDiagnostics();
+        _meterSnapshot = true;
+    }
+
+    if (_meterMetric >= Diagnostics::MetricCount || _meterDiagnostics.empty()) {
+        print("# HELP opendtu_powermeter_failures_total power meter readings which failed, by reason\n");
+        print("# TYPE opendtu_powermeter_failures_total counter\n");
+        for (auto const& source : _meterDiagnostics) {
+            for (size_t f = 0; f < Diagnostics::FailureCount; ++f) {
+                print("opendtu_powermeter_failures_total{source=\"%s\",reason=\"%s\"} %" PRIu32 "\n",
+                    source.Key, Diagnostics::getName(static_cast<Diagnostics::Failure>(f)), source.Snapshot.Failures[f]);
+            }
         }
-        stream->printf("opendtu_%s{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\",type=\"%s\",channel=\"%d\"} %s\n",
-            chanName,
-            serial.c_str(),
-            idx,
-            inv->name(),
-            inv->Statistics()->getChannelTypeName(type),
-            channel,
-            inv->Statistics()->getChannelFieldValueString(type, channel, fieldId).c_str());
+
+        _meterDiagnostics.clear();
+        return false;
+    }
+
+    auto metric = static_cast<Diagnostics::Metric>(_meterMetric);
+    auto name = Diagnostics::getName(metric);
+    auto const& bounds = Diagnostics::getBounds(metric);
+
+    // the samples of all sources follow the preamble of their metric
+    if (_meterSource == 0) {
+        print("# HELP opendtu_powermeter_%s_seconds power meter %s of the readings\n", name, name);
+        print("# TYPE opendtu_powermeter_%s_seconds histogram\n", name);
     }
+
+    auto const& source = _meterDiagnostics[_meterSource];
+    auto const& histogram = source.Snapshot.Metrics[_meterMetric];
+
+    uint32_t cumulative = 0;
+    for (size_t i = 0; i < bounds.size(); i++) {
+        cumulative += histogram.Buckets[i];
+        print("opendtu_powermeter_%s_seconds_bucket{source=\"%s\",le=\"%.4f\"} %" PRIu32 "\n",
+            name, source.Key, bounds[i] / 1000000.0, cumulative);
+    }
+    print("opendtu_powermeter_%s_seconds_bucket{source=\"%s\",le=\"+Inf\"} %" PRIu32 "\n",
+        name, source.Key, histogram.Count);
+    print("opendtu_powermeter_%s_seconds_sum{source=\"%s\"} %.6f\n",
+        name, source.Key, histogram.Sum / 1000000.0);
+    print("opendtu_powermeter_%s_seconds_count{source=\"%s\"} %" PRIu32 "\n",
+        name, source.Key, histogram.Count);
+
+    if (++_meterSource >= _meterDiagnostics.size()) {
+        _meterSource = 0;
+        ++_meterMetric;
+    }
+
+    return true;
 }
 
-void WebApiPrometheusClass::addPanelInfo(AsyncResponseStream* stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel)
+void WebApiPrometheusClass::MetricsWriter::renderPowerLimiter()
 {
-    if (type != TYPE_DC) {
+    if (!Configuration.get().PowerLimiter.Enabled) {
         return;
     }
 
-    const auto& config = Configuration.getInverterConfig(inv->serial());
+    print("# HELP opendtu_powerlimiter_mode dynamic power limiter mode\n");
+    print("# TYPE opendtu_powerlimiter_mode gauge\n");
+    print("opendtu_powerlimiter_mode %u\n", static_cast<unsigned>(PowerLimiter.getMode()));
+
+    print("# HELP opendtu_powerlimiter_inverter_output expected output of the governed inverters in W\n");
+    print("# TYPE opendtu_powerlimiter_inverter_output gauge\n");
+    print("opendtu_powerlimiter_inverter_output %" PRId32 "\n", PowerLimiter.getInverterOutput());
+
+
+    // the latency summaries are rendered in a block of their own, as they
+    // do not fit into this one
+    using Metric = ControlLatencyClass::Metric;
+
+    print("# HELP opendtu_powerlimiter_latency_alert whether the 90th percentile exceeds its threshold\n");
+    print("# TYPE opendtu_powerlimiter_latency_alert gauge\n");
+    for (size_t i = 0; i < ControlLatencyClass::MetricCount; ++i) {
+        auto metric = static_cast<Metric>(i);
+        print("opendtu_powerlimiter_latency_alert{metric=\"%s\"} %u\n", ControlLatencyClass::getName(metric),
+            ControlLatency.getSummary(metric).Alert ? 1 : 0);
+    }
+
+    print("# HELP opendtu_powerlimiter_meter_jitter_seconds smoothed jitter of the power meter inter-arrival time\n");
+    print("# TYPE opendtu_powerlimiter_meter_jitter_seconds gauge\n");
+    print("opendtu_powerlimiter_meter_jitter_seconds %.3f\n", ControlLatency.getMeterJitter() / 1000.0);
+}
+
+void WebApiPrometheusClass::MetricsWriter::renderControlLatency()
+{
+    if (!Configuration.get().PowerLimiter.Enabled) {
+        return;
+    }
+
+    using Metric = ControlLatencyClass::Metric;
+
+    print("# HELP opendtu_powerlimiter_latency_seconds DPL control loop latencies over the recent samples\n");
+    print("# TYPE opendtu_powerlimiter_latency_seconds summary\n");
+    for (size_t i = 0; i < ControlLatencyClass::MetricCount; ++i) {
+        auto metric = static_cast<Metric>(i);
+        auto summary = ControlLatency.getSummary(metric);
+        auto name = ControlLatencyClass::getName(metric);
+        if (summary.Samples > 0) {
+            print("opendtu_powerlimiter_latency_seconds{metric=\"%s\",quantile=\"0.5\"} %.3f\n", name, summary.P50 / 1000.0);
+            print("opendtu_powerlimiter_latency_seconds{metric=\"%s\",quantile=\"0.9\"} %.3f\n", name, summary.P90 / 1000.0);
+            print("opendtu_powerlimiter_latency_seconds{metric=\"%s\",quantile=\"0.99\"} %.3f\n", name, summary.P99 / 1000.0);
+        }
+        print("opendtu_powerlimiter_latency_seconds_count{metric=\"%s\"} %" PRIu32 "\n", name, summary.Count);
+    }
+}
+
+void WebApiPrometheusClass::MetricsWriter::renderEnergy()
+{
+    using Flow = EnergyMeterClass::Flow;
+
+    print("# HELP opendtu_energy_today energy of the flow on the current day in Wh\n");
+    print("# TYPE opendtu_energy_today gauge\n");
+    for (size_t i = 0; i < EnergyMeterClass::FLOW_COUNT; ++i) {
+        auto flow = static_cast<Flow>(i);
+        print("opendtu_energy_today{flow=\"%s\"} %.1f\n", EnergyMeterClass::getName(flow), EnergyMeter.getToday(flow));
+    }
+
+    print("# HELP opendtu_energy_total energy of the flow since counting started in Wh\n");
+    print("# TYPE opendtu_energy_total counter\n");
+    for (size_t i = 0; i < EnergyMeterClass::FLOW_COUNT; ++i) {
+        auto flow = static_cast<Flow>(i);
+        print("opendtu_energy_total{flow=\"%s\"} %.1f\n", EnergyMeterClass::getName(flow), EnergyMeter.getTotal(flow));
+    }
+}
+
+bool WebApiPrometheusClass::MetricsWriter::renderTasks()
+{
+    using Stats = TaskProfilerClass::Stats;
+
+    struct Family {
+        char const* name;
+        char const* preamble;
+        uint64_t (*getValue)(Stats const&);
+    };
+
+    static constexpr Family families[] = {
+        { "runs", "# HELP opendtu_task_runs number of scheduler task runs\n# TYPE opendtu_task_runs counter\n",
+            [](Stats const& s) -> uint64_t { return s.Count; } },
+        { "runtime_us", "# HELP opendtu_task_runtime_us total runtime of scheduler task in us\n# TYPE opendtu_task_runtime_us counter\n",
+            [](Stats const& s) -> uint64_t { return s.TotalMicros; } },
+        { "max_runtime_us", "# HELP opendtu_task_max_runtime_us longest run of scheduler task in us\n# TYPE opendtu_task_max_runtime_us gauge\n",
+            [](Stats const& s) -> uint64_t { return s.MaxMicros; } },
+        { "overruns", "# HELP opendtu_task_overruns runs of scheduler task longer than its interval\n# TYPE opendtu_task_overruns counter\n",
+            [](Stats const& s) -> uint64_t { return s.Overruns; } },
+        { "max_late_ms", "# HELP opendtu_task_max_late_ms latest start of scheduler task in ms\n# TYPE opendtu_task_max_late_ms gauge\n",
+            [](Stats const& s) -> uint64_t { return s.MaxLateMillis; } },
+    };
+    constexpr uint8_t familyCount = sizeof(families) / sizeof(families[0]);
+
+    if (_taskFamily == 0 && _taskIndex == 0) { _tasks = TaskProfiler.getStats(); }
+
+    if (_taskFamily >= familyCount || _tasks.empty()) {
+        _tasks.clear();
+        return false;
+    }
+
+    auto const& family = families[_taskFamily];
+    if (_taskIndex == 0) { print("%s", family.preamble); }
+
+    // a block holds the values of a limited number of tasks
+    static constexpr size_t tasksPerBlock = 16;
+    size_t end = std::min(_tasks.size(), _taskIndex + tasksPerBlock);
+    for (; _taskIndex < end; ++_taskIndex) {
+        auto const& stats = _tasks[_taskIndex];
+        print("opendtu_task_%s{task=\"%s\"} %" PRIu64 "\n",
+            family.name, stats.Name, family.getValue(stats));
+    }
+
+    if (_taskIndex >= _tasks.size()) {
+        _taskIndex = 0;
+        ++_taskFamily;
+    }
+
+    return true;
+}
+
+bool WebApiPrometheusClass::MetricsWriter::renderHeapTags()
+{
+    using TagStats = HeapMonitorClass::TagStats;
+
+    struct Family {
+        char const* name;
+        char const* preamble;
+        int64_t (*getValue)(TagStats const&);
+    };
+
+    static constexpr Family families[] = {
+        { "net_bytes", "# HELP opendtu_heap_tag_net_bytes heap allocated and not freed within scopes of tag\n# TYPE opendtu_heap_tag_net_bytes gauge\n",
+            [](TagStats const& s) -> int64_t { return s.NetBytes; } },
+        { "bytes_per_minute", "# HELP opendtu_heap_tag_bytes_per_minute change of heap allocated within scopes of tag during the last minute\n# TYPE opendtu_heap_tag_bytes_per_minute gauge\n",
+            [](TagStats const& s) -> int64_t { return s.BytesPerMinute; } },
+        { "failed_allocs", "# HELP opendtu_heap_tag_failed_allocs failed allocations within scopes of tag\n# TYPE opendtu_heap_tag_failed_allocs counter\n",
+            [](TagStats const& s) -> int64_t { return s.FailedAllocs; } },
+    };
+    constexpr uint8_t familyCount = sizeof(families) / sizeof(families[0]);
+
+    if (_heapTagFamily == 0 && _heapTagIndex == 0) { _heapTags = HeapMonitor.getTagStats(); }
+
+    if (_heapTagFamily >= familyCount || _heapTags.empty()) {
+        _heapTags.clear();
+        return false;
+    }
+
+    auto const& family = families[_heapTagFamily];
+    if (_heapTagIndex == 0) { print("%s", family.preamble); }
+
+    // a block holds the values of a limited number of tags
+    static constexpr size_t tagsPerBlock = 16;
+    size_t end = std::min(_heapTags.size(), _heapTagIndex + tagsPerBlock);
+    for (; _heapTagIndex < end; ++_heapTagIndex) {
+        auto const& stats = _heapTags[_heapTagIndex];
+        print("opendtu_heap_tag_%s{tag=\"%s\"} %" PRId64 "\n",
+            family.name, stats.Name, family.getValue(stats));
+    }
+
+    if (_heapTagIndex >= _heapTags.size()) {
+        _heapTagIndex = 0;
+        ++_heapTagFamily;
+    }
+
+    return true;
+}
+
+bool WebApiPrometheusClass::MetricsWriter::renderWebsockets()
+{
+    using SocketStats = WsMonitorClass::SocketStats;
+
+    struct Family {
+        char const* name;
+        char const* preamble;
+        uint32_t (*getValue)(SocketStats const&);
+    };
+
+    static constexpr Family families[] = {
+        { "clients", "# HELP opendtu_websocket_clients connected clients of websocket\n# TYPE opendtu_websocket_clients gauge\n",
+            [](SocketStats const& s) -> uint32_t { return s.Clients; } },
+        { "queued_messages", "# HELP opendtu_websocket_queued_messages messages queued for all clients of websocket\n# TYPE opendtu_websocket_queued_messages gauge\n",
+            [](SocketStats const& s) -> uint32_t { return s.QueuedMessages; } },
+        { "queue_peak", "# HELP opendtu_websocket_queue_peak longest message queue of any client of websocket since startup\n# TYPE opendtu_websocket_queue_peak gauge\n",
+            [](SocketStats const& s) -> uint32_t { return s.PeakQueueLength; } },
+        { "sndbuf_used_bytes", "# HELP opendtu_websocket_sndbuf_used_bytes TCP send buffer used by all clients of websocket\n# TYPE opendtu_websocket_sndbuf_used_bytes gauge\n",
+            [](SocketStats const& s) -> uint32_t { return s.SendBufferUsed; } },
+        { "backlogged_clients", "# HELP opendtu_websocket_backlogged_clients clients of websocket with queued messages\n# TYPE opendtu_websocket_backlogged_clients gauge\n",
+            [](SocketStats const& s) -> uint32_t { return s.BackloggedClients; } },
+        { "closed_clients", "# HELP opendtu_websocket_closed_clients clients of websocket closed due to a persistent backlog\n# TYPE opendtu_websocket_closed_clients counter\n",
+            [](SocketStats const& s) -> uint32_t { return s.ClosedClients; } },
+    };
+    constexpr uint8_t familyCount = sizeof(families) / sizeof(families[0]);
+
+    if (_socketFamily == 0) { _sockets = WsMonitor.getStats(); }
+
+    if (_socketFamily >= familyCount || _sockets.empty()) {
+        _sockets.clear();
+        return false;
+    }
+
+    auto const& family = families[_socketFamily];
+    print("%s", family.preamble);
+    for (auto const& stats : _sockets) {
+        print("opendtu_websocket_%s{url=\"%s\"} %" PRIu32 "\n",
+            family.name, stats.Url, family.getValue(stats));
+    }
 
-    const bool printHelp = (idx == 0 && channel == 0);
-    if (printHelp) {
-        stream->print("# HELP opendtu_PanelInfo panel information\n");
-        stream->print("# TYPE opendtu_PanelInfo gauge\n");
-    }
-    stream->printf("opendtu_PanelInfo{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\",channel=\"%d\",panelname=\"%s\"} 1\n",
-        serial.c_str(),
-        idx,
-        inv->name(),
-        channel,
-        config->channel[channel].Name);
-
-    if (printHelp) {
-        stream->print("# HELP opendtu_MaxPower panel maximum output power\n");
-        stream->print("# TYPE opendtu_MaxPower gauge\n");
-    }
-    stream->printf("opendtu_MaxPower{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\",channel=\"%d\"} %d\n",
-        serial.c_str(),
-        idx,
-        inv->name(),
-        channel,
-        config->channel[channel].MaxChannelPower);
-
-    if (printHelp) {
-        stream->print("# HELP opendtu_YieldTotalOffset panel yield offset (for used inverters)\n");
-        stream->print("# TYPE opendtu_YieldTotalOffset gauge\n");
-    }
-    stream->printf("opendtu_YieldTotalOffset{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\",channel=\"%" PRId16 "\"} %f\n",
-        serial.c_str(),
-        idx,
-        inv->name(),
-        channel,
-        config->channel[channel].YieldTotalOffset);
+    ++_socketFamily;
+    return true;
 }
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "WebApi_router.h"
+#include "MessageOutput.h"
+#include <algorithm>
+#include <esp_timer.h>
+
+void WebApiRouterClass::on(char const* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest)
+{
+    auto& routes = _routes[std::string_view(uri)];
+
+    for (auto const& route : routes) {
+        if (route.Method & method) {
+            MessageOutput.printf("[WebApi] route %s registered twice\r\n", uri);
+        }
+    }
+
+    routes.push_back({ method, std::move(onRequest) });
+}
+
+WebApiRouterClass::Route const* WebApiRouterClass::find(AsyncWebServerRequest* request) const
+{
+    String const& url = request->url();
+    auto it = _routes.find(std::string_view(url.c_str(), url.length()));
+    if (it == _routes.end()) { return nullptr; }
+
+    for (auto const& route : it->second) {
+        if (route.Method & request->method()) { return &route; }
+    }
+
+    return nullptr;
+}
+
+bool WebApiRouterClass::canHandle(AsyncWebServerRequest* request) const
+{
+    return find(request) != nullptr;
+}
+
+void WebApiRouterClass::handleRequest(AsyncWebServerRequest* request)
+{
+    // the route cannot vanish between canHandle() and this call, as
+    // routes are only registered before the web server is started.
+    auto route = const_cast<Route*>(find(request));
+    if (route == nullptr) {
+        request->send(404);
+        return;
+    }
+
+    int64_t start = esp_timer_get_time();
+    if (isOverBudget(request, *route, start)) { return; }
+
+    route->OnRequest(request);
+    uint32_t duration = static_cast<uint32_t>(esp_timer_get_time() - start);
+
+    ++route->Count;
+    route->TotalMicros += duration;
+    route->MaxMicros = std::max(route->MaxMicros, duration);
+    if (duration > RequestBudgetMicros) { ++route->Overruns; }
+
+    _bucketMicros += duration;
+}
+
+bool WebApiRouterClass::isOverBudget(AsyncWebServerRequest* request, Route& route, int64_t now)
+{
+    uint64_t drained = static_cast<uint64_t>(now - _bucketUpdated) * BudgetMicrosPerSecond / 1000000;
+    _bucketMicros = (_bucketMicros > drained) ? _bucketMicros - drained : 0;
+    _bucketUpdated = now;
+
+    if (_bucketMicros < BudgetMicrosPerSecond) { return false; }
+
+    // a route is judged by its average, as single requests may be slow
+    // for reasons beyond the handler, e.g., another task using the core
+    if (route.Count == 0 || route.TotalMicros / route.Count < FairShareMicros) { return false; }
+
+    ++route.Rejected;
+
+    uint32_t retrySeconds = (_bucketMicros - BudgetMicrosPerSecond) / BudgetMicrosPerSecond + 1;
+    auto response = request->beginResponse(503, "text/plain", "Service Unavailable");
+    response->addHeader("Retry-After", String(retrySeconds));
+    request->send(response);
+    return true;
+}
+
+std::vector<WebApiRouterClass::Stats> WebApiRouterClass::getStats() const
+{
+    std::vector<Stats> stats;
+
+    for (auto const& [uri, routes] : _routes) {
+        for (auto const& route : routes) {
+            stats.push_back({ uri.data(), route.Method, route.Count, route.TotalMicros, route.MaxMicros,
+                route.Overruns, route.Rejected });
+        }
+    }
+
+    return stats;
+}
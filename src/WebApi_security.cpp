@@ -13,9 +13,10 @@ void WebApiSecurityClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     using std::placeholders::_1;
 
-    server.on("/api/security/config", HTTP_GET, std::bind(&WebApiSecurityClass::onSecurityGet, this, _1));
-    server.on("/api/security/config", HTTP_POST, std::bind(&WebApiSecurityClass::onSecurityPost, this, _1));
-    server.on("/api/security/authenticate", HTTP_GET, std::bind(&WebApiSecurityClass::onAuthenticateGet, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/security/config", HTTP_GET, std::bind(&WebApiSecurityClass::onSecurityGet, this, _1));
+    router.on("/api/security/config", HTTP_POST, std::bind(&WebApiSecurityClass::onSecurityPost, this, _1));
+    router.on("/api/security/authenticate", HTTP_GET, std::bind(&WebApiSecurityClass::onAuthenticateGet, this, _1));
 }
 
 void WebApiSecurityClass::onSecurityGet(AsyncWebServerRequest* request)
@@ -72,7 +73,7 @@ void WebApiSecurityClass::onSecurityPost(AsyncWebServerRequest* request)
         config.Security.AllowReadonly = root["allow_readonly"].as<bool>();
     }
 
-    WebApi.writeConfig(retMsg);
+    WebApi.writeConfig(retMsg, ConfigurationClass::Section::Security);
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
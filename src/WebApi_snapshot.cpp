@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "WebApi_snapshot.h"
+#include "Configuration.h"
+#include "MessageOutput.h"
+#include "WebApi.h"
+#include <time.h>
+
+WebApiSnapshotClass::WebApiSnapshotClass(WebApiWsLiveClass& live, WebApiWsBatteryLiveClass& battery,
+        WebApiWsSolarChargerLiveClass& solarCharger, WebApiWsHuaweiLiveClass& huawei,
+        WebApiSysstatusClass& sysstatus)
+    : _live(live)
+    , _battery(battery)
+    , _solarCharger(solarCharger)
+    , _huawei(huawei)
+    , _sysstatus(sysstatus)
+{
+}
+
+void WebApiSnapshotClass::init(AsyncWebServer& server, Scheduler& scheduler)
+{
+    using std::placeholders::_1;
+
+    auto& router = WebApi.getRouter();
+    router.on("/api/snapshot", HTTP_GET, std::bind(&WebApiSnapshotClass::onSnapshotGet, this, _1));
+}
+
+uint8_t WebApiSnapshotClass::parseSections(AsyncWebServerRequest* request)
+{
+    if (!request->hasParam("include")) { return Section::All; }
+
+    static constexpr struct {
+        char const* name;
+        Section section;
+    } names[] = {
+        { "live", Section::Live },
+        { "battery", Section::Battery },
+        { "solarcharger", Section::SolarCharger },
+        { "huawei", Section::Huawei },
+        { "powerlimiter", Section::PowerLimiter },
+        { "system", Section::System },
+    };
+
+    String const& include = request->getParam("include")->value();
+    uint8_t sections = 0;
+    int start = 0;
+    while (start <= static_cast<int>(include.length())) {
+        int end = include.indexOf(',', start);
+        if (end < 0) { end = include.length(); }
+
+        String name = include.substring(start, end);
+        name.trim();
+        for (auto const& entry : names) {
+            if (name.equals(entry.name)) { sections |= entry.section; }
+        }
+
+        start = end + 1;
+    }
+
+    return sections;
+}
+
+void WebApiSnapshotClass::generate(JsonVariant& root, uint8_t sections)
+{
+    root["uptime_ms"] = millis();
+
+    // the wall clock time of the snapshot, once the time is synchronized
+    struct tm timeinfo;
+    if (getLocalTime(&timeinfo, 5)) {
+        root["timestamp"] = time(nullptr);
+    }
+
+    if (sections & Section::Live) {
+        JsonVariant live = root["live"].to<JsonObject>();
+        _live.generateSnapshot(live);
+    }
+
+    if (sections & Section::Battery) {
+        auto fragment = _battery.getFragment();
+        if (fragment.spDoc) { root["battery"] = fragment.spDoc->as<JsonVariantConst>(); }
+    }
+
+    if (sections & Section::SolarCharger) {
+        JsonVariant solarCharger = root["solarcharger"].to<JsonObject>();
+        _solarCharger.generateSnapshot(solarCharger);
+    }
+
+    if (sections & Section::Huawei) {
+        auto fragment = _huawei.getFragment();
+        if (fragment.spDoc) { root["huawei"] = fragment.spDoc->as<JsonVariantConst>(); }
+    }
+
+    if (sections & Section::PowerLimiter) {
+        auto powerLimiter = root["powerlimiter"].to<JsonObject>();
+        ConfigurationClass::serializePowerLimiterConfig(Configuration.get().PowerLimiter, powerLimiter);
+    }
+
+    if (sections & Section::System) {
+        JsonVariant system = root["system"].to<JsonObject>();
+        _sysstatus.generateStatus(system);
+    }
+}
+
+void WebApiSnapshotClass::onSnapshotGet(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    uint8_t sections = parseSections(request);
+
+    try {
+        auto version = JsonETag()
+            .add(static_cast<uint32_t>(sections))
+            .add(static_cast<uint32_t>(millis() / 1000))
+            .getHash();
+
+        auto fragment = _cache.get(version, [this, sections](JsonVariant& root) {
+            generate(root, sections);
+        });
+
+        if (!fragment.spText) {
+            WebApi.sendTooManyRequests(request);
+            return;
+        }
+
+        JsonFragmentCache::send(request, fragment);
+
+    } catch (const std::bad_alloc& bad_alloc) {
+        MessageOutput.printf("Calling /api/snapshot has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+        WebApi.sendTooManyRequests(request);
+    } catch (const std::exception& exc) {
+        MessageOutput.printf("Unknown exception in /api/snapshot. Reason: \"%s\".\r\n", exc.what());
+        WebApi.sendTooManyRequests(request);
+    }
+}
@@ -3,6 +3,7 @@
 #include "ArduinoJson.h"
 #include "AsyncJson.h"
 #include "Configuration.h"
+#include "Features.h"
 #include "WebApi.h"
 #include "WebApi_errors.h"
 #include "helper.h"
@@ -15,8 +16,9 @@ void WebApiSolarChargerlass::init(AsyncWebServer& server, Scheduler& scheduler)
 
     _server = &server;
 
-    _server->on("/api/solarcharger/config", HTTP_GET, std::bind(&WebApiSolarChargerlass::onAdminGet, this, _1));
-    _server->on("/api/solarcharger/config", HTTP_POST, std::bind(&WebApiSolarChargerlass::onAdminPost, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/solarcharger/config", HTTP_GET, std::bind(&WebApiSolarChargerlass::onAdminGet, this, _1));
+    router.on("/api/solarcharger/config", HTTP_POST, std::bind(&WebApiSolarChargerlass::onAdminPost, this, _1));
 }
 
 void WebApiSolarChargerlass::onAdminGet(AsyncWebServerRequest* request)
@@ -31,6 +33,11 @@ void WebApiSolarChargerlass::onAdminGet(AsyncWebServerRequest* request)
 
     ConfigurationClass::serializeSolarChargerConfig(config.SolarCharger, root);
 
+    auto availableProviders = root["available_providers"].to<JsonArray>();
+    for (uint8_t provider = 0; provider < Features::SolarChargerProviderCount; ++provider) {
+        if (Features::isSolarChargerProviderAvailable(provider)) { availableProviders.add(provider); }
+    }
+
     auto mqtt = root["mqtt"].to<JsonObject>();
     ConfigurationClass::serializeSolarChargerMqttConfig(config.SolarCharger.Mqtt, mqtt);
 
@@ -61,6 +68,13 @@ void WebApiSolarChargerlass::onAdminPost(AsyncWebServerRequest* request)
         return;
     }
 
+    if (!Features::isSolarChargerProviderAvailable(root["provider"].as<uint8_t>())) {
+        retMsg["message"] = "Provider is not available in this build!";
+        retMsg["code"] = WebApiError::GenericNotAvailable;
+        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        return;
+    }
+
     {
         auto guard = Configuration.getWriteGuard();
         auto& config = guard.getConfig();
@@ -69,7 +83,7 @@ void WebApiSolarChargerlass::onAdminPost(AsyncWebServerRequest* request)
         ConfigurationClass::deserializeSolarChargerMqttConfig(root["mqtt"].as<JsonObject>(), config.SolarCharger.Mqtt);
     }
 
-    WebApi.writeConfig(retMsg);
+    WebApi.writeConfig(retMsg, ConfigurationClass::Section::SolarCharger);
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
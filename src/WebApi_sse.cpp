@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "WebApi_sse.h"
+#include "Configuration.h"
+#include "MessageOutput.h"
+#include "NightMode.h"
+#include "defaults.h"
+
+WebApiSseClass::WebApiSseClass()
+    : _events("/api/events")
+{
+}
+
+void WebApiSseClass::init(AsyncWebServer& server, Scheduler& scheduler)
+{
+    _events.onConnect([this](AsyncEventSourceClient* client) {
+        MessageOutput.printf("Events: [%s] connect\r\n", client->client()->remoteIP().toString().c_str());
+        ++_connects;
+    });
+
+    server.addHandler(&_events);
+
+    _simpleDigestAuth.setUsername(AUTH_USERNAME);
+    _simpleDigestAuth.setRealm("live events");
+
+    reload();
+}
+
+void WebApiSseClass::reload()
+{
+    _events.removeMiddleware(&_simpleDigestAuth);
+
+    auto const& config = Configuration.get();
+
+    if (config.Security.AllowReadonly) { return; }
+
+    _simpleDigestAuth.setPassword(config.Security.Password);
+    _events.addMiddleware(&_simpleDigestAuth);
+    _events.close();
+}
+
+bool WebApiSseClass::takeResyncRequest(uint32_t& seenConnects) const
+{
+    uint32_t connects = _connects;
+    if (connects == seenConnects) { return false; }
+    seenConnects = connects;
+    return true;
+}
+
+void WebApiSseClass::publish(char const* channel, JsonDocument const& root, AsyncWebSocketSharedBuffer spText)
+{
+    if (!hasClients()) { return; }
+
+    // someone is reading the live data
+    NightMode.notifyActivity();
+
+    // the event source shares a single copy of the message among all
+    // clients. a compact JSON document holds no line breaks, which would
+    // end the data of the event.
+    String text;
+    if (spText) {
+        text.concat(reinterpret_cast<char const*>(spText->data()), spText->size());
+    } else {
+        serializeJson(root, text);
+    }
+
+    _events.send(text.c_str(), channel, millis());
+}
@@ -3,23 +3,46 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_sysstatus.h"
+#include "BootProfiler.h"
 #include "Configuration.h"
+#include "HeapMonitor.h"
 #include "NetworkSettings.h"
 #include "PinMapping.h"
 #include "SerialPortManager.h"
+#include "TaskProfiler.h"
 #include "WebApi.h"
+#include "WsMonitor.h"
 #include "__compiled_constants.h"
 #include <AsyncJson.h>
 #include <CpuTemperature.h>
 #include <Hoymiles.h>
 #include <LittleFS.h>
 #include <ResetReason.h>
+#include <SpiManager.h>
 
 void WebApiSysstatusClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     using std::placeholders::_1;
 
-    server.on("/api/system/status", HTTP_GET, std::bind(&WebApiSysstatusClass::onSystemStatus, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/system/status", HTTP_GET, std::bind(&WebApiSysstatusClass::onSystemStatus, this, _1));
+    router.on("/api/system/tasks", HTTP_GET, std::bind(&WebApiSysstatusClass::onSystemTasks, this, _1));
+    router.on("/api/system/heap", HTTP_GET, std::bind(&WebApiSysstatusClass::onSystemHeap, this, _1));
+    router.on("/api/system/spi", HTTP_GET, std::bind(&WebApiSysstatusClass::onSystemSpi, this, _1));
+    router.on("/api/system/routes", HTTP_GET, std::bind(&WebApiSysstatusClass::onSystemRoutes, this, _1));
+}
+
+static void addQueueLatency(JsonObject root, HoymilesRadio const& radio)
+{
+    auto add = [&radio](JsonObject obj, CommandPriority priority) {
+        auto latency = radio.getQueueLatency(priority);
+        obj["last"] = latency.Last;
+        obj["avg"] = latency.Average;
+        obj["max"] = latency.Max;
+    };
+
+    add(root["control"].to<JsonObject>(), CommandPriority::Control);
+    add(root["telemetry"].to<JsonObject>(), CommandPriority::Telemetry);
 }
 
 void WebApiSysstatusClass::onSystemStatus(AsyncWebServerRequest* request)
@@ -28,9 +51,16 @@ void WebApiSysstatusClass::onSystemStatus(AsyncWebServerRequest* request)
         return;
     }
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto response = new PooledJsonResponse(JsonDocumentPoolClass::SizeClass::Large);
     auto& root = response->getRoot();
 
+    generateStatus(root);
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
+
+void WebApiSysstatusClass::generateStatus(JsonVariant& root)
+{
     root["hostname"] = NetworkSettings.getHostname();
 
     root["sdkversion"] = ESP.getSdkVersion();
@@ -54,9 +84,11 @@ void WebApiSysstatusClass::onSystemStatus(AsyncWebServerRequest* request)
     root["flashsize"] = ESP.getFlashChipSize();
 
     JsonArray taskDetails = root["task_details"].to<JsonArray>();
-    static std::array<char const*, 13> constexpr task_names = {
+    static std::array<char const*, 19> constexpr task_names = {
         "IDLE0", "IDLE1", "wifi", "tiT", "loopTask", "async_tcp", "mqttclient",
-        "HuaweiHwIfc", "HuaweiTwai", "PM:SDM", "PM:HTTP+JSON", "PM:SML", "PM:HTTP+SML"
+        "HoyRadioNRF", "HoyRadioCMT", "HuaweiHwIfc", "TwaiBus", "PM:SDM",
+        "PM:HTTP+JSON", "PM:SML", "PM:HTTP+SML", "VE.Direct 0", "VE.Direct 1",
+        "VE.Direct 2", "Display"
     };
     for (char const* task_name : task_names) {
         TaskHandle_t const handle = xTaskGetHandle(task_name);
@@ -65,6 +97,8 @@ void WebApiSysstatusClass::onSystemStatus(AsyncWebServerRequest* request)
         task["name"] = task_name;
         task["stack_watermark"] = uxTaskGetStackHighWaterMark(handle);
         task["priority"] = uxTaskPriorityGet(handle);
+        BaseType_t core = xTaskGetAffinity(handle);
+        task["core"] = (core == tskNO_AFFINITY) ? -1 : core;
     }
 
     String reason;
@@ -89,15 +123,164 @@ void WebApiSysstatusClass::onSystemStatus(AsyncWebServerRequest* request)
     root["nrf_configured"] = PinMapping.isValidNrf24Config();
     root["nrf_connected"] = Hoymiles.getRadioNrf()->isConnected();
     root["nrf_pvariant"] = Hoymiles.getRadioNrf()->isPVariant();
+    addQueueLatency(root["nrf_queue_latency"].to<JsonObject>(), *Hoymiles.getRadioNrf());
 
     root["cmt_configured"] = PinMapping.isValidCmt2300Config();
     root["cmt_connected"] = Hoymiles.getRadioCmt()->isConnected();
+    addQueueLatency(root["cmt_queue_latency"].to<JsonObject>(), *Hoymiles.getRadioCmt());
 
     JsonArray uarts = root["uarts"].to<JsonArray>();
     for (auto const& allocation : SerialPortManager.getAllocations()) {
         JsonObject uart = uarts.add<JsonObject>();
-        uart["port"] = allocation.first;
-        uart["owner"] = allocation.second;
+        uart["port"] = allocation.Port;
+        uart["owner"] = allocation.Owner;
+        uart["shared"] = allocation.Shared;
+    }
+
+    JsonObject boot = root["boot"].to<JsonObject>();
+    boot["control_ms"] = BootProfiler.getControlMillis();
+    JsonArray stages = boot["stages"].to<JsonArray>();
+    for (auto const& stage : BootProfiler.getStages()) {
+        JsonObject entry = stages.add<JsonObject>();
+        entry["name"] = stage.Name;
+        entry["start_ms"] = stage.StartMillis;
+        entry["duration_ms"] = stage.DurationMillis;
+        entry["concurrent"] = stage.Concurrent;
+        entry["wait_ms"] = stage.WaitMillis;
+    }
+
+    JsonObject websockets = root["websockets"].to<JsonObject>();
+    websockets["sndbuf_size"] = WsMonitorClass::SendBufferSize;
+    websockets["backlog_limit_s"] = WsMonitor.getBacklogLimitSeconds();
+#ifdef CONFIG_ASYNC_TCP_QUEUE_SIZE
+    websockets["async_tcp_queue_size"] = CONFIG_ASYNC_TCP_QUEUE_SIZE;
+#endif
+    JsonArray sockets = websockets["sockets"].to<JsonArray>();
+    for (auto const& stats : WsMonitor.getStats()) {
+        JsonObject entry = sockets.add<JsonObject>();
+        entry["url"] = stats.Url;
+        entry["clients"] = stats.Clients;
+        entry["queued"] = stats.QueuedMessages;
+        entry["queue_max"] = stats.MaxQueueLength;
+        entry["queue_peak"] = stats.PeakQueueLength;
+        entry["sndbuf_used"] = stats.SendBufferUsed;
+        entry["sndbuf_max"] = stats.MaxSendBufferUsed;
+        entry["backlogged"] = stats.BackloggedClients;
+        entry["closed"] = stats.ClosedClients;
+    }
+}
+
+void WebApiSysstatusClass::onSystemTasks(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    auto response = new PooledJsonResponse(JsonDocumentPoolClass::SizeClass::Large);
+    auto& root = response->getRoot();
+
+    root["uptime"] = esp_timer_get_time() / 1000000;
+
+    JsonArray tasks = root["tasks"].to<JsonArray>();
+    for (auto const& stats : TaskProfiler.getStats()) {
+        JsonObject task = tasks.add<JsonObject>();
+        task["name"] = stats.Name;
+        task["interval_ms"] = stats.IntervalMillis;
+        task["count"] = stats.Count;
+        task["total_us"] = stats.TotalMicros;
+        task["avg_us"] = (stats.Count > 0) ? stats.TotalMicros / stats.Count : 0;
+        task["max_us"] = stats.MaxMicros;
+        task["overruns"] = stats.Overruns;
+        task["max_late_ms"] = stats.MaxLateMillis;
+    }
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
+
+void WebApiSysstatusClass::onSystemRoutes(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    auto response = new PooledJsonResponse(JsonDocumentPoolClass::SizeClass::Large);
+    auto& root = response->getRoot();
+
+    root["uptime"] = esp_timer_get_time() / 1000000;
+
+    JsonArray routes = root["routes"].to<JsonArray>();
+    for (auto const& stats : WebApi.getRouter().getStats()) {
+        JsonObject route = routes.add<JsonObject>();
+        route["uri"] = stats.Uri;
+        route["method"] = (stats.Method & HTTP_POST) ? "POST" : "GET";
+        route["count"] = stats.Count;
+        route["total_us"] = stats.TotalMicros;
+        route["avg_us"] = (stats.Count > 0) ? stats.TotalMicros / stats.Count : 0;
+        route["max_us"] = stats.MaxMicros;
+        route["overruns"] = stats.Overruns;
+        route["rejected"] = stats.Rejected;
+    }
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
+
+void WebApiSysstatusClass::onSystemHeap(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    auto response = new PooledJsonResponse(JsonDocumentPoolClass::SizeClass::Large);
+    auto& root = response->getRoot();
+
+    root["uptime"] = esp_timer_get_time() / 1000000;
+    root["heap_free"] = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    root["heap_min_free"] = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    root["heap_max_block"] = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    root["fragmentation"] = HeapMonitor.getFragmentation();
+
+    JsonArray history = root["fragmentation_history"].to<JsonArray>();
+    for (auto sample : HeapMonitor.getFragmentationHistory()) {
+        history.add(sample);
+    }
+
+    JsonArray tags = root["tags"].to<JsonArray>();
+    for (auto const& stats : HeapMonitor.getTagStats()) {
+        JsonObject tag = tags.add<JsonObject>();
+        tag["name"] = stats.Name;
+        tag["scopes"] = stats.Scopes;
+        tag["net_bytes"] = stats.NetBytes;
+        tag["bytes_per_minute"] = stats.BytesPerMinute;
+        tag["failed_allocs"] = stats.FailedAllocs;
+        tag["failed_bytes"] = stats.FailedBytes;
+    }
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
+
+void WebApiSysstatusClass::onSystemSpi(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    auto response = new PooledJsonResponse(JsonDocumentPoolClass::SizeClass::Small);
+    auto& root = response->getRoot();
+
+    root["uptime"] = esp_timer_get_time() / 1000000;
+
+    JsonArray devices = root["devices"].to<JsonArray>();
+    for (auto const& stats : SpiManagerInst.get_device_stats()) {
+        JsonObject device = devices.add<JsonObject>();
+        device["name"] = stats.name;
+        device["bus"] = stats.bus_id;
+        device["priority"] = static_cast<uint8_t>(stats.priority);
+        device["transactions"] = stats.transactions;
+        device["busy_us"] = stats.busy_us;
+        device["max_us"] = stats.max_us;
+        device["waits"] = stats.waits;
+        device["wait_us"] = stats.wait_us;
+        device["max_wait_us"] = stats.max_wait_us;
     }
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
@@ -3,6 +3,7 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_webapp.h"
+#include "WebApi.h"
 #include <MD5Builder.h>
 
 extern const uint8_t file_index_html_start[] asm("_binary_webapp_dist_index_html_gz_start");
@@ -11,6 +12,11 @@ extern const uint8_t file_favicon_png_start[] asm("_binary_webapp_dist_favicon_p
 extern const uint8_t file_zones_json_start[] asm("_binary_webapp_dist_zones_json_gz_start");
 extern const uint8_t file_app_js_start[] asm("_binary_webapp_dist_js_app_js_gz_start");
 extern const uint8_t file_site_webmanifest_start[] asm("_binary_webapp_dist_site_webmanifest_start");
+extern const uint8_t file_index_html_br_start[] asm("_binary_webapp_dist_index_html_br_start");
+extern const uint8_t file_zones_json_br_start[] asm("_binary_webapp_dist_zones_json_br_start");
+extern const uint8_t file_app_js_br_start[] asm("_binary_webapp_dist_js_app_js_br_start");
+extern const uint8_t file_views_js_start[] asm("_binary_webapp_dist_js_views_js_gz_start");
+extern const uint8_t file_views_js_br_start[] asm("_binary_webapp_dist_js_views_js_br_start");
 
 extern const uint8_t file_index_html_end[] asm("_binary_webapp_dist_index_html_gz_end");
 extern const uint8_t file_favicon_ico_end[] asm("_binary_webapp_dist_favicon_ico_end");
@@ -18,6 +24,41 @@ extern const uint8_t file_favicon_png_end[] asm("_binary_webapp_dist_favicon_png
 extern const uint8_t file_zones_json_end[] asm("_binary_webapp_dist_zones_json_gz_end");
 extern const uint8_t file_app_js_end[] asm("_binary_webapp_dist_js_app_js_gz_end");
 extern const uint8_t file_site_webmanifest_end[] asm("_binary_webapp_dist_site_webmanifest_end");
+extern const uint8_t file_index_html_br_end[] asm("_binary_webapp_dist_index_html_br_end");
+extern const uint8_t file_zones_json_br_end[] asm("_binary_webapp_dist_zones_json_br_end");
+extern const uint8_t file_app_js_br_end[] asm("_binary_webapp_dist_js_app_js_br_end");
+extern const uint8_t file_views_js_end[] asm("_binary_webapp_dist_js_views_js_gz_end");
+extern const uint8_t file_views_js_br_end[] asm("_binary_webapp_dist_js_views_js_br_end");
+
+// browsers advertise brotli only for HTTPS, i.e., if the web interface is
+// accessed through a reverse proxy terminating TLS.
+static bool acceptsBrotli(AsyncWebServerRequest* request)
+{
+    if (!request->hasHeader("Accept-Encoding")) { return false; }
+
+    String const& accepted = request->getHeader("Accept-Encoding")->value();
+    int start = 0;
+    while (start < static_cast<int>(accepted.length())) {
+        int end = accepted.indexOf(',', start);
+        if (end < 0) { end = accepted.length(); }
+
+        String coding = accepted.substring(start, end);
+        coding.trim();
+        int params = coding.indexOf(';');
+        String name = (params < 0) ? coding : coding.substring(0, params);
+        name.trim();
+
+        if (name.equalsIgnoreCase("br")) {
+            // "br;q=0" explicitly rejects brotli
+            int quality = (params < 0) ? -1 : coding.indexOf("q=", params);
+            return quality < 0 || coding.substring(quality + 2).toFloat() > 0;
+        }
+
+        start = end + 1;
+    }
+
+    return false;
+}
 
 void WebApiWebappClass::responseBinaryDataWithETagCache(AsyncWebServerRequest *request, const String &contentType, const String &contentEncoding, const uint8_t *content, size_t len)
 {
@@ -51,46 +92,79 @@ void WebApiWebappClass::responseBinaryDataWithETagCache(AsyncWebServerRequest *r
     // HTTP requires cache headers in 200 and 304 to be identical
     response->addHeader("Cache-Control", "public, must-revalidate");
     response->addHeader("ETag", expectedEtag);
+    if (contentEncoding.length() > 0) {
+        response->addHeader("Vary", "Accept-Encoding");
+    }
 
     request->send(response);
 }
 
+void WebApiWebappClass::responseCompressedDataWithETagCache(AsyncWebServerRequest* request, const String& contentType,
+    const uint8_t* gzContent, size_t gzLen, const uint8_t* brContent, size_t brLen)
+{
+    if (acceptsBrotli(request)) {
+        responseBinaryDataWithETagCache(request, contentType, "br", brContent, brLen);
+        return;
+    }
+
+    responseBinaryDataWithETagCache(request, contentType, "gzip", gzContent, gzLen);
+}
+
 void WebApiWebappClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     /*
-       We don't validate the request header "Accept-Encoding" if gzip compression is supported!
-       We just have the gzipped data available - so we ship them!
+       The compressed files are available as brotli and as gzip. brotli is
+       shipped if the client accepts it. We don't validate the request
+       header "Accept-Encoding" if gzip compression is supported otherwise!
     */
 
-    server.on("/", HTTP_GET, [&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, "text/html", "gzip", file_index_html_start, file_index_html_end - file_index_html_start);
+    auto& router = WebApi.getRouter();
+    router.on("/", HTTP_GET, [&](AsyncWebServerRequest* request) {
+        responseCompressedDataWithETagCache(request, "text/html",
+            file_index_html_start, file_index_html_end - file_index_html_start,
+            file_index_html_br_start, file_index_html_br_end - file_index_html_br_start);
     });
 
     server.onNotFound([&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, "text/html", "gzip", file_index_html_start, file_index_html_end - file_index_html_start);
+        responseCompressedDataWithETagCache(request, "text/html",
+            file_index_html_start, file_index_html_end - file_index_html_start,
+            file_index_html_br_start, file_index_html_br_end - file_index_html_br_start);
     });
 
-    server.on("/index.html", HTTP_GET, [&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, "text/html", "gzip", file_index_html_start, file_index_html_end - file_index_html_start);
+    router.on("/index.html", HTTP_GET, [&](AsyncWebServerRequest* request) {
+        responseCompressedDataWithETagCache(request, "text/html",
+            file_index_html_start, file_index_html_end - file_index_html_start,
+            file_index_html_br_start, file_index_html_br_end - file_index_html_br_start);
     });
 
-    server.on("/favicon.ico", HTTP_GET, [&](AsyncWebServerRequest* request) {
+    router.on("/favicon.ico", HTTP_GET, [&](AsyncWebServerRequest* request) {
         responseBinaryDataWithETagCache(request, "image/x-icon", "", file_favicon_ico_start, file_favicon_ico_end - file_favicon_ico_start);
     });
 
-    server.on("/favicon.png", HTTP_GET, [&](AsyncWebServerRequest* request) {
+    router.on("/favicon.png", HTTP_GET, [&](AsyncWebServerRequest* request) {
         responseBinaryDataWithETagCache(request, "image/png", "", file_favicon_png_start, file_favicon_png_end - file_favicon_png_start);
     });
 
-    server.on("/zones.json", HTTP_GET, [&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, "application/json", "gzip", file_zones_json_start, file_zones_json_end - file_zones_json_start);
+    router.on("/zones.json", HTTP_GET, [&](AsyncWebServerRequest* request) {
+        responseCompressedDataWithETagCache(request, "application/json",
+            file_zones_json_start, file_zones_json_end - file_zones_json_start,
+            file_zones_json_br_start, file_zones_json_br_end - file_zones_json_br_start);
     });
 
-    server.on("/site.webmanifest", HTTP_GET, [&](AsyncWebServerRequest* request) {
+    router.on("/site.webmanifest", HTTP_GET, [&](AsyncWebServerRequest* request) {
         responseBinaryDataWithETagCache(request, "application/json", "", file_site_webmanifest_start, file_site_webmanifest_end - file_site_webmanifest_start);
     });
 
-    server.on("/js/app.js", HTTP_GET, [&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, "text/javascript", "gzip", file_app_js_start, file_app_js_end - file_app_js_start);
+    router.on("/js/app.js", HTTP_GET, [&](AsyncWebServerRequest* request) {
+        responseCompressedDataWithETagCache(request, "text/javascript",
+            file_app_js_start, file_app_js_end - file_app_js_start,
+            file_app_js_br_start, file_app_js_br_end - file_app_js_br_start);
+    });
+
+    // the views besides the live dashboard, loaded on navigation
+    router.on("/js/views.js", HTTP_GET, [&](AsyncWebServerRequest* request) {
+        responseCompressedDataWithETagCache(request, "text/javascript",
+            file_views_js_start, file_views_js_end - file_views_js_start,
+            file_views_js_br_start, file_views_js_br_end - file_views_js_br_start);
     });
 }
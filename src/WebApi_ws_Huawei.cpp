@@ -10,10 +10,16 @@
 #include "Utils.h"
 #include "WebApi.h"
 #include "defaults.h"
+#include "TaskProfiler.h"
+#include "WsMonitor.h"
 
-WebApiWsHuaweiLiveClass::WebApiWsHuaweiLiveClass()
+WebApiWsHuaweiLiveClass::WebApiWsHuaweiLiveClass(WebApiWsMuxClass& mux, WebApiSseClass& sse)
     : _ws("/huaweilivedata")
+    , _publisher(_ws)
+    , _muxPublisher(mux.getSocket(), "huawei")
+    , _sse(sse)
 {
+    mux.addPublisher(_muxPublisher);
 }
 
 void WebApiWsHuaweiLiveClass::init(AsyncWebServer& server, Scheduler& scheduler)
@@ -26,19 +32,21 @@ void WebApiWsHuaweiLiveClass::init(AsyncWebServer& server, Scheduler& scheduler)
     using std::placeholders::_6;
 
     _server = &server;
-    _server->on("/api/huaweilivedata/status", HTTP_GET, std::bind(&WebApiWsHuaweiLiveClass::onLivedataStatus, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/huaweilivedata/status", HTTP_GET, std::bind(&WebApiWsHuaweiLiveClass::onLivedataStatus, this, _1));
 
     _server->addHandler(&_ws);
+    WsMonitor.addSocket(_ws);
     _ws.onEvent(std::bind(&WebApiWsHuaweiLiveClass::onWebsocketEvent, this, _1, _2, _3, _4, _5, _6));
 
     scheduler.addTask(_wsCleanupTask);
-    _wsCleanupTask.setCallback(std::bind(&WebApiWsHuaweiLiveClass::wsCleanupTaskCb, this));
+    _wsCleanupTask.setCallback(TaskProfiler.wrap("WebApiWsHuaweiLive::wsCleanupTaskCb", std::bind(&WebApiWsHuaweiLiveClass::wsCleanupTaskCb, this)));
     _wsCleanupTask.setIterations(TASK_FOREVER);
     _wsCleanupTask.setInterval(1 * TASK_SECOND);
     _wsCleanupTask.enable();
 
     scheduler.addTask(_sendDataTask);
-    _sendDataTask.setCallback(std::bind(&WebApiWsHuaweiLiveClass::sendDataTaskCb, this));
+    _sendDataTask.setCallback(TaskProfiler.wrap("WebApiWsHuaweiLive::sendDataTaskCb", std::bind(&WebApiWsHuaweiLiveClass::sendDataTaskCb, this)));
     _sendDataTask.setIterations(TASK_FOREVER);
     _sendDataTask.setInterval(1 * TASK_SECOND);
     _sendDataTask.enable();
@@ -73,23 +81,17 @@ void WebApiWsHuaweiLiveClass::wsCleanupTaskCb()
 void WebApiWsHuaweiLiveClass::sendDataTaskCb()
 {
     // do nothing if no WS client is connected
-    if (_ws.count() == 0) {
+    if (!_publisher.hasClients() && !_muxPublisher.hasClients() && !_sse.hasClients()) {
         return;
     }
 
     try {
-        std::lock_guard<std::mutex> lock(_mutex);
-        JsonDocument root;
-        JsonVariant var = root;
+        auto fragment = getFragment();
+        if (!fragment.spDoc) { return; }
 
-        generateCommonJsonResponse(var);
-
-        if (Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) {
-            String buffer;
-            serializeJson(root, buffer);
-
-            _ws.textAll(buffer);
-        }
+        _publisher.publish(*fragment.spDoc, fragment.spText);
+        _muxPublisher.publish(*fragment.spDoc);
+        _sse.publish("huawei", *fragment.spDoc, fragment.spText);
     } catch (std::bad_alloc& bad_alloc) {
         MessageOutput.printf("Calling /api/huaweilivedata/status has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
     } catch (const std::exception& exc) {
@@ -97,13 +99,24 @@ void WebApiWsHuaweiLiveClass::sendDataTaskCb()
     }
 }
 
-void WebApiWsHuaweiLiveClass::generateCommonJsonResponse(JsonVariant& root)
+JsonFragmentCache::Fragment WebApiWsHuaweiLiveClass::getFragment()
 {
-    HuaweiCan.getJsonData(root);
+    // the data age (in seconds) is part of the document
+    auto lastUpdate = HuaweiCan.getDataPoints().getLastUpdate();
+    auto version = JsonETag()
+        .add(lastUpdate)
+        .add(static_cast<uint32_t>((millis() - lastUpdate) / 1000))
+        .getHash();
+
+    return _cache.get(version, [](JsonVariant& root) {
+        HuaweiCan.getJsonData(root);
+    });
 }
 
 void WebApiWsHuaweiLiveClass::onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len)
 {
+    _publisher.onWebsocketEvent(client, type, arg, data, len);
+
     if (type == WS_EVT_CONNECT) {
         char str[64];
         snprintf(str, sizeof(str), "Websocket: [%s][%u] connect", server->url(), client->id());
@@ -123,13 +136,13 @@ void WebApiWsHuaweiLiveClass::onLivedataStatus(AsyncWebServerRequest* request)
         return;
     }
     try {
-        std::lock_guard<std::mutex> lock(_mutex);
-        AsyncJsonResponse* response = new AsyncJsonResponse();
-        auto& root = response->getRoot();
-
-        generateCommonJsonResponse(root);
+        auto fragment = getFragment();
+        if (!fragment.spText) {
+            WebApi.sendTooManyRequests(request);
+            return;
+        }
 
-        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        JsonFragmentCache::send(request, fragment);
 
     } catch (std::bad_alloc& bad_alloc) {
         MessageOutput.printf("Calling /api/huaweilivedata/status has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
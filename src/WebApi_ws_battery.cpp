@@ -11,10 +11,16 @@
 #include "WebApi.h"
 #include "defaults.h"
 #include "Utils.h"
+#include "TaskProfiler.h"
+#include "WsMonitor.h"
 
-WebApiWsBatteryLiveClass::WebApiWsBatteryLiveClass()
+WebApiWsBatteryLiveClass::WebApiWsBatteryLiveClass(WebApiWsMuxClass& mux, WebApiSseClass& sse)
     : _ws("/batterylivedata")
+    , _publisher(_ws)
+    , _muxPublisher(mux.getSocket(), "battery")
+    , _sse(sse)
 {
+    mux.addPublisher(_muxPublisher);
 }
 
 void WebApiWsBatteryLiveClass::init(AsyncWebServer& server, Scheduler& scheduler)
@@ -27,19 +33,21 @@ void WebApiWsBatteryLiveClass::init(AsyncWebServer& server, Scheduler& scheduler
     using std::placeholders::_6;
 
     _server = &server;
-    _server->on("/api/batterylivedata/status", HTTP_GET, std::bind(&WebApiWsBatteryLiveClass::onLivedataStatus, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/batterylivedata/status", HTTP_GET, std::bind(&WebApiWsBatteryLiveClass::onLivedataStatus, this, _1));
 
     _server->addHandler(&_ws);
+    WsMonitor.addSocket(_ws);
     _ws.onEvent(std::bind(&WebApiWsBatteryLiveClass::onWebsocketEvent, this, _1, _2, _3, _4, _5, _6));
 
     scheduler.addTask(_wsCleanupTask);
-    _wsCleanupTask.setCallback(std::bind(&WebApiWsBatteryLiveClass::wsCleanupTaskCb, this));
+    _wsCleanupTask.setCallback(TaskProfiler.wrap("WebApiWsBatteryLive::wsCleanupTaskCb", std::bind(&WebApiWsBatteryLiveClass::wsCleanupTaskCb, this)));
     _wsCleanupTask.setIterations(TASK_FOREVER);
     _wsCleanupTask.setInterval(1 * TASK_SECOND);
     _wsCleanupTask.enable();
 
     scheduler.addTask(_sendDataTask);
-    _sendDataTask.setCallback(std::bind(&WebApiWsBatteryLiveClass::sendDataTaskCb, this));
+    _sendDataTask.setCallback(TaskProfiler.wrap("WebApiWsBatteryLive::sendDataTaskCb", std::bind(&WebApiWsBatteryLiveClass::sendDataTaskCb, this)));
     _sendDataTask.setIterations(TASK_FOREVER);
     _sendDataTask.setInterval(1 * TASK_SECOND);
     _sendDataTask.enable();
@@ -74,36 +82,31 @@ void WebApiWsBatteryLiveClass::wsCleanupTaskCb()
 void WebApiWsBatteryLiveClass::sendDataTaskCb()
 {
     // do nothing if no WS client is connected
-    if (_ws.count() == 0) {
+    if (!_publisher.hasClients() && !_muxPublisher.hasClients() && !_sse.hasClients()) {
         return;
     }
 
-    if (!Battery.getStats()->updateAvailable(_lastUpdateCheck)) { return; }
+    // a client which connected to the event stream relies on the current data
+    bool resync = _sse.takeResyncRequest(_sseConnects);
+    if (!Battery.getStats()->updateAvailable(_lastUpdateCheck) && !resync) { return; }
     _lastUpdateCheck = millis();
 
     try {
-        std::lock_guard<std::mutex> lock(_mutex);
-        JsonDocument root;
-        JsonVariant var = root;
-        
-        generateCommonJsonResponse(var);
+        auto fragment = getFragment();
+        if (!fragment.spDoc) { return; }
 
-        if (Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) {
+        // battery provider does not generate a card, e.g., MQTT provider
+        if (fragment.spDoc->size() == 0) { return; }
 
-            // battery provider does not generate a card, e.g., MQTT provider
-            if (root.isNull()) { return; }
-
-            String buffer;
-            serializeJson(root, buffer);
-
-            if (Configuration.get().Security.AllowReadonly) {
-                _ws.setAuthentication("", "");
-            } else {
-                _ws.setAuthentication(AUTH_USERNAME, Configuration.get().Security.Password);
-            }
-
-            _ws.textAll(buffer);
+        if (Configuration.get().Security.AllowReadonly) {
+            _ws.setAuthentication("", "");
+        } else {
+            _ws.setAuthentication(AUTH_USERNAME, Configuration.get().Security.Password);
         }
+
+        _publisher.publish(*fragment.spDoc, fragment.spText);
+        _muxPublisher.publish(*fragment.spDoc);
+        _sse.publish("battery", *fragment.spDoc, fragment.spText);
     } catch (std::bad_alloc& bad_alloc) {
         MessageOutput.printf("Calling /api/batterylivedata/status has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
     } catch (const std::exception& exc) {
@@ -111,13 +114,27 @@ void WebApiWsBatteryLiveClass::sendDataTaskCb()
     }
 }
 
-void WebApiWsBatteryLiveClass::generateCommonJsonResponse(JsonVariant& root)
+JsonFragmentCache::Fragment WebApiWsBatteryLiveClass::getFragment()
 {
-    Battery.getStats()->getLiveViewData(root);
+    auto spStats = Battery.getStats();
+
+    // the data age is part of the document. the stats are replaced if
+    // another provider is selected.
+    auto version = JsonETag()
+        .add(spStats->getLastUpdate())
+        .add(spStats->getAgeSeconds())
+        .add(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(spStats.get())))
+        .getHash();
+
+    return _cache.get(version, [&spStats](JsonVariant& root) {
+        spStats->getLiveViewData(root);
+    });
 }
 
 void WebApiWsBatteryLiveClass::onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len)
 {
+    _publisher.onWebsocketEvent(client, type, arg, data, len);
+
     if (type == WS_EVT_CONNECT) {
         MessageOutput.printf("Websocket: [%s][%u] connect\r\n", server->url(), client->id());
     } else if (type == WS_EVT_DISCONNECT) {
@@ -131,12 +148,13 @@ void WebApiWsBatteryLiveClass::onLivedataStatus(AsyncWebServerRequest* request)
         return;
     }
     try {
-        std::lock_guard<std::mutex> lock(_mutex);
-        AsyncJsonResponse* response = new AsyncJsonResponse();
-        auto& root = response->getRoot();
-        generateCommonJsonResponse(root);
+        auto fragment = getFragment();
+        if (!fragment.spText) {
+            WebApi.sendTooManyRequests(request);
+            return;
+        }
 
-        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        JsonFragmentCache::send(request, fragment);
     } catch (std::bad_alloc& bad_alloc) {
         MessageOutput.printf("Calling /api/batterylivedata/status has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
         WebApi.sendTooManyRequests(request);
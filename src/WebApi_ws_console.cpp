@@ -7,21 +7,48 @@
 #include "MessageOutput.h"
 #include "WebApi.h"
 #include "defaults.h"
+#include "TaskProfiler.h"
+#include "WsMonitor.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+
+namespace {
+
+// sent by a client to only receive the lines starting with any of the comma
+// separated prefixes, e.g., "filter:[DPL],[VE.Direct]". an empty list
+// clears the filters.
+constexpr char const FilterRequest[] = "filter:";
+
+} // namespace
 
 WebApiWsConsoleClass::WebApiWsConsoleClass()
     : _ws("/console")
-    , _wsCleanupTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&WebApiWsConsoleClass::wsCleanupTaskCb, this))
+    , _wsCleanupTask(1 * TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("WebApiWsConsole::wsCleanupTaskCb", std::bind(&WebApiWsConsoleClass::wsCleanupTaskCb, this)))
+    , _flushTask(BatchIntervalMillis * TASK_MILLISECOND, TASK_FOREVER, TaskProfiler.wrap("WebApiWsConsole::flushTaskCb", std::bind(&WebApiWsConsoleClass::flushTaskCb, this)))
 {
 }
 
 void WebApiWsConsoleClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+    using std::placeholders::_3;
+    using std::placeholders::_4;
+    using std::placeholders::_5;
+    using std::placeholders::_6;
+
     server.addHandler(&_ws);
-    MessageOutput.register_ws_output(&_ws);
+    WsMonitor.addSocket(_ws);
+    _ws.onEvent(std::bind(&WebApiWsConsoleClass::onWebsocketEvent, this, _1, _2, _3, _4, _5, _6));
+    MessageOutput.register_ws_output(std::bind(&WebApiWsConsoleClass::onLine, this, _1, _2));
 
     scheduler.addTask(_wsCleanupTask);
     _wsCleanupTask.enable();
 
+    scheduler.addTask(_flushTask);
+    _flushTask.enable();
+
     _simpleDigestAuth.setUsername(AUTH_USERNAME);
     _simpleDigestAuth.setRealm("console websocket");
 
@@ -48,3 +75,108 @@ void WebApiWsConsoleClass::wsCleanupTaskCb()
     // see: https://github.com/me-no-dev/ESPAsyncWebServer#limiting-the-number-of-web-socket-clients
     _ws.cleanupClients();
 }
+
+void WebApiWsConsoleClass::onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = std::find_if(_clients.begin(), _clients.end(),
+        [client](Client const& c) { return c.Id == client->id(); });
+
+    if (type == WS_EVT_CONNECT) {
+        if (it == _clients.end()) { _clients.push_back({ client->id() }); }
+        return;
+    }
+
+    if (type == WS_EVT_DISCONNECT) {
+        if (it != _clients.end()) { _clients.erase(it); }
+        return;
+    }
+
+    if (type != WS_EVT_DATA || it == _clients.end()) { return; }
+
+    auto info = static_cast<AwsFrameInfo const*>(arg);
+    if (!info->final || info->index != 0 || info->len != len || info->opcode != WS_TEXT) {
+        return;
+    }
+
+    size_t const prefixLength = strlen(FilterRequest);
+    if (len < prefixLength || memcmp(data, FilterRequest, prefixLength) != 0) { return; }
+
+    it->Filters.clear();
+
+    auto pos = reinterpret_cast<char const*>(data) + prefixLength;
+    auto end = reinterpret_cast<char const*>(data) + len;
+    while (pos < end) {
+        auto comma = std::find(pos, end, ',');
+        if (comma > pos) { it->Filters.emplace_back(pos, comma); }
+        pos = comma + 1;
+    }
+}
+
+bool WebApiWsConsoleClass::matches(Client const& client, uint8_t const* data, size_t size)
+{
+    if (client.Filters.empty()) { return true; }
+
+    for (auto const& filter : client.Filters) {
+        if (size >= filter.size() && memcmp(data, filter.data(), filter.size()) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool WebApiWsConsoleClass::send(Client& client)
+{
+    auto pClient = _ws.client(client.Id);
+    if (!pClient || pClient->status() != WS_CONNECTED) { return false; }
+
+    // the previous frame is still queued, so the client does not keep up.
+    // its batch is retained and lines which do not fit are dropped.
+    if (pClient->queueLen() > 0) { return false; }
+
+    auto spFrame = std::make_shared<std::vector<uint8_t>>();
+
+    if (client.Dropped > 0) {
+        char notice[64];
+        int length = snprintf(notice, sizeof(notice),
+                "[Console] %" PRIu32 " lines were dropped\r\n", client.Dropped);
+        spFrame->assign(notice, notice + std::min<size_t>(length, sizeof(notice) - 1));
+    }
+
+    spFrame->insert(spFrame->end(), client.Batch.begin(), client.Batch.end());
+    if (spFrame->empty()) { return true; }
+
+    if (!pClient->text(spFrame)) { return false; }
+
+    client.Batch.clear();
+    client.Dropped = 0;
+    return true;
+}
+
+void WebApiWsConsoleClass::onLine(uint8_t const* data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (auto& client : _clients) {
+        if (!matches(client, data, size)) { continue; }
+
+        if (client.Batch.size() + size > MaxFrameSize && !send(client)) {
+            ++client.Dropped;
+            continue;
+        }
+
+        client.Batch.insert(client.Batch.end(), data, data + size);
+    }
+}
+
+void WebApiWsConsoleClass::flushTaskCb()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (auto& client : _clients) {
+        if (client.Batch.empty() && client.Dropped == 0) { continue; }
+        send(client);
+    }
+}
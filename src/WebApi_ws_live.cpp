@@ -3,8 +3,11 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_ws_live.h"
+#include "DataBus.h"
 #include "Datastore.h"
 #include "MessageOutput.h"
+#include "NightMode.h"
+#include "PowerLimiter.h"
 #include "Utils.h"
 #include "WebApi.h"
 #include <battery/Controller.h>
@@ -14,16 +17,23 @@
 #include "defaults.h"
 #include <solarcharger/Controller.h>
 #include <AsyncJson.h>
+#include <algorithm>
+#include "TaskProfiler.h"
+#include "WsMonitor.h"
 
 #ifndef PIN_MAPPING_REQUIRED
     #define PIN_MAPPING_REQUIRED 0
 #endif
 
-WebApiWsLiveClass::WebApiWsLiveClass()
+WebApiWsLiveClass::WebApiWsLiveClass(WebApiWsMuxClass& mux, WebApiSseClass& sse)
     : _ws("/livedata")
-    , _wsCleanupTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&WebApiWsLiveClass::wsCleanupTaskCb, this))
-    , _sendDataTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&WebApiWsLiveClass::sendDataTaskCb, this))
+    , _publisher(_ws)
+    , _muxPublisher(mux.getSocket(), "live")
+    , _sse(sse)
+    , _wsCleanupTask(1 * TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("WebApiWsLive::wsCleanupTaskCb", std::bind(&WebApiWsLiveClass::wsCleanupTaskCb, this)))
+    , _sendDataTask(1 * TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("WebApiWsLive::sendDataTaskCb", std::bind(&WebApiWsLiveClass::sendDataTaskCb, this)))
 {
+    mux.addPublisher(_muxPublisher);
 }
 
 void WebApiWsLiveClass::init(AsyncWebServer& server, Scheduler& scheduler)
@@ -35,9 +45,11 @@ void WebApiWsLiveClass::init(AsyncWebServer& server, Scheduler& scheduler)
     using std::placeholders::_5;
     using std::placeholders::_6;
 
-    server.on("/api/livedata/status", HTTP_GET, std::bind(&WebApiWsLiveClass::onLivedataStatus, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/livedata/status", HTTP_GET, std::bind(&WebApiWsLiveClass::onLivedataStatus, this, _1));
 
     server.addHandler(&_ws);
+    WsMonitor.addSocket(_ws);
     _ws.onEvent(std::bind(&WebApiWsLiveClass::onWebsocketEvent, this, _1, _2, _3, _4, _5, _6));
 
     scheduler.addTask(_wsCleanupTask);
@@ -77,8 +89,12 @@ void WebApiWsLiveClass::generateOnBatteryJsonResponse(JsonVariant& root, bool al
     auto const& config = Configuration.get();
     auto constexpr halfOfAllMillis = std::numeric_limits<uint32_t>::max() / 2;
 
-    auto solarChargerAge = SolarCharger.getStats()->getAgeMillis();
-    if (all || (solarChargerAge > 0 && (millis() - _lastPublishSolarCharger) > solarChargerAge)) {
+    // the sections are sent if new data was announced on the DataBus since
+    // they were last sent
+    using Topic = DataBusClass::Topic;
+
+    auto solarChargerSequence = DataBus.getSequence(Topic::SolarCharger);
+    if (all || solarChargerSequence != _lastSolarChargerSequence) {
         auto solarchargerObj = root["solarcharger"].to<JsonObject>();
         solarchargerObj["enabled"] = config.SolarCharger.Enabled;
 
@@ -108,7 +124,7 @@ void WebApiWsLiveClass::generateOnBatteryJsonResponse(JsonVariant& root, bool al
             }
         }
 
-        if (!all) { _lastPublishSolarCharger = millis(); }
+        if (!all) { _lastSolarChargerSequence = solarChargerSequence; }
     }
 
     if (all || (HuaweiCan.getDataPoints().getLastUpdate() - _lastPublishHuawei) < halfOfAllMillis ) {
@@ -127,7 +143,8 @@ void WebApiWsLiveClass::generateOnBatteryJsonResponse(JsonVariant& root, bool al
     }
 
     auto spStats = Battery.getStats();
-    if (all || spStats->updateAvailable(_lastPublishBattery)) {
+    auto batterySequence = DataBus.getSequence(Topic::Battery);
+    if (all || batterySequence != _lastBatterySequence) {
         auto batteryObj = root["battery"].to<JsonObject>();
         batteryObj["enabled"] = config.Battery.Enabled;
 
@@ -149,18 +166,45 @@ void WebApiWsLiveClass::generateOnBatteryJsonResponse(JsonVariant& root, bool al
             }
         }
 
-        if (!all) { _lastPublishBattery = millis(); }
+        if (!all) { _lastBatterySequence = batterySequence; }
     }
 
-    if (all || (PowerMeter.getLastUpdate() - _lastPublishPowerMeter) < halfOfAllMillis) {
+    auto powerMeterSequence = DataBus.getSequence(Topic::PowerMeter);
+    if (all || powerMeterSequence != _lastPowerMeterSequence) {
         auto powerMeterObj = root["power_meter"].to<JsonObject>();
         powerMeterObj["enabled"] = config.PowerMeter.Enabled;
 
         if (config.PowerMeter.Enabled) {
             addTotalField(powerMeterObj, "Power", PowerMeter.getPowerTotal(), "W", 1);
+
+            auto oPredicted = PowerMeter.getPredictedPowerTotal();
+            if (oPredicted) {
+                addTotalField(powerMeterObj, "Predicted", *oPredicted, "W", 1);
+                addTotalField(powerMeterObj, "Residual", PowerMeter.getEstimatorResidual(), "W", 1);
+            }
         }
 
-        if (!all) { _lastPublishPowerMeter = millis(); }
+        if (!all) { _lastPowerMeterSequence = powerMeterSequence; }
+    }
+
+    // the losses and the resistance are recalculated with every decision
+    auto dplSequence = DataBus.getSequence(Topic::DplDecision);
+    if (all || dplSequence != _lastDplDecisionSequence) {
+        auto powerLimiterObj = root["power_limiter"].to<JsonObject>();
+        powerLimiterObj["enabled"] = config.PowerLimiter.Enabled;
+
+        if (config.PowerLimiter.Enabled) {
+            addTotalField(powerLimiterObj, "Losses", PowerLimiter.getInverterLossesWatts(), "W", 1);
+            addTotalField(powerLimiterObj, "SuppressedUpdates", PowerLimiter.getSuppressedLimitUpdates(), "", 0);
+
+            auto resistance = PowerLimiter.getBatteryResistance();
+            if (resistance > 0) {
+                addTotalField(powerLimiterObj, "Resistance", resistance * 1000, "mOhm", 1);
+                addTotalField(powerLimiterObj, "FitQuality", PowerLimiter.getBatteryResistanceFitQuality() * 100, "%", 0);
+            }
+        }
+
+        if (!all) { _lastDplDecisionSequence = dplSequence; }
     }
 }
 
@@ -176,22 +220,31 @@ void WebApiWsLiveClass::sendOnBatteryStats()
     if (root.isNull()) { return; }
 
     if (Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) {
-        String buffer;
-        serializeJson(root, buffer);
-
-        _ws.textAll(buffer);;
+        _publisher.publish(root);
+        _muxPublisher.publish(root);
+        _sse.publish("live", root);
     }
 }
 
 void WebApiWsLiveClass::sendDataTaskCb()
 {
     // do nothing if no WS client is connected
-    if (_ws.count() == 0) {
+    if (!_publisher.hasClients() && !_muxPublisher.hasClients() && !_sse.hasClients()) {
         return;
     }
 
+    // someone is watching the live view
+    NightMode.notifyActivity();
+
+    // a client which skipped frames relies on full frames to catch up
+    bool resync = _publisher.takeResyncRequest() | _muxPublisher.takeResyncRequest()
+        | _sse.takeResyncRequest(_sseConnects);
+    if (resync) { _lastPublishOnBatteryFull = millis() - (10 * 1000) - 1; }
+
     sendOnBatteryStats();
 
+    bool forceKeyframe = _forceKeyframe.exchange(false) || resync;
+
     // Loop all inverters
     for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
         auto inv = Hoymiles.getInverterByPos(i);
@@ -199,12 +252,23 @@ void WebApiWsLiveClass::sendDataTaskCb()
             continue;
         }
 
+        auto& state = _publishStates[i];
+        if (state.serial != inv->serial()) {
+            state = InverterPublishState();
+            state.serial = inv->serial();
+        }
+
+        // changed values are sent as soon as new statistics arrived, while
+        // a full keyframe is sent periodically to refresh all other values.
         const uint32_t lastUpdateInternal = inv->Statistics()->getLastUpdateFromInternal();
-        if (!((lastUpdateInternal > 0 && lastUpdateInternal > _lastPublishStats[i]) || (millis() - _lastPublishStats[i] > (10 * 1000)))) {
+        const bool newStats = lastUpdateInternal > 0 && lastUpdateInternal > state.lastPublish;
+        const bool keyframe = forceKeyframe || state.lastKeyframe == 0 || (millis() - state.lastKeyframe > (10 * 1000));
+        if (!newStats && !keyframe) {
             continue;
         }
 
-        _lastPublishStats[i] = millis();
+        state.lastPublish = millis();
+        if (keyframe) { state.lastKeyframe = state.lastPublish; }
 
         try {
             std::lock_guard<std::mutex> lock(_mutex);
@@ -216,16 +280,16 @@ void WebApiWsLiveClass::sendDataTaskCb()
 
             generateCommonJsonResponse(var);
             generateInverterCommonJsonResponse(invObject, inv);
-            generateInverterChannelJsonResponse(invObject, inv);
+            generateInverterChannelJsonResponse(invObject, inv, &state.values, !keyframe);
+            if (!keyframe) { invObject["delta"] = true; }
 
             if (!Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) {
                 continue;
             }
 
-            String buffer;
-            serializeJson(root, buffer);
-
-            _ws.textAll(buffer);
+            _publisher.publish(root);
+            _muxPublisher.publish(root);
+            _sse.publish("live", root);
 
         } catch (const std::bad_alloc& bad_alloc) {
             MessageOutput.printf("Calling /api/livedata/status has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
@@ -263,6 +327,7 @@ void WebApiWsLiveClass::generateInverterCommonJsonResponse(JsonObject& root, std
     root["order"] = inv_cfg->Order;
     root["data_age_ms"] = millis() - inv->Statistics()->getLastUpdate();
     root["poll_enabled"] = inv->getEnablePolling();
+    root["poll_interval_ms"] = inv->getEffectivePollInterval();
     root["reachable"] = inv->isReachable();
     root["producing"] = inv->isProducing();
     root["limit_relative"] = inv->SystemConfigPara()->getLimitPercent();
@@ -278,9 +343,17 @@ void WebApiWsLiveClass::generateInverterCommonJsonResponse(JsonObject& root, std
     root["radio_stats"]["rx_fail_partial"] = inv->RadioStats.RxFailPartialAnswer;
     root["radio_stats"]["rx_fail_corrupt"] = inv->RadioStats.RxFailCorruptData;
     root["radio_stats"]["rssi"] = inv->getLastRssi();
+
+    // trailing fragments which were never lost are omitted
+    auto const& lost = inv->RadioStats.LostFragments;
+    auto lostEnd = std::find_if(lost.rbegin(), lost.rend(), [](uint32_t count) { return count > 0; }).base();
+    auto lostFragments = root["radio_stats"]["lost_fragments"].to<JsonArray>();
+    for (auto it = lost.begin(); it != lostEnd; ++it) {
+        lostFragments.add(*it);
+    }
 }
 
-void WebApiWsLiveClass::generateInverterChannelJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv)
+void WebApiWsLiveClass::generateInverterChannelJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv, LastSentValues* lastSent, bool deltaOnly)
 {
     const INVERTER_CONFIG_T* inv_cfg = Configuration.getInverterConfig(inv->serial());
     if (inv_cfg == nullptr) {
@@ -291,28 +364,29 @@ void WebApiWsLiveClass::generateInverterChannelJsonResponse(JsonObject& root, st
     for (auto& t : inv->Statistics()->getChannelTypes()) {
         auto chanTypeObj = root[inv->Statistics()->getChannelTypeName(t)].to<JsonObject>();
         for (auto& c : inv->Statistics()->getChannelsByType(t)) {
-            if (t == TYPE_DC) {
+            if (t == TYPE_DC && !deltaOnly) {
                 chanTypeObj[String(static_cast<uint8_t>(c))]["name"]["u"] = inv_cfg->channel[c].Name;
             }
-            addField(chanTypeObj, inv, t, c, FLD_PAC);
-            addField(chanTypeObj, inv, t, c, FLD_UAC);
-            addField(chanTypeObj, inv, t, c, FLD_IAC);
+            addField(chanTypeObj, inv, t, c, FLD_PAC, "", lastSent, deltaOnly);
+            addField(chanTypeObj, inv, t, c, FLD_UAC, "", lastSent, deltaOnly);
+            addField(chanTypeObj, inv, t, c, FLD_IAC, "", lastSent, deltaOnly);
             if (t == TYPE_INV) {
-                addField(chanTypeObj, inv, t, c, FLD_PDC, "Power DC");
+                addField(chanTypeObj, inv, t, c, FLD_PDC, "Power DC", lastSent, deltaOnly);
             } else {
-                addField(chanTypeObj, inv, t, c, FLD_PDC);
+                addField(chanTypeObj, inv, t, c, FLD_PDC, "", lastSent, deltaOnly);
             }
-            addField(chanTypeObj, inv, t, c, FLD_UDC);
-            addField(chanTypeObj, inv, t, c, FLD_IDC);
-            addField(chanTypeObj, inv, t, c, FLD_YD);
-            addField(chanTypeObj, inv, t, c, FLD_YT);
-            addField(chanTypeObj, inv, t, c, FLD_F);
-            addField(chanTypeObj, inv, t, c, FLD_T);
-            addField(chanTypeObj, inv, t, c, FLD_PF);
-            addField(chanTypeObj, inv, t, c, FLD_Q);
-            addField(chanTypeObj, inv, t, c, FLD_EFF);
+            addField(chanTypeObj, inv, t, c, FLD_UDC, "", lastSent, deltaOnly);
+            addField(chanTypeObj, inv, t, c, FLD_IDC, "", lastSent, deltaOnly);
+            addField(chanTypeObj, inv, t, c, FLD_YD, "", lastSent, deltaOnly);
+            addField(chanTypeObj, inv, t, c, FLD_YT, "", lastSent, deltaOnly);
+            addField(chanTypeObj, inv, t, c, FLD_F, "", lastSent, deltaOnly);
+            addField(chanTypeObj, inv, t, c, FLD_T, "", lastSent, deltaOnly);
+            addField(chanTypeObj, inv, t, c, FLD_PF, "", lastSent, deltaOnly);
+            addField(chanTypeObj, inv, t, c, FLD_Q, "", lastSent, deltaOnly);
+            addField(chanTypeObj, inv, t, c, FLD_EFF, "", lastSent, deltaOnly);
             if (t == TYPE_DC && inv->Statistics()->getStringMaxPower(c) > 0) {
-                addField(chanTypeObj, inv, t, c, FLD_IRR);
+                addField(chanTypeObj, inv, t, c, FLD_IRR, "", lastSent, deltaOnly);
+                if (deltaOnly) { continue; }
                 chanTypeObj[String(c)][inv->Statistics()->getChannelFieldName(t, c, FLD_IRR)]["max"] = inv->Statistics()->getStringMaxPower(c);
             }
         }
@@ -325,9 +399,23 @@ void WebApiWsLiveClass::generateInverterChannelJsonResponse(JsonObject& root, st
     }
 }
 
-void WebApiWsLiveClass::addField(JsonObject& root, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, String topic)
+uint16_t WebApiWsLiveClass::fieldKey(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId)
+{
+    return (static_cast<uint16_t>(type) << 12) | (static_cast<uint16_t>(channel) << 8) | static_cast<uint16_t>(fieldId);
+}
+
+void WebApiWsLiveClass::addField(JsonObject& root, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, String topic, LastSentValues* lastSent, bool deltaOnly)
 {
     if (inv->Statistics()->hasChannelFieldValue(type, channel, fieldId)) {
+        float value = inv->Statistics()->getChannelFieldValue(type, channel, fieldId);
+
+        if (lastSent != nullptr) {
+            auto result = lastSent->emplace(fieldKey(type, channel, fieldId), value);
+            bool changed = result.second || result.first->second != value;
+            result.first->second = value;
+            if (deltaOnly && !changed) { return; }
+        }
+
         String chanName;
         if (topic == "") {
             chanName = inv->Statistics()->getChannelFieldName(type, channel, fieldId);
@@ -336,7 +424,8 @@ void WebApiWsLiveClass::addField(JsonObject& root, std::shared_ptr<InverterAbstr
         }
         String chanNum;
         chanNum = channel;
-        root[chanNum][chanName]["v"] = inv->Statistics()->getChannelFieldValue(type, channel, fieldId);
+        root[chanNum][chanName]["v"] = value;
+        if (deltaOnly) { return; }
         root[chanNum][chanName]["u"] = inv->Statistics()->getChannelFieldUnit(type, channel, fieldId);
         root[chanNum][chanName]["d"] = inv->Statistics()->getChannelFieldDigits(type, channel, fieldId);
     }
@@ -351,51 +440,111 @@ void WebApiWsLiveClass::addTotalField(JsonObject& root, const String& name, cons
 
 void WebApiWsLiveClass::onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len)
 {
+    _publisher.onWebsocketEvent(client, type, arg, data, len);
+
     if (type == WS_EVT_CONNECT) {
         MessageOutput.printf("Websocket: [%s][%u] connect\r\n", server->url(), client->id());
+        NightMode.notifyActivity();
+        _forceKeyframe = true;
     } else if (type == WS_EVT_DISCONNECT) {
         MessageOutput.printf("Websocket: [%s][%u] disconnect\r\n", server->url(), client->id());
     }
 }
 
+String WebApiWsLiveClass::getLivedataETag(uint64_t serial)
+{
+    JsonETag etag;
+    etag.add(serial);
+
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) { continue; }
+
+        // the totals cover all inverters, even if a single one is requested
+        etag.add(inv->Statistics()->getLastUpdate())
+            .add(inv->SystemConfigPara()->getLastUpdate())
+            .add(inv->PowerCommand()->getLastUpdate())
+            .add(inv->DevInfo()->getLastUpdate())
+            .add(inv->RadioStats.TxRequestData)
+            .add(static_cast<uint32_t>(inv->isReachable()))
+            .add(static_cast<uint32_t>(inv->isProducing()));
+    }
+
+    struct tm timeinfo;
+    etag.add(static_cast<uint32_t>(getLocalTime(&timeinfo, 5)));
+
+    // a jitter of a millisecond only causes a full response
+    etag.add(millis() - SolarCharger.getStats()->getAgeMillis())
+        .add(Battery.getStats()->getLastUpdate())
+        .add(PowerMeter.getLastUpdate())
+        .add(HuaweiCan.getDataPoints().getLastUpdate());
+
+    // the data ages in the response are computed from the current time
+    return etag.toString(true);
+}
+
+void WebApiWsLiveClass::generateSnapshot(JsonVariant& root)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto invArray = root["inverters"].to<JsonArray>();
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) { continue; }
+
+        auto invObject = invArray.add<JsonObject>();
+        generateInverterCommonJsonResponse(invObject, inv);
+        generateInverterChannelJsonResponse(invObject, inv);
+    }
+
+    generateCommonJsonResponse(root);
+    generateOnBatteryJsonResponse(root, true);
+}
+
 void WebApiWsLiveClass::onLivedataStatus(AsyncWebServerRequest* request)
 {
     if (!WebApi.checkCredentialsReadonly(request)) {
         return;
     }
 
+    auto serial = WebApi.parseSerialFromRequest(request);
+    auto etag = getLivedataETag(serial);
+    if (WebApi.sendNotModified(request, etag)) { return; }
+
     try {
-        std::lock_guard<std::mutex> lock(_mutex);
-        AsyncJsonResponse* response = new AsyncJsonResponse();
-        auto& root = response->getRoot();
-        auto invArray = root["inverters"].to<JsonArray>();
-        auto serial = WebApi.parseSerialFromRequest(request);
+        // the inverters are serialized one at a time while sending
+        JsonStreamResponse stream;
 
         if (serial > 0) {
-            auto inv = Hoymiles.getInverterBySerial(serial);
-            if (inv != nullptr) {
-                JsonObject invObject = invArray.add<JsonObject>();
+            stream.addArray("inverters", 1, [this, serial](size_t, JsonObject invObject) {
+                auto inv = Hoymiles.getInverterBySerial(serial);
+                if (inv == nullptr) { return false; }
+
+                std::lock_guard<std::mutex> lock(_mutex);
                 generateInverterCommonJsonResponse(invObject, inv);
                 generateInverterChannelJsonResponse(invObject, inv);
-            }
+                return true;
+            });
         } else {
             // Loop all inverters
-            for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+            stream.addArray("inverters", Hoymiles.getNumInverters(), [this](size_t i, JsonObject invObject) {
                 auto inv = Hoymiles.getInverterByPos(i);
-                if (inv == nullptr) {
-                    continue;
-                }
+                if (inv == nullptr) { return false; }
 
-                JsonObject invObject = invArray.add<JsonObject>();
+                std::lock_guard<std::mutex> lock(_mutex);
                 generateInverterCommonJsonResponse(invObject, inv);
-            }
+                return true;
+            });
         }
 
-        generateCommonJsonResponse(root);
-
-        generateOnBatteryJsonResponse(root, true);
+        stream.addMembers([this](JsonObject rootObject) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            JsonVariant root = rootObject;
+            generateCommonJsonResponse(root);
+            generateOnBatteryJsonResponse(root, true);
+        });
 
-        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        stream.send(request, etag);
 
     } catch (const std::bad_alloc& bad_alloc) {
         MessageOutput.printf("Calling /api/livedata/status has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "WebApi_ws_mux.h"
+#include "Configuration.h"
+#include "MessageOutput.h"
+#include "defaults.h"
+#include "TaskProfiler.h"
+#include "WsMonitor.h"
+
+WebApiWsMuxClass::WebApiWsMuxClass()
+    : _ws("/live")
+    , _wsCleanupTask(1 * TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("WebApiWsMux::wsCleanupTaskCb", std::bind(&WebApiWsMuxClass::wsCleanupTaskCb, this)))
+{
+}
+
+void WebApiWsMuxClass::init(AsyncWebServer& server, Scheduler& scheduler)
+{
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+    using std::placeholders::_3;
+    using std::placeholders::_4;
+    using std::placeholders::_5;
+    using std::placeholders::_6;
+
+    server.addHandler(&_ws);
+    WsMonitor.addSocket(_ws);
+    _ws.onEvent(std::bind(&WebApiWsMuxClass::onWebsocketEvent, this, _1, _2, _3, _4, _5, _6));
+
+    scheduler.addTask(_wsCleanupTask);
+    _wsCleanupTask.enable();
+
+    _simpleDigestAuth.setUsername(AUTH_USERNAME);
+    _simpleDigestAuth.setRealm("live websocket");
+
+    reload();
+}
+
+void WebApiWsMuxClass::reload()
+{
+    _ws.removeMiddleware(&_simpleDigestAuth);
+
+    auto const& config = Configuration.get();
+
+    if (config.Security.AllowReadonly) { return; }
+
+    _ws.enable(false);
+    _simpleDigestAuth.setPassword(config.Security.Password);
+    _ws.addMiddleware(&_simpleDigestAuth);
+    _ws.closeAll();
+    _ws.enable(true);
+}
+
+void WebApiWsMuxClass::addPublisher(WebApiWsPublisher& publisher)
+{
+    _publishers.push_back(&publisher);
+}
+
+void WebApiWsMuxClass::wsCleanupTaskCb()
+{
+    // see: https://github.com/me-no-dev/ESPAsyncWebServer#limiting-the-number-of-web-socket-clients
+    _ws.cleanupClients();
+}
+
+void WebApiWsMuxClass::onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len)
+{
+    for (auto pPublisher : _publishers) {
+        pPublisher->onWebsocketEvent(client, type, arg, data, len);
+    }
+
+    if (type == WS_EVT_CONNECT) {
+        MessageOutput.printf("Websocket: [%s][%u] connect\r\n", server->url(), client->id());
+    } else if (type == WS_EVT_DISCONNECT) {
+        MessageOutput.printf("Websocket: [%s][%u] disconnect\r\n", server->url(), client->id());
+    }
+}
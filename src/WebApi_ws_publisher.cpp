@@ -0,0 +1,378 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "WebApi_ws_publisher.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr char const* EncodingRequest = "encoding:msgpack";
+constexpr char const SubscribeRequest[] = "subscribe:";
+
+void putBigEndian(std::vector<uint8_t>& out, uint64_t value, size_t bytes)
+{
+    for (size_t i = bytes; i > 0; --i) {
+        out.push_back(static_cast<uint8_t>(value >> ((i - 1) * 8)));
+    }
+}
+
+void writeUnsigned(std::vector<uint8_t>& out, uint64_t value)
+{
+    if (value < 0x80) {
+        out.push_back(static_cast<uint8_t>(value));
+    } else if (value <= 0xFF) {
+        out.push_back(0xCC);
+        putBigEndian(out, value, 1);
+    } else if (value <= 0xFFFF) {
+        out.push_back(0xCD);
+        putBigEndian(out, value, 2);
+    } else if (value <= 0xFFFFFFFF) {
+        out.push_back(0xCE);
+        putBigEndian(out, value, 4);
+    } else {
+        out.push_back(0xCF);
+        putBigEndian(out, value, 8);
+    }
+}
+
+void writeSigned(std::vector<uint8_t>& out, int64_t value)
+{
+    if (value >= 0) { return writeUnsigned(out, value); }
+
+    if (value >= -32) {
+        out.push_back(static_cast<uint8_t>(value));
+    } else if (value >= INT8_MIN) {
+        out.push_back(0xD0);
+        putBigEndian(out, static_cast<uint64_t>(value), 1);
+    } else if (value >= INT16_MIN) {
+        out.push_back(0xD1);
+        putBigEndian(out, static_cast<uint64_t>(value), 2);
+    } else if (value >= INT32_MIN) {
+        out.push_back(0xD2);
+        putBigEndian(out, static_cast<uint64_t>(value), 4);
+    } else {
+        out.push_back(0xD3);
+        putBigEndian(out, static_cast<uint64_t>(value), 8);
+    }
+}
+
+void writeFloat(std::vector<uint8_t>& out, double value)
+{
+    // most values originate from floats, which need only half the space
+    float single = static_cast<float>(value);
+    if (static_cast<double>(single) == value || std::isnan(value)) {
+        uint32_t bits;
+        memcpy(&bits, &single, sizeof(bits));
+        out.push_back(0xCA);
+        putBigEndian(out, bits, 4);
+        return;
+    }
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    out.push_back(0xCB);
+    putBigEndian(out, bits, 8);
+}
+
+void writeString(std::vector<uint8_t>& out, char const* str, size_t len)
+{
+    if (len < 32) {
+        out.push_back(0xA0 | static_cast<uint8_t>(len));
+    } else if (len <= 0xFF) {
+        out.push_back(0xD9);
+        putBigEndian(out, len, 1);
+    } else if (len <= 0xFFFF) {
+        out.push_back(0xDA);
+        putBigEndian(out, len, 2);
+    } else {
+        out.push_back(0xDB);
+        putBigEndian(out, len, 4);
+    }
+
+    out.insert(out.end(), str, str + len);
+}
+
+void writeArrayHeader(std::vector<uint8_t>& out, size_t size)
+{
+    if (size < 16) {
+        out.push_back(0x90 | static_cast<uint8_t>(size));
+    } else if (size <= 0xFFFF) {
+        out.push_back(0xDC);
+        putBigEndian(out, size, 2);
+    } else {
+        out.push_back(0xDD);
+        putBigEndian(out, size, 4);
+    }
+}
+
+void writeMapHeader(std::vector<uint8_t>& out, size_t size)
+{
+    if (size < 16) {
+        out.push_back(0x80 | static_cast<uint8_t>(size));
+    } else if (size <= 0xFFFF) {
+        out.push_back(0xDE);
+        putBigEndian(out, size, 2);
+    } else {
+        out.push_back(0xDF);
+        putBigEndian(out, size, 4);
+    }
+}
+
+} // namespace
+
+WebApiWsPublisher::WebApiWsPublisher(AsyncWebSocket& ws, char const* channel)
+    : _ws(ws)
+    , _channel(channel)
+{
+}
+
+bool WebApiWsPublisher::hasClients()
+{
+    if (!_channel) { return _ws.count() > 0; }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    return std::any_of(_clients.begin(), _clients.end(),
+        [](Client const& c) { return c.Subscribed; });
+}
+
+// the request lists all channels the client subscribes to
+bool WebApiWsPublisher::isSubscription(uint8_t const* data, size_t len) const
+{
+    auto pos = reinterpret_cast<char const*>(data) + strlen(SubscribeRequest);
+    auto end = reinterpret_cast<char const*>(data) + len;
+    size_t channelLength = strlen(_channel);
+
+    while (pos < end) {
+        auto comma = std::find(pos, end, ',');
+        if (static_cast<size_t>(comma - pos) == channelLength
+                && memcmp(pos, _channel, channelLength) == 0) {
+            return true;
+        }
+        pos = comma + 1;
+    }
+
+    return false;
+}
+
+WebApiWsPublisher::Client& WebApiWsPublisher::getClient(uint32_t id)
+{
+    for (auto& client : _clients) {
+        if (client.Id == id) { return client; }
+    }
+
+    // without a channel, every client of the websocket is served
+    _clients.push_back({ id, _channel == nullptr });
+    return _clients.back();
+}
+
+void WebApiWsPublisher::onWebsocketEvent(AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (type == WS_EVT_DISCONNECT) {
+        _clients.erase(std::remove_if(_clients.begin(), _clients.end(),
+            [client](Client const& c) { return c.Id == client->id(); }),
+            _clients.end());
+        return;
+    }
+
+    if (type != WS_EVT_DATA) { return; }
+
+    auto info = static_cast<AwsFrameInfo const*>(arg);
+    if (!info->final || info->index != 0 || info->len != len || info->opcode != WS_TEXT) {
+        return;
+    }
+
+    size_t const subscribeLength = strlen(SubscribeRequest);
+    if (_channel && len >= subscribeLength && memcmp(data, SubscribeRequest, subscribeLength) == 0) {
+        auto& state = getClient(client->id());
+        bool subscribed = isSubscription(data, len);
+
+        // streams which send changes only must send a full update to the
+        // new subscriber
+        if (subscribed && !state.Subscribed) { _resyncRequested = true; }
+        state.Subscribed = subscribed;
+        return;
+    }
+
+    if (len != strlen(EncodingRequest) || memcmp(data, EncodingRequest, len) != 0) { return; }
+
+    getClient(client->id()).Binary = true;
+}
+
+void WebApiWsPublisher::encodeKey(std::vector<uint8_t>& out, char const* key)
+{
+    auto it = _keyIndices.find(key);
+    if (it != _keyIndices.end()) {
+        writeUnsigned(out, it->second);
+        return;
+    }
+
+    if (_keys.size() < MaxKeys) {
+        uint16_t index = _keys.size();
+        _keys.emplace_back(key);
+        _keyIndices.emplace(_keys.back(), index);
+        writeUnsigned(out, index);
+        return;
+    }
+
+    writeString(out, key, strlen(key));
+}
+
+void WebApiWsPublisher::encodeValue(std::vector<uint8_t>& out, JsonVariantConst value)
+{
+    if (value.is<JsonObjectConst>()) {
+        auto object = value.as<JsonObjectConst>();
+        writeMapHeader(out, object.size());
+        for (JsonPairConst pair : object) {
+            encodeKey(out, pair.key().c_str());
+            encodeValue(out, pair.value());
+        }
+        return;
+    }
+
+    if (value.is<JsonArrayConst>()) {
+        auto array = value.as<JsonArrayConst>();
+        writeArrayHeader(out, array.size());
+        for (JsonVariantConst element : array) {
+            encodeValue(out, element);
+        }
+        return;
+    }
+
+    if (value.is<bool>()) {
+        out.push_back(value.as<bool>() ? 0xC3 : 0xC2);
+    } else if (value.is<int64_t>()) {
+        writeSigned(out, value.as<int64_t>());
+    } else if (value.is<uint64_t>()) {
+        writeUnsigned(out, value.as<uint64_t>());
+    } else if (value.is<double>()) {
+        writeFloat(out, value.as<double>());
+    } else if (value.is<char const*>()) {
+        auto str = value.as<JsonString>();
+        writeString(out, str.c_str(), str.size());
+    } else {
+        out.push_back(0xC0);
+    }
+}
+
+AsyncWebSocketSharedBuffer WebApiWsPublisher::buildBinaryFrame(uint16_t base) const
+{
+    auto spFrame = std::make_shared<std::vector<uint8_t>>();
+    auto& frame = *spFrame;
+    frame.reserve(_payload.size() + 8);
+
+    if (_channel) {
+        writeArrayHeader(frame, 4);
+        writeString(frame, _channel, strlen(_channel));
+    } else {
+        writeArrayHeader(frame, 3);
+    }
+    writeUnsigned(frame, base);
+    writeArrayHeader(frame, _keys.size() - base);
+    for (size_t i = base; i < _keys.size(); ++i) {
+        writeString(frame, _keys[i].c_str(), _keys[i].size());
+    }
+    frame.insert(frame.end(), _payload.begin(), _payload.end());
+
+    return spFrame;
+}
+
+AsyncWebSocketSharedBuffer WebApiWsPublisher::buildTextFrame(JsonDocument const& root) const
+{
+    size_t size = measureJson(root);
+    if (!_channel) {
+        auto spFrame = std::make_shared<std::vector<uint8_t>>(size);
+        serializeJson(root, reinterpret_cast<char*>(spFrame->data()), size);
+        return spFrame;
+    }
+
+    std::string prefix = std::string("{\"channel\":\"") + _channel + "\",\"data\":";
+    auto spFrame = std::make_shared<std::vector<uint8_t>>(prefix.size() + size + 1);
+    auto pFrame = reinterpret_cast<char*>(spFrame->data());
+    memcpy(pFrame, prefix.data(), prefix.size());
+    serializeJson(root, pFrame + prefix.size(), size);
+    pFrame[prefix.size() + size] = '}';
+    return spFrame;
+}
+
+bool WebApiWsPublisher::takeResyncRequest()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    bool requested = _resyncRequested;
+    _resyncRequested = false;
+    return requested;
+}
+
+bool WebApiWsPublisher::isSendDue(AsyncWebSocketClient& client, Client& state)
+{
+    // the previous frame is still queued, i.e., the client is served faster
+    // than it can take the frames. the frame is skipped and the client is
+    // served less often from now on.
+    if (client.queueLen() > 0) {
+        state.IntervalMillis = std::min(MaxBackoffMillis,
+                std::max(MinBackoffMillis, state.IntervalMillis * 2));
+        state.Skipped = true;
+        return false;
+    }
+
+    if (millis() - state.LastSentMillis < state.IntervalMillis) {
+        state.Skipped = true;
+        return false;
+    }
+
+    // the client keeps up, so the rate is raised again
+    state.IntervalMillis /= 2;
+    if (state.IntervalMillis < MinBackoffMillis) { state.IntervalMillis = 0; }
+
+    if (state.Skipped) {
+        state.Skipped = false;
+        _resyncRequested = true;
+    }
+
+    return true;
+}
+
+void WebApiWsPublisher::publish(JsonDocument const& root, AsyncWebSocketSharedBuffer spText)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _payload.clear();
+    if (_channel) { spText = nullptr; }
+
+    // clients usually know the same keys and hence share a frame
+    std::vector<std::pair<uint16_t, AsyncWebSocketSharedBuffer>> frames;
+
+    for (auto& client : _ws.getClients()) {
+        if (client.status() != WS_CONNECTED) { continue; }
+
+        auto& state = getClient(client.id());
+        if (!state.Subscribed) { continue; }
+        if (!isSendDue(client, state)) { continue; }
+
+        if (!state.Binary) {
+            if (!spText) { spText = buildTextFrame(root); }
+
+            if (client.text(spText)) { state.LastSentMillis = millis(); }
+            continue;
+        }
+
+        if (_payload.empty()) {
+            encodeValue(_payload, root.as<JsonVariantConst>());
+        }
+
+        uint16_t base = state.KnownKeys;
+        auto it = std::find_if(frames.begin(), frames.end(),
+            [base](auto const& frame) { return frame.first == base; });
+        if (it == frames.end()) {
+            frames.emplace_back(base, buildBinaryFrame(base));
+            it = frames.end() - 1;
+        }
+
+        // a frame which was dropped is repeated with its keys next time
+        if (client.binary(it->second)) {
+            state.KnownKeys = _keys.size();
+            state.LastSentMillis = millis();
+        }
+    }
+}
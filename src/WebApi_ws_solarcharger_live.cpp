@@ -5,16 +5,23 @@
 #include "WebApi_ws_solarcharger_live.h"
 #include "AsyncJson.h"
 #include "Configuration.h"
+#include "MemoryPolicy.h"
 #include "MessageOutput.h"
 #include "Utils.h"
 #include "WebApi.h"
 #include "defaults.h"
 #include "PowerLimiter.h"
 #include <solarcharger/Controller.h>
+#include "TaskProfiler.h"
+#include "WsMonitor.h"
 
-WebApiWsSolarChargerLiveClass::WebApiWsSolarChargerLiveClass()
+WebApiWsSolarChargerLiveClass::WebApiWsSolarChargerLiveClass(WebApiWsMuxClass& mux, WebApiSseClass& sse)
     : _ws("/solarchargerlivedata")
+    , _publisher(_ws)
+    , _muxPublisher(mux.getSocket(), "solarcharger")
+    , _sse(sse)
 {
+    mux.addPublisher(_muxPublisher);
 }
 
 void WebApiWsSolarChargerLiveClass::init(AsyncWebServer& server, Scheduler& scheduler)
@@ -27,20 +34,22 @@ void WebApiWsSolarChargerLiveClass::init(AsyncWebServer& server, Scheduler& sche
     using std::placeholders::_6;
 
     _server = &server;
-    _server->on("/api/solarchargerlivedata/status", HTTP_GET, std::bind(&WebApiWsSolarChargerLiveClass::onLivedataStatus, this, _1));
+    auto& router = WebApi.getRouter();
+    router.on("/api/solarchargerlivedata/status", HTTP_GET, std::bind(&WebApiWsSolarChargerLiveClass::onLivedataStatus, this, _1));
 
     _server->addHandler(&_ws);
+    WsMonitor.addSocket(_ws);
     _ws.onEvent(std::bind(&WebApiWsSolarChargerLiveClass::onWebsocketEvent, this, _1, _2, _3, _4, _5, _6));
 
 
     scheduler.addTask(_wsCleanupTask);
-    _wsCleanupTask.setCallback(std::bind(&WebApiWsSolarChargerLiveClass::wsCleanupTaskCb, this));
+    _wsCleanupTask.setCallback(TaskProfiler.wrap("WebApiWsSolarChargerLive::wsCleanupTaskCb", std::bind(&WebApiWsSolarChargerLiveClass::wsCleanupTaskCb, this)));
     _wsCleanupTask.setIterations(TASK_FOREVER);
     _wsCleanupTask.setInterval(1 * TASK_SECOND);
     _wsCleanupTask.enable();
 
     scheduler.addTask(_sendDataTask);
-    _sendDataTask.setCallback(std::bind(&WebApiWsSolarChargerLiveClass::sendDataTaskCb, this));
+    _sendDataTask.setCallback(TaskProfiler.wrap("WebApiWsSolarChargerLive::sendDataTaskCb", std::bind(&WebApiWsSolarChargerLiveClass::sendDataTaskCb, this)));
     _sendDataTask.setIterations(TASK_FOREVER);
     _sendDataTask.setInterval(500 * TASK_MILLISECOND);
     _sendDataTask.enable();
@@ -75,10 +84,12 @@ void WebApiWsSolarChargerLiveClass::wsCleanupTaskCb()
 void WebApiWsSolarChargerLiveClass::sendDataTaskCb()
 {
     // do nothing if no WS client is connected
-    if (_ws.count() == 0) { return; }
+    if (!_publisher.hasClients() && !_muxPublisher.hasClients() && !_sse.hasClients()) { return; }
 
-    // Update on ve.direct change or at least after 10 seconds
-    bool fullUpdate = (millis() - _lastFullPublish > (10 * 1000));
+    // Update on ve.direct change or at least after 10 seconds. a client
+    // which skipped frames relies on a full update to catch up.
+    bool fullUpdate = (millis() - _lastFullPublish > (10 * 1000))
+        || (_publisher.takeResyncRequest() | _muxPublisher.takeResyncRequest() | _sse.takeResyncRequest(_sseConnects));
 
     auto publishAgeMillis = millis() - _lastPublish;
     bool updateAvailable = SolarCharger.getStats()->getAgeMillis() < publishAgeMillis;
@@ -86,16 +97,15 @@ void WebApiWsSolarChargerLiveClass::sendDataTaskCb()
     if (fullUpdate || updateAvailable) {
         try {
             std::lock_guard<std::mutex> lock(_mutex);
-            JsonDocument root;
+            JsonDocument root(MemoryPolicy::jsonAllocator());
             JsonVariant var = root;
 
             generateCommonJsonResponse(var, fullUpdate);
 
             if (Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) {
-                String buffer;
-                serializeJson(root, buffer);
-
-                _ws.textAll(buffer);;
+                _publisher.publish(root);
+                _muxPublisher.publish(root);
+                _sse.publish("solarcharger", root);
             }
         } catch (std::bad_alloc& bad_alloc) {
             MessageOutput.printf("Calling /api/solarchargerlivedata/status has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
@@ -117,6 +127,8 @@ void WebApiWsSolarChargerLiveClass::generateCommonJsonResponse(JsonVariant& root
 
 void WebApiWsSolarChargerLiveClass::onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len)
 {
+    _publisher.onWebsocketEvent(client, type, arg, data, len);
+
     if (type == WS_EVT_CONNECT) {
         char str[64];
         snprintf(str, sizeof(str), "Websocket: [%s][%u] connect", server->url(), client->id());
@@ -130,6 +142,14 @@ void WebApiWsSolarChargerLiveClass::onWebsocketEvent(AsyncWebSocket* server, Asy
     }
 }
 
+void WebApiWsSolarChargerLiveClass::generateSnapshot(JsonVariant& root)
+{
+    // the websocket's publish time is not touched, such that the clients
+    // of the websocket still receive all values changed since
+    std::lock_guard<std::mutex> lock(_mutex);
+    SolarCharger.getStats()->getLiveViewData(root, true/*fullUpdate*/, _lastPublish);
+}
+
 void WebApiWsSolarChargerLiveClass::onLivedataStatus(AsyncWebServerRequest* request)
 {
     if (!WebApi.checkCredentialsReadonly(request)) {
@@ -137,7 +157,7 @@ void WebApiWsSolarChargerLiveClass::onLivedataStatus(AsyncWebServerRequest* requ
     }
     try {
         std::lock_guard<std::mutex> lock(_mutex);
-        AsyncJsonResponse* response = new AsyncJsonResponse();
+        auto response = new PooledJsonResponse(JsonDocumentPoolClass::SizeClass::Large);
         auto& root = response->getRoot();
 
         generateCommonJsonResponse(root, true/*fullUpdate*/);
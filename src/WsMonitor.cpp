@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "WsMonitor.h"
+#include "MessageOutput.h"
+#include "TaskProfiler.h"
+#include <algorithm>
+#include <cinttypes>
+
+WsMonitorClass WsMonitor;
+
+WsMonitorClass::WsMonitorClass()
+    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, TaskProfiler.wrap("WsMonitor::loop", std::bind(&WsMonitorClass::loop, this)))
+{
+}
+
+void WsMonitorClass::init(Scheduler& scheduler)
+{
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+void WsMonitorClass::addSocket(AsyncWebSocket& ws)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (std::find(_sockets.begin(), _sockets.end(), &ws) != _sockets.end()) { return; }
+
+    _sockets.push_back(&ws);
+    _stats.push_back({ ws.url() });
+}
+
+std::vector<WsMonitorClass::SocketStats> WsMonitorClass::getStats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+uint32_t WsMonitorClass::getBacklogLimitSeconds() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _backlogLimitSeconds;
+}
+
+void WsMonitorClass::loop()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // memory held by queued frames hurts most when the heap runs low
+    _backlogLimitSeconds = (ESP.getFreeHeap() < LowHeapBytes) ? LowHeapBacklogLimitSeconds : BacklogLimitSeconds;
+
+    std::vector<Client> clients;
+    clients.reserve(_clients.size());
+
+    for (size_t i = 0; i < _sockets.size(); ++i) {
+        auto& ws = *_sockets[i];
+        auto& stats = _stats[i];
+
+        stats.Clients = 0;
+        stats.QueuedMessages = 0;
+        stats.MaxQueueLength = 0;
+        stats.SendBufferUsed = 0;
+        stats.MaxSendBufferUsed = 0;
+        stats.BackloggedClients = 0;
+
+        for (auto& client : ws.getClients()) {
+            Client const* pPrevious = nullptr;
+            for (auto const& previous : _clients) {
+                if (previous.pSocket == &ws && previous.Id == client.id()) {
+                    pPrevious = &previous;
+                    break;
+                }
+            }
+
+            auto pTcp = client.client();
+
+            // the close frame might be stuck behind the backlog as well
+            if (client.status() == WS_DISCONNECTING && pPrevious && pPrevious->Closing) {
+                uint32_t closingSeconds = pPrevious->ClosingSeconds + 1;
+                if (closingSeconds >= AbortSeconds && pTcp) {
+                    pTcp->abort();
+                } else {
+                    clients.push_back({ &ws, client.id(), pPrevious->BacklogSeconds, true, closingSeconds });
+                }
+                continue;
+            }
+
+            if (client.status() != WS_CONNECTED) { continue; }
+
+            uint32_t queued = client.queueLen();
+            uint32_t space = pTcp ? pTcp->space() : SendBufferSize;
+            uint32_t used = (space < SendBufferSize) ? SendBufferSize - space : 0;
+
+            ++stats.Clients;
+            stats.QueuedMessages += queued;
+            stats.MaxQueueLength = std::max(stats.MaxQueueLength, queued);
+            stats.PeakQueueLength = std::max(stats.PeakQueueLength, queued);
+            stats.SendBufferUsed += used;
+            stats.MaxSendBufferUsed = std::max(stats.MaxSendBufferUsed, used);
+
+            if (queued == 0) { continue; }
+
+            ++stats.BackloggedClients;
+
+            uint32_t backlogSeconds = pPrevious ? pPrevious->BacklogSeconds + 1 : 1;
+            bool closing = backlogSeconds >= _backlogLimitSeconds;
+            clients.push_back({ &ws, client.id(), backlogSeconds, closing, 0 });
+
+            if (!closing) { continue; }
+
+            MessageOutput.printf("[WsMonitor] Closing client %" PRIu32 " of %s, its queue of %" PRIu32 " messages "
+                "did not drain for %" PRIu32 " s\r\n", client.id(), ws.url(), queued, backlogSeconds);
+            ++stats.ClosedClients;
+            client.close();
+        }
+    }
+
+    _clients = std::move(clients);
+}
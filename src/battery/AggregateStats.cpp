@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <algorithm>
+#include <string>
+#include <battery/AggregateStats.h>
+#include <Configuration.h>
+#include <MemoryPolicy.h>
+
+namespace Batteries {
+
+namespace {
+
+// the timestamps of the combined values are the ones of the least recently
+// updated battery, such that the combined values age if any battery stops
+// reporting.
+void keepOldest(std::optional<uint32_t>& oOldest, uint32_t timestamp)
+{
+    if (!oOldest || static_cast<int32_t>(timestamp - *oOldest) < 0) {
+        oOldest = timestamp;
+    }
+}
+
+} // namespace
+
+AggregateStats::AggregateStats(std::vector<std::shared_ptr<Stats const>> packs)
+{
+    _packs.reserve(packs.size());
+    for (auto& spStats : packs) {
+        _packs.push_back({ std::move(spStats), 0 });
+    }
+}
+
+std::shared_ptr<Stats const> AggregateStats::getPack(size_t index) const
+{
+    if (index >= _packs.size()) { return nullptr; }
+    return _packs[index].spStats;
+}
+
+bool AggregateStats::update()
+{
+    bool updated = false;
+
+    for (auto& pack : _packs) {
+        uint32_t lastUpdate = pack.spStats->getLastUpdate();
+        if (lastUpdate == pack.lastUpdate) { continue; }
+        pack.lastUpdate = lastUpdate;
+        updated = true;
+    }
+
+    if (!updated) { return false; }
+
+    aggregate();
+    return true;
+}
+
+void AggregateStats::aggregate()
+{
+    bool weighted = Configuration.get().Battery.SocAggregation == BatterySocAggregation::CapacityWeighted;
+
+    std::optional<uint32_t> oSocUpdate, oVoltageUpdate, oCurrentUpdate, oLimitUpdate;
+    float minSoc = FLT_MAX, socSum = 0, weightedSocSum = 0, weightSum = 0;
+    uint8_t socCount = 0, socPrecision = 0, currentPrecision = 0;
+    float minVoltage = FLT_MAX, current = 0, minLimit = FLT_MAX;
+    float capacity = 0;
+    bool allCapacitiesKnown = true;
+    bool immediateChargingRequest = false;
+    float chargeCurrentLimitation = FLT_MAX;
+    uint32_t lastUpdate = 0;
+
+    for (auto const& pack : _packs) {
+        auto const& stats = *pack.spStats;
+
+        if (lastUpdate == 0 || static_cast<int32_t>(stats.getLastUpdate() - lastUpdate) > 0) {
+            lastUpdate = stats.getLastUpdate();
+        }
+
+        auto oCapacity = stats.getCapacityAmpHours();
+        if (oCapacity) { capacity += *oCapacity; }
+        else { allCapacitiesKnown = false; }
+
+        if (stats.isSoCValid()) {
+            minSoc = std::min(minSoc, stats.getSoC());
+            socSum += stats.getSoC();
+            ++socCount;
+            weightedSocSum += stats.getSoC() * oCapacity.value_or(0);
+            weightSum += oCapacity.value_or(0);
+            socPrecision = std::max(socPrecision, stats.getSoCPrecision());
+            keepOldest(oSocUpdate, stats.getSoCLastUpdate());
+        }
+
+        if (stats.isVoltageValid()) {
+            minVoltage = std::min(minVoltage, stats.getVoltage());
+            keepOldest(oVoltageUpdate, stats.getVoltageLastUpdate());
+        }
+
+        if (stats.isCurrentValid()) {
+            current += stats.getChargeCurrent();
+            currentPrecision = std::max(currentPrecision, stats.getChargeCurrentPrecision());
+            keepOldest(oCurrentUpdate, stats.getChargeCurrentLastUpdate());
+        }
+
+        if (stats.isDischargeCurrentLimitValid()) {
+            minLimit = std::min(minLimit, stats.getDischargeCurrentLimit());
+            keepOldest(oLimitUpdate, stats.getDischargeCurrentLimitLastUpdate());
+        }
+
+        immediateChargingRequest = immediateChargingRequest || stats.getImmediateChargingRequest();
+        chargeCurrentLimitation = std::min(chargeCurrentLimitation, stats.getChargeCurrentLimitation());
+    }
+
+    if (oSocUpdate) {
+        float soc = minSoc;
+        if (weighted) {
+            // batteries which do not report their capacity are weighted
+            // equally, i.e., the mean SoC is used
+            soc = (allCapacitiesKnown && weightSum > 0) ? weightedSocSum / weightSum : socSum / socCount;
+        }
+        setSoC(soc, socPrecision, *oSocUpdate);
+    }
+
+    if (oVoltageUpdate) { setVoltage(minVoltage, *oVoltageUpdate); }
+    if (oCurrentUpdate) { setCurrent(current, currentPrecision, *oCurrentUpdate); }
+    if (oLimitUpdate) { setDischargeCurrentLimit(minLimit, *oLimitUpdate); }
+
+    _immediateChargingRequest = immediateChargingRequest;
+    _chargeCurrentLimitation = chargeCurrentLimitation;
+    _oCapacity = allCapacitiesKnown ? std::optional<float>(capacity) : std::nullopt;
+
+    // the setters assigned the oldest timestamps, while any update of a
+    // battery is an update of the combined stats.
+    _lastUpdate = lastUpdate;
+
+    updateManufacturer();
+}
+
+void AggregateStats::updateManufacturer()
+{
+    size_t known = std::count_if(_packs.begin(), _packs.end(),
+            [](Pack const& pack) { return pack.spStats->getManufacturer().has_value(); });
+    if (known == _knownManufacturers) { return; }
+    _knownManufacturers = known;
+
+    String manufacturer;
+    for (auto const& pack : _packs) {
+        auto const& oManufacturer = pack.spStats->getManufacturer();
+        if (!oManufacturer) { continue; }
+        if (!manufacturer.isEmpty()) { manufacturer += " + "; }
+        manufacturer += *oManufacturer;
+    }
+    setManufacturer(manufacturer);
+}
+
+void AggregateStats::getLiveViewData(JsonVariant& root) const
+{
+    Stats::getLiveViewData(root);
+
+    if (_oCapacity) {
+        addLiveViewValue(root, "capacity", *_oCapacity, "Ah", 0);
+    }
+
+    // each battery gets a section with its status values, while the issues
+    // of all batteries are shown together.
+    for (size_t i = 0; i < _packs.size(); ++i) {
+        JsonDocument doc(MemoryPolicy::jsonAllocator());
+        JsonVariant pack = doc.to<JsonVariant>();
+        _packs[i].spStats->getLiveViewData(pack);
+
+        std::string section = "pack" + std::to_string(i + 1);
+        addLiveViewTextInSection(root, section, "manufacturer",
+                pack["manufacturer"] | "unknown", false);
+        addLiveViewInSection(root, section, "dataAge",
+                pack["data_age"].as<uint32_t>(), "s", 0);
+
+        auto values = root["values"][section];
+        for (auto kv : pack["values"]["status"].as<JsonObject>()) {
+            values[kv.key()] = kv.value();
+        }
+
+        for (auto kv : pack["issues"].as<JsonObject>()) {
+            int level = root["issues"][kv.key()] | 0;
+            root["issues"][kv.key()] = std::max(level, kv.value().as<int>());
+        }
+    }
+}
+
+} // namespace Batteries
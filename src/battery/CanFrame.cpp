@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <battery/CanFrame.h>
+#include <MessageOutput.h>
+
+namespace Batteries::CanFrame {
+
+std::optional<float> readValue(twai_message_t const& frame, Type type,
+        uint8_t offset, uint8_t bit, float scale, float bias)
+{
+    auto fits = [&frame, offset](uint8_t width) {
+        return offset + width <= frame.data_length_code;
+    };
+
+    uint8_t const* data = frame.data + offset;
+    int64_t raw = 0;
+
+    switch (type) {
+        case Type::U8:
+            if (!fits(1)) { return std::nullopt; }
+            raw = data[0];
+            break;
+        case Type::U16:
+            if (!fits(2)) { return std::nullopt; }
+            raw = static_cast<uint16_t>((data[1] << 8) | data[0]);
+            break;
+        case Type::S16:
+            if (!fits(2)) { return std::nullopt; }
+            raw = static_cast<int16_t>((data[1] << 8) | data[0]);
+            break;
+        case Type::S24: {
+            if (!fits(3)) { return std::nullopt; }
+            int32_t value = (data[2] << 16) | (data[1] << 8) | data[0];
+            raw = (value & 0x800000) ? value - 0x1000000 : value;
+            break;
+        }
+        case Type::U32:
+            if (!fits(4)) { return std::nullopt; }
+            raw = (static_cast<uint32_t>(data[3]) << 24) | (data[2] << 16) | (data[1] << 8) | data[0];
+            break;
+        case Type::Bit:
+            if (!fits(1)) { return std::nullopt; }
+            raw = (data[0] >> bit) & 1;
+            break;
+        default:
+            return std::nullopt;
+    }
+
+    return raw * scale + bias;
+}
+
+std::optional<String> readText(twai_message_t const& frame)
+{
+    String text(reinterpret_cast<char const*>(frame.data), frame.data_length_code);
+    if (text.isEmpty() || !isgraph(text.charAt(0))) { return std::nullopt; }
+    return text;
+}
+
+void logValue(char const* tag, char const* name, float value)
+{
+    MessageOutput.printf("[%s] %s: %.3f\r\n", tag, name, value);
+}
+
+void logText(char const* tag, char const* name, String const& text)
+{
+    MessageOutput.printf("[%s] %s: %s\r\n", tag, name, text.c_str());
+}
+
+} // namespace Batteries::CanFrame
@@ -1,8 +1,8 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include <battery/CanReceiver.h>
 #include <MessageOutput.h>
-#include <PinMapping.h>
-#include <driver/twai.h>
+#include <algorithm>
+#include <cinttypes>
 
 namespace Batteries {
 
@@ -14,168 +14,160 @@ bool CanReceiver::init(bool verboseLogging, char const* providerName)
     MessageOutput.printf("[%s] Initialize interface...\r\n",
             _providerName);
 
-    const PinMapping_t& pin = PinMapping.get();
+    auto const pin = getPins();
     MessageOutput.printf("[%s] Interface rx = %d, tx = %d\r\n",
-            _providerName, pin.battery_rx, pin.battery_tx);
+            _providerName, pin.Rx, pin.Tx);
 
-    if (pin.battery_rx < 0 || pin.battery_tx < 0) {
+    if (pin.Rx < 0 || pin.Tx < 0) {
         MessageOutput.printf("[%s] Invalid pin config\r\n",
                 _providerName);
         return false;
     }
 
-    auto tx = static_cast<gpio_num_t>(pin.battery_tx);
-    auto rx = static_cast<gpio_num_t>(pin.battery_rx);
-    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(tx, rx, TWAI_MODE_NORMAL);
-
-    // interrupts at level 1 are in high demand, at least on ESP32-S3 boards,
-    // but only a limited amount can be allocated. failing to allocate an
-    // interrupt in the TWAI driver will cause a bootloop. we therefore
-    // register the TWAI driver's interrupt at level 2. level 2 interrupts
-    // should be available -- we don't really know. we would love to have the
-    // esp_intr_dump() function, but that's not available yet in our version
-    // of the underlying esp-idf.
-    g_config.intr_flags = ESP_INTR_FLAG_LEVEL2;
-
-    // Initialize configuration structures using macro initializers
-    twai_timing_config_t t_config = TWAI_TIMING_CONFIG_500KBITS();
+    TwaiBusClass::Config config = {
+        .Name = _providerName,
+        .TxPin = pin.Tx,
+        .RxPin = pin.Rx,
+        .Bitrate = 500000,
+        .Extended = false,
+        .FirstId = 0,
+        .LastId = 0x7FF,
+        .Filter = getFilterConfig(),
+        .QueueLength = FrameQueueLength,
+        .NotifyTask = nullptr
+    };
+
+    _pSubscription = TwaiBus.subscribe(config);
+    if (_pSubscription == nullptr) {
+        MessageOutput.printf("[%s] Failed to subscribe to CAN bus\r\n",
+                _providerName);
+        return false;
+    }
+
+    return true;
+}
+
+twai_filter_config_t CanReceiver::getFilterConfig() const
+{
     twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
 
-    // Install TWAI driver
-    esp_err_t twaiLastResult = twai_driver_install(&g_config, &t_config, &f_config);
-    switch (twaiLastResult) {
-        case ESP_OK:
-            MessageOutput.printf("[%s] Twai driver installed\r\n",
-                    _providerName);
-            break;
-        case ESP_ERR_INVALID_ARG:
-            MessageOutput.printf("[%s] Twai driver install - invalid arg\r\n",
-                    _providerName);
-            return false;
-            break;
-        case ESP_ERR_NO_MEM:
-            MessageOutput.printf("[%s] Twai driver install - no memory\r\n",
-                    _providerName);
-            return false;
-            break;
-        case ESP_ERR_INVALID_STATE:
-            MessageOutput.printf("[%s] Twai driver install - invalid state\r\n",
-                    _providerName);
-            return false;
-            break;
-    }
+    auto ids = getMessageIds();
+    if (ids.empty()) { return f_config; }
+
+    std::sort(ids.begin(), ids.end());
 
-    // Start TWAI driver
-    twaiLastResult = twai_start();
-    switch (twaiLastResult) {
-        case ESP_OK:
-            MessageOutput.printf("[%s] Twai driver started\r\n",
-                    _providerName);
-            break;
-        case ESP_ERR_INVALID_STATE:
-            MessageOutput.printf("[%s] Twai driver start - invalid state\r\n",
-                    _providerName);
-            return false;
-            break;
+    // a filter ignores all bits in which the identifiers of its group
+    // differ, so it lets pass 2^(number of those bits) identifiers.
+    struct Group {
+        uint32_t code = 0x7FF;
+        uint32_t differing = 0;
+    };
+
+    auto makeGroup = [&ids](size_t begin, size_t end) -> Group {
+        uint32_t allOnes = 0x7FF;
+        uint32_t anyOnes = 0;
+        for (size_t i = begin; i < end; ++i) {
+            allOnes &= ids[i];
+            anyOnes |= ids[i];
+        }
+        return { allOnes, allOnes ^ anyOnes };
+    };
+
+    auto passing = [](Group const& g) -> uint32_t {
+        return 1 << __builtin_popcount(g.differing);
+    };
+
+    // dual filter mode provides two filters for standard frames. split the
+    // sorted identifiers into two groups such that the least amount of
+    // unwanted identifiers passes.
+    Group first = makeGroup(0, ids.size());
+    Group second = first;
+    for (size_t split = 1; split < ids.size(); ++split) {
+        Group a = makeGroup(0, split);
+        Group b = makeGroup(split, ids.size());
+        if (passing(a) + passing(b) < passing(first) + passing(second)) {
+            first = a;
+            second = b;
+        }
     }
 
-    return true;
+    // filter 1 matches the identifier in bits 31..21 and filter 2 in bits
+    // 15..5. the RTR bits and the data nibbles are not compared. mask bits
+    // which are set are not compared.
+    f_config.acceptance_code = (first.code << 21) | (second.code << 5);
+    f_config.acceptance_mask = (first.differing << 21) | (1 << 20) | 0xF0000
+        | (second.differing << 5) | (1 << 4) | 0xF;
+    f_config.single_filter = false;
+
+    MessageOutput.printf("[%s] Acceptance filters: 0x%03" PRIX32 "/0x%03" PRIX32 ", "
+            "0x%03" PRIX32 "/0x%03" PRIX32 " (code/ignored bits)\r\n", _providerName,
+            first.code, first.differing, second.code, second.differing);
+
+    return f_config;
 }
 
 void CanReceiver::deinit()
 {
-    // Stop TWAI driver
-    esp_err_t twaiLastResult = twai_stop();
-    switch (twaiLastResult) {
-        case ESP_OK:
-            MessageOutput.printf("[%s] Twai driver stopped\r\n",
-                    _providerName);
-            break;
-        case ESP_ERR_INVALID_STATE:
-            MessageOutput.printf("[%s] Twai driver stop - invalid state\r\n",
-                    _providerName);
-            break;
-    }
-
-    // Uninstall TWAI driver
-    twaiLastResult = twai_driver_uninstall();
-    switch (twaiLastResult) {
-        case ESP_OK:
-            MessageOutput.printf("[%s] Twai driver uninstalled\r\n",
-                    _providerName);
-            break;
-        case ESP_ERR_INVALID_STATE:
-            MessageOutput.printf("[%s] Twai driver uninstall - invalid state\r\n",
-                    _providerName);
-            break;
-    }
+    TwaiBus.unsubscribe(_pSubscription);
+    _pSubscription = nullptr;
 }
 
 void CanReceiver::loop()
 {
-    // Check for messages. twai_receive is blocking when there is no data so we return if there are no frames in the buffer
-    twai_status_info_t status_info;
-    esp_err_t twaiLastResult = twai_get_status_info(&status_info);
-    if (twaiLastResult != ESP_OK) {
-        switch (twaiLastResult) {
-            case ESP_ERR_INVALID_ARG:
-                MessageOutput.printf("[%s] Twai driver get status - invalid arg\r\n",
-                        _providerName);
-                break;
-            case ESP_ERR_INVALID_STATE:
-                MessageOutput.printf("[%s] Twai driver get status - invalid state\r\n",
-                        _providerName);
-                break;
-        }
-        return;
-    }
-    if (status_info.msgs_to_rx == 0) {
-        return;
+    if (_pSubscription == nullptr) { return; }
+
+    uint32_t droppedFrames = _pSubscription->getDroppedFrames();
+    uint32_t missedFrames = TwaiBus.getMissedFrames();
+    uint32_t lostFrames = droppedFrames + missedFrames;
+    if (lostFrames != _reportedLostFrames && millis() - _lastLostFramesReport > 10 * 1000) {
+        MessageOutput.printf("[%s] Lost %" PRIu32 " CAN frames so far (%" PRIu32 " "
+                "dropped from frame queue, %" PRIu32 " missed by driver)\r\n",
+                _providerName, lostFrames, droppedFrames, missedFrames);
+        _reportedLostFrames = lostFrames;
+        _lastLostFramesReport = millis();
     }
 
-    // Wait for message to be received, function is blocking
+    // process a bounded batch, such that a busy bus cannot stall the main loop
     twai_message_t rx_message;
-    if (twai_receive(&rx_message, pdMS_TO_TICKS(100)) != ESP_OK) {
-        MessageOutput.printf("[%s] Failed to receive message",
-                _providerName);
-        return;
-    }
+    for (size_t batch = 0; batch < MaxFramesPerLoop; ++batch) {
+        if (!_pSubscription->receive(rx_message)) { return; }
+
+        if (_verboseLogging) {
+            MessageOutput.printf("[%s] Received CAN message: 0x%04X -",
+                    _providerName, rx_message.identifier);
 
-    if (_verboseLogging) {
-        MessageOutput.printf("[%s] Received CAN message: 0x%04X -",
-                _providerName, rx_message.identifier);
+            for (int i = 0; i < rx_message.data_length_code; i++) {
+                MessageOutput.printf(" %02X", rx_message.data[i]);
+            }
 
-        for (int i = 0; i < rx_message.data_length_code; i++) {
-            MessageOutput.printf(" %02X", rx_message.data[i]);
+            MessageOutput.printf("\r\n");
         }
 
-        MessageOutput.printf("\r\n");
+        onMessage(rx_message);
     }
-
-    onMessage(rx_message);
 }
 
-uint8_t CanReceiver::readUnsignedInt8(uint8_t *data)
+uint8_t CanReceiver::readUnsignedInt8(uint8_t const* data)
 {
     return data[0];
 }
 
-uint16_t CanReceiver::readUnsignedInt16(uint8_t *data)
+uint16_t CanReceiver::readUnsignedInt16(uint8_t const* data)
 {
     return (data[1] << 8) | data[0];
 }
 
-int16_t CanReceiver::readSignedInt16(uint8_t *data)
+int16_t CanReceiver::readSignedInt16(uint8_t const* data)
 {
-    return this->readUnsignedInt16(data);
+    return readUnsignedInt16(data);
 }
 
-int32_t CanReceiver::readSignedInt24(uint8_t *data)
+int32_t CanReceiver::readSignedInt24(uint8_t const* data)
 {
     return (data[2] << 16) | (data[1] << 8) | data[0];
 }
 
-uint32_t CanReceiver::readUnsignedInt32(uint8_t *data)
+uint32_t CanReceiver::readUnsignedInt32(uint8_t const* data)
 {
     return (data[3] << 24) | (data[2] << 16) | (data[1] << 8) | data[0];
 }
@@ -185,7 +177,7 @@ float CanReceiver::scaleValue(int32_t value, float factor)
     return value * factor;
 }
 
-bool CanReceiver::getBit(uint8_t value, uint8_t bit)
+bool CanReceiver::getBit(uint32_t value, uint8_t bit)
 {
     return (value & (1 << bit)) >> bit;
 }
@@ -1,14 +1,31 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include <battery/Controller.h>
+#include <Configuration.h>
+#include <DataBus.h>
+#include <Features.h>
+#if FEATURE_BATTERY_JBDBMS
 #include <battery/jbdbms/Provider.h>
+#endif
+#if FEATURE_BATTERY_JKBMS
 #include <battery/jkbms/Provider.h>
+#endif
+#if FEATURE_BATTERY_MQTT
 #include <battery/mqtt/Provider.h>
+#endif
+#if FEATURE_BATTERY_PYLONTECH
 #include <battery/pylontech/Provider.h>
+#endif
+#if FEATURE_BATTERY_PYTES
 #include <battery/pytes/Provider.h>
+#endif
+#if FEATURE_BATTERY_SBS
 #include <battery/sbs/Provider.h>
+#endif
+#if FEATURE_BATTERY_SMARTSHUNT
 #include <battery/victronsmartshunt/Provider.h>
-#include <Configuration.h>
+#endif
 #include <MessageOutput.h>
+#include <TaskProfiler.h>
 
 Batteries::Controller Battery;
 
@@ -18,79 +35,183 @@ std::shared_ptr<Stats const> Controller::getStats() const
 {
     std::lock_guard<std::mutex> lock(_mutex);
 
-    if (!_upProvider) {
+    if (_spAggregateStats) { return _spAggregateStats; }
+
+    if (_providers.empty()) {
         static auto sspDummyStats = std::make_shared<Stats>();
         return sspDummyStats;
     }
 
-    return _upProvider->getStats();
+    return _providers.front()->getStats();
+}
+
+size_t Controller::getPackCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _providers.size();
+}
+
+std::shared_ptr<Stats const> Controller::getPackStats(size_t index) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (index >= _providers.size()) { return nullptr; }
+
+    return _providers[index]->getStats();
+}
+
+void Controller::restoreSoC(float soc, uint8_t precision, uint32_t ageMillis)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_spAggregateStats) {
+        _spAggregateStats->restoreSoC(soc, precision, ageMillis);
+        return;
+    }
+
+    if (_providers.empty()) { return; }
+
+    _providers.front()->getStats()->restoreSoC(soc, precision, ageMillis);
 }
 
 void Controller::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&Controller::loop, this));
+    _loopTask.setCallback(TaskProfiler.wrap("Battery::loop", std::bind(&Controller::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
 
     this->updateSettings();
 }
 
+std::unique_ptr<Provider> Controller::createProvider(uint8_t provider) const
+{
+    if (provider < Features::BatteryProviderCount
+            && !Features::isBatteryProviderAvailable(provider)) {
+        MessageOutput.printf("[Battery] Provider %d is not available in this "
+                "build\r\n", provider);
+        return nullptr;
+    }
+
+    switch (provider) {
+#if FEATURE_BATTERY_PYLONTECH
+        case 0: return std::make_unique<Pylontech::Provider>();
+#endif
+#if FEATURE_BATTERY_JKBMS
+        case 1: return std::make_unique<JkBms::Provider>();
+#endif
+#if FEATURE_BATTERY_MQTT
+        case 2: return std::make_unique<Mqtt::Provider>();
+#endif
+#if FEATURE_BATTERY_SMARTSHUNT
+        case 3: return std::make_unique<VictronSmartShunt::Provider>();
+#endif
+#if FEATURE_BATTERY_PYTES
+        case 4: return std::make_unique<Pytes::Provider>();
+#endif
+#if FEATURE_BATTERY_SBS
+        case 5: return std::make_unique<SBS::Provider>();
+#endif
+#if FEATURE_BATTERY_JBDBMS
+        case 6: return std::make_unique<JbdBms::Provider>();
+#endif
+        default:
+            MessageOutput.printf("[Battery] Unknown provider: %d\r\n", provider);
+            return nullptr;
+    }
+}
+
 void Controller::updateSettings()
 {
     std::lock_guard<std::mutex> lock(_mutex);
 
-    if (_upProvider) {
-        _upProvider->deinit();
-        _upProvider = nullptr;
-    }
+    for (auto& upProvider : _providers) { upProvider->deinit(); }
+    _providers.clear();
+    _spAggregateStats = nullptr;
+    _spAggregateHassIntegration = nullptr;
 
     auto const& config = Configuration.get();
     if (!config.Battery.Enabled) { return; }
 
     bool verboseLogging = config.Battery.VerboseLogging;
 
-    switch (config.Battery.Provider) {
-        case 0:
-            _upProvider = std::make_unique<Pylontech::Provider>();
-            break;
-        case 1:
-            _upProvider = std::make_unique<JkBms::Provider>();
-            break;
-        case 2:
-            _upProvider = std::make_unique<Mqtt::Provider>();
-            break;
-        case 3:
-            _upProvider = std::make_unique<VictronSmartShunt::Provider>();
-            break;
-        case 4:
-            _upProvider = std::make_unique<Pytes::Provider>();
-            break;
-        case 5:
-            _upProvider = std::make_unique<SBS::Provider>();
-            break;
-        case 6:
-            _upProvider = std::make_unique<JbdBms::Provider>();
-            break;
-        default:
-            MessageOutput.printf("[Battery] Unknown provider: %d\r\n", config.Battery.Provider);
-            return;
+    // the main provider comes first, its stats are used if it is the
+    // only one which could be initialized
+    std::vector<uint8_t> providers = { config.Battery.Provider };
+    for (uint8_t provider = 0; provider < Features::BatteryProviderCount; ++provider) {
+        if (provider == config.Battery.Provider) { continue; }
+        if (config.Battery.AdditionalProviders & (1 << provider)) {
+            providers.push_back(provider);
+        }
+    }
+
+    // the MQTT provider needs no pins, all others use the battery pins,
+    // and a second one the battery2 pins.
+    uint8_t pinSet = 0;
+    for (auto provider : providers) {
+        auto upProvider = createProvider(provider);
+        if (!upProvider) { continue; }
+
+        bool needsPins = provider != 2;
+        if (needsPins && pinSet > 1) {
+            MessageOutput.printf("[Battery] No pins left for provider %d\r\n", provider);
+            continue;
+        }
+
+        if (needsPins) { upProvider->setPinSet(pinSet); }
+        if (!upProvider->init(verboseLogging)) { continue; }
+        if (needsPins) { ++pinSet; }
+
+        _providers.push_back(std::move(upProvider));
+    }
+
+    if (_providers.size() < 2) { return; }
+
+    std::vector<std::shared_ptr<Stats const>> packs;
+    for (size_t i = 0; i < _providers.size(); ++i) {
+        auto spStats = _providers[i]->getStats();
+        spStats->setMqttSubtopic("pack" + String(i + 1));
+        packs.push_back(spStats);
     }
 
-    if (!_upProvider->init(verboseLogging)) { _upProvider = nullptr; }
+    _spAggregateStats = std::make_shared<AggregateStats>(std::move(packs));
+    _spAggregateHassIntegration = std::make_shared<HassIntegration>(_spAggregateStats);
 }
 
 void Controller::loop()
 {
     std::lock_guard<std::mutex> lock(_mutex);
 
-    if (!_upProvider) { return; }
+    if (_providers.empty()) { return; }
+
+    for (auto& upProvider : _providers) {
+        upProvider->loop();
+    }
 
-    _upProvider->loop();
+    // the providers update their stats from different contexts, so the
+    // update is announced from here
+    if (_spAggregateStats) { _spAggregateStats->update(); }
 
-    _upProvider->getStats()->mqttLoop();
+    auto lastUpdate = _spAggregateStats ? _spAggregateStats->getLastUpdate()
+        : _providers.front()->getStats()->getLastUpdate();
+    if (lastUpdate != _lastStatsUpdate) {
+        _lastStatsUpdate = lastUpdate;
+        DataBus.publish(DataBusClass::Topic::Battery);
+    }
+
+    for (auto& upProvider : _providers) {
+        upProvider->getStats()->mqttLoop();
+    }
+
+    if (_spAggregateStats) {
+        // the individual batteries are not announced to Home Assistant,
+        // as their integrations assume to publish below battery/
+        _spAggregateStats->mqttLoop();
+        _spAggregateHassIntegration->hassLoop();
+        return;
+    }
 
-    auto spHassIntegration = _upProvider->getHassIntegration();
+    auto spHassIntegration = _providers.front()->getHassIntegration();
     if (spHassIntegration) { spHassIntegration->hassLoop(); }
 }
 
@@ -4,8 +4,10 @@
 #include <battery/Stats.h>
 #include <battery/HassIntegration.h>
 #include <Configuration.h>
+#include <MemoryPolicy.h>
 #include <MqttSettings.h>
 #include <MqttHandleHass.h>
+#include <MqttHassPublisher.h>
 #include <Utils.h>
 #include <__compiled_constants.h>
 
@@ -14,6 +16,11 @@ namespace Batteries {
 HassIntegration::HassIntegration(std::shared_ptr<Stats> spStats)
     : _spStats(spStats) { }
 
+HassIntegration::~HassIntegration()
+{
+    MqttHassPublisher.cancel(this);
+}
+
 void HassIntegration::hassLoop()
 {
     auto const& config = Configuration.get();
@@ -47,6 +54,16 @@ void HassIntegration::publishSensors() const
 void HassIntegration::publishSensor(const char* caption, const char* icon,
         const char* subTopic, const char* deviceClass,
         const char* stateClass, const char* unitOfMeasurement) const
+{
+    // the arguments are string literals, so the pointers stay valid
+    MqttHassPublisher.enqueue(this, [=]() {
+        generateSensor(caption, icon, subTopic, deviceClass, stateClass, unitOfMeasurement);
+    });
+}
+
+void HassIntegration::generateSensor(const char* caption, const char* icon,
+        const char* subTopic, const char* deviceClass,
+        const char* stateClass, const char* unitOfMeasurement) const
 {
     String sensorId = caption;
     sensorId.replace(" ", "_");
@@ -65,7 +82,7 @@ void HassIntegration::publishSensor(const char* caption, const char* icon,
     // statTopic.concat("/");
     statTopic.concat(subTopic);
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::jsonAllocator());
     root["name"] = caption;
     root["stat_t"] = statTopic;
     root["uniq_id"] = _serial + "_" + sensorId;
@@ -104,6 +121,15 @@ void HassIntegration::publishSensor(const char* caption, const char* icon,
 void HassIntegration::publishBinarySensor(const char* caption,
         const char* icon, const char* subTopic,
         const char* payload_on, const char* payload_off) const
+{
+    MqttHassPublisher.enqueue(this, [=]() {
+        generateBinarySensor(caption, icon, subTopic, payload_on, payload_off);
+    });
+}
+
+void HassIntegration::generateBinarySensor(const char* caption,
+        const char* icon, const char* subTopic,
+        const char* payload_on, const char* payload_off) const
 {
     String sensorId = caption;
     sensorId.replace(" ", "_");
@@ -123,7 +149,7 @@ void HassIntegration::publishBinarySensor(const char* caption,
     // statTopic.concat("/");
     statTopic.concat(subTopic);
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::jsonAllocator());
 
     root["name"] = caption;
     root["uniq_id"] = _serial + "_" + sensorId;
@@ -160,9 +186,7 @@ void HassIntegration::createDeviceInfo(JsonObject& object) const
 
 void HassIntegration::publish(const String& subtopic, const String& payload) const
 {
-    String topic = Configuration.get().Mqtt.Hass.Topic;
-    topic += subtopic;
-    MqttSettings.publishGeneric(topic.c_str(), payload.c_str(), Configuration.get().Mqtt.Hass.Retain);
+    MqttHassPublisher.publish(subtopic, payload);
 }
 
 } // namespace Batteries
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <battery/Provider.h>
+#include <battery/Stats.h>
+#include <gridcharger/huawei/Controller.h>
+#include <Configuration.h>
+#include <MessageOutput.h>
+#include <PinMapping.h>
+#include <PowerLimiter.h>
+#include <algorithm>
+#include <cmath>
+
+namespace Batteries {
+
+namespace {
+
+constexpr uint32_t FastPollIntervalMillis = 1000;
+constexpr uint32_t SlowPollIntervalFactor = 4;
+constexpr uint32_t SlowPollIntervalMaxMillis = 60 * 1000;
+
+// how close to the stop thresholds the battery has to be for the fast rate
+constexpr float StopVoltageMargin = 0.5;
+constexpr float StopSocMargin = 5;
+
+// below this, the battery is considered idle
+constexpr float IdleCurrentAmps = 0.5;
+constexpr float GridChargerActiveAmps = 0.5;
+
+} // namespace
+
+void Provider::updatePollInterval(uint8_t configuredSeconds, bool verboseLogging)
+{
+    auto const& config = Configuration.get();
+    auto spStats = getStats();
+
+    uint32_t interval = configuredSeconds * 1000;
+
+    bool discharging = PowerLimiter.isGovernedBatteryPoweredInverterProducing();
+
+    bool nearStop = false;
+    if (spStats && spStats->isVoltageValid()) {
+        nearStop |= spStats->getVoltage() <= config.PowerLimiter.VoltageStopThreshold + StopVoltageMargin;
+    }
+    if (spStats && spStats->isSoCValid() && !config.PowerLimiter.IgnoreSoc) {
+        nearStop |= spStats->getSoC() <= config.PowerLimiter.BatterySocStopThreshold + StopSocMargin;
+    }
+
+    bool gridCharging = false;
+    if (config.Huawei.Enabled) {
+        using Label = GridCharger::Huawei::DataPointLabel;
+        auto oOutputCurrent = HuaweiCan.getDataPoints().get<Label::OutputCurrent>();
+        gridCharging = oOutputCurrent && *oOutputCurrent > GridChargerActiveAmps;
+    }
+
+    bool idle = !discharging && !gridCharging && spStats && spStats->isCurrentValid()
+        && std::fabs(spStats->getChargeCurrent()) < IdleCurrentAmps;
+
+    char const* reason = "configured";
+    if ((discharging && nearStop) || gridCharging) {
+        interval = std::min(interval, FastPollIntervalMillis);
+        reason = gridCharging ? "grid charger active" : "close to stop threshold";
+    } else if (idle) {
+        interval = std::max(interval, std::min(interval * SlowPollIntervalFactor, SlowPollIntervalMaxMillis));
+        reason = "battery idle";
+    }
+
+    if (interval == _pollIntervalMillis) { return; }
+    _pollIntervalMillis = interval;
+
+    if (!verboseLogging) { return; }
+    MessageOutput.printf("[Battery] Polling the BMS every %u ms (%s)\r\n", interval, reason);
+}
+
+Provider::Pins Provider::getPins() const
+{
+    auto const& pin = PinMapping.get();
+
+    if (_pinSet == 1) {
+        return { pin.battery2_rx, pin.battery2_rxen, pin.battery2_tx, pin.battery2_txen };
+    }
+
+    return { pin.battery_rx, pin.battery_rxen, pin.battery_tx, pin.battery_txen };
+}
+
+} // namespace Batteries
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <battery/ResistanceEstimator.h>
+
+namespace Batteries {
+
+void ResistanceEstimator::reset()
+{
+    *this = ResistanceEstimator();
+}
+
+void ResistanceEstimator::update(float current, float voltage)
+{
+    // exponentially weighted mean and (co)variances, updated incrementally
+    // to avoid the cancellation of large sums of squares
+    _weight = _weight * Decay + 1;
+    float alpha = 1 / _weight;
+
+    float dCurrent = current - _meanCurrent;
+    float dVoltage = voltage - _meanVoltage;
+
+    _meanCurrent += alpha * dCurrent;
+    _meanVoltage += alpha * dVoltage;
+
+    _varCurrent = (1 - alpha) * (_varCurrent + alpha * dCurrent * dCurrent);
+    _varVoltage = (1 - alpha) * (_varVoltage + alpha * dVoltage * dVoltage);
+    _covariance = (1 - alpha) * (_covariance + alpha * dCurrent * dVoltage);
+
+    ++_samples;
+}
+
+std::optional<float> ResistanceEstimator::getResistance() const
+{
+    if (_samples < MinSamples || _varCurrent < MinCurrentVariance) { return std::nullopt; }
+
+    // the voltage rises while charging, i.e., the slope is positive
+    float resistance = _covariance / _varCurrent;
+    if (resistance <= 0 || resistance > MaxResistance) { return std::nullopt; }
+
+    return resistance;
+}
+
+float ResistanceEstimator::getFitQuality() const
+{
+    if (_varCurrent <= 0 || _varVoltage <= 0) { return 0; }
+
+    return (_covariance * _covariance) / (_varCurrent * _varVoltage);
+}
+
+} // namespace Batteries
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <battery/SocEstimator.h>
+#include <algorithm>
+#include <cmath>
+
+namespace Batteries {
+
+void SocEstimator::reset()
+{
+    *this = SocEstimator();
+}
+
+void SocEstimator::update(float soc, uint8_t precision, uint32_t socTimestamp,
+        float current, float capacity, uint32_t now)
+{
+    if (capacity <= 0) {
+        reset();
+        return;
+    }
+
+    if (!_valid || socTimestamp != _lastSoCTimestamp) {
+        // the true SoC is within the interval which rounds to the
+        // reported value
+        float halfStep = 0.5f * std::pow(10.0f, -static_cast<float>(precision));
+
+        if (!_valid) { _estimate = soc; }
+        _estimate = std::clamp(_estimate, soc - halfStep, soc + halfStep);
+
+        _valid = true;
+        _reportedSoC = soc;
+        _lastSoCTimestamp = socTimestamp;
+        _lastIntegration = now;
+        return;
+    }
+
+    uint32_t elapsed = std::min(now - _lastIntegration, MaxIntegrationMillis);
+    _lastIntegration = now;
+
+    float chargeAh = current * elapsed / (3600.0f * 1000.0f);
+    _estimate += chargeAh / capacity * 100;
+
+    _estimate = std::clamp(_estimate, _reportedSoC - MaxDeviation, _reportedSoC + MaxDeviation);
+    _estimate = std::clamp(_estimate, 0.0f, 100.0f);
+}
+
+std::optional<float> SocEstimator::getSoC(uint32_t now) const
+{
+    if (!_valid) { return std::nullopt; }
+    if ((now - _lastSoCTimestamp) > MaxSoCAgeMillis) { return std::nullopt; }
+    if ((now - _lastIntegration) > MaxIntegrationMillis) { return std::nullopt; }
+    return _estimate;
+}
+
+} // namespace Batteries
@@ -1,4 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <limits>
 #include <battery/Stats.h>
 #include <Configuration.h>
@@ -67,49 +70,175 @@ void Stats::mqttLoop()
 {
     auto& config = Configuration.get();
 
-    if (!MqttSettings.getConnected()
-            || (millis() - _lastMqttPublish) < (config.Mqtt.PublishInterval * 1000)) {
+    if (!MqttSettings.acceptsPublishes()) {
+        // messages were lost while the broker was not reachable, so
+        // everything is published again once the connection was
+        // re-established.
+        _lastFullMqttPublish = 0;
+        _mqttPublished.clear();
+        _mqttCellVoltages.clear();
         return;
     }
 
+    if ((millis() - _lastMqttPublish) < (config.Mqtt.PublishInterval * 1000)) {
+        return;
+    }
+
+    // regularly publish all topics regardless of whether or not their value changed
+    bool neverFullyPublished = _lastFullMqttPublish == 0;
+    bool intervalElapsed = (millis() - _lastFullMqttPublish) >= getMqttFullPublishIntervalMs();
+    _mqttFullPublish = neverFullyPublished || intervalElapsed;
+
     mqttPublish();
 
     _lastMqttPublish = millis();
+    if (_mqttFullPublish) { _lastFullMqttPublish = _lastMqttPublish; }
+    _mqttFullPublish = false;
 }
 
 uint32_t Stats::getMqttFullPublishIntervalMs() const
 {
     auto& config = Configuration.get();
 
-    // this is the default interval, see mqttLoop(). mqttPublish()
-    // implementations in derived classes may choose to publish some values
-    // with a lower frequency and hence implement this method with a different
-    // return value.
-    return config.Mqtt.PublishInterval * 1000;
+    // values are published at the regular interval only if they changed,
+    // see mqttLoop(). all values are published at the full interval, which
+    // cannot be shorter than the regular interval.
+    uint32_t interval = std::max<uint32_t>(config.Mqtt.PublishInterval,
+            config.Battery.MqttFullPublishInterval);
+    return interval * 1000;
+}
+
+// 32 bit FNV-1a
+static uint32_t mqttHash(char const* text)
+{
+    uint32_t result = 2166136261UL;
+    for (char const* c = text; *c != '\0'; ++c) {
+        result ^= static_cast<uint8_t>(*c);
+        result *= 16777619UL;
+    }
+    return result;
+}
+
+bool Stats::exceedsMqttDeadband(float last, float value, float absoluteDeadband) const
+{
+    float relativeDeadband = Configuration.get().Battery.MqttDeadbandRelative;
+
+    float delta = std::fabs(value - last);
+    if (delta <= absoluteDeadband) { return false; }
+    return delta > std::fabs(last) * relativeDeadband / 100;
+}
+
+MqttTopicRegistryClass::Handle Stats::internMqttTopic(char const* topic) const
+{
+    static constexpr char const prefix[] = "battery/";
+    static constexpr size_t prefixLength = sizeof(prefix) - 1;
+
+    if (_mqttTopicPrefix.isEmpty() || strncmp(topic, prefix, prefixLength) != 0) {
+        return MqttTopicRegistry.intern(topic);
+    }
+
+    return MqttTopicRegistry.intern(_mqttTopicPrefix.c_str(), topic + prefixLength);
+}
+
+void Stats::mqttPublishValue(char const* topic, char const* text,
+        std::optional<float> value, float absoluteDeadband) const
+{
+    uint32_t topicHash = mqttHash(topic);
+    uint32_t textHash = mqttHash(text);
+    float numeric = value.value_or(NAN);
+
+    auto it = std::lower_bound(_mqttPublished.begin(), _mqttPublished.end(), topicHash,
+        [](auto const& entry, uint32_t hash) { return entry.topicHash < hash; });
+
+    if (it != _mqttPublished.end() && it->topicHash == topicHash) {
+        if (!_mqttFullPublish) {
+            if (it->textHash == textHash) { return; }
+
+            // the last published value is kept if the change is suppressed,
+            // such that slow drifts are published eventually.
+            bool numericChange = !std::isnan(it->value) && !std::isnan(numeric);
+            if (numericChange && !exceedsMqttDeadband(it->value, numeric, absoluteDeadband)) {
+                return;
+            }
+        }
+
+        it->textHash = textHash;
+        it->value = numeric;
+    } else {
+        it = _mqttPublished.insert(it, { topicHash, textHash, numeric,
+                internMqttTopic(topic) });
+    }
+
+    MqttSettings.publish(it->topic, text);
+}
+
+void Stats::mqttPublishCellVoltages(tCellVoltages const& cellVoltages) const
+{
+    auto const& config = Configuration.get().Battery;
+
+    if (!config.MqttCellVoltagesJson) {
+        // only cells whose voltage changed since the last call are passed
+        // on, which skips building their topics in the common case
+        _mqttCellVoltages.resize(cellVoltages.size());
+        size_t idx = 0;
+        for (auto milliVolt : cellVoltages) {
+            if (!_mqttFullPublish && _mqttCellVoltages[idx] == milliVolt) {
+                ++idx;
+                continue;
+            }
+            _mqttCellVoltages[idx] = milliVolt;
+
+            char topic[32];
+            snprintf(topic, sizeof(topic), "battery/Cell%uMilliVolt", static_cast<unsigned>(++idx));
+            mqttPublishValue(topic, milliVolt, config.MqttCellDeadbandMilliVolt);
+        }
+        return;
+    }
+
+    // the array is published as a whole if any cell voltage exceeds the deadband
+    bool changed = _mqttFullPublish || cellVoltages.size() != _mqttCellVoltages.size();
+    size_t idx = 0;
+    for (auto iter = cellVoltages.begin(); !changed && iter != cellVoltages.end(); ++iter, ++idx) {
+        changed = exceedsMqttDeadband(_mqttCellVoltages[idx], *iter,
+                config.MqttCellDeadbandMilliVolt);
+    }
+
+    if (!changed) { return; }
+
+    _mqttCellVoltages.assign(cellVoltages.begin(), cellVoltages.end());
+    String payload("[");
+    payload.reserve(cellVoltages.size() * 5 + 2);
+    for (auto milliVolt : cellVoltages) {
+        if (payload.length() > 1) { payload += ","; }
+        payload += milliVolt;
+    }
+    payload += "]";
+
+    MqttSettings.publish(internMqttTopic("battery/CellsMilliVolt"), payload.c_str());
 }
 
 void Stats::mqttPublish() const
 {
     if (_oManufacturer.has_value()) {
-        MqttSettings.publish("battery/manufacturer", *_oManufacturer);
+        mqttPublishValue("battery/manufacturer", *_oManufacturer);
     }
 
-    MqttSettings.publish("battery/dataAge", String(getAgeSeconds()));
+    mqttPublishValue("battery/dataAge", getAgeSeconds());
 
     if (isSoCValid()) {
-        MqttSettings.publish("battery/stateOfCharge", String(_soc));
+        mqttPublishValue("battery/stateOfCharge", _soc);
     }
 
     if (isVoltageValid()) {
-        MqttSettings.publish("battery/voltage", String(_voltage));
+        mqttPublishValue("battery/voltage", _voltage);
     }
 
     if (isCurrentValid()) {
-        MqttSettings.publish("battery/current", String(_current));
+        mqttPublishValue("battery/current", _current);
     }
 
     if (isDischargeCurrentLimitValid()) {
-        MqttSettings.publish("battery/settings/dischargeCurrentLimitation", String(_dischargeCurrentLimit));
+        mqttPublishValue("battery/settings/dischargeCurrentLimitation", _dischargeCurrentLimit);
     }
 }
 
@@ -2,12 +2,13 @@
 #include <numeric>
 #include <Configuration.h>
 #include <HardwareSerial.h>
-#include <PinMapping.h>
+#include <InputCapture.h>
 #include <MessageOutput.h>
 #include <battery/jbdbms/DataPoints.h>
 #include <battery/jbdbms/Provider.h>
 #include <battery/jbdbms/SerialMessage.h>
 #include <SerialPortManager.h>
+#include <TaskPlacement.h>
 #include <frozen/map.h>
 
 namespace Batteries::JbdBms {
@@ -19,52 +20,63 @@ Provider::Provider()
 bool Provider::init(bool verboseLogging)
 {
     _verboseLogging = verboseLogging;
+    updatePollInterval(Configuration.get().Battery.JkBmsPollingInterval, _verboseLogging);
 
     std::string ifcType = "transceiver";
     if (Interface::Transceiver != getInterface()) { ifcType = "TTL-UART"; }
     MessageOutput.printf("[JBD BMS] Initialize %s interface...\r\n", ifcType.c_str());
 
-    const PinMapping_t& pin = PinMapping.get();
+    auto const pin = getPins();
     MessageOutput.printf("[JBD BMS] rx = %d, rxen = %d, tx = %d, txen = %d\r\n",
-            pin.battery_rx, pin.battery_rxen, pin.battery_tx, pin.battery_txen);
+            pin.Rx, pin.RxEnable, pin.Tx, pin.TxEnable);
 
-    if (pin.battery_rx < 0 || pin.battery_tx < 0) {
+    if (pin.Rx < 0 || pin.Tx < 0) {
         MessageOutput.println("[JBD BMS] Invalid RX/TX pin config");
         return false;
     }
 
 #ifdef JBDBMS_DUMMY_SERIAL
     _upSerial = std::make_unique<DummySerial>();
+    _upSerial->begin(9600, SERIAL_8N1, pin.Rx, pin.Tx);
 #else
-    auto oHwSerialPort = SerialPortManager.allocatePort(_serialPortOwner);
-    if (!oHwSerialPort) { return false; }
-
-    _upSerial = std::make_unique<HardwareSerial>(*oHwSerialPort);
+    if (!SerialPortManager.allocateSharedPort(_serialPortOwner,
+                { 9600, SERIAL_8N1, pin.Rx, pin.Tx })) {
+        return false;
+    }
 #endif
 
-    _upSerial->end(); // make sure the UART will be re-initialized
-    _upSerial->begin(9600, SERIAL_8N1, pin.battery_rx, pin.battery_tx);
-    _upSerial->flush();
-
-    if (Interface::Transceiver != getInterface()) { return true; }
+    if (Interface::Transceiver == getInterface()) {
+        _rxEnablePin = pin.RxEnable;
+        _txEnablePin = pin.TxEnable;
 
-    _rxEnablePin = pin.battery_rxen;
-    _txEnablePin = pin.battery_txen;
+        if (_rxEnablePin < 0 || _txEnablePin < 0) {
+            MessageOutput.println("[JBD BMS] Invalid transceiver pin config");
+            return false;
+        }
 
-    if (_rxEnablePin < 0 || _txEnablePin < 0) {
-        MessageOutput.println("[JBD BMS] Invalid transceiver pin config");
-        return false;
+        pinMode(_rxEnablePin, OUTPUT);
+        pinMode(_txEnablePin, OUTPUT);
     }
 
-    pinMode(_rxEnablePin, OUTPUT);
-    pinMode(_txEnablePin, OUTPUT);
+    // the period only matters to send requests and detect timeouts, as
+    // the UART buffers a whole response.
+    uint32_t constexpr stackSize = 3072;
+    if (!startSerialTask("JBD BMS", TaskPlacement::Role::SerialBattery,
+                stackSize, 50/*period ms*/, nullptr)) {
+        MessageOutput.println("[JBD BMS] Failed to create task, polling from main loop");
+    }
 
     return true;
 }
 
 void Provider::deinit()
 {
+    stopSerialTask();
+    closeWindow();
+
+#ifdef JBDBMS_DUMMY_SERIAL
     _upSerial->end();
+#endif
 
     if (_rxEnablePin > 0) { pinMode(_rxEnablePin, INPUT); }
     if (_txEnablePin > 0) { pinMode(_txEnablePin, INPUT); }
@@ -84,10 +96,11 @@ frozen::string const& Provider::getStatusText(Provider::Status status)
 {
     static constexpr frozen::string missing = "programmer error: missing status text";
 
-    static constexpr frozen::map<Status, frozen::string, 6> texts = {
+    static constexpr frozen::map<Status, frozen::string, 7> texts = {
         { Status::Timeout, "timeout wating for response from BMS" },
         { Status::WaitingForPollInterval, "waiting for poll interval to elapse" },
         { Status::HwSerialNotAvailableForWrite, "UART is not available for writing" },
+        { Status::WaitingForWindow, "waiting for the shared UART to become available" },
         { Status::BusyReading, "busy waiting for or reading a message from the BMS" },
         { Status::RequestSent, "request for data sent" },
         { Status::FrameCompleted, "a whole frame was received" }
@@ -110,47 +123,64 @@ void Provider::announceStatus(Provider::Status status)
     _lastStatusPrinted = millis();
 }
 
-void Provider::sendRequest(uint8_t pollInterval)
+void Provider::startPollCycle(uint8_t cellVoltagesDivider)
+{
+    using Command = SerialCommand::Command;
+
+    _pipelineSize = 0;
+    _pipelinePos = 0;
+
+    if (!_hardwareVersionRequested) { // read only once
+        _pipeline[_pipelineSize++] = Command::ReadHardwareVersionNumber;
+        _hardwareVersionRequested = true;
+    }
+
+    _pipeline[_pipelineSize++] = Command::ReadBasicInformation;
+
+    if (cellVoltagesDivider == 0 || (_pollCycle % cellVoltagesDivider) == 0) {
+        _pipeline[_pipelineSize++] = Command::ReadCellVoltages;
+    }
+
+    ++_pollCycle;
+    _lastPollCycle = millis();
+}
+
+void Provider::sendRequest(uint32_t pollIntervalMillis, uint8_t cellVoltagesDivider)
 {
     if (ReadState::Idle != _readState) {
         return announceStatus(Status::BusyReading);
     }
 
-    if ((millis() - _lastRequest) < pollInterval * 1000) {
-        return announceStatus(Status::WaitingForPollInterval);
+    // the requests of a poll cycle are sent back to back: the next request
+    // is sent as soon as the previous one was answered or timed out.
+    if (_pipelinePos >= _pipelineSize) {
+        if ((millis() - _lastPollCycle) < pollIntervalMillis) {
+            return announceStatus(Status::WaitingForPollInterval);
+        }
+
+        startPollCycle(cellVoltagesDivider);
     }
 
-    if (!_upSerial->availableForWrite()) {
-        return announceStatus(Status::HwSerialNotAvailableForWrite);
+    if (!openWindow()) {
+        return announceStatus(Status::WaitingForWindow);
     }
 
-    SerialCommand::Command cmd;
-    switch (SerialCommand::getLastCommand()) {
-        case SerialCommand::Command::Init: // read only once
-            cmd = SerialCommand::Command::ReadHardwareVersionNumber;
-            break;
-        case SerialCommand::Command::ReadBasicInformation:
-            cmd = SerialCommand::Command::ReadCellVoltages;
-            break;
-        case SerialCommand::Command::ReadCellVoltages:
-            cmd = SerialCommand::Command::ReadBasicInformation;
-            break;
-        default:
-            cmd = SerialCommand::Command::ReadBasicInformation;
-            break;
+    if (!_pSerial->availableForWrite()) {
+        closeWindow();
+        return announceStatus(Status::HwSerialNotAvailableForWrite);
     }
 
-    SerialCommand readCmd(SerialCommand::Status::Read, cmd);
+    SerialCommand readCmd(SerialCommand::Status::Read, _pipeline[_pipelinePos++]);
 
     if (Interface::Transceiver == getInterface()) {
         digitalWrite(_rxEnablePin, HIGH); // disable reception (of our own data)
         digitalWrite(_txEnablePin, HIGH); // enable transmission
     }
 
-    _upSerial->write(readCmd.data(), readCmd.size());
+    _pSerial->write(readCmd.data(), readCmd.size());
 
     if (Interface::Transceiver == getInterface()) {
-        _upSerial->flush();
+        _pSerial->flush();
         digitalWrite(_rxEnablePin, LOW); // enable reception
         digitalWrite(_txEnablePin, LOW); // disable transmission (free the bus)
     }
@@ -163,24 +193,54 @@ void Provider::sendRequest(uint8_t pollInterval)
 
 void Provider::loop()
 {
-    auto const& config = Configuration.get();
-    uint8_t pollInterval = config.Battery.JkBmsPollingInterval;
+    updatePollInterval(Configuration.get().Battery.JkBmsPollingInterval, _verboseLogging);
+
+    // no task could be created, so we talk to the BMS ourselves
+    if (!hasSerialTask()) { serialLoop(); }
+
+    {
+        std::lock_guard<std::mutex> lock(_handoffMutex);
+        if (!_dataPointsPending) { return; }
+
+        _handoffDataPoints.clear();
+        _handoffDataPoints.updateFrom(_pendingDataPoints);
+        _pendingDataPoints.clear();
+        _dataPointsPending = false;
+    }
+
+    processDataPoints(_handoffDataPoints);
+}
 
-    while (_upSerial->available()) {
-        rxData(_upSerial->read());
+void Provider::serialLoop()
+{
+    auto const& config = Configuration.get();
+    uint32_t pollIntervalMillis = getPollIntervalMillis();
+
+    // the reset() after a complete frame closes the window
+    while (_pSerial && _pSerial->available()) {
+        uint8_t inbyte = _pSerial->read();
+        // the live input is dropped while a recording is replayed
+        if (InputCapture.isReplaying(InputCapture::Source::JbdBms)) { continue; }
+        InputCapture.record(InputCapture::Source::JbdBms, 0, &inbyte, 1);
+        rxData(inbyte);
     }
 
-    sendRequest(pollInterval);
+    InputCapture.replay(InputCapture::Source::JbdBms, 0, [this](uint8_t const* data, size_t length) {
+        for (size_t i = 0; i < length; ++i) { rxData(data[i]); }
+    });
 
-    if (millis() > _lastRequest + 2 * pollInterval * 1000 + 250) {
+    if (ReadState::Idle != _readState && millis() - _lastRequest > _responseTimeoutMillis) {
         reset();
-        return announceStatus(Status::Timeout);
+        announceStatus(Status::Timeout);
     }
+
+    sendRequest(pollIntervalMillis, config.Battery.JbdBmsCellVoltagesDivider);
 }
 
 void Provider::rxData(uint8_t inbyte)
 {
     _buffer.push_back(inbyte);
+    SerialMessage::accumulateChecksum(_checksumSum, _buffer);
 
     switch(_readState) {
         case ReadState::Idle: // unsolicited message from BMS
@@ -227,9 +287,36 @@ void Provider::rxData(uint8_t inbyte)
     reset();
 }
 
+bool Provider::openWindow()
+{
+    if (_pSerial) { return true; }
+
+#ifdef JBDBMS_DUMMY_SERIAL
+    _pSerial = _upSerial.get();
+#else
+    _pSerial = SerialPortManager.acquireWindow(_serialPortOwner);
+#endif
+
+    return _pSerial != nullptr;
+}
+
+void Provider::closeWindow()
+{
+    if (!_pSerial) { return; }
+
+#ifndef JBDBMS_DUMMY_SERIAL
+    SerialPortManager.releaseWindow(_serialPortOwner);
+#endif
+
+    _pSerial = nullptr;
+}
+
 void Provider::reset()
 {
-    _buffer.clear();
+    closeWindow();
+
+    _buffer.clear(); // keeps the capacity for the next frame
+    _checksumSum = 0;
     return setReadState(ReadState::Idle);
 }
 
@@ -250,9 +337,13 @@ void Provider::frameComplete()
         MessageOutput.println();
     }
 
-    auto pResponse = std::make_unique<SerialResponse>(std::move(_buffer));
-    if (pResponse->isValid()) {
-        processDataPoints(pResponse->getDataPoints());
+    _frameDataPoints.clear();
+    SerialResponse response(ByteSpan(_buffer.data(), _buffer.size()),
+            _checksumSum, _frameDataPoints);
+    if (response.isValid()) {
+        std::lock_guard<std::mutex> lock(_handoffMutex);
+        _pendingDataPoints.updateFrom(response.getDataPoints());
+        _dataPointsPending = true;
     } // if invalid, error message has been produced by SerialResponse c'tor
 
     reset();
@@ -264,15 +355,13 @@ void Provider::processDataPoints(DataPointContainer const& dataPoints)
 
     if (!_verboseLogging) { return; }
 
-    auto iter = dataPoints.cbegin();
-    while ( iter != dataPoints.cend() ) {
+    dataPoints.forEach([](DataPointLabel label, auto const& dataPoint) {
         MessageOutput.printf("[%11.3f] JBD BMS: %s: %s%s\r\n",
-            static_cast<double>(iter->second.getTimestamp())/1000,
-            iter->second.getLabelText().c_str(),
-            iter->second.getValueText().c_str(),
-            iter->second.getUnitText().c_str());
-        ++iter;
-    }
+            static_cast<double>(dataPoint.getTimestamp())/1000,
+            DataPointContainer::getLabelText(label),
+            dataPoint.getValueText().c_str(),
+            DataPointContainer::getUnitText(label));
+    });
 }
 
 } // namespace Batteries::JbdBms
@@ -7,14 +7,18 @@
 namespace Batteries::JbdBms {
 
 SerialCommand::SerialCommand(SerialCommand::Status status, SerialCommand::Command cmd)
-    : SerialMessage(7, 0x00) // frame length 7 bytes initialized with zeros
+    : SerialMessage(ByteSpan(), 0)
+    , _storage(7, 0x00) // frame length 7 bytes initialized with zeros
 {
-    set(_raw.begin(), startMarker);
-    set(_raw.begin() + 1, static_cast<uint8_t>(status));
-    set(_raw.begin() + 2, static_cast<uint8_t>(cmd));
-    set(_raw.begin() + 3, static_cast<uint16_t>(0x00)); // frame length
-    updateChecksum();
-    set(_raw.end() - 1, endMarker);
+    _raw = ByteSpan(_storage.data(), _storage.size());
+
+    set(_storage.begin(), startMarker);
+    set(_storage.begin() + 1, static_cast<uint8_t>(status));
+    set(_storage.begin() + 2, static_cast<uint8_t>(cmd));
+    set(_storage.begin() + 3, static_cast<uint16_t>(0x00)); // frame length
+    _checksum = calcChecksum();
+    set(_storage.end() - 3, _checksum);
+    set(_storage.end() - 1, endMarker);
 
     _lastCmd = cmd;
 }
@@ -25,8 +29,9 @@ SerialCommand::Command SerialCommand::_lastCmd = SerialCommand::Command::Init;
 using Label = JbdBms::DataPointLabel;
 template<Label L> using Traits = DataPointLabelTraits<L>;
 
-SerialResponse::SerialResponse(tData&& raw)
-    : SerialMessage(std::move(raw))
+SerialResponse::SerialResponse(ByteSpan raw, uint16_t checksumSum, DataPointContainer& dp)
+    : SerialMessage(raw, checksumFromSum(checksumSum))
+    , _dp(dp)
 {
     if (!isValid()) { return; }
 
@@ -76,11 +81,9 @@ SerialResponse::SerialResponse(tData&& raw)
         else if (getCommand() == Command::ReadCellVoltages)
         {
             uint8_t cellAmount = getDataLength() / 2;
-            std::map<uint8_t, uint16_t> voltages;
+            tCellVoltages voltages;
             for (size_t cellCounter = 0; cellCounter < cellAmount; ++cellCounter) {
-                uint8_t idx = cellCounter;
-                auto cellMilliVolt = get<uint16_t>(pos);
-                voltages[idx] = cellMilliVolt;
+                voltages.add(get<uint16_t>(pos));
             }
             _dp.add<Label::CellsMilliVolt>(voltages);
         }
@@ -172,24 +175,31 @@ std::string SerialMessage::getString(It&& pos, size_t len, bool replaceZeroes) c
 }
 
 template<typename T>
-void SerialMessage::set(tData::iterator const& pos, T val)
+void SerialCommand::set(tData::iterator const& pos, T val)
 {
     // avoid out-of-bound write
-    if (std::distance(pos, _raw.end()) < sizeof(T)) { return; }
+    if (std::distance(pos, _storage.end()) < sizeof(T)) { return; }
 
     for (unsigned i = 0; i < sizeof(T); ++i) {
         *(pos+i) = static_cast<uint8_t>(val >> (sizeof(T)-1-i)*8);
     }
 }
 
-uint16_t SerialMessage::calcChecksum() const
+uint16_t SerialCommand::calcChecksum() const
 {
-    return (~std::accumulate(_raw.cbegin()+2, _raw.cend()-3, 0) + 0x01);
+    return checksumFromSum(std::accumulate(_storage.cbegin()+2, _storage.cend()-3, 0));
 }
 
-void SerialMessage::updateChecksum()
+void SerialMessage::accumulateChecksum(uint16_t& sum, tData const& frame)
 {
-    set(_raw.end()-3, calcChecksum());
+    // the checksum covers the status, the data length and the data content,
+    // i.e., it starts after the start marker and the command code. the data
+    // length field is the fourth byte.
+    size_t idx = frame.size() - 1;
+    if (idx < 2) { return; }
+    if (idx >= 4 && idx >= 4 + static_cast<size_t>(frame[3])) { return; }
+
+    sum += frame[idx];
 }
 
 void SerialMessage::printMessage() {
@@ -228,7 +238,7 @@ bool SerialMessage::isValid() const {
     }
 
     uint16_t const actualChecksum = getChecksum();
-    uint16_t const expectedChecksum = calcChecksum();
+    uint16_t const expectedChecksum = _checksum;
     if (actualChecksum != expectedChecksum) {
         MessageOutput.printf("JbdBms::SerialMessage: invalid checksum 0x%04x, expected 0x%04x\r\n",
             actualChecksum, expectedChecksum);
@@ -2,7 +2,7 @@
 #include <algorithm>
 #include <string>
 #include <vector>
-#include <MqttSettings.h>
+#include <Configuration.h>
 #include <battery/jbdbms/Stats.h>
 #include <battery/jbdbms/DataPoints.h>
 
@@ -43,10 +43,12 @@ void Stats::getJsonData(JsonVariant& root, bool verbose) const
     }
 
     if (_cellVoltageTimestamp > 0) {
-        addLiveViewInSection(root, "cells", "cellMinVoltage", static_cast<float>(_cellMinMilliVolt)/1000, "V", 3);
-        addLiveViewInSection(root, "cells", "cellAvgVoltage", static_cast<float>(_cellAvgMilliVolt)/1000, "V", 3);
-        addLiveViewInSection(root, "cells", "cellMaxVoltage", static_cast<float>(_cellMaxMilliVolt)/1000, "V", 3);
-        addLiveViewInSection(root, "cells", "cellDiffVoltage", (_cellMaxMilliVolt - _cellMinMilliVolt), "mV", 0);
+        addLiveViewInSection(root, "cells", "cellMinVoltage", static_cast<float>(_cellVoltages.getMinMilliVolt())/1000, "V", 3);
+        addLiveViewInSection(root, "cells", "cellMinVoltageCell", _cellVoltages.getMinCell(), "", 0);
+        addLiveViewInSection(root, "cells", "cellAvgVoltage", static_cast<float>(_cellVoltages.getAvgMilliVolt())/1000, "V", 3);
+        addLiveViewInSection(root, "cells", "cellMaxVoltage", static_cast<float>(_cellVoltages.getMaxMilliVolt())/1000, "V", 3);
+        addLiveViewInSection(root, "cells", "cellMaxVoltageCell", _cellVoltages.getMaxCell(), "", 0);
+        addLiveViewInSection(root, "cells", "cellDiffVoltage", _cellVoltages.getDiffMilliVolt(), "mV", 0);
     }
 
     auto oBalancingEnabled = _dataPoints.get<Label::BalancingEnabled>();
@@ -93,39 +95,25 @@ void Stats::mqttPublish() const
         Label::BatterySoCPercent // already published by base class
     };
 
-    // regularly publish all topics regardless of whether or not their value changed
-    bool neverFullyPublished = _lastFullMqttPublish == 0;
-    bool intervalElapsed = _lastFullMqttPublish + getMqttFullPublishIntervalMs() < millis();
-    bool fullPublish = neverFullyPublished || intervalElapsed;
+    _dataPoints.forEach([this](Label label, auto const& dataPoint) {
+        auto skipMatch = std::find(mqttSkip.begin(), mqttSkip.end(), label);
+        if (skipMatch != mqttSkip.end()) { return; }
 
-    for (auto iter = _dataPoints.cbegin(); iter != _dataPoints.cend(); ++iter) {
-        // skip data points that did not change since last published
-        if (!fullPublish && iter->second.getTimestamp() < _lastMqttPublish) { continue; }
+        String topic("battery/");
+        topic += DataPointContainer::getLabelText(label);
+        mqttPublishValue(topic, dataPoint.getValueText().c_str(), dataPoint.getValueNumber());
+    });
 
-        auto skipMatch = std::find(mqttSkip.begin(), mqttSkip.end(), iter->first);
-        if (skipMatch != mqttSkip.end()) { continue; }
-
-        String topic((std::string("battery/") + iter->second.getLabelText()).c_str());
-        MqttSettings.publish(topic, iter->second.getValueText().c_str());
-    }
-
-    auto oCellVoltages = _dataPoints.get<Label::CellsMilliVolt>();
-    if (oCellVoltages.has_value() && (fullPublish || _cellVoltageTimestamp > _lastMqttPublish)) {
-        unsigned idx = 1;
-        for (auto iter = oCellVoltages->cbegin(); iter != oCellVoltages->cend(); ++iter) {
-            String topic("battery/Cell");
-            topic += String(idx);
-            topic += "MilliVolt";
-
-            MqttSettings.publish(topic, String(iter->second));
-
-            ++idx;
-        }
+    if (_cellVoltageTimestamp > 0) {
+        mqttPublishCellVoltages(_cellVoltages);
 
-        MqttSettings.publish("battery/CellMinMilliVolt", String(_cellMinMilliVolt));
-        MqttSettings.publish("battery/CellAvgMilliVolt", String(_cellAvgMilliVolt));
-        MqttSettings.publish("battery/CellMaxMilliVolt", String(_cellMaxMilliVolt));
-        MqttSettings.publish("battery/CellDiffMilliVolt", String(_cellMaxMilliVolt - _cellMinMilliVolt));
+        float cellDeadband = Configuration.get().Battery.MqttCellDeadbandMilliVolt;
+        mqttPublishValue("battery/CellMinMilliVolt", _cellVoltages.getMinMilliVolt(), cellDeadband);
+        mqttPublishValue("battery/CellAvgMilliVolt", _cellVoltages.getAvgMilliVolt(), cellDeadband);
+        mqttPublishValue("battery/CellMaxMilliVolt", _cellVoltages.getMaxMilliVolt(), cellDeadband);
+        mqttPublishValue("battery/CellDiffMilliVolt", _cellVoltages.getDiffMilliVolt(), cellDeadband);
+        mqttPublishValue("battery/CellMinVoltageCell", _cellVoltages.getMinCell());
+        mqttPublishValue("battery/CellMaxVoltageCell", _cellVoltages.getMaxCell());
     }
 
     auto oAlarms = _dataPoints.get<Label::AlarmsBitmask>();
@@ -133,12 +121,9 @@ void Stats::mqttPublish() const
         for (auto iter = JbdBms::AlarmBitTexts.begin(); iter != JbdBms::AlarmBitTexts.end(); ++iter) {
             auto bit = iter->first;
             String value = (*oAlarms & static_cast<uint16_t>(bit))?"1":"0";
-            MqttSettings.publish(String("battery/alarms/") + iter->second.data(), value);
+            mqttPublishValue(String("battery/alarms/") + iter->second.data(), value);
         }
     }
-
-    _lastMqttPublish = millis();
-    if (fullPublish) { _lastFullMqttPublish = _lastMqttPublish; }
 }
 
 void Stats::updateFrom(JbdBms::DataPointContainer const& dp)
@@ -170,17 +155,10 @@ void Stats::updateFrom(JbdBms::DataPointContainer const& dp)
 
     _dataPoints.updateFrom(dp);
 
+    // the statistics were computed while parsing the cell voltages
     auto oCellVoltages = _dataPoints.get<Label::CellsMilliVolt>();
     if (oCellVoltages.has_value()) {
-        for (auto iter = oCellVoltages->cbegin(); iter != oCellVoltages->cend(); ++iter) {
-            if (iter == oCellVoltages->cbegin()) {
-                _cellMinMilliVolt = _cellAvgMilliVolt = _cellMaxMilliVolt = iter->second;
-                continue;
-            }
-            _cellMinMilliVolt = std::min(_cellMinMilliVolt, iter->second);
-            _cellAvgMilliVolt = (_cellAvgMilliVolt + iter->second) / 2;
-            _cellMaxMilliVolt = std::max(_cellMaxMilliVolt, iter->second);
-        }
+        _cellVoltages = *oCellVoltages;
         _cellVoltageTimestamp = millis();
     }
 
@@ -1,11 +1,12 @@
 #include <Arduino.h>
 #include <Configuration.h>
 #include <HardwareSerial.h>
-#include <PinMapping.h>
+#include <InputCapture.h>
 #include <MessageOutput.h>
 #include <battery/jkbms/DataPoints.h>
 #include <battery/jkbms/Provider.h>
 #include <SerialPortManager.h>
+#include <TaskPlacement.h>
 #include <frozen/map.h>
 
 namespace Batteries::JkBms {
@@ -17,52 +18,63 @@ Provider::Provider()
 bool Provider::init(bool verboseLogging)
 {
     _verboseLogging = verboseLogging;
+    updatePollInterval(Configuration.get().Battery.JkBmsPollingInterval, _verboseLogging);
 
     std::string ifcType = "transceiver";
     if (Interface::Transceiver != getInterface()) { ifcType = "TTL-UART"; }
     MessageOutput.printf("[JK BMS] Initialize %s interface...\r\n", ifcType.c_str());
 
-    const PinMapping_t& pin = PinMapping.get();
+    auto const pin = getPins();
     MessageOutput.printf("[JK BMS] rx = %d, rxen = %d, tx = %d, txen = %d\r\n",
-            pin.battery_rx, pin.battery_rxen, pin.battery_tx, pin.battery_txen);
+            pin.Rx, pin.RxEnable, pin.Tx, pin.TxEnable);
 
-    if (pin.battery_rx < 0 || pin.battery_tx < 0) {
+    if (pin.Rx < 0 || pin.Tx < 0) {
         MessageOutput.println("[JK BMS] Invalid RX/TX pin config");
         return false;
     }
 
 #ifdef JKBMS_DUMMY_SERIAL
     _upSerial = std::make_unique<DummySerial>();
+    _upSerial->begin(115200, SERIAL_8N1, pin.Rx, pin.Tx);
 #else
-    auto oHwSerialPort = SerialPortManager.allocatePort(_serialPortOwner);
-    if (!oHwSerialPort) { return false; }
-
-    _upSerial = std::make_unique<HardwareSerial>(*oHwSerialPort);
+    if (!SerialPortManager.allocateSharedPort(_serialPortOwner,
+                { 115200, SERIAL_8N1, pin.Rx, pin.Tx })) {
+        return false;
+    }
 #endif
 
-    _upSerial->end(); // make sure the UART will be re-initialized
-    _upSerial->begin(115200, SERIAL_8N1, pin.battery_rx, pin.battery_tx);
-    _upSerial->flush();
-
-    if (Interface::Transceiver != getInterface()) { return true; }
+    if (Interface::Transceiver == getInterface()) {
+        _rxEnablePin = pin.RxEnable;
+        _txEnablePin = pin.TxEnable;
 
-    _rxEnablePin = pin.battery_rxen;
-    _txEnablePin = pin.battery_txen;
+        if (_rxEnablePin < 0 || _txEnablePin < 0) {
+            MessageOutput.println("[JK BMS] Invalid transceiver pin config");
+            return false;
+        }
 
-    if (_rxEnablePin < 0 || _txEnablePin < 0) {
-        MessageOutput.println("[JK BMS] Invalid transceiver pin config");
-        return false;
+        pinMode(_rxEnablePin, OUTPUT);
+        pinMode(_txEnablePin, OUTPUT);
     }
 
-    pinMode(_rxEnablePin, OUTPUT);
-    pinMode(_txEnablePin, OUTPUT);
+    // the period only matters to send requests and detect timeouts, as
+    // the UART buffers a whole response.
+    uint32_t constexpr stackSize = 3072;
+    if (!startSerialTask("JK BMS", TaskPlacement::Role::SerialBattery,
+                stackSize, 100/*period ms*/, nullptr)) {
+        MessageOutput.println("[JK BMS] Failed to create task, polling from main loop");
+    }
 
     return true;
 }
 
 void Provider::deinit()
 {
+    stopSerialTask();
+    closeWindow();
+
+#ifdef JKBMS_DUMMY_SERIAL
     _upSerial->end();
+#endif
 
     if (_rxEnablePin > 0) { pinMode(_rxEnablePin, INPUT); }
     if (_txEnablePin > 0) { pinMode(_txEnablePin, INPUT); }
@@ -82,10 +94,11 @@ frozen::string const& Provider::getStatusText(Provider::Status status)
 {
     static constexpr frozen::string missing = "programmer error: missing status text";
 
-    static constexpr frozen::map<Status, frozen::string, 6> texts = {
+    static constexpr frozen::map<Status, frozen::string, 7> texts = {
         { Status::Timeout, "timeout wating for response from BMS" },
         { Status::WaitingForPollInterval, "waiting for poll interval to elapse" },
         { Status::HwSerialNotAvailableForWrite, "UART is not available for writing" },
+        { Status::WaitingForWindow, "waiting for the shared UART to become available" },
         { Status::BusyReading, "busy waiting for or reading a message from the BMS" },
         { Status::RequestSent, "request for data sent" },
         { Status::FrameCompleted, "a whole frame was received" }
@@ -108,17 +121,22 @@ void Provider::announceStatus(Provider::Status status)
     _lastStatusPrinted = millis();
 }
 
-void Provider::sendRequest(uint8_t pollInterval)
+void Provider::sendRequest(uint32_t pollIntervalMillis)
 {
     if (ReadState::Idle != _readState) {
         return announceStatus(Status::BusyReading);
     }
 
-    if ((millis() - _lastRequest) < pollInterval * 1000) {
+    if ((millis() - _lastRequest) < pollIntervalMillis) {
         return announceStatus(Status::WaitingForPollInterval);
     }
 
-    if (!_upSerial->availableForWrite()) {
+    if (!openWindow()) {
+        return announceStatus(Status::WaitingForWindow);
+    }
+
+    if (!_pSerial->availableForWrite()) {
+        closeWindow();
         return announceStatus(Status::HwSerialNotAvailableForWrite);
     }
 
@@ -129,10 +147,10 @@ void Provider::sendRequest(uint8_t pollInterval)
         digitalWrite(_txEnablePin, HIGH); // enable transmission
     }
 
-    _upSerial->write(readAll.data(), readAll.size());
+    _pSerial->write(readAll.data(), readAll.size());
 
     if (Interface::Transceiver == getInterface()) {
-        _upSerial->flush();
+        _pSerial->flush();
         digitalWrite(_rxEnablePin, LOW); // enable reception
         digitalWrite(_txEnablePin, LOW); // disable transmission (free the bus)
     }
@@ -145,16 +163,44 @@ void Provider::sendRequest(uint8_t pollInterval)
 
 void Provider::loop()
 {
-    auto const& config = Configuration.get();
-    uint8_t pollInterval = config.Battery.JkBmsPollingInterval;
+    updatePollInterval(Configuration.get().Battery.JkBmsPollingInterval, _verboseLogging);
+
+    // no task could be created, so we talk to the BMS ourselves
+    if (!hasSerialTask()) { serialLoop(); }
+
+    {
+        std::lock_guard<std::mutex> lock(_handoffMutex);
+        if (!_dataPointsPending) { return; }
 
-    while (_upSerial->available()) {
-        rxData(_upSerial->read());
+        _handoffDataPoints.clear();
+        _handoffDataPoints.updateFrom(_pendingDataPoints);
+        _pendingDataPoints.clear();
+        _dataPointsPending = false;
+    }
+
+    processDataPoints(_handoffDataPoints);
+}
+
+void Provider::serialLoop()
+{
+    uint32_t pollIntervalMillis = getPollIntervalMillis();
+
+    // the reset() after a complete frame closes the window
+    while (_pSerial && _pSerial->available()) {
+        uint8_t inbyte = _pSerial->read();
+        // the live input is dropped while a recording is replayed
+        if (InputCapture.isReplaying(InputCapture::Source::JkBms)) { continue; }
+        InputCapture.record(InputCapture::Source::JkBms, 0, &inbyte, 1);
+        rxData(inbyte);
     }
 
-    sendRequest(pollInterval);
+    InputCapture.replay(InputCapture::Source::JkBms, 0, [this](uint8_t const* data, size_t length) {
+        for (size_t i = 0; i < length; ++i) { rxData(data[i]); }
+    });
 
-    if (millis() > _lastRequest + 2 * pollInterval * 1000 + 250) {
+    sendRequest(pollIntervalMillis);
+
+    if (millis() > _lastRequest + 2 * pollIntervalMillis + 250) {
         reset();
         return announceStatus(Status::Timeout);
     }
@@ -163,6 +209,7 @@ void Provider::loop()
 void Provider::rxData(uint8_t inbyte)
 {
     _buffer.push_back(inbyte);
+    SerialMessage::accumulateChecksum(_checksum, _buffer);
 
     switch(_readState) {
         case ReadState::Idle: // unsolicited message from BMS
@@ -197,9 +244,36 @@ void Provider::rxData(uint8_t inbyte)
     reset();
 }
 
+bool Provider::openWindow()
+{
+    if (_pSerial) { return true; }
+
+#ifdef JKBMS_DUMMY_SERIAL
+    _pSerial = _upSerial.get();
+#else
+    _pSerial = SerialPortManager.acquireWindow(_serialPortOwner);
+#endif
+
+    return _pSerial != nullptr;
+}
+
+void Provider::closeWindow()
+{
+    if (!_pSerial) { return; }
+
+#ifndef JKBMS_DUMMY_SERIAL
+    SerialPortManager.releaseWindow(_serialPortOwner);
+#endif
+
+    _pSerial = nullptr;
+}
+
 void Provider::reset()
 {
-    _buffer.clear();
+    closeWindow();
+
+    _buffer.clear(); // keeps the capacity for the next frame
+    _checksum = 0;
     return setReadState(ReadState::Idle);
 }
 
@@ -220,9 +294,20 @@ void Provider::frameComplete()
         MessageOutput.println();
     }
 
-    auto pResponse = std::make_unique<SerialResponse>(std::move(_buffer), _protocolVersion);
-    if (pResponse->isValid()) {
-        processDataPoints(pResponse->getDataPoints());
+    _frameDataPoints.clear();
+    SerialResponse response(ByteSpan(_buffer.data(), _buffer.size()),
+            _checksum, _frameDataPoints, _protocolVersion);
+    if (response.isValid()) {
+        auto const& dataPoints = response.getDataPoints();
+
+        // the parser of the next frame depends on the protocol version
+        using Label = JkBms::DataPointLabel;
+        auto oProtocolVersion = dataPoints.get<Label::ProtocolVersion>();
+        if (oProtocolVersion.has_value()) { _protocolVersion = *oProtocolVersion; }
+
+        std::lock_guard<std::mutex> lock(_handoffMutex);
+        _pendingDataPoints.updateFrom(dataPoints);
+        _dataPointsPending = true;
     } // if invalid, error message has been produced by SerialResponse c'tor
 
     reset();
@@ -232,22 +317,15 @@ void Provider::processDataPoints(DataPointContainer const& dataPoints)
 {
     _stats->updateFrom(dataPoints);
 
-    using Label = JkBms::DataPointLabel;
-
-    auto oProtocolVersion = dataPoints.get<Label::ProtocolVersion>();
-    if (oProtocolVersion.has_value()) { _protocolVersion = *oProtocolVersion; }
-
     if (!_verboseLogging) { return; }
 
-    auto iter = dataPoints.cbegin();
-    while ( iter != dataPoints.cend() ) {
+    dataPoints.forEach([](DataPointLabel label, auto const& dataPoint) {
         MessageOutput.printf("[%11.3f] JK BMS: %s: %s%s\r\n",
-            static_cast<double>(iter->second.getTimestamp())/1000,
-            iter->second.getLabelText().c_str(),
-            iter->second.getValueText().c_str(),
-            iter->second.getUnitText().c_str());
-        ++iter;
-    }
+            static_cast<double>(dataPoint.getTimestamp())/1000,
+            DataPointContainer::getLabelText(label),
+            dataPoint.getValueText().c_str(),
+            DataPointContainer::getUnitText(label));
+    });
 }
 
 } // namespace Batteries::JkBms
@@ -5,22 +5,29 @@
 namespace Batteries::JkBms {
 
 SerialCommand::SerialCommand(SerialCommand::Command cmd)
-    : SerialMessage(20, 0x00)
+    : SerialMessage(ByteSpan(), 0)
+    , _storage(20, 0x00)
 {
-    set(_raw.begin(), startMarker);
-    set(_raw.begin() + 2, static_cast<uint16_t>(_raw.size() - 2)); // frame length
-    set(_raw.begin() + 8, static_cast<uint8_t>(cmd));
-    set(_raw.begin() + 9, static_cast<uint8_t>(Source::Host));
-    set(_raw.begin() + 10, static_cast<uint8_t>(Type::Command));
-    set(_raw.end() - 5, endMarker);
-    updateChecksum();
+    _raw = ByteSpan(_storage.data(), _storage.size());
+
+    set(_storage.begin(), startMarker);
+    set(_storage.begin() + 2, static_cast<uint16_t>(_storage.size() - 2)); // frame length
+    set(_storage.begin() + 8, static_cast<uint8_t>(cmd));
+    set(_storage.begin() + 9, static_cast<uint8_t>(Source::Host));
+    set(_storage.begin() + 10, static_cast<uint8_t>(Type::Command));
+    set(_storage.end() - 5, endMarker);
+
+    _checksum = calcChecksum();
+    set(_storage.end() - 2, _checksum);
 }
 
 using Label = JkBms::DataPointLabel;
 template<Label L> using Traits = DataPointLabelTraits<L>;
 
-SerialResponse::SerialResponse(tData&& raw, uint8_t protocolVersion)
-    : SerialMessage(std::move(raw))
+SerialResponse::SerialResponse(ByteSpan raw, uint16_t checksum,
+        DataPointContainer& dp, uint8_t protocolVersion)
+    : SerialMessage(raw, checksum)
+    , _dp(dp)
 {
     if (!isValid()) { return; }
 
@@ -39,11 +46,10 @@ SerialResponse::SerialResponse(tData&& raw, uint8_t protocolVersion)
             case 0x79:
             {
                 uint8_t cellAmount = *(pos++) / 3;
-                std::map<uint8_t, uint16_t> voltages;
+                tCellVoltages voltages;
                 for (size_t cellCounter = 0; cellCounter < cellAmount; ++cellCounter) {
-                    uint8_t idx = *(pos++);
-                    auto cellMilliVolt = get<uint16_t>(pos);
-                    voltages[idx] = cellMilliVolt;
+                    ++pos; // cell number, the cells are reported in order
+                    voltages.add(get<uint16_t>(pos));
                 }
                 _dp.add<Label::CellsMilliVolt>(voltages);
                 break;
@@ -287,7 +293,7 @@ std::string SerialMessage::getString(It&& pos, size_t len, bool replaceZeroes) c
     return std::string(start, pos);
 }
 
-void SerialMessage::processBatteryCurrent(SerialMessage::tData::const_iterator& pos, uint8_t protocolVersion)
+void SerialResponse::processBatteryCurrent(ByteSpan::const_iterator& pos, uint8_t protocolVersion)
 {
     uint16_t raw = get<uint16_t>(pos);
 
@@ -306,24 +312,33 @@ void SerialMessage::processBatteryCurrent(SerialMessage::tData::const_iterator&
 }
 
 template<typename T>
-void SerialMessage::set(tData::iterator const& pos, T val)
+void SerialCommand::set(tData::iterator const& pos, T val)
 {
     // avoid out-of-bound write
-    if (std::distance(pos, _raw.end()) < sizeof(T)) { return; }
+    if (std::distance(pos, _storage.end()) < sizeof(T)) { return; }
 
     for (unsigned i = 0; i < sizeof(T); ++i) {
         *(pos+i) = static_cast<uint8_t>(val >> (sizeof(T)-1-i)*8);
     }
 }
 
-uint16_t SerialMessage::calcChecksum() const
+uint16_t SerialCommand::calcChecksum() const
 {
-    return std::accumulate(_raw.cbegin(), _raw.cend()-4, 0);
+    return std::accumulate(_storage.cbegin(), _storage.cend()-4, 0);
 }
 
-void SerialMessage::updateChecksum()
+void SerialMessage::accumulateChecksum(uint16_t& checksum, tData const& frame)
 {
-    set(_raw.end()-2, calcChecksum());
+    // the checksum covers all bytes except for the four trailing bytes,
+    // which hold the checksum. the frame length field (which does not count
+    // the start marker) is complete once the first four bytes are received.
+    size_t idx = frame.size() - 1;
+    if (idx >= 4) {
+        size_t frameSize = (static_cast<size_t>(frame[2]) << 8 | frame[3]) + 2;
+        if (idx + 4 >= frameSize) { return; }
+    }
+
+    checksum += frame[idx];
 }
 
 bool SerialMessage::isValid() const {
@@ -349,7 +364,7 @@ bool SerialMessage::isValid() const {
     }
 
     uint16_t const actualChecksum = get<uint16_t>(_raw.cend()-2);
-    uint16_t const expectedChecksum = calcChecksum();
+    uint16_t const expectedChecksum = _checksum;
     if (actualChecksum != expectedChecksum) {
         MessageOutput.printf("JkBms::SerialMessage: invalid checksum 0x%04x, expected 0x%04x\r\n",
             actualChecksum, expectedChecksum);
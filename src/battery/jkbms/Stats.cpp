@@ -2,7 +2,7 @@
 #include <algorithm>
 #include <string>
 #include <vector>
-#include <MqttSettings.h>
+#include <Configuration.h>
 #include <battery/jkbms/Stats.h>
 #include <battery/jkbms/DataPoints.h>
 
@@ -51,10 +51,12 @@ void Stats::getJsonData(JsonVariant& root, bool verbose) const
     }
 
     if (_cellVoltageTimestamp > 0) {
-        addLiveViewInSection(root, "cells", "cellMinVoltage", static_cast<float>(_cellMinMilliVolt)/1000, "V", 3);
-        addLiveViewInSection(root, "cells", "cellAvgVoltage", static_cast<float>(_cellAvgMilliVolt)/1000, "V", 3);
-        addLiveViewInSection(root, "cells", "cellMaxVoltage", static_cast<float>(_cellMaxMilliVolt)/1000, "V", 3);
-        addLiveViewInSection(root, "cells", "cellDiffVoltage", (_cellMaxMilliVolt - _cellMinMilliVolt), "mV", 0);
+        addLiveViewInSection(root, "cells", "cellMinVoltage", static_cast<float>(_cellVoltages.getMinMilliVolt())/1000, "V", 3);
+        addLiveViewInSection(root, "cells", "cellMinVoltageCell", _cellVoltages.getMinCell(), "", 0);
+        addLiveViewInSection(root, "cells", "cellAvgVoltage", static_cast<float>(_cellVoltages.getAvgMilliVolt())/1000, "V", 3);
+        addLiveViewInSection(root, "cells", "cellMaxVoltage", static_cast<float>(_cellVoltages.getMaxMilliVolt())/1000, "V", 3);
+        addLiveViewInSection(root, "cells", "cellMaxVoltageCell", _cellVoltages.getMaxCell(), "", 0);
+        addLiveViewInSection(root, "cells", "cellDiffVoltage", _cellVoltages.getDiffMilliVolt(), "mV", 0);
     }
 
     if (oStatus.has_value()) {
@@ -103,39 +105,25 @@ void Stats::mqttPublish() const
         // "old" topic.
     };
 
-    // regularly publish all topics regardless of whether or not their value changed
-    bool neverFullyPublished = _lastFullMqttPublish == 0;
-    bool intervalElapsed = _lastFullMqttPublish + getMqttFullPublishIntervalMs() < millis();
-    bool fullPublish = neverFullyPublished || intervalElapsed;
+    _dataPoints.forEach([this](Label label, auto const& dataPoint) {
+        auto skipMatch = std::find(mqttSkip.begin(), mqttSkip.end(), label);
+        if (skipMatch != mqttSkip.end()) { return; }
 
-    for (auto iter = _dataPoints.cbegin(); iter != _dataPoints.cend(); ++iter) {
-        // skip data points that did not change since last published
-        if (!fullPublish && iter->second.getTimestamp() < _lastMqttPublish) { continue; }
+        String topic("battery/");
+        topic += DataPointContainer::getLabelText(label);
+        mqttPublishValue(topic, dataPoint.getValueText().c_str(), dataPoint.getValueNumber());
+    });
 
-        auto skipMatch = std::find(mqttSkip.begin(), mqttSkip.end(), iter->first);
-        if (skipMatch != mqttSkip.end()) { continue; }
-
-        String topic((std::string("battery/") + iter->second.getLabelText()).c_str());
-        MqttSettings.publish(topic, iter->second.getValueText().c_str());
-    }
-
-    auto oCellVoltages = _dataPoints.get<Label::CellsMilliVolt>();
-    if (oCellVoltages.has_value() && (fullPublish || _cellVoltageTimestamp > _lastMqttPublish)) {
-        unsigned idx = 1;
-        for (auto iter = oCellVoltages->cbegin(); iter != oCellVoltages->cend(); ++iter) {
-            String topic("battery/Cell");
-            topic += String(idx);
-            topic += "MilliVolt";
-
-            MqttSettings.publish(topic, String(iter->second));
-
-            ++idx;
-        }
+    if (_cellVoltageTimestamp > 0) {
+        mqttPublishCellVoltages(_cellVoltages);
 
-        MqttSettings.publish("battery/CellMinMilliVolt", String(_cellMinMilliVolt));
-        MqttSettings.publish("battery/CellAvgMilliVolt", String(_cellAvgMilliVolt));
-        MqttSettings.publish("battery/CellMaxMilliVolt", String(_cellMaxMilliVolt));
-        MqttSettings.publish("battery/CellDiffMilliVolt", String(_cellMaxMilliVolt - _cellMinMilliVolt));
+        float cellDeadband = Configuration.get().Battery.MqttCellDeadbandMilliVolt;
+        mqttPublishValue("battery/CellMinMilliVolt", _cellVoltages.getMinMilliVolt(), cellDeadband);
+        mqttPublishValue("battery/CellAvgMilliVolt", _cellVoltages.getAvgMilliVolt(), cellDeadband);
+        mqttPublishValue("battery/CellMaxMilliVolt", _cellVoltages.getMaxMilliVolt(), cellDeadband);
+        mqttPublishValue("battery/CellDiffMilliVolt", _cellVoltages.getDiffMilliVolt(), cellDeadband);
+        mqttPublishValue("battery/CellMinVoltageCell", _cellVoltages.getMinCell());
+        mqttPublishValue("battery/CellMaxVoltageCell", _cellVoltages.getMaxCell());
     }
 
     auto oAlarms = _dataPoints.get<Label::AlarmsBitmask>();
@@ -143,7 +131,7 @@ void Stats::mqttPublish() const
         for (auto iter = JkBms::AlarmBitTexts.begin(); iter != JkBms::AlarmBitTexts.end(); ++iter) {
             auto bit = iter->first;
             String value = (*oAlarms & static_cast<uint16_t>(bit))?"1":"0";
-            MqttSettings.publish(String("battery/alarms/") + iter->second.data(), value);
+            mqttPublishValue(String("battery/alarms/") + iter->second.data(), value);
         }
     }
 
@@ -152,12 +140,9 @@ void Stats::mqttPublish() const
         for (auto iter = JkBms::StatusBitTexts.begin(); iter != JkBms::StatusBitTexts.end(); ++iter) {
             auto bit = iter->first;
             String value = (*oStatus & static_cast<uint16_t>(bit))?"1":"0";
-            MqttSettings.publish(String("battery/status/") + iter->second.data(), value);
+            mqttPublishValue(String("battery/status/") + iter->second.data(), value);
         }
     }
-
-    _lastMqttPublish = millis();
-    if (fullPublish) { _lastFullMqttPublish = _lastMqttPublish; }
 }
 
 std::optional<String> Stats::getHassDeviceName() const
@@ -167,6 +152,15 @@ std::optional<String> Stats::getHassDeviceName() const
     return String("JK BMS (") + *oManufacturer + ")";
 }
 
+std::optional<float> Stats::getCapacityAmpHours() const
+{
+    using Label = JkBms::DataPointLabel;
+
+    auto oCapacity = _dataPoints.get<Label::BatteryCapacitySettingAmpHours>();
+    if (!oCapacity.has_value() || *oCapacity == 0) { return std::nullopt; }
+    return static_cast<float>(*oCapacity);
+}
+
 void Stats::updateFrom(JkBms::DataPointContainer const& dp)
 {
     using Label = JkBms::DataPointLabel;
@@ -209,17 +203,10 @@ void Stats::updateFrom(JkBms::DataPointContainer const& dp)
 
     _dataPoints.updateFrom(dp);
 
+    // the statistics were computed while parsing the cell voltages
     auto oCellVoltages = _dataPoints.get<Label::CellsMilliVolt>();
     if (oCellVoltages.has_value()) {
-        for (auto iter = oCellVoltages->cbegin(); iter != oCellVoltages->cend(); ++iter) {
-            if (iter == oCellVoltages->cbegin()) {
-                _cellMinMilliVolt = _cellAvgMilliVolt = _cellMaxMilliVolt = iter->second;
-                continue;
-            }
-            _cellMinMilliVolt = std::min(_cellMinMilliVolt, iter->second);
-            _cellAvgMilliVolt = (_cellAvgMilliVolt + iter->second) / 2;
-            _cellMaxMilliVolt = std::max(_cellMaxMilliVolt, iter->second);
-        }
+        _cellVoltages = *oCellVoltages;
         _cellVoltageTimestamp = millis();
     }
 
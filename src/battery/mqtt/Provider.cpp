@@ -16,12 +16,13 @@ bool Provider::init(bool verboseLogging)
 
     _socTopic = config.Battery.MqttSocTopic;
     if (!_socTopic.isEmpty()) {
+        _socJsonPath = JsonPath(config.Battery.MqttSocJsonPath);
         MqttSettings.subscribe(_socTopic, 0/*QoS*/,
                 std::bind(&Provider::onMqttMessageSoC,
                     this, std::placeholders::_1, std::placeholders::_2,
                     std::placeholders::_3, std::placeholders::_4,
                     std::placeholders::_5, std::placeholders::_6,
-                    config.Battery.MqttSocJsonPath)
+                    &_socJsonPath)
                 );
 
         if (_verboseLogging) {
@@ -32,12 +33,13 @@ bool Provider::init(bool verboseLogging)
 
     _voltageTopic = config.Battery.MqttVoltageTopic;
     if (!_voltageTopic.isEmpty()) {
+        _voltageJsonPath = JsonPath(config.Battery.MqttVoltageJsonPath);
         MqttSettings.subscribe(_voltageTopic, 0/*QoS*/,
                 std::bind(&Provider::onMqttMessageVoltage,
                     this, std::placeholders::_1, std::placeholders::_2,
                     std::placeholders::_3, std::placeholders::_4,
                     std::placeholders::_5, std::placeholders::_6,
-                    config.Battery.MqttVoltageJsonPath)
+                    &_voltageJsonPath)
                 );
 
         if (_verboseLogging) {
@@ -50,12 +52,13 @@ bool Provider::init(bool verboseLogging)
         _dischargeCurrentLimitTopic = config.Battery.MqttDischargeCurrentTopic;
 
         if (!_dischargeCurrentLimitTopic.isEmpty()) {
+            _dischargeCurrentLimitJsonPath = JsonPath(config.Battery.MqttDischargeCurrentJsonPath);
             MqttSettings.subscribe(_dischargeCurrentLimitTopic, 0/*QoS*/,
                     std::bind(&Provider::onMqttMessageDischargeCurrentLimit,
                         this, std::placeholders::_1, std::placeholders::_2,
                         std::placeholders::_3, std::placeholders::_4,
                         std::placeholders::_5, std::placeholders::_6,
-                        config.Battery.MqttDischargeCurrentJsonPath)
+                        &_dischargeCurrentLimitJsonPath)
                     );
 
             if (_verboseLogging) {
@@ -85,11 +88,11 @@ void Provider::deinit()
 
 void Provider::onMqttMessageSoC(espMqttClientTypes::MessageProperties const& properties,
         char const* topic, uint8_t const* payload, size_t len, size_t index, size_t total,
-        char const* jsonPath)
+        JsonPath const* jsonPath)
 {
     auto soc = Utils::getNumericValueFromMqttPayload<float>("MqttBattery",
-            std::string(reinterpret_cast<const char*>(payload), len), topic,
-            jsonPath);
+            std::string_view(reinterpret_cast<const char*>(payload), len), topic,
+            *jsonPath);
 
     if (!soc.has_value()) { return; }
 
@@ -118,11 +121,11 @@ void Provider::onMqttMessageSoC(espMqttClientTypes::MessageProperties const& pro
 
 void Provider::onMqttMessageVoltage(espMqttClientTypes::MessageProperties const& properties,
         char const* topic, uint8_t const* payload, size_t len, size_t index, size_t total,
-        char const* jsonPath)
+        JsonPath const* jsonPath)
 {
     auto voltage = Utils::getNumericValueFromMqttPayload<float>("MqttBattery",
-            std::string(reinterpret_cast<const char*>(payload), len), topic,
-            jsonPath);
+            std::string_view(reinterpret_cast<const char*>(payload), len), topic,
+            *jsonPath);
 
 
     if (!voltage.has_value()) { return; }
@@ -162,11 +165,11 @@ void Provider::onMqttMessageVoltage(espMqttClientTypes::MessageProperties const&
 
 void Provider::onMqttMessageDischargeCurrentLimit(espMqttClientTypes::MessageProperties const& properties,
         char const* topic, uint8_t const* payload, size_t len, size_t index, size_t total,
-        char const* jsonPath)
+        JsonPath const* jsonPath)
 {
     auto amperage = Utils::getNumericValueFromMqttPayload<float>("MqttBattery",
-            std::string(reinterpret_cast<const char*>(payload), len), topic,
-            jsonPath);
+            std::string_view(reinterpret_cast<const char*>(payload), len), topic,
+            *jsonPath);
 
 
     if (!amperage.has_value()) { return; }
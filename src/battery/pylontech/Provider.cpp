@@ -16,133 +16,57 @@ bool Provider::init(bool verboseLogging)
     return ::Batteries::CanReceiver::init(verboseLogging, "Pylontech");
 }
 
-void Provider::onMessage(twai_message_t rx_message)
+CanFrame::FrameTable<Stats> const& Provider::getFrames()
 {
-    switch (rx_message.identifier) {
-        case 0x351: {
-            _stats->_chargeVoltage = this->scaleValue(this->readUnsignedInt16(rx_message.data), 0.1);
-            _stats->_chargeCurrentLimitation = this->scaleValue(this->readSignedInt16(rx_message.data + 2), 0.1);
-            _stats->setDischargeCurrentLimit(this->scaleValue(this->readSignedInt16(rx_message.data + 4), 0.1), millis());
-            _stats->_dischargeVoltageLimitation = this->scaleValue(this->readUnsignedInt16(rx_message.data + 6), 0.1);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pylontech] chargeVoltage: %f chargeCurrentLimitation: %f dischargeCurrentLimitation: %f dischargeVoltageLimitation: %f\r\n",
-                        _stats->_chargeVoltage, _stats->_chargeCurrentLimitation, _stats->getDischargeCurrentLimit(),
-                        _stats->_dischargeVoltageLimitation);
-            }
-            break;
-        }
-
-        case 0x355: {
-            _stats->setSoC(static_cast<uint8_t>(this->readUnsignedInt16(rx_message.data)), 0/*precision*/, millis());
-            _stats->_stateOfHealth = this->readUnsignedInt16(rx_message.data + 2);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pylontech] soc: %f soh: %d\r\n",
-                        _stats->getSoC(), _stats->_stateOfHealth);
-            }
-            break;
-        }
-
-        case 0x356: {
-            _stats->setVoltage(this->scaleValue(this->readSignedInt16(rx_message.data), 0.01), millis());
-            _stats->setCurrent(this->scaleValue(this->readSignedInt16(rx_message.data + 2), 0.1), 1/*precision*/, millis());
-            _stats->_temperature = this->scaleValue(this->readSignedInt16(rx_message.data + 4), 0.1);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pylontech] voltage: %f current: %f temperature: %f\r\n",
-                        _stats->getVoltage(), _stats->getChargeCurrent(), _stats->_temperature);
-            }
-            break;
-        }
-
-        case 0x359: {
-            uint16_t alarmBits = rx_message.data[0];
-            _stats->_alarmOverCurrentDischarge = this->getBit(alarmBits, 7);
-            _stats->_alarmUnderTemperature = this->getBit(alarmBits, 4);
-            _stats->_alarmOverTemperature = this->getBit(alarmBits, 3);
-            _stats->_alarmUnderVoltage = this->getBit(alarmBits, 2);
-            _stats->_alarmOverVoltage= this->getBit(alarmBits, 1);
-
-            alarmBits = rx_message.data[1];
-            _stats->_alarmBmsInternal= this->getBit(alarmBits, 3);
-            _stats->_alarmOverCurrentCharge = this->getBit(alarmBits, 0);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pylontech] Alarms: %d %d %d %d %d %d %d\r\n",
-                        _stats->_alarmOverCurrentDischarge,
-                        _stats->_alarmUnderTemperature,
-                        _stats->_alarmOverTemperature,
-                        _stats->_alarmUnderVoltage,
-                        _stats->_alarmOverVoltage,
-                        _stats->_alarmBmsInternal,
-                        _stats->_alarmOverCurrentCharge);
-            }
-
-            uint16_t warningBits = rx_message.data[2];
-            _stats->_warningHighCurrentDischarge = this->getBit(warningBits, 7);
-            _stats->_warningLowTemperature = this->getBit(warningBits, 4);
-            _stats->_warningHighTemperature = this->getBit(warningBits, 3);
-            _stats->_warningLowVoltage = this->getBit(warningBits, 2);
-            _stats->_warningHighVoltage = this->getBit(warningBits, 1);
-
-            warningBits = rx_message.data[3];
-            _stats->_warningBmsInternal= this->getBit(warningBits, 3);
-            _stats->_warningHighCurrentCharge = this->getBit(warningBits, 0);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pylontech] Warnings: %d %d %d %d %d %d %d\r\n",
-                        _stats->_warningHighCurrentDischarge,
-                        _stats->_warningLowTemperature,
-                        _stats->_warningHighTemperature,
-                        _stats->_warningLowVoltage,
-                        _stats->_warningHighVoltage,
-                        _stats->_warningBmsInternal,
-                        _stats->_warningHighCurrentCharge);
-            }
-
-            _stats->_moduleCount = rx_message.data[4];
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pylontech] Modules: %d\r\n",
-                        _stats->_moduleCount);
-            }
-
-            break;
-        }
-
-        case 0x35E: {
-            String manufacturer(reinterpret_cast<char*>(rx_message.data),
-                    rx_message.data_length_code);
-
-            if (manufacturer.isEmpty()) { break; }
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pylontech] Manufacturer: %s\r\n", manufacturer.c_str());
-            }
-
-            _stats->setManufacturer(manufacturer);
-            break;
-        }
-
-        case 0x35C: {
-            uint16_t chargeStatusBits = rx_message.data[0];
-            _stats->_chargeEnabled = this->getBit(chargeStatusBits, 7);
-            _stats->_dischargeEnabled = this->getBit(chargeStatusBits, 6);
-            _stats->_chargeImmediately = this->getBit(chargeStatusBits, 5);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pylontech] chargeStatusBits: %d %d %d\r\n",
-                    _stats->_chargeEnabled,
-                    _stats->_dischargeEnabled,
-                    _stats->_chargeImmediately);
-            }
-
-            break;
-        }
-
-        default:
-            return; // do not update last update timestamp
-            break;
+    using F = CanFrame::Field<Stats>;
+    using T = CanFrame::Type;
+
+    static constexpr F fields[] = {
+        F::value(0x351, T::U16, 0, 0.1, "chargeVoltage", [](Stats& s, float v) { s._chargeVoltage = v; }),
+        F::value(0x351, T::S16, 2, 0.1, "chargeCurrentLimitation", [](Stats& s, float v) { s._chargeCurrentLimitation = v; }),
+        F::value(0x351, T::S16, 4, 0.1, "dischargeCurrentLimitation", [](Stats& s, float v) { s.setDischargeCurrentLimit(v, millis()); }),
+        F::value(0x351, T::U16, 6, 0.1, "dischargeVoltageLimitation", [](Stats& s, float v) { s._dischargeVoltageLimitation = v; }),
+
+        F::value(0x355, T::U16, 0, 1, "soc", [](Stats& s, float v) { s.setSoC(static_cast<uint8_t>(v), 0/*precision*/, millis()); }),
+        F::value(0x355, T::U16, 2, 1, "soh", [](Stats& s, float v) { s._stateOfHealth = v; }),
+
+        F::value(0x356, T::S16, 0, 0.01, "voltage", [](Stats& s, float v) { s.setVoltage(v, millis()); }),
+        F::value(0x356, T::S16, 2, 0.1, "current", [](Stats& s, float v) { s.setCurrent(v, 1/*precision*/, millis()); }),
+        F::value(0x356, T::S16, 4, 0.1, "temperature", [](Stats& s, float v) { s._temperature = v; }),
+
+        F::bit(0x359, 0, 7, "alarmOverCurrentDischarge", [](Stats& s, float v) { s._alarmOverCurrentDischarge = v; }),
+        F::bit(0x359, 0, 4, "alarmUnderTemperature", [](Stats& s, float v) { s._alarmUnderTemperature = v; }),
+        F::bit(0x359, 0, 3, "alarmOverTemperature", [](Stats& s, float v) { s._alarmOverTemperature = v; }),
+        F::bit(0x359, 0, 2, "alarmUnderVoltage", [](Stats& s, float v) { s._alarmUnderVoltage = v; }),
+        F::bit(0x359, 0, 1, "alarmOverVoltage", [](Stats& s, float v) { s._alarmOverVoltage = v; }),
+        F::bit(0x359, 1, 3, "alarmBmsInternal", [](Stats& s, float v) { s._alarmBmsInternal = v; }),
+        F::bit(0x359, 1, 0, "alarmOverCurrentCharge", [](Stats& s, float v) { s._alarmOverCurrentCharge = v; }),
+        F::bit(0x359, 2, 7, "warningHighCurrentDischarge", [](Stats& s, float v) { s._warningHighCurrentDischarge = v; }),
+        F::bit(0x359, 2, 4, "warningLowTemperature", [](Stats& s, float v) { s._warningLowTemperature = v; }),
+        F::bit(0x359, 2, 3, "warningHighTemperature", [](Stats& s, float v) { s._warningHighTemperature = v; }),
+        F::bit(0x359, 2, 2, "warningLowVoltage", [](Stats& s, float v) { s._warningLowVoltage = v; }),
+        F::bit(0x359, 2, 1, "warningHighVoltage", [](Stats& s, float v) { s._warningHighVoltage = v; }),
+        F::bit(0x359, 3, 3, "warningBmsInternal", [](Stats& s, float v) { s._warningBmsInternal = v; }),
+        F::bit(0x359, 3, 0, "warningHighCurrentCharge", [](Stats& s, float v) { s._warningHighCurrentCharge = v; }),
+        F::value(0x359, T::U8, 4, 1, "moduleCount", [](Stats& s, float v) { s._moduleCount = v; }),
+
+        F::bit(0x35C, 0, 7, "chargeEnabled", [](Stats& s, float v) { s._chargeEnabled = v; }),
+        F::bit(0x35C, 0, 6, "dischargeEnabled", [](Stats& s, float v) { s._dischargeEnabled = v; }),
+        F::bit(0x35C, 0, 5, "chargeImmediately", [](Stats& s, float v) { s._chargeImmediately = v; }),
+
+        F::text(0x35E, "manufacturer", [](Stats& s, String const& t) { s.setManufacturer(t); }),
+    };
+
+    static constexpr CanFrame::FrameTable<Stats> frames(fields);
+    static_assert(frames.isSorted(), "fields must be sorted by frame identifier");
+
+    return frames;
+}
+
+void Provider::onMessage(twai_message_t const& rx_message)
+{
+    if (!getFrames().decode(rx_message, *_stats, "Pylontech", _verboseLogging)) {
+        return; // do not update last update timestamp
     }
 
     _stats->setLastUpdate(millis());
@@ -1,5 +1,4 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
-#include <MqttSettings.h>
 #include <battery/pylontech/Stats.h>
 
 namespace Batteries::Pylontech {
@@ -47,29 +46,29 @@ void Stats::mqttPublish() const
 {
     ::Batteries::Stats::mqttPublish();
 
-    MqttSettings.publish("battery/settings/chargeVoltage", String(_chargeVoltage));
-    MqttSettings.publish("battery/settings/chargeCurrentLimitation", String(_chargeCurrentLimitation));
-    MqttSettings.publish("battery/settings/dischargeVoltageLimitation", String(_dischargeVoltageLimitation));
-    MqttSettings.publish("battery/stateOfHealth", String(_stateOfHealth));
-    MqttSettings.publish("battery/temperature", String(_temperature));
-    MqttSettings.publish("battery/alarm/overCurrentDischarge", String(_alarmOverCurrentDischarge));
-    MqttSettings.publish("battery/alarm/overCurrentCharge", String(_alarmOverCurrentCharge));
-    MqttSettings.publish("battery/alarm/underTemperature", String(_alarmUnderTemperature));
-    MqttSettings.publish("battery/alarm/overTemperature", String(_alarmOverTemperature));
-    MqttSettings.publish("battery/alarm/underVoltage", String(_alarmUnderVoltage));
-    MqttSettings.publish("battery/alarm/overVoltage", String(_alarmOverVoltage));
-    MqttSettings.publish("battery/alarm/bmsInternal", String(_alarmBmsInternal));
-    MqttSettings.publish("battery/warning/highCurrentDischarge", String(_warningHighCurrentDischarge));
-    MqttSettings.publish("battery/warning/highCurrentCharge", String(_warningHighCurrentCharge));
-    MqttSettings.publish("battery/warning/lowTemperature", String(_warningLowTemperature));
-    MqttSettings.publish("battery/warning/highTemperature", String(_warningHighTemperature));
-    MqttSettings.publish("battery/warning/lowVoltage", String(_warningLowVoltage));
-    MqttSettings.publish("battery/warning/highVoltage", String(_warningHighVoltage));
-    MqttSettings.publish("battery/warning/bmsInternal", String(_warningBmsInternal));
-    MqttSettings.publish("battery/charging/chargeEnabled", String(_chargeEnabled));
-    MqttSettings.publish("battery/charging/dischargeEnabled", String(_dischargeEnabled));
-    MqttSettings.publish("battery/charging/chargeImmediately", String(_chargeImmediately));
-    MqttSettings.publish("battery/modulesTotal", String(_moduleCount));
+    mqttPublishValue("battery/settings/chargeVoltage", _chargeVoltage);
+    mqttPublishValue("battery/settings/chargeCurrentLimitation", _chargeCurrentLimitation);
+    mqttPublishValue("battery/settings/dischargeVoltageLimitation", _dischargeVoltageLimitation);
+    mqttPublishValue("battery/stateOfHealth", _stateOfHealth);
+    mqttPublishValue("battery/temperature", _temperature);
+    mqttPublishValue("battery/alarm/overCurrentDischarge", _alarmOverCurrentDischarge);
+    mqttPublishValue("battery/alarm/overCurrentCharge", _alarmOverCurrentCharge);
+    mqttPublishValue("battery/alarm/underTemperature", _alarmUnderTemperature);
+    mqttPublishValue("battery/alarm/overTemperature", _alarmOverTemperature);
+    mqttPublishValue("battery/alarm/underVoltage", _alarmUnderVoltage);
+    mqttPublishValue("battery/alarm/overVoltage", _alarmOverVoltage);
+    mqttPublishValue("battery/alarm/bmsInternal", _alarmBmsInternal);
+    mqttPublishValue("battery/warning/highCurrentDischarge", _warningHighCurrentDischarge);
+    mqttPublishValue("battery/warning/highCurrentCharge", _warningHighCurrentCharge);
+    mqttPublishValue("battery/warning/lowTemperature", _warningLowTemperature);
+    mqttPublishValue("battery/warning/highTemperature", _warningHighTemperature);
+    mqttPublishValue("battery/warning/lowVoltage", _warningLowVoltage);
+    mqttPublishValue("battery/warning/highVoltage", _warningHighVoltage);
+    mqttPublishValue("battery/warning/bmsInternal", _warningBmsInternal);
+    mqttPublishValue("battery/charging/chargeEnabled", _chargeEnabled);
+    mqttPublishValue("battery/charging/dischargeEnabled", _dischargeEnabled);
+    mqttPublishValue("battery/charging/chargeImmediately", _chargeImmediately);
+    mqttPublishValue("battery/modulesTotal", _moduleCount);
 }
 
 } // namespace Batteries::Pylontech
@@ -29,468 +29,254 @@ bool Provider::init(bool verboseLogging)
     return ::Batteries::CanReceiver::init(verboseLogging, "Pytes");
 }
 
-void Provider::onMessage(twai_message_t rx_message)
+CanFrame::FrameTable<Stats> const& Provider::getFrames()
 {
-    switch (rx_message.identifier) {
-        case 0x351:
-        case 0x400: {
-            _stats->_chargeVoltageLimit = this->scaleValue(this->readUnsignedInt16(rx_message.data), 0.1);
-            _stats->_chargeCurrentLimit = this->scaleValue(this->readUnsignedInt16(rx_message.data + 2), 0.1);
-            _stats->setDischargeCurrentLimit(this->scaleValue(this->readUnsignedInt16(rx_message.data + 4), 0.1), millis());
-            _stats->_dischargeVoltageLimit = this->scaleValue(this->readSignedInt16(rx_message.data + 6), 0.1);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] chargeVoltageLimit: %f chargeCurrentLimit: %f dischargeCurrentLimit: %f dischargeVoltageLimit: %f\r\n",
-                        _stats->_chargeVoltageLimit, _stats->_chargeCurrentLimit,
-                        _stats->getDischargeCurrentLimit(), _stats->_dischargeVoltageLimit);
+    using F = CanFrame::Field<Stats>;
+    using T = CanFrame::Type;
+
+    // some frames of the Victron protocol have a twin in the Pytes protocol
+#define LIMITS(id) \
+    F::value(id, T::U16, 0, 0.1, "chargeVoltageLimit", [](Stats& s, float v) { s._chargeVoltageLimit = v; }), \
+    F::value(id, T::U16, 2, 0.1, "chargeCurrentLimit", [](Stats& s, float v) { s._chargeCurrentLimit = v; }), \
+    F::value(id, T::U16, 4, 0.1, "dischargeCurrentLimit", [](Stats& s, float v) { s.setDischargeCurrentLimit(v, millis()); }), \
+    F::value(id, T::S16, 6, 0.1, "dischargeVoltageLimit", [](Stats& s, float v) { s._dischargeVoltageLimit = v; })
+
+#define MEASUREMENTS(id) \
+    F::value(id, T::S16, 0, 0.01, "voltage", [](Stats& s, float v) { s.setVoltage(v, millis()); }), \
+    F::value(id, T::S16, 2, 0.1, "current", [](Stats& s, float v) { s.setCurrent(v, 1/*precision*/, millis()); }), \
+    F::value(id, T::S16, 4, 0.1, "temperature", [](Stats& s, float v) { s._temperature = v; })
+
+#define MANUFACTURER(id) \
+    F::text(id, "manufacturer", [](Stats& s, String const& t) { s.setManufacturer(t); })
+
+#define ENERGY(id) \
+    F::value(id, T::U32, 0, 0.1, "chargedEnergy", [](Stats& s, float v) { s._chargedEnergy = v; }), \
+    F::value(id, T::U32, 4, 0.1, "dischargedEnergy", [](Stats& s, float v) { s._dischargedEnergy = v; })
+
+#define FLAG(id, offset, bit, field) \
+    F::bit(id, offset, bit, #field, [](Stats& s, float v) { s._##field = v; })
+
+    static constexpr F fields[] = {
+        LIMITS(0x351),
+
+        // Victron protocol: SOC/SOH
+        F::value(0x355, T::U16, 0, 1, "soc", [](Stats& s, float v) { s.setSoC(static_cast<uint8_t>(v), 0/*precision*/, millis()); }),
+        F::value(0x355, T::U16, 2, 1, "soh", [](Stats& s, float v) { s._stateOfHealth = v; }),
+
+        MEASUREMENTS(0x356),
+
+        // Victron protocol: Alarms and Warnings
+        FLAG(0x35A, 0, 2, alarmOverVoltage),
+        FLAG(0x35A, 0, 4, alarmUnderVoltage),
+        FLAG(0x35A, 0, 6, alarmOverTemperature),
+        FLAG(0x35A, 1, 0, alarmUnderTemperature),
+        FLAG(0x35A, 1, 2, alarmOverTemperatureCharge),
+        FLAG(0x35A, 1, 4, alarmUnderTemperatureCharge),
+        FLAG(0x35A, 1, 6, alarmOverCurrentDischarge),
+        FLAG(0x35A, 2, 0, alarmOverCurrentCharge),
+        FLAG(0x35A, 2, 6, alarmInternalFailure),
+        FLAG(0x35A, 3, 0, alarmCellImbalance),
+        FLAG(0x35A, 4, 2, warningHighVoltage),
+        FLAG(0x35A, 4, 4, warningLowVoltage),
+        FLAG(0x35A, 4, 6, warningHighTemperature),
+        FLAG(0x35A, 5, 0, warningLowTemperature),
+        FLAG(0x35A, 5, 2, warningHighTemperatureCharge),
+        FLAG(0x35A, 5, 4, warningLowTemperatureCharge),
+        FLAG(0x35A, 5, 6, warningHighDischargeCurrent),
+        FLAG(0x35A, 6, 0, warningHighChargeCurrent),
+        FLAG(0x35A, 6, 6, warningInternalFailure),
+        FLAG(0x35A, 7, 0, warningCellImbalance),
+
+        MANUFACTURER(0x35E),
+
+        // Victron protocol: BatteryInfo
+        F::frame(0x35F, [](Stats& s, twai_message_t const& frame, bool verboseLogging) {
+            auto fwVersionPart1 = String(readUnsignedInt8(frame.data + 2));
+            auto fwVersionPart2 = String(readUnsignedInt8(frame.data + 3));
+            s._fwversion = "v" + fwVersionPart1 + "." + fwVersionPart2;
+
+            if (verboseLogging) {
+                MessageOutput.printf("[Pytes] fwversion: %s\r\n", s._fwversion.c_str());
             }
-            break;
-        }
-
-        case 0x355: {  // Victron protocol: SOC/SOH
-            _stats->setSoC(static_cast<uint8_t>(this->readUnsignedInt16(rx_message.data)), 0/*precision*/, millis());
-            _stats->_stateOfHealth = this->readUnsignedInt16(rx_message.data + 2);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] soc: %f soh: %d\r\n",
-                        _stats->getSoC(), _stats->_stateOfHealth);
-            }
-            break;
-        }
-
-        case 0x356:
-        case 0x405: {
-            _stats->setVoltage(this->scaleValue(this->readSignedInt16(rx_message.data), 0.01), millis());
-            _stats->setCurrent(this->scaleValue(this->readSignedInt16(rx_message.data + 2), 0.1), 1/*precision*/, millis());
-            _stats->_temperature = this->scaleValue(this->readSignedInt16(rx_message.data + 4), 0.1);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] voltage: %f current: %f temperature: %f\r\n",
-                        _stats->getVoltage(), _stats->getChargeCurrent(), _stats->_temperature);
-            }
-            break;
-        }
-
-        case 0x35A: { // Victron protocol: Alarms and Warnings
-            uint16_t alarmBits = rx_message.data[0];
-            _stats->_alarmOverVoltage = this->getBit(alarmBits, 2);
-            _stats->_alarmUnderVoltage = this->getBit(alarmBits, 4);
-            _stats->_alarmOverTemperature = this->getBit(alarmBits, 6);
-
-            alarmBits = rx_message.data[1];
-            _stats->_alarmUnderTemperature = this->getBit(alarmBits, 0);
-            _stats->_alarmOverTemperatureCharge = this->getBit(alarmBits, 2);
-            _stats->_alarmUnderTemperatureCharge = this->getBit(alarmBits, 4);
-            _stats->_alarmOverCurrentDischarge = this->getBit(alarmBits, 6);
-
-            alarmBits = rx_message.data[2];
-            _stats->_alarmOverCurrentCharge = this->getBit(alarmBits, 0);
-            _stats->_alarmInternalFailure = this->getBit(alarmBits, 6);
-
-            alarmBits = rx_message.data[3];
-            _stats->_alarmCellImbalance = this->getBit(alarmBits, 0);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] Alarms: %d %d %d %d %d %d %d %d %d %d\r\n",
-                        _stats->_alarmOverVoltage,
-                        _stats->_alarmUnderVoltage,
-                        _stats->_alarmOverTemperature,
-                        _stats->_alarmUnderTemperature,
-                        _stats->_alarmOverTemperatureCharge,
-                        _stats->_alarmUnderTemperatureCharge,
-                        _stats->_alarmOverCurrentDischarge,
-                        _stats->_alarmOverCurrentCharge,
-                        _stats->_alarmInternalFailure,
-                        _stats->_alarmCellImbalance);
-            }
-
-            uint16_t warningBits = rx_message.data[4];
-            _stats->_warningHighVoltage = this->getBit(warningBits, 2);
-            _stats->_warningLowVoltage = this->getBit(warningBits, 4);
-            _stats->_warningHighTemperature = this->getBit(warningBits, 6);
-
-            warningBits = rx_message.data[5];
-            _stats->_warningLowTemperature = this->getBit(warningBits, 0);
-            _stats->_warningHighTemperatureCharge = this->getBit(warningBits, 2);
-            _stats->_warningLowTemperatureCharge = this->getBit(warningBits, 4);
-            _stats->_warningHighDischargeCurrent = this->getBit(warningBits, 6);
-
-            warningBits = rx_message.data[6];
-            _stats->_warningHighChargeCurrent = this->getBit(warningBits, 0);
-            _stats->_warningInternalFailure = this->getBit(warningBits, 6);
-
-            warningBits = rx_message.data[7];
-            _stats->_warningCellImbalance = this->getBit(warningBits, 0);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] Warnings: %d %d %d %d %d %d %d %d %d %d\r\n",
-                        _stats->_warningHighVoltage,
-                        _stats->_warningLowVoltage,
-                        _stats->_warningHighTemperature,
-                        _stats->_warningLowTemperature,
-                        _stats->_warningHighTemperatureCharge,
-                        _stats->_warningLowTemperatureCharge,
-                        _stats->_warningHighDischargeCurrent,
-                        _stats->_warningHighChargeCurrent,
-                        _stats->_warningInternalFailure,
-                        _stats->_warningCellImbalance);
-            }
-            break;
-        }
-
-        case 0x35E:
-        case 0x40A: {
-            String manufacturer(reinterpret_cast<char*>(rx_message.data),
-                    rx_message.data_length_code);
-
-            if (manufacturer.isEmpty()) { break; }
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] Manufacturer: %s\r\n", manufacturer.c_str());
-            }
-
-            _stats->setManufacturer(manufacturer);
-            break;
-        }
-
-        case 0x35F: { // Victron protocol: BatteryInfo
-            auto fwVersionPart1 = String(this->readUnsignedInt8(rx_message.data + 2));
-            auto fwVersionPart2 = String(this->readUnsignedInt8(rx_message.data + 3));
-            _stats->_fwversion = "v" + fwVersionPart1 + "." + fwVersionPart2;
-
-            _stats->_availableCapacity = this->readUnsignedInt16(rx_message.data + 4);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] fwversion: %s availableCapacity: %f Ah\r\n",
-                        _stats->_fwversion.c_str(), _stats->_availableCapacity);
-            }
-            break;
-        }
-
-        case 0x360: { // Victron protocol: Charging request
-            _stats->_chargeImmediately = rx_message.data[0]; // 0xff requests charging.
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] chargeImmediately: %d\r\n",
-                        _stats->_chargeImmediately);
-            }
-            break;
-        }
-
-        case 0x372: { // Victron protocol: BankInfo
-            _stats->_moduleCountOnline = this->readUnsignedInt16(rx_message.data);
-            _stats->_moduleCountBlockingCharge = this->readUnsignedInt16(rx_message.data + 2);
-            _stats->_moduleCountBlockingDischarge = this->readUnsignedInt16(rx_message.data + 4);
-            _stats->_moduleCountOffline = this->readUnsignedInt16(rx_message.data + 6);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] moduleCountOnline: %d moduleCountBlockingCharge: %d moduleCountBlockingDischarge: %d moduleCountOffline: %d\r\n",
-                        _stats->_moduleCountOnline, _stats->_moduleCountBlockingCharge,
-                        _stats->_moduleCountBlockingDischarge, _stats->_moduleCountOffline);
+        }),
+        F::value(0x35F, T::U16, 4, 1, "availableCapacity", [](Stats& s, float v) { s._availableCapacity = v; }),
+
+        // Victron protocol: Charging request, 0xff requests charging
+        F::value(0x360, T::U8, 0, 1, "chargeImmediately", [](Stats& s, float v) { s._chargeImmediately = v; }),
+
+        // Victron protocol: BankInfo
+        F::value(0x372, T::U16, 0, 1, "moduleCountOnline", [](Stats& s, float v) { s._moduleCountOnline = v; }),
+        F::value(0x372, T::U16, 2, 1, "moduleCountBlockingCharge", [](Stats& s, float v) { s._moduleCountBlockingCharge = v; }),
+        F::value(0x372, T::U16, 4, 1, "moduleCountBlockingDischarge", [](Stats& s, float v) { s._moduleCountBlockingDischarge = v; }),
+        F::value(0x372, T::U16, 6, 1, "moduleCountOffline", [](Stats& s, float v) { s._moduleCountOffline = v; }),
+
+        // Victron protocol: CellInfo
+        F::value(0x373, T::U16, 0, 1, "lowestCellMilliVolt", [](Stats& s, float v) { s._cellMinMilliVolt = v; }),
+        F::value(0x373, T::U16, 2, 1, "highestCellMilliVolt", [](Stats& s, float v) { s._cellMaxMilliVolt = v; }),
+        F::value(0x373, T::U16, 4, 1, "minimumCellTemperature", [](Stats& s, float v) { s._cellMinTemperature = v; }, -273),
+        F::value(0x373, T::U16, 6, 1, "maximumCellTemperature", [](Stats& s, float v) { s._cellMaxTemperature = v; }, -273),
+
+        // Victron protocol: Battery/Cell names (strings)
+        F::text(0x374, "cellMinVoltageName", [](Stats& s, String const& t) { s._cellMinVoltageName = t; }),
+        F::text(0x375, "cellMaxVoltageName", [](Stats& s, String const& t) { s._cellMaxVoltageName = t; }),
+        F::text(0x376, "cellMinTemperatureName", [](Stats& s, String const& t) { s._cellMinTemperatureName = t; }),
+        F::text(0x377, "cellMaxTemperatureName", [](Stats& s, String const& t) { s._cellMaxTemperatureName = t; }),
+
+        // History: Charged / Discharged Energy
+        ENERGY(0x378),
+
+        // BatterySize: Installed Ah
+        F::value(0x379, T::U16, 0, 1, "totalCapacity", [](Stats& s, float v) { s._totalCapacity = v; }),
+
+        // Serialnumber
+        F::text(0x380, "snPart1", [](Stats& s, String const& t) { s._serialPart1 = t; s.updateSerial(); }),
+        F::text(0x381, "snPart2", [](Stats& s, String const& t) { s._serialPart2 = t; s.updateSerial(); }),
+
+        LIMITS(0x400),
+
+        // Pytes protocol: Highest/Lowest Cell Voltage
+        F::value(0x401, T::U16, 0, 1, "highestCellMilliVolt", [](Stats& s, float v) { s._cellMaxMilliVolt = v; }),
+        F::value(0x401, T::U16, 2, 1, "lowestCellMilliVolt", [](Stats& s, float v) { s._cellMinMilliVolt = v; }),
+        F::frame(0x401, [](Stats& s, twai_message_t const& frame, bool verboseLogging) {
+            pytesSetCellLabel(s._cellMaxVoltageName, readUnsignedInt8(frame.data + 4));
+            pytesSetCellLabel(s._cellMinVoltageName, readUnsignedInt8(frame.data + 6));
+
+            if (verboseLogging) {
+                MessageOutput.printf("[Pytes] cellMinVoltageName: %s cellMaxVoltageName: %s\r\n",
+                        s._cellMinVoltageName.c_str(), s._cellMaxVoltageName.c_str());
             }
-            break;
-        }
-
-        case 0x373: { // Victron protocol: CellInfo
-            _stats->_cellMinMilliVolt = this->readUnsignedInt16(rx_message.data);
-            _stats->_cellMaxMilliVolt = this->readUnsignedInt16(rx_message.data + 2);
-            _stats->_cellMinTemperature = this->readUnsignedInt16(rx_message.data + 4) - 273;
-            _stats->_cellMaxTemperature = this->readUnsignedInt16(rx_message.data + 6) - 273;
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] lowestCellMilliVolt: %d highestCellMilliVolt: %d minimumCellTemperature: %f maximumCellTemperature: %f\r\n",
-                        _stats->_cellMinMilliVolt, _stats->_cellMaxMilliVolt,
-                        _stats->_cellMinTemperature, _stats->_cellMaxTemperature);
+        }),
+
+        // Pytes protocol: Highest/Lowest Cell Temperature
+        F::value(0x402, T::U16, 0, 0.1, "maximumCellTemperature", [](Stats& s, float v) { s._cellMaxTemperature = v; }),
+        F::value(0x402, T::U16, 2, 0.1, "minimumCellTemperature", [](Stats& s, float v) { s._cellMinTemperature = v; }),
+        F::frame(0x402, [](Stats& s, twai_message_t const& frame, bool verboseLogging) {
+            pytesSetCellLabel(s._cellMaxTemperatureName, readUnsignedInt16(frame.data + 4));
+            pytesSetCellLabel(s._cellMinTemperatureName, readUnsignedInt16(frame.data + 6));
+
+            if (verboseLogging) {
+                MessageOutput.printf("[Pytes] cellMinTemperatureName: %s cellMaxTemperatureName: %s\r\n",
+                        s._cellMinTemperatureName.c_str(), s._cellMaxTemperatureName.c_str());
             }
-            break;
-        }
-
-        case 0x374: { // Victron protocol: Battery/Cell name (string) with "Lowest Cell Voltage"
-            String cellMinVoltageName(reinterpret_cast<char*>(rx_message.data),
-                    rx_message.data_length_code);
-
-            if (cellMinVoltageName.isEmpty()) { break; }
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] cellMinVoltageName: %s\r\n",
-                        cellMinVoltageName.c_str());
-            }
-
-            _stats->_cellMinVoltageName = cellMinVoltageName;
-            break;
-        }
-
-        case 0x375: { // Victron protocol: Battery/Cell name (string) with "Highest Cell Voltage"
-            String cellMaxVoltageName(reinterpret_cast<char*>(rx_message.data),
-                    rx_message.data_length_code);
-
-            if (cellMaxVoltageName.isEmpty()) { break; }
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] cellMaxVoltageName: %s\r\n",
-                        cellMaxVoltageName.c_str());
-            }
-
-            _stats->_cellMaxVoltageName = cellMaxVoltageName;
-            break;
-        }
-
-        case 0x376: { // Victron Protocol: Battery/Cell name (string) with "Minimum Cell Temperature"
-            String cellMinTemperatureName(reinterpret_cast<char*>(rx_message.data),
-                    rx_message.data_length_code);
-
-            if (cellMinTemperatureName.isEmpty()) { break; }
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] cellMinTemperatureName: %s\r\n",
-                        cellMinTemperatureName.c_str());
-            }
-
-            _stats->_cellMinTemperatureName = cellMinTemperatureName;
-            break;
-        }
-
-        case 0x377: { // Victron Protocol: Battery/Cell name (string) with "Maximum Cell Temperature"
-            String cellMaxTemperatureName(reinterpret_cast<char*>(rx_message.data),
-                    rx_message.data_length_code);
+        }),
 
-            if (cellMaxTemperatureName.isEmpty()) { break; }
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] cellMaxTemperatureName: %s\r\n",
-                        cellMaxTemperatureName.c_str());
-            }
-
-            _stats->_cellMaxTemperatureName = cellMaxTemperatureName;
-            break;
-        }
-
-        case 0x378:
-        case 0x41e: { // History: Charged / Discharged Energy
-            _stats->_chargedEnergy = this->scaleValue(this->readUnsignedInt32(rx_message.data), 0.1);
-            _stats->_dischargedEnergy = this->scaleValue(this->readUnsignedInt32(rx_message.data + 4), 0.1);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] chargedEnergy: %f dischargedEnergy: %f\r\n",
-                        _stats->_chargedEnergy, _stats->_dischargedEnergy);
-            }
-            break;
-        }
-
-        case 0x379: { // BatterySize: Installed Ah
-            _stats->_totalCapacity = this->readUnsignedInt16(rx_message.data);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] totalCapacity: %f Ah\r\n",
-                        _stats->_totalCapacity);
-            }
-            break;
-        }
-
-        case 0x380: { // Serialnumber - part 1
-            String snPart1(reinterpret_cast<char*>(rx_message.data),
-                    rx_message.data_length_code);
-
-            if (snPart1.isEmpty() || !isgraph(snPart1.charAt(0))) { break; }
+        // Pytes protocol: Alarms and Warnings (part 1)
+        F::frame(0x403, [](Stats& s, twai_message_t const& frame, bool verboseLogging) {
+            uint32_t alarmBits1 = readUnsignedInt32(frame.data);
+            uint32_t alarmBits2 = readUnsignedInt32(frame.data + 4);
+            uint32_t mergedBits = alarmBits1 | alarmBits2;
 
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] snPart1: %s\r\n", snPart1.c_str());
+            bool overVoltage = getBit(mergedBits, 0);
+            bool highVoltage = getBit(mergedBits, 1);
+            bool lowVoltage = getBit(mergedBits, 3);
+            bool underVoltage = getBit(mergedBits, 4);
+            bool overTemp = getBit(mergedBits, 8);
+            bool highTemp = getBit(mergedBits, 9);
+            bool lowTemp = getBit(mergedBits, 11);
+            bool underTemp = getBit(mergedBits, 12);
+            bool overCurrentDischarge = getBit(mergedBits, 17) || getBit(mergedBits, 18);
+            bool overCurrentCharge = getBit(mergedBits, 19) || getBit(mergedBits, 20);
+            bool highCurrentDischarge = getBit(mergedBits, 21);
+            bool highCurrentCharge = getBit(mergedBits, 22);
+            bool stateCharging = getBit(mergedBits, 26);
+            bool stateDischarging = getBit(mergedBits, 27);
+
+            s._alarmOverVoltage = overVoltage;
+            s._alarmUnderVoltage = underVoltage;
+            s._alarmOverTemperature = stateDischarging && overTemp;
+            s._alarmUnderTemperature = stateDischarging && underTemp;
+            s._alarmOverTemperatureCharge = stateCharging && overTemp;
+            s._alarmUnderTemperatureCharge = stateCharging && underTemp;
+
+            s._alarmOverCurrentDischarge = overCurrentDischarge;
+            s._alarmOverCurrentCharge = overCurrentCharge;
+
+            s._warningHighVoltage = highVoltage;
+            s._warningLowVoltage = lowVoltage;
+            s._warningHighTemperature = stateDischarging && highTemp;
+            s._warningLowTemperature = stateDischarging && lowTemp;
+            s._warningHighTemperatureCharge = stateCharging && highTemp;
+            s._warningLowTemperatureCharge = stateCharging && lowTemp;
+
+            s._warningHighDischargeCurrent = highCurrentDischarge;
+            s._warningHighChargeCurrent = highCurrentCharge;
+
+            if (verboseLogging) {
+                MessageOutput.printf("[Pytes] Alarms and warnings (bits: %08x)\r\n", mergedBits);
             }
+        }),
 
-            _stats->_serialPart1 = snPart1;
-            _stats->updateSerial();
-            break;
-        }
+        // Pytes protocol: SOC/SOH. the soc (byte 0+1) isn't used here since
+        // it is generated with higher precision in message 0x0409 below.
+        F::value(0x404, T::U16, 2, 1, "soh", [](Stats& s, float v) { s._stateOfHealth = v; }),
+        F::value(0x404, T::U16, 6, 1, "cycles", [](Stats& s, float v) { s._chargeCycles = v; }),
 
-        case 0x381: {  // Serialnumber - part 2
-            String snPart2(reinterpret_cast<char*>(rx_message.data),
-                    rx_message.data_length_code);
+        MEASUREMENTS(0x405),
 
-            if (snPart2.isEmpty() || !isgraph(snPart2.charAt(0))) { break; }
+        // Pytes protocol: alarms (part 2)
+        F::bit(0x406, 1, 7, "internalFailure", [](Stats& s, float v) { s._alarmInternalFailure = v; }),
 
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] snPart2: %s\r\n", snPart2.c_str());
-            }
+        // Pytes protocol: charge status
+        F::frame(0x408, [](Stats& s, twai_message_t const& frame, bool verboseLogging) {
+            bool chargeEnabled = frame.data[0];
+            bool dischargeEnabled = frame.data[1];
+            s._chargeImmediately = frame.data[2];
+            // Note: Should use std::popcount once supported by the compiler.
+            s._moduleCountBlockingCharge = popCount(frame.data[5]);
+            s._moduleCountBlockingDischarge = popCount(frame.data[6]);
 
-            _stats->_serialPart2 = snPart2;
-            _stats->updateSerial();
-            break;
-        }
-
-        case 0x401: { // Pytes protocol: Highest/Lowest Cell Voltage
-            _stats->_cellMaxMilliVolt = this->readUnsignedInt16(rx_message.data);
-            _stats->_cellMinMilliVolt = this->readUnsignedInt16(rx_message.data + 2);
-            pytesSetCellLabel(_stats->_cellMaxVoltageName, this->readUnsignedInt8(rx_message.data + 4));
-            pytesSetCellLabel(_stats->_cellMinVoltageName, this->readUnsignedInt8(rx_message.data + 6));
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] lowestCellMilliVolt: %d highestCellMilliVolt: %d cellMinVoltageName: %s cellMaxVoltageName: %s\r\n",
-                        _stats->_cellMinMilliVolt, _stats->_cellMaxMilliVolt,
-                        _stats->_cellMinVoltageName.c_str(), _stats->_cellMaxVoltageName.c_str());
-            }
-            break;
-        }
-
-        case 0x402: { // Pytes protocol: Highest/Lowest Cell Temperature
-            _stats->_cellMaxTemperature = this->scaleValue(this->readUnsignedInt16(rx_message.data), 0.1);
-            _stats->_cellMinTemperature = this->scaleValue(this->readUnsignedInt16(rx_message.data + 2), 0.1);
-            pytesSetCellLabel(_stats->_cellMaxTemperatureName, this->readUnsignedInt16(rx_message.data + 4));
-            pytesSetCellLabel(_stats->_cellMinTemperatureName, this->readUnsignedInt16(rx_message.data + 6));
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] minimumCellTemperature: %f maximumCellTemperature: %f cellMinTemperatureName: %s cellMaxTemperatureName: %s\r\n",
-                        _stats->_cellMinTemperature, _stats->_cellMaxTemperature,
-                        _stats->_cellMinTemperatureName.c_str(), _stats->_cellMaxTemperatureName.c_str());
+            if (verboseLogging) {
+                MessageOutput.printf("[Pytes] chargeEnabled: %d dischargeEnabled: %d chargeImmediately: %d moduleCountBlockingDischarge: %d moduleCountBlockingCharge: %d\r\n",
+                    chargeEnabled, dischargeEnabled, s._chargeImmediately,
+                    s._moduleCountBlockingCharge, s._moduleCountBlockingDischarge);
             }
-            break;
-        }
+        }),
 
-        case 0x403: { // Pytes protocol: Alarms and Warnings (part 1)
-            uint32_t alarmBits1 = this->readUnsignedInt32(rx_message.data);
-            uint32_t alarmBits2 = this->readUnsignedInt32(rx_message.data + 4);
-            uint32_t mergedBits = alarmBits1 | alarmBits2;
-
-            bool overVoltage = this->getBit(mergedBits, 0);
-            bool highVoltage = this->getBit(mergedBits, 1);
-            bool lowVoltage = this->getBit(mergedBits, 3);
-            bool underVoltage = this->getBit(mergedBits, 4);
-            bool overTemp = this->getBit(mergedBits, 8);
-            bool highTemp = this->getBit(mergedBits, 9);
-            bool lowTemp = this->getBit(mergedBits, 11);
-            bool underTemp = this->getBit(mergedBits, 12);
-            bool overCurrentDischarge = this->getBit(mergedBits, 17) || this->getBit(mergedBits, 18);
-            bool overCurrentCharge = this->getBit(mergedBits, 19) || this->getBit(mergedBits, 20);
-            bool highCurrentDischarge = this->getBit(mergedBits, 21);
-            bool highCurrentCharge = this->getBit(mergedBits, 22);
-            bool stateCharging = this->getBit(mergedBits, 26);
-            bool stateDischarging = this->getBit(mergedBits, 27);
-
-            _stats->_alarmOverVoltage = overVoltage;
-            _stats->_alarmUnderVoltage = underVoltage;
-            _stats->_alarmOverTemperature = stateDischarging && overTemp;
-            _stats->_alarmUnderTemperature = stateDischarging && underTemp;
-            _stats->_alarmOverTemperatureCharge = stateCharging && overTemp;
-            _stats->_alarmUnderTemperatureCharge = stateCharging && underTemp;
-
-            _stats->_alarmOverCurrentDischarge = overCurrentDischarge;
-            _stats->_alarmOverCurrentCharge = overCurrentCharge;
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] Alarms: %d %d %d %d %d %d %d %d\r\n",
-                        _stats->_alarmOverVoltage,
-                        _stats->_alarmUnderVoltage,
-                        _stats->_alarmOverTemperature,
-                        _stats->_alarmUnderTemperature,
-                        _stats->_alarmOverTemperatureCharge,
-                        _stats->_alarmUnderTemperatureCharge,
-                        _stats->_alarmOverCurrentDischarge,
-                        _stats->_alarmOverCurrentCharge);
-            }
+        // Pytes protocol: full mAh / remaining mAh
+        F::frame(0x409, [](Stats& s, twai_message_t const& frame, bool verboseLogging) {
+            s._totalCapacity = scaleValue(readUnsignedInt32(frame.data), 0.001);
+            s._availableCapacity = scaleValue(readUnsignedInt32(frame.data + 4), 0.001);
+            s._capacityPrecision = 2;
+            float soc = 100.0 * s._availableCapacity / s._totalCapacity;
+            s.setSoC(soc, 2/*precision*/, millis());
 
-            _stats->_warningHighVoltage = highVoltage;
-            _stats->_warningLowVoltage = lowVoltage;
-            _stats->_warningHighTemperature = stateDischarging && highTemp;
-            _stats->_warningLowTemperature = stateDischarging && lowTemp;
-            _stats->_warningHighTemperatureCharge = stateCharging && highTemp;
-            _stats->_warningLowTemperatureCharge = stateCharging && lowTemp;
-
-            _stats->_warningHighDischargeCurrent = highCurrentDischarge;
-            _stats->_warningHighChargeCurrent = highCurrentCharge;
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] Warnings: %d %d %d %d %d %d %d %d\r\n",
-                        _stats->_warningHighVoltage,
-                        _stats->_warningLowVoltage,
-                        _stats->_warningHighTemperature,
-                        _stats->_warningLowTemperature,
-                        _stats->_warningHighTemperatureCharge,
-                        _stats->_warningLowTemperatureCharge,
-                        _stats->_warningHighDischargeCurrent,
-                        _stats->_warningHighChargeCurrent);
-            }
-            break;
-        }
-
-        case 0x404: { // Pytes protocol: SOC/SOH
-            // soc (byte 0+1) isn't used here since it is generated with higher
-            // precision in message 0x0409 below.
-            _stats->_stateOfHealth = this->readUnsignedInt16(rx_message.data + 2);
-            _stats->_chargeCycles = this->readUnsignedInt16(rx_message.data + 6);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] soh: %d cycles: %d\r\n",
-                        _stats->_stateOfHealth, _stats->_chargeCycles);
+            if (verboseLogging) {
+                MessageOutput.printf("[Pytes] soc: %.2f totalCapacity: %.2f Ah availableCapacity: %.2f Ah \r\n",
+                        soc, s._totalCapacity, s._availableCapacity);
             }
-            break;
-        }
-
-        case 0x406: { // Pytes protocol: alarms (part 2)
-            uint32_t alarmBits = this->readUnsignedInt32(rx_message.data);
-            _stats->_alarmInternalFailure = this->getBit(alarmBits, 15);
+        }),
 
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] internalFailure: %d (bits: %08x)\r\n",
-                        _stats->_alarmInternalFailure, alarmBits);
-            }
-            break;
-        }
+        MANUFACTURER(0x40A),
 
-        case 0x408: { // Pytes protocol: charge status
-            bool chargeEnabled = rx_message.data[0];
-            bool dischargeEnabled = rx_message.data[1];
-            _stats->_chargeImmediately = rx_message.data[2];
-            // Note: Should use std::popcount once supported by the compiler.
-            _stats->_moduleCountBlockingCharge = popCount(rx_message.data[5]);
-            _stats->_moduleCountBlockingDischarge = popCount(rx_message.data[6]);
+        // Pytes protocol: online / offline module count
+        F::value(0x40B, T::U8, 6, 1, "moduleCountOnline", [](Stats& s, float v) { s._moduleCountOnline = v; }),
+        F::value(0x40B, T::U8, 7, 1, "moduleCountOffline", [](Stats& s, float v) { s._moduleCountOffline = v; }),
 
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] chargeEnabled: %d dischargeEnabled: %d chargeImmediately: %d moduleCountBlockingDischarge: %d moduleCountBlockingCharge: %d\r\n",
-                    chargeEnabled, dischargeEnabled, _stats->_chargeImmediately,
-                    _stats->_moduleCountBlockingCharge, _stats->_moduleCountBlockingDischarge);
-            }
-            break;
-        }
+        // Pytes protocol: balancing info. We don't know the exact unit for
+        // this yet, so we only use it to publish active / not active. It is
+        // somewhat likely that this is a percentage value on the scale of
+        // 0-32768, but that is just a theory.
+        F::value(0x40D, T::U16, 4, 1, "balance", [](Stats& s, float v) { s._balance = v; }),
 
-        case 0x409: { // Pytes protocol: full mAh / remaining mAh
-            _stats->_totalCapacity = this->scaleValue(this->readUnsignedInt32(rx_message.data), 0.001);
-            _stats->_availableCapacity = this->scaleValue(this->readUnsignedInt32(rx_message.data + 4), 0.001);
-            _stats->_capacityPrecision = 2;
-            float soc = 100.0 * _stats->_availableCapacity / _stats->_totalCapacity;
-            _stats->setSoC(soc, 2/*precision*/, millis());
+        ENERGY(0x41E),
+    };
 
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] soc: %.2f totalCapacity: %.2f Ah availableCapacity: %.2f Ah \r\n",
-                        soc, _stats->_totalCapacity, _stats->_availableCapacity);
-            }
-            break;
-        }
+#undef LIMITS
+#undef MEASUREMENTS
+#undef MANUFACTURER
+#undef ENERGY
+#undef FLAG
 
-        case 0x40b: { // Pytes protocol: online / offline module count
-            _stats->_moduleCountOnline = this->readUnsignedInt8(rx_message.data + 6);
-            _stats->_moduleCountOffline = this->readUnsignedInt8(rx_message.data + 7);
+    static constexpr CanFrame::FrameTable<Stats> frames(fields);
+    static_assert(frames.isSorted(), "fields must be sorted by frame identifier");
 
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] moduleCountOnline: %d moduleCountOffline: %d\r\n",
-                        _stats->_moduleCountOnline, _stats->_moduleCountOffline);
-            }
-            break;
-        }
-
-        case 0x40d: { // Pytes protocol: balancing info
-            // We don't know the exact unit for this yet, so we only use
-            // it to publish active / not active.
-            // It is somewhat likely that this is a percentage value on
-            // the scale of 0-32768, but that is just a theory.
-            _stats->_balance = this->readUnsignedInt16(rx_message.data + 4);
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] balance: %d\r\n",
-                        _stats->_balance);
-            }
-            break;
-        }
+    return frames;
+}
 
-        default:
-            return; // do not update last update timestamp
-            break;
+void Provider::onMessage(twai_message_t const& rx_message)
+{
+    if (!getFrames().decode(rx_message, *_stats, "Pytes", _verboseLogging)) {
+        return; // do not update last update timestamp
     }
 
     _stats->setLastUpdate(millis());
@@ -1,5 +1,4 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
-#include <MqttSettings.h>
 #include <battery/pytes/Stats.h>
 
 namespace Batteries::Pytes {
@@ -86,68 +85,68 @@ void Stats::mqttPublish() const
 {
     ::Batteries::Stats::mqttPublish();
 
-    MqttSettings.publish("battery/settings/chargeVoltage", String(_chargeVoltageLimit));
-    MqttSettings.publish("battery/settings/chargeCurrentLimitation", String(_chargeCurrentLimit));
-    MqttSettings.publish("battery/settings/dischargeVoltageLimitation", String(_dischargeVoltageLimit));
+    mqttPublishValue("battery/settings/chargeVoltage", _chargeVoltageLimit);
+    mqttPublishValue("battery/settings/chargeCurrentLimitation", _chargeCurrentLimit);
+    mqttPublishValue("battery/settings/dischargeVoltageLimitation", _dischargeVoltageLimit);
 
-    MqttSettings.publish("battery/stateOfHealth", String(_stateOfHealth));
+    mqttPublishValue("battery/stateOfHealth", _stateOfHealth);
     if (_chargeCycles != -1) {
-        MqttSettings.publish("battery/chargeCycles", String(_chargeCycles));
+        mqttPublishValue("battery/chargeCycles", _chargeCycles);
     }
     if (_balance != -1) {
-        MqttSettings.publish("battery/balancingActive", String(_balance ? 1 : 0));
+        mqttPublishValue("battery/balancingActive", _balance ? 1 : 0);
     }
-    MqttSettings.publish("battery/temperature", String(_temperature));
+    mqttPublishValue("battery/temperature", _temperature);
 
     if (_chargedEnergy != -1) {
-        MqttSettings.publish("battery/chargedEnergy", String(_chargedEnergy));
+        mqttPublishValue("battery/chargedEnergy", _chargedEnergy);
     }
 
     if (_dischargedEnergy != -1) {
-        MqttSettings.publish("battery/dischargedEnergy", String(_dischargedEnergy));
+        mqttPublishValue("battery/dischargedEnergy", _dischargedEnergy);
     }
 
-    MqttSettings.publish("battery/capacity", String(_totalCapacity));
-    MqttSettings.publish("battery/availableCapacity", String(_availableCapacity));
-
-    MqttSettings.publish("battery/CellMinMilliVolt", String(_cellMinMilliVolt));
-    MqttSettings.publish("battery/CellMaxMilliVolt", String(_cellMaxMilliVolt));
-    MqttSettings.publish("battery/CellDiffMilliVolt", String(_cellMaxMilliVolt - _cellMinMilliVolt));
-    MqttSettings.publish("battery/CellMinTemperature", String(_cellMinTemperature));
-    MqttSettings.publish("battery/CellMaxTemperature", String(_cellMaxTemperature));
-    MqttSettings.publish("battery/CellMinVoltageName", String(_cellMinVoltageName));
-    MqttSettings.publish("battery/CellMaxVoltageName", String(_cellMaxVoltageName));
-    MqttSettings.publish("battery/CellMinTemperatureName", String(_cellMinTemperatureName));
-    MqttSettings.publish("battery/CellMaxTemperatureName", String(_cellMaxTemperatureName));
-
-    MqttSettings.publish("battery/modulesOnline", String(_moduleCountOnline));
-    MqttSettings.publish("battery/modulesOffline", String(_moduleCountOffline));
-    MqttSettings.publish("battery/modulesBlockingCharge", String(_moduleCountBlockingCharge));
-    MqttSettings.publish("battery/modulesBlockingDischarge", String(_moduleCountBlockingDischarge));
-
-    MqttSettings.publish("battery/alarm/overCurrentDischarge", String(_alarmOverCurrentDischarge));
-    MqttSettings.publish("battery/alarm/overCurrentCharge", String(_alarmOverCurrentCharge));
-    MqttSettings.publish("battery/alarm/underVoltage", String(_alarmUnderVoltage));
-    MqttSettings.publish("battery/alarm/overVoltage", String(_alarmOverVoltage));
-    MqttSettings.publish("battery/alarm/underTemperature", String(_alarmUnderTemperature));
-    MqttSettings.publish("battery/alarm/overTemperature", String(_alarmOverTemperature));
-    MqttSettings.publish("battery/alarm/underTemperatureCharge", String(_alarmUnderTemperatureCharge));
-    MqttSettings.publish("battery/alarm/overTemperatureCharge", String(_alarmOverTemperatureCharge));
-    MqttSettings.publish("battery/alarm/bmsInternal", String(_alarmInternalFailure));
-    MqttSettings.publish("battery/alarm/cellImbalance", String(_alarmCellImbalance));
-
-    MqttSettings.publish("battery/warning/highCurrentDischarge", String(_warningHighDischargeCurrent));
-    MqttSettings.publish("battery/warning/highCurrentCharge", String(_warningHighChargeCurrent));
-    MqttSettings.publish("battery/warning/lowVoltage", String(_warningLowVoltage));
-    MqttSettings.publish("battery/warning/highVoltage", String(_warningHighVoltage));
-    MqttSettings.publish("battery/warning/lowTemperature", String(_warningLowTemperature));
-    MqttSettings.publish("battery/warning/highTemperature", String(_warningHighTemperature));
-    MqttSettings.publish("battery/warning/lowTemperatureCharge", String(_warningLowTemperatureCharge));
-    MqttSettings.publish("battery/warning/highTemperatureCharge", String(_warningHighTemperatureCharge));
-    MqttSettings.publish("battery/warning/bmsInternal", String(_warningInternalFailure));
-    MqttSettings.publish("battery/warning/cellImbalance", String(_warningCellImbalance));
-
-    MqttSettings.publish("battery/charging/chargeImmediately", String(_chargeImmediately));
+    mqttPublishValue("battery/capacity", _totalCapacity);
+    mqttPublishValue("battery/availableCapacity", _availableCapacity);
+
+    mqttPublishValue("battery/CellMinMilliVolt", _cellMinMilliVolt);
+    mqttPublishValue("battery/CellMaxMilliVolt", _cellMaxMilliVolt);
+    mqttPublishValue("battery/CellDiffMilliVolt", _cellMaxMilliVolt - _cellMinMilliVolt);
+    mqttPublishValue("battery/CellMinTemperature", _cellMinTemperature);
+    mqttPublishValue("battery/CellMaxTemperature", _cellMaxTemperature);
+    mqttPublishValue("battery/CellMinVoltageName", _cellMinVoltageName);
+    mqttPublishValue("battery/CellMaxVoltageName", _cellMaxVoltageName);
+    mqttPublishValue("battery/CellMinTemperatureName", _cellMinTemperatureName);
+    mqttPublishValue("battery/CellMaxTemperatureName", _cellMaxTemperatureName);
+
+    mqttPublishValue("battery/modulesOnline", _moduleCountOnline);
+    mqttPublishValue("battery/modulesOffline", _moduleCountOffline);
+    mqttPublishValue("battery/modulesBlockingCharge", _moduleCountBlockingCharge);
+    mqttPublishValue("battery/modulesBlockingDischarge", _moduleCountBlockingDischarge);
+
+    mqttPublishValue("battery/alarm/overCurrentDischarge", _alarmOverCurrentDischarge);
+    mqttPublishValue("battery/alarm/overCurrentCharge", _alarmOverCurrentCharge);
+    mqttPublishValue("battery/alarm/underVoltage", _alarmUnderVoltage);
+    mqttPublishValue("battery/alarm/overVoltage", _alarmOverVoltage);
+    mqttPublishValue("battery/alarm/underTemperature", _alarmUnderTemperature);
+    mqttPublishValue("battery/alarm/overTemperature", _alarmOverTemperature);
+    mqttPublishValue("battery/alarm/underTemperatureCharge", _alarmUnderTemperatureCharge);
+    mqttPublishValue("battery/alarm/overTemperatureCharge", _alarmOverTemperatureCharge);
+    mqttPublishValue("battery/alarm/bmsInternal", _alarmInternalFailure);
+    mqttPublishValue("battery/alarm/cellImbalance", _alarmCellImbalance);
+
+    mqttPublishValue("battery/warning/highCurrentDischarge", _warningHighDischargeCurrent);
+    mqttPublishValue("battery/warning/highCurrentCharge", _warningHighChargeCurrent);
+    mqttPublishValue("battery/warning/lowVoltage", _warningLowVoltage);
+    mqttPublishValue("battery/warning/highVoltage", _warningHighVoltage);
+    mqttPublishValue("battery/warning/lowTemperature", _warningLowTemperature);
+    mqttPublishValue("battery/warning/highTemperature", _warningHighTemperature);
+    mqttPublishValue("battery/warning/lowTemperatureCharge", _warningLowTemperatureCharge);
+    mqttPublishValue("battery/warning/highTemperatureCharge", _warningHighTemperatureCharge);
+    mqttPublishValue("battery/warning/bmsInternal", _warningInternalFailure);
+    mqttPublishValue("battery/warning/cellImbalance", _warningCellImbalance);
+
+    mqttPublishValue("battery/charging/chargeImmediately", _chargeImmediately);
 }
 
 } // namespace Batteries::Pytes
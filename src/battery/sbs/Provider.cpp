@@ -17,114 +17,58 @@ bool Provider::init(bool verboseLogging)
     return ::Batteries::CanReceiver::init(verboseLogging, "SBS");
 }
 
-void Provider::onMessage(twai_message_t rx_message)
+CanFrame::FrameTable<Stats> const& Provider::getFrames()
 {
-    switch (rx_message.identifier) {
-        case 0x610: {
-            _stats->setVoltage(this->readUnsignedInt16(rx_message.data)* 0.001, millis());
-            _stats->setCurrent(this->readSignedInt16(rx_message.data + 3) * 0.001, 2/*precision*/, millis());
-            _stats->setSoC(static_cast<float>(this->readUnsignedInt16(rx_message.data + 6)), 1, millis());
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[SBS Unipower] 1552 SoC: %f Voltage: %f Current: %f\r\n", _stats->getSoC(), _stats->getVoltage(), _stats->getChargeCurrent());
+    using F = CanFrame::Field<Stats>;
+    using T = CanFrame::Type;
+
+    static constexpr F fields[] = {
+        F::value(0x610, T::U16, 0, 0.001, "voltage", [](Stats& s, float v) { s.setVoltage(v, millis()); }),
+        F::value(0x610, T::S16, 3, 0.001, "current", [](Stats& s, float v) { s.setCurrent(v, 2/*precision*/, millis()); }),
+        F::value(0x610, T::U16, 6, 1, "soc", [](Stats& s, float v) { s.setSoC(v, 1, millis()); }),
+
+        F::frame(0x630, [](Stats& s, twai_message_t const& frame, bool verboseLogging) {
+            // the cluster state: 1 is discharge mode (recuperation enabled),
+            // 2 is charge mode (discharge with half current possible), while
+            // 0 (inactive), 4 (fault), 8 (deep sleep) and all other states
+            // allow neither.
+            int clusterstate = frame.data[0];
+            bool enabled = clusterstate == 1 || clusterstate == 2;
+            s._chargeEnabled = enabled;
+            s._dischargeEnabled = enabled;
+            s.setManufacturer("SBS UniPower ");
+
+            if (verboseLogging) {
+                MessageOutput.printf("[SBS Unipower] chargeStatusBits: %d %d\r\n", s._chargeEnabled, s._dischargeEnabled);
             }
-            break;
-        }
-
-         case 0x630: {
-            int clusterstate = rx_message.data[0];
-            switch (clusterstate) {
-                case 0:
-                    // Battery inactive
-                    _stats->_dischargeEnabled = 0;
-                    _stats->_chargeEnabled = 0;
-                    break;
-
-                case 1:
-                    // Battery Discharge mode (recuperation enabled)
-                    _stats->_chargeEnabled = 1;
-                    _stats->_dischargeEnabled = 1;
-                    break;
-
-                case 2:
-                    // Battery in charge Mode (discharge with half current possible (45A))
-                    _stats->_chargeEnabled = 1;
-                    _stats->_dischargeEnabled = 1;
-                    break;
-
-                case 4:
-                    // Battery Fault
-                    _stats->_chargeEnabled = 0;
-                    _stats->_dischargeEnabled = 0;
-                    break;
-
-                case 8:
-                    // Battery Deepsleep
-                    _stats->_chargeEnabled = 0;
-                    _stats->_dischargeEnabled = 0;
-                    break;
-
-                default:
-                    _stats->_dischargeEnabled = 0;
-                    _stats->_chargeEnabled = 0;
-                    break;
-            }
-            _stats->setManufacturer("SBS UniPower ");
+        }),
 
-            if (_verboseLogging) {
-                MessageOutput.printf("[SBS Unipower] 1584 chargeStatusBits: %d %d\r\n", _stats->_chargeEnabled, _stats->_dischargeEnabled);
-            }
-            break;
-        }
+        F::value(0x640, T::S24, 0, 0.001, "dischargeCurrentLimit", [](Stats& s, float v) { s.setDischargeCurrentLimit(v, millis()); }),
+        F::value(0x640, T::S24, 3, 0.001, "chargeCurrentLimitation", [](Stats& s, float v) { s._chargeCurrentLimitation = v; }),
 
-        case 0x640: {
-            _stats->_chargeCurrentLimitation = (this->readSignedInt24(rx_message.data + 3) * 0.001);
-            _stats->setDischargeCurrentLimit(this->readSignedInt24(rx_message.data) * 0.001, millis());
+        // the temperature is reported in degrees Fahrenheit
+        F::value(0x650, T::U8, 0, 1 / 1.8, "temperature", [](Stats& s, float v) { s._temperature = v; }, -32 / 1.8),
 
-            if (_verboseLogging) {
-                MessageOutput.printf("[SBS Unipower] 1600 Currents  %f, %f \r\n", _stats->_chargeCurrentLimitation, _stats->getDischargeCurrentLimit());
-            }
-            break;
-        }
+        F::bit(0x660, 0, 1, "alarmUnderTemperature", [](Stats& s, float v) { s._alarmUnderTemperature = v; }),
+        F::bit(0x660, 0, 0, "alarmOverTemperature", [](Stats& s, float v) { s._alarmOverTemperature = v; }),
+        F::bit(0x660, 0, 3, "alarmUnderVoltage", [](Stats& s, float v) { s._alarmUnderVoltage = v; }),
+        F::bit(0x660, 0, 2, "alarmOverVoltage", [](Stats& s, float v) { s._alarmOverVoltage = v; }),
+        F::bit(0x660, 1, 2, "alarmBmsInternal", [](Stats& s, float v) { s._alarmBmsInternal = v; }),
 
-        case 0x650: {
-            byte temp = rx_message.data[0];
-            _stats->_temperature = (static_cast<float>(temp)-32) /1.8;
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[SBS Unipower] 1616 Temp %f \r\n",_stats->_temperature);
-            }
-            break;
-        }
-
-        case 0x660: {
-            uint16_t alarmBits = rx_message.data[0];
-            _stats->_alarmUnderTemperature = this->getBit(alarmBits, 1);
-            _stats->_alarmOverTemperature = this->getBit(alarmBits, 0);
-            _stats->_alarmUnderVoltage = this->getBit(alarmBits, 3);
-            _stats->_alarmOverVoltage= this->getBit(alarmBits, 2);
-            _stats->_alarmBmsInternal= this->getBit(rx_message.data[1], 2);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[SBS Unipower] 1632 Alarms: %d %d %d %d \r\n ", _stats->_alarmUnderTemperature, _stats->_alarmOverTemperature, _stats->_alarmUnderVoltage,  _stats->_alarmOverVoltage);
-            }
-            break;
-        }
+        F::bit(0x670, 1, 1, "warningHighCurrentDischarge", [](Stats& s, float v) { s._warningHighCurrentDischarge = v; }),
+        F::bit(0x670, 1, 0, "warningHighCurrentCharge", [](Stats& s, float v) { s._warningHighCurrentCharge = v; }),
+    };
 
-        case 0x670: {
-            uint16_t warningBits = rx_message.data[1];
-            _stats->_warningHighCurrentDischarge = this->getBit(warningBits, 1);
-            _stats->_warningHighCurrentCharge = this->getBit(warningBits, 0);
+    static constexpr CanFrame::FrameTable<Stats> frames(fields);
+    static_assert(frames.isSorted(), "fields must be sorted by frame identifier");
 
-             if (_verboseLogging) {
-                MessageOutput.printf("[SBS Unipower] 1648 Warnings: %d %d \r\n", _stats->_warningHighCurrentDischarge, _stats->_warningHighCurrentCharge);
-            }
-            break;
-        }
+    return frames;
+}
 
-        default:
-            return; // do not update last update timestamp
-            break;
+void Provider::onMessage(twai_message_t const& rx_message)
+{
+    if (!getFrames().decode(rx_message, *_stats, "SBS Unipower", _verboseLogging)) {
+        return; // do not update last update timestamp
     }
 
     _stats->setLastUpdate(millis());
@@ -1,5 +1,4 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
-#include <MqttSettings.h>
 #include <battery/sbs/Stats.h>
 
 namespace Batteries::SBS {
@@ -30,17 +29,17 @@ void Stats::mqttPublish() const
 {
     ::Batteries::Stats::mqttPublish();
 
-    MqttSettings.publish("battery/settings/chargeVoltage", String(_chargeVoltage));
-    MqttSettings.publish("battery/settings/chargeCurrentLimitation", String(_chargeCurrentLimitation));
-    MqttSettings.publish("battery/stateOfHealth", String(_stateOfHealth));
-    MqttSettings.publish("battery/temperature", String(_temperature));
-    MqttSettings.publish("battery/alarm/underVoltage", String(_alarmUnderVoltage));
-    MqttSettings.publish("battery/alarm/overVoltage", String(_alarmOverVoltage));
-    MqttSettings.publish("battery/alarm/bmsInternal", String(_alarmBmsInternal));
-    MqttSettings.publish("battery/warning/highCurrentDischarge", String(_warningHighCurrentDischarge));
-    MqttSettings.publish("battery/warning/highCurrentCharge", String(_warningHighCurrentCharge));
-    MqttSettings.publish("battery/charging/chargeEnabled", String(_chargeEnabled));
-    MqttSettings.publish("battery/charging/dischargeEnabled", String(_dischargeEnabled));
+    mqttPublishValue("battery/settings/chargeVoltage", _chargeVoltage);
+    mqttPublishValue("battery/settings/chargeCurrentLimitation", _chargeCurrentLimitation);
+    mqttPublishValue("battery/stateOfHealth", _stateOfHealth);
+    mqttPublishValue("battery/temperature", _temperature);
+    mqttPublishValue("battery/alarm/underVoltage", _alarmUnderVoltage);
+    mqttPublishValue("battery/alarm/overVoltage", _alarmOverVoltage);
+    mqttPublishValue("battery/alarm/bmsInternal", _alarmBmsInternal);
+    mqttPublishValue("battery/warning/highCurrentDischarge", _warningHighCurrentDischarge);
+    mqttPublishValue("battery/warning/highCurrentCharge", _warningHighCurrentCharge);
+    mqttPublishValue("battery/charging/chargeEnabled", _chargeEnabled);
+    mqttPublishValue("battery/charging/dischargeEnabled", _dischargeEnabled);
 }
 
 } // namespace Batteries::SBS
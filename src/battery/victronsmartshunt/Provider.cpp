@@ -1,8 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include <battery/victronsmartshunt/Provider.h>
-#include <PinMapping.h>
 #include <MessageOutput.h>
-#include <SerialPortManager.h>
 
 namespace Batteries::VictronSmartShunt {
 
@@ -12,40 +10,45 @@ Provider::Provider()
 
 void Provider::deinit()
 {
-    SerialPortManager.freePort(_serialPortOwner);
+    _upPort = nullptr;
 }
 
 bool Provider::init(bool verboseLogging)
 {
     MessageOutput.println("[VictronSmartShunt] Initialize interface...");
 
-    const PinMapping_t& pin = PinMapping.get();
+    auto const pin = getPins();
     MessageOutput.printf("[VictronSmartShunt] Interface rx = %d, tx = %d\r\n",
-            pin.battery_rx, pin.battery_tx);
+            pin.Rx, pin.Tx);
 
-    if (pin.battery_rx < 0) {
+    if (pin.Rx < 0) {
         MessageOutput.println("[VictronSmartShunt] Invalid pin config");
         return false;
     }
 
-    auto tx = static_cast<gpio_num_t>(pin.battery_tx);
-    auto rx = static_cast<gpio_num_t>(pin.battery_rx);
+    // each set of battery pins may connect a SmartShunt
+    std::string owner = "SmartShunt";
+    if (getPinSet() > 0) { owner += " " + std::to_string(getPinSet() + 1); }
 
-    auto oHwSerialPort = SerialPortManager.allocatePort(_serialPortOwner);
-    if (!oHwSerialPort) { return false; }
+    auto upPort = std::make_unique<Port>(owner);
+    if (!upPort->begin(pin.Rx, pin.Tx, verboseLogging, TaskPlacement::Role::SerialBattery)) {
+        return false;
+    }
 
-    VeDirectShunt.init(rx, tx, &MessageOutput, verboseLogging, *oHwSerialPort);
+    _upPort = std::move(upPort);
     return true;
 }
 
 void Provider::loop()
 {
-    VeDirectShunt.loop();
+    if (!_upPort) { return; }
 
-    if (VeDirectShunt.getLastUpdate() == _lastUpdate) { return; }
+    _upPort->withController([this](VeDirectShuntController const& controller) {
+        if (controller.getLastUpdate() == _lastUpdate) { return; }
 
-    _stats->updateFrom(VeDirectShunt.getData());
-    _lastUpdate = VeDirectShunt.getLastUpdate();
+        _lastUpdate = controller.getLastUpdate();
+        _stats->updateFrom(controller.getData(), _lastUpdate);
+    });
 }
 
 } // namespace Batteries::VictronSmartShunt
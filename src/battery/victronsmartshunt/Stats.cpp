@@ -1,11 +1,10 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
-#include <MqttSettings.h>
 #include <battery/victronsmartshunt/Stats.h>
 
 namespace Batteries::VictronSmartShunt {
 
-void Stats::updateFrom(VeDirectShuntController::data_t const& shuntData) {
-    _lastUpdate = VeDirectShunt.getLastUpdate();
+void Stats::updateFrom(VeDirectShuntController::data_t const& shuntData, uint32_t lastUpdate) {
+    _lastUpdate = lastUpdate;
     ::Batteries::Stats::setVoltage(shuntData.batteryVoltage_V_mV / 1000.0, _lastUpdate);
     ::Batteries::Stats::setSoC(static_cast<float>(shuntData.SOC) / 10, 1/*precision*/, _lastUpdate);
     ::Batteries::Stats::setCurrent(static_cast<float>(shuntData.batteryCurrent_I_mA) / 1000, 2/*precision*/, _lastUpdate);
@@ -57,14 +56,14 @@ void Stats::getLiveViewData(JsonVariant& root) const {
 void Stats::mqttPublish() const {
     ::Batteries::Stats::mqttPublish();
 
-    MqttSettings.publish("battery/chargeCycles", String(_chargeCycles));
-    MqttSettings.publish("battery/chargedEnergy", String(_chargedEnergy));
-    MqttSettings.publish("battery/dischargedEnergy", String(_dischargedEnergy));
-    MqttSettings.publish("battery/instantaneousPower", String(_instantaneousPower));
-    MqttSettings.publish("battery/consumedAmpHours", String(_consumedAmpHours));
-    MqttSettings.publish("battery/lastFullCharge", String(_lastFullCharge));
-    MqttSettings.publish("battery/midpointVoltage", String(_midpointVoltage));
-    MqttSettings.publish("battery/midpointDeviation", String(_midpointDeviation));
+    mqttPublishValue("battery/chargeCycles", _chargeCycles);
+    mqttPublishValue("battery/chargedEnergy", _chargedEnergy);
+    mqttPublishValue("battery/dischargedEnergy", _dischargedEnergy);
+    mqttPublishValue("battery/instantaneousPower", _instantaneousPower);
+    mqttPublishValue("battery/consumedAmpHours", _consumedAmpHours);
+    mqttPublishValue("battery/lastFullCharge", _lastFullCharge);
+    mqttPublishValue("battery/midpointVoltage", _midpointVoltage);
+    mqttPublishValue("battery/midpointDeviation", _midpointDeviation);
 }
 
 } // namespace Batteries::VictronSmartShunt
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "Benchmark.h"
+#include <atomic>
+#include <cstdlib>
+
+// the benchmark environments link with --wrap for malloc, calloc and
+// realloc, such that every allocation passes through here. this includes
+// operator new, Arduino's String and the standard containers.
+namespace {
+
+std::atomic<bool> sCounting = false;
+std::atomic<uint32_t> sAllocations = 0;
+
+inline void countAllocation()
+{
+    if (sCounting.load(std::memory_order_relaxed)) {
+        sAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+} // namespace
+
+extern "C" {
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+    countAllocation();
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    countAllocation();
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    if (size > 0) { countAllocation(); }
+    return __real_realloc(ptr, size);
+}
+
+} // extern "C"
+
+namespace Benchmark {
+
+void countAllocations(bool enable)
+{
+    if (enable) { sAllocations = 0; }
+    sCounting = enable;
+}
+
+uint32_t getAllocationCount()
+{
+    return sAllocations;
+}
+
+} // namespace Benchmark
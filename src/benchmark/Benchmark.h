@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <InputCapture.h>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// the parser benchmark firmware (see the benchmark_* environments) runs the
+// parsers on recorded input and reports the cycles and the heap allocations
+// they need per byte and per frame, such that the numbers can be compared
+// from release to release. the serial sources are fed from a log recorded
+// by InputCapture, which is read from /benchmark.capture on LittleFS. the
+// Hoymiles and MQTT parsers run on built-in data.
+namespace Benchmark {
+
+// the input of every source found in the log. the records of each channel
+// are concatenated in order, as the parsers would have received them.
+struct Corpus {
+    using Source = InputCaptureClass::Source;
+
+    std::array<std::vector<uint8_t>, static_cast<size_t>(Source::Count)> Streams;
+
+    std::vector<uint8_t> const& of(Source source) const { return Streams[static_cast<size_t>(source)]; }
+
+    bool load(char const* path);
+};
+
+struct Result {
+    uint32_t Iterations;
+    uint32_t Frames; // per iteration
+    size_t Bytes; // per iteration
+    uint64_t Cycles;
+    uint32_t Allocations;
+};
+
+// runs the body at least a few times and for about a second. the body
+// parses its input once and returns the number of frames it decoded.
+Result run(std::function<uint32_t()> const& body, size_t bytes);
+
+// prints the result as a line of the CSV table, see printHeader()
+void printHeader();
+void print(char const* name, Result const& result);
+void printSkipped(char const* name, char const* reason);
+
+void runParsers(Corpus const& corpus);
+
+// counts the heap allocations while enabled, see Allocations.cpp
+void countAllocations(bool enable);
+uint32_t getAllocationCount();
+
+} // namespace Benchmark
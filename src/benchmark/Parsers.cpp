@@ -0,0 +1,399 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "Benchmark.h"
+#include <Arduino.h>
+#include <MqttSubscribeParser.h>
+#include <VeDirectMpptController.h>
+#include <battery/jbdbms/SerialMessage.h>
+#include <battery/jkbms/SerialMessage.h>
+#include <inverters/HM_4CH.h>
+#include <sml.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace Benchmark {
+
+namespace {
+
+using Source = InputCaptureClass::Source;
+
+// keeps the compiler from optimizing the decoded values away
+volatile float sSink;
+
+size_t countOccurrences(std::vector<uint8_t> const& data, char const* pattern)
+{
+    size_t count = 0;
+    size_t length = strlen(pattern);
+    for (size_t i = 0; i + length <= data.size(); ++i) {
+        if (memcmp(data.data() + i, pattern, length) == 0) { ++count; }
+    }
+    return count;
+}
+
+// a few text blocks of an MPPT charge controller, used if the log holds no
+// VE.Direct data
+std::vector<uint8_t> buildVeDirectFrames()
+{
+    static constexpr char const* fields[][2] = {
+        { "PID", "0xA060" }, { "FW", "164" }, { "SER#", "HQ2132ABCDE" },
+        { "V", "26450" }, { "I", "3200" }, { "VPV", "71230" }, { "PPV", "87" },
+        { "CS", "3" }, { "MPPT", "2" }, { "OR", "0x00000000" }, { "ERR", "0" },
+        { "LOAD", "ON" }, { "IL", "0" }, { "H19", "12345" }, { "H20", "123" },
+        { "H21", "456" }, { "H22", "234" }, { "H23", "567" }, { "HSDS", "321" }
+    };
+
+    std::vector<uint8_t> frame;
+    auto append = [&frame](char const* text) { frame.insert(frame.end(), text, text + strlen(text)); };
+    for (auto const& field : fields) {
+        append("\r\n");
+        append(field[0]);
+        append("\t");
+        append(field[1]);
+    }
+    append("\r\nChecksum\t");
+
+    // the bytes of a block including the checksum add up to zero
+    uint8_t sum = 0;
+    for (auto byte : frame) { sum += byte; }
+    frame.push_back(256 - sum);
+
+    std::vector<uint8_t> frames;
+    for (int i = 0; i < 10; ++i) { frames.insert(frames.end(), frame.begin(), frame.end()); }
+    return frames;
+}
+
+void runVeDirect(Corpus const& corpus)
+{
+    auto const& recorded = corpus.of(Source::VeDirect);
+    auto const data = recorded.empty() ? buildVeDirectFrames() : recorded;
+    uint32_t frames = countOccurrences(data, "\r\nChecksum\t");
+
+    // not initialized, so it does not open a serial port
+    static VeDirectMpptController controller;
+
+    print(recorded.empty() ? "vedirect (built-in)" : "vedirect", run([&]() {
+        controller.feed(data.data(), data.size());
+        return frames;
+    }, data.size()));
+}
+
+void runSml(Corpus const& corpus)
+{
+    auto const& data = corpus.of(Source::SmlSerial);
+    if (data.empty()) { return printSkipped("sml", "no SML data recorded"); }
+
+    // the values the SML power meter decodes most often
+    static constexpr struct {
+        uint8_t OBIS[6];
+        void (*decoder)(float&);
+    } handlers[] = {
+        { { 0x01, 0x00, 0x10, 0x07, 0x00, 0xff }, &smlOBISW },
+        { { 0x01, 0x00, 0x01, 0x08, 0x00, 0xff }, &smlOBISWh },
+        { { 0x01, 0x00, 0x02, 0x08, 0x00, 0xff }, &smlOBISWh },
+        { { 0x01, 0x00, 0x20, 0x07, 0x00, 0xff }, &smlOBISVolt }
+    };
+
+    print("sml", run([&]() {
+        uint32_t frames = 0;
+        smlReset();
+        for (auto byte : data) {
+            switch (smlState(byte)) {
+                case SML_LISTEND:
+                    for (auto const& handler : handlers) {
+                        if (!smlOBISCheck(handler.OBIS)) { continue; }
+                        float value = 0;
+                        handler.decoder(value);
+                        sSink = value;
+                        break;
+                    }
+                    break;
+                case SML_FINAL:
+                    ++frames;
+                    smlReset();
+                    break;
+                case SML_CHECKSUM_ERROR:
+                    smlReset();
+                    break;
+                default:
+                    break;
+            }
+        }
+        return frames;
+    }, data.size()));
+}
+
+struct FrameRange {
+    size_t Offset;
+    size_t Length;
+};
+
+// splits the stream like the providers do, i.e., by the start marker and
+// the length field. the ranges are computed once, outside of the timing.
+std::vector<FrameRange> splitJkBmsFrames(std::vector<uint8_t> const& data)
+{
+    std::vector<FrameRange> frames;
+    size_t i = 0;
+    while (i + 4 <= data.size()) {
+        if (data[i] != 0x4e || data[i + 1] != 0x57) { ++i; continue; }
+        size_t length = ((data[i + 2] << 8) | data[i + 3]) + 2;
+        if (i + length > data.size()) { break; }
+        frames.push_back({ i, length });
+        i += length;
+    }
+    return frames;
+}
+
+std::vector<FrameRange> splitJbdBmsFrames(std::vector<uint8_t> const& data)
+{
+    std::vector<FrameRange> frames;
+    size_t i = 0;
+    while (i + 7 <= data.size()) {
+        if (data[i] != 0xdd) { ++i; continue; }
+        size_t length = data[i + 3] + 7;
+        if (i + length > data.size() || data[i + length - 1] != 0x77) { ++i; continue; }
+        frames.push_back({ i, length });
+        i += length;
+    }
+    return frames;
+}
+
+void runJkBms(Corpus const& corpus)
+{
+    using Batteries::JkBms::SerialMessage;
+    using Batteries::JkBms::SerialResponse;
+
+    auto const& data = corpus.of(Source::JkBms);
+    auto const frames = splitJkBmsFrames(data);
+    if (frames.empty()) { return printSkipped("jkbms", "no JK BMS frames recorded"); }
+
+    SerialMessage::tData buffer;
+    Batteries::JkBms::DataPointContainer dataPoints;
+
+    print("jkbms", run([&]() {
+        uint32_t valid = 0;
+        for (auto const& frame : frames) {
+            // the checksum is accumulated as the bytes arrive
+            buffer.clear();
+            uint16_t checksum = 0;
+            for (size_t i = 0; i < frame.Length; ++i) {
+                buffer.push_back(data[frame.Offset + i]);
+                SerialMessage::accumulateChecksum(checksum, buffer);
+            }
+
+            dataPoints.clear();
+            SerialResponse response(Batteries::ByteSpan(buffer.data(), buffer.size()), checksum, dataPoints);
+            if (response.isValid()) { ++valid; }
+        }
+        return valid;
+    }, data.size()));
+}
+
+void runJbdBms(Corpus const& corpus)
+{
+    using Batteries::JbdBms::SerialMessage;
+    using Batteries::JbdBms::SerialResponse;
+
+    auto const& data = corpus.of(Source::JbdBms);
+    auto const frames = splitJbdBmsFrames(data);
+    if (frames.empty()) { return printSkipped("jbdbms", "no JBD BMS frames recorded"); }
+
+    SerialMessage::tData buffer;
+    Batteries::JbdBms::DataPointContainer dataPoints;
+
+    print("jbdbms", run([&]() {
+        uint32_t valid = 0;
+        for (auto const& frame : frames) {
+            buffer.clear();
+            uint16_t checksum = 0;
+            for (size_t i = 0; i < frame.Length; ++i) {
+                buffer.push_back(data[frame.Offset + i]);
+                SerialMessage::accumulateChecksum(checksum, buffer);
+            }
+
+            dataPoints.clear();
+            SerialResponse response(Batteries::ByteSpan(buffer.data(), buffer.size()), checksum, dataPoints);
+            if (response.isValid()) { ++valid; }
+        }
+        return valid;
+    }, data.size()));
+}
+
+// the inverter is not attached to a radio, only its parsers are used
+HM_4CH& getInverter()
+{
+    static HM_4CH inverter(nullptr, 0x116112345678ULL);
+    static bool initialized = false;
+    if (!initialized) {
+        inverter.init();
+        initialized = true;
+    }
+    return inverter;
+}
+
+// appends the payload in fragments of the size the radio delivers
+template<typename Parser>
+void appendFragments(Parser& parser, std::vector<uint8_t> const& payload)
+{
+    constexpr size_t FragmentSize = 16;
+    for (size_t offset = 0; offset < payload.size(); offset += FragmentSize) {
+        size_t length = std::min(FragmentSize, payload.size() - offset);
+        parser.appendFragment(offset, payload.data() + offset, length);
+    }
+}
+
+void runStatistics()
+{
+    auto& parser = *getInverter().Statistics();
+
+    std::vector<uint8_t> payload(parser.getExpectedByteCount());
+    for (size_t i = 0; i < payload.size(); ++i) { payload[i] = (i * 37 + 11) & 0xff; }
+
+    print("statistics", run([&]() {
+        parser.beginAppendFragment();
+        parser.clearBuffer();
+        appendFragments(parser, payload);
+        parser.endAppendFragment();
+
+        // reads every value, like the web API and the MQTT publisher do
+        float sum = 0;
+        for (uint8_t type = 0; type < StatisticsParser::TYPE_COUNT; ++type) {
+            for (uint8_t channel = 0; channel < CH_CNT; ++channel) {
+                for (uint8_t field = 0; field < StatisticsParser::FIELD_COUNT; ++field) {
+                    auto t = static_cast<ChannelType_t>(type);
+                    auto c = static_cast<ChannelNum_t>(channel);
+                    auto f = static_cast<FieldId_t>(field);
+                    if (parser.hasChannelFieldValue(t, c, f)) { sum += parser.getChannelFieldValue(t, c, f); }
+                }
+            }
+        }
+        sSink = sum;
+        return 1;
+    }, payload.size()));
+}
+
+void runAlarmLog()
+{
+    auto& parser = *getInverter().EventLog();
+
+    static constexpr uint8_t messageIds[] = { 1, 2, 3, 4, 11, 12, 13, 14, 15, 36, 46, 47, 48, 49, 61 };
+    std::vector<uint8_t> payload(ALARM_LOG_PAYLOAD_SIZE, 0);
+    for (size_t i = 0; i < ALARM_LOG_ENTRY_COUNT; ++i) {
+        uint8_t* entry = &payload[2 + i * ALARM_LOG_ENTRY_SIZE];
+        uint16_t start = 3600 + i * 600;
+        uint16_t end = start + 120;
+        entry[1] = messageIds[i];
+        entry[4] = start >> 8;
+        entry[5] = start & 0xff;
+        entry[6] = end >> 8;
+        entry[7] = end & 0xff;
+    }
+
+    print("alarmlog", run([&]() {
+        parser.clearBuffer();
+        appendFragments(parser, payload);
+
+        AlarmLogEntry_t entry;
+        uint8_t count = parser.getEntryCount();
+        for (uint8_t i = 0; i < count; ++i) { parser.getLogEntry(i, entry); }
+        return count;
+    }, payload.size()));
+}
+
+void runGridProfile()
+{
+    auto& parser = *getInverter().GridProfile();
+
+    // the sections of a typical profile: identifier, version, value count
+    static constexpr uint8_t sections[][3] = {
+        { 0x00, 0x00, 5 }, { 0x10, 0x00, 5 }, { 0x20, 0x00, 1 }, { 0x30, 0x03, 5 },
+        { 0x40, 0x00, 2 }, { 0x50, 0x00, 4 }, { 0x60, 0x00, 4 }, { 0x70, 0x00, 1 },
+        { 0x80, 0x00, 7 }, { 0x90, 0x00, 2 }, { 0xb0, 0x00, 3 }
+    };
+
+    std::vector<uint8_t> payload = { 0x03, 0x00, 0x20, 0x00 };
+    for (auto const& section : sections) {
+        payload.push_back(section[0]);
+        payload.push_back(section[1]);
+        for (uint8_t i = 0; i < section[2]; ++i) {
+            uint16_t value = 2300 + i * 10;
+            payload.push_back(value >> 8);
+            payload.push_back(value & 0xff);
+        }
+    }
+
+    print("gridprofile", run([&]() {
+        parser.clearBuffer();
+        appendFragments(parser, payload);
+
+        float sum = 0;
+        for (auto const& section : parser.getProfile()) {
+            for (auto const& item : section.items) { sum += item.Value; }
+        }
+        sSink = sum;
+        return 1;
+    }, payload.size()));
+}
+
+void runMqttSubscribe()
+{
+    MqttSubscribeParser parser;
+    uint32_t delivered = 0;
+    auto callback = [&delivered](espMqttClientTypes::MessageProperties const&, char const*,
+            uint8_t const*, size_t, size_t, size_t) { ++delivered; };
+
+    // the subscriptions of a setup with a few inverters and the DPL
+    static constexpr char const* settings[] = {
+        "limit_persistent_relative", "limit_persistent_absolute",
+        "limit_nonpersistent_relative", "limit_nonpersistent_absolute",
+        "power", "restart", "reset_rf_stats"
+    };
+    for (char const* serial : { "116112345678", "116112345679", "114187654321", "138212345678" }) {
+        for (char const* setting : settings) {
+            parser.register_callback(std::string("solar/") + serial + "/cmd/" + setting, 0, callback);
+        }
+    }
+    parser.register_callback("solar/powerlimiter/cmd/#", 0, callback);
+    parser.register_callback("solar/huawei/cmd/+", 0, callback);
+    parser.register_callback("shellies/+/emeter/+/power", 0, callback);
+    parser.register_callback("battery/soc", 0, callback);
+
+    static constexpr char const* topics[] = {
+        "solar/116112345678/cmd/limit_nonpersistent_absolute",
+        "solar/138212345678/cmd/power",
+        "solar/powerlimiter/cmd/threshold/voltage/start",
+        "solar/huawei/cmd/limit_online_voltage",
+        "shellies/shellyem3/emeter/0/power",
+        "shellies/shellyem3/emeter/1/power",
+        "battery/soc",
+        "solar/999999999999/cmd/power" // no subscriber
+    };
+    static constexpr uint8_t payload[] = { '4', '2', '0' };
+
+    size_t bytes = 0;
+    for (char const* topic : topics) { bytes += strlen(topic) + sizeof(payload); }
+
+    espMqttClientTypes::MessageProperties properties = { 0, false, false, 0 };
+    print("mqttsubscribe", run([&]() {
+        for (char const* topic : topics) {
+            parser.handle_message(properties, topic, payload, sizeof(payload), 0, sizeof(payload));
+        }
+        return sizeof(topics) / sizeof(topics[0]);
+    }, bytes));
+}
+
+} // namespace
+
+void runParsers(Corpus const& corpus)
+{
+    printHeader();
+    runVeDirect(corpus);
+    runSml(corpus);
+    runJkBms(corpus);
+    runJbdBms(corpus);
+    runStatistics();
+    runAlarmLog();
+    runGridProfile();
+    runMqttSubscribe();
+}
+
+} // namespace Benchmark
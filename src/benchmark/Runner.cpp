@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "Benchmark.h"
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <cstring>
+
+namespace Benchmark {
+
+namespace {
+
+constexpr uint32_t MinIterations = 3;
+constexpr uint32_t MinMillis = 1000;
+
+} // namespace
+
+bool Corpus::load(char const* path)
+{
+    File file = LittleFS.open(path, "r");
+    if (!file) { return false; }
+
+    InputCaptureClass::Header header;
+    if (file.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) != sizeof(header)
+            || memcmp(header.Magic, "OICP", sizeof(header.Magic)) != 0) {
+        Serial.printf("[Benchmark] %s is not an input capture\r\n", path);
+        return false;
+    }
+
+    // the channels of a source are appended one after another
+    std::array<std::array<std::vector<uint8_t>, InputCaptureClass::MaxChannels>,
+        static_cast<size_t>(Source::Count)> channels;
+
+    size_t remaining = header.RecordBytes;
+    while (remaining >= sizeof(InputCaptureClass::RecordHeader)) {
+        InputCaptureClass::RecordHeader record;
+        file.read(reinterpret_cast<uint8_t*>(&record), sizeof(record));
+        remaining -= sizeof(record);
+        if (record.Length > remaining) { break; }
+
+        if (record.Source < static_cast<uint8_t>(Source::Count) && record.Channel < InputCaptureClass::MaxChannels) {
+            auto& stream = channels[record.Source][record.Channel];
+            size_t offset = stream.size();
+            stream.resize(offset + record.Length);
+            file.read(stream.data() + offset, record.Length);
+        } else {
+            file.seek(record.Length, SeekCur);
+        }
+        remaining -= record.Length;
+    }
+
+    for (size_t source = 0; source < channels.size(); ++source) {
+        for (auto& stream : channels[source]) {
+            Streams[source].insert(Streams[source].end(), stream.begin(), stream.end());
+        }
+    }
+
+    Serial.printf("[Benchmark] Loaded %u bytes recorded in %u ms from %s\r\n",
+            header.RecordBytes, header.DurationMillis, path);
+    return true;
+}
+
+Result run(std::function<uint32_t()> const& body, size_t bytes)
+{
+    Result result = { 0, 0, bytes, 0, 0 };
+    uint32_t allocations = 0;
+    uint32_t start = millis();
+
+    while (result.Iterations < MinIterations || millis() - start < MinMillis) {
+        countAllocations(true);
+        uint32_t cycles = ESP.getCycleCount();
+        result.Frames = body();
+        cycles = ESP.getCycleCount() - cycles;
+        countAllocations(false);
+
+        result.Cycles += cycles;
+        allocations += getAllocationCount();
+        ++result.Iterations;
+
+        // lets the idle task feed the watchdog
+        delay(1);
+    }
+
+    result.Allocations = allocations;
+    return result;
+}
+
+void printHeader()
+{
+    Serial.println("BENCH,parser,iterations,frames,bytes,cycles/byte,cycles/frame,allocs/frame");
+}
+
+void print(char const* name, Result const& result)
+{
+    uint64_t cycles = result.Cycles / result.Iterations;
+    uint32_t perByte = result.Bytes > 0 ? cycles / result.Bytes : 0;
+    uint32_t perFrame = result.Frames > 0 ? cycles / result.Frames : 0;
+    float allocations = result.Frames > 0
+        ? static_cast<float>(result.Allocations) / result.Iterations / result.Frames : 0;
+
+    Serial.printf("BENCH,%s,%u,%u,%u,%u,%u,%.2f\r\n", name, result.Iterations,
+            result.Frames, result.Bytes, perByte, perFrame, allocations);
+}
+
+void printSkipped(char const* name, char const* reason)
+{
+    Serial.printf("BENCH,%s,skipped: %s\r\n", name, reason);
+}
+
+} // namespace Benchmark
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "Benchmark.h"
+#include "__compiled_constants.h"
+#include "defaults.h"
+#include <Arduino.h>
+#include <LittleFS.h>
+
+// the entry point of the benchmark_* environments, which replaces the
+// firmware's main.cpp. no network and no other tasks are started, such that
+// the parsers have the CPU to themselves.
+void setup()
+{
+    Serial.begin(SERIAL_BAUDRATE);
+#if !ARDUINO_USB_CDC_ON_BOOT
+    while (!Serial)
+        yield();
+#endif
+    // gives the serial monitor a moment to attach
+    delay(2000);
+
+    Serial.printf("[Benchmark] %s rev %u, %u MHz, %s, build %s\r\n",
+            ESP.getChipModel(), ESP.getChipRevision(), ESP.getCpuFreqMHz(),
+            PIOENV, __COMPILED_GIT_HASH__);
+
+    Benchmark::Corpus corpus;
+    if (!LittleFS.begin(false) || !corpus.load("/benchmark.capture")) {
+        Serial.println("[Benchmark] No /benchmark.capture found, only the built-in data is used");
+    }
+
+    Benchmark::runParsers(corpus);
+    Serial.println("[Benchmark] Done");
+}
+
+void loop()
+{
+    delay(1000);
+}
@@ -4,8 +4,13 @@
  */
 #include <battery/Controller.h>
 #include <gridcharger/huawei/Controller.h>
+#include <Features.h>
+#if FEATURE_HUAWEI_MCP2515
 #include <gridcharger/huawei/MCP2515.h>
+#endif
+#if FEATURE_HUAWEI_TWAI
 #include <gridcharger/huawei/TWAI.h>
+#endif
 #include "MessageOutput.h"
 #include <powermeter/Controller.h>
 #include "PowerLimiter.h"
@@ -13,6 +18,8 @@
 
 #include <functional>
 #include <algorithm>
+#include <cmath>
+#include <TaskProfiler.h>
 
 GridCharger::Huawei::Controller HuaweiCan;
 
@@ -28,7 +35,7 @@ void Controller::init(Scheduler& scheduler)
     MessageOutput.print("Initialize Huawei AC charger interface...\r\n");
 
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&Controller::loop, this));
+    _loopTask.setCallback(TaskProfiler.wrap("Huawei::loop", std::bind(&Controller::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
 
@@ -57,13 +64,24 @@ void Controller::updateSettings()
 
     if (!config.Huawei.Enabled) { return; }
 
+    if (config.Huawei.HardwareInterface < Features::GridChargerInterfaceCount
+            && !Features::isGridChargerInterfaceAvailable(config.Huawei.HardwareInterface)) {
+        MessageOutput.printf("[Huawei::Controller] Hardware interface %d is "
+                "not available in this build\r\n", config.Huawei.HardwareInterface);
+        return;
+    }
+
     switch (config.Huawei.HardwareInterface) {
+#if FEATURE_HUAWEI_MCP2515
         case GridChargerHardwareInterface::MCP2515:
             _upHardwareInterface = std::make_unique<MCP2515>();
             break;
+#endif
+#if FEATURE_HUAWEI_TWAI
         case GridChargerHardwareInterface::TWAI:
             _upHardwareInterface = std::make_unique<TWAI>();
             break;
+#endif
         default:
             MessageOutput.printf("[Huawei::Controller] Unknown hardware "
                     "interface setting %d\r\n", config.Huawei.HardwareInterface);
@@ -71,6 +89,8 @@ void Controller::updateSettings()
             break;
     }
 
+    _upHardwareInterface->setUnitCount(config.Huawei.UnitCount);
+
     if (!_upHardwareInterface->init()) {
         MessageOutput.print("[Huawei::Controller] Error initializing hardware interface\r\n");
         _upHardwareInterface.reset(nullptr);
@@ -101,11 +121,15 @@ void Controller::loop()
 
     bool verboseLogging = config.Huawei.VerboseLogging;
 
-    auto upNewData = _upHardwareInterface->getCurrentData();
-    if (upNewData) {
-        _dataPoints.updateFrom(*upNewData);
+    bool updated = false;
+    for (uint8_t unit = 0; unit < _upHardwareInterface->getUnitCount(); ++unit) {
+        if (!_upHardwareInterface->getCurrentData(unit, _units[unit].Latest)) { continue; }
+        updateDataPoints(unit, verboseLogging);
+        updated = true;
     }
 
+    if (updated) { combineDataPoints(); }
+
     auto oOutputCurrent = _dataPoints.get<DataPointLabel::OutputCurrent>();
     auto oOutputVoltage = _dataPoints.get<DataPointLabel::OutputVoltage>();
     auto oOutputPower = _dataPoints.get<DataPointLabel::OutputPower>();
@@ -193,6 +217,7 @@ void Controller::loop()
         }
 
         if (PowerLimiter.isGovernedBatteryPoweredInverterProducing()) {
+            _powerController.Active = false;
             _setParameter(0.0, Setting::OnlineCurrent);
             // Don't run auto mode for a second now. Otherwise we may send too much over the CAN bus
             _autoModeBlockedTillMillis = millis() + 1000;
@@ -204,34 +229,40 @@ void Controller::loop()
                 _autoPowerEnabledCounter > 0) {
             // We have received a new PowerMeter value. Also we're _autoPowerEnabled
             // So we're good to calculate a new limit
-
+            uint32_t dt = PowerMeter.getLastUpdate() - _lastPowerMeterUpdateReceivedMillis;
             _lastPowerMeterUpdateReceivedMillis = PowerMeter.getLastUpdate();
 
-            // Calculate new power limit
-            float newPowerLimit = -1 * round(PowerMeter.getPowerTotal());
-
-            // Powerlimit is the requested output power + permissable Grid consumption factoring in the efficiency factor
-            newPowerLimit += *oOutputPower + config.Huawei.Auto_Power_Target_Power_Consumption / efficiency;
+            // positive if more power is exported than permissable, i.e., if
+            // the charger shall draw more power from the grid.
+            float error = -1 * PowerMeter.getPowerTotal() + config.Huawei.Auto_Power_Target_Power_Consumption;
 
-            if (verboseLogging) {
-                MessageOutput.printf("[Huawei::Controller] newPowerLimit: %.0f, "
-                    "output_power: %.01f\r\n", newPowerLimit, *oOutputPower);
-            }
+            // the maximum input power, regarding the current limit requested by the BMS
+            float permissableCurrent = stats->getChargeCurrentLimitation() - (stats->getChargeCurrent() - *oOutputCurrent); // BMS current limit - current from other sources, e.g. Victron MPPT charger
+            float maxPowerLimit = std::min(config.Huawei.Auto_Power_Upper_Power_Limit,
+                    std::max(0.0f, permissableCurrent) * *oOutputVoltage / efficiency);
 
             // Check whether the battery SoC limit setting is enabled
             if (config.Battery.Enabled && config.Huawei.Auto_Power_BatterySoC_Limits_Enabled) {
                 uint8_t _batterySoC = Battery.getStats()->getSoC();
                 // Sets power limit to 0 if the BMS reported SoC reaches or exceeds the user configured value
                 if (_batterySoC >= config.Huawei.Auto_Power_Stop_BatterySoC_Threshold) {
-                    newPowerLimit = 0;
+                    maxPowerLimit = 0;
                     if (verboseLogging) {
                         MessageOutput.printf("[Huawei::Controller] Current battery SoC %i reached "
-                                "stop threshold %i, set newPowerLimit to %f \r\n", _batterySoC,
-                                config.Huawei.Auto_Power_Stop_BatterySoC_Threshold, newPowerLimit);
+                                "stop threshold %i, set newPowerLimit to 0\r\n", _batterySoC,
+                                config.Huawei.Auto_Power_Stop_BatterySoC_Threshold);
                     }
                 }
             }
 
+            float newPowerLimit = stepPowerController(error, dt, *oOutputPower / efficiency, maxPowerLimit);
+
+            if (verboseLogging) {
+                MessageOutput.printf("[Huawei::Controller] newPowerLimit: %.0f, "
+                    "output_power: %.01f, error: %.0f, max: %.0f\r\n",
+                    newPowerLimit, *oOutputPower, error, maxPowerLimit);
+            }
+
             if (newPowerLimit > config.Huawei.Auto_Power_Lower_Power_Limit) {
 
                 // Check if the output power has dropped below the lower limit (i.e. the battery is full)
@@ -244,6 +275,7 @@ void Controller::loop()
                     _autoPowerEnabledCounter--;
                     if (_autoPowerEnabledCounter == 0) {
                         _autoPowerEnabled = false;
+                        _powerController.Active = false;
                         _setParameter(0.0, Setting::OnlineCurrent);
                         return;
                     }
@@ -251,40 +283,190 @@ void Controller::loop()
                     _autoPowerEnabledCounter = 10;
                 }
 
-                // Limit power to maximum
-                if (newPowerLimit > config.Huawei.Auto_Power_Upper_Power_Limit) {
-                    newPowerLimit = config.Huawei.Auto_Power_Upper_Power_Limit;
-                }
-
                 // Calculate output current
-                float calculatedCurrent = efficiency * (newPowerLimit / *oOutputVoltage);
-
-                // Limit output current to value requested by BMS
-                float permissableCurrent = stats->getChargeCurrentLimitation() - (stats->getChargeCurrent() - *oOutputCurrent); // BMS current limit - current from other sources, e.g. Victron MPPT charger
-                float outputCurrent = std::min(calculatedCurrent, permissableCurrent);
-                outputCurrent= outputCurrent > 0 ? outputCurrent : 0;
+                float outputCurrent = efficiency * (newPowerLimit / *oOutputVoltage);
 
                 if (verboseLogging) {
                     MessageOutput.printf("[Huawei::Controller] Setting output "
-                        "current to %.2fA. This is the lower value of "
-                        "calculated %.2fA and BMS permissable %.2fA "
-                        "currents\r\n", outputCurrent, calculatedCurrent,
-                        permissableCurrent);
+                        "current to %.2fA, BMS permissable %.2fA\r\n",
+                        outputCurrent, permissableCurrent);
                 }
                 _autoPowerEnabled = true;
-                _setParameter(outputCurrent, Setting::OnlineCurrent);
 
-                // Don't run auto mode some time to allow for output stabilization after issuing a new value
-                _autoModeBlockedTillMillis = millis() + 2 * HardwareInterface::DataRequestIntervalMillis;
+                // the controller is stepped with every power meter reading,
+                // so only actual changes are sent to the PSU
+                if (std::abs(outputCurrent - _powerController.LastCurrent) >= 0.05) {
+                    _setParameter(outputCurrent, Setting::OnlineCurrent);
+                    _powerController.LastCurrent = outputCurrent;
+                }
             } else {
                 // requested PL is below minium. Set current to 0
                 _autoPowerEnabled = false;
+                _powerController.Active = false;
                 _setParameter(0.0, Setting::OnlineCurrent);
             }
         }
     }
 }
 
+float Controller::stepPowerController(float error, uint32_t dtMillis, float inputPower, float maxPowerLimit)
+{
+    auto& pc = _powerController;
+
+    // start from the power the PSU currently draws, so the output does not
+    // jump when control is (re-)started, e.g., after the interlock released.
+    if (!pc.Active) {
+        pc.Active = true;
+        pc.Output = inputPower;
+        pc.LastError = error;
+        pc.LastCurrent = -1;
+    }
+
+    // readings may be missing for a while, which must not cause a large step
+    float dt = std::min<uint32_t>(dtMillis, 2000) / 1000.0f;
+
+    // velocity form: the output is clamped rather than the integral term,
+    // which prevents windup while the output is saturated.
+    float delta = PowerControllerKp * (error - pc.LastError) + PowerControllerKi * error * dt;
+    pc.Output = std::max(0.0f, std::min(maxPowerLimit, pc.Output + delta));
+    pc.LastError = error;
+
+    return pc.Output;
+}
+
+void Controller::updateDataPoints(uint8_t unit, bool verboseLogging)
+{
+    auto const& snapshot = _units[unit].Latest;
+    auto& dataPoints = _units[unit].DataPoints;
+
+    // unchanged values keep their timestamp, like in DataPointContainer::updateFrom()
+#define UPD(l) \
+    { \
+        auto oValue = snapshot.get<DataPointLabel::l>(); \
+        auto oPrevious = dataPoints.get<DataPointLabel::l>(); \
+        if (oValue && (!oPrevious || *oPrevious != *oValue)) { \
+            dataPoints.add<DataPointLabel::l>(*oValue); \
+        } \
+        if (oValue && verboseLogging) { \
+            MessageOutput.printf("[Huawei::HwIfc] [%.3f] unit %d %s: %.3f%s\r\n", \
+                static_cast<float>(snapshot.getTimestamp<DataPointLabel::l>())/1000, \
+                unit + 1, DataPointLabelTraits<DataPointLabel::l>::name, *oValue, \
+                DataPointLabelTraits<DataPointLabel::l>::unit); \
+        } \
+    }
+
+    UPD(InputPower);
+    UPD(InputFrequency);
+    UPD(InputCurrent);
+    UPD(OutputPower);
+    UPD(Efficiency);
+    UPD(OutputVoltage);
+    UPD(OutputCurrentMax);
+    UPD(InputVoltage);
+    UPD(OutputTemperature);
+    UPD(InputTemperature);
+    UPD(OutputCurrent);
+#undef UPD
+}
+
+void Controller::combineDataPoints()
+{
+    uint8_t unitCount = getUnitCount();
+
+    if (unitCount == 1) {
+        _dataPoints.updateFrom(_units[0].DataPoints);
+        return;
+    }
+
+    // the units share the AC input and the DC output, so the voltages and
+    // the frequency are the same for all of them, while their powers and
+    // currents add up.
+    enum class Combine { Sum, Mean, Max };
+
+    auto combine = [this, unitCount](auto label, Combine how) {
+        constexpr auto L = decltype(label)::value;
+        std::optional<float> oResult;
+        uint8_t count = 0;
+
+        for (uint8_t unit = 0; unit < unitCount; ++unit) {
+            auto oValue = _units[unit].DataPoints.get<L>();
+            if (!oValue) { continue; }
+            ++count;
+            if (!oResult) { oResult = *oValue; continue; }
+            oResult = (how == Combine::Max) ? std::max(*oResult, *oValue) : *oResult + *oValue;
+        }
+
+        if (!oResult) { return; }
+        if (how == Combine::Mean) { *oResult /= count; }
+
+        auto oPrevious = _dataPoints.get<L>();
+        if (!oPrevious || *oPrevious != *oResult) {
+            _dataPoints.add<L>(*oResult);
+        }
+    };
+
+#define COMBINE(l, h) combine(std::integral_constant<DataPointLabel, DataPointLabel::l>{}, Combine::h)
+    COMBINE(InputPower, Sum);
+    COMBINE(InputFrequency, Mean);
+    COMBINE(InputCurrent, Sum);
+    COMBINE(OutputPower, Sum);
+    COMBINE(OutputVoltage, Mean);
+    COMBINE(OutputCurrentMax, Sum);
+    COMBINE(InputVoltage, Mean);
+    COMBINE(OutputTemperature, Max);
+    COMBINE(InputTemperature, Max);
+    COMBINE(OutputCurrent, Sum);
+#undef COMBINE
+
+    // the efficiency of the units combined
+    auto oInputPower = _dataPoints.get<DataPointLabel::InputPower>();
+    auto oOutputPower = _dataPoints.get<DataPointLabel::OutputPower>();
+    if (oInputPower && oOutputPower && *oInputPower > 0) {
+        float efficiency = *oOutputPower / *oInputPower;
+        auto oPrevious = _dataPoints.get<DataPointLabel::Efficiency>();
+        if (!oPrevious || *oPrevious != efficiency) {
+            _dataPoints.add<DataPointLabel::Efficiency>(efficiency);
+        }
+    }
+}
+
+uint8_t Controller::getUnitCount() const
+{
+    if (!_upHardwareInterface) { return 1; }
+    return _upHardwareInterface->getUnitCount();
+}
+
+std::array<float, HardwareInterface::MaxUnits> Controller::splitCurrent(float current) const
+{
+    std::array<float, HardwareInterface::MaxUnits> shares = { 0 };
+    std::array<float, HardwareInterface::MaxUnits> weights = { 0 };
+    float weightSum = 0;
+    uint8_t unitCount = getUnitCount();
+
+    for (uint8_t unit = 0; unit < unitCount; ++unit) {
+        auto const& dataPoints = _units[unit].DataPoints;
+
+        auto oEfficiency = dataPoints.get<DataPointLabel::Efficiency>();
+        float weight = oEfficiency ? (*oEfficiency > 0.5 ? *oEfficiency : 1.0) : 1.0;
+
+        auto oTemperature = dataPoints.get<DataPointLabel::OutputTemperature>();
+        if (oTemperature && *oTemperature > DerateStartTemperature) {
+            float progress = std::min(1.0f, (*oTemperature - DerateStartTemperature) /
+                    (DerateEndTemperature - DerateStartTemperature));
+            weight *= 1.0f - progress * (1.0f - DeratedWeight);
+        }
+
+        weights[unit] = weight;
+        weightSum += weight;
+    }
+
+    for (uint8_t unit = 0; unit < unitCount; ++unit) {
+        shares[unit] = current * weights[unit] / weightSum;
+    }
+
+    return shares;
+}
+
 void Controller::setParameter(float val, HardwareInterface::Setting setting)
 {
     std::lock_guard<std::mutex> lock(_mutex);
@@ -318,6 +500,12 @@ void Controller::_setParameter(float val, HardwareInterface::Setting setting)
         _outputCurrentOnSinceMillis = millis();
     }
 
+    if (getUnitCount() > 1 &&
+            (setting == Setting::OnlineCurrent || setting == Setting::OfflineCurrent)) {
+        _upHardwareInterface->setParameters(setting, splitCurrent(val));
+        return;
+    }
+
     _upHardwareInterface->setParameter(setting, val);
 }
 
@@ -346,6 +534,7 @@ void Controller::setMode(uint8_t mode) {
 
     if (_mode == HUAWEI_MODE_AUTO_INT && mode != HUAWEI_MODE_AUTO_INT) {
         _autoPowerEnabled = false;
+        _powerController.Active = false;
         _setParameter(0, HardwareInterface::Setting::OnlineCurrent);
     }
 
@@ -361,10 +550,10 @@ void Controller::getJsonData(JsonVariant& root) const
     using Label = GridCharger::Huawei::DataPointLabel;
 #define VAL(l, n) \
     { \
-        auto oDataPoint = _dataPoints.getDataPointFor<Label::l>(); \
-        if (oDataPoint) { \
-            root[n]["v"] = *_dataPoints.get<Label::l>(); \
-            root[n]["u"] = oDataPoint->getUnitText(); \
+        auto oValue = _dataPoints.get<Label::l>(); \
+        if (oValue) { \
+            root[n]["v"] = *oValue; \
+            root[n]["u"] = DataPointLabelTraits<Label::l>::unit; \
         } \
     }
 
@@ -381,10 +570,34 @@ void Controller::getJsonData(JsonVariant& root) const
 
     // special handling for efficiency, as we need to multiply it
     // to get the percentage (rather than the decimal notation).
-    auto oEfficiency = _dataPoints.getDataPointFor<Label::Efficiency>();
+    auto oEfficiency = _dataPoints.get<Label::Efficiency>();
     if (oEfficiency) {
-        root["efficiency"]["v"] = *_dataPoints.get<Label::Efficiency>() * 100;
-        root["efficiency"]["u"] = oEfficiency->getUnitText();
+        root["efficiency"]["v"] = *oEfficiency * 100;
+        root["efficiency"]["u"] = DataPointLabelTraits<Label::Efficiency>::unit;
+    }
+
+    uint8_t unitCount = getUnitCount();
+    if (unitCount < 2) { return; }
+
+    auto units = root["units"].to<JsonArray>();
+    for (uint8_t unit = 0; unit < unitCount; ++unit) {
+        auto const& dataPoints = _units[unit].DataPoints;
+        auto entry = units.add<JsonObject>();
+        entry["data_age"] = (millis() - dataPoints.getLastUpdate()) / 1000;
+
+#define VAL(l, n) \
+    { \
+        auto oValue = dataPoints.get<Label::l>(); \
+        if (oValue) { entry[n] = *oValue; } \
+    }
+
+        VAL(OutputCurrent, "output_current");
+        VAL(OutputPower, "output_power");
+        VAL(OutputTemperature, "output_temp");
+#undef VAL
+
+        auto oUnitEfficiency = dataPoints.get<Label::Efficiency>();
+        if (oUnitEfficiency) { entry["efficiency"] = *oUnitEfficiency * 100; }
     }
 }
 
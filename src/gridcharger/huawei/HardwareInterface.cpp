@@ -1,8 +1,8 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 
 #include <Arduino.h>
-#include <Configuration.h>
 #include <MessageOutput.h>
+#include <TaskPlacement.h>
 #include <gridcharger/huawei/HardwareInterface.h>
 
 namespace GridCharger::Huawei {
@@ -30,8 +30,9 @@ void HardwareInterface::staticLoopHelper(void* context)
 bool HardwareInterface::startLoop()
 {
     uint32_t constexpr stackSize = 3072;
-    return pdPASS == xTaskCreate(HardwareInterface::staticLoopHelper,
-            "HuaweiHwIfc", stackSize, this, 16/*prio*/, &_taskHandle);
+    return TaskPlacement::create(TaskPlacement::Role::GridCharger,
+            HardwareInterface::staticLoopHelper, "HuaweiHwIfc", stackSize,
+            this, &_taskHandle);
 }
 
 void HardwareInterface::stopLoop()
@@ -63,74 +64,59 @@ void HardwareInterface::loop()
         //     0x108081FE (unclear).
         // https://github.com/craigpeacock/Huawei_R4850G2_CAN/blob/main/r4850.c
         // https://www.beyondlogic.org/review-huawei-r4850g2-power-supply-53-5vdc-3kw/
-        if ((msg.canId & 0x1FFFFFFF) != 0x1081407F) { continue; }
+        uint32_t canId = msg.canId & 0x1FFFFFFF;
+        if ((canId & ~AddressMask) != (DataAnswerId & ~AddressMask)) { continue; }
 
-        if ((msg.valueId & 0xFF00FFFF) != 0x01000000) { continue; }
+        uint8_t unit = ((canId & AddressMask) >> 16) - 0x81;
+        if (unit >= _unitCount) { continue; }
 
-        if (!_upDataInFlight) { _upDataInFlight = std::make_unique<DataPointContainer>(); }
+        if ((msg.valueId & 0xFF00FFFF) != 0x01000000) { continue; }
 
         auto label = static_cast<DataPointLabel>((msg.valueId & 0x00FF0000) >> 16);
 
-        unsigned divisor = (label == DataPointLabel::OutputCurrentMax) ? _maxCurrentMultiplier : 1024;
-        float value = static_cast<float>(msg.value)/divisor;
         switch (label) {
             case DataPointLabel::InputPower:
-                _upDataInFlight->add<DataPointLabel::InputPower>(value);
-                break;
             case DataPointLabel::InputFrequency:
-                _upDataInFlight->add<DataPointLabel::InputFrequency>(value);
-                break;
             case DataPointLabel::InputCurrent:
-                _upDataInFlight->add<DataPointLabel::InputCurrent>(value);
-                break;
             case DataPointLabel::OutputPower:
-                _upDataInFlight->add<DataPointLabel::OutputPower>(value);
-                break;
             case DataPointLabel::Efficiency:
-                _upDataInFlight->add<DataPointLabel::Efficiency>(value);
-                break;
             case DataPointLabel::OutputVoltage:
-                _upDataInFlight->add<DataPointLabel::OutputVoltage>(value);
-                break;
             case DataPointLabel::OutputCurrentMax:
-                _upDataInFlight->add<DataPointLabel::OutputCurrentMax>(value);
-                break;
             case DataPointLabel::InputVoltage:
-                _upDataInFlight->add<DataPointLabel::InputVoltage>(value);
-                break;
             case DataPointLabel::OutputTemperature:
-                _upDataInFlight->add<DataPointLabel::OutputTemperature>(value);
-                break;
             case DataPointLabel::InputTemperature:
-                _upDataInFlight->add<DataPointLabel::InputTemperature>(value);
-                break;
             case DataPointLabel::OutputCurrent:
-                _upDataInFlight->add<DataPointLabel::OutputCurrent>(value);
                 break;
+            default:
+                continue;
         }
 
+        unsigned divisor = (label == DataPointLabel::OutputCurrentMax) ? _maxCurrentMultiplier : 1024;
+        _units[unit].InFlight.set(label, static_cast<float>(msg.value)/divisor, millis());
+
         // the OutputCurent value is the last value in a data request's answer
-        // among all values we process into the data point container, so we
-        // make the in-flight container the current container.
-        if (label == DataPointLabel::OutputCurrent) {
-            _upDataCurrent = std::move(_upDataInFlight);
-        }
+        // among all values we process into the snapshot, so we publish the
+        // in-flight snapshot.
+        if (label == DataPointLabel::OutputCurrent) { publish(_units[unit]); }
     }
 
+    // all queued set-points are sent right away, such that the units
+    // receive new set-points at the same time.
     size_t queueSize = _sendQueue.size();
     for (size_t i = 0; i < queueSize; ++i) {
-        auto [setting, val] = _sendQueue.front();
+        auto parameter = _sendQueue.front();
         _sendQueue.pop();
 
+        uint16_t val = parameter.Value;
         std::array<uint8_t, 8> data = {
-            0x01, static_cast<uint8_t>(setting), 0x00, 0x00,
+            0x01, static_cast<uint8_t>(parameter.Type), 0x00, 0x00,
             0x00, 0x00, static_cast<uint8_t>((val & 0xFF00) >> 8),
             static_cast<uint8_t>(val & 0xFF)
         };
 
-        if (!sendMessage(0x108180FE, data)) {
+        if (!sendMessage(0x100080FE | addressOf(parameter.UnitIndex), data)) {
             MessageOutput.print("[Huawei::HwIfc] Failed to set parameter\r\n");
-            _sendQueue.push({setting, val});
+            _sendQueue.push(parameter);
         }
     }
 
@@ -144,59 +130,78 @@ void HardwareInterface::loop()
 
         // this should be redundant, as every answer to a data request should
         // have the OutputCurrent value, which is supposed to be the last value
-        // in the answer, and it already triggers moving the data in flight.
-        if (_upDataInFlight) {
-            _upDataCurrent = std::move(_upDataInFlight);
+        // in the answer, and it already triggers publishing the data in flight.
+        for (uint8_t unit = 0; unit < _unitCount; ++unit) {
+            if (_units[unit].InFlight.Valid != 0) { publish(_units[unit]); }
         }
     }
 }
 
 void HardwareInterface::setParameter(HardwareInterface::Setting setting, float val)
+{
+    std::array<float, MaxUnits> values;
+    values.fill(val);
+    setParameters(setting, values);
+}
+
+void HardwareInterface::setParameters(HardwareInterface::Setting setting, std::array<float, MaxUnits> const& values)
 {
     std::lock_guard<std::mutex> lock(_mutex);
 
     if (_taskHandle == nullptr) { return; }
 
-    switch (setting) {
-        case Setting::OfflineVoltage:
-        case Setting::OnlineVoltage:
-            val *= 1024;
-            break;
-        case Setting::OfflineCurrent:
-        case Setting::OnlineCurrent:
-            val *= _maxCurrentMultiplier;
-            break;
+    for (uint8_t unit = 0; unit < _unitCount; ++unit) {
+        float val = values[unit];
+
+        switch (setting) {
+            case Setting::OfflineVoltage:
+            case Setting::OnlineVoltage:
+                val *= 1024;
+                break;
+            case Setting::OfflineCurrent:
+            case Setting::OnlineCurrent:
+                val *= _maxCurrentMultiplier;
+                break;
+        }
+
+        _sendQueue.push({unit, setting, static_cast<uint16_t>(val)});
     }
 
-    _sendQueue.push({setting, static_cast<uint16_t>(val)});
     _nextRequestMillis = millis() - 1; // request param feedback immediately
 
     xTaskNotifyGive(_taskHandle);
 }
 
-std::unique_ptr<DataPointContainer> HardwareInterface::getCurrentData()
+void HardwareInterface::publish(Unit& unit)
 {
-    std::unique_ptr<DataPointContainer> upData = nullptr;
+    uint32_t seq = unit.SnapshotSeq.load(std::memory_order_relaxed);
 
-    {
-        std::lock_guard<std::mutex> lock(_mutex);
-        upData = std::move(_upDataCurrent);
-    }
+    // orders the previous increment of the sequence number before the
+    // writes to the slot, which the reader might still be copying from.
+    std::atomic_thread_fence(std::memory_order_release);
+    unit.Snapshots[(seq + 1) & 1] = unit.InFlight;
 
-    auto const& config = Configuration.get();
-    if (upData && config.Huawei.VerboseLogging) {
-        auto iter = upData->cbegin();
-        while (iter != upData->cend()) {
-            MessageOutput.printf("[Huawei::HwIfc] [%.3f] %s: %s%s\r\n",
-                static_cast<float>(iter->second.getTimestamp())/1000,
-                iter->second.getLabelText().c_str(),
-                iter->second.getValueText().c_str(),
-                iter->second.getUnitText().c_str());
-            ++iter;
-        }
-    }
+    unit.SnapshotSeq.store(seq + 1, std::memory_order_release);
+
+    unit.InFlight.Valid = 0;
+}
+
+bool HardwareInterface::getCurrentData(uint8_t unitIndex, Snapshot& snapshot)
+{
+    if (unitIndex >= _unitCount) { return false; }
+    auto& unit = _units[unitIndex];
+
+    uint32_t seq;
+
+    do {
+        seq = unit.SnapshotSeq.load(std::memory_order_acquire);
+        if (seq == unit.ConsumedSeq) { return false; }
+        snapshot = unit.Snapshots[seq & 1];
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while (seq != unit.SnapshotSeq.load(std::memory_order_relaxed));
 
-    return std::move(upData);
+    unit.ConsumedSeq = seq;
+    return true;
 }
 
 } // namespace GridCharger::Huawei
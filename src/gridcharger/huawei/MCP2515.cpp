@@ -25,6 +25,15 @@ void mcp2515Isr()
 
 std::optional<uint8_t> MCP2515::_oSpiBus = std::nullopt;
 
+// SPI instructions of the MCP2515, see datasheet section 12
+static constexpr uint8_t MCP_INSTR_READ_STATUS = 0xA0;
+static constexpr uint8_t MCP_INSTR_READ_RX0 = 0x90; // starting at RXB0SIDH
+static constexpr uint8_t MCP_INSTR_READ_RX1 = 0x94; // starting at RXB1SIDH
+static constexpr uint8_t MCP_STATUS_RX0IF = 0x01;
+static constexpr uint8_t MCP_STATUS_RX1IF = 0x02;
+
+static const SPISettings sSpiSettings(10000000, MSBFIRST, SPI_MODE0);
+
 MCP2515::~MCP2515()
 {
     detachInterrupt(digitalPinToInterrupt(_huaweiIrq));
@@ -75,11 +84,17 @@ bool MCP2515::init()
         return false;
     }
 
-    const uint32_t myMask = 0xFFFFFFFF;         // Look at all incoming bits and...
-    const uint32_t myFilter = 0x1081407F;       // filter for this message only
+    // only the answers to data requests are processed. all filters are
+    // programmed, as unused filters would otherwise match ID zero and wake
+    // up the task once in a while for nothing. the low bits of the address
+    // are not compared, such that the answers of all units pass.
+    const uint32_t myMask = 0xFFFCFFFF;         // Look at all incoming bits but the unit's and...
+    const uint32_t myFilter = DataAnswerId;     // filter for this message only
     _upCAN->init_Mask(0, 1, myMask);
-    _upCAN->init_Filt(0, 1, myFilter);
     _upCAN->init_Mask(1, 1, myMask);
+    for (uint8_t f = 0; f < 6; ++f) {
+        _upCAN->init_Filt(f, 1, myFilter);
+    }
 
     // Change to normal mode to allow messages to be transmitted
     _upCAN->setMode(MCP_NORMAL);
@@ -98,6 +113,7 @@ bool MCP2515::init()
     }
 
     sIsrTaskHandle = getTaskHandle();
+    _huaweiCs = pin.huawei_cs;
     _huaweiIrq = pin.huawei_irq;
     pinMode(_huaweiIrq, INPUT_PULLUP);
     attachInterrupt(digitalPinToInterrupt(_huaweiIrq), mcp2515Isr, FALLING);
@@ -105,27 +121,78 @@ bool MCP2515::init()
     return true;
 }
 
-bool MCP2515::getMessage(HardwareInterface::can_message_t& msg)
+uint8_t MCP2515::readStatus()
 {
-    if (!_upCAN) { return false; }
+    _upSPI->beginTransaction(sSpiSettings);
+    digitalWrite(_huaweiCs, LOW);
+    _upSPI->transfer(MCP_INSTR_READ_STATUS);
+    uint8_t status = _upSPI->transfer(0x00);
+    digitalWrite(_huaweiCs, HIGH);
+    _upSPI->endTransaction();
+    return status;
+}
 
-    INT32U rxId;
-    unsigned char len = 0;
-    unsigned char rxBuf[8];
+// the READ RX BUFFER instruction reads the whole buffer in one transaction
+// and clears the respective interrupt flag when CS is released, which saves
+// the separate register accesses the mcp_can library would do.
+void MCP2515::readRxBuffer(uint8_t instruction, RxBuffer& buffer)
+{
+    _upSPI->beginTransaction(sSpiSettings);
+    digitalWrite(_huaweiCs, LOW);
+    _upSPI->transfer(instruction);
+    _upSPI->transferBytes(nullptr, buffer.data(), buffer.size());
+    digitalWrite(_huaweiCs, HIGH);
+    _upSPI->endTransaction();
+}
 
-    while (!digitalRead(_huaweiIrq)) {
-        _upCAN->readMsgBuf(&rxId, &len, rxBuf); // Read data: len = data length, buf = data byte(s)
+bool MCP2515::decode(RxBuffer const& buffer, HardwareInterface::can_message_t& msg)
+{
+    uint8_t sidh = buffer[0];
+    uint8_t sidl = buffer[1];
 
-        // Determine if ID is standard (11 bits) or extended (29 bits)
-        if ((rxId & 0x80000000) != 0x80000000) { continue; }
+    if ((sidl & 0x08) == 0) { return false; } // we only process extended format messages
 
-        if (len != 8) { continue; }
+    if ((buffer[4] & 0x0F) != 8) { return false; }
 
-        msg.canId = rxId;
-        msg.valueId = rxBuf[0] << 24 | rxBuf[1] << 16 | rxBuf[2] << 8 | rxBuf[3];
-        msg.value = rxBuf[4] << 24 | rxBuf[5] << 16 | rxBuf[6] << 8 | rxBuf[7];
+    msg.canId = (static_cast<uint32_t>(sidh) << 21)
+        | (static_cast<uint32_t>(sidl & 0xE0) << 13)
+        | (static_cast<uint32_t>(sidl & 0x03) << 16)
+        | (static_cast<uint32_t>(buffer[2]) << 8)
+        | buffer[3];
+
+    uint8_t const* data = &buffer[5];
+    msg.valueId = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
+    msg.value = data[4] << 24 | data[5] << 16 | data[6] << 8 | data[7];
+
+    return true;
+}
+
+bool MCP2515::getMessage(HardwareInterface::can_message_t& msg)
+{
+    if (!_upCAN) { return false; }
 
-        return true;
+    while (_rxIndex < _rxCount || !digitalRead(_huaweiIrq)) {
+        if (_rxIndex < _rxCount) {
+            msg = _rxMessages[_rxIndex++];
+            return true;
+        }
+
+        // both receive buffers are read while the interrupt is pending, as
+        // the second one is filled on rollover if the first one was full.
+        _rxCount = _rxIndex = 0;
+        uint8_t status = readStatus();
+        // only the receive interrupts are enabled by the mcp_can library
+        if ((status & (MCP_STATUS_RX0IF | MCP_STATUS_RX1IF)) == 0) { return false; }
+
+        RxBuffer buffer;
+        if (status & MCP_STATUS_RX0IF) {
+            readRxBuffer(MCP_INSTR_READ_RX0, buffer);
+            if (decode(buffer, _rxMessages[_rxCount])) { ++_rxCount; }
+        }
+        if (status & MCP_STATUS_RX1IF) {
+            readRxBuffer(MCP_INSTR_READ_RX1, buffer);
+            if (decode(buffer, _rxMessages[_rxCount])) { ++_rxCount; }
+        }
     }
 
     return false;
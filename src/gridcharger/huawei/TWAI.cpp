@@ -5,34 +5,15 @@
 #include <gridcharger/huawei/TWAI.h>
 #include "MessageOutput.h"
 #include "PinMapping.h"
-#include "Configuration.h"
-#include <driver/twai.h>
 
 namespace GridCharger::Huawei {
 
 TWAI::~TWAI()
 {
-    if (_pollingTaskHandle != nullptr) {
-        _pollingTaskDone = false;
-        _stopPolling = true;
-
-        while (!_pollingTaskDone) { delay(10); }
-
-        _pollingTaskHandle = nullptr;
-    }
-
     stopLoop();
 
-    if (twai_stop() != ESP_OK) {
-        MessageOutput.print("[Huawei::TWAI] failed to stop driver\r\n");
-        return;
-    }
-
-    if (twai_driver_uninstall() != ESP_OK) {
-        MessageOutput.print("[Huawei::TWAI] failed to uninstall driver\r\n");
-    }
-
-    MessageOutput.print("[Huawei::TWAI] driver stopped and uninstalled\r\n");
+    TwaiBus.unsubscribe(_pSubscription);
+    _pSubscription = nullptr;
 }
 
 bool TWAI::init()
@@ -47,83 +28,59 @@ bool TWAI::init()
         return false;
     }
 
-    auto tx = static_cast<gpio_num_t>(pin.huawei_tx);
-    auto rx = static_cast<gpio_num_t>(pin.huawei_rx);
-    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(tx, rx, TWAI_MODE_NORMAL);
-
-    // interrupts at level 1 are in high demand, at least on ESP32-S3 boards,
-    // but only a limited amount can be allocated. failing to allocate an
-    // interrupt in the TWAI driver will cause a bootloop. we therefore
-    // register the TWAI driver's interrupt at level 2. level 2 interrupts
-    // should be available -- we don't really know. we would love to have the
-    // esp_intr_dump() function, but that's not available yet in our version
-    // of the underlying esp-idf.
-    g_config.intr_flags = ESP_INTR_FLAG_LEVEL2;
-
-    twai_timing_config_t t_config = TWAI_TIMING_CONFIG_125KBITS();
-    twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
-
-    if (twai_driver_install(&g_config, &t_config, &f_config) != ESP_OK) {
-        MessageOutput.print("[Huawei::TWAI] Failed to install driver\r\n");
-        return false;
-    }
-
-    if (twai_start() != ESP_OK) {
-        MessageOutput.print("[Huawei::TWAI] Failed to start driver\r\n");
-        return false;
-    }
-
     if (!startLoop()) {
         MessageOutput.printf("[Huawei::TWAI] failed to start loop task\r\n");
         return false;
     }
 
-    // enable alert on message received
-    uint32_t alertsToEnable = TWAI_ALERT_RX_DATA;
-    if (twai_reconfigure_alerts(alertsToEnable, NULL) != ESP_OK) {
-        MessageOutput.print("[Huawei::TWAI] Failed to configure alerts\r\n");
+    // the answers to data requests are the only messages processed. the
+    // filter compares all identifier bits of extended frames, but neither
+    // the RTR bit nor the unused bits, nor the low bits of the address,
+    // such that the answers of all units pass.
+    static constexpr uint32_t UnitBits = 0x3 << 16; // addresses 0x81 to 0x83
+    twai_filter_config_t f_config = {
+        .acceptance_code = DataAnswerId << 3,
+        .acceptance_mask = 0x7 | (UnitBits << 3),
+        .single_filter = true
+    };
+
+    TwaiBusClass::Config config = {
+        .Name = "Huawei",
+        .TxPin = pin.huawei_tx,
+        .RxPin = pin.huawei_rx,
+        .Bitrate = 125000,
+        .Extended = true,
+        .FirstId = DataAnswerId,
+        .LastId = (DataAnswerId & ~AddressMask) | addressOf(MaxUnits - 1),
+        .Filter = f_config,
+        .QueueLength = 32,
+        // wake up hardware interface task to actually receive the message
+        .NotifyTask = getTaskHandle()
+    };
+
+    _pSubscription = TwaiBus.subscribe(config);
+    if (_pSubscription == nullptr) {
+        MessageOutput.print("[Huawei::TWAI] failed to subscribe to CAN bus\r\n");
+        stopLoop();
         return false;
     }
 
-    uint32_t constexpr stackSize = 1536;
-    return pdPASS == xTaskCreate(TWAI::pollAlerts,
-            "HuaweiTwai", stackSize, this, 20/*prio*/, &_pollingTaskHandle);
-
     MessageOutput.print("[Huawei::TWAI] driver ready\r\n");
 
     return true;
 }
 
-void TWAI::pollAlerts(void* context)
-{
-    auto& instance = *static_cast<TWAI*>(context);
-    uint32_t alerts;
-
-    while (!instance._stopPolling) {
-        if (twai_read_alerts(&alerts, pdMS_TO_TICKS(500)) != ESP_OK) { continue; }
-
-        if (alerts & TWAI_ALERT_RX_DATA) {
-            // wake up hardware interface task to actually receive the message
-            xTaskNotifyGive(instance.getTaskHandle());
-        }
-    }
-
-    instance._pollingTaskDone = true;
-
-    vTaskDelete(nullptr);
-}
-
 bool TWAI::getMessage(HardwareInterface::can_message_t& msg)
 {
+    if (_pSubscription == nullptr) { return false; }
+
     while (true) {
         twai_message_t rxMessage;
 
         // it's okay if we cannot receive a message now, as the hardware
         // interface task wakes up for reasons other than a message being
         // received, but always checks if a message is available.
-        if (twai_receive(&rxMessage, pdMS_TO_TICKS(1)) != ESP_OK) { return false; }
-
-        if (rxMessage.extd != 1) { continue; } // we only process extended format messages
+        if (!_pSubscription->receive(rxMessage)) { return false; }
 
         if (rxMessage.data_length_code != 8) { continue; }
 
@@ -146,7 +103,7 @@ bool TWAI::sendMessage(uint32_t canId, std::array<uint8_t, 8> const& data)
     txMsg.data_length_code = data.size();
     txMsg.identifier = canId;
 
-    return twai_transmit(&txMsg, pdMS_TO_TICKS(1000)) == ESP_OK;
+    return TwaiBus.transmit(txMsg, pdMS_TO_TICKS(1000));
 }
 
 } // namespace GridCharger::Huawei
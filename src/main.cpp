@@ -2,14 +2,30 @@
 /*
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
+#include "Aggregates.h"
+#include "BootProfiler.h"
 #include "Configuration.h"
+#include "ControlLatency.h"
+#include "DataBus.h"
 #include "Datastore.h"
 #include "Display_Graphic.h"
+#include "DplCluster.h"
+#include "EnergyMeter.h"
+#include "EventStore.h"
+#include "FileHashCache.h"
+#include "HeapMonitor.h"
+#include "History.h"
 #include "I18n.h"
+#include "InfluxExporter.h"
+#include "InverterCache.h"
 #include "InverterSettings.h"
 #include "Led_Single.h"
+#include "MemoryPolicy.h"
 #include "MessageOutput.h"
+#include "ModbusTcpServer.h"
+#include "NightMode.h"
 #include "SerialPortManager.h"
+#include "StateStore.h"
 #include <battery/Controller.h>
 #include <gridcharger/huawei/Controller.h>
 #include "MqttHandleDtu.h"
@@ -19,6 +35,7 @@
 #include "MqttHandleHuawei.h"
 #include "MqttHandlePowerLimiter.h"
 #include "MqttHandlePowerLimiterHass.h"
+#include "MqttHassPublisher.h"
 #include "MqttSettings.h"
 #include "NetworkSettings.h"
 #include "NtpSettings.h"
@@ -27,7 +44,9 @@
 #include "Scheduler.h"
 #include "SunPosition.h"
 #include "Utils.h"
+#include "WarmRestart.h"
 #include "WebApi.h"
+#include "WsMonitor.h"
 #include <powermeter/Controller.h>
 #include "PowerLimiter.h"
 #include "defaults.h"
@@ -36,12 +55,11 @@
 #include <LittleFS.h>
 #include <SpiManager.h>
 #include <TaskScheduler.h>
-#include <esp_heap_caps.h>
 
 void setup()
 {
-    // Move all dynamic allocations >512byte to psram (if available)
-    heap_caps_malloc_extmem_enable(512);
+    // Move large dynamic allocations to psram (if available)
+    MemoryPolicy::init();
 
     // Initialize SpiManager
     SpiManagerInst.register_bus(SPI2_HOST);
@@ -57,10 +75,12 @@ void setup()
         yield();
 #endif
     MessageOutput.init(scheduler);
+    HeapMonitor.init(scheduler);
     MessageOutput.println();
     MessageOutput.println("Starting OpenDTU");
 
     // Initialize file system
+    BootProfiler.stage("Filesystem");
     MessageOutput.print("Initialize FS... ");
     if (!LittleFS.begin(false)) { // Do not format if mount failed
         MessageOutput.print("failed... trying to format...");
@@ -74,6 +94,7 @@ void setup()
     }
 
     // Read configuration values
+    BootProfiler.stage("Configuration");
     Configuration.init(scheduler);
     MessageOutput.print("Reading configuration... ");
     if (!Configuration.read()) {
@@ -94,12 +115,17 @@ void setup()
     auto& config = Configuration.get();
     MessageOutput.println("done");
 
+    WarmRestart.init();
+
     // Read languate pack
+    BootProfiler.stage("Language pack");
     MessageOutput.print("Reading language pack... ");
     I18n.init(scheduler);
+    FileHashCache.init(scheduler);
     MessageOutput.println("done");
 
     // Load PinMapping
+    BootProfiler.stage("Pin mapping");
     MessageOutput.print("Reading PinMapping... ");
     if (PinMapping.init(Configuration.get().Dev_PinMapping)) {
         MessageOutput.print("found valid mapping ");
@@ -112,27 +138,37 @@ void setup()
     SerialPortManager.init();
 
     // Initialize Network
+    BootProfiler.stage("Network");
     MessageOutput.print("Initialize Network... ");
     NetworkSettings.init(scheduler);
     MessageOutput.println("done");
     NetworkSettings.applyConfig();
 
+    // the radios wait for their hardware most of the time. they are set up
+    // while the following stages run, which do not use the Hoymiles library.
+    // started after the network, such that a W5500 claims its SPI bus first.
+    auto radios = BootProfiler.startWorker("Radios", []() { InverterSettings.initRadios(); });
+
     // Initialize NTP
+    BootProfiler.stage("NTP");
     MessageOutput.print("Initialize NTP... ");
     NtpSettings.init();
     MessageOutput.println("done");
 
     // Initialize SunPosition
+    BootProfiler.stage("Sun position");
     MessageOutput.print("Initialize SunPosition... ");
     SunPosition.init(scheduler);
     MessageOutput.println("done");
 
     // Initialize MqTT
+    BootProfiler.stage("MQTT");
     MessageOutput.print("Initialize MqTT... ");
-    MqttSettings.init();
+    MqttSettings.init(scheduler);
     MqttHandleDtu.init(scheduler);
     MqttHandleInverter.init(scheduler);
     MqttHandleInverterTotal.init(scheduler);
+    MqttHassPublisher.init(scheduler);
     MqttHandleHass.init(scheduler);
     MqttHandleHuawei.init(scheduler);
     MqttHandlePowerLimiter.init(scheduler);
@@ -140,11 +176,14 @@ void setup()
     MessageOutput.println("done");
 
     // Initialize WebApi
+    BootProfiler.stage("Web API");
     MessageOutput.print("Initialize WebApi... ");
+    WsMonitor.init(scheduler);
     WebApi.init(scheduler);
     MessageOutput.println("done");
 
     // Initialize Display
+    BootProfiler.stage("Display");
     MessageOutput.print("Initialize Display... ");
     Display.init(
         scheduler,
@@ -163,24 +202,52 @@ void setup()
     MessageOutput.println("done");
 
     // Initialize Single LEDs
+    BootProfiler.stage("LEDs");
     MessageOutput.print("Initialize LEDs... ");
     LedSingle.init(scheduler);
     MessageOutput.println("done");
 
+    // the DataBus registers a callback with the Hoymiles library
+    BootProfiler.join(radios);
+
+    BootProfiler.stage("Inverters");
+    DataBus.init();
+    StateStore.init(scheduler);
     InverterSettings.init(scheduler);
+    InverterCache.init(scheduler);
+    NightMode.init(scheduler);
+    InverterCache.restore();
+    WarmRestart.restoreInverters();
 
     Datastore.init(scheduler);
     RestartHelper.init(scheduler);
 
     // OpenDTU-OnBattery-specific initializations go below
+    BootProfiler.stage("Solar charger");
     SolarCharger.init(scheduler);
+    BootProfiler.stage("Power meter");
     PowerMeter.init(scheduler);
+    BootProfiler.stage("Power limiter");
     PowerLimiter.init(scheduler);
+    ControlLatency.init(scheduler);
+    DplCluster.init(scheduler);
+    BootProfiler.stage("Grid charger");
     HuaweiCan.init(scheduler);
+    BootProfiler.stage("Battery");
     Battery.init(scheduler);
+    WarmRestart.restoreBattery();
+    BootProfiler.stage("History and exporters");
+    History.init(scheduler);
+    EventStore.init(scheduler);
+    EnergyMeter.init(scheduler);
+    Aggregates.init(scheduler);
+    InfluxExporter.init(scheduler);
+    ModbusTcpServer.init(scheduler);
+
+    BootProfiler.finish();
 }
 
 void loop()
 {
-    scheduler.execute();
+    executeScheduler();
 }
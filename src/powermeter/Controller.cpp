@@ -1,12 +1,36 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include <powermeter/Controller.h>
 #include <Configuration.h>
+#include <MessageOutput.h>
+#include <MqttSettings.h>
+#include <PowerLimiter.h>
+#include <Features.h>
+#if FEATURE_POWERMETER_HTTP_JSON
 #include <powermeter/json/http/Provider.h>
+#endif
+#if FEATURE_POWERMETER_MQTT
 #include <powermeter/json/mqtt/Provider.h>
+#endif
+#if FEATURE_POWERMETER_SDM
 #include <powermeter/sdm/serial/Provider.h>
+#endif
+#if FEATURE_POWERMETER_HTTP_SML
 #include <powermeter/sml/http/Provider.h>
+#endif
+#if FEATURE_POWERMETER_SERIAL_SML
 #include <powermeter/sml/serial/Provider.h>
+#endif
+#if FEATURE_POWERMETER_SMAHM
 #include <powermeter/udp/smahm/Provider.h>
+#endif
+#if FEATURE_POWERMETER_UDP_PUSH
+#include <powermeter/udp/push/Provider.h>
+#endif
+#if FEATURE_POWERMETER_SHELLY_RPC
+#include <powermeter/json/shelly/Provider.h>
+#endif
+#include <cmath>
+#include <TaskProfiler.h>
 
 PowerMeters::Controller PowerMeter;
 
@@ -15,84 +39,331 @@ namespace PowerMeters {
 void Controller::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&Controller::loop, this));
+    _loopTask.setCallback(TaskProfiler.wrap("PowerMeter::loop", std::bind(&Controller::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
 
     updateSettings();
 }
 
-void Controller::updateSettings()
+std::unique_ptr<Provider> Controller::createProvider(Provider::Type type)
 {
-    std::lock_guard<std::mutex> l(_mutex);
-
-    if (_upProvider) { _upProvider.reset(); }
-
     auto const& pmcfg = Configuration.get().PowerMeter;
 
-    if (!pmcfg.Enabled) { return; }
+    if (!Features::isPowerMeterProviderAvailable(type)) {
+        MessageOutput.printf("[PowerMeters::Controller] Source %s is not "
+                "available in this build\r\n", getSourceName(type));
+        return nullptr;
+    }
 
-    switch(static_cast<Provider::Type>(pmcfg.Source)) {
+    switch(type) {
+#if FEATURE_POWERMETER_MQTT
         case Provider::Type::MQTT:
-            _upProvider = std::make_unique<::PowerMeters::Json::Mqtt::Provider>(pmcfg.Mqtt);
-            break;
+            return std::make_unique<::PowerMeters::Json::Mqtt::Provider>(pmcfg.Mqtt);
+#endif
+#if FEATURE_POWERMETER_SDM
         case Provider::Type::SDM1PH:
-            _upProvider = std::make_unique<::PowerMeters::Sdm::Serial::Provider>(
+            return std::make_unique<::PowerMeters::Sdm::Serial::Provider>(
                     ::PowerMeters::Sdm::Serial::Provider::Phases::One, pmcfg.SerialSdm);
-            break;
         case Provider::Type::SDM3PH:
-            _upProvider = std::make_unique<::PowerMeters::Sdm::Serial::Provider>(
+            return std::make_unique<::PowerMeters::Sdm::Serial::Provider>(
                     ::PowerMeters::Sdm::Serial::Provider::Phases::Three, pmcfg.SerialSdm);
-            break;
+#endif
+#if FEATURE_POWERMETER_HTTP_JSON
         case Provider::Type::HTTP_JSON:
-            _upProvider = std::make_unique<::PowerMeters::Json::Http::Provider>(pmcfg.HttpJson);
-            break;
+            return std::make_unique<::PowerMeters::Json::Http::Provider>(pmcfg.HttpJson);
+#endif
+#if FEATURE_POWERMETER_SERIAL_SML
         case Provider::Type::SERIAL_SML:
-            _upProvider = std::make_unique<::PowerMeters::Sml::Serial::Provider>();
-            break;
+            return std::make_unique<::PowerMeters::Sml::Serial::Provider>();
+#endif
+#if FEATURE_POWERMETER_SMAHM
         case Provider::Type::SMAHM2:
-            _upProvider = std::make_unique<::PowerMeters::Udp::SmaHM::Provider>();
-            break;
+            return std::make_unique<::PowerMeters::Udp::SmaHM::Provider>(pmcfg.UdpSmaHm);
+#endif
+#if FEATURE_POWERMETER_HTTP_SML
         case Provider::Type::HTTP_SML:
-            _upProvider = std::make_unique<::PowerMeters::Sml::Http::Provider>(pmcfg.HttpSml);
+            return std::make_unique<::PowerMeters::Sml::Http::Provider>(pmcfg.HttpSml);
+#endif
+#if FEATURE_POWERMETER_UDP_PUSH
+        case Provider::Type::UDP_PUSH:
+            return std::make_unique<::PowerMeters::Udp::Push::Provider>(pmcfg.UdpPush);
+#endif
+#if FEATURE_POWERMETER_SHELLY_RPC
+        case Provider::Type::SHELLY_RPC:
+            return std::make_unique<::PowerMeters::Json::Shelly::Provider>(pmcfg.ShellyRpc);
+#endif
+        default:
             break;
     }
 
-    if (!_upProvider->init()) {
-        _upProvider = nullptr;
+    return nullptr;
+}
+
+char const* Controller::getSourceName(Provider::Type type)
+{
+    switch(type) {
+        case Provider::Type::MQTT: return "MQTT";
+        case Provider::Type::SDM1PH: return "SDM 1 phase";
+        case Provider::Type::SDM3PH: return "SDM 3 phases";
+        case Provider::Type::HTTP_JSON: return "HTTP(S) + JSON";
+        case Provider::Type::SERIAL_SML: return "SML serial";
+        case Provider::Type::SMAHM2: return "SMA Homemanager 2.0";
+        case Provider::Type::HTTP_SML: return "HTTP(S) + SML";
+        case Provider::Type::UDP_PUSH: return "UDP push";
+        case Provider::Type::SHELLY_RPC: return "Shelly RPC";
+    }
+
+    return "unknown";
+}
+
+char const* Controller::getSourceKey(Provider::Type type)
+{
+    switch(type) {
+        case Provider::Type::MQTT: return "mqtt";
+        case Provider::Type::SDM1PH: return "sdm1ph";
+        case Provider::Type::SDM3PH: return "sdm3ph";
+        case Provider::Type::HTTP_JSON: return "http_json";
+        case Provider::Type::SERIAL_SML: return "serial_sml";
+        case Provider::Type::SMAHM2: return "smahm2";
+        case Provider::Type::HTTP_SML: return "http_sml";
+        case Provider::Type::UDP_PUSH: return "udp_push";
+        case Provider::Type::SHELLY_RPC: return "shelly_rpc";
+    }
+
+    return "unknown";
+}
+
+std::vector<Controller::SourceDiagnostics> Controller::getDiagnostics() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+
+    std::vector<SourceDiagnostics> res;
+    for (auto const& source : _sources) {
+        res.push_back({ source.Type, getSourceKey(source.Type),
+                source.upProvider->getDiagnostics() });
+    }
+
+    return res;
+}
+
+// must be called while holding the mutex
+void Controller::publishDiagnostics() const
+{
+    using Metric = Diagnostics::Metric;
+    using Failure = Diagnostics::Failure;
+
+    auto& topics = MqttTopicRegistry;
+    char subtopic[32];
+
+    for (auto const& source : _sources) {
+        auto key = getSourceKey(source.Type);
+        auto snapshot = source.upProvider->getDiagnostics();
+
+        for (size_t m = 0; m < Diagnostics::MetricCount; ++m) {
+            auto const& histogram = snapshot.Metrics[m];
+            auto name = Diagnostics::getName(static_cast<Metric>(m));
+
+            snprintf(subtopic, sizeof(subtopic), "/%s/count", name);
+            MqttSettings.publish(topics.intern("powermeter/diagnostics/", key, subtopic),
+                    histogram.Count, 0);
+
+            if (histogram.Count == 0) { continue; }
+
+            snprintf(subtopic, sizeof(subtopic), "/%s/average_ms", name);
+            MqttSettings.publish(topics.intern("powermeter/diagnostics/", key, subtopic),
+                    histogram.Sum / 1000.0 / histogram.Count, 3);
+        }
+
+        for (size_t f = 0; f < Diagnostics::FailureCount; ++f) {
+            snprintf(subtopic, sizeof(subtopic), "/failures/%s",
+                    Diagnostics::getName(static_cast<Failure>(f)));
+            MqttSettings.publish(topics.intern("powermeter/diagnostics/", key, subtopic),
+                    snapshot.Failures[f], 0);
+        }
+    }
+}
+
+void Controller::updateSettings()
+{
+    std::lock_guard<std::mutex> l(_mutex);
+
+    // destroy the providers first, as they might occupy resources (e.g.,
+    // a UART) that the new providers need.
+    _sources.clear();
+    _estimator.reset();
+    _lastEstimatorUpdate = 0;
+
+    auto const& pmcfg = Configuration.get().PowerMeter;
+
+    if (!pmcfg.Enabled) { return; }
+
+    std::vector<Provider::Type> types = { static_cast<Provider::Type>(pmcfg.Source) };
+    if (pmcfg.Fusion.Enabled && pmcfg.Fusion.Source != pmcfg.Source) {
+        types.push_back(static_cast<Provider::Type>(pmcfg.Fusion.Source));
+    }
+
+    for (auto type : types) {
+        auto upProvider = createProvider(type);
+
+        if (!upProvider || !upProvider->init()) {
+            MessageOutput.printf("[PowerMeters::Controller] Initializing source "
+                    "%s failed\r\n", getSourceName(type));
+            continue;
+        }
+
+        _sources.push_back({ type, std::move(upProvider) });
+    }
+
+    if (!_sources.empty()) { _lastActiveType = _sources.front().Type; }
+}
+
+Controller::Source const* Controller::getActiveSource() const
+{
+    if (_sources.empty()) { return nullptr; }
+
+    Source const* pActive = nullptr;
+    uint32_t activeAge = 0;
+
+    for (auto const& source : _sources) {
+        if (!source.upProvider->isDataValid()) { continue; }
+
+        uint32_t age = millis() - source.upProvider->getLastUpdate();
+        if (pActive == nullptr || age < activeAge) {
+            pActive = &source;
+            activeAge = age;
+        }
     }
+
+    // without any valid reading, report the (stale) primary source
+    if (pActive == nullptr) { return &_sources.front(); }
+
+    return pActive;
 }
 
 float Controller::getPowerTotal() const
 {
     std::lock_guard<std::mutex> l(_mutex);
-    if (!_upProvider) { return 0.0; }
-    return _upProvider->getPowerTotal();
+    auto pSource = getActiveSource();
+    if (!pSource) { return 0.0; }
+    return pSource->upProvider->getPowerTotal();
 }
 
 uint32_t Controller::getLastUpdate() const
 {
     std::lock_guard<std::mutex> l(_mutex);
-    if (!_upProvider) { return 0; }
-    return _upProvider->getLastUpdate();
+    auto pSource = getActiveSource();
+    if (!pSource) { return 0; }
+    return pSource->upProvider->getLastUpdate();
+}
+
+uint32_t Controller::getMeasuredMillis() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    auto pSource = getActiveSource();
+    if (!pSource) { return 0; }
+    return pSource->upProvider->getMeasuredMillis();
 }
 
 bool Controller::isDataValid() const
 {
     std::lock_guard<std::mutex> l(_mutex);
-    if (!_upProvider) { return false; }
-    return _upProvider->isDataValid();
+    auto pSource = getActiveSource();
+    if (!pSource) { return false; }
+    return pSource->upProvider->isDataValid();
+}
+
+char const* Controller::getActiveSourceName() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    auto pSource = getActiveSource();
+    if (!pSource) { return "none"; }
+    return getSourceName(pSource->Type);
+}
+
+std::optional<float> Controller::getEstimatedLoad() const
+{
+    if (!Configuration.get().PowerMeter.PredictiveFilter) { return std::nullopt; }
+
+    std::lock_guard<std::mutex> l(_mutex);
+    auto pSource = getActiveSource();
+    if (!pSource || !pSource->upProvider->isDataValid()) { return std::nullopt; }
+    return _estimator.getLoad(millis());
+}
+
+std::optional<float> Controller::getPredictedPowerTotal() const
+{
+    auto oLoad = getEstimatedLoad();
+    if (!oLoad) { return std::nullopt; }
+    return *oLoad - PowerLimiter.getBehindPowerMeterOutputAt(millis());
+}
+
+float Controller::getEstimatorResidual() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    return _estimator.getResidual();
 }
 
 void Controller::loop()
 {
     std::lock_guard<std::mutex> lock(_mutex);
-    if (!_upProvider) { return; }
-    _upProvider->loop();
+    if (_sources.empty()) { return; }
+
+    for (auto const& source : _sources) {
+        source.upProvider->loop();
+    }
+
+    auto pActive = getActiveSource();
 
     auto const& pmcfg = Configuration.get().PowerMeter;
-    if (pmcfg.Source == static_cast<uint8_t>(Provider::Type::MQTT)) { return; }
-    _upProvider->mqttLoop();
+
+    // feed each new reading into the estimator, paired with the output that
+    // the inverters behind the power meter produced when it was taken.
+    uint32_t measuredMillis = pActive->upProvider->getMeasuredMillis();
+    if (pmcfg.PredictiveFilter && pActive->upProvider->isDataValid()
+            && measuredMillis != _lastEstimatorUpdate) {
+        float load = pActive->upProvider->getPowerTotal()
+            + PowerLimiter.getBehindPowerMeterOutputAt(measuredMillis);
+        _estimator.update(measuredMillis, load);
+        _lastEstimatorUpdate = measuredMillis;
+    }
+
+    if (_sources.size() > 1) {
+        if (pActive->Type != _lastActiveType) {
+            MessageOutput.printf("[PowerMeters::Controller] Switched from source "
+                    "%s to %s\r\n", getSourceName(_lastActiveType),
+                    getSourceName(pActive->Type));
+            _lastActiveType = pActive->Type;
+        }
+
+        // cross-check the readings of both sources, if both are valid
+        auto const& primary = *_sources[0].upProvider;
+        auto const& secondary = *_sources[1].upProvider;
+        if (primary.isDataValid() && secondary.isDataValid()
+                && pmcfg.Fusion.MaxDeviation > 0
+                && millis() - _lastDeviationWarning > 60 * 1000) {
+            float deviation = std::abs(primary.getPowerTotal() - secondary.getPowerTotal());
+            if (deviation > pmcfg.Fusion.MaxDeviation) {
+                MessageOutput.printf("[PowerMeters::Controller] Readings of %s "
+                        "(%.1f W) and %s (%.1f W) deviate by %.1f W\r\n",
+                        getSourceName(_sources[0].Type), primary.getPowerTotal(),
+                        getSourceName(_sources[1].Type), secondary.getPowerTotal(),
+                        deviation);
+                _lastDeviationWarning = millis();
+            }
+        }
+    }
+
+    if (MqttSettings.acceptsPublishes()
+            && millis() - _lastDiagnosticsPublish > 60 * 1000) {
+        publishDiagnostics();
+        _lastDiagnosticsPublish = millis();
+    }
+
+    // only the active source publishes, such that the topics are not
+    // written alternately by multiple sources.
+    if (pActive->Type == Provider::Type::MQTT) { return; }
+    pActive->upProvider->mqttLoop();
 }
 
 } // namespace PowerMeters
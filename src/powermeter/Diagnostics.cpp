@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <powermeter/Diagnostics.h>
+#include <algorithm>
+
+namespace PowerMeters {
+
+char const* Diagnostics::getName(Metric metric)
+{
+    switch (metric) {
+    case Metric::Latency: return "latency";
+    case Metric::Interval: return "interval";
+    case Metric::ParseTime: return "parse_time";
+    case Metric::Count: break;
+    }
+    return "unknown";
+}
+
+char const* Diagnostics::getName(Failure failure)
+{
+    switch (failure) {
+    case Failure::Request: return "request";
+    case Failure::Timeout: return "timeout";
+    case Failure::Checksum: return "checksum";
+    case Failure::Parse: return "parse";
+    case Failure::Incomplete: return "incomplete";
+    case Failure::Sequence: return "sequence";
+    case Failure::Count: break;
+    }
+    return "unknown";
+}
+
+Diagnostics::Bounds const& Diagnostics::getBounds(Metric metric)
+{
+    // the HTTP meters answer within tens to hundreds of milliseconds,
+    // readings arrive every few hundred milliseconds up to a minute and
+    // decoding takes microseconds to milliseconds.
+    static constexpr Bounds latency = { 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000 };
+    static constexpr Bounds interval = { 250000, 500000, 1000000, 2000000, 5000000, 10000000, 30000000, 60000000 };
+    static constexpr Bounds parseTime = { 100, 250, 500, 1000, 2500, 5000, 10000, 25000 };
+
+    switch (metric) {
+    case Metric::Latency: return latency;
+    case Metric::Interval: return interval;
+    default: break;
+    }
+    return parseTime;
+}
+
+void Diagnostics::record(Metric metric, uint32_t micros)
+{
+    auto const& bounds = getBounds(metric);
+    size_t bucket = std::lower_bound(bounds.begin(), bounds.end(), micros) - bounds.begin();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto& histogram = _snapshot.Metrics[static_cast<size_t>(metric)];
+    ++histogram.Buckets[bucket];
+    ++histogram.Count;
+    histogram.Sum += micros;
+}
+
+void Diagnostics::record(Failure failure)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_snapshot.Failures[static_cast<size_t>(failure)];
+}
+
+Diagnostics::Snapshot Diagnostics::get() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _snapshot;
+}
+
+} // namespace PowerMeters
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <powermeter/Estimator.h>
+#include <algorithm>
+#include <limits>
+
+namespace PowerMeters {
+
+void Estimator::reset()
+{
+    _initialized = false;
+    _trend = 0;
+    _residual = 0;
+}
+
+void Estimator::update(uint32_t measuredAt, float load)
+{
+    uint32_t dt = measuredAt - _lastMeasurement;
+
+    if (!_initialized || dt == 0 || dt > MaxGapMillis) {
+        _initialized = true;
+        _lastMeasurement = measuredAt;
+        _load = load;
+        _trend = 0;
+        _residual = 0;
+        return;
+    }
+
+    float forecast = _load + _trend * std::min(dt, MaxForecastMillis);
+    _residual = load - forecast;
+
+    _load = forecast + Alpha * _residual;
+    _trend += Beta * _residual / dt;
+    _lastMeasurement = measuredAt;
+}
+
+std::optional<float> Estimator::getLoad(uint32_t at) const
+{
+    if (!_initialized) { return std::nullopt; }
+
+    // the time might be slightly before the last measurement
+    auto constexpr halfOfAllMillis = std::numeric_limits<uint32_t>::max() / 2;
+    uint32_t dt = at - _lastMeasurement;
+    if (dt > halfOfAllMillis) { return _load; }
+
+    if (dt > MaxGapMillis) { return std::nullopt; }
+
+    return _load + _trend * std::min(dt, MaxForecastMillis);
+}
+
+} // namespace PowerMeters
@@ -1,6 +1,9 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include <powermeter/Provider.h>
+#include <DataBus.h>
 #include <MqttSettings.h>
+#include <algorithm>
+#include <limits>
 
 namespace PowerMeters {
 
@@ -9,14 +12,34 @@ bool Provider::isDataValid() const
     return _lastUpdate > 0 && ((millis() - _lastUpdate) < (30 * 1000));
 }
 
-void Provider::mqttPublish(String const& topic, float const& value) const
+void Provider::gotUpdate()
 {
-    MqttSettings.publish("powermeter/" + topic, String(value));
+    gotUpdate(millis());
+}
+
+void Provider::gotUpdate(uint32_t takenMillis)
+{
+    uint32_t now = millis();
+    uint32_t last = _lastUpdate;
+    if (last > 0) {
+        auto constexpr maxMillis = std::numeric_limits<uint32_t>::max() / 1000;
+        _diagnostics.record(Diagnostics::Metric::Interval,
+                std::min(now - last, maxMillis) * 1000);
+    }
+
+    _measuredMillis = takenMillis;
+    _lastUpdate = now;
+    DataBus.publish(DataBusClass::Topic::PowerMeter);
+}
+
+void Provider::mqttPublish(char const* topic, float const& value) const
+{
+    MqttSettings.publish(MqttTopicRegistry.intern("powermeter/", topic), value, 2);
 }
 
 void Provider::mqttLoop() const
 {
-    if (!MqttSettings.getConnected()) { return; }
+    if (!MqttSettings.acceptsPublishes()) { return; }
 
     if (!isDataValid()) { return; }
 
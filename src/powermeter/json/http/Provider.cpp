@@ -2,6 +2,7 @@
 #include <Utils.h>
 #include <powermeter/json/http/Provider.h>
 #include <MessageOutput.h>
+#include <TaskPlacement.h>
 #include <WiFiClientSecure.h>
 #include <ArduinoJson.h>
 #include <mbedtls/sha256.h>
@@ -24,6 +25,13 @@ Provider::~Provider()
         while (!_taskDone) { delay(10); }
         _taskHandle = nullptr;
     }
+
+    for (auto& fetcher : _fetchers) {
+        if (fetcher.taskHandle == nullptr) { continue; }
+        xTaskNotifyGive(fetcher.taskHandle);
+        while (!fetcher.taskDone) { delay(10); }
+        fetcher.taskHandle = nullptr;
+    }
 }
 
 bool Provider::init()
@@ -33,6 +41,11 @@ bool Provider::init()
 
         _httpGetters[i] = nullptr;
 
+        _jsonPaths[i] = JsonPath(valueConfig.JsonPath);
+        if (!_cfg.IndividualRequests && valueConfig.Enabled) {
+            _jsonPaths[i].addToFilter(_sharedFilter);
+        }
+
         if (i == 0 || (_cfg.IndividualRequests && valueConfig.Enabled)) {
             _httpGetters[i] = std::make_unique<HttpGetter>(valueConfig.HttpRequest);
         }
@@ -62,8 +75,45 @@ void Provider::loop()
     lock.unlock();
 
     uint32_t constexpr stackSize = 3072;
-    xTaskCreate(Provider::pollingLoopHelper, "PM:HTTP+JSON",
-            stackSize, this, 1/*prio*/, &_taskHandle);
+
+    for (uint8_t i = 1; i < POWERMETER_HTTP_JSON_MAX_VALUES; i++) {
+        if (!_httpGetters[i]) { continue; }
+
+        auto& fetcher = _fetchers[i];
+        fetcher.pProvider = this;
+        fetcher.idx = i;
+        fetcher.taskDone = false;
+        TaskPlacement::create(TaskPlacement::Role::NetworkPowerMeter,
+                Provider::fetcherLoopHelper, "PM:HTTP+JSON", stackSize,
+                &fetcher, &fetcher.taskHandle);
+    }
+
+    TaskPlacement::create(TaskPlacement::Role::NetworkPowerMeter,
+            Provider::pollingLoopHelper, "PM:HTTP+JSON", stackSize,
+            this, &_taskHandle);
+}
+
+void Provider::fetcherLoopHelper(void* context)
+{
+    auto pFetcher = static_cast<Fetcher*>(context);
+    auto pProvider = pFetcher->pProvider;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        std::unique_lock<std::mutex> lock(pProvider->_pollingMutex);
+        bool stop = pProvider->_stopPolling;
+        lock.unlock();
+
+        if (stop) { break; }
+
+        pFetcher->result = pProvider->fetchValue(pFetcher->idx);
+        pFetcher->resultMillis = millis();
+        xTaskNotifyGive(pFetcher->requester);
+    }
+
+    pFetcher->taskDone = true;
+    vTaskDelete(nullptr);
 }
 
 void Provider::pollingLoopHelper(void* context)
@@ -101,73 +151,173 @@ void Provider::pollingLoop()
 
         MessageOutput.printf("[PowerMeters::Json::Http] New total: %.2f\r\n", getPowerTotal());
 
-        gotUpdate();
+        uint32_t takenMillis;
+        {
+            std::lock_guard<std::mutex> l(_valueMutex);
+            takenMillis = _powerValuesMillis;
+        }
+
+        // the total is as old as its oldest component
+        gotUpdate(takenMillis);
     }
 }
 
-Provider::poll_result_t Provider::poll()
+String Provider::fetchDocument(uint8_t idx, JsonDocument& json, JsonDocument const& filter)
+{
+    auto const& upGetter = _httpGetters[idx];
+    if (!upGetter) {
+        return "Programmer error: no HTTP getter for this value";
+    }
+
+    uint32_t requestMicros = micros();
+    auto res = upGetter->performGetRequest();
+    if (!res) {
+        _diagnostics.record(Diagnostics::Failure::Request);
+        return upGetter->getErrorText();
+    }
+    _diagnostics.record(Diagnostics::Metric::Latency, micros() - requestMicros);
+
+    auto pStream = res.getStream();
+    if (!pStream) {
+        return "Programmer error: HTTP request yields no stream";
+    }
+
+    // parses the response while it is received, keeping only what the
+    // filter selects, so large status documents need little memory. the
+    // parse time hence includes receiving the body.
+    uint32_t parseMicros = micros();
+    const DeserializationError error = deserializeJson(json, *pStream,
+            DeserializationOption::Filter(filter));
+    if (error) {
+        _diagnostics.record(Diagnostics::Failure::Parse);
+        return String("Unable to parse server response as JSON: ") + error.c_str();
+    }
+    _diagnostics.record(Diagnostics::Metric::ParseTime, micros() - parseMicros);
+
+    return "";
+}
+
+Provider::value_result_t Provider::fetchValue(uint8_t idx)
 {
-    power_values_t cache;
     JsonDocument jsonResponse;
 
-    auto prefixedError = [](uint8_t idx, char const* err) -> String {
-        String res("Value ");
-        res.reserve(strlen(err) + 16);
-        return res + String(idx + 1) + ": " + err;
-    };
+    auto error = fetchDocument(idx, jsonResponse, _jsonPaths[idx].getFilter());
+    if (!error.isEmpty()) { return error; }
 
+    return extractValue(idx, jsonResponse);
+}
+
+Provider::value_result_t Provider::extractValue(uint8_t idx, JsonDocument const& json) const
+{
+    auto const& cfg = _cfg.Values[idx];
+
+    auto pathResolutionResult = _jsonPaths[idx].getValue<float>(json);
+    if (!pathResolutionResult.second.isEmpty()) {
+        _diagnostics.record(Diagnostics::Failure::Incomplete);
+        return pathResolutionResult.second;
+    }
+
+    // this value is supposed to be in Watts and positive if energy is consumed
+    float value = pathResolutionResult.first;
+
+    switch (cfg.PowerUnit) {
+        case Unit_t::MilliWatts:
+            value /= 1000;
+            break;
+        case Unit_t::KiloWatts:
+            value *= 1000;
+            break;
+        default:
+            break;
+    }
+
+    if (cfg.SignInverted) { value *= -1; }
+
+    return value;
+}
+
+Provider::poll_result_t Provider::poll()
+{
+    std::array<value_result_t, POWERMETER_HTTP_JSON_MAX_VALUES> results;
+    std::array<uint32_t, POWERMETER_HTTP_JSON_MAX_VALUES> resultMillis = {};
+
+    // start the concurrent requests first
+    uint8_t pending = 0;
     for (uint8_t i = 0; i < POWERMETER_HTTP_JSON_MAX_VALUES; i++) {
-        auto const& cfg = _cfg.Values[i];
+        auto& fetcher = _fetchers[i];
+        if (!_cfg.Values[i].Enabled || fetcher.taskHandle == nullptr) { continue; }
+
+        fetcher.requester = xTaskGetCurrentTaskHandle();
+        xTaskNotifyGive(fetcher.taskHandle);
+        ++pending;
+    }
+
+    JsonDocument jsonResponse;
+    String sharedError;
+    bool fetched = false;
 
-        if (!cfg.Enabled) {
-            cache[i] = 0.0;
+    for (uint8_t i = 0; i < POWERMETER_HTTP_JSON_MAX_VALUES; i++) {
+        if (!_cfg.Values[i].Enabled) {
+            results[i] = 0.0f;
             continue;
         }
 
-        auto const& upGetter = _httpGetters[i];
-
-        if (upGetter) {
-            auto res = upGetter->performGetRequest();
-            if (!res) {
-                return prefixedError(i, upGetter->getErrorText());
-            }
+        if (_fetchers[i].taskHandle != nullptr) { continue; }
 
-            auto pStream = res.getStream();
-            if (!pStream) {
-                return prefixedError(i, "Programmer error: HTTP request yields no stream");
-            }
+        if (_cfg.IndividualRequests) {
+            results[i] = fetchValue(i);
+            resultMillis[i] = millis();
+            continue;
+        }
 
-            const DeserializationError error = deserializeJson(jsonResponse, *pStream);
-            if (error) {
-                String msg("Unable to parse server response as JSON: ");
-                return prefixedError(i, String(msg + error.c_str()).c_str());
-            }
+        // all values are extracted from the response to the first request
+        if (!fetched) {
+            sharedError = fetchDocument(0, jsonResponse, _sharedFilter);
+            fetched = true;
         }
 
-        auto pathResolutionResult = Utils::getJsonValueByPath<float>(jsonResponse, cfg.JsonPath);
-        if (!pathResolutionResult.second.isEmpty()) {
-            return prefixedError(i, pathResolutionResult.second.c_str());
+        resultMillis[i] = millis();
+
+        if (!sharedError.isEmpty()) {
+            results[i] = sharedError;
+            continue;
         }
 
-        // this value is supposed to be in Watts and positive if energy is consumed
-        cache[i] = pathResolutionResult.first;
-
-        switch (cfg.PowerUnit) {
-            case Unit_t::MilliWatts:
-                cache[i] /= 1000;
-                break;
-            case Unit_t::KiloWatts:
-                cache[i] *= 1000;
-                break;
-            default:
-                break;
+        results[i] = extractValue(i, jsonResponse);
+    }
+
+    for (; pending > 0; --pending) {
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+    }
+
+    power_values_t cache;
+    std::optional<uint32_t> oOldestMillis;
+
+    for (uint8_t i = 0; i < POWERMETER_HTTP_JSON_MAX_VALUES; i++) {
+        bool fetchedByWorker = _fetchers[i].taskHandle != nullptr && _cfg.Values[i].Enabled;
+        auto const& result = fetchedByWorker ? _fetchers[i].result : results[i];
+
+        if (std::holds_alternative<String>(result)) {
+            auto const& err = std::get<String>(result);
+            String res("Value ");
+            res.reserve(err.length() + 16);
+            return String(res + String(i + 1) + ": " + err);
         }
 
-        if (cfg.SignInverted) { cache[i] *= -1; }
+        cache[i] = std::get<float>(result);
+
+        if (!_cfg.Values[i].Enabled) { continue; }
+
+        // compares ages rather than timestamps to cope with wrap-arounds
+        uint32_t takenMillis = fetchedByWorker ? _fetchers[i].resultMillis : resultMillis[i];
+        if (!oOldestMillis || (millis() - takenMillis) > (millis() - *oOldestMillis)) {
+            oOldestMillis = takenMillis;
+        }
     }
 
     std::unique_lock<std::mutex> lock(_valueMutex);
     _powerValues = cache;
+    _powerValuesMillis = oOldestMillis.value_or(millis());
     return cache;
 }
 
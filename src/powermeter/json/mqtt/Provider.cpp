@@ -9,22 +9,24 @@ namespace PowerMeters::Json::Mqtt {
 
 bool Provider::init()
 {
-    auto subscribe = [this](PowerMeterMqttValue const& val, float* targetVariable) {
+    auto subscribe = [this](PowerMeterMqttValue const& val, float* targetVariable,
+            JsonPath* jsonPath) {
         *targetVariable = 0;
         char const* topic = val.Topic;
         if (strlen(topic) == 0) { return; }
+        *jsonPath = JsonPath(val.JsonPath);
         MqttSettings.subscribe(topic, 0,
                 std::bind(&Provider::onMessage,
                     this, std::placeholders::_1, std::placeholders::_2,
                     std::placeholders::_3, std::placeholders::_4,
                     std::placeholders::_5, std::placeholders::_6,
-                    targetVariable, &val)
+                    targetVariable, &val, jsonPath)
                 );
         _mqttSubscriptions.push_back(topic);
     };
 
     for (size_t i = 0; i < _powerValues.size(); ++i) {
-        subscribe(_cfg.Values[i], &_powerValues[i]);
+        subscribe(_cfg.Values[i], &_powerValues[i], &_jsonPaths[i]);
     }
 
     return _mqttSubscriptions.size() > 0;
@@ -38,13 +40,19 @@ Provider::~Provider()
 
 void Provider::onMessage(Provider::MsgProperties const& properties,
         char const* topic, uint8_t const* payload, size_t len, size_t index,
-        size_t total, float* targetVariable, PowerMeterMqttValue const* cfg)
+        size_t total, float* targetVariable, PowerMeterMqttValue const* cfg,
+        JsonPath const* jsonPath)
 {
+    uint32_t parseMicros = micros();
     auto extracted = Utils::getNumericValueFromMqttPayload<float>("PowerMeters::Json::Mqtt",
-            std::string(reinterpret_cast<const char*>(payload), len), topic,
-            cfg->JsonPath);
+            std::string_view(reinterpret_cast<const char*>(payload), len), topic,
+            *jsonPath);
 
-    if (!extracted.has_value()) { return; }
+    if (!extracted.has_value()) {
+        _diagnostics.record(Diagnostics::Failure::Parse);
+        return;
+    }
+    _diagnostics.record(Diagnostics::Metric::ParseTime, micros() - parseMicros);
 
     float newValue = *extracted;
 
@@ -0,0 +1,337 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <powermeter/json/shelly/Provider.h>
+#include <MessageOutput.h>
+#include <TaskPlacement.h>
+#include <Utils.h>
+#include <esp_system.h>
+#include <mbedtls/sha256.h>
+#include <limits>
+#include <optional>
+
+namespace PowerMeters::Json::Shelly {
+
+namespace {
+
+// the status is requested if no notification arrived for this long, and a
+// request which was not answered within the timeout is given up.
+constexpr uint32_t quietMillis = 2000;
+constexpr uint32_t requestTimeoutMillis = 5000;
+
+constexpr int bufferSize = 2048;
+constexpr int stackSize = 4096;
+
+char const* const phaseKeys[] = { "a_act_power", "b_act_power", "c_act_power" };
+
+String sha256(String const& data)
+{
+    uint8_t hash[32];
+
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0); // select SHA256
+    mbedtls_sha256_update(&ctx, reinterpret_cast<const unsigned char*>(data.c_str()), data.length());
+    mbedtls_sha256_finish(&ctx, hash);
+    mbedtls_sha256_free(&ctx);
+
+    char hex[sizeof(hash) * 2 + 1];
+    for (size_t i = 0; i < sizeof(hash); ++i) {
+        snprintf(hex + i * 2, 3, "%02x", hash[i]);
+    }
+    return String(hex);
+}
+
+} // namespace
+
+Provider::Provider(PowerMeterShellyRpcConfig const& cfg)
+    : _cfg(cfg)
+    , _component(String("em:") + cfg.EmId)
+{
+    auto addPowers = [](JsonObject status) {
+        status["total_act_power"] = true;
+        for (auto key : phaseKeys) { status[key] = true; }
+    };
+
+    // responses carry the status as result, notifications as parameter
+    _filter["id"] = true;
+    _filter["method"] = true;
+    _filter["error"] = true;
+    addPowers(_filter["result"].to<JsonObject>());
+    addPowers(_filter["params"][_component].to<JsonObject>());
+
+    _message.reserve(bufferSize);
+}
+
+Provider::~Provider()
+{
+    // stops the websocket task, hence no event is handled afterwards
+    if (_client != nullptr) { esp_websocket_client_destroy(_client); }
+}
+
+bool Provider::init()
+{
+    if (strlen(_cfg.Hostname) == 0) {
+        MessageOutput.printf("[PowerMeters::Json::Shelly] No hostname configured\r\n");
+        return false;
+    }
+
+    String uri = String("ws://") + _cfg.Hostname + "/rpc";
+
+    esp_websocket_client_config_t config = {};
+    config.uri = uri.c_str();
+    config.buffer_size = bufferSize;
+    config.task_stack = stackSize;
+    config.task_prio = TaskPlacement::get(TaskPlacement::Role::NetworkPowerMeter).Priority;
+
+    _client = esp_websocket_client_init(&config);
+    if (_client == nullptr) {
+        MessageOutput.printf("[PowerMeters::Json::Shelly] Cannot create websocket client\r\n");
+        return false;
+    }
+
+    esp_websocket_register_events(_client, WEBSOCKET_EVENT_ANY, &Provider::onEventHelper, this);
+
+    if (esp_websocket_client_start(_client) != ESP_OK) {
+        MessageOutput.printf("[PowerMeters::Json::Shelly] Cannot connect to %s\r\n", uri.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void Provider::loop()
+{
+    if (_client == nullptr || !esp_websocket_client_is_connected(_client)) { return; }
+
+    uint32_t now = millis();
+
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        if (_requestPending) {
+            if ((now - _requestMillis) < requestTimeoutMillis) { return; }
+            _requestPending = false;
+            _diagnostics.record(Diagnostics::Failure::Timeout);
+        }
+    }
+
+    if ((now - _lastMessage) < quietMillis) { return; }
+
+    sendStatusRequest();
+}
+
+float Provider::getPowerTotal() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    return _power;
+}
+
+void Provider::doMqttPublish() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    mqttPublish("power1", _phases[0]);
+    mqttPublish("power2", _phases[1]);
+    mqttPublish("power3", _phases[2]);
+}
+
+void Provider::sendStatusRequest()
+{
+    JsonDocument request;
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+
+        _requestId = (_requestId % std::numeric_limits<int32_t>::max()) + 1;
+        _requestMillis = millis();
+        _requestPending = true;
+
+        request["id"] = _requestId;
+
+        if (_authValid) {
+            String cnonce(esp_random());
+            String ha2 = sha256("dummy_method:dummy_uri");
+
+            auto auth = request["auth"].to<JsonObject>();
+            auth["realm"] = _authRealm;
+            auth["username"] = "admin";
+            auth["nonce"] = _authNonce;
+            auth["cnonce"] = cnonce;
+            auth["response"] = sha256(_authHa1 + ":" + String(_authNonce) + ":1:" + cnonce + ":auth:" + ha2);
+            auth["algorithm"] = "SHA-256";
+        }
+    }
+
+    // the source is the address of the notifications
+    request["src"] = String("opendtu-") + String(Utils::getChipId(), HEX);
+    request["method"] = "EM.GetStatus";
+    request["params"]["id"] = _cfg.EmId;
+
+    String payload;
+    serializeJson(request, payload);
+
+    if (esp_websocket_client_send_text(_client, payload.c_str(), payload.length(), pdMS_TO_TICKS(1000)) < 0) {
+        std::lock_guard<std::mutex> l(_mutex);
+        _requestPending = false;
+        _diagnostics.record(Diagnostics::Failure::Request);
+    }
+}
+
+void Provider::onEventHelper(void* context, esp_event_base_t base,
+        int32_t eventId, void* eventData)
+{
+    auto pInstance = static_cast<Provider*>(context);
+    pInstance->onEvent(eventId, static_cast<esp_websocket_event_data_t const*>(eventData));
+}
+
+void Provider::onEvent(int32_t eventId, esp_websocket_event_data_t const* data)
+{
+    switch (eventId) {
+        case WEBSOCKET_EVENT_CONNECTED:
+            MessageOutput.printf("[PowerMeters::Json::Shelly] Connected to %s\r\n", _cfg.Hostname);
+            {
+                std::lock_guard<std::mutex> l(_mutex);
+                _requestPending = false;
+            }
+            // identifies us as peer, which subscribes to the notifications
+            sendStatusRequest();
+            break;
+
+        case WEBSOCKET_EVENT_DISCONNECTED:
+            MessageOutput.printf("[PowerMeters::Json::Shelly] Disconnected from %s\r\n", _cfg.Hostname);
+            _diagnostics.record(Diagnostics::Failure::Request);
+            break;
+
+        case WEBSOCKET_EVENT_DATA:
+            // text frames only, possibly received in several chunks
+            if (data->op_code != 0x01 && data->op_code != 0x00) { break; }
+            if (data->payload_offset == 0) { _message.clear(); }
+            _message.insert(_message.end(), data->data_ptr, data->data_ptr + data->data_len);
+            if (data->payload_offset + data->data_len >= data->payload_len) { handleMessage(); }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void Provider::handleMessage()
+{
+    uint32_t parseMicros = micros();
+    uint32_t arrival = millis();
+    _lastMessage = arrival;
+
+    JsonDocument doc;
+    auto error = deserializeJson(doc, _message.data(), _message.size(),
+            DeserializationOption::Filter(_filter));
+    if (error) {
+        _diagnostics.record(Diagnostics::Failure::Parse);
+        MessageOutput.printf("[PowerMeters::Json::Shelly] Cannot parse message: %s\r\n", error.c_str());
+        return;
+    }
+
+    JsonObjectConst status;
+    std::optional<uint32_t> requestMillis;
+
+    if (doc["method"].is<char const*>()) {
+        // NotifyStatus or NotifyFullStatus, possibly of another component
+        status = doc["params"][_component];
+        if (status.isNull()) { return; }
+    } else {
+        {
+            std::lock_guard<std::mutex> l(_mutex);
+            if (!_requestPending || doc["id"] != _requestId) { return; }
+            _requestPending = false;
+            requestMillis = _requestMillis;
+        }
+
+        if (!doc["error"].isNull()) {
+            handleError(doc["error"]);
+            return;
+        }
+
+        status = doc["result"];
+    }
+
+    bool updated = false;
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+
+        // notifications only carry the values which changed
+        if (status["total_act_power"].is<float>()) {
+            _power = status["total_act_power"].as<float>();
+            updated = true;
+        }
+
+        for (size_t i = 0; i < _phases.size(); ++i) {
+            if (!status[phaseKeys[i]].is<float>()) { continue; }
+            _phases[i] = status[phaseKeys[i]].as<float>();
+        }
+    }
+
+    _diagnostics.record(Diagnostics::Metric::ParseTime, micros() - parseMicros);
+
+    if (requestMillis) {
+        if (!updated) {
+            _diagnostics.record(Diagnostics::Failure::Incomplete);
+            return;
+        }
+        _diagnostics.record(Diagnostics::Metric::Latency, (arrival - *requestMillis) * 1000);
+    }
+
+    if (!updated) { return; }
+
+    if (_verboseLogging) {
+        MessageOutput.printf("[PowerMeters::Json::Shelly] %s: %.1f W\r\n",
+                (requestMillis ? "Status" : "Notification"), getPowerTotal());
+    }
+
+    gotUpdate();
+}
+
+void Provider::handleError(JsonObjectConst error)
+{
+    int code = error["code"] | 0;
+    char const* message = error["message"] | "";
+
+    if (code != 401) {
+        _diagnostics.record(Diagnostics::Failure::Request);
+        MessageOutput.printf("[PowerMeters::Json::Shelly] Error %d: %s\r\n", code, message);
+        return;
+    }
+
+    // the challenge is a JSON document within the error message
+    JsonDocument challenge;
+    bool stale;
+    bool valid = false;
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        stale = _authValid;
+        _authValid = false;
+
+        if (deserializeJson(challenge, message) == DeserializationError::Ok
+                && challenge["algorithm"] == "SHA-256"
+                && challenge["nonce"].is<uint32_t>()) {
+            String realm = challenge["realm"] | "";
+            if (realm != _authRealm || _authHa1.isEmpty()) {
+                _authRealm = realm;
+                _authHa1 = sha256(String("admin:") + realm + ":" + _cfg.Password);
+            }
+            _authNonce = challenge["nonce"].as<uint32_t>();
+            valid = _authValid = strlen(_cfg.Password) > 0;
+        }
+    }
+
+    _diagnostics.record(Diagnostics::Failure::Request);
+
+    if (!valid) {
+        MessageOutput.printf("[PowerMeters::Json::Shelly] Authentication "
+                "required, check the password\r\n");
+        return;
+    }
+
+    // an expired nonce is renewed silently, a rejected password is not
+    // retried right away, but with the next request.
+    if (stale && _verboseLogging) {
+        MessageOutput.printf("[PowerMeters::Json::Shelly] Authentication renewed\r\n");
+    }
+    if (!stale) { sendStatusRequest(); }
+}
+
+} // namespace PowerMeters::Json::Shelly
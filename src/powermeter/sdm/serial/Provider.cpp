@@ -2,9 +2,23 @@
 #include <powermeter/sdm/serial/Provider.h>
 #include <PinMapping.h>
 #include <MessageOutput.h>
+#include <TaskPlacement.h>
+#include <algorithm>
 
 namespace PowerMeters::Sdm::Serial {
 
+Provider::Provider(Phases phases, PowerMeterSerialSdmConfig const& cfg)
+    : _phases(phases)
+    , _cfg(cfg)
+{
+    _meters.push_back({ static_cast<uint8_t>(_cfg.Address), _phases });
+
+    if (_cfg.SubMeterAddress > 0 && _cfg.SubMeterAddress != _cfg.Address) {
+        _meters.push_back({ static_cast<uint8_t>(_cfg.SubMeterAddress),
+                _cfg.SubMeterThreePhases ? Phases::Three : Phases::One });
+    }
+}
+
 Provider::~Provider()
 {
     _taskDone = false;
@@ -64,14 +78,16 @@ void Provider::loop()
     lock.unlock();
 
     uint32_t constexpr stackSize = 3072;
-    xTaskCreate(Provider::pollingLoopHelper, "PM:SDM",
-            stackSize, this, 1/*prio*/, &_taskHandle);
+    TaskPlacement::create(TaskPlacement::Role::SerialPowerMeter,
+            Provider::pollingLoopHelper, "PM:SDM", stackSize,
+            this, &_taskHandle);
 }
 
 float Provider::getPowerTotal() const
 {
     std::lock_guard<std::mutex> l(_valueMutex);
-    return _phase1Power + _phase2Power + _phase3Power;
+    auto const& power = _meters.front().Power;
+    return power[0] + power[1] + power[2];
 }
 
 bool Provider::isDataValid() const
@@ -80,19 +96,31 @@ bool Provider::isDataValid() const
     return getLastUpdate() > 0 && (age < (3 * _cfg.PollingInterval * 1000));
 }
 
+void Provider::mqttPublishMeter(Meter const& meter, String const& prefix) const
+{
+    mqttPublish(prefix + "power1", meter.Power[0]);
+    mqttPublish(prefix + "voltage1", meter.Voltage[0]);
+    mqttPublish(prefix + "import", meter.Energy[0]);
+    mqttPublish(prefix + "export", meter.Energy[1]);
+
+    if (meter.MeterPhases == Phases::Three) {
+        mqttPublish(prefix + "power2", meter.Power[1]);
+        mqttPublish(prefix + "power3", meter.Power[2]);
+        mqttPublish(prefix + "voltage2", meter.Voltage[1]);
+        mqttPublish(prefix + "voltage3", meter.Voltage[2]);
+    }
+}
+
 void Provider::doMqttPublish() const
 {
     std::lock_guard<std::mutex> l(_valueMutex);
-    mqttPublish("power1", _phase1Power);
-    mqttPublish("voltage1", _phase1Voltage);
-    mqttPublish("import", _energyImport);
-    mqttPublish("export", _energyExport);
-
-    if (_phases == Phases::Three) {
-        mqttPublish("power2", _phase2Power);
-        mqttPublish("power3", _phase3Power);
-        mqttPublish("voltage2", _phase2Voltage);
-        mqttPublish("voltage3", _phase3Voltage);
+    mqttPublishMeter(_meters.front(), "");
+
+    for (size_t i = 1; i < _meters.size(); ++i) {
+        auto const& meter = _meters[i];
+        auto prefix = "submeter" + String(meter.Address) + "/";
+        mqttPublish(prefix + "powertotal", meter.Power[0] + meter.Power[1] + meter.Power[2]);
+        mqttPublishMeter(meter, prefix);
     }
 }
 
@@ -104,46 +132,75 @@ void Provider::pollingLoopHelper(void* context)
     vTaskDelete(nullptr);
 }
 
-bool Provider::readValue(std::unique_lock<std::mutex>& lock, uint16_t reg, float& targetVar)
+bool Provider::readValues(std::unique_lock<std::mutex>& lock, Request const& request)
 {
-    lock.unlock(); // reading values takes too long to keep holding the lock
-    float val = _upSdm->readVal(reg, _cfg.Address);
+    uint32_t requestMicros = micros();
+
+    lock.unlock(); // sending takes too long to keep holding the lock
+    _upSdm->startReadVals(request.Reg, request.Count, request.Address);
     lock.lock();
 
-    // we additionally check in between each transaction whether or not we are
-    // actually asked to stop polling altogether. otherwise, the destructor of
-    // this instance might need to wait for a whole while until the task ends.
+    // the reply is awaited without blocking the lock, such that we can
+    // check whether or not we are actually asked to stop polling
+    // altogether. otherwise, the destructor of this instance might need to
+    // wait for a whole while until the task ends.
+    uint16_t err = SDM_ERR_STILL_WAITING;
+    while (!_stopPolling) {
+        lock.unlock();
+        err = _upSdm->readValsReady(request.Count, request.Address);
+        lock.lock();
+
+        if (err != SDM_ERR_STILL_WAITING) { break; }
+
+        _cv.wait_for(lock, std::chrono::milliseconds(2),
+                [this] { return _stopPolling; }); // releases the mutex
+    }
+
     if (_stopPolling) { return false; }
 
-    auto err = _upSdm->getErrCode(true/*clear error code*/);
+    uint16_t reg = request.Reg;
+    uint8_t count = request.Count;
+    uint8_t address = request.Address;
+
+    _upSdm->clearErrCode();
 
     switch (err) {
         case SDM_ERR_NO_ERROR:
+            _diagnostics.record(Diagnostics::Metric::Latency, micros() - requestMicros);
+
             if (_verboseLogging) {
-                MessageOutput.printf("[PowerMeters::Sdm::Serial]: read register %d "
-                        "(0x%04x) successfully\r\n", reg, reg);
+                MessageOutput.printf("[PowerMeters::Sdm::Serial]: read %d values "
+                        "from register %d (0x%04x) of meter %d successfully\r\n",
+                        count, reg, reg, address);
             }
 
-            targetVar = val;
+            for (uint8_t i = 0; i < count; ++i) {
+                request.pTargets[i] = _upSdm->decodeFloatValue(i);
+            }
             return true;
             break;
         case SDM_ERR_CRC_ERROR:
+            _diagnostics.record(Diagnostics::Failure::Checksum);
             MessageOutput.printf("[PowerMeters::Sdm::Serial]: CRC error "
                     "while reading register %d (0x%04x)\r\n", reg, reg);
             break;
         case SDM_ERR_WRONG_BYTES:
+            _diagnostics.record(Diagnostics::Failure::Parse);
             MessageOutput.printf("[PowerMeters::Sdm::Serial]: unexpected data in "
                     "message while reading register %d (0x%04x)\r\n", reg, reg);
             break;
         case SDM_ERR_NOT_ENOUGHT_BYTES:
+            _diagnostics.record(Diagnostics::Failure::Incomplete);
             MessageOutput.printf("[PowerMeters::Sdm::Serial]: unexpected end of "
                     "message while reading register %d (0x%04x)\r\n", reg, reg);
             break;
         case SDM_ERR_TIMEOUT:
+            _diagnostics.record(Diagnostics::Failure::Timeout);
             MessageOutput.printf("[PowerMeters::Sdm::Serial]: timeout occured "
                     "while reading register %d (0x%04x)\r\n", reg, reg);
             break;
         default:
+            _diagnostics.record(Diagnostics::Failure::Request);
             MessageOutput.printf("[PowerMeters::Sdm::Serial]: unknown SDM error "
                     "code after reading register %d (0x%04x)\r\n", reg, reg);
             break;
@@ -168,47 +225,53 @@ void Provider::pollingLoop()
 
         _lastPoll = millis();
 
-        // reading takes a "very long" time as each readVal() is a synchronous
-        // exchange of serial messages. cache the values and write later to
-        // enforce consistent values.
-        float phase1Power = 0.0;
-        float phase2Power = 0.0;
-        float phase3Power = 0.0;
-        float phase1Voltage = 0.0;
-        float phase2Voltage = 0.0;
-        float phase3Voltage = 0.0;
-        float energyImport = 0.0;
-        float energyExport = 0.0;
-
-        bool success = readValue(lock, SDM_PHASE_1_POWER, phase1Power) &&
-            readValue(lock, SDM_PHASE_1_VOLTAGE, phase1Voltage) &&
-            readValue(lock, SDM_IMPORT_ACTIVE_ENERGY, energyImport) &&
-            readValue(lock, SDM_EXPORT_ACTIVE_ENERGY, energyExport);
-
-        if (success && _phases == Phases::Three) {
-            success = readValue(lock, SDM_PHASE_2_POWER, phase2Power) &&
-                readValue(lock, SDM_PHASE_3_POWER, phase3Power) &&
-                readValue(lock, SDM_PHASE_2_VOLTAGE, phase2Voltage) &&
-                readValue(lock, SDM_PHASE_3_VOLTAGE, phase3Voltage);
+        // the phases' values are stored in consecutive registers, such that
+        // each kind of value is read in a single request. voltages and energy
+        // counters are not needed for regulation and are read less often to
+        // keep the power readings fresh. all meters share the bus, so their
+        // requests are issued one after another. reading still takes a
+        // while, so the values are cached and written later to enforce
+        // consistent values.
+        bool slowPoll = _lastSlowPoll == 0 ||
+            (millis() - _lastSlowPoll) >= _cfg.SlowPollingInterval * 1000;
+
+        std::vector<Meter> meters;
+        {
+            std::lock_guard<std::mutex> l(_valueMutex);
+            meters = _meters;
+        }
+
+        std::vector<Request> requests;
+        for (auto& meter : meters) {
+            uint8_t phases = (meter.MeterPhases == Phases::Three) ? 3 : 1;
+            requests.push_back({ meter.Address, SDM_PHASE_1_POWER, phases, meter.Power.data() });
+
+            if (!slowPoll) { continue; }
+
+            requests.push_back({ meter.Address, SDM_PHASE_1_VOLTAGE, phases, meter.Voltage.data() });
+            requests.push_back({ meter.Address, SDM_IMPORT_ACTIVE_ENERGY, 2, meter.Energy.data() });
+        }
+
+        bool success = true;
+        for (auto const& request : requests) {
+            if (!readValues(lock, request)) {
+                success = false;
+                break;
+            }
         }
 
         if (!success) { continue; }
 
         {
             std::lock_guard<std::mutex> l(_valueMutex);
-            _phase1Power = static_cast<float>(phase1Power);
-            _phase2Power = static_cast<float>(phase2Power);
-            _phase3Power = static_cast<float>(phase3Power);
-            _phase1Voltage = static_cast<float>(phase1Voltage);
-            _phase2Voltage = static_cast<float>(phase2Voltage);
-            _phase3Voltage = static_cast<float>(phase3Voltage);
-            _energyImport = static_cast<float>(energyImport);
-            _energyExport = static_cast<float>(energyExport);
+            _meters = std::move(meters);
+            if (slowPoll) { _lastSlowPoll = _lastPoll; }
         }
 
         MessageOutput.printf("[PowerMeters::Sdm::Serial] TotalPower: %5.2f\r\n", getPowerTotal());
 
-        gotUpdate();
+        // the power registers are read first
+        gotUpdate(_lastPoll);
     }
 }
 
@@ -33,16 +33,55 @@ void Provider::doMqttPublish() const
 }
 
 void Provider::reset()
+{
+    if (_frameStartMillis != 0) {
+        _diagnostics.record(Diagnostics::Failure::Incomplete);
+    }
+
+    clear();
+}
+
+void Provider::clear()
 {
     smlReset();
     _cache = { std::nullopt };
+    _frameStartMillis = 0;
+    _parseMicros = 0;
+    _decodedValues = 0;
+}
+
+bool Provider::hasExpectedValues() const
+{
+    // the total power is the first handler
+    return (_expectedValues & 1) != 0
+        && (_decodedValues & _expectedValues) == _expectedValues;
+}
+
+void Provider::takeValues()
+{
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        _values = _cache;
+    }
+    _diagnostics.record(Diagnostics::Metric::ParseTime,
+            _parseMicros + (micros() - _chunkStartMicros));
+    gotUpdate(_frameStartMillis);
+    clear();
+    _chunkStartMicros = micros();
+    ++_completedFrames;
+    MessageOutput.printf("[%s] TotalPower: %5.2f\r\n",
+            _user.c_str(), getPowerTotal());
 }
 
 void Provider::processSmlByte(uint8_t byte)
 {
+    // millis() is never zero once the first frame can have arrived
+    if (_frameStartMillis == 0) { _frameStartMillis = millis(); }
+
     switch (smlState(byte)) {
         case SML_LISTEND:
-            for (auto& handler: smlHandlerList) {
+            for (size_t i = 0; i < smlHandlerList.size(); ++i) {
+                auto const& handler = smlHandlerList[i];
                 if (!smlOBISCheck(handler.OBIS)) { continue; }
 
                 float helper = 0.0;
@@ -53,19 +92,19 @@ void Provider::processSmlByte(uint8_t byte)
                             _user.c_str(), handler.name, helper);
                 }
 
-                std::lock_guard<std::mutex> l(_mutex);
-                *handler.target = helper;
+                // the cache is only accessed by the parsing task
+                _cache.*handler.target = helper;
+                _decodedValues |= (1 << i);
+                break;
             }
             break;
         case SML_FINAL:
-            gotUpdate();
-            _values = _cache;
-            reset();
-            MessageOutput.printf("[%s] TotalPower: %5.2f\r\n",
-                    _user.c_str(), getPowerTotal());
+            _expectedValues |= _decodedValues;
+            takeValues();
             break;
         case SML_CHECKSUM_ERROR:
-            reset();
+            _diagnostics.record(Diagnostics::Failure::Checksum);
+            clear();
             MessageOutput.printf("[%s] checksum verification failed\r\n",
                     _user.c_str());
             break;
@@ -74,4 +113,20 @@ void Provider::processSmlByte(uint8_t byte)
     }
 }
 
+void Provider::processSmlBytes(uint8_t const* data, size_t length)
+{
+    // the checksum is computed by the parser as the bytes pass through
+    _chunkStartMicros = micros();
+    for (size_t i = 0; i < length; ++i) {
+        processSmlByte(data[i]);
+    }
+
+    // a frame completed within this chunk restarted the measurement. the
+    // values might be taken right after this chunk.
+    if (_frameStartMillis != 0) {
+        _parseMicros += micros() - _chunkStartMicros;
+        _chunkStartMicros = micros();
+    }
+}
+
 } // namespace PowerMeters::Sml
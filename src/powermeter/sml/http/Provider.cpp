@@ -1,9 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include <powermeter/sml/http/Provider.h>
 #include <MessageOutput.h>
+#include <TaskPlacement.h>
 #include <WiFiClientSecure.h>
 #include <base64.h>
 #include <ESPmDNS.h>
+#include <algorithm>
 
 namespace PowerMeters::Sml::Http {
 
@@ -46,8 +48,9 @@ void Provider::loop()
     lock.unlock();
 
     uint32_t constexpr stackSize = 3072;
-    xTaskCreate(Provider::pollingLoopHelper, "PM:HTTP+SML",
-            stackSize, this, 1/*prio*/, &_taskHandle);
+    TaskPlacement::create(TaskPlacement::Role::NetworkPowerMeter,
+            Provider::pollingLoopHelper, "PM:HTTP+SML", stackSize,
+            this, &_taskHandle);
 }
 
 void Provider::pollingLoopHelper(void* context)
@@ -80,10 +83,7 @@ void Provider::pollingLoop()
 
         if (!res.isEmpty()) {
             MessageOutput.printf("[PowerMeters::Sml::Http] %s\r\n", res.c_str());
-            continue;
         }
-
-        gotUpdate();
     }
 }
 
@@ -99,22 +99,70 @@ String Provider::poll()
         return "Initialization of HTTP request failed";
     }
 
+    uint32_t requestMicros = micros();
     auto res = _upHttpGetter->performGetRequest();
     if (!res) {
+        _diagnostics.record(Diagnostics::Failure::Request);
         return _upHttpGetter->getErrorText();
     }
+    _diagnostics.record(Diagnostics::Metric::Latency, micros() - requestMicros);
 
     auto pStream = res.getStream();
     if (!pStream) {
         return "Programmer error: HTTP request yields no stream";
     }
 
-    while (pStream->available()) {
-        processSmlByte(pStream->read());
+    // the body is parsed while it arrives, so it is never buffered as a
+    // whole. reading ends once a frame was complete or, as TCP ensures the
+    // integrity of the data, once the values of previous frames were
+    // decoded, which spares receiving the rest of large documents.
+    int remaining = res.getSize(); // -1 if unknown
+
+    // the meter is expected to answer with its current values
+    startFrame(_lastPoll);
+
+    uint32_t frames = getCompletedFrames();
+    uint32_t lastDataMillis = millis();
+
+    uint8_t chunk[64];
+    while (remaining != 0 && getCompletedFrames() == frames) {
+        int available = pStream->available();
+        if (available <= 0) {
+            if (!res.isConnected()) { break; }
+            if (millis() - lastDataMillis > _cfg.HttpRequest.Timeout) {
+                res.close();
+                ::PowerMeters::Sml::Provider::reset();
+                _diagnostics.record(Diagnostics::Failure::Timeout);
+                return "Timeout while receiving the response";
+            }
+            delay(1);
+            continue;
+        }
+
+        size_t toRead = std::min<size_t>(available, sizeof(chunk));
+        if (remaining > 0) { toRead = std::min<size_t>(toRead, remaining); }
+
+        size_t length = pStream->readBytes(chunk, toRead);
+        if (length == 0) { break; }
+        if (remaining > 0) { remaining -= length; }
+        lastDataMillis = millis();
+
+        processSmlBytes(chunk, length);
+
+        if (getCompletedFrames() == frames && hasExpectedValues()) {
+            takeValues();
+        }
     }
 
+    // unread data would otherwise precede the next response
+    if (remaining != 0) { res.close(); }
+
     ::PowerMeters::Sml::Provider::reset();
 
+    if (getCompletedFrames() == frames) {
+        return "No complete SML frame received";
+    }
+
     return "";
 }
 
@@ -1,7 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include <powermeter/sml/serial/Provider.h>
+#include <InputCapture.h>
 #include <PinMapping.h>
 #include <MessageOutput.h>
+#include <SerialPortManager.h>
+#include <TaskPlacement.h>
+#include <algorithm>
 
 namespace PowerMeters::Sml::Serial {
 
@@ -17,6 +21,28 @@ bool Provider::init()
         return false;
     }
 
+    // the hardware UARTs are shared with other components. once they are
+    // all taken, we fall back to a software UART.
+    if (SerialPortManager.hasFreePort()) {
+        auto oHwSerialPort = SerialPortManager.allocatePort(_serialPortOwner);
+        if (!oHwSerialPort) { return false; }
+
+        _upHwSerial = std::make_unique<HardwareSerial>(*oHwSerialPort);
+        _upHwSerial->end(); // make sure the UART will be re-initialized
+        _upHwSerial->setRxBufferSize(_bufCapacity); // must precede begin()
+        _upHwSerial->begin(_baud, SERIAL_8N1, pin.powermeter_rx, -1/*tx pin*/);
+        _upHwSerial->setRxTimeout(_rxTimeoutSymbols);
+
+        // runs in the UART event task once the RX line became idle
+        _upHwSerial->onReceive([this]() {
+            if (_taskHandle != nullptr) { xTaskNotifyGive(_taskHandle); }
+        }, true/*only on timeout*/);
+
+        return true;
+    }
+
+    SerialPortManager.registerSoftwarePort(_serialPortOwner);
+
     pinMode(pin.powermeter_rx, INPUT);
     _upSmlSerial = std::make_unique<SoftwareSerial>();
     _upSmlSerial->begin(_baud, SWSERIAL_8N1, pin.powermeter_rx, -1/*tx pin*/,
@@ -37,8 +63,9 @@ void Provider::loop()
     lock.unlock();
 
     uint32_t constexpr stackSize = 3072;
-    xTaskCreate(Provider::pollingLoopHelper, "PM:SML",
-            stackSize, this, 1/*prio*/, &_taskHandle);
+    TaskPlacement::create(TaskPlacement::Role::SerialPowerMeter,
+            Provider::pollingLoopHelper, "PM:SML", stackSize,
+            this, &_taskHandle);
 }
 
 Provider::~Provider()
@@ -50,14 +77,23 @@ Provider::~Provider()
     lock.unlock();
 
     if (_taskHandle != nullptr) {
+        xTaskNotifyGive(_taskHandle); // wakes the hardware UART polling loop
         while (!_taskDone) { delay(10); }
         _taskHandle = nullptr;
     }
 
+    if (_upHwSerial) {
+        _upHwSerial->onReceive(nullptr);
+        _upHwSerial->end();
+        _upHwSerial = nullptr;
+    }
+
     if (_upSmlSerial) {
         _upSmlSerial->end();
         _upSmlSerial = nullptr;
     }
+
+    SerialPortManager.freePort(_serialPortOwner);
 }
 
 void Provider::pollingLoopHelper(void* context)
@@ -69,6 +105,56 @@ void Provider::pollingLoopHelper(void* context)
 }
 
 void Provider::pollingLoop()
+{
+    if (_upHwSerial) {
+        pollingLoopHardware();
+        return;
+    }
+
+    pollingLoopSoftware();
+}
+
+void Provider::pollingLoopHardware()
+{
+    // a datagram was (partially) parsed since the parser was last reset
+    bool pending = false;
+    std::unique_lock<std::mutex> lock(_pollingMutex);
+
+    while (!_stopPolling) {
+        lock.unlock();
+
+        // sleeps until the UART reports an idle RX line. the parser is reset
+        // if no more data followed within the datagram gap, as a datagram
+        // is then considered complete (or truncated).
+        TickType_t timeout = pending ? pdMS_TO_TICKS(_datagramGapMillis) : portMAX_DELAY;
+
+        // a recording is fed while waiting for the UART
+        if (InputCapture.isReplaying(InputCapture::Source::SmlSerial)) {
+            replay();
+            timeout = std::min<TickType_t>(timeout, pdMS_TO_TICKS(10));
+        }
+
+        if (ulTaskNotifyTake(pdTRUE, timeout) == 0) {
+            if (pending) { ::PowerMeters::Sml::Provider::reset(); }
+            pending = false;
+            lock.lock();
+            continue;
+        }
+
+        uint8_t chunk[_chunkSize];
+        size_t length;
+        while ((length = _upHwSerial->read(chunk, sizeof(chunk))) > 0) {
+            if (InputCapture.isReplaying(InputCapture::Source::SmlSerial)) { continue; }
+            InputCapture.record(InputCapture::Source::SmlSerial, 0, chunk, length);
+            processSmlBytes(chunk, length);
+            pending = true;
+        }
+
+        lock.lock();
+    }
+}
+
+void Provider::pollingLoopSoftware()
 {
     int lastAvailable = 0;
     uint32_t gapStartMillis = 0;
@@ -82,6 +168,8 @@ void Provider::pollingLoop()
         // frequenly.
         int nowAvailable = _upSmlSerial->available();
 
+        replay();
+
         if (nowAvailable <= 0) {
             // sleep, but at most until the software serial ISR
             // buffer is potentially half full with transitions.
@@ -111,8 +199,12 @@ void Provider::pollingLoop()
             continue;
         }
 
-        while (_upSmlSerial->available() > 0) {
-            processSmlByte(_upSmlSerial->read());
+        uint8_t chunk[_chunkSize];
+        int length;
+        while ((length = _upSmlSerial->read(chunk, sizeof(chunk))) > 0) {
+            if (InputCapture.isReplaying(InputCapture::Source::SmlSerial)) { continue; }
+            InputCapture.record(InputCapture::Source::SmlSerial, 0, chunk, length);
+            processSmlBytes(chunk, length);
         }
 
         lastAvailable = 0;
@@ -123,4 +215,11 @@ void Provider::pollingLoop()
     }
 }
 
+void Provider::replay()
+{
+    InputCapture.replay(InputCapture::Source::SmlSerial, 0, [this](uint8_t const* data, size_t length) {
+        processSmlBytes(data, length);
+    });
+}
+
 } // namespace PowerMeters::Sml::Serial
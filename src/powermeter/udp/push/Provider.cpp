@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <powermeter/udp/push/Provider.h>
+#include <ArduinoJson.h>
+#include <MessageOutput.h>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace PowerMeters::Udp::Push {
+
+static constexpr char binaryMagic[4] = { 'O', 'D', 'P', 'M' };
+static constexpr uint8_t binaryVersion = 1;
+static constexpr size_t binaryHeaderSize = 16;
+
+// a sender which was silent for this long or whose sequence number dropped
+// by more than a few datagrams is assumed to have restarted
+static constexpr uint32_t restartMillis = 5000;
+static constexpr int32_t maxReorder = 16;
+
+// the clock offset is estimated anew after this many datagrams, which
+// follows drifting clocks
+static constexpr uint16_t clockOffsetWindow = 256;
+
+// anything beyond is a broken reading rather than a household
+static constexpr float maxPowerWatts = 1e6;
+
+Provider::Provider(PowerMeterUdpPushConfig const& cfg)
+    : _cfg(cfg)
+{
+}
+
+Provider::~Provider()
+{
+    _udp.close();
+}
+
+bool Provider::init()
+{
+    _udp.onPacket([this](AsyncUDPPacket& packet) { handlePacket(packet); });
+
+    if (!_udp.listen(_cfg.Port)) {
+        MessageOutput.printf("[PowerMeters::Udp::Push] Cannot listen on port "
+                "%u\r\n", _cfg.Port);
+        return false;
+    }
+
+    MessageOutput.printf("[PowerMeters::Udp::Push] Listening on port %u\r\n", _cfg.Port);
+    return true;
+}
+
+float Provider::getPowerTotal() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    return _power;
+}
+
+void Provider::doMqttPublish() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    if (!_hasPhases) { return; }
+
+    mqttPublish("power1", _phases[0]);
+    mqttPublish("power2", _phases[1]);
+    mqttPublish("power3", _phases[2]);
+}
+
+bool Provider::parseBinary(uint8_t const* data, size_t size, Reading& reading) const
+{
+    if (size < binaryHeaderSize + sizeof(float)) { return false; }
+    if (memcmp(data, binaryMagic, sizeof(binaryMagic)) != 0) { return false; }
+    if (data[4] != binaryVersion) { return false; }
+
+    uint8_t phases = data[5];
+    if (phases != 0 && phases != 3) { return false; }
+    if (size != binaryHeaderSize + (1 + phases) * sizeof(float)) { return false; }
+
+    memcpy(&reading.Sequence, data + 8, sizeof(reading.Sequence));
+    memcpy(&reading.Timestamp, data + 12, sizeof(reading.Timestamp));
+    memcpy(&reading.Power, data + binaryHeaderSize, sizeof(reading.Power));
+
+    reading.HasPhases = phases == 3;
+    if (reading.HasPhases) {
+        memcpy(reading.Phases.data(), data + binaryHeaderSize + sizeof(float),
+                reading.Phases.size() * sizeof(float));
+    }
+
+    return true;
+}
+
+bool Provider::parseJson(uint8_t const* data, size_t size, Reading& reading) const
+{
+    JsonDocument doc;
+    if (deserializeJson(doc, data, size) != DeserializationError::Ok) { return false; }
+
+    if (!doc["seq"].is<uint32_t>() || !doc["ts"].is<uint32_t>() || !doc["power"].is<float>()) {
+        return false;
+    }
+
+    reading.Sequence = doc["seq"].as<uint32_t>();
+    reading.Timestamp = doc["ts"].as<uint32_t>();
+    reading.Power = doc["power"].as<float>();
+
+    JsonArrayConst phases = doc["phases"];
+    reading.HasPhases = !phases.isNull();
+    if (!reading.HasPhases) { return true; }
+
+    if (phases.size() != reading.Phases.size()) { return false; }
+    for (size_t i = 0; i < reading.Phases.size(); ++i) {
+        if (!phases[i].is<float>()) { return false; }
+        reading.Phases[i] = phases[i].as<float>();
+    }
+
+    return true;
+}
+
+void Provider::handlePacket(AsyncUDPPacket& packet)
+{
+    uint32_t arrival = millis();
+    uint32_t parseMicros = micros();
+
+    uint8_t const* data = packet.data();
+    size_t size = packet.length();
+
+    Reading reading = {};
+    bool parsed = size > 0 && (data[0] == '{' ? parseJson(data, size, reading) : parseBinary(data, size, reading));
+
+    auto isValid = [](float power) { return std::isfinite(power) && std::fabs(power) < maxPowerWatts; };
+    bool valid = parsed && isValid(reading.Power);
+    for (size_t i = 0; valid && reading.HasPhases && i < reading.Phases.size(); ++i) {
+        valid = isValid(reading.Phases[i]);
+    }
+
+    if (!valid) {
+        _diagnostics.record(Diagnostics::Failure::Parse);
+        MessageOutput.printf("[PowerMeters::Udp::Push] Invalid datagram of %u "
+                "bytes from %s\r\n", size, packet.remoteIP().toString().c_str());
+        return;
+    }
+
+    uint32_t measured;
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+
+        int32_t advance = static_cast<int32_t>(reading.Sequence - _lastSequence);
+        bool resync = !_synced || (arrival - _lastArrival) > restartMillis || advance < -maxReorder;
+
+        if (!resync && advance <= 0) {
+            _diagnostics.record(Diagnostics::Failure::Sequence);
+            if (_verboseLogging) {
+                MessageOutput.printf("[PowerMeters::Udp::Push] Dropped datagram "
+                        "%u, last was %u\r\n", reading.Sequence, _lastSequence);
+            }
+            return;
+        }
+
+        uint32_t offset = arrival - reading.Timestamp;
+        if (resync || static_cast<int32_t>(offset - _clockOffset) < 0
+                || ++_clockOffsetAge >= clockOffsetWindow) {
+            _clockOffset = offset;
+            _clockOffsetAge = 0;
+        }
+        measured = reading.Timestamp + _clockOffset;
+
+        _power = reading.Power;
+        _phases = reading.Phases;
+        _hasPhases = reading.HasPhases;
+        _synced = true;
+        _lastSequence = reading.Sequence;
+        _lastArrival = arrival;
+    }
+
+    _diagnostics.record(Diagnostics::Metric::ParseTime, micros() - parseMicros);
+
+    // relative to the least delayed datagram, see _clockOffset
+    auto constexpr maxMillis = std::numeric_limits<uint32_t>::max() / 1000;
+    _diagnostics.record(Diagnostics::Metric::Latency, std::min(arrival - measured, maxMillis) * 1000);
+
+    if (_verboseLogging) {
+        MessageOutput.printf("[PowerMeters::Udp::Push] Datagram %u: %.1f W, "
+                "measured %u ms ago\r\n", reading.Sequence, reading.Power,
+                arrival - measured);
+    }
+
+    gotUpdate(measured);
+}
+
+} // namespace PowerMeters::Udp::Push
@@ -5,6 +5,7 @@
 #include <powermeter/udp/smahm/Provider.h>
 #include <Arduino.h>
 #include <WiFiUdp.h>
+#include <cmath>
 #include "MessageOutput.h"
 
 namespace PowerMeters::Udp::SmaHM {
@@ -13,15 +14,79 @@ static constexpr unsigned int multicastPort = 9522;  // local port to listen on
 static const IPAddress multicastIP(239, 12, 255, 254);
 static WiFiUDP SMAUdp;
 
-constexpr uint32_t interval = 1000;
+// the Home Manager 2.0 sends up to five datagrams per second. the socket is
+// checked often enough to timestamp their arrival for the jitter estimate.
+constexpr uint32_t interval = 20;
+
+static constexpr uint16_t groupTagEnd = 0x0000;
+static constexpr uint16_t groupTagData = 0x0010;
+static constexpr uint16_t groupTagId = 0x02A0;
+static constexpr uint16_t protocolIdEnergyMeter = 0x6069;
+
+static constexpr uint8_t obisChannelVersion = 144;
+static constexpr uint8_t obisTypeActual = 4;
+static constexpr uint8_t obisTypeCounter = 8;
+
+// the OBIS measurements which make up a reading. each power is reported as
+// separate (positive) values for import and export.
+struct ObisField {
+    uint8_t Index;
+    uint8_t Slot;     // total, L1, L2 or L3
+    bool Export;
+};
+
+static constexpr ObisField obisFields[] = {
+    {  1, 0, false },
+    {  2, 0, true },
+    { 21, 1, false },
+    { 22, 1, true },
+    { 41, 2, false },
+    { 42, 2, true },
+    { 61, 3, false },
+    { 62, 3, true }
+};
+
+static constexpr size_t obisFieldCount = sizeof(obisFields) / sizeof(obisFields[0]);
+static constexpr uint8_t obisNoField = 0xFF;
+
+// maps an OBIS index of an actual value to its position in obisFields,
+// such that decoding a measurement does not search the table.
+static constexpr std::array<uint8_t, 256> buildObisLookup()
+{
+    std::array<uint8_t, 256> lookup = {};
+    for (auto& entry : lookup) { entry = obisNoField; }
+    for (size_t i = 0; i < obisFieldCount; ++i) {
+        lookup[obisFields[i].Index] = static_cast<uint8_t>(i);
+    }
+    return lookup;
+}
+
+static constexpr auto obisLookup = buildObisLookup();
+
+static_assert(obisFieldCount <= 32, "fields must fit into the mask of seen fields");
 
-void Provider::Soutput(int kanal, int index, int art, int tarif,
-        char const* name, float value, uint32_t timestamp)
+static uint16_t readUint16(uint8_t const* data)
 {
-    if (!_verboseLogging) { return; }
+    return (static_cast<uint16_t>(data[0]) << 8) | data[1];
+}
 
-    MessageOutput.printf("[PowerMeters::Udp::SmaHM] %s = %.1f (timestamp %u)\r\n",
-            name, value, timestamp);
+static uint32_t readUint32(uint8_t const* data)
+{
+    return (static_cast<uint32_t>(data[0]) << 24) |
+        (static_cast<uint32_t>(data[1]) << 16) |
+        (static_cast<uint32_t>(data[2]) << 8) |
+        data[3];
+}
+
+Provider::Provider(PowerMeterUdpSmaHmConfig const& cfg)
+    : _cfg(cfg)
+{
+    // a serial of zero adopts the first meter that is heard
+    _meters.push_back({ _cfg.Serial });
+
+    if (_cfg.SubMeterSerial > 0 && _cfg.SubMeterSerial != _cfg.Serial) {
+        _meters.push_back({ _cfg.SubMeterSerial });
+    }
 }
 
 bool Provider::init()
@@ -36,173 +101,205 @@ Provider::~Provider()
     SMAUdp.stop();
 }
 
+float Provider::getPowerTotal() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    return _meters.front().Power[0];
+}
+
+void Provider::mqttPublishMeter(Meter const& meter, String const& prefix) const
+{
+    mqttPublish(prefix + "power1", meter.Power[1]);
+    mqttPublish(prefix + "power2", meter.Power[2]);
+    mqttPublish(prefix + "power3", meter.Power[3]);
+    mqttPublish(prefix + "jitter", meter.JitterMillis);
+}
+
 void Provider::doMqttPublish() const
 {
-    mqttPublish("power1", _powerMeterL1);
-    mqttPublish("power2", _powerMeterL2);
-    mqttPublish("power3", _powerMeterL3);
+    std::lock_guard<std::mutex> l(_mutex);
+    mqttPublishMeter(_meters.front(), "");
+
+    for (size_t i = 1; i < _meters.size(); ++i) {
+        auto const& meter = _meters[i];
+        if (!meter.Valid) { continue; }
+
+        auto prefix = "submeter" + String(meter.Serial) + "/";
+        mqttPublish(prefix + "powertotal", meter.Power[0]);
+        mqttPublishMeter(meter, prefix);
+    }
 }
 
-uint8_t* Provider::decodeGroup(uint8_t* offset, uint16_t grouplen)
+// must be called while holding the mutex
+Provider::Meter* Provider::getMeter(uint32_t serial)
 {
-    float Pbezug = 0;
-    float BezugL1 = 0;
-    float BezugL2 = 0;
-    float BezugL3 = 0;
-    float Peinspeisung = 0;
-    float EinspeisungL1 = 0;
-    float EinspeisungL2 = 0;
-    float EinspeisungL3 = 0;
-
-    uint8_t* endOfGroup = offset + grouplen;
-
-    // not used: uint16_t protocolID = (offset[0] << 8) + offset[1];
-    offset += 2;
-
-    // not used: uint16_t susyID = (offset[0] << 8) + offset[1];
-    offset += 2;
-
-    _serial = (offset[0] << 24) + (offset[1] << 16) + (offset[2] << 8) + offset[3];
-    offset += 4;
-
-    uint32_t timestamp = (offset[0] << 24) + (offset[1] << 16) + (offset[2] << 8) + offset[3];
-    offset += 4;
-
-    unsigned count = 0;
-    while (offset < endOfGroup) {
-        uint8_t kanal = offset[0];
-        uint8_t index = offset[1];
-        uint8_t art = offset[2];
-        uint8_t tarif = offset[3];
-        offset += 4;
-
-        if (kanal == 144) {
-            // Optional: Versionsnummer auslesen... aber interessiert die?
-            offset += 4;
+    for (auto& meter : _meters) {
+        if (meter.Serial == serial) { return &meter; }
+    }
+
+    auto& primary = _meters.front();
+    if (primary.Serial != 0) { return nullptr; }
+
+    MessageOutput.printf("[PowerMeters::Udp::SmaHM] Using meter with serial "
+            "%u\r\n", serial);
+    primary.Serial = serial;
+    return &primary;
+}
+
+void Provider::decodeGroup(uint8_t const* data, uint16_t length, uint32_t arrival)
+{
+    // protocol ID (2), SUSyID (2), serial (4) and timestamp (4)
+    if (length < 12) { return; }
+
+    if (readUint16(data) != protocolIdEnergyMeter) { return; }
+
+    uint32_t serial = readUint32(data + 4);
+    uint32_t timestamp = readUint32(data + 8);
+
+    std::array<float, obisFieldCount> values = {};
+    uint32_t seen = 0;
+
+    // every measurement is read in place. the header consists of channel,
+    // index, type (i.e. the size of the value) and tariff.
+    size_t pos = 12;
+    while (pos + 4 <= length) {
+        uint8_t channel = data[pos];
+        uint8_t index = data[pos + 1];
+        uint8_t type = data[pos + 2];
+        pos += 4;
+
+        // the software version is always four bytes long
+        size_t size = (channel == obisChannelVersion) ? 4 : type;
+        if (size == 0 || pos + size > length) { break; }
+
+        if (channel == obisChannelVersion || type == obisTypeCounter) {
+            pos += size;
             continue;
         }
 
-        if (art == 8) {
-            offset += 8;
+        if (type != obisTypeActual) {
+            MessageOutput.printf("[PowerMeters::Udp::SmaHM] Skipped unknown "
+                    "measurement: %d %d %d %d\r\n", channel, index, type, data[pos - 1]);
+            pos += size;
             continue;
         }
 
-        if (art == 4) {
-            uint32_t data = (offset[0] << 24) +
-                (offset[1] << 16) +
-                (offset[2] << 8) +
-                offset[3];
-            offset += 4;
-
-            switch (index) {
-                case (1):
-                    Pbezug = data * 0.1;
-                    ++count;
-                    break;
-                case (2):
-                    Peinspeisung = data * 0.1;
-                    ++count;
-                    break;
-                case (21):
-                    BezugL1 = data * 0.1;
-                    ++count;
-                    break;
-                case (22):
-                    EinspeisungL1 = data * 0.1;
-                    ++count;
-                    break;
-                case (41):
-                    BezugL2 = data * 0.1;
-                    ++count;
-                    break;
-                case (42):
-                    EinspeisungL2 = data * 0.1;
-                    ++count;
-                    break;
-                case (61):
-                    BezugL3 = data * 0.1;
-                    ++count;
-                    break;
-                case (62):
-                    EinspeisungL3 = data * 0.1;
-                    ++count;
-                    break;
-                default:
-                    break;
-            }
-
-            if (count == 8) {
-                _powerMeterPower = Pbezug - Peinspeisung;
-                _powerMeterL1 = BezugL1 - EinspeisungL1;
-                _powerMeterL2 = BezugL2 - EinspeisungL2;
-                _powerMeterL3 = BezugL3 - EinspeisungL3;
-                Soutput(kanal, index, art, tarif, "Leistung", _powerMeterPower, timestamp);
-                Soutput(kanal, index, art, tarif, "Leistung L1", _powerMeterL1, timestamp);
-                Soutput(kanal, index, art, tarif, "Leistung L2", _powerMeterL2, timestamp);
-                Soutput(kanal, index, art, tarif, "Leistung L3", _powerMeterL3, timestamp);
-                count = 0;
-                gotUpdate();
-            }
+        uint8_t field = obisLookup[index];
+        if (field != obisNoField) {
+            values[field] = readUint32(data + pos) * 0.1;
+            seen |= (1UL << field);
+        }
 
-            continue;
+        pos += size;
+    }
+
+    std::lock_guard<std::mutex> l(_mutex);
+
+    auto pMeter = getMeter(serial);
+    if (!pMeter) {
+        if (_verboseLogging) {
+            MessageOutput.printf("[PowerMeters::Udp::SmaHM] Ignoring meter "
+                    "with serial %u\r\n", serial);
         }
+        return;
+    }
+
+    auto& meter = *pMeter;
 
-        MessageOutput.printf("[PowerMeters::Udp::SmaHM] Skipped unknown measurement: %d %d %d %d\r\n",
-                kanal, index, art, tarif);
-        offset += art;
+    if (meter.LastArrival != 0) {
+        int32_t transit = static_cast<int32_t>((arrival - meter.LastArrival) -
+                (timestamp - meter.LastTimestamp));
+        meter.JitterMillis += (std::abs(transit) - meter.JitterMillis) / 16;
     }
+    meter.LastArrival = arrival;
+    meter.LastTimestamp = timestamp;
 
-    return offset;
-}
+    if (seen != (1UL << obisFieldCount) - 1) {
+        _diagnostics.record(Diagnostics::Failure::Incomplete);
+        MessageOutput.printf("[PowerMeters::Udp::SmaHM] Incomplete reading "
+                "of meter %u\r\n", serial);
+        return;
+    }
 
-void Provider::loop()
-{
-    uint32_t currentMillis = millis();
-    if (currentMillis - _previousMillis < interval) { return; }
+    meter.Power = {};
+    for (size_t i = 0; i < obisFieldCount; ++i) {
+        auto const& field = obisFields[i];
+        meter.Power[field.Slot] += field.Export ? -values[i] : values[i];
+    }
+    meter.Valid = true;
 
-    _previousMillis = currentMillis;
+    if (_verboseLogging) {
+        MessageOutput.printf("[PowerMeters::Udp::SmaHM] Meter %u: %.1f W "
+                "(L1 %.1f W, L2 %.1f W, L3 %.1f W), timestamp %u, jitter "
+                "%.1f ms\r\n", serial, meter.Power[0], meter.Power[1],
+                meter.Power[2], meter.Power[3], timestamp, meter.JitterMillis);
+    }
 
-    int packetSize = SMAUdp.parsePacket();
-    if (!packetSize) { return; }
+    if (&meter == &_meters.front()) { gotUpdate(); }
+}
+
+void Provider::handlePacket(uint8_t const* buffer, size_t size)
+{
+    uint32_t arrival = millis();
 
-    uint8_t buffer[1024];
-    int rSize = SMAUdp.read(buffer, 1024);
-    if (buffer[0] != 'S' || buffer[1] != 'M' || buffer[2] != 'A') {
+    if (size < 4 || buffer[0] != 'S' || buffer[1] != 'M' || buffer[2] != 'A') {
+        _diagnostics.record(Diagnostics::Failure::Parse);
         MessageOutput.println("[PowerMeters::Udp::SmaHM] Not an SMA packet?");
         return;
     }
 
-    uint16_t grouplen;
-    uint16_t grouptag;
-    uint8_t* offset = buffer + 4; // skips the header 'SMA\0'
+    size_t pos = 4; // skips the header 'SMA\0'
+
+    while (pos + 4 <= size) {
+        uint16_t grouplen = readUint16(buffer + pos);
+        uint16_t grouptag = readUint16(buffer + pos + 2);
+        pos += 4;
+
+        if (grouplen == 0xffff || pos + grouplen > size) { return; }
+
+        switch (grouptag) {
+            case groupTagId:
+                break;
+            case groupTagData:
+                decodeGroup(buffer + pos, grouplen, arrival);
+                break;
+            case groupTagEnd:
+                return;
+            default:
+                MessageOutput.printf("[PowerMeters::Udp::SmaHM] Unhandled group "
+                        "0x%04x with length %d\r\n", grouptag, grouplen);
+                break;
+        }
 
-    do {
-        grouplen = (offset[0] << 8) + offset[1];
-        grouptag = (offset[2] << 8) + offset[3];
-        offset += 4;
+        pos += grouplen;
+    }
+}
 
-        if (grouplen == 0xffff) return;
+void Provider::loop()
+{
+    uint32_t currentMillis = millis();
+    if (currentMillis - _previousMillis < interval) { return; }
 
-        if (grouptag == 0x02A0 && grouplen == 4) {
-            offset += 4;
-            continue;
-        }
+    _previousMillis = currentMillis;
 
-        if (grouptag == 0x0010) {
-            offset = decodeGroup(offset, grouplen);
+    // datagrams of all meters are received on the same socket
+    int packetSize;
+    while ((packetSize = SMAUdp.parsePacket()) > 0) {
+        if (static_cast<size_t>(packetSize) > _buffer.size()) {
+            _diagnostics.record(Diagnostics::Failure::Parse);
+            MessageOutput.printf("[PowerMeters::Udp::SmaHM] Skipped datagram "
+                    "of %d bytes\r\n", packetSize);
+            SMAUdp.flush();
             continue;
         }
 
-        if (grouptag == 0) {
-            // end marker
-            offset += grouplen;
-            continue;
-        }
+        int rSize = SMAUdp.read(_buffer.data(), _buffer.size());
+        if (rSize <= 0) { continue; }
 
-        MessageOutput.printf("[PowerMeters::Udp::SmaHM] Unhandled group 0x%04x with length %d\r\n",
-                grouptag, grouplen);
-        offset += grouplen;
-    } while (grouplen > 0 && offset + 4 < buffer + rSize);
+        uint32_t parseMicros = micros();
+        handlePacket(_buffer.data(), rSize);
+        _diagnostics.record(Diagnostics::Metric::ParseTime, micros() - parseMicros);
+    }
 }
 
 } // namespace PowerMeters::Udp::SmaHM
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <algorithm>
+#include <solarcharger/AggregateStats.h>
+#include <MemoryPolicy.h>
+
+namespace SolarChargers {
+
+AggregateStats::AggregateStats(std::vector<std::shared_ptr<Stats const>> providers)
+{
+    _sources.reserve(providers.size());
+    for (auto& spStats : providers) {
+        _sources.push_back({ std::move(spStats), 0 });
+    }
+}
+
+bool AggregateStats::update()
+{
+    bool updated = false;
+    auto now = millis();
+
+    for (auto& source : _sources) {
+        // the age of a provider without any values is meaningless, e.g.,
+        // the Victron provider reports zero until it received a frame.
+        auto const& stats = *source.spStats;
+        bool hasData = stats.getOutputPowerWatts() || stats.getOutputVoltage();
+        uint32_t lastUpdate = hasData ? now - stats.getAgeMillis() : 0;
+        if (lastUpdate == source.lastUpdate) { continue; }
+        source.lastUpdate = lastUpdate;
+        updated = true;
+    }
+
+    if (!updated) { return false; }
+
+    aggregate();
+    return true;
+}
+
+void AggregateStats::aggregate()
+{
+    Aggregates agg;
+
+    auto add = [](auto& sum, auto const& oValue) {
+        if (!oValue) { return; }
+        sum = sum.has_value() ? *sum + *oValue : *oValue;
+    };
+
+    auto first = [](auto& target, auto const& oValue) {
+        if (!target) { target = oValue; }
+    };
+
+    for (auto const& source : _sources) {
+        auto const& stats = *source.spStats;
+
+        if (source.lastUpdate == 0) { continue; }
+
+        if (!agg.oNewestUpdate || static_cast<int32_t>(source.lastUpdate - *agg.oNewestUpdate) > 0) {
+            agg.oNewestUpdate = source.lastUpdate;
+        }
+
+        add(agg.oOutputPowerWatts, stats.getOutputPowerWatts());
+        add(agg.oPanelPowerWatts, stats.getPanelPowerWatts());
+        add(agg.oYieldTotal, stats.getYieldTotal());
+        add(agg.oYieldDay, stats.getYieldDay());
+
+        auto oVoltage = stats.getOutputVoltage();
+        if (oVoltage) {
+            agg.oOutputVoltage = agg.oOutputVoltage.has_value() ? std::min(*agg.oOutputVoltage, *oVoltage) : *oVoltage;
+        }
+
+        first(agg.oStateOfOperation, stats.getStateOfOperation());
+        first(agg.oFloatVoltage, stats.getFloatVoltage());
+        first(agg.oAbsorptionVoltage, stats.getAbsorptionVoltage());
+    }
+
+    _aggregates = agg;
+}
+
+uint32_t AggregateStats::getAgeMillis() const
+{
+    if (!_aggregates.oNewestUpdate) { return 0; }
+    return millis() - *_aggregates.oNewestUpdate;
+}
+
+void AggregateStats::getLiveViewData(JsonVariant& root, const boolean fullUpdate, const uint32_t lastPublish) const
+{
+    Stats::getLiveViewData(root, fullUpdate, lastPublish);
+
+    // each provider renders its instances into a document of its own, as
+    // some providers replace the list of instances.
+    auto instances = root["solarcharger"]["instances"].to<JsonObject>();
+    for (auto const& source : _sources) {
+        JsonDocument doc(MemoryPolicy::jsonAllocator());
+        JsonVariant var = doc.to<JsonVariant>();
+        source.spStats->getLiveViewData(var, fullUpdate, lastPublish);
+
+        for (auto kv : var["solarcharger"]["instances"].as<JsonObject>()) {
+            instances[kv.key()] = kv.value();
+        }
+    }
+}
+
+} // namespace SolarChargers
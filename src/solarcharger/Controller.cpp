@@ -4,8 +4,14 @@
 #include <MqttSettings.h>
 #include <solarcharger/Controller.h>
 #include <solarcharger/DummyStats.h>
+#include <Features.h>
+#if FEATURE_SOLARCHARGER_VEDIRECT
 #include <solarcharger/victron/Provider.h>
+#endif
+#if FEATURE_SOLARCHARGER_MQTT
 #include <solarcharger/mqtt/Provider.h>
+#endif
+#include <TaskProfiler.h>
 
 SolarChargers::Controller SolarCharger;
 
@@ -14,63 +20,123 @@ namespace SolarChargers {
 void Controller::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&Controller::loop, this));
+    _loopTask.setCallback(TaskProfiler.wrap("SolarCharger::loop", std::bind(&Controller::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
 
     this->updateSettings();
 }
 
+std::unique_ptr<Provider> Controller::createProvider(uint8_t provider) const
+{
+    if (provider < Features::SolarChargerProviderCount
+            && !Features::isSolarChargerProviderAvailable(provider)) {
+        MessageOutput.printf("[SolarCharger] Provider %d is not available in "
+                "this build\r\n", provider);
+        return nullptr;
+    }
+
+    switch (provider) {
+#if FEATURE_SOLARCHARGER_VEDIRECT
+        case SolarChargerProviderType::VEDIRECT:
+            return std::make_unique<::SolarChargers::Victron::Provider>();
+#endif
+#if FEATURE_SOLARCHARGER_MQTT
+        case SolarChargerProviderType::MQTT:
+            return std::make_unique<::SolarChargers::Mqtt::Provider>();
+#endif
+        default:
+            MessageOutput.printf("[SolarCharger] Unknown provider: %d\r\n", provider);
+            return nullptr;
+    }
+}
+
 void Controller::updateSettings()
 {
     std::lock_guard<std::mutex> lock(_mutex);
 
-    if (_upProvider) {
-        _upProvider->deinit();
-        _upProvider = nullptr;
-    }
+    for (auto& upProvider : _providers) { upProvider->deinit(); }
+    _providers.clear();
+    _spAggregateStats = nullptr;
+    _estimator.reset();
 
     auto const& config = Configuration.get();
     if (!config.SolarCharger.Enabled) { return; }
 
     bool verboseLogging = config.SolarCharger.VerboseLogging;
 
-    switch (config.SolarCharger.Provider) {
-        case SolarChargerProviderType::VEDIRECT:
-            _upProvider = std::make_unique<::SolarChargers::Victron::Provider>();
-            break;
-        case SolarChargerProviderType::MQTT:
-            _upProvider = std::make_unique<::SolarChargers::Mqtt::Provider>();
-            break;
-        default:
-            MessageOutput.printf("[SolarCharger] Unknown provider: %d\r\n", config.SolarCharger.Provider);
-            return;
+    // the main provider comes first, its stats are used if it is the
+    // only one which could be initialized
+    std::vector<uint8_t> providers = { config.SolarCharger.Provider };
+    for (uint8_t provider = 0; provider < Features::SolarChargerProviderCount; ++provider) {
+        if (provider == config.SolarCharger.Provider) { continue; }
+        if (config.SolarCharger.AdditionalProviders & (1 << provider)) {
+            providers.push_back(provider);
+        }
     }
 
-    if (!_upProvider->init(verboseLogging)) { _upProvider = nullptr; }
+    for (auto provider : providers) {
+        auto upProvider = createProvider(provider);
+        if (!upProvider) { continue; }
+        if (!upProvider->init(verboseLogging)) { continue; }
+        _providers.push_back(std::move(upProvider));
+    }
 
     _forcePublishSensors = true;
+
+    if (_providers.size() < 2) { return; }
+
+    std::vector<std::shared_ptr<Stats const>> stats;
+    for (auto const& upProvider : _providers) {
+        stats.push_back(upProvider->getStats());
+    }
+
+    _spAggregateStats = std::make_shared<AggregateStats>(std::move(stats));
 }
 
 std::shared_ptr<Stats const> Controller::getStats() const
 {
     std::lock_guard<std::mutex> lock(_mutex);
 
-    if (!_upProvider) {
+    if (_providers.empty()) {
         static auto sspDummyStats = std::make_shared<DummyStats>();
         return sspDummyStats;
     }
 
-    return _upProvider->getStats();
+    if (_spAggregateStats) { return _spAggregateStats; }
+
+    return _providers.front()->getStats();
+}
+
+std::optional<float> Controller::getPredictedOutputPowerWatts() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_providers.empty()) { return std::nullopt; }
+    return _estimator.getOutputWatts(millis());
 }
 
 void Controller::loop()
 {
     std::lock_guard<std::mutex> lock(_mutex);
 
-    if (!_upProvider) { return; }
+    if (_providers.empty()) { return; }
 
-    _upProvider->loop();
+    for (auto& upProvider : _providers) {
+        upProvider->loop();
+    }
+
+    if (_spAggregateStats) { _spAggregateStats->update(); }
+
+    // feed the output power into the estimator, along with the time it was
+    // reported at. the estimator skips data it already knows.
+    std::shared_ptr<Stats const> spStats = _spAggregateStats;
+    if (!spStats) { spStats = _providers.front()->getStats(); }
+    auto oOutputWatts = spStats->getOutputPowerWatts();
+    if (oOutputWatts) {
+        auto oPanelWatts = spStats->getPanelPowerWatts();
+        _estimator.update(millis() - spStats->getAgeMillis(), *oOutputWatts,
+                oPanelWatts ? std::optional<float>(*oPanelWatts) : std::nullopt);
+    }
 
     // TODO(schlimmchen): this cannot make sure that transient
     // connection problems are actually always noticed.
@@ -79,12 +145,16 @@ void Controller::loop()
         return;
     }
 
-    _upProvider->getStats()->mqttLoop();
+    for (auto& upProvider : _providers) {
+        upProvider->getStats()->mqttLoop();
+    }
 
     auto const& config = Configuration.get();
     if (!config.Mqtt.Hass.Enabled) { return; }
 
-    _upProvider->getStats()->mqttPublishSensors(_forcePublishSensors);
+    for (auto& upProvider : _providers) {
+        upProvider->getStats()->mqttPublishSensors(_forcePublishSensors);
+    }
 
     _forcePublishSensors = false;
 }
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <solarcharger/Estimator.h>
+#include <algorithm>
+#include <limits>
+
+namespace SolarChargers {
+
+void Estimator::reset()
+{
+    _initialized = false;
+    _trend = 0;
+    _residual = 0;
+    _oPanelWatts = std::nullopt;
+}
+
+void Estimator::update(uint32_t measuredAt, float outputWatts, std::optional<float> oPanelWatts)
+{
+    uint32_t dt = measuredAt - _lastMeasurement;
+
+    // the same data, whose time is derived from its age
+    if (_initialized && dt < MinIntervalMillis) { return; }
+
+    if (!_initialized || dt > MaxGapMillis) {
+        _initialized = true;
+        _lastMeasurement = measuredAt;
+        _output = outputWatts;
+        _trend = 0;
+        _residual = 0;
+        _oPanelWatts = oPanelWatts;
+        return;
+    }
+
+    float forecast = _output + _trend * std::min(dt, MaxForecastMillis);
+    _residual = outputWatts - forecast;
+
+    _output = forecast + Alpha * _residual;
+    _trend += Beta * _residual / dt;
+
+    // the output follows the panel power, reduced by the conversion losses
+    // of the charge controller, which the ratio of both accounts for.
+    if (oPanelWatts && _oPanelWatts && *oPanelWatts > 0) {
+        float ratio = std::clamp(outputWatts / *oPanelWatts, 0.0f, 1.0f);
+        float panelTrend = (*oPanelWatts - *_oPanelWatts) * ratio / dt;
+        _trend += Gamma * (panelTrend - _trend);
+    }
+
+    _oPanelWatts = oPanelWatts;
+    _lastMeasurement = measuredAt;
+}
+
+std::optional<float> Estimator::getOutputWatts(uint32_t at) const
+{
+    if (!_initialized) { return std::nullopt; }
+
+    // the time might be slightly before the last measurement
+    auto constexpr halfOfAllMillis = std::numeric_limits<uint32_t>::max() / 2;
+    uint32_t dt = at - _lastMeasurement;
+    if (dt > halfOfAllMillis) { return std::max(0.0f, _output); }
+
+    if (dt > MaxGapMillis) { return std::nullopt; }
+
+    // the charge controllers cannot draw power from the bus
+    return std::max(0.0f, _output + _trend * std::min(dt, MaxForecastMillis));
+}
+
+} // namespace SolarChargers
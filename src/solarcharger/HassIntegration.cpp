@@ -4,16 +4,25 @@
 #include <Configuration.h>
 #include <MqttSettings.h>
 #include <MqttHandleHass.h>
+#include <MqttHassPublisher.h>
 #include <Utils.h>
 #include <__compiled_constants.h>
 
 namespace SolarChargers {
 
+HassIntegration::~HassIntegration()
+{
+    MqttHassPublisher.cancel(this);
+}
+
 void HassIntegration::publish(const String& subtopic, const String& payload) const
 {
-    String topic = Configuration.get().Mqtt.Hass.Topic;
-    topic += subtopic;
-    MqttSettings.publishGeneric(topic.c_str(), payload.c_str(), Configuration.get().Mqtt.Hass.Retain);
+    MqttHassPublisher.publish(subtopic, payload);
+}
+
+void HassIntegration::enqueue(std::function<void()>&& generator) const
+{
+    MqttHassPublisher.enqueue(this, std::move(generator));
 }
 
 } // namespace SolarChargers
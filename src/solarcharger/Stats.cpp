@@ -22,7 +22,7 @@ void Stats::mqttLoop()
 {
     auto& config = Configuration.get();
 
-    if (!MqttSettings.getConnected()
+    if (!MqttSettings.acceptsPublishes()
             || (millis() - _lastMqttPublish) < (config.Mqtt.PublishInterval * 1000)) {
         return;
     }
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include <solarcharger/mqtt/Provider.h>
 #include <Configuration.h>
+#include <DataBus.h>
 #include <MqttSettings.h>
 #include <MessageOutput.h>
 #include <Utils.h>
@@ -36,13 +37,14 @@ bool Provider::init(bool verboseLogging)
     if (!_outputPowerTopic.isEmpty()
         && !config.CalculateOutputPower) {
         _subscribedTopics.push_back(_outputPowerTopic);
+        _outputPowerJsonPath = JsonPath(config.PowerJsonPath);
 
         MqttSettings.subscribe(_outputPowerTopic, 0/*QoS*/,
                 std::bind(&Provider::onMqttMessageOutputPower,
                     this, std::placeholders::_1, std::placeholders::_2,
                     std::placeholders::_3, std::placeholders::_4,
                     std::placeholders::_5, std::placeholders::_6,
-                    config.PowerJsonPath)
+                    &_outputPowerJsonPath)
                 );
 
         if (_verboseLogging) {
@@ -53,13 +55,14 @@ bool Provider::init(bool verboseLogging)
 
     if (!_outputCurrentTopic.isEmpty()) {
         _subscribedTopics.push_back(_outputCurrentTopic);
+        _outputCurrentJsonPath = JsonPath(config.CurrentJsonPath);
 
         MqttSettings.subscribe(_outputCurrentTopic, 0/*QoS*/,
                 std::bind(&Provider::onMqttMessageOutputCurrent,
                     this, std::placeholders::_1, std::placeholders::_2,
                     std::placeholders::_3, std::placeholders::_4,
                     std::placeholders::_5, std::placeholders::_6,
-                    config.CurrentJsonPath)
+                    &_outputCurrentJsonPath)
                 );
 
         if (_verboseLogging) {
@@ -70,13 +73,14 @@ bool Provider::init(bool verboseLogging)
 
     if (!_outputVoltageTopic.isEmpty()) {
         _subscribedTopics.push_back(_outputVoltageTopic);
+        _outputVoltageJsonPath = JsonPath(config.VoltageJsonPath);
 
         MqttSettings.subscribe(_outputVoltageTopic, 0/*QoS*/,
                 std::bind(&Provider::onMqttMessageOutputVoltage,
                     this, std::placeholders::_1, std::placeholders::_2,
                     std::placeholders::_3, std::placeholders::_4,
                     std::placeholders::_5, std::placeholders::_6,
-                    config.VoltageJsonPath)
+                    &_outputVoltageJsonPath)
                 );
 
         if (_verboseLogging) {
@@ -98,11 +102,11 @@ void Provider::deinit()
 
 void Provider::onMqttMessageOutputPower(espMqttClientTypes::MessageProperties const& properties,
             char const* topic, uint8_t const* payload, size_t len, size_t index, size_t total,
-            char const* jsonPath) const
+            JsonPath const* jsonPath) const
 {
     auto outputPower = Utils::getNumericValueFromMqttPayload<float>("SolarChargers::Mqtt",
-            std::string(reinterpret_cast<const char*>(payload), len), topic,
-            jsonPath);
+            std::string_view(reinterpret_cast<const char*>(payload), len), topic,
+            *jsonPath);
 
     if (!outputPower.has_value()) { return; }
 
@@ -126,6 +130,7 @@ void Provider::onMqttMessageOutputPower(espMqttClientTypes::MessageProperties co
     }
 
     _stats->setOutputPowerWatts(*outputPower);
+    DataBus.publish(DataBusClass::Topic::SolarCharger);
 
     if (_verboseLogging) {
         MessageOutput.printf("[SolarChargers::Mqtt]: Updated output_power to %.1f from '%s'\r\n",
@@ -135,11 +140,11 @@ void Provider::onMqttMessageOutputPower(espMqttClientTypes::MessageProperties co
 
 void Provider::onMqttMessageOutputVoltage(espMqttClientTypes::MessageProperties const& properties,
             char const* topic, uint8_t const* payload, size_t len, size_t index, size_t total,
-            char const* jsonPath) const
+            JsonPath const* jsonPath) const
 {
     auto outputVoltage = Utils::getNumericValueFromMqttPayload<float>("SolarChargers::Mqtt",
-            std::string(reinterpret_cast<const char*>(payload), len), topic,
-            jsonPath);
+            std::string_view(reinterpret_cast<const char*>(payload), len), topic,
+            *jsonPath);
 
     if (!outputVoltage.has_value()) { return; }
 
@@ -169,6 +174,7 @@ void Provider::onMqttMessageOutputVoltage(espMqttClientTypes::MessageProperties
     }
 
     _stats->setOutputVoltage(*outputVoltage);
+    DataBus.publish(DataBusClass::Topic::SolarCharger);
 
     if (_verboseLogging) {
         MessageOutput.printf("[SolarChargers::Mqtt]: Updated output_voltage to %.2f from '%s'\r\n",
@@ -178,11 +184,11 @@ void Provider::onMqttMessageOutputVoltage(espMqttClientTypes::MessageProperties
 
 void Provider::onMqttMessageOutputCurrent(espMqttClientTypes::MessageProperties const& properties,
             char const* topic, uint8_t const* payload, size_t len, size_t index, size_t total,
-            char const* jsonPath) const
+            JsonPath const* jsonPath) const
 {
     auto outputCurrent = Utils::getNumericValueFromMqttPayload<float>("SolarChargers::Mqtt",
-            std::string(reinterpret_cast<const char*>(payload), len), topic,
-            jsonPath);
+            std::string_view(reinterpret_cast<const char*>(payload), len), topic,
+            *jsonPath);
 
     if (!outputCurrent.has_value()) { return; }
 
@@ -197,6 +203,7 @@ void Provider::onMqttMessageOutputCurrent(espMqttClientTypes::MessageProperties
     }
 
     _stats->setOutputCurrent(*outputCurrent);
+    DataBus.publish(DataBusClass::Topic::SolarCharger);
 
     if (*outputCurrent < 0) {
         MessageOutput.printf("[SolarChargers::Mqtt]: Implausible output_current '%.2f' in topic '%s'\r\n",
@@ -3,6 +3,7 @@
  * Copyright (C) 2022 Thomas Basler and others
  */
 #include "Configuration.h"
+#include "MemoryPolicy.h"
 #include "MqttSettings.h"
 #include "MqttHandleHass.h"
 #include "Utils.h"
@@ -13,63 +14,77 @@ namespace SolarChargers::Victron {
 
 void HassIntegration::publishSensors(const VeDirectMpptController::data_t &mpptData) const
 {
-    publishSensor("MPPT serial number", "mdi:counter", "SER", nullptr, nullptr, nullptr, mpptData);
-    publishSensor("MPPT firmware version integer", "mdi:counter", "FWI", nullptr, nullptr, nullptr, mpptData);
-    publishSensor("MPPT firmware version formatted", "mdi:counter", "FWF", nullptr, nullptr, nullptr, mpptData);
-    publishSensor("MPPT firmware version FW", "mdi:counter", "FW", nullptr, nullptr, nullptr, mpptData);
-    publishSensor("MPPT firmware version FWE", "mdi:counter", "FWE", nullptr, nullptr, nullptr, mpptData);
-    publishSensor("MPPT state of operation", "mdi:wrench", "CS", nullptr, nullptr, nullptr, mpptData);
-    publishSensor("MPPT error code", "mdi:bell", "ERR", nullptr, nullptr, nullptr, mpptData);
-    publishSensor("MPPT off reason", "mdi:wrench", "OR", nullptr, nullptr, nullptr, mpptData);
-    publishSensor("MPPT tracker operation mode", "mdi:wrench", "MPPT", nullptr, nullptr, nullptr, mpptData);
-    publishSensor("MPPT Day sequence number (0...364)", "mdi:calendar-month-outline", "HSDS", NULL, "total", "d", mpptData);
+    // the documents are created later, from a copy shared by all sensors
+    auto spMpptData = std::make_shared<const VeDirectMpptController::data_t>(mpptData);
+
+    publishSensor("MPPT serial number", "mdi:counter", "SER", nullptr, nullptr, nullptr, spMpptData);
+    publishSensor("MPPT firmware version integer", "mdi:counter", "FWI", nullptr, nullptr, nullptr, spMpptData);
+    publishSensor("MPPT firmware version formatted", "mdi:counter", "FWF", nullptr, nullptr, nullptr, spMpptData);
+    publishSensor("MPPT firmware version FW", "mdi:counter", "FW", nullptr, nullptr, nullptr, spMpptData);
+    publishSensor("MPPT firmware version FWE", "mdi:counter", "FWE", nullptr, nullptr, nullptr, spMpptData);
+    publishSensor("MPPT state of operation", "mdi:wrench", "CS", nullptr, nullptr, nullptr, spMpptData);
+    publishSensor("MPPT error code", "mdi:bell", "ERR", nullptr, nullptr, nullptr, spMpptData);
+    publishSensor("MPPT off reason", "mdi:wrench", "OR", nullptr, nullptr, nullptr, spMpptData);
+    publishSensor("MPPT tracker operation mode", "mdi:wrench", "MPPT", nullptr, nullptr, nullptr, spMpptData);
+    publishSensor("MPPT Day sequence number (0...364)", "mdi:calendar-month-outline", "HSDS", NULL, "total", "d", spMpptData);
 
     // battery info
-    publishSensor("Battery voltage", NULL, "V", "voltage", "measurement", "V", mpptData);
-    publishSensor("Battery current", NULL, "I", "current", "measurement", "A", mpptData);
-    publishSensor("Battery power (calculated)", NULL, "P", "power", "measurement", "W", mpptData);
-    publishSensor("Battery efficiency (calculated)", NULL, "E", NULL, "measurement", "%", mpptData);
+    publishSensor("Battery voltage", NULL, "V", "voltage", "measurement", "V", spMpptData);
+    publishSensor("Battery current", NULL, "I", "current", "measurement", "A", spMpptData);
+    publishSensor("Battery power (calculated)", NULL, "P", "power", "measurement", "W", spMpptData);
+    publishSensor("Battery efficiency (calculated)", NULL, "E", NULL, "measurement", "%", spMpptData);
 
     // panel info
-    publishSensor("Panel voltage", NULL, "VPV", "voltage", "measurement", "V", mpptData);
-    publishSensor("Panel current (calculated)", NULL, "IPV", "current", "measurement", "A", mpptData);
-    publishSensor("Panel power", NULL, "PPV", "power", "measurement", "W", mpptData);
-    publishSensor("Panel yield total", NULL, "H19", "energy", "total_increasing", "kWh", mpptData);
-    publishSensor("Panel yield today", NULL, "H20", "energy", "total", "kWh", mpptData);
-    publishSensor("Panel maximum power today", NULL, "H21", "power", "measurement", "W", mpptData);
-    publishSensor("Panel yield yesterday", NULL, "H22", "energy", "total", "kWh", mpptData);
-    publishSensor("Panel maximum power yesterday", NULL, "H23", "power", "measurement", "W", mpptData);
+    publishSensor("Panel voltage", NULL, "VPV", "voltage", "measurement", "V", spMpptData);
+    publishSensor("Panel current (calculated)", NULL, "IPV", "current", "measurement", "A", spMpptData);
+    publishSensor("Panel power", NULL, "PPV", "power", "measurement", "W", spMpptData);
+    publishSensor("Panel yield total", NULL, "H19", "energy", "total_increasing", "kWh", spMpptData);
+    publishSensor("Panel yield today", NULL, "H20", "energy", "total", "kWh", spMpptData);
+    publishSensor("Panel maximum power today", NULL, "H21", "power", "measurement", "W", spMpptData);
+    publishSensor("Panel yield yesterday", NULL, "H22", "energy", "total", "kWh", spMpptData);
+    publishSensor("Panel maximum power yesterday", NULL, "H23", "power", "measurement", "W", spMpptData);
 
     // optional info, provided only if the charge controller delivers the information
     if (mpptData.relayState_RELAY.first != 0) {
-        publishBinarySensor("MPPT error relay state", "mdi:electric-switch", "RELAY", "ON", "OFF", mpptData);
+        publishBinarySensor("MPPT error relay state", "mdi:electric-switch", "RELAY", "ON", "OFF", spMpptData);
     }
     if (mpptData.loadOutputState_LOAD.first != 0) {
-        publishBinarySensor("MPPT load output state", "mdi:export", "LOAD", "ON", "OFF", mpptData);
+        publishBinarySensor("MPPT load output state", "mdi:export", "LOAD", "ON", "OFF", spMpptData);
     }
     if (mpptData.loadCurrent_IL_mA.first != 0) {
-        publishSensor("MPPT load current", NULL, "IL", "current", "measurement", "A", mpptData);
+        publishSensor("MPPT load current", NULL, "IL", "current", "measurement", "A", spMpptData);
     }
 
     // optional info, provided only if TX is connected to charge controller
     if (mpptData.NetworkTotalDcInputPowerMilliWatts.first != 0) {
-        publishSensor("VE.Smart network total DC input power", "mdi:solar-power", "NetworkTotalDcInputPower", "power", "measurement", "W", mpptData);
+        publishSensor("VE.Smart network total DC input power", "mdi:solar-power", "NetworkTotalDcInputPower", "power", "measurement", "W", spMpptData);
     }
     if (mpptData.MpptTemperatureMilliCelsius.first != 0) {
-        publishSensor("MPPT temperature", "mdi:temperature-celsius", "MpptTemperature", "temperature", "measurement", "°C", mpptData);
+        publishSensor("MPPT temperature", "mdi:temperature-celsius", "MpptTemperature", "temperature", "measurement", "°C", spMpptData);
     }
     if (mpptData.BatteryAbsorptionMilliVolt.first != 0) {
-        publishSensor("Battery absorption voltage", "mdi:battery-charging-90", "BatteryAbsorption", "voltage", "measurement", "V", mpptData);
+        publishSensor("Battery absorption voltage", "mdi:battery-charging-90", "BatteryAbsorption", "voltage", "measurement", "V", spMpptData);
     }
     if (mpptData.BatteryFloatMilliVolt.first != 0) {
-        publishSensor("Battery float voltage", "mdi:battery-charging-100", "BatteryFloat", "voltage", "measurement", "V", mpptData);
+        publishSensor("Battery float voltage", "mdi:battery-charging-100", "BatteryFloat", "voltage", "measurement", "V", spMpptData);
     }
     if (mpptData.SmartBatterySenseTemperatureMilliCelsius.first != 0) {
-        publishSensor("Smart Battery Sense temperature", "mdi:temperature-celsius", "SmartBatterySenseTemperature", "temperature", "measurement", "°C", mpptData);
+        publishSensor("Smart Battery Sense temperature", "mdi:temperature-celsius", "SmartBatterySenseTemperature", "temperature", "measurement", "°C", spMpptData);
     }
 }
 
 void HassIntegration::publishSensor(const char *caption, const char *icon, const char *subTopic,
+                                                const char *deviceClass, const char *stateClass,
+                                                const char *unitOfMeasurement,
+                                                const std::shared_ptr<const VeDirectMpptController::data_t> &spMpptData) const
+{
+    // the arguments are string literals, so the pointers stay valid
+    enqueue([=]() {
+        generateSensor(caption, icon, subTopic, deviceClass, stateClass, unitOfMeasurement, *spMpptData);
+    });
+}
+
+void HassIntegration::generateSensor(const char *caption, const char *icon, const char *subTopic,
                                                 const char *deviceClass, const char *stateClass,
                                                 const char *unitOfMeasurement,
                                                 const VeDirectMpptController::data_t &mpptData) const
@@ -92,7 +107,7 @@ void HassIntegration::publishSensor(const char *caption, const char *icon, const
     statTopic.concat("/");
     statTopic.concat(subTopic);
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::jsonAllocator());
 
     root["name"] = caption;
     root["stat_t"] = statTopic;
@@ -107,7 +122,7 @@ void HassIntegration::publishSensor(const char *caption, const char *icon, const
     }
 
     JsonObject deviceObj = root["dev"].to<JsonObject>();
-    createDeviceInfo(deviceObj, mpptData);
+    createDeviceInfo(deviceObj, spMpptData);
 
     if (Configuration.get().Mqtt.Hass.Expire) {
         root["exp_aft"] = Configuration.get().Mqtt.PublishInterval * 3;
@@ -130,6 +145,15 @@ void HassIntegration::publishSensor(const char *caption, const char *icon, const
 }
 
 void HassIntegration::publishBinarySensor(const char *caption, const char *icon, const char *subTopic,
+                                                      const char *payload_on, const char *payload_off,
+                                                      const std::shared_ptr<const VeDirectMpptController::data_t> &spMpptData) const
+{
+    enqueue([=]() {
+        generateBinarySensor(caption, icon, subTopic, payload_on, payload_off, *spMpptData);
+    });
+}
+
+void HassIntegration::generateBinarySensor(const char *caption, const char *icon, const char *subTopic,
                                                       const char *payload_on, const char *payload_off,
                                                       const VeDirectMpptController::data_t &mpptData) const
 {
@@ -151,7 +175,7 @@ void HassIntegration::publishBinarySensor(const char *caption, const char *icon,
     statTopic.concat("/");
     statTopic.concat(subTopic);
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::jsonAllocator());
     root["name"] = caption;
     root["uniq_id"] = serial + "_" + sensorId;
     root["stat_t"] = statTopic;
@@ -163,7 +187,7 @@ void HassIntegration::publishBinarySensor(const char *caption, const char *icon,
     }
 
     JsonObject deviceObj = root["dev"].to<JsonObject>();
-    createDeviceInfo(deviceObj, mpptData);
+    createDeviceInfo(deviceObj, spMpptData);
 
     if (!Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) {
         return;
@@ -1,9 +1,10 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include <solarcharger/victron/Provider.h>
 #include "Configuration.h"
+#include "InputCapture.h"
 #include "PinMapping.h"
 #include "MessageOutput.h"
-#include "SerialPortManager.h"
+#include <string>
 
 namespace SolarChargers::Victron {
 
@@ -24,18 +25,17 @@ bool Provider::init(bool verboseLogging)
         controllerCount++;
     }
 
+    if (initController(pin.victron_rx4, pin.victron_tx4, verboseLogging, 4)) {
+        controllerCount++;
+    }
+
     return controllerCount > 0;
 }
 
 void Provider::deinit()
 {
     std::lock_guard<std::mutex> lock(_mutex);
-
-    _controllers.clear();
-    for (auto const& o: _serialPortOwners) {
-        SerialPortManager.freePort(o.c_str());
-    }
-    _serialPortOwners.clear();
+    _ports.clear();
 }
 
 bool Provider::initController(int8_t rx, int8_t tx, bool logging,
@@ -49,16 +49,27 @@ bool Provider::initController(int8_t rx, int8_t tx, bool logging,
         return false;
     }
 
-    String owner("Victron MPPT ");
-    owner += String(instance);
-    auto oHwSerialPort = SerialPortManager.allocatePort(owner.c_str());
-    if (!oHwSerialPort) { return false; }
-
-    _serialPortOwners.push_back(owner);
+    auto upPort = std::make_unique<Port>("Victron MPPT " + std::to_string(instance));
+
+    uint8_t channel = instance - 1;
+    upPort->getController().setRxTap([channel](uint8_t inbyte) {
+        // the live input is dropped while a recording is replayed
+        if (InputCapture.isReplaying(InputCapture::Source::VeDirect)) { return false; }
+        InputCapture.record(InputCapture::Source::VeDirect, channel, &inbyte, 1);
+        return true;
+    });
+    upPort->setLoopHook([channel](VeDirectMpptController& controller) {
+        InputCapture.replay(InputCapture::Source::VeDirect, channel,
+            [&controller](uint8_t const* data, size_t length) {
+                controller.feed(data, length);
+            });
+    });
+
+    if (!upPort->begin(rx, tx, logging, TaskPlacement::Role::SolarCharger)) {
+        return false;
+    }
 
-    auto upController = std::make_unique<VeDirectMpptController>();
-    upController->init(rx, tx, &MessageOutput, logging, *oHwSerialPort);
-    _controllers.push_back(std::move(upController));
+    _ports.push_back(std::move(upPort));
     return true;
 }
 
@@ -66,14 +77,14 @@ void Provider::loop()
 {
     std::lock_guard<std::mutex> lock(_mutex);
 
-    for (auto const& upController : _controllers) {
-        upController->loop();
-
-        if(upController->isDataValid()) {
-            _stats->update(upController->getData().serialNr_SER, upController->getData(), upController->getLastUpdate());
-        } else {
-            _stats->update(upController->getData().serialNr_SER, std::nullopt, upController->getLastUpdate());
-        }
+    for (auto const& upPort : _ports) {
+        upPort->withController([this](VeDirectMpptController const& controller) {
+            if (controller.isDataValid()) {
+                _stats->update(controller.getData().serialNr_SER, controller.getData(), controller.getLastUpdate());
+            } else {
+                _stats->update(controller.getData().serialNr_SER, std::nullopt, controller.getLastUpdate());
+            }
+        });
     }
 }
 
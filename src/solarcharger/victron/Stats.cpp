@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include <Configuration.h>
+#include <DataBus.h>
 #include <MqttSettings.h>
 #include <MessageOutput.h>
 #include <solarcharger/victron/Stats.h>
@@ -11,139 +12,132 @@ void Stats::update(const String serial, const std::optional<VeDirectMpptControll
     // serial required as index
     if (serial.isEmpty()) { return; }
 
+    // called with every provider loop, so the aggregates are only updated
+    // if a new frame was received or if the data became invalid.
+    auto it = _data.find(serial);
+    if (it != _data.end() && _lastUpdate[serial] == lastUpdate
+            && it->second.has_value() == mpptData.has_value()) {
+        return;
+    }
+
     _data[serial] = mpptData;
     _lastUpdate[serial] = lastUpdate;
-}
-
-uint32_t Stats::getAgeMillis() const
-{
-    uint32_t age = 0;
-    auto now = millis();
-
-    for (auto const& entry : _data) {
-        if (!entry.second) { continue; }
-        if (!_lastUpdate[entry.first]) { continue; }
-
-        age = std::max<uint32_t>(age, now - _lastUpdate[entry.first]);
-    }
 
-    return age;
+    updateAggregates();
 
+    DataBus.publish(DataBusClass::Topic::SolarCharger);
 }
 
-std::optional<float> Stats::getOutputPowerWatts() const
+void Stats::updateAggregates() const
 {
-    std::optional<float> sum = std::nullopt;
-
-    for (auto const& entry : _data) {
-        if (!entry.second) { continue; }
-        
-        sum = sum.has_value() ? *sum + entry.second->batteryOutputPower_W : entry.second->batteryOutputPower_W;
-    }
+    Aggregates agg;
+    auto now = millis();
 
-    return sum;
-}
+    auto add = [](auto& sum, auto value) {
+        sum = sum.has_value() ? *sum + value : value;
+    };
 
-std::optional<float> Stats::getOutputVoltage() const
-{
-    std::optional<float> min = std::nullopt;
+    std::optional<float> panelPower = std::nullopt;
 
     for (auto const& entry : _data) {
         if (!entry.second) { continue; }
+        auto const& data = *entry.second;
 
-        float volts = entry.second->batteryVoltage_V_mV / 1000.0;
-        min = min.has_value() ? std::min(*min, volts) : volts;
-    }
-
-    return min;
-}
+        auto lastUpdate = _lastUpdate[entry.first];
+        if (lastUpdate && (!agg.oOldestUpdate || now - lastUpdate > now - *agg.oOldestUpdate)) {
+            agg.oOldestUpdate = lastUpdate;
+        }
 
-std::optional<uint16_t> Stats::getPanelPowerWatts() const
-{
-    std::optional<float> sum = std::nullopt;
+        add(agg.oOutputPowerWatts, static_cast<float>(data.batteryOutputPower_W));
 
-    for (auto const& entry : _data) {
-        if (!entry.second) { continue; }
+        float volts = data.batteryVoltage_V_mV / 1000.0;
+        agg.oOutputVoltage = agg.oOutputVoltage.has_value() ? std::min(*agg.oOutputVoltage, volts) : volts;
 
         // if any charge controller is part of a VE.Smart network, and if the
         // charge controller is connected in a way that allows to send
         // requests, we should have the "network total DC input power" available.
-        auto networkPower = entry.second->NetworkTotalDcInputPowerMilliWatts;
-        if (networkPower.first > 0) {
-            return static_cast<uint16_t>(networkPower.second / 1000.0);
+        auto networkPower = data.NetworkTotalDcInputPowerMilliWatts;
+        if (networkPower.first > 0 && !agg.oPanelPowerWatts) {
+            agg.oPanelPowerWatts = static_cast<uint16_t>(networkPower.second / 1000.0);
         }
+        add(panelPower, static_cast<float>(data.panelPower_PPV_W));
+
+        add(agg.oYieldTotal, data.yieldTotal_H19_Wh / 1000.0f);
+        add(agg.oYieldDay, static_cast<float>(data.yieldToday_H20_Wh));
+
+        // state of operation from the first available controller
+        if (!agg.oStateOfOperation) {
+            // see victron protocol documentation for CS values
+            switch (data.currentState_CS) {
+                case 0: agg.oStateOfOperation = Stats::StateOfOperation::Off; break;
+                case 3: agg.oStateOfOperation = Stats::StateOfOperation::Bulk; break;
+                case 4: agg.oStateOfOperation = Stats::StateOfOperation::Absorption; break;
+                case 5: agg.oStateOfOperation = Stats::StateOfOperation::Float; break;
+                default: agg.oStateOfOperation = Stats::StateOfOperation::Various; break;
+            }
+        }
+
+        // only use valid and not outdated values
+        if (!agg.oFloatVoltage && data.BatteryFloatMilliVolt.first > 0) {
+            agg.oFloatVoltage = data.BatteryFloatMilliVolt.second / 1000.0;
+        }
+
+        if (!agg.oAbsorptionVoltage && data.BatteryAbsorptionMilliVolt.first > 0) {
+            agg.oAbsorptionVoltage = data.BatteryAbsorptionMilliVolt.second / 1000.0;
+        }
+    }
 
-        sum = sum.has_value() ? *sum + entry.second->panelPower_PPV_W : entry.second->panelPower_PPV_W;
+    if (!agg.oPanelPowerWatts && panelPower) {
+        agg.oPanelPowerWatts = static_cast<uint16_t>(*panelPower);
     }
 
-    return sum;
+    _aggregates = agg;
 }
 
-std::optional<float> Stats::getYieldTotal() const
+uint32_t Stats::getAgeMillis() const
 {
-    std::optional<float> sum = std::nullopt;
-
-    for (auto const& entry : _data) {
-        if (!entry.second) { continue; }
-
-        float yield = entry.second->yieldTotal_H19_Wh / 1000.0;
-        sum = sum.has_value() ? *sum + yield : yield;
-    }
+    if (!_aggregates.oOldestUpdate) { return 0; }
+    return millis() - *_aggregates.oOldestUpdate;
+}
 
-    return sum;
+std::optional<float> Stats::getOutputPowerWatts() const
+{
+    return _aggregates.oOutputPowerWatts;
 }
 
-std::optional<float> Stats::getYieldDay() const
+std::optional<float> Stats::getOutputVoltage() const
 {
-    std::optional<float> sum = std::nullopt;
+    return _aggregates.oOutputVoltage;
+}
 
-    for (auto const& entry : _data) {
-        if (!entry.second) { continue; }
+std::optional<uint16_t> Stats::getPanelPowerWatts() const
+{
+    return _aggregates.oPanelPowerWatts;
+}
 
-        sum = sum.has_value() ? *sum + entry.second->yieldToday_H20_Wh : entry.second->yieldToday_H20_Wh;
-    }
+std::optional<float> Stats::getYieldTotal() const
+{
+    return _aggregates.oYieldTotal;
+}
 
-    return sum;
+std::optional<float> Stats::getYieldDay() const
+{
+    return _aggregates.oYieldDay;
 }
 
 std::optional<Stats::StateOfOperation> Stats::getStateOfOperation() const
 {
-    for (auto const& entry : _data) {
-        if (!entry.second) { continue; }
-        // see victron protocol documentation for CS values
-        switch (entry.second->currentState_CS) {
-            case 0: return Stats::StateOfOperation::Off;
-            case 3: return Stats::StateOfOperation::Bulk;
-            case 4: return Stats::StateOfOperation::Absorption;
-            case 5: return Stats::StateOfOperation::Float;
-            default: return Stats::StateOfOperation::Various;
-        }
-    }
-    return std::nullopt;
+    return _aggregates.oStateOfOperation;
 }
 
 std::optional<float> Stats::getFloatVoltage() const
 {
-    for (auto const& entry : _data) {
-        if (!entry.second) { continue; }
-        auto voltage = entry.second->BatteryFloatMilliVolt;
-        if (voltage.first > 0) { // only return valid and not outdated value
-            return voltage.second / 1000.0;
-        }
-    }
-    return std::nullopt;
+    return _aggregates.oFloatVoltage;
 }
 
 std::optional<float> Stats::getAbsorptionVoltage() const
 {
-    for (auto const& entry : _data) {
-        if (!entry.second) { continue; }
-        auto voltage = entry.second->BatteryAbsorptionMilliVolt;
-        if (voltage.first > 0) { // only return valid and not outdated value
-            return voltage.second / 1000.0;
-        }
-    }
-    return std::nullopt;
+    return _aggregates.oAbsorptionVoltage;
 }
 
 void Stats::getLiveViewData(JsonVariant& root, const boolean fullUpdate, const uint32_t lastPublish) const
@@ -326,14 +320,11 @@ void Stats::mqttPublish() const
 }
 
 void Stats::publishMpptData(const VeDirectMpptController::data_t &currentData, const VeDirectMpptController::data_t &previousData) const {
-    String value;
-    String topic = "victron/";
-    topic.concat(currentData.serialNr_SER);
-    topic.concat("/");
+    char const* serial = currentData.serialNr_SER;
 
 #define PUBLISH(sm, t, val) \
     if (_PublishFull || currentData.sm != previousData.sm) { \
-        MqttSettings.publish(topic + t, String(val)); \
+        MqttSettings.publish(MqttTopicRegistry.intern("victron/", serial, "/" t), String(val).c_str()); \
     }
 
     PUBLISH(productID_PID,           "PID",  currentData.getPidAsString().data());
@@ -363,7 +354,7 @@ void Stats::publishMpptData(const VeDirectMpptController::data_t &currentData, c
 
 #define PUBLISH_OPT(sm, t, val) \
     if (currentData.sm.first != 0 && (_PublishFull || currentData.sm.second != previousData.sm.second)) { \
-        MqttSettings.publish(topic + t, String(val)); \
+        MqttSettings.publish(MqttTopicRegistry.intern("victron/", serial, "/" t), String(val).c_str()); \
     }
 
     PUBLISH_OPT(relayState_RELAY,                         "RELAY",                        currentData.relayState_RELAY.second ? "ON" : "OFF");
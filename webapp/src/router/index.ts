@@ -1,30 +1,13 @@
-import AboutView from '@/views/AboutView.vue';
-import BatteryAdminView from '@/views/BatteryAdminView.vue';
-import AcChargerAdminView from '@/views/AcChargerAdminView.vue';
-import ConfigAdminView from '@/views/ConfigAdminView.vue';
-import ConsoleInfoView from '@/views/ConsoleInfoView.vue';
-import DeviceAdminView from '@/views/DeviceAdminView.vue';
-import DtuAdminView from '@/views/DtuAdminView.vue';
 import ErrorView from '@/views/ErrorView.vue';
-import FirmwareUpgradeView from '@/views/FirmwareUpgradeView.vue';
 import HomeView from '@/views/HomeView.vue';
-import SolarChargerAdminView from '@/views/SolarChargerAdminView.vue';
-import PowerMeterAdminView from '@/views/PowerMeterAdminView.vue';
-import PowerLimiterAdminView from '@/views/PowerLimiterAdminView.vue';
-import InverterAdminView from '@/views/InverterAdminView.vue';
 import LoginView from '@/views/LoginView.vue';
-import MaintenanceRebootView from '@/views/MaintenanceRebootView.vue';
-import MqttAdminView from '@/views/MqttAdminView.vue';
-import MqttInfoView from '@/views/MqttInfoView.vue';
-import NetworkAdminView from '@/views/NetworkAdminView.vue';
-import NetworkInfoView from '@/views/NetworkInfoView.vue';
-import NtpAdminView from '@/views/NtpAdminView.vue';
-import NtpInfoView from '@/views/NtpInfoView.vue';
-import SecurityAdminView from '@/views/SecurityAdminView.vue';
-import SystemInfoView from '@/views/SystemInfoView.vue';
 import WaitRestartView from '@/views/WaitRestartView.vue';
 import { createRouter, createWebHistory } from 'vue-router';
 
+// the live dashboard, and the views shown while it cannot be, are part of
+// the initial bundle. all other views are loaded on navigation from a
+// separate chunk (see vite.config.ts), as kiosk displays never show them.
+
 const router = createRouter({
     history: createWebHistory(import.meta.env.BASE_URL),
     linkActiveClass: 'active',
@@ -54,107 +37,107 @@ const router = createRouter({
         {
             path: '/about',
             name: 'About',
-            component: AboutView,
+            component: () => import('@/views/AboutView.vue'),
         },
         {
             path: '/info/network',
             name: 'Network',
-            component: NetworkInfoView,
+            component: () => import('@/views/NetworkInfoView.vue'),
         },
         {
             path: '/info/system',
             name: 'System',
-            component: SystemInfoView,
+            component: () => import('@/views/SystemInfoView.vue'),
         },
         {
             path: '/info/ntp',
             name: 'NTP',
-            component: NtpInfoView,
+            component: () => import('@/views/NtpInfoView.vue'),
         },
         {
             path: '/info/mqtt',
             name: 'MqTT',
-            component: MqttInfoView,
+            component: () => import('@/views/MqttInfoView.vue'),
         },
         {
             path: '/info/console',
             name: 'Web Console',
-            component: ConsoleInfoView,
+            component: () => import('@/views/ConsoleInfoView.vue'),
         },
         {
             path: '/settings/network',
             name: 'Network Settings',
-            component: NetworkAdminView,
+            component: () => import('@/views/NetworkAdminView.vue'),
         },
         {
             path: '/settings/ntp',
             name: 'NTP Settings',
-            component: NtpAdminView,
+            component: () => import('@/views/NtpAdminView.vue'),
         },
         {
             path: '/settings/solarcharger',
             name: 'Solar Charger Settings',
-            component: SolarChargerAdminView,
+            component: () => import('@/views/SolarChargerAdminView.vue'),
         },
         {
             path: '/settings/powermeter',
             name: 'Power meter Settings',
-            component: PowerMeterAdminView,
+            component: () => import('@/views/PowerMeterAdminView.vue'),
         },
         {
             path: '/settings/powerlimiter',
             name: 'Power limiter Settings',
-            component: PowerLimiterAdminView,
+            component: () => import('@/views/PowerLimiterAdminView.vue'),
         },
         {
             path: '/settings/battery',
             name: 'Battery Settings',
-            component: BatteryAdminView,
+            component: () => import('@/views/BatteryAdminView.vue'),
         },
         {
             path: '/settings/chargerac',
             name: 'Charger Settings',
-            component: AcChargerAdminView,
+            component: () => import('@/views/AcChargerAdminView.vue'),
         },
         {
             path: '/settings/mqtt',
             name: 'MqTT Settings',
-            component: MqttAdminView,
+            component: () => import('@/views/MqttAdminView.vue'),
         },
         {
             path: '/settings/inverter',
             name: 'Inverter Settings',
-            component: InverterAdminView,
+            component: () => import('@/views/InverterAdminView.vue'),
         },
         {
             path: '/settings/dtu',
             name: 'DTU Settings',
-            component: DtuAdminView,
+            component: () => import('@/views/DtuAdminView.vue'),
         },
         {
             path: '/settings/device',
             name: 'Device Manager',
-            component: DeviceAdminView,
+            component: () => import('@/views/DeviceAdminView.vue'),
         },
         {
             path: '/firmware/upgrade',
             name: 'Firmware Upgrade',
-            component: FirmwareUpgradeView,
+            component: () => import('@/views/FirmwareUpgradeView.vue'),
         },
         {
             path: '/settings/config',
             name: 'Config Management',
-            component: ConfigAdminView,
+            component: () => import('@/views/ConfigAdminView.vue'),
         },
         {
             path: '/settings/security',
             name: 'Security',
-            component: SecurityAdminView,
+            component: () => import('@/views/SecurityAdminView.vue'),
         },
         {
             path: '/maintenance/reboot',
             name: 'Device Reboot',
-            component: MaintenanceRebootView,
+            component: () => import('@/views/MaintenanceRebootView.vue'),
         },
         {
             path: '/wait',
@@ -2,7 +2,9 @@ export interface AcChargerConfig {
     enabled: boolean;
     verbose_logging: boolean;
     hardware_interface: number;
+    available_hardware_interfaces: number[];
     can_controller_frequency: number;
+    unit_count: number;
     auto_power_enabled: boolean;
     auto_power_batterysoc_limits_enabled: boolean;
     voltage_limit: number;
@@ -2,8 +2,16 @@ export interface BatteryConfig {
     enabled: boolean;
     verbose_logging: boolean;
     provider: number;
+    available_providers: number[];
+    additional_providers: number;
+    soc_aggregation: number;
     jkbms_interface: number;
     jkbms_polling_interval: number;
+    jbdbms_cell_voltages_divider: number;
+    mqtt_full_publish_interval: number;
+    mqtt_deadband_relative: number;
+    mqtt_cell_deadband_millivolt: number;
+    mqtt_cell_voltages_json: boolean;
     mqtt_soc_topic: string;
     mqtt_soc_json_path: string;
     mqtt_voltage_topic: string;
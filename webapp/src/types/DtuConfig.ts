@@ -10,6 +10,7 @@ export interface DtuConfig {
     serial: number;
     pollinterval: number;
     verbose_logging: boolean;
+    low_power_night: boolean;
     nrf_enabled: boolean;
     nrf_palevel: number;
     cmt_enabled: boolean;
@@ -29,6 +29,7 @@ export interface RadioStatistics {
     rx_fail_partial: number;
     rx_fail_corrupt: number;
     rssi: number;
+    lost_fragments: number[];
 }
 
 export interface Inverter {
@@ -37,6 +38,7 @@ export interface Inverter {
     order: number;
     data_age_ms: number;
     poll_enabled: boolean;
+    poll_interval_ms: number;
     reachable: boolean;
     producing: boolean;
     limit_relative: number;
@@ -46,6 +48,7 @@ export interface Inverter {
     DC: InverterStatistics[];
     INV: InverterStatistics[];
     radio_stats: RadioStatistics;
+    delta?: boolean;
 }
 
 export interface Total {
@@ -84,6 +87,16 @@ export interface Battery {
 export interface PowerMeter {
     enabled: boolean;
     Power: ValueObject;
+    Predicted?: ValueObject;
+    Residual?: ValueObject;
+}
+
+export interface PowerLimiter {
+    enabled: boolean;
+    Losses?: ValueObject;
+    SuppressedUpdates?: ValueObject;
+    Resistance?: ValueObject;
+    FitQuality?: ValueObject;
 }
 
 export interface LiveData {
@@ -94,4 +107,5 @@ export interface LiveData {
     huawei: Huawei;
     battery: Battery;
     power_meter: PowerMeter;
+    power_limiter: PowerLimiter;
 }
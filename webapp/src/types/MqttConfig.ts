@@ -8,7 +8,11 @@ export interface MqttConfig {
     mqtt_password: string;
     mqtt_topic: string;
     mqtt_publish_interval: number;
+    mqtt_publish_refresh_interval: number;
+    mqtt_publish_deadband: number;
+    mqtt_inverter_json_payload: boolean;
     mqtt_clean_session: boolean;
+    mqtt_outbox_limit: number;
     mqtt_retain: boolean;
     mqtt_tls: boolean;
     mqtt_root_ca_cert: string;
@@ -24,4 +28,5 @@ export interface MqttConfig {
     mqtt_hass_retain: boolean;
     mqtt_hass_topic: string;
     mqtt_hass_individualpanels: boolean;
+    mqtt_hass_devicediscovery: boolean;
 }
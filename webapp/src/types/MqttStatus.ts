@@ -19,4 +19,5 @@ export interface MqttStatus {
     mqtt_hass_retain: boolean;
     mqtt_hass_topic: string;
     mqtt_hass_individualpanels: boolean;
+    mqtt_hass_devicediscovery: boolean;
 }
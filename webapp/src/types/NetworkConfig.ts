@@ -9,8 +9,21 @@ export interface NetworkConfig {
     dns1: string;
     dns2: string;
     aptimeout: number;
+    powersave: boolean;
+    failover: boolean;
     mdnsenabled: boolean;
     syslogenabled: boolean;
     sysloghostname: string;
     syslogport: number;
+    syslogprotocol: number;
+    influxenabled: boolean;
+    influxhostname: string;
+    influxport: number;
+    influxprotocol: number;
+    influxinterval: number;
+    influxpath: string;
+    influxtoken: string;
+    modbusenabled: boolean;
+    modbusport: number;
+    modbuswriteenabled: boolean;
 }
@@ -1,3 +1,19 @@
+export interface W5500Status {
+    spi_clock: number;
+    rx_frames: number;
+    rx_bytes: number;
+    rx_errors: number;
+    rx_rate: number;
+    rx_latency_avg: number;
+    rx_latency_max: number;
+    tx_frames: number;
+    tx_bytes: number;
+    tx_errors: number;
+    tx_rate: number;
+    tx_latency_avg: number;
+    tx_latency_max: number;
+}
+
 export interface NetworkStatus {
     // WifiStationInfo
     sta_status: boolean;
@@ -17,6 +33,7 @@ export interface NetworkStatus {
     network_dns2: string;
     network_mac: string;
     network_mode: string;
+    w5500?: W5500Status;
     // InterfaceApInfo
     ap_ip: string;
     ap_mac: string;
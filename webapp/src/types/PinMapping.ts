@@ -77,6 +77,7 @@ export interface Device {
     display: Display;
     victron: Victron;
     battery: Battery;
+    battery2: Battery;
     huawei: Huawei;
     powermeter: PowerMeter;
 }
@@ -37,6 +37,7 @@ export interface PowerLimiterConfig {
     enabled: boolean;
     verbose_logging: boolean;
     solar_passthrough_enabled: boolean;
+    solar_power_prediction: boolean;
     conduction_losses: number;
     battery_always_use_at_night: boolean;
     target_power_consumption: number;
@@ -48,6 +49,8 @@ export interface PowerLimiterConfig {
     voltage_start_threshold: number;
     voltage_stop_threshold: number;
     voltage_load_correction_factor: number;
+    voltage_load_correction_adaptive: boolean;
+    battery_capacity: number;
     inverter_restart_hour: number;
     full_solar_passthrough_soc: number;
     full_solar_passthrough_start_voltage: number;
@@ -56,5 +59,19 @@ export interface PowerLimiterConfig {
     inverter_channel_id_for_dc_voltage: number;
     restart_hour: number;
     total_upper_power_limit: number;
+    distribution_strategy: number;
+    cluster_role: number;
+    cluster_port: number;
+    cluster_id: number;
+    latency_alert_reaction_ms: number;
+    latency_alert_meter_interval_ms: number;
+    latency_alert_stats_age_ms: number;
+    shadow_enabled: boolean;
+    shadow_target_power_consumption: number;
+    shadow_target_power_consumption_hysteresis: number;
+    shadow_battery_soc_start_threshold: number;
+    shadow_battery_soc_stop_threshold: number;
+    shadow_voltage_start_threshold: number;
+    shadow_voltage_stop_threshold: number;
     inverters: PowerLimiterInverterConfig[];
 }
@@ -0,0 +1,22 @@
+export interface PowerLimiterScorecardResult {
+    start: number; // unix timestamp
+    seconds: number;
+    active_seconds: number;
+    import_wh: number;
+    export_wh: number;
+    commands: number;
+    reactions: number;
+    mean_abs_error?: number; // in W
+    mean_reaction?: number; // in ms
+    status: Record<string, number>; // percent of the covered time
+}
+
+export interface PowerLimiterScorecardWindow {
+    current?: PowerLimiterScorecardResult;
+    completed?: PowerLimiterScorecardResult;
+}
+
+export interface PowerLimiterScorecard {
+    quarter_hour: PowerLimiterScorecardWindow;
+    day: PowerLimiterScorecardWindow;
+}
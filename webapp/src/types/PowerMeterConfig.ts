@@ -13,7 +13,10 @@ export interface PowerMeterMqttConfig {
 
 export interface PowerMeterSerialSdmConfig {
     polling_interval: number;
+    slow_polling_interval: number;
     address: number;
+    submeter_address: number;
+    submeter_three_phases: boolean;
 }
 
 export interface PowerMeterHttpJsonValue {
@@ -35,13 +38,40 @@ export interface PowerMeterHttpSmlConfig {
     http_request: HttpRequestConfig;
 }
 
+export interface PowerMeterUdpSmaHmConfig {
+    serial: number;
+    submeter_serial: number;
+}
+
+export interface PowerMeterUdpPushConfig {
+    port: number;
+}
+
+export interface PowerMeterShellyRpcConfig {
+    hostname: string;
+    password: string;
+    em_id: number;
+}
+
+export interface PowerMeterFusionConfig {
+    enabled: boolean;
+    source: number;
+    max_deviation: number;
+}
+
 export interface PowerMeterConfig {
     enabled: boolean;
     verbose_logging: boolean;
     source: number;
+    available_sources: number[];
+    predictive_filter: boolean;
     interval: number;
     mqtt: PowerMeterMqttConfig;
     serial_sdm: PowerMeterSerialSdmConfig;
     http_json: PowerMeterHttpJsonConfig;
     http_sml: PowerMeterHttpSmlConfig;
+    udp_smahm: PowerMeterUdpSmaHmConfig;
+    udp_push: PowerMeterUdpPushConfig;
+    shelly_rpc: PowerMeterShellyRpcConfig;
+    fusion: PowerMeterFusionConfig;
 }
@@ -0,0 +1,17 @@
+export interface PowerMeterHistogram {
+    count: number;
+    sum: number; // in µs
+    buckets: number[];
+}
+
+export interface PowerMeterSourceDiagnostics {
+    source: number;
+    key: string;
+    metrics: Record<string, PowerMeterHistogram>;
+    failures: Record<string, number>;
+}
+
+export interface PowerMeterDiagnostics {
+    bounds: Record<string, number[]>; // in µs
+    sources: PowerMeterSourceDiagnostics[];
+}
@@ -15,6 +15,8 @@ export interface SolarChargerConfig {
     enabled: boolean;
     verbose_logging: boolean;
     provider: number;
+    additional_providers: number;
+    available_providers: number[];
     publish_updates_only: boolean;
     mqtt: SolarChargerMqttConfig;
 }
@@ -2,11 +2,37 @@ export interface TaskDetail {
     name: string;
     stack_watermark: number;
     priority: number;
+    core: number; // -1 if the task is not pinned
 }
 
 export interface UartAllocation {
     port: number;
     owner: string;
+    shared: boolean;
+}
+
+export interface BootStage {
+    name: string;
+    start_ms: number;
+    duration_ms: number;
+    concurrent: boolean;
+    wait_ms: number;
+}
+
+export interface BootTimes {
+    control_ms: number;
+    stages: BootStage[];
+}
+
+export interface QueueLatency {
+    last: number;
+    avg: number;
+    max: number;
+}
+
+export interface RadioQueueLatency {
+    control: QueueLatency;
+    telemetry: QueueLatency;
 }
 
 export interface SystemStatus {
@@ -50,8 +76,12 @@ export interface SystemStatus {
     nrf_configured: boolean;
     nrf_connected: boolean;
     nrf_pvariant: boolean;
+    nrf_queue_latency: RadioQueueLatency;
     cmt_configured: boolean;
     cmt_connected: boolean;
+    cmt_queue_latency: RadioQueueLatency;
     // UARTs
     uarts: UartAllocation[];
+    // BootTimes
+    boot: BootTimes;
 }
@@ -0,0 +1,114 @@
+// all live views share a single websocket, on which each view subscribes
+// to the channel it displays. the socket is opened with the first and
+// closed with the last subscription. a heartbeat keeps it open and
+// reconnects it if it was closed.
+import { authUrl } from '@/utils/authentication';
+import { ChannelDataDecoder } from '@/utils/msgpack';
+
+// eslint-disable-next-line @typescript-eslint/no-explicit-any
+type DataHandler = (data: any) => void;
+type ConnectionHandler = (connected: boolean) => void;
+
+const heartbeatMillis = 59 * 1000;
+
+class LiveSocket {
+    private socket: WebSocket | null = null;
+    private decoder = new ChannelDataDecoder();
+    private handlers = new Map<string, Set<DataHandler>>();
+    private connectionHandlers = new Set<ConnectionHandler>();
+    private heartInterval = 0;
+
+    // returns a function which ends the subscription
+    subscribe(channel: string, handler: DataHandler, onConnection?: ConnectionHandler): () => void {
+        let handlers = this.handlers.get(channel);
+        if (handlers === undefined) {
+            handlers = new Set();
+            this.handlers.set(channel, handlers);
+        }
+        handlers.add(handler);
+        if (onConnection !== undefined) {
+            this.connectionHandlers.add(onConnection);
+            onConnection(this.socket?.readyState === WebSocket.OPEN);
+        }
+
+        if (this.socket === null) {
+            this.connect();
+        } else {
+            this.sendSubscriptions();
+        }
+
+        return () => {
+            handlers.delete(handler);
+            if (handlers.size === 0) {
+                this.handlers.delete(channel);
+            }
+            if (onConnection !== undefined) {
+                this.connectionHandlers.delete(onConnection);
+            }
+
+            if (this.handlers.size === 0) {
+                this.close();
+            } else {
+                this.sendSubscriptions();
+            }
+        };
+    }
+
+    // forces a new connection, e.g., once the credentials changed
+    reconnect() {
+        this.close();
+        if (this.handlers.size > 0) {
+            this.connect();
+        }
+    }
+
+    private connect() {
+        const { protocol, host } = location;
+        const webSocketUrl = `${protocol === 'https:' ? 'wss' : 'ws'}://${authUrl()}${host}/live`;
+
+        const socket = new WebSocket(webSocketUrl);
+        this.socket = socket;
+        this.decoder.attach(socket);
+
+        socket.addEventListener('open', () => {
+            this.sendSubscriptions();
+            this.connectionHandlers.forEach((handler) => handler(true));
+        });
+
+        socket.addEventListener('close', () => {
+            this.connectionHandlers.forEach((handler) => handler(false));
+        });
+
+        socket.addEventListener('message', (event) => {
+            const frame = this.decoder.decode(event.data);
+            this.handlers.get(frame.channel)?.forEach((handler) => handler(frame.data));
+        });
+
+        this.heartInterval = setInterval(() => {
+            if (this.socket?.readyState === WebSocket.OPEN) {
+                this.socket.send('ping');
+            } else if (this.socket?.readyState === WebSocket.CLOSED) {
+                this.close();
+                this.connect();
+            }
+        }, heartbeatMillis);
+    }
+
+    private close() {
+        if (this.heartInterval) {
+            clearInterval(this.heartInterval);
+            this.heartInterval = 0;
+        }
+        this.socket?.close();
+        this.socket = null;
+    }
+
+    private sendSubscriptions() {
+        if (this.socket?.readyState !== WebSocket.OPEN) {
+            return;
+        }
+        this.socket.send('subscribe:' + [...this.handlers.keys()].join(','));
+    }
+}
+
+export const liveSocket = new LiveSocket();
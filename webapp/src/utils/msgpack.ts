@@ -0,0 +1,190 @@
+// decodes the frames of the live data websockets. after the socket was
+// opened, the firmware is asked to send MessagePack frames, in which object
+// keys are indices into a dictionary which is built up while receiving
+// frames. text frames, which are sent until the request was processed, are
+// parsed as JSON. the frames of the multiplexed socket carry the channel
+// they belong to, each channel having its own dictionary.
+
+const encodingRequest = 'encoding:msgpack';
+
+class Reader {
+    private view: DataView;
+    private pos = 0;
+    private textDecoder = new TextDecoder();
+
+    constructor(
+        buffer: ArrayBuffer,
+        private keys: string[]
+    ) {
+        this.view = new DataView(buffer);
+    }
+
+    readByte(): number {
+        return this.view.getUint8(this.pos++);
+    }
+
+    readValue(): unknown {
+        const type = this.readByte();
+
+        if (type < 0x80) return type;
+        if (type < 0x90) return this.readMap(type & 0x0f);
+        if (type < 0xa0) return this.readArray(type & 0x0f);
+        if (type < 0xc0) return this.readString(type & 0x1f);
+        if (type >= 0xe0) return type - 0x100;
+
+        switch (type) {
+            case 0xc0:
+                return null;
+            case 0xc2:
+                return false;
+            case 0xc3:
+                return true;
+            case 0xca:
+                return this.advance(4, this.view.getFloat32(this.pos));
+            case 0xcb:
+                return this.advance(8, this.view.getFloat64(this.pos));
+            case 0xcc:
+                return this.advance(1, this.view.getUint8(this.pos));
+            case 0xcd:
+                return this.advance(2, this.view.getUint16(this.pos));
+            case 0xce:
+                return this.advance(4, this.view.getUint32(this.pos));
+            case 0xcf:
+                return this.advance(8, Number(this.view.getBigUint64(this.pos)));
+            case 0xd0:
+                return this.advance(1, this.view.getInt8(this.pos));
+            case 0xd1:
+                return this.advance(2, this.view.getInt16(this.pos));
+            case 0xd2:
+                return this.advance(4, this.view.getInt32(this.pos));
+            case 0xd3:
+                return this.advance(8, Number(this.view.getBigInt64(this.pos)));
+            case 0xd9:
+                return this.readString(this.advance(1, this.view.getUint8(this.pos)));
+            case 0xda:
+                return this.readString(this.advance(2, this.view.getUint16(this.pos)));
+            case 0xdb:
+                return this.readString(this.advance(4, this.view.getUint32(this.pos)));
+            case 0xdc:
+                return this.readArray(this.advance(2, this.view.getUint16(this.pos)));
+            case 0xdd:
+                return this.readArray(this.advance(4, this.view.getUint32(this.pos)));
+            case 0xde:
+                return this.readMap(this.advance(2, this.view.getUint16(this.pos)));
+            case 0xdf:
+                return this.readMap(this.advance(4, this.view.getUint32(this.pos)));
+        }
+
+        throw new Error(`unsupported MessagePack type 0x${type.toString(16)}`);
+    }
+
+    private advance<T>(bytes: number, value: T): T {
+        this.pos += bytes;
+        return value;
+    }
+
+    private readString(length: number): string {
+        const bytes = new Uint8Array(this.view.buffer, this.view.byteOffset + this.pos, length);
+        this.pos += length;
+        return this.textDecoder.decode(bytes);
+    }
+
+    private readArray(size: number): unknown[] {
+        const array = new Array(size);
+        for (let i = 0; i < size; i++) {
+            array[i] = this.readValue();
+        }
+        return array;
+    }
+
+    private readMap(size: number): Record<string, unknown> {
+        const map: Record<string, unknown> = {};
+        for (let i = 0; i < size; i++) {
+            const key = this.readValue();
+            const name = typeof key === 'number' ? this.keys[key] : String(key);
+            map[name] = this.readValue();
+        }
+        return map;
+    }
+}
+
+export class LiveDataDecoder {
+    private keys: string[] = [];
+
+    // asks the firmware for binary frames once the socket is open
+    attach(socket: WebSocket) {
+        socket.binaryType = 'arraybuffer';
+        socket.addEventListener('open', () => socket.send(encodingRequest));
+        this.keys = [];
+    }
+
+    // eslint-disable-next-line @typescript-eslint/no-explicit-any
+    decode(data: string | ArrayBuffer): any {
+        if (typeof data === 'string') {
+            return JSON.parse(data);
+        }
+
+        // the frame is an array [base, [keys...], payload]. the keys are
+        // added to the dictionary before the payload is read.
+        const reader = new Reader(data, this.keys);
+        if (reader.readByte() !== 0x93) {
+            throw new Error('unexpected live data frame');
+        }
+
+        const base = reader.readValue() as number;
+        const newKeys = reader.readValue() as string[];
+        newKeys.forEach((key, i) => {
+            this.keys[base + i] = key;
+        });
+
+        return reader.readValue();
+    }
+}
+
+export interface ChannelFrame {
+    channel: string;
+    // eslint-disable-next-line @typescript-eslint/no-explicit-any
+    data: any;
+}
+
+export class ChannelDataDecoder {
+    private keys = new Map<string, string[]>();
+
+    attach(socket: WebSocket) {
+        socket.binaryType = 'arraybuffer';
+        socket.addEventListener('open', () => socket.send(encodingRequest));
+        this.keys.clear();
+    }
+
+    decode(data: string | ArrayBuffer): ChannelFrame {
+        if (typeof data === 'string') {
+            return JSON.parse(data) as ChannelFrame;
+        }
+
+        // the frame is an array [channel, base, [keys...], payload]. the
+        // channel is read before its dictionary is known.
+        const peek = new Reader(data, []);
+        if (peek.readByte() !== 0x94) {
+            throw new Error('unexpected live data frame');
+        }
+        const channel = peek.readValue() as string;
+
+        let keys = this.keys.get(channel);
+        if (keys === undefined) {
+            keys = [];
+            this.keys.set(channel, keys);
+        }
+
+        const reader = new Reader(data, keys);
+        reader.readByte();
+        reader.readValue();
+
+        const base = reader.readValue() as number;
+        const newKeys = reader.readValue() as string[];
+        newKeys.forEach((key, i) => {
+            keys[base + i] = key;
+        });
+
+        return { channel, data: reader.readValue() };
+    }
+}
@@ -18,11 +18,39 @@ try {
     proxy_target = '192.168.20.110';
 }
 
+// whether the module is statically imported by the entry module, directly
+// or through other modules, i.e., whether it is part of the initial bundle.
+type ModuleInfoGetter = (id: string) => { isEntry: boolean; importers: readonly string[] } | null;
+const loadedByEntry = new Map<string, boolean>();
+function isLoadedByEntry(id: string, getModuleInfo: ModuleInfoGetter, visiting = new Set<string>()): boolean {
+    const known = loadedByEntry.get(id);
+    if (known !== undefined) return known;
+
+    const info = getModuleInfo(id);
+    if (!info) return true;
+    if (info.isEntry) return true;
+
+    // import cycles are resolved by the other importers
+    if (visiting.has(id)) return false;
+    visiting.add(id);
+
+    const result = info.importers.some((importer) => isLoadedByEntry(importer, getModuleInfo, visiting));
+    visiting.delete(id);
+
+    // a negative result within a cycle depends on the modules being visited
+    if (result || visiting.size === 0) loadedByEntry.set(id, result);
+    return result;
+}
+
 // https://vitejs.dev/config/
 export default defineConfig(({ command }) => { return {
   plugins: [
     vue(),
-    viteCompression({ deleteOriginFile: true, threshold: 0 }),
+    // both variants are embedded, the firmware ships the brotli one if the
+    // client accepts it. the compressions run in parallel, so neither may
+    // delete the original file the other one reads.
+    viteCompression({ deleteOriginFile: false, threshold: 0 }),
+    viteCompression({ deleteOriginFile: false, threshold: 0, algorithm: 'brotliCompress', ext: '.br' }),
     cssInjectedByJsPlugin(),
     VueI18nPlugin({
         /* options */
@@ -48,10 +76,14 @@ export default defineConfig(({ command }) => { return {
     chunkSizeWarningLimit: 1024,
     rollupOptions: {
       output: {
-        // Only create one js file
-        inlineDynamicImports: true,
-        // Get rid of hash on js file
+        // the firmware embeds a fixed set of files: the lazily loaded views
+        // and all modules only they depend on form a single chunk.
+        manualChunks(id, { getModuleInfo }) {
+          return isLoadedByEntry(id, getModuleInfo) ? undefined : 'views';
+        },
+        // Get rid of hash on js files
         entryFileNames: 'js/app.js',
+        chunkFileNames: 'js/[name].js',
         // Get rid of hash on css file
         assetFileNames: "assets/[name].[ext]",
       },
@@ -66,6 +98,11 @@ export default defineConfig(({ command }) => { return {
       '^/api': {
         target: 'http://' + proxy_target
       },
+      '^/live$': {
+        target: 'ws://' + proxy_target,
+        ws: true,
+        changeOrigin: true
+      },
       '^/livedata': {
         target: 'ws://' + proxy_target,
         ws: true,